@@ -0,0 +1,115 @@
+#include <cmath>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <fuse_variables/velocity_linear_3d_stamped.h>
+
+#include <bs_common/graph_access.h>
+#include <bs_common/preintegrator.h>
+
+namespace {
+
+// 200 Hz imu over one second, the usual spacing of keyframes
+bs_common::PreIntegrator MakePreIntegrator() {
+  bs_common::PreIntegrator pre_integrator;
+  pre_integrator.cov_w = 1e-4 * Eigen::Matrix3d::Identity();
+  pre_integrator.cov_a = 1e-3 * Eigen::Matrix3d::Identity();
+  pre_integrator.cov_bg = 1e-6 * Eigen::Matrix3d::Identity();
+  pre_integrator.cov_ba = 1e-5 * Eigen::Matrix3d::Identity();
+  for (int i = 0; i <= 200; i++) {
+    const double t = 1.0 + 0.005 * i;
+    bs_common::IMUData data;
+    data.t = ros::Time(t);
+    data.w = Eigen::Vector3d(0.5 * sin(t), 0.3 * cos(2 * t), 0.2);
+    data.a = Eigen::Vector3d(cos(t), sin(3 * t), 9.81 + 0.5 * sin(t));
+    pre_integrator.AddData(data);
+  }
+  return pre_integrator;
+}
+
+// graph with the imu states of a window of num_states keyframes
+fuse_graphs::HashGraph MakeGraph(int num_states) {
+  fuse_graphs::HashGraph graph;
+  for (int i = 0; i < num_states; i++) {
+    const ros::Time stamp(1.0 + 0.1 * i);
+    graph.addVariable(fuse_variables::Position3DStamped::make_shared(stamp));
+    graph.addVariable(
+        fuse_variables::Orientation3DStamped::make_shared(stamp));
+    graph.addVariable(
+        fuse_variables::VelocityLinear3DStamped::make_shared(stamp));
+    graph.addVariable(bs_variables::GyroscopeBias3DStamped::make_shared(stamp));
+    graph.addVariable(
+        bs_variables::AccelerationBias3DStamped::make_shared(stamp));
+  }
+  return graph;
+}
+
+} // namespace
+
+static void BM_PreIntegratorIntegrate(benchmark::State& state) {
+  bs_common::PreIntegrator pre_integrator = MakePreIntegrator();
+  const Eigen::Vector3d bg(0.01, -0.02, 0.005);
+  const Eigen::Vector3d ba(0.05, 0.02, -0.03);
+  const ros::Time t(2.0);
+  const bool compute_covariance = state.range(0);
+  for (auto _ : state) {
+    // clear the cached integration so every measurement is integrated
+    pre_integrator.Reset();
+    benchmark::DoNotOptimize(pre_integrator.Integrate(
+        t, bg, ba, true, compute_covariance, compute_covariance));
+  }
+  state.SetItemsProcessed(state.iterations() * pre_integrator.Data().Size());
+}
+BENCHMARK(BM_PreIntegratorIntegrate)->Arg(0)->Arg(1);
+
+static void BM_PreIntegratorIntegrateCached(benchmark::State& state) {
+  bs_common::PreIntegrator pre_integrator = MakePreIntegrator();
+  const Eigen::Vector3d bg(0.01, -0.02, 0.005);
+  const Eigen::Vector3d ba(0.05, 0.02, -0.03);
+  const Eigen::Vector3d bg_small = bg + Eigen::Vector3d::Constant(1e-3);
+  const ros::Time t(2.0);
+  pre_integrator.Integrate(t, bg, ba, true, true, true);
+  bool small = false;
+  for (auto _ : state) {
+    // alternate between small bias changes, which are corrected to first order
+    small = !small;
+    benchmark::DoNotOptimize(pre_integrator.Integrate(
+        t, small ? bg_small : bg, ba, true, true, true));
+  }
+}
+BENCHMARK(BM_PreIntegratorIntegrateCached);
+
+static void BM_GraphAccessGetImuState(benchmark::State& state) {
+  const int num_states = state.range(0);
+  const fuse_graphs::HashGraph graph = MakeGraph(num_states);
+  int i = 0;
+  for (auto _ : state) {
+    const ros::Time stamp(1.0 + 0.1 * (i++ % num_states));
+    benchmark::DoNotOptimize(bs_common::GetImuState(graph, stamp));
+  }
+}
+BENCHMARK(BM_GraphAccessGetImuState)->Arg(10)->Arg(100);
+
+static void BM_GraphAccessGetGraphPoses(benchmark::State& state) {
+  const fuse_graphs::HashGraph graph = MakeGraph(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bs_common::GetGraphPoses(graph));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GraphAccessGetGraphPoses)->Arg(10)->Arg(100);
+
+static void BM_GraphAccessCurrentTimestamps(benchmark::State& state) {
+  const fuse_graphs::HashGraph graph = MakeGraph(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bs_common::CurrentTimestamps(graph));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GraphAccessCurrentTimestamps)->Arg(10)->Arg(100);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Monotonic arena which hands out memory from large blocks and only
+ * releases it all at once when destroyed. This is meant for many small objects
+ * created together that have a similar lifetime, e.g. all constraints of one
+ * frame, so that they cost one heap allocation per block instead of one each.
+ *
+ * Allocating is not thread safe, but the arena can be destroyed from any
+ * thread (i.e., by whichever thread releases the last object).
+ */
+class MonotonicArena {
+public:
+  /**
+   * @brief constructor
+   * @param block_size number of bytes per block, larger allocations get their
+   * own block
+   */
+  explicit MonotonicArena(size_t block_size = 64 * 1024)
+      : block_size_(block_size) {}
+
+  ~MonotonicArena() {
+    for (void* block : blocks_) { ::operator delete(block); }
+  }
+
+  MonotonicArena(const MonotonicArena& other) = delete;
+
+  MonotonicArena& operator=(const MonotonicArena& other) = delete;
+
+  void* Allocate(size_t bytes, size_t alignment) {
+    void* ptr = current_;
+    if (!ptr || !std::align(alignment, bytes, ptr, remaining_)) {
+      // new blocks are aligned to max_align_t, pad for anything stricter
+      const size_t padded = bytes + alignment;
+      const size_t size = padded > block_size_ ? padded : block_size_;
+      ptr = ::operator new(size);
+      blocks_.push_back(ptr);
+      remaining_ = size;
+      std::align(alignment, bytes, ptr, remaining_);
+    }
+    current_ = static_cast<char*>(ptr) + bytes;
+    remaining_ -= bytes;
+    return ptr;
+  }
+
+  size_t NumBlocks() const { return blocks_.size(); }
+
+private:
+  size_t block_size_;
+  std::vector<void*> blocks_;
+  void* current_{nullptr};
+  size_t remaining_{0};
+};
+
+/**
+ * @brief Standard allocator over a shared MonotonicArena. Every copy of the
+ * allocator keeps the arena alive, so objects made with std::allocate_shared
+ * keep their memory valid until the last of them is destroyed. Deallocation is
+ * a no-op.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(std::shared_ptr<MonotonicArena> arena)
+      : arena_(std::move(arena)) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.Arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {}
+
+  const std::shared_ptr<MonotonicArena>& Arena() const { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return arena_ == other.Arena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return arena_ != other.Arena();
+  }
+
+private:
+  std::shared_ptr<MonotonicArena> arena_;
+};
+
+} // namespace bs_common
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Writes output files (e.g., scans or graph dumps) on background
+ * threads, so that saving results for data collection does not stall the
+ * sensor models. Each output stream should have its own writer, which has a
+ * bounded queue of write tasks and its own policy for when the queue is full:
+ *
+ *  - BLOCK: wait for a free spot, so no outputs are lost but the caller can
+ *    still be slowed down if the disk can't keep up,
+ *  - DROP: drop the new task and count it, so the caller is never slowed down.
+ *
+ * Tasks are plain functions which do the writing themselves, they must only
+ * capture data that is not modified by the caller after queuing (e.g., copies
+ * or shared pointers to immutable data). If sync_batch_size is set, the file
+ * system of the output directory is synced after every sync_batch_size tasks
+ * instead of after every file, which keeps the cost of syncing low.
+ */
+class AsyncWriter {
+public:
+  enum class Policy { BLOCK, DROP };
+
+  struct Params {
+    /** max number of tasks waiting to be written */
+    size_t queue_size{50};
+
+    /** number of writer threads. If 0, tasks are run when queued */
+    int num_threads{1};
+
+    Policy policy{Policy::BLOCK};
+
+    /** sync the output directory every this many tasks, 0 to never sync */
+    int sync_batch_size{0};
+  };
+
+  /**
+   * @brief constructor
+   * @param output_directory directory the tasks write to, only used for
+   * syncing
+   * @param params writer params
+   */
+  AsyncWriter(const std::string& output_directory, const Params& params);
+
+  /**
+   * @brief writes all queued tasks, then joins the writer threads
+   */
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter& other) = delete;
+
+  AsyncWriter& operator=(const AsyncWriter& other) = delete;
+
+  /**
+   * @brief queue a write task
+   * @return false if the task was dropped because the queue is full
+   */
+  bool Enqueue(std::function<void()> task);
+
+  /**
+   * @brief block until all queued tasks are written, and sync if
+   * sync_batch_size is set
+   */
+  void Flush();
+
+  /**
+   * @brief get the number of tasks dropped since construction
+   */
+  size_t NumDropped() const { return num_dropped_; }
+
+private:
+  void Run();
+
+  /**
+   * @brief run a task, then sync if the batch is full
+   */
+  void RunTask(const std::function<void()>& task);
+
+  void Sync() const;
+
+  std::string output_directory_;
+  Params params_;
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable task_added_;
+  std::condition_variable task_done_;
+  size_t num_in_progress_{0};
+  int num_unsynced_{0};
+  bool stopping_{false};
+  std::atomic<size_t> num_dropped_{0};
+};
+
+} // namespace bs_common
@@ -4,4 +4,6 @@
 #include <bs_common/DescriptorMsg.h>
 #include <bs_common/LandmarkMeasurementMsg.h>
 #include <bs_common/LidarMeasurementMsg.h>
+#include <bs_common/RelocRequestMsg.h>
+#include <bs_common/RelocResponseMsg.h>
 #include <bs_common/SlamChunkMsg.h>
\ No newline at end of file
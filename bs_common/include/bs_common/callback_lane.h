@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <boost/make_shared.hpp>
+#include <fuse_core/callback_wrapper.h>
+#include <ros/callback_queue_interface.h>
+#include <ros/node_handle.h>
+
+#include <bs_common/instrumentation.h>
+#include <bs_common/sampling_profiler.h>
+
+namespace bs_common {
+
+/**
+ * @brief Bounded lane of callbacks of a fuse AsyncSensorModel, used for its
+ * graph updates. fuse queues every graph update on the callback queue of the
+ * model, between its sensor callbacks, so a burst of slow graph updates
+ * delays the sensor data. A lane holds at most queue_size pending values, a
+ * new value supersedes the oldest pending one once it is full, e.g. with a
+ * queue size of 1 only the newest graph is processed. Graph deltas (see
+ * GraphSnapshot) are relative to the previous graph, so models which use them
+ * with superseding lanes must not rely on a delta to list all removed
+ * variables (see ScanPoseBuffer::UpdatePoses).
+ *
+ * The callbacks run on the callback queue of the model, so they are
+ * serialized with its sensor callbacks, unless the lane is dedicated: then
+ * they run on a thread of their own and the model must synchronize them with
+ * its sensor callbacks.
+ *
+ * The time values wait in the lane is recorded in the "<name>/wait" metric,
+ * and the number of superseded values in the counter of "<name>/superseded".
+ */
+template <typename T>
+class CallbackLane {
+public:
+  using Callback = std::function<void(const std::shared_ptr<const T>&)>;
+
+  struct Params {
+    /** max number of pending values, 0 for unbounded */
+    int queue_size{0};
+
+    /** run the callbacks on a thread of their own */
+    bool dedicated{false};
+
+    /**
+     * @brief load <prefix>/queue_size and <prefix>/dedicated, keeping the
+     * current values as defaults
+     */
+    void LoadFromROS(const ros::NodeHandle& nh, const std::string& prefix) {
+      nh.param(prefix + "/queue_size", queue_size, queue_size);
+      nh.param(prefix + "/dedicated", dedicated, dedicated);
+      queue_size = std::max(queue_size, 0);
+    }
+  };
+
+  struct Stats {
+    size_t pending{0};
+    size_t max_pending{0};
+    uint64_t processed{0};
+    uint64_t superseded{0};
+  };
+
+  /**
+   * @param name prefix of the metrics, e.g. "lidar_odometry/graph_lane". This
+   * is also the name of the dedicated thread in the SamplingProfiler
+   * @param queue callback queue of the model, not used if dedicated
+   * @param callback called with each value that is not superseded, in order
+   */
+  CallbackLane(const std::string& name, ros::CallbackQueueInterface* queue,
+               Callback callback, const Params& params)
+      : state_(std::make_shared<State>(name)) {
+    state_->queue = queue;
+    state_->callback = std::move(callback);
+    state_->queue_size = static_cast<size_t>(params.queue_size);
+    state_->dedicated = params.dedicated;
+    if (state_->dedicated) {
+      worker_ = std::thread([state = state_, name]() {
+        SamplingProfiler::GetInstance().RegisterThread(name);
+        state->Work();
+      });
+    }
+  }
+
+  /**
+   * @brief create a lane configured by the params in <prefix>/ (see
+   * Params::LoadFromROS), using the callback queue of the node handle
+   * @return nullptr if it is neither bounded nor dedicated, then each value
+   * should be queued as usual
+   */
+  static std::unique_ptr<CallbackLane<T>>
+      FromROS(const ros::NodeHandle& nh, const std::string& prefix,
+              const std::string& name, Callback callback) {
+    Params params;
+    params.LoadFromROS(nh, prefix);
+    if (params.queue_size == 0 && !params.dedicated) { return nullptr; }
+    return std::make_unique<CallbackLane<T>>(name, nh.getCallbackQueue(),
+                                             std::move(callback), params);
+  }
+
+  CallbackLane(const CallbackLane& other) = delete;
+
+  CallbackLane& operator=(const CallbackLane& other) = delete;
+
+  ~CallbackLane() {
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->stopped = true;
+      state_->pending.clear();
+    }
+    state_->condition.notify_all();
+    if (worker_.joinable()) { worker_.join(); }
+    if (!state_->dedicated) {
+      state_->queue->removeByID(reinterpret_cast<uint64_t>(state_.get()));
+    }
+  }
+
+  /**
+   * @brief add a value, superseding the oldest pending one if the lane is
+   * full
+   */
+  void Push(std::shared_ptr<const T> value) {
+    bool superseded = false;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (state_->stopped) { return; }
+      state_->pending.emplace_back(std::move(value),
+                                   std::chrono::steady_clock::now());
+      if (state_->queue_size > 0 &&
+          state_->pending.size() > state_->queue_size) {
+        state_->pending.pop_front();
+        state_->stats.superseded++;
+        superseded = true;
+      }
+      state_->stats.max_pending =
+          std::max(state_->stats.max_pending, state_->pending.size());
+    }
+    if (superseded) {
+      // the callback queued for the superseded value takes the next one
+      state_->superseded_metric.Increment();
+      return;
+    }
+
+    if (state_->dedicated) {
+      state_->condition.notify_one();
+      return;
+    }
+    std::weak_ptr<State> weak_state = state_;
+    state_->queue->addCallback(
+        boost::make_shared<fuse_core::CallbackWrapper<void>>([weak_state]() {
+          if (auto state = weak_state.lock()) { state->ProcessOne(); }
+        }),
+        reinterpret_cast<uint64_t>(state_.get()));
+  }
+
+  /**
+   * @brief drop all pending values. If dedicated, this waits for the running
+   * callback, so it must not be called from a callback of this lane
+   */
+  void Clear() {
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->pending.clear();
+    }
+    if (state_->dedicated) {
+      std::lock_guard<std::mutex> lock(state_->callback_mutex);
+    } else {
+      state_->queue->removeByID(reinterpret_cast<uint64_t>(state_.get()));
+    }
+  }
+
+  Stats GetStats() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    Stats stats = state_->stats;
+    stats.pending = state_->pending.size();
+    return stats;
+  }
+
+private:
+  /** shared with the queued callbacks, which may outlive the lane */
+  struct State {
+    explicit State(const std::string& name)
+        : wait_metric(
+              Instrumentation::GetInstance().GetMetric(name + "/wait")),
+          superseded_metric(
+              Instrumentation::GetInstance().GetMetric(name + "/superseded")) {
+    }
+
+    void ProcessOne() {
+      // held while the callback runs, so that pending values are processed in
+      // order and Clear can wait for the running one
+      std::lock_guard<std::mutex> callback_lock(callback_mutex);
+      std::shared_ptr<const T> value;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) { return; }
+        value = std::move(pending.front().first);
+        wait_metric.Record(std::chrono::steady_clock::now() -
+                           pending.front().second);
+        pending.pop_front();
+        stats.processed++;
+      }
+      callback(value);
+    }
+
+    void Work() {
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          condition.wait(lock,
+                         [this]() { return stopped || !pending.empty(); });
+          if (stopped) { return; }
+        }
+        ProcessOne();
+      }
+    }
+
+    ros::CallbackQueueInterface* queue{nullptr};
+    Callback callback;
+    size_t queue_size{0};
+    bool dedicated{false};
+    Metric& wait_metric;
+    Metric& superseded_metric;
+
+    std::mutex callback_mutex;
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::pair<std::shared_ptr<const T>,
+                         std::chrono::steady_clock::time_point>>
+        pending;
+    Stats stats;
+    bool stopped{false};
+  };
+
+  std::shared_ptr<State> state_;
+  std::thread worker_;
+};
+
+} // namespace bs_common
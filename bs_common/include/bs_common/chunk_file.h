@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace bs_common {
+
+/**
+ * @brief Appends plain data to a byte buffer, used to serialize the chunks of
+ * a chunk file. Values are written in host byte order, without padding
+ */
+class ByteWriter {
+public:
+  /**
+   * @brief append a trivially copyable value
+   */
+  template <typename T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can be written");
+    WriteBytes(&value, sizeof(T));
+  }
+
+  /**
+   * @brief append the size of a vector followed by its elements
+   */
+  template <typename T>
+  void WriteVector(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can be written");
+    Write<uint64_t>(values.size());
+    WriteBytes(values.data(), values.size() * sizeof(T));
+  }
+
+  /**
+   * @brief append the coefficients of a fixed size matrix, column major
+   */
+  template <typename Derived>
+  void WriteMatrix(const Eigen::MatrixBase<Derived>& m) {
+    static_assert(Derived::SizeAtCompileTime != Eigen::Dynamic,
+                  "only fixed size matrices can be written");
+    for (int c = 0; c < m.cols(); c++) {
+      for (int r = 0; r < m.rows(); r++) { Write<double>(m(r, c)); }
+    }
+  }
+
+  /**
+   * @brief append the size of a string followed by its characters
+   */
+  void WriteString(const std::string& s);
+
+  /**
+   * @brief append raw bytes
+   */
+  void WriteBytes(const void* data, size_t size);
+
+  const std::vector<uint8_t>& Data() const { return data_; }
+
+  size_t Size() const { return data_.size(); }
+
+  void Clear() { data_.clear(); }
+
+private:
+  std::vector<uint8_t> data_;
+};
+
+/**
+ * @brief Reads back data written by a ByteWriter, in the same order. The data
+ * is not copied. Every read is bounds checked and throws a std::runtime_error
+ * when it is past the end of the data
+ */
+class ByteReader {
+public:
+  /**
+   * @brief constructor
+   * @param data start of the data, must outlive the reader
+   * @param size size of the data in bytes
+   */
+  ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  T Read() {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can be read");
+    T value;
+    std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  void ReadVector(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can be read");
+    const uint64_t n = Read<uint64_t>();
+    if (n > Remaining() / sizeof(T)) {
+      throw std::runtime_error("invalid vector size in chunk data");
+    }
+    values.resize(n);
+    std::memcpy(values.data(), ReadBytes(n * sizeof(T)), n * sizeof(T));
+  }
+
+  template <typename Derived>
+  void ReadMatrix(Eigen::MatrixBase<Derived>& m) {
+    static_assert(Derived::SizeAtCompileTime != Eigen::Dynamic,
+                  "only fixed size matrices can be read");
+    for (int c = 0; c < m.cols(); c++) {
+      for (int r = 0; r < m.rows(); r++) { m(r, c) = Read<double>(); }
+    }
+  }
+
+  std::string ReadString();
+
+  /**
+   * @brief get a pointer to the next size bytes and move past them
+   */
+  const uint8_t* ReadBytes(size_t size);
+
+  size_t Remaining() const { return size_ - position_; }
+
+private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_{0};
+};
+
+/**
+ * @brief Location of a chunk in a chunk file. Chunks are identified by a type
+ * and an id, which is unique per type
+ */
+struct ChunkInfo {
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t id;
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * @brief Writes a chunk file, which is a header followed by the chunks back
+ * to back and an index of all chunks at the end. Chunks are written to the file
+ * as they are added, so only one chunk is held in memory at a time. Chunks can
+ * be added from multiple threads, they are stored in the order they are added
+ * and the index is the same regardless of the order.
+ *
+ * Layout:
+ *
+ *  header: magic (8 bytes), format version (uint32), user version (uint32),
+ *          index offset (uint64), number of chunks (uint64)
+ *  chunks: raw data
+ *  index:  one ChunkInfo per chunk
+ */
+class ChunkFileWriter {
+public:
+  ChunkFileWriter() = default;
+
+  /**
+   * @brief closes the file if it is still open
+   */
+  ~ChunkFileWriter();
+
+  ChunkFileWriter(const ChunkFileWriter& other) = delete;
+
+  ChunkFileWriter& operator=(const ChunkFileWriter& other) = delete;
+
+  /**
+   * @brief create a file, overriding any existing file
+   * @param path full path to the file
+   * @param version version of the layout of the chunk data, which is returned
+   * to readers so they can handle older layouts
+   * @return false if the file cannot be created
+   */
+  bool Open(const std::string& path, uint32_t version);
+
+  /**
+   * @brief write a chunk. Ids that are already used by a chunk of the same
+   * type are reported on Close
+   * @return false if the file is not open or the chunk cannot be written
+   */
+  bool AddChunk(uint32_t type, uint64_t id, const ByteWriter& data);
+
+  /**
+   * @brief write the index and close the file. The file is not valid until
+   * this is called
+   * @return false if the file is not open or the index cannot be written
+   */
+  bool Close();
+
+  bool IsOpen() const { return file_.is_open(); }
+
+private:
+  std::mutex mutex_;
+  std::ofstream file_;
+  std::string path_;
+  uint32_t version_{0};
+  uint64_t offset_{0};
+  std::vector<ChunkInfo> index_;
+};
+
+/**
+ * @brief Reads a chunk file written by ChunkFileWriter. The file is memory
+ * mapped, so opening it only reads the header and index and the data of each
+ * chunk is paged in by the OS when it is first read. The reader is not
+ * modified after Open, so chunks can be read from multiple threads
+ */
+class ChunkFileReader {
+public:
+  ChunkFileReader() = default;
+
+  /**
+   * @brief unmaps the file
+   */
+  ~ChunkFileReader();
+
+  ChunkFileReader(const ChunkFileReader& other) = delete;
+
+  ChunkFileReader& operator=(const ChunkFileReader& other) = delete;
+
+  /**
+   * @brief memory map a file and read its index
+   * @param path full path to the file
+   * @return false if the file cannot be mapped or is not a valid chunk file
+   */
+  bool Open(const std::string& path);
+
+  /**
+   * @brief unmap the file. ByteReaders of its chunks are invalidated
+   */
+  void Close();
+
+  bool IsOpen() const { return data_ != nullptr; }
+
+  /**
+   * @brief get the version the file was written with
+   */
+  uint32_t Version() const { return version_; }
+
+  /**
+   * @brief find a chunk
+   * @return nullptr if there is no chunk with this type and id
+   */
+  const ChunkInfo* Find(uint32_t type, uint64_t id) const;
+
+  /**
+   * @brief get all chunks of a type, sorted by id
+   */
+  std::vector<ChunkInfo> Chunks(uint32_t type) const;
+
+  /**
+   * @brief get a reader over the data of a chunk, valid until Close
+   */
+  ByteReader Read(const ChunkInfo& chunk) const;
+
+  /**
+   * @brief tell the OS that the pages of a chunk are not needed anymore, so
+   * they no longer count towards the resident memory of the process. The chunk
+   * can still be read, its pages are then read from the file again. Only the
+   * pages that are fully inside the chunk are released
+   */
+  void Evict(const ChunkInfo& chunk) const;
+
+  /**
+   * @brief check if a file starts with the chunk file magic
+   */
+  static bool IsChunkFile(const std::string& path);
+
+private:
+  std::string path_;
+  const uint8_t* data_{nullptr};
+  size_t size_{0};
+  uint32_t version_{0};
+  std::vector<ChunkInfo> index_; // sorted by type then id
+};
+
+} // namespace bs_common
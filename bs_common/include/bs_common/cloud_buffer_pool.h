@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <boost/core/demangle.hpp>
+#include <pcl/point_cloud.h>
+
+#include <bs_common/instrumentation.h>
+#include <bs_common/memory_accounting.h>
+
+namespace bs_common {
+
+/**
+ * @brief Thread safe pool of point buffers for pcl::PointCloud, so that the
+ * clouds a lidar front end creates for every scan (the converted and deskewed
+ * scan, the filtered scan, the scan kept by its ScanPose) reuse the storage of
+ * the clouds of previous scans instead of going through the heap. This is the
+ * size classed counterpart of the FreeListPool.
+ *
+ * Buffers are binned by capacity in power of two size classes. Acquire gives
+ * a cloud empty storage with at least the requested capacity, from the
+ * smallest class that fits (at most 4 times larger than needed), and new
+ * buffers are reserved with the capacity rounded up to the next class so a
+ * pool reaches a steady state after a few scans. Released buffers are cleared
+ * and keep their capacity. At most max_buffers_per_class buffers are kept per
+ * class, and buffers smaller than kMinPooledPoints are not pooled.
+ *
+ * Each pool records the counters "cloud_pool/<name>/allocated",
+ * "cloud_pool/<name>/reused" and "cloud_pool/<name>/released" in the
+ * instrumentation, and the memory of its free buffers in the memory account
+ * "cloud_pool/<name>".
+ */
+template <typename PointT>
+class CloudBufferPool {
+public:
+  using Cloud = pcl::PointCloud<PointT>;
+  using Buffer = typename Cloud::VectorType;
+
+  static constexpr size_t kMinPooledPoints = 1024;
+  static constexpr size_t kDefaultMaxBuffersPerClass = 8;
+
+  /**
+   * @brief constructor
+   * @param name name of the pool in the instrumentation metrics and memory
+   * accounts
+   * @param max_buffers_per_class maximum number of free buffers to keep per
+   * size class
+   */
+  explicit CloudBufferPool(
+      const std::string& name,
+      size_t max_buffers_per_class = kDefaultMaxBuffersPerClass)
+      : max_buffers_per_class_(max_buffers_per_class),
+        allocated_metric_(Instrumentation::GetInstance().GetMetric(
+            "cloud_pool/" + name + "/allocated")),
+        reused_metric_(Instrumentation::GetInstance().GetMetric(
+            "cloud_pool/" + name + "/reused")),
+        released_metric_(Instrumentation::GetInstance().GetMetric(
+            "cloud_pool/" + name + "/released")),
+        account_(MemoryAccounting::GetInstance().GetAccount("cloud_pool/" +
+                                                            name)) {}
+
+  CloudBufferPool(const CloudBufferPool& other) = delete;
+
+  CloudBufferPool& operator=(const CloudBufferPool& other) = delete;
+
+  /**
+   * @brief get the pool of a point type, shared by all libraries of the
+   * process. The pool is created on first use and never destroyed, since
+   * pooled clouds may be released during static destruction. It is named
+   * after the point type, e.g. "cloud_pool/pcl::PointXYZ/reused"
+   */
+  static CloudBufferPool& Get() {
+    static CloudBufferPool* pool =
+        new CloudBufferPool(boost::core::demangle(typeid(PointT).name()));
+    return *pool;
+  }
+
+  /**
+   * @brief give pooled storage to a cloud. The storage is swapped in, since
+   * moving a pcl::PointCloud does not keep the capacity of its points with
+   * all pcl versions
+   * @param cloud cloud to clear, its previous storage goes back to the pool
+   * @param capacity min number of points the cloud can hold without
+   * reallocating
+   */
+  void Acquire(Cloud& cloud, size_t capacity) {
+    Release(cloud);
+    if (capacity == 0) { return; }
+    const size_t size_class = SizeClass(capacity, true);
+    if (capacity >= kMinPooledPoints) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // larger buffers are only used up to kMaxClassesAbove classes above
+      const size_t max_class =
+          std::min(kNumClasses, size_class + kMaxClassesAbove + 1);
+      for (size_t c = size_class; c < max_class; c++) {
+        if (free_[c].empty()) { continue; }
+        cloud.points.swap(free_[c].back());
+        free_[c].pop_back();
+        free_bytes_ -= cloud.points.capacity() * sizeof(PointT);
+        account_.Update(NumFreeBuffersLocked(), free_bytes_);
+        reused_metric_.Increment();
+        return;
+      }
+    }
+    allocated_metric_.Increment();
+    cloud.points.reserve(size_t(1) << size_class);
+  }
+
+  /**
+   * @brief give the storage of a cloud back to the pool, the cloud is left
+   * empty
+   */
+  void Release(Cloud& cloud) {
+    Buffer buffer;
+    buffer.swap(cloud.points);
+    cloud.width = 0;
+    cloud.height = 1;
+    const size_t capacity = buffer.capacity();
+    if (capacity < kMinPooledPoints) { return; }
+    released_metric_.Increment();
+    buffer.clear();
+    // a buffer goes in the largest class it can fully serve
+    const size_t size_class = SizeClass(capacity, false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_class >= kNumClasses ||
+        free_[size_class].size() >= max_buffers_per_class_) {
+      return;
+    }
+    free_bytes_ += capacity * sizeof(PointT);
+    free_[size_class].push_back(std::move(buffer));
+    account_.Update(NumFreeBuffersLocked(), free_bytes_);
+  }
+
+  /**
+   * @brief share a cloud, its storage goes back to the pool once the last
+   * copy of the returned pointer is destroyed. The pool must outlive the
+   * shared cloud, which is always the case for the pools returned by Get
+   * @param cloud cloud to share, its points are swapped into the shared cloud
+   * and it is left empty
+   */
+  std::shared_ptr<Cloud> Share(Cloud& cloud) {
+    auto shared = new Cloud();
+    shared->header = cloud.header;
+    shared->width = cloud.width;
+    shared->height = cloud.height;
+    shared->is_dense = cloud.is_dense;
+    shared->sensor_origin_ = cloud.sensor_origin_;
+    shared->sensor_orientation_ = cloud.sensor_orientation_;
+    shared->points.swap(cloud.points);
+    cloud.width = 0;
+    cloud.height = 1;
+    return std::shared_ptr<Cloud>(shared, [this](Cloud* released) {
+      Release(*released);
+      delete released;
+    });
+  }
+
+  size_t NumFreeBuffers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return NumFreeBuffersLocked();
+  }
+
+  /**
+   * @brief drop all free buffers
+   */
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& buffers : free_) { buffers.clear(); }
+    free_bytes_ = 0;
+    account_.Update(0, 0);
+  }
+
+private:
+  static constexpr size_t kNumClasses = 32;
+  static constexpr size_t kMaxClassesAbove = 2;
+
+  /**
+   * @brief log2 of the capacity, rounded up or down
+   */
+  static size_t SizeClass(size_t capacity, bool round_up) {
+    size_t size_class = 0;
+    while ((size_t(1) << (size_class + 1)) <= capacity) { size_class++; }
+    if (round_up && (size_t(1) << size_class) < capacity) { size_class++; }
+    return size_class;
+  }
+
+  size_t NumFreeBuffersLocked() const {
+    size_t num_free = 0;
+    for (const auto& buffers : free_) { num_free += buffers.size(); }
+    return num_free;
+  }
+
+  size_t max_buffers_per_class_;
+
+  mutable std::mutex mutex_;
+  std::array<std::vector<Buffer>, kNumClasses> free_;
+  size_t free_bytes_{0};
+
+  Metric& allocated_metric_;
+  Metric& reused_metric_;
+  Metric& released_metric_;
+  MemoryAccount& account_;
+};
+
+} // namespace bs_common
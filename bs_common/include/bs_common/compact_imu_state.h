@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+
+#include <Eigen/Geometry>
+#include <ros/time.h>
+
+namespace bs_common {
+
+/**
+ * @brief Fixed size IMU state (stamp, orientation, position, velocity and
+ * biases) used to propagate states and to store their history. Unlike
+ * ImuState it holds no fuse variables or preintegrator, so copies are plain
+ * memory copies. ImuState can be built from it once the variables are needed,
+ * e.g. to build a transaction, and their uuids are generated from the stamp as
+ * for any ImuState.
+ */
+struct CompactImuState {
+  CompactImuState() = default;
+
+  /**
+   * @brief state at the given time with identity orientation and zero
+   * position, velocity and biases
+   */
+  explicit CompactImuState(const ros::Time& time) : stamp(time) {}
+
+  ros::Time stamp;
+  double orientation[4]{1, 0, 0, 0}; // w, x, y, z
+  double position[3]{0, 0, 0};
+  double velocity[3]{0, 0, 0};
+  double gyro_bias[3]{0, 0, 0};
+  double accel_bias[3]{0, 0, 0};
+
+  ros::Time Stamp() const { return stamp; }
+
+  Eigen::Quaterniond OrientationQuat() const {
+    return Eigen::Quaterniond(orientation[0], orientation[1], orientation[2],
+                              orientation[3])
+        .normalized();
+  }
+
+  Eigen::Matrix3d OrientationMat() const {
+    return OrientationQuat().toRotationMatrix();
+  }
+
+  Eigen::Vector3d PositionVec() const {
+    return Eigen::Vector3d(position[0], position[1], position[2]);
+  }
+
+  Eigen::Vector3d VelocityVec() const {
+    return Eigen::Vector3d(velocity[0], velocity[1], velocity[2]);
+  }
+
+  Eigen::Vector3d GyroBiasVec() const {
+    return Eigen::Vector3d(gyro_bias[0], gyro_bias[1], gyro_bias[2]);
+  }
+
+  Eigen::Vector3d AccelBiasVec() const {
+    return Eigen::Vector3d(accel_bias[0], accel_bias[1], accel_bias[2]);
+  }
+
+  void SetOrientation(const Eigen::Quaterniond& q) {
+    orientation[0] = q.w();
+    orientation[1] = q.x();
+    orientation[2] = q.y();
+    orientation[3] = q.z();
+  }
+
+  void SetPosition(const Eigen::Vector3d& p) { SetPosition(p.data()); }
+
+  void SetVelocity(const Eigen::Vector3d& v) { SetVelocity(v.data()); }
+
+  void SetGyroBias(const Eigen::Vector3d& bg) { SetGyroBias(bg.data()); }
+
+  void SetAccelBias(const Eigen::Vector3d& ba) { SetAccelBias(ba.data()); }
+
+  /**
+   * @brief setters from c-style arrays, e.g. the data of fuse variables
+   */
+  void SetOrientation(const double* q) { std::copy(q, q + 4, orientation); }
+
+  void SetPosition(const double* p) { std::copy(p, p + 3, position); }
+
+  void SetVelocity(const double* v) { std::copy(v, v + 3, velocity); }
+
+  void SetGyroBias(const double* bg) { std::copy(bg, bg + 3, gyro_bias); }
+
+  void SetAccelBias(const double* ba) { std::copy(ba, ba + 3, accel_bias); }
+};
+
+static_assert(std::is_trivially_copyable<CompactImuState>::value,
+              "CompactImuState must stay trivially copyable");
+
+} // namespace bs_common
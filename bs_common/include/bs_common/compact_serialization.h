@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include <fuse_core/constraint.h>
+#include <fuse_core/graph.h>
+#include <fuse_core/loss.h>
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+#include <fuse_core/variable.h>
+
+#include <bs_common/chunk_file.h>
+
+namespace bs_common {
+
+/**
+ * @brief Compact binary encoding of fuse variables, constraints, transactions
+ * and graphs. Every object is written as a 32 bit type code followed by its
+ * fields with a fixed size and order, instead of the class name, archive
+ * headers and object tracking boost::serialization writes for each object.
+ *
+ * The type code is computed from the fuse type name, so it is stable across
+ * builds and processes. The fields of a type must not change without bumping
+ * kCompactSerializationVersion, which is written at the start of every
+ * transaction and graph so readers can reject data they do not understand.
+ *
+ * Codecs are registered by the library implementing the type, next to its
+ * plugin export, so they are available as soon as fuse loads the plugin (see
+ * BS_COMPACT_CONSTRAINT_EXPORT). The fuse and beam_slam variables are
+ * registered by bs_common. Objects without a codec, such as losses and the
+ * fuse constraints, are written with their type name and boost serialization
+ * and read back through the fuse plugin loaders, so any graph can be encoded.
+ */
+constexpr uint32_t kCompactSerializationVersion = 1;
+
+/**
+ * @brief Stable 32 bit code of a fuse type name (FNV-1a hash)
+ */
+uint32_t CompactTypeCode(const std::string& type);
+
+class CompactSerializer {
+public:
+  using VariableWriter =
+      std::function<void(const fuse_core::Variable&, ByteWriter&)>;
+  using VariableReader =
+      std::function<fuse_core::Variable::SharedPtr(ByteReader&)>;
+  using ConstraintWriter =
+      std::function<void(const fuse_core::Constraint&, ByteWriter&)>;
+  using ConstraintReader =
+      std::function<fuse_core::Constraint::SharedPtr(ByteReader&)>;
+
+  /**
+   * @brief get the serializer shared by all libraries of the process
+   */
+  static CompactSerializer& Instance();
+
+  CompactSerializer(const CompactSerializer& other) = delete;
+
+  CompactSerializer& operator=(const CompactSerializer& other) = delete;
+
+  /**
+   * @brief register the codec of a variable type. Throws a std::runtime_error
+   * if the code of the type is already used by a different type
+   */
+  void RegisterVariable(const std::string& type, VariableWriter writer,
+                        VariableReader reader);
+
+  /**
+   * @brief register the codec of a constraint type. Throws a
+   * std::runtime_error if the code of the type is already used by a
+   * different type
+   */
+  void RegisterConstraint(const std::string& type, ConstraintWriter writer,
+                          ConstraintReader reader);
+
+  /**
+   * @brief check if a type has a codec, otherwise it is written with boost
+   * serialization
+   */
+  bool HasCodec(const std::string& type) const;
+
+  void WriteVariable(const fuse_core::Variable& variable,
+                     ByteWriter& writer) const;
+
+  void WriteConstraint(const fuse_core::Constraint& constraint,
+                       ByteWriter& writer) const;
+
+  void WriteTransaction(const fuse_core::Transaction& transaction,
+                        ByteWriter& writer) const;
+
+  /**
+   * @brief write all variables, with their hold state, and constraints of a
+   * graph
+   */
+  void WriteGraph(const fuse_core::Graph& graph, ByteWriter& writer) const;
+
+  /**
+   * @brief read data written by WriteVariable. All reads throw a
+   * std::runtime_error if the data is invalid or of an unknown type
+   */
+  fuse_core::Variable::SharedPtr ReadVariable(ByteReader& reader) const;
+
+  fuse_core::Constraint::SharedPtr ReadConstraint(ByteReader& reader) const;
+
+  fuse_core::Transaction::SharedPtr ReadTransaction(ByteReader& reader) const;
+
+  /**
+   * @brief read data written by WriteGraph, adding the variables and
+   * constraints to a graph
+   */
+  void ReadGraph(ByteReader& reader, fuse_core::Graph& graph) const;
+
+private:
+  CompactSerializer();
+
+  /**
+   * @brief register the fuse and beam_slam variables
+   */
+  void RegisterVariables();
+
+  /**
+   * @brief get the code of a type that is being registered
+   */
+  uint32_t NewCode(const std::string& type);
+
+  /**
+   * @brief get the code of the type of an object, or 0 if it has no codec.
+   * The codes are cached by type id so type names are only built once
+   */
+  template <typename T>
+  uint32_t Code(const T& object) const;
+
+  struct VariableCodec {
+    VariableWriter write;
+    VariableReader read;
+  };
+
+  struct ConstraintCodec {
+    ConstraintWriter write;
+    ConstraintReader read;
+  };
+
+  // codecs are registered as plugin libraries are loaded, which can happen
+  // while other threads encode
+  mutable std::shared_timed_mutex mutex_;
+  std::unordered_map<uint32_t, std::string> types_;
+  mutable std::unordered_map<std::type_index, uint32_t> codes_;
+  std::unordered_map<uint32_t, VariableCodec> variables_;
+  std::unordered_map<uint32_t, ConstraintCodec> constraints_;
+};
+
+/**
+ * @brief write the fuse_core::Constraint members of a constraint, for use by
+ * the codecs of constraint types
+ */
+void WriteConstraintBase(const fuse_core::Constraint& constraint,
+                         ByteWriter& writer);
+
+/**
+ * @brief read the fuse_core::Constraint members written by
+ * WriteConstraintBase
+ */
+void ReadConstraintBase(ByteReader& reader, std::string& source,
+                        fuse_core::UUID& uuid,
+                        std::vector<fuse_core::UUID>& variables,
+                        fuse_core::Loss::SharedPtr& loss);
+
+/**
+ * @brief write an optional loss. Losses have no codec and are written with
+ * boost serialization
+ */
+void WriteLoss(const fuse_core::Loss::SharedPtr& loss, ByteWriter& writer);
+
+fuse_core::Loss::SharedPtr ReadLoss(ByteReader& reader);
+
+/**
+ * @brief register the codec of a constraint type T, which implements
+ * serializeCompact(ByteWriter&) const and deserializeCompact(ByteReader&)
+ */
+template <typename T>
+bool RegisterCompactConstraint() {
+  CompactSerializer::Instance().RegisterConstraint(
+      T::detail::type(),
+      [](const fuse_core::Constraint& constraint, ByteWriter& writer) {
+        static_cast<const T&>(constraint).serializeCompact(writer);
+      },
+      [](ByteReader& reader) -> fuse_core::Constraint::SharedPtr {
+        auto constraint = T::make_shared();
+        constraint->deserializeCompact(reader);
+        return constraint;
+      });
+  return true;
+}
+
+} // namespace bs_common
+
+#define BS_COMPACT_SERIALIZATION_CONCAT_(a, b) a##b
+#define BS_COMPACT_SERIALIZATION_CONCAT(a, b)                                  \
+  BS_COMPACT_SERIALIZATION_CONCAT_(a, b)
+
+/**
+ * @brief register the compact codec of a constraint type when its library is
+ * loaded. Use next to PLUGINLIB_EXPORT_CLASS
+ */
+#define BS_COMPACT_CONSTRAINT_EXPORT(Class)                                    \
+  namespace {                                                                  \
+  const bool BS_COMPACT_SERIALIZATION_CONCAT(compact_constraint_registered_,   \
+                                             __LINE__) =                       \
+      bs_common::RegisterCompactConstraint<Class>();                           \
+  }
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
 #include <bs_common/extrinsics_lookup_base.h>
+#include <bs_common/rcu_slot.h>
+#include <bs_common/trajectory_buffer.h>
 #include <bs_parameters/models/calibration_params.h>
 
 #include <Eigen/Dense>
@@ -15,6 +21,13 @@ namespace bs_common {
  * beam_slam is to add global variables to the config yaml for each of the
  * frames, then each of the sensor models can get the instance of this class
  * with those same global params. See global_mapper.cpp for an example use case.
+ *
+ * The frame ids are resolved once at construction, so the GetT_* getters never
+ * compare strings. Static extrinsics are looked up on tf once per frame pair
+ * and then read from an immutable snapshot without locking. Dynamic extrinsics
+ * are read from a time-indexed cache of T_BASELINK_SENSOR estimates which is
+ * fed by the models estimating them (see AddT_BASELINK_SENSOR), and tf is only
+ * used to seed the cache of sensors without estimates.
  */
 class ExtrinsicsLookupOnline {
 public:
@@ -191,6 +204,20 @@ public:
   bool GetT_SENSOR_BASELINK(Eigen::Matrix4d& T, const std::string& sensor_frame,
                             const ros::Time& time = ros::Time(0));
 
+  /**
+   * @brief Adds an estimate of dynamic extrinsics to the cache read by the
+   * getters. Estimates are interpolated between stamps, and the closest
+   * estimate is used for times outside of the cache since the extrinsics only
+   * drift slowly. Does nothing if extrinsics are static
+   * @param T transform from sensor frame to baselink
+   * @param sensor_frame sensor frame id
+   * @param time time of the estimate
+   * @return false if the sensor frame id is invalid
+   */
+  bool AddT_BASELINK_SENSOR(const Eigen::Matrix4d& T,
+                            const std::string& sensor_frame,
+                            const ros::Time& time);
+
   /**
    * @brief Gets the frame id of IMU
    * @return frame id
@@ -241,11 +268,48 @@ public:
   std::string GetFrameIdsString();
 
 private:
+  /** frames known at construction, used to index the transform tables */
+  enum Frame : size_t { IMU = 0, CAMERA, LIDAR, BASELINK, NUM_FRAMES };
+
+  /** static transforms that have been looked up, indexed by to * NUM_FRAMES +
+   * from */
+  struct StaticTransforms {
+    std::array<Eigen::Matrix4d, NUM_FRAMES * NUM_FRAMES> T;
+    std::array<bool, NUM_FRAMES * NUM_FRAMES> set{};
+  };
+
   /**
    * @brief Constructor
    */
   ExtrinsicsLookupOnline();
 
+  /**
+   * @brief get transform between two known frames
+   */
+  bool GetTransform(Eigen::Matrix4d& T, Frame to_frame, Frame from_frame,
+                    const ros::Time& time);
+
+  /**
+   * @brief get a static transform from the snapshot, looking it up on tf and
+   * publishing a new snapshot if it isn't set yet
+   */
+  bool GetStaticTransform(Eigen::Matrix4d& T, Frame to_frame,
+                          Frame from_frame);
+
+  /**
+   * @brief get a dynamic transform from a sensor (or baselink) to baselink
+   * from the cache, seeding the cache from tf if it is empty
+   */
+  bool GetDynamicT_BASELINK_FRAME(Eigen::Matrix4d& T, Frame frame,
+                                  const ros::Time& time);
+
+  /**
+   * @brief store a looked up transform in the extrinsics copy, if it is
+   * between two sensors
+   */
+  void SetExtrinsicsCopy(const Eigen::Matrix4d& T, Frame to_frame,
+                         Frame from_frame);
+
   /**
    * @brief Looks up the transform between specified frames using the
    * tf_listener
@@ -268,6 +332,23 @@ private:
   std::unique_ptr<tf::TransformListener> tf_listener_;
 
   std::shared_ptr<ExtrinsicsLookupBase> extrinsics_;
+
+  // interned frame ids, immutable after construction. Frames sharing an id
+  // (e.g. baselink and IMU) all resolve to the first of them
+  std::array<std::string, NUM_FRAMES> frame_ids_;
+  std::array<Frame, NUM_FRAMES> resolved_frames_;
+  std::unordered_map<std::string, Frame> frames_;
+
+  std::once_flag tf_listener_created_;
+
+  // guards extrinsics_ and publishing static transforms
+  std::mutex mutex_;
+
+  RcuSlot<StaticTransforms> static_transforms_;
+
+  // T_BASELINK_FRAME estimates per frame, only used for dynamic extrinsics
+  std::array<std::unique_ptr<TrajectoryBuffer>, NUM_FRAMES>
+      dynamic_transforms_;
 };
 
 } // namespace bs_common
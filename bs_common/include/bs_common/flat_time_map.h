@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Time sorted map stored in a single vector, used for the time keyed
+ * stores of keyframes and scans. These are appended in time order and
+ * iterated far more often than they are looked up, so keeping the values
+ * contiguous avoids the allocation per insertion and the pointer chasing of a
+ * std::map. Appending a key newer than the last one is amortized O(1), lookups
+ * are binary searches, and inserting or erasing elsewhere moves the newer
+ * values.
+ *
+ * The interface is the subset of std::map used by these stores, so it can
+ * replace one without changing its callers. Unlike a std::map, iterators and
+ * references are invalidated by insertions and erasures, as with a vector:
+ * callers must hold the key (e.g. the stamp), which is the stable handle of a
+ * value, and look it up again after modifying the map. Keys must not be
+ * modified through the iterators.
+ */
+template <typename Key, typename T>
+class FlatTimeMap {
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using container_type = std::vector<value_type>;
+  using size_type = typename container_type::size_type;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+  using reverse_iterator = typename container_type::reverse_iterator;
+  using const_reverse_iterator =
+      typename container_type::const_reverse_iterator;
+
+  iterator begin() { return values_.begin(); }
+  iterator end() { return values_.end(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+  const_iterator cbegin() const { return values_.cbegin(); }
+  const_iterator cend() const { return values_.cend(); }
+  reverse_iterator rbegin() { return values_.rbegin(); }
+  reverse_iterator rend() { return values_.rend(); }
+  const_reverse_iterator rbegin() const { return values_.rbegin(); }
+  const_reverse_iterator rend() const { return values_.rend(); }
+
+  size_type size() const { return values_.size(); }
+
+  bool empty() const { return values_.empty(); }
+
+  void clear() { values_.clear(); }
+
+  void reserve(size_type n) { values_.reserve(n); }
+
+  iterator lower_bound(const Key& key) {
+    return std::lower_bound(values_.begin(), values_.end(), key, KeyLess());
+  }
+
+  const_iterator lower_bound(const Key& key) const {
+    return std::lower_bound(values_.begin(), values_.end(), key, KeyLess());
+  }
+
+  iterator upper_bound(const Key& key) {
+    return std::upper_bound(values_.begin(), values_.end(), key, KeyLess());
+  }
+
+  const_iterator upper_bound(const Key& key) const {
+    return std::upper_bound(values_.begin(), values_.end(), key, KeyLess());
+  }
+
+  iterator find(const Key& key) {
+    auto it = lower_bound(key);
+    return it != end() && !(key < it->first) ? it : end();
+  }
+
+  const_iterator find(const Key& key) const {
+    auto it = lower_bound(key);
+    return it != end() && !(key < it->first) ? it : end();
+  }
+
+  size_type count(const Key& key) const { return find(key) != end() ? 1 : 0; }
+
+  T& at(const Key& key) {
+    auto it = find(key);
+    if (it == end()) { throw std::out_of_range{"FlatTimeMap::at"}; }
+    return it->second;
+  }
+
+  const T& at(const Key& key) const {
+    auto it = find(key);
+    if (it == end()) { throw std::out_of_range{"FlatTimeMap::at"}; }
+    return it->second;
+  }
+
+  T& operator[](const Key& key) { return emplace(key, T()).first->second; }
+
+  /**
+   * @brief insert a value if the key is not in the map
+   * @return iterator to the value with this key and true if it was inserted
+   */
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+    // fast path for values appended in time order
+    if (values_.empty() || values_.back().first < key) {
+      values_.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+      return {std::prev(values_.end()), true};
+    }
+    auto it = lower_bound(key);
+    if (!(key < it->first)) { return {it, false}; }
+    it = values_.emplace(it, std::piecewise_construct,
+                         std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+    return {it, true};
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return emplace(value.first, value.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return emplace(value.first, std::move(value.second));
+  }
+
+  iterator erase(const_iterator it) { return values_.erase(it); }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    return values_.erase(first, last);
+  }
+
+  size_type erase(const Key& key) {
+    auto it = find(key);
+    if (it == end()) { return 0; }
+    values_.erase(it);
+    return 1;
+  }
+
+private:
+  struct KeyLess {
+    bool operator()(const value_type& value, const Key& key) const {
+      return value.first < key;
+    }
+    bool operator()(const Key& key, const value_type& value) const {
+      return key < value.first;
+    }
+  };
+
+  container_type values_;
+};
+
+} // namespace bs_common
@@ -14,19 +14,16 @@
 #include <fuse_variables/velocity_angular_3d_stamped.h>
 
 #include <beam_utils/utils.h>
+#include <bs_common/graph_visitor.h>
 #include <bs_common/imu_state.h>
 
 namespace bs_common {
 
-struct ImuBiases {
-  double a_x;
-  double a_y;
-  double a_z;
-  double g_x;
-  double g_y;
-  double g_z;
-};
-
+/**
+ * @brief Gets the imu biases of all stamps in the graph. Use an
+ * ImuBiasCollector with VisitGraph (see bs_common/graph_visitor.h) to get them
+ * in the same traversal as other quantities
+ */
 std::map<int64_t, ImuBiases>
     GetImuBiasesFromGraph(const fuse_core::Graph& graph);
 
@@ -137,21 +134,23 @@ fuse_variables::AccelerationLinear3DStamped::SharedPtr
                           const ros::Time& stamp);
 
 /**
- * @brief Gets all timestamps in the given graph
+ * @brief Gets all timestamps in the given graph. Use GetStampIndex (see
+ * bs_common/graph_snapshot.h) to avoid the copy, which for graph snapshots
+ * doesn't need to scan the graph
  * @param graph to search in
  * @return set of timestamps
  */
 std::set<ros::Time> CurrentTimestamps(const fuse_core::Graph& graph);
 
 /**
- * @brief Gets all landmark id's in the given graph
+ * @brief Gets all landmark id's in the given graph, see LandmarkIdCollector
  * @param graph to search in
  * @return set of landmark ids
  */
 std::set<uint64_t> CurrentLandmarkIDs(const fuse_core::Graph& graph);
 
 /**
- * @brief return graph poses
+ * @brief return graph poses, see PoseCollector
  * @param graph to search in
  * @return map from timestamp to T_World_Baselink
  */
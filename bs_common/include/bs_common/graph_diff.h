@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fuse_core/constraint.h>
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+#include <fuse_core/variable.h>
+#include <ros/time.h>
+
+#include <bs_common/chunk_file.h>
+#include <bs_common/graph_snapshot.h>
+
+namespace bs_common {
+
+/**
+ * @brief Encodes consecutive graph updates as the variables and constraints
+ * added and removed since the previously encoded update, plus the values of
+ * the variables which changed (constraints are immutable in fuse, so they can
+ * only be added or removed). Objects are encoded with the CompactSerializer.
+ * The first update, and the first one after Reset, is a diff against an empty
+ * graph, i.e. a snapshot of the graph.
+ *
+ * Updates can be skipped, each encoded update is a diff against the previous
+ * encoded one. If an encoded update is lost (e.g., it cannot be sent), the
+ * encoder must be reset and the next update decoded as a snapshot. Used by
+ * GraphRecorder and the remote smoother transport, see GraphDiffDecoder to
+ * decode them.
+ */
+class GraphDiffEncoder {
+public:
+  /**
+   * @brief encode the changes since the previous update, and remember this
+   * graph as the previous update
+   * @param graph graph after the update
+   * @param stamp stamp associated with the update
+   * @param data output, the encoded update is appended
+   */
+  void Encode(const fuse_core::Graph& graph, const ros::Time& stamp,
+              ByteWriter& data);
+
+  /**
+   * @brief forget the previous update, the next one is encoded as a snapshot
+   */
+  void Reset();
+
+private:
+  struct VariableState {
+    std::vector<double> data;
+    bool hold;
+  };
+
+  std::unordered_map<fuse_core::UUID, VariableState, fuse_core::uuid::hash>
+      variables_;
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash> constraints_;
+};
+
+/**
+ * @brief Reconstructs the graph from the updates encoded by GraphDiffEncoder.
+ * The variables and constraints are shared between the graphs built after
+ * each update, and a variable whose value changed is copied before it is
+ * modified, so a graph built before is never modified by following updates.
+ */
+class GraphDiffDecoder {
+public:
+  /**
+   * @brief apply an encoded update. Throws a std::runtime_error if it is
+   * invalid or does not apply to the current state
+   * @param data encoded update
+   * @param snapshot true if the update was encoded after a reset of the
+   * encoder, then the previous state is discarded
+   * @param stamp optionally set to the stamp of the update
+   * @param delta optionally filled with the variables added, changed and
+   * removed w.r.t. the previous update, its index is built
+   */
+  void Apply(ByteReader& data, bool snapshot, ros::Time* stamp = nullptr,
+             GraphDelta* delta = nullptr);
+
+  /**
+   * @brief add all variables and constraints of the current state to a graph
+   * @param graph empty graph
+   */
+  void Build(fuse_core::Graph& graph) const;
+
+  /**
+   * @brief build a snapshot of the current state, with a delta and stamp
+   * index. Consumers of a GraphSnapshot receive it as an immutable graph
+   * @param delta delta returned by the last Apply
+   */
+  GraphSnapshot::SharedPtr BuildSnapshot(GraphDelta delta) const;
+
+  void Reset();
+
+private:
+  std::unordered_map<fuse_core::UUID, fuse_core::Variable::SharedPtr,
+                     fuse_core::uuid::hash>
+      variables_;
+  std::unordered_map<fuse_core::UUID, bool, fuse_core::uuid::hash> holds_;
+  std::unordered_map<fuse_core::UUID, fuse_core::Constraint::SharedPtr,
+                     fuse_core::uuid::hash>
+      constraints_;
+};
+
+} // namespace bs_common
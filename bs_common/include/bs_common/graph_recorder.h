@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+#include <ros/time.h>
+
+#include <bs_common/async_writer.h>
+#include <bs_common/chunk_file.h>
+#include <bs_common/graph_diff.h>
+
+namespace bs_common {
+
+/**
+ * @brief version of the layout of the graph recording chunks
+ */
+constexpr uint32_t kGraphRecordingVersion = 1;
+
+enum class GraphRecordingChunkType : uint32_t {
+  SNAPSHOT = 0, // all variables and constraints
+  DIFF          // changes since the previous update
+};
+
+/**
+ * @brief Records graph updates for post-mortem analysis, in a compact binary
+ * format which is cheap enough to be enabled in production. The first update
+ * is written as a snapshot of the graph, and every following update only as
+ * the variables and constraints added and removed since the previous update,
+ * plus the values of the variables which changed, see GraphDiffEncoder.
+ *
+ * Updates are encoded and written on a background thread, the graphs passed
+ * to Record must not be modified afterwards (e.g., the graphs received by
+ * onGraphUpdate).
+ *
+ * The recording is split in segments of snapshot_period updates, each in its
+ * own chunk file graph_<first update>.bin starting with a snapshot. A segment
+ * is only valid once closed, so at most the current segment is lost if the
+ * process dies, and reading an update only needs its own segment. See
+ * GraphRecording to read them back.
+ */
+class GraphRecorder {
+public:
+  struct Params {
+    /** number of updates per segment */
+    int snapshot_period{100};
+
+    /** max number of updates waiting to be written */
+    size_t queue_size{10};
+
+    /** if true, updates are dropped when the queue is full instead of
+     * blocking the caller. The next recorded update then contains all
+     * changes since the last written one */
+    bool drop_when_full{false};
+  };
+
+  /**
+   * @brief constructor
+   * @param directory output directory, which must exist
+   * @param params recorder params
+   */
+  GraphRecorder(const std::string& directory, const Params& params);
+
+  /**
+   * @brief writes all queued updates and closes the current segment
+   */
+  ~GraphRecorder();
+
+  GraphRecorder(const GraphRecorder& other) = delete;
+
+  GraphRecorder& operator=(const GraphRecorder& other) = delete;
+
+  /**
+   * @brief queue a graph update
+   * @param graph graph after the update, must not be modified afterwards
+   * @param update index of the update, must increase between calls
+   * @param stamp stamp associated with the update, e.g. the latest variable
+   * @return false if the update was dropped
+   */
+  bool Record(fuse_core::Graph::ConstSharedPtr graph, uint64_t update,
+              const ros::Time& stamp = ros::Time(0));
+
+  /**
+   * @brief block until all queued updates are written
+   */
+  void Flush();
+
+  size_t NumDropped() const { return writer_->NumDropped(); }
+
+private:
+  /**
+   * @brief encode an update, run on the writer thread
+   */
+  void Write(const fuse_core::Graph& graph, uint64_t update,
+             const ros::Time& stamp);
+
+  bool CloseSegment();
+
+  std::string directory_;
+  Params params_;
+
+  // only accessed by the writer thread
+  ChunkFileWriter segment_;
+  int segment_updates_{0};
+  GraphDiffEncoder encoder_;
+
+  // last so queued updates are written before the state is destroyed
+  std::unique_ptr<AsyncWriter> writer_;
+};
+
+/**
+ * @brief Reads a recording written by GraphRecorder, and reconstructs the
+ * graph at any recorded update
+ */
+class GraphRecording {
+public:
+  /**
+   * @brief open all segments of a recording
+   * @param directory directory the recorder wrote to
+   * @return false if there is no valid segment
+   */
+  bool Open(const std::string& directory);
+
+  /**
+   * @brief get the indices of all recorded updates, in order
+   */
+  std::vector<uint64_t> Updates() const;
+
+  /**
+   * @brief reconstruct the graph at an update, by reading the snapshot of its
+   * segment and applying the following updates
+   * @param update index of the update
+   * @param graph empty graph the variables and constraints are added to
+   * @param stamp optionally set to the stamp of the update
+   * @return false if the update was not recorded. Throws a std::runtime_error
+   * if the recording is invalid
+   */
+  bool Read(uint64_t update, fuse_core::Graph& graph,
+            ros::Time* stamp = nullptr) const;
+
+private:
+  std::vector<std::unique_ptr<ChunkFileReader>> segments_;
+
+  /** segment index of each update */
+  std::map<uint64_t, size_t> updates_;
+};
+
+} // namespace bs_common
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+#include <fuse_graphs/hash_graph.h>
+
+#include <bs_common/stamp_index.h>
+
+namespace bs_common {
+
+/**
+ * @brief Summary of how the variables of a graph changed between two
+ * consecutive graph updates. A variable is considered changed if any of its
+ * values differ from the previous update.
+ */
+struct GraphDelta {
+  std::vector<fuse_core::UUID> added_variables;
+  std::vector<fuse_core::UUID> changed_variables;
+  std::vector<fuse_core::UUID> removed_variables;
+
+  /**
+   * @brief checks if any variables were added, changed or removed
+   */
+  bool Empty() const;
+
+  /**
+   * @brief check if a variable was added or had its value changed
+   * @param uuid variable to check
+   * @return true if the variable changed or is new in this update
+   */
+  bool IsUpdated(const fuse_core::UUID& uuid) const;
+
+  /**
+   * @brief check if a variable was removed (i.e., marginalized)
+   * @param uuid variable to check
+   */
+  bool IsRemoved(const fuse_core::UUID& uuid) const;
+
+  /**
+   * @brief build the lookup sets used by IsUpdated and IsRemoved. This must be
+   * called once all vectors are filled.
+   */
+  void BuildIndex();
+
+  /**
+   * @brief clear all data
+   */
+  void Clear();
+
+private:
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash> updated_set_;
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash> removed_set_;
+};
+
+/**
+ * @brief Immutable graph snapshot published by the optimizer. Variables and
+ * constraints that did not change since the last snapshot are shared (by
+ * pointer) between consecutive snapshots instead of being deep copied. This
+ * must never be modified once published, consumers receive it as a
+ * fuse_core::Graph::ConstSharedPtr. Calling clone() will return a regular deep
+ * copied fuse_graphs::HashGraph which can be freely modified.
+ *
+ * Along with the graph, this stores the GraphDelta w.r.t. the previous
+ * snapshot so that consumers can update their state incrementally, and the
+ * StampIndex of its pose states.
+ */
+class GraphSnapshot : public fuse_graphs::HashGraph {
+public:
+  FUSE_SMART_PTR_DEFINITIONS(GraphSnapshot);
+
+  GraphSnapshot(const fuse_graphs::HashGraphParams& params =
+                    fuse_graphs::HashGraphParams());
+
+  ~GraphSnapshot() override = default;
+
+  const GraphDelta& Delta() const { return delta_; }
+
+  GraphDelta& DeltaMutable() { return delta_; }
+
+  const StampIndex::ConstSharedPtr& Stamps() const { return stamps_; }
+
+  void SetStamps(StampIndex::ConstSharedPtr stamps);
+
+private:
+  GraphDelta delta_;
+  StampIndex::ConstSharedPtr stamps_;
+};
+
+/**
+ * @brief get the graph delta associated with a graph message, if it was
+ * published as a GraphSnapshot
+ * @param graph graph message received from the optimizer
+ * @return pointer to the delta, or nullptr if the graph is not a snapshot
+ */
+const GraphDelta* GetGraphDelta(const fuse_core::Graph& graph);
+
+/**
+ * @brief get the stamp index of a graph message. This is O(1) if it was
+ * published as a GraphSnapshot, otherwise the graph is scanned
+ * @param graph graph message received from the optimizer
+ */
+StampIndex::ConstSharedPtr GetStampIndex(const fuse_core::Graph& graph);
+
+} // namespace bs_common
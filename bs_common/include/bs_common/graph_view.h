@@ -0,0 +1,164 @@
+#pragma once
+
+#include <set>
+#include <unordered_map>
+
+#include <vector>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+
+#include <bs_common/graph_visitor.h>
+
+namespace bs_common {
+
+/**
+ * @brief Read only index over the variables of a graph. All variables are
+ * visited once on construction and stored by device id and stamp (or landmark
+ * id) so that repeated lookups are O(1) and return pointers to the variables
+ * stored in the graph, without generating uuids, copying variables or relying
+ * on exceptions to detect missing variables. This should be built once per
+ * graph update and shared by everything that needs to query that graph.
+ *
+ * Stamped variables of different devices can share a stamp. Like their uuids,
+ * they are looked up by stamp and device id, which defaults to NIL.
+ *
+ * The view keeps a shared pointer to the graph, so returned pointers are valid
+ * for the lifetime of the view.
+ */
+class GraphView {
+public:
+  /**
+   * @brief Default constructor, creates an empty view
+   */
+  GraphView() = default;
+
+  /**
+   * @brief Builds the index over all variables in a graph
+   * @param graph graph to index
+   * @param visitors additional visitors which are filled in the same
+   * traversal of the graph, e.g. an ImuBiasCollector
+   */
+  explicit GraphView(fuse_core::Graph::ConstSharedPtr graph,
+                     const std::vector<GraphVisitor*>& visitors = {});
+
+  /**
+   * @brief Get the graph this view was built from, nullptr if empty
+   */
+  const fuse_core::Graph::ConstSharedPtr& Graph() const { return graph_; }
+
+  /**
+   * @brief Get position at some stamp, nullptr if not in graph
+   */
+  const fuse_variables::Position3DStamped* GetPosition(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get orientation at some stamp, nullptr if not in graph
+   */
+  const fuse_variables::Orientation3DStamped* GetOrientation(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get linear velocity at some stamp, nullptr if not in graph
+   */
+  const fuse_variables::VelocityLinear3DStamped* GetVelocity(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get angular velocity at some stamp, nullptr if not in graph
+   */
+  const fuse_variables::VelocityAngular3DStamped* GetAngularVelocity(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get linear acceleration at some stamp, nullptr if not in graph
+   */
+  const fuse_variables::AccelerationLinear3DStamped* GetLinearAcceleration(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get gyroscope bias at some stamp, nullptr if not in graph
+   */
+  const bs_variables::GyroscopeBias3DStamped* GetGyroscopeBias(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get accelerometer bias at some stamp, nullptr if not in graph
+   */
+  const bs_variables::AccelerationBias3DStamped* GetAccelBias(
+      const ros::Time& stamp,
+      const fuse_core::UUID& device_id = fuse_core::uuid::NIL) const;
+
+  /**
+   * @brief Get a euclidean landmark by id, nullptr if not in graph
+   */
+  const bs_variables::Point3DLandmark* GetLandmark(uint64_t id) const;
+
+  /**
+   * @brief Get an inverse depth landmark by id, nullptr if not in graph
+   */
+  const bs_variables::InverseDepthLandmark*
+      GetInverseDepthLandmark(uint64_t id) const;
+
+  /**
+   * @brief Get all stamps that have a position in the graph, for any device
+   */
+  const std::set<ros::Time>& Timestamps() const { return timestamps_; }
+
+  /**
+   * @brief Get ids of all landmarks (euclidean and inverse depth) in the graph
+   */
+  const std::set<uint64_t>& LandmarkIDs() const { return landmark_ids_; }
+
+private:
+  class Indexer;
+
+  struct StampKey {
+    fuse_core::UUID device_id;
+    uint64_t stamp;
+
+    bool operator==(const StampKey& other) const {
+      return stamp == other.stamp && device_id == other.device_id;
+    }
+  };
+
+  struct StampKeyHash {
+    size_t operator()(const StampKey& key) const;
+  };
+
+  template <typename T>
+  using StampMap = std::unordered_map<StampKey, const T*, StampKeyHash>;
+
+  template <typename Map, typename Key>
+  typename Map::mapped_type Find(const Map& map, const Key& key) const {
+    const auto iter = map.find(key);
+    if (iter == map.end()) { return nullptr; }
+    return iter->second;
+  }
+
+  fuse_core::Graph::ConstSharedPtr graph_;
+
+  StampMap<fuse_variables::Position3DStamped> positions_;
+  StampMap<fuse_variables::Orientation3DStamped> orientations_;
+  StampMap<fuse_variables::VelocityLinear3DStamped> velocities_;
+  StampMap<fuse_variables::VelocityAngular3DStamped> angular_velocities_;
+  StampMap<fuse_variables::AccelerationLinear3DStamped> accelerations_;
+  StampMap<bs_variables::GyroscopeBias3DStamped> gyro_biases_;
+  StampMap<bs_variables::AccelerationBias3DStamped> accel_biases_;
+  std::unordered_map<uint64_t, const bs_variables::Point3DLandmark*>
+      landmarks_;
+  std::unordered_map<uint64_t, const bs_variables::InverseDepthLandmark*>
+      inversedepth_landmarks_;
+
+  std::set<ros::Time> timestamps_;
+  std::set<uint64_t> landmark_ids_;
+};
+
+} // namespace bs_common
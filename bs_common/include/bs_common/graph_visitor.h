@@ -0,0 +1,152 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <fuse_core/graph.h>
+#include <fuse_core/variable.h>
+#include <fuse_variables/acceleration_linear_3d_stamped.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <fuse_variables/velocity_angular_3d_stamped.h>
+#include <fuse_variables/velocity_linear_3d_stamped.h>
+
+#include <bs_variables/accel_bias_3d_stamped.h>
+#include <bs_variables/gyro_bias_3d_stamped.h>
+#include <bs_variables/inverse_depth_landmark.h>
+#include <bs_variables/point_3d_landmark.h>
+
+namespace bs_common {
+
+/**
+ * @brief Variable types known to the graph visitors
+ */
+enum class VariableType {
+  POSITION,
+  ORIENTATION,
+  VELOCITY,
+  ANGULAR_VELOCITY,
+  ACCELERATION,
+  GYRO_BIAS,
+  ACCEL_BIAS,
+  POINT_LANDMARK,
+  INVERSE_DEPTH_LANDMARK,
+  OTHER
+};
+
+/**
+ * @brief Gets the type of a variable by comparing its dynamic type to the
+ * type ids of the known variables, which are computed once. Unlike comparing
+ * variable.type(), this does not build a string per variable, and a variable
+ * of a known type can then be static_cast instead of dynamic_cast
+ */
+VariableType GetVariableType(const fuse_core::Variable& variable);
+
+struct ImuBiases {
+  double a_x;
+  double a_y;
+  double a_z;
+  double g_x;
+  double g_y;
+  double g_z;
+};
+
+/**
+ * @brief Visitor of the variables of a graph. Each hook is called with the
+ * variables of its type, and does nothing by default. Several visitors can be
+ * filled in a single traversal of the graph with VisitGraph, so consumers
+ * which need e.g. poses, biases and landmarks of the same graph update do not
+ * each walk over all variables
+ */
+class GraphVisitor {
+public:
+  virtual ~GraphVisitor() = default;
+
+  virtual void Visit(const fuse_variables::Position3DStamped& v) {}
+  virtual void Visit(const fuse_variables::Orientation3DStamped& v) {}
+  virtual void Visit(const fuse_variables::VelocityLinear3DStamped& v) {}
+  virtual void Visit(const fuse_variables::VelocityAngular3DStamped& v) {}
+  virtual void Visit(const fuse_variables::AccelerationLinear3DStamped& v) {}
+  virtual void Visit(const bs_variables::GyroscopeBias3DStamped& v) {}
+  virtual void Visit(const bs_variables::AccelerationBias3DStamped& v) {}
+  virtual void Visit(const bs_variables::Point3DLandmark& v) {}
+  virtual void Visit(const bs_variables::InverseDepthLandmark& v) {}
+};
+
+/**
+ * @brief Dispatches one variable to the visitors
+ */
+void VisitVariable(const fuse_core::Variable& variable,
+                   const std::vector<GraphVisitor*>& visitors);
+
+/**
+ * @brief Visits all variables of a graph once, passing each to all visitors
+ */
+void VisitGraph(const fuse_core::Graph& graph,
+                const std::vector<GraphVisitor*>& visitors);
+
+/**
+ * @brief Collects the poses of a graph. Stamps with only a position or only
+ * an orientation keep an identity for the other
+ */
+class PoseCollector : public GraphVisitor {
+public:
+  void Visit(const fuse_variables::Position3DStamped& v) override;
+  void Visit(const fuse_variables::Orientation3DStamped& v) override;
+
+  /**
+   * @brief converts the collected variables in one batch
+   * @return map from timestamp to T_World_Baselink
+   */
+  std::map<ros::Time, Eigen::Matrix4d> Poses() const;
+
+private:
+  size_t Index(const ros::Time& stamp);
+
+  std::map<ros::Time, size_t> indices_;
+  std::vector<const fuse_variables::Position3DStamped*> positions_;
+  std::vector<const fuse_variables::Orientation3DStamped*> orientations_;
+};
+
+/**
+ * @brief Collects the gyroscope and accelerometer biases of a graph by stamp
+ */
+class ImuBiasCollector : public GraphVisitor {
+public:
+  void Visit(const bs_variables::GyroscopeBias3DStamped& v) override;
+  void Visit(const bs_variables::AccelerationBias3DStamped& v) override;
+
+  std::map<int64_t, ImuBiases> biases;
+};
+
+/**
+ * @brief Collects the stamps of all positions of a graph
+ */
+class TimestampCollector : public GraphVisitor {
+public:
+  void Visit(const fuse_variables::Position3DStamped& v) override {
+    timestamps.insert(v.stamp());
+  }
+
+  std::set<ros::Time> timestamps;
+};
+
+/**
+ * @brief Collects the ids of all landmarks (euclidean and inverse depth) of a
+ * graph
+ */
+class LandmarkIdCollector : public GraphVisitor {
+public:
+  void Visit(const bs_variables::Point3DLandmark& v) override {
+    landmark_ids.insert(v.id());
+  }
+  void Visit(const bs_variables::InverseDepthLandmark& v) override {
+    landmark_ids.insert(v.id());
+  }
+
+  std::set<uint64_t> landmark_ids;
+};
+
+} // namespace bs_common
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <iterator>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include <ros/time.h>
+#include <sensor_msgs/Imu.h>
+
+#include <bs_common/preintegrator.h>
+
+namespace bs_common {
+
+/**
+ * @brief Compact copy of the fields of an imu message used by the models (no
+ * header strings or covariances)
+ */
+struct ImuSample {
+  /**
+   * @brief Default Constructor
+   */
+  ImuSample() = default;
+
+  /**
+   * @brief Constructor
+   * @param msg sensor data
+   */
+  explicit ImuSample(const sensor_msgs::Imu& msg);
+
+  /**
+   * @brief Converts to the measurement type used by the preintegrator
+   */
+  IMUData ToIMUData() const;
+
+  ros::Time stamp;
+  Eigen::Vector3d w;          // gyro measurement
+  Eigen::Vector3d a;          // accelerometer measurement
+  Eigen::Quaterniond q_WORLD; // orientation estimate, if the imu provides one
+};
+
+/**
+ * @brief Contiguous ring buffer of imu samples sorted by time. Samples normally
+ * arrive in order so adding to the back is O(1) and trimming the front is O(1)
+ * per removed sample, out of order samples are shifted into place. Lookups by
+ * time are binary searches, and range queries return views into the buffer
+ * instead of copies.
+ *
+ * Views and references are invalidated by any change to the buffer.
+ */
+class ImuSampleBuffer {
+public:
+  /**
+   * @brief Random access iterator over consecutive samples
+   */
+  class ConstIterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = ImuSample;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ImuSample*;
+    using reference = const ImuSample&;
+
+    ConstIterator() = default;
+
+    ConstIterator(const ImuSampleBuffer* buffer, size_t index)
+        : buffer_(buffer), index_(index) {}
+
+    reference operator*() const { return (*buffer_)[index_]; }
+    pointer operator->() const { return &(*buffer_)[index_]; }
+    reference operator[](difference_type n) const {
+      return (*buffer_)[index_ + n];
+    }
+
+    ConstIterator& operator++() {
+      index_++;
+      return *this;
+    }
+    ConstIterator operator++(int) {
+      ConstIterator it = *this;
+      index_++;
+      return it;
+    }
+    ConstIterator& operator--() {
+      index_--;
+      return *this;
+    }
+    ConstIterator operator--(int) {
+      ConstIterator it = *this;
+      index_--;
+      return it;
+    }
+    ConstIterator& operator+=(difference_type n) {
+      index_ += n;
+      return *this;
+    }
+    ConstIterator& operator-=(difference_type n) {
+      index_ -= n;
+      return *this;
+    }
+    ConstIterator operator+(difference_type n) const {
+      return ConstIterator(buffer_, index_ + n);
+    }
+    ConstIterator operator-(difference_type n) const {
+      return ConstIterator(buffer_, index_ - n);
+    }
+    difference_type operator-(const ConstIterator& other) const {
+      return static_cast<difference_type>(index_) -
+             static_cast<difference_type>(other.index_);
+    }
+
+    bool operator==(const ConstIterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const ConstIterator& other) const {
+      return index_ != other.index_;
+    }
+    bool operator<(const ConstIterator& other) const {
+      return index_ < other.index_;
+    }
+    bool operator>(const ConstIterator& other) const {
+      return index_ > other.index_;
+    }
+    bool operator<=(const ConstIterator& other) const {
+      return index_ <= other.index_;
+    }
+    bool operator>=(const ConstIterator& other) const {
+      return index_ >= other.index_;
+    }
+
+    /**
+     * @brief Index of the sample in the buffer
+     */
+    size_t Index() const { return index_; }
+
+  private:
+    const ImuSampleBuffer* buffer_{nullptr};
+    size_t index_{0};
+  };
+
+  /**
+   * @brief View of consecutive samples in the buffer
+   */
+  class View {
+  public:
+    View() = default;
+
+    View(ConstIterator begin, ConstIterator end) : begin_(begin), end_(end) {}
+
+    ConstIterator begin() const { return begin_; }
+    ConstIterator end() const { return end_; }
+    size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    const ImuSample& operator[](size_t i) const { return begin_[i]; }
+    const ImuSample& front() const { return *begin_; }
+    const ImuSample& back() const { return *(end_ - 1); }
+
+  private:
+    ConstIterator begin_;
+    ConstIterator end_;
+  };
+
+  /**
+   * @brief Constructor
+   * @param max_duration samples older than this relative to the newest sample
+   * are removed as new samples are added. A duration of 0 keeps all samples
+   * @param max_size max number of samples, the oldest samples are removed
+   * once it is reached so the ring never grows past it. 0 for no limit
+   */
+  explicit ImuSampleBuffer(const ros::Duration& max_duration = ros::Duration(0),
+                           size_t max_size = 0);
+
+  /**
+   * @brief Adds a sample, then removes samples older than the max duration.
+   * Samples with a timestamp that is already in the buffer, or older than all
+   * samples of a full buffer, are ignored
+   * @return false if the sample was ignored
+   */
+  bool Add(const ImuSample& sample);
+
+  /**
+   * @brief Adds the sample of an imu message
+   */
+  bool Add(const sensor_msgs::Imu& msg) { return Add(ImuSample(msg)); }
+
+  /**
+   * @brief Gets all samples with start_time <= stamp <= end_time
+   */
+  View Range(const ros::Time& start_time, const ros::Time& end_time) const;
+
+  /**
+   * @brief Gets all samples with stamp > start_time
+   */
+  View After(const ros::Time& start_time) const;
+
+  /**
+   * @brief Gets all samples
+   */
+  View All() const { return View(begin(), end()); }
+
+  /**
+   * @brief Gets the first sample with stamp >= time, or end() if there is none
+   */
+  ConstIterator LowerBound(const ros::Time& time) const;
+
+  /**
+   * @brief Gets the sample closest in time
+   * @return nullptr if the buffer is empty or the closest sample is more than
+   * max_offset away
+   */
+  const ImuSample* Closest(const ros::Time& time,
+                           const ros::Duration& max_offset) const;
+
+  /**
+   * @brief Removes all samples with stamp < time
+   */
+  void RemoveBefore(const ros::Time& time);
+
+  /**
+   * @brief Removes the sample at the front of the buffer
+   */
+  void PopFront();
+
+  /**
+   * @brief Removes all samples
+   */
+  void Clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  const ImuSample& operator[](size_t i) const {
+    return storage_[(head_ + i) & (storage_.size() - 1)];
+  }
+
+  const ImuSample& Front() const { return (*this)[0]; }
+
+  const ImuSample& Back() const { return (*this)[size_ - 1]; }
+
+  ConstIterator begin() const { return ConstIterator(this, 0); }
+
+  ConstIterator end() const { return ConstIterator(this, size_); }
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+private:
+  ImuSample& At(size_t i) {
+    return storage_[(head_ + i) & (storage_.size() - 1)];
+  }
+
+  void Grow();
+
+  ros::Duration max_duration_;
+  size_t max_size_{0};
+
+  // capacity is always a power of two so indices wrap with a mask
+  std::vector<ImuSample, Eigen::aligned_allocator<ImuSample>> storage_;
+  size_t head_{0};
+  size_t size_{0};
+};
+
+} // namespace bs_common
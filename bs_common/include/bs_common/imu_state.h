@@ -6,6 +6,8 @@
 #include <fuse_variables/position_3d_stamped.h>
 #include <fuse_variables/velocity_linear_3d_stamped.h>
 
+#include <bs_common/compact_imu_state.h>
+#include <bs_common/graph_view.h>
 #include <bs_common/preintegrator.h>
 #include <bs_variables/accel_bias_3d_stamped.h>
 #include <bs_variables/gyro_bias_3d_stamped.h>
@@ -63,6 +65,18 @@ public:
            const Eigen::Vector3d& position, const Eigen::Vector3d& velocity,
            const Eigen::Vector3d& gyrobias, const Eigen::Vector3d& accelbias);
 
+  /**
+   * @brief constructor from a compact state, the preintegrator is empty
+   * @param state compact state with the stamp and values of this imu state
+   */
+  explicit ImuState(const CompactImuState& state);
+
+  /**
+   * @brief get the stamp and values of this ImuState without its variables and
+   * preintegrator
+   */
+  CompactImuState Compact() const;
+
   /**
    * @brief update the velocity, pose, gyro bias and accel bias variables of
    * this ImuState given some graph message
@@ -72,6 +86,13 @@ public:
    */
   bool Update(fuse_core::Graph::ConstSharedPtr graph_msg);
 
+  /**
+   * @brief same as above but looks up the variables in a pre-built graph view
+   * @param graph_view index over the graph from some optimizer
+   * @return true update was successful (i.e., stamp was in the graph view)
+   */
+  bool Update(const GraphView& graph_view);
+
   /**
    * @brief update the velocity, gyro bias and accel bias variables of this
    * ImuState given some graph message
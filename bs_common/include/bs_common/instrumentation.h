@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Summary statistics of a metric, aggregated over all threads
+ */
+struct MetricSummary {
+  std::string name;
+  uint64_t count{0};   // number of recorded durations
+  uint64_t counter{0}; // value of counter (see Metric::Increment)
+  double mean_s{0};
+  double p50_s{0};
+  double p99_s{0};
+  double max_s{0};
+};
+
+/**
+ * @brief Histogram of durations with log spaced buckets (4 per octave,
+ * starting at 1 ns). Each histogram is only written by a single thread, all
+ * values are relaxed atomics so they can be read at any time from other
+ * threads without locking.
+ */
+class LatencyHistogram {
+public:
+  static constexpr int kNumBuckets = 160;
+
+  /**
+   * @brief Records a duration
+   * @param duration_ns duration in nanoseconds
+   */
+  void Record(uint64_t duration_ns);
+
+  /**
+   * @brief Adds the contents of this histogram to a set of buckets
+   */
+  void AddTo(std::array<uint64_t, kNumBuckets>& buckets, uint64_t& count,
+             uint64_t& sum_ns, uint64_t& max_ns) const;
+
+  /**
+   * @brief Gets the bucket for some duration
+   */
+  static int Bucket(uint64_t duration_ns);
+
+  /**
+   * @brief Gets the representative duration (geometric center) of a bucket
+   */
+  static double BucketValueNs(int bucket);
+
+private:
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_ns_{0};
+  std::atomic<uint64_t> max_ns_{0};
+};
+
+/**
+ * @brief Named latency metric with an optional counter. Each thread that
+ * records to this metric gets its own histogram, so recording never blocks,
+ * the registration of a new thread is the only operation that locks.
+ */
+class Metric {
+public:
+  explicit Metric(const std::string& name) : name_(name) {}
+
+  /**
+   * @brief Records a duration
+   */
+  void Record(std::chrono::nanoseconds duration);
+
+  /**
+   * @brief Increments the counter of this metric, this is independent of the
+   * recorded durations
+   */
+  void Increment(uint64_t n = 1) {
+    counter_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Aggregates the histograms of all threads
+   */
+  MetricSummary Summarize() const;
+
+  const std::string& Name() const { return name_; }
+
+private:
+  LatencyHistogram& GetThreadHistogram();
+
+  std::string name_;
+  std::atomic<uint64_t> counter_{0};
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<LatencyHistogram>> histograms_;
+};
+
+/**
+ * @brief Registry of all metrics. This is a singleton so that all sensor
+ * models and the optimizer running in the same process share the same
+ * metrics, which get reported in the optimizer diagnostics.
+ */
+class Instrumentation {
+public:
+  static Instrumentation& GetInstance();
+
+  Instrumentation(const Instrumentation& other) = delete;
+
+  Instrumentation& operator=(const Instrumentation& other) = delete;
+
+  /**
+   * @brief Gets a metric by name, creating it if it does not exist. The
+   * returned reference is valid for the lifetime of the program, so callers
+   * on hot paths should get it once and store it (e.g., in a static)
+   * @param name metric name, e.g. "lidar_odometry/process"
+   */
+  Metric& GetMetric(const std::string& name);
+
+  /**
+   * @brief Summarizes all metrics, sorted by name
+   */
+  std::vector<MetricSummary> Summarize() const;
+
+private:
+  Instrumentation() = default;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Metric>> metrics_;
+};
+
+/**
+ * @brief Records the time from construction to destruction (or Stop) in a
+ * metric
+ */
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Metric& metric)
+      : metric_(&metric), start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() { Stop(); }
+
+  /**
+   * @brief Records the elapsed time, nothing is recorded on destruction after
+   * this is called
+   */
+  void Stop() {
+    if (!metric_) { return; }
+    metric_->Record(std::chrono::steady_clock::now() - start_);
+    metric_ = nullptr;
+  }
+
+private:
+  Metric* metric_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace bs_common
@@ -0,0 +1,415 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <fuse_core/callback_wrapper.h>
+#include <ros/ros.h>
+
+namespace bs_common {
+
+/**
+ * @brief Typed in-process channel of a topic. Publishers and subscribers of
+ * the same topic and type living in the same process (e.g. the fuse plugins
+ * loaded by an optimizer) exchange shared pointers through it, so data is
+ * neither converted to a ROS message nor copied.
+ *
+ * There is one channel per resolved topic name and type, it exists as long
+ * as a publisher or subscriber uses it.
+ */
+template <typename T>
+class IntraProcessChannel {
+public:
+  using Callback = std::function<void(const std::shared_ptr<const T>&)>;
+
+  /** called (with the lock held) when the first publisher is added or the
+   * last one is removed, must not call back into the channel */
+  using PublisherHook = std::function<void(bool has_publisher)>;
+
+  static std::shared_ptr<IntraProcessChannel<T>> Get(const std::string& topic) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<IntraProcessChannel<T>>>
+        channels;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<IntraProcessChannel<T>> channel = channels[topic].lock();
+    if (!channel) {
+      channel = std::shared_ptr<IntraProcessChannel<T>>(
+          new IntraProcessChannel<T>(topic));
+      channels[topic] = channel;
+    }
+    return channel;
+  }
+
+  const std::string& Topic() const { return topic_; }
+
+  void AddPublisher() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (num_publishers_++ == 0) { CallHooks(true); }
+  }
+
+  void RemovePublisher() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_publishers_ == 0) { CallHooks(false); }
+  }
+
+  bool HasPublisher() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_publishers_ > 0;
+  }
+
+  /**
+   * @brief add a subscriber, the hook is called with the current state
+   * before this returns
+   * @return id used to remove the subscriber
+   */
+  uint64_t AddSubscriber(Callback callback, PublisherHook hook) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t id = next_id_++;
+    hook(num_publishers_ > 0);
+    subscribers_.emplace(id, Subscriber{std::move(callback), std::move(hook)});
+    return id;
+  }
+
+  void RemoveSubscriber(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.erase(id);
+  }
+
+  size_t NumSubscribers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return subscribers_.size();
+  }
+
+  /**
+   * @brief call the callback of all subscribers, in the calling thread
+   */
+  void Publish(const std::shared_ptr<const T>& data) const {
+    std::vector<Callback> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      callbacks.reserve(subscribers_.size());
+      for (const auto& [id, subscriber] : subscribers_) {
+        callbacks.push_back(subscriber.callback);
+      }
+    }
+    for (const auto& callback : callbacks) { callback(data); }
+  }
+
+private:
+  struct Subscriber {
+    Callback callback;
+    PublisherHook hook;
+  };
+
+  explicit IntraProcessChannel(const std::string& topic) : topic_(topic) {}
+
+  void CallHooks(bool has_publisher) {
+    for (auto& [id, subscriber] : subscribers_) {
+      subscriber.hook(has_publisher);
+    }
+  }
+
+  const std::string topic_;
+  mutable std::mutex mutex_;
+  int num_publishers_{0};
+  uint64_t next_id_{0};
+  std::map<uint64_t, Subscriber> subscribers_;
+};
+
+/**
+ * @brief Publisher which passes data to the subscribers of the same process
+ * through an IntraProcessChannel, and only converts it to a ROS message if
+ * the topic has ROS subscribers (e.g. other processes, rosbag or rviz).
+ *
+ * @tparam T type passed in-process
+ * @tparam MsgT ROS message type of the topic
+ */
+template <typename T, typename MsgT>
+class IntraProcessPublisher {
+public:
+  using ToMsg = std::function<MsgT(const T&)>;
+
+  IntraProcessPublisher() = default;
+
+  /**
+   * @brief constructor
+   * @param node_handle node handle used to advertise and resolve the topic
+   * @param topic topic name, resolved with the node handle
+   * @param queue_size queue size of the ROS publisher
+   * @param to_msg converts the data to a ROS message
+   */
+  IntraProcessPublisher(ros::NodeHandle node_handle, const std::string& topic,
+                        uint32_t queue_size, ToMsg to_msg)
+      : state_(std::make_shared<State>()) {
+    state_->channel =
+        IntraProcessChannel<T>::Get(node_handle.resolveName(topic));
+    state_->channel->AddPublisher();
+    state_->publisher = node_handle.advertise<MsgT>(topic, queue_size);
+    state_->to_msg = std::move(to_msg);
+  }
+
+  IntraProcessPublisher(const IntraProcessPublisher& other) = delete;
+
+  IntraProcessPublisher& operator=(const IntraProcessPublisher& other) = delete;
+
+  IntraProcessPublisher(IntraProcessPublisher&& other) = default;
+
+  IntraProcessPublisher& operator=(IntraProcessPublisher&& other) = default;
+
+  ~IntraProcessPublisher() = default;
+
+  void Publish(const std::shared_ptr<const T>& data) const {
+    if (!state_) { return; }
+    state_->channel->Publish(data);
+    if (state_->publisher.getNumSubscribers() == 0) { return; }
+
+    // published as a shared pointer so ROS does not copy it either for its
+    // own subscribers in this process
+    state_->publisher.publish(boost::make_shared<MsgT>(state_->to_msg(*data)));
+  }
+
+  /**
+   * @brief number of in-process and ROS subscribers
+   */
+  uint32_t NumSubscribers() const {
+    if (!state_) { return 0; }
+    return state_->channel->NumSubscribers() +
+           state_->publisher.getNumSubscribers();
+  }
+
+  void Shutdown() { state_.reset(); }
+
+private:
+  struct State {
+    ~State() {
+      if (channel) { channel->RemovePublisher(); }
+      publisher.shutdown();
+    }
+
+    std::shared_ptr<IntraProcessChannel<T>> channel;
+    ros::Publisher publisher;
+    ToMsg to_msg;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * @brief Subscriber which receives data from the IntraProcessPublisher of
+ * the same process, and falls back to a ROS subscriber (converting the
+ * messages) while there is no such publisher. The callback is always called
+ * from the callback queue of the node handle, and at most queue_size messages
+ * are kept, dropping the oldest. Like the callbacks of a ROS subscriber, the
+ * callbacks never overlap and are called in the order the messages arrived,
+ * even if the queue is served by several threads.
+ *
+ * A topic is expected to be published either in-process or over ROS: ROS
+ * messages are ignored while an in-process publisher exists so that messages
+ * are not received twice.
+ *
+ * @tparam T type passed in-process
+ * @tparam MsgT ROS message type of the topic
+ */
+template <typename T, typename MsgT>
+class IntraProcessSubscriber {
+public:
+  using Callback = std::function<void(const std::shared_ptr<const T>&)>;
+  using FromMsg = std::function<std::shared_ptr<const T>(const MsgT&)>;
+
+  IntraProcessSubscriber() = default;
+
+  /**
+   * @brief constructor
+   * @param node_handle node handle used to subscribe and resolve the topic,
+   * its callback queue is used for all callbacks
+   * @param topic topic name, resolved with the node handle
+   * @param queue_size max number of queued messages
+   * @param callback called for each message
+   * @param from_msg converts a ROS message to the in-process type
+   * @param transport_hints transport hints of the ROS subscriber
+   */
+  IntraProcessSubscriber(
+      ros::NodeHandle node_handle, const std::string& topic,
+      uint32_t queue_size, Callback callback, FromMsg from_msg,
+      const ros::TransportHints& transport_hints = ros::TransportHints())
+      : state_(std::make_shared<State>()) {
+    state_->weak_self = state_;
+    state_->node_handle = node_handle;
+    state_->topic = node_handle.resolveName(topic);
+    state_->queue_size = std::max<uint32_t>(queue_size, 1);
+    state_->callback = std::move(callback);
+    state_->from_msg = std::move(from_msg);
+    state_->transport_hints = transport_hints;
+    state_->channel = IntraProcessChannel<T>::Get(state_->topic);
+
+    std::weak_ptr<State> weak_state = state_;
+    state_->id = state_->channel->AddSubscriber(
+        [weak_state](const std::shared_ptr<const T>& data) {
+          if (auto state = weak_state.lock()) { state->Push(data); }
+        },
+        [weak_state](bool has_publisher) {
+          auto state = weak_state.lock();
+          if (!state) { return; }
+          state->has_publisher = has_publisher;
+          // the ROS subscriber is changed from the callback queue, but with a
+          // multi-threaded queue one of its callbacks may still run on another
+          // thread: these hold callback_mutex and skip the message once there
+          // is a publisher
+          state->AddCallback([weak_state]() {
+            if (auto state = weak_state.lock()) {
+              state->UpdateRosSubscriber();
+            }
+          });
+        });
+  }
+
+  IntraProcessSubscriber(const IntraProcessSubscriber& other) = delete;
+
+  IntraProcessSubscriber&
+      operator=(const IntraProcessSubscriber& other) = delete;
+
+  IntraProcessSubscriber(IntraProcessSubscriber&& other) = default;
+
+  IntraProcessSubscriber& operator=(IntraProcessSubscriber&& other) {
+    Shutdown();
+    state_ = std::move(other.state_);
+    return *this;
+  }
+
+  ~IntraProcessSubscriber() { Shutdown(); }
+
+  /**
+   * @brief true if the data is received from a publisher in this process
+   */
+  bool IntraProcess() const { return state_ && state_->has_publisher; }
+
+  void Shutdown() {
+    if (!state_) { return; }
+    state_->channel->RemoveSubscriber(state_->id);
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->shutdown = true;
+      state_->pending.clear();
+      state_->subscriber.shutdown();
+    }
+    state_->node_handle.getCallbackQueue()->removeByID(
+        reinterpret_cast<uint64_t>(state_.get()));
+    state_.reset();
+  }
+
+private:
+  struct State {
+    void AddCallback(std::function<void()> function) {
+      node_handle.getCallbackQueue()->addCallback(
+          boost::make_shared<fuse_core::CallbackWrapper<void>>(
+              std::move(function)),
+          reinterpret_cast<uint64_t>(this));
+    }
+
+    void Push(const std::shared_ptr<const T>& data) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (shutdown) { return; }
+        pending.push_back(data);
+        if (pending.size() > queue_size) { pending.pop_front(); }
+        // the queued drain takes this message too
+        if (draining) { return; }
+        draining = true;
+      }
+      AddDrainCallback();
+    }
+
+    /**
+     * @brief queue a callback for the oldest pending message. Only one is
+     * queued or running at a time, it queues the next one once done, so the
+     * messages are delivered in order and one at a time
+     */
+    void AddDrainCallback() {
+      std::weak_ptr<State> weak_state = weak_self;
+      AddCallback([weak_state]() {
+        auto state = weak_state.lock();
+        if (!state) { return; }
+        std::shared_ptr<const T> data;
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (state->shutdown || state->pending.empty()) {
+            state->draining = false;
+            return;
+          }
+          data = std::move(state->pending.front());
+          state->pending.pop_front();
+        }
+        {
+          std::lock_guard<std::mutex> lock(state->callback_mutex);
+          state->callback(data);
+        }
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (state->shutdown || state->pending.empty()) {
+            state->draining = false;
+            return;
+          }
+        }
+        state->AddDrainCallback();
+      });
+    }
+
+    void UpdateRosSubscriber() {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (shutdown) { return; }
+      if (has_publisher && subscriber) {
+        ROS_DEBUG("Receiving %s in-process", topic.c_str());
+        subscriber.shutdown();
+      } else if (!has_publisher && !subscriber) {
+        ROS_DEBUG("Receiving %s over ROS", topic.c_str());
+        std::weak_ptr<State> weak_state = weak_self;
+        boost::function<void(const typename MsgT::ConstPtr&)> ros_callback =
+            [weak_state](const typename MsgT::ConstPtr& msg) {
+              auto state = weak_state.lock();
+              if (!state) { return; }
+              std::lock_guard<std::mutex> lock(state->callback_mutex);
+              if (state->has_publisher) { return; }
+              state->callback(state->from_msg(*msg));
+            };
+        subscriber = node_handle.subscribe<MsgT>(topic, queue_size,
+                                                 ros_callback,
+                                                 ros::VoidConstPtr(),
+                                                 transport_hints);
+      }
+    }
+
+    ros::NodeHandle node_handle;
+    std::string topic;
+    uint32_t queue_size{1};
+    Callback callback;
+    FromMsg from_msg;
+    ros::TransportHints transport_hints;
+    std::shared_ptr<IntraProcessChannel<T>> channel;
+    uint64_t id{0};
+    std::weak_ptr<State> weak_self;
+    std::atomic<bool> has_publisher{false};
+
+    std::mutex mutex;
+    std::deque<std::shared_ptr<const T>> pending;
+    ros::Subscriber subscriber;
+    bool shutdown{false};
+    // set while a drain callback is queued or running
+    bool draining{false};
+
+    // held while the callback runs
+    std::mutex callback_mutex;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+} // namespace bs_common
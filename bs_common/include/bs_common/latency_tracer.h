@@ -0,0 +1,135 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ros/time.h>
+
+namespace bs_common {
+
+/**
+ * @brief One processing stage of a sensor measurement. Measurements are
+ * identified by their sensor stamp, which is carried through all messages
+ * (header stamps) and transactions (transaction stamps) from the driver to the
+ * published pose, so no other trace context needs to be propagated.
+ */
+struct TraceEvent {
+  std::string stage;
+  ros::Time sensor_stamp;
+  ros::WallTime receive; // when the data was received by this stage
+  ros::WallTime start;   // when processing started
+  ros::WallTime end;     // when processing (and any publishing) ended
+  double age_s{0};       // ros time at the end minus the sensor stamp
+};
+
+/**
+ * @brief Records the processing stages of each measurement through the
+ * pipeline, e.g., LidarScanDeskewer -> LidarOdometry -> FixedLagSmoother ->
+ * Odometry3DPublisher. This is a singleton so that all sensor models, the
+ * optimizer and the publishers running in the same process share the same
+ * trace.
+ *
+ * The age of the data at the end of each stage is always recorded in the
+ * "latency/<stage>" instrumentation metric, which is reported in the
+ * optimizer diagnostics. Events are only stored when enabled, and can be
+ * written as a Chrome trace (chrome://tracing or https://ui.perfetto.dev).
+ */
+class LatencyTracer {
+public:
+  static LatencyTracer& GetInstance();
+
+  LatencyTracer(const LatencyTracer& other) = delete;
+
+  LatencyTracer& operator=(const LatencyTracer& other) = delete;
+
+  /**
+   * @brief Enable storing events
+   * @param max_events max number of events kept, the oldest events are
+   * dropped first
+   */
+  void Enable(size_t max_events = 100000);
+
+  bool Enabled() const;
+
+  /**
+   * @brief Records a stage of processing a measurement
+   */
+  void Record(const std::string& stage, const ros::Time& sensor_stamp,
+              const ros::WallTime& receive, const ros::WallTime& start,
+              const ros::WallTime& end);
+
+  /**
+   * @brief Gets all stored events, in the order they were recorded
+   */
+  std::vector<TraceEvent> Events() const;
+
+  /**
+   * @brief Removes all stored events
+   */
+  void Clear();
+
+  /**
+   * @brief Writes all stored events as a Chrome trace json file. Each stage is
+   * shown as a separate thread, with the queueing time (receive to start) and
+   * the age of the data as arguments of the events
+   * @return false if the file could not be written
+   */
+  bool WriteChromeTrace(const std::string& path) const;
+
+private:
+  LatencyTracer() = default;
+
+  mutable std::mutex mutex_;
+  bool enabled_{false};
+  size_t max_events_{0};
+  std::deque<TraceEvent> events_;
+};
+
+/**
+ * @brief Records a stage from construction (process start) to destruction (or
+ * Stop) in the latency tracer
+ */
+class ScopedTrace {
+public:
+  /**
+   * @param stage name of the stage, e.g. "lidar_odometry"
+   * @param sensor_stamp stamp of the measurement being processed
+   * @param receive time the measurement was received by this stage, this is
+   * the start time if it is processed immediately
+   */
+  ScopedTrace(const std::string& stage, const ros::Time& sensor_stamp,
+              const ros::WallTime& receive = ros::WallTime())
+      : stage_(stage),
+        sensor_stamp_(sensor_stamp),
+        start_(ros::WallTime::now()),
+        receive_(receive.isZero() ? start_ : receive) {}
+
+  ~ScopedTrace() { Stop(); }
+
+  /**
+   * @brief Records the stage, nothing is recorded on destruction after this is
+   * called
+   */
+  void Stop() {
+    if (stopped_) { return; }
+    stopped_ = true;
+    LatencyTracer::GetInstance().Record(stage_, sensor_stamp_, receive_, start_,
+                                        ros::WallTime::now());
+  }
+
+  /**
+   * @brief Do not record this stage, e.g. if the measurement was dropped
+   */
+  void Cancel() { stopped_ = true; }
+
+private:
+  std::string stage_;
+  ros::Time sensor_stamp_;
+  ros::WallTime start_;
+  ros::WallTime receive_;
+  bool stopped_{false};
+};
+
+} // namespace bs_common
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Memory footprint of one subsystem
+ */
+struct MemorySummary {
+  std::string name;
+  uint64_t elements{0};     // number of stored points (or other elements)
+  uint64_t bytes{0};        // approximate heap memory used by the elements
+  uint64_t budget_bytes{0}; // 0 if there is no budget
+};
+
+/**
+ * @brief Memory footprint of a single subsystem (e.g. the scans of a
+ * registration map), updated by its owner whenever its containers change. An
+ * optional budget can be set, owners check OverBudget after updating and
+ * prune their oldest data (using their existing pruning) until they are
+ * within budget. All values are relaxed atomics so they can be read and set
+ * from any thread.
+ */
+class MemoryAccount {
+public:
+  explicit MemoryAccount(const std::string& name) : name_(name) {}
+
+  /**
+   * @brief Sets the current footprint
+   * @param elements number of stored points, or other elements for
+   * containers that do not store points (e.g., keyframes or imu messages)
+   * @param bytes approximate heap memory used by the elements
+   */
+  void Update(uint64_t elements, uint64_t bytes) {
+    elements_.store(elements, std::memory_order_relaxed);
+    bytes_.store(bytes, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Sets the budget in bytes, 0 disables the budget
+   */
+  void SetBudget(uint64_t budget_bytes) {
+    budget_bytes_.store(budget_bytes, std::memory_order_relaxed);
+  }
+
+  uint64_t Budget() const {
+    return budget_bytes_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t Bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Checks if the footprint exceeds the budget, always false if there
+   * is no budget
+   */
+  bool OverBudget() const {
+    const uint64_t budget = Budget();
+    return budget > 0 && Bytes() > budget;
+  }
+
+  MemorySummary Summarize() const;
+
+  const std::string& Name() const { return name_; }
+
+private:
+  std::string name_;
+  std::atomic<uint64_t> elements_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> budget_bytes_{0};
+};
+
+/**
+ * @brief Registry of the memory footprints of all subsystems. This is a
+ * singleton so that all sensor models and the optimizer running in the same
+ * process share the same accounts, which get reported in the optimizer
+ * diagnostics and whose budgets are set from the optimizer params.
+ */
+class MemoryAccounting {
+public:
+  static MemoryAccounting& GetInstance();
+
+  MemoryAccounting(const MemoryAccounting& other) = delete;
+
+  MemoryAccounting& operator=(const MemoryAccounting& other) = delete;
+
+  /**
+   * @brief Gets an account by name, creating it if it does not exist. The
+   * returned reference is valid for the lifetime of the program. Budgets can
+   * be set before the owner of the account gets it.
+   * @param name account name, e.g. "lidar_odometry/active_clouds"
+   */
+  MemoryAccount& GetAccount(const std::string& name);
+
+  /**
+   * @brief Summarizes all accounts, sorted by name
+   */
+  std::vector<MemorySummary> Summarize() const;
+
+  /**
+   * @brief Total bytes of all accounts
+   */
+  uint64_t TotalBytes() const;
+
+private:
+  MemoryAccounting() = default;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<MemoryAccount>> accounts_;
+};
+
+} // namespace bs_common
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <pcl/point_cloud.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+
+namespace bs_common {
+
+/**
+ * @brief Packs the xyz fields of a pointcloud into an unorganized PointCloud2
+ * with three float32 fields. This is used in place of geometry_msgs/Vector3
+ * arrays when sending clouds between models since it is half the size and can
+ * be filled and read without per point message allocations.
+ * @param cloud input cloud
+ * @param msg output packed cloud
+ */
+template <typename PointT>
+void PCLToPackedXYZMsg(const pcl::PointCloud<PointT>& cloud,
+                       sensor_msgs::PointCloud2& msg) {
+  msg.height = 1;
+  msg.width = cloud.size();
+  msg.is_dense = false;
+  sensor_msgs::PointCloud2Modifier modifier(msg);
+  modifier.setPointCloud2Fields(3, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                "y", 1, sensor_msgs::PointField::FLOAT32, "z",
+                                1, sensor_msgs::PointField::FLOAT32);
+  modifier.resize(cloud.size());
+
+  sensor_msgs::PointCloud2Iterator<float> iter_x(msg, "x");
+  sensor_msgs::PointCloud2Iterator<float> iter_y(msg, "y");
+  sensor_msgs::PointCloud2Iterator<float> iter_z(msg, "z");
+  for (const auto& p : cloud) {
+    *iter_x = p.x;
+    *iter_y = p.y;
+    *iter_z = p.z;
+    ++iter_x;
+    ++iter_y;
+    ++iter_z;
+  }
+}
+
+/**
+ * @brief Unpacks a cloud packed with PCLToPackedXYZMsg. Only the xyz fields of
+ * the output points are set
+ * @param msg input packed cloud
+ * @param cloud output cloud
+ */
+template <typename PointT>
+void PackedXYZMsgToPCL(const sensor_msgs::PointCloud2& msg,
+                       pcl::PointCloud<PointT>& cloud) {
+  const size_t size = msg.width * msg.height;
+  cloud.clear();
+  if (size == 0) { return; }
+  cloud.resize(size);
+
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(msg, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y(msg, "y");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(msg, "z");
+  for (auto& p : cloud) {
+    p.x = *iter_x;
+    p.y = *iter_y;
+    p.z = *iter_z;
+    ++iter_x;
+    ++iter_y;
+    ++iter_z;
+  }
+}
+
+} // namespace bs_common
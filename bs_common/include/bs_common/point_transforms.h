@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+
+namespace bs_common {
+
+/**
+ * @brief Float32 point math for clouds whose poses are kept in double.
+ *
+ * Points are stored as floats relative to a local origin (a scan, submap or
+ * map frame) close to them, and only the poses of these origins are kept in
+ * double. Transforms between origins are composed in double and cast to float
+ * once, then applied to the points as a single 4x4 float product per point,
+ * which Eigen vectorizes over the four float lanes of pcl's aligned xyz
+ * storage. Unlike pcl::transformPointCloud with a double matrix, this does not
+ * convert each point to double and back.
+ *
+ * Points should never be expressed in a frame far from them: moving a cloud
+ * from one origin to another is done with RebaseCloud, which goes through the
+ * relative transform of the two origins instead of through world coordinates,
+ * where a float only resolves centimeters at a few hundred kilometers.
+ */
+
+/**
+ * @brief Composes T_Target_Source = T_World_Target^-1 * T_World_Source in
+ * double and casts the result to float. The large world translations cancel
+ * in double, so the float result only holds the small relative motion
+ * @param T_World_Target pose of the frame the points are moved to
+ * @param T_World_Source pose of the frame the points are in
+ */
+inline Eigen::Matrix4f
+    RelativeTransformFloat(const Eigen::Matrix4d& T_World_Target,
+                           const Eigen::Matrix4d& T_World_Source) {
+  Eigen::Matrix4d T_Target_World = Eigen::Matrix4d::Identity();
+  const Eigen::Matrix3d R_Target_World =
+      T_World_Target.block<3, 3>(0, 0).transpose();
+  T_Target_World.block<3, 3>(0, 0) = R_Target_World;
+  T_Target_World.block<3, 1>(0, 3) =
+      -R_Target_World * T_World_Target.block<3, 1>(0, 3);
+  return (T_Target_World * T_World_Source).cast<float>();
+}
+
+/**
+ * @brief Writes the points of the input transformed by T_Out_In to the output,
+ * starting at an offset. All other point fields are copied. The output must
+ * already have room for the input points
+ */
+template <typename PointT>
+void TransformPointsInto(const pcl::PointCloud<PointT>& input,
+                         const Eigen::Matrix4f& T_Out_In,
+                         pcl::PointCloud<PointT>& output, size_t offset = 0) {
+  const bool in_place = &input == &output && offset == 0;
+  for (size_t i = 0; i < input.size(); i++) {
+    PointT& p = output[offset + i];
+    if (!in_place) { p = input[i]; }
+    Eigen::Vector4f P_In = p.getVector4fMap();
+    P_In[3] = 1;
+    p.getVector4fMap() = T_Out_In * P_In;
+  }
+}
+
+/**
+ * @brief Transforms a cloud, the output may be the input. The transform is
+ * cast to float once
+ * @param input cloud in frame In
+ * @param output cloud in frame Out
+ * @param T_Out_In transform from the input to the output frame
+ */
+template <typename PointT>
+void TransformCloud(const pcl::PointCloud<PointT>& input,
+                    pcl::PointCloud<PointT>& output,
+                    const Eigen::Matrix4d& T_Out_In) {
+  if (&input != &output) {
+    output.resize(input.size());
+    output.header = input.header;
+    output.is_dense = input.is_dense;
+    output.sensor_origin_ = input.sensor_origin_;
+    output.sensor_orientation_ = input.sensor_orientation_;
+  }
+  TransformPointsInto(input, T_Out_In.cast<float>(), output);
+  output.width = input.width;
+  output.height = input.height;
+}
+
+/**
+ * @brief Appends the points of a cloud transformed by T_Out_In to the output,
+ * without creating a temporary transformed cloud. The same inputs always give
+ * the same points
+ */
+template <typename PointT>
+void AppendTransformedCloud(const pcl::PointCloud<PointT>& input,
+                            const Eigen::Matrix4d& T_Out_In,
+                            pcl::PointCloud<PointT>& output) {
+  const size_t offset = output.size();
+  output.resize(offset + input.size());
+  TransformPointsInto(input, T_Out_In.cast<float>(), output, offset);
+}
+
+/**
+ * @brief Moves a cloud from one local origin to another in place, using the
+ * relative transform of the two origins composed in double
+ * @param cloud points relative to the old origin, relative to the new origin
+ * on return
+ * @param T_World_OriginOld pose of the frame the points are in
+ * @param T_World_OriginNew pose of the frame to move the points to
+ */
+template <typename PointT>
+void RebaseCloud(pcl::PointCloud<PointT>& cloud,
+                 const Eigen::Matrix4d& T_World_OriginOld,
+                 const Eigen::Matrix4d& T_World_OriginNew) {
+  TransformPointsInto(
+      cloud, RelativeTransformFloat(T_World_OriginNew, T_World_OriginOld),
+      cloud);
+}
+
+} // namespace bs_common
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <typeinfo>
+
+#include <boost/core/demangle.hpp>
+
+#include <bs_common/instrumentation.h>
+
+namespace bs_common {
+
+/**
+ * @brief Thread safe free list of fixed size blocks. Released blocks are kept
+ * and handed out again instead of going back to the heap, which suits objects
+ * that are created and destroyed at a steady rate, e.g. the constraints and
+ * variables each sensor model creates per measurement and the optimizer
+ * releases on marginalization. Unlike the MonotonicArena, blocks are reused
+ * one by one so objects can have unrelated lifetimes.
+ *
+ * Blocks are allocated and released from any thread. The number of blocks
+ * kept is bounded, blocks released past that go back to the heap.
+ *
+ * Each pool records the following counters in the instrumentation:
+ * "pool/<name>/allocated" blocks taken from the heap,
+ * "pool/<name>/reused" blocks taken from the free list and
+ * "pool/<name>/released" blocks released (to the free list or the heap).
+ */
+class FreeListPool {
+public:
+  static constexpr size_t kDefaultMaxFreeBlocks = 4096;
+
+  /**
+   * @brief constructor
+   * @param name name of the pool in the instrumentation metrics
+   * @param block_size number of bytes per block
+   * @param alignment alignment of each block
+   * @param max_free_blocks maximum number of released blocks to keep
+   */
+  FreeListPool(const std::string& name, size_t block_size, size_t alignment,
+               size_t max_free_blocks = kDefaultMaxFreeBlocks);
+
+  ~FreeListPool();
+
+  FreeListPool(const FreeListPool& other) = delete;
+
+  FreeListPool& operator=(const FreeListPool& other) = delete;
+
+  void* Allocate();
+
+  void Deallocate(void* ptr);
+
+  size_t NumFreeBlocks() const;
+
+  size_t BlockSize() const { return block_size_; }
+
+  /**
+   * @brief get the pool of blocks of some type, shared by all libraries of
+   * the process. The pool is created on first use and never destroyed, since
+   * pooled objects may be released during static destruction (e.g., by a
+   * graph held in a static)
+   * @param name name of the pool, only used by the first call
+   */
+  template <typename Block>
+  static FreeListPool& Get(const std::string& name) {
+    static FreeListPool* pool =
+        new FreeListPool(name, sizeof(Block), alignof(Block));
+    return *pool;
+  }
+
+private:
+  struct Node {
+    Node* next;
+  };
+
+  void* NewBlock() const;
+
+  void DeleteBlock(void* ptr) const;
+
+  size_t block_size_;
+  size_t alignment_;
+  size_t max_free_blocks_;
+
+  mutable std::mutex mutex_;
+  Node* free_{nullptr};
+  size_t num_free_{0};
+
+  Metric& allocated_metric_;
+  Metric& reused_metric_;
+  Metric& released_metric_;
+};
+
+/**
+ * @brief Standard allocator over the FreeListPool of its value type. Used with
+ * std::allocate_shared, the allocator is rebound to the type of the shared
+ * control block, so each object and its reference counts take one pooled
+ * block. Arrays are allocated on the heap.
+ */
+template <typename T>
+class PoolAllocator {
+public:
+  using value_type = T;
+
+  /**
+   * @brief constructor
+   * @param name name of the pool in the instrumentation metrics. Must outlive
+   * the allocator and its copies
+   */
+  explicit PoolAllocator(const char* name) : name_(name) {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : name_(other.Name()) {}
+
+  T* allocate(size_t n) {
+    if (n != 1) {
+      return static_cast<T*>(
+          ::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+    return static_cast<T*>(FreeListPool::Get<T>(name_).Allocate());
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    if (n != 1) {
+      ::operator delete(ptr, std::align_val_t(alignof(T)));
+      return;
+    }
+    FreeListPool::Get<T>(name_).Deallocate(ptr);
+  }
+
+  const char* Name() const { return name_; }
+
+  // all allocators of a type share the same pool
+  template <typename U>
+  bool operator==(const PoolAllocator<U>& other) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>& other) const {
+    return false;
+  }
+
+private:
+  const char* name_;
+};
+
+/**
+ * @brief make a shared object in the pool of its type if use_pool is true,
+ * otherwise this is the same as std::make_shared. The pool is named after the
+ * type, e.g. "pool/fuse_variables::Position3DStamped/reused"
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> MakePooled(bool use_pool, Args&&... args) {
+  if (!use_pool) { return std::make_shared<T>(std::forward<Args>(args)...); }
+  static const std::string name = boost::core::demangle(typeid(T).name());
+  return std::allocate_shared<T>(PoolAllocator<T>(name.c_str()),
+                                 std::forward<Args>(args)...);
+}
+
+} // namespace bs_common
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_utils/math.h>
+
+namespace bs_common {
+
+/**
+ * @brief Batch of poses stored as contiguous arrays of quaternions and
+ * translations. Each coefficient is a row-major row holding that coefficient
+ * for all poses (e.g. all x of the quaternions), so the batch operations below
+ * are array expressions over whole rows which Eigen vectorizes across poses,
+ * instead of building and multiplying one 4x4 matrix per pose.
+ */
+struct PoseArray {
+  using QuaternionRows =
+      Eigen::Matrix<double, 4, Eigen::Dynamic, Eigen::RowMajor>;
+  using PositionRows =
+      Eigen::Matrix<double, 3, Eigen::Dynamic, Eigen::RowMajor>;
+
+  /**
+   * @brief Resizes the batch and sets all poses to identities
+   */
+  void Resize(size_t size);
+
+  size_t Size() const { return static_cast<size_t>(p.cols()); }
+
+  /**
+   * @brief Sets a pose from a transformation matrix
+   */
+  void Set(size_t i, const Eigen::Matrix4d& T);
+
+  /**
+   * @brief Sets a pose from a quaternion and translation. The quaternion is
+   * normalized
+   */
+  void Set(size_t i, const Eigen::Quaterniond& orientation,
+           const Eigen::Vector3d& position);
+
+  /**
+   * @brief Gets a pose as a transformation matrix
+   */
+  Eigen::Matrix4d T(size_t i) const;
+
+  QuaternionRows q; // x, y, z, w, normalized
+  PositionRows p;
+};
+
+/**
+ * @brief Composes two batches pose by pose: T_A_C[i] = T_A_B[i] * T_B_C[i]
+ */
+void ComposePoses(const PoseArray& T_A_B, const PoseArray& T_B_C,
+                  PoseArray& T_A_C);
+
+/**
+ * @brief Composes one transform with all poses of a batch:
+ * T_A_C[i] = T_A_B * T_B_C[i]
+ */
+void ComposePoses(const Eigen::Matrix4d& T_A_B, const PoseArray& T_B_C,
+                  PoseArray& T_A_C);
+
+/**
+ * @brief Inverts all poses of a batch: T_B_A[i] = T_A_B[i]^-1
+ */
+void InvertPoses(const PoseArray& T_A_B, PoseArray& T_B_A);
+
+/**
+ * @brief Transforms all points of a batch in place: P_A = T_A_B * P_B
+ */
+void TransformPoints(const Eigen::Matrix4d& T_A_B, Eigen::Matrix3Xd& points);
+
+/**
+ * @brief Converts all poses of a batch to transformation matrices
+ */
+void PoseArrayToEigenTransforms(
+    const PoseArray& poses,
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts);
+
+} // namespace bs_common
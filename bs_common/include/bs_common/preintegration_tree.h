@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include <ros/time.h>
+
+#include <bs_common/preintegrator.h>
+
+namespace bs_common {
+
+/**
+ * @brief Segment tree of preintegrated imu measurements. Every interval
+ * between consecutive measurements is preintegrated once, and the tree stores
+ * the composition of each power of two sized run of intervals, so the
+ * preintegrated measurement between any two times is composed from O(log n)
+ * cached segments instead of re-integrating every measurement in between.
+ *
+ * All segments are integrated with the same biases. Queries with biases close
+ * to these are corrected to first order using the bias jacobians, otherwise
+ * the tree is re-integrated with the new biases.
+ */
+class PreintegrationTree {
+public:
+  /**
+   * @brief Default Constructor
+   */
+  PreintegrationTree() = default;
+
+  /**
+   * @brief Adds a measurement. Measurements added after the newest one are
+   * O(log n), out of order measurements cause the tree to be rebuilt on the
+   * next query
+   * @param imu_data measurement to add
+   * @return false if a measurement with the same timestamp already exists
+   */
+  bool AddData(const IMUData& imu_data);
+
+  /**
+   * @brief Removes all measurements with stamp < t
+   */
+  void RemoveBefore(const ros::Time& t);
+
+  /**
+   * @brief Removes all measurements
+   */
+  void Clear();
+
+  /**
+   * @brief Preintegrates the measurements between two times. Each measurement
+   * is held until the next one, and the newest measurement is held until t2
+   * if t2 is after it. The covariance, bias jacobians and square root
+   * information of the result are computed
+   * @param t1 start time, must not be before the oldest measurement
+   * @param t2 end time, must be after t1
+   * @param bg gyroscope bias estimate
+   * @param ba accelerometer bias estimate
+   * @param pre_integrator preintegrator to store the result in (delta and
+   * jacobian)
+   * @return false if the times are not covered by the measurements
+   */
+  bool Integrate(const ros::Time& t1, const ros::Time& t2,
+                 const Eigen::Vector3d& bg, const Eigen::Vector3d& ba,
+                 PreIntegrator& pre_integrator);
+
+  /**
+   * @brief Number of measurements stored
+   */
+  size_t Size() const { return data_.size() - first_; }
+
+  bool Empty() const { return Size() == 0; }
+
+  // continuous noise covariance
+  Eigen::Matrix3d cov_w{Eigen::Matrix3d::Zero()};
+  Eigen::Matrix3d cov_a{Eigen::Matrix3d::Zero()};
+  // continuous random walk noise covariance
+  Eigen::Matrix3d cov_bg{Eigen::Matrix3d::Zero()};
+  Eigen::Matrix3d cov_ba{Eigen::Matrix3d::Zero()};
+
+  // max change in bias since the tree was integrated for which a first order
+  // correction is used instead of re-integrating
+  double bias_correction_tol_bg{1e-2};
+  double bias_correction_tol_ba{1e-1};
+
+private:
+  /**
+   * @brief Preintegrated measurement over some interval. Only the pose and
+   * velocity block of the covariance is stored, the bias block only depends on
+   * the length of the interval
+   */
+  struct Segment {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    ros::Duration t{0};
+    Eigen::Quaterniond q{Eigen::Quaterniond::Identity()};
+    Eigen::Vector3d p{Eigen::Vector3d::Zero()};
+    Eigen::Vector3d v{Eigen::Vector3d::Zero()};
+    // ordered in q, p, v
+    Eigen::Matrix<double, 9, 9> cov{Eigen::Matrix<double, 9, 9>::Zero()};
+    Jacobian jacobian{Eigen::Matrix3d::Zero(), Eigen::Matrix3d::Zero(),
+                      Eigen::Matrix3d::Zero(), Eigen::Matrix3d::Zero(),
+                      Eigen::Matrix3d::Zero()};
+  };
+
+  /**
+   * @brief Composes segment a followed by segment b
+   */
+  static Segment Compose(const Segment& a, const Segment& b);
+
+  /**
+   * @brief Preintegrates a single measurement held for dt, with the biases of
+   * the tree
+   */
+  Segment Step(const IMUData& imu_data, const ros::Duration& dt);
+
+  /**
+   * @brief Composes the intervals starting at measurements [first, last)
+   */
+  Segment Query(size_t first, size_t last) const;
+
+  /**
+   * @brief Integrates the interval starting at measurement i and updates the
+   * segments containing it
+   */
+  void UpdateInterval(size_t i);
+
+  /**
+   * @brief Drops removed measurements and moves the integrated intervals into
+   * a tree with the given capacity, which must be larger than the number of
+   * intervals
+   */
+  void Relayout(size_t capacity);
+
+  /**
+   * @brief Re-integrates all intervals with the current biases
+   */
+  void Reintegrate();
+
+  // measurements sorted by time, the ones before first_ have been removed
+  std::vector<IMUData> data_;
+  size_t first_{0};
+
+  // segments of a complete binary tree, with the interval starting at
+  // measurement i stored in leaf capacity_ + i. Capacity is a power of two
+  std::vector<Segment, Eigen::aligned_allocator<Segment>> nodes_;
+  size_t capacity_{0};
+
+  // biases the segments were integrated with, the tree is only valid if all
+  // intervals were integrated with them
+  bool valid_{false};
+  Eigen::Vector3d bg_{Eigen::Vector3d::Zero()};
+  Eigen::Vector3d ba_{Eigen::Vector3d::Zero()};
+
+  PreIntegrator stepper_; // used to integrate single measurements
+};
+
+} // namespace bs_common
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <beam_utils/math.h>
 #include <beam_utils/se3.h>
 #include <beam_utils/time.h>
@@ -47,6 +49,56 @@ struct IMUData {
   Eigen::Vector3d a; // accelerometer measurement
 };
 
+/**
+ * @brief Contiguous ring buffer of imu measurements sorted by time. Samples
+ * normally arrive in order so adding to the back and removing from the front
+ * are O(1), out of order samples are shifted into place.
+ */
+class IMUDataBuffer {
+public:
+  /**
+   * @brief Adds a measurement, measurements with a timestamp that is already in
+   * the buffer are ignored
+   * @param imu_data measurement to add
+   * @return index at which the measurement was inserted, or -1 if ignored
+   */
+  int Insert(const IMUData& imu_data);
+
+  /**
+   * @brief Removes the measurement at the front of the buffer
+   */
+  void PopFront();
+
+  /**
+   * @brief Removes all measurements
+   */
+  void Clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  const IMUData& operator[](size_t i) const {
+    return storage_[(head_ + i) % storage_.size()];
+  }
+
+  const IMUData& Front() const { return (*this)[0]; }
+
+  const IMUData& Back() const { return (*this)[size_ - 1]; }
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+private:
+  IMUData& At(size_t i) { return storage_[(head_ + i) % storage_.size()]; }
+
+  void Grow();
+
+  std::vector<IMUData> storage_;
+  size_t head_{0};
+  size_t size_{0};
+};
+
 /**
  * @brief Struct representing the changes between imu states
  */
@@ -92,6 +144,17 @@ public:
    */
   void Clear(const ros::Time& t);
 
+  /**
+   * @brief Adds a measurement to the buffer
+   * @param imu_data measurement to add
+   */
+  void AddData(const IMUData& imu_data);
+
+  /**
+   * @brief Get measurements currently in the buffer
+   */
+  const IMUDataBuffer& Data() const { return data_; }
+
   /**
    * @brief Increments current state by the incoming imu data
    * @param dt time difference to increment forward to
@@ -108,7 +171,11 @@ public:
 
   /**
    * @brief IMU Integration Function, integrate current measurements to a
-   * timestamp
+   * timestamp. Integrated states are cached, so repeated calls only increment
+   * over measurements after the most recent cached state before t. If the
+   * biases moved less than the bias correction tolerances since the cached
+   * states were integrated, the result is corrected to first order using the
+   * bias jacobians instead of re-integrating all measurements.
    * @param t timestamp to integrate to
    * @param bg current gyroscope bias estimate
    * @param ba current accelerometer bias estimate
@@ -118,7 +185,7 @@ public:
    */
   bool Integrate(const ros::Time& t, const Eigen::Vector3d& bg,
                  const Eigen::Vector3d& ba, bool compute_jacobian,
-                 bool compute_covariance,  bool compute_information);
+                 bool compute_covariance, bool compute_information);
 
   /**
    * @brief Computes the square-root information matrix from the covariance
@@ -129,6 +196,15 @@ public:
   double cov_tol{1e-5}; // tolerance on zero cov matrix for pose & vel terms
   double bias_cov_tol{1e-9}; // tolerance on zero cov matrix for bias terms
 
+  // max change in bias since the cached integration for which a first order
+  // correction is used instead of re-integrating
+  double bias_correction_tol_bg{1e-2};
+  double bias_correction_tol_ba{1e-1};
+
+  // number of measurements between cached integration states, used when
+  // integrating to a time before the last integrated measurement
+  size_t checkpoint_interval{10};
+
   Eigen::Matrix3d cov_w; // continuous noise covariance
   Eigen::Matrix3d cov_a;
   Eigen::Matrix3d cov_bg; // continuous random walk noise covariance
@@ -136,11 +212,40 @@ public:
 
   Delta delta;
   Jacobian jacobian;
-  std::map<ros::Time, IMUData> data;
-  // std::vector<IMUData> data;
 
   // for when inv covariance calculated has nan or inf
   double invalid_inv_cov_weight_{1e-4};
+
+private:
+  /**
+   * @brief Integration state at some measurement in the buffer, all intervals
+   * between the first measurement and the measurement at index have been
+   * integrated
+   */
+  struct IntegrationState {
+    size_t index{0};
+    Delta delta;
+    Jacobian jacobian;
+  };
+
+  /**
+   * @brief Gets the most recent cached state at or before time t
+   * @return nullptr if no cached state can be used
+   */
+  const IntegrationState* GetCachedState(const ros::Time& t) const;
+
+  IMUDataBuffer data_;
+
+  // cached integration, all cached states are integrated using the biases and
+  // options stored here
+  bool cache_valid_{false};
+  Eigen::Vector3d cache_bg_;
+  Eigen::Vector3d cache_ba_;
+  bool cache_jacobian_{false};
+  bool cache_covariance_{false};
+  IntegrationState frontier_; // state at the last integrated measurement
+  std::vector<IntegrationState, Eigen::aligned_allocator<IntegrationState>>
+      checkpoints_; // one every checkpoint_interval measurements
 };
 
 } // namespace bs_common
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+
+namespace bs_common {
+
+/**
+ * @brief Slot holding the latest value of some state, to hand it from one
+ * thread to others without holding a lock while it is used (read-copy-update).
+ *
+ * Store publishes a new immutable copy, and Load returns a pointer to the
+ * latest copy. Readers keep using the copy they loaded while it is being
+ * replaced, and the old copy is freed once the last reader drops it. Only the
+ * pointer swap is synchronized, so neither side ever waits on the other while
+ * it copies or uses the state.
+ */
+template <typename T>
+class RcuSlot {
+public:
+  using ConstPtr = std::shared_ptr<const T>;
+
+  RcuSlot() = default;
+
+  RcuSlot(const RcuSlot& other) = delete;
+
+  RcuSlot& operator=(const RcuSlot& other) = delete;
+
+  /**
+   * @brief publish a new value, readers see it on their next Load
+   */
+  void Store(T value) {
+    std::atomic_store(&value_,
+                      ConstPtr(std::make_shared<const T>(std::move(value))));
+  }
+
+  /**
+   * @brief get the latest value
+   * @return nullptr if nothing was stored since construction or Reset
+   */
+  ConstPtr Load() const { return std::atomic_load(&value_); }
+
+  /**
+   * @brief drop the stored value
+   */
+  void Reset() { std::atomic_store(&value_, ConstPtr()); }
+
+private:
+  ConstPtr value_;
+};
+
+} // namespace bs_common
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+
+#include <bs_common/imu_state.h>
+
+namespace bs_common {
+
+/**
+ * @brief State of a reset of the optimizer, shared with its plugins. This is a
+ * singleton so that all plugins and the optimizer running in the same process
+ * share it.
+ *
+ * During a fast reset the plugins are stopped and started as usual, but they
+ * keep what they loaded (e.g. frame initializers and registration maps)
+ * instead of rebuilding it, and the ignition sensor may re-ignite the
+ * optimizer from the last good state instead of waiting for a new
+ * initialization. State tied to the world frame (e.g. the odometry of frame
+ * initializers and registration maps) must only be kept if the optimizer is
+ * re-ignited, since the world frame of a new initialization is different, see
+ * KeepsWorldFrame().
+ */
+class ResetContext {
+public:
+  static ResetContext& GetInstance();
+
+  ResetContext(const ResetContext& other) = delete;
+
+  ResetContext& operator=(const ResetContext& other) = delete;
+
+  /**
+   * @brief Called by the ignition sensor to tell if it re-ignites the
+   * optimizer from the last good state after a fast reset
+   */
+  void SetReigniteAfterFastReset(bool reignite);
+
+  /**
+   * @brief Called by the optimizer before stopping its plugins for a fast
+   * reset. Records whether the world frame is kept, which is the case if
+   * re-ignition is requested and there is a last good state
+   * @param last_good_state state to re-ignite from, nullopt if there is none
+   */
+  void BeginFastReset(const std::optional<ImuState>& last_good_state);
+
+  /**
+   * @brief Called by the optimizer once its plugins are started again, the
+   * last good state is discarded if no plugin took it
+   */
+  void EndReset();
+
+  /**
+   * @brief Check if the plugins are stopped or started for a fast reset
+   */
+  bool IsFastReset() const;
+
+  /**
+   * @brief Check if the plugins are stopped or started for a fast reset after
+   * which the optimizer is re-ignited in the same world frame. This stays true
+   * once the last good state is taken, until EndReset()
+   */
+  bool KeepsWorldFrame() const;
+
+  /**
+   * @brief Check if there is a last good state to re-ignite from
+   */
+  bool HasLastGoodState() const;
+
+  /**
+   * @brief Get the last good state to re-ignite from. It is removed, so that
+   * only one plugin re-ignites the optimizer
+   * @return state, nullopt if there is none or it was already taken
+   */
+  std::optional<ImuState> TakeLastGoodState();
+
+private:
+  ResetContext() = default;
+
+  mutable std::mutex mutex_;
+  bool fast_reset_{false};
+  bool reignite_{false};
+  bool keeps_world_frame_{false};
+  std::optional<ImuState> last_good_state_;
+};
+
+} // namespace bs_common
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+
+namespace bs_common {
+
+/**
+ * @brief Low overhead sampling profiler which can be left in field builds and
+ * toggled at runtime, e.g. through the services of the FixedLagSmoother. Only
+ * threads that registered themselves are sampled, under the name they
+ * registered with (e.g. the plugin name), so samples can be attributed to
+ * LidarOdometry, VisualOdometry, the smoother thread and so on.
+ *
+ * While running, a sampler thread sends a signal (SIGPROF) to each registered
+ * thread in turn at the sampling rate, and the signal handler of that thread
+ * records its call stack. Stacks are aggregated in memory as raw addresses
+ * with a count, and are only symbolized when written as folded stacks, the
+ * input format of flamegraph.pl and speedscope.
+ *
+ * Frames are named from the dynamic symbol table, so functions that are not
+ * exported (e.g. static functions, or the executable unless linked with
+ * -rdynamic) are shown as <module>+<offset>. Another profiler using SIGPROF
+ * (e.g. gperftools) cannot be used at the same time.
+ *
+ * This is a singleton so that all plugins running in the same process share
+ * the same profile.
+ */
+class SamplingProfiler {
+public:
+  struct Params {
+    /** samples per second of each thread */
+    double rate_hz{20};
+
+    /** max number of distinct stacks kept, samples of new stacks are dropped
+     * once reached */
+    size_t max_stacks{50000};
+  };
+
+  static SamplingProfiler& GetInstance();
+
+  SamplingProfiler(const SamplingProfiler& other) = delete;
+
+  SamplingProfiler& operator=(const SamplingProfiler& other) = delete;
+
+  /**
+   * @brief Register the calling thread to be sampled, under a name. Calling
+   * this again from the same thread with the same name is cheap, so it can be
+   * called at the start of every callback of threads that are not owned by
+   * the caller (e.g. the spinner threads of a plugin). The thread is also
+   * given the name (truncated to 15 characters) at the OS level, and is
+   * unregistered when it exits
+   * @param name name of the thread, e.g. "lidar_odometry"
+   */
+  void RegisterThread(const std::string& name);
+
+  /**
+   * @brief Stop sampling the calling thread
+   */
+  void UnregisterThread();
+
+  /**
+   * @brief Install the signal handler and start sampling
+   * @return false if already running or the handler could not be installed
+   */
+  bool Start(const Params& params);
+
+  bool Start() { return Start(Params()); }
+
+  /**
+   * @brief Stop sampling, the samples are kept. The signal handler stays
+   * installed since signals of late samples may still be pending
+   */
+  void Stop();
+
+  bool Running() const { return running_; }
+
+  /**
+   * @brief Get the names of the registered threads
+   */
+  std::vector<std::string> Threads() const;
+
+  /**
+   * @brief Get the number of samples recorded since the last Clear
+   */
+  size_t NumSamples() const;
+
+  /**
+   * @brief Get the number of samples dropped because max_stacks was reached
+   */
+  size_t NumDropped() const;
+
+  /**
+   * @brief Get the profile as folded stacks, one line per distinct stack:
+   * "<thread>;<outermost frame>;...;<innermost frame> <count>"
+   */
+  std::vector<std::string> FoldedStacks() const;
+
+  /**
+   * @brief Write the folded stacks to a file
+   * @return false if the file could not be written
+   */
+  bool WriteFoldedStacks(const std::string& path) const;
+
+  /**
+   * @brief Remove all samples
+   */
+  void Clear();
+
+private:
+  static constexpr int kMaxFrames = 64;
+
+  /** Written by the signal handler of its thread */
+  struct Slot {
+    std::atomic<bool> requested{false};
+    std::atomic<int> depth{-1};
+    void* frames[kMaxFrames];
+  };
+
+  struct Thread {
+    std::string name;
+    pthread_t handle;
+    Slot slot;
+  };
+
+  SamplingProfiler() = default;
+
+  ~SamplingProfiler();
+
+  static void HandleSignal(int signal);
+
+  void Run();
+
+  /**
+   * @brief Signal a thread and wait for its stack, registry_mutex_ must be
+   * held
+   * @return number of frames, 0 if the thread did not answer in time
+   */
+  int Sample(Thread& thread);
+
+  void Record(const std::string& thread, const void* const* frames,
+              int depth);
+
+  /** Slot of the calling thread, nullptr if not registered */
+  static thread_local Slot* current_slot_;
+
+  Params params_;
+  bool handler_installed_{false};
+  std::atomic<bool> running_{false};
+  std::thread sampler_;
+  std::mutex sampler_mutex_; // serializes Start and Stop
+  std::mutex wakeup_mutex_;
+  std::condition_variable wakeup_;
+
+  mutable std::mutex registry_mutex_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+
+  mutable std::mutex stacks_mutex_;
+  // <thread name, <frames, count>>
+  std::map<std::string, std::map<std::vector<const void*>, size_t>> stacks_;
+  size_t num_stacks_{0};
+  size_t num_samples_{0};
+  size_t num_dropped_{0};
+};
+
+} // namespace bs_common
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Ring buffer of messages in POSIX shared memory, used to pass data
+ * between two processes without copying it through sockets or ROS
+ * serialization. A ring has a single producer and a single consumer: each
+ * message is written once into the ring by the producer and copied once out
+ * of it by the consumer.
+ *
+ * The ring is created by one process, which owns it and removes it when
+ * destroyed, and opened by the other one. Messages are length prefixed and
+ * wrap around the end of the ring, so any message up to MaxMessageSize can be
+ * written as long as the consumer keeps up. Blocking reads and writes poll the
+ * ring with a backoff of at most kMaxPollPeriod, since the processes do not
+ * share a condition variable.
+ *
+ * A ring that is removed and created again (e.g. when its owner restarts) is
+ * a new ring, the other process must open it again.
+ */
+class ShmRing {
+public:
+  static constexpr std::chrono::microseconds kMaxPollPeriod{500};
+
+  /**
+   * @brief create a ring, replacing any ring left with the same name
+   * @param name shared memory object name, e.g. "/beam_slam_transactions"
+   * @param capacity size of the ring in bytes
+   * @return nullptr if it cannot be created
+   */
+  static std::unique_ptr<ShmRing> Create(const std::string& name,
+                                         size_t capacity);
+
+  /**
+   * @brief open a ring created by another process
+   * @return nullptr if it does not exist (yet) or is not a valid ring
+   */
+  static std::unique_ptr<ShmRing> Open(const std::string& name);
+
+  /**
+   * @brief unmap the ring, and remove it if this process created it
+   */
+  ~ShmRing();
+
+  ShmRing(const ShmRing& other) = delete;
+
+  ShmRing& operator=(const ShmRing& other) = delete;
+
+  /**
+   * @brief write a message if there is enough space
+   * @return false if the ring is full or the message is too large
+   */
+  bool TryWrite(const uint8_t* data, size_t size);
+
+  /**
+   * @brief write a message, waiting for space
+   * @return false if there is no space after the timeout or the message is
+   * too large
+   */
+  bool Write(const uint8_t* data, size_t size,
+             const std::chrono::milliseconds& timeout);
+
+  /**
+   * @brief read the oldest message if there is one
+   * @param message output, resized to the message
+   */
+  bool TryRead(std::vector<uint8_t>& message);
+
+  /**
+   * @brief read the oldest message, waiting for one
+   * @return false if there is no message after the timeout
+   */
+  bool Read(std::vector<uint8_t>& message,
+            const std::chrono::milliseconds& timeout);
+
+  const std::string& Name() const { return name_; }
+
+  size_t Capacity() const { return capacity_; }
+
+  /**
+   * @brief size of the largest message that fits in the ring
+   */
+  size_t MaxMessageSize() const { return capacity_ - sizeof(uint64_t); }
+
+  /**
+   * @brief number of bytes written but not read yet, including the length
+   * prefixes
+   */
+  size_t Used() const;
+
+private:
+  struct Header;
+
+  ShmRing(const std::string& name, void* memory, size_t mapped_size,
+          bool owner);
+
+  /**
+   * @brief copy bytes to or from the ring at a position of the byte stream,
+   * wrapping around its end
+   */
+  void CopyIn(uint64_t position, const uint8_t* data, size_t size);
+  void CopyOut(uint64_t position, uint8_t* data, size_t size) const;
+
+  std::string name_;
+  void* memory_;
+  size_t mapped_size_;
+  bool owner_;
+  Header* header_;
+  uint8_t* data_;
+  size_t capacity_;
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "shared memory counters must be lock free");
+};
+
+} // namespace bs_common
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Bounded lock-free single-producer single-consumer queue. Values are
+ * stored in a fixed ring so pushing and popping never allocates, and the two
+ * threads only share the head and tail indices. This is meant to pass work
+ * between the stages of a pipeline, where each stage is a single thread.
+ *
+ * TryPush must only be called by one producer thread and TryPop by one
+ * consumer thread at a time. Neither blocks, callers decide whether to drop,
+ * retry or wait when the queue is full or empty.
+ */
+template <typename T>
+class SPSCQueue {
+public:
+  /**
+   * @brief constructor
+   * @param capacity max number of queued values, at least one
+   */
+  explicit SPSCQueue(size_t capacity)
+      : slots_(std::max<size_t>(capacity, 1) + 1) {}
+
+  SPSCQueue(const SPSCQueue& other) = delete;
+
+  SPSCQueue& operator=(const SPSCQueue& other) = delete;
+
+  /**
+   * @brief add a value to the queue
+   * @return false if the queue is full, in which case the value is not moved
+   */
+  bool TryPush(T&& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = Next(tail);
+    if (next == head_.load(std::memory_order_acquire)) { return false; }
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief remove the oldest value from the queue
+   * @return false if the queue is empty
+   */
+  bool TryPop(T& value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) { return false; }
+    value = std::move(slots_[head]);
+    // release whatever the slot holds now instead of when it is overwritten
+    slots_[head] = T();
+    head_.store(Next(head), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief check if the queue is empty, this is only a snapshot if the other
+   * thread is running
+   */
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief check if the queue is full. This is exact when called by the
+   * producer, since only the producer can fill the queue
+   */
+  bool Full() const {
+    return Next(tail_.load(std::memory_order_relaxed)) ==
+           head_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief get the max number of queued values
+   */
+  size_t Capacity() const { return slots_.size() - 1; }
+
+private:
+  size_t Next(size_t i) const { return i + 1 == slots_.size() ? 0 : i + 1; }
+
+  std::vector<T> slots_;
+
+  // head and tail are written by different threads, keep them on separate
+  // cache lines
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace bs_common
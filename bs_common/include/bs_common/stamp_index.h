@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/graph.h>
+#include <ros/time.h>
+
+namespace bs_common {
+
+/**
+ * @brief Ordered set of the stamps of the pose states in a graph
+ * (fuse_variables::Position3DStamped), stored in fixed duration time buckets.
+ * Each bucket is a small sorted vector, so lookups only search the bucket of
+ * the stamp and insertions/removals at the ends of the window, which is how
+ * states are added and marginalized, don't move the other stamps.
+ *
+ * A GraphSnapshot carries the index of its graph, which the snapshot builder
+ * updates with the added and removed variables instead of scanning the graph,
+ * see bs_common::GetStampIndex.
+ */
+class StampIndex {
+public:
+  FUSE_SMART_PTR_DEFINITIONS(StampIndex);
+
+  /**
+   * @brief constructor
+   * @param bucket_duration duration covered by each bucket
+   */
+  explicit StampIndex(const ros::Duration& bucket_duration = ros::Duration(1));
+
+  /**
+   * @brief Builds the index of all pose stamps in a graph
+   */
+  explicit StampIndex(const fuse_core::Graph& graph,
+                      const ros::Duration& bucket_duration = ros::Duration(1));
+
+  /**
+   * @brief Adds a stamp
+   * @return false if it was already in the index
+   */
+  bool Insert(const ros::Time& stamp);
+
+  /**
+   * @brief Removes a stamp
+   * @return false if it wasn't in the index
+   */
+  bool Erase(const ros::Time& stamp);
+
+  bool Contains(const ros::Time& stamp) const;
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+  /**
+   * @brief Oldest stamp, the index must not be empty
+   */
+  const ros::Time& Oldest() const;
+
+  /**
+   * @brief Newest stamp, the index must not be empty
+   */
+  const ros::Time& Newest() const;
+
+  /**
+   * @brief All stamps in increasing order
+   */
+  std::vector<ros::Time> Stamps() const;
+
+  /**
+   * @brief Stamps in [start, end] in increasing order
+   */
+  std::vector<ros::Time> Range(const ros::Time& start,
+                               const ros::Time& end) const;
+
+  /**
+   * @brief Stamps in this index that are not in the other one, in increasing
+   * order. With the index of the previous graph, this gives the marginalized
+   * stamps, and with the one of the next graph the new stamps
+   */
+  std::vector<ros::Time> Difference(const StampIndex& other) const;
+
+  std::set<ros::Time> ToSet() const;
+
+  void Clear();
+
+private:
+  uint64_t Bucket(const ros::Time& stamp) const;
+
+  uint64_t bucket_nsec_;
+  std::map<uint64_t, std::vector<ros::Time>> buckets_;
+  size_t size_{0};
+};
+
+} // namespace bs_common
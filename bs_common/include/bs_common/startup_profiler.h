@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Startup times of plugins and readiness of heavy resources (e.g.
+ * vocabularies) which are loaded in the background. This is a singleton so
+ * that all plugins and the optimizer running in the same process share it:
+ * plugins record their init times and signal their resources as ready, and
+ * the optimizer only waits for the resources it is configured to need before
+ * starting.
+ *
+ * Startup times are recorded in the "startup/<name>" instrumentation metrics,
+ * which are reported in the optimizer diagnostics.
+ */
+class StartupProfiler {
+public:
+  static StartupProfiler& GetInstance();
+
+  StartupProfiler(const StartupProfiler& other) = delete;
+
+  StartupProfiler& operator=(const StartupProfiler& other) = delete;
+
+  /**
+   * @brief Records and logs the time something took to initialize
+   * @param name e.g. "lidar_odometry/on_init"
+   */
+  void Record(const std::string& name, std::chrono::nanoseconds duration);
+
+  /**
+   * @brief Signals that a resource is ready to be used
+   */
+  void SetReady(const std::string& resource);
+
+  bool IsReady(const std::string& resource) const;
+
+  /**
+   * @brief Blocks until all resources are ready, or until the timeout
+   * @param timeout_s timeout in seconds, waits forever if negative
+   * @return resources which are not ready
+   */
+  std::vector<std::string>
+      WaitUntilReady(const std::vector<std::string>& resources,
+                     double timeout_s) const;
+
+private:
+  StartupProfiler() = default;
+
+  mutable std::mutex mutex_;
+  mutable std::condition_variable ready_condition_;
+  std::set<std::string> ready_;
+};
+
+/**
+ * @brief Records the time from construction to destruction (or Stop) in the
+ * startup profiler
+ */
+class ScopedStartupTimer {
+public:
+  explicit ScopedStartupTimer(const std::string& name)
+      : name_(name), start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedStartupTimer() { Stop(); }
+
+  /**
+   * @brief Records the elapsed time, nothing is recorded on destruction after
+   * this is called
+   */
+  void Stop() {
+    if (stopped_) { return; }
+    stopped_ = true;
+    StartupProfiler::GetInstance().Record(
+        name_, std::chrono::steady_clock::now() - start_);
+  }
+
+private:
+  std::string name_;
+  std::chrono::steady_clock::time_point start_;
+  bool stopped_{false};
+};
+
+/**
+ * @brief Loads a resource on a background thread, recording its load time and
+ * signalling it as ready once loaded. Exceptions thrown by load are rethrown
+ * by get() on the returned future.
+ * @param resource name of the resource, e.g. "visual_odometry/vocabulary"
+ * @param load loads and returns the resource
+ */
+template <typename T>
+std::shared_future<T> LoadInBackground(const std::string& resource,
+                                       std::function<T()> load) {
+  return std::async(std::launch::async,
+                    [resource, load = std::move(load)]() {
+                      ScopedStartupTimer timer(resource);
+                      T result = load();
+                      timer.Stop();
+                      StartupProfiler::GetInstance().SetReady(resource);
+                      return result;
+                    })
+      .share();
+}
+
+} // namespace bs_common
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Priority class of a task. Real-time tasks (e.g. odometry) are always
+ * run before background tasks (e.g. global mapping)
+ */
+enum class TaskPriority { REALTIME = 0, BACKGROUND = 1 };
+
+/**
+ * @brief Process-wide pool of worker threads shared by all components, so
+ * that parallel work from scan registration, visual odometry, global mapping
+ * and the optimizer does not oversubscribe the cores.
+ *
+ * Each worker has its own queue per priority class. Tasks queued from a
+ * worker go to its own queue, other tasks are spread over the workers. Idle
+ * workers run the newest task of their own queue first, then steal the oldest
+ * task of the other workers. Real-time tasks are always taken before
+ * background tasks, and at most max_background_threads workers run background
+ * tasks at once so that some workers are always available for real-time
+ * tasks.
+ *
+ * This is a singleton so that all sensor models and the optimizer running in
+ * the same process share the same workers. Workers can be pinned to cores,
+ * see Params.
+ */
+class TaskScheduler {
+public:
+  static constexpr int kNumPriorities = 2;
+
+  struct Params {
+    /** number of workers, if 0 the number of cores is used */
+    int num_threads{0};
+
+    /** max number of workers running background tasks at once, if 0 half of
+     * the workers are used (at least one) */
+    int max_background_threads{0};
+
+    /** cores the workers are pinned to, worker i is pinned to
+     * cores[i % cores.size()]. Workers are not pinned if empty */
+    std::vector<int> cores;
+  };
+
+  /**
+   * @brief Statistics since the workers were started. tasks_run counts the
+   * tasks taken from the queues, including the ones still running
+   */
+  struct Stats {
+    int num_threads{0};
+    double uptime_s{0};
+    std::array<uint64_t, kNumPriorities> tasks_run{};
+    std::array<uint64_t, kNumPriorities> tasks_queued{};
+    std::array<double, kNumPriorities> busy_s{};
+  };
+
+  /**
+   * @brief get the scheduler, it is started with the default params on the
+   * first call
+   */
+  static TaskScheduler& GetInstance();
+
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler& other) = delete;
+
+  TaskScheduler& operator=(const TaskScheduler& other) = delete;
+
+  /**
+   * @brief restart the workers with new params. The queued tasks are run
+   * first. This is meant to be called once at startup and must not be called
+   * from a task or while other threads queue tasks
+   */
+  void Configure(const Params& params);
+
+  /**
+   * @brief queue a task
+   * @return future which becomes ready once the task ran, and which rethrows
+   * any exception thrown by the task
+   */
+  std::future<void> Enqueue(TaskPriority priority, std::function<void()> task);
+
+  /**
+   * @brief run task(i) for all i in [0, n), split in contiguous chunks over
+   * the workers. The calling thread runs the first chunk and then helps with
+   * queued tasks of the same or higher priority until all calls returned, so
+   * this can be called from tasks. The first exception thrown by a call is
+   * rethrown.
+   * @param max_parallelism max number of chunks, if 0 one chunk per worker
+   * plus one for the calling thread
+   */
+  void ParallelFor(TaskPriority priority, size_t n,
+                   const std::function<void(size_t)>& task,
+                   size_t max_parallelism = 0);
+
+  int NumThreads() const { return static_cast<int>(workers_.size()); }
+
+  Stats GetStats() const;
+
+  /**
+   * @brief pin the calling thread to a set of cores, e.g. for dedicated
+   * threads which are not part of the scheduler
+   * @return false if the cores are invalid or pinning is not supported
+   */
+  static bool PinCurrentThread(const std::vector<int>& cores);
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::array<std::deque<std::packaged_task<void()>>, kNumPriorities> queues;
+    std::thread thread;
+  };
+
+  TaskScheduler();
+
+  void Start(const Params& params);
+
+  void Stop();
+
+  void Push(TaskPriority priority, std::packaged_task<void()> task);
+
+  /**
+   * @brief take a task of a priority from the queue of a worker, newest
+   * first if own_queue, oldest first otherwise
+   */
+  bool Pop(Worker& worker, int priority, bool own_queue,
+           std::packaged_task<void()>& task);
+
+  /**
+   * @brief run one queued task, starting with the queue of worker_index
+   * @param lowest_priority lowest priority of the tasks to run
+   * @return false if no task could be run
+   */
+  bool RunOne(size_t worker_index, int lowest_priority);
+
+  bool HasRunnableTask() const;
+
+  void Run(size_t worker_index, int core);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  int max_background_threads_{1};
+  std::chrono::steady_clock::time_point start_time_;
+  std::atomic<size_t> next_worker_{0};
+  std::atomic<int> running_background_{0};
+  std::array<std::atomic<uint64_t>, kNumPriorities> num_queued_{};
+  std::array<std::atomic<uint64_t>, kNumPriorities> tasks_run_{};
+  std::array<std::atomic<uint64_t>, kNumPriorities> busy_ns_{};
+
+  // only used to sleep and wake up idle workers
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_{false};
+};
+
+} // namespace bs_common
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bs_common {
+
+/**
+ * @brief Fixed size pool of worker threads which run tasks in the order they
+ * were added. The threads are created once in the constructor and joined in
+ * the destructor, so this can be used for work that repeats at sensor rate
+ * without paying the cost of creating threads every time.
+ *
+ * Tasks must not wait on other tasks of the same pool, this can deadlock if
+ * all threads are waiting.
+ */
+class ThreadPool {
+public:
+  /**
+   * @brief constructor
+   * @param num_threads number of worker threads, at least one is created
+   */
+  explicit ThreadPool(int num_threads);
+
+  /**
+   * @brief waits for all queued tasks to finish, then joins the workers
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool& other) = delete;
+
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  /**
+   * @brief queue a task
+   * @return future which becomes ready once the task ran, and which rethrows
+   * any exception thrown by the task
+   */
+  std::future<void> Enqueue(std::function<void()> task);
+
+  /**
+   * @brief run task(i) for all i in [0, n), split in contiguous chunks over
+   * the workers. Blocks until all calls returned. This is run inline if there
+   * is only one worker or one item.
+   */
+  void ParallelFor(size_t n, const std::function<void(size_t)>& task);
+
+  /**
+   * @brief get the number of worker threads
+   */
+  int NumThreads() const { return static_cast<int>(workers_.size()); }
+
+private:
+  void Run();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::packaged_task<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_{false};
+};
+
+} // namespace bs_common
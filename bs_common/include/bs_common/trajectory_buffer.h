@@ -0,0 +1,246 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ros/time.h>
+
+#include <beam_utils/math.h>
+
+#include <bs_common/rcu_slot.h>
+
+namespace bs_common {
+
+/**
+ * @brief Stamped pose of a trajectory. This is a plain 64 byte record so that
+ * trajectories can be stored to and mapped from files as is, see
+ * TrajectoryFile
+ */
+struct TrajectoryPose {
+  TrajectoryPose() = default;
+
+  /**
+   * @brief Constructor
+   * @param _stamp time of the pose
+   * @param T transformation matrix
+   */
+  TrajectoryPose(const ros::Time& _stamp, const Eigen::Matrix4d& T);
+
+  /**
+   * @brief Gets the pose as a transformation matrix
+   */
+  Eigen::Matrix4d T() const;
+
+  Eigen::Quaterniond Orientation() const {
+    return Eigen::Quaterniond(q[3], q[0], q[1], q[2]);
+  }
+
+  Eigen::Vector3d Position() const {
+    return Eigen::Vector3d(p[0], p[1], p[2]);
+  }
+
+  ros::Time stamp;
+  double q[4]{0, 0, 0, 1}; // x, y, z, w
+  double p[3]{0, 0, 0};
+};
+
+static_assert(std::is_trivially_copyable<TrajectoryPose>::value &&
+                  sizeof(TrajectoryPose) == 64,
+              "TrajectoryPose is stored in files as is");
+
+using TrajectoryPoses = std::vector<TrajectoryPose>;
+
+/**
+ * @brief Immutable trajectory with its poses sorted by time in contiguous
+ * memory. Poses between two samples are interpolated the same way as tf2:
+ * linearly for the position and with a slerp for the orientation. Lookups are
+ * binary searches, and batched lookups of sorted times walk the trajectory
+ * only once.
+ *
+ * The poses are either owned by the trajectory or read in place from memory
+ * owned by someone else, such as a memory mapped file. Copies share the poses.
+ */
+class Trajectory {
+public:
+  Trajectory() = default;
+
+  /**
+   * @brief Constructor
+   * @param poses poses in any order. Poses with a stamp that is already in the
+   * trajectory are removed, keeping the first one
+   */
+  explicit Trajectory(TrajectoryPoses poses);
+
+  /**
+   * @brief Constructor that reads the poses in place without copying them
+   * @param storage keeps the poses alive as long as the trajectory, or any of
+   * its copies, uses them
+   * @param poses poses sorted by time, with unique stamps
+   * @param size number of poses
+   */
+  Trajectory(std::shared_ptr<const void> storage, const TrajectoryPose* poses,
+             size_t size);
+
+  /**
+   * @brief Interpolates the pose at a time
+   * @param T [out] pose
+   * @param time stamp between StartTime() and EndTime(). As with tf2, a time
+   * of 0 gets the last pose
+   * @param error_msg [out] reason if the lookup fails
+   * @return false if the time is outside of the trajectory
+   */
+  bool Get(Eigen::Matrix4d& T, const ros::Time& time,
+           std::string& error_msg) const;
+
+  /**
+   * @brief Interpolates the poses at many times, walking the trajectory once
+   * @param Ts [out] one pose per time
+   * @param times sorted stamps
+   * @param error_msg [out] reason if the lookup fails
+   * @return false if any of the times is outside of the trajectory
+   */
+  bool Get(std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts,
+           const std::vector<ros::Time>& times, std::string& error_msg) const;
+
+  /**
+   * @brief Gets the last pose with stamp <= time, without interpolating
+   * @return nullptr if there is none
+   */
+  const TrajectoryPose* Before(const ros::Time& time) const;
+
+  const TrajectoryPose* begin() const { return poses_; }
+
+  const TrajectoryPose* end() const { return poses_ + size_; }
+
+  const TrajectoryPose& operator[](size_t i) const { return poses_[i]; }
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+  /**
+   * @brief Stamp of the first pose, must not be empty
+   */
+  const ros::Time& StartTime() const { return poses_[0].stamp; }
+
+  /**
+   * @brief Stamp of the last pose, must not be empty
+   */
+  const ros::Time& EndTime() const { return poses_[size_ - 1].stamp; }
+
+private:
+  /**
+   * @brief Checks that a time is within the trajectory
+   */
+  bool CheckTime(const ros::Time& time, std::string& error_msg) const;
+
+  /**
+   * @brief Gets the pose at a time, given the index of the first pose with
+   * stamp >= time
+   */
+  Eigen::Matrix4d Interpolate(size_t index, const ros::Time& time) const;
+
+  std::shared_ptr<const void> storage_;
+  const TrajectoryPose* poses_{nullptr};
+  size_t size_{0};
+};
+
+/**
+ * @brief Trajectory shared between writers and many readers. Writers add
+ * poses to their own copy and publish it as an immutable Trajectory through an
+ * RcuSlot, so readers never take a lock or copy the poses: they load the
+ * latest trajectory and use it for as long as they need it, while new poses
+ * are published. Each write copies the poses once, which is cheap for the few
+ * thousand poses of an odometry buffer compared to the lookups it saves.
+ *
+ * Readers that are waiting for poses, e.g. for the odometry to catch up to a
+ * sensor measurement, can be notified when the trajectory reaches a time
+ * instead of polling it, see NotifyWhenReached.
+ */
+class TrajectoryBuffer {
+public:
+  /**
+   * @brief Constructor
+   * @param max_duration poses older than this relative to the newest pose are
+   * removed as new poses are added. A duration of 0 keeps all poses
+   */
+  explicit TrajectoryBuffer(
+      const ros::Duration& max_duration = ros::Duration(0));
+
+  TrajectoryBuffer(const TrajectoryBuffer& other) = delete;
+
+  TrajectoryBuffer& operator=(const TrajectoryBuffer& other) = delete;
+
+  /**
+   * @brief Adds a pose and publishes the trajectory. Poses with a stamp that
+   * is already in the buffer are ignored
+   * @return false if the pose was ignored
+   */
+  bool Add(const ros::Time& stamp, const Eigen::Matrix4d& T);
+
+  /**
+   * @brief Replaces all poses and publishes the trajectory. The poses are
+   * shared with the trajectory, they are only copied by the next Add
+   */
+  void Set(const Trajectory& trajectory);
+
+  /**
+   * @brief Removes all poses and publishes the empty trajectory
+   */
+  void Clear();
+
+  /**
+   * @brief Gets the latest published trajectory, never nullptr
+   */
+  RcuSlot<Trajectory>::ConstPtr Get() const { return trajectory_.Load(); }
+
+  /**
+   * @brief Calls a function once the trajectory reaches a time, i.e., once
+   * its end time is >= time. It is called by the writer publishing the pose
+   * that reaches the time, or right away if the trajectory already reaches
+   * it. Notifications are called while holding a lock, so they should be
+   * short (e.g., add a callback to a queue) and must not use the
+   * notifications of this buffer
+   * @param time time to reach
+   * @param callback function called once
+   * @return id of the notification to cancel it, 0 if it was already called
+   */
+  uint64_t NotifyWhenReached(const ros::Time& time,
+                             std::function<void()> callback);
+
+  /**
+   * @brief Cancels a notification. Once this returns the notification is not
+   * called anymore. Ids of notifications that were already called are ignored
+   */
+  void CancelNotification(uint64_t id);
+
+private:
+  /**
+   * @brief Calls and removes the notifications reached by the latest
+   * published trajectory
+   */
+  void Notify();
+
+  ros::Duration max_duration_;
+
+  // only locked by writers
+  std::mutex mutex_;
+  TrajectoryPoses poses_;
+  bool poses_outdated_{false}; // if Set since the last Add
+
+  RcuSlot<Trajectory> trajectory_;
+
+  // notifications by time to reach, with their id
+  std::mutex notifications_mutex_;
+  std::multimap<ros::Time, std::pair<uint64_t, std::function<void()>>>
+      notifications_;
+  uint64_t next_notification_id_{1};
+};
+
+} // namespace bs_common
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <bs_common/trajectory_buffer.h>
+
+namespace bs_common {
+
+/**
+ * @brief Binary trajectory file. The poses are stored as TrajectoryPose
+ * records in a chunk file (see ChunkFileWriter) next to the frame ids of the
+ * trajectory. Loading a file only maps it: the poses are read in place
+ * without parsing and the OS pages them in as they are looked up, so even
+ * multi-hour trajectories load instantly.
+ *
+ * The version is written to the file and must be bumped whenever the data of
+ * a chunk changes.
+ */
+constexpr uint32_t kTrajectoryFileVersion = 1;
+
+enum class TrajectoryChunkType : uint32_t {
+  POSES = 0, // number of poses followed by the records
+  FRAMES     // fixed and moving frame ids
+};
+
+/**
+ * @brief Trajectory with its frame ids, as stored in a trajectory file
+ */
+struct TrajectoryFile {
+  /** frame the poses are expressed in, e.g. the world frame */
+  std::string fixed_frame;
+
+  /** frame the poses are of, e.g. the baselink frame */
+  std::string moving_frame;
+
+  Trajectory trajectory;
+
+  /**
+   * @brief write the trajectory and frame ids to a file, overriding any
+   * existing file
+   * @return false if the file cannot be written
+   */
+  bool Save(const std::string& path) const;
+
+  /**
+   * @brief map a file written by Save. The trajectory keeps the file mapped
+   * while it, or any of its copies, exists
+   * @return false if the file cannot be mapped or is not a trajectory file
+   */
+  bool Load(const std::string& path);
+
+  /**
+   * @brief check if a file is a chunk file with trajectory poses
+   */
+  static bool IsTrajectoryFile(const std::string& path);
+};
+
+} // namespace bs_common
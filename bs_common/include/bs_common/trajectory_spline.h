@@ -0,0 +1,185 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include <ros/time.h>
+
+#include <beam_utils/math.h>
+
+#include <bs_common/trajectory_buffer.h>
+
+namespace bs_common {
+
+/**
+ * @brief Uniform cumulative cubic B-spline over SE(3), with the rotation and
+ * translation splined separately (the split representation of basalt's
+ * Se3Spline). The spline is C2 continuous, unlike the piecewise linear
+ * interpolation of Trajectory, and evaluating it only needs the four control
+ * points around the time so batched lookups don't search at all.
+ *
+ * The control points are solved so the spline goes through the poses sampled
+ * at its knots, which are at start time + k * knot interval.
+ */
+class TrajectorySpline {
+public:
+  TrajectorySpline() = default;
+
+  /**
+   * @brief Fits a spline through poses of a trajectory sampled at uniform
+   * knots
+   * @param trajectory trajectory to sample
+   * @param start_time time of the first knot, within the trajectory
+   * @param knot_interval time between knots
+   * @param num_knots number of knots, at least 2. The last one must be within
+   * the trajectory
+   * @param spline [out] fitted spline
+   * @param error_msg [out] reason if the trajectory cannot be sampled
+   * @return false if any knot is outside of the trajectory
+   */
+  static bool Fit(const Trajectory& trajectory, const ros::Time& start_time,
+                  const ros::Duration& knot_interval, size_t num_knots,
+                  TrajectorySpline& spline, std::string& error_msg);
+
+  /**
+   * @brief Evaluates the pose at a time
+   * @param T [out] pose
+   * @param time stamp between StartTime() and EndTime()
+   * @param error_msg [out] reason if the lookup fails
+   * @return false if the time is outside of the spline
+   */
+  bool Get(Eigen::Matrix4d& T, const ros::Time& time,
+           std::string& error_msg) const;
+
+  /**
+   * @brief Evaluates the poses at many times
+   * @param Ts [out] one pose per time
+   * @param times stamps, in any order
+   * @param error_msg [out] reason if the lookup fails
+   * @return false if any of the times is outside of the spline
+   */
+  bool Get(std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts,
+           const std::vector<ros::Time>& times, std::string& error_msg) const;
+
+  bool Empty() const { return positions_.empty(); }
+
+  /**
+   * @brief Time of the first knot, must not be empty
+   */
+  const ros::Time& StartTime() const { return start_time_; }
+
+  /**
+   * @brief Time of the last knot, must not be empty
+   */
+  const ros::Time& EndTime() const { return end_time_; }
+
+private:
+  /**
+   * @brief Evaluates the pose at a time within the spline
+   */
+  Eigen::Matrix4d Evaluate(const ros::Time& time) const;
+
+  /**
+   * @brief Evaluates the orientation at segment s and normalized time u
+   */
+  Eigen::Quaterniond EvaluateOrientation(size_t s, double u) const;
+
+  ros::Time start_time_;
+  ros::Time end_time_;
+  ros::Duration knot_interval_;
+
+  // knot k is at the first point of segment k, which uses control points k to
+  // k + 3. There are two more control points than knots
+  std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond>>
+      orientations_;
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+      positions_;
+
+  // log(q_{i-1}^-1 * q_i) of each control point i > 0, computed once
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+      orientation_deltas_;
+};
+
+/**
+ * @brief Splines a trajectory in fixed time windows, and caches one spline per
+ * window so consumers looking up the same period (e.g. the points of a scan,
+ * then the images around it) share a single fit. Knots are on a grid of
+ * absolute time, so the spline of a window does not depend on when it was
+ * fitted.
+ *
+ * The cache assumes trajectories only grow at the back, as odometry buffers
+ * do: a window is only refitted if the trajectory did not cover it entirely
+ * when it was fitted. Times the splines do not cover (before the first or
+ * after the last knot of the trajectory) are interpolated linearly.
+ *
+ * Lookups are thread safe.
+ */
+class TrajectorySplineCache {
+public:
+  struct Params {
+    /** time between knots */
+    ros::Duration knot_interval{0.01};
+
+    /** duration of each window, rounded to a multiple of the knot interval */
+    ros::Duration window_duration{1.0};
+
+    /** max number of cached windows, the oldest ones are removed first */
+    size_t max_windows{16};
+  };
+
+  /**
+   * @brief Constructor
+   * @param params cache params
+   */
+  explicit TrajectorySplineCache(const Params& params);
+
+  TrajectorySplineCache(const TrajectorySplineCache& other) = delete;
+
+  TrajectorySplineCache& operator=(const TrajectorySplineCache& other) = delete;
+
+  /**
+   * @brief Evaluates the poses of a trajectory at many times
+   * @param trajectory trajectory to spline, the latest one of the buffer it
+   * comes from
+   * @param Ts [out] one pose per time
+   * @param times sorted stamps
+   * @param error_msg [out] reason if the lookup fails
+   * @return false if any of the times is outside of the trajectory
+   */
+  bool Get(const Trajectory& trajectory,
+           std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts,
+           const std::vector<ros::Time>& times, std::string& error_msg);
+
+  /**
+   * @brief Removes all cached windows, e.g. when the trajectory is replaced
+   */
+  void Clear();
+
+private:
+  struct Window {
+    std::shared_ptr<const TrajectorySpline> spline;
+    bool complete{false}; // if the trajectory covered the whole window
+    ros::Time trajectory_end;
+  };
+
+  /**
+   * @brief Gets the spline of a window, fitting it if needed
+   * @return nullptr if the trajectory has less than two knots in the window
+   */
+  std::shared_ptr<const TrajectorySpline>
+      GetWindow(const Trajectory& trajectory, int64_t index);
+
+  Params params_;
+  int64_t knot_interval_ns_;
+  int64_t knots_per_window_;
+
+  std::mutex mutex_;
+  std::map<int64_t, Window> windows_;
+};
+
+} // namespace bs_common
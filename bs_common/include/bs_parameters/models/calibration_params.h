@@ -38,6 +38,15 @@ public:
     ros::param::get("/calibration_params/world_frame", world_frame);
     ros::param::get("/calibration_params/static_extrinsics", static_extrinsics);
 
+    // additional cameras of a multi-camera rig, the camera above is the
+    // primary camera. Their measurements have sensor ids 1, 2, ... in this
+    // order
+    std::vector<std::string> additional_cam_intrinsics_paths_rel;
+    ros::param::get("/calibration_params/additional_camera_intrinsics_paths",
+                    additional_cam_intrinsics_paths_rel);
+    ros::param::get("/calibration_params/additional_camera_frames",
+                    additional_camera_frames);
+
     ros::param::get("/calibration_params/camera_hz", camera_hz);
     ros::param::get("/calibration_params/imu_hz", imu_hz);
     ros::param::get("/calibration_params/lidar_hz", lidar_hz);
@@ -60,6 +69,18 @@ public:
       cam_intrinsics_path = beam::CombinePaths(
           bs_common::GetBeamSlamCalibrationsPath(), cam_intrinsics_path_rel);
     }
+
+    if (additional_cam_intrinsics_paths_rel.size() !=
+        additional_camera_frames.size()) {
+      ROS_ERROR("Number of additional camera intrinsics paths and frames "
+                "don't match.");
+      throw std::runtime_error{"Invalid additional camera calibration."};
+    }
+    additional_cam_intrinsics_paths.clear();
+    for (const auto& path_rel : additional_cam_intrinsics_paths_rel) {
+      additional_cam_intrinsics_paths.push_back(beam::CombinePaths(
+          bs_common::GetBeamSlamCalibrationsPath(), path_rel));
+    }
   }
 
   std::string imu_intrinsics_path{};
@@ -69,6 +90,8 @@ public:
   std::string camera_frame{};
   std::string baselink_frame{};
   std::string world_frame{};
+  std::vector<std::string> additional_cam_intrinsics_paths{};
+  std::vector<std::string> additional_camera_frames{};
   int camera_hz;
   int imu_hz;
   int lidar_hz;
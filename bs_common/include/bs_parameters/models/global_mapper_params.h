@@ -28,6 +28,11 @@ public:
                    false);
     getParam<bool>(nh, "publish_new_scans", publish_new_scans, false);
 
+    /** Topic of the slam chunks, e.g. the output of a SlamChunkRelay when the
+     * global mapper runs on another machine than the local mapper */
+    getParam<std::string>(nh, "slam_chunk_topic", slam_chunk_topic,
+                          "/local_mapper/slam_results");
+
     /** Config path for global mapper.Provide path relative to config folder  */
     std::string global_map_config_rel;
     getParam<std::string>(nh, "global_map_config", global_map_config_rel,
@@ -40,6 +45,7 @@ public:
 
   std::string global_map_config;
   std::string output_path;
+  std::string slam_chunk_topic;
   bool save_global_map_data;
   bool save_submaps;
   bool save_submap_frames;
@@ -27,11 +27,16 @@ public:
      * there aren't any duplicate priors and that the graph is fully connected
      * via IO constraints */
     getParam<bool>(nh, "validate_graph", validate_graph, validate_graph);
+
+    /** Minimum time in seconds between two publications of each cloud, 0 to
+     * publish on every graph update */
+    getParam<double>(nh, "publish_period", publish_period, publish_period);
   }
 
   std::string save_path;
   bool publish{true};
   bool validate_graph{false};
+  double publish_period{0};
 };
 
 }} // namespace bs_parameters::models
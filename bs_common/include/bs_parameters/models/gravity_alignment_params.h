@@ -35,6 +35,31 @@ public:
     getParamRequired<std::string>(nh, "constraint_odom_topic",
                                   constraint_odom_topic);
 
+    // if greater than 0, the gravity direction of each constraint is averaged
+    // over the imu samples in this window before the odometry stamp, instead
+    // of using the closest sample
+    getParam<double>(nh, "averaging_window_s", averaging_window_s,
+                     averaging_window_s);
+
+    // minimum time between constraints, odometry messages that arrive sooner
+    // after the last constraint are skipped. Set this to the keyframe period
+    // to only add one constraint per keyframe
+    getParam<double>(nh, "min_constraint_period_s", min_constraint_period_s,
+                     min_constraint_period_s);
+
+    // windows with a sample above these limits are considered high dynamics,
+    // where the orientation estimate of the imu is unreliable, and no
+    // constraint is added. Only checked if averaging
+    getParam<double>(nh, "max_angular_rate", max_angular_rate,
+                     max_angular_rate);
+    getParam<double>(nh, "max_accel_deviation", max_accel_deviation,
+                     max_accel_deviation);
+
+    // allocate the constraints from a pool, which is reused once the
+    // smoother releases them
+    getParam<bool>(nh, "use_pooled_allocation", use_pooled_allocation,
+                   use_pooled_allocation);
+
     // nominal direction of gravity as measured by the IMU. This is usually
     // positive or negative Z so we have implemented those two options as: '+Z'
     // or '-Z'
@@ -53,6 +78,11 @@ public:
 
   double measurement_buffer_duration{10.0};
   double gravity_information_weight{1.0};
+  double averaging_window_s{0.0};
+  double min_constraint_period_s{0.0};
+  double max_angular_rate{1.0};    // rad/s
+  double max_accel_deviation{2.0}; // m/s^2 from the nominal gravity magnitude
+  bool use_pooled_allocation{false};
   std::string imu_topic{};
   std::string constraint_odom_topic{};
   std::string nominal_gravity_direction{"+Z"};
@@ -19,6 +19,24 @@ public:
                      measurement_buffer_duration, measurement_buffer_duration);
     // imu topic
     getParamRequired<std::string>(nh, "imu_topic", imu_topic);
+    getParam<bool>(nh, "publish_propagated_odometry",
+                   publish_propagated_odometry, publish_propagated_odometry);
+    getParam<bool>(nh, "relinearize_constraints", relinearize_constraints,
+                   relinearize_constraints);
+    getParam<double>(nh, "relinearization_tol_bg", relinearization_tol_bg,
+                     relinearization_tol_bg);
+    getParam<double>(nh, "relinearization_tol_ba", relinearization_tol_ba,
+                     relinearization_tol_ba);
+    getParam<bool>(nh, "use_pooled_allocation", use_pooled_allocation,
+                   use_pooled_allocation);
+    getParam<double>(nh, "trigger_coalescing_tolerance",
+                     trigger_coalescing_tolerance,
+                     trigger_coalescing_tolerance);
+    if (trigger_coalescing_tolerance > max_trigger_coalescing_tolerance) {
+      ROS_ERROR("trigger_coalescing_tolerance must be at most %.3f s.",
+                max_trigger_coalescing_tolerance);
+      throw std::runtime_error{"invalid trigger_coalescing_tolerance"};
+    }
 
     std::string info_weights_config;
     getParamRequired<std::string>(ros::NodeHandle("~"),
@@ -36,5 +54,29 @@ public:
   double measurement_buffer_duration{10.0};
   double inertial_information_weight{1.0};
   std::string imu_topic{};
+
+  // publish the latest optimized state propagated to each imu msg, on its own
+  // path which never waits on graph updates
+  bool publish_propagated_odometry{true};
+
+  // re-integrate the imu data of constraints whose start state biases moved
+  // past these tolerances (norm) since they were integrated. Smaller changes
+  // are corrected to first order by the constraints themselves
+  bool relinearize_constraints{false};
+  double relinearization_tol_bg{1e-3};
+  double relinearization_tol_ba{1e-2};
+
+  // allocate the constraints and variables of each imu state from pools of
+  // their types, which are reused once the smoother releases them
+  bool use_pooled_allocation{false};
+
+  // triggers within this time [s] of the last imu constraint, e.g. lidar and
+  // visual keyframes of the same instant, are tied to its state with a zero
+  // motion constraint instead of getting an imu constraint of their own. The
+  // zero motion constraint is tight, so this only holds for near simultaneous
+  // triggers and is capped at the tolerance used when breaking up
+  // constraints. 0 to disable
+  double trigger_coalescing_tolerance{0.0};
+  static constexpr double max_trigger_coalescing_tolerance{0.005};
 };
 }} // namespace bs_parameters::models
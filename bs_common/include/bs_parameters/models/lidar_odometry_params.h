@@ -28,6 +28,16 @@ public:
     /** Input lidar topic */
     getParamRequired<std::string>(nh, "input_topic", input_topic);
 
+    /** Frame of the lidar publishing to the input topic. Leave empty to use
+     * the lidar frame from the extrinsics. To fuse multiple lidars, run one
+     * lidar odometry per lidar, each with its own lidar frame and input topic,
+     * and give them the same registration_map_name so each lidar is registered
+     * against the map built from all of them. Each instance runs its own
+     * filter and feature extraction pipeline on its own callback thread. Scans
+     * in a map are keyed by stamp, so lidars sharing a map must not publish
+     * scans with the exact same stamp. */
+    getParam<std::string>(nh, "lidar_frame", lidar_frame, lidar_frame);
+
     /** If set to true, it will output the loam points of the marginalized scan
      * poses */
     getParam<bool>(nh, "output_loam_points", output_loam_points,
@@ -38,10 +48,49 @@ public:
     getParam<bool>(nh, "output_lidar_points", output_lidar_points,
                    output_lidar_points);
 
+    /** If set to true, output lidar and loam points are sent as packed float32
+     * clouds instead of arrays of geometry_msgs/Vector3 */
+    getParam<bool>(nh, "pack_output_points", pack_output_points,
+                   pack_output_points);
+
     /** If set to true, it will output all points in the registration map */
     getParam<bool>(nh, "publish_registration_map", publish_registration_map,
                    publish_registration_map);
 
+    /** Min time in seconds between publishing the full registration map. New
+     * scans are still published as they get added to the map */
+    getParam<double>(nh, "registration_map_publish_period",
+                     registration_map_publish_period,
+                     registration_map_publish_period);
+
+    /** Name of the registration map to register scans against. Models using
+     * the same name share a map, so this should only be changed (e.g., to run
+     * one lidar odometry per lidar) if the map should not be shared with the
+     * other models. Leave empty to use the map filled by slam initialization */
+    getParam<std::string>(nh, "registration_map_name", registration_map_name,
+                          registration_map_name);
+
+    /** Localization only mode: if set, scans are registered only against this
+     * global map saved by a previous session (with its map store) and give
+     * absolute pose constraints in its world frame, no registration map is
+     * built. The robot must be initialized in the map (e.g., init_mode
+     * PRIOR_MAP in slam initialization), and the registration must be
+     * SCANTOMAP with the loam matcher. Only the submaps within
+     * prior_map_tile_radius_m are paged in, and they are only updated once the
+     * robot moved prior_map_update_distance_m. The global mapper is not needed
+     * in this mode */
+    getParam<std::string>(nh, "prior_map_path", prior_map_path,
+                          prior_map_path);
+    getParam<double>(nh, "prior_map_tile_radius_m", prior_map_tile_radius_m,
+                     prior_map_tile_radius_m);
+    getParam<double>(nh, "prior_map_update_distance_m",
+                     prior_map_update_distance_m, prior_map_update_distance_m);
+    getParam<double>(nh, "prior_map_downsample_voxel_size",
+                     prior_map_downsample_voxel_size,
+                     prior_map_downsample_voxel_size);
+    getParam<double>(nh, "prior_map_memory_budget_mb",
+                     prior_map_memory_budget_mb, prior_map_memory_budget_mb);
+
     getParam<bool>(nh, "save_graph_updates", save_graph_updates,
                    save_graph_updates);
 
@@ -52,11 +101,112 @@ public:
     getParam<bool>(nh, "save_marginalized_scans", save_marginalized_scans,
                    save_marginalized_scans);
 
+    /** Number of background threads writing the saved scans and graph
+     * updates. If set to 0, outputs are written in the graph update callback */
+    getParam<int>(nh, "output_writer_threads", output_writer_threads,
+                  output_writer_threads);
+
+    /** Max number of outputs waiting to be written, per output type */
+    getParam<int>(nh, "output_queue_size", output_queue_size,
+                  output_queue_size);
+
+    /** If set to true, marginalized scans are dropped when the output queue is
+     * full, otherwise the graph update callback waits for the writer */
+    getParam<bool>(nh, "drop_marginalized_scans_when_full",
+                   drop_marginalized_scans_when_full,
+                   drop_marginalized_scans_when_full);
+
+    /** Same as above, for graph updates */
+    getParam<bool>(nh, "drop_graph_updates_when_full",
+                   drop_graph_updates_when_full, drop_graph_updates_when_full);
+
+    /** If set to true, saved scans are written as compressed binary PCD */
+    getParam<bool>(nh, "compress_output_clouds", compress_output_clouds,
+                   compress_output_clouds);
+
+    /** Sync the output file system every this many outputs, 0 to never sync
+     * (the OS decides when to write to disk) */
+    getParam<int>(nh, "output_sync_batch_size", output_sync_batch_size,
+                  output_sync_batch_size);
+
+    /** Min time between scans while the optimizer requests back-pressure,
+     * scans closer than this to the last scan get dropped */
+    getParam<double>(nh, "backpressure_min_scan_period",
+                     backpressure_min_scan_period,
+                     backpressure_min_scan_period);
+
+    /** Number of threads used to extract loam features. If greater than 1,
+     * the rings of each scan are split over this many threads. */
+    getParam<int>(nh, "feature_extraction_threads",
+                  feature_extraction_threads, feature_extraction_threads);
+
+    /** If greater than 0 and features are extracted on multiple threads,
+     * scans are organized into a range image with this many azimuth bins per
+     * ring before extracting features (e.g., the horizontal resolution of the
+     * lidar). Points of a ring are then in azimuth order even if the driver
+     * output isn't, and points sharing a bin are reduced to the closest */
+    getParam<int>(nh, "range_image_columns", range_image_columns,
+                  range_image_columns);
+
+    /** Max strong edge and surface features kept per scan when using the
+     * loam matcher, 0 for no limit. A capped class keeps features spread over
+     * feature_budget_buckets azimuth buckets, favouring far features, so the
+     * registration time is bounded in feature rich environments */
+    getParam<int>(nh, "feature_budget_edges", feature_budget_edges,
+                  feature_budget_edges);
+    getParam<int>(nh, "feature_budget_surfaces", feature_budget_surfaces,
+                  feature_budget_surfaces);
+    getParam<int>(nh, "feature_budget_buckets", feature_budget_buckets,
+                  feature_budget_buckets);
+    if (feature_budget_buckets < 1) {
+      ROS_ERROR("feature_budget_buckets must be at least 1.");
+      throw std::runtime_error{"invalid feature_budget_buckets"};
+    }
+
+    /** If set to true, scans are projected to lean points (position, ring and
+     * intensity) before filtering and feature extraction, which reduces the
+     * memory read by each pass. Only used if the input filters are crop box,
+     * voxel or ROR filters and features are extracted on multiple threads (or
+     * not at all) */
+    getParam<bool>(nh, "lean_points", lean_points, lean_points);
+
+    /** If set to true, features of each scan are extracted while the previous
+     * scan is still being registered */
+    getParam<bool>(nh, "pipeline_scan_processing", pipeline_scan_processing,
+                   pipeline_scan_processing);
+
+    /** If set to true, scans are scheduled based on the processing load. While
+     * registering takes longer than scheduler_max_load times the scan period,
+     * or scans are queuing up, only keyframes are registered and the poses of
+     * other scans are tracked with the frame initializer. If the scan buffer
+     * is full, non-keyframes are skipped. The active mode is published on the
+     * scheduler_mode topic. */
+    getParam<bool>(nh, "adaptive_scheduling", adaptive_scheduling,
+                   adaptive_scheduling);
+
+    /** Max ratio of registration time to scan period before only registering
+     * keyframes */
+    getParam<double>(nh, "scheduler_max_load", scheduler_max_load,
+                     scheduler_max_load);
+
+    /** Min motion from the last registered scan (estimated by the frame
+     * initializer) for a scan to be a keyframe. A scan is a keyframe if it
+     * passes either threshold. */
+    getParam<double>(nh, "keyframe_min_translation_m",
+                     keyframe_min_translation_m, keyframe_min_translation_m);
+    getParam<double>(nh, "keyframe_min_rotation_deg", keyframe_min_rotation_deg,
+                     keyframe_min_rotation_deg);
+
     // send a trigger to IO to set IMU relative state constraint
     getParam<bool>(nh, "trigger_inertial_odom_constraints",
                    trigger_inertial_odom_constraints,
                    trigger_inertial_odom_constraints);
 
+    /** Allocate the constraints and variables of each scan from pools of
+     * their types, which are reused once the smoother releases them */
+    getParam<bool>(nh, "use_pooled_allocation", use_pooled_allocation,
+                   use_pooled_allocation);
+
     /** Outputs scans as PCD files IFF not empty */
     getParam<std::string>(nh, "scan_output_directory", scan_output_directory,
                           scan_output_directory);
@@ -145,20 +295,48 @@ public:
 
   // General params
   std::string input_topic;
+  std::string lidar_frame{""};
   std::string frame_initializer_config{""};
   std::string input_filters_config{""};
   std::string scan_output_directory{""};
+  std::string registration_map_name{""};
+  std::string prior_map_path{""};
 
   double lidar_information_weight{1.0};
   double prior_information_weight{0};
+  double backpressure_min_scan_period{0.2};
+  double registration_map_publish_period{1.0};
+  double scheduler_max_load{0.8};
+  double keyframe_min_translation_m{0.2};
+  double keyframe_min_rotation_deg{5};
+  double prior_map_tile_radius_m{60};
+  double prior_map_update_distance_m{5};
+  double prior_map_downsample_voxel_size{-1};
+  double prior_map_memory_budget_mb{1024};
+  int feature_extraction_threads{1};
+  int range_image_columns{0};
+  int feature_budget_edges{0};
+  int feature_budget_surfaces{0};
+  int feature_budget_buckets{36};
+  int output_writer_threads{1};
+  int output_queue_size{50};
+  int output_sync_batch_size{0};
 
   bool trigger_inertial_odom_constraints{true};
   bool output_loam_points{true};
   bool output_lidar_points{true};
+  bool pack_output_points{true};
   bool publish_registration_map{false};
   bool save_graph_updates{false};
   bool save_scan_registration_results{false};
   bool save_marginalized_scans{true};
+  bool pipeline_scan_processing{false};
+  bool lean_points{false};
+  bool adaptive_scheduling{false};
+  bool drop_marginalized_scans_when_full{false};
+  bool drop_graph_updates_when_full{true};
+  bool compress_output_clouds{false};
+  bool use_pooled_allocation{false};
 
   LidarType lidar_type{LidarType::VELODYNE};
 
@@ -25,6 +25,11 @@ public:
     /** Input lidar topic (distorted) */
     getParamRequired<std::string>(nh, "input_topic", input_topic);
 
+    /** Frame of the lidar publishing to the input topic, this is the frame
+     * scans are deskewed to. Leave empty to use the lidar frame from the
+     * extrinsics. Run one deskewer per lidar when using multiple lidars */
+    getParam<std::string>(nh, "lidar_frame", lidar_frame, lidar_frame);
+
     /** While waiting for IMU data, we will store a scan queue with this buffer
      * size */
     getParam<int>(nh, "scan_buffer_size", scan_buffer_size, scan_buffer_size);
@@ -45,6 +50,17 @@ public:
       lidar_type = iter->second;
     }
 
+    /**
+     * Number of poses to sample from the frame initializer over each sweep.
+     * Point poses are interpolated between these knots instead of looking up
+     * the trajectory for each point. Must be at least 2.
+     */
+    getParam<int>(nh, "num_pose_knots", num_pose_knots, num_pose_knots);
+    if (num_pose_knots < 2) {
+      ROS_ERROR("num_pose_knots must be at least 2, using default (10)");
+      num_pose_knots = 10;
+    }
+
     std::string frame_initializer_config_rel;
     getParam<std::string>(nh, "frame_initializer_config",
                           frame_initializer_config_rel,
@@ -56,7 +72,9 @@ public:
   }
 
   int scan_buffer_size{5};
+  int num_pose_knots{10};
   std::string input_topic;
+  std::string lidar_frame{""};
   LidarType lidar_type{LidarType::VELODYNE};
   std::string frame_initializer_config{""};
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ros/param.h>
+
+#include <bs_parameters/parameter_base.h>
+
+namespace bs_parameters { namespace models {
+
+/**
+ * @brief Defines the set of parameters required by the SlamChunkRelay class
+ */
+struct SlamChunkRelayParams : public ParameterBase {
+public:
+  /**
+   * @brief Method for loading parameter values from ROS.
+   *
+   * @param[in] nh - The ROS node handle with which to load parameters
+   */
+  void loadFromROS(const ros::NodeHandle& nh) final {
+    /** Topic of the slam chunks of the local mapper */
+    getParam<std::string>(nh, "input_topic", input_topic, input_topic);
+
+    /** Bandwidth budget of the chunks in kilobits per second, 0 to send all
+     * chunks in full (with compressed images) */
+    getParam<double>(nh, "budget_kbps", budget_kbps, budget_kbps);
+
+    /** Max time in seconds of budget saved while chunks are small */
+    getParam<double>(nh, "burst_s", burst_s, burst_s);
+
+    /** JPEG quality of the images, lowered down to min_jpeg_quality by
+     * quality_step while chunks do not fit in the budget */
+    getParam<int>(nh, "jpeg_quality", jpeg_quality, jpeg_quality);
+    getParam<int>(nh, "min_jpeg_quality", min_jpeg_quality, min_jpeg_quality);
+    getParam<int>(nh, "quality_step", quality_step, quality_step);
+  }
+
+  std::string input_topic{"/local_mapper/slam_results"};
+  double budget_kbps{0};
+  double burst_s{2};
+  int jpeg_quality{90};
+  int min_jpeg_quality{40};
+  int quality_step{10};
+};
+
+}} // namespace bs_parameters::models
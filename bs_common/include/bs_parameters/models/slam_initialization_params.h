@@ -42,10 +42,59 @@ public:
     // path to optional output folder
     getParam<std::string>(nh, "output_folder", output_folder, output_folder);
 
-    // mode for initializing, options: VISUAL, LIDAR
+    // mode for initializing, options: VISUAL, LIDAR, PRIOR_MAP
     getParam<std::string>(nh, "init_mode", init_mode, init_mode);
-    if (init_mode != "VISUAL" && init_mode != "LIDAR") {
-      ROS_ERROR("Invalid init mode type, options: 'VISUAL', 'LIDAR'.");
+    if (init_mode != "VISUAL" && init_mode != "LIDAR" &&
+        init_mode != "PRIOR_MAP") {
+      ROS_ERROR("Invalid init mode type, options: 'VISUAL', 'LIDAR', "
+                "'PRIOR_MAP'.");
+    }
+
+    // PRIOR_MAP: global map saved by a previous session to relocalize in, and
+    // the reloc configs relative to the config folder (defaults if empty)
+    getParam<std::string>(nh, "prior_map_path", prior_map_path,
+                          prior_map_path);
+    std::string prior_map_candidate_search_config_rel;
+    getParam<std::string>(nh, "prior_map_candidate_search_config",
+                          prior_map_candidate_search_config_rel,
+                          prior_map_candidate_search_config_rel);
+    if (!prior_map_candidate_search_config_rel.empty()) {
+      prior_map_candidate_search_config =
+          beam::CombinePaths(bs_common::GetBeamSlamConfigPath(),
+                             prior_map_candidate_search_config_rel);
+    }
+    std::string prior_map_refinement_config_rel;
+    getParam<std::string>(nh, "prior_map_refinement_config",
+                          prior_map_refinement_config_rel,
+                          prior_map_refinement_config_rel);
+    if (!prior_map_refinement_config_rel.empty()) {
+      prior_map_refinement_config = beam::CombinePaths(
+          bs_common::GetBeamSlamConfigPath(), prior_map_refinement_config_rel);
+    }
+
+    // max memory of the prior map lidar clouds paged in to relocalize
+    getParam<double>(nh, "prior_map_memory_budget_mb",
+                     prior_map_memory_budget_mb, prior_map_memory_budget_mb);
+
+    // number of scans to try relocalizing before falling back to LIDAR init
+    getParam<int>(nh, "prior_map_max_attempts", prior_map_max_attempts,
+                  prior_map_max_attempts);
+
+    // after a fast reset of the optimizer (see bs_common::ResetContext),
+    // initialize immediately from the last good state instead of running the
+    // initialization again. Not supported by VisualOdometry, which needs the
+    // landmarks of a full initialization
+    getParam<bool>(nh, "reignite_after_fast_reset", reignite_after_fast_reset,
+                   reignite_after_fast_reset);
+
+    // method for estimating gravity, scale and velocities from the init path,
+    // options: QR, CLOSED_FORM
+    getParam<std::string>(nh, "inertial_alignment_method",
+                          inertial_alignment_method, inertial_alignment_method);
+    if (inertial_alignment_method != "QR" &&
+        inertial_alignment_method != "CLOSED_FORM") {
+      ROS_ERROR("Invalid inertial alignment method, options: 'QR', "
+                "'CLOSED_FORM'.");
     }
 
     // maximum optimizaiton time in seconds
@@ -75,6 +124,12 @@ public:
                                           matcher_config_rel);
     }
 
+    // number of threads used to filter scans and extract their features for
+    // lidar initialization. If greater than 1, buffered scans are prepared in
+    // parallel while the scans before them are registered
+    getParam<int>(nh, "lidar_init_threads", lidar_init_threads,
+                  lidar_init_threads);
+
     /// Load all information matrix weights for the optimization problem
     std::string info_weights_config;
 
@@ -145,6 +200,8 @@ public:
                        local_map_matching);
     getParamJson<bool>(J, "use_online_calibration", use_online_calibration,
                        use_online_calibration);
+    getParamJson<int>(J, "triangulation_threads", triangulation_threads,
+                      triangulation_threads);
   }
 
   std::string visual_measurement_topic{"/feature_tracker/visual_measurements"};
@@ -153,8 +210,18 @@ public:
   std::string frame_initializer_config{""};
   std::string init_mode{"FRAMEINIT"};
   std::string output_folder{""};
+  std::string inertial_alignment_method{"QR"};
 
   std::string matcher_config;
+  int lidar_init_threads{1};
+
+  // prior map init
+  std::string prior_map_path{""};
+  std::string prior_map_candidate_search_config{""};
+  std::string prior_map_refinement_config{""};
+  double prior_map_memory_budget_mb{1024};
+  int prior_map_max_attempts{10};
+  bool reignite_after_fast_reset{false};
   double max_optimization_s{1.0};
 
   // optimization weights
@@ -175,6 +242,7 @@ public:
   double max_triangulation_distance{30.0};
   double max_triangulation_reprojection{40.0};
   double track_outlier_pixel_threshold{1.0};
+  int triangulation_threads{1};
   fuse_core::Loss::SharedPtr reprojection_loss;
 };
 }} // namespace bs_parameters::models
@@ -39,11 +39,56 @@ public:
     tracker_config = beam::CombinePaths(bs_common::GetBeamSlamConfigPath(),
                                         tracker_config_rel);
 
+    // Options: raw, compressed. If compressed, the JPEG or PNG images that
+    // image_transport publishes on image_topic/compressed are subscribed to
+    // instead of the raw images
+    getParam<std::string>(nh, "image_transport", image_transport,
+                          image_transport);
+
+    // sensor id of the camera, landmark ids are made unique across the
+    // cameras of a multi-camera rig with it. Each camera of a rig has its own
+    // tracker, with its own measurement topic and camera frame
     getParam<int>(nh, "sensor_id", sensor_id, 0);
+    getParam<std::string>(nh, "measurement_topic", measurement_topic,
+                          measurement_topic);
+
+    // camera frame of the measurements, the calibration camera frame if empty
+    getParam<std::string>(nh, "camera_frame", camera_frame, camera_frame);
+
+    // Options: CPU, CUDA. The CUDA backend needs OpenCV built with CUDA, else
+    // this falls back to the CPU backend
+    getParam<std::string>(nh, "tracker_backend", tracker_backend,
+                          tracker_backend);
+
+    // If true, landmark measurements are sent in the packed arrays of the
+    // camera measurement message instead of one message per landmark
+    getParam<bool>(nh, "pack_measurements", pack_measurements,
+                   pack_measurements);
+
+    // If true, the measurements of an image are published as soon as it is
+    // tracked instead of after the next image. Landmarks that the next image
+    // adds to the image are then published in an update message for it
+    getParam<bool>(nh, "publish_immediately", publish_immediately,
+                   publish_immediately);
+
+    // If true, decoding and preprocessing, tracking and publishing run on
+    // separate threads connected by bounded queues, instead of all in the
+    // image callback
+    getParam<bool>(nh, "use_pipeline", use_pipeline, use_pipeline);
+
+    // max number of images waiting between two stages of the pipeline, new
+    // images are dropped when the first queue is full
+    getParam<int>(nh, "pipeline_queue_size", pipeline_queue_size,
+                  pipeline_queue_size);
+
+    // number of threads used for decoding and preprocessing images
+    getParam<int>(nh, "num_preprocess_threads", num_preprocess_threads,
+                  num_preprocess_threads);
   }
 
   // subscribing topics
   std::string image_topic{};
+  std::string image_transport{"raw"};
 
   // vision configs
   std::string descriptor_config{};
@@ -51,5 +96,17 @@ public:
   std::string tracker_config{};
 
   int sensor_id{0};
+  std::string measurement_topic{"/feature_tracker/visual_measurements"};
+  std::string camera_frame{};
+
+  std::string tracker_backend{"CPU"};
+
+  bool pack_measurements{true};
+  bool publish_immediately{false};
+
+  // pipeline
+  bool use_pipeline{false};
+  int pipeline_queue_size{4};
+  int num_preprocess_threads{1};
 };
 }} // namespace bs_parameters::models
@@ -54,10 +54,38 @@ public:
                    trigger_inertial_odom_constraints,
                    trigger_inertial_odom_constraints);
 
+    // allocate the pose variables and constraints of each frame from pools of
+    // their types, which are reused once the smoother releases them
+    getParam<bool>(nh, "use_pooled_allocation", use_pooled_allocation,
+                   use_pooled_allocation);
+
+    // min time (s) between publishes of the landmark clouds in standalone
+    // mode, 0 to publish after every keyframe
+    getParam<double>(nh, "landmarks_publish_period", landmarks_publish_period,
+                     landmarks_publish_period);
+
+    // measurement topics of the additional cameras of a multi-camera rig (see
+    // calibration_params), in the same order. The primary camera measurements
+    // are on /feature_tracker/visual_measurements
+    getParam<std::vector<std::string>>(nh, "additional_measurement_topics",
+                                       additional_measurement_topics,
+                                       additional_measurement_topics);
+
+    // max stamp difference (s) between the measurements of the cameras of a
+    // rig for them to be processed as one frame
+    getParam<double>(nh, "frame_set_tolerance", frame_set_tolerance,
+                     frame_set_tolerance);
+
     // keyframe parallax (rotation adjusted as in vins mono)
     getParam<double>(nh, "keyframe_parallax", keyframe_parallax,
                      keyframe_parallax);
 
+    // keyframe parallax is scaled by this while the optimizer requests
+    // back-pressure
+    getParam<double>(nh, "backpressure_keyframe_parallax_scale",
+                     backpressure_keyframe_parallax_scale,
+                     backpressure_keyframe_parallax_scale);
+
     /// Load all information matrix weights for the optimization problem from
     /// the default location
     std::string info_weights_config;
@@ -110,6 +138,9 @@ public:
     }
 
     getParamJson<bool>(J, "use_idp", use_idp, use_idp);
+    getParamJson<double>(J, "idp_conversion_max_depth_std",
+                         idp_conversion_max_depth_std,
+                         idp_conversion_max_depth_std);
     getParamJson<double>(J, "max_triangulation_distance",
                          max_triangulation_distance,
                          max_triangulation_distance);
@@ -126,6 +157,33 @@ public:
     getParamJson<bool>(J, "use_online_calibration", use_online_calibration,
                        use_online_calibration);
 
+    // robust localization: P3P RANSAC before the pose refinement
+    getParamJson<bool>(J, "use_ransac_localization", use_ransac_localization,
+                       use_ransac_localization);
+    getParamJson<int>(J, "ransac_max_iterations", ransac_max_iterations,
+                      ransac_max_iterations);
+    getParamJson<double>(J, "ransac_inlier_threshold", ransac_inlier_threshold,
+                         ransac_inlier_threshold);
+    getParamJson<double>(J, "ransac_confidence", ransac_confidence,
+                         ransac_confidence);
+    getParamJson<int>(J, "localization_threads", localization_threads,
+                      localization_threads);
+    getParamJson<int>(J, "triangulation_threads", triangulation_threads,
+                      triangulation_threads);
+
+    // warm restart: the vo state is saved to checkpoint_path every
+    // checkpoint_period seconds (0 to never save), and restored on startup if
+    // restore_checkpoint is set and the checkpoint is at most
+    // checkpoint_max_age seconds older than the first frame
+    getParamJson<std::string>(J, "checkpoint_path", checkpoint_path,
+                              checkpoint_path);
+    getParamJson<double>(J, "checkpoint_period", checkpoint_period,
+                         checkpoint_period);
+    getParamJson<bool>(J, "restore_checkpoint", restore_checkpoint,
+                       restore_checkpoint);
+    getParamJson<double>(J, "checkpoint_max_age", checkpoint_max_age,
+                         checkpoint_max_age);
+
     if (use_standalone_vo) {
       try {
         beam::ValidateJsonKeysOrThrow({"standalone_vo_params"}, J);
@@ -152,17 +210,39 @@ public:
   // yaml vo params
   bool use_standalone_vo{false};
   bool trigger_inertial_odom_constraints{true};
+  bool use_pooled_allocation{false};
   double keyframe_parallax{20.0};
+  double backpressure_keyframe_parallax_scale{2.0};
+  double landmarks_publish_period{1.0};
+  std::vector<std::string> additional_measurement_topics{};
+  double frame_set_tolerance{0.005};
 
   // main vo params
   bool use_online_calibration{false};
   bool use_idp{false};
+  // inverse depth landmarks are converted to euclidean once their estimated
+  // relative depth standard deviation is below this, 0 to disable
+  double idp_conversion_max_depth_std{0};
   bool local_map_matching{false};
   double max_triangulation_distance{30.0};
   double max_triangulation_reprojection{30.0};
   double reprojection_information_weight{1.0};
   double track_outlier_pixel_threshold{1.0};
   int required_points_to_refine{30};
+  int triangulation_threads{1};
+
+  // robust localization params
+  bool use_ransac_localization{false};
+  int ransac_max_iterations{200};
+  double ransac_inlier_threshold{5.0};
+  double ransac_confidence{0.99};
+  int localization_threads{1};
+
+  // warm restart params
+  std::string checkpoint_path{};
+  double checkpoint_period{10.0};
+  bool restore_checkpoint{false};
+  double checkpoint_max_age{60.0};
 
   // vo params used only when standalone vo is true
   double marginalization_prior_weight{1e-9};
@@ -23,6 +23,9 @@ public:
     getParam<bool>(nh, "publish_tf", publish_tf, true);
     getParam<bool>(nh, "predict_to_current_time", predict_to_current_time,
                    false);
+    getParam<double>(nh, "max_prediction_time", max_prediction_time, 0.5);
+    getParam<bool>(nh, "publish_predicted_odometry",
+                   publish_predicted_odometry, false);
     getParam<double>(nh, "tf_publish_frequency", tf_publish_frequency, 10);
 
     double tf_cache_time_double;
@@ -64,10 +67,24 @@ public:
 
     fuse_core::loadCovarianceOptionsFromROS(
         ros::NodeHandle(nh, "covariance_options"), covariance_options);
+    getParam<int>(nh, "covariance_threads", covariance_threads, 1);
+
+    double covariance_period_double;
+    getParam<double>(nh, "covariance_period", covariance_period_double, 1.0);
+    covariance_period.fromSec(covariance_period_double);
   }
 
   bool publish_tf;
   bool predict_to_current_time;
+
+  /** maximum time in seconds the latest state is predicted forward, 0 for no
+   * limit */
+  double max_prediction_time;
+
+  /** if predicting to the current time, publish the predicted odometry at the
+   * tf publish frequency instead of the optimized odometry */
+  bool publish_predicted_odometry;
+
   double tf_publish_frequency;
   ros::Duration tf_cache_time;
   ros::Duration tf_timeout;
@@ -79,6 +96,15 @@ public:
   std::string world_frame_id;
   std::string topic;
   ceres::Covariance::Options covariance_options;
+
+  /** number of threads computing the covariance blocks, overrides
+   * covariance_options/num_threads. 0 uses as many as the shared
+   * bs_common::TaskScheduler has workers */
+  int covariance_threads;
+
+  /** minimum time between two covariance computations, the latest covariance
+   * is published with the states in between */
+  ros::Duration covariance_period;
 };
 
 }} // namespace bs_parameters::publishers
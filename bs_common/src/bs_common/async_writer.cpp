@@ -0,0 +1,129 @@
+#include <bs_common/async_writer.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <beam_utils/log.h>
+
+namespace bs_common {
+
+AsyncWriter::AsyncWriter(const std::string& output_directory,
+                         const Params& params)
+    : output_directory_(output_directory), params_(params) {
+  if (params_.queue_size == 0) { params_.queue_size = 1; }
+  for (int i = 0; i < params_.num_threads; i++) {
+    workers_.emplace_back(&AsyncWriter::Run, this);
+  }
+}
+
+AsyncWriter::~AsyncWriter() {
+  Flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_added_.notify_all();
+  for (auto& worker : workers_) { worker.join(); }
+  if (num_dropped_ > 0) {
+    BEAM_WARN("Dropped {} outputs to {}, writer queue was full",
+              num_dropped_.load(), output_directory_);
+  }
+}
+
+bool AsyncWriter::Enqueue(std::function<void()> task) {
+  if (workers_.empty()) {
+    RunTask(task);
+    return true;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (tasks_.size() >= params_.queue_size) {
+      if (params_.policy == Policy::DROP) {
+        num_dropped_++;
+        return false;
+      }
+      task_done_.wait(
+          lock, [this]() { return tasks_.size() < params_.queue_size; });
+    }
+    tasks_.push_back(std::move(task));
+  }
+  task_added_.notify_one();
+  return true;
+}
+
+void AsyncWriter::Flush() {
+  bool sync{false};
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_done_.wait(
+        lock, [this]() { return tasks_.empty() && num_in_progress_ == 0; });
+    if (params_.sync_batch_size > 0 && num_unsynced_ > 0) {
+      num_unsynced_ = 0;
+      sync = true;
+    }
+  }
+  if (sync) { Sync(); }
+}
+
+void AsyncWriter::Run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_added_.wait(lock,
+                       [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) { return; }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      num_in_progress_++;
+    }
+    // a full queue may be waiting for this spot
+    task_done_.notify_all();
+
+    RunTask(task);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_in_progress_--;
+    }
+    task_done_.notify_all();
+  }
+}
+
+void AsyncWriter::RunTask(const std::function<void()>& task) {
+  try {
+    task();
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Failed to write output to {}: {}", output_directory_,
+               e.what());
+  }
+
+  if (params_.sync_batch_size <= 0) { return; }
+  bool sync{false};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_unsynced_++;
+    if (num_unsynced_ >= params_.sync_batch_size) {
+      num_unsynced_ = 0;
+      sync = true;
+    }
+  }
+  if (sync) { Sync(); }
+}
+
+void AsyncWriter::Sync() const {
+  // syncs the whole file system of the output directory, which is one call
+  // for the full batch instead of one fsync per file
+  int fd = ::open(output_directory_.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    BEAM_ERROR("Cannot open output directory for syncing: {}",
+               output_directory_);
+    return;
+  }
+  if (::syncfs(fd) != 0) {
+    BEAM_ERROR("Failed to sync output directory: {}", output_directory_);
+  }
+  ::close(fd);
+}
+
+} // namespace bs_common
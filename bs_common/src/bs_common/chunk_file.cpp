@@ -0,0 +1,235 @@
+#include <bs_common/chunk_file.h>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <beam_utils/log.h>
+
+namespace bs_common {
+
+namespace {
+
+constexpr char kMagic[8] = {'B', 'S', 'C', 'H', 'U', 'N', 'K', '\0'};
+
+// version of the header and index layout, independent of the version of the
+// chunk data which is up to the user
+constexpr uint32_t kFormatVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t version;
+  uint64_t index_offset;
+  uint64_t num_chunks;
+};
+
+bool ChunkLess(const ChunkInfo& a, const ChunkInfo& b) {
+  return a.type < b.type || (a.type == b.type && a.id < b.id);
+}
+
+} // namespace
+
+void ByteWriter::WriteString(const std::string& s) {
+  Write<uint64_t>(s.size());
+  WriteBytes(s.data(), s.size());
+}
+
+void ByteWriter::WriteBytes(const void* data, size_t size) {
+  if (size == 0) { return; }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  data_.insert(data_.end(), bytes, bytes + size);
+}
+
+std::string ByteReader::ReadString() {
+  const uint64_t n = Read<uint64_t>();
+  const uint8_t* bytes = ReadBytes(n);
+  return std::string(reinterpret_cast<const char*>(bytes), n);
+}
+
+const uint8_t* ByteReader::ReadBytes(size_t size) {
+  if (size > Remaining()) {
+    throw std::runtime_error("read past the end of chunk data");
+  }
+  const uint8_t* bytes = data_ + position_;
+  position_ += size;
+  return bytes;
+}
+
+ChunkFileWriter::~ChunkFileWriter() {
+  if (IsOpen()) { Close(); }
+}
+
+bool ChunkFileWriter::Open(const std::string& path, uint32_t version) {
+  if (IsOpen()) { Close(); }
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    BEAM_ERROR("Cannot create chunk file: {}", path);
+    return false;
+  }
+  path_ = path;
+  version_ = version;
+  index_.clear();
+
+  // the header is rewritten with the index location once it is known
+  Header header{};
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  offset_ = sizeof(Header);
+  return file_.good();
+}
+
+bool ChunkFileWriter::AddChunk(uint32_t type, uint64_t id,
+                               const ByteWriter& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!IsOpen()) { return false; }
+  ChunkInfo chunk{type, 0, id, offset_, data.Size()};
+  file_.write(reinterpret_cast<const char*>(data.Data().data()), data.Size());
+  if (!file_.good()) {
+    BEAM_ERROR("Cannot write chunk to file: {}", path_);
+    return false;
+  }
+  index_.push_back(chunk);
+  offset_ += data.Size();
+  return true;
+}
+
+bool ChunkFileWriter::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!IsOpen()) { return false; }
+  std::sort(index_.begin(), index_.end(), ChunkLess);
+  const auto duplicate = std::adjacent_find(
+      index_.begin(), index_.end(), [](const ChunkInfo& a, const ChunkInfo& b) {
+        return a.type == b.type && a.id == b.id;
+      });
+  if (duplicate != index_.end()) {
+    BEAM_WARN("Duplicate chunk with type {} and id {} in file: {}, only the "
+              "first is readable",
+              duplicate->type, duplicate->id, path_);
+  }
+
+  file_.write(reinterpret_cast<const char*>(index_.data()),
+              index_.size() * sizeof(ChunkInfo));
+
+  Header header{};
+  std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+  header.format_version = kFormatVersion;
+  header.version = version_;
+  header.index_offset = offset_;
+  header.num_chunks = index_.size();
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  const bool success = file_.good();
+  file_.close();
+  index_.clear();
+  if (!success) { BEAM_ERROR("Cannot write chunk file index: {}", path_); }
+  return success;
+}
+
+ChunkFileReader::~ChunkFileReader() {
+  Close();
+}
+
+bool ChunkFileReader::Open(const std::string& path) {
+  Close();
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    BEAM_ERROR("Cannot open chunk file: {}", path);
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(Header)) {
+    BEAM_ERROR("Invalid chunk file: {}", path);
+    close(fd);
+    return false;
+  }
+  const size_t size = file_stat.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file open
+  close(fd);
+  if (data == MAP_FAILED) {
+    BEAM_ERROR("Cannot map chunk file: {}", path);
+    return false;
+  }
+  path_ = path;
+  data_ = static_cast<const uint8_t*>(data);
+  size_ = size;
+
+  Header header;
+  std::memcpy(&header, data_, sizeof(Header));
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), header.magic) ||
+      header.format_version != kFormatVersion ||
+      header.index_offset > size_ ||
+      header.num_chunks > (size_ - header.index_offset) / sizeof(ChunkInfo)) {
+    BEAM_ERROR("Invalid or unsupported chunk file: {}", path);
+    Close();
+    return false;
+  }
+  version_ = header.version;
+  index_.resize(header.num_chunks);
+  std::memcpy(index_.data(), data_ + header.index_offset,
+              header.num_chunks * sizeof(ChunkInfo));
+  for (const ChunkInfo& chunk : index_) {
+    if (chunk.offset > header.index_offset ||
+        chunk.size > header.index_offset - chunk.offset) {
+      BEAM_ERROR("Invalid chunk index in chunk file: {}", path);
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void ChunkFileReader::Close() {
+  if (data_) { munmap(const_cast<uint8_t*>(data_), size_); }
+  data_ = nullptr;
+  size_ = 0;
+  version_ = 0;
+  index_.clear();
+}
+
+const ChunkInfo* ChunkFileReader::Find(uint32_t type, uint64_t id) const {
+  const ChunkInfo query{type, 0, id, 0, 0};
+  auto it = std::lower_bound(index_.begin(), index_.end(), query, ChunkLess);
+  if (it == index_.end() || it->type != type || it->id != id) {
+    return nullptr;
+  }
+  return &(*it);
+}
+
+std::vector<ChunkInfo> ChunkFileReader::Chunks(uint32_t type) const {
+  const ChunkInfo first{type, 0, 0, 0, 0};
+  auto begin = std::lower_bound(index_.begin(), index_.end(), first, ChunkLess);
+  auto end = std::find_if(begin, index_.end(), [type](const ChunkInfo& c) {
+    return c.type != type;
+  });
+  return std::vector<ChunkInfo>(begin, end);
+}
+
+ByteReader ChunkFileReader::Read(const ChunkInfo& chunk) const {
+  return ByteReader(data_ + chunk.offset, chunk.size);
+}
+
+void ChunkFileReader::Evict(const ChunkInfo& chunk) const {
+  if (!data_) { return; }
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t start = reinterpret_cast<uintptr_t>(data_ + chunk.offset);
+  const uintptr_t end = start + chunk.size;
+  const uintptr_t first_page = (start + page_size - 1) / page_size * page_size;
+  const uintptr_t last_page = end / page_size * page_size;
+  if (last_page <= first_page) { return; }
+  madvise(reinterpret_cast<void*>(first_page), last_page - first_page,
+          MADV_DONTNEED);
+}
+
+bool ChunkFileReader::IsChunkFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  if (!file.read(magic, sizeof(kMagic))) { return false; }
+  return std::equal(std::begin(kMagic), std::end(kMagic), magic);
+}
+
+} // namespace bs_common
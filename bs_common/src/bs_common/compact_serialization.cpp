@@ -0,0 +1,493 @@
+#include <bs_common/compact_serialization.h>
+
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+
+#include <beam_utils/log.h>
+#include <fuse_core/serialization.h>
+#include <fuse_variables/acceleration_linear_3d_stamped.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <fuse_variables/velocity_angular_3d_stamped.h>
+#include <fuse_variables/velocity_linear_3d_stamped.h>
+#include <pluginlib/class_loader.h>
+
+#include <bs_variables/accel_bias_3d_stamped.h>
+#include <bs_variables/gyro_bias_3d_stamped.h>
+#include <bs_variables/inverse_depth_landmark.h>
+#include <bs_variables/orientation_3d.h>
+#include <bs_variables/point_3d_landmark.h>
+#include <bs_variables/position_3d.h>
+
+namespace bs_common {
+
+namespace {
+
+// type code of objects written with boost serialization
+constexpr uint32_t kBoostCode = 0;
+
+/**
+ * @brief Plugin loaders used to create the objects written with boost
+ * serialization. They are never destroyed so the plugin libraries stay loaded
+ * while the objects exist
+ */
+struct PluginLoaders {
+  std::mutex mutex;
+  pluginlib::ClassLoader<fuse_core::Variable> variables{"fuse_core",
+                                                        "fuse_core::Variable"};
+  pluginlib::ClassLoader<fuse_core::Constraint> constraints{
+      "fuse_core", "fuse_core::Constraint"};
+  pluginlib::ClassLoader<fuse_core::Loss> losses{"fuse_core",
+                                                 "fuse_core::Loss"};
+};
+
+PluginLoaders& Loaders() {
+  static PluginLoaders* loaders = new PluginLoaders();
+  return *loaders;
+}
+
+void WriteStamp(const ros::Time& stamp, ByteWriter& writer) {
+  writer.Write<uint32_t>(stamp.sec);
+  writer.Write<uint32_t>(stamp.nsec);
+}
+
+ros::Time ReadStamp(ByteReader& reader) {
+  const uint32_t sec = reader.Read<uint32_t>();
+  const uint32_t nsec = reader.Read<uint32_t>();
+  return ros::Time(sec, nsec);
+}
+
+template <typename Range, typename Function>
+void WriteRange(const Range& range, ByteWriter& writer, Function write) {
+  writer.Write<uint64_t>(std::distance(range.begin(), range.end()));
+  for (const auto& element : range) { write(element); }
+}
+
+// reads the number of elements of a range, each at least min_size bytes
+uint64_t ReadCount(ByteReader& reader, size_t min_size) {
+  const uint64_t count = reader.Read<uint64_t>();
+  if (count > reader.Remaining() / min_size) {
+    throw std::runtime_error("invalid element count in compact data");
+  }
+  return count;
+}
+
+void CheckVersion(ByteReader& reader) {
+  const uint32_t version = reader.Read<uint32_t>();
+  if (version > kCompactSerializationVersion) {
+    BEAM_ERROR("Compact serialization version {} is newer than supported "
+               "version {}",
+               version, kCompactSerializationVersion);
+    throw std::runtime_error("unsupported compact serialization version");
+  }
+}
+
+template <typename T>
+void WriteBoost(const T& object, ByteWriter& writer) {
+  writer.WriteString(object.type());
+  std::stringstream stream;
+  {
+    fuse_core::BinaryOutputArchive archive(stream);
+    object.serialize(archive);
+  }
+  writer.WriteString(stream.str());
+}
+
+template <typename T>
+std::shared_ptr<T> ReadBoost(ByteReader& reader,
+                             pluginlib::ClassLoader<T>& loader) {
+  const std::string type = reader.ReadString();
+  const std::string data = reader.ReadString();
+  std::shared_ptr<T> object;
+  try {
+    std::lock_guard<std::mutex> lock(Loaders().mutex);
+    object.reset(loader.createUnmanagedInstance(type));
+  } catch (const pluginlib::PluginlibException& e) {
+    BEAM_ERROR("Cannot create object of type {}: {}", type, e.what());
+    throw std::runtime_error("unknown type in compact data");
+  }
+  try {
+    std::stringstream stream(data);
+    fuse_core::BinaryInputArchive archive(stream);
+    object->deserialize(archive);
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Cannot deserialize object of type {}: {}", type, e.what());
+    throw std::runtime_error("invalid boost data in compact data");
+  }
+  return object;
+}
+
+template <typename T>
+void WriteData(const T& variable, ByteWriter& writer) {
+  writer.WriteBytes(variable.data(), T::SIZE * sizeof(double));
+}
+
+template <typename T>
+void ReadData(ByteReader& reader, T& variable) {
+  std::memcpy(variable.data(), reader.ReadBytes(T::SIZE * sizeof(double)),
+              T::SIZE * sizeof(double));
+}
+
+/**
+ * @brief register a variable whose uuid is generated from its stamp and
+ * device id
+ */
+template <typename T>
+void RegisterStampedVariable(CompactSerializer& serializer) {
+  serializer.RegisterVariable(
+      T::detail::type(),
+      [](const fuse_core::Variable& variable, ByteWriter& writer) {
+        const T& v = static_cast<const T&>(variable);
+        WriteStamp(v.stamp(), writer);
+        writer.Write<fuse_core::UUID>(v.deviceId());
+        WriteData(v, writer);
+      },
+      [](ByteReader& reader) -> fuse_core::Variable::SharedPtr {
+        const ros::Time stamp = ReadStamp(reader);
+        const fuse_core::UUID device_id = reader.Read<fuse_core::UUID>();
+        auto v = T::make_shared(stamp, device_id);
+        ReadData(reader, *v);
+        return v;
+      });
+}
+
+/**
+ * @brief register a variable whose uuid is generated from its frame ids
+ */
+template <typename T>
+void RegisterFrameVariable(CompactSerializer& serializer) {
+  serializer.RegisterVariable(
+      T::detail::type(),
+      [](const fuse_core::Variable& variable, ByteWriter& writer) {
+        const T& v = static_cast<const T&>(variable);
+        writer.WriteString(v.child());
+        writer.WriteString(v.parent());
+        WriteData(v, writer);
+      },
+      [](ByteReader& reader) -> fuse_core::Variable::SharedPtr {
+        const std::string child = reader.ReadString();
+        const std::string parent = reader.ReadString();
+        auto v = T::make_shared(child, parent);
+        ReadData(reader, *v);
+        return v;
+      });
+}
+
+} // namespace
+
+uint32_t CompactTypeCode(const std::string& type) {
+  uint32_t hash = 2166136261u;
+  for (const char c : type) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+CompactSerializer& CompactSerializer::Instance() {
+  static CompactSerializer serializer;
+  return serializer;
+}
+
+CompactSerializer::CompactSerializer() {
+  RegisterVariables();
+}
+
+void CompactSerializer::RegisterVariables() {
+  RegisterStampedVariable<fuse_variables::Position3DStamped>(*this);
+  RegisterStampedVariable<fuse_variables::Orientation3DStamped>(*this);
+  RegisterStampedVariable<fuse_variables::VelocityLinear3DStamped>(*this);
+  RegisterStampedVariable<fuse_variables::VelocityAngular3DStamped>(*this);
+  RegisterStampedVariable<fuse_variables::AccelerationLinear3DStamped>(*this);
+  RegisterStampedVariable<bs_variables::GyroscopeBias3DStamped>(*this);
+  RegisterStampedVariable<bs_variables::AccelerationBias3DStamped>(*this);
+  RegisterFrameVariable<bs_variables::Position3D>(*this);
+  RegisterFrameVariable<bs_variables::Orientation3D>(*this);
+
+  RegisterVariable(
+      bs_variables::Point3DLandmark::detail::type(),
+      [](const fuse_core::Variable& variable, ByteWriter& writer) {
+        const auto& v = static_cast<const bs_variables::Point3DLandmark&>(
+            variable);
+        writer.Write<uint64_t>(v.id());
+        writer.WriteMatrix(v.viewing_angle());
+        writer.Write<uint64_t>(v.word_id());
+        WriteData(v, writer);
+      },
+      [](ByteReader& reader) -> fuse_core::Variable::SharedPtr {
+        const uint64_t id = reader.Read<uint64_t>();
+        Eigen::Vector3d viewing_angle;
+        reader.ReadMatrix(viewing_angle);
+        const uint64_t word_id = reader.Read<uint64_t>();
+        auto v = bs_variables::Point3DLandmark::make_shared(id, viewing_angle,
+                                                            word_id);
+        ReadData(reader, *v);
+        return v;
+      });
+
+  RegisterVariable(
+      bs_variables::InverseDepthLandmark::detail::type(),
+      [](const fuse_core::Variable& variable, ByteWriter& writer) {
+        const auto& v =
+            static_cast<const bs_variables::InverseDepthLandmark&>(variable);
+        writer.Write<uint64_t>(v.id());
+        writer.WriteMatrix(v.bearing());
+        WriteStamp(v.anchorStamp(), writer);
+        WriteData(v, writer);
+      },
+      [](ByteReader& reader) -> fuse_core::Variable::SharedPtr {
+        const uint64_t id = reader.Read<uint64_t>();
+        Eigen::Vector3d bearing;
+        reader.ReadMatrix(bearing);
+        const ros::Time anchor_stamp = ReadStamp(reader);
+        auto v = bs_variables::InverseDepthLandmark::make_shared(id, bearing,
+                                                                 anchor_stamp);
+        ReadData(reader, *v);
+        return v;
+      });
+}
+
+uint32_t CompactSerializer::NewCode(const std::string& type) {
+  const uint32_t code = CompactTypeCode(type);
+  const auto iter = types_.find(code);
+  if (code == kBoostCode || (iter != types_.end() && iter->second != type)) {
+    BEAM_ERROR("Compact type code {} of type {} is already used by {}", code,
+               type, iter != types_.end() ? iter->second : "boost");
+    throw std::runtime_error("compact type code collision");
+  }
+  types_[code] = type;
+
+  // types without a codec may have been cached before this registration
+  codes_.clear();
+  return code;
+}
+
+void CompactSerializer::RegisterVariable(const std::string& type,
+                                         VariableWriter writer,
+                                         VariableReader reader) {
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+  variables_[NewCode(type)] = VariableCodec{writer, reader};
+}
+
+void CompactSerializer::RegisterConstraint(const std::string& type,
+                                           ConstraintWriter writer,
+                                           ConstraintReader reader) {
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+  constraints_[NewCode(type)] = ConstraintCodec{writer, reader};
+}
+
+bool CompactSerializer::HasCodec(const std::string& type) const {
+  std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+  const auto iter = types_.find(CompactTypeCode(type));
+  return iter != types_.end() && iter->second == type;
+}
+
+template <typename T>
+uint32_t CompactSerializer::Code(const T& object) const {
+  const std::type_index index(typeid(object));
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    const auto iter = codes_.find(index);
+    if (iter != codes_.end()) { return iter->second; }
+  }
+  const std::string type = object.type();
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+  const uint32_t code = CompactTypeCode(type);
+  const auto iter = types_.find(code);
+  const bool has_codec = iter != types_.end() && iter->second == type;
+  return codes_[index] = has_codec ? code : kBoostCode;
+}
+
+void CompactSerializer::WriteVariable(const fuse_core::Variable& variable,
+                                      ByteWriter& writer) const {
+  const uint32_t code = Code(variable);
+  writer.Write<uint32_t>(code);
+  if (code == kBoostCode) {
+    WriteBoost(variable, writer);
+    return;
+  }
+
+  // codecs are never removed and map nodes are stable, so the codec can be
+  // used without holding the lock
+  const VariableCodec* codec;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    codec = &variables_.at(code);
+  }
+  codec->write(variable, writer);
+}
+
+void CompactSerializer::WriteConstraint(
+    const fuse_core::Constraint& constraint, ByteWriter& writer) const {
+  const uint32_t code = Code(constraint);
+  writer.Write<uint32_t>(code);
+  if (code == kBoostCode) {
+    WriteBoost(constraint, writer);
+    return;
+  }
+  const ConstraintCodec* codec;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    codec = &constraints_.at(code);
+  }
+  codec->write(constraint, writer);
+}
+
+void CompactSerializer::WriteTransaction(
+    const fuse_core::Transaction& transaction, ByteWriter& writer) const {
+  writer.Write<uint32_t>(kCompactSerializationVersion);
+  WriteStamp(transaction.stamp(), writer);
+  WriteRange(transaction.involvedStamps(), writer,
+             [&](const ros::Time& stamp) { WriteStamp(stamp, writer); });
+  WriteRange(transaction.addedVariables(), writer,
+             [&](const fuse_core::Variable& variable) {
+               WriteVariable(variable, writer);
+             });
+  WriteRange(transaction.removedVariables(), writer,
+             [&](const fuse_core::UUID& uuid) {
+               writer.Write<fuse_core::UUID>(uuid);
+             });
+  WriteRange(transaction.addedConstraints(), writer,
+             [&](const fuse_core::Constraint& constraint) {
+               WriteConstraint(constraint, writer);
+             });
+  WriteRange(transaction.removedConstraints(), writer,
+             [&](const fuse_core::UUID& uuid) {
+               writer.Write<fuse_core::UUID>(uuid);
+             });
+}
+
+void CompactSerializer::WriteGraph(const fuse_core::Graph& graph,
+                                   ByteWriter& writer) const {
+  writer.Write<uint32_t>(kCompactSerializationVersion);
+  WriteRange(graph.getVariables(), writer,
+             [&](const fuse_core::Variable& variable) {
+               WriteVariable(variable, writer);
+               writer.Write<uint8_t>(graph.isVariableOnHold(variable.uuid()));
+             });
+  WriteRange(graph.getConstraints(), writer,
+             [&](const fuse_core::Constraint& constraint) {
+               WriteConstraint(constraint, writer);
+             });
+}
+
+fuse_core::Variable::SharedPtr
+    CompactSerializer::ReadVariable(ByteReader& reader) const {
+  const uint32_t code = reader.Read<uint32_t>();
+  if (code == kBoostCode) {
+    return ReadBoost(reader, Loaders().variables);
+  }
+  const VariableCodec* codec;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    const auto iter = variables_.find(code);
+    if (iter == variables_.end()) {
+      BEAM_ERROR("No compact codec for variable type code {}, is the library "
+                 "of the type loaded?",
+                 code);
+      throw std::runtime_error("unknown variable type in compact data");
+    }
+    codec = &iter->second;
+  }
+  return codec->read(reader);
+}
+
+fuse_core::Constraint::SharedPtr
+    CompactSerializer::ReadConstraint(ByteReader& reader) const {
+  const uint32_t code = reader.Read<uint32_t>();
+  if (code == kBoostCode) {
+    return ReadBoost(reader, Loaders().constraints);
+  }
+  const ConstraintCodec* codec;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    const auto iter = constraints_.find(code);
+    if (iter == constraints_.end()) {
+      BEAM_ERROR("No compact codec for constraint type code {}, is the "
+                 "library of the type loaded?",
+                 code);
+      throw std::runtime_error("unknown constraint type in compact data");
+    }
+    codec = &iter->second;
+  }
+  return codec->read(reader);
+}
+
+fuse_core::Transaction::SharedPtr
+    CompactSerializer::ReadTransaction(ByteReader& reader) const {
+  CheckVersion(reader);
+  auto transaction = fuse_core::Transaction::make_shared();
+  transaction->stamp(ReadStamp(reader));
+  uint64_t count = ReadCount(reader, 2 * sizeof(uint32_t));
+  for (uint64_t i = 0; i < count; i++) {
+    transaction->addInvolvedStamp(ReadStamp(reader));
+  }
+  count = ReadCount(reader, sizeof(uint32_t));
+  for (uint64_t i = 0; i < count; i++) {
+    transaction->addVariable(ReadVariable(reader));
+  }
+  count = ReadCount(reader, sizeof(fuse_core::UUID));
+  for (uint64_t i = 0; i < count; i++) {
+    transaction->removeVariable(reader.Read<fuse_core::UUID>());
+  }
+  count = ReadCount(reader, sizeof(uint32_t));
+  for (uint64_t i = 0; i < count; i++) {
+    transaction->addConstraint(ReadConstraint(reader));
+  }
+  count = ReadCount(reader, sizeof(fuse_core::UUID));
+  for (uint64_t i = 0; i < count; i++) {
+    transaction->removeConstraint(reader.Read<fuse_core::UUID>());
+  }
+  return transaction;
+}
+
+void CompactSerializer::ReadGraph(ByteReader& reader,
+                                  fuse_core::Graph& graph) const {
+  CheckVersion(reader);
+  uint64_t count = ReadCount(reader, sizeof(uint32_t));
+  for (uint64_t i = 0; i < count; i++) {
+    const auto variable = ReadVariable(reader);
+    const bool hold = reader.Read<uint8_t>();
+    graph.addVariable(variable);
+    if (hold) { graph.holdVariable(variable->uuid(), true); }
+  }
+  count = ReadCount(reader, sizeof(uint32_t));
+  for (uint64_t i = 0; i < count; i++) {
+    graph.addConstraint(ReadConstraint(reader));
+  }
+}
+
+void WriteConstraintBase(const fuse_core::Constraint& constraint,
+                         ByteWriter& writer) {
+  writer.WriteString(constraint.source());
+  writer.Write<fuse_core::UUID>(constraint.uuid());
+  const auto& variables = constraint.variables();
+  writer.Write<uint64_t>(variables.size());
+  writer.WriteBytes(variables.data(),
+                    variables.size() * sizeof(fuse_core::UUID));
+  WriteLoss(constraint.loss(), writer);
+}
+
+void ReadConstraintBase(ByteReader& reader, std::string& source,
+                        fuse_core::UUID& uuid,
+                        std::vector<fuse_core::UUID>& variables,
+                        fuse_core::Loss::SharedPtr& loss) {
+  source = reader.ReadString();
+  uuid = reader.Read<fuse_core::UUID>();
+  reader.ReadVector(variables);
+  loss = ReadLoss(reader);
+}
+
+void WriteLoss(const fuse_core::Loss::SharedPtr& loss, ByteWriter& writer) {
+  writer.Write<uint8_t>(loss != nullptr);
+  if (loss) { WriteBoost(*loss, writer); }
+}
+
+fuse_core::Loss::SharedPtr ReadLoss(ByteReader& reader) {
+  if (!reader.Read<uint8_t>()) { return nullptr; }
+  return ReadBoost(reader, Loaders().losses);
+}
+
+} // namespace bs_common
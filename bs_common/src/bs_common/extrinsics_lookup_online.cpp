@@ -23,10 +23,29 @@ ExtrinsicsLookupOnline::ExtrinsicsLookupOnline() {
       .baselink = calibration_params_.baselink_frame};
 
   extrinsics_ = std::make_shared<ExtrinsicsLookupBase>(frame_ids);
+
+  frame_ids_[IMU] = frame_ids.imu;
+  frame_ids_[CAMERA] = frame_ids.camera;
+  frame_ids_[LIDAR] = frame_ids.lidar;
+  frame_ids_[BASELINK] = frame_ids.baselink;
+  for (size_t i = 0; i < NUM_FRAMES; i++) {
+    const Frame frame = static_cast<Frame>(i);
+    frames_.emplace(frame_ids_[frame], frame);
+    resolved_frames_[frame] = frames_.at(frame_ids_[frame]);
+  }
+
+  static_transforms_.Store(StaticTransforms());
+  if (!calibration_params_.static_extrinsics) {
+    for (auto& transforms : dynamic_transforms_) {
+      // lookups are close to the latest estimate, so a short history is enough
+      transforms = std::make_unique<TrajectoryBuffer>(ros::Duration(30));
+    }
+  }
 }
 
 void ExtrinsicsLookupOnline::SaveExtrinsicsToJson(
     const std::string& save_filename) {
+  std::lock_guard<std::mutex> lock(mutex_);
   extrinsics_->SaveExtrinsicsToJson(save_filename);
 }
 
@@ -36,6 +55,7 @@ void ExtrinsicsLookupOnline::SaveFrameIdsToJson(
 }
 
 ExtrinsicsLookupBase ExtrinsicsLookupOnline::GetExtrinsicsCopy() {
+  std::lock_guard<std::mutex> lock(mutex_);
   return *extrinsics_;
 }
 
@@ -48,123 +68,188 @@ bool ExtrinsicsLookupOnline::GetTransform(Eigen::Matrix4d& T,
     return true;
   }
 
-  // if dynamic extrinsics, then we want to lookup the extrinsics now and
-  // replace the most recent estimate in ExtrinsicsLookupBase
-  if (!calibration_params_.static_extrinsics) {
-    if (!LookupTransform(T, to_frame, from_frame, time)) { return false; }
-    extrinsics_->SetTransform(T, to_frame, from_frame);
+  const auto to_iter = frames_.find(to_frame);
+  const auto from_iter = frames_.find(from_frame);
+  if (to_iter != frames_.end() && from_iter != frames_.end()) {
+    return GetTransform(T, to_iter->second, from_iter->second, time);
+  }
+
+  // frames that aren't extrinsics are not cached
+  return LookupTransform(T, to_frame, from_frame, time);
+}
+
+bool ExtrinsicsLookupOnline::GetTransform(Eigen::Matrix4d& T, Frame to_frame,
+                                          Frame from_frame,
+                                          const ros::Time& time) {
+  to_frame = resolved_frames_[to_frame];
+  from_frame = resolved_frames_[from_frame];
+  if (to_frame == from_frame) {
+    T = Eigen::Matrix4d::Identity();
     return true;
   }
 
-  // else try to lookup in ExtrinsicsLookupBase
-  if (extrinsics_->GetTransform(T, to_frame, from_frame)) { return true; }
+  if (calibration_params_.static_extrinsics) {
+    return GetStaticTransform(T, to_frame, from_frame);
+  }
+
+  // dynamic extrinsics are chained through baselink so that every sensor only
+  // needs its own estimates
+  Eigen::Matrix4d T_BASELINK_TO;
+  Eigen::Matrix4d T_BASELINK_FROM;
+  if (!GetDynamicT_BASELINK_FRAME(T_BASELINK_TO, to_frame, time) ||
+      !GetDynamicT_BASELINK_FRAME(T_BASELINK_FROM, from_frame, time)) {
+    return false;
+  }
+  T = beam::InvertTransform(T_BASELINK_TO) * T_BASELINK_FROM;
+  SetExtrinsicsCopy(T, to_frame, from_frame);
+  return true;
+}
+
+bool ExtrinsicsLookupOnline::GetStaticTransform(Eigen::Matrix4d& T,
+                                                Frame to_frame,
+                                                Frame from_frame) {
+  const size_t index = to_frame * NUM_FRAMES + from_frame;
+  const auto snapshot = static_transforms_.Load();
+  if (snapshot->set[index]) {
+    T = snapshot->T[index];
+    return true;
+  }
 
   // if that failed, then the transform isn't set, so lets look it up and set it
-  if (!LookupTransform(T, to_frame, from_frame)) { return false; }
-  extrinsics_->SetTransform(T, to_frame, from_frame);
+  if (!LookupTransform(T, frame_ids_[to_frame], frame_ids_[from_frame])) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  StaticTransforms transforms = *static_transforms_.Load();
+  transforms.T[index] = T;
+  transforms.set[index] = true;
+  const size_t inverse_index = from_frame * NUM_FRAMES + to_frame;
+  transforms.T[inverse_index] = beam::InvertTransform(T);
+  transforms.set[inverse_index] = true;
+  static_transforms_.Store(transforms);
+  if (extrinsics_->IsSensorFrameIdValid(frame_ids_[to_frame]) &&
+      extrinsics_->IsSensorFrameIdValid(frame_ids_[from_frame])) {
+    extrinsics_->SetTransform(T, frame_ids_[to_frame], frame_ids_[from_frame]);
+  }
+  return true;
+}
+
+bool ExtrinsicsLookupOnline::GetDynamicT_BASELINK_FRAME(Eigen::Matrix4d& T,
+                                                        Frame frame,
+                                                        const ros::Time& time) {
+  if (frame == resolved_frames_[BASELINK]) {
+    T = Eigen::Matrix4d::Identity();
+    return true;
+  }
+
+  auto& transforms = dynamic_transforms_[frame];
+  auto trajectory = transforms->Get();
+  if (trajectory->Empty()) {
+    // no estimates for this sensor yet, so seed the cache from tf
+    if (!LookupTransform(T, frame_ids_[BASELINK], frame_ids_[frame], time)) {
+      return false;
+    }
+    transforms->Add(time, T);
+    return true;
+  }
+
+  if (time.isZero() || time >= trajectory->EndTime()) {
+    T = (*trajectory)[trajectory->Size() - 1].T();
+  } else if (time <= trajectory->StartTime()) {
+    T = (*trajectory)[0].T();
+  } else {
+    std::string error_msg;
+    trajectory->Get(T, time, error_msg);
+  }
+  return true;
+}
+
+void ExtrinsicsLookupOnline::SetExtrinsicsCopy(const Eigen::Matrix4d& T,
+                                               Frame to_frame,
+                                               Frame from_frame) {
+  const std::string& to_frame_id = frame_ids_[to_frame];
+  const std::string& from_frame_id = frame_ids_[from_frame];
+  if (!extrinsics_->IsSensorFrameIdValid(to_frame_id) ||
+      !extrinsics_->IsSensorFrameIdValid(from_frame_id)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  extrinsics_->SetTransform(T, to_frame_id, from_frame_id);
+}
+
+bool ExtrinsicsLookupOnline::AddT_BASELINK_SENSOR(
+    const Eigen::Matrix4d& T, const std::string& sensor_frame,
+    const ros::Time& time) {
+  if (!extrinsics_->IsSensorFrameIdValid(sensor_frame)) {
+    BEAM_ERROR("Invalid sensor frame id.");
+    return false;
+  }
+  if (calibration_params_.static_extrinsics) { return true; }
+  const Frame frame = resolved_frames_[frames_.at(sensor_frame)];
+  if (frame == resolved_frames_[BASELINK]) { return true; }
+  dynamic_transforms_[frame]->Add(time, T);
   return true;
 }
 
 bool ExtrinsicsLookupOnline::GetT_CAMERA_IMU(Eigen::Matrix4d& T,
                                              const ros::Time& time) {
-  return GetTransform(T, extrinsics_->GetCameraFrameId(),
-                      extrinsics_->GetImuFrameId(), time);
+  return GetTransform(T, CAMERA, IMU, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_IMU_CAMERA(Eigen::Matrix4d& T,
                                              const ros::Time& time) {
-  return GetTransform(T, extrinsics_->GetImuFrameId(),
-                      extrinsics_->GetCameraFrameId(), time);
+  return GetTransform(T, IMU, CAMERA, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_CAMERA_LIDAR(Eigen::Matrix4d& T,
                                                const ros::Time& time) {
-  return GetTransform(T, extrinsics_->GetCameraFrameId(),
-                      extrinsics_->GetLidarFrameId(), time);
+  return GetTransform(T, CAMERA, LIDAR, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_LIDAR_CAMERA(Eigen::Matrix4d& T,
                                                const ros::Time& time) {
-  return GetTransform(T, extrinsics_->GetLidarFrameId(),
-                      extrinsics_->GetCameraFrameId(), time);
+  return GetTransform(T, LIDAR, CAMERA, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_IMU_LIDAR(Eigen::Matrix4d& T,
                                             const ros::Time& time) {
-  return GetTransform(T, extrinsics_->GetImuFrameId(),
-                      extrinsics_->GetLidarFrameId(), time);
+  return GetTransform(T, IMU, LIDAR, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_LIDAR_IMU(Eigen::Matrix4d& T,
                                             const ros::Time& time) {
-  return GetTransform(T, extrinsics_->GetLidarFrameId(),
-                      extrinsics_->GetImuFrameId(), time);
+  return GetTransform(T, LIDAR, IMU, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_BASELINK_IMU(Eigen::Matrix4d& T,
                                                const ros::Time& time) {
-  if (extrinsics_->GetBaselinkFrameId() == extrinsics_->GetImuFrameId()) {
-    T = Eigen::Matrix4d::Identity();
-    return true;
-  }
-
-  return GetTransform(T, extrinsics_->GetBaselinkFrameId(),
-                      extrinsics_->GetImuFrameId(), time);
+  return GetTransform(T, BASELINK, IMU, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_IMU_BASELINK(Eigen::Matrix4d& T,
                                                const ros::Time& time) {
-  if (extrinsics_->GetBaselinkFrameId() == extrinsics_->GetImuFrameId()) {
-    T = Eigen::Matrix4d::Identity();
-    return true;
-  }
-
-  return GetTransform(T, extrinsics_->GetImuFrameId(),
-                      extrinsics_->GetBaselinkFrameId(), time);
+  return GetTransform(T, IMU, BASELINK, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_BASELINK_CAMERA(Eigen::Matrix4d& T,
                                                   const ros::Time& time) {
-  if (extrinsics_->GetBaselinkFrameId() == extrinsics_->GetCameraFrameId()) {
-    T = Eigen::Matrix4d::Identity();
-    return true;
-  }
-
-  return GetTransform(T, extrinsics_->GetBaselinkFrameId(),
-                      extrinsics_->GetCameraFrameId(), time);
+  return GetTransform(T, BASELINK, CAMERA, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_CAMERA_BASELINK(Eigen::Matrix4d& T,
                                                   const ros::Time& time) {
-  if (extrinsics_->GetBaselinkFrameId() == extrinsics_->GetCameraFrameId()) {
-    T = Eigen::Matrix4d::Identity();
-    return true;
-  }
-
-  return GetTransform(T, extrinsics_->GetCameraFrameId(),
-                      extrinsics_->GetBaselinkFrameId(), time);
+  return GetTransform(T, CAMERA, BASELINK, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_BASELINK_LIDAR(Eigen::Matrix4d& T,
                                                  const ros::Time& time) {
-  if (extrinsics_->GetBaselinkFrameId() == extrinsics_->GetLidarFrameId()) {
-    T = Eigen::Matrix4d::Identity();
-    return true;
-  }
-
-  return GetTransform(T, extrinsics_->GetBaselinkFrameId(),
-                      extrinsics_->GetLidarFrameId(), time);
+  return GetTransform(T, BASELINK, LIDAR, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_LIDAR_BASELINK(Eigen::Matrix4d& T,
                                                  const ros::Time& time) {
-  if (extrinsics_->GetBaselinkFrameId() == extrinsics_->GetLidarFrameId()) {
-    T = Eigen::Matrix4d::Identity();
-    return true;
-  }
-
-  return GetTransform(T, extrinsics_->GetLidarFrameId(),
-                      extrinsics_->GetBaselinkFrameId(), time);
+  return GetTransform(T, LIDAR, BASELINK, time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_BASELINK_SENSOR(
@@ -175,7 +260,7 @@ bool ExtrinsicsLookupOnline::GetT_BASELINK_SENSOR(
     return false;
   }
 
-  return GetTransform(T, extrinsics_->GetBaselinkFrameId(), sensor_frame, time);
+  return GetTransform(T, BASELINK, frames_.at(sensor_frame), time);
 }
 
 bool ExtrinsicsLookupOnline::GetT_SENSOR_BASELINK(
@@ -186,7 +271,7 @@ bool ExtrinsicsLookupOnline::GetT_SENSOR_BASELINK(
     return false;
   }
 
-  return GetTransform(T, sensor_frame, extrinsics_->GetBaselinkFrameId(), time);
+  return GetTransform(T, frames_.at(sensor_frame), BASELINK, time);
 }
 
 std::string ExtrinsicsLookupOnline::GetImuFrameId() const {
@@ -224,9 +309,9 @@ bool ExtrinsicsLookupOnline::LookupTransform(Eigen::Matrix4d& T,
                                              const ros::Time& time,
                                              int max_iterations,
                                              const ros::Duration& sleep_time) {
-  if (!tf_listener_) {
+  std::call_once(tf_listener_created_, [this]() {
     tf_listener_ = std::make_unique<tf::TransformListener>();
-  }
+  });
 
   tf::StampedTransform TROS;
   int count = 0;
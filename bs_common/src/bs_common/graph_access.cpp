@@ -3,49 +3,16 @@
 #include <bs_variables/point_3d_landmark.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/graph_snapshot.h>
 #include <bs_variables/inverse_depth_landmark.h>
 
 namespace bs_common {
 
 std::map<int64_t, ImuBiases>
     GetImuBiasesFromGraph(const fuse_core::Graph& graph) {
-  std::map<int64_t, ImuBiases> biases;
-  const auto var_range = graph.getVariables();
-  for (auto it = var_range.begin(); it != var_range.end(); it++) {
-    if (it->type() == "bs_variables::GyroscopeBias3DStamped") {
-      auto v = dynamic_cast<const bs_variables::GyroscopeBias3DStamped&>(*it);
-      int64_t t_ns = v.stamp().toNSec();
-      auto iter = biases.find(t_ns);
-      if (iter == biases.end()) {
-        ImuBiases b;
-        b.g_x = v.x();
-        b.g_y = v.y();
-        b.g_z = v.z();
-        biases.emplace(t_ns, b);
-      } else {
-        iter->second.g_x = v.x();
-        iter->second.g_y = v.y();
-        iter->second.g_z = v.z();
-      }
-    } else if (it->type() == "bs_variables::AccelerationBias3DStamped") {
-      auto v =
-          dynamic_cast<const bs_variables::AccelerationBias3DStamped&>(*it);
-      int64_t t_ns = v.stamp().toNSec();
-      auto iter = biases.find(t_ns);
-      if (iter == biases.end()) {
-        ImuBiases b;
-        b.a_x = v.x();
-        b.a_y = v.y();
-        b.a_z = v.z();
-        biases.emplace(t_ns, b);
-      } else {
-        iter->second.a_x = v.x();
-        iter->second.a_y = v.y();
-        iter->second.a_z = v.z();
-      }
-    }
-  }
-  return biases;
+  ImuBiasCollector collector;
+  VisitGraph(graph, {&collector});
+  return std::move(collector.biases);
 }
 
 void SaveGraphToTxtFile(const fuse_core::Graph& graph,
@@ -187,74 +154,20 @@ fuse_variables::AccelerationLinear3DStamped::SharedPtr
 }
 
 std::set<ros::Time> CurrentTimestamps(const fuse_core::Graph& graph) {
-  std::set<ros::Time> times;
-  for (auto& var : graph.getVariables()) {
-    auto position = fuse_variables::Position3DStamped::make_shared();
-    if (var.type() != position->type()) { continue; }
-    *position = dynamic_cast<const fuse_variables::Position3DStamped&>(var);
-    times.insert(position->stamp());
-  }
-  return times;
+  return GetStampIndex(graph)->ToSet();
 }
 
 std::set<uint64_t> CurrentLandmarkIDs(const fuse_core::Graph& graph) {
-  std::set<uint64_t> ids;
-  for (auto& var : graph.getVariables()) {
-    auto landmark = bs_variables::Point3DLandmark::make_shared();
-    auto inversedepth_landmark =
-        bs_variables::InverseDepthLandmark::make_shared();
-    if (var.type() == landmark->type()) {
-      *landmark = dynamic_cast<const bs_variables::Point3DLandmark&>(var);
-      ids.insert(landmark->id());
-    } else if (var.type() == inversedepth_landmark->type()) {
-      *inversedepth_landmark =
-          dynamic_cast<const bs_variables::InverseDepthLandmark&>(var);
-      ids.insert(inversedepth_landmark->id());
-    }
-  }
-  return ids;
+  LandmarkIdCollector collector;
+  VisitGraph(graph, {&collector});
+  return std::move(collector.landmark_ids);
 }
 
 std::map<ros::Time, Eigen::Matrix4d>
     GetGraphPoses(const fuse_core::Graph& graph) {
-  std::map<ros::Time, Eigen::Matrix4d> poses;
-  const auto var_range = graph.getVariables();
-  for (auto var_it = var_range.begin(); var_it != var_range.end(); var_it++) {
-    if (var_it->type() == "fuse_variables::Position3DStamped") {
-      auto v = dynamic_cast<const fuse_variables::Position3DStamped&>(*var_it);
-      auto pose_it = poses.find(v.stamp());
-      if (pose_it != poses.end()) {
-        pose_it->second(0, 3) = v.x();
-        pose_it->second(1, 3) = v.y();
-        pose_it->second(2, 3) = v.z();
-      } else {
-        Eigen::Matrix4d T_World_Baselink = Eigen::Matrix4d::Identity();
-        T_World_Baselink(0, 3) = v.x();
-        T_World_Baselink(1, 3) = v.y();
-        T_World_Baselink(2, 3) = v.z();
-        poses.emplace(v.stamp(), T_World_Baselink);
-      }
-    } else if (var_it->type() == "fuse_variables::Orientation3DStamped") {
-      auto v =
-          dynamic_cast<const fuse_variables::Orientation3DStamped&>(*var_it);
-      auto pose_it = poses.find(v.stamp());
-      Eigen::Quaterniond q;
-      q.x() = v.x();
-      q.y() = v.y();
-      q.z() = v.z();
-      q.w() = v.w();
-      Eigen::Matrix3d R_World_Baselink(q);
-      if (pose_it != poses.end()) {
-        pose_it->second.block(0, 0, 3, 3) = R_World_Baselink;
-      } else {
-        Eigen::Matrix4d T_World_Baselink = Eigen::Matrix4d::Identity();
-        T_World_Baselink.block(0, 0, 3, 3) = R_World_Baselink;
-        poses.emplace(v.stamp(), T_World_Baselink);
-      }
-    }
-  }
-
-  return poses;
+  PoseCollector collector;
+  VisitGraph(graph, {&collector});
+  return collector.Poses();
 }
 
 bs_variables::Point3DLandmark::SharedPtr
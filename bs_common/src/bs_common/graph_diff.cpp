@@ -0,0 +1,191 @@
+#include <bs_common/graph_diff.h>
+
+#include <algorithm>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/compact_serialization.h>
+
+namespace bs_common {
+
+void GraphDiffEncoder::Encode(const fuse_core::Graph& graph,
+                              const ros::Time& stamp, ByteWriter& data) {
+  const CompactSerializer& serializer = CompactSerializer::Instance();
+  data.Write<uint32_t>(kCompactSerializationVersion);
+  data.Write<uint32_t>(stamp.sec);
+  data.Write<uint32_t>(stamp.nsec);
+
+  // removed objects, the state is updated while writing the added and
+  // modified ones
+  std::vector<fuse_core::UUID> removed;
+  for (const auto& uuid : constraints_) {
+    if (!graph.constraintExists(uuid)) { removed.push_back(uuid); }
+  }
+  for (const auto& uuid : removed) { constraints_.erase(uuid); }
+  data.WriteVector(removed);
+  removed.clear();
+  for (const auto& [uuid, state] : variables_) {
+    if (!graph.variableExists(uuid)) { removed.push_back(uuid); }
+  }
+  for (const auto& uuid : removed) { variables_.erase(uuid); }
+  data.WriteVector(removed);
+
+  ByteWriter added;
+  ByteWriter modified;
+  uint64_t num_added{0};
+  uint64_t num_modified{0};
+  for (const auto& variable : graph.getVariables()) {
+    const bool hold = graph.isVariableOnHold(variable.uuid());
+    auto iter = variables_.find(variable.uuid());
+    if (iter == variables_.end()) {
+      serializer.WriteVariable(variable, added);
+      added.Write<uint8_t>(hold);
+      variables_.emplace(
+          variable.uuid(),
+          VariableState{std::vector<double>(variable.data(),
+                                            variable.data() + variable.size()),
+                        hold});
+      num_added++;
+      continue;
+    }
+
+    VariableState& state = iter->second;
+    if (state.hold == hold &&
+        std::equal(state.data.begin(), state.data.end(), variable.data(),
+                   variable.data() + variable.size())) {
+      continue;
+    }
+    state.data.assign(variable.data(), variable.data() + variable.size());
+    state.hold = hold;
+    modified.Write<fuse_core::UUID>(variable.uuid());
+    modified.WriteVector(state.data);
+    modified.Write<uint8_t>(hold);
+    num_modified++;
+  }
+  data.Write<uint64_t>(num_added);
+  data.WriteBytes(added.Data().data(), added.Size());
+  data.Write<uint64_t>(num_modified);
+  data.WriteBytes(modified.Data().data(), modified.Size());
+
+  added.Clear();
+  num_added = 0;
+  for (const auto& constraint : graph.getConstraints()) {
+    if (!constraints_.insert(constraint.uuid()).second) { continue; }
+    serializer.WriteConstraint(constraint, added);
+    num_added++;
+  }
+  data.Write<uint64_t>(num_added);
+  data.WriteBytes(added.Data().data(), added.Size());
+}
+
+void GraphDiffEncoder::Reset() {
+  variables_.clear();
+  constraints_.clear();
+}
+
+void GraphDiffDecoder::Apply(ByteReader& data, bool snapshot,
+                             ros::Time* stamp, GraphDelta* delta) {
+  const CompactSerializer& serializer = CompactSerializer::Instance();
+  if (data.Read<uint32_t>() != kCompactSerializationVersion) {
+    BEAM_ERROR("Graph update has an unknown compact serialization version");
+    throw std::runtime_error{"invalid graph update"};
+  }
+  const uint32_t sec = data.Read<uint32_t>();
+  const uint32_t nsec = data.Read<uint32_t>();
+  if (stamp) { *stamp = ros::Time(sec, nsec); }
+  if (delta) { delta->Clear(); }
+
+  // a snapshot replaces the whole state, its delta is found by comparing the
+  // variables before and after
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash> previous;
+  if (snapshot) {
+    if (delta) {
+      for (const auto& [uuid, variable] : variables_) { previous.insert(uuid); }
+    }
+    Reset();
+  }
+
+  std::vector<fuse_core::UUID> removed;
+  data.ReadVector(removed);
+  for (const auto& uuid : removed) { constraints_.erase(uuid); }
+  data.ReadVector(removed);
+  for (const auto& uuid : removed) {
+    variables_.erase(uuid);
+    holds_.erase(uuid);
+  }
+  if (delta && !snapshot) { delta->removed_variables = removed; }
+
+  uint64_t count = data.Read<uint64_t>();
+  for (uint64_t i = 0; i < count; i++) {
+    fuse_core::Variable::SharedPtr variable = serializer.ReadVariable(data);
+    holds_[variable->uuid()] = data.Read<uint8_t>();
+    variables_[variable->uuid()] = variable;
+    if (delta && !snapshot) {
+      delta->added_variables.push_back(variable->uuid());
+    }
+  }
+  count = data.Read<uint64_t>();
+  std::vector<double> values;
+  for (uint64_t i = 0; i < count; i++) {
+    const fuse_core::UUID uuid = data.Read<fuse_core::UUID>();
+    data.ReadVector(values);
+    const bool hold = data.Read<uint8_t>();
+    const auto variable = variables_.find(uuid);
+    if (variable == variables_.end() ||
+        variable->second->size() != values.size()) {
+      BEAM_ERROR("Graph update modifies an unknown variable");
+      throw std::runtime_error{"invalid graph update"};
+    }
+    // graphs built before share the variable
+    fuse_core::Variable::SharedPtr copy = variable->second->clone();
+    std::copy(values.begin(), values.end(), copy->data());
+    variable->second = std::move(copy);
+    holds_[uuid] = hold;
+    if (delta) { delta->changed_variables.push_back(uuid); }
+  }
+  count = data.Read<uint64_t>();
+  for (uint64_t i = 0; i < count; i++) {
+    fuse_core::Constraint::SharedPtr constraint =
+        serializer.ReadConstraint(data);
+    constraints_[constraint->uuid()] = constraint;
+  }
+
+  if (delta && snapshot) {
+    for (const auto& [uuid, variable] : variables_) {
+      if (previous.erase(uuid) > 0) {
+        delta->changed_variables.push_back(uuid);
+      } else {
+        delta->added_variables.push_back(uuid);
+      }
+    }
+    delta->removed_variables.assign(previous.begin(), previous.end());
+  }
+  if (delta) { delta->BuildIndex(); }
+}
+
+void GraphDiffDecoder::Build(fuse_core::Graph& graph) const {
+  for (const auto& [uuid, variable] : variables_) {
+    graph.addVariable(variable);
+    if (holds_.at(uuid)) { graph.holdVariable(uuid, true); }
+  }
+  for (const auto& [uuid, constraint] : constraints_) {
+    graph.addConstraint(constraint);
+  }
+}
+
+GraphSnapshot::SharedPtr
+    GraphDiffDecoder::BuildSnapshot(GraphDelta delta) const {
+  auto snapshot = GraphSnapshot::make_shared();
+  Build(*snapshot);
+  snapshot->DeltaMutable() = std::move(delta);
+  snapshot->SetStamps(StampIndex::make_shared(*snapshot));
+  return snapshot;
+}
+
+void GraphDiffDecoder::Reset() {
+  variables_.clear();
+  holds_.clear();
+  constraints_.clear();
+}
+
+} // namespace bs_common
@@ -0,0 +1,173 @@
+#include <bs_common/graph_recorder.h>
+
+#include <algorithm>
+#include <filesystem>
+
+#include <beam_utils/log.h>
+
+
+namespace bs_common {
+
+namespace {
+
+const std::string kSegmentPrefix = "graph_";
+const std::string kSegmentExtension = ".bin";
+
+/**
+ * @brief get the first update of a segment from its file name
+ * @return false if this is not a segment
+ */
+bool SegmentFirstUpdate(const std::filesystem::path& path, uint64_t& update) {
+  const std::string name = path.stem().string();
+  if (path.extension() != kSegmentExtension ||
+      name.compare(0, kSegmentPrefix.size(), kSegmentPrefix) != 0) {
+    return false;
+  }
+  try {
+    update = std::stoull(name.substr(kSegmentPrefix.size()));
+  } catch (const std::exception&) { return false; }
+  return true;
+}
+
+} // namespace
+
+GraphRecorder::GraphRecorder(const std::string& directory,
+                             const Params& params)
+    : directory_(directory), params_(params) {
+  if (params_.snapshot_period < 1) { params_.snapshot_period = 1; }
+  AsyncWriter::Params writer_params;
+  writer_params.queue_size = params_.queue_size;
+  // updates are diffs of the previous one, so they are written in order
+  writer_params.num_threads = 1;
+  writer_params.policy = params_.drop_when_full ? AsyncWriter::Policy::DROP
+                                                : AsyncWriter::Policy::BLOCK;
+  writer_ = std::make_unique<AsyncWriter>(directory_, writer_params);
+}
+
+GraphRecorder::~GraphRecorder() {
+  writer_.reset();
+  CloseSegment();
+}
+
+bool GraphRecorder::Record(fuse_core::Graph::ConstSharedPtr graph,
+                           uint64_t update, const ros::Time& stamp) {
+  return writer_->Enqueue(
+      [this, graph, update, stamp]() { Write(*graph, update, stamp); });
+}
+
+void GraphRecorder::Flush() { writer_->Flush(); }
+
+void GraphRecorder::Write(const fuse_core::Graph& graph, uint64_t update,
+                          const ros::Time& stamp) {
+  // start a new segment with a snapshot, diffs are then taken against an
+  // empty graph
+  if (!segment_.IsOpen() || segment_updates_ >= params_.snapshot_period) {
+    CloseSegment();
+    const std::string path = (std::filesystem::path(directory_) /
+                              (kSegmentPrefix + std::to_string(update) +
+                               kSegmentExtension))
+                                 .string();
+    if (!segment_.Open(path, kGraphRecordingVersion)) {
+      BEAM_ERROR("Cannot open graph recording segment {}", path);
+      return;
+    }
+    segment_updates_ = 0;
+    encoder_.Reset();
+  }
+  const auto type = segment_updates_ == 0 ? GraphRecordingChunkType::SNAPSHOT
+                                          : GraphRecordingChunkType::DIFF;
+
+  ByteWriter data;
+  encoder_.Encode(graph, stamp, data);
+  if (!segment_.AddChunk(static_cast<uint32_t>(type), update, data)) {
+    BEAM_ERROR("Cannot write graph update {} to recording", update);
+  }
+  segment_updates_++;
+}
+
+bool GraphRecorder::CloseSegment() {
+  if (!segment_.IsOpen()) { return true; }
+  if (!segment_.Close()) {
+    BEAM_ERROR("Cannot close graph recording segment in {}", directory_);
+    return false;
+  }
+  return true;
+}
+
+bool GraphRecording::Open(const std::string& directory) {
+  segments_.clear();
+  updates_.clear();
+  if (!std::filesystem::is_directory(directory)) {
+    BEAM_ERROR("Invalid graph recording directory: {}", directory);
+    return false;
+  }
+
+  std::map<uint64_t, std::filesystem::path> paths;
+  for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+    uint64_t first_update;
+    if (SegmentFirstUpdate(entry.path(), first_update)) {
+      paths.emplace(first_update, entry.path());
+    }
+  }
+  for (const auto& [first_update, path] : paths) {
+    auto segment = std::make_unique<ChunkFileReader>();
+    if (!segment->Open(path.string())) {
+      BEAM_WARN("Skipping invalid graph recording segment {}, it may not "
+                "have been closed",
+                path.string());
+      continue;
+    }
+    if (segment->Version() != kGraphRecordingVersion) {
+      BEAM_WARN("Skipping graph recording segment {} of unknown version {}",
+                path.string(), segment->Version());
+      continue;
+    }
+    for (const auto type :
+         {GraphRecordingChunkType::SNAPSHOT, GraphRecordingChunkType::DIFF}) {
+      for (const ChunkInfo& chunk :
+           segment->Chunks(static_cast<uint32_t>(type))) {
+        updates_[chunk.id] = segments_.size();
+      }
+    }
+    segments_.push_back(std::move(segment));
+  }
+  return !segments_.empty();
+}
+
+std::vector<uint64_t> GraphRecording::Updates() const {
+  std::vector<uint64_t> updates;
+  updates.reserve(updates_.size());
+  for (const auto& [update, segment] : updates_) { updates.push_back(update); }
+  return updates;
+}
+
+bool GraphRecording::Read(uint64_t update, fuse_core::Graph& graph,
+                          ros::Time* stamp) const {
+  const auto iter = updates_.find(update);
+  if (iter == updates_.end()) { return false; }
+  const ChunkFileReader& segment = *segments_.at(iter->second);
+  std::vector<ChunkInfo> chunks =
+      segment.Chunks(static_cast<uint32_t>(GraphRecordingChunkType::SNAPSHOT));
+  const std::vector<ChunkInfo> diffs =
+      segment.Chunks(static_cast<uint32_t>(GraphRecordingChunkType::DIFF));
+  if (chunks.size() != 1) {
+    BEAM_ERROR("Graph recording segment must have one snapshot, found {}",
+               chunks.size());
+    throw std::runtime_error{"invalid graph recording"};
+  }
+  for (const ChunkInfo& chunk : diffs) {
+    if (chunk.id <= update) { chunks.push_back(chunk); }
+  }
+
+  GraphDiffDecoder decoder;
+  for (const ChunkInfo& chunk : chunks) {
+    ByteReader data = segment.Read(chunk);
+    const bool snapshot = chunk.type == static_cast<uint32_t>(
+                                            GraphRecordingChunkType::SNAPSHOT);
+    decoder.Apply(data, snapshot, stamp);
+  }
+  decoder.Build(graph);
+  return true;
+}
+
+} // namespace bs_common
@@ -0,0 +1,54 @@
+#include <bs_common/graph_snapshot.h>
+
+namespace bs_common {
+
+bool GraphDelta::Empty() const {
+  return added_variables.empty() && changed_variables.empty() &&
+         removed_variables.empty();
+}
+
+bool GraphDelta::IsUpdated(const fuse_core::UUID& uuid) const {
+  return updated_set_.find(uuid) != updated_set_.end();
+}
+
+bool GraphDelta::IsRemoved(const fuse_core::UUID& uuid) const {
+  return removed_set_.find(uuid) != removed_set_.end();
+}
+
+void GraphDelta::BuildIndex() {
+  updated_set_.clear();
+  removed_set_.clear();
+  updated_set_.insert(added_variables.begin(), added_variables.end());
+  updated_set_.insert(changed_variables.begin(), changed_variables.end());
+  removed_set_.insert(removed_variables.begin(), removed_variables.end());
+}
+
+void GraphDelta::Clear() {
+  added_variables.clear();
+  changed_variables.clear();
+  removed_variables.clear();
+  updated_set_.clear();
+  removed_set_.clear();
+}
+
+GraphSnapshot::GraphSnapshot(const fuse_graphs::HashGraphParams& params)
+    : fuse_graphs::HashGraph(params),
+      stamps_(StampIndex::make_shared()) {}
+
+void GraphSnapshot::SetStamps(StampIndex::ConstSharedPtr stamps) {
+  stamps_ = std::move(stamps);
+}
+
+const GraphDelta* GetGraphDelta(const fuse_core::Graph& graph) {
+  const auto snapshot = dynamic_cast<const GraphSnapshot*>(&graph);
+  if (snapshot == nullptr) { return nullptr; }
+  return &snapshot->Delta();
+}
+
+StampIndex::ConstSharedPtr GetStampIndex(const fuse_core::Graph& graph) {
+  const auto snapshot = dynamic_cast<const GraphSnapshot*>(&graph);
+  if (snapshot != nullptr) { return snapshot->Stamps(); }
+  return StampIndex::make_shared(graph);
+}
+
+} // namespace bs_common
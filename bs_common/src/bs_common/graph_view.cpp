@@ -0,0 +1,123 @@
+#include <bs_common/graph_view.h>
+
+#include <boost/functional/hash.hpp>
+
+namespace bs_common {
+
+/**
+ * @brief Visitor filling the maps of a view
+ */
+class GraphView::Indexer : public GraphVisitor {
+public:
+  explicit Indexer(GraphView& view) : view_(view) {}
+
+  template <typename T>
+  static StampKey Key(const T& v) {
+    return StampKey{v.deviceId(), v.stamp().toNSec()};
+  }
+
+  void Visit(const fuse_variables::Position3DStamped& v) override {
+    view_.positions_.emplace(Key(v), &v);
+    view_.timestamps_.insert(v.stamp());
+  }
+  void Visit(const fuse_variables::Orientation3DStamped& v) override {
+    view_.orientations_.emplace(Key(v), &v);
+  }
+  void Visit(const fuse_variables::VelocityLinear3DStamped& v) override {
+    view_.velocities_.emplace(Key(v), &v);
+  }
+  void Visit(const fuse_variables::VelocityAngular3DStamped& v) override {
+    view_.angular_velocities_.emplace(Key(v), &v);
+  }
+  void Visit(const fuse_variables::AccelerationLinear3DStamped& v) override {
+    view_.accelerations_.emplace(Key(v), &v);
+  }
+  void Visit(const bs_variables::GyroscopeBias3DStamped& v) override {
+    view_.gyro_biases_.emplace(Key(v), &v);
+  }
+  void Visit(const bs_variables::AccelerationBias3DStamped& v) override {
+    view_.accel_biases_.emplace(Key(v), &v);
+  }
+  void Visit(const bs_variables::Point3DLandmark& v) override {
+    view_.landmarks_.emplace(v.id(), &v);
+    view_.landmark_ids_.insert(v.id());
+  }
+  void Visit(const bs_variables::InverseDepthLandmark& v) override {
+    view_.inversedepth_landmarks_.emplace(v.id(), &v);
+    view_.landmark_ids_.insert(v.id());
+  }
+
+private:
+  GraphView& view_;
+};
+
+size_t GraphView::StampKeyHash::operator()(const StampKey& key) const {
+  size_t seed = fuse_core::uuid::hash()(key.device_id);
+  boost::hash_combine(seed, key.stamp);
+  return seed;
+}
+
+GraphView::GraphView(fuse_core::Graph::ConstSharedPtr graph,
+                     const std::vector<GraphVisitor*>& visitors)
+    : graph_(graph) {
+  if (!graph_) { return; }
+
+  Indexer indexer(*this);
+  std::vector<GraphVisitor*> all_visitors{&indexer};
+  all_visitors.insert(all_visitors.end(), visitors.begin(), visitors.end());
+  VisitGraph(*graph_, all_visitors);
+}
+
+const fuse_variables::Position3DStamped*
+    GraphView::GetPosition(const ros::Time& stamp,
+                           const fuse_core::UUID& device_id) const {
+  return Find(positions_, StampKey{device_id, stamp.toNSec()});
+}
+
+const fuse_variables::Orientation3DStamped*
+    GraphView::GetOrientation(const ros::Time& stamp,
+                              const fuse_core::UUID& device_id) const {
+  return Find(orientations_, StampKey{device_id, stamp.toNSec()});
+}
+
+const fuse_variables::VelocityLinear3DStamped*
+    GraphView::GetVelocity(const ros::Time& stamp,
+                           const fuse_core::UUID& device_id) const {
+  return Find(velocities_, StampKey{device_id, stamp.toNSec()});
+}
+
+const fuse_variables::VelocityAngular3DStamped*
+    GraphView::GetAngularVelocity(const ros::Time& stamp,
+                                  const fuse_core::UUID& device_id) const {
+  return Find(angular_velocities_, StampKey{device_id, stamp.toNSec()});
+}
+
+const fuse_variables::AccelerationLinear3DStamped*
+    GraphView::GetLinearAcceleration(const ros::Time& stamp,
+                                     const fuse_core::UUID& device_id) const {
+  return Find(accelerations_, StampKey{device_id, stamp.toNSec()});
+}
+
+const bs_variables::GyroscopeBias3DStamped*
+    GraphView::GetGyroscopeBias(const ros::Time& stamp,
+                                const fuse_core::UUID& device_id) const {
+  return Find(gyro_biases_, StampKey{device_id, stamp.toNSec()});
+}
+
+const bs_variables::AccelerationBias3DStamped*
+    GraphView::GetAccelBias(const ros::Time& stamp,
+                            const fuse_core::UUID& device_id) const {
+  return Find(accel_biases_, StampKey{device_id, stamp.toNSec()});
+}
+
+const bs_variables::Point3DLandmark*
+    GraphView::GetLandmark(uint64_t id) const {
+  return Find(landmarks_, id);
+}
+
+const bs_variables::InverseDepthLandmark*
+    GraphView::GetInverseDepthLandmark(uint64_t id) const {
+  return Find(inversedepth_landmarks_, id);
+}
+
+} // namespace bs_common
@@ -0,0 +1,147 @@
+#include <bs_common/graph_visitor.h>
+
+#include <array>
+#include <typeindex>
+#include <utility>
+
+#include <bs_common/pose_array.h>
+
+namespace bs_common {
+
+namespace {
+
+template <typename T>
+void Dispatch(const fuse_core::Variable& variable,
+              const std::vector<GraphVisitor*>& visitors) {
+  // the dynamic type was checked by GetVariableType
+  const T& v = static_cast<const T&>(variable);
+  for (GraphVisitor* visitor : visitors) { visitor->Visit(v); }
+}
+
+} // namespace
+
+VariableType GetVariableType(const fuse_core::Variable& variable) {
+  using TypeIds = std::array<std::pair<std::type_index, VariableType>, 9>;
+  static const TypeIds type_ids{{
+      {typeid(fuse_variables::Position3DStamped), VariableType::POSITION},
+      {typeid(fuse_variables::Orientation3DStamped),
+       VariableType::ORIENTATION},
+      {typeid(fuse_variables::VelocityLinear3DStamped), VariableType::VELOCITY},
+      {typeid(fuse_variables::VelocityAngular3DStamped),
+       VariableType::ANGULAR_VELOCITY},
+      {typeid(fuse_variables::AccelerationLinear3DStamped),
+       VariableType::ACCELERATION},
+      {typeid(bs_variables::GyroscopeBias3DStamped), VariableType::GYRO_BIAS},
+      {typeid(bs_variables::AccelerationBias3DStamped),
+       VariableType::ACCEL_BIAS},
+      {typeid(bs_variables::Point3DLandmark), VariableType::POINT_LANDMARK},
+      {typeid(bs_variables::InverseDepthLandmark),
+       VariableType::INVERSE_DEPTH_LANDMARK},
+  }};
+  const std::type_index type(typeid(variable));
+  for (const auto& [type_id, variable_type] : type_ids) {
+    if (type == type_id) { return variable_type; }
+  }
+  return VariableType::OTHER;
+}
+
+void VisitVariable(const fuse_core::Variable& variable,
+                   const std::vector<GraphVisitor*>& visitors) {
+  switch (GetVariableType(variable)) {
+    case VariableType::POSITION:
+      Dispatch<fuse_variables::Position3DStamped>(variable, visitors);
+      break;
+    case VariableType::ORIENTATION:
+      Dispatch<fuse_variables::Orientation3DStamped>(variable, visitors);
+      break;
+    case VariableType::VELOCITY:
+      Dispatch<fuse_variables::VelocityLinear3DStamped>(variable, visitors);
+      break;
+    case VariableType::ANGULAR_VELOCITY:
+      Dispatch<fuse_variables::VelocityAngular3DStamped>(variable, visitors);
+      break;
+    case VariableType::ACCELERATION:
+      Dispatch<fuse_variables::AccelerationLinear3DStamped>(variable,
+                                                            visitors);
+      break;
+    case VariableType::GYRO_BIAS:
+      Dispatch<bs_variables::GyroscopeBias3DStamped>(variable, visitors);
+      break;
+    case VariableType::ACCEL_BIAS:
+      Dispatch<bs_variables::AccelerationBias3DStamped>(variable, visitors);
+      break;
+    case VariableType::POINT_LANDMARK:
+      Dispatch<bs_variables::Point3DLandmark>(variable, visitors);
+      break;
+    case VariableType::INVERSE_DEPTH_LANDMARK:
+      Dispatch<bs_variables::InverseDepthLandmark>(variable, visitors);
+      break;
+    case VariableType::OTHER:
+      break;
+  }
+}
+
+void VisitGraph(const fuse_core::Graph& graph,
+                const std::vector<GraphVisitor*>& visitors) {
+  for (const auto& variable : graph.getVariables()) {
+    VisitVariable(variable, visitors);
+  }
+}
+
+void PoseCollector::Visit(const fuse_variables::Position3DStamped& v) {
+  positions_[Index(v.stamp())] = &v;
+}
+
+void PoseCollector::Visit(const fuse_variables::Orientation3DStamped& v) {
+  orientations_[Index(v.stamp())] = &v;
+}
+
+size_t PoseCollector::Index(const ros::Time& stamp) {
+  const auto [iter, inserted] = indices_.emplace(stamp, positions_.size());
+  if (inserted) {
+    positions_.push_back(nullptr);
+    orientations_.push_back(nullptr);
+  }
+  return iter->second;
+}
+
+std::map<ros::Time, Eigen::Matrix4d> PoseCollector::Poses() const {
+  PoseArray batch;
+  batch.Resize(positions_.size());
+  for (size_t i = 0; i < positions_.size(); i++) {
+    if (positions_[i]) {
+      const auto& p = *positions_[i];
+      batch.p.col(i) << p.x(), p.y(), p.z();
+    }
+    if (orientations_[i]) {
+      const auto& o = *orientations_[i];
+      batch.q.col(i) =
+          Eigen::Quaterniond(o.w(), o.x(), o.y(), o.z()).normalized().coeffs();
+    }
+  }
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+  PoseArrayToEigenTransforms(batch, Ts);
+
+  std::map<ros::Time, Eigen::Matrix4d> poses;
+  for (const auto& [stamp, index] : indices_) {
+    poses.emplace_hint(poses.end(), stamp, Ts[index]);
+  }
+  return poses;
+}
+
+void ImuBiasCollector::Visit(const bs_variables::GyroscopeBias3DStamped& v) {
+  ImuBiases& b = biases[v.stamp().toNSec()];
+  b.g_x = v.x();
+  b.g_y = v.y();
+  b.g_z = v.z();
+}
+
+void ImuBiasCollector::Visit(
+    const bs_variables::AccelerationBias3DStamped& v) {
+  ImuBiases& b = biases[v.stamp().toNSec()];
+  b.a_x = v.x();
+  b.a_y = v.y();
+  b.a_z = v.z();
+}
+
+} // namespace bs_common
@@ -0,0 +1,128 @@
+#include <bs_common/imu_sample_buffer.h>
+
+#include <algorithm>
+
+namespace bs_common {
+
+ImuSample::ImuSample(const sensor_msgs::Imu& msg) {
+  stamp = msg.header.stamp;
+  w[0] = msg.angular_velocity.x;
+  w[1] = msg.angular_velocity.y;
+  w[2] = msg.angular_velocity.z;
+  a[0] = msg.linear_acceleration.x;
+  a[1] = msg.linear_acceleration.y;
+  a[2] = msg.linear_acceleration.z;
+  q_WORLD = Eigen::Quaterniond(msg.orientation.w, msg.orientation.x,
+                               msg.orientation.y, msg.orientation.z);
+}
+
+IMUData ImuSample::ToIMUData() const {
+  IMUData imu_data;
+  imu_data.t = stamp;
+  imu_data.w = w;
+  imu_data.a = a;
+  return imu_data;
+}
+
+ImuSampleBuffer::ImuSampleBuffer(const ros::Duration& max_duration,
+                                 size_t max_size)
+    : max_duration_(max_duration), max_size_(max_size) {
+  // allocate the whole ring upfront so it is never grown while adding
+  if (max_size_ > 0) {
+    size_t capacity = 1;
+    while (capacity < max_size_) { capacity *= 2; }
+    storage_.resize(capacity);
+  }
+}
+
+bool ImuSampleBuffer::Add(const ImuSample& sample) {
+  // find insertion point, searching from the back since data is usually added
+  // in order
+  size_t index = size_;
+  while (index > 0 && (*this)[index - 1].stamp >= sample.stamp) {
+    if ((*this)[index - 1].stamp == sample.stamp) { return false; }
+    index--;
+  }
+
+  if (max_size_ > 0 && size_ == max_size_) {
+    if (index == 0) { return false; }
+    PopFront();
+    index--;
+  }
+  if (size_ == storage_.size()) { Grow(); }
+  size_++;
+  for (size_t i = size_ - 1; i > index; i--) { At(i) = At(i - 1); }
+  At(index) = sample;
+
+  if (max_duration_ > ros::Duration(0)) {
+    while (Back().stamp - Front().stamp > max_duration_) { PopFront(); }
+  }
+  return true;
+}
+
+ImuSampleBuffer::View ImuSampleBuffer::Range(const ros::Time& start_time,
+                                             const ros::Time& end_time) const {
+  const auto first = LowerBound(start_time);
+  const auto last = std::upper_bound(
+      first, end(), end_time,
+      [](const ros::Time& t, const ImuSample& sample) {
+        return t < sample.stamp;
+      });
+  return View(first, last);
+}
+
+ImuSampleBuffer::View
+    ImuSampleBuffer::After(const ros::Time& start_time) const {
+  const auto first = std::upper_bound(
+      begin(), end(), start_time,
+      [](const ros::Time& t, const ImuSample& sample) {
+        return t < sample.stamp;
+      });
+  return View(first, end());
+}
+
+ImuSampleBuffer::ConstIterator
+    ImuSampleBuffer::LowerBound(const ros::Time& time) const {
+  return std::lower_bound(begin(), end(), time,
+                          [](const ImuSample& sample, const ros::Time& t) {
+                            return sample.stamp < t;
+                          });
+}
+
+const ImuSample* ImuSampleBuffer::Closest(
+    const ros::Time& time, const ros::Duration& max_offset) const {
+  if (Empty()) { return nullptr; }
+  auto closest = LowerBound(time);
+  if (closest == end()) {
+    closest--;
+  } else if (closest != begin() &&
+             time - std::prev(closest)->stamp <= closest->stamp - time) {
+    closest--;
+  }
+  const ros::Duration offset =
+      closest->stamp > time ? closest->stamp - time : time - closest->stamp;
+  if (offset > max_offset) { return nullptr; }
+  return &(*closest);
+}
+
+void ImuSampleBuffer::RemoveBefore(const ros::Time& time) {
+  const size_t n = LowerBound(time).Index();
+  head_ = (head_ + n) & (storage_.size() - 1);
+  size_ -= n;
+}
+
+void ImuSampleBuffer::PopFront() {
+  if (size_ == 0) { return; }
+  head_ = (head_ + 1) & (storage_.size() - 1);
+  size_--;
+}
+
+void ImuSampleBuffer::Grow() {
+  std::vector<ImuSample, Eigen::aligned_allocator<ImuSample>> storage(
+      std::max<size_t>(2 * storage_.size(), 256));
+  for (size_t i = 0; i < size_; i++) { storage[i] = (*this)[i]; }
+  storage_ = std::move(storage);
+  head_ = 0;
+}
+
+} // namespace bs_common
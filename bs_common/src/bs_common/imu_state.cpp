@@ -67,6 +67,30 @@ ImuState::ImuState(const ros::Time& time, const Eigen::Quaterniond& orientation,
   SetAccelBias(accelbias);
 }
 
+ImuState::ImuState(const CompactImuState& state)
+    : stamp_(state.stamp),
+      orientation_(state.stamp, fuse_core::uuid::NIL),
+      position_(state.stamp, fuse_core::uuid::NIL),
+      velocity_(state.stamp, fuse_core::uuid::NIL),
+      gyrobias_(state.stamp, fuse_core::uuid::NIL),
+      accelbias_(state.stamp, fuse_core::uuid::NIL) {
+  SetOrientation(state.orientation);
+  SetPosition(state.position);
+  SetVelocity(state.velocity);
+  SetGyroBias(state.gyro_bias);
+  SetAccelBias(state.accel_bias);
+}
+
+CompactImuState ImuState::Compact() const {
+  CompactImuState state(stamp_);
+  state.SetOrientation(orientation_.data());
+  state.SetPosition(position_.data());
+  state.SetVelocity(velocity_.data());
+  state.SetGyroBias(gyrobias_.data());
+  state.SetAccelBias(accelbias_.data());
+  return state;
+}
+
 bool ImuState::Update(fuse_core::Graph::ConstSharedPtr graph_msg) {
   if (graph_msg->variableExists(orientation_.uuid()) &&
       graph_msg->variableExists(position_.uuid()) &&
@@ -93,6 +117,24 @@ bool ImuState::Update(fuse_core::Graph::ConstSharedPtr graph_msg) {
   return false;
 }
 
+bool ImuState::Update(const GraphView& graph_view) {
+  const auto orientation = graph_view.GetOrientation(stamp_);
+  const auto position = graph_view.GetPosition(stamp_);
+  const auto velocity = graph_view.GetVelocity(stamp_);
+  const auto gyrobias = graph_view.GetGyroscopeBias(stamp_);
+  const auto accelbias = graph_view.GetAccelBias(stamp_);
+  if (!orientation || !position || !velocity || !gyrobias || !accelbias) {
+    return false;
+  }
+  orientation_ = *orientation;
+  position_ = *position;
+  velocity_ = *velocity;
+  gyrobias_ = *gyrobias;
+  accelbias_ = *accelbias;
+  updates_++;
+  return true;
+}
+
 bool ImuState::UpdateRelative(fuse_core::Graph::ConstSharedPtr graph_msg) {
   if (graph_msg->variableExists(velocity_.uuid()) &&
       graph_msg->variableExists(gyrobias_.uuid()) &&
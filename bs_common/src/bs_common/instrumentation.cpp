@@ -0,0 +1,128 @@
+#include <bs_common/instrumentation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace bs_common {
+
+void LatencyHistogram::Record(uint64_t duration_ns) {
+  buckets_[Bucket(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(duration_ns, std::memory_order_relaxed);
+  // only this histogram's thread writes so no compare exchange is needed
+  if (duration_ns > max_ns_.load(std::memory_order_relaxed)) {
+    max_ns_.store(duration_ns, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::AddTo(std::array<uint64_t, kNumBuckets>& buckets,
+                             uint64_t& count, uint64_t& sum_ns,
+                             uint64_t& max_ns) const {
+  for (int i = 0; i < kNumBuckets; i++) {
+    buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+  }
+  count += count_.load(std::memory_order_relaxed);
+  sum_ns += sum_ns_.load(std::memory_order_relaxed);
+  max_ns = std::max(max_ns, max_ns_.load(std::memory_order_relaxed));
+}
+
+int LatencyHistogram::Bucket(uint64_t duration_ns) {
+  if (duration_ns <= 1) { return 0; }
+  const int bucket =
+      static_cast<int>(4.0 * std::log2(static_cast<double>(duration_ns)));
+  return std::min(bucket, kNumBuckets - 1);
+}
+
+double LatencyHistogram::BucketValueNs(int bucket) {
+  return std::pow(2.0, (bucket + 0.5) / 4.0);
+}
+
+void Metric::Record(std::chrono::nanoseconds duration) {
+  GetThreadHistogram().Record(std::max<int64_t>(duration.count(), 0));
+}
+
+LatencyHistogram& Metric::GetThreadHistogram() {
+  // metrics are never destroyed, so caching raw pointers per thread is safe
+  thread_local std::unordered_map<const Metric*, LatencyHistogram*> histograms;
+  auto iter = histograms.find(this);
+  if (iter != histograms.end()) { return *iter->second; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  histograms_.push_back(std::make_unique<LatencyHistogram>());
+  LatencyHistogram* histogram = histograms_.back().get();
+  histograms.emplace(this, histogram);
+  return *histogram;
+}
+
+MetricSummary Metric::Summarize() const {
+  std::array<uint64_t, LatencyHistogram::kNumBuckets> buckets{};
+  uint64_t count{0};
+  uint64_t sum_ns{0};
+  uint64_t max_ns{0};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& histogram : histograms_) {
+      histogram->AddTo(buckets, count, sum_ns, max_ns);
+    }
+  }
+
+  MetricSummary summary;
+  summary.name = name_;
+  summary.counter = counter_.load(std::memory_order_relaxed);
+  summary.count = count;
+  if (count == 0) { return summary; }
+
+  auto percentile = [&](double p) {
+    const uint64_t target = std::ceil(p * count);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < LatencyHistogram::kNumBuckets; i++) {
+      cumulative += buckets[i];
+      if (cumulative >= target) {
+        // bucket centers can exceed the true max for the top bucket
+        return std::min(LatencyHistogram::BucketValueNs(i),
+                        static_cast<double>(max_ns)) *
+               1e-9;
+      }
+    }
+    return max_ns * 1e-9;
+  };
+
+  summary.mean_s = sum_ns * 1e-9 / count;
+  summary.p50_s = percentile(0.5);
+  summary.p99_s = percentile(0.99);
+  summary.max_s = max_ns * 1e-9;
+  return summary;
+}
+
+Instrumentation& Instrumentation::GetInstance() {
+  static Instrumentation instance;
+  return instance;
+}
+
+Metric& Instrumentation::GetMetric(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = metrics_.find(name);
+  if (iter == metrics_.end()) {
+    iter = metrics_.emplace(name, std::make_unique<Metric>(name)).first;
+  }
+  return *iter->second;
+}
+
+std::vector<MetricSummary> Instrumentation::Summarize() const {
+  std::vector<const Metric*> metrics;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [name, metric] : metrics_) {
+      metrics.push_back(metric.get());
+    }
+  }
+
+  std::vector<MetricSummary> summaries;
+  for (const Metric* metric : metrics) {
+    summaries.push_back(metric->Summarize());
+  }
+  return summaries;
+}
+
+} // namespace bs_common
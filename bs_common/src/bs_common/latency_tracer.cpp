@@ -0,0 +1,108 @@
+#include <bs_common/latency_tracer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+
+#include <nlohmann/json.hpp>
+#include <ros/console.h>
+#include <unistd.h>
+
+#include <bs_common/instrumentation.h>
+
+namespace bs_common {
+
+LatencyTracer& LatencyTracer::GetInstance() {
+  static LatencyTracer instance;
+  return instance;
+}
+
+void LatencyTracer::Enable(size_t max_events) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  enabled_ = true;
+  max_events_ = max_events;
+  while (events_.size() > max_events_) { events_.pop_front(); }
+}
+
+bool LatencyTracer::Enabled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return enabled_;
+}
+
+void LatencyTracer::Record(const std::string& stage,
+                           const ros::Time& sensor_stamp,
+                           const ros::WallTime& receive,
+                           const ros::WallTime& start,
+                           const ros::WallTime& end) {
+  TraceEvent event{stage, sensor_stamp, receive, start, end};
+  if (ros::Time::isValid()) {
+    event.age_s = (ros::Time::now() - sensor_stamp).toSec();
+  }
+
+  // the age uses the ros clock so it is also valid when playing back bags
+  Metric& metric =
+      Instrumentation::GetInstance().GetMetric("latency/" + stage);
+  metric.Record(std::chrono::nanoseconds(
+      static_cast<int64_t>(std::max(event.age_s, 0.0) * 1e9)));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!enabled_) { return; }
+  events_.push_back(std::move(event));
+  while (events_.size() > max_events_) { events_.pop_front(); }
+}
+
+std::vector<TraceEvent> LatencyTracer::Events() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<TraceEvent>(events_.begin(), events_.end());
+}
+
+void LatencyTracer::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  events_.clear();
+}
+
+bool LatencyTracer::WriteChromeTrace(const std::string& path) const {
+  const std::vector<TraceEvent> events = Events();
+  const int pid = getpid();
+  auto to_us = [](const ros::WallTime& t) { return t.toNSec() / 1000; };
+
+  // each stage gets its own row, in the order stages first appear
+  std::map<std::string, int> stage_ids;
+  nlohmann::json trace_events = nlohmann::json::array();
+  for (const auto& event : events) {
+    auto it = stage_ids.find(event.stage);
+    if (it == stage_ids.end()) {
+      it = stage_ids.emplace(event.stage, stage_ids.size() + 1).first;
+      trace_events.push_back({{"name", "thread_name"},
+                              {"ph", "M"},
+                              {"pid", pid},
+                              {"tid", it->second},
+                              {"args", {{"name", event.stage}}}});
+    }
+    trace_events.push_back(
+        {{"name", event.stage},
+         {"cat", "latency"},
+         {"ph", "X"},
+         {"pid", pid},
+         {"tid", it->second},
+         {"ts", to_us(event.start)},
+         {"dur", to_us(event.end) - to_us(event.start)},
+         {"args",
+          {{"sensor_stamp", event.sensor_stamp.toSec()},
+           {"queue_ms", 1e3 * (event.start - event.receive).toSec()},
+           {"age_ms", 1e3 * event.age_s}}}});
+  }
+
+  std::ofstream file(path);
+  if (!file.good()) {
+    ROS_ERROR("Cannot open latency trace file: %s", path.c_str());
+    return false;
+  }
+  file << nlohmann::json{{"traceEvents", trace_events},
+                         {"displayTimeUnit", "ms"}}
+              .dump();
+  return file.good();
+}
+
+} // namespace bs_common
@@ -0,0 +1,44 @@
+#include <bs_common/memory_accounting.h>
+
+namespace bs_common {
+
+MemorySummary MemoryAccount::Summarize() const {
+  MemorySummary summary;
+  summary.name = name_;
+  summary.elements = elements_.load(std::memory_order_relaxed);
+  summary.bytes = bytes_.load(std::memory_order_relaxed);
+  summary.budget_bytes = budget_bytes_.load(std::memory_order_relaxed);
+  return summary;
+}
+
+MemoryAccounting& MemoryAccounting::GetInstance() {
+  static MemoryAccounting instance;
+  return instance;
+}
+
+MemoryAccount& MemoryAccounting::GetAccount(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = accounts_.find(name);
+  if (iter == accounts_.end()) {
+    iter = accounts_.emplace(name, std::make_unique<MemoryAccount>(name)).first;
+  }
+  return *iter->second;
+}
+
+std::vector<MemorySummary> MemoryAccounting::Summarize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<MemorySummary> summaries;
+  for (const auto& [name, account] : accounts_) {
+    summaries.push_back(account->Summarize());
+  }
+  return summaries;
+}
+
+uint64_t MemoryAccounting::TotalBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t total{0};
+  for (const auto& [name, account] : accounts_) { total += account->Bytes(); }
+  return total;
+}
+
+} // namespace bs_common
@@ -0,0 +1,71 @@
+#include <bs_common/pool_allocator.h>
+
+#include <algorithm>
+
+namespace bs_common {
+
+FreeListPool::FreeListPool(const std::string& name, size_t block_size,
+                           size_t alignment, size_t max_free_blocks)
+    : block_size_(std::max(block_size, sizeof(Node))),
+      alignment_(std::max(alignment, alignof(Node))),
+      max_free_blocks_(max_free_blocks),
+      allocated_metric_(Instrumentation::GetInstance().GetMetric(
+          "pool/" + name + "/allocated")),
+      reused_metric_(
+          Instrumentation::GetInstance().GetMetric("pool/" + name + "/reused")),
+      released_metric_(Instrumentation::GetInstance().GetMetric(
+          "pool/" + name + "/released")) {}
+
+FreeListPool::~FreeListPool() {
+  while (free_) {
+    Node* next = free_->next;
+    DeleteBlock(free_);
+    free_ = next;
+  }
+}
+
+void* FreeListPool::Allocate() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_) {
+      Node* node = free_;
+      free_ = node->next;
+      num_free_--;
+      reused_metric_.Increment();
+      return node;
+    }
+  }
+  allocated_metric_.Increment();
+  return NewBlock();
+}
+
+void FreeListPool::Deallocate(void* ptr) {
+  if (!ptr) { return; }
+  released_metric_.Increment();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (num_free_ < max_free_blocks_) {
+      Node* node = static_cast<Node*>(ptr);
+      node->next = free_;
+      free_ = node;
+      num_free_++;
+      return;
+    }
+  }
+  DeleteBlock(ptr);
+}
+
+size_t FreeListPool::NumFreeBlocks() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_free_;
+}
+
+void* FreeListPool::NewBlock() const {
+  return ::operator new(block_size_, std::align_val_t(alignment_));
+}
+
+void FreeListPool::DeleteBlock(void* ptr) const {
+  ::operator delete(ptr, std::align_val_t(alignment_));
+}
+
+} // namespace bs_common
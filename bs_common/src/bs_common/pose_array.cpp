@@ -0,0 +1,151 @@
+#include <bs_common/pose_array.h>
+
+#include <stdexcept>
+
+#include <beam_utils/log.h>
+
+namespace bs_common {
+
+namespace {
+
+using RowArray = Eigen::Array<double, 1, Eigen::Dynamic>;
+
+// out[i] = q[i] * v[i] * q[i]^-1, with the vector part of the quaternions
+// scaled by sign so that -1 rotates by the inverses. out may be v
+void Rotate(const PoseArray::QuaternionRows& q, double sign,
+            const PoseArray::PositionRows& v, PoseArray::PositionRows& out) {
+  const RowArray ux = sign * q.row(0).array();
+  const RowArray uy = sign * q.row(1).array();
+  const RowArray uz = sign * q.row(2).array();
+  const auto w = q.row(3).array();
+  const auto vx = v.row(0).array();
+  const auto vy = v.row(1).array();
+  const auto vz = v.row(2).array();
+
+  // v + w * t + u x t, with t = 2 * u x v
+  const RowArray tx = 2 * (uy * vz - uz * vy);
+  const RowArray ty = 2 * (uz * vx - ux * vz);
+  const RowArray tz = 2 * (ux * vy - uy * vx);
+  out.resize(3, v.cols());
+  out.row(0).array() = vx + w * tx + uy * tz - uz * ty;
+  out.row(1).array() = vy + w * ty + uz * tx - ux * tz;
+  out.row(2).array() = vz + w * tz + ux * ty - uy * tx;
+}
+
+} // namespace
+
+void PoseArray::Resize(size_t size) {
+  q.setZero(4, size);
+  q.row(3).setOnes();
+  p.setZero(3, size);
+}
+
+void PoseArray::Set(size_t i, const Eigen::Matrix4d& T) {
+  Set(i, Eigen::Quaterniond(T.block<3, 3>(0, 0)), T.block<3, 1>(0, 3));
+}
+
+void PoseArray::Set(size_t i, const Eigen::Quaterniond& orientation,
+                    const Eigen::Vector3d& position) {
+  q.col(i) = orientation.normalized().coeffs();
+  p.col(i) = position;
+}
+
+Eigen::Matrix4d PoseArray::T(size_t i) const {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::Quaterniond(q(3, i), q(0, i), q(1, i), q(2, i)).toRotationMatrix();
+  T.block<3, 1>(0, 3) = p.col(i);
+  return T;
+}
+
+void ComposePoses(const PoseArray& T_A_B, const PoseArray& T_B_C,
+                  PoseArray& T_A_C) {
+  if (T_A_B.Size() != T_B_C.Size()) {
+    BEAM_ERROR("Cannot compose pose arrays of size {} and {}", T_A_B.Size(),
+               T_B_C.Size());
+    throw std::runtime_error{"Pose arrays have different sizes"};
+  }
+  const auto ax = T_A_B.q.row(0).array();
+  const auto ay = T_A_B.q.row(1).array();
+  const auto az = T_A_B.q.row(2).array();
+  const auto aw = T_A_B.q.row(3).array();
+  const auto bx = T_B_C.q.row(0).array();
+  const auto by = T_B_C.q.row(1).array();
+  const auto bz = T_B_C.q.row(2).array();
+  const auto bw = T_B_C.q.row(3).array();
+
+  // compute into temporaries since T_A_C may be one of the inputs
+  PoseArray::QuaternionRows q(4, T_B_C.Size());
+  q.row(0).array() = aw * bx + ax * bw + ay * bz - az * by;
+  q.row(1).array() = aw * by - ax * bz + ay * bw + az * bx;
+  q.row(2).array() = aw * bz + ax * by - ay * bx + az * bw;
+  q.row(3).array() = aw * bw - ax * bx - ay * by - az * bz;
+  PoseArray::PositionRows p;
+  Rotate(T_A_B.q, 1, T_B_C.p, p);
+  p += T_A_B.p;
+  T_A_C.q = std::move(q);
+  T_A_C.p = std::move(p);
+}
+
+void ComposePoses(const Eigen::Matrix4d& T_A_B, const PoseArray& T_B_C,
+                  PoseArray& T_A_C) {
+  // left multiplying by a quaternion is a linear map of the coefficients
+  const Eigen::Quaterniond a =
+      Eigen::Quaterniond(T_A_B.block<3, 3>(0, 0)).normalized();
+  Eigen::Matrix4d L;
+  L << a.w(), -a.z(), a.y(), a.x(), //
+      a.z(), a.w(), -a.x(), a.y(),  //
+      -a.y(), a.x(), a.w(), a.z(),  //
+      -a.x(), -a.y(), -a.z(), a.w();
+  PoseArray::QuaternionRows q = L * T_B_C.q;
+  PoseArray::PositionRows p = (a.toRotationMatrix() * T_B_C.p).colwise() +
+                              T_A_B.block<3, 1>(0, 3);
+  T_A_C.q = std::move(q);
+  T_A_C.p = std::move(p);
+}
+
+void InvertPoses(const PoseArray& T_A_B, PoseArray& T_B_A) {
+  PoseArray::PositionRows p;
+  Rotate(T_A_B.q, -1, T_A_B.p, p);
+  T_B_A.q = T_A_B.q;
+  T_B_A.q.topRows<3>() *= -1;
+  T_B_A.p = -p;
+}
+
+void TransformPoints(const Eigen::Matrix4d& T_A_B, Eigen::Matrix3Xd& points) {
+  points = (T_A_B.block<3, 3>(0, 0) * points).colwise() +
+           T_A_B.block<3, 1>(0, 3);
+}
+
+void PoseArrayToEigenTransforms(
+    const PoseArray& poses,
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts) {
+  const auto x = poses.q.row(0).array();
+  const auto y = poses.q.row(1).array();
+  const auto z = poses.q.row(2).array();
+  const auto w = poses.q.row(3).array();
+
+  // rotation matrix coefficients of all poses, one row per coefficient
+  Eigen::Matrix<double, 9, Eigen::Dynamic, Eigen::RowMajor> R(9, poses.Size());
+  R.row(0).array() = 1 - 2 * (y * y + z * z);
+  R.row(1).array() = 2 * (x * y - z * w);
+  R.row(2).array() = 2 * (x * z + y * w);
+  R.row(3).array() = 2 * (x * y + z * w);
+  R.row(4).array() = 1 - 2 * (x * x + z * z);
+  R.row(5).array() = 2 * (y * z - x * w);
+  R.row(6).array() = 2 * (x * z - y * w);
+  R.row(7).array() = 2 * (y * z + x * w);
+  R.row(8).array() = 1 - 2 * (x * x + y * y);
+
+  Ts.resize(poses.Size());
+  for (size_t i = 0; i < poses.Size(); i++) {
+    Eigen::Matrix4d& T = Ts[i];
+    T.setIdentity();
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) { T(r, c) = R(3 * r + c, i); }
+    }
+    T.block<3, 1>(0, 3) = poses.p.col(i);
+  }
+}
+
+} // namespace bs_common
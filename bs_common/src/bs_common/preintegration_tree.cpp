@@ -0,0 +1,230 @@
+#include <bs_common/preintegration_tree.h>
+
+#include <algorithm>
+
+namespace bs_common {
+
+namespace {
+
+bool StampLess(const IMUData& imu_data, const ros::Time& t) {
+  return imu_data.t < t;
+}
+
+bool StampGreater(const ros::Time& t, const IMUData& imu_data) {
+  return t < imu_data.t;
+}
+
+} // namespace
+
+bool PreintegrationTree::AddData(const IMUData& imu_data) {
+  const auto iter = std::lower_bound(data_.begin() + first_, data_.end(),
+                                     imu_data.t, StampLess);
+  if (iter != data_.end()) {
+    if (iter->t == imu_data.t) { return false; }
+    // out of order, all intervals after it change
+    data_.insert(iter, imu_data);
+    valid_ = false;
+    return true;
+  }
+
+  // make room for the new interval
+  if (valid_ && !data_.empty() && data_.size() - 1 >= capacity_) {
+    Relayout(2 * capacity_);
+  }
+  data_.push_back(imu_data);
+  if (valid_ && data_.size() > 1) { UpdateInterval(data_.size() - 2); }
+  return true;
+}
+
+void PreintegrationTree::RemoveBefore(const ros::Time& t) {
+  first_ = std::lower_bound(data_.begin() + first_, data_.end(), t, StampLess) -
+           data_.begin();
+  // compact once half the tree is unused, so that this is amortized O(1)
+  if (first_ > capacity_ / 2) { Relayout(capacity_); }
+}
+
+void PreintegrationTree::Clear() {
+  data_.clear();
+  first_ = 0;
+  nodes_.clear();
+  capacity_ = 0;
+  valid_ = false;
+}
+
+bool PreintegrationTree::Integrate(const ros::Time& t1, const ros::Time& t2,
+                                   const Eigen::Vector3d& bg,
+                                   const Eigen::Vector3d& ba,
+                                   PreIntegrator& pre_integrator) {
+  if (Empty() || t2 <= t1 || t1 < data_[first_].t) { return false; }
+
+  if (!valid_ || (bg - bg_).norm() > bias_correction_tol_bg ||
+      (ba - ba_).norm() > bias_correction_tol_ba) {
+    bg_ = bg;
+    ba_ = ba;
+    Reintegrate();
+  }
+
+  // last measurements at or before each time
+  const size_t i = std::upper_bound(data_.begin() + first_, data_.end(), t1,
+                                    StampGreater) -
+                   data_.begin() - 1;
+  const size_t j = std::upper_bound(data_.begin() + i, data_.end(), t2,
+                                    StampGreater) -
+                   data_.begin() - 1;
+
+  Segment segment;
+  if (i == j) {
+    segment = Step(data_[i], t2 - t1);
+  } else {
+    if (data_[i].t == t1) {
+      segment = Query(i, j);
+    } else {
+      segment = Compose(Step(data_[i], data_[i + 1].t - t1), Query(i + 1, j));
+    }
+    if (t2 > data_[j].t) {
+      segment = Compose(segment, Step(data_[j], t2 - data_[j].t));
+    }
+  }
+
+  pre_integrator.Reset();
+  pre_integrator.delta.t = segment.t;
+  pre_integrator.delta.q = segment.q;
+  pre_integrator.delta.p = segment.p;
+  pre_integrator.delta.v = segment.v;
+  pre_integrator.delta.cov.block<9, 9>(ES_Q, ES_Q) = segment.cov;
+  pre_integrator.delta.cov.block<3, 3>(ES_BG, ES_BG) =
+      cov_bg * segment.t.toSec();
+  pre_integrator.delta.cov.block<3, 3>(ES_BA, ES_BA) =
+      cov_ba * segment.t.toSec();
+  pre_integrator.jacobian = segment.jacobian;
+
+  // first order correction for the change in bias since the tree was
+  // integrated
+  const Eigen::Vector3d dbg = bg - bg_;
+  const Eigen::Vector3d dba = ba - ba_;
+  if (!dbg.isZero() || !dba.isZero()) {
+    const auto& J = pre_integrator.jacobian;
+    pre_integrator.delta.q =
+        (pre_integrator.delta.q *
+         Eigen::Quaterniond(beam::LieAlgebraToR(J.dq_dbg * dbg)))
+            .normalized();
+    pre_integrator.delta.p += J.dp_dbg * dbg + J.dp_dba * dba;
+    pre_integrator.delta.v += J.dv_dbg * dbg + J.dv_dba * dba;
+  }
+
+  pre_integrator.ComputeSqrtInvCov();
+  return true;
+}
+
+PreintegrationTree::Segment PreintegrationTree::Compose(const Segment& a,
+                                                        const Segment& b) {
+  const Eigen::Matrix3d R_a = a.q.matrix();
+  const Eigen::Matrix3d R_b_T = b.q.conjugate().matrix();
+  const Eigen::Matrix3d R_a_skew_p_b = R_a * beam::SkewTransform(b.p);
+  const Eigen::Matrix3d R_a_skew_v_b = R_a * beam::SkewTransform(b.v);
+  const double dt_b = b.t.toSec();
+
+  Segment c;
+  c.t = a.t + b.t;
+  c.q = (a.q * b.q).normalized();
+  c.p = a.p + dt_b * a.v + R_a * b.p;
+  c.v = a.v + R_a * b.v;
+
+  const Jacobian& J_a = a.jacobian;
+  const Jacobian& J_b = b.jacobian;
+  c.jacobian.dq_dbg = R_b_T * J_a.dq_dbg + J_b.dq_dbg;
+  c.jacobian.dp_dbg = J_a.dp_dbg + dt_b * J_a.dv_dbg + R_a * J_b.dp_dbg -
+                      R_a_skew_p_b * J_a.dq_dbg;
+  c.jacobian.dp_dba = J_a.dp_dba + dt_b * J_a.dv_dba + R_a * J_b.dp_dba;
+  c.jacobian.dv_dbg =
+      J_a.dv_dbg + R_a * J_b.dv_dbg - R_a_skew_v_b * J_a.dq_dbg;
+  c.jacobian.dv_dba = J_a.dv_dba + R_a * J_b.dv_dba;
+
+  // propagate the errors of a through b, and rotate the errors of b into the
+  // frame at the start of a
+  Eigen::Matrix<double, 9, 9> A = Eigen::Matrix<double, 9, 9>::Identity();
+  A.block<3, 3>(ES_Q, ES_Q) = R_b_T;
+  A.block<3, 3>(ES_P, ES_Q) = -R_a_skew_p_b;
+  A.block<3, 3>(ES_P, ES_V) = dt_b * Eigen::Matrix3d::Identity();
+  A.block<3, 3>(ES_V, ES_Q) = -R_a_skew_v_b;
+
+  Eigen::Matrix<double, 9, 9> B = Eigen::Matrix<double, 9, 9>::Identity();
+  B.block<3, 3>(ES_P, ES_P) = R_a;
+  B.block<3, 3>(ES_V, ES_V) = R_a;
+
+  c.cov = A * a.cov * A.transpose() + B * b.cov * B.transpose();
+  return c;
+}
+
+PreintegrationTree::Segment PreintegrationTree::Step(const IMUData& imu_data,
+                                                     const ros::Duration& dt) {
+  stepper_.cov_w = cov_w;
+  stepper_.cov_a = cov_a;
+  stepper_.cov_bg = cov_bg;
+  stepper_.cov_ba = cov_ba;
+  stepper_.Reset();
+  stepper_.Increment(dt, imu_data, bg_, ba_, true, true);
+
+  Segment segment;
+  segment.t = stepper_.delta.t;
+  segment.q = stepper_.delta.q;
+  segment.p = stepper_.delta.p;
+  segment.v = stepper_.delta.v;
+  segment.cov = stepper_.delta.cov.block<9, 9>(ES_Q, ES_Q);
+  segment.jacobian = stepper_.jacobian;
+  return segment;
+}
+
+PreintegrationTree::Segment PreintegrationTree::Query(size_t first,
+                                                      size_t last) const {
+  // segments are not commutative, so compose from both ends inwards
+  Segment left;
+  Segment right;
+  for (size_t l = capacity_ + first, r = capacity_ + last; l < r;
+       l /= 2, r /= 2) {
+    if (l & 1) { left = Compose(left, nodes_[l++]); }
+    if (r & 1) { right = Compose(nodes_[--r], right); }
+  }
+  return Compose(left, right);
+}
+
+void PreintegrationTree::UpdateInterval(size_t i) {
+  size_t node = capacity_ + i;
+  nodes_[node] = Step(data_[i], data_[i + 1].t - data_[i].t);
+  for (node /= 2; node > 0; node /= 2) {
+    nodes_[node] = Compose(nodes_[2 * node], nodes_[2 * node + 1]);
+  }
+}
+
+void PreintegrationTree::Relayout(size_t capacity) {
+  std::vector<Segment, Eigen::aligned_allocator<Segment>> nodes(2 * capacity);
+  if (valid_) {
+    for (size_t i = first_; i + 1 < data_.size(); i++) {
+      nodes[capacity + i - first_] = nodes_[capacity_ + i];
+    }
+  }
+  data_.erase(data_.begin(), data_.begin() + first_);
+  first_ = 0;
+  nodes_ = std::move(nodes);
+  capacity_ = capacity;
+  if (!valid_) { return; }
+  for (size_t node = capacity_ - 1; node > 0; node--) {
+    nodes_[node] = Compose(nodes_[2 * node], nodes_[2 * node + 1]);
+  }
+}
+
+void PreintegrationTree::Reintegrate() {
+  size_t capacity = 64;
+  while (capacity < 2 * Size()) { capacity *= 2; }
+  valid_ = false;
+  Relayout(capacity);
+  for (size_t i = 0; i + 1 < data_.size(); i++) {
+    nodes_[capacity_ + i] = Step(data_[i], data_[i + 1].t - data_[i].t);
+  }
+  for (size_t node = capacity_ - 1; node > 0; node--) {
+    nodes_[node] = Compose(nodes_[2 * node], nodes_[2 * node + 1]);
+  }
+  valid_ = true;
+}
+
+} // namespace bs_common
@@ -4,6 +4,44 @@
 
 namespace bs_common {
 
+int IMUDataBuffer::Insert(const IMUData& imu_data) {
+  // find insertion point, searching from the back since data is usually added
+  // in order
+  size_t index = size_;
+  while (index > 0 && (*this)[index - 1].t >= imu_data.t) {
+    if ((*this)[index - 1].t == imu_data.t) { return -1; }
+    index--;
+  }
+
+  if (size_ == storage_.size()) { Grow(); }
+  size_++;
+  for (size_t i = size_ - 1; i > index; i--) { At(i) = At(i - 1); }
+  At(index) = imu_data;
+  return index;
+}
+
+void IMUDataBuffer::PopFront() {
+  if (size_ == 0) { return; }
+  head_ = (head_ + 1) % storage_.size();
+  size_--;
+}
+
+void IMUDataBuffer::Grow() {
+  std::vector<IMUData> storage(std::max<size_t>(2 * storage_.size(), 64));
+  for (size_t i = 0; i < size_; i++) { storage[i] = (*this)[i]; }
+  storage_ = std::move(storage);
+  head_ = 0;
+}
+
+void PreIntegrator::AddData(const IMUData& imu_data) {
+  const int index = data_.Insert(imu_data);
+  // measurements inserted before the end of the cached integration invalidate
+  // the cache
+  if (index >= 0 && static_cast<size_t>(index) <= frontier_.index) {
+    cache_valid_ = false;
+  }
+}
+
 void PreIntegrator::Reset() {
   delta.t = ros::Duration(0.0);
   delta.q.setIdentity();
@@ -17,10 +55,15 @@ void PreIntegrator::Reset() {
   jacobian.dp_dba.setZero();
   jacobian.dv_dbg.setZero();
   jacobian.dv_dba.setZero();
+
+  cache_valid_ = false;
 }
 
 void PreIntegrator::Clear(const ros::Time& t) {
-  while (!data.empty() && data.begin()->first < t) { data.erase(data.begin()); }
+  while (!data_.Empty() && data_.Front().t < t) {
+    data_.PopFront();
+    cache_valid_ = false;
+  }
 }
 
 void PreIntegrator::Increment(const ros::Duration& dt, const IMUData& data,
@@ -88,25 +131,85 @@ void PreIntegrator::Increment(const ros::Duration& dt, const IMUData& data,
   delta.q = (delta.q * q_full).normalized();
 }
 
+const PreIntegrator::IntegrationState*
+    PreIntegrator::GetCachedState(const ros::Time& t) const {
+  if (data_[frontier_.index].t <= t) { return &frontier_; }
+  for (auto iter = checkpoints_.rbegin(); iter != checkpoints_.rend(); iter++) {
+    if (data_[iter->index].t <= t) { return &(*iter); }
+  }
+  return nullptr;
+}
+
 bool PreIntegrator::Integrate(const ros::Time& t, const Eigen::Vector3d& bg,
                               const Eigen::Vector3d& ba, bool compute_jacobian,
-                              bool compute_covariance, bool compute_information) {
-  if (data.empty()) return false;
-  Reset();
+                              bool compute_covariance,
+                              bool compute_information) {
+  if (data_.Empty()) return false;
+
+  // check if we can continue from a cached state
+  const IntegrationState* start = nullptr;
+  if (cache_valid_ && (!compute_jacobian || cache_jacobian_) &&
+      (!compute_covariance || cache_covariance_)) {
+    start = GetCachedState(t);
+  }
+  const Eigen::Vector3d dbg = bg - cache_bg_;
+  const Eigen::Vector3d dba = ba - cache_ba_;
+  const bool bias_changed = start && (!dbg.isZero() || !dba.isZero());
+  if (bias_changed &&
+      (!cache_jacobian_ || dbg.norm() > bias_correction_tol_bg ||
+       dba.norm() > bias_correction_tol_ba)) {
+    start = nullptr;
+  }
 
-  // increment over window such that it is less or equal to the requested time
-  for (auto iter = data.begin(); std::next(iter) != data.end(); iter++) {
-    const auto& next = std::next(iter);
-    if (next->first > t) { break; }
-    const auto dt = next->first - iter->first;
-    Increment(dt, iter->second, bg, ba, compute_jacobian, compute_covariance);
+  if (start) {
+    delta = start->delta;
+    jacobian = start->jacobian;
+  } else {
+    Reset();
+    cache_valid_ = true;
+    cache_bg_ = bg;
+    cache_ba_ = ba;
+    cache_jacobian_ = compute_jacobian;
+    cache_covariance_ = compute_covariance;
+    frontier_ = IntegrationState{0, delta, jacobian};
+    checkpoints_.clear();
+    checkpoints_.push_back(frontier_);
+    start = &frontier_;
+  }
+
+  // increment over window such that it is less or equal to the requested
+  // time, always using the cached biases so that cached states are consistent
+  size_t index = start->index;
+  for (; index + 1 < data_.Size(); index++) {
+    const IMUData& next = data_[index + 1];
+    if (next.t > t) { break; }
+    const auto dt = next.t - data_[index].t;
+    Increment(dt, data_[index], cache_bg_, cache_ba_, cache_jacobian_,
+              cache_covariance_);
+    if ((index + 1) % checkpoint_interval == 0 &&
+        index + 1 > checkpoints_.back().index) {
+      checkpoints_.push_back(IntegrationState{index + 1, delta, jacobian});
+    }
+  }
+  if (index > frontier_.index) {
+    frontier_ = IntegrationState{index, delta, jacobian};
   }
 
   // final increment to requested time
-  const auto dt = t - data.rbegin()->first;
+  const auto dt = t - data_.Back().t;
   if (dt > ros::Duration(0)) {
-    Increment(dt, data.rbegin()->second, bg, ba, compute_jacobian,
-              compute_covariance);
+    Increment(dt, data_.Back(), cache_bg_, cache_ba_, cache_jacobian_,
+              cache_covariance_);
+  }
+
+  // first order correction for the change in bias since the cached states
+  // were integrated
+  if (bias_changed) {
+    delta.q = (delta.q * Eigen::Quaterniond(
+                             beam::LieAlgebraToR(jacobian.dq_dbg * dbg)))
+                  .normalized();
+    delta.p += jacobian.dp_dbg * dbg + jacobian.dp_dba * dba;
+    delta.v += jacobian.dv_dbg * dbg + jacobian.dv_dba * dba;
   }
 
   if (compute_information) { ComputeSqrtInvCov(); }
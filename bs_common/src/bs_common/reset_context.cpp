@@ -0,0 +1,52 @@
+#include <bs_common/reset_context.h>
+
+namespace bs_common {
+
+ResetContext& ResetContext::GetInstance() {
+  static ResetContext instance;
+  return instance;
+}
+
+void ResetContext::SetReigniteAfterFastReset(bool reignite) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  reignite_ = reignite;
+}
+
+void ResetContext::BeginFastReset(
+    const std::optional<ImuState>& last_good_state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  fast_reset_ = true;
+  keeps_world_frame_ = reignite_ && last_good_state.has_value();
+  last_good_state_ = last_good_state;
+}
+
+void ResetContext::EndReset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  fast_reset_ = false;
+  keeps_world_frame_ = false;
+  last_good_state_.reset();
+}
+
+bool ResetContext::IsFastReset() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return fast_reset_;
+}
+
+bool ResetContext::KeepsWorldFrame() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return keeps_world_frame_;
+}
+
+bool ResetContext::HasLastGoodState() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return last_good_state_.has_value();
+}
+
+std::optional<ImuState> ResetContext::TakeLastGoodState() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::optional<ImuState> state;
+  std::swap(state, last_good_state_);
+  return state;
+}
+
+} // namespace bs_common
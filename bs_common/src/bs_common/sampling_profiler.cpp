@@ -0,0 +1,307 @@
+#include <bs_common/sampling_profiler.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+#include <beam_utils/log.h>
+
+namespace bs_common {
+
+namespace {
+
+constexpr int kSignal = SIGPROF;
+
+// the signal handler and the signal trampoline are at the top of each stack
+constexpr int kSkippedFrames = 2;
+
+// a sample is skipped if the thread does not handle the signal within this
+// time, e.g. while it is in an uninterruptible sleep
+constexpr std::chrono::milliseconds kSampleTimeout{10};
+
+/**
+ * @brief Unregisters the thread from the profiler when it exits
+ */
+struct ThreadRegistration {
+  ~ThreadRegistration() {
+    if (!name.empty()) { SamplingProfiler::GetInstance().UnregisterThread(); }
+  }
+
+  std::string name;
+};
+
+thread_local ThreadRegistration registration;
+
+std::string Symbolize(const void* address, bool is_return_address) {
+  // return addresses point after the call, which may be the start of the next
+  // function
+  const void* lookup = is_return_address
+                           ? static_cast<const char*>(address) - 1
+                           : address;
+  Dl_info info;
+  if (dladdr(lookup, &info) == 0) {
+    std::ostringstream ss;
+    ss << address;
+    return ss.str();
+  }
+  if (info.dli_sname) {
+    int status = 0;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+    std::free(demangled);
+    return name;
+  }
+  std::string module = info.dli_fname ? info.dli_fname : "??";
+  module = module.substr(module.find_last_of('/') + 1);
+  std::ostringstream ss;
+  ss << module << "+0x" << std::hex
+     << (static_cast<const char*>(lookup) -
+         static_cast<const char*>(info.dli_fbase));
+  return ss.str();
+}
+
+} // namespace
+
+thread_local SamplingProfiler::Slot* SamplingProfiler::current_slot_ = nullptr;
+
+SamplingProfiler& SamplingProfiler::GetInstance() {
+  static SamplingProfiler instance;
+  return instance;
+}
+
+SamplingProfiler::~SamplingProfiler() {
+  Stop();
+}
+
+void SamplingProfiler::RegisterThread(const std::string& name) {
+  if (current_slot_ && registration.name == name) { return; }
+  UnregisterThread();
+
+  auto thread = std::make_unique<Thread>();
+  thread->name = name;
+  thread->handle = pthread_self();
+  pthread_setname_np(thread->handle, name.substr(0, 15).c_str());
+
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  current_slot_ = &thread->slot;
+  threads_.push_back(std::move(thread));
+  registration.name = name;
+}
+
+void SamplingProfiler::UnregisterThread() {
+  if (!current_slot_) { return; }
+
+  // the sampler holds the lock while signaling, so the slot is not used once
+  // it is removed
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  threads_.erase(std::remove_if(threads_.begin(), threads_.end(),
+                                [](const std::unique_ptr<Thread>& thread) {
+                                  return &thread->slot == current_slot_;
+                                }),
+                 threads_.end());
+  current_slot_ = nullptr;
+  registration.name.clear();
+}
+
+bool SamplingProfiler::Start(const Params& params) {
+  std::lock_guard<std::mutex> lock(sampler_mutex_);
+  if (running_) { return false; }
+  if (params.rate_hz <= 0) {
+    BEAM_ERROR("Invalid profiler sampling rate: {}", params.rate_hz);
+    return false;
+  }
+
+  if (!handler_installed_) {
+    // backtrace loads its unwinder on the first call, which is not safe in a
+    // signal handler
+    void* frames[1];
+    backtrace(frames, 1);
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &SamplingProfiler::HandleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(kSignal, &action, nullptr) != 0) {
+      BEAM_ERROR("Cannot install the profiler signal handler: {}",
+                 std::strerror(errno));
+      return false;
+    }
+    handler_installed_ = true;
+  }
+
+  params_ = params;
+  running_ = true;
+  sampler_ = std::thread(&SamplingProfiler::Run, this);
+  return true;
+}
+
+void SamplingProfiler::Stop() {
+  std::lock_guard<std::mutex> lock(sampler_mutex_);
+  if (!running_) { return; }
+  {
+    std::lock_guard<std::mutex> wakeup_lock(wakeup_mutex_);
+    running_ = false;
+  }
+  wakeup_.notify_all();
+  sampler_.join();
+}
+
+std::vector<std::string> SamplingProfiler::Threads() const {
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  std::vector<std::string> names;
+  names.reserve(threads_.size());
+  for (const auto& thread : threads_) { names.push_back(thread->name); }
+  return names;
+}
+
+size_t SamplingProfiler::NumSamples() const {
+  std::lock_guard<std::mutex> lock(stacks_mutex_);
+  return num_samples_;
+}
+
+size_t SamplingProfiler::NumDropped() const {
+  std::lock_guard<std::mutex> lock(stacks_mutex_);
+  return num_dropped_;
+}
+
+std::vector<std::string> SamplingProfiler::FoldedStacks() const {
+  std::lock_guard<std::mutex> lock(stacks_mutex_);
+
+  // stacks with different return addresses in the same functions are merged
+  std::unordered_map<const void*, std::string> symbols[2];
+  std::map<std::string, size_t> folded;
+  for (const auto& [thread, stacks] : stacks_) {
+    for (const auto& [frames, count] : stacks) {
+      std::string line = thread;
+      for (size_t i = frames.size(); i-- > 0;) {
+        // only the innermost frame is the interrupted instruction
+        const bool is_return_address = i > 0;
+        auto iter = symbols[is_return_address].find(frames[i]);
+        if (iter == symbols[is_return_address].end()) {
+          std::string symbol = Symbolize(frames[i], is_return_address);
+          std::replace(symbol.begin(), symbol.end(), ';', ':');
+          iter = symbols[is_return_address]
+                     .emplace(frames[i], std::move(symbol))
+                     .first;
+        }
+        line += ";" + iter->second;
+      }
+      folded[line] += count;
+    }
+  }
+
+  std::vector<std::string> lines;
+  lines.reserve(folded.size());
+  for (const auto& [stack, count] : folded) {
+    lines.push_back(stack + " " + std::to_string(count));
+  }
+  return lines;
+}
+
+bool SamplingProfiler::WriteFoldedStacks(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file.good()) {
+    BEAM_ERROR("Cannot write profile to: {}", path);
+    return false;
+  }
+  for (const auto& line : FoldedStacks()) { file << line << "\n"; }
+  return file.good();
+}
+
+void SamplingProfiler::Clear() {
+  std::lock_guard<std::mutex> lock(stacks_mutex_);
+  stacks_.clear();
+  num_stacks_ = 0;
+  num_samples_ = 0;
+  num_dropped_ = 0;
+}
+
+void SamplingProfiler::HandleSignal(int) {
+  const int saved_errno = errno;
+  Slot* slot = current_slot_;
+  if (slot && slot->requested.exchange(false, std::memory_order_acq_rel)) {
+    slot->depth.store(backtrace(slot->frames, kMaxFrames),
+                      std::memory_order_release);
+  }
+  errno = saved_errno;
+}
+
+void SamplingProfiler::Run() {
+  const auto period = std::chrono::duration_cast<
+      std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / params_.rate_hz));
+  auto next = std::chrono::steady_clock::now();
+  while (true) {
+    // skip the samples that are late instead of catching up
+    next = std::max(next + period, std::chrono::steady_clock::now());
+    {
+      std::unique_lock<std::mutex> lock(wakeup_mutex_);
+      if (wakeup_.wait_until(lock, next, [this]() { return !running_; })) {
+        return;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (auto& thread : threads_) {
+      const int depth = Sample(*thread);
+      if (depth > kSkippedFrames) {
+        Record(thread->name, thread->slot.frames + kSkippedFrames,
+               depth - kSkippedFrames);
+      }
+    }
+  }
+}
+
+int SamplingProfiler::Sample(Thread& thread) {
+  Slot& slot = thread.slot;
+  slot.depth.store(-1, std::memory_order_relaxed);
+  slot.requested.store(true, std::memory_order_release);
+  if (pthread_kill(thread.handle, kSignal) != 0) {
+    slot.requested = false;
+    return 0;
+  }
+
+  // if the request is withdrawn before the handler takes it, the handler
+  // ignores the signal. Otherwise the handler is running and is waited for
+  const auto deadline = std::chrono::steady_clock::now() + kSampleTimeout;
+  while (slot.depth.load(std::memory_order_acquire) < 0) {
+    if (std::chrono::steady_clock::now() > deadline &&
+        slot.requested.exchange(false, std::memory_order_acq_rel)) {
+      return 0;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+  }
+  return slot.depth.load(std::memory_order_acquire);
+}
+
+void SamplingProfiler::Record(const std::string& thread,
+                              const void* const* frames, int depth) {
+  std::vector<const void*> stack(frames, frames + depth);
+  std::lock_guard<std::mutex> lock(stacks_mutex_);
+  auto& stacks = stacks_[thread];
+  auto iter = stacks.find(stack);
+  if (iter == stacks.end()) {
+    if (num_stacks_ >= params_.max_stacks) {
+      num_dropped_++;
+      return;
+    }
+    iter = stacks.emplace(std::move(stack), 0).first;
+    num_stacks_++;
+  }
+  iter->second++;
+  num_samples_++;
+}
+
+} // namespace bs_common
@@ -0,0 +1,211 @@
+#include <bs_common/shm_ring.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <beam_utils/log.h>
+
+namespace bs_common {
+
+namespace {
+
+constexpr uint64_t kShmRingMagic = 0x474e495242534d42; // "BMSBRING"
+constexpr uint32_t kShmRingVersion = 1;
+
+/**
+ * @brief offset of the data after the header, a multiple of the cache line
+ */
+constexpr size_t kDataOffset = 256;
+
+} // namespace
+
+/**
+ * @brief start of the shared memory. head and tail are the number of bytes
+ * written and read since the ring was created, they are only written by the
+ * producer and the consumer respectively
+ */
+struct ShmRing::Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t capacity;
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+};
+
+std::unique_ptr<ShmRing> ShmRing::Create(const std::string& name,
+                                         size_t capacity) {
+  static_assert(sizeof(Header) <= kDataOffset,
+                "ring header must fit before the data");
+  if (capacity <= sizeof(uint64_t)) {
+    BEAM_ERROR("Invalid capacity of shared memory ring {}: {}", name,
+               capacity);
+    return nullptr;
+  }
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    BEAM_ERROR("Cannot create shared memory ring {}: {}", name,
+               std::strerror(errno));
+    return nullptr;
+  }
+  const size_t mapped_size = kDataOffset + capacity;
+  if (ftruncate(fd, static_cast<off_t>(mapped_size)) != 0) {
+    BEAM_ERROR("Cannot allocate {} bytes for shared memory ring {}: {}",
+               mapped_size, name, std::strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void* memory =
+      mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    BEAM_ERROR("Cannot map shared memory ring {}: {}", name,
+               std::strerror(errno));
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  // the magic is written last, so a ring being created is not valid yet
+  Header* header = new (memory) Header();
+  header->version = kShmRingVersion;
+  header->capacity = capacity;
+  header->head.store(0);
+  header->tail.store(0);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kShmRingMagic;
+  return std::unique_ptr<ShmRing>(
+      new ShmRing(name, memory, mapped_size, true));
+}
+
+std::unique_ptr<ShmRing> ShmRing::Open(const std::string& name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) { return nullptr; }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) <= kDataOffset) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t mapped_size = static_cast<size_t>(info.st_size);
+  void* memory =
+      mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    BEAM_ERROR("Cannot map shared memory ring {}: {}", name,
+               std::strerror(errno));
+    return nullptr;
+  }
+  const Header* header = static_cast<const Header*>(memory);
+  if (header->magic != kShmRingMagic ||
+      header->version != kShmRingVersion ||
+      header->capacity != mapped_size - kDataOffset) {
+    munmap(memory, mapped_size);
+    return nullptr;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return std::unique_ptr<ShmRing>(
+      new ShmRing(name, memory, mapped_size, false));
+}
+
+ShmRing::ShmRing(const std::string& name, void* memory, size_t mapped_size,
+                 bool owner)
+    : name_(name),
+      memory_(memory),
+      mapped_size_(mapped_size),
+      owner_(owner),
+      header_(static_cast<Header*>(memory)),
+      data_(static_cast<uint8_t*>(memory) + kDataOffset),
+      capacity_(mapped_size - kDataOffset) {}
+
+ShmRing::~ShmRing() {
+  munmap(memory_, mapped_size_);
+  if (owner_) { shm_unlink(name_.c_str()); }
+}
+
+bool ShmRing::TryWrite(const uint8_t* data, size_t size) {
+  if (size > MaxMessageSize()) { return false; }
+  const uint64_t head = header_->head.load(std::memory_order_relaxed);
+  const uint64_t tail = header_->tail.load(std::memory_order_acquire);
+  const uint64_t length = size;
+  if (capacity_ - (head - tail) < sizeof(length) + size) { return false; }
+  CopyIn(head, reinterpret_cast<const uint8_t*>(&length), sizeof(length));
+  CopyIn(head + sizeof(length), data, size);
+  header_->head.store(head + sizeof(length) + size,
+                      std::memory_order_release);
+  return true;
+}
+
+bool ShmRing::Write(const uint8_t* data, size_t size,
+                    const std::chrono::milliseconds& timeout) {
+  if (size > MaxMessageSize()) { return false; }
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::chrono::microseconds period(1);
+  while (!TryWrite(data, size)) {
+    if (std::chrono::steady_clock::now() >= deadline) { return false; }
+    std::this_thread::sleep_for(period);
+    period = std::min(period * 2, kMaxPollPeriod);
+  }
+  return true;
+}
+
+bool ShmRing::TryRead(std::vector<uint8_t>& message) {
+  const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+  const uint64_t head = header_->head.load(std::memory_order_acquire);
+  if (head == tail) { return false; }
+  uint64_t length;
+  CopyOut(tail, reinterpret_cast<uint8_t*>(&length), sizeof(length));
+  if (length > head - tail - sizeof(length)) {
+    BEAM_ERROR("Corrupted message in shared memory ring {}", name_);
+    throw std::runtime_error{"corrupted shared memory ring"};
+  }
+  message.resize(length);
+  CopyOut(tail + sizeof(length), message.data(), length);
+  header_->tail.store(tail + sizeof(length) + length,
+                      std::memory_order_release);
+  return true;
+}
+
+bool ShmRing::Read(std::vector<uint8_t>& message,
+                   const std::chrono::milliseconds& timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::chrono::microseconds period(1);
+  while (!TryRead(message)) {
+    if (std::chrono::steady_clock::now() >= deadline) { return false; }
+    std::this_thread::sleep_for(period);
+    period = std::min(period * 2, kMaxPollPeriod);
+  }
+  return true;
+}
+
+size_t ShmRing::Used() const {
+  const uint64_t tail = header_->tail.load(std::memory_order_acquire);
+  const uint64_t head = header_->head.load(std::memory_order_acquire);
+  return head - tail;
+}
+
+void ShmRing::CopyIn(uint64_t position, const uint8_t* data, size_t size) {
+  const size_t offset = position % capacity_;
+  const size_t first = std::min(size, capacity_ - offset);
+  std::memcpy(data_ + offset, data, first);
+  std::memcpy(data_, data + first, size - first);
+}
+
+void ShmRing::CopyOut(uint64_t position, uint8_t* data, size_t size) const {
+  const size_t offset = position % capacity_;
+  const size_t first = std::min(size, capacity_ - offset);
+  std::memcpy(data, data_ + offset, first);
+  std::memcpy(data + first, data_, size - first);
+}
+
+} // namespace bs_common
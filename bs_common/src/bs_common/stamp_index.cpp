@@ -0,0 +1,124 @@
+#include <bs_common/stamp_index.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include <fuse_variables/position_3d_stamped.h>
+
+namespace bs_common {
+
+StampIndex::StampIndex(const ros::Duration& bucket_duration)
+    : bucket_nsec_(std::max<uint64_t>(bucket_duration.toNSec(), 1)) {}
+
+StampIndex::StampIndex(const fuse_core::Graph& graph,
+                       const ros::Duration& bucket_duration)
+    : StampIndex(bucket_duration) {
+  for (const auto& variable : graph.getVariables()) {
+    const auto position =
+        dynamic_cast<const fuse_variables::Position3DStamped*>(&variable);
+    if (position) { Insert(position->stamp()); }
+  }
+}
+
+bool StampIndex::Insert(const ros::Time& stamp) {
+  std::vector<ros::Time>& bucket = buckets_[Bucket(stamp)];
+  // stamps are mostly added in order
+  if (bucket.empty() || bucket.back() < stamp) {
+    bucket.push_back(stamp);
+  } else {
+    auto it = std::lower_bound(bucket.begin(), bucket.end(), stamp);
+    if (*it == stamp) { return false; }
+    bucket.insert(it, stamp);
+  }
+  size_++;
+  return true;
+}
+
+bool StampIndex::Erase(const ros::Time& stamp) {
+  auto bucket = buckets_.find(Bucket(stamp));
+  if (bucket == buckets_.end()) { return false; }
+  auto it =
+      std::lower_bound(bucket->second.begin(), bucket->second.end(), stamp);
+  if (it == bucket->second.end() || *it != stamp) { return false; }
+  bucket->second.erase(it);
+  if (bucket->second.empty()) { buckets_.erase(bucket); }
+  size_--;
+  return true;
+}
+
+bool StampIndex::Contains(const ros::Time& stamp) const {
+  auto bucket = buckets_.find(Bucket(stamp));
+  if (bucket == buckets_.end()) { return false; }
+  return std::binary_search(bucket->second.begin(), bucket->second.end(),
+                            stamp);
+}
+
+const ros::Time& StampIndex::Oldest() const {
+  return buckets_.begin()->second.front();
+}
+
+const ros::Time& StampIndex::Newest() const {
+  return buckets_.rbegin()->second.back();
+}
+
+std::vector<ros::Time> StampIndex::Stamps() const {
+  std::vector<ros::Time> stamps;
+  stamps.reserve(size_);
+  for (const auto& [bucket, bucket_stamps] : buckets_) {
+    stamps.insert(stamps.end(), bucket_stamps.begin(), bucket_stamps.end());
+  }
+  return stamps;
+}
+
+std::vector<ros::Time> StampIndex::Range(const ros::Time& start,
+                                         const ros::Time& end) const {
+  std::vector<ros::Time> stamps;
+  if (end < start) { return stamps; }
+  for (auto bucket = buckets_.lower_bound(Bucket(start));
+       bucket != buckets_.end() && bucket->first <= Bucket(end); bucket++) {
+    for (const auto& stamp : bucket->second) {
+      if (stamp >= start && stamp <= end) { stamps.push_back(stamp); }
+    }
+  }
+  return stamps;
+}
+
+std::vector<ros::Time> StampIndex::Difference(const StampIndex& other) const {
+  std::vector<ros::Time> difference;
+  for (const auto& [bucket, bucket_stamps] : buckets_) {
+    // buckets only match if both indices use the same duration
+    const auto other_bucket = bucket_nsec_ == other.bucket_nsec_
+                                  ? other.buckets_.find(bucket)
+                                  : other.buckets_.end();
+    if (other_bucket == other.buckets_.end()) {
+      for (const auto& stamp : bucket_stamps) {
+        if (!other.Contains(stamp)) { difference.push_back(stamp); }
+      }
+      continue;
+    }
+    std::set_difference(bucket_stamps.begin(), bucket_stamps.end(),
+                        other_bucket->second.begin(),
+                        other_bucket->second.end(),
+                        std::back_inserter(difference));
+  }
+  return difference;
+}
+
+std::set<ros::Time> StampIndex::ToSet() const {
+  std::set<ros::Time> stamps;
+  for (const auto& [bucket, bucket_stamps] : buckets_) {
+    stamps.insert(bucket_stamps.begin(), bucket_stamps.end());
+  }
+  return stamps;
+}
+
+void StampIndex::Clear() {
+  buckets_.clear();
+  size_ = 0;
+}
+
+uint64_t StampIndex::Bucket(const ros::Time& stamp) const {
+  return stamp.toNSec() / bucket_nsec_;
+}
+
+} // namespace bs_common
@@ -0,0 +1,60 @@
+#include <bs_common/startup_profiler.h>
+
+#include <ros/console.h>
+
+#include <bs_common/instrumentation.h>
+
+namespace bs_common {
+
+StartupProfiler& StartupProfiler::GetInstance() {
+  static StartupProfiler instance;
+  return instance;
+}
+
+void StartupProfiler::Record(const std::string& name,
+                             std::chrono::nanoseconds duration) {
+  Instrumentation::GetInstance().GetMetric("startup/" + name).Record(duration);
+  ROS_INFO("Startup: %s took %.3f s", name.c_str(), duration.count() * 1e-9);
+}
+
+void StartupProfiler::SetReady(const std::string& resource) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_.insert(resource);
+  }
+  ready_condition_.notify_all();
+}
+
+bool StartupProfiler::IsReady(const std::string& resource) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ready_.find(resource) != ready_.end();
+}
+
+std::vector<std::string>
+    StartupProfiler::WaitUntilReady(const std::vector<std::string>& resources,
+                                    double timeout_s) const {
+  auto all_ready = [&]() {
+    for (const auto& resource : resources) {
+      if (ready_.find(resource) == ready_.end()) { return false; }
+    }
+    return true;
+  };
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (timeout_s < 0) {
+    ready_condition_.wait(lock, all_ready);
+  } else {
+    ready_condition_.wait_for(lock, std::chrono::duration<double>(timeout_s),
+                              all_ready);
+  }
+
+  std::vector<std::string> not_ready;
+  for (const auto& resource : resources) {
+    if (ready_.find(resource) == ready_.end()) {
+      not_ready.push_back(resource);
+    }
+  }
+  return not_ready;
+}
+
+} // namespace bs_common
@@ -0,0 +1,270 @@
+#include <bs_common/task_scheduler.h>
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <bs_common/sampling_profiler.h>
+
+namespace bs_common {
+
+namespace {
+
+// worker of the calling thread, used to queue tasks from a worker on its own
+// queue
+thread_local const TaskScheduler* current_scheduler = nullptr;
+thread_local size_t current_worker = 0;
+
+// whether the calling thread is running a background task, nested tasks it
+// runs while waiting (see ParallelFor) use the same background slot
+thread_local bool running_background_task = false;
+
+} // namespace
+
+TaskScheduler& TaskScheduler::GetInstance() {
+  static TaskScheduler instance;
+  return instance;
+}
+
+TaskScheduler::TaskScheduler() { Start(Params()); }
+
+TaskScheduler::~TaskScheduler() { Stop(); }
+
+void TaskScheduler::Configure(const Params& params) {
+  Stop();
+  Start(params);
+}
+
+void TaskScheduler::Start(const Params& params) {
+  const int num_threads =
+      params.num_threads > 0
+          ? params.num_threads
+          : std::max<int>(std::thread::hardware_concurrency(), 1);
+  max_background_threads_ =
+      params.max_background_threads > 0
+          ? std::min(params.max_background_threads, num_threads)
+          : std::max(num_threads / 2, 1);
+  for (int p = 0; p < kNumPriorities; p++) {
+    num_queued_[p] = 0;
+    tasks_run_[p] = 0;
+    busy_ns_[p] = 0;
+  }
+  running_background_ = 0;
+  stopping_ = false;
+  start_time_ = std::chrono::steady_clock::now();
+
+  // all workers must exist before any of them starts stealing
+  for (int i = 0; i < num_threads; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (int i = 0; i < num_threads; i++) {
+    const int core =
+        params.cores.empty() ? -1 : params.cores[i % params.cores.size()];
+    workers_[i]->thread = std::thread(&TaskScheduler::Run, this, i, core);
+  }
+}
+
+void TaskScheduler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker : workers_) { worker->thread.join(); }
+  workers_.clear();
+}
+
+std::future<void> TaskScheduler::Enqueue(TaskPriority priority,
+                                         std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> future = packaged.get_future();
+  Push(priority, std::move(packaged));
+  return future;
+}
+
+void TaskScheduler::ParallelFor(TaskPriority priority, size_t n,
+                                const std::function<void(size_t)>& task,
+                                size_t max_parallelism) {
+  if (max_parallelism == 0) { max_parallelism = workers_.size() + 1; }
+  const size_t num_chunks = std::min(n, max_parallelism);
+  if (num_chunks <= 1) {
+    for (size_t i = 0; i < n; i++) { task(i); }
+    return;
+  }
+
+  // the chunks notify while holding the lock, so this stack frame can only
+  // be left once the last chunk is done with it
+  std::mutex done_mutex;
+  std::condition_variable done;
+  size_t remaining = num_chunks - 1;
+  std::exception_ptr error;
+  auto run_chunk = [&](size_t chunk) {
+    const size_t begin = chunk * n / num_chunks;
+    const size_t end = (chunk + 1) * n / num_chunks;
+    try {
+      for (size_t i = begin; i < end; i++) { task(i); }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if (!error) { error = std::current_exception(); }
+    }
+  };
+  for (size_t chunk = 1; chunk < num_chunks; chunk++) {
+    Push(priority, std::packaged_task<void()>([&, chunk]() {
+           run_chunk(chunk);
+           std::lock_guard<std::mutex> lock(done_mutex);
+           if (--remaining == 0) { done.notify_all(); }
+         }));
+  }
+  run_chunk(0);
+
+  // help with queued tasks instead of blocking a worker, this is what makes
+  // nested calls from tasks safe
+  const size_t start = current_scheduler == this ? current_worker : 0;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if (remaining == 0) { break; }
+    }
+    if (RunOne(start, static_cast<int>(priority))) { continue; }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait_for(lock, std::chrono::milliseconds(1),
+                  [&]() { return remaining == 0; });
+  }
+  if (error) { std::rethrow_exception(error); }
+}
+
+TaskScheduler::Stats TaskScheduler::GetStats() const {
+  Stats stats;
+  stats.num_threads = NumThreads();
+  stats.uptime_s = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time_)
+                       .count();
+  for (int p = 0; p < kNumPriorities; p++) {
+    stats.tasks_run[p] = tasks_run_[p].load(std::memory_order_relaxed);
+    stats.tasks_queued[p] = num_queued_[p].load(std::memory_order_relaxed);
+    stats.busy_s[p] = busy_ns_[p].load(std::memory_order_relaxed) * 1e-9;
+  }
+  return stats;
+}
+
+bool TaskScheduler::PinCurrentThread(const std::vector<int>& cores) {
+#ifdef __linux__
+  if (cores.empty()) { return false; }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int core : cores) {
+    if (core < 0 || core >= CPU_SETSIZE) { return false; }
+    CPU_SET(core, &cpu_set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) ==
+         0;
+#else
+  return false;
+#endif
+}
+
+void TaskScheduler::Push(TaskPriority priority,
+                         std::packaged_task<void()> task) {
+  const int p = static_cast<int>(priority);
+  const size_t index = current_scheduler == this
+                           ? current_worker
+                           : next_worker_++ % workers_.size();
+
+  // counted before it is queued so the count never goes below zero
+  num_queued_[p]++;
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+    workers_[index]->queues[p].push_back(std::move(task));
+  }
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  condition_.notify_one();
+}
+
+bool TaskScheduler::Pop(Worker& worker, int priority, bool own_queue,
+                        std::packaged_task<void()>& task) {
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  auto& queue = worker.queues[priority];
+  if (queue.empty()) { return false; }
+  if (own_queue) {
+    task = std::move(queue.back());
+    queue.pop_back();
+  } else {
+    task = std::move(queue.front());
+    queue.pop_front();
+  }
+  return true;
+}
+
+bool TaskScheduler::RunOne(size_t worker_index, int lowest_priority) {
+  const bool is_worker = current_scheduler == this;
+  const int background = static_cast<int>(TaskPriority::BACKGROUND);
+  for (int p = 0; p <= lowest_priority; p++) {
+    if (num_queued_[p] == 0) { continue; }
+
+    // reserve a background slot before taking a background task
+    const bool reserve = p == background && !running_background_task;
+    if (reserve) {
+      int running = running_background_;
+      do {
+        if (running >= max_background_threads_) { return false; }
+      } while (
+          !running_background_.compare_exchange_weak(running, running + 1));
+    }
+
+    std::packaged_task<void()> task;
+    bool found = false;
+    for (size_t i = 0; i < workers_.size() && !found; i++) {
+      const size_t index = (worker_index + i) % workers_.size();
+      found = Pop(*workers_[index], p, is_worker && i == 0, task);
+    }
+    if (!found) {
+      if (reserve) { running_background_--; }
+      continue;
+    }
+    num_queued_[p]--;
+    tasks_run_[p]++;
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool was_running_background = running_background_task;
+    running_background_task = p == background;
+    task();
+    running_background_task = was_running_background;
+    busy_ns_[p] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    if (reserve) {
+      // another background task may be runnable now
+      running_background_--;
+      { std::lock_guard<std::mutex> lock(mutex_); }
+      condition_.notify_one();
+    }
+    return true;
+  }
+  return false;
+}
+
+bool TaskScheduler::HasRunnableTask() const {
+  const int background = static_cast<int>(TaskPriority::BACKGROUND);
+  return num_queued_[0] > 0 || (num_queued_[background] > 0 &&
+                                running_background_ < max_background_threads_);
+}
+
+void TaskScheduler::Run(size_t worker_index, int core) {
+  current_scheduler = this;
+  current_worker = worker_index;
+  if (core >= 0) { PinCurrentThread({core}); }
+  SamplingProfiler::GetInstance().RegisterThread(
+      "task_worker/" + std::to_string(worker_index));
+
+  while (true) {
+    if (RunOne(worker_index, static_cast<int>(TaskPriority::BACKGROUND))) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() { return stopping_ || HasRunnableTask(); });
+    if (stopping_ && num_queued_[0] == 0 && num_queued_[1] == 0) { return; }
+  }
+}
+
+} // namespace bs_common
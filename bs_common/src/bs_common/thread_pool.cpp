@@ -0,0 +1,72 @@
+#include <bs_common/thread_pool.h>
+
+#include <algorithm>
+
+namespace bs_common {
+
+ThreadPool::ThreadPool(int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  workers_.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&ThreadPool::Run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker : workers_) { worker.join(); }
+}
+
+std::future<void> ThreadPool::Enqueue(std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> future = packaged.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(packaged));
+  }
+  condition_.notify_one();
+  return future;
+}
+
+void ThreadPool::ParallelFor(size_t n,
+                             const std::function<void(size_t)>& task) {
+  const size_t num_chunks = std::min(n, workers_.size());
+  if (num_chunks <= 1) {
+    for (size_t i = 0; i < n; i++) { task(i); }
+    return;
+  }
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_chunks);
+  for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+    const size_t begin = chunk * n / num_chunks;
+    const size_t end = (chunk + 1) * n / num_chunks;
+    futures.push_back(Enqueue([&task, begin, end]() {
+      for (size_t i = begin; i < end; i++) { task(i); }
+    }));
+  }
+
+  // wait for all chunks before rethrowing, they reference the task
+  for (auto& future : futures) { future.wait(); }
+  for (auto& future : futures) { future.get(); }
+}
+
+void ThreadPool::Run() {
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) { return; }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+} // namespace bs_common
@@ -0,0 +1,236 @@
+#include <bs_common/trajectory_buffer.h>
+
+#include <algorithm>
+
+namespace bs_common {
+
+TrajectoryPose::TrajectoryPose(const ros::Time& _stamp,
+                               const Eigen::Matrix4d& T)
+    : stamp(_stamp) {
+  const Eigen::Quaterniond orientation =
+      Eigen::Quaterniond(T.block<3, 3>(0, 0)).normalized();
+  q[0] = orientation.x();
+  q[1] = orientation.y();
+  q[2] = orientation.z();
+  q[3] = orientation.w();
+  p[0] = T(0, 3);
+  p[1] = T(1, 3);
+  p[2] = T(2, 3);
+}
+
+Eigen::Matrix4d TrajectoryPose::T() const {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) = Orientation().toRotationMatrix();
+  T.block<3, 1>(0, 3) = Position();
+  return T;
+}
+
+Trajectory::Trajectory(TrajectoryPoses poses) {
+  auto by_stamp = [](const TrajectoryPose& a, const TrajectoryPose& b) {
+    return a.stamp < b.stamp;
+  };
+  auto same_stamp = [](const TrajectoryPose& a, const TrajectoryPose& b) {
+    return a.stamp == b.stamp;
+  };
+  if (!std::is_sorted(poses.begin(), poses.end(), by_stamp)) {
+    std::stable_sort(poses.begin(), poses.end(), by_stamp);
+  }
+  poses.erase(std::unique(poses.begin(), poses.end(), same_stamp),
+              poses.end());
+
+  auto storage = std::make_shared<const TrajectoryPoses>(std::move(poses));
+  poses_ = storage->data();
+  size_ = storage->size();
+  storage_ = std::move(storage);
+}
+
+Trajectory::Trajectory(std::shared_ptr<const void> storage,
+                       const TrajectoryPose* poses, size_t size)
+    : storage_(std::move(storage)), poses_(poses), size_(size) {}
+
+bool Trajectory::Get(Eigen::Matrix4d& T, const ros::Time& time,
+                     std::string& error_msg) const {
+  if (!CheckTime(time, error_msg)) { return false; }
+  if (time.isZero()) {
+    T = poses_[size_ - 1].T();
+    return true;
+  }
+  const auto iter = std::lower_bound(
+      begin(), end(), time, [](const TrajectoryPose& pose, const ros::Time& t) {
+        return pose.stamp < t;
+      });
+  T = Interpolate(iter - begin(), time);
+  return true;
+}
+
+bool Trajectory::Get(std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts,
+                     const std::vector<ros::Time>& times,
+                     std::string& error_msg) const {
+  Ts.clear();
+  if (times.empty()) { return true; }
+  Ts.reserve(times.size());
+
+  // only search for the first time, then walk forward
+  auto earlier = [](const TrajectoryPose& pose, const ros::Time& t) {
+    return pose.stamp < t;
+  };
+  size_t index = 0;
+  bool searched = false;
+  for (const ros::Time& time : times) {
+    if (!CheckTime(time, error_msg)) { return false; }
+    if (time.isZero()) {
+      Ts.push_back(poses_[size_ - 1].T());
+      continue;
+    }
+    if (!searched) {
+      index = std::lower_bound(begin(), end(), time, earlier) - begin();
+      searched = true;
+    }
+    while (poses_[index].stamp < time) { index++; }
+    Ts.push_back(Interpolate(index, time));
+  }
+  return true;
+}
+
+const TrajectoryPose* Trajectory::Before(const ros::Time& time) const {
+  const TrajectoryPose* iter = std::upper_bound(
+      begin(), end(), time, [](const ros::Time& t, const TrajectoryPose& pose) {
+        return t < pose.stamp;
+      });
+  if (iter == begin()) { return nullptr; }
+  return iter - 1;
+}
+
+bool Trajectory::CheckTime(const ros::Time& time,
+                           std::string& error_msg) const {
+  if (Empty()) {
+    error_msg = "Trajectory is empty.";
+    return false;
+  }
+  if (time.isZero()) { return true; }
+  if (time < StartTime()) {
+    error_msg = "Lookup would require extrapolation into the past. Requested "
+                "time " +
+                std::to_string(time.toSec()) +
+                " but the earliest data is at time " +
+                std::to_string(StartTime().toSec());
+    return false;
+  }
+  if (time > EndTime()) {
+    error_msg = "Lookup would require extrapolation into the future. "
+                "Requested time " +
+                std::to_string(time.toSec()) +
+                " but the latest data is at time " +
+                std::to_string(EndTime().toSec());
+    return false;
+  }
+  return true;
+}
+
+Eigen::Matrix4d Trajectory::Interpolate(size_t index,
+                                        const ros::Time& time) const {
+  const TrajectoryPose& pose2 = poses_[index];
+  if (pose2.stamp == time || index == 0) { return pose2.T(); }
+  const TrajectoryPose& pose1 = poses_[index - 1];
+  const double alpha =
+      (time - pose1.stamp).toSec() / (pose2.stamp - pose1.stamp).toSec();
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) = pose1.Orientation()
+                            .slerp(alpha, pose2.Orientation())
+                            .toRotationMatrix();
+  T.block<3, 1>(0, 3) =
+      (1 - alpha) * pose1.Position() + alpha * pose2.Position();
+  return T;
+}
+
+TrajectoryBuffer::TrajectoryBuffer(const ros::Duration& max_duration)
+    : max_duration_(max_duration) {
+  trajectory_.Store(Trajectory());
+}
+
+bool TrajectoryBuffer::Add(const ros::Time& stamp, const Eigen::Matrix4d& T) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (poses_outdated_) {
+      const auto trajectory = trajectory_.Load();
+      poses_.assign(trajectory->begin(), trajectory->end());
+      poses_outdated_ = false;
+    }
+
+    // find insertion point, searching from the back since poses are usually
+    // added in order
+    size_t index = poses_.size();
+    while (index > 0 && poses_[index - 1].stamp >= stamp) {
+      if (poses_[index - 1].stamp == stamp) { return false; }
+      index--;
+    }
+    poses_.insert(poses_.begin() + index, TrajectoryPose(stamp, T));
+
+    if (max_duration_ > ros::Duration(0)) {
+      auto first = poses_.begin();
+      while (poses_.back().stamp - first->stamp > max_duration_) { first++; }
+      poses_.erase(poses_.begin(), first);
+    }
+
+    trajectory_.Store(Trajectory(poses_));
+  }
+  Notify();
+  return true;
+}
+
+void TrajectoryBuffer::Set(const Trajectory& trajectory) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    poses_.clear();
+    poses_outdated_ = true;
+    trajectory_.Store(trajectory);
+  }
+  Notify();
+}
+
+void TrajectoryBuffer::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  poses_.clear();
+  poses_outdated_ = false;
+  trajectory_.Store(Trajectory());
+}
+
+uint64_t TrajectoryBuffer::NotifyWhenReached(const ros::Time& time,
+                                             std::function<void()> callback) {
+  // writers notify after publishing, so checking the trajectory under this
+  // lock can't miss a pose
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
+  const auto trajectory = trajectory_.Load();
+  if (!trajectory->Empty() && trajectory->EndTime() >= time) {
+    callback();
+    return 0;
+  }
+  const uint64_t id = next_notification_id_++;
+  notifications_.emplace(time, std::make_pair(id, std::move(callback)));
+  return id;
+}
+
+void TrajectoryBuffer::CancelNotification(uint64_t id) {
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
+  for (auto iter = notifications_.begin(); iter != notifications_.end();
+       iter++) {
+    if (iter->second.first == id) {
+      notifications_.erase(iter);
+      return;
+    }
+  }
+}
+
+void TrajectoryBuffer::Notify() {
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
+  if (notifications_.empty()) { return; }
+  const auto trajectory = trajectory_.Load();
+  if (trajectory->Empty()) { return; }
+  const auto end = notifications_.upper_bound(trajectory->EndTime());
+  for (auto iter = notifications_.begin(); iter != end; iter++) {
+    iter->second.second();
+  }
+  notifications_.erase(notifications_.begin(), end);
+}
+
+} // namespace bs_common
@@ -0,0 +1,82 @@
+#include <bs_common/trajectory_file.h>
+
+#include <cstring>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/chunk_file.h>
+
+namespace bs_common {
+
+bool TrajectoryFile::Save(const std::string& path) const {
+  ChunkFileWriter writer;
+  if (!writer.Open(path, kTrajectoryFileVersion)) { return false; }
+
+  // the poses are the first chunk, right after the header, so the records
+  // are aligned when the file is mapped
+  ByteWriter poses;
+  poses.Write<uint64_t>(trajectory.Size());
+  poses.WriteBytes(trajectory.begin(),
+                   trajectory.Size() * sizeof(TrajectoryPose));
+  ByteWriter frames;
+  frames.WriteString(fixed_frame);
+  frames.WriteString(moving_frame);
+  if (!writer.AddChunk(static_cast<uint32_t>(TrajectoryChunkType::POSES), 0,
+                       poses) ||
+      !writer.AddChunk(static_cast<uint32_t>(TrajectoryChunkType::FRAMES), 0,
+                       frames)) {
+    return false;
+  }
+  return writer.Close();
+}
+
+bool TrajectoryFile::Load(const std::string& path) {
+  auto reader = std::make_shared<ChunkFileReader>();
+  if (!reader->Open(path)) { return false; }
+  if (reader->Version() > kTrajectoryFileVersion) {
+    BEAM_ERROR("Trajectory file version {} is newer than supported version {}",
+               reader->Version(), kTrajectoryFileVersion);
+    return false;
+  }
+  const ChunkInfo* poses_chunk =
+      reader->Find(static_cast<uint32_t>(TrajectoryChunkType::POSES), 0);
+  const ChunkInfo* frames_chunk =
+      reader->Find(static_cast<uint32_t>(TrajectoryChunkType::FRAMES), 0);
+  if (!poses_chunk || !frames_chunk) {
+    BEAM_ERROR("Trajectory file is missing its poses or frames: {}", path);
+    return false;
+  }
+
+  try {
+    ByteReader frames = reader->Read(*frames_chunk);
+    fixed_frame = frames.ReadString();
+    moving_frame = frames.ReadString();
+
+    ByteReader poses = reader->Read(*poses_chunk);
+    const uint64_t num_poses = poses.Read<uint64_t>();
+    const uint8_t* data = poses.ReadBytes(num_poses * sizeof(TrajectoryPose));
+    if (reinterpret_cast<uintptr_t>(data) % alignof(TrajectoryPose) == 0) {
+      trajectory = Trajectory(reader,
+                              reinterpret_cast<const TrajectoryPose*>(data),
+                              num_poses);
+    } else {
+      // only files not written by Save can be misaligned
+      TrajectoryPoses copy(num_poses);
+      std::memcpy(copy.data(), data, num_poses * sizeof(TrajectoryPose));
+      trajectory = Trajectory(std::move(copy));
+    }
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Invalid trajectory file {}: {}", path, e.what());
+    return false;
+  }
+  return true;
+}
+
+bool TrajectoryFile::IsTrajectoryFile(const std::string& path) {
+  if (!ChunkFileReader::IsChunkFile(path)) { return false; }
+  ChunkFileReader reader;
+  return reader.Open(path) &&
+         reader.Find(static_cast<uint32_t>(TrajectoryChunkType::POSES), 0);
+}
+
+} // namespace bs_common
@@ -0,0 +1,291 @@
+#include <bs_common/trajectory_spline.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace bs_common {
+
+namespace {
+
+// max number of iterations to solve the orientation control points, and the
+// error at the knots at which they are considered solved
+constexpr int kMaxOrientationIterations = 5;
+constexpr double kMaxOrientationError = 1e-10;
+
+Eigen::Quaterniond Exp(const Eigen::Vector3d& v) {
+  const double angle = v.norm();
+  if (angle < 1e-12) {
+    return Eigen::Quaterniond(1, v[0] / 2, v[1] / 2, v[2] / 2).normalized();
+  }
+  return Eigen::Quaterniond(Eigen::AngleAxisd(angle, v / angle));
+}
+
+Eigen::Vector3d Log(const Eigen::Quaterniond& q) {
+  const Eigen::AngleAxisd angle_axis(q);
+  return angle_axis.angle() * angle_axis.axis();
+}
+
+/**
+ * @brief solves the control points of a uniform cubic B-spline going through
+ * values at its knots. Knot k is at control point k + 1, and the spline goes
+ * through it if (c_k + 4 c_{k+1} + c_{k+2}) / 6 = x_k. The first and last
+ * control points extrapolate linearly, so the end knots are their own control
+ * points and the inner ones are a tridiagonal system
+ * @param x values at the knots, at least 2
+ * @return control points, two more than the values
+ */
+std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+    InterpolatingControlPoints(
+        const std::vector<Eigen::Vector3d,
+                          Eigen::aligned_allocator<Eigen::Vector3d>>& x) {
+  const size_t M = x.size();
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> c(
+      M + 2);
+  c[1] = x.front();
+  c[M] = x.back();
+
+  const size_t n = M - 2;
+  std::vector<double> cp(n);
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> dp(
+      n);
+  for (size_t i = 0; i < n; i++) {
+    Eigen::Vector3d rhs = 6 * x[i + 1];
+    if (i == 0) { rhs -= c[1]; }
+    if (i == n - 1) { rhs -= c[M]; }
+    const double m = i == 0 ? 4.0 : 4.0 - cp[i - 1];
+    cp[i] = 1.0 / m;
+    dp[i] = (i == 0 ? rhs : rhs - dp[i - 1]) / m;
+  }
+  for (size_t i = n; i-- > 0;) {
+    c[i + 2] = i == n - 1 ? dp[i] : Eigen::Vector3d(dp[i] - cp[i] * c[i + 3]);
+  }
+  c[0] = 2 * c[1] - c[2];
+  c[M + 1] = 2 * c[M] - c[M - 1];
+  return c;
+}
+
+/**
+ * @brief cumulative basis of a uniform cubic B-spline
+ */
+Eigen::Vector3d CumulativeBasis(double u) {
+  const double u2 = u * u;
+  const double u3 = u2 * u;
+  return Eigen::Vector3d(5 + 3 * u - 3 * u2 + u3, 1 + 3 * u + 3 * u2 - 2 * u3,
+                         u3) /
+         6.0;
+}
+
+} // namespace
+
+bool TrajectorySpline::Fit(const Trajectory& trajectory,
+                           const ros::Time& start_time,
+                           const ros::Duration& knot_interval,
+                           size_t num_knots, TrajectorySpline& spline,
+                           std::string& error_msg) {
+  if (num_knots < 2 || knot_interval <= ros::Duration(0)) {
+    error_msg = "A spline needs at least two knots with a positive interval.";
+    return false;
+  }
+  std::vector<ros::Time> knot_times(num_knots);
+  for (size_t k = 0; k < num_knots; k++) {
+    knot_times[k].fromNSec(start_time.toNSec() + k * knot_interval.toNSec());
+  }
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+  if (!trajectory.Get(Ts, knot_times, error_msg)) { return false; }
+
+  spline = TrajectorySpline();
+  spline.start_time_ = knot_times.front();
+  spline.end_time_ = knot_times.back();
+  spline.knot_interval_ = knot_interval;
+
+  const size_t M = num_knots;
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> x(M);
+  for (size_t k = 0; k < M; k++) { x[k] = Ts[k].block<3, 1>(0, 3); }
+  spline.positions_ = InterpolatingControlPoints(x);
+
+  // the orientations are not linear in the control points, so they start at
+  // the knot orientations and are corrected by the control points which
+  // interpolate the errors at the knots, until the spline goes through them.
+  // The end knots are always interpolated
+  std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond>>
+      targets(M);
+  for (size_t k = 0; k < M; k++) {
+    targets[k] = Eigen::Quaterniond(Ts[k].block<3, 3>(0, 0)).normalized();
+  }
+  auto& q = spline.orientations_;
+  auto& deltas = spline.orientation_deltas_;
+  q.resize(M + 2);
+  deltas.resize(M + 2, Eigen::Vector3d::Zero());
+  for (size_t k = 0; k < M; k++) { q[k + 1] = targets[k]; }
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+      errors(M, Eigen::Vector3d::Zero());
+  for (int iteration = 0;; iteration++) {
+    q[0] = q[1] * Exp(-Log(q[1].inverse() * q[2]));
+    q[M + 1] = q[M] * Exp(Log(q[M - 1].inverse() * q[M]));
+    for (size_t i = 1; i < M + 2; i++) {
+      deltas[i] = Log(q[i - 1].inverse() * q[i]);
+    }
+    if (iteration == kMaxOrientationIterations) { break; }
+
+    double max_error = 0;
+    for (size_t k = 1; k + 1 < M; k++) {
+      errors[k] = Log(spline.EvaluateOrientation(k, 0).inverse() * targets[k]);
+      max_error = std::max(max_error, errors[k].norm());
+    }
+    if (max_error < kMaxOrientationError) { break; }
+    const auto corrections = InterpolatingControlPoints(errors);
+    for (size_t k = 1; k + 1 < M; k++) {
+      q[k + 1] = (q[k + 1] * Exp(corrections[k + 1])).normalized();
+    }
+  }
+  return true;
+}
+
+bool TrajectorySpline::Get(Eigen::Matrix4d& T, const ros::Time& time,
+                           std::string& error_msg) const {
+  if (Empty()) {
+    error_msg = "Spline is empty.";
+    return false;
+  }
+  if (time < start_time_ || time > end_time_) {
+    error_msg = "Requested time " + std::to_string(time.toSec()) +
+                " is outside of the spline, from " +
+                std::to_string(start_time_.toSec()) + " to " +
+                std::to_string(end_time_.toSec());
+    return false;
+  }
+  T = Evaluate(time);
+  return true;
+}
+
+bool TrajectorySpline::Get(std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts,
+                           const std::vector<ros::Time>& times,
+                           std::string& error_msg) const {
+  Ts.resize(times.size());
+  for (size_t i = 0; i < times.size(); i++) {
+    if (!Get(Ts[i], times[i], error_msg)) {
+      Ts.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+Eigen::Matrix4d TrajectorySpline::Evaluate(const ros::Time& time) const {
+  const double t = (time - start_time_).toSec() / knot_interval_.toSec();
+  const size_t num_segments = positions_.size() - 3;
+  const size_t s = std::min(static_cast<size_t>(t), num_segments - 1);
+  const double u = t - s;
+  const Eigen::Vector3d lambda = CumulativeBasis(u);
+
+  const auto& c = positions_;
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) = EvaluateOrientation(s, u).toRotationMatrix();
+  T.block<3, 1>(0, 3) = c[s] + lambda[0] * (c[s + 1] - c[s]) +
+                        lambda[1] * (c[s + 2] - c[s + 1]) +
+                        lambda[2] * (c[s + 3] - c[s + 2]);
+  return T;
+}
+
+Eigen::Quaterniond TrajectorySpline::EvaluateOrientation(size_t s,
+                                                         double u) const {
+  const Eigen::Vector3d lambda = CumulativeBasis(u);
+  Eigen::Quaterniond q = orientations_[s];
+  for (int j = 0; j < 3; j++) {
+    q = q * Exp(lambda[j] * orientation_deltas_[s + j + 1]);
+  }
+  return q.normalized();
+}
+
+TrajectorySplineCache::TrajectorySplineCache(const Params& params)
+    : params_(params) {
+  knot_interval_ns_ = std::max<int64_t>(params_.knot_interval.toNSec(), 1);
+  knots_per_window_ = std::max<int64_t>(
+      std::llround(params_.window_duration.toSec() /
+                   (knot_interval_ns_ * 1e-9)),
+      1);
+}
+
+bool TrajectorySplineCache::Get(
+    const Trajectory& trajectory,
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts,
+    const std::vector<ros::Time>& times, std::string& error_msg) {
+  Ts.clear();
+  if (times.empty()) { return true; }
+  Ts.resize(times.size());
+  if (trajectory.Empty()) { return trajectory.Get(Ts, times, error_msg); }
+
+  // the spline is only loaded again when the times enter a new window
+  const int64_t window_ns = knot_interval_ns_ * knots_per_window_;
+  int64_t window_index = -1;
+  std::shared_ptr<const TrajectorySpline> spline;
+  for (size_t i = 0; i < times.size(); i++) {
+    const ros::Time& time = times[i];
+    const int64_t index = static_cast<int64_t>(time.toNSec()) / window_ns;
+    if (!time.isZero() && index != window_index) {
+      window_index = index;
+      spline = GetWindow(trajectory, index);
+    }
+    if (!time.isZero() && spline && time >= spline->StartTime() &&
+        time <= spline->EndTime()) {
+      spline->Get(Ts[i], time, error_msg);
+    } else if (!trajectory.Get(Ts[i], time, error_msg)) {
+      Ts.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void TrajectorySplineCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  windows_.clear();
+}
+
+std::shared_ptr<const TrajectorySpline>
+    TrajectorySplineCache::GetWindow(const Trajectory& trajectory,
+                                     int64_t index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = windows_.find(index);
+  if (iter != windows_.end() &&
+      (iter->second.complete ||
+       iter->second.trajectory_end == trajectory.EndTime())) {
+    return iter->second.spline;
+  }
+
+  // knots on the grid of the window which are within the trajectory
+  const int64_t window_ns = knots_per_window_ * knot_interval_ns_;
+  const int64_t window_start = index * window_ns;
+  const int64_t window_end = window_start + window_ns;
+  const int64_t trajectory_start = trajectory.StartTime().toNSec();
+  const int64_t trajectory_end = trajectory.EndTime().toNSec();
+  const int64_t first_knot = std::max(
+      window_start, (trajectory_start + knot_interval_ns_ - 1) /
+                        knot_interval_ns_ * knot_interval_ns_);
+  const int64_t last_knot = std::min(
+      window_end, trajectory_end / knot_interval_ns_ * knot_interval_ns_);
+
+  Window window;
+  window.complete = trajectory_end >= window_end;
+  window.trajectory_end = trajectory.EndTime();
+  if (last_knot > first_knot) {
+    auto spline = std::make_shared<TrajectorySpline>();
+    std::string error_msg;
+    ros::Time start_time;
+    start_time.fromNSec(first_knot);
+    ros::Duration knot_interval;
+    knot_interval.fromNSec(knot_interval_ns_);
+    const size_t num_knots = (last_knot - first_knot) / knot_interval_ns_ + 1;
+    if (TrajectorySpline::Fit(trajectory, start_time, knot_interval, num_knots,
+                              *spline, error_msg)) {
+      window.spline = std::move(spline);
+    }
+  }
+  windows_[index] = window;
+  while (windows_.size() > params_.max_windows) {
+    windows_.erase(windows_.begin());
+  }
+  return window.spline;
+}
+
+} // namespace bs_common
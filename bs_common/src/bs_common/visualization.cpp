@@ -114,45 +114,39 @@ pcl::PointCloud<pcl::PointXYZRGBL>
   return cloud;
 }
 
+namespace {
+
+/**
+ * @brief Collects the pose and velocity of each stamp as an IMU state
+ */
+class ImuStateCollector : public GraphVisitor {
+public:
+  void Visit(const fuse_variables::Position3DStamped& v) override {
+    State(v.stamp()).SetPosition(v.x(), v.y(), v.z());
+  }
+  void Visit(const fuse_variables::Orientation3DStamped& v) override {
+    State(v.stamp()).SetOrientation(v.w(), v.x(), v.y(), v.z());
+  }
+  void Visit(const fuse_variables::VelocityLinear3DStamped& v) override {
+    State(v.stamp()).SetVelocity(v.x(), v.y(), v.z());
+  }
+
+  std::map<uint64_t, ImuState> states;
+
+private:
+  ImuState& State(const ros::Time& stamp) {
+    return states.try_emplace(stamp.toNSec(), stamp).first->second;
+  }
+};
+
+} // namespace
+
 pcl::PointCloud<pcl::PointXYZRGBL>
     GetGraphPosesAsCloud(const fuse_core::Graph& graph) {
   // save as IMU state so we can reuse the pointcloud function above
-  std::map<uint64_t, ImuState> poses;
-  const auto var_range = graph.getVariables();
-  for (auto it = var_range.begin(); it != var_range.end(); it++) {
-    if (it->type() == "fuse_variables::Position3DStamped") {
-      auto v = dynamic_cast<const fuse_variables::Position3DStamped&>(*it);
-      uint64_t t = v.stamp().toNSec();
-      if (poses.find(t) != poses.end()) {
-        poses.at(t).SetPosition(v.x(), v.y(), v.z());
-      } else {
-        ImuState state(v.stamp());
-        state.SetPosition(v.x(), v.y(), v.z());
-        poses.emplace(t, state);
-      }
-    } else if (it->type() == "fuse_variables::Orientation3DStamped") {
-      auto v = dynamic_cast<const fuse_variables::Orientation3DStamped&>(*it);
-      uint64_t t = v.stamp().toNSec();
-      if (poses.find(t) != poses.end()) {
-        poses.at(t).SetOrientation(v.w(), v.x(), v.y(), v.z());
-      } else {
-        ImuState state(v.stamp());
-        state.SetOrientation(v.w(), v.x(), v.y(), v.z());
-        poses.emplace(t, state);
-      }
-    } else if (it->type() == "fuse_variables::VelocityLinear3DStamped") {
-      auto v =
-          dynamic_cast<const fuse_variables::VelocityLinear3DStamped&>(*it);
-      uint64_t t = v.stamp().toNSec();
-      if (poses.find(t) != poses.end()) {
-        poses.at(t).SetVelocity(v.x(), v.y(), v.z());
-      } else {
-        ImuState state(v.stamp());
-        state.SetVelocity(v.x(), v.y(), v.z());
-        poses.emplace(t, state);
-      }
-    }
-  }
+  ImuStateCollector collector;
+  VisitGraph(graph, {&collector});
+  const std::map<uint64_t, ImuState>& poses = collector.states;
 
   pcl::PointCloud<pcl::PointXYZRGBL> cloud;
   for (const auto& [t, imu_state] : poses) {
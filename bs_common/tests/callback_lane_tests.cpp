@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <future>
+
+#include <ros/callback_queue.h>
+
+#include <bs_common/callback_lane.h>
+
+using Lane = bs_common::CallbackLane<int>;
+
+TEST(CallbackLane, Unbounded) {
+  ros::CallbackQueue queue;
+  std::vector<int> received;
+  Lane lane("test/unbounded_lane", &queue,
+            [&](const std::shared_ptr<const int>& value) {
+              received.push_back(*value);
+            },
+            Lane::Params());
+  for (int i = 0; i < 3; i++) { lane.Push(std::make_shared<int>(i)); }
+  EXPECT_EQ(lane.GetStats().pending, 3);
+  queue.callAvailable();
+  EXPECT_EQ(received, std::vector<int>({0, 1, 2}));
+
+  const Lane::Stats stats = lane.GetStats();
+  EXPECT_EQ(stats.pending, 0);
+  EXPECT_EQ(stats.max_pending, 3);
+  EXPECT_EQ(stats.processed, 3);
+  EXPECT_EQ(stats.superseded, 0);
+}
+
+TEST(CallbackLane, Supersede) {
+  ros::CallbackQueue queue;
+  std::vector<int> received;
+  Lane::Params params;
+  params.queue_size = 1;
+  Lane lane("test/supersede_lane", &queue,
+            [&](const std::shared_ptr<const int>& value) {
+              received.push_back(*value);
+            },
+            params);
+  for (int i = 0; i < 4; i++) { lane.Push(std::make_shared<int>(i)); }
+  EXPECT_EQ(lane.GetStats().pending, 1);
+  queue.callAvailable();
+  EXPECT_EQ(received, std::vector<int>({3}));
+  EXPECT_EQ(lane.GetStats().superseded, 3);
+  EXPECT_EQ(bs_common::Instrumentation::GetInstance()
+                .GetMetric("test/supersede_lane/superseded")
+                .Summarize()
+                .counter,
+            3);
+
+  // cleared values are never processed
+  lane.Push(std::make_shared<int>(4));
+  lane.Clear();
+  queue.callAvailable();
+  EXPECT_EQ(received.size(), 1);
+  lane.Push(std::make_shared<int>(5));
+  queue.callAvailable();
+  EXPECT_EQ(received, std::vector<int>({3, 5}));
+}
+
+TEST(CallbackLane, Dedicated) {
+  ros::CallbackQueue queue;
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  std::mutex mutex;
+  std::vector<int> received;
+  Lane::Params params;
+  params.queue_size = 1;
+  params.dedicated = true;
+  Lane lane("test/dedicated_lane", &queue,
+            [&](const std::shared_ptr<const int>& value) {
+              unblocked.wait();
+              std::lock_guard<std::mutex> lock(mutex);
+              received.push_back(*value);
+            },
+            params);
+
+  // the first value blocks the lane, the next ones supersede each other
+  lane.Push(std::make_shared<int>(0));
+  while (lane.GetStats().processed == 0) { std::this_thread::yield(); }
+  for (int i = 1; i < 4; i++) { lane.Push(std::make_shared<int>(i)); }
+  unblock.set_value();
+  while (lane.GetStats().processed < 2) { std::this_thread::yield(); }
+  lane.Clear();
+
+  // nothing runs on the callback queue
+  EXPECT_TRUE(queue.isEmpty());
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_EQ(received, std::vector<int>({0, 3}));
+  EXPECT_EQ(lane.GetStats().superseded, 2);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
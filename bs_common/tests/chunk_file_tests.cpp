@@ -0,0 +1,140 @@
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/chunk_file.h>
+
+namespace {
+
+std::string TestFilePath() {
+  return "/tmp/bs_common_chunk_file_test_" + std::to_string(getpid()) + ".bin";
+}
+
+} // namespace
+
+TEST(ChunkFile, WriteRead) {
+  const std::string path = TestFilePath();
+  const Eigen::Matrix4d T = Eigen::Matrix4d::Random();
+  const std::vector<float> points{1.0f, 2.0f, 3.0f, 4.5f};
+
+  bs_common::ChunkFileWriter writer;
+  ASSERT_TRUE(writer.Open(path, 3));
+  for (uint64_t id = 0; id < 10; id++) {
+    bs_common::ByteWriter data;
+    data.Write<uint64_t>(id);
+    data.WriteMatrix(T);
+    data.WriteString("chunk" + std::to_string(id));
+    data.WriteVector(points);
+    // add out of order
+    EXPECT_TRUE(writer.AddChunk(id % 2, 9 - id, data));
+  }
+  EXPECT_TRUE(writer.AddChunk(5, 0, bs_common::ByteWriter()));
+  ASSERT_TRUE(writer.Close());
+  EXPECT_FALSE(writer.AddChunk(0, 100, bs_common::ByteWriter()));
+
+  EXPECT_TRUE(bs_common::ChunkFileReader::IsChunkFile(path));
+  bs_common::ChunkFileReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  EXPECT_EQ(reader.Version(), 3u);
+  EXPECT_EQ(reader.Find(2, 0), nullptr);
+  EXPECT_EQ(reader.Find(0, 0), nullptr);
+
+  const auto chunks = reader.Chunks(1);
+  ASSERT_EQ(chunks.size(), 5u);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    EXPECT_EQ(chunks[i].id, 2 * i);
+    const bs_common::ChunkInfo* chunk = reader.Find(1, chunks[i].id);
+    ASSERT_NE(chunk, nullptr);
+    bs_common::ByteReader data = reader.Read(*chunk);
+    const uint64_t id = 9 - chunks[i].id;
+    EXPECT_EQ(data.Read<uint64_t>(), id);
+    Eigen::Matrix4d T_read;
+    data.ReadMatrix(T_read);
+    EXPECT_TRUE(T_read.isApprox(T));
+    EXPECT_EQ(data.ReadString(), "chunk" + std::to_string(id));
+    std::vector<float> points_read;
+    data.ReadVector(points_read);
+    EXPECT_EQ(points_read, points);
+    EXPECT_EQ(data.Remaining(), 0u);
+    EXPECT_THROW(data.Read<uint8_t>(), std::runtime_error);
+  }
+
+  // evicted chunks are read from the file again
+  for (const auto& chunk : chunks) { reader.Evict(chunk); }
+  bs_common::ByteReader evicted = reader.Read(chunks.front());
+  EXPECT_EQ(evicted.Read<uint64_t>(), 9u);
+
+  const bs_common::ChunkInfo* empty = reader.Find(5, 0);
+  ASSERT_NE(empty, nullptr);
+  EXPECT_EQ(empty->size, 0u);
+  reader.Close();
+  EXPECT_FALSE(reader.IsOpen());
+  std::remove(path.c_str());
+}
+
+TEST(ChunkFile, Invalid) {
+  const std::string path = TestFilePath();
+  bs_common::ChunkFileReader reader;
+  EXPECT_FALSE(reader.Open(path));
+
+  // unfinished files are not readable
+  bs_common::ChunkFileWriter writer;
+  ASSERT_TRUE(writer.Open(path, 1));
+  bs_common::ByteWriter data;
+  data.Write<double>(1.0);
+  EXPECT_TRUE(writer.AddChunk(0, 0, data));
+  EXPECT_FALSE(bs_common::ChunkFileReader::IsChunkFile(path));
+  writer.Close();
+  EXPECT_TRUE(reader.Open(path));
+
+  // truncated files are rejected
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "BSCHUNK";
+    file.put('\0');
+  }
+  EXPECT_FALSE(reader.Open(path));
+  std::remove(path.c_str());
+}
+
+TEST(ChunkFile, ParallelWrite) {
+  const std::string path = TestFilePath();
+  bs_common::ChunkFileWriter writer;
+  ASSERT_TRUE(writer.Open(path, 1));
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < 4; t++) {
+    threads.emplace_back([&writer, t]() {
+      for (uint64_t id = 0; id < 100; id++) {
+        bs_common::ByteWriter data;
+        data.WriteVector(std::vector<uint64_t>(id, t));
+        writer.AddChunk(t, id, data);
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  ASSERT_TRUE(writer.Close());
+
+  bs_common::ChunkFileReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  for (uint32_t t = 0; t < 4; t++) {
+    const auto chunks = reader.Chunks(t);
+    ASSERT_EQ(chunks.size(), 100u);
+    for (const auto& chunk : chunks) {
+      bs_common::ByteReader data = reader.Read(chunk);
+      std::vector<uint64_t> values;
+      data.ReadVector(values);
+      EXPECT_EQ(values, std::vector<uint64_t>(chunk.id, t));
+    }
+  }
+  std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
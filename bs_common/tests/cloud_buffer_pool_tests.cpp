@@ -0,0 +1,117 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/cloud_buffer_pool.h>
+
+namespace {
+
+using Pool = bs_common::CloudBufferPool<pcl::PointXYZ>;
+
+uint64_t Counter(const std::string& name) {
+  return bs_common::Instrumentation::GetInstance()
+      .GetMetric(name)
+      .Summarize()
+      .counter;
+}
+
+pcl::PointCloud<pcl::PointXYZ> Fill(Pool& pool, size_t size) {
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  pool.Acquire(cloud, size);
+  for (size_t i = 0; i < size; i++) { cloud.push_back(pcl::PointXYZ(i, 0, 0)); }
+  return cloud;
+}
+
+} // namespace
+
+TEST(CloudBufferPool, ReuseStorage) {
+  Pool pool("test_cloud_pool");
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  pool.Acquire(cloud, 3000);
+  EXPECT_TRUE(cloud.empty());
+  // rounded up to the size class
+  EXPECT_EQ(cloud.points.capacity(), 4096u);
+  const pcl::PointXYZ* data = cloud.points.data();
+  cloud.push_back(pcl::PointXYZ(1, 2, 3));
+
+  pool.Release(cloud);
+  EXPECT_TRUE(cloud.empty());
+  EXPECT_EQ(pool.NumFreeBuffers(), 1u);
+
+  // any size of the class gets the same buffer
+  pcl::PointCloud<pcl::PointXYZ> reused;
+  pool.Acquire(reused, 2100);
+  EXPECT_TRUE(reused.empty());
+  EXPECT_EQ(reused.points.data(), data);
+  EXPECT_EQ(pool.NumFreeBuffers(), 0u);
+  EXPECT_EQ(Counter("cloud_pool/test_cloud_pool/allocated"), 1u);
+  EXPECT_EQ(Counter("cloud_pool/test_cloud_pool/reused"), 1u);
+  EXPECT_EQ(Counter("cloud_pool/test_cloud_pool/released"), 1u);
+  EXPECT_EQ(bs_common::MemoryAccounting::GetInstance()
+                .GetAccount("cloud_pool/test_cloud_pool")
+                .Bytes(),
+            0u);
+}
+
+TEST(CloudBufferPool, SizeClasses) {
+  Pool pool("test_cloud_pool_classes", 2);
+
+  // buffers which are too small are not kept
+  pcl::PointCloud<pcl::PointXYZ> small;
+  pool.Acquire(small, 10);
+  pool.Release(small);
+  EXPECT_EQ(pool.NumFreeBuffers(), 0u);
+
+  // a buffer is not handed out for requests larger than its capacity, nor
+  // for requests much smaller than it
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  pool.Acquire(cloud, 1 << 12);
+  pool.Release(cloud);
+  pool.Acquire(cloud, (1 << 12) + 1);
+  EXPECT_EQ(cloud.points.capacity(), 1u << 13);
+  EXPECT_EQ(pool.NumFreeBuffers(), 1u);
+  pool.Release(cloud);
+  EXPECT_EQ(pool.NumFreeBuffers(), 2u);
+  pcl::PointCloud<pcl::PointXYZ> a;
+  pool.Acquire(a, 1 << 10);
+  EXPECT_EQ(a.points.capacity(), 1u << 12);
+  pcl::PointCloud<pcl::PointXYZ> b;
+  pool.Acquire(b, 1 << 10);
+  EXPECT_EQ(b.points.capacity(), 1u << 10);
+  EXPECT_EQ(pool.NumFreeBuffers(), 1u);
+
+  // at most two buffers per class are kept
+  pool.Clear();
+  EXPECT_EQ(pool.NumFreeBuffers(), 0u);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> clouds;
+  for (int i = 0; i < 4; i++) { clouds.push_back(Fill(pool, 1 << 11)); }
+  for (auto& c : clouds) { pool.Release(c); }
+  EXPECT_EQ(pool.NumFreeBuffers(), 2u);
+}
+
+TEST(CloudBufferPool, Share) {
+  Pool pool("test_cloud_pool_share");
+  auto cloud = Fill(pool, 2000);
+  const pcl::PointXYZ* data = cloud.points.data();
+  std::shared_ptr<const pcl::PointCloud<pcl::PointXYZ>> shared =
+      pool.Share(cloud);
+  EXPECT_TRUE(cloud.empty());
+  ASSERT_EQ(shared->size(), 2000u);
+  EXPECT_EQ(shared->points.data(), data);
+  EXPECT_EQ(shared->width, 2000u);
+
+  // the storage goes back to the pool with the last copy
+  auto copy = shared;
+  shared.reset();
+  EXPECT_EQ(pool.NumFreeBuffers(), 0u);
+  copy.reset();
+  EXPECT_EQ(pool.NumFreeBuffers(), 1u);
+  pcl::PointCloud<pcl::PointXYZ> reused;
+  pool.Acquire(reused, 2000);
+  EXPECT_EQ(reused.points.data(), data);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+#include <bs_common/flat_time_map.h>
+
+TEST(FlatTimeMap, SortedInsertion) {
+  bs_common::FlatTimeMap<uint64_t, std::string> map;
+  EXPECT_TRUE(map.emplace(2, "b").second);
+  EXPECT_TRUE(map.emplace(3, "c").second);
+  EXPECT_TRUE(map.insert({1, "a"}).second);
+
+  // existing keys are not replaced
+  const auto [it, inserted] = map.emplace(2, "x");
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(it->second, "b");
+
+  std::string values;
+  for (const auto& [stamp, value] : map) { values += value; }
+  EXPECT_EQ(values, "abc");
+  EXPECT_EQ(map.size(), 3);
+  EXPECT_EQ(map.begin()->first, 1);
+  EXPECT_EQ(map.rbegin()->first, 3);
+
+  map[4] = "d";
+  EXPECT_EQ(map.at(4), "d");
+  EXPECT_THROW(map.at(5), std::out_of_range);
+}
+
+TEST(FlatTimeMap, Lookup) {
+  bs_common::FlatTimeMap<uint64_t, int> map;
+  for (uint64_t t = 10; t <= 50; t += 10) { map.emplace(t, t / 10); }
+  EXPECT_EQ(map.find(30)->second, 3);
+  EXPECT_EQ(map.find(35), map.end());
+  EXPECT_EQ(map.count(40), 1);
+  EXPECT_EQ(map.count(45), 0);
+  EXPECT_EQ(map.lower_bound(25)->first, 30);
+  EXPECT_EQ(map.lower_bound(30)->first, 30);
+  EXPECT_EQ(map.upper_bound(30)->first, 40);
+  EXPECT_EQ(map.upper_bound(50), map.end());
+}
+
+TEST(FlatTimeMap, Erase) {
+  bs_common::FlatTimeMap<uint64_t, int> map;
+  for (uint64_t t = 0; t < 10; t++) { map.emplace(t, t); }
+  EXPECT_EQ(map.erase(5), 1);
+  EXPECT_EQ(map.erase(5), 0);
+  map.erase(map.begin());
+  map.erase(map.begin(), map.lower_bound(3));
+  EXPECT_EQ(map.size(), 6);
+  EXPECT_EQ(map.begin()->first, 3);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(FlatTimeMap, MatchesStdMap) {
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<uint64_t> stamps(0, 200);
+  bs_common::FlatTimeMap<uint64_t, uint64_t> map;
+  std::map<uint64_t, uint64_t> expected;
+  for (int i = 0; i < 1000; i++) {
+    const uint64_t stamp = stamps(generator);
+    if (i % 3 == 0) {
+      EXPECT_EQ(map.erase(stamp), expected.erase(stamp));
+    } else {
+      EXPECT_EQ(map.emplace(stamp, i).second,
+                expected.emplace(stamp, i).second);
+    }
+  }
+  ASSERT_EQ(map.size(), expected.size());
+  auto expected_it = expected.begin();
+  for (const auto& [stamp, value] : map) {
+    EXPECT_EQ(stamp, expected_it->first);
+    EXPECT_EQ(value, expected_it->second);
+    expected_it++;
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,44 @@
+#include <fuse_core/uuid.h>
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <gtest/gtest.h>
+
+#include <bs_common/graph_view.h>
+
+TEST(GraphView, DevicesAtSameStamp) {
+  const ros::Time stamp(1);
+  const fuse_core::UUID device = fuse_core::uuid::generate("device");
+  auto graph = std::make_shared<fuse_graphs::HashGraph>();
+  auto position = fuse_variables::Position3DStamped::make_shared(stamp);
+  position->x() = 1;
+  auto device_position =
+      fuse_variables::Position3DStamped::make_shared(stamp, device);
+  device_position->x() = 2;
+  auto device_orientation =
+      fuse_variables::Orientation3DStamped::make_shared(stamp, device);
+  graph->addVariable(device_position);
+  graph->addVariable(position);
+  graph->addVariable(device_orientation);
+
+  const bs_common::GraphView view(graph);
+  ASSERT_NE(view.GetPosition(stamp), nullptr);
+  EXPECT_EQ(view.GetPosition(stamp)->uuid(), position->uuid());
+  EXPECT_EQ(view.GetPosition(stamp)->x(), 1);
+  ASSERT_NE(view.GetPosition(stamp, device), nullptr);
+  EXPECT_EQ(view.GetPosition(stamp, device)->uuid(), device_position->uuid());
+  EXPECT_EQ(view.GetPosition(stamp, device)->x(), 2);
+
+  // only the device has an orientation
+  EXPECT_EQ(view.GetOrientation(stamp), nullptr);
+  ASSERT_NE(view.GetOrientation(stamp, device), nullptr);
+  EXPECT_EQ(view.GetOrientation(stamp, device)->uuid(),
+            device_orientation->uuid());
+  EXPECT_EQ(view.GetPosition(ros::Time(2), device), nullptr);
+  EXPECT_EQ(view.Timestamps().size(), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <bs_common/imu_sample_buffer.h>
+
+namespace {
+
+bs_common::ImuSample MakeSample(double t) {
+  bs_common::ImuSample sample;
+  sample.stamp = ros::Time(t);
+  sample.w = Eigen::Vector3d::Constant(t);
+  sample.a = Eigen::Vector3d::Constant(-t);
+  sample.q_WORLD.setIdentity();
+  return sample;
+}
+
+void ExpectStamps(const bs_common::ImuSampleBuffer::View& view,
+                  const std::vector<double>& stamps) {
+  ASSERT_EQ(view.size(), stamps.size());
+  size_t i = 0;
+  for (const auto& sample : view) {
+    EXPECT_EQ(sample.stamp, ros::Time(stamps[i]));
+    EXPECT_EQ(sample.w, Eigen::Vector3d::Constant(stamps[i]));
+    i++;
+  }
+}
+
+} // namespace
+
+TEST(ImuSampleBuffer, AddKeepsSamplesSorted) {
+  bs_common::ImuSampleBuffer buffer;
+  EXPECT_TRUE(buffer.Add(MakeSample(1)));
+  EXPECT_TRUE(buffer.Add(MakeSample(3)));
+  EXPECT_TRUE(buffer.Add(MakeSample(2)));
+  EXPECT_TRUE(buffer.Add(MakeSample(0.5)));
+  EXPECT_FALSE(buffer.Add(MakeSample(2)));
+  ExpectStamps(buffer.All(), {0.5, 1, 2, 3});
+}
+
+TEST(ImuSampleBuffer, RangeQueries) {
+  bs_common::ImuSampleBuffer buffer;
+  for (int i = 1; i <= 10; i++) { buffer.Add(MakeSample(i)); }
+
+  ExpectStamps(buffer.Range(ros::Time(3), ros::Time(5)), {3, 4, 5});
+  ExpectStamps(buffer.Range(ros::Time(2.5), ros::Time(4.5)), {3, 4});
+  ExpectStamps(buffer.Range(ros::Time(10.5), ros::Time(11)), {});
+  ExpectStamps(buffer.Range(ros::Time(0), ros::Time(0.5)), {});
+  ExpectStamps(buffer.After(ros::Time(8)), {9, 10});
+  EXPECT_EQ(buffer.LowerBound(ros::Time(4.5))->stamp, ros::Time(5));
+  EXPECT_EQ(buffer.LowerBound(ros::Time(11)), buffer.end());
+}
+
+TEST(ImuSampleBuffer, Closest) {
+  bs_common::ImuSampleBuffer buffer;
+  EXPECT_EQ(buffer.Closest(ros::Time(1), ros::Duration(1)), nullptr);
+  for (int i = 1; i <= 5; i++) { buffer.Add(MakeSample(i)); }
+
+  const ros::Duration max_offset(0.4);
+  EXPECT_EQ(buffer.Closest(ros::Time(2.6), max_offset)->stamp, ros::Time(3));
+  EXPECT_EQ(buffer.Closest(ros::Time(2.3), max_offset)->stamp, ros::Time(2));
+  EXPECT_EQ(buffer.Closest(ros::Time(4), max_offset)->stamp, ros::Time(4));
+  EXPECT_EQ(buffer.Closest(ros::Time(5.3), max_offset)->stamp, ros::Time(5));
+  EXPECT_EQ(buffer.Closest(ros::Time(0.7), max_offset)->stamp, ros::Time(1));
+  EXPECT_EQ(buffer.Closest(ros::Time(0.5), max_offset), nullptr);
+  EXPECT_EQ(buffer.Closest(ros::Time(5.5), max_offset), nullptr);
+}
+
+TEST(ImuSampleBuffer, TrimsToMaxDurationAcrossWrap) {
+  // add enough samples for the ring to grow and wrap several times
+  bs_common::ImuSampleBuffer buffer(ros::Duration(1.0));
+  const double dt = 0.001;
+  for (int i = 0; i < 5000; i++) { buffer.Add(MakeSample(i * dt)); }
+
+  EXPECT_EQ(buffer.Size(), 1001u);
+  EXPECT_NEAR(buffer.Front().stamp.toSec(), 3.999, 1e-9);
+  EXPECT_NEAR(buffer.Back().stamp.toSec(), 4.999, 1e-9);
+  for (size_t i = 1; i < buffer.Size(); i++) {
+    EXPECT_LT(buffer[i - 1].stamp, buffer[i].stamp);
+  }
+
+  buffer.RemoveBefore(ros::Time(4.5));
+  EXPECT_EQ(buffer.Size(), 500u);
+  EXPECT_NEAR(buffer.Front().stamp.toSec(), 4.5, 1e-9);
+
+  const auto view = buffer.Range(ros::Time(4.7), ros::Time(4.8));
+  EXPECT_EQ(view.size(), 101u);
+  EXPECT_NEAR(view.front().stamp.toSec(), 4.7, 1e-9);
+  EXPECT_NEAR(view.back().stamp.toSec(), 4.8, 1e-9);
+
+  buffer.Clear();
+  EXPECT_TRUE(buffer.Empty());
+  EXPECT_TRUE(buffer.All().empty());
+}
+
+TEST(ImuSampleBuffer, FixedCapacity) {
+  bs_common::ImuSampleBuffer buffer(ros::Duration(0), 100);
+  for (int i = 0; i < 1000; i++) { buffer.Add(MakeSample(i)); }
+  EXPECT_EQ(buffer.Size(), 100u);
+  EXPECT_EQ(buffer.Front().stamp, ros::Time(900));
+  EXPECT_EQ(buffer.Back().stamp, ros::Time(999));
+
+  // out of order samples replace the oldest one, unless they are older
+  EXPECT_TRUE(buffer.Add(MakeSample(950.5)));
+  EXPECT_EQ(buffer.Size(), 100u);
+  EXPECT_EQ(buffer.Front().stamp, ros::Time(901));
+  EXPECT_EQ(buffer.LowerBound(ros::Time(950.1))->stamp, ros::Time(950.5));
+  EXPECT_FALSE(buffer.Add(MakeSample(900.5)));
+  EXPECT_EQ(buffer.Front().stamp, ros::Time(901));
+}
+
+TEST(ImuSampleBuffer, ConvertsMessages) {
+  sensor_msgs::Imu msg;
+  msg.header.stamp = ros::Time(2);
+  msg.angular_velocity.x = 1;
+  msg.angular_velocity.y = 2;
+  msg.angular_velocity.z = 3;
+  msg.linear_acceleration.x = 4;
+  msg.linear_acceleration.y = 5;
+  msg.linear_acceleration.z = 6;
+  msg.orientation.w = 1;
+
+  bs_common::ImuSampleBuffer buffer;
+  buffer.Add(msg);
+  const bs_common::IMUData imu_data = buffer.Front().ToIMUData();
+  EXPECT_EQ(imu_data.t, ros::Time(2));
+  EXPECT_EQ(imu_data.w, Eigen::Vector3d(1, 2, 3));
+  EXPECT_EQ(imu_data.a, Eigen::Vector3d(4, 5, 6));
+  EXPECT_TRUE(buffer.Front().q_WORLD.isApprox(Eigen::Quaterniond::Identity()));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -135,6 +135,39 @@ TEST(ImuState, ImuState) {
   EXPECT_EQ(IS2.AccelBias().data()[2], ba_vec[2]);
 }
 
+TEST(ImuState, CompactImuState) {
+  Eigen::Quaterniond q_quat{Eigen::Quaterniond::UnitRandom()};
+  Eigen::Vector3d p_vec{1, 2, 3};
+  Eigen::Vector3d v_vec{0.1, 0.2, 0.3};
+  Eigen::Vector3d bg_vec{0.001, 0.002, 0.003};
+  Eigen::Vector3d ba_vec{0.0001, 0.0002, 0.0003};
+  bs_common::ImuState IS1(ros::Time(2), q_quat, p_vec, v_vec, bg_vec, ba_vec);
+
+  // compact state keeps the values
+  const bs_common::CompactImuState compact = IS1.Compact();
+  EXPECT_EQ(compact.Stamp(), ros::Time(2));
+  EXPECT_EQ(compact.OrientationQuat().coeffs(), IS1.OrientationQuat().coeffs());
+  EXPECT_EQ(compact.PositionVec(), p_vec);
+  EXPECT_EQ(compact.VelocityVec(), v_vec);
+  EXPECT_EQ(compact.GyroBiasVec(), bg_vec);
+  EXPECT_EQ(compact.AccelBiasVec(), ba_vec);
+
+  // and builds the same variables
+  bs_common::ImuState IS2(compact);
+  EXPECT_EQ(IS2.Stamp(), IS1.Stamp());
+  EXPECT_EQ(IS2.Orientation().uuid(), IS1.Orientation().uuid());
+  EXPECT_EQ(IS2.Position().uuid(), IS1.Position().uuid());
+  EXPECT_EQ(IS2.Velocity().uuid(), IS1.Velocity().uuid());
+  EXPECT_EQ(IS2.GyroBias().uuid(), IS1.GyroBias().uuid());
+  EXPECT_EQ(IS2.AccelBias().uuid(), IS1.AccelBias().uuid());
+  EXPECT_EQ(IS2.GetStateVector(), IS1.GetStateVector());
+
+  // default state
+  const bs_common::CompactImuState default_state(ros::Time(1));
+  EXPECT_EQ(bs_common::ImuState(default_state).GetStateVector(),
+            bs_common::ImuState(ros::Time(1)).GetStateVector());
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,132 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <ros/callback_queue.h>
+#include <std_msgs/Int32.h>
+
+#include <bs_common/intra_process.h>
+
+using bs_common::IntraProcessChannel;
+
+TEST(IntraProcessChannel, SharedPerTopicAndType) {
+  auto channel = IntraProcessChannel<int>::Get("/test/shared");
+  EXPECT_EQ(channel, IntraProcessChannel<int>::Get("/test/shared"));
+  EXPECT_NE(channel, IntraProcessChannel<int>::Get("/test/other"));
+  EXPECT_EQ(IntraProcessChannel<double>::Get("/test/shared")->NumSubscribers(),
+            0);
+
+  // channels are removed once unused
+  std::weak_ptr<IntraProcessChannel<int>> weak_channel = channel;
+  channel.reset();
+  EXPECT_TRUE(weak_channel.expired());
+}
+
+TEST(IntraProcessChannel, Publish) {
+  auto channel = IntraProcessChannel<int>::Get("/test/publish");
+  std::vector<bool> hook_calls;
+  std::vector<std::shared_ptr<const int>> received;
+  const uint64_t id = channel->AddSubscriber(
+      [&](const std::shared_ptr<const int>& data) {
+        received.push_back(data);
+      },
+      [&](bool has_publisher) { hook_calls.push_back(has_publisher); });
+  ASSERT_EQ(hook_calls.size(), 1);
+  EXPECT_FALSE(hook_calls[0]);
+
+  // hooks are only called when the first publisher is added or the last one
+  // is removed
+  channel->AddPublisher();
+  channel->AddPublisher();
+  EXPECT_TRUE(channel->HasPublisher());
+  ASSERT_EQ(hook_calls.size(), 2);
+  EXPECT_TRUE(hook_calls[1]);
+
+  // data is passed without copying
+  auto data = std::make_shared<const int>(3);
+  channel->Publish(data);
+  ASSERT_EQ(received.size(), 1);
+  EXPECT_EQ(received[0].get(), data.get());
+
+  channel->RemovePublisher();
+  EXPECT_EQ(hook_calls.size(), 2);
+  channel->RemovePublisher();
+  EXPECT_FALSE(channel->HasPublisher());
+  ASSERT_EQ(hook_calls.size(), 3);
+  EXPECT_FALSE(hook_calls[2]);
+
+  channel->RemoveSubscriber(id);
+  EXPECT_EQ(channel->NumSubscribers(), 0);
+  channel->Publish(data);
+  EXPECT_EQ(received.size(), 1);
+}
+
+TEST(IntraProcessSubscriber, SerializedCallbacks) {
+  const int num_threads = 4;
+  const int num_messages = 200;
+  using Data = std::pair<int, int>;
+
+  // with a publisher in the process no ROS subscriber is made, so this does
+  // not need a master
+  auto channel = IntraProcessChannel<Data>::Get("/test/serial");
+  channel->AddPublisher();
+
+  ros::CallbackQueue queue;
+  ros::NodeHandle node_handle;
+  node_handle.setCallbackQueue(&queue);
+  ros::AsyncSpinner spinner(num_threads, &queue);
+  spinner.start();
+
+  std::atomic<int> active{0};
+  std::atomic<int> overlaps{0};
+  std::atomic<int> received{0};
+  std::vector<int> last(num_threads, -1);
+  bool in_order{true};
+  bs_common::IntraProcessSubscriber<Data, std_msgs::Int32> subscriber(
+      node_handle, "/test/serial", num_threads * num_messages,
+      [&](const std::shared_ptr<const Data>& data) {
+        if (active++ > 0) { overlaps++; }
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        // only one callback runs at a time, so these need no lock
+        if (data->second <= last[data->first]) { in_order = false; }
+        last[data->first] = data->second;
+        active--;
+        received++;
+      },
+      [](const std_msgs::Int32& msg) {
+        return std::make_shared<const Data>(0, msg.data);
+      });
+
+  std::vector<std::thread> publishers;
+  for (int t = 0; t < num_threads; t++) {
+    publishers.emplace_back([&, t]() {
+      for (int i = 0; i < num_messages; i++) {
+        channel->Publish(std::make_shared<const Data>(t, i));
+      }
+    });
+  }
+  for (auto& publisher : publishers) { publisher.join(); }
+
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (received < num_threads * num_messages &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(received, num_threads * num_messages);
+  EXPECT_EQ(overlaps, 0);
+  EXPECT_TRUE(in_order);
+
+  // shut down before the publisher is removed, which would subscribe over ROS
+  subscriber.Shutdown();
+  spinner.stop();
+  channel->RemovePublisher();
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "intra_process_tests",
+            ros::init_options::NoRosout | ros::init_options::NoSigintHandler);
+  return RUN_ALL_TESTS();
+}
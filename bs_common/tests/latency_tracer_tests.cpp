@@ -0,0 +1,66 @@
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include <nlohmann/json.hpp>
+
+#include <bs_common/instrumentation.h>
+#include <bs_common/latency_tracer.h>
+
+TEST(LatencyTracer, RecordAndWrite) {
+  auto& tracer = bs_common::LatencyTracer::GetInstance();
+  const uint64_t count = bs_common::Instrumentation::GetInstance()
+                             .GetMetric("latency/test_stage")
+                             .Summarize()
+                             .count;
+
+  // events are not stored until enabled, but the age is always recorded
+  { bs_common::ScopedTrace trace("test_stage", ros::Time(1)); }
+  EXPECT_TRUE(tracer.Events().empty());
+
+  tracer.Enable(2);
+  const ros::WallTime receive = ros::WallTime::now();
+  for (int i = 0; i < 3; i++) {
+    bs_common::ScopedTrace trace("test_stage", ros::Time(1 + i), receive);
+  }
+  {
+    bs_common::ScopedTrace trace("test_stage", ros::Time(10));
+    trace.Cancel();
+  }
+  const auto events = tracer.Events();
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].sensor_stamp, ros::Time(2));
+  EXPECT_EQ(events[1].sensor_stamp, ros::Time(3));
+  for (const auto& event : events) {
+    EXPECT_EQ(event.receive, receive);
+    EXPECT_LE(event.receive, event.start);
+    EXPECT_LE(event.start, event.end);
+  }
+  EXPECT_EQ(bs_common::Instrumentation::GetInstance()
+                    .GetMetric("latency/test_stage")
+                    .Summarize()
+                    .count -
+                count,
+            4);
+
+  const std::string path = "/tmp/latency_tracer_tests.json";
+  ASSERT_TRUE(tracer.WriteChromeTrace(path));
+  nlohmann::json J;
+  std::ifstream file(path);
+  file >> J;
+  // one thread name and two complete events
+  ASSERT_EQ(J["traceEvents"].size(), 3);
+  EXPECT_EQ(J["traceEvents"][0]["ph"], "M");
+  EXPECT_EQ(J["traceEvents"][1]["ph"], "X");
+  EXPECT_EQ(J["traceEvents"][1]["name"], "test_stage");
+  EXPECT_DOUBLE_EQ(J["traceEvents"][2]["args"]["sensor_stamp"], 3.0);
+
+  tracer.Clear();
+  EXPECT_TRUE(tracer.Events().empty());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
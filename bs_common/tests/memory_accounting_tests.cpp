@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <bs_common/memory_accounting.h>
+
+TEST(MemoryAccounting, UpdateAndBudget) {
+  auto& accounting = bs_common::MemoryAccounting::GetInstance();
+
+  // budgets can be set before the owner updates the account
+  accounting.GetAccount("test/b").SetBudget(100);
+  auto& account_a = accounting.GetAccount("test/a");
+  auto& account_b = accounting.GetAccount("test/b");
+  EXPECT_EQ(&account_b, &accounting.GetAccount("test/b"));
+
+  account_a.Update(10, 1000);
+  account_b.Update(5, 50);
+  EXPECT_FALSE(account_a.OverBudget());
+  EXPECT_FALSE(account_b.OverBudget());
+  EXPECT_EQ(accounting.TotalBytes(), 1050);
+
+  account_b.Update(20, 200);
+  EXPECT_TRUE(account_b.OverBudget());
+  account_b.SetBudget(0);
+  EXPECT_FALSE(account_b.OverBudget());
+
+  const auto summaries = accounting.Summarize();
+  ASSERT_EQ(summaries.size(), 2);
+  EXPECT_EQ(summaries[0].name, "test/a");
+  EXPECT_EQ(summaries[0].elements, 10);
+  EXPECT_EQ(summaries[0].bytes, 1000);
+  EXPECT_EQ(summaries[0].budget_bytes, 0);
+  EXPECT_EQ(summaries[1].name, "test/b");
+  EXPECT_EQ(summaries[1].elements, 20);
+  EXPECT_EQ(summaries[1].bytes, 200);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <pcl/point_types.h>
+
+#include <bs_common/point_transforms.h>
+
+namespace {
+
+Eigen::Matrix4d Pose(double yaw, const Eigen::Vector3d& position) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      (Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()) *
+       Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitX()))
+          .toRotationMatrix();
+  T.block<3, 1>(0, 3) = position;
+  return T;
+}
+
+pcl::PointCloud<pcl::PointXYZI> CreateCloud() {
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  for (int i = 0; i < 100; i++) {
+    pcl::PointXYZI p;
+    p.x = 0.37 * i;
+    p.y = -0.11 * i;
+    p.z = 5 - 0.05 * i;
+    p.intensity = i;
+    cloud.push_back(p);
+  }
+  return cloud;
+}
+
+Eigen::Vector3d Transform(const Eigen::Matrix4d& T, const pcl::PointXYZI& p) {
+  return T.block<3, 3>(0, 0) * Eigen::Vector3d(p.x, p.y, p.z) +
+         T.block<3, 1>(0, 3);
+}
+
+} // namespace
+
+TEST(PointTransforms, TransformCloud) {
+  const auto cloud = CreateCloud();
+  const Eigen::Matrix4d T = Pose(0.7, Eigen::Vector3d(3, -2, 1));
+  pcl::PointCloud<pcl::PointXYZI> transformed;
+  bs_common::TransformCloud(cloud, transformed, T);
+  ASSERT_EQ(transformed.size(), cloud.size());
+  for (size_t i = 0; i < cloud.size(); i++) {
+    const Eigen::Vector3d expected = Transform(T, cloud[i]);
+    EXPECT_TRUE(transformed[i].getVector3fMap().cast<double>().isApprox(
+        expected, 1e-6));
+    EXPECT_EQ(transformed[i].intensity, cloud[i].intensity);
+  }
+
+  // in place gives the same points
+  auto in_place = cloud;
+  bs_common::TransformCloud(in_place, in_place, T);
+  for (size_t i = 0; i < cloud.size(); i++) {
+    EXPECT_EQ(in_place[i].getVector3fMap(), transformed[i].getVector3fMap());
+  }
+}
+
+TEST(PointTransforms, AppendTransformedCloud) {
+  const auto cloud = CreateCloud();
+  const Eigen::Matrix4d T = Pose(-1.2, Eigen::Vector3d(0.5, 4, -3));
+  pcl::PointCloud<pcl::PointXYZI> transformed;
+  bs_common::TransformCloud(cloud, transformed, T);
+
+  auto output = cloud;
+  bs_common::AppendTransformedCloud(cloud, T, output);
+  ASSERT_EQ(output.size(), 2 * cloud.size());
+  for (size_t i = 0; i < cloud.size(); i++) {
+    EXPECT_EQ(output[i].getVector3fMap(), cloud[i].getVector3fMap());
+    EXPECT_EQ(output[cloud.size() + i].getVector3fMap(),
+              transformed[i].getVector3fMap());
+  }
+}
+
+TEST(PointTransforms, RebaseFarFromWorldOrigin) {
+  // two scan origins a few meters apart, a thousand kilometers from the world
+  // origin
+  const Eigen::Matrix4d T_World_Old =
+      Pose(0.3, Eigen::Vector3d(1e6, -2e6, 30));
+  const Eigen::Matrix4d T_World_New =
+      Pose(0.35, Eigen::Vector3d(1e6 + 4.2, -2e6 + 1.3, 30.5));
+  const auto cloud = CreateCloud();
+  auto rebased = cloud;
+  bs_common::RebaseCloud(rebased, T_World_Old, T_World_New);
+
+  const Eigen::Matrix4d T_New_Old = T_World_New.inverse() * T_World_Old;
+  for (size_t i = 0; i < cloud.size(); i++) {
+    const Eigen::Vector3d expected = Transform(T_New_Old, cloud[i]);
+    EXPECT_LT((rebased[i].getVector3fMap().cast<double>() - expected).norm(),
+              1e-4);
+  }
+
+  // going through world coordinates in float loses centimeters
+  const Eigen::Matrix4f T_World_Old_f = T_World_Old.cast<float>();
+  const Eigen::Matrix4f T_New_World_f = T_World_New.inverse().cast<float>();
+  const Eigen::Vector4f P_Old(cloud[50].x, cloud[50].y, cloud[50].z, 1);
+  const Eigen::Vector4f P_New = T_New_World_f * (T_World_Old_f * P_Old);
+  EXPECT_GT((P_New.head<3>().cast<double>() - Transform(T_New_Old, cloud[50]))
+                .norm(),
+            1e-2);
+}
+
+TEST(PointTransforms, RelativeTransformFloat) {
+  const Eigen::Matrix4d T_World_A = Pose(1.0, Eigen::Vector3d(5e5, 5e5, 0));
+  const Eigen::Matrix4d T_World_B =
+      Pose(1.1, Eigen::Vector3d(5e5 + 0.25, 5e5 - 0.5, 0.1));
+  const Eigen::Matrix4f T_A_B =
+      bs_common::RelativeTransformFloat(T_World_A, T_World_B);
+  EXPECT_TRUE(T_A_B.cast<double>().isApprox(T_World_A.inverse() * T_World_B,
+                                           1e-6));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,81 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Dense>
+
+#include <bs_common/pool_allocator.h>
+
+namespace {
+
+struct PooledObject {
+  PooledObject(int id) : id(id) {}
+
+  int id;
+  Eigen::Matrix4d T{Eigen::Matrix4d::Identity()};
+};
+
+uint64_t Counter(const std::string& name) {
+  return bs_common::Instrumentation::GetInstance()
+      .GetMetric(name)
+      .Summarize()
+      .counter;
+}
+
+} // namespace
+
+TEST(FreeListPool, ReuseAndBound) {
+  bs_common::FreeListPool pool("test_pool", 24, 16, 2);
+  EXPECT_EQ(pool.BlockSize(), 24u);
+
+  void* a = pool.Allocate();
+  void* b = pool.Allocate();
+  void* c = pool.Allocate();
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % 16, 0u);
+  pool.Deallocate(a);
+  pool.Deallocate(b);
+  pool.Deallocate(c);
+  EXPECT_EQ(pool.NumFreeBlocks(), 2u);
+
+  // the last released block is handed out first
+  EXPECT_EQ(pool.Allocate(), b);
+  EXPECT_EQ(pool.NumFreeBlocks(), 1u);
+  EXPECT_EQ(Counter("pool/test_pool/allocated"), 3u);
+  EXPECT_EQ(Counter("pool/test_pool/reused"), 1u);
+  EXPECT_EQ(Counter("pool/test_pool/released"), 3u);
+}
+
+TEST(PoolAllocator, MakePooled) {
+  const std::string name =
+      "pool/" + boost::core::demangle(typeid(PooledObject).name());
+  const uint64_t allocated = Counter(name + "/allocated");
+  const uint64_t reused = Counter(name + "/reused");
+
+  std::vector<std::shared_ptr<PooledObject>> objects;
+  for (int i = 0; i < 10; i++) {
+    objects.push_back(bs_common::MakePooled<PooledObject>(true, i));
+  }
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(objects[i]->id, i);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(objects[i]->T.data()) %
+                  alignof(Eigen::Matrix4d),
+              0u);
+  }
+  objects.clear();
+
+  // released from other threads and reused
+  std::thread([&objects]() {
+    for (int i = 0; i < 10; i++) {
+      objects.push_back(bs_common::MakePooled<PooledObject>(true, i));
+    }
+  }).join();
+  std::thread([&objects]() { objects.clear(); }).join();
+  EXPECT_EQ(Counter(name + "/allocated") - allocated, 10u);
+  EXPECT_EQ(Counter(name + "/reused") - reused, 10u);
+
+  // not pooled
+  const auto object = bs_common::MakePooled<PooledObject>(false, 1);
+  EXPECT_EQ(object->id, 1);
+  EXPECT_EQ(Counter(name + "/allocated") - allocated, 10u);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <beam_utils/math.h>
+
+#include <bs_common/pose_array.h>
+
+namespace {
+
+Eigen::Matrix4d MakePose(int i) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(0.3 * i, Eigen::Vector3d(1, 2, 3 - i).normalized())
+          .toRotationMatrix();
+  T.block<3, 1>(0, 3) = Eigen::Vector3d(i, -0.5 * i, 2);
+  return T;
+}
+
+bs_common::PoseArray MakePoses(int size, int offset) {
+  bs_common::PoseArray poses;
+  poses.Resize(size);
+  for (int i = 0; i < size; i++) { poses.Set(i, MakePose(i + offset)); }
+  return poses;
+}
+
+} // namespace
+
+TEST(PoseArray, Conversions) {
+  bs_common::PoseArray poses;
+  poses.Resize(3);
+  EXPECT_TRUE(poses.T(2).isApprox(Eigen::Matrix4d::Identity()));
+
+  poses = MakePoses(7, 0);
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+  bs_common::PoseArrayToEigenTransforms(poses, Ts);
+  ASSERT_EQ(Ts.size(), 7u);
+  for (int i = 0; i < 7; i++) {
+    EXPECT_TRUE(poses.T(i).isApprox(MakePose(i), 1e-12));
+    EXPECT_TRUE(Ts[i].isApprox(MakePose(i), 1e-12));
+  }
+}
+
+TEST(PoseArray, Compose) {
+  const bs_common::PoseArray T_A_B = MakePoses(5, 0);
+  const bs_common::PoseArray T_B_C = MakePoses(5, 3);
+  bs_common::PoseArray T_A_C;
+  bs_common::ComposePoses(T_A_B, T_B_C, T_A_C);
+  ASSERT_EQ(T_A_C.Size(), 5u);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_TRUE(T_A_C.T(i).isApprox(MakePose(i) * MakePose(i + 3), 1e-12));
+  }
+
+  const Eigen::Matrix4d T = MakePose(9);
+  bs_common::ComposePoses(T, T_B_C, T_A_C);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_TRUE(T_A_C.T(i).isApprox(T * MakePose(i + 3), 1e-12));
+  }
+
+  EXPECT_THROW(bs_common::ComposePoses(T_A_B, MakePoses(2, 0), T_A_C),
+               std::runtime_error);
+}
+
+TEST(PoseArray, InvertAndTransform) {
+  bs_common::PoseArray poses = MakePoses(6, 1);
+  bs_common::InvertPoses(poses, poses);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_TRUE(poses.T(i).isApprox(MakePose(i + 1).inverse(), 1e-12));
+  }
+
+  const Eigen::Matrix4d T = MakePose(4);
+  Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, 10);
+  const Eigen::Matrix3Xd original = points;
+  bs_common::TransformPoints(T, points);
+  for (int i = 0; i < 10; i++) {
+    const Eigen::Vector3d expected =
+        (T * original.col(i).homogeneous()).head<3>();
+    EXPECT_TRUE(points.col(i).isApprox(expected, 1e-12));
+  }
+}
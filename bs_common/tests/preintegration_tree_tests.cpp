@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/preintegration_tree.h>
+
+namespace {
+
+const Eigen::Vector3d kGyroBias(0.01, -0.02, 0.005);
+const Eigen::Vector3d kAccelBias(0.05, 0.02, -0.03);
+
+std::vector<bs_common::IMUData> GenerateImuData(double t_start, double t_end,
+                                                double dt) {
+  std::vector<bs_common::IMUData> imu_data;
+  for (double t = t_start; t <= t_end; t += dt) {
+    bs_common::IMUData data;
+    data.t = ros::Time(t);
+    data.w = Eigen::Vector3d(0.5 * sin(t), 0.3 * cos(2 * t), 0.2);
+    data.a = Eigen::Vector3d(cos(t), sin(3 * t), 9.81 + 0.5 * sin(t));
+    imu_data.push_back(data);
+  }
+  return imu_data;
+}
+
+// works for both the tree and the preintegrator
+template <typename T>
+void SetNoise(T& integrator) {
+  integrator.cov_w = 1e-4 * Eigen::Matrix3d::Identity();
+  integrator.cov_a = 1e-3 * Eigen::Matrix3d::Identity();
+  integrator.cov_bg = 1e-6 * Eigen::Matrix3d::Identity();
+  integrator.cov_ba = 1e-5 * Eigen::Matrix3d::Identity();
+}
+
+// integrates the measurements in [t1, t2] with the preintegrator, starting at
+// measurement t1
+bs_common::PreIntegrator
+    Integrate(const std::vector<bs_common::IMUData>& imu_data,
+              const ros::Time& t1, const ros::Time& t2,
+              const Eigen::Vector3d& bg, const Eigen::Vector3d& ba) {
+  bs_common::PreIntegrator pre_integrator;
+  SetNoise(pre_integrator);
+  for (const auto& data : imu_data) {
+    if (data.t >= t1 && data.t <= t2) { pre_integrator.AddData(data); }
+  }
+  pre_integrator.Integrate(t2, bg, ba, true, true, true);
+  return pre_integrator;
+}
+
+void ExpectNear(const Eigen::MatrixXd& A, const Eigen::MatrixXd& B,
+                double relative_tolerance) {
+  EXPECT_LE((A - B).norm(), relative_tolerance * std::max(1.0, B.norm()));
+}
+
+void ExpectEqual(const bs_common::PreIntegrator& expected,
+                 const bs_common::PreIntegrator& actual) {
+  EXPECT_NEAR(actual.delta.t.toSec(), expected.delta.t.toSec(), 1e-9);
+  EXPECT_TRUE(actual.delta.q.isApprox(expected.delta.q, 1e-9));
+  ExpectNear(actual.delta.p, expected.delta.p, 1e-9);
+  ExpectNear(actual.delta.v, expected.delta.v, 1e-9);
+  // the sequential preintegrator linearizes each increment about the
+  // orientation at the start of the increment, while composed segments use
+  // the midpoint, so these differ at first order in the rotation per increment
+  ExpectNear(actual.delta.cov, expected.delta.cov, 5e-2);
+  ExpectNear(actual.jacobian.dq_dbg, expected.jacobian.dq_dbg, 5e-2);
+  ExpectNear(actual.jacobian.dp_dbg, expected.jacobian.dp_dbg, 5e-2);
+  ExpectNear(actual.jacobian.dp_dba, expected.jacobian.dp_dba, 5e-2);
+  ExpectNear(actual.jacobian.dv_dbg, expected.jacobian.dv_dbg, 5e-2);
+  ExpectNear(actual.jacobian.dv_dba, expected.jacobian.dv_dba, 5e-2);
+}
+
+} // namespace
+
+TEST(PreintegrationTree, MatchesPreIntegrator) {
+  const auto imu_data = GenerateImuData(0, 5, 0.005);
+  bs_common::PreintegrationTree tree;
+  SetNoise(tree);
+  bs_common::PreIntegrator unused;
+  for (const auto& data : imu_data) { EXPECT_TRUE(tree.AddData(data)); }
+  EXPECT_FALSE(tree.AddData(imu_data[10]));
+
+  // measurement times, and times between measurements
+  const std::vector<std::pair<ros::Time, ros::Time>> windows{
+      {imu_data[0].t, imu_data[1].t},     {imu_data[3].t, imu_data[200].t},
+      {imu_data[17].t, ros::Time(3.1234)}, {imu_data[0].t, imu_data.back().t},
+      {imu_data[400].t, ros::Time(5.5)},  {ros::Time(2.0001), imu_data[500].t},
+      {ros::Time(2.0001), ros::Time(2.0002)}};
+  for (const auto& [t1, t2] : windows) {
+    bs_common::PreIntegrator pre_integrator;
+    ASSERT_TRUE(tree.Integrate(t1, t2, kGyroBias, kAccelBias, pre_integrator));
+    EXPECT_NEAR(pre_integrator.delta.t.toSec(), (t2 - t1).toSec(), 1e-9);
+    if (std::find_if(imu_data.begin(), imu_data.end(), [&t1](const auto& d) {
+          return d.t == t1;
+        }) != imu_data.end()) {
+      ExpectEqual(Integrate(imu_data, t1, t2, kGyroBias, kAccelBias),
+                  pre_integrator);
+    }
+  }
+
+  EXPECT_FALSE(tree.Integrate(imu_data[10].t, imu_data[10].t, kGyroBias,
+                              kAccelBias, unused));
+}
+
+TEST(PreintegrationTree, SplitComposesToWhole) {
+  const auto imu_data = GenerateImuData(0, 2, 0.0025);
+  bs_common::PreintegrationTree tree;
+  SetNoise(tree);
+  bs_common::PreIntegrator unused;
+  for (const auto& data : imu_data) { tree.AddData(data); }
+
+  const ros::Time t1(0.1);
+  const ros::Time t_split(1.23456);
+  const ros::Time t2(1.9);
+  bs_common::PreIntegrator whole;
+  bs_common::PreIntegrator first;
+  bs_common::PreIntegrator second;
+  ASSERT_TRUE(tree.Integrate(t1, t2, kGyroBias, kAccelBias, whole));
+  ASSERT_TRUE(tree.Integrate(t1, t_split, kGyroBias, kAccelBias, first));
+  ASSERT_TRUE(tree.Integrate(t_split, t2, kGyroBias, kAccelBias, second));
+
+  const double dt2 = second.delta.t.toSec();
+  EXPECT_TRUE(whole.delta.q.isApprox(first.delta.q * second.delta.q, 1e-9));
+  ExpectNear(whole.delta.v, first.delta.v + first.delta.q * second.delta.v,
+             1e-9);
+  ExpectNear(whole.delta.p,
+             first.delta.p + dt2 * first.delta.v +
+                 first.delta.q * second.delta.p,
+             1e-9);
+}
+
+TEST(PreintegrationTree, BiasChanges) {
+  const auto imu_data = GenerateImuData(0, 2, 0.005);
+  bs_common::PreintegrationTree tree;
+  SetNoise(tree);
+  bs_common::PreIntegrator unused;
+  for (const auto& data : imu_data) { tree.AddData(data); }
+  const ros::Time t1 = imu_data[20].t;
+  const ros::Time t2 = imu_data[300].t;
+  bs_common::PreIntegrator pre_integrator;
+  tree.Integrate(t1, t2, kGyroBias, kAccelBias, pre_integrator);
+
+  // small changes are corrected to first order
+  const Eigen::Vector3d bg_small = kGyroBias + Eigen::Vector3d::Constant(1e-3);
+  const Eigen::Vector3d ba_small = kAccelBias + Eigen::Vector3d::Constant(1e-2);
+  tree.Integrate(t1, t2, bg_small, ba_small, pre_integrator);
+  const auto expected_small = Integrate(imu_data, t1, t2, bg_small, ba_small);
+  EXPECT_TRUE(pre_integrator.delta.q.isApprox(expected_small.delta.q, 1e-5));
+  ExpectNear(pre_integrator.delta.p, expected_small.delta.p, 1e-4);
+  ExpectNear(pre_integrator.delta.v, expected_small.delta.v, 1e-4);
+
+  // large changes re-integrate the tree
+  const Eigen::Vector3d bg_large = kGyroBias + Eigen::Vector3d::Constant(0.1);
+  const Eigen::Vector3d ba_large = kAccelBias + Eigen::Vector3d::Constant(1.0);
+  tree.Integrate(t1, t2, bg_large, ba_large, pre_integrator);
+  ExpectEqual(Integrate(imu_data, t1, t2, bg_large, ba_large), pre_integrator);
+}
+
+TEST(PreintegrationTree, RemoveAndOutOfOrder) {
+  auto imu_data = GenerateImuData(0, 10, 0.005);
+  bs_common::PreintegrationTree tree;
+  SetNoise(tree);
+  bs_common::PreIntegrator unused;
+
+  // add measurements while removing old ones so the tree is compacted and
+  // grown several times
+  const size_t skipped = 1500;
+  for (size_t i = 0; i < imu_data.size(); i++) {
+    if (i == skipped) { continue; }
+    tree.AddData(imu_data[i]);
+    if (i >= 800) { tree.RemoveBefore(imu_data[i - 800].t); }
+    if (i >= 200 && i % 100 == 0) {
+      EXPECT_TRUE(tree.Integrate(imu_data[i - 200].t, imu_data[i].t,
+                                 kGyroBias, kAccelBias, unused));
+    }
+  }
+  EXPECT_EQ(tree.Size(), 800u);
+  EXPECT_FALSE(tree.Integrate(imu_data[400].t, imu_data[1500].t, kGyroBias,
+                              kAccelBias, unused));
+
+  const ros::Time t1 = imu_data[1300].t;
+  const ros::Time t2 = imu_data[1900].t;
+  bs_common::PreIntegrator pre_integrator;
+  ASSERT_TRUE(tree.Integrate(t1, t2, kGyroBias, kAccelBias, pre_integrator));
+  imu_data.erase(imu_data.begin() + skipped);
+  ExpectEqual(Integrate(imu_data, t1, t2, kGyroBias, kAccelBias),
+              pre_integrator);
+
+  // add the skipped measurement back
+  tree.AddData(GenerateImuData(0, 10, 0.005)[skipped]);
+  EXPECT_EQ(tree.Size(), 801u);
+  ASSERT_TRUE(tree.Integrate(t1, t2, kGyroBias, kAccelBias, pre_integrator));
+  ExpectEqual(
+      Integrate(GenerateImuData(0, 10, 0.005), t1, t2, kGyroBias, kAccelBias),
+      pre_integrator);
+
+  tree.Clear();
+  EXPECT_TRUE(tree.Empty());
+  EXPECT_FALSE(tree.Integrate(t1, t2, kGyroBias, kAccelBias, pre_integrator));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
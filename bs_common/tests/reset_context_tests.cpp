@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <bs_common/reset_context.h>
+
+TEST(ResetContext, FastReset) {
+  auto& context = bs_common::ResetContext::GetInstance();
+  EXPECT_FALSE(context.IsFastReset());
+  EXPECT_FALSE(context.HasLastGoodState());
+
+  bs_common::ImuState state(ros::Time(5));
+  state.SetPosition(Eigen::Vector3d(1, 2, 3));
+  context.BeginFastReset(state);
+  EXPECT_TRUE(context.IsFastReset());
+  EXPECT_TRUE(context.HasLastGoodState());
+
+  // only taken once
+  const auto taken = context.TakeLastGoodState();
+  ASSERT_TRUE(taken.has_value());
+  EXPECT_EQ(taken->Stamp(), ros::Time(5));
+  EXPECT_EQ(taken->PositionVec(), Eigen::Vector3d(1, 2, 3));
+  EXPECT_FALSE(context.HasLastGoodState());
+  EXPECT_FALSE(context.TakeLastGoodState().has_value());
+  EXPECT_TRUE(context.IsFastReset());
+
+  context.EndReset();
+  EXPECT_FALSE(context.IsFastReset());
+}
+
+TEST(ResetContext, EndResetDiscardsState) {
+  auto& context = bs_common::ResetContext::GetInstance();
+  context.BeginFastReset(bs_common::ImuState(ros::Time(1)));
+  context.EndReset();
+  EXPECT_FALSE(context.HasLastGoodState());
+
+  // no state to re-ignite from
+  context.BeginFastReset(std::nullopt);
+  EXPECT_TRUE(context.IsFastReset());
+  EXPECT_FALSE(context.TakeLastGoodState().has_value());
+  context.EndReset();
+}
+
+TEST(ResetContext, KeepsWorldFrame) {
+  auto& context = bs_common::ResetContext::GetInstance();
+
+  // without re-ignition a new initialization makes a new world frame
+  context.SetReigniteAfterFastReset(false);
+  context.BeginFastReset(bs_common::ImuState(ros::Time(1)));
+  EXPECT_TRUE(context.IsFastReset());
+  EXPECT_FALSE(context.KeepsWorldFrame());
+  context.EndReset();
+
+  // nor is it kept without a state to re-ignite from
+  context.SetReigniteAfterFastReset(true);
+  context.BeginFastReset(std::nullopt);
+  EXPECT_FALSE(context.KeepsWorldFrame());
+  context.EndReset();
+
+  // it is kept until the reset ends, once the state is taken too
+  context.BeginFastReset(bs_common::ImuState(ros::Time(1)));
+  EXPECT_TRUE(context.KeepsWorldFrame());
+  EXPECT_TRUE(context.TakeLastGoodState().has_value());
+  EXPECT_TRUE(context.KeepsWorldFrame());
+  context.EndReset();
+  EXPECT_FALSE(context.KeepsWorldFrame());
+  context.SetReigniteAfterFastReset(false);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
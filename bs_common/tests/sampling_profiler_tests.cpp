@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/sampling_profiler.h>
+
+namespace {
+
+volatile double sink = 0;
+
+void Spin(const std::atomic<bool>& stop) {
+  while (!stop) {
+    for (int i = 0; i < 1000; i++) { sink = sink + i * 0.5; }
+  }
+}
+
+bool HasThread(const std::string& name) {
+  const auto threads = bs_common::SamplingProfiler::GetInstance().Threads();
+  return std::find(threads.begin(), threads.end(), name) != threads.end();
+}
+
+} // namespace
+
+TEST(SamplingProfiler, SampleRegisteredThreads) {
+  auto& profiler = bs_common::SamplingProfiler::GetInstance();
+  profiler.Clear();
+
+  std::atomic<bool> stop{false};
+  std::atomic<bool> registered{false};
+  std::thread worker([&]() {
+    profiler.RegisterThread("test_worker");
+    // registering again with the same name is a no-op
+    profiler.RegisterThread("test_worker");
+    registered = true;
+    Spin(stop);
+  });
+  while (!registered) { std::this_thread::yield(); }
+  EXPECT_TRUE(HasThread("test_worker"));
+
+  bs_common::SamplingProfiler::Params params;
+  params.rate_hz = 200;
+  EXPECT_TRUE(profiler.Start(params));
+  EXPECT_FALSE(profiler.Start(params));
+  EXPECT_TRUE(profiler.Running());
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  profiler.Stop();
+  EXPECT_FALSE(profiler.Running());
+
+  // no samples are taken once stopped
+  const size_t num_samples = profiler.NumSamples();
+  EXPECT_GT(num_samples, 10);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(profiler.NumSamples(), num_samples);
+
+  // threads are unregistered when they exit
+  stop = true;
+  worker.join();
+  EXPECT_FALSE(HasThread("test_worker"));
+
+  // only registered threads are sampled, and the counts add up
+  size_t total = 0;
+  const auto stacks = profiler.FoldedStacks();
+  ASSERT_FALSE(stacks.empty());
+  for (const auto& line : stacks) {
+    EXPECT_EQ(line.rfind("test_worker;", 0), 0);
+    total += std::stoul(line.substr(line.find_last_of(' ') + 1));
+  }
+  EXPECT_EQ(total, num_samples);
+
+  const std::string path = "/tmp/sampling_profiler_tests.folded";
+  EXPECT_TRUE(profiler.WriteFoldedStacks(path));
+  std::ifstream file(path);
+  size_t num_lines = 0;
+  for (std::string line; std::getline(file, line);) { num_lines++; }
+  EXPECT_EQ(num_lines, stacks.size());
+  std::remove(path.c_str());
+
+  profiler.Clear();
+  EXPECT_EQ(profiler.NumSamples(), 0);
+  EXPECT_TRUE(profiler.FoldedStacks().empty());
+}
+
+TEST(SamplingProfiler, MaxStacks) {
+  auto& profiler = bs_common::SamplingProfiler::GetInstance();
+  profiler.Clear();
+
+  std::atomic<bool> stop{false};
+  std::thread worker([&]() {
+    profiler.RegisterThread("test_worker");
+    Spin(stop);
+  });
+
+  bs_common::SamplingProfiler::Params params;
+  params.rate_hz = 200;
+  params.max_stacks = 1;
+  ASSERT_TRUE(profiler.Start(params));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  profiler.Stop();
+  stop = true;
+  worker.join();
+
+  // samples of other stacks than the first one are dropped
+  EXPECT_EQ(profiler.FoldedStacks().size(), 1);
+  EXPECT_GT(profiler.NumSamples() + profiler.NumDropped(), 10);
+  profiler.Clear();
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
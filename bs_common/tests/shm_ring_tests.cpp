@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <unistd.h>
+
+#include <bs_common/shm_ring.h>
+
+namespace {
+
+std::string RingName(const std::string& test) {
+  return "/bs_common_shm_ring_" + test + "_" + std::to_string(getpid());
+}
+
+std::vector<uint8_t> Message(size_t size, uint8_t first) {
+  std::vector<uint8_t> message(size);
+  for (size_t i = 0; i < size; i++) { message[i] = first + i; }
+  return message;
+}
+
+} // namespace
+
+TEST(ShmRing, OpenMissing) {
+  EXPECT_EQ(bs_common::ShmRing::Open(RingName("missing")), nullptr);
+}
+
+TEST(ShmRing, WriteRead) {
+  const std::string name = RingName("write_read");
+  auto producer = bs_common::ShmRing::Create(name, 64);
+  ASSERT_NE(producer, nullptr);
+  auto consumer = bs_common::ShmRing::Open(name);
+  ASSERT_NE(consumer, nullptr);
+  EXPECT_EQ(consumer->Capacity(), 64);
+
+  std::vector<uint8_t> received;
+  EXPECT_FALSE(consumer->TryRead(received));
+
+  // messages wrap around the end of the ring
+  for (uint8_t i = 0; i < 10; i++) {
+    const std::vector<uint8_t> message = Message(20, i);
+    ASSERT_TRUE(producer->TryWrite(message.data(), message.size()));
+    ASSERT_TRUE(consumer->TryRead(received));
+    EXPECT_EQ(received, message);
+  }
+  EXPECT_EQ(producer->Used(), 0);
+
+  // full, then too large
+  const std::vector<uint8_t> message = Message(20, 0);
+  EXPECT_TRUE(producer->TryWrite(message.data(), message.size()));
+  EXPECT_TRUE(producer->TryWrite(message.data(), message.size()));
+  EXPECT_FALSE(producer->TryWrite(message.data(), message.size()));
+  EXPECT_FALSE(producer->Write(message.data(), message.size(),
+                               std::chrono::milliseconds(1)));
+  const std::vector<uint8_t> large = Message(producer->MaxMessageSize() + 1, 0);
+  EXPECT_FALSE(producer->TryWrite(large.data(), large.size()));
+
+  // empty messages are valid
+  EXPECT_TRUE(consumer->TryRead(received));
+  EXPECT_TRUE(consumer->TryRead(received));
+  EXPECT_TRUE(producer->TryWrite(nullptr, 0));
+  EXPECT_TRUE(consumer->TryRead(received));
+  EXPECT_TRUE(received.empty());
+  EXPECT_FALSE(consumer->Read(received, std::chrono::milliseconds(1)));
+
+  // removed with its owner
+  producer.reset();
+  EXPECT_EQ(bs_common::ShmRing::Open(name), nullptr);
+}
+
+TEST(ShmRing, Threads) {
+  const std::string name = RingName("threads");
+  auto producer = bs_common::ShmRing::Create(name, 256);
+  ASSERT_NE(producer, nullptr);
+  auto consumer = bs_common::ShmRing::Open(name);
+  ASSERT_NE(consumer, nullptr);
+
+  constexpr int kNumMessages = 1000;
+  std::thread writer([&producer]() {
+    for (int i = 0; i < kNumMessages; i++) {
+      const std::vector<uint8_t> message = Message(1 + i % 100, i);
+      ASSERT_TRUE(producer->Write(message.data(), message.size(),
+                                  std::chrono::milliseconds(1000)));
+    }
+  });
+  std::vector<uint8_t> received;
+  for (int i = 0; i < kNumMessages; i++) {
+    ASSERT_TRUE(consumer->Read(received, std::chrono::milliseconds(1000)));
+    ASSERT_EQ(received, Message(1 + i % 100, i));
+  }
+  writer.join();
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
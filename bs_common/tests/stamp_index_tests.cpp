@@ -0,0 +1,94 @@
+#include <set>
+#include <vector>
+
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <gtest/gtest.h>
+
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/stamp_index.h>
+
+namespace {
+
+std::vector<ros::Time> Stamps(const std::vector<double>& seconds) {
+  std::vector<ros::Time> stamps;
+  for (double t : seconds) { stamps.emplace_back(t); }
+  return stamps;
+}
+
+} // namespace
+
+TEST(StampIndex, InsertErase) {
+  bs_common::StampIndex index(ros::Duration(0.5));
+  EXPECT_TRUE(index.Empty());
+  for (double t : {1.0, 0.2, 1.6, 0.1, 1.1}) {
+    EXPECT_TRUE(index.Insert(ros::Time(t)));
+  }
+  EXPECT_FALSE(index.Insert(ros::Time(1.1)));
+  EXPECT_EQ(index.Size(), 5);
+  EXPECT_EQ(index.Oldest(), ros::Time(0.1));
+  EXPECT_EQ(index.Newest(), ros::Time(1.6));
+  EXPECT_EQ(index.Stamps(), Stamps({0.1, 0.2, 1.0, 1.1, 1.6}));
+  EXPECT_TRUE(index.Contains(ros::Time(1.0)));
+  EXPECT_FALSE(index.Contains(ros::Time(1.05)));
+
+  EXPECT_TRUE(index.Erase(ros::Time(0.1)));
+  EXPECT_TRUE(index.Erase(ros::Time(0.2)));
+  EXPECT_FALSE(index.Erase(ros::Time(0.2)));
+  EXPECT_EQ(index.Size(), 3);
+  EXPECT_EQ(index.Oldest(), ros::Time(1.0));
+  const std::set<ros::Time> expected{ros::Time(1.0), ros::Time(1.1),
+                                     ros::Time(1.6)};
+  EXPECT_EQ(index.ToSet(), expected);
+
+  index.Clear();
+  EXPECT_TRUE(index.Empty());
+  EXPECT_TRUE(index.Stamps().empty());
+}
+
+TEST(StampIndex, RangeAndDifference) {
+  bs_common::StampIndex previous(ros::Duration(1));
+  bs_common::StampIndex current(ros::Duration(1));
+  for (double t = 0; t < 5; t += 0.25) { previous.Insert(ros::Time(t + 1)); }
+  for (double t = 2; t < 7; t += 0.25) { current.Insert(ros::Time(t + 1)); }
+
+  EXPECT_EQ(previous.Range(ros::Time(1.5), ros::Time(2.25)),
+            Stamps({1.5, 1.75, 2.0, 2.25}));
+  EXPECT_TRUE(previous.Range(ros::Time(2.25), ros::Time(1.5)).empty());
+
+  // marginalized and new stamps
+  EXPECT_EQ(previous.Difference(current),
+            Stamps({1, 1.25, 1.5, 1.75, 2, 2.25, 2.5, 2.75}));
+  EXPECT_EQ(current.Difference(previous),
+            Stamps({6, 6.25, 6.5, 6.75, 7, 7.25, 7.5, 7.75}));
+
+  // indices with different buckets
+  bs_common::StampIndex other(ros::Duration(0.3));
+  for (const auto& stamp : current.Stamps()) { other.Insert(stamp); }
+  EXPECT_EQ(previous.Difference(other), previous.Difference(current));
+  EXPECT_TRUE(other.Difference(current).empty());
+}
+
+TEST(StampIndex, Graph) {
+  fuse_graphs::HashGraph graph;
+  for (double t : {3.0, 1.0, 2.0}) {
+    graph.addVariable(
+        fuse_variables::Position3DStamped::make_shared(ros::Time(t)));
+    graph.addVariable(
+        fuse_variables::Orientation3DStamped::make_shared(ros::Time(t + 10)));
+  }
+  EXPECT_EQ(bs_common::GetStampIndex(graph)->Stamps(), Stamps({1, 2, 3}));
+
+  // snapshots return their own index
+  bs_common::GraphSnapshot snapshot;
+  EXPECT_TRUE(bs_common::GetStampIndex(snapshot)->Empty());
+  auto stamps = bs_common::StampIndex::make_shared(graph);
+  snapshot.SetStamps(stamps);
+  EXPECT_EQ(bs_common::GetStampIndex(snapshot), stamps);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
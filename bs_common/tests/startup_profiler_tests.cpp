@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include <bs_common/instrumentation.h>
+#include <bs_common/startup_profiler.h>
+
+TEST(StartupProfiler, LoadInBackground) {
+  auto& profiler = bs_common::StartupProfiler::GetInstance();
+  EXPECT_FALSE(profiler.IsReady("test/resource"));
+
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  std::shared_future<int> resource = bs_common::LoadInBackground<int>(
+      "test/resource", [unblocked]() {
+        unblocked.wait();
+        return 3;
+      });
+
+  // not ready until loaded
+  const auto not_ready = profiler.WaitUntilReady({"test/resource"}, 0.01);
+  ASSERT_EQ(not_ready.size(), 1);
+  EXPECT_EQ(not_ready[0], "test/resource");
+
+  unblock.set_value();
+  EXPECT_TRUE(profiler.WaitUntilReady({"test/resource"}, -1).empty());
+  EXPECT_TRUE(profiler.IsReady("test/resource"));
+  EXPECT_EQ(resource.get(), 3);
+  EXPECT_EQ(bs_common::Instrumentation::GetInstance()
+                .GetMetric("startup/test/resource")
+                .Summarize()
+                .count,
+            1);
+}
+
+TEST(StartupProfiler, ScopedStartupTimer) {
+  { bs_common::ScopedStartupTimer timer("test/on_init"); }
+  EXPECT_EQ(bs_common::Instrumentation::GetInstance()
+                .GetMetric("startup/test/on_init")
+                .Summarize()
+                .count,
+            1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
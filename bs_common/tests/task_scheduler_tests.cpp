@@ -0,0 +1,86 @@
+#include <atomic>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/task_scheduler.h>
+
+using bs_common::TaskPriority;
+using bs_common::TaskScheduler;
+
+TEST(TaskScheduler, ParallelFor) {
+  auto& scheduler = TaskScheduler::GetInstance();
+  TaskScheduler::Params params;
+  params.num_threads = 4;
+  scheduler.Configure(params);
+  EXPECT_EQ(scheduler.NumThreads(), 4);
+
+  std::vector<int> calls(1000, 0);
+  scheduler.ParallelFor(TaskPriority::REALTIME, calls.size(),
+                        [&](size_t i) { calls[i]++; });
+  for (const int c : calls) { EXPECT_EQ(c, 1); }
+
+  // exceptions are rethrown once all chunks are done
+  EXPECT_THROW(scheduler.ParallelFor(TaskPriority::REALTIME, 100,
+                                     [](size_t i) {
+                                       if (i == 50) {
+                                         throw std::runtime_error("error");
+                                       }
+                                     }),
+               std::runtime_error);
+}
+
+TEST(TaskScheduler, NestedTasks) {
+  auto& scheduler = TaskScheduler::GetInstance();
+  TaskScheduler::Params params;
+  params.num_threads = 2;
+  scheduler.Configure(params);
+
+  // more outer tasks than workers, all blocking on inner loops
+  std::atomic<int> count{0};
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 8; i++) {
+    futures.push_back(scheduler.Enqueue(TaskPriority::BACKGROUND, [&]() {
+      scheduler.ParallelFor(TaskPriority::BACKGROUND, 10,
+                            [&](size_t) { count++; });
+    }));
+  }
+  for (auto& future : futures) { future.get(); }
+  EXPECT_EQ(count, 80);
+}
+
+TEST(TaskScheduler, BackgroundLimit) {
+  auto& scheduler = TaskScheduler::GetInstance();
+  TaskScheduler::Params params;
+  params.num_threads = 4;
+  params.max_background_threads = 1;
+  scheduler.Configure(params);
+
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 20; i++) {
+    futures.push_back(scheduler.Enqueue(TaskPriority::BACKGROUND, [&]() {
+      const int r = ++running;
+      int m = max_running;
+      while (r > m && !max_running.compare_exchange_weak(m, r)) {}
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      running--;
+    }));
+  }
+
+  // real-time tasks still run on the other workers
+  scheduler.Enqueue(TaskPriority::REALTIME, []() {}).get();
+  for (auto& future : futures) { future.get(); }
+  EXPECT_EQ(max_running, 1);
+
+  const auto stats = scheduler.GetStats();
+  EXPECT_EQ(stats.num_threads, 4);
+  EXPECT_EQ(stats.tasks_run[static_cast<int>(TaskPriority::BACKGROUND)], 20);
+  EXPECT_EQ(stats.tasks_run[static_cast<int>(TaskPriority::REALTIME)], 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
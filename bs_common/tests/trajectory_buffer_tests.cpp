@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/trajectory_buffer.h>
+#include <bs_common/trajectory_file.h>
+
+namespace {
+
+// moves 1 m/s along x while yawing 0.1 rad/s
+Eigen::Matrix4d MakePose(double t) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(0.1 * t, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T(0, 3) = t;
+  return T;
+}
+
+bs_common::Trajectory MakeTrajectory(const std::vector<double>& stamps) {
+  bs_common::TrajectoryPoses poses;
+  for (double t : stamps) { poses.emplace_back(ros::Time(t), MakePose(t)); }
+  return bs_common::Trajectory(poses);
+}
+
+} // namespace
+
+TEST(Trajectory, Interpolation) {
+  const bs_common::Trajectory trajectory = MakeTrajectory({3, 1, 2, 4, 2});
+  ASSERT_EQ(trajectory.Size(), 4u);
+  EXPECT_EQ(trajectory.StartTime(), ros::Time(1));
+  EXPECT_EQ(trajectory.EndTime(), ros::Time(4));
+
+  std::string error;
+  Eigen::Matrix4d T;
+  for (double t : {1.0, 1.25, 2.0, 3.7, 4.0}) {
+    ASSERT_TRUE(trajectory.Get(T, ros::Time(t), error));
+    EXPECT_TRUE(T.isApprox(MakePose(t), 1e-9));
+  }
+  ASSERT_TRUE(trajectory.Get(T, ros::Time(0), error));
+  EXPECT_TRUE(T.isApprox(MakePose(4), 1e-9));
+
+  EXPECT_FALSE(trajectory.Get(T, ros::Time(0.5), error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_FALSE(trajectory.Get(T, ros::Time(4.5), error));
+  EXPECT_FALSE(bs_common::Trajectory().Get(T, ros::Time(1), error));
+
+  EXPECT_EQ(trajectory.Before(ros::Time(0.5)), nullptr);
+  ASSERT_NE(trajectory.Before(ros::Time(2.5)), nullptr);
+  EXPECT_EQ(trajectory.Before(ros::Time(2.5))->stamp, ros::Time(2));
+  EXPECT_EQ(trajectory.Before(ros::Time(3))->stamp, ros::Time(3));
+  EXPECT_EQ(trajectory.Before(ros::Time(10))->stamp, ros::Time(4));
+}
+
+TEST(Trajectory, BatchedLookup) {
+  const bs_common::Trajectory trajectory =
+      MakeTrajectory({0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.0});
+  std::vector<ros::Time> times;
+  for (int i = 0; i <= 90; i++) { times.push_back(ros::Time(0.1 + 0.01 * i)); }
+
+  std::string error;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+  ASSERT_TRUE(trajectory.Get(Ts, times, error));
+  ASSERT_EQ(Ts.size(), times.size());
+  for (size_t i = 0; i < times.size(); i++) {
+    Eigen::Matrix4d T;
+    ASSERT_TRUE(trajectory.Get(T, times[i], error));
+    EXPECT_TRUE(Ts[i].isApprox(T, 1e-12));
+  }
+
+  times.push_back(ros::Time(1.5));
+  EXPECT_FALSE(trajectory.Get(Ts, times, error));
+}
+
+TEST(TrajectoryBuffer, AddAndPublish) {
+  bs_common::TrajectoryBuffer buffer(ros::Duration(2));
+  ASSERT_NE(buffer.Get(), nullptr);
+  EXPECT_TRUE(buffer.Get()->Empty());
+
+  EXPECT_TRUE(buffer.Add(ros::Time(1), MakePose(1)));
+  EXPECT_TRUE(buffer.Add(ros::Time(3), MakePose(3)));
+  EXPECT_TRUE(buffer.Add(ros::Time(2), MakePose(2)));
+  EXPECT_FALSE(buffer.Add(ros::Time(2), MakePose(2)));
+
+  // readers keep the trajectory they loaded while new poses are added
+  const auto snapshot = buffer.Get();
+  EXPECT_TRUE(buffer.Add(ros::Time(4), MakePose(4)));
+  ASSERT_EQ(snapshot->Size(), 3u);
+  EXPECT_EQ(snapshot->StartTime(), ros::Time(1));
+
+  // the oldest pose is more than 2 s older than the newest
+  const auto latest = buffer.Get();
+  ASSERT_EQ(latest->Size(), 3u);
+  EXPECT_EQ(latest->StartTime(), ros::Time(2));
+  EXPECT_EQ(latest->EndTime(), ros::Time(4));
+
+  buffer.Set(MakeTrajectory({10, 11}));
+  EXPECT_EQ(buffer.Get()->Size(), 2u);
+  EXPECT_TRUE(buffer.Add(ros::Time(12), MakePose(12)));
+  EXPECT_EQ(buffer.Get()->Size(), 3u);
+
+  buffer.Clear();
+  EXPECT_TRUE(buffer.Get()->Empty());
+}
+
+TEST(TrajectoryBuffer, NotifyWhenReached) {
+  bs_common::TrajectoryBuffer buffer;
+  std::vector<int> calls;
+  const uint64_t id1 =
+      buffer.NotifyWhenReached(ros::Time(2), [&]() { calls.push_back(1); });
+  const uint64_t id2 =
+      buffer.NotifyWhenReached(ros::Time(3), [&]() { calls.push_back(2); });
+  const uint64_t id3 =
+      buffer.NotifyWhenReached(ros::Time(3), [&]() { calls.push_back(3); });
+  EXPECT_NE(id1, 0u);
+  EXPECT_NE(id2, id1);
+
+  buffer.Add(ros::Time(1), MakePose(1));
+  EXPECT_TRUE(calls.empty());
+
+  buffer.CancelNotification(id3);
+  buffer.Add(ros::Time(2.5), MakePose(2.5));
+  ASSERT_EQ(calls.size(), 1u);
+  EXPECT_EQ(calls[0], 1);
+
+  // a pose added in the past doesn't move the end time
+  buffer.Add(ros::Time(0.5), MakePose(0.5));
+  EXPECT_EQ(calls.size(), 1u);
+
+  buffer.Set(MakeTrajectory({3, 4}));
+  ASSERT_EQ(calls.size(), 2u);
+  EXPECT_EQ(calls[1], 2);
+
+  // already reached, called right away
+  EXPECT_EQ(
+      buffer.NotifyWhenReached(ros::Time(4), [&]() { calls.push_back(4); }),
+      0u);
+  EXPECT_EQ(calls.size(), 3u);
+
+  // cancelled and called notifications are not called again
+  buffer.CancelNotification(id1);
+  buffer.Add(ros::Time(5), MakePose(5));
+  EXPECT_EQ(calls.size(), 3u);
+}
+
+TEST(TrajectoryFile, SaveAndMap) {
+  const std::string path =
+      "/tmp/bs_common_trajectory_test_" + std::to_string(getpid()) + ".bin";
+  bs_common::TrajectoryFile file;
+  file.fixed_frame = "world";
+  file.moving_frame = "imu";
+  file.trajectory = MakeTrajectory({1, 1.5, 2, 3});
+  ASSERT_TRUE(file.Save(path));
+  EXPECT_TRUE(bs_common::TrajectoryFile::IsTrajectoryFile(path));
+
+  bs_common::TrajectoryFile loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.fixed_frame, "world");
+  EXPECT_EQ(loaded.moving_frame, "imu");
+  ASSERT_EQ(loaded.trajectory.Size(), 4u);
+
+  // the mapped trajectory outlives the file object that loaded it
+  bs_common::TrajectoryBuffer buffer;
+  buffer.Set(loaded.trajectory);
+  loaded = bs_common::TrajectoryFile();
+  std::string error;
+  Eigen::Matrix4d T;
+  ASSERT_TRUE(buffer.Get()->Get(T, ros::Time(2.5), error));
+  EXPECT_TRUE(T.isApprox(MakePose(2.5), 1e-9));
+  EXPECT_TRUE(buffer.Add(ros::Time(4), MakePose(4)));
+  EXPECT_EQ(buffer.Get()->Size(), 5u);
+
+  std::remove(path.c_str());
+  EXPECT_FALSE(bs_common::TrajectoryFile::IsTrajectoryFile(path));
+}
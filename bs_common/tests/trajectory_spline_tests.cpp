@@ -0,0 +1,119 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/trajectory_spline.h>
+
+namespace {
+
+// smooth motion with accelerations and rotations about every axis
+Eigen::Matrix4d MakePose(double t) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      (Eigen::AngleAxisd(0.5 * t, Eigen::Vector3d::UnitZ()) *
+       Eigen::AngleAxisd(0.2 * std::sin(t), Eigen::Vector3d::UnitY()) *
+       Eigen::AngleAxisd(0.1 * std::cos(2 * t), Eigen::Vector3d::UnitX()))
+          .toRotationMatrix();
+  T(0, 3) = 2 * t;
+  T(1, 3) = std::sin(t);
+  T(2, 3) = 0.1 * t * t;
+  return T;
+}
+
+// densely sampled, as an odometry buffer would be
+bs_common::Trajectory MakeTrajectory(double start, double end) {
+  bs_common::TrajectoryPoses poses;
+  for (double t = start; t <= end + 1e-9; t += 0.001) {
+    poses.emplace_back(ros::Time(t), MakePose(t));
+  }
+  return bs_common::Trajectory(poses);
+}
+
+void ExpectNear(const Eigen::Matrix4d& T, const Eigen::Matrix4d& expected,
+                double tolerance) {
+  EXPECT_LT((T.block<3, 1>(0, 3) - expected.block<3, 1>(0, 3)).norm(),
+            tolerance);
+  const Eigen::AngleAxisd error(T.block<3, 3>(0, 0).transpose() *
+                                expected.block<3, 3>(0, 0));
+  EXPECT_LT(std::abs(error.angle()), tolerance);
+}
+
+} // namespace
+
+TEST(TrajectorySpline, Fit) {
+  const bs_common::Trajectory trajectory = MakeTrajectory(1, 3);
+  bs_common::TrajectorySpline spline;
+  std::string error;
+  ASSERT_TRUE(bs_common::TrajectorySpline::Fit(
+      trajectory, ros::Time(1), ros::Duration(0.05), 21, spline, error));
+  EXPECT_EQ(spline.StartTime(), ros::Time(1));
+  EXPECT_EQ(spline.EndTime(), ros::Time(2));
+
+  // the spline goes through the knots, and stays close to the motion between
+  // them
+  Eigen::Matrix4d T;
+  for (int k = 0; k <= 20; k++) {
+    const ros::Time time(1 + 0.05 * k);
+    ASSERT_TRUE(spline.Get(T, time, error));
+    Eigen::Matrix4d expected;
+    ASSERT_TRUE(trajectory.Get(expected, time, error));
+    ExpectNear(T, expected, 1e-8);
+  }
+  std::vector<ros::Time> times;
+  for (double t = 1.0; t <= 2.0; t += 0.0137) { times.emplace_back(t); }
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+  ASSERT_TRUE(spline.Get(Ts, times, error));
+  ASSERT_EQ(Ts.size(), times.size());
+  for (size_t i = 0; i < times.size(); i++) {
+    ExpectNear(Ts[i], MakePose(times[i].toSec()), 1e-3);
+  }
+
+  EXPECT_FALSE(spline.Get(T, ros::Time(0.99), error));
+  EXPECT_FALSE(spline.Get(T, ros::Time(2.01), error));
+  EXPECT_FALSE(bs_common::TrajectorySpline::Fit(
+      trajectory, ros::Time(2), ros::Duration(0.05), 30, spline, error));
+  EXPECT_FALSE(bs_common::TrajectorySpline::Fit(
+      trajectory, ros::Time(2), ros::Duration(0.05), 1, spline, error));
+}
+
+TEST(TrajectorySplineCache, Windows) {
+  bs_common::TrajectorySplineCache::Params params;
+  params.knot_interval = ros::Duration(0.02);
+  params.window_duration = ros::Duration(0.5);
+  params.max_windows = 2;
+  bs_common::TrajectorySplineCache cache(params);
+
+  // times across windows, including the end of the trajectory which is past
+  // the last knot and interpolated linearly
+  const bs_common::Trajectory trajectory = MakeTrajectory(1.005, 2.505);
+  std::vector<ros::Time> times;
+  for (double t = 1.005; t <= 2.505; t += 0.01) { times.emplace_back(t); }
+  times.emplace_back(2.505);
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+  std::string error;
+  ASSERT_TRUE(cache.Get(trajectory, Ts, times, error));
+  ASSERT_EQ(Ts.size(), times.size());
+  for (size_t i = 0; i < times.size(); i++) {
+    ExpectNear(Ts[i], MakePose(times[i].toSec()), 1e-3);
+  }
+
+  EXPECT_FALSE(cache.Get(trajectory, Ts, {ros::Time(2.6)}, error));
+  EXPECT_TRUE(Ts.empty());
+  EXPECT_FALSE(cache.Get(bs_common::Trajectory(), Ts, {ros::Time(1)}, error));
+
+  // windows fitted before the trajectory covered them are fitted again
+  cache.Clear();
+  const bs_common::Trajectory partial = MakeTrajectory(1.005, 1.2);
+  ASSERT_TRUE(cache.Get(partial, Ts, {ros::Time(1.1)}, error));
+  ASSERT_TRUE(cache.Get(trajectory, Ts, {ros::Time(1.1), ros::Time(1.4)},
+                        error));
+  ExpectNear(Ts[0], MakePose(1.1), 1e-3);
+  ExpectNear(Ts[1], MakePose(1.4), 1e-3);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
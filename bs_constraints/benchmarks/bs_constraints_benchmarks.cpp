@@ -0,0 +1,452 @@
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <ceres/autodiff_cost_function.h>
+#include <fuse_core/serialization.h>
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <fuse_variables/velocity_linear_3d_stamped.h>
+
+#include <beam_utils/math.h>
+
+#include <bs_common/compact_serialization.h>
+#include <bs_common/imu_state.h>
+#include <bs_common/preintegrator.h>
+#include <bs_constraints/inertial/absolute_imu_state_3d_stamped_constraint.h>
+#include <bs_constraints/inertial/normal_delta_imu_state_3d_cost_functor.h>
+#include <bs_constraints/inertial/normal_delta_imu_state_3d_function.h>
+#include <bs_constraints/relative_pose/delta_pose_3d_with_extrinsics_cost_function.h>
+#include <bs_constraints/relative_pose/delta_pose_3d_with_extrinsics_cost_functor.h>
+#include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
+#include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
+#include <bs_constraints/transaction_batch.h>
+#include <bs_constraints/visual/euclidean_reprojection_constraint.h>
+#include <bs_constraints/visual/euclidean_reprojection_function.h>
+#include <bs_constraints/visual/euclidean_reprojection_functor.h>
+#include <bs_constraints/visual/inversedepth_reprojection_function.h>
+#include <bs_constraints/visual/inversedepth_reprojection_functor.h>
+#include <bs_variables/accel_bias_3d_stamped.h>
+#include <bs_variables/gyro_bias_3d_stamped.h>
+#include <bs_variables/orientation_3d.h>
+#include <bs_variables/point_3d_landmark.h>
+#include <bs_variables/position_3d.h>
+
+namespace {
+
+// a camera looking at a point 5m ahead, with the measurement close to its
+// projection so the residuals and jacobians are realistic
+const Eigen::Matrix2d kInformation = Eigen::Matrix2d::Identity();
+const Eigen::Matrix3d kK =
+    (Eigen::Matrix3d() << 400, 0, 320, 0, 400, 240, 0, 0, 1).finished();
+const Eigen::Vector3d kPointCam(0.2, 0.1, 5.0);
+const Eigen::Vector2d kPixel =
+    (kK * kPointCam).hnormalized() + Eigen::Vector2d(0.5, -0.5);
+
+Eigen::Matrix4d TCamBaselink() {
+  Eigen::Matrix4d T_CAM_BASELINK = Eigen::Matrix4d::Identity();
+  T_CAM_BASELINK.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  T_CAM_BASELINK.block<3, 1>(0, 3) = Eigen::Vector3d(0.1, -0.05, 0.2);
+  return T_CAM_BASELINK;
+}
+
+std::vector<double> Orientation(const Eigen::Matrix4d& T) {
+  const Eigen::Quaterniond q(T.block<3, 3>(0, 0));
+  return {q.w(), q.x(), q.y(), q.z()};
+}
+
+std::vector<double> Position(const Eigen::Matrix4d& T) {
+  return {T(0, 3), T(1, 3), T(2, 3)};
+}
+
+std::vector<double> Data(const fuse_core::Variable& variable) {
+  return {variable.data(), variable.data() + variable.size()};
+}
+
+Eigen::Matrix4d Pose(double angle, const Eigen::Vector3d& t) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(angle, Eigen::Vector3d(1, 2, 3).normalized())
+          .toRotationMatrix();
+  T.block<3, 1>(0, 3) = t;
+  return T;
+}
+
+// evaluates the residuals and all jacobians, as done by the solver per
+// iteration
+void EvaluateCostFunction(benchmark::State& state,
+                          const ceres::CostFunction& cost_function,
+                          const std::vector<std::vector<double>>& parameters) {
+  std::vector<const double*> parameter_ptrs;
+  std::vector<std::vector<double>> jacobians;
+  std::vector<double*> jacobian_ptrs;
+  for (const auto& p : parameters) {
+    parameter_ptrs.push_back(p.data());
+    jacobians.emplace_back(cost_function.num_residuals() * p.size());
+  }
+  for (auto& J : jacobians) { jacobian_ptrs.push_back(J.data()); }
+  std::vector<double> residual(cost_function.num_residuals());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cost_function.Evaluate(
+        parameter_ptrs.data(), residual.data(), jacobian_ptrs.data()));
+    benchmark::ClobberMemory();
+  }
+}
+
+
+constexpr double kWindowDuration = 15;  // s
+constexpr double kKeyframeRate = 10;    // Hz
+constexpr int kNumLandmarks = 1000;
+constexpr int kObservationsPerLandmark = 10;
+
+const bs_common::CompactSerializer& Serializer() {
+  return bs_common::CompactSerializer::Instance();
+}
+
+// variables and constraints of a 15 s window of visual inertial lidar
+// odometry: imu states at 10 Hz with a prior on the first one, lidar relative
+// poses between consecutive states and landmarks observed by several states
+fuse_core::Transaction::SharedPtr MakeWindow() {
+  auto transaction = fuse_core::Transaction::make_shared();
+  transaction->stamp(ros::Time(1));
+  auto position_extrinsics =
+      bs_variables::Position3D::make_shared("imu", "lidar");
+  auto orientation_extrinsics =
+      bs_variables::Orientation3D::make_shared("imu", "lidar");
+  transaction->addVariable(position_extrinsics);
+  transaction->addVariable(orientation_extrinsics);
+
+  const int num_states = kWindowDuration * kKeyframeRate;
+  std::vector<fuse_variables::Position3DStamped::SharedPtr> positions;
+  std::vector<fuse_variables::Orientation3DStamped::SharedPtr> orientations;
+  for (int i = 0; i < num_states; i++) {
+    const ros::Time stamp(1 + i / kKeyframeRate);
+    transaction->addInvolvedStamp(stamp);
+    const Eigen::Quaterniond q(
+        Eigen::AngleAxisd(0.01 * i, Eigen::Vector3d::UnitZ()));
+    const Eigen::Vector3d p(0.1 * i, 0.02 * i, 0);
+    const Eigen::Vector3d v(1, 0.2, 0);
+    const Eigen::Vector3d bg(0.001, -0.002, 0.003);
+    const Eigen::Vector3d ba(0.01, 0.02, -0.03);
+
+    auto position = fuse_variables::Position3DStamped::make_shared(stamp);
+    auto orientation = fuse_variables::Orientation3DStamped::make_shared(stamp);
+    auto velocity = fuse_variables::VelocityLinear3DStamped::make_shared(stamp);
+    auto gyro_bias = bs_variables::GyroscopeBias3DStamped::make_shared(stamp);
+    auto accel_bias =
+        bs_variables::AccelerationBias3DStamped::make_shared(stamp);
+    for (int j = 0; j < 3; j++) {
+      position->data()[j] = p[j];
+      velocity->data()[j] = v[j];
+      gyro_bias->data()[j] = bg[j];
+      accel_bias->data()[j] = ba[j];
+    }
+    orientation->w() = q.w();
+    orientation->x() = q.x();
+    orientation->y() = q.y();
+    orientation->z() = q.z();
+    transaction->addVariable(position);
+    transaction->addVariable(orientation);
+    transaction->addVariable(velocity);
+    transaction->addVariable(gyro_bias);
+    transaction->addVariable(accel_bias);
+
+    if (i == 0) {
+      bs_common::ImuState state(stamp, q, p, v, bg, ba);
+      Eigen::Matrix<double, 16, 1> mean;
+      mean << q.w(), q.x(), q.y(), q.z(), p, v, bg, ba;
+      transaction->addConstraint(
+          bs_constraints::AbsoluteImuState3DStampedConstraint::make_shared(
+              "prior", state, mean,
+              1e-4 * Eigen::Matrix<double, 15, 15>::Identity()));
+    } else {
+      fuse_core::Vector7d delta;
+      delta << 0.1, 0.02, 0, std::cos(0.005), 0, 0, std::sin(0.005);
+      transaction->addConstraint(
+          bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint::
+              make_shared("lidar", *positions.back(), *orientations.back(),
+                          *position, *orientation, *position_extrinsics,
+                          *orientation_extrinsics, delta,
+                          1e-3 * fuse_core::Matrix6d::Identity()));
+    }
+    positions.push_back(position);
+    orientations.push_back(orientation);
+  }
+
+  Eigen::Matrix4d T_cam_baselink = Eigen::Matrix4d::Identity();
+  T_cam_baselink.block<3, 1>(0, 3) = Eigen::Vector3d(0.1, 0, 0.05);
+  Eigen::Matrix3d K;
+  K << 500, 0, 320, 0, 500, 240, 0, 0, 1;
+  for (int l = 0; l < kNumLandmarks; l++) {
+    auto landmark = bs_variables::Point3DLandmark::make_shared(
+        l, Eigen::Vector3d(0, 0, 1), l % 100);
+    landmark->x() = 0.01 * l;
+    landmark->y() = 1;
+    landmark->z() = 5;
+    transaction->addVariable(landmark);
+    for (int k = 0; k < kObservationsPerLandmark; k++) {
+      const int state = (l + 7 * k) % num_states;
+      transaction->addConstraint(
+          bs_constraints::EuclideanReprojectionConstraint::make_shared(
+              "camera", *orientations[state], *positions[state], *landmark,
+              T_cam_baselink, K, Eigen::Vector2d(320 + k, 240 - k), 2.0));
+    }
+  }
+  return transaction;
+}
+
+} // namespace
+
+// Arg(0) is the analytic cost function, Arg(1) the autodiff functor
+
+static void BM_EuclideanReprojection(benchmark::State& state) {
+  const Eigen::Matrix4d T_CAM_BASELINK = TCamBaselink();
+  const Eigen::Matrix4d T_WORLD_BASELINK =
+      Pose(0.3, Eigen::Vector3d(1.0, 2.0, 3.0));
+  const Eigen::Vector3d P_WORLD =
+      (T_WORLD_BASELINK * beam::InvertTransform(T_CAM_BASELINK) *
+       kPointCam.homogeneous())
+          .hnormalized();
+  const std::vector<std::vector<double>> parameters{
+      Orientation(T_WORLD_BASELINK), Position(T_WORLD_BASELINK),
+      {P_WORLD[0], P_WORLD[1], P_WORLD[2]}};
+
+  std::unique_ptr<ceres::CostFunction> cost_function;
+  if (state.range(0) == 0) {
+    cost_function = std::make_unique<bs_constraints::EuclideanReprojection>(
+        kInformation, kPixel, kK, T_CAM_BASELINK);
+  } else {
+    cost_function = std::make_unique<ceres::AutoDiffCostFunction<
+        bs_constraints::EuclideanReprojectionFunctor, 2, 4, 3, 3>>(
+        new bs_constraints::EuclideanReprojectionFunctor(kInformation, kPixel,
+                                                         kK, T_CAM_BASELINK));
+  }
+  EvaluateCostFunction(state, *cost_function, parameters);
+}
+BENCHMARK(BM_EuclideanReprojection)->Arg(0)->Arg(1);
+
+static void BM_InverseDepthReprojection(benchmark::State& state) {
+  const Eigen::Matrix4d T_CAM_BASELINK = TCamBaselink();
+  const Eigen::Matrix4d T_WORLD_BASELINKa =
+      Pose(0.3, Eigen::Vector3d(1.0, 2.0, 3.0));
+  const Eigen::Matrix4d T_WORLD_BASELINKm =
+      T_WORLD_BASELINKa * Pose(0.05, Eigen::Vector3d(0.3, 0.0, 0.1));
+  const Eigen::Vector3d bearing = kPointCam.normalized();
+  const std::vector<std::vector<double>> parameters{
+      Orientation(T_WORLD_BASELINKa),
+      Position(T_WORLD_BASELINKa),
+      Orientation(T_WORLD_BASELINKm),
+      Position(T_WORLD_BASELINKm),
+      {1.0 / kPointCam.norm()}};
+
+  std::unique_ptr<ceres::CostFunction> cost_function;
+  if (state.range(0) == 0) {
+    cost_function = std::make_unique<bs_constraints::InverseDepthReprojection>(
+        kInformation, kPixel, kK, T_CAM_BASELINK, bearing);
+  } else {
+    cost_function = std::make_unique<ceres::AutoDiffCostFunction<
+        bs_constraints::InverseDepthReprojectionFunctor, 2, 4, 3, 4, 3, 1>>(
+        new bs_constraints::InverseDepthReprojectionFunctor(
+            kInformation, kPixel, kK, T_CAM_BASELINK, bearing));
+  }
+  EvaluateCostFunction(state, *cost_function, parameters);
+}
+BENCHMARK(BM_InverseDepthReprojection)->Arg(0)->Arg(1);
+
+static void BM_DeltaPose3DWithExtrinsics(benchmark::State& state) {
+  const Eigen::Matrix4d T_WORLD_BASELINK1 =
+      Pose(0.3, Eigen::Vector3d(1.0, 2.0, 3.0));
+  const Eigen::Matrix4d T_WORLD_BASELINK2 =
+      T_WORLD_BASELINK1 * Pose(0.05, Eigen::Vector3d(0.5, 0.1, 0.0));
+  const Eigen::Matrix4d T_BASELINK_SENSOR =
+      beam::InvertTransform(TCamBaselink());
+  const std::vector<std::vector<double>> parameters{
+      Position(T_WORLD_BASELINK1), Orientation(T_WORLD_BASELINK1),
+      Position(T_WORLD_BASELINK2), Orientation(T_WORLD_BASELINK2),
+      Position(T_BASELINK_SENSOR), Orientation(T_BASELINK_SENSOR)};
+
+  // measurement close to the relative sensor pose
+  const Eigen::Matrix4d T_SENSOR1_SENSOR2 =
+      beam::InvertTransform(T_WORLD_BASELINK1 * T_BASELINK_SENSOR) *
+      T_WORLD_BASELINK2 * T_BASELINK_SENSOR *
+      Pose(0.01, Eigen::Vector3d(0.01, 0.0, -0.01));
+  const Eigen::Quaterniond q(T_SENSOR1_SENSOR2.block<3, 3>(0, 0));
+  fuse_core::Vector7d d_S1_S2;
+  d_S1_S2 << T_SENSOR1_SENSOR2(0, 3), T_SENSOR1_SENSOR2(1, 3),
+      T_SENSOR1_SENSOR2(2, 3), q.w(), q.x(), q.y(), q.z();
+  const fuse_core::Matrix6d sqrt_info = fuse_core::Matrix6d::Identity() * 10;
+
+  std::unique_ptr<ceres::CostFunction> cost_function;
+  if (state.range(0) == 0) {
+    cost_function = std::make_unique<bs_constraints::DeltaPose3DWithExtrinsics>(
+        sqrt_info, d_S1_S2);
+  } else {
+    cost_function = std::make_unique<ceres::AutoDiffCostFunction<
+        bs_constraints::DeltaPose3DWithExtrinsicsCostFunctor, 6, 3, 4, 3, 4, 3,
+        4>>(new bs_constraints::DeltaPose3DWithExtrinsicsCostFunctor(sqrt_info,
+                                                                     d_S1_S2));
+  }
+  EvaluateCostFunction(state, *cost_function, parameters);
+}
+BENCHMARK(BM_DeltaPose3DWithExtrinsics)->Arg(0)->Arg(1);
+
+// 0.5s of imu data at 200Hz between two states, with the biases of state i
+// away from the linearization point so the bias correction is evaluated
+static void BM_NormalDeltaImuState3D(benchmark::State& state) {
+  const Eigen::Vector3d bg(0.01, -0.02, 0.015);
+  const Eigen::Vector3d ba(0.1, 0.05, -0.08);
+  auto pre_integrator = std::make_shared<bs_common::PreIntegrator>();
+  pre_integrator->cov_w = 1e-4 * Eigen::Matrix3d::Identity();
+  pre_integrator->cov_a = 1e-3 * Eigen::Matrix3d::Identity();
+  pre_integrator->cov_bg = 1e-6 * Eigen::Matrix3d::Identity();
+  pre_integrator->cov_ba = 1e-5 * Eigen::Matrix3d::Identity();
+  for (int i = 0; i <= 100; i++) {
+    bs_common::IMUData imu_data;
+    imu_data.t = ros::Time(1.0 + 0.005 * i);
+    imu_data.w = Eigen::Vector3d(0.1, -0.2, 0.3);
+    imu_data.a = Eigen::Vector3d(0.5, 0.2, 9.81);
+    pre_integrator->AddData(imu_data);
+  }
+  pre_integrator->Integrate(ros::Time(1.5), bg, ba, true, true, true);
+
+  const Eigen::Quaterniond q_i(
+      Eigen::AngleAxisd(0.3, Eigen::Vector3d(1, 2, 3).normalized()));
+  const Eigen::Vector3d p_i(1.0, 2.0, 3.0);
+  const Eigen::Vector3d v_i(1.0, 0.5, 0.0);
+  const bs_common::ImuState imu_state_i(ros::Time(1.0), q_i, p_i, v_i, bg, ba);
+  const bs_common::ImuState state_i(ros::Time(1.0), q_i, p_i, v_i,
+                                    bg + Eigen::Vector3d::Constant(0.01),
+                                    ba - Eigen::Vector3d::Constant(0.01));
+  const bs_common::ImuState state_j(
+      ros::Time(1.5), q_i * pre_integrator->delta.q,
+      p_i + Eigen::Vector3d(0.5, 0.3, 0.1), v_i + Eigen::Vector3d(0.2, 0, 0),
+      bg, ba);
+  const std::vector<std::vector<double>> parameters{
+      Data(state_i.Orientation()), Data(state_i.Position()),
+      Data(state_i.Velocity()),    Data(state_i.GyroBias()),
+      Data(state_i.AccelBias()),   Data(state_j.Orientation()),
+      Data(state_j.Position()),    Data(state_j.Velocity()),
+      Data(state_j.GyroBias()),    Data(state_j.AccelBias())};
+
+  std::unique_ptr<ceres::CostFunction> cost_function;
+  if (state.range(0) == 0) {
+    cost_function = std::make_unique<bs_constraints::NormalDeltaImuState3D>(
+        imu_state_i, *pre_integrator, 1.0);
+  } else {
+    cost_function = std::make_unique<ceres::AutoDiffCostFunction<
+        bs_constraints::NormalDeltaImuState3DCostFunctor, 15, 4, 3, 3, 3, 3, 4,
+        3, 3, 3, 3>>(new bs_constraints::NormalDeltaImuState3DCostFunctor(
+        imu_state_i, pre_integrator, 1.0));
+  }
+  EvaluateCostFunction(state, *cost_function, parameters);
+}
+BENCHMARK(BM_NormalDeltaImuState3D)->Arg(0)->Arg(1);
+
+// merges one transaction per keyframe into the initialization graph, each
+// keyframe adds its pose, the previous pose and the constraint between them.
+// Arg(0) merges with fuse_core::Transaction::merge, Arg(1) with a
+// bs_constraints::TransactionBatch
+static void BM_MergeKeyframeTransactions(benchmark::State& state) {
+  const int num_keyframes = state.range(1);
+  std::vector<fuse_core::Transaction::SharedPtr> keyframe_transactions;
+  fuse_variables::Position3DStamped p1(ros::Time(1));
+  fuse_variables::Orientation3DStamped o1(ros::Time(1));
+  for (int i = 2; i <= num_keyframes; i++) {
+    const ros::Time stamp(i);
+    fuse_variables::Position3DStamped p2(stamp);
+    fuse_variables::Orientation3DStamped o2(stamp);
+    p2.x() = i;
+    bs_constraints::Pose3DStampedTransaction transaction(stamp);
+    transaction.AddPoseVariables(p1, o1, p1.stamp());
+    transaction.AddPoseVariables(p2, o2, stamp);
+    transaction.AddPoseConstraint(p1, p2, o1, o2,
+                                  (fuse_core::Vector7d() << 1, 0, 0, 1, 0, 0, 0)
+                                      .finished(),
+                                  fuse_core::Matrix6d::Identity(), "benchmark");
+    keyframe_transactions.push_back(transaction.GetTransaction());
+    p1 = p2;
+    o1 = o2;
+  }
+
+  for (auto _ : state) {
+    fuse_core::Transaction merged;
+    if (state.range(0) == 0) {
+      for (const auto& transaction : keyframe_transactions) {
+        merged.merge(*transaction);
+      }
+    } else {
+      bs_constraints::TransactionBatch batch;
+      batch.Reserve(4 * num_keyframes, num_keyframes, 2 * num_keyframes);
+      for (const auto& transaction : keyframe_transactions) {
+        batch.Merge(*transaction);
+      }
+      batch.MoveInto(merged);
+    }
+    benchmark::DoNotOptimize(merged);
+  }
+}
+BENCHMARK(BM_MergeKeyframeTransactions)
+    ->Args({0, 500})
+    ->Args({1, 500})
+    ->Args({0, 2000})
+    ->Args({1, 2000})
+    ->Unit(benchmark::kMillisecond);
+
+// Arg(0) serializes the window graph with the boost binary archive, Arg(1)
+// with the compact serializer
+static void BM_WriteGraph(benchmark::State& state) {
+  fuse_graphs::HashGraph graph;
+  graph.update(*MakeWindow());
+  bs_common::ByteWriter writer;
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      std::stringstream stream;
+      {
+        fuse_core::BinaryOutputArchive archive(stream);
+        graph.serialize(archive);
+      }
+      benchmark::DoNotOptimize(stream.str());
+    } else {
+      writer.Clear();
+      Serializer().WriteGraph(graph, writer);
+      benchmark::DoNotOptimize(writer.Size());
+    }
+  }
+}
+BENCHMARK(BM_WriteGraph)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+static void BM_ReadGraph(benchmark::State& state) {
+  fuse_graphs::HashGraph graph;
+  graph.update(*MakeWindow());
+  std::string boost_data;
+  {
+    std::stringstream stream;
+    {
+      fuse_core::BinaryOutputArchive archive(stream);
+      graph.serialize(archive);
+    }
+    boost_data = stream.str();
+  }
+  bs_common::ByteWriter writer;
+  Serializer().WriteGraph(graph, writer);
+
+  for (auto _ : state) {
+    fuse_graphs::HashGraph read;
+    if (state.range(0) == 0) {
+      std::stringstream stream(boost_data);
+      fuse_core::BinaryInputArchive archive(stream);
+      read.deserialize(archive);
+    } else {
+      bs_common::ByteReader reader(writer.Data().data(), writer.Size());
+      Serializer().ReadGraph(reader, read);
+    }
+    benchmark::DoNotOptimize(read);
+  }
+}
+BENCHMARK(BM_ReadGraph)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
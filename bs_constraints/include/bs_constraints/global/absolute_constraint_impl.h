@@ -8,6 +8,8 @@
 #include <bs_variables/accel_bias_3d_stamped.h>
 #include <bs_variables/gyro_bias_3d_stamped.h>
 
+#include <bs_constraints/global/normal_prior_euclidean_function.h>
+
 namespace fuse_constraints {
 
 template <>
@@ -40,4 +42,37 @@ inline std::string fuse_constraints::AbsoluteConstraint<
   return "fuse_constraints::AbsoluteAccelBias3DStampedConstraint";
 }
 
+// The 3D variables get fixed size priors instead of the dynamically sized
+// ceres::NormalPrior
+
+template <>
+inline ceres::CostFunction* fuse_constraints::AbsoluteConstraint<
+    fuse_variables::VelocityAngular3DStamped>::costFunction() const {
+  return bs_constraints::MakeNormalPriorEuclidean<3>(sqrt_information_, mean_);
+}
+
+template <>
+inline ceres::CostFunction* fuse_constraints::AbsoluteConstraint<
+    fuse_variables::VelocityLinear3DStamped>::costFunction() const {
+  return bs_constraints::MakeNormalPriorEuclidean<3>(sqrt_information_, mean_);
+}
+
+template <>
+inline ceres::CostFunction* fuse_constraints::AbsoluteConstraint<
+    fuse_variables::AccelerationLinear3DStamped>::costFunction() const {
+  return bs_constraints::MakeNormalPriorEuclidean<3>(sqrt_information_, mean_);
+}
+
+template <>
+inline ceres::CostFunction* fuse_constraints::AbsoluteConstraint<
+    bs_variables::GyroscopeBias3DStamped>::costFunction() const {
+  return bs_constraints::MakeNormalPriorEuclidean<3>(sqrt_information_, mean_);
+}
+
+template <>
+inline ceres::CostFunction* fuse_constraints::AbsoluteConstraint<
+    bs_variables::AccelerationBias3DStamped>::costFunction() const {
+  return bs_constraints::MakeNormalPriorEuclidean<3>(sqrt_information_, mean_);
+}
+
 }  // namespace fuse_constraints
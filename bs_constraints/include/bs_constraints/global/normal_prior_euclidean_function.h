@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ceres/normal_prior.h>
+#include <ceres/sized_cost_function.h>
+
+#include <fuse_core/eigen.h>
+#include <fuse_core/fuse_macros.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Prior on an N dimensional euclidean variable with a fixed size
+ * residual, i.e. a fixed size ceres::NormalPrior:
+ *
+ *   cost(x) = || A * (x - b) ||^2
+ *
+ * The jacobian is A, which is copied without any dynamic allocation.
+ */
+template <int N>
+class NormalPriorEuclidean : public ceres::SizedCostFunction<N, N> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] A The residual weighting matrix, most likely the square root
+   * information matrix
+   * @param[in] b The mean of the variable
+   */
+  NormalPriorEuclidean(const Eigen::Matrix<double, N, N>& A,
+                       const Eigen::Matrix<double, N, 1>& b)
+      : A_(A), b_(b) {}
+
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Map<const Eigen::Matrix<double, N, 1>> x(parameters[0]);
+    Eigen::Map<Eigen::Matrix<double, N, 1>> E(residual);
+    E.noalias() = A_ * (x - b_);
+    if (jacobians && jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, N, N, Eigen::RowMajor>> J(jacobians[0]);
+      J = A_;
+    }
+    return true;
+  }
+
+private:
+  Eigen::Matrix<double, N, N> A_;
+  Eigen::Matrix<double, N, 1> b_;
+};
+
+/**
+ * @brief Create the prior of a fuse absolute constraint on an N dimensional
+ * variable. Constraints on all N dimensions get a fixed size
+ * NormalPriorEuclidean, partial constraints (fewer rows) a ceres::NormalPrior
+ * as in fuse
+ */
+template <int N>
+ceres::CostFunction* MakeNormalPriorEuclidean(const fuse_core::MatrixXd& A,
+                                              const fuse_core::VectorXd& b) {
+  if (A.rows() != N || A.cols() != N || b.size() != N) {
+    return new ceres::NormalPrior(A, b);
+  }
+  return new NormalPriorEuclidean<N>(A, b);
+}
+
+} // namespace bs_constraints
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ceres/rotation.h>
+#include <ceres/sized_cost_function.h>
+
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/eigen.h>
+#include <fuse_core/fuse_macros.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Prior on a 3D pose with analytic jacobians. This is equivalent to the
+ * autodiff fuse_constraints::NormalPriorPose3DCostFunctor:
+ *
+ *   cost(x) = || A * [  p - b(0:2)               ] ||^2
+ *             ||     [  AngleAxis(b(3:6)^-1 * q) ] ||
+ *
+ * The square root information and mean are stored with fixed sizes, so
+ * evaluating does not allocate. The quaternion jacobian is exact in the
+ * tangent space of unit quaternions (see MinusJacobian).
+ */
+class NormalPriorPose3D : public ceres::SizedCostFunction<6, 3, 4> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] A The residual weighting matrix, most likely the square root
+   * information matrix in order (x, y, z, qx, qy, qz)
+   * @param[in] b The pose measurement or prior in order (x, y, z, qw, qx, qy,
+   * qz)
+   */
+  NormalPriorPose3D(const fuse_core::Matrix6d& A, const fuse_core::Vector7d& b)
+      : A_(A),
+        p_(b.head<3>()),
+        q_inverse_(Eigen::Quaterniond(b[3], b[4], b[5], b[6]).conjugate()) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : position
+   *                         1 : orientation (w, x, y, z)
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Map<const Eigen::Vector3d> p(parameters[0]);
+    const Eigen::Quaterniond q(parameters[1][0], parameters[1][1],
+                               parameters[1][2], parameters[1][3]);
+
+    // the angle axis of the difference is invariant to the scale of q
+    const Eigen::Quaterniond q_error = q_inverse_ * q;
+    const double q_error_wxyz[4] = {q_error.w(), q_error.x(), q_error.y(),
+                                    q_error.z()};
+    Eigen::Matrix<double, 6, 1> error;
+    error.head<3>() = p - p_;
+    ceres::QuaternionToAngleAxis(q_error_wxyz, error.data() + 3);
+
+    Eigen::Map<Eigen::Matrix<double, 6, 1>> E(residual);
+    E.noalias() = A_ * error;
+
+    if (!jacobians) { return true; }
+
+    if (jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 3, Eigen::RowMajor>> J(jacobians[0]);
+      J = A_.leftCols<3>();
+    }
+    if (jacobians[1]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 4, Eigen::RowMajor>> J(jacobians[1]);
+      J.noalias() = A_.rightCols<3>() *
+                    SO3RightJacobianInverse(error.tail<3>()) *
+                    MinusJacobian(q.normalized());
+    }
+    return true;
+  }
+
+private:
+  fuse_core::Matrix6d A_;
+  Eigen::Vector3d p_;
+  Eigen::Quaterniond q_inverse_;
+};
+
+} // namespace bs_constraints
@@ -14,6 +14,7 @@
 #include <fuse_core/serialization.h>
 #include <fuse_core/uuid.h>
 
+#include <bs_common/chunk_file.h>
 #include <bs_common/imu_state.h>
 
 namespace bs_constraints {
@@ -98,6 +99,17 @@ public:
    */
   ceres::CostFunction* costFunction() const override;
 
+  /**
+   * @brief Write the constraint in the compact binary encoding, see
+   * bs_common::CompactSerializer
+   */
+  void serializeCompact(bs_common::ByteWriter& writer) const;
+
+  /**
+   * @brief Read a constraint written by serializeCompact
+   */
+  void deserializeCompact(bs_common::ByteReader& reader);
+
 protected:
   Eigen::Matrix<double, 16, 1> mean_;
   Eigen::Matrix<double, 15, 15> sqrt_information_;
@@ -9,6 +9,7 @@
 #include <bs_common/imu_state.h>
 #include <bs_common/preintegrator.h>
 #include <bs_common/utils.h>
+#include <bs_constraints/transaction_batch.h>
 
 namespace bs_constraints {
 
@@ -19,12 +20,22 @@ public:
 
   /// @brief
   /// @param transaction_stamp
-  ImuState3DStampedTransaction(const ros::Time& transaction_stamp);
+  /// @param use_pooled_allocation allocate constraints and variables from the
+  /// pools of their types (see bs_common::MakePooled)
+  ImuState3DStampedTransaction(const ros::Time& transaction_stamp,
+                               bool use_pooled_allocation = false);
 
   /// @brief
   /// @return
   fuse_core::Transaction::SharedPtr GetTransaction() const;
 
+  /// @brief stage the variables and constraints added from now on in a
+  /// bs_constraints::TransactionBatch with this capacity, which is moved into
+  /// the transaction by GetTransaction
+  /// @param num_states number of imu states that will be added
+  /// @param num_constraints
+  void Reserve(size_t num_states, size_t num_constraints);
+
   /// @brief
   /// @param imu_state
   /// @param prior_covariance
@@ -50,7 +61,15 @@ public:
   void AddImuStateVariables(const bs_common::ImuState& imu_state);
 
 protected:
+  void addVariable(fuse_core::Variable::SharedPtr variable);
+
+  void addConstraint(fuse_core::Constraint::SharedPtr constraint);
+
   fuse_core::Transaction::SharedPtr transaction_;
+  bool use_pooled_allocation_;
+  bool use_batch_{false};
+  // flushed into the transaction by GetTransaction
+  mutable TransactionBatch batch_;
 };
 
 } // namespace bs_constraints
\ No newline at end of file
@@ -48,7 +48,7 @@ private:
   Eigen::Matrix<double, 15, 15> A_; //!< The residual weighting matrix
 };
 
-NormalDeltaImuState3DCostFunctor::NormalDeltaImuState3DCostFunctor(
+inline NormalDeltaImuState3DCostFunctor::NormalDeltaImuState3DCostFunctor(
     const bs_common::ImuState& imu_state_i,
     const std::shared_ptr<bs_common::PreIntegrator> pre_integrator,
     const double info_weight)
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ceres/sized_cost_function.h>
+
+#include <bs_common/imu_state.h>
+#include <bs_common/preintegrator.h>
+#include <bs_common/utils.h>
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/util.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Cost of the difference between two 3D IMU states and their
+ * preintegrated measurement according to DOI: 10.15607/RSS.2015.XI.006, with
+ * analytic jacobians. This is equivalent to the autodiff
+ * NormalDeltaImuState3DCostFunctor.
+ *
+ * The preintegrated measurement is corrected to first order for the change of
+ * the biases of state i, using the bias jacobians computed by the
+ * preintegrator, so these are reused directly in the jacobians wrt the biases.
+ */
+class NormalDeltaImuState3D
+    : public ceres::SizedCostFunction<15, 4, 3, 3, 3, 3, 4, 3, 3, 3, 3> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] imu_state_i IMU state at the start of the preintegration, whose
+   * biases were used to integrate
+   * @param[in] pre_integrator preintegrator containing IMU data between the
+   * two states, with its jacobians and covariance computed
+   * @param[in] info_weight weight applied to the square root information
+   */
+  NormalDeltaImuState3D(const bs_common::ImuState& imu_state_i,
+                        const bs_common::PreIntegrator& pre_integrator,
+                        const double info_weight)
+      : dt_(pre_integrator.delta.t.toSec()),
+        dq_(pre_integrator.delta.q),
+        dp_(pre_integrator.delta.p),
+        dv_(pre_integrator.delta.v),
+        jacobian_(pre_integrator.jacobian),
+        bg_(imu_state_i.GyroBiasVec()),
+        ba_(imu_state_i.AccelBiasVec()),
+        A_(info_weight * pre_integrator.delta.sqrt_inv_cov) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : orientation of state i (4d quaternion)
+   *                         1 : position of state i
+   *                         2 : velocity of state i
+   *                         3 : gyroscope bias of state i
+   *                         4 : accelerometer bias of state i
+   *                         5 - 9 : same for state j
+   * @param[out] residual - The computed residual (error), ordered orientation,
+   * position, velocity, gyroscope bias and accelerometer bias
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Quaterniond q_i(parameters[0][0], parameters[0][1],
+                                 parameters[0][2], parameters[0][3]);
+    const Eigen::Map<const Eigen::Vector3d> p_i(parameters[1]);
+    const Eigen::Map<const Eigen::Vector3d> v_i(parameters[2]);
+    const Eigen::Map<const Eigen::Vector3d> bg_i(parameters[3]);
+    const Eigen::Map<const Eigen::Vector3d> ba_i(parameters[4]);
+    const Eigen::Quaterniond q_j(parameters[5][0], parameters[5][1],
+                                 parameters[5][2], parameters[5][3]);
+    const Eigen::Map<const Eigen::Vector3d> p_j(parameters[6]);
+    const Eigen::Map<const Eigen::Vector3d> v_j(parameters[7]);
+    const Eigen::Map<const Eigen::Vector3d> bg_j(parameters[8]);
+    const Eigen::Map<const Eigen::Vector3d> ba_j(parameters[9]);
+
+    // correct the preintegrated measurement for the change in biases
+    const Eigen::Vector3d dbg = bg_i - bg_;
+    const Eigen::Vector3d dba = ba_i - ba_;
+    const Eigen::Quaterniond dq_bg =
+        bs_common::DeltaQ<double>(jacobian_.dq_dbg * dbg);
+    const Eigen::Quaterniond q_corrected = dq_ * dq_bg;
+    const Eigen::Vector3d p_corrected =
+        dp_ + jacobian_.dp_dbg * dbg + jacobian_.dp_dba * dba;
+    const Eigen::Vector3d v_corrected =
+        dv_ + jacobian_.dv_dbg * dbg + jacobian_.dv_dba * dba;
+
+    const Eigen::Quaterniond q_i_inv = q_i.inverse();
+    const Eigen::Quaterniond q_corrected_inv = q_corrected.inverse();
+    const Eigen::Quaterniond q_error = q_corrected_inv * (q_i_inv * q_j);
+    const Eigen::Vector3d delta_p =
+        p_j - p_i - dt_ * v_i - 0.5 * dt_ * dt_ * GRAVITY_WORLD;
+    const Eigen::Vector3d delta_v = v_j - v_i - dt_ * GRAVITY_WORLD;
+
+    Eigen::Map<Eigen::Matrix<double, 15, 1>> E(residual);
+    E.segment<3>(0) = 2.0 * q_error.vec();
+    E.segment<3>(3) = q_i.conjugate() * delta_p - p_corrected;
+    E.segment<3>(6) = q_i.conjugate() * delta_v - v_corrected;
+    E.segment<3>(9) = bg_j - bg_i;
+    E.segment<3>(12) = ba_j - ba_i;
+    E.applyOnTheLeft(A_);
+
+    if (!jacobians) { return true; }
+
+    const Eigen::Matrix3d R_i_T = q_i.conjugate().toRotationMatrix();
+    const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+
+    // orientation i
+    if (jacobians[0]) {
+      Eigen::Matrix<double, 15, 4> J = Eigen::Matrix<double, 15, 4>::Zero();
+      J.block<3, 4>(0, 0) =
+          2.0 * (QuaternionLeftProductMatrix(q_corrected_inv) *
+                 QuaternionRightProductMatrix(q_j) *
+                 DQuaternionInverseDQuaternion(q_i))
+                    .bottomRows<3>();
+      J.block<3, 4>(3, 0) = DInverseQuaternionRotationDQuaternion(q_i, delta_p);
+      J.block<3, 4>(6, 0) = DInverseQuaternionRotationDQuaternion(q_i, delta_v);
+      SetJacobian(J, jacobians[0]);
+    }
+
+    // position i
+    if (jacobians[1]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(3, 0) = -R_i_T;
+      SetJacobian(J, jacobians[1]);
+    }
+
+    // velocity i
+    if (jacobians[2]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(3, 0) = -dt_ * R_i_T;
+      J.block<3, 3>(6, 0) = -R_i_T;
+      SetJacobian(J, jacobians[2]);
+    }
+
+    // gyro bias i, through the bias correction
+    if (jacobians[3]) {
+      // q_error = dq_bg^-1 * (dq^-1 * q_i^-1 * q_j), and dq_bg = [1, theta / 2]
+      Eigen::Matrix<double, 4, 3> d_dq_bg_d_theta =
+          Eigen::Matrix<double, 4, 3>::Zero();
+      d_dq_bg_d_theta.bottomRows<3>() = 0.5 * I;
+      const Eigen::Quaterniond q_rest = dq_.inverse() * (q_i_inv * q_j);
+
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(0, 0) =
+          2.0 * (QuaternionRightProductMatrix(q_rest) *
+                 DQuaternionInverseDQuaternion(dq_bg) * d_dq_bg_d_theta)
+                    .bottomRows<3>() *
+          jacobian_.dq_dbg;
+      J.block<3, 3>(3, 0) = -jacobian_.dp_dbg;
+      J.block<3, 3>(6, 0) = -jacobian_.dv_dbg;
+      J.block<3, 3>(9, 0) = -I;
+      SetJacobian(J, jacobians[3]);
+    }
+
+    // accel bias i, through the bias correction
+    if (jacobians[4]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(3, 0) = -jacobian_.dp_dba;
+      J.block<3, 3>(6, 0) = -jacobian_.dv_dba;
+      J.block<3, 3>(12, 0) = -I;
+      SetJacobian(J, jacobians[4]);
+    }
+
+    // orientation j
+    if (jacobians[5]) {
+      Eigen::Matrix<double, 15, 4> J = Eigen::Matrix<double, 15, 4>::Zero();
+      J.block<3, 4>(0, 0) =
+          2.0 * QuaternionLeftProductMatrix(q_corrected_inv * q_i_inv)
+                    .bottomRows<3>();
+      SetJacobian(J, jacobians[5]);
+    }
+
+    // position j
+    if (jacobians[6]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(3, 0) = R_i_T;
+      SetJacobian(J, jacobians[6]);
+    }
+
+    // velocity j
+    if (jacobians[7]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(6, 0) = R_i_T;
+      SetJacobian(J, jacobians[7]);
+    }
+
+    // gyro bias j
+    if (jacobians[8]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(9, 0) = I;
+      SetJacobian(J, jacobians[8]);
+    }
+
+    // accel bias j
+    if (jacobians[9]) {
+      Eigen::Matrix<double, 15, 3> J = Eigen::Matrix<double, 15, 3>::Zero();
+      J.block<3, 3>(12, 0) = I;
+      SetJacobian(J, jacobians[9]);
+    }
+    return true;
+  }
+
+private:
+  /**
+   * @brief Weights the jacobian of the unweighted residual and writes it to
+   * the (row major) ceres jacobian
+   */
+  template <int N>
+  void SetJacobian(const Eigen::Matrix<double, 15, N>& J,
+                   double* jacobian) const {
+    Eigen::Map<Eigen::Matrix<double, 15, N, Eigen::RowMajor>> J_map(jacobian);
+    J_map.noalias() = A_ * J;
+  }
+
+  double dt_;
+  Eigen::Quaterniond dq_;
+  Eigen::Vector3d dp_;
+  Eigen::Vector3d dv_;
+  bs_common::Jacobian jacobian_; //!< bias jacobians of the measurement
+  Eigen::Vector3d bg_;           //!< gyro bias used to integrate
+  Eigen::Vector3d ba_;           //!< accel bias used to integrate
+  Eigen::Matrix<double, 15, 15> A_; //!< The residual weighting matrix
+};
+
+} // namespace bs_constraints
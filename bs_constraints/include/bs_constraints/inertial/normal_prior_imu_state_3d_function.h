@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ceres/rotation.h>
+#include <ceres/sized_cost_function.h>
+
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/fuse_macros.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Prior on a 3D imu state with analytic jacobians. This is equivalent
+ * to the autodiff NormalPriorImuState3DCostFunctor:
+ *
+ *   cost(x) = || A * [  AngleAxis(b(0:3)^-1 * q) ] ||^2
+ *             ||     [  p - b(4:6)               ] ||
+ *             ||     [  v - b(7:9)               ] ||
+ *             ||     [  bg - b(10:12)            ] ||
+ *             ||     [  ba - b(13:15)            ] ||
+ *
+ * This is evaluated for every marginalization prior and first window prior, so
+ * the 15x15 square root information and mean are stored with fixed sizes and
+ * evaluating does not allocate. The jacobians wrt the euclidean variables are
+ * blocks of A.
+ */
+class NormalPriorImuState3D
+    : public ceres::SizedCostFunction<15, 4, 3, 3, 3, 3> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] A The residual weighting matrix, most likely the square root
+   * information matrix
+   * @param[in] b The imu state prior in order (qw, qx, qy, qz, p, v, bg, ba)
+   */
+  NormalPriorImuState3D(const Eigen::Matrix<double, 15, 15>& A,
+                        const Eigen::Matrix<double, 16, 1>& b)
+      : A_(A),
+        b_(b.tail<12>()),
+        q_inverse_(Eigen::Quaterniond(b[0], b[1], b[2], b[3]).conjugate()) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : orientation (w, x, y, z)
+   *                         1 : position
+   *                         2 : velocity
+   *                         3 : gyroscope bias
+   *                         4 : accelerometer bias
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Quaterniond q(parameters[0][0], parameters[0][1],
+                               parameters[0][2], parameters[0][3]);
+
+    // the angle axis of the difference is invariant to the scale of q
+    const Eigen::Quaterniond q_error = q_inverse_ * q;
+    const double q_error_wxyz[4] = {q_error.w(), q_error.x(), q_error.y(),
+                                    q_error.z()};
+    Eigen::Matrix<double, 15, 1> error;
+    ceres::QuaternionToAngleAxis(q_error_wxyz, error.data());
+    for (int i = 0; i < 4; i++) {
+      error.segment<3>(3 + 3 * i) =
+          Eigen::Map<const Eigen::Vector3d>(parameters[i + 1]) -
+          b_.segment<3>(3 * i);
+    }
+
+    Eigen::Map<Eigen::Matrix<double, 15, 1>> E(residual);
+    E.noalias() = A_ * error;
+
+    if (!jacobians) { return true; }
+
+    if (jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, 15, 4, Eigen::RowMajor>> J(
+          jacobians[0]);
+      J.noalias() = A_.leftCols<3>() *
+                    SO3RightJacobianInverse(error.head<3>()) *
+                    MinusJacobian(q.normalized());
+    }
+    for (int i = 0; i < 4; i++) {
+      if (!jacobians[i + 1]) { continue; }
+      Eigen::Map<Eigen::Matrix<double, 15, 3, Eigen::RowMajor>> J(
+          jacobians[i + 1]);
+      J = A_.middleCols<3>(3 + 3 * i);
+    }
+    return true;
+  }
+
+private:
+  Eigen::Matrix<double, 15, 15> A_;
+  Eigen::Matrix<double, 12, 1> b_;
+  Eigen::Quaterniond q_inverse_;
+};
+
+} // namespace bs_constraints
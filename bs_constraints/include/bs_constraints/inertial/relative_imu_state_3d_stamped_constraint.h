@@ -14,6 +14,7 @@
 #include <fuse_core/serialization.h>
 #include <fuse_core/uuid.h>
 
+#include <bs_common/chunk_file.h>
 #include <bs_common/imu_state.h>
 #include <bs_common/preintegrator.h>
 
@@ -91,6 +92,22 @@ public:
    */
   ros::Time GetTime2() { return imu_state_j_.Stamp(); }
 
+  /**
+   * @brief get first state, whose biases the imu data was integrated with
+   */
+  const bs_common::ImuState& GetImuState1() const { return imu_state_i_; }
+
+  /**
+   * @brief Write the constraint in the compact binary encoding, see
+   * bs_common::CompactSerializer
+   */
+  void serializeCompact(bs_common::ByteWriter& writer) const;
+
+  /**
+   * @brief Read a constraint written by serializeCompact
+   */
+  void deserializeCompact(bs_common::ByteReader& reader);
+
 protected:
   bs_common::ImuState imu_state_i_;
   bs_common::ImuState imu_state_j_;
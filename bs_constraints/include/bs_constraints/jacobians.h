@@ -63,6 +63,13 @@ Eigen::Matrix<double, 4, 3> PlusJacobian(const Eigen::Quaterniond& q);
 /// @return
 Eigen::Matrix<double, 3, 4> MinusJacobian(const Eigen::Quaterniond& q);
 
+/// @brief Computes the inverse of the right jacobian of SO3, which maps right
+/// perturbations of a rotation to changes of its rotation vector:
+/// Log(Exp(phi) * Exp(delta)) ~= phi + J_r^-1(phi) * delta
+/// @param phi rotation vector (angle axis)
+/// @return 3x3 jacobian
+Eigen::Matrix3d SO3RightJacobianInverse(const Eigen::Vector3d& phi);
+
 /// @brief
 /// @param R
 /// @param point
@@ -82,6 +89,52 @@ Eigen::Matrix3d DPointRotationDPoint(const Eigen::Matrix3d& R,
 /// @return
 Eigen::Matrix3d DInverseRotationDRotation(const Eigen::Matrix3d& R);
 
+/// @brief Computes jacobian of R(q) * point wrt the quaternion coefficients
+/// [w, x, y, z]. This is exact in the tangent space of unit quaternions, which
+/// is all a quaternion local parameterization uses
+/// @param q unit quaternion
+/// @param point point being rotated
+/// @return 3x4 jacobian
+Eigen::Matrix<double, 3, 4>
+    DQuaternionRotationDQuaternion(const Eigen::Quaterniond& q,
+                                   const Eigen::Vector3d& point);
+
+/// @brief Computes jacobian of R(q)^T * point wrt the quaternion coefficients
+/// [w, x, y, z], see DQuaternionRotationDQuaternion
+/// @param q unit quaternion
+/// @param point point being rotated
+/// @return 3x4 jacobian
+Eigen::Matrix<double, 3, 4>
+    DInverseQuaternionRotationDQuaternion(const Eigen::Quaterniond& q,
+                                          const Eigen::Vector3d& point);
+
+/// @brief Computes the matrix L(q) such that q * p = L(q) * p, with
+/// quaternion coefficients ordered [w, x, y, z]
+/// @param q left quaternion
+/// @return 4x4 matrix
+Eigen::Matrix4d QuaternionLeftProductMatrix(const Eigen::Quaterniond& q);
+
+/// @brief Computes the matrix R(q) such that p * q = R(q) * p, with
+/// quaternion coefficients ordered [w, x, y, z]
+/// @param q right quaternion
+/// @return 4x4 matrix
+Eigen::Matrix4d QuaternionRightProductMatrix(const Eigen::Quaterniond& q);
+
+/// @brief Computes jacobian of q.inverse() = q.conjugate() / |q|^2 wrt the
+/// quaternion coefficients [w, x, y, z]. This is exact for any (non zero) q.
+/// @param q quaternion
+/// @return 4x4 jacobian
+Eigen::Matrix4d DQuaternionInverseDQuaternion(const Eigen::Quaterniond& q);
+
+/// @brief Computes jacobian of the roll, pitch and yaw of a quaternion, as
+/// computed by fuse_core::getRoll, getPitch and getYaw, wrt the quaternion
+/// coefficients [w, x, y, z]. The pitch row is zero when pitch is saturated at
+/// +/- pi / 2
+/// @param q unit quaternion
+/// @return 3x4 jacobian
+Eigen::Matrix<double, 3, 4>
+    DRollPitchYawDQuaternion(const Eigen::Quaterniond& q);
+
 /// @brief
 /// @param R_left
 /// @param R_right
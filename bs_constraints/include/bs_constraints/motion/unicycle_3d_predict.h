@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+
 #include <fuse_core/util.h>
 
 #include <tf2/LinearMath/Transform.h>
@@ -255,4 +257,72 @@ inline void predict(const tf2::Transform& pose1,
   acc_linear2.setZ(acc_linear_z_pred);
 };
 
+/**
+ * @brief Given a state and time delta, predicts a new state and computes the
+ * jacobian of the prediction wrt the first state. States are ordered (x, y, z,
+ * roll, pitch, yaw, x_vel, y_vel, z_vel, roll_vel, pitch_vel, yaw_vel, x_acc,
+ * y_acc, z_acc)
+ * @param[in] state1 - The first state
+ * @param[in] dt - The time delta across which to predict the state
+ * @param[out] state2 - The predicted state, with wrapped angles
+ * @param[out] jacobian - The jacobian of state2 wrt state1
+ */
+inline void predict(const fuse_core::Vector15d& state1, const double dt,
+                    fuse_core::Vector15d& state2,
+                    fuse_core::Matrix15d& jacobian) {
+  predict(state1[0], state1[1], state1[2], state1[3], state1[4], state1[5],
+          state1[6], state1[7], state1[8], state1[9], state1[10], state1[11],
+          state1[12], state1[13], state1[14], dt, state2[0], state2[1],
+          state2[2], state2[3], state2[4], state2[5], state2[6], state2[7],
+          state2[8], state2[9], state2[10], state2[11], state2[12], state2[13],
+          state2[14]);
+
+  const double sr = std::sin(state1[3]);
+  const double cr = std::cos(state1[3]);
+  const double sp = std::sin(state1[4]);
+  const double cp = std::cos(state1[4]);
+  const double sy = std::sin(state1[5]);
+  const double cy = std::cos(state1[5]);
+  const double cpi = 1.0 / cp;
+  const double tp = sp * cpi;
+
+  // position2 = position1 + R(roll, pitch, yaw) * u, with R = Rz * Ry * Rx
+  const Eigen::Vector3d u = dt * state1.segment<3>(6) +
+                            0.5 * dt * dt * state1.segment<3>(12);
+  Eigen::Matrix3d Rx;
+  Rx << 1, 0, 0, 0, cr, -sr, 0, sr, cr;
+  Eigen::Matrix3d Ry;
+  Ry << cp, 0, sp, 0, 1, 0, -sp, 0, cp;
+  Eigen::Matrix3d Rz;
+  Rz << cy, -sy, 0, sy, cy, 0, 0, 0, 1;
+  Eigen::Matrix3d dRx;
+  dRx << 0, 0, 0, 0, -sr, -cr, 0, cr, -sr;
+  Eigen::Matrix3d dRy;
+  dRy << -sp, 0, cp, 0, 0, 0, -cp, 0, -sp;
+  Eigen::Matrix3d dRz;
+  dRz << -sy, -cy, 0, cy, -sy, 0, 0, 0, 0;
+  const Eigen::Matrix3d R = Rz * Ry * Rx;
+
+  // rpy2 = rpy1 + E(roll, pitch) * vel_angular * dt
+  const Eigen::Vector3d w = state1.segment<3>(9);
+  Eigen::Matrix3d E;
+  E << 1, sr * tp, cr * tp, 0, cr, -sr, 0, sr * cpi, cr * cpi;
+  Eigen::Matrix3d dE_droll;
+  dE_droll << 0, cr * tp, -sr * tp, 0, -sr, -cr, 0, cr * cpi, -sr * cpi;
+  Eigen::Matrix3d dE_dpitch;
+  dE_dpitch << 0, sr * cpi * cpi, cr * cpi * cpi, 0, 0, 0, 0,
+      sr * sp * cpi * cpi, cr * sp * cpi * cpi;
+
+  jacobian.setIdentity();
+  jacobian.block<3, 1>(0, 3) = Rz * Ry * dRx * u;
+  jacobian.block<3, 1>(0, 4) = Rz * dRy * Rx * u;
+  jacobian.block<3, 1>(0, 5) = dRz * Ry * Rx * u;
+  jacobian.block<3, 3>(0, 6) = dt * R;
+  jacobian.block<3, 3>(0, 12) = 0.5 * dt * dt * R;
+  jacobian.block<3, 1>(3, 3) += dt * dE_droll * w;
+  jacobian.block<3, 1>(3, 4) += dt * dE_dpitch * w;
+  jacobian.block<3, 3>(3, 9) = dt * E;
+  jacobian.block<3, 3>(6, 12) = dt * Eigen::Matrix3d::Identity();
+}
+
 } // namespace bs_constraints
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ceres/sized_cost_function.h>
+
+#include <bs_constraints/jacobians.h>
+#include <bs_constraints/motion/unicycle_3d_predict.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/util.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Cost of the difference between a 3D state and the state predicted by
+ * the unicycle model from the previous state, with analytic jacobians. This is
+ * equivalent to the autodiff Unicycle3DStateCostFunctor.
+ */
+class Unicycle3DStateCostFunction
+    : public ceres::SizedCostFunction<15, 3, 4, 3, 3, 3, 3, 4, 3, 3, 3> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] dt The time delta across which to generate the kinematic model
+   * cost
+   * @param[in] A The residual weighting matrix, most likely the square root
+   * information matrix in order (x, y, z, roll, pitch, yaw, x_vel, y_vel,
+   * z_vel, roll_vel, pitch_vel, yaw_vel, x_acc, y_acc, z_acc)
+   */
+  Unicycle3DStateCostFunction(const double dt, const fuse_core::Matrix15d& A)
+      : dt_(dt), A_(A) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : position of state 1
+   *                         1 : orientation of state 1 (4d quaternion)
+   *                         2 : linear velocity of state 1
+   *                         3 : angular velocity of state 1
+   *                         4 : linear acceleration of state 1
+   *                         5 - 9 : same for state 2
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Quaterniond q1(parameters[1][0], parameters[1][1],
+                                parameters[1][2], parameters[1][3]);
+    const Eigen::Quaterniond q2(parameters[6][0], parameters[6][1],
+                                parameters[6][2], parameters[6][3]);
+
+    // states ordered as in the residual
+    fuse_core::Vector15d state1;
+    fuse_core::Vector15d state2;
+    state1.segment<3>(0) = Eigen::Map<const Eigen::Vector3d>(parameters[0]);
+    state1[3] = fuse_core::getRoll(q1.w(), q1.x(), q1.y(), q1.z());
+    state1[4] = fuse_core::getPitch(q1.w(), q1.x(), q1.y(), q1.z());
+    state1[5] = fuse_core::getYaw(q1.w(), q1.x(), q1.y(), q1.z());
+    state1.segment<3>(6) = Eigen::Map<const Eigen::Vector3d>(parameters[2]);
+    state1.segment<3>(9) = Eigen::Map<const Eigen::Vector3d>(parameters[3]);
+    state1.segment<3>(12) = Eigen::Map<const Eigen::Vector3d>(parameters[4]);
+    state2.segment<3>(0) = Eigen::Map<const Eigen::Vector3d>(parameters[5]);
+    state2[3] = fuse_core::getRoll(q2.w(), q2.x(), q2.y(), q2.z());
+    state2[4] = fuse_core::getPitch(q2.w(), q2.x(), q2.y(), q2.z());
+    state2[5] = fuse_core::getYaw(q2.w(), q2.x(), q2.y(), q2.z());
+    state2.segment<3>(6) = Eigen::Map<const Eigen::Vector3d>(parameters[7]);
+    state2.segment<3>(9) = Eigen::Map<const Eigen::Vector3d>(parameters[8]);
+    state2.segment<3>(12) = Eigen::Map<const Eigen::Vector3d>(parameters[9]);
+
+    fuse_core::Vector15d state_pred;
+    fuse_core::Matrix15d J_pred;
+    predict(state1, dt_, state_pred, J_pred);
+
+    fuse_core::Vector15d E = state2 - state_pred;
+    fuse_core::wrapAngle2D(E[3]);
+    fuse_core::wrapAngle2D(E[4]);
+    fuse_core::wrapAngle2D(E[5]);
+    Eigen::Map<fuse_core::Vector15d> residual_map(residual);
+    residual_map.noalias() = A_ * E;
+
+    if (!jacobians) { return true; }
+
+    // the residual is state2 - state_pred, so the jacobian of the unweighted
+    // residual wrt state 1 is -J_pred and wrt state 2 is the identity
+    const fuse_core::Matrix15d A_J1 = -A_ * J_pred;
+    for (int i = 0; i < 5; i++) {
+      if (jacobians[i]) {
+        SetJacobian(A_J1, i, i == 1 ? &q1 : nullptr, jacobians[i]);
+      }
+      if (jacobians[i + 5]) {
+        SetJacobian(A_, i, i == 1 ? &q2 : nullptr, jacobians[i + 5]);
+      }
+    }
+    return true;
+  }
+
+private:
+  /**
+   * @brief Writes the jacobian of the weighted residual wrt one parameter
+   * block to the (row major) ceres jacobian
+   * @param J_state jacobian of the weighted residual wrt the state
+   * @param block index of the parameter block within the state
+   * @param q orientation of the state if the block is the orientation, in
+   * which case the jacobian is taken through roll, pitch and yaw
+   * @param jacobian ceres jacobian
+   */
+  void SetJacobian(const fuse_core::Matrix15d& J_state, int block,
+                   const Eigen::Quaterniond* q, double* jacobian) const {
+    if (q) {
+      Eigen::Map<Eigen::Matrix<double, 15, 4, Eigen::RowMajor>> J_map(
+          jacobian);
+      J_map.noalias() =
+          J_state.middleCols<3>(3 * block) * DRollPitchYawDQuaternion(*q);
+    } else {
+      Eigen::Map<Eigen::Matrix<double, 15, 3, Eigen::RowMajor>> J_map(
+          jacobian);
+      J_map = J_state.middleCols<3>(3 * block);
+    }
+  }
+
+  double dt_;
+  fuse_core::Matrix15d A_; //!< The residual weighting matrix, most likely the
+                           //!< square root information matrix
+};
+
+} // namespace bs_constraints
@@ -62,7 +62,7 @@ private:
                            //!< square root information matrix
 };
 
-Unicycle3DStateCostFunctor::Unicycle3DStateCostFunctor(
+inline Unicycle3DStateCostFunctor::Unicycle3DStateCostFunctor(
     const double dt, const fuse_core::Matrix15d& A)
     : dt_(dt), A_(A) {}
 
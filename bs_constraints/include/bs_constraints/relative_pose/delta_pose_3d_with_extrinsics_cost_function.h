@@ -0,0 +1,170 @@
+#pragma once
+
+#include <ceres/sized_cost_function.h>
+
+#include <beam_utils/math.h>
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/eigen.h>
+#include <fuse_core/fuse_macros.h>
+
+#include <ceres/rotation.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Cost function that models a difference between 3D pose variables with
+ * extrinsics, with analytic jacobians. This is equivalent to the autodiff
+ * DeltaPose3DWithExtrinsicsCostFunctor, but much cheaper to evaluate.
+ *
+ * With the sensor poses T_W_S = T_W_B * T_B_S, the residual is:
+ *
+ * r = A * [ R_W_S1^T * (t_W_S2 - t_W_S1) - t_S1_S2 ]
+ *         [ Log(R_S1_S2^T * R_W_S1^T * R_W_S2)    ]
+ *
+ * where A is the square root information matrix and T_S1_S2 the measurement.
+ * The quaternion jacobians are exact in the tangent space of unit quaternions
+ * (see MinusJacobian), which is all the orientation local parameterizations
+ * use.
+ */
+class DeltaPose3DWithExtrinsics
+    : public ceres::SizedCostFunction<6, 3, 4, 3, 4, 3, 4> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Constructor
+   *
+   * @param[in] sqrt_info The square root information matrix used as the
+   * residual weighting matrix (dx, dy, dz, dqx, dqy, dqz)
+   * @param[in] d_Sensor1_Sensor2 The exposed pose difference between pose 1 and
+   * pose 2 in order (dx, dy, dz, dqw, dqx, dqy, dqz) expressed in the sensor
+   * frame
+   */
+  DeltaPose3DWithExtrinsics(const fuse_core::Matrix6d& sqrt_info,
+                            const fuse_core::Vector7d& d_Sensor1_Sensor2)
+      : sqrt_info_(sqrt_info),
+        t_S1_S2_(d_Sensor1_Sensor2.head<3>()),
+        R_S2_S1_(Eigen::Quaterniond(d_Sensor1_Sensor2[3], d_Sensor1_Sensor2[4],
+                                    d_Sensor1_Sensor2[5], d_Sensor1_Sensor2[6])
+                     .normalized()
+                     .toRotationMatrix()
+                     .transpose()) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : p_World_Baselink1
+   *                         1 : o_World_Baselink1 (w, x, y, z)
+   *                         2 : p_World_Baselink2
+   *                         3 : o_World_Baselink2 (w, x, y, z)
+   *                         4 : p_Baselink_Sensor
+   *                         5 : o_Baselink_Sensor (w, x, y, z)
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Map<const Eigen::Vector3d> t_W_B1(parameters[0]);
+    const Eigen::Quaterniond q_W_B1(parameters[1][0], parameters[1][1],
+                                    parameters[1][2], parameters[1][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_W_B2(parameters[2]);
+    const Eigen::Quaterniond q_W_B2(parameters[3][0], parameters[3][1],
+                                    parameters[3][2], parameters[3][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_B_S(parameters[4]);
+    const Eigen::Quaterniond q_B_S(parameters[5][0], parameters[5][1],
+                                   parameters[5][2], parameters[5][3]);
+
+    // rotations are normalized, as done by ceres::QuaternionRotatePoint
+    const Eigen::Matrix3d R_W_B1 = q_W_B1.normalized().toRotationMatrix();
+    const Eigen::Matrix3d R_W_B2 = q_W_B2.normalized().toRotationMatrix();
+    const Eigen::Matrix3d R_B_S = q_B_S.normalized().toRotationMatrix();
+    const Eigen::Matrix3d R_S_B = R_B_S.transpose();
+    const Eigen::Matrix3d R_B1_W = R_W_B1.transpose();
+    const Eigen::Matrix3d R_B1_B2 = R_B1_W * R_W_B2;
+
+    // relative sensor pose
+    const Eigen::Vector3d t_B1_S2 = R_B1_W * (R_W_B2 * t_B_S + t_W_B2 - t_W_B1);
+    const Eigen::Vector3d t_S1_S2 = R_S_B * (t_B1_S2 - t_B_S);
+    const Eigen::Matrix3d R_S1_S2 = R_S_B * R_B1_B2 * R_B_S;
+
+    // error of the relative sensor pose wrt the measurement
+    const Eigen::Matrix3d R_error = R_S2_S1_ * R_S1_S2;
+    Eigen::Matrix<double, 6, 1> error;
+    error.head<3>() = t_S1_S2 - t_S1_S2_;
+    ceres::RotationMatrixToAngleAxis(
+        ceres::ColumnMajorAdapter3x3(R_error.data()), error.data() + 3);
+
+    Eigen::Map<Eigen::Matrix<double, 6, 1>> E(residual);
+    E = sqrt_info_ * error;
+
+    if (!jacobians) { return true; }
+
+    // jacobians of the error wrt right perturbations of each rotation, which
+    // are converted to the quaternion coefficients with the minus jacobian
+    const Eigen::Matrix3d J_r_inv = SO3RightJacobianInverse(error.tail<3>());
+    const Eigen::Matrix3d R_S1_B2 = R_S_B * R_B1_B2;
+
+    if (jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 3, Eigen::RowMajor>> J(jacobians[0]);
+      Eigen::Matrix<double, 6, 3> d_error_d_t_W_B1 =
+          Eigen::Matrix<double, 6, 3>::Zero();
+      d_error_d_t_W_B1.topRows<3>() = -R_S_B * R_B1_W;
+      J = sqrt_info_ * d_error_d_t_W_B1;
+    }
+    if (jacobians[1]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 4, Eigen::RowMajor>> J(jacobians[1]);
+      Eigen::Matrix<double, 6, 3> d_error_d_R_W_B1;
+      d_error_d_R_W_B1.topRows<3>() = R_S_B * beam::SkewX(t_B1_S2);
+      d_error_d_R_W_B1.bottomRows<3>() =
+          -J_r_inv * R_S_B * R_B1_B2.transpose();
+      J = sqrt_info_ * d_error_d_R_W_B1 * MinusJacobian(q_W_B1.normalized());
+    }
+    if (jacobians[2]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 3, Eigen::RowMajor>> J(jacobians[2]);
+      Eigen::Matrix<double, 6, 3> d_error_d_t_W_B2 =
+          Eigen::Matrix<double, 6, 3>::Zero();
+      d_error_d_t_W_B2.topRows<3>() = R_S_B * R_B1_W;
+      J = sqrt_info_ * d_error_d_t_W_B2;
+    }
+    if (jacobians[3]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 4, Eigen::RowMajor>> J(jacobians[3]);
+      Eigen::Matrix<double, 6, 3> d_error_d_R_W_B2;
+      d_error_d_R_W_B2.topRows<3>() =
+          R_S_B * R_B1_W * DPointRotationDRotation(R_W_B2, t_B_S);
+      d_error_d_R_W_B2.bottomRows<3>() =
+          J_r_inv * DRotationCompositionDRightRotation(R_S1_B2, R_B_S) *
+          R_S_B;
+      J = sqrt_info_ * d_error_d_R_W_B2 * MinusJacobian(q_W_B2.normalized());
+    }
+    if (jacobians[4]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 3, Eigen::RowMajor>> J(jacobians[4]);
+      Eigen::Matrix<double, 6, 3> d_error_d_t_B_S =
+          Eigen::Matrix<double, 6, 3>::Zero();
+      d_error_d_t_B_S.topRows<3>() =
+          R_S_B * (R_B1_B2 - Eigen::Matrix3d::Identity());
+      J = sqrt_info_ * d_error_d_t_B_S;
+    }
+    if (jacobians[5]) {
+      Eigen::Map<Eigen::Matrix<double, 6, 4, Eigen::RowMajor>> J(jacobians[5]);
+      Eigen::Matrix<double, 6, 3> d_error_d_R_B_S;
+      d_error_d_R_B_S.topRows<3>() = beam::SkewX(t_S1_S2);
+      d_error_d_R_B_S.bottomRows<3>() =
+          J_r_inv *
+          (Eigen::Matrix3d::Identity() - R_error.transpose() * R_S2_S1_);
+      J = sqrt_info_ * d_error_d_R_B_S * MinusJacobian(q_B_S.normalized());
+    }
+    return true;
+  }
+
+private:
+  fuse_core::Matrix6d sqrt_info_;
+  Eigen::Vector3d t_S1_S2_;
+  Eigen::Matrix3d R_S2_S1_;
+};
+
+} // namespace bs_constraints
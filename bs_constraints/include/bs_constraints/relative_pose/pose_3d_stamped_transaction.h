@@ -10,6 +10,7 @@
 #include <fuse_variables/orientation_3d_stamped.h>
 #include <fuse_variables/position_3d_stamped.h>
 
+#include <bs_constraints/transaction_batch.h>
 #include <bs_variables/orientation_3d.h>
 #include <bs_variables/position_3d.h>
 
@@ -24,15 +25,32 @@ class Pose3DStampedTransaction {
 public:
   FUSE_SMART_PTR_DEFINITIONS(Pose3DStampedTransaction);
 
+  /**
+   * @brief constructor
+   * @param transaction_stamp
+   * @param override_constraints
+   * @param override_variables
+   * @param use_pooled_allocation allocate the pose constraints and variables
+   * from the pools of their types (see bs_common::MakePooled)
+   */
   Pose3DStampedTransaction(const ros::Time& transaction_stamp,
                            bool override_constraints = true,
-                           bool override_variables = true);
+                           bool override_variables = true,
+                           bool use_pooled_allocation = false);
 
   /**
    * @brief get the transaction. If empty, it will return a nullptr
    */
   fuse_core::Transaction::SharedPtr GetTransaction() const;
 
+  /**
+   * @brief stage the variables and constraints added from now on in a
+   * bs_constraints::TransactionBatch with this capacity, which is moved into
+   * the transaction by GetTransaction. Use this for transactions with many
+   * elements, which are otherwise checked for duplicates at each addition
+   */
+  void Reserve(size_t num_variables, size_t num_constraints);
+
   /**
    * @brief Add relative pose constraint. If frame_id is empty or equal to the
    * baselink frame, then the added constraint will be of type
@@ -102,10 +120,19 @@ public:
                          bool override_prior = true);
 
 protected:
+  void addVariable(fuse_core::Variable::SharedPtr variable, bool overwrite);
+
+  void addConstraint(fuse_core::Constraint::SharedPtr constraint,
+                     bool overwrite);
+
   fuse_core::Transaction::SharedPtr transaction_;
   fuse_loss::CauchyLoss::SharedPtr loss_function_;
   bool override_constraints_;
   bool override_variables_;
+  bool use_pooled_allocation_;
+  bool use_batch_{false};
+  // flushed into the transaction by GetTransaction
+  mutable TransactionBatch batch_;
 };
 
 } // namespace bs_constraints
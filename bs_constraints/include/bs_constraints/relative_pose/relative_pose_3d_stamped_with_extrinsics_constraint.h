@@ -20,6 +20,8 @@
 #include <bs_variables/orientation_3d.h>
 #include <bs_variables/position_3d.h>
 
+#include <bs_common/chunk_file.h>
+
 namespace bs_constraints {
 
 /**
@@ -116,6 +118,17 @@ public:
    */
   ceres::CostFunction* costFunction() const override;
 
+  /**
+   * @brief Write the constraint in the compact binary encoding, see
+   * bs_common::CompactSerializer
+   */
+  void serializeCompact(bs_common::ByteWriter& writer) const;
+
+  /**
+   * @brief Read a constraint written by serializeCompact
+   */
+  void deserializeCompact(bs_common::ByteReader& reader);
+
 protected:
   /** The measured difference between variable pose2 and variable pose1 in the
    * sensor frame. Note we invert the input difference here instead of inverting
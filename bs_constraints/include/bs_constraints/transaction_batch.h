@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <fuse_core/constraint.h>
+#include <fuse_core/transaction.h>
+#include <fuse_core/variable.h>
+#include <ros/time.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Builder for transactions with many elements, e.g. the initialization
+ * graph or a batch of loop closures.
+ *
+ * Each fuse_core::Transaction::addVariable/addConstraint searches all the
+ * elements already added for a duplicate, so building a transaction one
+ * element at a time, or merging many small transactions into one, is
+ * quadratic. This stages the elements in preallocated vectors without any
+ * checks, and resolves the duplicates with a hash map once, when the result is
+ * moved into a transaction. The duplicates are resolved as if the elements had
+ * been added to the transaction in order: the first one is kept, unless a
+ * later one is added with overwrite = true.
+ */
+class TransactionBatch {
+public:
+  TransactionBatch() = default;
+
+  /**
+   * @brief Reserves storage for the elements that will be added
+   */
+  void Reserve(size_t num_variables, size_t num_constraints,
+               size_t num_stamps = 0);
+
+  void AddVariable(fuse_core::Variable::SharedPtr variable,
+                   bool overwrite = false);
+
+  void AddConstraint(fuse_core::Constraint::SharedPtr constraint,
+                     bool overwrite = false);
+
+  void AddInvolvedStamp(const ros::Time& stamp);
+
+  /**
+   * @brief Adds the elements of another batch, which are shared and not
+   * copied
+   */
+  void Merge(const TransactionBatch& other);
+
+  /**
+   * @brief Adds the added variables, constraints and involved stamps of a
+   * transaction. The transaction only gives access to const references, so
+   * the elements are cloned. Removed elements are ignored
+   */
+  void Merge(const fuse_core::Transaction& transaction,
+             bool overwrite = false);
+
+  bool Empty() const;
+
+  /**
+   * @brief Number of staged variables, duplicates included
+   */
+  size_t NumVariables() const { return variables_.size(); }
+
+  /**
+   * @brief Number of staged constraints, duplicates included
+   */
+  size_t NumConstraints() const { return constraints_.size(); }
+
+  /**
+   * @brief Adds the deduplicated elements to the transaction and clears the
+   * batch. The storage is kept, so the batch can be reused
+   */
+  void MoveInto(fuse_core::Transaction& transaction);
+
+  /**
+   * @brief Moves the elements into a new transaction with this stamp
+   */
+  fuse_core::Transaction::SharedPtr ToTransaction(const ros::Time& stamp);
+
+  void Clear();
+
+private:
+  template <typename T>
+  struct Entry {
+    std::shared_ptr<T> element;
+    bool overwrite;
+  };
+
+  /**
+   * @brief Removes the duplicated entries in place, keeping the order of the
+   * first occurrence of each uuid
+   */
+  template <typename T>
+  static void Deduplicate(std::vector<Entry<T>>& entries);
+
+  std::vector<Entry<fuse_core::Variable>> variables_;
+  std::vector<Entry<fuse_core::Constraint>> constraints_;
+  std::vector<ros::Time> stamps_;
+};
+
+} // namespace bs_constraints
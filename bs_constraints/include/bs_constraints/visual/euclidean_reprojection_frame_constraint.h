@@ -0,0 +1,156 @@
+#pragma once
+
+#include <fuse_core/constraint.h>
+#include <fuse_core/eigen.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/loss.h>
+#include <fuse_core/serialization.h>
+#include <fuse_core/uuid.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <bs_variables/point_3d_landmark.h>
+#include <fuse_variables/position_3d_stamped.h>
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/export.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/vector.hpp>
+#include <ceres/cost_function.h>
+
+#include <bs_constraints/visual/euclidean_reprojection_frame_function.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <bs_common/chunk_file.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Reprojection constraint of all euclidean landmarks observed in one
+ * image. This is equivalent to one EuclideanReprojectionConstraint per
+ * observation, but all observations share a single residual block (see
+ * EuclideanReprojectionFrame).
+ *
+ * The robust loss of each observation is passed on construction and applied
+ * inside the cost function. The loss of the constraint itself (i.e.,
+ * Constraint::loss()) should be left unset, since it would be applied to the
+ * sum of all observations.
+ */
+class EuclideanReprojectionFrameConstraint : public fuse_core::Constraint {
+public:
+  FUSE_CONSTRAINT_DEFINITIONS(EuclideanReprojectionFrameConstraint);
+
+  /**
+   * @brief Default constructor
+   */
+  EuclideanReprojectionFrameConstraint() = default;
+
+  /**
+   * @brief Create a constraint using the camera pose, and the location and
+   * measured pixel of each landmark observed in the image
+   *
+   * @param landmarks landmarks observed in the image
+   * @param measurements rectified pixel of each landmark, in the same order
+   * @param observation_loss robust loss applied to each observation, may be
+   * null
+   * @throws std::invalid_argument if there are no landmarks, or a different
+   * number of landmarks and measurements
+   */
+  EuclideanReprojectionFrameConstraint(
+      const std::string& source,
+      const fuse_variables::Orientation3DStamped& R_WORLD_BASELINK,
+      const fuse_variables::Position3DStamped& t_WORLD_BASELINK,
+      const std::vector<bs_variables::Point3DLandmark::SharedPtr>& landmarks,
+      const EuclideanReprojectionFrame::Pixels& measurements,
+      const Eigen::Matrix4d& T_cam_baselink,
+      const Eigen::Matrix3d& intrinsic_matrix,
+      const double reprojection_information_weight,
+      const fuse_core::Loss::SharedPtr& observation_loss = nullptr);
+
+  /**
+   * @brief Destructor
+   */
+  virtual ~EuclideanReprojectionFrameConstraint() = default;
+
+  /**
+   * @brief Read-only access to the measured pixel values
+   *
+   */
+  const EuclideanReprojectionFrame::Pixels& pixels() const { return pixels_; }
+
+  /**
+   * @brief Read-only access to the loss applied to each observation
+   *
+   */
+  const fuse_core::Loss::SharedPtr& observationLoss() const {
+    return observation_loss_;
+  }
+
+  /**
+   * @brief Print a human-readable description of the constraint to the provided
+   * stream.
+   *
+   * @param[out] stream The stream to write to. Defaults to stdout.
+   */
+  void print(std::ostream& stream = std::cout) const override;
+
+  /**
+   * @brief Construct an instance of this constraint's cost function
+   *
+   * The function caller will own the new cost function instance. It is the
+   * responsibility of the caller to delete the cost function object when it is
+   * no longer needed. If the pointer is provided to a Ceres::Problem object,
+   * the Ceres::Problem object will takes ownership of the pointer and delete it
+   * during destruction.
+   *
+   * @return A base pointer to an instance of a derived CostFunction.
+   */
+  ceres::CostFunction* costFunction() const override;
+
+  /**
+   * @brief Write the constraint in the compact binary encoding, see
+   * bs_common::CompactSerializer
+   */
+  void serializeCompact(bs_common::ByteWriter& writer) const;
+
+  /**
+   * @brief Read a constraint written by serializeCompact
+   */
+  void deserializeCompact(bs_common::ByteReader& reader);
+
+protected:
+  EuclideanReprojectionFrame::Pixels pixels_;
+  Eigen::Matrix4d T_cam_baselink_;
+  Eigen::Matrix3d intrinsic_matrix_;
+  Eigen::Matrix2d sqrt_information_;
+  fuse_core::Loss::SharedPtr observation_loss_;
+
+private:
+  // Allow Boost Serialization access to private methods
+  friend class boost::serialization::access;
+
+  /**
+   * @brief The Boost Serialize method that serializes all of the data members
+   * in to/out of the archive
+   *
+   * @param[in/out] archive - The archive object that holds the serialized class
+   * members
+   * @param[in] version - The version of the archive being read/written.
+   * Generally unused.
+   */
+  template <class Archive>
+  void serialize(Archive& archive, const unsigned int /* version */) {
+    archive& boost::serialization::base_object<fuse_core::Constraint>(*this);
+    archive& pixels_;
+    archive& T_cam_baselink_;
+    archive& intrinsic_matrix_;
+    archive& sqrt_information_;
+    archive& observation_loss_;
+  }
+};
+
+} // namespace bs_constraints
+
+BOOST_CLASS_EXPORT_KEY(bs_constraints::EuclideanReprojectionFrameConstraint);
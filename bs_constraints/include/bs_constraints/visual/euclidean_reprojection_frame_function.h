@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ceres/cost_function.h>
+#include <ceres/loss_function.h>
+
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/util.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Reprojection cost of all euclidean landmarks observed in one
+ * rectified (pinhole) image, with analytic jacobians. Each observation is
+ * equivalent to an EuclideanReprojection, but they share one residual block so
+ * the pose is evaluated once per image and Ceres only tracks one block.
+ *
+ * Since all observations share a residual block, a robust loss on the block
+ * would act on the sum of all reprojection errors. The loss is instead applied
+ * to each observation inside the cost function: the 2d residual r of each
+ * observation is rescaled to sqrt(rho(|r|^2)) * r / |r|, so the cost of the
+ * block is exactly the sum of the robustified costs of its observations, and
+ * the jacobians are differentiated through the rescaling.
+ *
+ * Note that Ceres stores the jacobian of each parameter block densely over all
+ * residuals of the block, so the landmark jacobians grow with the square of
+ * the number of observations.
+ */
+class EuclideanReprojectionFrame : public ceres::CostFunction {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  using Pixels =
+      std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>;
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] information_matrix Residual weighting matrix of each
+   * observation
+   * @param[in] pixel_measurements Pixel measurement of each landmark
+   * @param[in] intrinsic_matrix Camera intrinsic matrix (K):
+   * [fx, 0, cx]
+   * [0, fy, cy]
+   * [0,  0,  1]
+   * @param[in] T_cam_baselink Camera extrinsic
+   * @param[in] loss_function robust loss applied to each observation, or null
+   * for a trivial loss. The cost function takes ownership.
+   */
+  EuclideanReprojectionFrame(const Eigen::Matrix2d& information_matrix,
+                             const Pixels& pixel_measurements,
+                             const Eigen::Matrix3d& intrinsic_matrix,
+                             const Eigen::Matrix4d& T_cam_baselink,
+                             ceres::LossFunction* loss_function = nullptr)
+      : information_matrix_(information_matrix),
+        pixel_measurements_(pixel_measurements),
+        intrinsic_matrix_(intrinsic_matrix),
+        R_CAM_BASELINK_(T_cam_baselink.block<3, 3>(0, 0)),
+        t_CAM_BASELINK_(T_cam_baselink.block<3, 1>(0, 3)),
+        loss_function_(loss_function) {
+    set_num_residuals(2 * pixel_measurements_.size());
+    mutable_parameter_block_sizes()->push_back(4);
+    mutable_parameter_block_sizes()->push_back(3);
+    for (size_t i = 0; i < pixel_measurements_.size(); i++) {
+      mutable_parameter_block_sizes()->push_back(3);
+    }
+  }
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : R_WORLD_BASELINK (4d quaternion of robot)
+   *                         1 : t_WORLD_BASELINK (3d position of robot)
+   *                         2 + i : P_WORLD of landmark i
+   * @param[out] residual - The computed residual (error), two per landmark
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Quaterniond q_WORLD_BASELINK(
+        parameters[0][0], parameters[0][1], parameters[0][2], parameters[0][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_WORLD_BASELINK(parameters[1]);
+    const Eigen::Matrix3d R_BASELINK_WORLD =
+        q_WORLD_BASELINK.toRotationMatrix().transpose();
+    const Eigen::Matrix3d R_CAM_WORLD = R_CAM_BASELINK_ * R_BASELINK_WORLD;
+
+    const int num_observations = pixel_measurements_.size();
+    for (int i = 0; i < num_observations; i++) {
+      const Eigen::Map<const Eigen::Vector3d> P_WORLD(parameters[2 + i]);
+      const Eigen::Vector3d P_WORLD_rel = P_WORLD - t_WORLD_BASELINK;
+      const Eigen::Vector3d P_CAMERA =
+          R_CAM_WORLD * P_WORLD_rel + t_CAM_BASELINK_;
+      const Eigen::Vector2d reprojection =
+          (intrinsic_matrix_ * P_CAMERA).hnormalized();
+      Eigen::Map<Eigen::Vector2d> E(residual + 2 * i);
+      E = information_matrix_ * (pixel_measurements_[i] - reprojection);
+
+      if (!jacobians) {
+        Robustify(E, nullptr);
+        continue;
+      }
+
+      const Eigen::Matrix<double, 2, 3> d_E_d_P_BASELINK =
+          -information_matrix_ *
+          DImageProjectionDPoint(intrinsic_matrix_, P_CAMERA) *
+          R_CAM_BASELINK_;
+      const Eigen::Matrix<double, 2, 3> d_E_d_P_WORLD =
+          d_E_d_P_BASELINK * R_BASELINK_WORLD;
+
+      // jacobian of this observation wrt [q, t, P_WORLD]
+      Eigen::Matrix<double, 2, 10> J;
+      J.block<2, 4>(0, 0) =
+          d_E_d_P_BASELINK *
+          DInverseQuaternionRotationDQuaternion(q_WORLD_BASELINK, P_WORLD_rel);
+      J.block<2, 3>(0, 4) = -d_E_d_P_WORLD;
+      J.block<2, 3>(0, 7) = d_E_d_P_WORLD;
+      Robustify(E, &J);
+
+      if (jacobians[0]) {
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, 4, Eigen::RowMajor>>
+            d_E_d_q_WORLD_BASELINK(jacobians[0], num_residuals(), 4);
+        d_E_d_q_WORLD_BASELINK.block<2, 4>(2 * i, 0) = J.block<2, 4>(0, 0);
+      }
+      if (jacobians[1]) {
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor>>
+            d_E_d_t_WORLD_BASELINK(jacobians[1], num_residuals(), 3);
+        d_E_d_t_WORLD_BASELINK.block<2, 3>(2 * i, 0) = J.block<2, 3>(0, 4);
+      }
+      if (jacobians[2 + i]) {
+        // each landmark only affects its own residuals
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor>>
+            d_E_d_P_WORLD_map(jacobians[2 + i], num_residuals(), 3);
+        d_E_d_P_WORLD_map.setZero();
+        d_E_d_P_WORLD_map.block<2, 3>(2 * i, 0) = J.block<2, 3>(0, 7);
+      }
+    }
+    return true;
+  }
+
+private:
+  /**
+   * @brief Apply the loss to the residual of one observation, rescaling it to
+   * r' = sqrt(rho(s) / s) * r where s = |r|^2, and update its jacobian to
+   * J' = dr'/dx. Does nothing if there is no loss function.
+   */
+  void Robustify(Eigen::Map<Eigen::Vector2d>& E,
+                 Eigen::Matrix<double, 2, 10>* J) const {
+    if (!loss_function_) { return; }
+    const double s = E.squaredNorm();
+    double rho[3];
+    loss_function_->Evaluate(s, rho);
+
+    // r' = g(s) * r, with g(s) = sqrt(rho(s) / s). At s = 0, use the limit of
+    // g and its derivative from the taylor expansion of rho
+    double g, d_g_d_s;
+    if (s < 1e-12) {
+      g = std::sqrt(rho[1]);
+      d_g_d_s = rho[2] / (4.0 * g);
+    } else {
+      g = std::sqrt(rho[0] / s);
+      d_g_d_s = (rho[1] * s - rho[0]) / (2.0 * s * s * g);
+    }
+    if (J) {
+      *J = g * *J + (2.0 * d_g_d_s) * E * (E.transpose() * *J);
+    }
+    E *= g;
+  }
+
+  Eigen::Matrix2d information_matrix_; //!< The residual weighting matrix
+  Pixels pixel_measurements_;          //!< The measured pixel values
+  Eigen::Matrix3d intrinsic_matrix_;
+  Eigen::Matrix3d R_CAM_BASELINK_;
+  Eigen::Vector3d t_CAM_BASELINK_;
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+};
+
+} // namespace bs_constraints
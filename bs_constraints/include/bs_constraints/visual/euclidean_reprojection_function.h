@@ -10,21 +10,13 @@
 
 #include <ceres/rotation.h>
 
-constexpr double EPSILON = 1e-8;
-
-auto point_transformation = [](const auto& q_coeffs, const auto& t,
-                               const auto& P) {
-  // get R from q_coeffs
-  Eigen::Quaterniond q(q_coeffs[0], q_coeffs[1], q_coeffs[2], q_coeffs[3]);
-  Eigen::Matrix3d R = q.normalized().toRotationMatrix();
-  Eigen::Matrix3d Ri = R.transpose();
-  // invert R
-  Eigen::Vector3d P_transformed = (Ri * P) - (Ri * t);
-  return P_transformed;
-};
-
 namespace bs_constraints {
 
+/**
+ * @brief Reprojection cost of a euclidean landmark in a rectified (pinhole)
+ * image, with analytic jacobians. This is equivalent to the autodiff
+ * EuclideanReprojectionFunctor, but much cheaper to evaluate.
+ */
 class EuclideanReprojection : public ceres::SizedCostFunction<2, 4, 3, 3> {
 public:
   FUSE_MAKE_ALIGNED_OPERATOR_NEW();
@@ -65,108 +57,58 @@ public:
    */
   bool Evaluate(double const* const* parameters, double* residual,
                 double** jacobians) const override {
-    Eigen::Quaterniond q_WORLD_BASELINK(parameters[0][0], parameters[0][1],
-                                        parameters[0][2], parameters[0][3]);
-    Eigen::Matrix3d R_WORLD_BASELINK = q_WORLD_BASELINK.toRotationMatrix();
-    Eigen::Vector3d t_WORLD_BASELINK(parameters[1][0], parameters[1][1],
-                                     parameters[1][2]);
-    Eigen::Vector3d P_WORLD(parameters[2][0], parameters[2][1],
-                            parameters[2][2]);
-
-    Eigen::Matrix3d R_CAM_BASELINK = T_cam_baselink_.block<3, 3>(0, 0);
-    Eigen::Vector3d t_CAM_BASELINK = T_cam_baselink_.block<3, 1>(0, 3);
-    Eigen::Matrix3d R_BASELINK_WORLD = R_WORLD_BASELINK.transpose();
+    const Eigen::Quaterniond q_WORLD_BASELINK(
+        parameters[0][0], parameters[0][1], parameters[0][2], parameters[0][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_WORLD_BASELINK(parameters[1]);
+    const Eigen::Map<const Eigen::Vector3d> P_WORLD(parameters[2]);
+
+    const Eigen::Matrix3d R_BASELINK_WORLD =
+        q_WORLD_BASELINK.toRotationMatrix().transpose();
+    const Eigen::Matrix3d R_CAM_BASELINK = T_cam_baselink_.block<3, 3>(0, 0);
+    const Eigen::Vector3d t_CAM_BASELINK = T_cam_baselink_.block<3, 1>(0, 3);
 
     // 1. transform point into baselink frame
-    Eigen::Vector3d P_BASELINK =
-        (R_BASELINK_WORLD * P_WORLD) - (R_BASELINK_WORLD * t_WORLD_BASELINK);
+    const Eigen::Vector3d P_WORLD_rel = P_WORLD - t_WORLD_BASELINK;
+    const Eigen::Vector3d P_BASELINK = R_BASELINK_WORLD * P_WORLD_rel;
 
     // 2. transform point into camera frame
-    auto P_CAMERA = R_CAM_BASELINK * P_BASELINK + t_CAM_BASELINK;
+    const Eigen::Vector3d P_CAMERA =
+        R_CAM_BASELINK * P_BASELINK + t_CAM_BASELINK;
 
     // 3. project into image space
-    Eigen::Vector2d reprojection = (intrinsic_matrix_ * P_CAMERA).hnormalized();
+    const Eigen::Vector2d reprojection =
+        (intrinsic_matrix_ * P_CAMERA).hnormalized();
 
     // compute weighted reprojection error
-    Eigen::Vector2d E =
-        information_matrix_ * (pixel_measurement_ - reprojection);
-    residual[0] = E[0];
-    residual[1] = E[1];
-
-    // compute jacobians
-    if (jacobians) {
-      const auto d_E_d_P_CAMERA =
-          DImageProjectionDPoint(intrinsic_matrix_, P_CAMERA);
-
-      const auto d_P_CAMERA_d_P_BASELINK =
-          DPointRotationDPoint(R_CAM_BASELINK, P_BASELINK);
-      if (jacobians[0]) {
-        // compute d(E)/d(R_WORLD_BASELINK) = d(E)/d(P_CAMERA) *
-        // d(P_CAMERA)/d(P_BASELINK) *
-        // d(P_BASELINK)/d(R_WORLD_BASELINK)
-
-        // // ! code that should theoretically work but doesn't:
-        // const auto d_P_BASELINK_D_R_WORLD_BASELINK =
-        //     DPointRotationDRotation(R_BASELINK_WORLD, P_WORLD) *
-        //         DInverseRotationDRotation(R_WORLD_BASELINK) -
-        //     DPointRotationDRotation(R_BASELINK_WORLD, t_WORLD_BASELINK) *
-        //         DInverseRotationDRotation(R_WORLD_BASELINK);
-        // const auto d_E_d_R_WORLD_BASELINK = d_E_d_P_CAMERA *
-        //                                     d_P_CAMERA_d_P_BASELINK *
-        //                                     d_P_BASELINK_D_R_WORLD_BASELINK;
-        // // lift to jacobian representation
-        // Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
-        //     d_E_d_q_WORLD_BASELINK(jacobians[0]);
-        // d_E_d_q_WORLD_BASELINK =
-        //     d_E_d_R_WORLD_BASELINK * MinusJacobian(q_WORLD_BASELINK);
-        // d_E_d_q_WORLD_BASELINK = -d_E_d_q_WORLD_BASELINK;
-
-        // ! workaround for getting jacobian wrt quaternion:
-        Eigen::Vector4d q_coeffs(q_WORLD_BASELINK.w(), q_WORLD_BASELINK.x(),
-                                 q_WORLD_BASELINK.y(), q_WORLD_BASELINK.z());
-        Eigen::Matrix<double, 3, 4> d_P_BASELINK_D_q_WORLD_BASELINK;
-        const auto res =
-            point_transformation(q_coeffs, t_WORLD_BASELINK, P_WORLD);
-        for (int i = 0; i < 4; i++) {
-          Eigen::Vector4d pert = Eigen::Vector4d::Zero();
-          pert[i] = EPSILON;
-          const auto res_pert =
-              point_transformation(q_coeffs + pert, t_WORLD_BASELINK, P_WORLD);
-          const auto finite_diff = (res_pert - res) / EPSILON;
-          d_P_BASELINK_D_q_WORLD_BASELINK.col(i) = finite_diff.transpose();
-        }
-
-        Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
-            d_E_d_q_WORLD_BASELINK(jacobians[0]);
-        d_E_d_q_WORLD_BASELINK = d_E_d_P_CAMERA * d_P_CAMERA_d_P_BASELINK *
-                                 d_P_BASELINK_D_q_WORLD_BASELINK;
-        d_E_d_q_WORLD_BASELINK.applyOnTheLeft(-information_matrix_);
-      }
-
-      if (jacobians[1]) {
-        // compute d(E)/d(R_WORLD_BASELINK) = d(E)/d(P_CAMERA) *
-        // d(P_CAMERA)/d(P_BASELINK) *
-        // d(P_BASELINK)/d(t_WORLD_BASELINK)
-        const auto d_P_BASELINK_d_t_WORLD_BASELINK =
-            -DPointRotationDPoint(R_BASELINK_WORLD, t_WORLD_BASELINK);
-        Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
-            d_E_d_t_WORLD_BASELINK(jacobians[1]);
-        d_E_d_t_WORLD_BASELINK = d_E_d_P_CAMERA * d_P_CAMERA_d_P_BASELINK *
-                                 d_P_BASELINK_d_t_WORLD_BASELINK;
-        d_E_d_t_WORLD_BASELINK.applyOnTheLeft(-information_matrix_);
-      }
-
-      if (jacobians[2]) {
-        Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>> d_E_D_P_WORLD(
-            jacobians[2]);
-        // compute d(E)/d(P_WORLD) = d(E)/d(P_CAMERA) *
-        // d(P_CAMERA)/d(P_BASELINK) * d(P_BASELINK)/d(P_WORLD)
-        auto d_P_BASELINK_d_P_WORLD =
-            DPointRotationDPoint(R_BASELINK_WORLD, P_WORLD);
-        d_E_D_P_WORLD =
-            d_E_d_P_CAMERA * d_P_CAMERA_d_P_BASELINK * d_P_BASELINK_d_P_WORLD;
-        d_E_D_P_WORLD.applyOnTheLeft(-information_matrix_);
-      }
+    Eigen::Map<Eigen::Vector2d> E(residual);
+    E = information_matrix_ * (pixel_measurement_ - reprojection);
+
+    if (!jacobians) { return true; }
+
+    // d(E)/d(P_BASELINK), shared by all parameter blocks
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_BASELINK =
+        -information_matrix_ *
+        DImageProjectionDPoint(intrinsic_matrix_, P_CAMERA) * R_CAM_BASELINK;
+
+    if (jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
+          d_E_d_q_WORLD_BASELINK(jacobians[0]);
+      d_E_d_q_WORLD_BASELINK =
+          d_E_d_P_BASELINK *
+          DInverseQuaternionRotationDQuaternion(q_WORLD_BASELINK, P_WORLD_rel);
+    }
+
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_WORLD =
+        d_E_d_P_BASELINK * R_BASELINK_WORLD;
+    if (jacobians[1]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_t_WORLD_BASELINK(jacobians[1]);
+      d_E_d_t_WORLD_BASELINK = -d_E_d_P_WORLD;
+    }
+    if (jacobians[2]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_P_WORLD_map(jacobians[2]);
+      d_E_d_P_WORLD_map = d_E_d_P_WORLD;
     }
     return true;
   }
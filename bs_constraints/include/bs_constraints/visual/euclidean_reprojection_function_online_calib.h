@@ -0,0 +1,129 @@
+#pragma once
+
+#include <ceres/sized_cost_function.h>
+
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/util.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Reprojection cost of a euclidean landmark in a rectified (pinhole)
+ * image with the camera extrinsic as a variable, with analytic jacobians. This
+ * is equivalent to the autodiff EuclideanReprojectionFunctorOnlineCalib.
+ */
+class EuclideanReprojectionOnlineCalib
+    : public ceres::SizedCostFunction<2, 4, 3, 3, 4, 3> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] information_matrix Residual weighting matrix
+   * @param[in] pixel_measurement Pixel measurement
+   * @param[in] intrinsic_matrix Camera intrinsic matrix (K):
+   * [fx, 0, cx]
+   * [0, fy, cy]
+   * [0,  0,  1]
+   */
+  EuclideanReprojectionOnlineCalib(const Eigen::Matrix2d& information_matrix,
+                                   const Eigen::Vector2d& pixel_measurement,
+                                   const Eigen::Matrix3d& intrinsic_matrix)
+      : information_matrix_(information_matrix),
+        pixel_measurement_(pixel_measurement),
+        intrinsic_matrix_(intrinsic_matrix) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : R_WORLD_BASELINK (4d quaternion of robot)
+   *                         1 : t_WORLD_BASELINK (3d position of robot)
+   *                         2 : P_WORLD (3d position of landmark)
+   *                         3 : R_BASELINK_CAM (4d quaternion of extrinsic)
+   *                         4 : t_BASELINK_CAM (3d position of extrinsic)
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Quaterniond q_WORLD_BASELINK(
+        parameters[0][0], parameters[0][1], parameters[0][2], parameters[0][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_WORLD_BASELINK(parameters[1]);
+    const Eigen::Map<const Eigen::Vector3d> P_WORLD(parameters[2]);
+    const Eigen::Quaterniond q_BASELINK_CAM(
+        parameters[3][0], parameters[3][1], parameters[3][2], parameters[3][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_BASELINK_CAM(parameters[4]);
+
+    const Eigen::Matrix3d R_BASELINK_WORLD =
+        q_WORLD_BASELINK.toRotationMatrix().transpose();
+    const Eigen::Matrix3d R_CAM_BASELINK =
+        q_BASELINK_CAM.toRotationMatrix().transpose();
+
+    // transform point into baselink, then camera frame
+    const Eigen::Vector3d P_WORLD_rel = P_WORLD - t_WORLD_BASELINK;
+    const Eigen::Vector3d P_BASELINK_rel =
+        R_BASELINK_WORLD * P_WORLD_rel - t_BASELINK_CAM;
+    const Eigen::Vector3d P_CAMERA = R_CAM_BASELINK * P_BASELINK_rel;
+
+    // project into image space and compute weighted reprojection error
+    const Eigen::Vector2d reprojection =
+        (intrinsic_matrix_ * P_CAMERA).hnormalized();
+    Eigen::Map<Eigen::Vector2d> E(residual);
+    E = information_matrix_ * (pixel_measurement_ - reprojection);
+
+    if (!jacobians) { return true; }
+
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_CAMERA =
+        -information_matrix_ *
+        DImageProjectionDPoint(intrinsic_matrix_, P_CAMERA);
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_BASELINK =
+        d_E_d_P_CAMERA * R_CAM_BASELINK;
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_WORLD =
+        d_E_d_P_BASELINK * R_BASELINK_WORLD;
+
+    if (jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
+          d_E_d_q_WORLD_BASELINK(jacobians[0]);
+      d_E_d_q_WORLD_BASELINK =
+          d_E_d_P_BASELINK *
+          DInverseQuaternionRotationDQuaternion(q_WORLD_BASELINK, P_WORLD_rel);
+    }
+    if (jacobians[1]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_t_WORLD_BASELINK(jacobians[1]);
+      d_E_d_t_WORLD_BASELINK = -d_E_d_P_WORLD;
+    }
+    if (jacobians[2]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_P_WORLD_map(jacobians[2]);
+      d_E_d_P_WORLD_map = d_E_d_P_WORLD;
+    }
+    if (jacobians[3]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
+          d_E_d_q_BASELINK_CAM(jacobians[3]);
+      d_E_d_q_BASELINK_CAM =
+          d_E_d_P_CAMERA *
+          DInverseQuaternionRotationDQuaternion(q_BASELINK_CAM, P_BASELINK_rel);
+    }
+    if (jacobians[4]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_t_BASELINK_CAM(jacobians[4]);
+      d_E_d_t_BASELINK_CAM = -d_E_d_P_BASELINK;
+    }
+    return true;
+  }
+
+private:
+  Eigen::Matrix2d information_matrix_; //!< The residual weighting matrix
+  Eigen::Vector2d pixel_measurement_;  //!< The measured pixel value
+  Eigen::Matrix3d intrinsic_matrix_;
+};
+
+} // namespace bs_constraints
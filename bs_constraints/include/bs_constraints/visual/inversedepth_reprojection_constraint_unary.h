@@ -19,6 +19,8 @@
 #include <string>
 #include <vector>
 
+#include <bs_common/chunk_file.h>
+
 namespace bs_constraints {
 
 class InverseDepthReprojectionConstraintUnary : public fuse_core::Constraint {
@@ -77,6 +79,17 @@ public:
    */
   ceres::CostFunction* costFunction() const override;
 
+  /**
+   * @brief Write the constraint in the compact binary encoding, see
+   * bs_common::CompactSerializer
+   */
+  void serializeCompact(bs_common::ByteWriter& writer) const;
+
+  /**
+   * @brief Read a constraint written by serializeCompact
+   */
+  void deserializeCompact(bs_common::ByteReader& reader);
+
 protected:
   Eigen::Vector2d pixel_;
   Eigen::Vector3d bearing_;
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <ceres/sized_cost_function.h>
+
+#include <beam_utils/math.h>
+#include <bs_constraints/jacobians.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/util.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Reprojection cost of an inverse depth landmark, anchored in one pose
+ * and measured in another, in a rectified (pinhole) image with analytic
+ * jacobians. This is equivalent to the autodiff
+ * InverseDepthReprojectionFunctor.
+ *
+ * The landmark is kept in homogeneous coordinates (bearing, inverse depth)
+ * through every transform, so the inverse depth never has to be inverted:
+ * transforming (x, w) by [R|t] gives (R * x + w * t, w), and the projection
+ * is invariant to the scale of the point.
+ */
+class InverseDepthReprojection
+    : public ceres::SizedCostFunction<2, 4, 3, 4, 3, 1> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] information_matrix Residual weighting matrix
+   * @param[in] pixel_measurement Pixel measurement
+   * @param[in] intrinsic_matrix Camera intrinsic matrix (K):
+   * [fx, 0, cx]
+   * [0, fy, cy]
+   * [0,  0,  1]
+   * @param[in] T_cam_baselink Camera extrinsic
+   * @param[in] bearing Bearing vector of the inverse depth landmark
+   */
+  InverseDepthReprojection(const Eigen::Matrix2d& information_matrix,
+                           const Eigen::Vector2d& pixel_measurement,
+                           const Eigen::Matrix3d& intrinsic_matrix,
+                           const Eigen::Matrix4d& T_cam_baselink,
+                           const Eigen::Vector3d& bearing)
+      : information_matrix_(information_matrix),
+        pixel_measurement_(pixel_measurement),
+        intrinsic_matrix_(intrinsic_matrix),
+        R_CAM_BASELINK_(T_cam_baselink.block<3, 3>(0, 0)),
+        t_CAM_BASELINK_(T_cam_baselink.block<3, 1>(0, 3)) {
+    const Eigen::Matrix4d T_BASELINK_CAM =
+        beam::InvertTransform(T_cam_baselink);
+    bearing_BASELINK_ = T_BASELINK_CAM.block<3, 3>(0, 0) * bearing;
+    t_BASELINK_CAM_ = T_BASELINK_CAM.block<3, 1>(0, 3);
+  }
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : R_WORLD_BASELINKa (anchor orientation)
+   *                         1 : t_WORLD_BASELINKa (anchor position)
+   *                         2 : R_WORLD_BASELINKm (measurement orientation)
+   *                         3 : t_WORLD_BASELINKm (measurement position)
+   *                         4 : inverse depth of the landmark
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    const Eigen::Quaterniond q_WORLD_BASELINKa(
+        parameters[0][0], parameters[0][1], parameters[0][2], parameters[0][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_WORLD_BASELINKa(parameters[1]);
+    const Eigen::Quaterniond q_WORLD_BASELINKm(
+        parameters[2][0], parameters[2][1], parameters[2][2], parameters[2][3]);
+    const Eigen::Map<const Eigen::Vector3d> t_WORLD_BASELINKm(parameters[3]);
+    const double inverse_depth = parameters[4][0];
+
+    const Eigen::Matrix3d R_WORLD_BASELINKa =
+        q_WORLD_BASELINKa.toRotationMatrix();
+    const Eigen::Matrix3d R_BASELINKm_WORLD =
+        q_WORLD_BASELINKm.toRotationMatrix().transpose();
+
+    // homogeneous point in: anchor baselink, world, measurement baselink and
+    // measurement camera frames. All have the inverse depth as weight
+    const Eigen::Vector3d P_BASELINKa =
+        bearing_BASELINK_ + inverse_depth * t_BASELINK_CAM_;
+    const Eigen::Vector3d P_WORLD_rel =
+        R_WORLD_BASELINKa * P_BASELINKa +
+        inverse_depth * (t_WORLD_BASELINKa - t_WORLD_BASELINKm);
+    const Eigen::Vector3d P_BASELINKm = R_BASELINKm_WORLD * P_WORLD_rel;
+    const Eigen::Vector3d P_CAMERAm =
+        R_CAM_BASELINK_ * P_BASELINKm + inverse_depth * t_CAM_BASELINK_;
+
+    // project into image space and compute weighted reprojection error
+    const Eigen::Vector2d reprojection =
+        (intrinsic_matrix_ * P_CAMERAm).hnormalized();
+    Eigen::Map<Eigen::Vector2d> E(residual);
+    E = information_matrix_ * (pixel_measurement_ - reprojection);
+
+    if (!jacobians) { return true; }
+
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_CAMERAm =
+        -information_matrix_ *
+        DImageProjectionDPoint(intrinsic_matrix_, P_CAMERAm);
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_BASELINKm =
+        d_E_d_P_CAMERAm * R_CAM_BASELINK_;
+    const Eigen::Matrix<double, 2, 3> d_E_d_P_WORLD =
+        d_E_d_P_BASELINKm * R_BASELINKm_WORLD;
+
+    if (jacobians[0]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
+          d_E_d_q_WORLD_BASELINKa(jacobians[0]);
+      d_E_d_q_WORLD_BASELINKa =
+          d_E_d_P_WORLD *
+          DQuaternionRotationDQuaternion(q_WORLD_BASELINKa, P_BASELINKa);
+    }
+    if (jacobians[1]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_t_WORLD_BASELINKa(jacobians[1]);
+      d_E_d_t_WORLD_BASELINKa = inverse_depth * d_E_d_P_WORLD;
+    }
+    if (jacobians[2]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>
+          d_E_d_q_WORLD_BASELINKm(jacobians[2]);
+      d_E_d_q_WORLD_BASELINKm =
+          d_E_d_P_BASELINKm * DInverseQuaternionRotationDQuaternion(
+                                  q_WORLD_BASELINKm, P_WORLD_rel);
+    }
+    if (jacobians[3]) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>>
+          d_E_d_t_WORLD_BASELINKm(jacobians[3]);
+      d_E_d_t_WORLD_BASELINKm = -inverse_depth * d_E_d_P_WORLD;
+    }
+    if (jacobians[4]) {
+      const Eigen::Vector3d d_P_WORLD_d_inverse_depth =
+          R_WORLD_BASELINKa * t_BASELINK_CAM_ + t_WORLD_BASELINKa -
+          t_WORLD_BASELINKm;
+      Eigen::Map<Eigen::Vector2d>
+          d_E_d_inverse_depth(jacobians[4]);
+      d_E_d_inverse_depth =
+          d_E_d_P_WORLD * d_P_WORLD_d_inverse_depth +
+          d_E_d_P_CAMERAm * t_CAM_BASELINK_;
+    }
+    return true;
+  }
+
+private:
+  Eigen::Matrix2d information_matrix_; //!< The residual weighting matrix
+  Eigen::Vector2d pixel_measurement_;  //!< The measured pixel value
+  Eigen::Matrix3d intrinsic_matrix_;
+  Eigen::Matrix3d R_CAM_BASELINK_;
+  Eigen::Vector3d t_CAM_BASELINK_;
+  Eigen::Vector3d t_BASELINK_CAM_;
+  Eigen::Vector3d bearing_BASELINK_; //!< bearing rotated into baselink frame
+};
+
+} // namespace bs_constraints
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+
+#include <Eigen/Dense>
+#include <ceres/sized_cost_function.h>
+
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/util.h>
+
+namespace bs_constraints {
+
+/**
+ * @brief Reprojection cost of an inverse depth landmark in its own anchor
+ * image, with analytic jacobians. This is equivalent to the autodiff
+ * InverseDepthReprojectionFunctorUnary.
+ *
+ * Since the landmark is parameterized by its bearing in the anchor frame, the
+ * reprojection in the anchor image only depends on the (fixed) bearing. The
+ * residual is therefore constant and all jacobians are zero, so it is computed
+ * once on construction.
+ */
+class InverseDepthReprojectionUnary
+    : public ceres::SizedCostFunction<2, 4, 3, 1> {
+public:
+  FUSE_MAKE_ALIGNED_OPERATOR_NEW();
+
+  /**
+   * @brief Construct a cost function instance
+   *
+   * @param[in] information_matrix Residual weighting matrix
+   * @param[in] pixel_measurement Pixel measurement
+   * @param[in] intrinsic_matrix Camera intrinsic matrix (K):
+   * [fx, 0, cx]
+   * [0, fy, cy]
+   * [0,  0,  1]
+   * @param[in] bearing Bearing vector of the inverse depth landmark
+   */
+  InverseDepthReprojectionUnary(const Eigen::Matrix2d& information_matrix,
+                                const Eigen::Vector2d& pixel_measurement,
+                                const Eigen::Matrix3d& intrinsic_matrix,
+                                const Eigen::Vector3d& bearing)
+      : residual_(information_matrix *
+                  (pixel_measurement -
+                   (intrinsic_matrix * bearing).hnormalized())) {}
+
+  /**
+   * @brief Evaluate the cost function. Used by the Ceres optimization engine.
+   *
+   * @param[in] parameters - Parameter blocks:
+   *                         0 : R_WORLD_BASELINKa (anchor orientation)
+   *                         1 : t_WORLD_BASELINKa (anchor position)
+   *                         2 : inverse depth of the landmark
+   * @param[out] residual - The computed residual (error)
+   * @param[out] jacobians - Jacobians of the residuals wrt the parameters. Only
+   * computed if not NULL, and only computed for the parameters where
+   * jacobians[i] is not NULL.
+   * @return The return value indicates whether the computation of the residuals
+   * and/or jacobians was successful or not.
+   */
+  bool Evaluate(double const* const* parameters, double* residual,
+                double** jacobians) const override {
+    residual[0] = residual_[0];
+    residual[1] = residual_[1];
+    if (!jacobians) { return true; }
+    if (jacobians[0]) { std::fill(jacobians[0], jacobians[0] + 8, 0.0); }
+    if (jacobians[1]) { std::fill(jacobians[1], jacobians[1] + 6, 0.0); }
+    if (jacobians[2]) { std::fill(jacobians[2], jacobians[2] + 2, 0.0); }
+    return true;
+  }
+
+private:
+  Eigen::Vector2d residual_;
+};
+
+} // namespace bs_constraints
@@ -1,11 +1,10 @@
 #include <bs_constraints/global/absolute_pose_3d_constraint.h>
 
-#include <fuse_constraints/normal_prior_pose_3d_cost_functor.h>
+#include <bs_constraints/global/normal_prior_pose_3d_function.h>
 #include <pluginlib/class_list_macros.h>
 
 #include <Eigen/Dense>
 #include <boost/serialization/export.hpp>
-#include <ceres/autodiff_cost_function.h>
 
 namespace bs_constraints {
 
@@ -43,10 +42,7 @@ bs_variables::Orientation3D AbsolutePose3DConstraint::getInitialOrientation() {
 }
 
 ceres::CostFunction* AbsolutePose3DConstraint::costFunction() const {
-  return new ceres::AutoDiffCostFunction<
-      fuse_constraints::NormalPriorPose3DCostFunctor, 6, 3, 4>(
-      new fuse_constraints::NormalPriorPose3DCostFunctor(sqrt_information_,
-                                                         mean_));
+  return new NormalPriorPose3D(sqrt_information_, mean_);
 }
 
 } // namespace bs_constraints
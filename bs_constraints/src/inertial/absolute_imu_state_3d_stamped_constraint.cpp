@@ -1,13 +1,14 @@
 #include <bs_constraints/inertial/absolute_imu_state_3d_stamped_constraint.h>
-#include <bs_constraints/inertial/normal_prior_imu_state_3d_cost_functor.h>
+#include <bs_constraints/inertial/normal_prior_imu_state_3d_function.h>
 
 #include <string>
 
 #include <Eigen/Dense>
 #include <boost/serialization/export.hpp>
-#include <ceres/autodiff_cost_function.h>
 #include <pluginlib/class_list_macros.h>
 
+#include <bs_common/compact_serialization.h>
+
 namespace bs_constraints {
 
 AbsoluteImuState3DStampedConstraint::AbsoluteImuState3DStampedConstraint(
@@ -41,9 +42,21 @@ void AbsoluteImuState3DStampedConstraint::print(std::ostream& stream) const {
 }
 
 ceres::CostFunction* AbsoluteImuState3DStampedConstraint::costFunction() const {
-  return new ceres::AutoDiffCostFunction<NormalPriorImuState3DCostFunctor, 15,
-                                         4, 3, 3, 3, 3>(
-      new NormalPriorImuState3DCostFunctor(sqrt_information_, mean_));
+  return new NormalPriorImuState3D(sqrt_information_, mean_);
+}
+
+void AbsoluteImuState3DStampedConstraint::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.WriteMatrix(mean_);
+  writer.WriteMatrix(sqrt_information_);
+}
+
+void AbsoluteImuState3DStampedConstraint::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  reader.ReadMatrix(mean_);
+  reader.ReadMatrix(sqrt_information_);
 }
 
 } // namespace bs_constraints
@@ -52,3 +65,5 @@ BOOST_CLASS_EXPORT_IMPLEMENT(
     bs_constraints::AbsoluteImuState3DStampedConstraint);
 PLUGINLIB_EXPORT_CLASS(bs_constraints::AbsoluteImuState3DStampedConstraint,
                        fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::AbsoluteImuState3DStampedConstraint);
@@ -3,23 +3,51 @@
 #include <bs_constraints/inertial/absolute_imu_state_3d_stamped_constraint.h>
 #include <bs_constraints/inertial/relative_imu_state_3d_stamped_constraint.h>
 
+#include <bs_common/pool_allocator.h>
+
 namespace bs_constraints {
 
 using ConstraintType = bs_constraints::RelativeImuState3DStampedConstraint;
 using PriorType = bs_constraints::AbsoluteImuState3DStampedConstraint;
 
 ImuState3DStampedTransaction::ImuState3DStampedTransaction(
-    const ros::Time& transaction_stamp) {
+    const ros::Time& transaction_stamp, bool use_pooled_allocation)
+    : use_pooled_allocation_(use_pooled_allocation) {
   transaction_ = fuse_core::Transaction::make_shared();
   transaction_->stamp(transaction_stamp);
 }
 
 fuse_core::Transaction::SharedPtr
     ImuState3DStampedTransaction::GetTransaction() const {
+  if (!batch_.Empty()) { batch_.MoveInto(*transaction_); }
   if (transaction_->empty()) { return nullptr; }
   return transaction_;
 }
 
+void ImuState3DStampedTransaction::Reserve(size_t num_states,
+                                           size_t num_constraints) {
+  use_batch_ = true;
+  batch_.Reserve(5 * num_states, num_constraints);
+}
+
+void ImuState3DStampedTransaction::addVariable(
+    fuse_core::Variable::SharedPtr variable) {
+  if (use_batch_) {
+    batch_.AddVariable(std::move(variable));
+  } else {
+    transaction_->addVariable(std::move(variable));
+  }
+}
+
+void ImuState3DStampedTransaction::addConstraint(
+    fuse_core::Constraint::SharedPtr constraint) {
+  if (use_batch_) {
+    batch_.AddConstraint(std::move(constraint), true);
+  } else {
+    transaction_->addConstraint(std::move(constraint), true);
+  }
+}
+
 void ImuState3DStampedTransaction::AddPriorImuStateConstraint(
     const bs_common::ImuState& imu_state,
     const Eigen::Matrix<double, 15, 15>& prior_covariance,
@@ -28,9 +56,9 @@ void ImuState3DStampedTransaction::AddPriorImuStateConstraint(
   Eigen::Matrix<double, 16, 1> mean = imu_state.GetStateVector();
 
   // build and add constraint
-  auto prior = std::make_shared<PriorType>(prior_source, imu_state, mean,
-                                           prior_covariance);
-  transaction_->addConstraint(prior, true);
+  auto prior = bs_common::MakePooled<PriorType>(
+      use_pooled_allocation_, prior_source, imu_state, mean, prior_covariance);
+  addConstraint(prior);
 }
 
 void ImuState3DStampedTransaction::AddRelativeImuStateConstraint(
@@ -41,10 +69,11 @@ void ImuState3DStampedTransaction::AddRelativeImuStateConstraint(
   std::shared_ptr<bs_common::PreIntegrator> pre_integrator_ptr =
       std::make_shared<bs_common::PreIntegrator>(pre_integrator);
   // build and add constraint
-  auto constraint = ConstraintType::make_shared(
-      source, imu_state_i, imu_state_j, pre_integrator_ptr, info_weight);
+  auto constraint = bs_common::MakePooled<ConstraintType>(
+      use_pooled_allocation_, source, imu_state_i, imu_state_j,
+      pre_integrator_ptr, info_weight);
 
-  transaction_->addConstraint(constraint, true);
+  addConstraint(constraint);
 }
 
 void ImuState3DStampedTransaction::AddImuStateVariables(
@@ -59,17 +88,17 @@ void ImuState3DStampedTransaction::AddImuStateVariables(
   // add to transaction
   transaction_->addInvolvedStamp(imu_state.Stamp());
   // we do not want to override the pose
-  transaction_->addVariable(
-      fuse_variables::Orientation3DStamped::make_shared(orr));
-  transaction_->addVariable(
-      fuse_variables::Position3DStamped::make_shared(pos));
+  addVariable(bs_common::MakePooled<fuse_variables::Orientation3DStamped>(
+      use_pooled_allocation_, orr));
+  addVariable(bs_common::MakePooled<fuse_variables::Position3DStamped>(
+      use_pooled_allocation_, pos));
   // we do want to override these
-  transaction_->addVariable(
-      fuse_variables::VelocityLinear3DStamped::make_shared(vel));
-  transaction_->addVariable(
-      bs_variables::GyroscopeBias3DStamped::make_shared(bg));
-  transaction_->addVariable(
-      bs_variables::AccelerationBias3DStamped::make_shared(ba));
+  addVariable(bs_common::MakePooled<fuse_variables::VelocityLinear3DStamped>(
+      use_pooled_allocation_, vel));
+  addVariable(bs_common::MakePooled<bs_variables::GyroscopeBias3DStamped>(
+      use_pooled_allocation_, bg));
+  addVariable(bs_common::MakePooled<bs_variables::AccelerationBias3DStamped>(
+      use_pooled_allocation_, ba));
 }
 
 } // namespace bs_constraints
\ No newline at end of file
@@ -3,10 +3,11 @@
 #include <string>
 
 #include <boost/serialization/export.hpp>
-#include <ceres/autodiff_cost_function.h>
 #include <pluginlib/class_list_macros.h>
 
-#include <bs_constraints/inertial/normal_delta_imu_state_3d_cost_functor.h>
+#include <bs_common/compact_serialization.h>
+
+#include <bs_constraints/inertial/normal_delta_imu_state_3d_function.h>
 
 namespace bs_constraints {
 
@@ -46,10 +47,8 @@ void RelativeImuState3DStampedConstraint::print(std::ostream& stream) const {
 }
 
 ceres::CostFunction* RelativeImuState3DStampedConstraint::costFunction() const {
-  return new ceres::AutoDiffCostFunction<NormalDeltaImuState3DCostFunctor, 15,
-                                         4, 3, 3, 3, 3, 4, 3, 3, 3, 3>(
-      new NormalDeltaImuState3DCostFunctor(imu_state_i_, pre_integrator_,
-                                           info_weight_));
+  return new NormalDeltaImuState3D(imu_state_i_, *pre_integrator_,
+                                   info_weight_);
 }
 
 Eigen::Matrix4d RelativeImuState3DStampedConstraint::getRelativePose() const {
@@ -65,9 +64,22 @@ Eigen::Matrix4d RelativeImuState3DStampedConstraint::getRelativePose() const {
   return T_S1_S2;
 }
 
+void RelativeImuState3DStampedConstraint::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  // as with its boost serialization, the preintegrator is not written
+  bs_common::WriteConstraintBase(*this, writer);
+}
+
+void RelativeImuState3DStampedConstraint::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+}
+
 } // namespace bs_constraints
 
 BOOST_CLASS_EXPORT_IMPLEMENT(
     bs_constraints::RelativeImuState3DStampedConstraint);
 PLUGINLIB_EXPORT_CLASS(bs_constraints::RelativeImuState3DStampedConstraint,
                        fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::RelativeImuState3DStampedConstraint);
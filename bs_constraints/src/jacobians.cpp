@@ -173,6 +173,16 @@ Eigen::Matrix<double, 3, 4> MinusJacobian(const Eigen::Quaterniond& q) {
   return jacobian;
 }
 
+Eigen::Matrix3d SO3RightJacobianInverse(const Eigen::Vector3d& phi) {
+  const double theta = phi.norm();
+  const Eigen::Matrix3d phi_x = beam::SkewX(phi);
+  Eigen::Matrix3d J = Eigen::Matrix3d::Identity() + 0.5 * phi_x;
+  if (theta < 1e-6) { return J + phi_x * phi_x / 12.0; }
+  const double c = 1.0 / (theta * theta) -
+                   (1.0 + std::cos(theta)) / (2.0 * theta * std::sin(theta));
+  return J + c * phi_x * phi_x;
+}
+
 Eigen::Matrix3d DPointRotationDRotation(const Eigen::Matrix3d& R,
                                         const Eigen::Vector3d& point) {
   return -R * beam::SkewX(point);
@@ -187,6 +197,96 @@ Eigen::Matrix3d DInverseRotationDRotation(const Eigen::Matrix3d& R) {
   return -R;
 }
 
+Eigen::Matrix<double, 3, 4>
+    DQuaternionRotationDQuaternion(const Eigen::Quaterniond& q,
+                                   const Eigen::Vector3d& point) {
+  // R(q) * p = (w^2 - u.u) * p + 2 * (u.p) * u + 2 * w * (u x p)
+  const double w = q.w();
+  const Eigen::Vector3d u = q.vec();
+  Eigen::Matrix<double, 3, 4> J;
+  J.col(0) = 2 * (w * point + u.cross(point));
+  J.rightCols<3>() =
+      2 * (u.dot(point) * Eigen::Matrix3d::Identity() +
+           u * point.transpose() - point * u.transpose() -
+           w * beam::SkewX(point));
+  return J;
+}
+
+Eigen::Matrix<double, 3, 4>
+    DInverseQuaternionRotationDQuaternion(const Eigen::Quaterniond& q,
+                                          const Eigen::Vector3d& point) {
+  // same as above with the conjugate, u -> -u
+  const double w = q.w();
+  const Eigen::Vector3d u = q.vec();
+  Eigen::Matrix<double, 3, 4> J;
+  J.col(0) = 2 * (w * point - u.cross(point));
+  J.rightCols<3>() =
+      2 * (u.dot(point) * Eigen::Matrix3d::Identity() +
+           u * point.transpose() - point * u.transpose() +
+           w * beam::SkewX(point));
+  return J;
+}
+
+Eigen::Matrix4d QuaternionLeftProductMatrix(const Eigen::Quaterniond& q) {
+  const Eigen::Vector3d u = q.vec();
+  Eigen::Matrix4d L;
+  L(0, 0) = q.w();
+  L.block<1, 3>(0, 1) = -u.transpose();
+  L.block<3, 1>(1, 0) = u;
+  L.block<3, 3>(1, 1) = q.w() * Eigen::Matrix3d::Identity() + beam::SkewX(u);
+  return L;
+}
+
+Eigen::Matrix4d QuaternionRightProductMatrix(const Eigen::Quaterniond& q) {
+  const Eigen::Vector3d u = q.vec();
+  Eigen::Matrix4d R;
+  R(0, 0) = q.w();
+  R.block<1, 3>(0, 1) = -u.transpose();
+  R.block<3, 1>(1, 0) = u;
+  R.block<3, 3>(1, 1) = q.w() * Eigen::Matrix3d::Identity() - beam::SkewX(u);
+  return R;
+}
+
+Eigen::Matrix4d DQuaternionInverseDQuaternion(const Eigen::Quaterniond& q) {
+  // q^-1 = C * q / (q.q), with C = diag(1, -1, -1, -1)
+  const Eigen::Vector4d q_wxyz(q.w(), q.x(), q.y(), q.z());
+  const double n = q_wxyz.squaredNorm();
+  const Eigen::Vector4d c(1, -1, -1, -1);
+  const Eigen::Matrix4d C = c.asDiagonal();
+  return C / n - (2.0 / (n * n)) * C * q_wxyz * q_wxyz.transpose();
+}
+
+Eigen::Matrix<double, 3, 4>
+    DRollPitchYawDQuaternion(const Eigen::Quaterniond& q) {
+  const double w = q.w();
+  const double x = q.x();
+  const double y = q.y();
+  const double z = q.z();
+  Eigen::Matrix<double, 3, 4> J = Eigen::Matrix<double, 3, 4>::Zero();
+
+  // roll = atan2(a, b), a = 2 (wx + yz), b = 1 - 2 (x^2 + y^2)
+  double a = 2.0 * (w * x + y * z);
+  double b = 1.0 - 2.0 * (x * x + y * y);
+  Eigen::RowVector4d da(2.0 * x, 2.0 * w, 2.0 * z, 2.0 * y);
+  Eigen::RowVector4d db(0, -4.0 * x, -4.0 * y, 0);
+  J.row(0) = (b * da - a * db) / (a * a + b * b);
+
+  // pitch = asin(s), s = 2 (wy - zx)
+  const double s = 2.0 * (w * y - z * x);
+  if (std::abs(s) < 1.0) {
+    const Eigen::RowVector4d ds(2.0 * y, -2.0 * z, 2.0 * w, -2.0 * x);
+    J.row(1) = ds / std::sqrt(1.0 - s * s);
+  }
+
+  // yaw = atan2(a, b), a = 2 (wz + xy), b = 1 - 2 (y^2 + z^2)
+  a = 2.0 * (w * z + x * y);
+  b = 1.0 - 2.0 * (y * y + z * z);
+  da << 2.0 * z, 2.0 * y, 2.0 * x, 2.0 * w;
+  db << 0, 0, -4.0 * y, -4.0 * z;
+  J.row(2) = (b * da - a * db) / (a * a + b * b);
+  return J;
+}
+
 Eigen::Matrix3d
     DRotationCompositionDLeftRotation(const Eigen::Matrix3d& R_left,
                                       const Eigen::Matrix3d& R_right) {
@@ -1,10 +1,9 @@
 #include <bs_constraints/motion/unicycle_3d_state_kinematic_constraint.h>
 
 #include <boost/serialization/export.hpp>
-#include <ceres/autodiff_cost_function.h>
 #include <pluginlib/class_list_macros.h>
 
-#include <bs_constraints/motion/unicycle_3d_state_cost_functor.h>
+#include <bs_constraints/motion/unicycle_3d_state_cost_function.h>
 
 namespace bs_constraints {
 
@@ -72,9 +71,7 @@ angular_velocity2. - 3
 linear_acceleration2 -3*/
 
 ceres::CostFunction* Unicycle3DStateKinematicConstraint::costFunction() const {
-  return new ceres::AutoDiffCostFunction<Unicycle3DStateCostFunctor, 15, 3, 4,
-                                         3, 3, 3, 3, 4, 3, 3, 3>(
-      new Unicycle3DStateCostFunctor(dt_, sqrt_information_));
+  return new Unicycle3DStateCostFunction(dt_, sqrt_information_);
 }
 
 } // namespace bs_constraints
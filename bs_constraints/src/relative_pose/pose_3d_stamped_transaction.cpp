@@ -2,6 +2,7 @@
 
 #include <bs_common/conversions.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/pool_allocator.h>
 #include <bs_constraints/global/absolute_pose_3d_constraint.h>
 #include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
 #include <bs_variables/orientation_3d.h>
@@ -11,9 +12,10 @@ namespace bs_constraints {
 
 Pose3DStampedTransaction::Pose3DStampedTransaction(
     const ros::Time& transaction_stamp, bool override_constraints,
-    bool override_variables)
+    bool override_variables, bool use_pooled_allocation)
     : override_constraints_(override_constraints),
-      override_variables_(override_variables) {
+      override_variables_(override_variables),
+      use_pooled_allocation_(use_pooled_allocation) {
   transaction_ = fuse_core::Transaction::make_shared();
   loss_function_ = std::make_shared<fuse_loss::CauchyLoss>();
   transaction_->stamp(transaction_stamp);
@@ -21,10 +23,35 @@ Pose3DStampedTransaction::Pose3DStampedTransaction(
 
 fuse_core::Transaction::SharedPtr
     Pose3DStampedTransaction::GetTransaction() const {
+  if (!batch_.Empty()) { batch_.MoveInto(*transaction_); }
   if (transaction_->empty()) { return nullptr; }
   return transaction_;
 }
 
+void Pose3DStampedTransaction::Reserve(size_t num_variables,
+                                       size_t num_constraints) {
+  use_batch_ = true;
+  batch_.Reserve(num_variables, num_constraints);
+}
+
+void Pose3DStampedTransaction::addVariable(
+    fuse_core::Variable::SharedPtr variable, bool overwrite) {
+  if (use_batch_) {
+    batch_.AddVariable(std::move(variable), overwrite);
+  } else {
+    transaction_->addVariable(std::move(variable), overwrite);
+  }
+}
+
+void Pose3DStampedTransaction::addConstraint(
+    fuse_core::Constraint::SharedPtr constraint, bool overwrite) {
+  if (use_batch_) {
+    batch_.AddConstraint(std::move(constraint), overwrite);
+  } else {
+    transaction_->addConstraint(std::move(constraint), overwrite);
+  }
+}
+
 void Pose3DStampedTransaction::AddPoseConstraint(
     const fuse_variables::Position3DStamped& position1,
     const fuse_variables::Position3DStamped& position2,
@@ -35,12 +62,12 @@ void Pose3DStampedTransaction::AddPoseConstraint(
     const std::string& frame_id) {
   // add regular relative pose constraint if no frame id is provided
   if (frame_id.empty()) {
-    auto constraint =
-        fuse_constraints::RelativePose3DStampedConstraint::make_shared(
-            source, position1, orientation1, position2, orientation2,
-            diff_Frame1_Frame2, covariance);
+    auto constraint = bs_common::MakePooled<
+        fuse_constraints::RelativePose3DStampedConstraint>(
+        use_pooled_allocation_, source, position1, orientation1, position2,
+        orientation2, diff_Frame1_Frame2, covariance);
     constraint->loss(loss_function_);
-    transaction_->addConstraint(constraint, override_constraints_);
+    addConstraint(constraint, override_constraints_);
     return;
   }
 
@@ -50,12 +77,12 @@ void Pose3DStampedTransaction::AddPoseConstraint(
   // add regular relative pose constraint if frame id provided is the baselink
   // frame id
   if (frame_id == extrinsics.GetBaselinkFrameId()) {
-    auto constraint =
-        fuse_constraints::RelativePose3DStampedConstraint::make_shared(
-            source, position1, orientation1, position2, orientation2,
-            diff_Frame1_Frame2, covariance);
+    auto constraint = bs_common::MakePooled<
+        fuse_constraints::RelativePose3DStampedConstraint>(
+        use_pooled_allocation_, source, position1, orientation1, position2,
+        orientation2, diff_Frame1_Frame2, covariance);
     constraint->loss(loss_function_);
-    transaction_->addConstraint(constraint, override_constraints_);
+    addConstraint(constraint, override_constraints_);
     return;
   }
 
@@ -72,13 +99,13 @@ void Pose3DStampedTransaction::AddPoseConstraint(
                                         frame_id);
   bs_variables::Orientation3D o_extrinsics(extrinsics.GetBaselinkFrameId(),
                                            frame_id);
-  auto constraint =
-      bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint::
-          make_shared(source, position1, orientation1, position2, orientation2,
-                      p_extrinsics, o_extrinsics, diff_Frame1_Frame2,
-                      covariance);
+  auto constraint = bs_common::MakePooled<
+      bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint>(
+      use_pooled_allocation_, source, position1, orientation1, position2,
+      orientation2, p_extrinsics, o_extrinsics, diff_Frame1_Frame2,
+      covariance);
   constraint->loss(loss_function_);
-  transaction_->addConstraint(constraint, override_constraints_);
+  addConstraint(constraint, override_constraints_);
 }
 
 void Pose3DStampedTransaction::AddPosePrior(
@@ -90,10 +117,11 @@ void Pose3DStampedTransaction::AddPosePrior(
   mean << position.x(), position.y(), position.z(), orientation.w(),
       orientation.x(), orientation.y(), orientation.z();
 
-  auto prior =
-      std::make_shared<fuse_constraints::AbsolutePose3DStampedConstraint>(
-          prior_source, position, orientation, mean, prior_covariance);
-  transaction_->addConstraint(prior, override_constraints_);
+  auto prior = bs_common::MakePooled<
+      fuse_constraints::AbsolutePose3DStampedConstraint>(
+      use_pooled_allocation_, prior_source, position, orientation, mean,
+      prior_covariance);
+  addConstraint(prior, override_constraints_);
 }
 
 void Pose3DStampedTransaction::AddPosePrior(
@@ -114,12 +142,12 @@ void Pose3DStampedTransaction::AddPoseVariables(
   transaction_->addInvolvedStamp(stamp);
 
   // add to transaction
-  transaction_->addVariable(
-      fuse_variables::Position3DStamped::make_shared(position),
-      override_variables_);
-  transaction_->addVariable(
-      fuse_variables::Orientation3DStamped::make_shared(orientation),
-      override_variables_);
+  addVariable(bs_common::MakePooled<fuse_variables::Position3DStamped>(
+                  use_pooled_allocation_, position),
+              override_variables_);
+  addVariable(bs_common::MakePooled<fuse_variables::Orientation3DStamped>(
+                  use_pooled_allocation_, orientation),
+              override_variables_);
 }
 
 void Pose3DStampedTransaction::AddExtrinsicVariablesForFrame(
@@ -162,8 +190,8 @@ void Pose3DStampedTransaction::AddExtrinsicVariablesForFrame(
   o->y() = q.y();
   o->z() = q.z();
 
-  transaction_->addVariable(p, override_variables_);
-  transaction_->addVariable(o, override_variables_);
+  addVariable(p, override_variables_);
+  addVariable(o, override_variables_);
 
   if (extrinsics_prior != 0) {
     BEAM_INFO("adding extrinsics prior for: {}", frame_id);
@@ -184,7 +212,7 @@ void Pose3DStampedTransaction::AddExtrinsicPrior(
 
   auto prior = std::make_shared<bs_constraints::AbsolutePose3DConstraint>(
       prior_source, position, orientation, mean, prior_covariance);
-  transaction_->addConstraint(prior, override_prior);
+  addConstraint(prior, override_prior);
 }
 
 } // namespace bs_constraints
\ No newline at end of file
@@ -1,10 +1,11 @@
 #include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
 
-#include <bs_constraints/relative_pose/delta_pose_3d_with_extrinsics_cost_functor.h>
+#include <bs_constraints/relative_pose/delta_pose_3d_with_extrinsics_cost_function.h>
 #include <pluginlib/class_list_macros.h>
 
+#include <bs_common/compact_serialization.h>
+
 #include <boost/serialization/export.hpp>
-#include <ceres/autodiff_cost_function.h>
 
 #include <string>
 
@@ -48,10 +49,21 @@ ceres::CostFunction*
     RelativePose3DStampedWithExtrinsicsConstraint::costFunction() const {
   // 6 residuals and 3 sets of poses each with 3 translation variables and then
   // 4 rotation variables
-  return new ceres::AutoDiffCostFunction<DeltaPose3DWithExtrinsicsCostFunctor,
-                                         6, 3, 4, 3, 4, 3, 4>(
-      new DeltaPose3DWithExtrinsicsCostFunctor(sqrt_information_,
-                                               d_Sensor1_Sensor2_));
+  return new DeltaPose3DWithExtrinsics(sqrt_information_, d_Sensor1_Sensor2_);
+}
+
+void RelativePose3DStampedWithExtrinsicsConstraint::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.WriteMatrix(d_Sensor1_Sensor2_);
+  writer.WriteMatrix(sqrt_information_);
+}
+
+void RelativePose3DStampedWithExtrinsicsConstraint::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  reader.ReadMatrix(d_Sensor1_Sensor2_);
+  reader.ReadMatrix(sqrt_information_);
 }
 
 } // namespace bs_constraints
@@ -61,3 +73,5 @@ BOOST_CLASS_EXPORT_IMPLEMENT(
 PLUGINLIB_EXPORT_CLASS(
     bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint,
     fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint);
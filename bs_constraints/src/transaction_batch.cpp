@@ -0,0 +1,103 @@
+#include <bs_constraints/transaction_batch.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <fuse_core/uuid.h>
+
+namespace bs_constraints {
+
+void TransactionBatch::Reserve(size_t num_variables, size_t num_constraints,
+                               size_t num_stamps) {
+  variables_.reserve(num_variables);
+  constraints_.reserve(num_constraints);
+  stamps_.reserve(num_stamps);
+}
+
+void TransactionBatch::AddVariable(fuse_core::Variable::SharedPtr variable,
+                                   bool overwrite) {
+  variables_.push_back({std::move(variable), overwrite});
+}
+
+void TransactionBatch::AddConstraint(
+    fuse_core::Constraint::SharedPtr constraint, bool overwrite) {
+  constraints_.push_back({std::move(constraint), overwrite});
+}
+
+void TransactionBatch::AddInvolvedStamp(const ros::Time& stamp) {
+  stamps_.push_back(stamp);
+}
+
+void TransactionBatch::Merge(const TransactionBatch& other) {
+  variables_.insert(variables_.end(), other.variables_.begin(),
+                    other.variables_.end());
+  constraints_.insert(constraints_.end(), other.constraints_.begin(),
+                      other.constraints_.end());
+  stamps_.insert(stamps_.end(), other.stamps_.begin(), other.stamps_.end());
+}
+
+void TransactionBatch::Merge(const fuse_core::Transaction& transaction,
+                             bool overwrite) {
+  for (const auto& variable : transaction.addedVariables()) {
+    variables_.push_back({variable.clone(), overwrite});
+  }
+  for (const auto& constraint : transaction.addedConstraints()) {
+    constraints_.push_back({constraint.clone(), overwrite});
+  }
+  for (const auto& stamp : transaction.involvedStamps()) {
+    stamps_.push_back(stamp);
+  }
+}
+
+bool TransactionBatch::Empty() const {
+  return variables_.empty() && constraints_.empty() && stamps_.empty();
+}
+
+template <typename T>
+void TransactionBatch::Deduplicate(std::vector<Entry<T>>& entries) {
+  std::unordered_map<fuse_core::UUID, size_t, fuse_core::uuid::hash> indices;
+  indices.reserve(entries.size());
+  size_t size = 0;
+  for (auto& entry : entries) {
+    const auto [it, inserted] = indices.emplace(entry.element->uuid(), size);
+    if (inserted) {
+      if (&entry != &entries[size]) { entries[size] = std::move(entry); }
+      size++;
+    } else if (entry.overwrite) {
+      entries[it->second] = std::move(entry);
+    }
+  }
+  entries.resize(size);
+}
+
+void TransactionBatch::MoveInto(fuse_core::Transaction& transaction) {
+  Deduplicate(variables_);
+  Deduplicate(constraints_);
+  std::sort(stamps_.begin(), stamps_.end());
+  stamps_.erase(std::unique(stamps_.begin(), stamps_.end()), stamps_.end());
+
+  for (auto& stamp : stamps_) { transaction.addInvolvedStamp(stamp); }
+  for (auto& entry : variables_) {
+    transaction.addVariable(std::move(entry.element), entry.overwrite);
+  }
+  for (auto& entry : constraints_) {
+    transaction.addConstraint(std::move(entry.element), entry.overwrite);
+  }
+  Clear();
+}
+
+fuse_core::Transaction::SharedPtr
+    TransactionBatch::ToTransaction(const ros::Time& stamp) {
+  auto transaction = fuse_core::Transaction::make_shared();
+  transaction->stamp(stamp);
+  MoveInto(*transaction);
+  return transaction;
+}
+
+void TransactionBatch::Clear() {
+  variables_.clear();
+  constraints_.clear();
+  stamps_.clear();
+}
+
+} // namespace bs_constraints
@@ -1,9 +1,10 @@
 #include <bs_constraints/visual/euclidean_reprojection_constraint.h>
 #include <bs_constraints/visual/euclidean_reprojection_function.h>
-#include <bs_constraints/visual/euclidean_reprojection_functor.h>
 
 #include <pluginlib/class_list_macros.h>
 
+#include <bs_common/compact_serialization.h>
+
 #include <boost/serialization/export.hpp>
 
 #include <Eigen/Dense>
@@ -39,11 +40,24 @@ void EuclideanReprojectionConstraint::print(std::ostream& stream) const {
 ceres::CostFunction* EuclideanReprojectionConstraint::costFunction() const {
   return new EuclideanReprojection(sqrt_information_, pixel_, intrinsic_matrix_,
                                    T_cam_baselink_);
-  // return new ceres::AutoDiffCostFunction<EuclideanReprojectionFunctor, 2, 4,
-  // 3, 3>(
-  //     new EuclideanReprojectionFunctor(sqrt_information_, pixel_,
-  //     intrinsic_matrix_,
-  //                             T_cam_baselink_));
+}
+
+void EuclideanReprojectionConstraint::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.WriteMatrix(pixel_);
+  writer.WriteMatrix(T_cam_baselink_);
+  writer.WriteMatrix(intrinsic_matrix_);
+  writer.WriteMatrix(sqrt_information_);
+}
+
+void EuclideanReprojectionConstraint::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  reader.ReadMatrix(pixel_);
+  reader.ReadMatrix(T_cam_baselink_);
+  reader.ReadMatrix(intrinsic_matrix_);
+  reader.ReadMatrix(sqrt_information_);
 }
 
 } // namespace bs_constraints
@@ -51,3 +65,4 @@ ceres::CostFunction* EuclideanReprojectionConstraint::costFunction() const {
 BOOST_CLASS_EXPORT_IMPLEMENT(bs_constraints::EuclideanReprojectionConstraint);
 PLUGINLIB_EXPORT_CLASS(bs_constraints::EuclideanReprojectionConstraint,
                        fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(bs_constraints::EuclideanReprojectionConstraint);
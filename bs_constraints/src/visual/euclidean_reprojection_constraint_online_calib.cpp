@@ -1,8 +1,10 @@
 #include <bs_constraints/visual/euclidean_reprojection_constraint_online_calib.h>
-#include <bs_constraints/visual/euclidean_reprojection_functor_online_calib.h>
+#include <bs_constraints/visual/euclidean_reprojection_function_online_calib.h>
 
 #include <pluginlib/class_list_macros.h>
 
+#include <bs_common/compact_serialization.h>
+
 #include <boost/serialization/export.hpp>
 
 #include <Eigen/Dense>
@@ -42,10 +44,24 @@ void EuclideanReprojectionConstraintOnlineCalib::print(
 
 ceres::CostFunction*
     EuclideanReprojectionConstraintOnlineCalib::costFunction() const {
-  return new ceres::AutoDiffCostFunction<
-      EuclideanReprojectionFunctorOnlineCalib, 2, 4, 3, 3, 4, 3>(
-      new EuclideanReprojectionFunctorOnlineCalib(sqrt_information_, pixel_,
-                                                  intrinsic_matrix_));
+  return new EuclideanReprojectionOnlineCalib(sqrt_information_, pixel_,
+                                              intrinsic_matrix_);
+}
+
+void EuclideanReprojectionConstraintOnlineCalib::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.WriteMatrix(pixel_);
+  writer.WriteMatrix(intrinsic_matrix_);
+  writer.WriteMatrix(sqrt_information_);
+}
+
+void EuclideanReprojectionConstraintOnlineCalib::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  reader.ReadMatrix(pixel_);
+  reader.ReadMatrix(intrinsic_matrix_);
+  reader.ReadMatrix(sqrt_information_);
 }
 
 } // namespace bs_constraints
@@ -55,3 +71,5 @@ BOOST_CLASS_EXPORT_IMPLEMENT(
 PLUGINLIB_EXPORT_CLASS(
     bs_constraints::EuclideanReprojectionConstraintOnlineCalib,
     fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::EuclideanReprojectionConstraintOnlineCalib);
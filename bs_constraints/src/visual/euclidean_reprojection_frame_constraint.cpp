@@ -0,0 +1,111 @@
+#include <bs_constraints/visual/euclidean_reprojection_frame_constraint.h>
+
+#include <pluginlib/class_list_macros.h>
+
+#include <bs_common/compact_serialization.h>
+
+#include <boost/serialization/export.hpp>
+
+#include <Eigen/Dense>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bs_constraints {
+
+namespace {
+
+std::vector<fuse_core::UUID> FrameVariables(
+    const fuse_variables::Orientation3DStamped& R_WORLD_BASELINK,
+    const fuse_variables::Position3DStamped& t_WORLD_BASELINK,
+    const std::vector<bs_variables::Point3DLandmark::SharedPtr>& landmarks) {
+  std::vector<fuse_core::UUID> variables{R_WORLD_BASELINK.uuid(),
+                                         t_WORLD_BASELINK.uuid()};
+  for (const auto& landmark : landmarks) {
+    variables.push_back(landmark->uuid());
+  }
+  return variables;
+}
+
+} // namespace
+
+EuclideanReprojectionFrameConstraint::EuclideanReprojectionFrameConstraint(
+    const std::string& source,
+    const fuse_variables::Orientation3DStamped& R_WORLD_BASELINK,
+    const fuse_variables::Position3DStamped& t_WORLD_BASELINK,
+    const std::vector<bs_variables::Point3DLandmark::SharedPtr>& landmarks,
+    const EuclideanReprojectionFrame::Pixels& measurements,
+    const Eigen::Matrix4d& T_cam_baselink,
+    const Eigen::Matrix3d& intrinsic_matrix,
+    const double reprojection_information_weight,
+    const fuse_core::Loss::SharedPtr& observation_loss)
+    : fuse_core::Constraint(source, {}),
+      pixels_(measurements),
+      T_cam_baselink_(T_cam_baselink),
+      intrinsic_matrix_(intrinsic_matrix),
+      sqrt_information_(reprojection_information_weight *
+                        Eigen::Matrix2d::Identity()),
+      observation_loss_(observation_loss) {
+  if (landmarks.empty()) {
+    throw std::invalid_argument(
+        "cannot create a reprojection frame constraint without landmarks");
+  }
+  if (landmarks.size() != measurements.size()) {
+    throw std::invalid_argument("number of landmarks (" +
+                                std::to_string(landmarks.size()) +
+                                ") and measurements (" +
+                                std::to_string(measurements.size()) +
+                                ") do not match");
+  }
+  variables_ = FrameVariables(R_WORLD_BASELINK, t_WORLD_BASELINK, landmarks);
+}
+
+void EuclideanReprojectionFrameConstraint::print(std::ostream& stream) const {
+  stream << type() << "\n"
+         << "  source: " << source() << "\n"
+         << "  uuid: " << uuid() << "\n"
+         << "  observations: " << pixels_.size() << "\n";
+}
+
+ceres::CostFunction*
+    EuclideanReprojectionFrameConstraint::costFunction() const {
+  return new EuclideanReprojectionFrame(
+      sqrt_information_, pixels_, intrinsic_matrix_, T_cam_baselink_,
+      observation_loss_ ? observation_loss_->lossFunction() : nullptr);
+}
+
+void EuclideanReprojectionFrameConstraint::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.Write<uint64_t>(pixels_.size());
+  for (const auto& pixel : pixels_) { writer.WriteMatrix(pixel); }
+  writer.WriteMatrix(T_cam_baselink_);
+  writer.WriteMatrix(intrinsic_matrix_);
+  writer.WriteMatrix(sqrt_information_);
+  bs_common::WriteLoss(observation_loss_, writer);
+}
+
+void EuclideanReprojectionFrameConstraint::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  const uint64_t num_pixels = reader.Read<uint64_t>();
+  if (num_pixels > reader.Remaining() / sizeof(Eigen::Vector2d)) {
+    throw std::runtime_error("invalid number of pixels in compact data");
+  }
+  pixels_.resize(num_pixels);
+  for (auto& pixel : pixels_) { reader.ReadMatrix(pixel); }
+  reader.ReadMatrix(T_cam_baselink_);
+  reader.ReadMatrix(intrinsic_matrix_);
+  reader.ReadMatrix(sqrt_information_);
+  observation_loss_ = bs_common::ReadLoss(reader);
+}
+
+} // namespace bs_constraints
+
+BOOST_CLASS_EXPORT_IMPLEMENT(
+    bs_constraints::EuclideanReprojectionFrameConstraint);
+PLUGINLIB_EXPORT_CLASS(bs_constraints::EuclideanReprojectionFrameConstraint,
+                       fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::EuclideanReprojectionFrameConstraint);
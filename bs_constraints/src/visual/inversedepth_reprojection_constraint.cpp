@@ -1,8 +1,10 @@
 #include <bs_constraints/visual/inversedepth_reprojection_constraint.h>
-#include <bs_constraints/visual/inversedepth_reprojection_functor.h>
+#include <bs_constraints/visual/inversedepth_reprojection_function.h>
 
 #include <pluginlib/class_list_macros.h>
 
+#include <bs_common/compact_serialization.h>
+
 #include <boost/serialization/export.hpp>
 
 #include <Eigen/Dense>
@@ -41,11 +43,29 @@ void InverseDepthReprojectionConstraint::print(std::ostream& stream) const {
 }
 
 ceres::CostFunction* InverseDepthReprojectionConstraint::costFunction() const {
-  return new ceres::AutoDiffCostFunction<InverseDepthReprojectionFunctor, 2, 4,
-                                         3, 4, 3, 1>(
-      new InverseDepthReprojectionFunctor(sqrt_information_, pixel_,
-                                          intrinsic_matrix_, T_cam_baselink_,
-                                          bearing_));
+  return new InverseDepthReprojection(sqrt_information_, pixel_,
+                                      intrinsic_matrix_, T_cam_baselink_,
+                                      bearing_);
+}
+
+void InverseDepthReprojectionConstraint::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.WriteMatrix(pixel_);
+  writer.WriteMatrix(bearing_);
+  writer.WriteMatrix(T_cam_baselink_);
+  writer.WriteMatrix(intrinsic_matrix_);
+  writer.WriteMatrix(sqrt_information_);
+}
+
+void InverseDepthReprojectionConstraint::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  reader.ReadMatrix(pixel_);
+  reader.ReadMatrix(bearing_);
+  reader.ReadMatrix(T_cam_baselink_);
+  reader.ReadMatrix(intrinsic_matrix_);
+  reader.ReadMatrix(sqrt_information_);
 }
 
 } // namespace bs_constraints
@@ -54,3 +74,5 @@ BOOST_CLASS_EXPORT_IMPLEMENT(
     bs_constraints::InverseDepthReprojectionConstraint);
 PLUGINLIB_EXPORT_CLASS(bs_constraints::InverseDepthReprojectionConstraint,
                        fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::InverseDepthReprojectionConstraint);
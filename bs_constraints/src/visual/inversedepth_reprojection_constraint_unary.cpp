@@ -1,8 +1,10 @@
 #include <bs_constraints/visual/inversedepth_reprojection_constraint_unary.h>
-#include <bs_constraints/visual/inversedepth_reprojection_functor_unary.h>
+#include <bs_constraints/visual/inversedepth_reprojection_function_unary.h>
 
 #include <pluginlib/class_list_macros.h>
 
+#include <bs_common/compact_serialization.h>
+
 #include <boost/serialization/export.hpp>
 
 #include <Eigen/Dense>
@@ -41,11 +43,28 @@ void InverseDepthReprojectionConstraintUnary::print(
 
 ceres::CostFunction*
     InverseDepthReprojectionConstraintUnary::costFunction() const {
-  return new ceres::AutoDiffCostFunction<InverseDepthReprojectionFunctorUnary,
-                                         2, 4, 3, 1>(
-      new InverseDepthReprojectionFunctorUnary(sqrt_information_, pixel_,
-                                               intrinsic_matrix_,
-                                               T_cam_baselink_, bearing_));
+  return new InverseDepthReprojectionUnary(sqrt_information_, pixel_,
+                                           intrinsic_matrix_, bearing_);
+}
+
+void InverseDepthReprojectionConstraintUnary::serializeCompact(
+    bs_common::ByteWriter& writer) const {
+  bs_common::WriteConstraintBase(*this, writer);
+  writer.WriteMatrix(pixel_);
+  writer.WriteMatrix(bearing_);
+  writer.WriteMatrix(T_cam_baselink_);
+  writer.WriteMatrix(intrinsic_matrix_);
+  writer.WriteMatrix(sqrt_information_);
+}
+
+void InverseDepthReprojectionConstraintUnary::deserializeCompact(
+    bs_common::ByteReader& reader) {
+  bs_common::ReadConstraintBase(reader, source_, uuid_, variables_, loss_);
+  reader.ReadMatrix(pixel_);
+  reader.ReadMatrix(bearing_);
+  reader.ReadMatrix(T_cam_baselink_);
+  reader.ReadMatrix(intrinsic_matrix_);
+  reader.ReadMatrix(sqrt_information_);
 }
 
 } // namespace bs_constraints
@@ -54,3 +73,5 @@ BOOST_CLASS_EXPORT_IMPLEMENT(
     bs_constraints::InverseDepthReprojectionConstraintUnary);
 PLUGINLIB_EXPORT_CLASS(bs_constraints::InverseDepthReprojectionConstraintUnary,
                        fuse_core::Constraint);
+BS_COMPACT_CONSTRAINT_EXPORT(
+    bs_constraints::InverseDepthReprojectionConstraintUnary);
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include <fuse_core/eigen_gtest.h>
+#include <fuse_core/serialization.h>
+#include <fuse_core/transaction.h>
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <fuse_variables/velocity_linear_3d_stamped.h>
+#include <gtest/gtest.h>
+
+#include <bs_common/compact_serialization.h>
+#include <bs_common/imu_state.h>
+#include <bs_constraints/inertial/absolute_imu_state_3d_stamped_constraint.h>
+#include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
+#include <bs_constraints/visual/euclidean_reprojection_constraint.h>
+#include <bs_variables/accel_bias_3d_stamped.h>
+#include <bs_variables/gyro_bias_3d_stamped.h>
+#include <bs_variables/inverse_depth_landmark.h>
+#include <bs_variables/orientation_3d.h>
+#include <bs_variables/point_3d_landmark.h>
+#include <bs_variables/position_3d.h>
+
+namespace {
+
+constexpr double kWindowDuration = 15;  // s
+constexpr double kKeyframeRate = 10;    // Hz
+constexpr int kNumLandmarks = 1000;
+constexpr int kObservationsPerLandmark = 10;
+
+const bs_common::CompactSerializer& Serializer() {
+  return bs_common::CompactSerializer::Instance();
+}
+
+// variables and constraints of a 15 s window of visual inertial lidar
+// odometry: imu states at 10 Hz with a prior on the first one, lidar relative
+// poses between consecutive states and landmarks observed by several states
+fuse_core::Transaction::SharedPtr MakeWindow() {
+  auto transaction = fuse_core::Transaction::make_shared();
+  transaction->stamp(ros::Time(1));
+  auto position_extrinsics =
+      bs_variables::Position3D::make_shared("imu", "lidar");
+  auto orientation_extrinsics =
+      bs_variables::Orientation3D::make_shared("imu", "lidar");
+  transaction->addVariable(position_extrinsics);
+  transaction->addVariable(orientation_extrinsics);
+
+  const int num_states = kWindowDuration * kKeyframeRate;
+  std::vector<fuse_variables::Position3DStamped::SharedPtr> positions;
+  std::vector<fuse_variables::Orientation3DStamped::SharedPtr> orientations;
+  for (int i = 0; i < num_states; i++) {
+    const ros::Time stamp(1 + i / kKeyframeRate);
+    transaction->addInvolvedStamp(stamp);
+    const Eigen::Quaterniond q(
+        Eigen::AngleAxisd(0.01 * i, Eigen::Vector3d::UnitZ()));
+    const Eigen::Vector3d p(0.1 * i, 0.02 * i, 0);
+    const Eigen::Vector3d v(1, 0.2, 0);
+    const Eigen::Vector3d bg(0.001, -0.002, 0.003);
+    const Eigen::Vector3d ba(0.01, 0.02, -0.03);
+
+    auto position = fuse_variables::Position3DStamped::make_shared(stamp);
+    auto orientation = fuse_variables::Orientation3DStamped::make_shared(stamp);
+    auto velocity = fuse_variables::VelocityLinear3DStamped::make_shared(stamp);
+    auto gyro_bias = bs_variables::GyroscopeBias3DStamped::make_shared(stamp);
+    auto accel_bias =
+        bs_variables::AccelerationBias3DStamped::make_shared(stamp);
+    for (int j = 0; j < 3; j++) {
+      position->data()[j] = p[j];
+      velocity->data()[j] = v[j];
+      gyro_bias->data()[j] = bg[j];
+      accel_bias->data()[j] = ba[j];
+    }
+    orientation->w() = q.w();
+    orientation->x() = q.x();
+    orientation->y() = q.y();
+    orientation->z() = q.z();
+    transaction->addVariable(position);
+    transaction->addVariable(orientation);
+    transaction->addVariable(velocity);
+    transaction->addVariable(gyro_bias);
+    transaction->addVariable(accel_bias);
+
+    if (i == 0) {
+      bs_common::ImuState state(stamp, q, p, v, bg, ba);
+      Eigen::Matrix<double, 16, 1> mean;
+      mean << q.w(), q.x(), q.y(), q.z(), p, v, bg, ba;
+      transaction->addConstraint(
+          bs_constraints::AbsoluteImuState3DStampedConstraint::make_shared(
+              "prior", state, mean,
+              1e-4 * Eigen::Matrix<double, 15, 15>::Identity()));
+    } else {
+      fuse_core::Vector7d delta;
+      delta << 0.1, 0.02, 0, std::cos(0.005), 0, 0, std::sin(0.005);
+      transaction->addConstraint(
+          bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint::
+              make_shared("lidar", *positions.back(), *orientations.back(),
+                          *position, *orientation, *position_extrinsics,
+                          *orientation_extrinsics, delta,
+                          1e-3 * fuse_core::Matrix6d::Identity()));
+    }
+    positions.push_back(position);
+    orientations.push_back(orientation);
+  }
+
+  Eigen::Matrix4d T_cam_baselink = Eigen::Matrix4d::Identity();
+  T_cam_baselink.block<3, 1>(0, 3) = Eigen::Vector3d(0.1, 0, 0.05);
+  Eigen::Matrix3d K;
+  K << 500, 0, 320, 0, 500, 240, 0, 0, 1;
+  for (int l = 0; l < kNumLandmarks; l++) {
+    auto landmark = bs_variables::Point3DLandmark::make_shared(
+        l, Eigen::Vector3d(0, 0, 1), l % 100);
+    landmark->x() = 0.01 * l;
+    landmark->y() = 1;
+    landmark->z() = 5;
+    transaction->addVariable(landmark);
+    for (int k = 0; k < kObservationsPerLandmark; k++) {
+      const int state = (l + 7 * k) % num_states;
+      transaction->addConstraint(
+          bs_constraints::EuclideanReprojectionConstraint::make_shared(
+              "camera", *orientations[state], *positions[state], *landmark,
+              T_cam_baselink, K, Eigen::Vector2d(320 + k, 240 - k), 2.0));
+    }
+  }
+  return transaction;
+}
+
+void ExpectSameVariable(const fuse_core::Variable& expected,
+                        const fuse_core::Variable& actual) {
+  EXPECT_EQ(expected.type(), actual.type());
+  EXPECT_EQ(expected.uuid(), actual.uuid());
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(expected.data()[i], actual.data()[i]);
+  }
+}
+
+void ExpectSameConstraint(const fuse_core::Constraint& expected,
+                          const fuse_core::Constraint& actual) {
+  EXPECT_EQ(expected.type(), actual.type());
+  EXPECT_EQ(expected.uuid(), actual.uuid());
+  EXPECT_EQ(expected.source(), actual.source());
+  EXPECT_EQ(expected.variables(), actual.variables());
+}
+
+} // namespace
+
+TEST(CompactSerialization, Variables) {
+  std::vector<fuse_core::Variable::SharedPtr> variables;
+  auto landmark = bs_variables::Point3DLandmark::make_shared(
+      12, Eigen::Vector3d(0, 0.6, 0.8), 34);
+  landmark->x() = 1.5;
+  variables.push_back(landmark);
+  auto inverse_depth = bs_variables::InverseDepthLandmark::make_shared(
+      56, Eigen::Vector3d(0.6, 0, 0.8), ros::Time(3, 4));
+  inverse_depth->inverse_depth() = 0.25;
+  variables.push_back(inverse_depth);
+  auto position = bs_variables::Position3D::make_shared("imu", "camera");
+  position->y() = -2;
+  variables.push_back(position);
+  variables.push_back(bs_variables::Orientation3D::make_shared("imu", "lidar"));
+  variables.push_back(
+      bs_variables::GyroscopeBias3DStamped::make_shared(ros::Time(5, 6)));
+
+  bs_common::ByteWriter writer;
+  for (const auto& variable : variables) {
+    EXPECT_TRUE(Serializer().HasCodec(variable->type()));
+    Serializer().WriteVariable(*variable, writer);
+  }
+  bs_common::ByteReader reader(writer.Data().data(), writer.Size());
+  std::vector<fuse_core::Variable::SharedPtr> actual;
+  for (const auto& variable : variables) {
+    actual.push_back(Serializer().ReadVariable(reader));
+    ASSERT_NE(actual.back(), nullptr);
+    ExpectSameVariable(*variable, *actual.back());
+  }
+  EXPECT_EQ(reader.Remaining(), 0u);
+
+  const auto& actual_landmark =
+      dynamic_cast<const bs_variables::Point3DLandmark&>(*actual[0]);
+  EXPECT_EQ(actual_landmark.word_id(), 34u);
+  EXPECT_MATRIX_EQ(actual_landmark.viewing_angle(),
+                   Eigen::Vector3d(0, 0.6, 0.8));
+  const auto& actual_inverse_depth =
+      dynamic_cast<const bs_variables::InverseDepthLandmark&>(*actual[1]);
+  EXPECT_EQ(actual_inverse_depth.anchorStamp(), ros::Time(3, 4));
+  EXPECT_MATRIX_EQ(actual_inverse_depth.bearing(),
+                   Eigen::Vector3d(0.6, 0, 0.8));
+
+  // truncated data is rejected
+  bs_common::ByteReader truncated(writer.Data().data(), writer.Size() / 2);
+  EXPECT_THROW(
+      {
+        for (size_t i = 0; i < variables.size(); i++) {
+          Serializer().ReadVariable(truncated);
+        }
+      },
+      std::runtime_error);
+}
+
+TEST(CompactSerialization, Transaction) {
+  const auto expected = MakeWindow();
+  bs_common::ByteWriter writer;
+  Serializer().WriteTransaction(*expected, writer);
+  bs_common::ByteReader reader(writer.Data().data(), writer.Size());
+  const auto actual = Serializer().ReadTransaction(reader);
+  EXPECT_EQ(reader.Remaining(), 0u);
+
+  EXPECT_EQ(expected->stamp(), actual->stamp());
+  const auto expected_stamps = expected->involvedStamps();
+  const auto actual_stamps = actual->involvedStamps();
+  EXPECT_TRUE(std::equal(expected_stamps.begin(), expected_stamps.end(),
+                         actual_stamps.begin(), actual_stamps.end()));
+
+  const auto expected_variables = expected->addedVariables();
+  const auto actual_variables = actual->addedVariables();
+  ASSERT_EQ(std::distance(expected_variables.begin(), expected_variables.end()),
+            std::distance(actual_variables.begin(), actual_variables.end()));
+  auto actual_variable = actual_variables.begin();
+  for (const auto& variable : expected_variables) {
+    ExpectSameVariable(variable, *actual_variable++);
+  }
+
+  const auto expected_constraints = expected->addedConstraints();
+  const auto actual_constraints = actual->addedConstraints();
+  ASSERT_EQ(
+      std::distance(expected_constraints.begin(), expected_constraints.end()),
+      std::distance(actual_constraints.begin(), actual_constraints.end()));
+  auto actual_constraint = actual_constraints.begin();
+  for (const auto& constraint : expected_constraints) {
+    EXPECT_TRUE(Serializer().HasCodec(constraint.type()));
+    ExpectSameConstraint(constraint, *actual_constraint);
+    const auto* reprojection =
+        dynamic_cast<const bs_constraints::EuclideanReprojectionConstraint*>(
+            &constraint);
+    if (reprojection) {
+      EXPECT_MATRIX_EQ(
+          reprojection->pixel(),
+          dynamic_cast<const bs_constraints::EuclideanReprojectionConstraint&>(
+              *actual_constraint)
+              .pixel());
+    }
+    actual_constraint++;
+  }
+}
+
+TEST(CompactSerialization, Graph) {
+  fuse_graphs::HashGraph expected;
+  expected.update(*MakeWindow());
+  const auto extrinsics = bs_variables::Position3D("imu", "lidar").uuid();
+  expected.holdVariable(extrinsics, true);
+
+  bs_common::ByteWriter writer;
+  Serializer().WriteGraph(expected, writer);
+  bs_common::ByteReader reader(writer.Data().data(), writer.Size());
+  fuse_graphs::HashGraph actual;
+  Serializer().ReadGraph(reader, actual);
+
+  for (const auto& variable : expected.getVariables()) {
+    ASSERT_TRUE(actual.variableExists(variable.uuid()));
+    ExpectSameVariable(variable, actual.getVariable(variable.uuid()));
+  }
+  for (const auto& constraint : expected.getConstraints()) {
+    ASSERT_TRUE(actual.constraintExists(constraint.uuid()));
+    ExpectSameConstraint(constraint, actual.getConstraint(constraint.uuid()));
+  }
+  EXPECT_TRUE(actual.isVariableOnHold(extrinsics));
+}
+
+TEST(CompactSerialization, SmallerThanBoost) {
+  fuse_graphs::HashGraph graph;
+  graph.update(*MakeWindow());
+
+  std::stringstream stream;
+  {
+    fuse_core::BinaryOutputArchive archive(stream);
+    graph.serialize(archive);
+  }
+  bs_common::ByteWriter writer;
+  Serializer().WriteGraph(graph, writer);
+  EXPECT_LT(writer.Size(), stream.str().size());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
 #include <beam_utils/utils.h>
 #include <ceres/ceres.h>
 #include <gtest/gtest.h>
@@ -11,7 +14,17 @@
 #include <bs_common/imu_state.h>
 #include <bs_constraints/jacobians.h>
 #include <bs_constraints/visual/euclidean_reprojection_function.h>
-#include <bs_constraints/visual/reprojection_functor.h>
+#include <bs_constraints/visual/euclidean_reprojection_frame_function.h>
+#include <bs_constraints/visual/euclidean_reprojection_function_online_calib.h>
+#include <bs_constraints/visual/euclidean_reprojection_functor.h>
+#include <bs_constraints/visual/euclidean_reprojection_functor_online_calib.h>
+#include <bs_constraints/visual/inversedepth_reprojection_function.h>
+#include <bs_constraints/visual/inversedepth_reprojection_function_unary.h>
+#include <bs_constraints/visual/inversedepth_reprojection_functor.h>
+#include <bs_constraints/visual/inversedepth_reprojection_functor_unary.h>
+#include <bs_variables/inverse_depth_landmark.h>
+#include <bs_variables/orientation_3d.h>
+#include <bs_variables/position_3d.h>
 
 constexpr double EPS = 1e-8;
 constexpr double THRESHOLD = 1e-6;
@@ -28,6 +41,75 @@ Eigen::Matrix3d GenerateRandomIntrinsicMatrix() {
   return K;
 }
 
+// evaluates the jacobian of a cost function in the local parameterization of
+// each variable
+ceres::CRSMatrix
+    EvaluateJacobian(ceres::CostFunction* cost_function,
+                     const std::vector<fuse_core::Variable*>& variables) {
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+
+  std::vector<double*> parameter_blocks;
+  for (auto variable : variables) {
+    problem.AddParameterBlock(variable->data(), variable->size(),
+                              variable->localParameterization());
+    parameter_blocks.push_back(variable->data());
+  }
+  ceres::TrivialLoss loss_function;
+  problem.AddResidualBlock(cost_function, &loss_function, parameter_blocks);
+
+  double cost = 0.0;
+  ceres::CRSMatrix jacobian;
+  problem.Evaluate(ceres::Problem::EvaluateOptions(), &cost, nullptr, nullptr,
+                   &jacobian);
+  return jacobian;
+}
+
+void ExpectEqualJacobians(const ceres::CRSMatrix& J1,
+                          const ceres::CRSMatrix& J2) {
+  ASSERT_EQ(J1.values.size(), J2.values.size());
+  for (int i = 0; i < J1.values.size(); i++) {
+    EXPECT_NEAR(J1.values[i], J2.values[i], 0.00001);
+  }
+  EXPECT_EQ(J1.cols, J2.cols);
+  EXPECT_EQ(J1.rows, J2.rows);
+}
+
+void ExpectEqualResiduals(ceres::CostFunction* cost_function1,
+                          ceres::CostFunction* cost_function2,
+                          const std::vector<fuse_core::Variable*>& variables) {
+  std::vector<const double*> parameters;
+  for (auto variable : variables) { parameters.push_back(variable->data()); }
+  double residual1[2];
+  double residual2[2];
+  cost_function1->Evaluate(parameters.data(), residual1, nullptr);
+  cost_function2->Evaluate(parameters.data(), residual2, nullptr);
+  EXPECT_NEAR(residual1[0], residual2[0], THRESHOLD);
+  EXPECT_NEAR(residual1[1], residual2[1], THRESHOLD);
+}
+
+fuse_variables::Orientation3DStamped::SharedPtr
+    MakeOrientation(const ros::Time& stamp, const Eigen::Matrix4d& T) {
+  const Eigen::Quaterniond q(T.block<3, 3>(0, 0));
+  auto orientation = fuse_variables::Orientation3DStamped::make_shared(stamp);
+  orientation->w() = q.w();
+  orientation->x() = q.x();
+  orientation->y() = q.y();
+  orientation->z() = q.z();
+  return orientation;
+}
+
+fuse_variables::Position3DStamped::SharedPtr
+    MakePosition(const ros::Time& stamp, const Eigen::Matrix4d& T) {
+  auto position = fuse_variables::Position3DStamped::make_shared(stamp);
+  position->x() = T(0, 3);
+  position->y() = T(1, 3);
+  position->z() = T(2, 3);
+  return position;
+}
+
 TEST(EuclideanReprojectionFunction, Validity) {
   // generate random T_WORLD_BASELINK
   const Eigen::Matrix4d T_WORLD_BASELINK = beam::GenerateRandomPose(1.0, 10.0);
@@ -196,6 +278,194 @@ TEST(EuclideanReprojectionFunction, Validity) {
   }
 }
 
+TEST(EuclideanReprojectionFunctionOnlineCalib, Validity) {
+  const Eigen::Matrix4d T_WORLD_BASELINK = beam::GenerateRandomPose(1.0, 10.0);
+  const Eigen::Matrix4d T_BASELINK_CAM = beam::GenerateRandomPose(0.0, 1.0);
+  const Eigen::Matrix3d K = GenerateRandomIntrinsicMatrix();
+  const Eigen::Vector3d P_CAM =
+      beam::randf(5.0, 10.0) *
+      beam::UniformRandomVector<3>(0.1, 1.0).normalized();
+  const Eigen::Vector3d P_WORLD =
+      (T_WORLD_BASELINK * T_BASELINK_CAM * P_CAM.homogeneous()).hnormalized();
+  const Eigen::Vector2d pixel =
+      (K * P_CAM).hnormalized() + Eigen::Vector2d(10, 10);
+
+  ros::Time stamp(0.0);
+  auto orientation = MakeOrientation(stamp, T_WORLD_BASELINK);
+  auto position = MakePosition(stamp, T_WORLD_BASELINK);
+  auto landmark = bs_variables::Point3DLandmark::make_shared(0);
+  landmark->x() = P_WORLD[0];
+  landmark->y() = P_WORLD[1];
+  landmark->z() = P_WORLD[2];
+  bs_variables::Orientation3D o_BASELINK_CAM("camera", "baselink");
+  bs_variables::Position3D p_BASELINK_CAM("camera", "baselink");
+  const Eigen::Quaterniond q_BASELINK_CAM(T_BASELINK_CAM.block<3, 3>(0, 0));
+  o_BASELINK_CAM.data()[0] = q_BASELINK_CAM.w();
+  o_BASELINK_CAM.data()[1] = q_BASELINK_CAM.x();
+  o_BASELINK_CAM.data()[2] = q_BASELINK_CAM.y();
+  o_BASELINK_CAM.data()[3] = q_BASELINK_CAM.z();
+  for (int i = 0; i < 3; i++) {
+    p_BASELINK_CAM.data()[i] = T_BASELINK_CAM(i, 3);
+  }
+  const std::vector<fuse_core::Variable*> variables{
+      orientation.get(), position.get(), landmark.get(), &o_BASELINK_CAM,
+      &p_BASELINK_CAM};
+
+  bs_constraints::EuclideanReprojectionOnlineCalib analytic(
+      Eigen::Matrix2d::Identity(), pixel, K);
+  ceres::AutoDiffCostFunction<
+      bs_constraints::EuclideanReprojectionFunctorOnlineCalib, 2, 4, 3, 3, 4, 3>
+      autodiff(new bs_constraints::EuclideanReprojectionFunctorOnlineCalib(
+          Eigen::Matrix2d::Identity(), pixel, K));
+
+  ExpectEqualResiduals(&analytic, &autodiff, variables);
+  ExpectEqualJacobians(EvaluateJacobian(&analytic, variables),
+                       EvaluateJacobian(&autodiff, variables));
+}
+
+TEST(InverseDepthReprojectionFunction, Validity) {
+  const Eigen::Matrix4d T_WORLD_BASELINKa = beam::GenerateRandomPose(1.0, 10.0);
+  const Eigen::Matrix4d T_BASELINKa_BASELINKm =
+      beam::GenerateRandomPose(0.0, 0.5);
+  const Eigen::Matrix4d T_WORLD_BASELINKm =
+      T_WORLD_BASELINKa * T_BASELINKa_BASELINKm;
+  const Eigen::Matrix4d T_CAM_BASELINK = beam::GenerateRandomPose(0.0, 1.0);
+  const Eigen::Matrix3d K = GenerateRandomIntrinsicMatrix();
+
+  // landmark in front of both cameras
+  const Eigen::Vector3d P_CAMa =
+      beam::randf(5.0, 10.0) *
+      beam::UniformRandomVector<3>(0.1, 1.0).normalized();
+  const Eigen::Matrix4d T_CAMm_CAMa =
+      T_CAM_BASELINK * beam::InvertTransform(T_BASELINKa_BASELINKm) *
+      beam::InvertTransform(T_CAM_BASELINK);
+  const Eigen::Vector3d P_CAMm =
+      (T_CAMm_CAMa * P_CAMa.homogeneous()).hnormalized();
+  const Eigen::Vector2d pixel =
+      (K * P_CAMm).hnormalized() + Eigen::Vector2d(10, 10);
+
+  ros::Time stamp_a(0.0);
+  ros::Time stamp_m(1.0);
+  auto orientation_a = MakeOrientation(stamp_a, T_WORLD_BASELINKa);
+  auto position_a = MakePosition(stamp_a, T_WORLD_BASELINKa);
+  auto orientation_m = MakeOrientation(stamp_m, T_WORLD_BASELINKm);
+  auto position_m = MakePosition(stamp_m, T_WORLD_BASELINKm);
+  const Eigen::Vector3d bearing = P_CAMa.normalized();
+  bs_variables::InverseDepthLandmark landmark(0, bearing, stamp_a);
+  landmark.inverse_depth() = 1.0 / P_CAMa.norm() + 0.01;
+
+  {
+    const std::vector<fuse_core::Variable*> variables{
+        orientation_a.get(), position_a.get(), orientation_m.get(),
+        position_m.get(), &landmark};
+    bs_constraints::InverseDepthReprojection analytic(
+        Eigen::Matrix2d::Identity(), pixel, K, T_CAM_BASELINK, bearing);
+    ceres::AutoDiffCostFunction<bs_constraints::InverseDepthReprojectionFunctor,
+                                2, 4, 3, 4, 3, 1>
+        autodiff(new bs_constraints::InverseDepthReprojectionFunctor(
+            Eigen::Matrix2d::Identity(), pixel, K, T_CAM_BASELINK, bearing));
+
+    ExpectEqualResiduals(&analytic, &autodiff, variables);
+    ExpectEqualJacobians(EvaluateJacobian(&analytic, variables),
+                         EvaluateJacobian(&autodiff, variables));
+  }
+
+  {
+    const std::vector<fuse_core::Variable*> variables{
+        orientation_a.get(), position_a.get(), &landmark};
+    bs_constraints::InverseDepthReprojectionUnary analytic(
+        Eigen::Matrix2d::Identity(), pixel, K, bearing);
+    ceres::AutoDiffCostFunction<
+        bs_constraints::InverseDepthReprojectionFunctorUnary, 2, 4, 3, 1>
+        autodiff(new bs_constraints::InverseDepthReprojectionFunctorUnary(
+            Eigen::Matrix2d::Identity(), pixel, K, T_CAM_BASELINK, bearing));
+
+    ExpectEqualResiduals(&analytic, &autodiff, variables);
+    ExpectEqualJacobians(EvaluateJacobian(&analytic, variables),
+                         EvaluateJacobian(&autodiff, variables));
+  }
+}
+
+TEST(EuclideanReprojectionFrameFunction, Validity) {
+  const Eigen::Matrix4d T_WORLD_BASELINK = beam::GenerateRandomPose(1.0, 10.0);
+  const Eigen::Matrix4d T_CAM_BASELINK = beam::GenerateRandomPose(0.0, 1.0);
+  const Eigen::Matrix4d T_WORLD_CAM =
+      T_WORLD_BASELINK * beam::InvertTransform(T_CAM_BASELINK);
+  const Eigen::Matrix3d K = GenerateRandomIntrinsicMatrix();
+
+  ros::Time stamp(0.0);
+  auto orientation = MakeOrientation(stamp, T_WORLD_BASELINK);
+  auto position = MakePosition(stamp, T_WORLD_BASELINK);
+
+  // observations with a range of reprojection errors, so that some are in the
+  // robust part of the loss
+  const int num_observations = 20;
+  std::vector<bs_variables::Point3DLandmark::SharedPtr> landmarks;
+  bs_constraints::EuclideanReprojectionFrame::Pixels pixels;
+  for (int i = 0; i < num_observations; i++) {
+    const Eigen::Vector3d P_CAM =
+        beam::randf(5.0, 10.0) *
+        beam::UniformRandomVector<3>(0.1, 1.0).normalized();
+    const Eigen::Vector3d P_WORLD =
+        (T_WORLD_CAM * P_CAM.homogeneous()).hnormalized();
+    auto landmark = bs_variables::Point3DLandmark::make_shared(i);
+    landmark->x() = P_WORLD[0];
+    landmark->y() = P_WORLD[1];
+    landmark->z() = P_WORLD[2];
+    landmarks.push_back(landmark);
+    pixels.push_back((K * P_CAM).hnormalized() +
+                     beam::UniformRandomVector<2>(-2.0 * i, 2.0 * i));
+  }
+
+  // evaluate the cost and gradient of one frame block, and of one residual
+  // block per observation with the same loss on each
+  const double cauchy_a = 3.0;
+  const auto evaluate = [&](bool use_frame, double& cost,
+                            std::vector<double>& gradient) {
+    ceres::Problem problem;
+    problem.AddParameterBlock(orientation->data(), orientation->size(),
+                              orientation->localParameterization());
+    problem.AddParameterBlock(position->data(), position->size());
+    for (const auto& landmark : landmarks) {
+      problem.AddParameterBlock(landmark->data(), landmark->size());
+    }
+    if (use_frame) {
+      std::vector<double*> parameter_blocks{orientation->data(),
+                                            position->data()};
+      for (const auto& landmark : landmarks) {
+        parameter_blocks.push_back(landmark->data());
+      }
+      problem.AddResidualBlock(
+          new bs_constraints::EuclideanReprojectionFrame(
+              Eigen::Matrix2d::Identity(), pixels, K, T_CAM_BASELINK,
+              new ceres::CauchyLoss(cauchy_a)),
+          nullptr, parameter_blocks);
+    } else {
+      for (int i = 0; i < num_observations; i++) {
+        problem.AddResidualBlock(
+            new bs_constraints::EuclideanReprojection(
+                Eigen::Matrix2d::Identity(), pixels[i], K, T_CAM_BASELINK),
+            new ceres::CauchyLoss(cauchy_a), orientation->data(),
+            position->data(), landmarks[i]->data());
+      }
+    }
+    problem.Evaluate(ceres::Problem::EvaluateOptions(), &cost, nullptr,
+                     &gradient, nullptr);
+  };
+
+  double frame_cost, cost;
+  std::vector<double> frame_gradient, gradient;
+  evaluate(true, frame_cost, frame_gradient);
+  evaluate(false, cost, gradient);
+
+  EXPECT_NEAR(frame_cost, cost, 1e-6 * cost);
+  ASSERT_EQ(frame_gradient.size(), gradient.size());
+  for (int i = 0; i < gradient.size(); i++) {
+    EXPECT_NEAR(frame_gradient[i], gradient[i],
+                1e-6 * std::max(1.0, std::abs(gradient[i])));
+  }
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,194 @@
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <fuse_core/transaction.h>
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <gtest/gtest.h>
+
+#include <bs_common/graph_recorder.h>
+#include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
+#include <bs_variables/orientation_3d.h>
+#include <bs_variables/position_3d.h>
+
+namespace {
+
+std::string TestDirectory() {
+  const std::string directory =
+      "/tmp/bs_constraints_graph_recorder_test_" + std::to_string(getpid());
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+
+// sliding window of poses linked by lidar relative poses, with one state per
+// update
+class Window {
+public:
+  Window() {
+    auto transaction = fuse_core::Transaction::make_shared();
+    transaction->addVariable(position_extrinsics_);
+    transaction->addVariable(orientation_extrinsics_);
+    graph_.update(*transaction);
+    graph_.holdVariable(position_extrinsics_->uuid(), true);
+  }
+
+  void AddState(int i) {
+    auto transaction = fuse_core::Transaction::make_shared();
+    const ros::Time stamp(1 + 0.1 * i);
+    auto position = fuse_variables::Position3DStamped::make_shared(stamp);
+    auto orientation = fuse_variables::Orientation3DStamped::make_shared(stamp);
+    position->x() = 0.1 * i;
+    position->y() = 0.02 * i;
+    orientation->w() = std::cos(0.005 * i);
+    orientation->z() = std::sin(0.005 * i);
+    transaction->addVariable(position);
+    transaction->addVariable(orientation);
+    if (!positions_.empty()) {
+      fuse_core::Vector7d delta;
+      delta << 0.1, 0.02, 0, std::cos(0.005), 0, 0, std::sin(0.005);
+      transaction->addConstraint(
+          bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint::
+              make_shared("lidar", *positions_.back(), *orientations_.back(),
+                          *position, *orientation, *position_extrinsics_,
+                          *orientation_extrinsics_, delta,
+                          1e-3 * fuse_core::Matrix6d::Identity()));
+    }
+    graph_.update(*transaction);
+    positions_.push_back(position);
+    orientations_.push_back(orientation);
+  }
+
+  // marginalize the oldest state
+  void RemoveState() {
+    std::vector<fuse_core::UUID> constraints;
+    for (const auto& constraint :
+         graph_.getConnectedConstraints(positions_.front()->uuid())) {
+      constraints.push_back(constraint.uuid());
+    }
+    for (const auto& uuid : constraints) { graph_.removeConstraint(uuid); }
+    graph_.removeVariable(positions_.front()->uuid());
+    graph_.removeVariable(orientations_.front()->uuid());
+    positions_.erase(positions_.begin());
+    orientations_.erase(orientations_.begin());
+  }
+
+  // the optimizer moves all states
+  void Optimize(double offset) {
+    for (const auto& position : positions_) {
+      graph_.getVariable(position->uuid()).data()[2] += offset;
+    }
+  }
+
+  fuse_graphs::HashGraph& graph() { return graph_; }
+
+private:
+  fuse_graphs::HashGraph graph_;
+  bs_variables::Position3D::SharedPtr position_extrinsics_{
+      bs_variables::Position3D::make_shared("imu", "lidar")};
+  bs_variables::Orientation3D::SharedPtr orientation_extrinsics_{
+      bs_variables::Orientation3D::make_shared("imu", "lidar")};
+  std::vector<fuse_variables::Position3DStamped::SharedPtr> positions_;
+  std::vector<fuse_variables::Orientation3DStamped::SharedPtr> orientations_;
+};
+
+void ExpectSameGraph(const fuse_core::Graph& expected,
+                     const fuse_core::Graph& actual) {
+  for (const auto& variable : actual.getVariables()) {
+    ASSERT_TRUE(expected.variableExists(variable.uuid()));
+    const auto& expected_variable = expected.getVariable(variable.uuid());
+    ASSERT_EQ(variable.type(), expected_variable.type());
+    for (size_t i = 0; i < variable.size(); i++) {
+      EXPECT_EQ(variable.data()[i], expected_variable.data()[i]);
+    }
+    EXPECT_EQ(actual.isVariableOnHold(variable.uuid()),
+              expected.isVariableOnHold(variable.uuid()));
+  }
+  for (const auto& variable : expected.getVariables()) {
+    EXPECT_TRUE(actual.variableExists(variable.uuid()));
+  }
+
+  for (const auto& constraint : actual.getConstraints()) {
+    ASSERT_TRUE(expected.constraintExists(constraint.uuid()));
+    EXPECT_EQ(constraint.variables(),
+              expected.getConstraint(constraint.uuid()).variables());
+  }
+  for (const auto& constraint : expected.getConstraints()) {
+    EXPECT_TRUE(actual.constraintExists(constraint.uuid()));
+  }
+}
+
+} // namespace
+
+TEST(GraphRecorder, RecordRead) {
+  const std::string directory = TestDirectory();
+  constexpr int kNumUpdates = 7;
+  constexpr int kWindowSize = 3;
+
+  // graphs passed to the recorder are not modified, and kept to check the
+  // reconstructed ones
+  std::vector<fuse_core::Graph::ConstSharedPtr> expected;
+  {
+    bs_common::GraphRecorder::Params params;
+    params.snapshot_period = 3;
+    bs_common::GraphRecorder recorder(directory, params);
+    Window window;
+    for (int i = 0; i < kNumUpdates; i++) {
+      window.AddState(i);
+      if (i >= kWindowSize) { window.RemoveState(); }
+      window.Optimize(0.01);
+      if (i == 4) {
+        window.graph().holdVariable(
+            bs_variables::Position3D("imu", "lidar").uuid(), false);
+      }
+      expected.push_back(window.graph().clone());
+      EXPECT_TRUE(recorder.Record(expected.back(), 10 + i, ros::Time(1 + i)));
+    }
+    EXPECT_EQ(recorder.NumDropped(), 0);
+  }
+
+  // first updates of each segment
+  EXPECT_TRUE(std::filesystem::exists(directory + "/graph_10.bin"));
+  EXPECT_TRUE(std::filesystem::exists(directory + "/graph_13.bin"));
+  EXPECT_TRUE(std::filesystem::exists(directory + "/graph_16.bin"));
+
+  bs_common::GraphRecording recording;
+  ASSERT_TRUE(recording.Open(directory));
+  const std::vector<uint64_t> updates = recording.Updates();
+  ASSERT_EQ(updates.size(), kNumUpdates);
+  for (int i = 0; i < kNumUpdates; i++) {
+    EXPECT_EQ(updates[i], 10 + i);
+    fuse_graphs::HashGraph actual;
+    ros::Time stamp;
+    ASSERT_TRUE(recording.Read(updates[i], actual, &stamp));
+    EXPECT_EQ(stamp, ros::Time(1 + i));
+    ExpectSameGraph(*expected[i], actual);
+  }
+
+  fuse_graphs::HashGraph actual;
+  EXPECT_FALSE(recording.Read(100, actual));
+  std::filesystem::remove_all(directory);
+}
+
+TEST(GraphRecorder, UnclosedSegment) {
+  const std::string directory = TestDirectory();
+  bs_common::GraphRecording recording;
+  EXPECT_FALSE(recording.Open(directory));
+
+  // a segment which was not closed, e.g. after a crash, is skipped
+  bs_common::ChunkFileWriter writer;
+  ASSERT_TRUE(writer.Open(directory + "/graph_0.bin",
+                          bs_common::kGraphRecordingVersion));
+  EXPECT_FALSE(recording.Open(directory));
+  std::filesystem::remove_all(directory);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,10 +1,17 @@
 #pragma once
 
 #include <beam_utils/utils.h>
+#include <ceres/autodiff_cost_function.h>
 #include <gtest/gtest.h>
 
 #include <bs_common/imu_state.h>
+#include <bs_constraints/global/normal_prior_pose_3d_function.h>
+#include <bs_constraints/inertial/normal_prior_imu_state_3d_cost_functor.h>
+#include <bs_constraints/inertial/normal_prior_imu_state_3d_function.h>
 #include <bs_constraints/jacobians.h>
+#include <bs_constraints/relative_pose/delta_pose_3d_with_extrinsics_cost_function.h>
+#include <bs_constraints/relative_pose/delta_pose_3d_with_extrinsics_cost_functor.h>
+#include <fuse_constraints/normal_prior_pose_3d_cost_functor.h>
 
 constexpr double EPS = 1e-8;
 constexpr double THRESHOLD = 1e-6;
@@ -389,6 +396,198 @@ TEST(DPointInverseTransformationDRotation, naive_parameterization) {
   }
 }
 
+TEST(SO3RightJacobianInverse, validity) {
+  for (int i = 0; i < N; i++) {
+    // random rotation, and one close to identity
+    for (double scale : {1.0, 1e-7}) {
+      Eigen::Vector3d phi = scale * beam::UniformRandomVector<3>(-1.0, 1.0);
+      Eigen::Quaterniond q(Eigen::AngleAxisd(phi.norm(), phi.normalized()));
+
+      // compute analytical jacobian
+      const auto J_analytical = bs_constraints::SO3RightJacobianInverse(phi);
+
+      // calculate numerical jacobian
+      Eigen::Matrix<double, 3, 3> J_numerical;
+      const Eigen::Vector3d res =
+          SO3BoxMinus(Eigen::Quaterniond::Identity(), q);
+      for (int j = 0; j < 3; j++) {
+        Eigen::Vector3d pert = Eigen::Vector3d::Zero();
+        pert[j] = EPS;
+        const Eigen::Vector3d res_pert = SO3BoxMinus(
+            Eigen::Quaterniond::Identity(), SO3BoxPlus(q, pert));
+        J_numerical.col(j) = (res_pert - res) / EPS;
+      }
+      EXPECT_TRUE(J_numerical.isApprox(J_analytical, THRESHOLD));
+    }
+  }
+}
+
+TEST(DeltaPose3DWithExtrinsics, validity) {
+  for (int i = 0; i < N; i++) {
+    // random poses and extrinsics, positions then quaternions (w, x, y, z)
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts;
+    std::vector<std::vector<double>> parameters;
+    for (int j = 0; j < 3; j++) {
+      Ts.push_back(beam::GenerateRandomPose(1.0, 10.0));
+      Eigen::Quaterniond q(Ts[j].block<3, 3>(0, 0));
+      parameters.push_back({Ts[j](0, 3), Ts[j](1, 3), Ts[j](2, 3)});
+      parameters.push_back({q.w(), q.x(), q.y(), q.z()});
+    }
+
+    // measurement close to the relative sensor pose, and random information
+    Eigen::Matrix4d T_noise = Eigen::Matrix4d::Identity();
+    T_noise.block<3, 3>(0, 0) =
+        Eigen::AngleAxisd(0.1, beam::UniformRandomVector<3>(-1.0, 1.0)
+                                   .normalized())
+            .toRotationMatrix();
+    T_noise.block<3, 1>(0, 3) = beam::UniformRandomVector<3>(-0.1, 0.1);
+    Eigen::Matrix4d T_S1_S2 = beam::InvertTransform(Ts[0] * Ts[2]) * Ts[1] *
+                              Ts[2] * T_noise;
+    Eigen::Quaterniond q_S1_S2(T_S1_S2.block<3, 3>(0, 0));
+    fuse_core::Vector7d d_S1_S2;
+    d_S1_S2 << T_S1_S2(0, 3), T_S1_S2(1, 3), T_S1_S2(2, 3), q_S1_S2.w(),
+        q_S1_S2.x(), q_S1_S2.y(), q_S1_S2.z();
+    fuse_core::Matrix6d sqrt_info = fuse_core::Matrix6d::Identity() * 10;
+    for (int j = 0; j < 6; j++) {
+      for (int k = j + 1; k < 6; k++) { sqrt_info(j, k) = beam::randf(0, 1); }
+    }
+
+    bs_constraints::DeltaPose3DWithExtrinsics analytic(sqrt_info, d_S1_S2);
+    ceres::AutoDiffCostFunction<DeltaPose3DWithExtrinsicsCostFunctor, 6, 3, 4,
+                                3, 4, 3, 4>
+        autodiff(new DeltaPose3DWithExtrinsicsCostFunctor(sqrt_info, d_S1_S2));
+
+    std::vector<const double*> parameter_ptrs;
+    for (const auto& p : parameters) { parameter_ptrs.push_back(p.data()); }
+    double residual_analytic[6];
+    double residual_autodiff[6];
+    std::vector<std::vector<double>> J_analytic;
+    std::vector<std::vector<double>> J_autodiff;
+    std::vector<double*> J_analytic_ptrs;
+    std::vector<double*> J_autodiff_ptrs;
+    for (const auto& p : parameters) {
+      J_analytic.emplace_back(6 * p.size());
+      J_autodiff.emplace_back(6 * p.size());
+    }
+    for (int j = 0; j < 6; j++) {
+      J_analytic_ptrs.push_back(J_analytic[j].data());
+      J_autodiff_ptrs.push_back(J_autodiff[j].data());
+    }
+    ASSERT_TRUE(analytic.Evaluate(parameter_ptrs.data(), residual_analytic,
+                                  J_analytic_ptrs.data()));
+    ASSERT_TRUE(autodiff.Evaluate(parameter_ptrs.data(), residual_autodiff,
+                                  J_autodiff_ptrs.data()));
+
+    // the residual is invariant to the scale of the quaternions, so the
+    // autodiff jacobians are also in their tangent space
+    for (int j = 0; j < 6; j++) {
+      EXPECT_NEAR(residual_analytic[j], residual_autodiff[j], THRESHOLD);
+    }
+    for (int j = 0; j < 6; j++) {
+      for (int k = 0; k < J_analytic[j].size(); k++) {
+        EXPECT_NEAR(J_analytic[j][k], J_autodiff[j][k], 1e-5);
+      }
+    }
+  }
+}
+
+void ExpectEqualCostFunctions(
+    const ceres::CostFunction& analytic, const ceres::CostFunction& autodiff,
+    const std::vector<std::vector<double>>& parameters) {
+  const int num_residuals = analytic.num_residuals();
+  std::vector<const double*> parameter_ptrs;
+  for (const auto& p : parameters) { parameter_ptrs.push_back(p.data()); }
+  std::vector<double> residual_analytic(num_residuals);
+  std::vector<double> residual_autodiff(num_residuals);
+  std::vector<std::vector<double>> J_analytic;
+  std::vector<std::vector<double>> J_autodiff;
+  std::vector<double*> J_analytic_ptrs;
+  std::vector<double*> J_autodiff_ptrs;
+  for (const auto& p : parameters) {
+    J_analytic.emplace_back(num_residuals * p.size());
+    J_autodiff.emplace_back(num_residuals * p.size());
+  }
+  for (int j = 0; j < parameters.size(); j++) {
+    J_analytic_ptrs.push_back(J_analytic[j].data());
+    J_autodiff_ptrs.push_back(J_autodiff[j].data());
+  }
+  ASSERT_TRUE(analytic.Evaluate(parameter_ptrs.data(), residual_analytic.data(),
+                                J_analytic_ptrs.data()));
+  ASSERT_TRUE(autodiff.Evaluate(parameter_ptrs.data(), residual_autodiff.data(),
+                                J_autodiff_ptrs.data()));
+  for (int j = 0; j < num_residuals; j++) {
+    EXPECT_NEAR(residual_analytic[j], residual_autodiff[j], THRESHOLD);
+  }
+  for (int j = 0; j < parameters.size(); j++) {
+    for (int k = 0; k < J_analytic[j].size(); k++) {
+      EXPECT_NEAR(J_analytic[j][k], J_autodiff[j][k], 1e-5);
+    }
+  }
+}
+
+TEST(NormalPriorPose3D, validity) {
+  for (int i = 0; i < N; i++) {
+    // random pose and a prior close to it
+    const Eigen::Matrix4d T = beam::GenerateRandomPose(1.0, 10.0);
+    const Eigen::Quaterniond q(T.block<3, 3>(0, 0));
+    const std::vector<std::vector<double>> parameters{
+        {T(0, 3), T(1, 3), T(2, 3)}, {q.w(), q.x(), q.y(), q.z()}};
+    const Eigen::Quaterniond q_prior =
+        q * Eigen::AngleAxisd(0.1, beam::UniformRandomVector<3>(-1.0, 1.0)
+                                       .normalized());
+    fuse_core::Vector7d mean;
+    mean.head<3>() =
+        T.block<3, 1>(0, 3) + beam::UniformRandomVector<3>(-0.1, 0.1);
+    mean.tail<4>() << q_prior.w(), q_prior.x(), q_prior.y(), q_prior.z();
+    fuse_core::Matrix6d sqrt_info = fuse_core::Matrix6d::Identity() * 10;
+    for (int j = 0; j < 6; j++) {
+      for (int k = j + 1; k < 6; k++) { sqrt_info(j, k) = beam::randf(0, 1); }
+    }
+
+    NormalPriorPose3D analytic(sqrt_info, mean);
+    ceres::AutoDiffCostFunction<fuse_constraints::NormalPriorPose3DCostFunctor,
+                                6, 3, 4>
+        autodiff(new fuse_constraints::NormalPriorPose3DCostFunctor(sqrt_info,
+                                                                    mean));
+    ExpectEqualCostFunctions(analytic, autodiff, parameters);
+  }
+}
+
+TEST(NormalPriorImuState3D, validity) {
+  for (int i = 0; i < N; i++) {
+    // random imu state and a prior close to it
+    const Eigen::Matrix4d T = beam::GenerateRandomPose(1.0, 10.0);
+    const Eigen::Quaterniond q(T.block<3, 3>(0, 0));
+    std::vector<std::vector<double>> parameters{{q.w(), q.x(), q.y(), q.z()},
+                                                {T(0, 3), T(1, 3), T(2, 3)}};
+    for (int j = 0; j < 3; j++) {
+      const Eigen::Vector3d x = beam::UniformRandomVector<3>(-1.0, 1.0);
+      parameters.push_back({x[0], x[1], x[2]});
+    }
+    const Eigen::Quaterniond q_prior =
+        q * Eigen::AngleAxisd(0.1, beam::UniformRandomVector<3>(-1.0, 1.0)
+                                       .normalized());
+    Eigen::Matrix<double, 16, 1> mean;
+    mean.head<4>() << q_prior.w(), q_prior.x(), q_prior.y(), q_prior.z();
+    for (int j = 0; j < 4; j++) {
+      mean.segment<3>(4 + 3 * j) =
+          Eigen::Map<const Eigen::Vector3d>(parameters[j + 1].data()) +
+          beam::UniformRandomVector<3>(-0.1, 0.1);
+    }
+    Eigen::Matrix<double, 15, 15> sqrt_info =
+        Eigen::Matrix<double, 15, 15>::Identity() * 10;
+    for (int j = 0; j < 15; j++) {
+      for (int k = j + 1; k < 15; k++) { sqrt_info(j, k) = beam::randf(0, 1); }
+    }
+
+    NormalPriorImuState3D analytic(sqrt_info, mean);
+    ceres::AutoDiffCostFunction<NormalPriorImuState3DCostFunctor, 15, 4, 3, 3,
+                                3, 3>
+        autodiff(new NormalPriorImuState3DCostFunctor(sqrt_info, mean));
+    ExpectEqualCostFunctions(analytic, autodiff, parameters);
+  }
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <ceres/autodiff_cost_function.h>
+#include <ceres/ceres.h>
+#include <gtest/gtest.h>
+
+#include <bs_common/imu_state.h>
+#include <bs_common/preintegrator.h>
+#include <bs_constraints/inertial/normal_delta_imu_state_3d_cost_functor.h>
+#include <bs_constraints/inertial/normal_delta_imu_state_3d_function.h>
+
+using bs_constraints::NormalDeltaImuState3DCostFunctor;
+using AutoDiffNormalDeltaImuState3D =
+    ceres::AutoDiffCostFunction<NormalDeltaImuState3DCostFunctor, 15, 4, 3, 3,
+                                3, 3, 4, 3, 3, 3, 3>;
+
+constexpr double THRESHOLD = 1e-5;
+
+// evaluates the jacobian of a cost function in the local parameterization of
+// each variable
+ceres::CRSMatrix
+    EvaluateJacobian(ceres::CostFunction* cost_function,
+                     const std::vector<fuse_core::Variable*>& variables) {
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+
+  std::vector<double*> parameter_blocks;
+  for (auto variable : variables) {
+    problem.AddParameterBlock(variable->data(), variable->size(),
+                              variable->localParameterization());
+    parameter_blocks.push_back(variable->data());
+  }
+  ceres::TrivialLoss loss_function;
+  problem.AddResidualBlock(cost_function, &loss_function, parameter_blocks);
+
+  double cost = 0.0;
+  ceres::CRSMatrix jacobian;
+  problem.Evaluate(ceres::Problem::EvaluateOptions(), &cost, nullptr, nullptr,
+                   &jacobian);
+  return jacobian;
+}
+
+class NormalDeltaImuState3DData {
+public:
+  NormalDeltaImuState3DData() {
+    // biases used to integrate
+    const Eigen::Vector3d bg(0.01, -0.02, 0.015);
+    const Eigen::Vector3d ba(0.1, 0.05, -0.08);
+
+    pre_integrator = std::make_shared<bs_common::PreIntegrator>();
+    pre_integrator->cov_w = 1e-4 * Eigen::Matrix3d::Identity();
+    pre_integrator->cov_a = 1e-3 * Eigen::Matrix3d::Identity();
+    pre_integrator->cov_bg = 1e-6 * Eigen::Matrix3d::Identity();
+    pre_integrator->cov_ba = 1e-5 * Eigen::Matrix3d::Identity();
+    for (int i = 0; i <= 100; i++) {
+      bs_common::IMUData imu_data;
+      imu_data.t = ros::Time(1.0 + 0.005 * i);
+      imu_data.w = 0.5 * Eigen::Vector3d::Random();
+      imu_data.a = Eigen::Vector3d(0, 0, 9.81) + Eigen::Vector3d::Random();
+      pre_integrator->AddData(imu_data);
+    }
+    pre_integrator->Integrate(ros::Time(1.5), bg, ba, true, true, true);
+
+    const Eigen::Quaterniond q_i = Eigen::Quaterniond::UnitRandom();
+    const Eigen::Vector3d p_i = Eigen::Vector3d::Random();
+    const Eigen::Vector3d v_i = Eigen::Vector3d::Random();
+    imu_state_i = bs_common::ImuState(ros::Time(1.0), q_i, p_i, v_i, bg, ba);
+
+    // perturb the states away from the measurement, and the biases of state i
+    // away from the linearization point so the bias correction is exercised
+    const Eigen::Vector3d bg_i = bg + 0.01 * Eigen::Vector3d::Random();
+    const Eigen::Vector3d ba_i = ba + 0.01 * Eigen::Vector3d::Random();
+    bs_common::ImuState state_i(ros::Time(1.0), q_i, p_i, v_i, bg_i, ba_i);
+    const Eigen::Quaterniond q_noise(
+        Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitX()));
+    bs_common::ImuState state_j(
+        ros::Time(1.5), q_i * pre_integrator->delta.q * q_noise,
+        p_i + Eigen::Vector3d::Random(), v_i + Eigen::Vector3d::Random(),
+        bg_i + 0.01 * Eigen::Vector3d::Random(),
+        ba_i + 0.01 * Eigen::Vector3d::Random());
+
+    orientation_i = state_i.Orientation();
+    position_i = state_i.Position();
+    velocity_i = state_i.Velocity();
+    gyro_bias_i = state_i.GyroBias();
+    accel_bias_i = state_i.AccelBias();
+    orientation_j = state_j.Orientation();
+    position_j = state_j.Position();
+    velocity_j = state_j.Velocity();
+    gyro_bias_j = state_j.GyroBias();
+    accel_bias_j = state_j.AccelBias();
+    variables = {&orientation_i, &position_i,   &velocity_i, &gyro_bias_i,
+                 &accel_bias_i,  &orientation_j, &position_j, &velocity_j,
+                 &gyro_bias_j,   &accel_bias_j};
+  }
+
+  std::shared_ptr<bs_common::PreIntegrator> pre_integrator;
+  bs_common::ImuState imu_state_i;
+  fuse_variables::Orientation3DStamped orientation_i;
+  fuse_variables::Position3DStamped position_i;
+  fuse_variables::VelocityLinear3DStamped velocity_i;
+  bs_variables::GyroscopeBias3DStamped gyro_bias_i;
+  bs_variables::AccelerationBias3DStamped accel_bias_i;
+  fuse_variables::Orientation3DStamped orientation_j;
+  fuse_variables::Position3DStamped position_j;
+  fuse_variables::VelocityLinear3DStamped velocity_j;
+  bs_variables::GyroscopeBias3DStamped gyro_bias_j;
+  bs_variables::AccelerationBias3DStamped accel_bias_j;
+  std::vector<fuse_core::Variable*> variables;
+};
+
+TEST(NormalDeltaImuState3D, Validity) {
+  for (int n = 0; n < 20; n++) {
+    NormalDeltaImuState3DData data;
+    bs_constraints::NormalDeltaImuState3D analytic(data.imu_state_i,
+                                                   *data.pre_integrator, 2.0);
+    AutoDiffNormalDeltaImuState3D autodiff(
+        new NormalDeltaImuState3DCostFunctor(
+            data.imu_state_i, data.pre_integrator, 2.0));
+
+    std::vector<const double*> parameters;
+    for (auto variable : data.variables) {
+      parameters.push_back(variable->data());
+    }
+    double residual_analytic[15];
+    double residual_autodiff[15];
+    analytic.Evaluate(parameters.data(), residual_analytic, nullptr);
+    autodiff.Evaluate(parameters.data(), residual_autodiff, nullptr);
+    for (int i = 0; i < 15; i++) {
+      EXPECT_NEAR(residual_analytic[i], residual_autodiff[i], THRESHOLD);
+    }
+
+    const ceres::CRSMatrix J_analytic =
+        EvaluateJacobian(&analytic, data.variables);
+    const ceres::CRSMatrix J_autodiff =
+        EvaluateJacobian(&autodiff, data.variables);
+    ASSERT_EQ(J_analytic.values.size(), J_autodiff.values.size());
+    EXPECT_EQ(J_analytic.rows, J_autodiff.rows);
+    EXPECT_EQ(J_analytic.cols, J_autodiff.cols);
+    for (int i = 0; i < J_analytic.values.size(); i++) {
+      // the weighted jacobians can be large, so compare relative to their size
+      const double scale = std::max(1.0, std::abs(J_autodiff.values[i]));
+      EXPECT_NEAR(J_analytic.values[i] / scale, J_autodiff.values[i] / scale,
+                  THRESHOLD);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,158 @@
+#include <vector>
+
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <gtest/gtest.h>
+
+#include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
+#include <bs_constraints/transaction_batch.h>
+
+namespace {
+
+fuse_variables::Position3DStamped::SharedPtr Position(double t, double x) {
+  auto position = fuse_variables::Position3DStamped::make_shared(ros::Time(t));
+  position->x() = x;
+  return position;
+}
+
+std::vector<fuse_core::UUID>
+    AddedVariables(const fuse_core::Transaction& transaction) {
+  std::vector<fuse_core::UUID> uuids;
+  for (const auto& variable : transaction.addedVariables()) {
+    uuids.push_back(variable.uuid());
+  }
+  return uuids;
+}
+
+double X(const fuse_core::Transaction& transaction,
+         const fuse_core::UUID& uuid) {
+  for (const auto& variable : transaction.addedVariables()) {
+    if (variable.uuid() == uuid) {
+      return dynamic_cast<const fuse_variables::Position3DStamped&>(variable)
+          .x();
+    }
+  }
+  return -1;
+}
+
+// chain of poses where each pose transaction also adds the previous pose, as
+// done by the scan registration
+void AddPoses(bs_constraints::Pose3DStampedTransaction& transaction,
+              int num_poses) {
+  fuse_variables::Orientation3DStamped o1(ros::Time(1));
+  fuse_variables::Position3DStamped p1(ros::Time(1));
+  transaction.AddPoseVariables(p1, o1, ros::Time(1));
+  for (int i = 2; i <= num_poses; i++) {
+    fuse_variables::Orientation3DStamped o2(ros::Time(i));
+    fuse_variables::Position3DStamped p2(ros::Time(i));
+    p2.x() = i;
+    Eigen::Matrix<double, 7, 1> delta;
+    delta << 1, 0, 0, 1, 0, 0, 0;
+    transaction.AddPoseVariables(p1, o1, p1.stamp());
+    transaction.AddPoseVariables(p2, o2, p2.stamp());
+    transaction.AddPoseConstraint(p1, p2, o1, o2, delta,
+                                  Eigen::Matrix<double, 6, 6>::Identity(),
+                                  "test");
+    o1 = o2;
+    p1 = p2;
+  }
+}
+
+} // namespace
+
+TEST(TransactionBatch, KeepsFirstUnlessOverwritten) {
+  bs_constraints::TransactionBatch batch;
+  batch.Reserve(4, 0);
+  batch.AddVariable(Position(1, 1));
+  batch.AddVariable(Position(2, 2));
+  batch.AddVariable(Position(1, 3));
+  batch.AddVariable(Position(2, 4), true);
+  EXPECT_EQ(batch.NumVariables(), 4);
+
+  fuse_core::Transaction transaction;
+  batch.MoveInto(transaction);
+  EXPECT_TRUE(batch.Empty());
+  const auto uuids = AddedVariables(transaction);
+  ASSERT_EQ(uuids.size(), 2);
+  EXPECT_EQ(uuids[0], Position(1, 0)->uuid());
+  EXPECT_EQ(uuids[1], Position(2, 0)->uuid());
+  EXPECT_EQ(X(transaction, uuids[0]), 1);
+  EXPECT_EQ(X(transaction, uuids[1]), 4);
+}
+
+TEST(TransactionBatch, MatchesSequentialTransaction) {
+  std::vector<std::pair<fuse_core::Variable::SharedPtr, bool>> variables;
+  for (int i = 0; i < 50; i++) {
+    variables.emplace_back(Position(i % 7, i), i % 3 == 0);
+  }
+  fuse_core::Transaction expected;
+  bs_constraints::TransactionBatch batch;
+  for (const auto& [variable, overwrite] : variables) {
+    expected.addVariable(variable, overwrite);
+    batch.AddVariable(variable, overwrite);
+    batch.AddInvolvedStamp(
+        dynamic_cast<const fuse_variables::Position3DStamped&>(*variable)
+            .stamp());
+  }
+  fuse_core::Transaction transaction;
+  batch.MoveInto(transaction);
+
+  EXPECT_EQ(AddedVariables(transaction), AddedVariables(expected));
+  for (const auto& uuid : AddedVariables(expected)) {
+    EXPECT_EQ(X(transaction, uuid), X(expected, uuid));
+  }
+  const auto stamps = transaction.involvedStamps();
+  EXPECT_EQ(std::distance(stamps.begin(), stamps.end()), 7);
+}
+
+TEST(TransactionBatch, MergeClonesTransaction) {
+  fuse_core::Transaction other;
+  auto position = Position(1, 1);
+  other.addVariable(position);
+  other.addInvolvedStamp(ros::Time(1));
+
+  bs_constraints::TransactionBatch batch;
+  batch.Merge(other);
+  bs_constraints::TransactionBatch merged;
+  merged.Merge(batch);
+  position->x() = 2;
+
+  auto transaction = merged.ToTransaction(ros::Time(5));
+  EXPECT_EQ(transaction->stamp(), ros::Time(5));
+  EXPECT_EQ(X(*transaction, position->uuid()), 1);
+  const auto stamps = transaction->involvedStamps();
+  EXPECT_EQ(std::distance(stamps.begin(), stamps.end()), 1);
+}
+
+TEST(TransactionBatch, Pose3DStampedTransactionReserve) {
+  bs_constraints::Pose3DStampedTransaction expected(ros::Time(1));
+  AddPoses(expected, 20);
+  bs_constraints::Pose3DStampedTransaction batched(ros::Time(1));
+  batched.Reserve(80, 20);
+  AddPoses(batched, 20);
+
+  auto expected_transaction = expected.GetTransaction();
+  auto transaction = batched.GetTransaction();
+  ASSERT_TRUE(transaction);
+  EXPECT_EQ(AddedVariables(*transaction),
+            AddedVariables(*expected_transaction));
+  const auto constraints = transaction->addedConstraints();
+  const auto expected_constraints = expected_transaction->addedConstraints();
+  ASSERT_EQ(std::distance(constraints.begin(), constraints.end()),
+            std::distance(expected_constraints.begin(),
+                          expected_constraints.end()));
+  const auto stamps = transaction->involvedStamps();
+  EXPECT_EQ(std::distance(stamps.begin(), stamps.end()), 20);
+
+  // the same transaction is returned, with the elements added since
+  AddPoses(batched, 21);
+  EXPECT_EQ(batched.GetTransaction(), transaction);
+  EXPECT_EQ(AddedVariables(*transaction).size(), 42);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <vector>
+
+#include <ceres/autodiff_cost_function.h>
+#include <gtest/gtest.h>
+
+#include <bs_constraints/motion/unicycle_3d_state_cost_function.h>
+#include <bs_constraints/motion/unicycle_3d_state_cost_functor.h>
+
+using AutoDiffUnicycle3DState =
+    ceres::AutoDiffCostFunction<bs_constraints::Unicycle3DStateCostFunctor, 15,
+                                3, 4, 3, 3, 3, 3, 4, 3, 3, 3>;
+
+constexpr double THRESHOLD = 1e-8;
+const std::vector<int> BLOCK_SIZES{3, 4, 3, 3, 3, 3, 4, 3, 3, 3};
+
+TEST(Unicycle3DStateCostFunction, Validity) {
+  for (int n = 0; n < 50; n++) {
+    // random states, with the second state close to the prediction so the
+    // angle residuals don't wrap
+    std::vector<std::vector<double>> parameters;
+    for (const auto size : BLOCK_SIZES) {
+      std::vector<double> block(size);
+      Eigen::Map<Eigen::VectorXd> block_map(block.data(), size);
+      block_map = Eigen::VectorXd::Random(size);
+      if (size == 4) { block_map.normalize(); }
+      parameters.push_back(block);
+    }
+    const Eigen::Quaterniond q1(parameters[1][0], parameters[1][1],
+                                parameters[1][2], parameters[1][3]);
+    const Eigen::Vector3d axis = Eigen::Vector3d(1, 2, 3).normalized();
+    const Eigen::Quaterniond q2 =
+        q1 * Eigen::Quaterniond(Eigen::AngleAxisd(0.1, axis));
+    parameters[6] = {q2.w(), q2.x(), q2.y(), q2.z()};
+
+    const double dt = 0.1 + 0.05 * n / 50.0;
+    fuse_core::Matrix15d A = fuse_core::Matrix15d::Random();
+    A += 5.0 * fuse_core::Matrix15d::Identity();
+    bs_constraints::Unicycle3DStateCostFunction analytic(dt, A);
+    AutoDiffUnicycle3DState autodiff(
+        new bs_constraints::Unicycle3DStateCostFunctor(dt, A));
+
+    std::vector<const double*> parameter_ptrs;
+    std::vector<std::vector<double>> J_analytic;
+    std::vector<std::vector<double>> J_autodiff;
+    for (size_t i = 0; i < parameters.size(); i++) {
+      parameter_ptrs.push_back(parameters[i].data());
+      J_analytic.emplace_back(15 * BLOCK_SIZES[i]);
+      J_autodiff.emplace_back(15 * BLOCK_SIZES[i]);
+    }
+    std::vector<double*> J_analytic_ptrs;
+    std::vector<double*> J_autodiff_ptrs;
+    for (size_t i = 0; i < parameters.size(); i++) {
+      J_analytic_ptrs.push_back(J_analytic[i].data());
+      J_autodiff_ptrs.push_back(J_autodiff[i].data());
+    }
+
+    double residual_analytic[15];
+    double residual_autodiff[15];
+    ASSERT_TRUE(analytic.Evaluate(parameter_ptrs.data(), residual_analytic,
+                                  J_analytic_ptrs.data()));
+    ASSERT_TRUE(autodiff.Evaluate(parameter_ptrs.data(), residual_autodiff,
+                                  J_autodiff_ptrs.data()));
+    for (int i = 0; i < 15; i++) {
+      EXPECT_NEAR(residual_analytic[i], residual_autodiff[i], THRESHOLD);
+    }
+    for (size_t i = 0; i < parameters.size(); i++) {
+      for (size_t j = 0; j < J_analytic[i].size(); j++) {
+        const double scale = std::max(1.0, std::abs(J_autodiff[i][j]));
+        EXPECT_NEAR(J_analytic[i][j] / scale, J_autodiff[i][j] / scale,
+                    THRESHOLD);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
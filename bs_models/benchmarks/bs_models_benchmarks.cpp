@@ -0,0 +1,107 @@
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <pcl/io/pcd_io.h>
+
+#include <beam_matching/Matchers.h>
+#include <beam_utils/math.h>
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/scan_pose.h>
+#include <bs_models/scan_registration/registration_map.h>
+
+using namespace bs_models;
+using namespace beam_matching;
+
+namespace {
+
+std::string DataPath() {
+  std::string current_file = "benchmarks/bs_models_benchmarks.cpp";
+  std::string path = __FILE__;
+  path.erase(path.end() - current_file.size(), path.end());
+  return path + "tests/data/";
+}
+
+const pcl::PointCloud<PointXYZIRT>& TestScan() {
+  static const pcl::PointCloud<PointXYZIRT> cloud = []() {
+    pcl::PointCloud<PointXYZIRT> cloud;
+    pcl::io::loadPCDFile(DataPath() + "test_scan_vlp16.pcd", cloud);
+    return cloud;
+  }();
+  return cloud;
+}
+
+std::shared_ptr<LoamFeatureExtractor> MakeFeatureExtractor() {
+  auto loam_params =
+      std::make_shared<LoamParams>(DataPath() + "loam_config.json");
+  return std::make_shared<LoamFeatureExtractor>(loam_params);
+}
+
+Eigen::Matrix4d ScanPoseAlongPath(int i) {
+  Eigen::Matrix4d T_Map_Scan = Eigen::Matrix4d::Identity();
+  T_Map_Scan.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(0.02 * i, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T_Map_Scan(0, 3) = 0.5 * i;
+  return T_Map_Scan;
+}
+
+} // namespace
+
+static void BM_ScanPoseLoamExtraction(benchmark::State& state) {
+  const pcl::PointCloud<PointXYZIRT>& cloud = TestScan();
+  const auto feature_extractor = MakeFeatureExtractor();
+  for (auto _ : state) {
+    ScanPose scan_pose(cloud, ros::Time(1), Eigen::Matrix4d::Identity(),
+                       Eigen::Matrix4d::Identity(), feature_extractor);
+    benchmark::DoNotOptimize(scan_pose.LoamCloud().edges.strong.cloud.size());
+  }
+  state.SetItemsProcessed(state.iterations() * cloud.size());
+}
+BENCHMARK(BM_ScanPoseLoamExtraction)->Unit(benchmark::kMillisecond);
+
+// decodes the regular cloud of a compressed scan pose, CloudPtr() does not
+// keep the decoded cloud so each call decodes it again
+static void BM_ScanPoseDecodeCompressed(benchmark::State& state) {
+  ScanPose scan_pose(TestScan(), ros::Time(1), Eigen::Matrix4d::Identity(),
+                     Eigen::Matrix4d::Identity(), MakeFeatureExtractor());
+  scan_pose.CompressClouds();
+  size_t num_points = 0;
+  for (auto _ : state) {
+    const auto cloud = scan_pose.CloudPtr();
+    num_points += cloud->size();
+    benchmark::DoNotOptimize(cloud->data());
+  }
+  state.SetItemsProcessed(num_points);
+}
+BENCHMARK(BM_ScanPoseDecodeCompressed)->Unit(benchmark::kMicrosecond);
+
+// Arg(0) is the map size in scans, Arg(1) whether a scan pose is updated
+// before each call so that the loam map is rebuilt instead of cached
+static void BM_RegistrationMapGetLoamCloudMap(benchmark::State& state) {
+  const int map_size = state.range(0);
+  const bool update_scan = state.range(1);
+  ScanPose scan_pose(TestScan(), ros::Time(1), Eigen::Matrix4d::Identity(),
+                     Eigen::Matrix4d::Identity(), MakeFeatureExtractor());
+  RegistrationMap map("benchmark");
+  map.SetMapSize(map_size);
+  for (int i = 0; i < map_size; i++) {
+    map.AddPointCloud(scan_pose.Cloud(), scan_pose.LoamCloud(),
+                      ros::Time(1 + i), ScanPoseAlongPath(i));
+  }
+  bool perturbed = false;
+  for (auto _ : state) {
+    if (update_scan) {
+      perturbed = !perturbed;
+      map.UpdateScan(ros::Time(1), ScanPoseAlongPath(perturbed ? 1 : 0));
+    }
+    benchmark::DoNotOptimize(map.GetLoamCloudMapPtr());
+  }
+}
+BENCHMARK(BM_RegistrationMapGetLoamCloudMap)
+    ->Args({10, 0})
+    ->Args({10, 1})
+    ->Args({30, 1})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <opencv2/opencv.hpp>
 #include <ros/ros.h>
 
@@ -7,6 +13,7 @@
 
 #include <bs_common/bs_msgs.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_models/scan_registration/voxel_map.h>
 
 namespace bs_models::experimental {
 
@@ -40,9 +47,43 @@ namespace bs_models::experimental {
  * those with loop closure, their poses relative to the local mapper's world
  * frame is always returned.
  *
+ * The submap data is stored as immutable snapshots (see SubmapSnapshot). A new
+ * snapshot is fully built before being swapped in, so readers never wait on a
+ * submap update and a snapshot held by a reader stays valid, unchanged, until
+ * the reader releases it.
+ *
+ * The active submap is the union of the last max_submaps submaps received
+ * (see SetMaxSubmaps). Lidar and loam points are stored in voxel hash maps
+ * where each submap keeps its own contribution, so a submap update only
+ * removes the previous points of that submap and adds its new ones instead of
+ * replacing the whole map, and the map size is bounded by the volume it
+ * covers rather than the number of submaps. Visual map points are stored in
+ * slots reused through a free list, so removing one is O(1). Snapshots are
+ * built from these after each update.
  */
 class ActiveSubmap {
 public:
+  /**
+   * @brief Immutable submap data. The clouds must not be modified once the
+   * snapshot is shared, they are only non-const pointers since the matchers
+   * take non-const inputs
+   */
+  struct SubmapSnapshot {
+    PointCloudPtr lidar_map_points{std::make_shared<PointCloud>()};
+    beam_matching::LoamPointCloudPtr loam_cloud{
+        std::make_shared<beam_matching::LoamPointCloud>()};
+    PointCloudPtr visual_map_points{std::make_shared<PointCloud>()};
+    std::vector<uint32_t> word_ids;
+
+    /** slot of each visual map point, see RemoveVisualMapPoint */
+    std::vector<uint32_t> visual_map_slots;
+
+    ros::Time update_time{0};
+    int update_id{0};
+  };
+
+  using SnapshotConstPtr = std::shared_ptr<const SubmapSnapshot>;
+
   /**
    * @brief Static Instance getter (singleton)
    * @return reference to the singleton
@@ -60,11 +101,55 @@ public:
   ActiveSubmap& operator=(const ActiveSubmap& other) = delete;
 
   /**
-   * @brief Updates the data with the new submap message
+   * @brief Updates the data with the new submap message, see MergeSubmap
    * @param message odometry message
    */
   void ActiveSubmapCallback(const bs_common::SubmapMsg::ConstPtr& msg);
 
+  /**
+   * @brief Merge a submap into the active submap. If the submap is already in
+   * the active submap, its previous points are replaced. Otherwise it is
+   * added, and the oldest submaps (lowest ids) are removed to keep at most
+   * max_submaps. A new snapshot is then published.
+   * @param submap_id id of the submap, ids must increase with new submaps
+   * @param lidar_points lidar points in the world frame
+   * @param loam_cloud loam points in the world frame
+   * @param visual_map_points visual map points in the world frame
+   * @param word_ids word id of each visual map point
+   */
+  void MergeSubmap(uint64_t submap_id, const PointCloud& lidar_points,
+                   const beam_matching::LoamPointCloud& loam_cloud,
+                   const PointCloud& visual_map_points,
+                   const std::vector<uint32_t>& word_ids);
+
+  /**
+   * @brief Remove a submap from the active submap and publish a new snapshot
+   * @param submap_id id used when merging the submap
+   */
+  void RemoveSubmap(uint64_t submap_id);
+
+  /**
+   * @brief Set the max number of submaps in the active submap, the oldest
+   * ones are removed on the next update. Defaults to 1, i.e. each new submap
+   * replaces the previous one
+   */
+  void SetMaxSubmaps(int max_submaps);
+
+  /**
+   * @brief Set the size of the voxels the lidar and loam points are merged
+   * into. This rebuilds the voxel maps from the submaps
+   */
+  void SetVoxelSize(double voxel_size);
+
+  /**
+   * @brief Get the current submap. This never blocks on submap updates, and
+   * the returned snapshot is not changed by later updates, so callers should
+   * get it once and use it for all their queries (e.g., a full registration).
+   * Visual map points removed since the last snapshot are applied here, unless
+   * an update is in progress in which case they are applied by the update
+   */
+  SnapshotConstPtr GetSnapshot() const;
+
   /**
    * @brief Set the publish_updates_ param. If this is set to true, it will
    * publish the maps as PointCloud2 messages each time it receives an updated
@@ -121,28 +206,94 @@ public:
   const beam_matching::LoamPointCloudPtr GetLoamMapPtr() const;
 
   /**
-   * @brief Removes a visual map point from the submap
-   * @param index of point to remove
+   * @brief Removes a visual map point from the submap. This only frees its
+   * slot, the point is removed from the snapshots returned by the next call
+   * to GetSnapshot
+   * @param index of point to remove in the current snapshot
    */
   void RemoveVisualMapPoint(size_t index);
 
 private:
+  using LoamFeatureCloud = decltype(
+      std::declval<beam_matching::LoamPointCloud>().edges.strong.cloud);
+  using LoamFeaturePointT = LoamFeatureCloud::PointType;
+
+  /** points a submap contributed, needed to remove them */
+  struct SubmapData {
+    PointCloud lidar_points;
+    beam_matching::LoamPointCloud loam_cloud;
+    std::vector<uint32_t> visual_slots;
+  };
+
+  struct VisualMapSlot {
+    pcl::PointXYZ point;
+    uint32_t word_id{0};
+    uint64_t submap_id{0};
+    bool used{false};
+  };
+
   /**
    * @brief Private constructor
    */
   ActiveSubmap();
 
+  /**
+   * @brief add or remove the points of a submap, update_mutex_ must be locked
+   */
+  void AddSubmapPoints(uint64_t submap_id, const SubmapData& submap);
+
+  void RemoveSubmapPoints(uint64_t submap_id, const SubmapData& submap);
+
+  /**
+   * @brief clear all submaps and voxel maps, update_mutex_ must be locked
+   */
+  void ClearSubmaps();
+
+  /**
+   * @brief build a snapshot from the voxel maps and visual slots, and swap it
+   * in. update_mutex_ must be locked
+   */
+  void UpdateSnapshot();
+
+  /**
+   * @brief fill the visual map of a snapshot from the used visual slots,
+   * update_mutex_ must be locked
+   */
+  void FillVisualMap(SubmapSnapshot& snapshot) const;
+
+  /**
+   * @brief swap in a new snapshot and publish it
+   */
+  void SwapSnapshot(const std::shared_ptr<SubmapSnapshot>& snapshot);
+
   /**
    * @brief Publishes map updates. See description of function
    * SetPublishUpdates()
    */
-  void Publish() const;
+  void Publish(const SubmapSnapshot& snapshot) const;
+
+  // data, the mutex only guards swapping the snapshot pointer. The snapshot
+  // is swapped by GetSnapshot when applying visual map point removals
+  mutable std::mutex snapshot_mutex_;
+  mutable SnapshotConstPtr snapshot_;
 
-  // data
-  PointCloudPtr lidar_map_points_;
-  beam_matching::LoamPointCloudPtr loam_cloud_;
-  PointCloudPtr visual_map_points_;
-  std::vector<uint32_t> word_ids_;
+  // merged submaps, guarded by update_mutex_. Readers only use snapshots
+  mutable std::mutex update_mutex_;
+  std::map<uint64_t, SubmapData> submaps_;
+  int max_submaps_{1};
+  double voxel_size_{0.05};
+  scan_registration::VoxelMap<pcl::PointXYZ> lidar_voxel_map_{voxel_size_};
+  scan_registration::VoxelMap<LoamFeaturePointT> edges_strong_voxel_map_{
+      voxel_size_};
+  scan_registration::VoxelMap<LoamFeaturePointT> edges_weak_voxel_map_{
+      voxel_size_};
+  scan_registration::VoxelMap<LoamFeaturePointT> surfaces_strong_voxel_map_{
+      voxel_size_};
+  scan_registration::VoxelMap<LoamFeaturePointT> surfaces_weak_voxel_map_{
+      voxel_size_};
+  std::vector<VisualMapSlot> visual_slots_;
+  std::vector<uint32_t> free_visual_slots_;
+  std::atomic<bool> visual_map_outdated_{false};
   ros::Subscriber submap_subscriber_;
   bs_common::ExtrinsicsLookupOnline& extrinsics_online_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
@@ -150,10 +301,9 @@ private:
   // publishing map updates:
   bool publish_updates_{false};
   int updates_counter_{0};
-  ros::Time update_time_{0};
   ros::Publisher visual_map_publisher_;
   ros::Publisher lidar_map_publisher_;
   ros::Publisher loam_map_publisher_;
 };
 
-} // namespace bs_models
\ No newline at end of file
+} // namespace bs_models::experimental
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <queue>
 
 #include <pcl/common/transforms.h>
@@ -21,15 +24,21 @@ template <typename PointT>
 struct LidarChunk {
   pcl::PointCloud<PointT> cloud;
   ros::Time time;
+  LidarChunk() = default;
   LidarChunk(const ros::Time& t, const pcl::PointCloud<PointT>& c)
       : time(t), cloud(c) {}
 };
 
+/**
+ * @brief motion compensated aggregate. The cloud is shared so that aggregates
+ * can be handed off without copying the points
+ */
 template <typename PointT>
 struct LidarAggregate {
-  pcl::PointCloud<PointT> cloud;
+  std::shared_ptr<pcl::PointCloud<PointT>> cloud;
   ros::Time time;
-  LidarAggregate(const ros::Time& t) : time(t) {}
+  LidarAggregate(const ros::Time& t)
+      : cloud(std::make_shared<pcl::PointCloud<PointT>>()), time(t) {}
 };
 
 /**
@@ -37,6 +46,15 @@ struct LidarAggregate {
  * compensated aggregate, where all poins in the aggregate come before the
  * aggregation_time. The aggregate contains all points expressed in the lidar
  * frame at the aggregation_time.
+ *
+ * This is meant to be streamed packet by packet, so chunks must be added in
+ * time order. They are stored in a fixed size ring of chunk buffers which keep
+ * their memory when reused, so adding a chunk does not allocate once the ring
+ * has warmed up. When aggregating, the lidar poses are queried once for a table
+ * of times spanning the aggregate (every pose_table_resolution), and the pose
+ * of each chunk is interpolated from this table instead of querying the frame
+ * initializer per chunk. Points are transformed straight into the aggregate,
+ * without intermediate clouds.
  */
 template <typename PointT>
 class LidarAggregator {
@@ -46,26 +64,60 @@ public:
    * @param frame_init_config path to frame initializer config
    * @param max_aggregate_duration maximum time duration to add points to a
    * single aggregate
+   * @param max_chunks size of the chunk ring. If full, the oldest chunks are
+   * dropped
+   * @param pose_table_resolution time between poses in the interpolation table
    */
   LidarAggregator(
       const std::string& frame_init_config,
-      const ros::Duration& max_aggregate_duration = ros::Duration(0.1)) {
+      const ros::Duration& max_aggregate_duration = ros::Duration(0.1),
+      size_t max_chunks = 4096,
+      const ros::Duration& pose_table_resolution = ros::Duration(0.01)) {
     max_aggregate_duration_ = max_aggregate_duration;
+    pose_table_resolution_ = pose_table_resolution;
+    chunks_.resize(std::max<size_t>(max_chunks, 1));
     frame_initializer_ =
         std::make_unique<bs_models::FrameInitializer>(
             frame_init_config);
   }
 
   /**
-   * @brief Adds a new lidar chunk to the sorted map of chunks to be aggregated.
+   * @brief Adds a new lidar chunk to the ring of chunks to be aggregated.
+   * Chunks older than the last added chunk are dropped
    * @param lidar_chunk set of lidar points to be added
    */
   void Add(const LidarChunk<PointT>& lidar_chunk) {
-    lidar_chunks_.emplace(lidar_chunk.time.toNSec(), lidar_chunk);
+    Add(lidar_chunk.time, lidar_chunk.cloud);
+  }
+
+  /**
+   * @brief same as above, but copies the points straight into the ring buffer
+   * @param time time of all points in the chunk
+   * @param cloud points expressed in the lidar frame
+   */
+  void Add(const ros::Time& time, const pcl::PointCloud<PointT>& cloud) {
+    if (num_chunks_ > 0 && time < ChunkAt(num_chunks_ - 1).time) {
+      ROS_WARN_THROTTLE(1, "Lidar chunk is older than the last added chunk, "
+                           "dropping. Chunks must be added in time order.");
+      return;
+    }
+    if (num_chunks_ == chunks_.size()) {
+      ROS_WARN_THROTTLE(1, "Lidar chunk buffer is full, dropping oldest chunk. "
+                           "Consider increasing max_chunks.");
+      PopChunk();
+    }
+    LidarChunk<PointT>& chunk = chunks_[(first_chunk_ + num_chunks_) %
+                                        chunks_.size()];
+    chunk.time = time;
+    chunk.cloud.clear();
+    chunk.cloud.insert(chunk.cloud.end(), cloud.begin(), cloud.end());
+    num_chunks_++;
   }
 
   std::vector<LidarAggregate<PointT>> Get() {
-    return std::move(finalized_aggregates_);
+    std::vector<LidarAggregate<PointT>> aggregates;
+    aggregates.swap(finalized_aggregates_);
+    return aggregates;
   }
 
   /**
@@ -75,86 +127,179 @@ public:
    * timestamp in the list
    */
   void Aggregate(const ros::Time& aggregation_time = ros::Time(0)) {
+    // check chunks have been added
+    if (num_chunks_ == 0) { return; }
+
     ros::Time t = aggregation_time;
-    if (aggregation_time == ros::Time(0)) {
-      t.fromNSec(lidar_chunks_.begin()->first);
-    }
+    if (aggregation_time == ros::Time(0)) { t = ChunkAt(0).time; }
     aggregation_times_.push(t);
 
-    // check aggregates have been added
-    if (lidar_chunks_.size() == 0) { return; }
-
     // continue as long as aggregation times and lidar chunks are not empty
-    while (!aggregation_times_.empty() && !lidar_chunks_.empty()) {
+    while (!aggregation_times_.empty() && num_chunks_ > 0) {
       const ros::Time current_aggregate_time = aggregation_times_.front();
 
       // if the aggregation time is ahead of the first lidar chunk, then we
       // remove the aggregation time. This might cause some missed aggregates at
       // the start if there is a bit of delay in the lidar input, but shouldn't
       // have that big of an effect
-      if (current_aggregate_time.toNSec() < lidar_chunks_.begin()->first) {
+      if (current_aggregate_time < ChunkAt(0).time) {
         aggregation_times_.pop();
         continue;
       }
 
       // If aggregation time is after the latest lidar chunk, then we return
       // and wait for more points to arrive
-      if (current_aggregate_time.toNSec() > lidar_chunks_.rbegin()->first) {
-        return;
-      }
+      if (current_aggregate_time > ChunkAt(num_chunks_ - 1).time) { return; }
 
       // if we get to here, then aggregation time is within the timestamps of
-      // the points
-
-      // get lidar pose at aggregation time
-      Eigen::Matrix4d T_WORLD_LIDARAGG;
-      std::string error_msg;
-      if (!frame_initializer_->GetPose(T_WORLD_LIDARAGG, current_aggregate_time,
-                                       extrinsics_.GetLidarFrameId(),
-                                       error_msg)) {
-        ROS_DEBUG("Cannot get lidar pose at requested aggregation time, "
-                  "skipping. Reason: %s",
-                  error_msg.c_str());
-        return;
+      // the points. Points older than the max duration are not aggregated
+      if (current_aggregate_time.toSec() > max_aggregate_duration_.toSec()) {
+        const ros::Time window_start =
+            current_aggregate_time - max_aggregate_duration_;
+        while (num_chunks_ > 0 && ChunkAt(0).time < window_start) {
+          PopChunk();
+        }
       }
 
-      // iterate through all lidar chunks, transform to corrected position, then
-      // add to final aggregate
-      LidarAggregate<PointT> current_aggregate(current_aggregate_time);
+      size_t num_in_window = 0;
+      size_t num_points = 0;
+      while (num_in_window < num_chunks_ &&
+             ChunkAt(num_in_window).time <= current_aggregate_time) {
+        num_points += ChunkAt(num_in_window).cloud.size();
+        num_in_window++;
+      }
 
-      while (!lidar_chunks_.empty()) {
-        const auto& current_chunk = lidar_chunks_.begin();
-        uint64_t current_chunk_time = lidar_chunks_.begin()->first;
-
-        // get lidar pose at current chunk time
-        Eigen::Matrix4d T_WORLD_LIDARCHUNK;
-        std::string error_msg;
-        if (!frame_initializer_->GetPose(
-                T_WORLD_LIDARCHUNK, current_chunk->second.time,
-                extrinsics_.GetLidarFrameId(), error_msg)) {
-          ROS_DEBUG(
-              "Cannot get lidar pose at lidar chunk time, skipping. Reason: %s",
-              error_msg.c_str());
-          lidar_chunks_.erase(current_chunk->first);
+      if (!BuildPoseTable(ChunkAt(0).time, current_aggregate_time)) { return; }
+
+      // transform all chunks to the corrected position, straight into the
+      // final aggregate
+      LidarAggregate<PointT> current_aggregate(current_aggregate_time);
+      current_aggregate.cloud->reserve(num_points);
+      for (size_t i = 0; i < num_in_window; i++) {
+        const LidarChunk<PointT>& chunk = ChunkAt(0);
+        Eigen::Matrix4d T_LIDARAGG_LIDARCHUNK;
+        if (!InterpolatePose(chunk.time, T_LIDARAGG_LIDARCHUNK)) {
+          ROS_DEBUG("Cannot get lidar pose at lidar chunk time, skipping.");
+          PopChunk();
           continue;
         }
+        const Eigen::Affine3f T(T_LIDARAGG_LIDARCHUNK.cast<float>());
+        for (const PointT& p_in : chunk.cloud) {
+          PointT p = p_in;
+          p.getVector3fMap() = T * p_in.getVector3fMap();
+          current_aggregate.cloud->push_back(p);
+        }
+        PopChunk();
+      }
+      aggregation_times_.pop();
+      finalized_aggregates_.push_back(std::move(current_aggregate));
+    }
+  }
+
+private:
+  struct PoseTableEntry {
+    double time;
+    Eigen::Matrix4d T_LIDARAGG_LIDAR;
+    bool valid;
+  };
+
+  LidarChunk<PointT>& ChunkAt(size_t i) {
+    return chunks_[(first_chunk_ + i) % chunks_.size()];
+  }
 
-        Eigen::Matrix4d T_LIDARAGG_LIDARCHUNK =
-            beam::InvertTransform(T_WORLD_LIDARAGG) * T_WORLD_LIDARCHUNK;
+  /**
+   * @brief remove the oldest chunk, its buffer keeps its memory for reuse
+   */
+  void PopChunk() {
+    chunks_[first_chunk_].cloud.clear();
+    first_chunk_ = (first_chunk_ + 1) % chunks_.size();
+    num_chunks_--;
+  }
+
+  /**
+   * @brief query the lidar poses between start_time and aggregation_time,
+   * relative to the lidar pose at the aggregation time
+   * @return false if the pose at the aggregation time is not available
+   */
+  bool BuildPoseTable(const ros::Time& start_time,
+                      const ros::Time& aggregation_time) {
+    Eigen::Matrix4d T_WORLD_LIDARAGG;
+    std::string error_msg;
+    if (!frame_initializer_->GetPose(T_WORLD_LIDARAGG, aggregation_time,
+                                     extrinsics_.GetLidarFrameId(),
+                                     error_msg)) {
+      ROS_DEBUG("Cannot get lidar pose at requested aggregation time, "
+                "skipping. Reason: %s",
+                error_msg.c_str());
+      return false;
+    }
+    const Eigen::Matrix4d T_LIDARAGG_WORLD =
+        beam::InvertTransform(T_WORLD_LIDARAGG);
 
-        pcl::PointCloud<PointT> compensated_chunk;
-        pcl::transformPointCloud(current_chunk->second.cloud, compensated_chunk,
-                                 T_LIDARAGG_LIDARCHUNK);
+    // the last entry is always at the aggregation time
+    const double resolution = std::max(pose_table_resolution_.toSec(), 1e-6);
+    const double duration = (aggregation_time - start_time).toSec();
+    const size_t num_entries =
+        static_cast<size_t>(std::ceil(duration / resolution)) + 1;
+    pose_table_.resize(num_entries);
 
-        current_aggregate.cloud += compensated_chunk;
-        lidar_chunks_.erase(current_chunk_time);
+    // entries covered by the odometry are looked up in one batch, the
+    // others are not valid
+    const ros::Time odometry_end = frame_initializer_->OdometryEndTime();
+    std::vector<ros::Time> times;
+    for (size_t i = 0; i + 1 < num_entries; i++) {
+      PoseTableEntry& entry = pose_table_[i];
+      const ros::Time t = start_time + ros::Duration(i * resolution);
+      entry.time = t.toSec();
+      entry.valid = false;
+      if (t <= odometry_end) { times.push_back(t); }
+    }
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_WORLD_LIDAR;
+    if (frame_initializer_->GetPoses(Ts_WORLD_LIDAR, times,
+                                     extrinsics_.GetLidarFrameId(),
+                                     error_msg)) {
+      for (size_t i = 0; i < Ts_WORLD_LIDAR.size(); i++) {
+        pose_table_[i].T_LIDARAGG_LIDAR = T_LIDARAGG_WORLD * Ts_WORLD_LIDAR[i];
+        pose_table_[i].valid = true;
       }
-      finalized_aggregates_.push_back(current_aggregate);
     }
+    PoseTableEntry& last = pose_table_.back();
+    last.time = aggregation_time.toSec();
+    last.T_LIDARAGG_LIDAR = Eigen::Matrix4d::Identity();
+    last.valid = true;
+    return true;
   }
 
-private:
-  std::map<uint64_t, LidarChunk<PointT>> lidar_chunks_; // t_nsec -> lidar chunk
+  /**
+   * @brief interpolate the relative lidar pose at a time within the pose table
+   * @return false if either of the surrounding table entries is not valid
+   */
+  bool InterpolatePose(const ros::Time& time,
+                       Eigen::Matrix4d& T_LIDARAGG_LIDAR) const {
+    if (pose_table_.size() == 1) {
+      T_LIDARAGG_LIDAR = pose_table_.front().T_LIDARAGG_LIDAR;
+      return true;
+    }
+    const double t = time.toSec();
+    const double resolution = std::max(pose_table_resolution_.toSec(), 1e-6);
+    size_t i = static_cast<size_t>(
+        std::max(0.0, std::floor((t - pose_table_.front().time) / resolution)));
+    i = std::min(i, pose_table_.size() - 2);
+    const PoseTableEntry& before = pose_table_[i];
+    const PoseTableEntry& after = pose_table_[i + 1];
+    if (!before.valid || !after.valid) { return false; }
+    T_LIDARAGG_LIDAR = beam::InterpolateTransform(
+        before.T_LIDARAGG_LIDAR, before.time, after.T_LIDARAGG_LIDAR,
+        after.time, t);
+    return true;
+  }
+
+  // ring of chunk buffers, sorted by time starting at first_chunk_
+  std::vector<LidarChunk<PointT>> chunks_;
+  size_t first_chunk_{0};
+  size_t num_chunks_{0};
+
+  std::vector<PoseTableEntry> pose_table_;
   std::vector<LidarAggregate<PointT>> finalized_aggregates_;
   std::unique_ptr<bs_models::FrameInitializer> frame_initializer_;
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
@@ -163,5 +308,6 @@ private:
 
   // params
   ros::Duration max_aggregate_duration_;
+  ros::Duration pose_table_resolution_;
 };
 } // namespace bs_models
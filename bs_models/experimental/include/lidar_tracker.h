@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <unordered_map>
 
 #include <fuse_core/async_sensor_model.h>
@@ -57,8 +58,23 @@ private:
       RegisterScanToGlobalMap(const ScanPose& scan_pose,
                               Eigen::Matrix4d& T_WORLD_BASELINK);
 
+  /**
+   * @brief queue a reloc request for a scan, which is built and published by
+   * a background task (see PublishRelocRequest) so the tracking thread only
+   * copies the pose. Requests are skipped while the previous one is still
+   * being built.
+   */
   void SendRelocRequest(const std::shared_ptr<ScanPose>& scan_pose);
 
+  /**
+   * @brief build a reloc request with the scan clouds in the baselink frame,
+   * in the packed cloud format (see bs_common/packed_cloud.h), and publish it
+   */
+  void PublishRelocRequest(const geometry_msgs::PoseStamped& T_WORLD_BASELINK,
+                           const Eigen::Matrix4d& T_BASELINK_LIDAR,
+                           const PointCloud& cloud,
+                           const beam_matching::LoamPointCloud& loam_cloud);
+
   void PublishMarginalizedScanPose(const std::shared_ptr<ScanPose>& scan_pose);
 
   void SaveMarginalizedScanPose(const std::shared_ptr<ScanPose>& scan_pose);
@@ -132,6 +148,8 @@ private:
   int updates_{0};
   ros::Duration reloc_request_period_;
   ros::Time last_reloc_request_time_{ros::Time(0)};
+  uint64_t reloc_request_counter_{0};
+  std::future<void> reloc_request_future_;
   Eigen::Matrix4d T_WORLD_BASELINKLAST_{Eigen::Matrix4d::Identity()};
   ros::Time last_scan_pose_time_{ros::Time(0)};
   std::string graph_updates_path_;
@@ -59,12 +59,25 @@ public:
     getParam<double>(nh, "max_aggregation_time_seconds",
                      max_aggregation_time_seconds,
                      max_aggregation_time_seconds);
+
+    /** Max number of lidar chunks (e.g., packets) buffered before
+     * aggregating, the oldest are dropped when full. Default: 4096 */
+    getParam<int>(nh, "max_buffered_chunks", max_buffered_chunks,
+                  max_buffered_chunks);
+
+    /** Time between the lidar poses that are queried per aggregate, the pose
+     * of each chunk is interpolated between these. Default: 0.01 */
+    getParam<double>(nh, "pose_table_resolution_seconds",
+                     pose_table_resolution_seconds,
+                     pose_table_resolution_seconds);
   }
 
   std::string aggregation_time_topic{"/local_mapper/inertial_odometry/trigger"};
   std::string pointcloud_topic;
   LidarType lidar_type{LidarType::VELODYNE};
   double max_aggregation_time_seconds{0.1};
+  int max_buffered_chunks{4096};
+  double pose_table_resolution_seconds{0.01};
 
   std::string frame_initializer_config{""};
 };
@@ -1,5 +1,7 @@
 #include <global_mapping/active_submap.h>
 
+#include <algorithm>
+
 #include <pcl/common/transforms.h>
 
 #include <beam_cv/descriptors/Descriptor.h>
@@ -7,150 +9,344 @@
 #include <beam_utils/pointclouds.h>
 #include <beam_utils/se3.h>
 
-namespace bs_models : experimental {
+namespace bs_models::experimental {
+
+ActiveSubmap::ActiveSubmap() {
+  ros::NodeHandle n;
+
+  // setup subsriber
+  submap_subscriber_ = n.subscribe("/global_mapper/active_submap", 1,
+                                   &ActiveSubmap::ActiveSubmapCallback, this);
 
-  ActiveSubmap::ActiveSubmap() {
-    ros::NodeHandle n;
+  // setup publishers
+  visual_map_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>("/active_submap/visual_map", 10);
+  lidar_map_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>("/active_submap/lidar_map", 10);
+  loam_map_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>("/active_submap/loam_map", 10);
 
-    // setup subsriber
-    submap_subscriber_ = n.subscribe("/global_mapper/active_submap", 1,
-                                     &ActiveSubmap::ActiveSubmapCallback, this);
+  // start with an empty submap
+  snapshot_ = std::make_shared<SubmapSnapshot>();
+}
 
-    // setup publishers
-    visual_map_publisher_ =
-        n.advertise<sensor_msgs::PointCloud2>("/active_submap/visual_map", 10);
-    lidar_map_publisher_ =
-        n.advertise<sensor_msgs::PointCloud2>("/active_submap/lidar_map", 10);
-    loam_map_publisher_ =
-        n.advertise<sensor_msgs::PointCloud2>("/active_submap/loam_map", 10);
+ActiveSubmap& ActiveSubmap::GetInstance() {
+  static ActiveSubmap instance;
+  return instance;
+}
 
-    // instantitate pointers
-    visual_map_points_ = std::make_shared<PointCloud>();
-    lidar_map_points_ = std::make_shared<PointCloud>();
-    loam_cloud_ = std::make_shared<beam_matching::LoamPointCloud>();
+void ActiveSubmap::ActiveSubmapCallback(
+    const bs_common::SubmapMsg::ConstPtr& msg) {
+  // add all 3d locations of landmarks to cloud
+  PointCloud visual_map_points;
+  visual_map_points.reserve(msg->visual_map_points.size());
+  for (const auto& p : msg->visual_map_points) {
+    visual_map_points.push_back(pcl::PointXYZ(p.x, p.y, p.z));
   }
+  std::vector<uint32_t> word_ids(msg->visual_map_word_ids.begin(),
+                                 msg->visual_map_word_ids.end());
 
-  ActiveSubmap& ActiveSubmap::GetInstance() {
-    static ActiveSubmap instance;
-    return instance;
+  // if lidar map not empty, check frame id
+  if (!msg->lidar_map.lidar_points.empty() ||
+      !msg->lidar_map.lidar_edges_strong.empty() ||
+      !msg->lidar_map.lidar_surfaces_strong.empty()) {
+    if (msg->lidar_map.frame_id != extrinsics_online_.GetWorldFrameId()) {
+      BEAM_WARN("Lidar measurement frame id in submap msg not consistent "
+                "with world "
+                "frame in extrinsics.");
+    }
   }
 
-  void ActiveSubmap::ActiveSubmapCallback(
-      const bs_common::SubmapMsg::ConstPtr& msg) {
-    updates_counter_++;
-    update_time_ = ros::Time::now();
+  // add all lidar points to point cloud
+  PointCloud lidar_points;
+  lidar_points.reserve(msg->lidar_map.lidar_points.size());
+  for (const geometry_msgs::Vector3& point_vec : msg->lidar_map.lidar_points) {
+    lidar_points.push_back(
+        pcl::PointXYZ(point_vec.x, point_vec.y, point_vec.z));
+  }
 
-    word_ids_.clear();
-    visual_map_points_->clear();
-    lidar_map_points_->clear();
+  // add loam pointcloud
+  PointCloudIRT edges_strong =
+      beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_edges_strong);
+  PointCloudIRT edges_weak =
+      beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_edges_weak);
+  PointCloudIRT surfaces_strong =
+      beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_surfaces_strong);
+  PointCloudIRT surfaces_weak =
+      beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_surfaces_weak);
+  beam_matching::LoamPointCloud loam_cloud(edges_strong, surfaces_strong,
+                                           edges_weak, surfaces_weak);
 
-    // add all descriptors to list
-    for (auto& id : msg->visual_map_word_ids) { word_ids_.push_back(id); }
+  MergeSubmap(msg->submap_id, lidar_points, loam_cloud, visual_map_points,
+              word_ids);
+}
 
-    // add all 3d locations of landmarks to cloud
-    for (auto& p : msg->visual_map_points) {
-      pcl::PointXYZ point(p.x, p.y, p.z);
-      visual_map_points_->push_back(point);
-    }
+void ActiveSubmap::MergeSubmap(uint64_t submap_id,
+                               const PointCloud& lidar_points,
+                               const beam_matching::LoamPointCloud& loam_cloud,
+                               const PointCloud& visual_map_points,
+                               const std::vector<uint32_t>& word_ids) {
+  if (visual_map_points.size() != word_ids.size()) {
+    BEAM_ERROR("Visual map points and word ids of submap {} have different "
+               "sizes, not merging submap",
+               submap_id);
+    return;
+  }
 
-    // if lidar map not empty, check frame id
-    if (!msg->lidar_map.lidar_points.empty() ||
-        !msg->lidar_map.lidar_edges_strong.empty() ||
-        !msg->lidar_map.lidar_surfaces_strong.empty()) {
-      if (msg->lidar_map.frame_id != extrinsics_online_.GetWorldFrameId()) {
-        BEAM_WARN("Lidar measurement frame id in submap msg not consistent "
-                  "with world "
-                  "frame in extrinsics.");
-      }
-    }
+  std::lock_guard<std::mutex> lock(update_mutex_);
 
-    // add all lidar points to point cloud
-    for (geometry_msgs::Vector3 point_vec : msg->lidar_map.lidar_points) {
-      pcl::PointXYZ point(point_vec.x, point_vec.y, point_vec.z);
-      lidar_map_points_->push_back(point);
-    }
+  // only the points of this submap change, all other submaps are kept
+  auto iter = submaps_.find(submap_id);
+  if (iter != submaps_.end()) {
+    RemoveSubmapPoints(submap_id, iter->second);
+    submaps_.erase(iter);
+  }
 
-    // add loam pointcloud
-    PointCloudIRT edges_strong =
-        beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_edges_strong);
-    PointCloudIRT edges_weak =
-        beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_edges_weak);
-    PointCloudIRT surfaces_strong =
-        beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_surfaces_strong);
-    PointCloudIRT surfaces_weak =
-        beam::ROSVectorToPCLIRT(msg->lidar_map.lidar_surfaces_weak);
-    loam_cloud_ = std::make_shared<beam_matching::LoamPointCloud>(
-        edges_strong, surfaces_strong, edges_weak, surfaces_weak);
+  SubmapData& submap = submaps_[submap_id];
+  submap.lidar_points = lidar_points;
+  submap.loam_cloud = loam_cloud;
+  for (size_t i = 0; i < visual_map_points.size(); i++) {
+    uint32_t slot;
+    if (free_visual_slots_.empty()) {
+      slot = visual_slots_.size();
+      visual_slots_.emplace_back();
+    } else {
+      slot = free_visual_slots_.back();
+      free_visual_slots_.pop_back();
+    }
+    visual_slots_[slot] =
+        VisualMapSlot{visual_map_points[i], word_ids[i], submap_id, true};
+    submap.visual_slots.push_back(slot);
+  }
+  AddSubmapPoints(submap_id, submap);
 
-    if (publish_updates_) { Publish(); }
+  while (submaps_.size() > static_cast<size_t>(max_submaps_)) {
+    RemoveSubmapPoints(submaps_.begin()->first, submaps_.begin()->second);
+    submaps_.erase(submaps_.begin());
   }
 
-  void ActiveSubmap::SetPublishUpdates(bool publish_updates) {
-    publish_updates_ = publish_updates;
+  UpdateSnapshot();
+}
+
+void ActiveSubmap::RemoveSubmap(uint64_t submap_id) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  auto iter = submaps_.find(submap_id);
+  if (iter == submaps_.end()) { return; }
+  RemoveSubmapPoints(submap_id, iter->second);
+  submaps_.erase(iter);
+  UpdateSnapshot();
+}
+
+void ActiveSubmap::SetMaxSubmaps(int max_submaps) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  max_submaps_ = std::max(max_submaps, 1);
+}
+
+void ActiveSubmap::SetVoxelSize(double voxel_size) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  voxel_size_ = voxel_size;
+  lidar_voxel_map_.SetVoxelSize(voxel_size_);
+  edges_strong_voxel_map_.SetVoxelSize(voxel_size_);
+  edges_weak_voxel_map_.SetVoxelSize(voxel_size_);
+  surfaces_strong_voxel_map_.SetVoxelSize(voxel_size_);
+  surfaces_weak_voxel_map_.SetVoxelSize(voxel_size_);
+  if (submaps_.empty()) { return; }
+
+  // visual slots are not voxelized, only re-add the lidar points
+  for (const auto& [submap_id, submap] : submaps_) {
+    AddSubmapPoints(submap_id, submap);
   }
+  UpdateSnapshot();
+}
 
-  std::vector<Eigen::Vector3d> ActiveSubmap::GetVisualMapVectorInCameraFrame(
-      const Eigen::Matrix4d& T_WORLD_CAMERA) const {
-    PointCloud cloud_in_cam_frame =
-        GetVisualMapCloudInCameraFrame(T_WORLD_CAMERA);
+void ActiveSubmap::AddSubmapPoints(uint64_t submap_id,
+                                   const SubmapData& submap) {
+  lidar_voxel_map_.AddCloud(submap_id, submap.lidar_points);
+  edges_strong_voxel_map_.AddCloud(submap_id,
+                                   submap.loam_cloud.edges.strong.cloud);
+  edges_weak_voxel_map_.AddCloud(submap_id, submap.loam_cloud.edges.weak.cloud);
+  surfaces_strong_voxel_map_.AddCloud(submap_id,
+                                      submap.loam_cloud.surfaces.strong.cloud);
+  surfaces_weak_voxel_map_.AddCloud(submap_id,
+                                    submap.loam_cloud.surfaces.weak.cloud);
+}
 
-    std::vector<Eigen::Vector3d> vector_in_cam_frame;
-    for (auto it = visual_map_points_->begin(); it != visual_map_points_->end();
-         it++) {
-      vector_in_cam_frame.push_back(Eigen::Vector3d{it->x, it->y, it->z});
+void ActiveSubmap::RemoveSubmapPoints(uint64_t submap_id,
+                                      const SubmapData& submap) {
+  lidar_voxel_map_.RemoveCloud(submap_id, submap.lidar_points);
+  edges_strong_voxel_map_.RemoveCloud(submap_id,
+                                      submap.loam_cloud.edges.strong.cloud);
+  edges_weak_voxel_map_.RemoveCloud(submap_id,
+                                    submap.loam_cloud.edges.weak.cloud);
+  surfaces_strong_voxel_map_.RemoveCloud(
+      submap_id, submap.loam_cloud.surfaces.strong.cloud);
+  surfaces_weak_voxel_map_.RemoveCloud(submap_id,
+                                       submap.loam_cloud.surfaces.weak.cloud);
+
+  // slots of points removed with RemoveVisualMapPoint may have been reused
+  // by other submaps
+  for (const uint32_t slot : submap.visual_slots) {
+    if (!visual_slots_[slot].used ||
+        visual_slots_[slot].submap_id != submap_id) {
+      continue;
     }
-    return vector_in_cam_frame;
+    visual_slots_[slot].used = false;
+    free_visual_slots_.push_back(slot);
   }
+}
 
-  PointCloud ActiveSubmap::GetVisualMapCloudInCameraFrame(
-      const Eigen::Matrix4d& T_WORLD_CAMERA) const {
-    if (T_WORLD_CAMERA.isIdentity()) { return *visual_map_points_; }
+void ActiveSubmap::ClearSubmaps() {
+  submaps_.clear();
+  lidar_voxel_map_.Clear();
+  edges_strong_voxel_map_.Clear();
+  edges_weak_voxel_map_.Clear();
+  surfaces_strong_voxel_map_.Clear();
+  surfaces_weak_voxel_map_.Clear();
+  visual_slots_.clear();
+  free_visual_slots_.clear();
+}
 
-    PointCloud cloud_in_cam_frame;
-    pcl::transformPointCloud(*visual_map_points_, cloud_in_cam_frame,
-                             beam::InvertTransform(T_WORLD_CAMERA));
-    return cloud_in_cam_frame;
-  }
+void ActiveSubmap::UpdateSnapshot() {
+  // build the new snapshot on the side, readers keep using the current one
+  auto snapshot = std::make_shared<SubmapSnapshot>();
+  *snapshot->lidar_map_points = lidar_voxel_map_.GetCloud();
+  snapshot->loam_cloud = std::make_shared<beam_matching::LoamPointCloud>(
+      edges_strong_voxel_map_.GetCloud(), surfaces_strong_voxel_map_.GetCloud(),
+      edges_weak_voxel_map_.GetCloud(), surfaces_weak_voxel_map_.GetCloud());
+  visual_map_outdated_ = false;
+  FillVisualMap(*snapshot);
 
-  const PointCloudPtr ActiveSubmap::GetVisualMapPoints() const {
-    return visual_map_points_;
+  updates_counter_++;
+  snapshot->update_time = ros::Time::now();
+  snapshot->update_id = updates_counter_;
+  SwapSnapshot(snapshot);
+}
+
+void ActiveSubmap::FillVisualMap(SubmapSnapshot& snapshot) const {
+  snapshot.visual_map_points = std::make_shared<PointCloud>();
+  snapshot.visual_map_points->reserve(visual_slots_.size() -
+                                      free_visual_slots_.size());
+  snapshot.word_ids.clear();
+  snapshot.visual_map_slots.clear();
+  for (uint32_t slot = 0; slot < visual_slots_.size(); slot++) {
+    const VisualMapSlot& visual_slot = visual_slots_[slot];
+    if (!visual_slot.used) { continue; }
+    snapshot.visual_map_points->push_back(visual_slot.point);
+    snapshot.word_ids.push_back(visual_slot.word_id);
+    snapshot.visual_map_slots.push_back(slot);
   }
+}
 
-  const PointCloudPtr ActiveSubmap::GetLidarMap() const {
-    return lidar_map_points_;
+void ActiveSubmap::SwapSnapshot(
+    const std::shared_ptr<SubmapSnapshot>& snapshot) {
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    snapshot_ = snapshot;
   }
 
-  const beam_matching::LoamPointCloudPtr ActiveSubmap::GetLoamMapPtr() const {
-    return loam_cloud_;
+  if (publish_updates_) { Publish(*snapshot); }
+}
+
+ActiveSubmap::SnapshotConstPtr ActiveSubmap::GetSnapshot() const {
+  // apply visual map point removals, unless an update holds the lock in which
+  // case its snapshot already includes them
+  if (visual_map_outdated_) {
+    std::unique_lock<std::mutex> update_lock(update_mutex_, std::try_to_lock);
+    if (update_lock.owns_lock() && visual_map_outdated_) {
+      visual_map_outdated_ = false;
+      std::lock_guard<std::mutex> lock(snapshot_mutex_);
+      auto snapshot = std::make_shared<SubmapSnapshot>(*snapshot_);
+      FillVisualMap(*snapshot);
+      snapshot_ = snapshot;
+      return snapshot_;
+    }
   }
 
-  void ActiveSubmap::RemoveVisualMapPoint(size_t index) {
-    visual_map_points_->erase(visual_map_points_->begin() + index);
-    word_ids_.erase(word_ids_.begin() + index);
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  return snapshot_;
+}
+
+void ActiveSubmap::SetPublishUpdates(bool publish_updates) {
+  publish_updates_ = publish_updates;
+}
+
+std::vector<Eigen::Vector3d> ActiveSubmap::GetVisualMapVectorInCameraFrame(
+    const Eigen::Matrix4d& T_WORLD_CAMERA) const {
+  PointCloud cloud_in_cam_frame =
+      GetVisualMapCloudInCameraFrame(T_WORLD_CAMERA);
+
+  std::vector<Eigen::Vector3d> vector_in_cam_frame;
+  vector_in_cam_frame.reserve(cloud_in_cam_frame.size());
+  for (const auto& p : cloud_in_cam_frame) {
+    vector_in_cam_frame.push_back(Eigen::Vector3d{p.x, p.y, p.z});
   }
+  return vector_in_cam_frame;
+}
 
-  void ActiveSubmap::Publish() const {
-    std::string frame_id = extrinsics_online_.GetWorldFrameId();
+PointCloud ActiveSubmap::GetVisualMapCloudInCameraFrame(
+    const Eigen::Matrix4d& T_WORLD_CAMERA) const {
+  const SnapshotConstPtr snapshot = GetSnapshot();
+  if (T_WORLD_CAMERA.isIdentity()) { return *snapshot->visual_map_points; }
 
-    if (!visual_map_points_->empty()) {
-      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
-          *visual_map_points_, update_time_, frame_id, updates_counter_);
-      visual_map_publisher_.publish(pc_msg);
-    }
+  PointCloud cloud_in_cam_frame;
+  pcl::transformPointCloud(*snapshot->visual_map_points, cloud_in_cam_frame,
+                           beam::InvertTransform(T_WORLD_CAMERA));
+  return cloud_in_cam_frame;
+}
 
-    if (!lidar_map_points_->empty()) {
-      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
-          *lidar_map_points_, update_time_, frame_id, updates_counter_);
-      lidar_map_publisher_.publish(pc_msg);
-    }
+const PointCloudPtr ActiveSubmap::GetVisualMapPoints() const {
+  return GetSnapshot()->visual_map_points;
+}
 
-    if (!loam_cloud_->Empty()) {
-      beam_matching::LoamPointCloudCombined loam_combined =
-          loam_cloud_->GetCombinedCloud();
-      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<PointLoam>(
-          loam_combined, update_time_, frame_id, updates_counter_);
-      loam_map_publisher_.publish(pc_msg);
-    }
+const PointCloudPtr ActiveSubmap::GetLidarMap() const {
+  return GetSnapshot()->lidar_map_points;
+}
+
+const beam_matching::LoamPointCloudPtr ActiveSubmap::GetLoamMapPtr() const {
+  return GetSnapshot()->loam_cloud;
+}
+
+void ActiveSubmap::RemoveVisualMapPoint(size_t index) {
+  // only free the slot, the snapshot visual map is rebuilt once by the next
+  // GetSnapshot or update instead of on every removal. Updates are locked out
+  // so the slot cannot be reused before it is freed
+  std::lock_guard<std::mutex> update_lock(update_mutex_);
+  const SnapshotConstPtr snapshot = [this]() {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    return snapshot_;
+  }();
+  if (index >= snapshot->visual_map_slots.size()) { return; }
+  const uint32_t slot = snapshot->visual_map_slots[index];
+  if (slot >= visual_slots_.size() || !visual_slots_[slot].used) { return; }
+  visual_slots_[slot].used = false;
+  free_visual_slots_.push_back(slot);
+  visual_map_outdated_ = true;
+}
+
+void ActiveSubmap::Publish(const SubmapSnapshot& snapshot) const {
+  std::string frame_id = extrinsics_online_.GetWorldFrameId();
+
+  if (!snapshot.visual_map_points->empty()) {
+    sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
+        *snapshot.visual_map_points, snapshot.update_time, frame_id,
+        snapshot.update_id);
+    visual_map_publisher_.publish(pc_msg);
+  }
+
+  if (!snapshot.lidar_map_points->empty()) {
+    sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
+        *snapshot.lidar_map_points, snapshot.update_time, frame_id,
+        snapshot.update_id);
+    lidar_map_publisher_.publish(pc_msg);
+  }
+
+  if (!snapshot.loam_cloud->Empty()) {
+    beam_matching::LoamPointCloudCombined loam_combined =
+        snapshot.loam_cloud->GetCombinedCloud();
+    sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<PointLoam>(
+        loam_combined, snapshot.update_time, frame_id, snapshot.update_id);
+    loam_map_publisher_.publish(pc_msg);
   }
+}
 
-} // namespace bs_models: experimental
\ No newline at end of file
+} // namespace bs_models::experimental
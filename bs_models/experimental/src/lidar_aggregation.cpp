@@ -20,13 +20,17 @@ void LidarAggregation::onInit() {
   params_.loadFromROS(private_node_handle_);
   ROS_DEBUG("Loaded params");
   max_aggregation_duration_.fromSec(params_.max_aggregation_time_seconds);
+  const ros::Duration pose_table_resolution(
+      params_.pose_table_resolution_seconds);
   if (params_.lidar_type == LidarType::VELODYNE) {
     velodyne_lidar_aggregator_ = std::make_unique<LidarAggregator<PointXYZIRT>>(
-        params_.frame_initializer_config, max_aggregation_duration_);
+        params_.frame_initializer_config, max_aggregation_duration_,
+        params_.max_buffered_chunks, pose_table_resolution);
   } else if (params_.lidar_type == LidarType::OUSTER) {
     ouster_lidar_aggregator_ =
         std::make_unique<LidarAggregator<PointXYZITRRNR>>(
-            params_.frame_initializer_config, max_aggregation_duration_);
+            params_.frame_initializer_config, max_aggregation_duration_,
+            params_.max_buffered_chunks, pose_table_resolution);
   } else {
     BEAM_ERROR(
         "Invalid lidar type param. Lidar type may not be implemented yet.");
@@ -68,8 +72,7 @@ void LidarAggregation::ProcessPointcloud(
          iter++) {
       ros::Time t;
       t.fromNSec(iter->first);
-      LidarChunk<PointXYZIRT> lidar_chunk(t, iter->second);
-      velodyne_lidar_aggregator_->Add(lidar_chunk);
+      velodyne_lidar_aggregator_->Add(t, iter->second);
     }
   } else if (params_.lidar_type == LidarType::OUSTER) {
     pcl::PointCloud<PointXYZITRRNR> cloud;
@@ -80,8 +83,7 @@ void LidarAggregation::ProcessPointcloud(
          iter++) {
       ros::Time t;
       t.fromNSec(iter->first);
-      LidarChunk<PointXYZITRRNR> lidar_chunk(t, iter->second);
-      ouster_lidar_aggregator_->Add(lidar_chunk);
+      ouster_lidar_aggregator_->Add(t, iter->second);
     }
   }
 
@@ -94,7 +96,7 @@ void LidarAggregation::ProcessTimeTrigger(const std_msgs::Time::ConstPtr& msg) {
         velodyne_lidar_aggregator_->Get();
     for (const auto& aggregate : aggregates) {
       sensor_msgs::PointCloud2 cloud_msg =
-          beam::PCLToROS<PointXYZIRT>(aggregate.cloud, aggregate.time,
+          beam::PCLToROS<PointXYZIRT>(*aggregate.cloud, aggregate.time,
                                       extrinsics_.GetLidarFrameId(), counter_);
       aggregate_publisher_.publish(cloud_msg);
     }
@@ -104,7 +106,7 @@ void LidarAggregation::ProcessTimeTrigger(const std_msgs::Time::ConstPtr& msg) {
         ouster_lidar_aggregator_->Get();
     for (const auto& aggregate : aggregates) {
       sensor_msgs::PointCloud2 cloud_msg = beam::PCLToROS<PointXYZITRRNR>(
-          aggregate.cloud, aggregate.time, extrinsics_.GetLidarFrameId(),
+          *aggregate.cloud, aggregate.time, extrinsics_.GetLidarFrameId(),
           counter_);
       aggregate_publisher_.publish(cloud_msg);
     }
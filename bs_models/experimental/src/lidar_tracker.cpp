@@ -1,12 +1,18 @@
 #include "lidar_tracker.h"
 
+#include <chrono>
+
 #include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
 #include <fuse_core/transaction.h>
 #include <pluginlib/class_list_macros.h>
 
 #include <beam_utils/filesystem.h>
 
+#include <bs_common/RelocRequestMsg.h>
 #include <bs_common/bs_msgs.h>
+#include <bs_common/packed_cloud.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_models/frame_initializers/frame_initializer.h>
 #include <bs_models/scan_registration/multi_scan_registration.h>
 #include <bs_models/scan_registration/scan_to_map_registration.h>
@@ -166,6 +172,7 @@ void LidarTracker::onStop() {
 
   active_clouds_.clear();
   subscriber_.shutdown();
+  if (reloc_request_future_.valid()) { reloc_request_future_.wait(); }
 }
 
 fuse_core::Transaction::SharedPtr LidarTracker::GenerateTransaction(
@@ -407,12 +414,16 @@ fuse_core::Transaction::SharedPtr
   Eigen::Matrix4d T_MAPEST_SCAN = scan_pose.T_REFFRAME_LIDAR();
   Eigen::Matrix4d T_MAPEST_MAP;
 
+  // hold on to one snapshot for the whole registration, so submap updates
+  // neither block nor change the map mid match
+  const ActiveSubmap::SnapshotConstPtr submap = active_submap_.GetSnapshot();
+
   if (global_loam_matching_ != nullptr) {
     LoamPointCloudPtr scan_in_map_frame =
         std::make_shared<LoamPointCloud>(scan_pose.LoamCloud());
     scan_in_map_frame->TransformPointCloud(T_MAPEST_SCAN);
 
-    LoamPointCloudPtr current_map = active_submap_.GetLoamMapPtr();
+    LoamPointCloudPtr current_map = submap->loam_cloud;
     if (current_map->Empty()) {
       ROS_WARN_THROTTLE(
           5, "active submap empty, make sure you have a global mapper running");
@@ -430,7 +441,7 @@ fuse_core::Transaction::SharedPtr
     pcl::transformPointCloud(scan_pose.Cloud(), *scan_in_map_frame,
                              T_MAPEST_SCAN);
 
-    PointCloudPtr current_map = active_submap_.GetLidarMap();
+    PointCloudPtr current_map = submap->lidar_map_points;
 
     if (current_map->empty()) {
       ROS_WARN_THROTTLE(
@@ -516,7 +527,7 @@ void LidarTracker::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) {
       // send reloc request if it is the first time the scan pose is updated,
       // and if the time elapsed since the last reloc request is greater than
       // the min.
-      if (scan_pose->Updates() == 1 ||
+      if (params_.reloc_request_period != 0 && scan_pose->Updates() == 1 &&
           scan_pose->Stamp() - last_reloc_request_time_ >=
               reloc_request_period_) {
         SendRelocRequest(scan_pose);
@@ -576,6 +587,14 @@ void LidarTracker::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
 
 void LidarTracker::SendRelocRequest(
     const std::shared_ptr<ScanPose>& scan_pose) {
+  // only one request is built at a time, requests due while the previous one
+  // is still being built are skipped instead of queued
+  if (reloc_request_future_.valid() &&
+      reloc_request_future_.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+    return;
+  }
+
   // Get extrinsics
   Eigen::Matrix4d T_BASELINK_LIDAR;
   if (!extrinsics_.GetT_BASELINK_LIDAR(T_BASELINK_LIDAR)) {
@@ -584,39 +603,54 @@ void LidarTracker::SendRelocRequest(
         "request.");
     return;
   }
+  last_reloc_request_time_ = scan_pose->Stamp();
 
-  // get clouds in baselink frame
-  PointCloud cloud_in_baselink_frame;
-  pcl::transformPointCloud(scan_pose->Cloud(), cloud_in_baselink_frame,
-                           T_BASELINK_LIDAR);
-  beam_matching::LoamPointCloud loam_cloud_in_baselink_frame(
-      scan_pose->LoamCloud(), T_BASELINK_LIDAR);
-
-  // create message and publish
-  //! why is reloc frame id = baselink, while slam chunk frame id = lidar? line
-  //! 624
-  RelocRequestMsg msg;
-  static uint64_t seq = 0;
+  // the clouds of a scan pose are never modified so they are shared with the
+  // worker, only the pose is copied since it keeps getting updated
   geometry_msgs::PoseStamped pose_stamped;
   bs_common::EigenTransformToPoseStamped(
-      scan_pose->T_REFFRAME_BASELINK(), scan_pose->Stamp(), seq++,
-      extrinsics_.GetBaselinkFrameId(), pose_stamped);
-  msg.T_WORLD_BASELINK = pose_stamped;
-  msg.lidar_measurement.frame_id = extrinsics_.GetBaselinkFrameId();
-  msg.lidar_measurement.lidar_points =
-      beam::PCLToROSVector(cloud_in_baselink_frame);
-  msg.lidar_measurement.lidar_edges_strong =
-      beam::PCLToROSVector(loam_cloud_in_baselink_frame.edges.strong.cloud);
-  msg.lidar_measurement.lidar_edges_weak =
-      beam::PCLToROSVector(loam_cloud_in_baselink_frame.edges.weak.cloud);
-  msg.lidar_measurement.lidar_surfaces_strong =
-      beam::PCLToROSVector(loam_cloud_in_baselink_frame.surfaces.strong.cloud);
-  msg.lidar_measurement.lidar_surfaces_weak =
-      beam::PCLToROSVector(loam_cloud_in_baselink_frame.surfaces.strong.cloud);
+      scan_pose->T_REFFRAME_BASELINK(), scan_pose->Stamp(),
+      reloc_request_counter_++, extrinsics_.GetBaselinkFrameId(),
+      pose_stamped);
+  reloc_request_future_ = bs_common::TaskScheduler::GetInstance().Enqueue(
+      bs_common::TaskPriority::BACKGROUND,
+      [this, pose_stamped, T_BASELINK_LIDAR, cloud = scan_pose->CloudPtr(),
+       loam_cloud = scan_pose->LoamCloudPtr()]() {
+        PublishRelocRequest(pose_stamped, T_BASELINK_LIDAR, *cloud,
+                            *loam_cloud);
+      });
+}
 
+void LidarTracker::PublishRelocRequest(
+    const geometry_msgs::PoseStamped& T_WORLD_BASELINK,
+    const Eigen::Matrix4d& T_BASELINK_LIDAR, const PointCloud& cloud,
+    const beam_matching::LoamPointCloud& loam_cloud) {
+  // get clouds in baselink frame
+  PointCloud cloud_in_baselink_frame;
+  pcl::transformPointCloud(cloud, cloud_in_baselink_frame, T_BASELINK_LIDAR);
+  beam_matching::LoamPointCloud loam_cloud_in_baselink_frame(loam_cloud,
+                                                             T_BASELINK_LIDAR);
+
+  //! why is reloc frame id = baselink, while slam chunk frame id = lidar?
+  bs_common::RelocRequestMsg::Ptr msg =
+      boost::make_shared<bs_common::RelocRequestMsg>();
+  msg->T_WORLD_BASELINK = T_WORLD_BASELINK;
+  bs_common::LidarMeasurementMsg& lidar_measurement = msg->lidar_measurement;
+  lidar_measurement.frame_id = extrinsics_.GetBaselinkFrameId();
+  lidar_measurement.packed = true;
+  bs_common::PCLToPackedXYZMsg(cloud_in_baselink_frame,
+                               lidar_measurement.lidar_points_packed);
+  bs_common::PCLToPackedXYZMsg(loam_cloud_in_baselink_frame.edges.strong.cloud,
+                               lidar_measurement.lidar_edges_strong_packed);
+  bs_common::PCLToPackedXYZMsg(loam_cloud_in_baselink_frame.edges.weak.cloud,
+                               lidar_measurement.lidar_edges_weak_packed);
+  bs_common::PCLToPackedXYZMsg(
+      loam_cloud_in_baselink_frame.surfaces.strong.cloud,
+      lidar_measurement.lidar_surfaces_strong_packed);
+  bs_common::PCLToPackedXYZMsg(
+      loam_cloud_in_baselink_frame.surfaces.weak.cloud,
+      lidar_measurement.lidar_surfaces_weak_packed);
   reloc_request_publisher_.publish(msg);
-
-  last_reloc_request_time_ = scan_pose->Stamp();
 }
 
 void LidarTracker::PublishMarginalizedScanPose(
@@ -1,18 +1,24 @@
 #pragma once
 
-#include <Eigen/Dense>
+#include <functional>
+#include <memory>
 #include <mutex>
+
+#include <Eigen/Dense>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/Path.h>
+#include <ros/callback_queue_interface.h>
 #include <ros/ros.h>
-#include <tf2/buffer_core.h>
 
-#include <bs_common/pose_lookup.h>
+#include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/rcu_slot.h>
+#include <bs_common/trajectory_buffer.h>
+#include <bs_common/trajectory_spline.h>
 
 namespace bs_models {
 
 static std::string frame_initializer_error_msg = "";
 
-using Path = std::map<ros::Time, Eigen::Matrix4d>;
-
 /**
  * @brief This base class shows the contract between a FrameInitializer class.
  * The goal of this class is to initialize the pose of a frame given some
@@ -21,8 +27,22 @@ using Path = std::map<ros::Time, Eigen::Matrix4d>;
  * PoseLookup and ExtrinsicsLookupOnline classes.
  *
  * All input data to the derived classes should be added in a custom
- * constructor. The constructor also needs to initialize pose_lookup_ and poses_
+ * constructor. The constructor also needs to initialize poses_
  *
+ * Poses are stored in trajectory buffers which are published to readers
+ * without locks, so lookups from many threads never wait on the callbacks or
+ * on each other. See bs_common::TrajectoryBuffer.
+ *
+ * If the config sets spline_knot_interval_s, batched lookups in the odometry
+ * (GetPoses) evaluate a cubic B-spline of it instead of interpolating linearly
+ * between odometry poses. The splines are cached per time window, so all
+ * users of the frame initializer looking up the same period share one fit.
+ * See bs_common::TrajectorySplineCache.
+ *
+ * Sensor models that buffer data because the odometry hasn't caught up to it
+ * yet can request a wakeup (see WakeWhenAvailable), so the data is processed
+ * as soon as the odometry reaches it rather than when their next message
+ * arrives.
  */
 class FrameInitializer {
 public:
@@ -32,6 +52,11 @@ public:
    */
   FrameInitializer(const std::string& config_path);
 
+  /**
+   * @brief Destructor, cancels the pending wakeup
+   */
+  ~FrameInitializer();
+
   /**
    * @brief Gets estimated pose of sensor frame wrt world frame using
    * Poselookup.
@@ -44,6 +69,20 @@ public:
                const std::string& sensor_frame_id,
                std::string& error_msg = frame_initializer_error_msg);
 
+  /**
+   * @brief Gets estimated poses of sensor frame wrt world frame at many
+   * timestamps. This is cheaper than calling GetPose for each timestamp since
+   * the trajectories are only loaded once and walked in order
+   * @param T_WORLD_SENSORs reference to result, one pose per timestamp
+   * @param times sorted stamps of the poses
+   * @param sensor_frame sensor frame id.
+   * @return true if all pose lookups were successful
+   */
+  bool GetPoses(std::vector<Eigen::Matrix4d, beam::AlignMat4d>& T_WORLD_SENSORs,
+                const std::vector<ros::Time>& times,
+                const std::string& sensor_frame_id,
+                std::string& error_msg = frame_initializer_error_msg);
+
   /**
    * @brief Gets relative pose between two timestamps wrt the world frame
    * @param T_A_B [out] relative pose
@@ -55,6 +94,37 @@ public:
                        const ros::Time& tB,
                        std::string& error_msg = frame_initializer_error_msg);
 
+  /**
+   * @brief Gets the stamp of the latest odometry pose, which is the latest
+   * time poses can be looked up at
+   * @return ros::Time(0) if there is no pose yet
+   */
+  ros::Time OdometryEndTime() const;
+
+  /**
+   * @brief Adds a callback to a queue once the odometry reaches a time, i.e.,
+   * once poses can be looked up at it. There is at most one wakeup per frame
+   * initializer, requesting one replaces the pending one (a callback of the
+   * replaced wakeup that is already queued is still called). Only request a
+   * wakeup for times after OdometryEndTime(): the callback is added right
+   * away if the odometry already reaches the time
+   * @param time stamp poses are needed at
+   * @param queue queue the callback is added to, usually the queue of the
+   * caller's node handle so it runs on the same threads as its callbacks
+   * @param callback function to call
+   */
+  void WakeWhenAvailable(const ros::Time& time,
+                         ros::CallbackQueueInterface* queue,
+                         std::function<void()> callback);
+
+  /**
+   * @brief Cancels the pending wakeup, including its callbacks that were
+   * already added to their queue but not called yet. Waits for a callback
+   * being called, so it must not be called while the callback could be
+   * waiting on the caller
+   */
+  void CancelWakeup();
+
   /**
    * @brief Converts incoming odometry messages to tf poses and stores them in a
    * buffercore
@@ -75,28 +145,55 @@ private:
    */
   void CheckOdometryFrameIDs(const nav_msgs::OdometryConstPtr message);
 
+  /**
+   * @brief Gets the baselink pose at a time from loaded trajectories. If the
+   * graph path is not empty, the odometry is only used to extrapolate from
+   * the graph pose directly before the time
+   */
+  bool GetT_WORLD_BASELINK(Eigen::Matrix4d& T_WORLD_BASELINK,
+                           const ros::Time& time,
+                           const bs_common::Trajectory& odometry,
+                           const bs_common::Trajectory& graph_path,
+                           std::string& error_msg) const;
+
+  /**
+   * @brief Gets the relative pose between two timestamps from a loaded
+   * odometry trajectory
+   */
+  bool GetRelativePose(Eigen::Matrix4d& T_A_B, const ros::Time& tA,
+                       const ros::Time& tB,
+                       const bs_common::Trajectory& odometry,
+                       std::string& error_msg) const;
+
   /**
    * @brief Initializes the class from a pose file
    */
   void InitializeFromPoseFile(const std::string& file_path);
 
-  std::string authority_;
-  std::shared_ptr<bs_common::PoseLookup> pose_lookup_;
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
 
-  std::shared_ptr<tf2::BufferCore> poses_;
+  /** T_WORLD_BASELINK from the odometry or pose file */
+  std::unique_ptr<bs_common::TrajectoryBuffer> poses_;
+
+  /** splines of poses_, if enabled */
+  std::unique_ptr<bs_common::TrajectorySplineCache> spline_cache_;
 
   Eigen::Matrix4d T_ORIGINAL_OVERRIDE_{};
 
-  Path graph_path_;
+  /** pending wakeup, see WakeWhenAvailable */
+  std::mutex wakeup_mutex_;
+  uint64_t wakeup_id_{0};
+  ros::CallbackQueueInterface* wakeup_queue_{nullptr};
+
+  /** T_WORLD_BASELINK of the current graph */
+  bs_common::RcuSlot<bs_common::Trajectory> graph_path_;
   ros::Duration poses_buffer_duration_;
   ros::Subscriber odometry_subscriber_;
   ros::Subscriber path_subscriber_;
   bool check_world_baselink_frames_{true};
   bool override_sensor_frame_id_{false};
   std::string sensor_frame_id_;
-  std::mutex path_mutex_;
   std::string type_;
 };
 
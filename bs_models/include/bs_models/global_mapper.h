@@ -1,13 +1,18 @@
 #pragma once
 
+#include <atomic>
+
 #include <fuse_core/async_sensor_model.h>
 #include <fuse_core/fuse_macros.h>
 #include <fuse_core/throttled_callback.h>
 #include <fuse_core/uuid.h>
 #include <fuse_graphs/hash_graph.h>
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
 
 #include <bs_common/bs_msgs.h>
 #include <bs_models/global_mapping/global_map.h>
+#include <bs_optimizers/graph_snapshot_builder.h>
 #include <bs_parameters/models/calibration_params.h>
 #include <bs_parameters/models/global_mapper_params.h>
 
@@ -51,6 +56,16 @@ public:
    */
   void ProcessSlamChunk(const bs_common::SlamChunkMsg::ConstPtr& msg);
 
+  /**
+   * @brief This function takes a reloc request, e.g. from a tracker that lost
+   * the map, and queues it on the reloc server of the global map, which
+   * answers it on its own workers (see global_mapping::RelocServer). Requests
+   * are received on their own callback queue, so they are never blocked by
+   * slam chunks and vice versa
+   * @param msg reloc request with the lidar clouds in the baselink frame
+   */
+  void ProcessRelocRequest(const bs_common::RelocRequestMsg::ConstPtr& msg);
+
 private:
   /**
    * @brief initi subscriber
@@ -79,6 +94,13 @@ private:
    */
   void UpdateExtrinsics();
 
+  /**
+   * @brief publish the response to a reloc request, called from the reloc
+   * server workers
+   */
+  void PublishRelocResponse(
+      const global_mapping::RelocServer::Response& response);
+
   fuse_core::UUID device_id_; //!< The UUID of this device
   bs_parameters::models::GlobalMapperParams params_;
   bs_parameters::models::CalibrationParams calibration_params_;
@@ -93,7 +115,7 @@ private:
   std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_data_;
   bs_common::ExtrinsicsLookupOnline& extrinsics_online_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
-  bool extrinsics_initialized_{false};
+  std::atomic<bool> extrinsics_initialized_{false};
   std::string save_path_;
 
   std::unique_ptr<global_mapping::GlobalMap> global_map_;
@@ -109,14 +131,27 @@ private:
   ros::Publisher submap_keypoints_publisher_;
   ros::Publisher global_map_lidar_publisher_;
   ros::Publisher global_map_keypoints_publisher_;
+  ros::Publisher global_map_lidar_tiles_publisher_;
   ros::Publisher new_scans_publisher_;
 
+  /** reloc requests and responses, only used if the global map has a reloc
+   * server */
+  ros::CallbackQueue reloc_callback_queue_;
+  std::unique_ptr<ros::AsyncSpinner> reloc_spinner_;
+  ros::Subscriber reloc_request_subscriber_;
+  ros::Publisher reloc_response_publisher_;
+  int reloc_response_seq_{0};
+
   // params that can only be set here:
   int max_output_map_size_{3000000}; // limits output size of lidar maps
   bool trigger_loop_closure_on_stop_{false};
 
   //   store a pointer to a graph for running the PGO
   std::shared_ptr<fuse_graphs::HashGraph> graph_;
+
+  /** snapshots of graph_ with the variables that changed in each
+   * optimization, so only the submaps that moved are updated */
+  bs_optimizers::GraphSnapshotBuilder graph_snapshot_builder_;
 };
 
 } // namespace bs_models
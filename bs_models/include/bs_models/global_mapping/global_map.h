@@ -1,8 +1,15 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <queue>
+#include <thread>
+#include <unordered_map>
 
 #include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
 #include <sensor_msgs/PointCloud2.h>
 
 #include <beam_filtering/Utils.h>
@@ -10,7 +17,16 @@
 
 #include <bs_common/bs_msgs.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_models/global_mapping/reloc_server.h>
 #include <bs_models/global_mapping/submap.h>
+#include <bs_models/global_mapping/submap_position_index.h>
+#include <bs_models/global_mapping/submap_prefetcher.h>
+#include <bs_models/global_mapping/submap_sizer.h>
+#include <bs_models/global_mapping/submap_evictor.h>
+#include <bs_models/global_mapping/submap_tile_store.h>
+#include <bs_models/global_mapping/submap_working_set.h>
+#include <bs_models/global_mapping/tiled_lidar_map.h>
+#include <bs_models/lidar/filter_pipeline.h>
 #include <bs_models/reloc/reloc_candidate_search_base.h>
 #include <bs_models/reloc/reloc_refinement_base.h>
 
@@ -25,6 +41,7 @@ enum class RosMapType {
   VISUALSUBMAP,
   VISUALGLOBALMAP,
   LIDARNEW,
+  LIDARGLOBALMAPTILE,
 };
 
 using RosMap = std::pair<RosMapType, sensor_msgs::PointCloud2>;
@@ -45,6 +62,11 @@ public:
     /** Max linear distance between poses in a submap */
     double submap_size{10};
 
+    /** Budgets of lidar points, landmark measurements and keyframes per
+     * submap, which split dense submaps early and let sparse ones grow past
+     * submap_size, see SubmapSizer */
+    SubmapSizer::Params adaptive_submaps;
+
     /** Full path to config file for loop closure candidate search. If blank, it
      * will use default parameters.*/
     std::string loop_closure_candidate_search_config;
@@ -71,11 +93,100 @@ public:
      * creating the global map */
     std::vector<beam_filtering::FilterParamsType> ros_globalmap_filter_params;
 
+    /** filter pipelines compiled from the params above */
+    FilterPipeline<pcl::PointXYZ> ros_submap_filters;
+    FilterPipeline<pcl::PointXYZ> ros_globalmap_filters;
+
+    /** If enabled, the lidar global map is published as level of detail
+     * tiles, and only the tiles that changed are published on each update
+     * (see TiledLidarMap). Submap filters are applied to the submap points in
+     * the submap frame, global map filters are not applied */
+    TiledLidarMap::Params ros_globalmap_tiles;
+
     /** string to store the full config from json*/
     std::string config_str;
 
     bool disable_loop_closure{false};
 
+    /** If true, loop closure is run on a background thread instead of inside
+     * AddMeasurement. Completed loop closures are returned by the next call to
+     * AddMeasurement, or by GetCompletedLoopClosures() */
+    bool async_loop_closure{false};
+
+    /** Max number of loop closure jobs waiting to be processed when running
+     * asynchronously. If full, the oldest job is dropped since it is stale. */
+    int loop_closure_queue_size{3};
+
+    /** If true, completed submaps are finalized on the background worker
+     * instead of inside AddMeasurement: their loop closure candidate search
+     * descriptors are computed, their ros submap messages are built and loop
+     * closure is run on them, in that order. This implies async_loop_closure,
+     * and when the queue is full only the loop closure of the oldest job is
+     * dropped so that all completed submaps are still published */
+    bool async_submap_finalization{false};
+
+    /** If true, the lidar keyframe clouds of each completed submap are
+     * compressed once it is finalized, see ScanPose::CompressClouds. This
+     * reduces the memory of long mapping sessions, at the cost of decoding the
+     * clouds whenever they are read */
+    bool compress_lidar_keyframes{false};
+
+    /** Out of core storage of the lidar clouds of completed submaps which are
+     * far from the robot while mapping, see SubmapEvictor */
+    SubmapEvictor::Params submap_eviction;
+
+    /** Loads the evicted or paged out submaps near the path ahead of the
+     * robot in the background, before loop closure or localization needs
+     * them, see SubmapPrefetcher */
+    SubmapPrefetcher::Params submap_prefetch;
+
+    /** Number of threads used to refine loop closure candidates in parallel.
+     * Each thread owns its own refinement object */
+    int loop_closure_num_threads{1};
+
+    /** Number of threads used to load and save submaps in parallel. Each
+     * thread reads or writes one submap at a time */
+    int io_num_threads{4};
+
+    /** How the lidar submaps, keypoint submaps, trajectory clouds and submap
+     * frames are exported (see SaveLidarSubmaps). Submaps are exported in
+     * parallel by io_num_threads workers */
+    struct ExportParams {
+      /** write binary compressed pcds, which are several times smaller than
+       * binary pcds but slower to read */
+      bool compress_pcds{false};
+
+      /** if greater than 0, the combined lidar map is written as cubic tiles
+       * of this size instead of a single cloud, one file per tile */
+      double tile_size_m{0};
+
+      /**
+       * @brief load params from json, missing params keep their defaults
+       */
+      void LoadFromJson(const nlohmann::json& J);
+
+      /**
+       * @brief get params as json
+       */
+      nlohmann::json ToJson() const;
+    };
+    ExportParams map_export;
+
+    /** How keyframe images are stored in the submaps, see
+     * vision::KeyframeImageStore */
+    vision::KeyframeImageStore::Params keyframe_images;
+
+    /** Answers relocalization requests against the completed submaps while
+     * mapping, see RelocServer. It uses the loop closure candidate search and
+     * refinement configs */
+    RelocServer::Params reloc_server;
+
+    /** Pushes each completed submap to a submap tile store shared with other
+     * robots, see SubmapTileStore. Tiles are written where the submaps are
+     * finalized, so use async_submap_finalization to keep the writes out of
+     * AddMeasurement */
+    SubmapTileStore::Params tile_store;
+
     /** Loads config settings from a json file. If config_path empty, it will
      * use default params defined herein.*/
     void LoadJson(const std::string& config_path);
@@ -94,8 +205,10 @@ public:
    * @brief constructor that requires a root directory to global map data. For
    * data format, see SaveData function
    * @param data_root_directory full path to global map data.
+   * @param load_lidar_clouds see Load
    */
-  GlobalMap(const std::string& data_root_directory);
+  GlobalMap(const std::string& data_root_directory,
+            bool load_lidar_clouds = true);
 
   /**
    * @brief constructor requiring only a pointer to camera model object
@@ -126,9 +239,9 @@ public:
             const std::string& config_path);
 
   /**
-   * @brief default destructor
+   * @brief destructor. This stops the loop closure worker if it is running
    */
-  ~GlobalMap() = default;
+  ~GlobalMap();
 
   /**
    * @brief setup general things needed when class is instantiated, such as
@@ -149,6 +262,16 @@ public:
    */
   Params& GetParamsMutable();
 
+  /**
+   * @brief get the camera model, shared with the submaps
+   */
+  std::shared_ptr<beam_calibration::CameraModel> GetCameraModel() const;
+
+  /**
+   * @brief get the extrinsics, shared with the submaps
+   */
+  std::shared_ptr<bs_common::ExtrinsicsLookupBase> GetExtrinsics() const;
+
   /**
    * @brief set the submaps vector
    * @param submaps vector of pointers to submaps to be stored in this global
@@ -221,7 +344,21 @@ public:
                      const ros::Time& stamp);
 
   /**
-   * @brief Update submap poses with a new graph message
+   * @brief unpack the clouds of a lidar measurement, which are either packed
+   * float32 clouds or arrays of points (see LidarMeasurementMsg::packed)
+   * @param lid_measurement lidar measurement to unpack
+   * @param cloud output cloud of the lidar points
+   * @param loam_cloud output cloud of the loam features
+   */
+  static void UnpackLidarMeasurement(
+      const bs_common::LidarMeasurementMsg& lid_measurement, PointCloud& cloud,
+      beam_matching::LoamPointCloud& loam_cloud);
+
+  /**
+   * @brief Update submap poses with a new graph message. If the graph message
+   * is a bs_common::GraphSnapshot, only the submaps whose pose variables are
+   * in its delta are updated, and the ROS global map is only rebuilt (when
+   * the ROS maps are retrieved) if a submap moved
    * @param graph_msg updated graph which should have all submap poses stored
    * @param update_time ros time of this update
    */
@@ -244,42 +381,111 @@ public:
    */
   fuse_core::Transaction::SharedPtr RunLoopClosure(int query_index = -1);
 
+  /**
+   * @brief get all loop closures completed by the background worker since the
+   * last call. Only used if params_.async_loop_closure is true
+   * @return merged transaction, or nullptr if none are available
+   */
+  fuse_core::Transaction::SharedPtr GetCompletedLoopClosures();
+
+  /**
+   * @brief process all pending loop closure and submap finalization jobs and
+   * then stop the background worker. Results can be retrieved with
+   * GetCompletedLoopClosures(). This should be called before RunLoopClosure()
+   * when running asynchronously so that the worker and the caller don't use
+   * the reloc objects at the same time
+   */
+  void FinishLoopClosures();
+
   /**
    * @brief Save full global map to a format that can be reloaded later for new
    * mapping sessions. Format will be as follows:
    *
    *  /output_path/
-   *    image_db_timestamps.json
    *    params.json
    *    camera_model.json
+   *    extrinsics.json
+   *    frame_ids.json
+   *    submaps.bin
+   *
+   *  Where submaps.bin is the binary map store holding all submaps, see
+   *  map_store.h. If use_map_store is false, the submaps are instead saved to
+   *  one directory each, in the format described in submap.h:
+   *
    *    /submap0/
    *      ...
-   *    /submap1/
-   *      ...
    *    ...
    *    /submapN/
    *       ...
    *
-   *  Where the format of the submap data is described in submap.h
-   *
    * @param output_path full path to directory
+   * @param use_map_store set to false to save the submaps to directories
    */
-  void SaveData(const std::string& output_path);
+  void SaveData(const std::string& output_path, bool use_map_store = true);
 
   /**
    * @brief load all global map data from a previous mapping session. This
-   * requires the exact format show above in SaveFullGlobalMap() function. There
-   * must be no other data in this directory
+   * requires the exact format show above in SaveData() function, with either
+   * the map store or the submap directories. There must be no other data in
+   * this directory
    * @param root_directory root directory of the global map data
+   * @param load_lidar_clouds if false, the lidar keyframes are loaded without
+   * their clouds and the map store is kept open (see MapStore), so the clouds
+   * can be paged in with a SubmapWorkingSet. Requires the map store format
    * @return true if successful
    */
-  bool Load(const std::string& root_directory);
+  bool Load(const std::string& root_directory, bool load_lidar_clouds = true);
+
+  /**
+   * @brief get the map store the submaps were loaded from without their lidar
+   * clouds, nullptr if the clouds were loaded
+   */
+  std::shared_ptr<const bs_common::ChunkFileReader> MapStore() const;
+
+  /**
+   * @brief get the server answering relocalization requests against the
+   * completed submaps, nullptr if params_.reloc_server is not enabled
+   */
+  std::shared_ptr<RelocServer> GetRelocServer() const;
+
+  /**
+   * @brief get the tile store the completed submaps are pushed to, e.g. to
+   * fetch the tiles of other robots. nullptr if params_.tile_store is not
+   * enabled
+   */
+  std::shared_ptr<SubmapTileStore> GetTileStore() const;
+
+  /**
+   * @brief set the working set used to page in the lidar clouds of the submaps
+   * when saving them, for global maps loaded without their clouds. The working
+   * set must be over the current submaps
+   */
+  void SetWorkingSet(const std::shared_ptr<SubmapWorkingSet>& working_set);
+
+  /**
+   * @brief prefetch the completed submaps near the path ahead of the robot,
+   * if params_.submap_prefetch is enabled. This is called by AddMeasurement,
+   * and can be called directly when localizing against a loaded map
+   * @param t_WORLD_BASELINK position of the robot
+   * @param stamp time of the position
+   */
+  void UpdatePrefetch(const Eigen::Vector3d& t_WORLD_BASELINK,
+                      const ros::Time& stamp);
+
+  /**
+   * @brief set the path the robot is going to follow, which is prefetched
+   * instead of the path extrapolated from its velocity
+   * @param path positions in the world frame, in the order they are reached.
+   * Empty to go back to extrapolating
+   */
+  void SetPlannedPath(const std::vector<Eigen::Vector3d>& path);
 
   /**
    * @brief Save each lidar submap to pcd files. A lidar submap consists of an
    * aggregation of all scans in the submap transformed to the world frame using
    * the submap pose estimate and the relative pose measurements of all scans
-   * relative to their submap anchor.
+   * relative to their submap anchor. The submaps are also combined into one
+   * map, which is split into tiles if params_.map_export.tile_size_m is set.
    * @param output_path where to save the submaps
    * @param save_initial set to true to save the initial map from the
    * local mapper, before global optimization
@@ -332,12 +538,81 @@ private:
    * outside the current submap range (since we need the pose and stamp to
    * construct a submap). Note: since the incoming frame is still in world frame
    * of the local mapper, we need to use the initial T_WORLD_SUBMAP before any
-   * loop closures were run.
+   * loop closures were run. The submap boundaries are decided by
+   * submap_sizer_.
    * @param T_WORLD_FRAME transform from current frame to local mapper's world
    * frame
    */
   int GetSubmapId(const Eigen::Matrix4d& T_WORLD_FRAME);
 
+  /**
+   * @brief load all submaps from the binary map store (see map_store.h). The
+   * params, camera model and extrinsics must be loaded first
+   * @param store_path full path to the map store
+   * @param load_lidar_clouds see Load
+   * @return true if successful
+   */
+  bool LoadMapStore(const std::string& store_path, bool load_lidar_clouds);
+
+  /** leases on the clouds of a submap, from the working set and the evictor
+   * if they are in use */
+  struct SubmapLease {
+    SubmapWorkingSet::Lease working_set;
+    SubmapEvictor::Lease evictor;
+  };
+
+  /**
+   * @brief lease the clouds of a submap from the working set and the submap
+   * evictor, if there are any
+   */
+  SubmapLease LeaseSubmap(size_t submap_id) const;
+
+  /**
+   * @brief run task(i) for every submap index i in [0, num_submaps) on a pool
+   * of params_.io_num_threads workers, logging the progress as submaps finish
+   * @param num_submaps number of submaps
+   * @param action name of the task used in the progress logs
+   * @param task loads or saves one submap, returns false on failure
+   * @param item name of the items used in the progress logs, for tasks which
+   * are indexed by something other than submaps
+   * @return true if all tasks succeeded
+   */
+  bool ForEachSubmapParallel(size_t num_submaps, const std::string& action,
+                             const std::function<bool(size_t)>& task,
+                             const std::string& item = "submap") const;
+
+  /**
+   * @brief save the lidar submaps and their combined map to a directory, see
+   * SaveLidarSubmaps
+   * @param submaps_path directory to save to, created if it does not exist
+   * @param use_initials set to true to use the initial submap poses
+   */
+  void ExportLidarSubmaps(const std::string& submaps_path,
+                          bool use_initials) const;
+
+  /**
+   * @brief save a combined lidar map as cubic tiles of
+   * params_.map_export.tile_size_m, named tile_X_Y_Z.pcd after the integer
+   * coordinates of the tile
+   * @param tiles_path directory to save to, created if it does not exist
+   * @param map lidar map in world frame
+   */
+  void ExportLidarTiles(const std::string& tiles_path,
+                        const PointCloud& map) const;
+
+  /**
+   * @brief get the baselink positions of the trajectory as a cloud, labelled
+   * with their stamps
+   */
+  pcl::PointCloud<pcl::PointXYZRGBL>
+      GetTrajectoryCloud(bool use_initials) const;
+
+  /**
+   * @brief get the RGB frames of all submap poses as a cloud
+   */
+  pcl::PointCloud<pcl::PointXYZRGBL>
+      GetSubmapFramesCloud(bool use_initials) const;
+
   /**
    * @brief takes the latest submap (back of vector) and adds a pose constraint
    * between it and it's previous submap. If it's the first submap, it will add
@@ -349,10 +624,12 @@ private:
 
   /**
    * @brief adds submap points (lidar points and camera keypoints) to the queue
-   * of ros messages to be published
-   * @param submap_id index to submap to add
+   * of ros messages to be published. Thread safe, as long as the submap isn't
+   * modified while this runs
+   * @param submap submap to add
+   * @param submap_id index of the submap, used as the message sequence
    */
-  void AddRosSubmap(int submap_id);
+  void AddRosSubmap(const SubmapPtr& submap, int submap_id);
 
   /**
    * @brief adds global map points (lidar points and camera keypoints) to the
@@ -360,6 +637,13 @@ private:
    */
   void AddRosGlobalMap();
 
+  /**
+   * @brief updates the tiled lidar map with the completed submaps and their
+   * poses, and adds the tiles that changed or changed level to the list of
+   * Ros maps
+   */
+  void AddRosGlobalMapTiles();
+
   /**
    * @brief adds new lidar scans  to the
    * queue of ros messages to be published
@@ -370,6 +654,70 @@ private:
   void AddNewRosScan(const PointCloud& cloud,
                      const Eigen::Matrix4d& T_WORLD_BASELINK,
                      const ros::Time& stamp);
+
+  /**
+   * @brief run loop closure for a query submap against a set of submaps
+   * @param submaps all submaps to search for candidates in
+   * @param query_index index of the query submap in submaps, or -1 for last
+   * @param snapshot_submaps if true, the query and candidate submaps are copied
+   * before refinement so that pose updates from other threads don't affect the
+   * refinement. Only the poses are read with submap_poses_mutex_ locked, the
+   * candidate search and the copies run outside of it
+   * @return fuse transaction with the loop closure constraints
+   */
+  fuse_core::Transaction::SharedPtr
+      RunLoopClosure(const std::vector<SubmapPtr>& submaps, int query_index,
+                     bool snapshot_submaps);
+
+  /**
+   * @brief add a job for a completed submap to the queue of the background
+   * worker. This starts the worker if it isn't already running.
+   * @param submap_id index of the completed submap
+   * @param add_ros_submap whether to build the ros submap messages
+   * @param run_loop_closure whether to run loop closure on the submap
+   * @return true if a job was queued, which then also finishes the submap (see
+   * FinishSubmap())
+   */
+  bool QueueSubmapFinalization(int submap_id, bool add_ros_submap,
+                               bool run_loop_closure);
+
+  /**
+   * @brief compress the lidar keyframes of a completed submap if enabled, and
+   * pass a copy of it to the reloc server and tile store. This is the last
+   * step for a completed submap, since the loop closure search may read the
+   * clouds of the submap without submap_poses_mutex_ locked
+   * @param submap_id index of the completed submap
+   * @param submap completed submap
+   */
+  void FinishSubmap(int submap_id, const SubmapPtr& submap);
+
+  /**
+   * @brief function run by the background worker thread
+   */
+  void SubmapFinalizationWorker();
+
+  /**
+   * @brief sync the submap position index with the poses of all submaps. Only
+   * the submaps that moved to a different cell are re-indexed. Must be called
+   * with submap_poses_mutex_ locked
+   */
+  void UpdateSubmapPositionIndex();
+
+  /**
+   * @brief add the pose variables of submaps that were added since the last
+   * call to submap_ids_by_pose_variable_. Must be called with
+   * submap_poses_mutex_ locked
+   */
+  void IndexSubmapPoseVariables();
+
+  /**
+   * @brief update the "global_map/submaps" memory account with the lidar
+   * clouds of all submaps. If it is over budget and submap eviction is
+   * enabled, the least recently used completed submaps are evicted until it
+   * is within budget
+   */
+  void UpdateMemoryAccount();
+
   Params params_;
 
   /** If set to true, this will store recently completed submaps as a
@@ -417,11 +765,76 @@ private:
       loop_closure_candidate_search_;
   std::shared_ptr<reloc::RelocRefinementBase> loop_closure_refinement_;
 
+  /** one refinement object per loop closure thread, the first is
+   * loop_closure_refinement_ */
+  std::vector<std::shared_ptr<reloc::RelocRefinementBase>>
+      loop_closure_refinements_;
+
+  // async loop closure and submap finalization
+  struct FinalizationJob {
+    int submap_id;
+    std::vector<SubmapPtr> submaps;
+    bool add_ros_submap;
+    bool run_loop_closure;
+
+    /** keeps the clouds of the submaps read by this job from being evicted */
+    SubmapEvictor::Lease lease;
+  };
+  std::thread finalization_thread_;
+  std::mutex finalization_jobs_mutex_;
+  std::condition_variable finalization_jobs_cv_;
+  std::deque<FinalizationJob> finalization_jobs_;
+  bool stop_finalization_worker_{false};
+  std::mutex completed_loop_closures_mutex_;
+  std::queue<fuse_core::Transaction::SharedPtr> completed_loop_closures_;
+
+  /** locked when submap poses are being read by loop closure or updated */
+  std::mutex submap_poses_mutex_;
+
+  /** index over the submap positions, only accessed with submap_poses_mutex_
+   * locked. The loop closure candidate search gets a copy of it on each run */
+  std::shared_ptr<SubmapPositionIndex> submap_position_index_{
+      std::make_shared<SubmapPositionIndex>()};
+
+  /** submap id of each submap pose variable, used to update only the submaps
+   * in a graph delta. Only accessed with submap_poses_mutex_ locked */
+  std::unordered_map<fuse_core::UUID, uint16_t, fuse_core::uuid::hash>
+      submap_ids_by_pose_variable_;
+  size_t num_indexed_submaps_{0};
+
+  /** only set if the submaps were loaded without their lidar clouds */
+  std::shared_ptr<const bs_common::ChunkFileReader> map_store_;
+  std::string map_store_path_;
+  std::shared_ptr<SubmapWorkingSet> working_set_;
+
+  /** only set if params_.submap_eviction is enabled */
+  std::shared_ptr<SubmapEvictor> submap_evictor_;
+
+  /** only set if params_.submap_prefetch is enabled. Its handles lease from
+   * the working set and the evictor, so it is declared after them to be
+   * destroyed first */
+  std::unique_ptr<SubmapPrefetcher> submap_prefetcher_;
+
+  /** tracks the content of the current submap */
+  SubmapSizer submap_sizer_;
+
+  /** only set if params_.reloc_server is enabled */
+  std::shared_ptr<RelocServer> reloc_server_;
+  std::shared_ptr<SubmapTileStore> tile_store_;
+
   // ros maps
+  std::mutex ros_submaps_mutex_;
   std::queue<std::shared_ptr<RosMap>> ros_submaps_;
   std::queue<std::shared_ptr<RosMap>> ros_new_scans_;
   std::shared_ptr<RosMap> ros_global_lidar_map_;
   std::shared_ptr<RosMap> ros_global_keypoints_map_;
+  std::queue<std::shared_ptr<RosMap>> ros_global_map_tiles_;
+  bool ros_global_map_outdated_{false};
+  TiledLidarMap ros_tiled_map_;
+  TiledLidarMap::TileVersions ros_sent_tiles_;
+
+  /** position of the last measurement, used as viewpoint for the tiles */
+  Eigen::Vector3d ros_viewpoint_{Eigen::Vector3d::Zero()};
 
   // -------------------------
   // params only tunable here:
@@ -1,12 +1,22 @@
 #pragma once
 
+#include <deque>
+#include <mutex>
+
+// Keep this include before any opencv include
+#include <pcl/kdtree/kdtree_flann.h>
+
 #include <fuse_graphs/hash_graph.h>
 #include <fuse_variables/orientation_3d_stamped.h>
 #include <fuse_variables/position_3d_stamped.h>
 
 #include <beam_matching/Matcher.h>
 
+#include <bs_common/thread_pool.h>
+#include <bs_models/global_mapping/registration_cache.h>
+#include <bs_models/global_mapping/submap_working_set.h>
 #include <bs_models/global_mapping/utils.h>
+#include <bs_optimizers/incremental_problem.h>
 
 namespace bs_models::global_mapping {
 
@@ -22,6 +32,15 @@ public:
     int lc_max_per_query_scan; // set to 0 to not do lc, or -1 to not set a max
     double lc_scan_context_dist_thres;
     double lc_cov_multiplier;
+
+    // number of most recent scans optimized when update_graph_on_all_scans is
+    // set, older scans are held constant and their poses are not updated. Set
+    // to 0 to optimize all scans
+    int optimization_window_scans{0};
+
+    // number of loop closure candidates verified in parallel, each worker has
+    // its own matcher
+    int lc_num_threads{1};
   };
 
   GlobalMapBatchOptimization() = delete;
@@ -33,6 +52,22 @@ public:
 
   bool Run(std::vector<SubmapPtr> submaps);
 
+  /**
+   * @brief set a working set over the submaps passed to Run, used to page in
+   * the lidar clouds around the current scan and the loop closure candidates
+   * when the submaps were loaded without them
+   */
+  void SetWorkingSet(const std::shared_ptr<SubmapWorkingSet>& working_set) {
+    working_set_ = working_set;
+  }
+
+  /**
+   * @brief set a cache of loop closure registration results between scans,
+   * pairs found in it are not registered again and the new registrations are
+   * added to it
+   */
+  void SetRegistrationCache(const std::shared_ptr<RegistrationCache>& cache);
+
 private:
   struct LoopClosureMeasurement {
     Eigen::Matrix4d T_Query_Candidate_Measured;
@@ -51,8 +86,71 @@ private:
 
   void RunLoopClosureOnAllScans(ScanPose& query);
 
+  /**
+   * @brief build the kd-tree of scan positions in the world frame, along with
+   * the trajectory length up to each scan, from the current scan poses
+   */
+  void BuildScanPositionIndex();
+
+  /**
+   * @brief get the scan context descriptor of the aggregated scan around a
+   * scan. Descriptors are cached since neighbouring queries share candidates
+   */
+  Eigen::MatrixXd GetScanContext(uint64_t scan_time_ns);
+
+  /**
+   * @brief check the scan context distance between a query and a candidate
+   * scan, then register them
+   * @param worker index of the matcher to use, which must not be in use by
+   * another thread
+   * @return false if the candidate is rejected
+   */
+  bool MeasureLoopClosure(const ScanPose& query,
+                          const Eigen::MatrixXd& sc_query,
+                          uint64_t candidate_stamp, int candidate_submap_id,
+                          size_t worker, LoopClosureMeasurement& measurement);
+
+  /**
+   * @brief remove cached scan contexts whose aggregated scans contain scans at
+   * or after a time
+   */
+  void InvalidateScanContexts(uint64_t min_timestamp);
+
+  /**
+   * @brief add a transaction to the graph, and to the incremental problem if
+   * the graph is optimized before the final optimization
+   */
+  void AddTransaction(const fuse_core::Transaction& transaction);
+
+  /**
+   * @brief add a scan to the optimization window, holding the oldest scan
+   * constant once the window is full
+   */
+  void AddToOptimizationWindow(const ScanPose& scan);
+
+  /**
+   * @brief optimize the scans in the optimization window and update only
+   * their poses and the poses of their submaps
+   * @param max_timestamp stamp of the last scan added to the graph (nsec)
+   */
+  void OptimizeWindow(uint64_t max_timestamp);
+
+  /**
+   * @brief optimize all scans in the graph, including those held constant by
+   * the optimization window, and update the poses of all scans
+   * @param max_timestamp stamp of the last scan added to the graph (nsec)
+   */
+  void OptimizeAll(uint64_t max_timestamp);
+
   pcl::PointCloud<pcl::PointXYZI> AggregateScan(uint64_t scan_time_ns) const;
 
+  /**
+   * @brief lease the submaps of all scans aggregated around each scan (see
+   * AggregateScan), returns an empty lease if there is no working set
+   */
+  SubmapWorkingSet::Lease
+      LeaseAggregatedSubmaps(const std::vector<uint64_t>& scan_times_ns) const;
+
   void ConvertScanPosesToWorld(std::vector<SubmapPtr> submaps);
 
   void UpdateInputSubmaps(std::vector<SubmapPtr> submaps);
@@ -65,10 +163,28 @@ private:
 
   Params params_;
   std::string output_path_;
-  std::unique_ptr<beam_matching::Matcher<PointCloudPtr>> matcher_;
-  std::unique_ptr<beam_matching::Matcher<beam_matching::LoamPointCloudPtr>>
-      matcher_loam_;
+  // one matcher per loop closure worker
+  std::vector<std::unique_ptr<beam_matching::Matcher<PointCloudPtr>>>
+      matchers_;
+  std::vector<
+      std::unique_ptr<beam_matching::Matcher<beam_matching::LoamPointCloudPtr>>>
+      matchers_loam_;
+  std::unique_ptr<bs_common::ThreadPool> pool_;
   std::shared_ptr<fuse_graphs::HashGraph> graph_;
+
+  // persistent problem used to optimize the graph between scans, so the
+  // problem is not rebuilt from the whole graph for every optimization
+  bs_optimizers::IncrementalProblem problem_;
+  std::deque<uint64_t> optimization_window_; // scan stamps in the window
+  std::vector<fuse_core::UUID> held_variables_;
+
+  // loop closure candidate search, rebuilt when all scan poses are updated
+  pcl::KdTreeFLANN<pcl::PointXYZ> scan_position_tree_;
+  std::vector<uint64_t> scan_position_stamps_; // stamp of each tree point
+  std::map<uint64_t, double> trajectory_lengths_; // <stamp, length to scan>
+  bool rebuild_scan_position_index_{true};
+  std::mutex scan_contexts_mutex_;
+  std::map<uint64_t, Eigen::MatrixXd> scan_contexts_;
   std::map<uint64_t, int> scan_stamp_to_submap_id_;
   std::string lidar_frame_id_;
 
@@ -77,9 +193,19 @@ private:
   // frame. Then once done the run() function, we convert back
   std::vector<SubmapPtr> submaps_;
 
+  // working set over the input submaps, and over submaps_ once converted
+  std::shared_ptr<SubmapWorkingSet> working_set_;
+  std::shared_ptr<SubmapWorkingSet> submaps_working_set_;
+
+  std::shared_ptr<RegistrationCache> cache_;
+  uint64_t cache_context_{0};
+
   // params only tunable here:
   int scans_to_aggregate_{30};
   int min_measurements_for_outlier_rejection_{5};
+  // scans that moved since the kd-tree was built are still found if they moved
+  // less than this
+  double lc_search_margin_m_{1.0};
   const Eigen::Vector3f scan_context_voxel_filter_{0.04, 0.04, 0.04};
 };
 
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <bs_models/global_mapping/global_map.h>
+#include <bs_models/global_mapping/submap_pose_graph_optimization.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Merges global maps from several mapping sessions (robots or days)
+ * into one global map, in the world frame of the first map. This is done in
+ * three steps:
+ *
+ * (1) FindCandidates: the submaps of each map are queried against the submaps
+ * of every previous map with the loop closure candidate search
+ * (2) VerifyCandidates: each candidate is refined with the loop closure
+ * refinement. The candidates can be split in shards so that they are verified
+ * by separate processes, possibly on separate machines, with the results
+ * written with SaveCandidates and combined with LoadCandidates afterwards
+ * (3) Merge: the maps are moved to the world frame of the first map using the
+ * verified candidates, and a pose graph optimization is run on all submaps
+ * with the verified candidates as loop closures between the sessions
+ *
+ * All maps must come from the same sensor setup, the merged map uses the
+ * calibration of the first map. The candidate search runs on the poses of the
+ * submaps in their own world frame, so a search that compares positions (e.g.
+ * reloc::RelocCandidateSearchEucDist) only works if the sessions share a world
+ * frame. Otherwise use a place recognition search such as scan context.
+ */
+class GlobalMapMerger {
+public:
+  struct Params {
+    /** Full path to config file for the candidate search. If blank, it will
+     * use default parameters.*/
+    std::string candidate_search_config;
+
+    /** Full path to config file for the candidate refinement. If blank, it
+     * will use default parameters.*/
+    std::string refinement_config;
+
+    /** Weights to assign to the loop closures between sessions */
+    Eigen::Matrix<double, 6, 6> loop_closure_covariance{
+        Eigen::Matrix<double, 6, 6>::Identity() * 1e-5};
+
+    /** Weights to assign to local mapper measurements */
+    Eigen::Matrix<double, 6, 6> local_mapper_covariance{
+        Eigen::Matrix<double, 6, 6>::Identity() * 1e-3};
+
+    /** number of candidates refined in parallel in each process */
+    int num_threads{4};
+
+    /** If true, the pose graph optimization of the merged map also searches
+     * for loop closures over all submaps, refined on num_threads threads */
+    bool search_loop_closures_on_union{false};
+
+    /** Loads config settings from a json file. If config_path empty, it will
+     * use default params defined herein. */
+    void LoadJson(const std::string& config_path);
+  };
+
+  /**
+   * @brief candidate relative pose between a submap of a reference map and a
+   * submap of a later query map
+   */
+  struct Candidate {
+    size_t reference_map;
+    size_t reference_submap;
+    size_t query_map;
+    size_t query_submap;
+
+    /** estimate from the candidate search */
+    Eigen::Matrix4d T_REFERENCE_QUERY_EST{Eigen::Matrix4d::Identity()};
+
+    /** set by VerifyCandidates */
+    bool verified{false};
+    bool successful{false};
+    Eigen::Matrix4d T_REFERENCE_QUERY{Eigen::Matrix4d::Identity()};
+  };
+
+  GlobalMapMerger() = delete;
+
+  /**
+   * @brief constructor
+   * @param params see struct above
+   * @param output_path optional directory to save the candidate search,
+   * refinement and pose graph results to. Must exist if not empty
+   */
+  GlobalMapMerger(const Params& params, const std::string& output_path = "");
+
+  ~GlobalMapMerger() = default;
+
+  /**
+   * @brief find candidates between all pairs of maps
+   * @param maps maps to merge, the first one is the reference frame
+   * @return candidates, ordered by query map and submap
+   */
+  std::vector<Candidate>
+      FindCandidates(const std::vector<std::shared_ptr<GlobalMap>>& maps) const;
+
+  /**
+   * @brief refine the candidates of one shard, the candidate with index i is
+   * in shard i % num_shards. The other candidates are not modified
+   * @param maps maps the candidates were found on, in the same order
+   * @param candidates candidates to verify
+   * @param shard_index shard of the candidates to verify
+   * @param num_shards total number of shards
+   * @return false if the inputs are invalid
+   */
+  bool VerifyCandidates(const std::vector<std::shared_ptr<GlobalMap>>& maps,
+                        std::vector<Candidate>& candidates,
+                        size_t shard_index = 0, size_t num_shards = 1) const;
+
+  /**
+   * @brief merge all maps connected to the first map by successful candidates.
+   * Maps that are not connected are skipped with a warning. The input maps are
+   * not modified, and the initial poses of the merged submaps stay in the
+   * world frame of their own map
+   * @param maps maps the candidates were found on, in the same order
+   * @param candidates verified candidates
+   * @return merged global map, nullptr if merging failed
+   */
+  std::shared_ptr<GlobalMap>
+      Merge(const std::vector<std::shared_ptr<GlobalMap>>& maps,
+            const std::vector<Candidate>& candidates) const;
+
+  /**
+   * @brief save candidates to a json file, along with the maps they belong to
+   * @param filename full path to the json file
+   * @param map_names names of the maps (e.g. their directories), used to check
+   * that candidates are loaded for the same maps
+   * @param candidates candidates to save
+   * @param shard_index if num_shards > 1, only this shard is saved
+   * @param num_shards number of shards
+   * @return true if successful
+   */
+  static bool SaveCandidates(const std::string& filename,
+                             const std::vector<std::string>& map_names,
+                             const std::vector<Candidate>& candidates,
+                             size_t shard_index = 0, size_t num_shards = 1);
+
+  /**
+   * @brief load candidates saved with SaveCandidates. Candidates that are
+   * already in the vector are overwritten by loaded candidates with the same
+   * index, which is how the results of several shards are combined
+   * @param filename full path to the json file
+   * @param map_names names of the maps, must match the saved ones
+   * @param candidates loaded candidates
+   * @return true if successful
+   */
+  static bool LoadCandidates(const std::string& filename,
+                             const std::vector<std::string>& map_names,
+                             std::vector<Candidate>& candidates);
+
+private:
+  Params params_;
+  std::string output_path_;
+};
+
+} // namespace bs_models::global_mapping
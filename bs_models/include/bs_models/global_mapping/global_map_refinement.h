@@ -1,10 +1,14 @@
 #pragma once
 
+#include <functional>
+
 #include <bs_models/global_mapping/global_map.h>
 #include <bs_models/global_mapping/global_map_batch_optimization.h>
+#include <bs_models/global_mapping/registration_cache.h>
 #include <bs_models/global_mapping/submap_alignment.h>
 #include <bs_models/global_mapping/submap_pose_graph_optimization.h>
 #include <bs_models/global_mapping/submap_refinement.h>
+#include <bs_models/global_mapping/submap_working_set.h>
 
 namespace bs_models::global_mapping {
 
@@ -42,12 +46,46 @@ public:
     double target_submap_length_m;
   };
 
+  /**
+   * @brief params for refining global maps that do not fit in memory. The
+   * global map must then be loaded without its lidar clouds (see
+   * GlobalMap::Load), which are paged in from the map store by a
+   * SubmapWorkingSet as each step needs them. Submap resizing is not supported
+   */
+  struct StreamingParams {
+    bool enabled{false};
+
+    /** estimated memory of the lidar clouds that are kept loaded */
+    double memory_budget_mb{4096};
+  };
+
+  /**
+   * @brief params for caching the registration results of the submap
+   * alignment, the loop closures of the pose graph optimization and of the
+   * batch optimization (see RegistrationCache). Submap refinement registers
+   * scans to a map it builds as it goes, so it is not cached
+   */
+  struct RegistrationCacheParams {
+    bool enabled{false};
+
+    /** resolutions the initial guesses are quantized to */
+    double translation_resolution_m{0.01};
+    double rotation_resolution_deg{0.1};
+
+    /** file the cache is loaded from if it exists and saved to after each
+     * step. Not read from the config, leave empty to only keep the cache in
+     * memory */
+    std::string path;
+  };
+
   struct Params {
     SubmapRefinement::Params submap_refinement;
     SubmapAlignment::Params submap_alignment;
     SubmapPoseGraphOptimization::Params submap_pgo;
     GlobalMapBatchOptimization::Params batch;
     SubmapResizeParams resize;
+    StreamingParams streaming;
+    RegistrationCacheParams registration_cache;
 
     /** Loads config settings from a json file. If config_path empty, it will
      * use default params defined herein. */
@@ -57,6 +95,9 @@ public:
   struct Summary {
     RegistrationResults submap_refinement;
     RegistrationResults submap_alignment;
+    SubmapPoseGraphOptimization::Summary submap_pgo;
+    size_t registration_cache_hits{0};
+    size_t registration_cache_misses{0};
 
     void Save(const std::string& output_path) const;
   };
@@ -138,9 +179,32 @@ public:
 private:
   void Initialize();
 
+  /**
+   * @brief run a step on all submaps, or on consecutive groups of submaps that
+   * fit in the memory budget when streaming
+   * @param overlap number of submaps each group shares with the previous one
+   * @param step step to run on some of the submaps
+   * @return false if the clouds of a group cannot be loaded
+   */
+  bool RunOnSubmapGroups(
+      size_t overlap,
+      const std::function<void(const std::vector<SubmapPtr>&)>& step);
+
+  /**
+   * @brief log the hit rate of the registration cache after a step and save
+   * it, if it is enabled
+   */
+  void SaveRegistrationCache(const std::string& step);
+
   Params params_;
   std::shared_ptr<GlobalMap> global_map_;
   Summary summary_;
+
+  // only set when streaming
+  std::shared_ptr<SubmapWorkingSet> working_set_;
+
+  // only set when the registration cache is enabled
+  std::shared_ptr<RegistrationCache> registration_cache_;
 };
 
 } // namespace bs_models::global_mapping
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include <bs_common/chunk_file.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Binary store of the submaps of a global map. All submaps are stored
+ * in one chunk file (see bs_common::ChunkFileWriter) next to the global map
+ * json files, with every submap, landmark container, lidar keyframe and
+ * keyframe image in its own chunk so each can be read without parsing the
+ * others.
+ *
+ * The version is written to the file and must be bumped whenever the data of
+ * a chunk changes, so older stores can still be read or rejected.
+ */
+constexpr uint32_t kMapStoreVersion = 1;
+
+// name of the store inside the global map directory
+constexpr char kMapStoreFilename[] = "submaps.bin";
+
+enum class MapChunkType : uint32_t {
+  SUBMAP = 0, // general data, camera keyframes and subframes
+  LANDMARKS,
+  LIDAR_KEYFRAME,
+  KEYFRAME_IMAGE,
+  SCAN_CONTEXTS, // optional, see Submap::SetScanContexts
+  TILE_INFO      // only in submap tiles, see SubmapTileStore
+};
+
+/**
+ * @brief get the id of the chunk for an item of a submap, where index is the
+ * index of the lidar keyframe or image in the submap
+ */
+inline uint64_t MapChunkId(uint16_t submap_id, uint32_t index = 0) {
+  return (static_cast<uint64_t>(submap_id) << 32) | index;
+}
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_utils/math.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Sparsifies a pose graph of submaps (see SubmapPoseGraphOptimization)
+ * so that its size grows with the explored area instead of the mission time.
+ *
+ * A submap is redundant if it is within merge_distance_m and
+ * merge_rotation_deg of an older submap it is connected to by a loop closure,
+ * i.e. it is a revisit of a mapped area. Redundant submaps are merged into
+ * the older one: the pose of the merged submap is removed from the graph by
+ * marginalizing it and it follows the kept submap rigidly from then on.
+ * Marginalizing a pose creates a dense clique over its neighbours, which is
+ * replaced with the Chow-Liu tree of the clique: the clique information is
+ * linearized at the current poses and conditioned on one neighbour (the root)
+ * to remove the gauge freedom, the tree maximizing the mutual information
+ * between the other neighbours is computed, and each tree edge (plus one edge
+ * from the root) is added as a relative pose measurement with the marginal
+ * covariance of that relative pose. Finally parallel edges, e.g. several loop
+ * closures between the same submaps, are combined into one edge with the same
+ * linearized information.
+ *
+ * Edges use the same error as the relative pose constraints of the graph
+ * (fuse_constraints::RelativePose3DStampedConstraint): the position error in
+ * the frame of the first pose, followed by the angle axis orientation error,
+ * so the covariances can be used for those constraints directly. All
+ * linearizations are done numerically around the given poses, which should be
+ * optimized. This class is stateless and thread safe.
+ */
+class PoseGraphSparsifier {
+public:
+  struct Params {
+    bool enabled{false};
+
+    /** max distance and rotation between a submap and the older submap it is
+     * merged into */
+    double merge_distance_m{2.0};
+    double merge_rotation_deg{30.0};
+
+    /** sparsify after this many loop closures were added to the graph */
+    int loop_closures_per_sparsification{10};
+  };
+
+  /**
+   * @brief relative pose measurement between two nodes
+   */
+  struct Edge {
+    size_t from;
+    size_t to;
+    Eigen::Matrix4d T_FROM_TO{Eigen::Matrix4d::Identity()};
+    Eigen::Matrix<double, 6, 6> covariance{
+        Eigen::Matrix<double, 6, 6>::Identity()};
+  };
+
+  /**
+   * @brief node removed from the graph, which follows the kept node
+   */
+  struct Merge {
+    size_t kept;
+    Eigen::Matrix4d T_KEPT_MERGED{Eigen::Matrix4d::Identity()};
+  };
+
+  using Poses = std::vector<Eigen::Matrix4d, beam::AlignMat4d>;
+
+  PoseGraphSparsifier() = default;
+
+  explicit PoseGraphSparsifier(const Params& params);
+
+  /**
+   * @brief merge the redundant nodes of a graph, oldest first, then combine
+   * parallel edges
+   * @param Ts_WORLD_NODE current pose of each node, by index
+   * @param fixed_nodes nodes which are never merged, e.g. the node with the
+   * prior
+   * @param edges edges of the graph, updated in place
+   * @param merged merged nodes, new merges are added and merges into a node
+   * which is merged itself are moved to its kept node
+   * @return number of nodes merged
+   */
+  size_t Sparsify(const Poses& Ts_WORLD_NODE,
+                  const std::set<size_t>& fixed_nodes, std::vector<Edge>& edges,
+                  std::map<size_t, Merge>& merged) const;
+
+  /**
+   * @brief remove a node from a graph, replacing the edges to it with the
+   * Chow-Liu tree over its neighbours
+   */
+  static void MarginalizeNode(size_t node, const Poses& Ts_WORLD_NODE,
+                              std::vector<Edge>& edges);
+
+  /**
+   * @brief combine the edges between the same nodes into one edge
+   */
+  static void CombineParallelEdges(const Poses& Ts_WORLD_NODE,
+                                   std::vector<Edge>& edges);
+
+  /**
+   * @brief error of an edge at the given poses
+   */
+  static Eigen::Matrix<double, 6, 1> Error(const Eigen::Matrix4d& T_WORLD_FROM,
+                                           const Eigen::Matrix4d& T_WORLD_TO,
+                                           const Eigen::Matrix4d& T_FROM_TO);
+
+private:
+  using Matrix6 = Eigen::Matrix<double, 6, 6>;
+
+  /**
+   * @brief numerical jacobians of the error of an edge w.r.t. perturbations
+   * of the two poses (world frame position, local orientation)
+   */
+  static void Jacobians(const Eigen::Matrix4d& T_WORLD_FROM,
+                        const Eigen::Matrix4d& T_WORLD_TO,
+                        const Eigen::Matrix4d& T_FROM_TO, Matrix6& J_from,
+                        Matrix6& J_to);
+
+  /**
+   * @brief find the older node a node can be merged into
+   * @return false if it is not redundant
+   */
+  bool FindKeptNode(size_t node, const Poses& Ts_WORLD_NODE,
+                    const std::vector<Edge>& edges,
+                    const std::map<size_t, Merge>& merged,
+                    size_t& kept) const;
+
+  Params params_;
+};
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <Eigen/Dense>
+
+#include <bs_models/global_mapping/submap.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Cache of registration results between pairs of scans or submaps, so
+ * the refinement stages, and reruns of them, skip matches that were already
+ * done. Results are content addressed: the key is a context id (the stage and
+ * its config, see ContextId), the content ids of the reference and target, and
+ * the initial guess quantized to a translation and rotation resolution. A pair
+ * registered again from nearly the same guess therefore returns the stored
+ * result. Submap content ids include the poses of their scans in the submap
+ * frame, so submaps changed by a previous stage do not hit the results of
+ * their old content.
+ *
+ * All methods are thread safe. The cache can be saved to a file and loaded by
+ * a later run, entries saved with other resolutions are not loaded.
+ */
+class RegistrationCache {
+public:
+  struct Key {
+    uint64_t context{0};
+    uint64_t reference{0};
+    uint64_t target{0};
+
+    /** quantized translation then rotation vector */
+    std::array<int64_t, 6> initial_guess{};
+
+    bool operator<(const Key& other) const;
+  };
+
+  struct Result {
+    bool successful{false};
+    Eigen::Matrix4d T_REFERENCE_TARGET{Eigen::Matrix4d::Identity()};
+    std::optional<Eigen::Matrix<double, 6, 6>> covariance;
+  };
+
+  /**
+   * @brief constructor
+   * @param translation_resolution_m resolution of the initial guess translation
+   * @param rotation_resolution_deg resolution of the initial guess rotation
+   */
+  RegistrationCache(double translation_resolution_m,
+                    double rotation_resolution_deg);
+
+  /**
+   * @brief id of a registration context: a stage name and the contents of its
+   * config file, so editing the config invalidates the stage results
+   * @param stage name of the stage, and anything else its results depend on
+   * @param config_path config file of the stage, can be empty
+   */
+  static uint64_t ContextId(const std::string& stage,
+                            const std::string& config_path);
+
+  /**
+   * @brief content id of a scan, whose cloud never changes once stored
+   */
+  static uint64_t ScanId(const ros::Time& stamp);
+
+  /**
+   * @brief content id of a submap from the stamps and (quantized) submap frame
+   * poses of its lidar keyframes. The clouds are not read, so this works for
+   * submaps loaded without them
+   */
+  uint64_t SubmapId(const Submap& submap) const;
+
+  /**
+   * @brief key of a registration
+   * @param T_REFERENCE_TARGET_init initial guess of the registration
+   */
+  Key MakeKey(uint64_t context, uint64_t reference, uint64_t target,
+              const Eigen::Matrix4d& T_REFERENCE_TARGET_init) const;
+
+  /**
+   * @brief find a result, counting a hit or a miss
+   * @return false if there is no result for this key
+   */
+  bool Find(const Key& key, Result& result);
+
+  /**
+   * @brief add or replace a result
+   */
+  void Insert(const Key& key, const Result& result);
+
+  /**
+   * @brief load results saved with Save, adding them to the cache
+   * @return false if the file cannot be read, is invalid, or was saved with
+   * other resolutions
+   */
+  bool Load(const std::string& path);
+
+  /**
+   * @brief save all results to a binary file
+   * @return false if the file cannot be written
+   */
+  bool Save(const std::string& path) const;
+
+  size_t Size() const;
+
+  size_t Hits() const;
+
+  size_t Misses() const;
+
+  /**
+   * @brief hits over lookups, 0 if there were no lookups
+   */
+  double HitRate() const;
+
+private:
+  double translation_resolution_m_;
+  double rotation_resolution_rad_;
+
+  mutable std::mutex mutex_;
+  std::map<Key, Result> results_;
+  size_t hits_{0};
+  size_t misses_{0};
+};
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <beam_matching/loam/LoamPointCloud.h>
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/global_mapping/submap.h>
+#include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_models/reloc/reloc_refinement_base.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Answers relocalization requests (e.g., from a tracker that lost the
+ * map) against the completed submaps of a global map that is being built, on
+ * its own worker threads so that requests never wait for map building and map
+ * building never waits for requests.
+ *
+ * The workers only read an immutable snapshot: copies of the completed
+ * submaps, with their candidate search descriptors computed before they are
+ * added, and the latest pose of each submap. The owner of the submaps hands
+ * over a copy of each submap once it is completed (AddSubmap) and the submap
+ * poses after each optimization (UpdateSubmapPoses), both of which only swap
+ * the snapshot pointer. Submap copies share their lidar clouds with the
+ * original submaps, see ScanPose. Each worker owns its candidate search and
+ * refinement objects.
+ *
+ * Requests are answered in order of arrival. When more than
+ * max_queued_requests are waiting the oldest ones are dropped, and requests
+ * that are not answered within deadline_s of their arrival fail, so that
+ * clients never get stale answers. Every request gets exactly one response,
+ * which is returned through the response callback on a worker thread. This
+ * class is thread safe.
+ */
+class RelocServer {
+public:
+  struct Params {
+    bool enabled{false};
+
+    /** number of worker threads, i.e., max number of requests processed
+     * concurrently */
+    int num_workers{2};
+
+    /** max number of requests waiting for a worker */
+    int max_queued_requests{4};
+
+    /** requests fail if they are not answered within this time of their
+     * arrival */
+    double deadline_s{1.0};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  struct Request {
+    ros::Time stamp;
+
+    /** initial estimate of the pose of the scan, in the local mapper's world
+     * frame */
+    Eigen::Matrix4d T_WORLD_BASELINK{Eigen::Matrix4d::Identity()};
+
+    /** clouds in the lidar frame */
+    PointCloud cloud;
+    beam_matching::LoamPointCloud loam_cloud;
+  };
+
+  struct Response {
+    /** stamp of the request */
+    ros::Time stamp;
+
+    bool successful{false};
+
+    /** id of the submap the scan was relocalized in, -1 if not successful */
+    int submap_id{-1};
+
+    /** pose of the scan in the global map world frame */
+    Eigen::Matrix4d T_WORLD_BASELINK{Eigen::Matrix4d::Identity()};
+  };
+
+  using ResponseCallback = std::function<void(const Response&)>;
+
+  /**
+   * @brief constructor, this starts the workers
+   * @param params see above
+   * @param candidate_search_config config of the candidate search of each
+   * worker, see reloc::RelocCandidateSearchBase::Create
+   * @param refinement_config config of the refinement of each worker, see
+   * reloc::RelocRefinementBase::Create
+   * @param camera_model camera model of the query submaps
+   * @param extrinsics extrinsics of the query submaps
+   */
+  RelocServer(
+      const Params& params, const std::string& candidate_search_config,
+      const std::string& refinement_config,
+      const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
+      const std::shared_ptr<bs_common::ExtrinsicsLookupBase>& extrinsics);
+
+  /**
+   * @brief destructor, this stops the workers. Pending requests are dropped
+   * without a response
+   */
+  ~RelocServer();
+
+  /**
+   * @brief set the callback that receives the responses. Must be set before
+   * submitting requests
+   */
+  void SetResponseCallback(const ResponseCallback& callback);
+
+  /**
+   * @brief add a completed submap that requests can be relocalized in. The
+   * server keeps the copy, which must not be modified anymore by the caller,
+   * and it only becomes visible to requests once its descriptors are computed
+   * by a worker
+   * @param submap_id id of the submap in the global map
+   * @param submap copy of the completed submap
+   */
+  void AddSubmap(int submap_id, const SubmapPtr& submap);
+
+  /**
+   * @brief update the poses of the submaps of the snapshot
+   * @param Ts_WORLD_SUBMAP pose of each submap by id, submaps without a pose
+   * keep their previous one
+   */
+  void UpdateSubmapPoses(
+      const std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts_WORLD_SUBMAP);
+
+  /**
+   * @brief queue a request, this never blocks on the workers
+   * @return false if the server is stopped
+   */
+  bool Submit(Request&& request);
+
+  /**
+   * @brief number of submaps visible to requests
+   */
+  size_t NumSubmaps() const;
+
+  /**
+   * @brief stop the workers after their current request. Pending requests are
+   * dropped without a response
+   */
+  void Stop();
+
+private:
+  /** immutable, published as a whole */
+  struct Snapshot {
+    std::vector<SubmapPtr> submaps;
+    std::vector<int> submap_ids;
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_WORLD_SUBMAP;
+  };
+
+  struct Worker {
+    std::shared_ptr<reloc::RelocCandidateSearchBase> candidate_search;
+    std::shared_ptr<reloc::RelocRefinementBase> refinement;
+    std::thread thread;
+  };
+
+  struct QueuedRequest {
+    Request request;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  struct QueuedSubmap {
+    int submap_id;
+    SubmapPtr submap;
+  };
+
+  void WorkerLoop(Worker& worker);
+
+  /**
+   * @brief compute the descriptors of a new submap with the candidate search
+   * of a worker, then add it to the snapshot
+   */
+  void PrepareSubmap(Worker& worker, QueuedSubmap&& queued_submap);
+
+  Response Relocalize(Worker& worker, const QueuedRequest& queued_request);
+
+  void SendResponse(const Response& response);
+
+  Params params_;
+  std::shared_ptr<beam_calibration::CameraModel> camera_model_;
+  std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  mutable std::mutex snapshot_mutex_;
+  std::shared_ptr<const Snapshot> snapshot_{std::make_shared<Snapshot>()};
+
+  /** latest pose of each submap by id, also used for submaps which are added
+   * after the last pose update */
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_WORLD_SUBMAP_;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<QueuedRequest> requests_;
+  std::deque<QueuedSubmap> submaps_to_prepare_;
+  bool stop_{false};
+
+  std::mutex callback_mutex_;
+  ResponseCallback response_callback_;
+};
+
+} // namespace bs_models::global_mapping
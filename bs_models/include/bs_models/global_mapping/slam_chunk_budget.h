@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <ros/time.h>
+
+#include <bs_common/bs_msgs.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Fits the slam chunks streamed to a GlobalMapper on another machine
+ * into a bandwidth budget, e.g. over a radio link. The budget is a token
+ * bucket of budget_kbps, which holds at most burst_s seconds of budget.
+ *
+ * Each chunk is reduced to the first level whose serialized size fits in the
+ * budget available, so the data is dropped in order of priority: the images
+ * first, then the dense lidar points, then the features, and the poses are
+ * always sent since the global map needs every keyframe pose. A chunk sent
+ * over budget is paid back by the following ones.
+ *  - FULL: all data, the image compressed at the adaptive JPEG quality
+ *  - REDUCED: no dense lidar points, the image compressed at
+ * min_jpeg_quality
+ *  - FEATURES: lidar features and visual landmarks only, no image
+ *  - POSES: pose and trajectory only
+ *
+ * The JPEG quality of full chunks drops by quality_step every time a full
+ * chunk does not fit, and rises again while they fit with half of the burst
+ * to spare, between min_jpeg_quality and jpeg_quality. Images are always
+ * compressed, even with no budget. This class is not thread safe.
+ */
+class SlamChunkBudget {
+public:
+  enum class Level { FULL = 0, REDUCED, FEATURES, POSES };
+
+  static constexpr size_t kNumLevels = 4;
+
+  struct Params {
+    /** budget in kilobits per second, disabled if not positive */
+    double budget_kbps{0};
+
+    /** max budget saved while chunks are smaller than the budget */
+    double burst_s{2};
+
+    int jpeg_quality{90};
+    int min_jpeg_quality{40};
+    int quality_step{10};
+  };
+
+  struct Stats {
+    std::array<uint64_t, kNumLevels> chunks{};
+    uint64_t bytes{0};
+  };
+
+  SlamChunkBudget() = default;
+
+  explicit SlamChunkBudget(const Params& params);
+
+  /**
+   * @brief reduce a chunk to the budget available, and take its size from
+   * the budget
+   * @param chunk chunk to send, modified in place
+   * @param now time the chunk is sent
+   * @return level the chunk was reduced to
+   */
+  Level Fit(bs_common::SlamChunkMsg& chunk, const ros::Time& now);
+
+  /**
+   * @brief forget the budget used, e.g. after a reset
+   */
+  void Reset();
+
+  int JpegQuality() const { return quality_; }
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  /**
+   * @brief refill the budget with the time elapsed since the last chunk
+   */
+  void Refill(const ros::Time& now);
+
+  /**
+   * @brief compress the raw image of a chunk, if it has one
+   */
+  static void CompressImage(bs_common::CameraMeasurementMsg& measurement,
+                            const sensor_msgs::Image& image, int quality);
+
+  static void ClearLidarPoints(bs_common::LidarMeasurementMsg& measurement);
+
+  static void ClearLidarFeatures(bs_common::LidarMeasurementMsg& measurement);
+
+  /** send the chunk at this level, and take its size from the budget */
+  Level Take(Level level, size_t size);
+
+  bool Enabled() const { return params_.budget_kbps > 0; }
+
+  Params params_;
+  double bytes_per_s_{0};
+  double burst_bytes_{0};
+  double available_bytes_{0};
+  ros::Time last_refill_;
+  int quality_{90};
+  Stats stats_;
+};
+
+} // namespace bs_models::global_mapping
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <mutex>
 
 // Keep this include before any opencv include
 #include <pcl/kdtree/kdtree_flann.h>
@@ -17,8 +19,13 @@
 #include <beam_matching/loam/LoamPointCloud.h>
 #include <beam_utils/pointclouds.h>
 #include <bs_common/bs_msgs.h>
+#include <bs_common/chunk_file.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/flat_time_map.h>
+#include <bs_models/global_mapping/submap_footprint.h>
 #include <bs_models/lidar/scan_pose.h>
+#include <bs_models/reloc/scan_context_accumulator.h>
+#include <bs_models/vision/keyframe_image_store.h>
 
 namespace bs_models::global_mapping {
 
@@ -57,6 +64,25 @@ public:
     Eigen::Matrix4d pose; // Either T_KEYFRAME_FRAME, or T_SUBMAP_FRAME
   };
 
+  /**
+   * @brief parameters of the cached lidar maps. The lidar keyframes are
+   * aggregated in the submap frame the first time a lidar map is requested, and
+   * only re-aggregated once a scan pose moves by more than the tolerances below
+   * (or scans are added or removed), so world frame queries only need to apply
+   * T_WORLD_SUBMAP
+   */
+  struct LidarMapCacheParams {
+    // voxel size used to downsample the aggregated regular lidar points (not
+    // the loam points). Set to 0 to keep all points
+    double voxel_size{0};
+
+    // max change in translation (m) of a scan pose before re-aggregating
+    double translation_tol{1e-3};
+
+    // max change in rotation (rad) of a scan pose before re-aggregating
+    double rotation_tol{1e-3};
+  };
+
   /*--------------------------------/
               CONSTRUCTORS
   /--------------------------------*/
@@ -143,12 +169,12 @@ public:
   /**
    * @brief get access to const& of lidar keyframes
    */
-  const std::map<uint64_t, ScanPose>& LidarKeyframes() const;
+  const bs_common::FlatTimeMap<uint64_t, ScanPose>& LidarKeyframes() const;
 
   /**
    * @brief get access to const& of lidar keyframes
    */
-  std::map<uint64_t, ScanPose>& LidarKeyframesMutable();
+  bs_common::FlatTimeMap<uint64_t, ScanPose>& LidarKeyframesMutable();
 
   /*--------------------------------/
               ITERATORS
@@ -156,32 +182,36 @@ public:
   /**
    * @brief get an iterator to the beginning of the lidar keyframes map
    */
-  std::map<uint64_t, ScanPose>::iterator LidarKeyframesBegin();
+  bs_common::FlatTimeMap<uint64_t, ScanPose>::iterator LidarKeyframesBegin();
 
   /**
    * @brief get an iterator to the end of the lidar keyframes map
    */
-  std::map<uint64_t, ScanPose>::iterator LidarKeyframesEnd();
+  bs_common::FlatTimeMap<uint64_t, ScanPose>::iterator LidarKeyframesEnd();
 
   /**
    * @brief get an iterator to the beginning of the camera keyframes map
    */
-  std::map<uint64_t, Eigen::Matrix4d>::iterator CameraKeyframesBegin();
+  bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d>::iterator
+      CameraKeyframesBegin();
 
   /**
    * @brief get an iterator to the end of the camera keyframes map
    */
-  std::map<uint64_t, Eigen::Matrix4d>::iterator CameraKeyframesEnd();
+  bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d>::iterator
+      CameraKeyframesEnd();
 
   /**
    * @brief get an iterator to the beginning of the subframes map
    */
-  std::map<uint64_t, std::vector<PoseStamped>>::iterator SubframesBegin();
+  bs_common::FlatTimeMap<uint64_t, std::vector<PoseStamped>>::iterator
+      SubframesBegin();
 
   /**
    * @brief get an iterator to the end of the subframes map
    */
-  std::map<uint64_t, std::vector<PoseStamped>>::iterator SubframesEnd();
+  bs_common::FlatTimeMap<uint64_t, std::vector<PoseStamped>>::iterator
+      SubframesEnd();
 
   /**
    * @brief get an iterator to the beginning of the landmarks measurement
@@ -195,14 +225,95 @@ public:
   beam_containers::landmark_container_iterator LandmarksEnd();
 
   /**
-   * @brief get a vector of the keyframe images
+   * @brief get a vector of the keyframe images, images are decoded on demand
+   * (see vision::KeyframeImageStore)
    */
   std::vector<cv::Mat> GetKeyframeVector();
 
   /**
-   * @brief get the map of timestamps and keyframes
+   * @brief get the map of timestamps and keyframes, images are decoded on
+   * demand (see vision::KeyframeImageStore)
+   */
+  std::map<uint64_t, cv::Mat> GetKeyframeMap();
+
+  /**
+   * @brief check if this submap has camera data. It is only allocated once a
+   * camera measurement is added or loaded, so lidar only submaps do not carry
+   * the camera containers and do not save them
+   */
+  bool HasCameraData() const { return camera_data_.data != nullptr; }
+
+  /**
+   * @brief set how keyframe images are stored. This must be called before any
+   * camera measurements are added since it clears the stored images
+   */
+  void SetKeyframeImageParams(
+      const vision::KeyframeImageStore::Params& params);
+
+  /**
+   * @brief set the parameters of the cached lidar maps, this clears the cache
+   */
+  void SetLidarMapCacheParams(const LidarMapCacheParams& params);
+
+  /**
+   * @brief store scan context descriptors of the lidar keyframes, which are
+   * computed by reloc::RelocCandidateSearchScanContext and saved with the
+   * submap so they are only computed once per submap
+   * @param num_scans_aggregated number of scans aggregated around each
+   * keyframe to compute its descriptor
+   * @param descriptors <time, descriptor> for each lidar keyframe
+   */
+  void SetScanContexts(int num_scans_aggregated,
+                       const std::map<uint64_t, Eigen::MatrixXd>& descriptors);
+
+  /**
+   * @brief get the stored scan context descriptors
+   * @param num_scans_aggregated number of scans aggregated around each
+   * keyframe that the descriptors are needed for
+   * @return descriptors, or nullptr if none were computed with this number of
+   * aggregated scans or if the lidar keyframes changed since
+   */
+  const std::map<uint64_t, Eigen::MatrixXd>*
+      ScanContexts(int num_scans_aggregated) const;
+
+  /**
+   * @brief accumulate scan context descriptors as lidar measurements are
+   * added (see reloc::ScanContextAccumulator), so they are ready when the
+   * submap is complete. This must be called before any lidar measurements are
+   * added, and the accumulated descriptors are released when scan contexts
+   * are stored with SetScanContexts
+   * @param num_scans_aggregated number of scans aggregated around each
+   * keyframe to compute its descriptor
    */
-  const std::map<uint64_t, cv::Mat>& GetKeyframeMap();
+  void AccumulateScanContexts(int num_scans_aggregated);
+
+  /**
+   * @brief get the accumulated scan context descriptors
+   * @param num_scans_aggregated number of scans aggregated around each
+   * keyframe that the descriptors are needed for
+   * @param descriptors [out] <time, descriptor> for each lidar keyframe
+   * @return false if none were accumulated with this number of aggregated
+   * scans or if they do not cover all lidar keyframes
+   */
+  bool AccumulatedScanContexts(
+      int num_scans_aggregated,
+      std::map<uint64_t, Eigen::MatrixXd>& descriptors) const;
+
+  /**
+   * @brief store the geometric footprint of the lidar map, which is computed
+   * by reloc::RelocCandidateSearchBase once the submap is complete and kept
+   * when the lidar clouds are released
+   * @param footprint footprint of GetLidarPointsInSubmapFrame()
+   */
+  void SetFootprint(const SubmapFootprint& footprint);
+
+  /**
+   * @brief get the stored footprint
+   * @param params params the footprint is needed for
+   * @return footprint, or nullptr if none was computed with these params or
+   * if the lidar keyframes changed since
+   */
+  const SubmapFootprint* Footprint(const SubmapFootprint::Params& params) const;
 
   /*--------------------------------/
               COMPARATORS
@@ -282,9 +393,12 @@ public:
       const std::vector<ros::Time>& stamps, const ros::Time& stamp);
 
   /**
-   * @brief update the submap pose with an updated graph message
+   * @brief update the submap pose with an updated graph message. If the graph
+   * message is a bs_common::GraphSnapshot, the pose variables are only copied
+   * if the delta says they changed.
    * @param graph_msg new graph message that should contain the submap pose
    * variables
+   * @return true if the pose variables were in the graph message
    */
   bool UpdatePose(fuse_core::Graph::ConstSharedPtr graph_msg);
 
@@ -357,7 +471,8 @@ public:
    * so this will break it up
    * @param use_initials set to true to use the initial world frame
    * from the local mapper, before global optimization
-   * @param return vector of clouds
+   * @param return vector of clouds. Points come from the cached submap frame
+   * map (see LidarMapCacheParams)
    */
   std::vector<PointCloud>
       GetLidarPointsInWorldFrame(int max_output_map_size,
@@ -365,7 +480,8 @@ public:
 
   /**
    * @brief output all lidar points to a single pointcloud map. Points will
-   * be converted to world frame before outputting.
+   * be converted to world frame before outputting. Points come from the cached
+   * submap frame map (see LidarMapCacheParams)
    * @param use_initials set to true to use the initial world frame
    * from the local mapper, before global optimization
    * @param return cloud
@@ -375,7 +491,8 @@ public:
 
   /**
    * @brief output all lidar LOAM points to a single pointcloud map. Points will
-   * be converted to world frame before outputting
+   * be converted to world frame before outputting. Points come from the cached
+   * submap frame map (see LidarMapCacheParams)
    * @param use_initials set to true to use the initial world frame
    * from the local mapper, before global optimization
    * @param return cloud
@@ -383,6 +500,22 @@ public:
   beam_matching::LoamPointCloud
       GetLidarLoamPointsInWorldFrame(bool use_initials = false) const;
 
+  /**
+   * @brief output all lidar points to a single pointcloud map in the submap
+   * frame, using the current scan poses. Points come from the cached submap
+   * frame map (see LidarMapCacheParams)
+   * @param return cloud
+   */
+  PointCloud GetLidarPointsInSubmapFrame() const;
+
+  /**
+   * @brief output all lidar LOAM points to a single pointcloud map in the
+   * submap frame, using the current scan poses. Points come from the cached
+   * submap frame map (see LidarMapCacheParams)
+   * @param return cloud
+   */
+  beam_matching::LoamPointCloud GetLidarLoamPointsInSubmapFrame() const;
+
   /**
    * @brief return a vector of stamped poses for all keyframes and their
    * attached sub-trajectories. Note that it is possible for a lidar keyframe
@@ -409,9 +542,9 @@ public:
    *
    * output_dir/
    *    submap.json (general data)
-   *    camera_model.json (intrinsics object)
-   *    landmarks.json
-   *    camera_keyframes.json
+   *    camera_model.json (intrinsics object, only if there is a camera model)
+   *    landmarks.json (only if there is camera data)
+   *    camera_keyframes.json (only if there is camera data)
    *    /lidar_keyframes/
    *        /keyframe0/
    *            ...
@@ -431,6 +564,8 @@ public:
    *        ...
    *        timestampN.png
    *
+   *    scan_contexts.json (only if scan contexts were stored)
+   *
    *    where lidar keyframe formats can be found in bs_common/ScanPose.h (see
    * SaveData function), camera_keyframes.json is a map from stamp (nsecs) to
    * pose vector (1 x 16)
@@ -456,16 +591,170 @@ public:
   bool LoadData(const std::string& input_dir,
                 bool override_camera_model_pointer);
 
+  /**
+   * @brief save submap data to the binary global map store (see
+   * global_mapping/map_store.h). This stores the same data as the directory
+   * format above, except for the camera model which is stored once by the
+   * GlobalMap. The general data, camera keyframes and subframes are stored in
+   * one chunk, and the landmarks, each lidar keyframe, each keyframe image and
+   * the scan contexts in their own chunks. The landmarks chunk is only stored
+   * if there are landmarks
+   * @param writer open map store
+   * @param submap_id index of the submap in the global map
+   * @return true if successful
+   */
+  bool SaveData(bs_common::ChunkFileWriter& writer, uint16_t submap_id);
+
+  /**
+   * @brief load submap data from the binary global map store. Only the chunks
+   * of this submap are read. The camera model pointer is not changed
+   * @param reader open map store
+   * @param submap_id index of the submap in the global map
+   * @param load_lidar_clouds if false, the lidar keyframes are loaded without
+   * their clouds, which can be loaded later with LoadLidarClouds
+   * @return true if successful
+   */
+  bool LoadData(const bs_common::ChunkFileReader& reader, uint16_t submap_id,
+                bool load_lidar_clouds = true);
+
+  /**
+   * @brief write only the lidar keyframe chunks of SaveData, which can be
+   * read back with LoadLidarClouds
+   * @param writer open map store
+   * @param submap_id index of the submap in the global map
+   * @return true if successful
+   */
+  bool SaveLidarClouds(bs_common::ChunkFileWriter& writer,
+                       uint16_t submap_id) const;
+
+  /**
+   * @brief load the clouds of the lidar keyframes from the map store this
+   * submap was loaded from, keeping the current scan poses. The lidar
+   * keyframes must be the same as when the store was saved
+   * @param reader open map store
+   * @param submap_id index of the submap in the global map
+   * @return true if successful
+   */
+  bool LoadLidarClouds(const bs_common::ChunkFileReader& reader,
+                       uint16_t submap_id);
+
+  /**
+   * @brief drop the clouds of all lidar keyframes and the cached lidar maps,
+   * keeping the scan poses. Copies of the lidar keyframes keep their clouds
+   */
+  void ReleaseLidarClouds();
+
+  /**
+   * @brief compress the clouds of all lidar keyframes, see
+   * ScanPose::CompressClouds. The cached lidar maps are kept
+   */
+  void CompressLidarKeyframes();
+
   const std::shared_ptr<bs_common::ExtrinsicsLookupBase>& Extrinsics() const;
 
   std::shared_ptr<beam_calibration::CameraModel> CameraModel();
 
 private:
   /**
-   * @brief Get 3D positions of each landmark given current tracks and
-   * camera poses. This fills in landmark_positions_
-   * @param override_points if set to false, it will skip triangulation if
-   * it has already been called
+   * @brief lidar keyframes aggregated in the submap frame, along with the scan
+   * poses (T_SUBMAP_LIDAR) they were aggregated with. Copies do not share the
+   * mutex, which guards the cache since it is filled from const getters
+   */
+  struct LidarMapCache {
+    LidarMapCache() = default;
+    LidarMapCache(const LidarMapCache& other);
+    LidarMapCache& operator=(const LidarMapCache& other);
+
+    mutable std::mutex mutex;
+    std::map<uint64_t, Eigen::Matrix4d> T_SUBMAP_LIDAR; // <time, pose>
+    bool has_points{false};
+    PointCloud points;
+    // number of aggregated points of each scan, empty if voxelized
+    std::vector<size_t> scan_sizes;
+    bool has_loam_points{false};
+    beam_matching::LoamPointCloud loam_points;
+  };
+
+  /**
+   * @brief pose of the submap. The global map updates it while its loop
+   * closure worker reads and copies the submap, so it is only accessed with
+   * the mutex locked once the submap is shared. Copies do not share the mutex
+   */
+  struct PoseState {
+    PoseState() = default;
+    PoseState(const PoseState& other);
+    PoseState& operator=(const PoseState& other);
+
+    mutable std::mutex mutex;
+    int graph_updates{0};
+    fuse_variables::Position3DStamped position;       // t_WORLD_SUBMAP
+    fuse_variables::Orientation3DStamped orientation; // R_WORLD_SUBMAP
+    Eigen::Matrix4d T_WORLD_SUBMAP; // recomputed when the fuse vars change
+  };
+
+  /**
+   * @brief camera keyframes, landmarks and keyframe images, see HasCameraData
+   */
+  struct CameraData {
+    // <time, pose>
+    bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d> keyframe_poses;
+    std::map<uint64_t, Eigen::Vector3d> landmark_positions; // <id, position>
+    // camera keyframe poses and number of landmark measurements used to
+    // triangulate landmark_positions
+    std::map<uint64_t, Eigen::Matrix4d> landmark_positions_keyframe_poses;
+    size_t landmark_positions_num_measurements{0};
+    vision::KeyframeImageStore keyframe_images; // <time, image>
+    beam_containers::LandmarkContainer landmarks;
+  };
+
+  /**
+   * @brief owns the camera data, copies of the submap get their own copy
+   */
+  struct CameraDataPtr {
+    CameraDataPtr() = default;
+    CameraDataPtr(const CameraDataPtr& other);
+    CameraDataPtr& operator=(const CameraDataPtr& other);
+    CameraDataPtr(CameraDataPtr&& other) = default;
+    CameraDataPtr& operator=(CameraDataPtr&& other) = default;
+
+    std::unique_ptr<CameraData> data;
+  };
+
+  /**
+   * @brief get the camera data, allocating it on first use
+   */
+  CameraData& CameraDataMutable();
+
+  /**
+   * @brief check that the scan poses used to fill a cache are still within
+   * tolerance of the current scan poses, clearing the cache otherwise
+   * @param cache cache to check, must be locked by the caller
+   * @param use_initials check against the initial scan poses
+   */
+  void ValidateLidarMapCache(LidarMapCache& cache, bool use_initials) const;
+
+  /**
+   * @brief aggregate all regular lidar points in the submap frame in the cache
+   * if they are not already
+   * @param cache cache to fill, must be locked by the caller
+   * @param use_initials use the initial scan poses
+   */
+  void FillLidarPointsCache(LidarMapCache& cache, bool use_initials) const;
+
+  /**
+   * @brief aggregate all lidar LOAM points in the submap frame in the cache if
+   * they are not already, using the current scan poses
+   * @param cache cache to fill, must be locked by the caller
+   */
+  void FillLidarLoamPointsCache(LidarMapCache& cache) const;
+
+  /**
+   * @brief Get 3D positions in the submap frame of each landmark given current
+   * tracks and camera poses. This fills in the landmark positions of the
+   * camera data. The landmarks are triangulated in parallel, and only again
+   * once the camera keyframe poses or the landmarks change
+   * @param override_points if set to true, it will triangulate even if the
+   * current positions are up to date
    */
   void TriangulateKeypoints(bool override_points = false);
 
@@ -482,28 +771,32 @@ private:
 
   // general submap data
   ros::Time stamp_;
-  int graph_updates_{0};
-  fuse_variables::Position3DStamped position_;       // t_WORLD_SUBMAP
-  fuse_variables::Orientation3DStamped orientation_; // R_WORLD_SUBMAP
+  PoseState pose_;
   std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_;
-  Eigen::Matrix4d T_WORLD_SUBMAP_; // this get recomputed when fuse vars change
   Eigen::Matrix4d T_WORLD_SUBMAP_initial_; // = T_WORLDLM_SUBMAP
   Eigen::Matrix4d T_SUBMAP_WORLD_initial_; // = T_SUBMAP_WORLDLM
 
   // lidar data
-  std::map<uint64_t, ScanPose> lidar_keyframe_poses_; // <time,ScanPose>
+  // <time,ScanPose>
+  bs_common::FlatTimeMap<uint64_t, ScanPose> lidar_keyframe_poses_;
+  LidarMapCacheParams lidar_map_cache_params_;
+  mutable LidarMapCache lidar_map_cache_;         // using T_REFFRAME_LIDAR
+  mutable LidarMapCache lidar_map_cache_initial_; // using T_REFFRAME_LIDAR_INIT
+  int scan_contexts_num_aggregated_{-1};
+  std::map<uint64_t, Eigen::MatrixXd> scan_contexts_; // <time, descriptor>
+  reloc::ScanContextAccumulator scan_context_accumulator_;
+  SubmapFootprint footprint_;
+  std::vector<uint64_t> footprint_keyframe_stamps_;
 
   // camera data
   std::shared_ptr<beam_calibration::CameraModel> camera_model_;
-  std::map<uint64_t, Eigen::Matrix4d> camera_keyframe_poses_; // <time, pose>
-  std::map<uint64_t, Eigen::Vector3d> landmark_positions_;    // <id, position>
-  std::map<uint64_t, cv::Mat> keyframe_images_;               // <time, image>
-  beam_containers::LandmarkContainer landmarks_;
+  vision::KeyframeImageStore::Params keyframe_image_params_;
+  CameraDataPtr camera_data_;
   const std::string descriptor_type_{
       "ORB"}; // see beam_cv/descriptors/Descriptor.h
 
   // subframe trajectory measurements, where poses are T_KEYFRAME_FRAME
-  std::map<uint64_t, std::vector<PoseStamped>> subframe_poses_;
+  bs_common::FlatTimeMap<uint64_t, std::vector<PoseStamped>> subframe_poses_;
 
   // NOTE: all frames are baselink frames
 };
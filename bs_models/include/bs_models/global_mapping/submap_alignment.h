@@ -1,5 +1,8 @@
 #pragma once
 
+#include <beam_matching/Matcher.h>
+
+#include <bs_models/global_mapping/registration_cache.h>
 #include <bs_models/global_mapping/utils.h>
 
 namespace bs_models::global_mapping {
@@ -10,6 +13,17 @@ public:
     /** Full path to config file for matcher. If blank, it will use default
      * parameters.*/
     std::string matcher_config;
+
+    /** Number of submap pairs aligned in parallel. Each worker creates its own
+     * matcher.*/
+    int num_threads{1};
+
+    /** Voxel sizes (m) of the coarse-to-fine pyramid used before the full
+     * resolution alignment, from coarsest to finest. Each level is initialized
+     * with the result of the previous one. Leave empty to only align at full
+     * resolution. This is not used by the LOAM matcher, which already matches
+     * sparse features.*/
+    std::vector<double> pyramid_voxel_sizes;
   };
 
   SubmapAlignment() = delete;
@@ -18,25 +32,78 @@ public:
 
   ~SubmapAlignment() = default;
 
+  /**
+   * @brief align each submap to the previous one. All consecutive pairs are
+   * aligned in parallel, then the submap poses are chained from the first
+   * submap
+   * @param submaps submaps to align, in order
+   * @return true if successful
+   */
   bool Run(std::vector<SubmapPtr> submaps);
 
   RegistrationResults GetResults() const { return results_; }
 
+  /**
+   * @brief set a cache of alignment results, pairs found in it are not aligned
+   * again and the new alignments are added to it
+   */
+  void SetRegistrationCache(const std::shared_ptr<RegistrationCache>& cache) {
+    cache_ = cache;
+  }
+
 private:
   /**
-   * @brief Aligns the tgt submap to the reference submap. This is designed to
-   * be called one by one starting with the second submap. Since drift builds up
-   * over time, we want to always use the initial relative poses between the two
-   * submaps to initialize the registration.
-   * @param submap_ref const reference to submap to be aligned to
-   * @param submap_tgt reference to submap to be aligned
+   * @brief create the matcher from the matcher config, only one of the two
+   * matchers is set
+   */
+  void CreateMatchers(
+      std::unique_ptr<beam_matching::Matcher<PointCloudPtr>>& matcher,
+      std::unique_ptr<beam_matching::Matcher<beam_matching::LoamPointCloudPtr>>&
+          matcher_loam) const;
+
+  /**
+   * @brief Aligns the tgt submap to the reference submap. Since drift builds up
+   * over time, we always use the initial relative poses between the two
+   * submaps to initialize the registration, so pairs can be aligned
+   * independently of each other.
+   * @param submap_ref submap to be aligned to
+   * @param submap_tgt submap to be aligned
+   * @param matcher matcher to use, if matcher_loam is null
+   * @param matcher_loam loam matcher to use, if not null
+   * @param T_SubmapRef_SubmapTgt aligned relative pose. This is the initial
+   * relative pose if the alignment fails
    * @return true if successful
    */
-  bool AlignSubmaps(const SubmapPtr& submap_ref, SubmapPtr& submap_tgt);
+  bool AlignSubmaps(
+      const Submap& submap_ref, const Submap& submap_tgt,
+      beam_matching::Matcher<PointCloudPtr>* matcher,
+      beam_matching::Matcher<beam_matching::LoamPointCloudPtr>* matcher_loam,
+      Eigen::Matrix4d& T_SubmapRef_SubmapTgt) const;
+
+  /**
+   * @brief save the reference and target submaps in the world frame for
+   * visualization
+   * @param tgt_filename name of the target submap file
+   * @param save_ref set to true to also save the reference submap
+   */
+  void SaveSubmaps(const Submap& submap_ref, const Submap& submap_tgt,
+                   const std::string& tgt_filename, uint8_t r, uint8_t g,
+                   uint8_t b, bool save_ref) const;
+
+  /**
+   * @brief same as AlignSubmaps, but returns the cached result if there is one
+   * @param cache_context context id of the cached results of this alignment
+   */
+  bool AlignSubmapsCached(
+      const Submap& submap_ref, const Submap& submap_tgt,
+      beam_matching::Matcher<PointCloudPtr>* matcher,
+      beam_matching::Matcher<beam_matching::LoamPointCloudPtr>* matcher_loam,
+      uint64_t cache_context, Eigen::Matrix4d& T_SubmapRef_SubmapTgt) const;
 
   Params params_;
   RegistrationResults results_;
   std::string output_path_;
+  std::shared_ptr<RegistrationCache> cache_;
 };
 
-} // namespace bs_models::global_mapping
\ No newline at end of file
+} // namespace bs_models::global_mapping
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <bs_models/global_mapping/submap.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Out of core storage of the lidar clouds of completed submaps while a
+ * global map is being built. Completed submaps which are far from the robot,
+ * or which exceed a number of resident submaps, are evicted: the clouds of
+ * their lidar keyframes are written to a spill file and released, while their
+ * poses, scan context descriptors and camera data stay in memory. The clouds
+ * of a submap are reloaded when a Lease on it is acquired. Keyframe images
+ * have their own spill policy, see vision::KeyframeImageStore.
+ *
+ * Completed submaps are not modified anymore, so each submap is only written
+ * once and later evictions just release its clouds. Submaps with compressed
+ * clouds (see ScanPose::CompressClouds) are compressed again when reloaded.
+ * Leased submaps are never evicted, and once a lease is released its submaps
+ * are evicted again if the policy says so. Evicting replaces the clouds of the
+ * submaps, so everything that reads the clouds of completed submaps must hold
+ * a lease on them. This class is thread safe.
+ */
+class SubmapEvictor {
+public:
+  struct Params {
+    bool enabled{false};
+
+    /** completed submaps further than this from the robot are evicted. If 0,
+     * submaps are only evicted by max_resident_submaps */
+    double distance_m{50};
+
+    /** max number of completed submaps with their clouds in memory, the least
+     * recently used ones are evicted first. If 0, there is no limit */
+    int max_resident_submaps{0};
+
+    /** directory of the spill files */
+    std::string directory{"/tmp"};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  /**
+   * @brief keeps the clouds of a set of submaps loaded until it is destroyed.
+   * Leases must not outlive their evictor
+   */
+  class Lease {
+  public:
+    Lease() = default;
+
+    ~Lease();
+
+    Lease(Lease&& other) noexcept;
+
+    Lease& operator=(Lease&& other) noexcept;
+
+    Lease(const Lease& other) = delete;
+
+    Lease& operator=(const Lease& other) = delete;
+
+    /**
+     * @brief false if the clouds of a submap could not be reloaded
+     */
+    bool Valid() const { return valid_; }
+
+    /**
+     * @brief release the submaps before the lease is destroyed
+     */
+    void Release();
+
+  private:
+    friend class SubmapEvictor;
+
+    SubmapEvictor* evictor_{nullptr};
+    std::vector<size_t> submap_ids_;
+    bool valid_{true};
+  };
+
+  SubmapEvictor() = delete;
+
+  /**
+   * @brief constructor
+   * @param params see struct above. The directory must exist
+   */
+  explicit SubmapEvictor(const Params& params);
+
+  /**
+   * @brief removes the spill files
+   */
+  ~SubmapEvictor();
+
+  SubmapEvictor(const SubmapEvictor& other) = delete;
+
+  SubmapEvictor& operator=(const SubmapEvictor& other) = delete;
+
+  /**
+   * @brief evict the completed submaps that are too far from the robot, then
+   * the least recently used ones until at most max_resident_submaps completed
+   * submaps are resident
+   * @param submaps all submaps of the global map, new submaps may only be
+   * added at the end
+   * @param num_completed number of submaps at the start of submaps which are
+   * complete, the others are never evicted
+   * @param t_WORLD_BASELINK position of the robot
+   * @return number of submaps evicted
+   */
+  size_t Update(const std::vector<SubmapPtr>& submaps, size_t num_completed,
+                const Eigen::Vector3d& t_WORLD_BASELINK);
+
+  /**
+   * @brief reload the clouds of submaps if they are evicted and keep them
+   * loaded until the returned lease is destroyed
+   * @param submaps all submaps of the global map, same as in Update
+   * @param submap_ids indices of the submaps, duplicates are ignored
+   */
+  Lease Acquire(const std::vector<SubmapPtr>& submaps,
+                std::vector<size_t> submap_ids);
+
+  /**
+   * @brief evict the least recently used resident submap that is not leased,
+   * regardless of the policy. This is used to enforce a memory budget
+   * @return false if no submap could be evicted
+   */
+  bool EvictLeastRecentlyUsed();
+
+  bool IsEvicted(size_t submap_id) const;
+
+  size_t NumEvicted() const;
+
+  const Params& GetParams() const { return params_; }
+
+private:
+  void Unpin(const std::vector<size_t>& submap_ids);
+
+  /**
+   * @brief add the submaps that were added since the last call. Must be called
+   * with the lock held
+   */
+  void AddSubmaps(const std::vector<SubmapPtr>& submaps);
+
+  /**
+   * @brief evict the resident submaps that are not leased and too far from the
+   * last robot position, then the least recently used ones. Must be called
+   * with the lock held
+   * @return number of submaps evicted
+   */
+  size_t EvictToPolicy();
+
+  /**
+   * @brief write the clouds of a submap to its spill file if not done yet and
+   * release them. Must be called with the lock held
+   */
+  bool Evict(size_t submap_id);
+
+  std::string SpillPath(const SubmapPtr& submap) const;
+
+  Params params_;
+
+  mutable std::mutex mutex_;
+  std::vector<SubmapPtr> submaps_;
+  std::optional<Eigen::Vector3d> t_WORLD_BASELINK_;
+  std::vector<std::string> spill_paths_; // empty if not written yet
+  std::vector<bool> evicted_;
+  std::vector<bool> compressed_; // recompressed when reloaded
+  std::vector<int> num_leases_;
+  std::vector<bool> resident_; // completed submaps with their clouds
+  std::list<size_t> lru_;      // resident submaps, most recently used first
+  std::vector<std::list<size_t>::iterator> lru_positions_;
+  size_t num_evicted_{0};
+};
+
+} // namespace bs_models::global_mapping
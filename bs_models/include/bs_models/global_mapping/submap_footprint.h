@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Cheap geometric summary of the lidar map of a completed submap, used
+ * to reject reloc and loop closure candidates which cannot overlap before any
+ * registration runs. It holds:
+ *
+ *   - an oriented bounding box, from the principal axes of the occupied
+ *     voxels,
+ *   - an occupancy bitmask at a coarse voxel resolution, over the bounding
+ *     voxel grid of the submap and dilated by one voxel so that small pose
+ *     errors still overlap, and the centers of the occupied (undilated)
+ *     voxels,
+ *   - a normalized histogram of the occupied voxel heights above the floor
+ *     of the submap, which separates e.g. different floors of a building.
+ *
+ * The overlap of two footprints is estimated by moving the voxel centers of
+ * one into the other with the estimated relative pose and testing their bits,
+ * which takes microseconds for submaps of a few thousand coarse voxels. All
+ * geometry is in the submap frame.
+ */
+class SubmapFootprint {
+public:
+  struct Params {
+    /** side length of the occupancy voxels */
+    double voxel_size_m{2.0};
+
+    /** height histogram bins, heights above the last bin fall in it */
+    double height_bin_size_m{0.5};
+    int num_height_bins{32};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    void Print(std::ostream& stream = std::cout) const;
+
+    bool operator==(const Params& other) const;
+  };
+
+  /**
+   * @brief empty footprint
+   */
+  SubmapFootprint() = default;
+
+  /**
+   * @brief compute the footprint of the lidar points of a submap
+   * @param points lidar points in the submap frame
+   * @param params
+   */
+  SubmapFootprint(const PointCloud& points, const Params& params);
+
+  bool Empty() const { return voxel_centers_.cols() == 0; }
+
+  const Params& GetParams() const { return params_; }
+
+  size_t NumOccupiedVoxels() const { return voxel_centers_.cols(); }
+
+  /**
+   * @brief center of the bounding box in the submap frame
+   */
+  const Eigen::Vector3d& BoxCenter() const { return box_center_; }
+
+  /**
+   * @brief axes of the bounding box in the submap frame, as columns
+   */
+  const Eigen::Matrix3d& BoxAxes() const { return box_axes_; }
+
+  const Eigen::Vector3d& BoxHalfExtents() const { return box_half_extents_; }
+
+  const std::vector<float>& HeightHistogram() const {
+    return height_histogram_;
+  }
+
+  /**
+   * @brief whether the bounding boxes of two footprints intersect, using the
+   * separating axis test
+   * @param other footprint of the other submap
+   * @param T_THIS_OTHER estimated pose of the other submap in this one
+   * @param margin_m the boxes are grown by this on all sides
+   */
+  bool BoxesIntersect(const SubmapFootprint& other,
+                      const Eigen::Matrix4d& T_THIS_OTHER,
+                      double margin_m = 0) const;
+
+  /**
+   * @brief fraction of the occupied voxels of the other footprint which fall
+   * in (or next to) an occupied voxel of this one
+   * @param other footprint of the other submap
+   * @param T_THIS_OTHER estimated pose of the other submap in this one
+   * @return overlap in [0, 1], 0 if either footprint is empty
+   */
+  double OccupancyOverlap(const SubmapFootprint& other,
+                          const Eigen::Matrix4d& T_THIS_OTHER) const;
+
+  /**
+   * @brief histogram intersection of the height histograms
+   * @return similarity in [0, 1], 1 if both histograms are equal
+   */
+  double HeightSimilarity(const SubmapFootprint& other) const;
+
+private:
+  /**
+   * @brief bit index of a grid voxel, or -1 if it is outside of the grid
+   */
+  int64_t BitIndex(const Eigen::Vector3i& voxel) const;
+
+  Params params_;
+
+  Eigen::Vector3d box_center_{Eigen::Vector3d::Zero()};
+  Eigen::Matrix3d box_axes_{Eigen::Matrix3d::Identity()};
+  Eigen::Vector3d box_half_extents_{Eigen::Vector3d::Zero()};
+
+  // the grid covers the voxels grid_min_ to grid_min_ + grid_size_ - 1
+  Eigen::Vector3i grid_min_{Eigen::Vector3i::Zero()};
+  Eigen::Vector3i grid_size_{Eigen::Vector3i::Zero()};
+  std::vector<uint64_t> occupancy_; // dilated by one voxel
+
+  Eigen::Matrix3Xf voxel_centers_;
+  std::vector<float> height_histogram_;
+};
+
+} // namespace bs_models::global_mapping
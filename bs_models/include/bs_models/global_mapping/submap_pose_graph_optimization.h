@@ -1,6 +1,14 @@
 #pragma once
 
+#include <map>
+#include <set>
+
+#include <bs_models/global_mapping/pose_graph_sparsifier.h>
+#include <bs_models/global_mapping/registration_cache.h>
+#include <bs_models/global_mapping/submap_working_set.h>
 #include <bs_models/global_mapping/utils.h>
+#include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_models/reloc/reloc_refinement_base.h>
 
 namespace bs_models::global_mapping {
 
@@ -20,6 +28,64 @@ public:
 
     /** Weights to assign to local mapper measurements */
     Eigen::Matrix<double, 6, 6> local_mapper_covariance;
+
+    /** If false, only the local mapper measurements and the loop closures set
+     * with SetLoopClosures are optimized */
+    bool search_loop_closures{true};
+
+    /** If greater than 1, the candidates of all query submaps are found first
+     * and refined on this many background tasks of the shared task
+     * scheduler, followed by a single graph solve.
+     * Otherwise the graph is solved after each query so that the search of
+     * the next query uses the updated submap poses */
+    int num_threads{1};
+
+    /** Merge redundant submaps of revisited areas and sparsify the graph
+     * every sparsification.loop_closures_per_sparsification loop closures,
+     * see PoseGraphSparsifier. Merged submaps keep their pose relative to the
+     * submap they were merged into, and later loop closures to them are
+     * added to that submap. Only used if num_threads is 1, since the graph is
+     * only solved once otherwise */
+    PoseGraphSparsifier::Params sparsification;
+  };
+
+  /**
+   * @brief result of refining one loop closure candidate
+   */
+  struct CandidateResult {
+    size_t match_index;
+    size_t query_index;
+    bool successful{false};
+    double coarse_overlap{1};
+    double refinement_time_s{0};
+  };
+
+  /**
+   * @brief summary of the last call to Run. Times are wall times, so the
+   * refinement time of the candidates adds up to more than refinement_time_s
+   * when they are refined in parallel
+   */
+  struct Summary {
+    size_t num_queries{0};
+    size_t num_candidates{0};
+    size_t num_successful{0};
+    double search_time_s{0};
+    double refinement_time_s{0};
+    double optimization_time_s{0};
+    size_t num_merged_submaps{0};
+    size_t num_edges{0};
+    double sparsification_time_s{0};
+    std::vector<CandidateResult> candidates;
+  };
+
+  /**
+   * @brief relative pose between two submaps that is already known, e.g. from
+   * a loop closure verified somewhere else
+   */
+  struct LoopClosure {
+    size_t match_index;
+    size_t query_index;
+    Eigen::Matrix4d T_MATCH_QUERY;
   };
 
   SubmapPoseGraphOptimization() = delete;
@@ -31,9 +97,121 @@ public:
 
   bool Run(std::vector<SubmapPtr> submaps);
 
+  /**
+   * @brief set a working set over the submaps passed to Run, used to page in
+   * the lidar clouds of the query and candidate submaps when the submaps were
+   * loaded without them. If the candidate search uses the lidar clouds, all
+   * submaps it searches are loaded for each query
+   */
+  void SetWorkingSet(const std::shared_ptr<SubmapWorkingSet>& working_set) {
+    working_set_ = working_set;
+  }
+
+  /**
+   * @brief set a cache of loop closure refinement results, candidates found in
+   * it are not refined again (and their coarse overlap is reported as 1) and
+   * the new refinements are added to it
+   */
+  void SetRegistrationCache(const std::shared_ptr<RegistrationCache>& cache) {
+    cache_ = cache;
+  }
+
+  /**
+   * @brief set the indices of submaps that start a new mapping session, used
+   * when the submaps passed to Run are the union of several global maps. No
+   * local mapper measurement is added between a session start and the submap
+   * before it, so the sessions are only connected by loop closures
+   */
+  void SetSessionStarts(const std::vector<size_t>& session_starts) {
+    session_starts_ =
+        std::set<size_t>(session_starts.begin(), session_starts.end());
+  }
+
+  /**
+   * @brief set loop closures which are added to the graph, with the loop
+   * closure covariance, before searching for new loop closures
+   */
+  void SetLoopClosures(const std::vector<LoopClosure>& loop_closures) {
+    loop_closures_ = loop_closures;
+  }
+
+  const Summary& GetSummary() const { return summary_; }
+
 private:
+  /**
+   * @brief loop closure candidate found by the candidate search
+   */
+  struct Candidate {
+    size_t match_index;
+    size_t query_index;
+    Eigen::Matrix4d T_MATCH_QUERY_EST;
+  };
+
+  /**
+   * @brief find the loop closure candidates of one query submap among the
+   * submaps before the one preceding it
+   */
+  std::vector<Candidate>
+      FindCandidates(reloc::RelocCandidateSearchBase& candidate_search,
+                     const std::vector<SubmapPtr>& submaps, size_t query_index,
+                     const std::string& output_path);
+
+  /**
+   * @brief refine candidates on params_.num_threads threads, with a
+   * refinement per thread since they are not thread safe. The clouds of the
+   * submaps are cached by the submaps, so they are shared between threads
+   * @return results in the order of the candidates
+   */
+  std::vector<reloc::RelocRefinementResults>
+      RefineCandidates(const std::vector<SubmapPtr>& submaps,
+                       const std::vector<Candidate>& candidates,
+                       const std::string& output_path);
+
+  /**
+   * @brief build the graph of the submaps which are not merged, with a prior
+   * on the first submap and all edges
+   */
+  std::shared_ptr<fuse_graphs::HashGraph>
+      BuildGraph(const std::vector<SubmapPtr>& submaps);
+
+  /**
+   * @brief update the submap poses from the graph, and the merged submaps
+   * from the submaps they were merged into
+   */
+  void UpdateSubmapPoses(const std::vector<SubmapPtr>& submaps,
+                         const std::shared_ptr<fuse_graphs::HashGraph>& graph);
+
+  /**
+   * @brief merge redundant submaps and rebuild the graph from the sparsified
+   * edges, at the current submap poses
+   */
+  void Sparsify(const std::vector<SubmapPtr>& submaps,
+                std::shared_ptr<fuse_graphs::HashGraph>& graph);
+
+  /**
+   * @brief add the successful refinements to the graph, optimize and update
+   * the submap poses. Loop closures to merged submaps are added to the
+   * submaps they were merged into
+   */
+  void AddLoopClosures(
+      const std::vector<SubmapPtr>& submaps,
+      const std::vector<Candidate>& candidates,
+      const std::vector<reloc::RelocRefinementResults>& results,
+      std::shared_ptr<fuse_graphs::HashGraph>& graph);
+
   Params params_;
   std::string output_path_;
+  std::shared_ptr<SubmapWorkingSet> working_set_;
+  std::shared_ptr<RegistrationCache> cache_;
+  std::set<size_t> session_starts_;
+  std::vector<LoopClosure> loop_closures_;
+  Summary summary_;
+  std::vector<std::shared_ptr<reloc::RelocRefinementBase>> refinements_;
+
+  // pose graph of the last call to Run, by submap index
+  std::vector<PoseGraphSparsifier::Edge> edges_;
+  std::map<size_t, PoseGraphSparsifier::Merge> merged_;
+  int loop_closures_since_sparsification_{0};
 
   // params only tunable here
   int pgo_skip_first_n_submaps_{2};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Spatial index over the positions of the submaps of a global map, so
+ * reloc and loop closure candidate searches do not need to compare against
+ * every submap. Submaps are identified by their index in the global map and
+ * stored in a uniform grid, which can be updated incrementally: adding a
+ * submap or moving one within its cell does not touch any other entry.
+ *
+ * Queries take a max_id so that the last submaps can be ignored (see
+ * ignore_last_n_submaps in reloc::RelocCandidateSearchBase). This class is not
+ * thread safe, GlobalMap only accesses it under its submap pose lock.
+ */
+class SubmapPositionIndex {
+public:
+  /**
+   * @brief constructor
+   * @param cell_size_m side length of the grid cells, which should be in the
+   * order of the query radius
+   */
+  explicit SubmapPositionIndex(double cell_size_m = 10);
+
+  /**
+   * @brief add a submap or update its position
+   * @param id index of the submap, must be at most Size(). If equal to Size()
+   * the submap is added
+   * @param position position of the submap in the world frame
+   */
+  void Update(size_t id, const Eigen::Vector3d& position);
+
+  /**
+   * @brief remove all submaps with an id greater or equal to size
+   */
+  void Resize(size_t size);
+
+  void Clear();
+
+  size_t Size() const { return positions_.size(); }
+
+  /**
+   * @brief find all submaps within a radius of a position
+   * @param position query position in the world frame
+   * @param radius_m search radius
+   * @param max_id only submaps with an id lower than this are returned
+   * @return submap ids, sorted by increasing distance
+   */
+  std::vector<size_t> Radius(const Eigen::Vector3d& position, double radius_m,
+                             size_t max_id) const;
+
+  /**
+   * @brief find the k closest submaps to a position
+   * @param position query position in the world frame
+   * @param k maximum number of submaps to return
+   * @param max_id only submaps with an id lower than this are returned
+   * @return submap ids, sorted by increasing distance
+   */
+  std::vector<size_t> Nearest(const Eigen::Vector3d& position, size_t k,
+                              size_t max_id) const;
+
+private:
+  using Cell = std::array<int64_t, 3>;
+
+  struct CellHash {
+    size_t operator()(const Cell& cell) const;
+  };
+
+  Cell ToCell(const Eigen::Vector3d& position) const;
+
+  void RemoveFromCell(size_t id);
+
+  /**
+   * @brief distances to all submaps with an id lower than max_id, used when a
+   * query would visit more cells than are occupied
+   */
+  std::vector<std::pair<double, size_t>>
+      AllDistances(const Eigen::Vector3d& position, size_t max_id) const;
+
+  double cell_size_m_;
+  std::vector<Eigen::Vector3d> positions_;
+  std::vector<Cell> cells_;
+  std::unordered_map<Cell, std::vector<size_t>, CellHash> grid_;
+
+  // bounds of all cells that were ever occupied, used to stop knn searches
+  Cell min_cell_{0, 0, 0};
+  Cell max_cell_{0, 0, 0};
+};
+
+} // namespace bs_models::global_mapping
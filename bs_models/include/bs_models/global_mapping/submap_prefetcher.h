@@ -0,0 +1,175 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+#include <ros/time.h>
+
+#include <bs_models/global_mapping/submap.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Loads the submaps that the robot is about to reach on a background
+ * I/O thread, so that loop closure and localization do not stall on paging in
+ * their clouds when a submap is first needed (see SubmapEvictor and
+ * SubmapWorkingSet). The path ahead of the robot is taken from a planned path
+ * if one is set, else extrapolated from the velocity of the robot. The owner
+ * finds the submaps near that path and requests them in the order they will
+ * be reached, and the I/O thread loads them in that order until the memory
+ * budget of the prefetched submaps is used.
+ *
+ * Prefetched submaps are kept loaded by the handle returned by the load
+ * function, which is released once a submap is not requested anymore. The
+ * load function is only called from the I/O thread. Handles must not outlive
+ * what they lease, so the prefetcher must be destroyed first. This class is
+ * thread safe.
+ */
+class SubmapPrefetcher {
+public:
+  struct Params {
+    bool enabled{false};
+
+    /** time the path is extrapolated over, at the current velocity */
+    double horizon_s{10};
+
+    /** the path ahead is at least this long, e.g. when the robot stops */
+    double min_horizon_m{10};
+
+    /** submaps whose origin is within this of the path are prefetched */
+    double radius_m{30};
+
+    /** distance between the points that the path is sampled at */
+    double sample_spacing_m{5};
+
+    /** max estimated memory of the prefetched submaps */
+    double memory_budget_mb{512};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  /** keeps a prefetched submap loaded until it is destroyed */
+  using Handle = std::shared_ptr<void>;
+
+  /**
+   * @brief loads the clouds of a submap
+   * @param submaps submaps the ids of the request refer to
+   * @param submap_id submap to load
+   * @param memory_bytes [out] estimated memory of the loaded submap
+   * @return handle keeping the submap loaded, nullptr if it failed
+   */
+  using LoadFunction =
+      std::function<Handle(const std::vector<SubmapPtr>& submaps,
+                           size_t submap_id, size_t& memory_bytes)>;
+
+  SubmapPrefetcher() = delete;
+
+  /**
+   * @brief constructor, starts the I/O thread
+   */
+  SubmapPrefetcher(const Params& params, LoadFunction load);
+
+  /**
+   * @brief stops the I/O thread and releases all prefetched submaps
+   */
+  ~SubmapPrefetcher();
+
+  SubmapPrefetcher(const SubmapPrefetcher& other) = delete;
+
+  SubmapPrefetcher& operator=(const SubmapPrefetcher& other) = delete;
+
+  /**
+   * @brief update the velocity of the robot with its position and sample the
+   * path ahead of it
+   * @param t_WORLD_BASELINK position of the robot
+   * @param stamp time of the position
+   * @return points along the path ahead, starting at the robot
+   */
+  std::vector<Eigen::Vector3d>
+      PredictPath(const Eigen::Vector3d& t_WORLD_BASELINK,
+                  const ros::Time& stamp);
+
+  /**
+   * @brief set the path the robot is going to follow, used instead of the
+   * extrapolated one. Pass an empty path to go back to extrapolating
+   * @param path positions in the world frame, in the order they are reached
+   */
+  void SetPlannedPath(const std::vector<Eigen::Vector3d>& path);
+
+  /**
+   * @brief replace the submaps to prefetch. Submaps of the previous request
+   * which are not in this one are released
+   * @param submaps submaps the ids refer to, only copied if the ids changed
+   * @param submap_ids ids in the order they should be loaded
+   */
+  void Request(const std::vector<SubmapPtr>& submaps,
+               const std::vector<size_t>& submap_ids);
+
+  /**
+   * @brief block until the I/O thread has processed the last request
+   */
+  void Flush();
+
+  /**
+   * @brief get the ids of the prefetched submaps, sorted
+   */
+  std::vector<size_t> PrefetchedIds() const;
+
+  /**
+   * @brief get the estimated memory of the prefetched submaps
+   */
+  size_t MemoryUsage() const;
+
+  const Params& GetParams() const { return params_; }
+
+private:
+  struct Prefetched {
+    size_t submap_id;
+    size_t memory_bytes;
+    Handle handle;
+  };
+
+  /**
+   * @brief loop of the I/O thread
+   */
+  void Run();
+
+  Params params_;
+  LoadFunction load_;
+  size_t memory_budget_bytes_;
+
+  // robot motion and planned path
+  std::mutex motion_mutex_;
+  std::optional<Eigen::Vector3d> last_position_;
+  ros::Time last_stamp_;
+  std::optional<Eigen::Vector3d> velocity_;
+  std::vector<Eigen::Vector3d> planned_path_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<SubmapPtr> submaps_;
+  std::vector<size_t> requested_ids_;
+  uint64_t request_version_{0};
+  uint64_t processed_version_{0};
+  std::vector<Prefetched> prefetched_;
+  size_t memory_usage_{0};
+  bool stop_{false};
+  std::thread thread_;
+};
+
+} // namespace bs_models::global_mapping
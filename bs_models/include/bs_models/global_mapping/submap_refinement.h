@@ -14,6 +14,10 @@ public:
     /** Full path to config file for matcher. If blank, it will use default
      * parameters.*/
     std::string matcher_config;
+
+    /** Number of submaps refined in parallel. Each worker creates its own scan
+     * registration and registration map, so memory use grows with this.*/
+    int num_threads{1};
   };
 
   SubmapRefinement() = delete;
@@ -25,7 +29,14 @@ public:
   RegistrationResults GetResults() const { return results_; }
 
 private:
-  bool RefineSubmap(SubmapPtr& submap);
+  /**
+   * @brief refine the scan poses of one submap. This only reads the shared
+   * state of the class, so submaps can be refined in parallel
+   * @param submap submap to refine
+   * @param results results of each scan in the submap are added to this
+   * @return true if successful
+   */
+  bool RefineSubmap(SubmapPtr& submap, RegistrationResults& results) const;
 
   Params params_;
   RegistrationResults results_;
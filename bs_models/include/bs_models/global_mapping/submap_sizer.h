@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+
+#include <nlohmann/json.hpp>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Decides where GlobalMap starts a new submap, so that the work per
+ * submap (loop closure refinement, ros submap messages, descriptors) stays
+ * roughly constant instead of growing with the density of the area.
+ *
+ * Without budgets a new submap is started once the robot is submap_size away
+ * from the current submap. With budgets, the current submap is split early,
+ * once it is at least min_submap_size_m long, as soon as its lidar points,
+ * landmark measurements or keyframes exceed their budget. A submap which is
+ * underfilled at submap_size, i.e. which is below min_fill_fraction of all
+ * its budgets, keeps growing up to max_submap_size_m, so sparse areas do not
+ * produce many tiny submaps. Completed submaps are never merged, since their
+ * poses are already in the graph. This class is not thread safe.
+ */
+class SubmapSizer {
+public:
+  struct Params {
+    bool enabled{false};
+
+    /** budgets per submap, disabled if 0 */
+    size_t max_lidar_points{0};
+    size_t max_landmark_measurements{0};
+    size_t max_keyframes{0};
+
+    /** submaps are never split before this length */
+    double min_submap_size_m{2};
+
+    /** underfilled submaps grow up to this length */
+    double max_submap_size_m{30};
+
+    /** a submap is underfilled if it is below this fraction of all its
+     * budgets */
+    double min_fill_fraction{0.25};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  /**
+   * @brief content of the current submap
+   */
+  struct Fill {
+    size_t lidar_points{0};
+    size_t landmark_measurements{0};
+    size_t keyframes{0};
+  };
+
+  SubmapSizer() = default;
+
+  explicit SubmapSizer(const Params& params);
+
+  /**
+   * @brief check if a measurement starts a new submap
+   * @param distance_m distance from the current submap to the measurement
+   * @param submap_size_m fixed submap size, see GlobalMap::Params
+   */
+  bool StartNewSubmap(double distance_m, double submap_size_m) const;
+
+  /**
+   * @brief add the content of a measurement to the current submap
+   */
+  void Add(size_t lidar_points, size_t landmark_measurements,
+           size_t keyframes);
+
+  /**
+   * @brief start counting the content of a new submap
+   */
+  void Reset() { fill_ = Fill(); }
+
+  const Fill& GetFill() const { return fill_; }
+
+private:
+  /**
+   * @brief check if the current submap is over any of its budgets
+   */
+  bool OverBudget() const;
+
+  /**
+   * @brief check if the current submap is below min_fill_fraction of all its
+   * budgets
+   */
+  bool Underfilled() const;
+
+  Params params_;
+  Fill fill_;
+};
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bs_models/global_mapping/submap_tile_store.h>
+#include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_models/reloc/reloc_refinement_base.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Runs the inter-robot loop closures of a shared submap tile store
+ * (see SubmapTileStore) once for the whole fleet, so robots only close loops
+ * against their own submaps. Each new tile is queried against the tiles of
+ * the other robots with the loop closure candidate search, which must be a
+ * place recognition search (e.g. scan context) unless the robots share a
+ * world frame, then each candidate is refined on num_threads threads with the
+ * loop closure refinement, the same way GlobalMapMerger verifies candidates
+ * between sessions.
+ *
+ * The search tiles are cached once loaded, without their lidar clouds if the
+ * candidate search does not use them (see
+ * reloc::RelocCandidateSearchBase::UsesLidarClouds). The clouds of the two
+ * tiles of a candidate are only loaded for its refinement. This class is not
+ * thread safe.
+ */
+class SubmapTileServer {
+public:
+  struct Params {
+    /** Full path to config file for the candidate search. If blank, it will
+     * use default parameters.*/
+    std::string candidate_search_config;
+
+    /** Full path to config file for the candidate refinement. If blank, it
+     * will use default parameters.*/
+    std::string refinement_config;
+
+    /** number of candidates refined in parallel */
+    int num_threads{4};
+
+    /** Loads config settings from a json file. If config_path empty, it will
+     * use default params defined herein. */
+    void LoadJson(const std::string& config_path);
+  };
+
+  /**
+   * @brief relative pose between the tiles of two robots
+   */
+  struct LoopClosure {
+    SubmapTileStore::Tile reference;
+    SubmapTileStore::Tile query;
+    Eigen::Matrix4d T_REFERENCE_QUERY{Eigen::Matrix4d::Identity()};
+  };
+
+  SubmapTileServer(const Params& params,
+                   const std::shared_ptr<SubmapTileStore>& store);
+
+  /**
+   * @brief refresh the store and close loops between each new or replaced
+   * tile and the tiles of the other robots. Tiles are only searched against
+   * the tiles before them, so each pair is searched once
+   * @return successful loop closures
+   */
+  std::vector<LoopClosure> ProcessNewTiles();
+
+  /**
+   * @brief append loop closures to a json file, as a list of objects with
+   * the robot and submap id of both tiles and T_REFERENCE_QUERY
+   * @return false if the file cannot be written
+   */
+  static bool SaveLoopClosures(const std::string& filename,
+                               const std::vector<LoopClosure>& loop_closures);
+
+  /**
+   * @brief load loop closures saved with SaveLoopClosures. The tile paths are
+   * not saved
+   * @return false if the file cannot be read
+   */
+  static bool LoadLoopClosures(const std::string& filename,
+                               std::vector<LoopClosure>& loop_closures);
+
+private:
+  /**
+   * @brief get a search tile from the cache, loading it the first time
+   */
+  SubmapPtr GetSearchTile(size_t tile);
+
+  Params params_;
+  std::shared_ptr<SubmapTileStore> store_;
+  std::shared_ptr<reloc::RelocCandidateSearchBase> candidate_search_;
+  std::vector<std::shared_ptr<reloc::RelocRefinementBase>> refinements_;
+  std::unordered_map<size_t, SubmapPtr> search_tiles_;
+};
+
+} // namespace bs_models::global_mapping
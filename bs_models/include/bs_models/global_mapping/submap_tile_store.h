@@ -0,0 +1,168 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <bs_models/global_mapping/submap.h>
+#include <bs_models/global_mapping/submap_position_index.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Store of the completed submaps of several robots mapping the same
+ * site, in a directory shared by all robots and the tile server (e.g. a
+ * network mount), so that submaps are built, stored and searched once for the
+ * whole fleet instead of once per robot. Each submap is a tile, stored in its
+ * own file in the binary map store format (see map_store.h):
+ *
+ *  root/
+ *    robot_name/
+ *      camera_model.json, extrinsics.json, frame_ids.json
+ *      submap0.bin
+ *      submap1.bin
+ *      ...
+ *
+ * Each tile file holds the chunks of one submap, with its id in the map of its
+ * robot, and a TILE_INFO chunk with its pose so the tiles can be indexed (see
+ * SubmapPositionIndex) without loading them. Tiles are written to a temporary
+ * file which is then renamed, so readers never see a partial tile, and a
+ * submap pushed again replaces its tile.
+ *
+ * Robots push their own submaps and Refresh picks up the tiles pushed by the
+ * others. Tile poses are in the world frame of their robot, so spatial queries
+ * over the tiles of several robots are only meaningful if the robots share a
+ * world frame (e.g. they relocalized in the same prior map). Otherwise the
+ * tiles of other robots are found by place recognition, see
+ * SubmapTileServer. This class is thread safe.
+ */
+class SubmapTileStore {
+public:
+  struct Params {
+    bool enabled{false};
+
+    /** root directory of the store, shared by all robots */
+    std::string directory;
+
+    /** name of this robot, tiles are pushed to its own directory */
+    std::string robot_name;
+
+    /** cell size of the spatial index of the tiles */
+    double cell_size_m{20};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  struct Tile {
+    std::string robot_name;
+
+    /** id of the submap in the global map of its robot */
+    uint16_t submap_id{0};
+
+    ros::Time stamp;
+
+    /** pose when the tile was pushed, in the world frame of its robot */
+    Eigen::Matrix4d T_WORLD_SUBMAP{Eigen::Matrix4d::Identity()};
+
+    std::string path;
+  };
+
+  /**
+   * @brief constructor, the root directory must exist
+   */
+  explicit SubmapTileStore(const Params& params);
+
+  /**
+   * @brief write a submap of this robot as a tile, and add it to the index.
+   * The calibration of the submap is written with the first tile of a robot
+   * @param submap_id id of the submap in the global map of this robot
+   * @param submap completed submap, must not be modified while it is written
+   * @return false if the tile cannot be written
+   */
+  bool Push(uint16_t submap_id, const SubmapPtr& submap);
+
+  /**
+   * @brief add the tiles which were pushed or replaced since the last refresh
+   * by any robot to the index
+   * @return index of each new or replaced tile
+   */
+  std::vector<size_t> Refresh();
+
+  /**
+   * @brief find the tiles within a radius of a position
+   * @param robot_name only tiles of this robot are returned, unless empty
+   * @return tile indices, sorted by increasing distance
+   */
+  std::vector<size_t> Nearby(const Eigen::Vector3d& position, double radius_m,
+                             const std::string& robot_name = "") const;
+
+  /**
+   * @brief load the submap of a tile, with the calibration of its robot
+   * @param load_lidar_clouds if false, the lidar keyframes are loaded without
+   * their clouds, which cannot be loaded later
+   * @return nullptr if the tile cannot be read
+   */
+  SubmapPtr Fetch(size_t tile, bool load_lidar_clouds = true) const;
+
+  Tile GetTile(size_t tile) const;
+
+  size_t Size() const;
+
+  const Params& GetParams() const { return params_; }
+
+private:
+  struct Calibration {
+    std::shared_ptr<beam_calibration::CameraModel> camera_model;
+    std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics;
+  };
+
+  std::string TilePath(const std::string& robot_name,
+                       uint16_t submap_id) const;
+
+  /**
+   * @brief write the calibration of this robot, if it was not written yet
+   */
+  bool WriteCalibration(Submap& submap);
+
+  /**
+   * @brief get the calibration of a robot, loading it the first time
+   * @return false if it does not exist
+   */
+  bool GetCalibration(const std::string& robot_name,
+                      Calibration& calibration) const;
+
+  /**
+   * @brief read the info chunk of a tile file
+   */
+  static bool ReadTileInfo(const std::string& path, Tile& tile);
+
+  /**
+   * @brief add or replace a tile in the index, caller must hold mutex_
+   * @return index of the tile
+   */
+  size_t AddTile(const Tile& tile);
+
+  Params params_;
+
+  mutable std::mutex mutex_;
+  std::vector<Tile> tiles_;
+  std::unordered_map<std::string, size_t> tiles_by_path_;
+  std::unordered_map<std::string, std::filesystem::file_time_type>
+      write_times_;
+  mutable std::unordered_map<std::string, Calibration> calibrations_;
+  SubmapPositionIndex position_index_;
+};
+
+} // namespace bs_models::global_mapping
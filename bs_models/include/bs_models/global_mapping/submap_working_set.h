@@ -0,0 +1,154 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <bs_common/chunk_file.h>
+#include <bs_models/global_mapping/submap.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Bounded set of the submaps of a global map that have their lidar
+ * clouds in memory, used to process global maps which do not fit in memory.
+ * The submaps are loaded without clouds from the map store (see
+ * GlobalMap::Load), and the clouds of a submap are paged in from the store
+ * when a Lease on it is acquired. Once all leases on a submap are released it
+ * stays loaded until the loaded submaps exceed the memory budget, then the
+ * least recently used ones are released.
+ *
+ * The memory of a submap is estimated from the size of its lidar keyframes in
+ * the store, the lidar maps cached by the submap come on top of that. Leased
+ * submaps are never released, so the budget is exceeded when the leased
+ * submaps do not fit in it. This class is thread safe, clouds are loaded
+ * under its lock so concurrent acquires are loaded one at a time.
+ */
+class SubmapWorkingSet {
+public:
+  /**
+   * @brief keeps the clouds of a set of submaps loaded until it is destroyed.
+   * Leases must not outlive their working set
+   */
+  class Lease {
+  public:
+    Lease() = default;
+
+    ~Lease();
+
+    Lease(Lease&& other) noexcept;
+
+    Lease& operator=(Lease&& other) noexcept;
+
+    Lease(const Lease& other) = delete;
+
+    Lease& operator=(const Lease& other) = delete;
+
+    /**
+     * @brief false if the clouds of a submap could not be loaded
+     */
+    bool Valid() const { return valid_; }
+
+    /**
+     * @brief release the submaps before the lease is destroyed
+     */
+    void Release();
+
+  private:
+    friend class SubmapWorkingSet;
+
+    SubmapWorkingSet* working_set_{nullptr};
+    std::vector<size_t> submap_ids_;
+    bool valid_{true};
+  };
+
+  /**
+   * @brief constructor
+   * @param submaps submaps in the order of the map store, loaded without their
+   * lidar clouds
+   * @param map_store open map store the submaps were loaded from
+   * @param memory_budget_bytes max estimated memory of the loaded submaps
+   */
+  SubmapWorkingSet(
+      const std::vector<SubmapPtr>& submaps,
+      const std::shared_ptr<const bs_common::ChunkFileReader>& map_store,
+      size_t memory_budget_bytes);
+
+  SubmapWorkingSet(const SubmapWorkingSet& other) = delete;
+
+  SubmapWorkingSet& operator=(const SubmapWorkingSet& other) = delete;
+
+  /**
+   * @brief get a new working set with the same map store and budget over
+   * copies of the submaps, e.g. the world frame copies of
+   * GlobalMapBatchOptimization. The copies must be in the same order and have
+   * the same lidar keyframes, their clouds are released
+   */
+  std::shared_ptr<SubmapWorkingSet>
+      ForSubmaps(const std::vector<SubmapPtr>& submaps) const;
+
+  /**
+   * @brief load the clouds of submaps and keep them loaded until the returned
+   * lease is destroyed
+   * @param submap_ids indices of the submaps, duplicates are ignored
+   */
+  Lease Acquire(std::vector<size_t> submap_ids);
+
+  /**
+   * @brief release the clouds of all submaps that are not leased
+   */
+  void ReleaseAll();
+
+  /**
+   * @brief split all submaps into consecutive groups whose estimated memory
+   * fits in the budget, with at least overlap + 1 submaps per group
+   * @param overlap number of submaps at the end of each group that are also
+   * at the start of the next group
+   */
+  std::vector<std::vector<size_t>> Partition(size_t overlap = 0) const;
+
+  /**
+   * @brief get the estimated memory of the clouds of a submap
+   */
+  size_t SubmapMemory(size_t submap_id) const;
+
+  /**
+   * @brief get the estimated memory of all loaded submaps
+   */
+  size_t MemoryUsage() const;
+
+  size_t MemoryBudget() const { return memory_budget_bytes_; }
+
+  size_t NumLoaded() const;
+
+  size_t Size() const { return submaps_.size(); }
+
+private:
+  void Unpin(const std::vector<size_t>& submap_ids);
+
+  /**
+   * @brief release least recently used submaps until the memory usage is
+   * within budget or all loaded submaps are leased. Must be called with the
+   * lock held
+   */
+  void EvictToBudget();
+
+  std::vector<SubmapPtr> submaps_;
+  std::shared_ptr<const bs_common::ChunkFileReader> map_store_;
+  size_t memory_budget_bytes_;
+
+  // lidar keyframe chunks of each submap, and their total size
+  std::vector<std::vector<bs_common::ChunkInfo>> chunks_;
+  std::vector<size_t> memory_;
+
+  mutable std::mutex mutex_;
+  std::vector<int> num_leases_;
+  std::vector<bool> loaded_;
+  std::list<size_t> lru_; // loaded submaps, most recently used first
+  std::vector<std::list<size_t>::iterator> lru_positions_;
+  size_t memory_usage_{0};
+  bool warned_over_budget_{false};
+};
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models::global_mapping {
+
+/**
+ * @brief Level of detail lidar map of a global map, split into cubic tiles so
+ * that a large map can be published incrementally. Each tile stores the points
+ * of all submaps overlapping it at num_levels resolutions, where level l is
+ * downsampled with a voxel size of voxel_size_m * 2^l like the levels of an
+ * octree.
+ *
+ * Submaps are added once and only re-binned into tiles when their pose
+ * changes. Each tile has a version which changes whenever its content changes,
+ * so a client that keeps the versions it received only needs the tiles that
+ * changed, or whose level changed because the viewpoint moved (see GetTiles).
+ */
+class TiledLidarMap {
+public:
+  struct Params {
+    /** if false, GlobalMap publishes the full global map instead */
+    bool enabled{false};
+
+    /** side length of the tiles */
+    double tile_size_m{20};
+
+    /** voxel size of the finest level */
+    double voxel_size_m{0.2};
+
+    int num_levels{4};
+
+    /** tiles closer than this to the viewpoint use the finest level, the level
+     * increases by one every time the distance doubles */
+    double lod_distance_m{30};
+
+    /** tiles further than this from the viewpoint are not returned, 0 to
+     * return all tiles */
+    double max_distance_m{0};
+
+    /** submaps that moved less than this are not re-binned */
+    double translation_tol_m{0.05};
+    double rotation_tol_rad{0.01};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  /** integer coordinates of a tile, the tile spans [key, key + 1) *
+   * tile_size_m along each axis */
+  using TileKey = std::array<int64_t, 3>;
+
+  /** <tile, (level, version)> of the tiles a client has */
+  using TileVersions = std::map<TileKey, std::pair<int, uint64_t>>;
+
+  struct Tile {
+    TileKey key;
+    int level;
+    uint64_t version;
+    PointCloud points; // world frame, empty if the tile has been cleared
+  };
+
+  explicit TiledLidarMap(const Params& params = Params());
+
+  /**
+   * @brief add a submap or replace its points
+   * @param submap_id id of the submap in the global map
+   * @param points lidar points in the submap frame
+   * @param T_WORLD_SUBMAP submap pose
+   */
+  void SetSubmap(int submap_id, const PointCloud& points,
+                 const Eigen::Matrix4d& T_WORLD_SUBMAP);
+
+  /**
+   * @brief update the pose of a submap, its tiles are only updated if it moved
+   * more than the tolerances
+   * @return false if the submap has not been added
+   */
+  bool UpdateSubmapPose(int submap_id, const Eigen::Matrix4d& T_WORLD_SUBMAP);
+
+  bool HasSubmap(int submap_id) const;
+
+  void Clear();
+
+  /**
+   * @brief get the tiles that a client is missing, at the level for their
+   * distance to the viewpoint
+   * @param viewpoint position the map is viewed from, in world frame
+   * @param sent_versions tiles the client already has, which is updated with
+   * the returned tiles. Tiles which were emptied are returned without points
+   * @return tiles that are new, changed or at a different level than sent
+   */
+  std::vector<Tile> GetTiles(const Eigen::Vector3d& viewpoint,
+                             TileVersions& sent_versions) const;
+
+  /**
+   * @brief get the level of a tile for a viewpoint
+   */
+  int GetLevel(const TileKey& key, const Eigen::Vector3d& viewpoint) const;
+
+  size_t NumTiles() const { return tiles_.size(); }
+
+private:
+  struct SubmapLevels {
+    Eigen::Matrix4d T_WORLD_SUBMAP;
+    std::vector<PointCloud> levels; // submap frame
+    std::set<TileKey> tiles;
+  };
+
+  struct TileData {
+    uint64_t version{0};
+    std::map<int, std::vector<PointCloud>> submap_levels; // world frame
+  };
+
+  void AddToTiles(int submap_id, SubmapLevels& submap);
+
+  void RemoveFromTiles(int submap_id, SubmapLevels& submap);
+
+  TileKey ToTileKey(const pcl::PointXYZ& p) const;
+
+  /**
+   * @brief distance from a viewpoint to the center of a tile
+   */
+  double DistanceToTile(const TileKey& key,
+                        const Eigen::Vector3d& viewpoint) const;
+
+  Params params_;
+  std::map<int, SubmapLevels> submaps_;
+  std::map<TileKey, TileData> tiles_;
+
+  // versions are unique over all tiles so a tile that is emptied and filled
+  // again never gets a version a client already has
+  uint64_t next_version_{1};
+};
+
+} // namespace bs_models::global_mapping
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <unordered_map>
+
 #include <fuse_core/async_sensor_model.h>
 #include <fuse_core/fuse_macros.h>
 #include <fuse_core/throttled_callback.h>
+#include <fuse_core/uuid.h>
 
 #include <opencv2/core.hpp>
 
@@ -12,12 +15,26 @@
 
 #include <bs_common/bs_msgs.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/graph_snapshot.h>
+#include <bs_models/graph_visualization/landmark_cloud.h>
 
 namespace bs_models {
 
 /**
  * @brief this is a lightweight version of the GraphVisualization which only
  * displays visual keypoints and poses
+ *
+ * Poses are kept up to date from the graph delta of each update (see
+ * bs_common::GraphSnapshot), so only new, changed and removed poses are
+ * visited. Removed (i.e., marginalized) poses are published as odometry with
+ * their last value, and the path of all poses in the window is published at
+ * most once per path_publish_period seconds (parameter, 0 to publish on every
+ * update), only if someone subscribed.
+ *
+ * Camera landmarks are kept up to date the same way (see
+ * graph_visualization::LandmarkCloud) while someone subscribes to them. The
+ * full cloud and the landmarks added or moved since the previous publish are
+ * published at most once per landmarks_publish_period seconds (parameter).
  */
 class GraphPublisher : public fuse_core::AsyncSensorModel {
 public:
@@ -26,6 +43,7 @@ public:
   struct PublisherWithCounter {
     ros::Publisher publisher;
     int counter{0};
+    ros::Time last_publish_time{0};
   };
 
   /**
@@ -43,11 +61,45 @@ private:
   void onStart() override;
   void onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) override;
   void PublishPoses(fuse_core::Graph::ConstSharedPtr graph_msg);
+
+  /**
+   * @brief update the poses of the variables added, changed or removed in an
+   * update, publishing the removed ones
+   */
+  void UpdatePoses(const fuse_core::Graph& graph,
+                   const bs_common::GraphDelta& delta);
+
+  /**
+   * @brief rebuild all poses from a graph, publishing the ones which are no
+   * longer in the graph. This is used when the graph has no delta.
+   */
+  void ResetPoses(const fuse_core::Graph& graph);
+
+  /**
+   * @brief get the pose at a stamp from its variables, keeping an identity for
+   * missing ones like bs_common::GetGraphPoses
+   * @return false if there is no pose variable at this stamp
+   */
+  bool GetPose(const fuse_core::Graph& graph, const ros::Time& stamp,
+               Eigen::Matrix4d& T_World_Baselink) const;
+
+  void PublishMarginalizedPose(const ros::Time& stamp,
+                               const Eigen::Matrix4d& T_World_Baselink);
+
+  void PublishPath();
+
+  /**
+   * @brief update the landmark cloud from the graph delta and publish it if
+   * the publish period elapsed and landmarks changed
+   */
+  void UpdateLandmarkCloud(const fuse_core::Graph& graph);
+
   void PublishCameraLandmarks(fuse_core::Graph::ConstSharedPtr graph_msg);
 
   template <typename PointT>
   void PublishCloud(PublisherWithCounter& publisher,
                     const pcl::PointCloud<PointT>& cloud) {
+    if (publisher.publisher.getNumSubscribers() == 0) { return; }
     sensor_msgs::PointCloud2 ros_cloud = beam::PCLToROS<PointT>(
         cloud, current_time_, extrinsics_.GetWorldFrameId(), publisher.counter);
     publisher.publisher.publish(ros_cloud);
@@ -61,6 +113,7 @@ private:
   PublisherWithCounter graph_path_publisher_;
   PublisherWithCounter graph_odom_publisher_; // these are marginalized poses
   PublisherWithCounter camera_landmarks_publisher_;
+  PublisherWithCounter camera_landmark_updates_publisher_;
   PublisherWithCounter image_publisher_;
 
   /// @brief vo visualization things
@@ -80,7 +133,17 @@ private:
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
   ros::Time current_time_;
-  std::map<ros::Time, Eigen::Matrix4d> poses_last_;
+
+  /** poses currently in the graph, with the stamp of their variables */
+  std::map<ros::Time, Eigen::Matrix4d> poses_;
+  std::unordered_map<fuse_core::UUID, ros::Time, fuse_core::uuid::hash>
+      pose_stamps_;
+  bool path_outdated_{false};
+  double path_publish_period_{0};
+
+  /** camera landmarks in the graph, only kept while someone subscribes */
+  graph_visualization::LandmarkCloud landmark_cloud_;
+  double landmarks_publish_period_{1.0};
 
   // parameters only tunable here
   double frame_size_{0.15};
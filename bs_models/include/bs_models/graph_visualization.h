@@ -12,6 +12,8 @@
 
 #include <bs_common/bs_msgs.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/graph_view.h>
 #include <bs_parameters/models/graph_visualization_params.h>
 
 namespace bs_models {
@@ -23,6 +25,7 @@ public:
   struct PublisherWithCounter {
     ros::Publisher publisher;
     int counter{0};
+    ros::Time last_publish_time;
   };
 
   /**
@@ -56,7 +59,8 @@ private:
   void onStart() override;
   void onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) override;
 
-  void VisualizePoses(fuse_core::Graph::ConstSharedPtr graph_msg);
+  void VisualizePoses(const bs_common::GraphView& view,
+                      const bs_common::GraphDelta* delta);
 
   void VisualizeLidarRelativePoseConstraints(
       fuse_core::Graph::ConstSharedPtr graph_msg);
@@ -64,25 +68,49 @@ private:
   void VisualizeImuRelativeConstraints(
       fuse_core::Graph::ConstSharedPtr graph_msg);
 
-  void VisualizeImuBiases(fuse_core::Graph::ConstSharedPtr graph_msg);
+  void VisualizeImuBiases(
+      const std::map<int64_t, bs_common::ImuBiases>& biases_in_graph);
 
   void VisualizeImuGravityConstraints(
       fuse_core::Graph::ConstSharedPtr graph_msg);
 
-  void VisualizeCameraLandmarks(fuse_core::Graph::ConstSharedPtr graph_msg);
+  void VisualizeCameraLandmarks(const bs_common::GraphView& view);
 
-  void ValidateGraphPriors(fuse_core::Graph::ConstSharedPtr graph_msg);
+  // only the constraints added since the last update are validated, the
+  // removed ones are dropped from the connectivity in UpdateConnectivity
+  void ValidateGraph(fuse_core::Graph::ConstSharedPtr graph_msg,
+                     const bs_common::GraphDelta* delta);
 
-  void ValidateGraphConnectivity(fuse_core::Graph::ConstSharedPtr graph_msg);
+  void ValidateGraphPrior(const fuse_core::Constraint& constraint);
+
+  void UpdateConnectivity(const fuse_core::Graph& graph,
+                          const bs_common::GraphDelta* delta);
+
+  void AddConnectivity(const fuse_core::Constraint& constraint);
+
+  void ValidateGraphConnectivity();
+
+  // true if a cloud will be published or saved this update, so that clouds
+  // no one uses are not generated
+  bool IsCloudNeeded(const PublisherWithCounter& publisher) const {
+    return !save_path_.empty() || IsPublishDue(publisher);
+  }
+
+  bool IsPublishDue(const PublisherWithCounter& publisher) const {
+    return params_.publish && publisher.publisher.getNumSubscribers() > 0 &&
+           current_time_ - publisher.last_publish_time >=
+               ros::Duration(params_.publish_period);
+  }
 
   template <typename PointT>
   void PublishCloud(PublisherWithCounter& publisher,
                     const pcl::PointCloud<PointT>& cloud) {
-    if (!params_.publish) { return; }
+    if (!IsPublishDue(publisher)) { return; }
     sensor_msgs::PointCloud2 ros_cloud = beam::PCLToROS<PointT>(
         cloud, current_time_, extrinsics_.GetWorldFrameId(), publisher.counter);
     publisher.publisher.publish(ros_cloud);
     publisher.counter++;
+    publisher.last_publish_time = current_time_;
   }
 
   void
@@ -90,12 +118,6 @@ private:
 
   bool HasImuConstraint(const ConstraintTypeMap& constraints) const;
 
-  fuse_core::UUID
-      GetLastVariable(const VariableConnectivityType& connectivity) const;
-
-  fuse_core::UUID
-      GetFirstVariable(const VariableConnectivityType& connectivity) const;
-
   // loadable parameters
   bs_parameters::models::GraphVisualizationParams params_;
 
@@ -140,6 +162,14 @@ private:
   std::unordered_map<std::string, fuse_core::UUID>
       extrinsics_constraints_; // T_child_parent -> uuid
   bool prior_found_on_first_{false};
+  VariableConnectivityType connectivity_;
+  std::map<ros::Time, fuse_core::UUID> positions_by_stamp_;
+  std::unordered_map<fuse_core::UUID, std::vector<fuse_core::UUID>,
+                     fuse_core::uuid::hash>
+      constraint_positions_; // validated constraint -> connected positions
+
+  // pose frames, only regenerated for poses that changed since the last update
+  std::map<ros::Time, pcl::PointCloud<pcl::PointXYZRGBL>> pose_clouds_;
 
   // parameters only tunable here
   double frame_size_{0.15};
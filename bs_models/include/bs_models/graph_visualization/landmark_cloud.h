@@ -0,0 +1,97 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_common/graph_snapshot.h>
+
+namespace bs_models::graph_visualization {
+
+/**
+ * @brief Point cloud of the camera landmarks (bs_variables::Point3DLandmark)
+ * of a graph, kept up to date incrementally. Only the variables of a graph
+ * delta (see bs_common::GraphSnapshot) or of a transaction are visited on
+ * update, the graph is only scanned by Reset. Landmarks added or moved since
+ * the last call to TakeUpdates can be published on their own, so subscribers
+ * that accumulate landmarks don't need the full cloud.
+ *
+ * Each landmark gets a random color seeded by its id, as in
+ * GetGraphCameraLandmarksAsCloud.
+ */
+class LandmarkCloud {
+public:
+  /**
+   * @brief rebuild the cloud from all landmarks in a graph
+   */
+  void Reset(const fuse_core::Graph& graph);
+
+  /**
+   * @brief update the landmarks of a graph delta
+   * @param graph graph the delta leads to
+   * @param delta variables added, changed and removed since the previous graph
+   */
+  void Update(const fuse_core::Graph& graph,
+              const bs_common::GraphDelta& delta);
+
+  /**
+   * @brief update the landmarks of a transaction that was applied to graph:
+   * added landmarks, landmarks connected to added constraints (whose value
+   * has usually just moved) and removed landmarks
+   */
+  void Update(const fuse_core::Graph& graph,
+              const fuse_core::Transaction& transaction);
+
+  /**
+   * @brief cloud of all landmarks, only rebuilt if landmarks changed since
+   * the last call
+   */
+  const pcl::PointCloud<pcl::PointXYZRGBL>& Cloud();
+
+  /**
+   * @brief landmarks added or moved since the last call (or Reset), removed
+   * landmarks aren't included
+   */
+  pcl::PointCloud<pcl::PointXYZRGBL> TakeUpdates();
+
+  /**
+   * @brief whether landmarks were added, moved or removed since the cloud
+   * was last built
+   */
+  bool Changed() const { return cloud_outdated_; }
+
+  /**
+   * @brief false until Reset is called, and again after Clear
+   */
+  bool Initialized() const { return initialized_; }
+
+  size_t Size() const { return points_.size(); }
+
+  void Clear();
+
+private:
+  /**
+   * @brief add or move a landmark with the value of its variable
+   * @return false if the variable doesn't exist or isn't a landmark
+   */
+  bool UpdateLandmark(const fuse_core::Graph& graph,
+                      const fuse_core::UUID& uuid);
+
+  void RemoveLandmark(const fuse_core::UUID& uuid);
+
+  using UUIDSet = std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash>;
+
+  std::unordered_map<fuse_core::UUID, pcl::PointXYZRGBL, fuse_core::uuid::hash>
+      points_;
+  UUIDSet updated_;
+  pcl::PointCloud<pcl::PointXYZRGBL> cloud_;
+  bool cloud_outdated_{false};
+  bool initialized_{false};
+};
+
+} // namespace bs_models::graph_visualization
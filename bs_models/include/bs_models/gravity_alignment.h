@@ -9,6 +9,7 @@
 #include <sensor_msgs/Imu.h>
 
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/imu_sample_buffer.h>
 #include <bs_parameters/models/gravity_alignment_params.h>
 
 namespace bs_models {
@@ -59,10 +60,25 @@ private:
    */
   void onStop() override {}
 
-  void AddConstraint(const sensor_msgs::Imu::ConstPtr& imu_msg,
-                     const ros::Time& stamp);
+  /**
+   * @brief Adds a gravity alignment constraint to the orientation at stamp
+   * @param g_in_Imu unit gravity direction measured in the imu frame
+   * @param stamp time of the orientation to constrain
+   */
+  void AddConstraint(const Eigen::Vector3d& g_in_Imu, const ros::Time& stamp);
+
+  /**
+   * @brief Averages the gravity direction in the imu frame over the samples in
+   * the averaging window ending at end_time
+   * @param end_time end of the window
+   * @param g_in_Imu [out] averaged unit gravity direction
+   * @return false if the window has no samples, or any sample in it exceeds
+   * the dynamics limits
+   */
+  bool AverageGravity(const ros::Time& end_time,
+                      Eigen::Vector3d& g_in_Imu) const;
 
-  void Publish(const sensor_msgs::Imu::ConstPtr& imu_data,
+  void Publish(const bs_common::ImuSample& imu_sample,
                const nav_msgs::Odometry::ConstPtr& odom_data) const;
 
   // loadable parameters
@@ -77,9 +93,12 @@ private:
   ros::Publisher publisher_;
   int counter_{0};
 
+  // stamp of the last constraint added, used to limit the constraint rate
+  ros::Time last_constraint_stamp_{0};
+
   // store IMU data up to buffer_duration_ and each time a new odom topic comes
   // in, we create a constraint and clear all IMU data prior to that timestamp
-  std::map<int64_t, sensor_msgs::Imu::ConstPtr> imu_buffer_;
+  bs_common::ImuSampleBuffer imu_buffer_;
 
   // extrinsics
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
@@ -101,10 +120,10 @@ private:
   std::string source_{"GravityAlignment"};
 
   // 5 second window of IMU data to store
-  int64_t buffer_duration_in_ns_{5000000000};
+  ros::Duration buffer_duration_{5.0};
 
   // max offset between odom msg and closest IMU msg
-  int64_t max_time_offset_in_ns_{100000000}; // 0.1s
+  ros::Duration max_time_offset_{0.1};
 
   bool publish_results_{true};
   double gravity_vector_length_{0.75}; // m
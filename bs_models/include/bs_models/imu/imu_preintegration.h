@@ -4,6 +4,8 @@
 #include <queue>
 
 #include <bs_common/bs_msgs.h>
+#include <bs_common/compact_imu_state.h>
+#include <bs_common/graph_view.h>
 #include <bs_common/imu_state.h>
 #include <bs_common/preintegrator.h>
 #include <bs_constraints/inertial/imu_state_3d_stamped_transaction.h>
@@ -39,6 +41,9 @@ public:
     Eigen::Matrix3d cov_gyro_bias{Eigen::Matrix3d::Identity() * 1e-6};
     Eigen::Matrix3d cov_accel_bias{Eigen::Matrix3d::Identity() * 1e-4};
     std::string source{"ImuPreintegration"};
+    // allocate the constraints and variables of each imu state from pools of
+    // their types (see bs_common::MakePooled)
+    bool use_pooled_allocation{false};
 
     bool LoadFromJSON(const std::string& path);
   };
@@ -121,16 +126,37 @@ public:
    * @param t_now time at which to stamp new IMU state if specified
    * @return ImuState
    */
-  bs_common::ImuState
+  static bs_common::ImuState
       PredictState(const bs_common::PreIntegrator& pre_integrator,
                    const bs_common::ImuState& imu_state_curr,
                    const ros::Time& t_now = ros::Time(0));
 
   /**
-   * @brief Gets current IMU state, which is the last registered key frame
+   * @brief Same as above for compact states, which propagates without
+   * building any fuse variables
+   */
+  static bs_common::CompactImuState
+      PredictState(const bs_common::PreIntegrator& pre_integrator,
+                   const bs_common::CompactImuState& imu_state_curr,
+                   const ros::Time& t_now = ros::Time(0));
+
+  /**
+   * @brief Gets current IMU state, which is the last registered key frame.
+   * This builds its variables, use GetCompactImuState if only the values are
+   * needed
    * @return ImuState
    */
-  bs_common::ImuState GetImuState() const { return imu_state_i_; }
+  bs_common::ImuState GetImuState() const {
+    return bs_common::ImuState(imu_state_i_);
+  }
+
+  /**
+   * @brief Gets the values of the current IMU state
+   * @return CompactImuState
+   */
+  bs_common::CompactImuState GetCompactImuState() const {
+    return imu_state_i_;
+  }
 
   /**
    * @brief Registers new transaction between key frames
@@ -147,12 +173,39 @@ public:
       fuse_variables::Position3DStamped::SharedPtr t_WORLD_IMU = nullptr,
       fuse_variables::VelocityLinear3DStamped::SharedPtr velocity = nullptr);
 
+  /**
+   * @brief Registers new transaction between key frames using a measurement
+   * that was already preintegrated from the current key frame to t_now (e.g.
+   * by a PreintegrationTree) with the biases of the current key frame, instead
+   * of integrating the measurements in the buffer
+   * @param t_now time at which to set new key frame
+   * @param pre_integrator preintegrated measurement, with its jacobians and
+   * square root information computed
+   * @param R_WORLD_IMU orientation of new key frame from VIO or LIO (if null,
+   * imu will predict)
+   * @param t_WORLD_IMU position of new key frame from VIO or LIO (if null, imu
+   * will predict)
+   * @return transaction if successful. If not, nullptr is returned
+   */
+  fuse_core::Transaction::SharedPtr RegisterPreintegratedFactor(
+      const ros::Time& t_now, const bs_common::PreIntegrator& pre_integrator,
+      fuse_variables::Orientation3DStamped::SharedPtr R_WORLD_IMU = nullptr,
+      fuse_variables::Position3DStamped::SharedPtr t_WORLD_IMU = nullptr,
+      fuse_variables::VelocityLinear3DStamped::SharedPtr velocity = nullptr);
+
   /**
    * @brief Updates current graph copy
    * @param graph_msg graph to update with
    */
   void UpdateGraph(fuse_core::Graph::ConstSharedPtr graph_msg);
 
+  /**
+   * @brief Updates current graph copy using a view that was already built for
+   * this graph update
+   * @param graph_view view of the graph to update with
+   */
+  void UpdateGraph(const bs_common::GraphView& graph_view);
+
   /**
    * @brief Updates state i with the given variables
    * @param position
@@ -193,20 +246,41 @@ private:
    */
   void SetPreintegrator();
 
+  /**
+   * @brief Adds the prior on the first key frame to the transaction if this is
+   * the first window and priors are enabled. preint_mutex_ must be held
+   */
+  void AddFirstWindowPrior(
+      bs_constraints::ImuState3DStampedTransaction& transaction);
+
+  /**
+   * @brief Adds the relative constraint between the current key frame and a
+   * new key frame at t_now, then moves the current key frame to the new one.
+   * preint_mutex_ must be held
+   * @param pre_integrator measurement preintegrated from the current key frame
+   * to t_now
+   */
+  void AddRelativeFactor(
+      bs_constraints::ImuState3DStampedTransaction& transaction,
+      const ros::Time& t_now, const bs_common::PreIntegrator& pre_integrator,
+      fuse_variables::Orientation3DStamped::SharedPtr R_WORLD_IMU,
+      fuse_variables::Position3DStamped::SharedPtr t_WORLD_IMU,
+      fuse_variables::VelocityLinear3DStamped::SharedPtr velocity);
+
   Params params_;           // class parameters
   bool first_window_{true}; // flag for first window between key frames
   bool add_prior_on_first_window_{true};
   std::string source_;
 
-  bs_common::ImuState imu_state_i_; // current key frame
-  bs_common::ImuState imu_state_k_; // intermediate frame
+  bs_common::CompactImuState imu_state_i_; // current key frame
+  bs_common::CompactImuState imu_state_k_; // intermediate frame
   bs_common::PreIntegrator
       pre_integrator_ij_; // preintegrate between key frames
   bs_common::PreIntegrator
       pre_integrator_kj_; // preintegrate between every frame
   Eigen::Vector3d bg_{Eigen::Vector3d::Zero()}; // zero gyroscope bias
   Eigen::Vector3d ba_{Eigen::Vector3d::Zero()}; // zero acceleration bias
-  std::unordered_map<uint64_t, bs_common::ImuState>
+  std::unordered_map<uint64_t, bs_common::CompactImuState>
       window_states_; // state velocities in the window
   double info_weight_{1.0};
   std::mutex preint_mutex_;
@@ -1,26 +1,60 @@
 #pragma once
 
+#include <bs_common/imu_sample_buffer.h>
 #include <bs_models/imu/imu_preintegration.h>
 
 namespace bs_models { namespace imu {
+
+/**
+ * @brief Method used to estimate gravity, scale and velocities.
+ * QR: solves the full linear system over gravity, scale and every velocity
+ * CLOSED_FORM: eliminates the velocities using the preintegrated velocity
+ * deltas so the normal equations over gravity, scale and the first velocity
+ * are a fixed size, then refines with gravity constrained to its nominal
+ * magnitude
+ */
+enum class AlignmentMethod { QR = 0, CLOSED_FORM };
+
+/**
+ * @brief Accuracy and runtime of an inertial alignment
+ */
+struct AlignmentSummary {
+  AlignmentMethod method{AlignmentMethod::QR};
+  bool success{false};
+  int num_frames{0};
+  // time to estimate the gyro bias, gravity, scale and velocities
+  double solve_time_s{0};
+  // magnitude of the gravity estimate before it is set to the nominal value
+  double unconstrained_gravity_norm{0};
+  // rms of the preintegrated position and velocity residuals between
+  // consecutive frames, using the final estimates
+  double rms_position_residual{0};
+  double rms_velocity_residual{0};
+  // gauss-newton iterations used by the closed form refinement
+  int refinement_iterations{0};
+};
+
 /**
  * @brief Estimates inertial parameters given an initial path and imu messages
  * @param path initial path estimate of robot (T_world_baselink)
- * @param imu_buffer buffer of imu messages
+ * @param imu_buffer buffer of imu samples
  * @param params initial noise parameters of imu
  * @param gravity [out] output resulting gravity estimate
  * @param bg [out] output resulting  gyroscope bias
  * @param ba [out] output resulting accelerometer bias
  * @param velocities [out] map of velocities at each pose in the path
  * @param scale [out] scale estimate wrt the imu messages
+ * @param method method used to estimate gravity, scale and velocities
+ * @param summary [out] accuracy and runtime of the alignment
  */
 void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
-                        const std::list<sensor_msgs::Imu>& imu_buffer,
+                        const bs_common::ImuSampleBuffer& imu_buffer,
                         const bs_models::ImuPreintegration::Params& params,
                         Eigen::Vector3d& gravity, Eigen::Vector3d& bg,
                         Eigen::Vector3d& ba,
                         std::map<uint64_t, Eigen::Vector3d>& velocities,
-                        double& scale);
+                        double& scale, AlignmentMethod method,
+                        AlignmentSummary& summary);
 
 /**
  * @brief Estimates gyroscope bias given imu states
@@ -42,7 +76,29 @@ void EstimateGyroBias(const std::vector<bs_common::ImuState>& imu_frames,
 void EstimateGravityScaleVelocities(
     const std::vector<bs_common::ImuState>& imu_frames,
     Eigen::Vector3d& gravity, double& scale,
-    std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities);
+    std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities,
+    AlignmentSummary& summary);
+
+/**
+ * @brief Estimates gravity, scale and velocities in closed form. Integrating
+ * the velocity deltas gives each velocity as v_i = v_0 + T_i * g + c_i, so the
+ * position deltas constrain only gravity, scale and v_0. Their normal
+ * equations are accumulated in one pass over the frames and solved with a
+ * fixed size cholesky decomposition, then a few gauss-newton steps refine the
+ * estimate with gravity on the sphere of nominal magnitude
+ * @param imu_frames list of imu states with populated imu buffers and external
+ * poses
+ * @param gravity [out] estimated gravity
+ * @param scale [out] estimated scale
+ * @param velocities [out] estimated velocities at each imu frame time
+ * @param summary [out] unconstrained gravity norm and refinement iterations
+ * @param max_iterations max number of gauss-newton refinement steps
+ */
+void EstimateGravityScaleVelocitiesClosedForm(
+    const std::vector<bs_common::ImuState>& imu_frames,
+    Eigen::Vector3d& gravity, double& scale,
+    std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities,
+    AlignmentSummary& summary, int max_iterations = 5);
 
 /**
  * @brief Refines gravity, scale and velocity
@@ -64,4 +120,20 @@ void RefineGravityScaleVelocities(
  */
 double ImuObservability(const std::vector<bs_common::ImuState>& imu_frames);
 
+/**
+ * @brief Computes the rms of the preintegrated position and velocity residuals
+ * between consecutive frames given the alignment estimates
+ * @param imu_frames list of imu states with populated imu buffers and external
+ * poses
+ * @param gravity estimated gravity
+ * @param scale estimated scale
+ * @param velocities estimated velocities at each imu frame time
+ * @param summary [out] summary to store the residuals in
+ */
+void ComputeAlignmentResiduals(
+    const std::vector<bs_common::ImuState>& imu_frames,
+    const Eigen::Vector3d& gravity, double scale,
+    const std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities,
+    AlignmentSummary& summary);
+
 }} // namespace bs_models::imu
\ No newline at end of file
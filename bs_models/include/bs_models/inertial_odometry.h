@@ -12,7 +12,14 @@
 #include <std_msgs/Time.h>
 
 #include <bs_common/bs_msgs.h>
+#include <bs_common/callback_lane.h>
+#include <bs_common/compact_imu_state.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/graph_view.h>
+#include <bs_common/imu_sample_buffer.h>
+#include <bs_common/preintegration_tree.h>
+#include <bs_common/rcu_slot.h>
+#include <bs_common/spsc_queue.h>
 #include <bs_models/frame_initializers/frame_initializer.h>
 #include <bs_models/imu/imu_preintegration.h>
 #include <bs_parameters/models/calibration_params.h>
@@ -24,6 +31,9 @@ struct ImuConstraintData {
   fuse_core::UUID constraint_uuid;
   ros::Time start_time;
   ros::Time end_time;
+  // biases of the start state the imu data was integrated with
+  Eigen::Vector3d bg{Eigen::Vector3d::Zero()};
+  Eigen::Vector3d ba{Eigen::Vector3d::Zero()};
 };
 
 /**
@@ -39,22 +49,43 @@ public:
 
   // add to the constraint buffer
   void AddConstraint(const ros::Time& start_time, const ros::Time& end_time,
-                     const fuse_core::UUID& constraint_uuid);
+                     const fuse_core::UUID& constraint_uuid,
+                     const Eigen::Vector3d& bg, const Eigen::Vector3d& ba);
 
   // extract imu constraint data that contains a specific time stamp. This will
   // remove it from the constraint buffer and therefore will need to be re-added
-  // remove it from the constraint buffer and therefore will need to be re-added
   std::optional<ImuConstraintData>
       ExtractConstraintContainingTime(const ros::Time& time);
 
-  std::map<ros::Time, sensor_msgs::Imu::ConstPtr>
-      GetImuData(const ros::Time& start_time, const ros::Time& end_time) const;
+  // view of the IMU data between start_time and end_time (inclusive), which
+  // is invalidated when new data is added
+  bs_common::ImuSampleBuffer::View GetImuData(const ros::Time& start_time,
+                                              const ros::Time& end_time) const;
+
+  // set the noise used to preintegrate the buffered IMU data
+  void SetPreintegrationNoise(const ImuPreintegration::Params& params);
+
+  // preintegrate the buffered IMU data between start_time and end_time, see
+  // bs_common::PreintegrationTree::Integrate
+  bool Preintegrate(const ros::Time& start_time, const ros::Time& end_time,
+                    const Eigen::Vector3d& bg, const Eigen::Vector3d& ba,
+                    bs_common::PreIntegrator& pre_integrator);
+
+  // preintegrate the buffered IMU data between start_time and end_time from
+  // scratch, holding each sample until the next one like Preintegrate but
+  // without using or changing the cached segments, which keep their biases
+  bool Reintegrate(const ros::Time& start_time, const ros::Time& end_time,
+                   const Eigen::Vector3d& bg, const Eigen::Vector3d& ba,
+                   bs_common::PreIntegrator& pre_integrator) const;
+
+  // constraint buffer, mutable so replaced constraints can be updated in place
+  std::map<ros::Time, ImuConstraintData>& GetConstraints();
 
   ros::Time GetLastConstraintTime() const;
 
   void ClearImuMsgs();
 
-  const std::map<ros::Time, sensor_msgs::Imu::ConstPtr>& GetImuMsgs() const;
+  const bs_common::ImuSampleBuffer& GetImuSamples() const;
 
 private:
   void CleanOverflow();
@@ -64,7 +95,11 @@ private:
   std::map<ros::Time, ImuConstraintData> constraint_buffer_;
 
   // raw IMU data not added to the constraint buffer
-  std::map<ros::Time, sensor_msgs::Imu::ConstPtr> imu_msgs_;
+  bs_common::ImuSampleBuffer imu_samples_;
+
+  // preintegrated segments of the raw IMU data, so constraints can be split
+  // without re-integrating all of their data
+  bs_common::PreintegrationTree preintegration_tree_;
   ros::Duration buffer_length_;
 };
 
@@ -90,9 +125,32 @@ private:
    */
   void processIMU(const sensor_msgs::Imu::ConstPtr& msg);
 
+  /**
+   * @brief Adds queued imu msgs to the imu buffer and integrates them to
+   * publish relative odometry. mutex_ must be held
+   */
+  void ProcessQueuedImu();
+
+  /**
+   * @brief Propagates the latest optimized state to the time of an imu msg and
+   * publishes it. This is only called from the imu callback and never takes
+   * mutex_, so it keeps running while graph updates are processed
+   * @param[in] msg - The imu msg to propagate to
+   */
+  void PropagateImu(const sensor_msgs::Imu::ConstPtr& msg);
+
+  /**
+   * @brief Hands the current imu state over to the propagation path. mutex_
+   * must be held
+   */
+  void PublishOptimizedState();
+
   /**
    * @brief Callback for processing a Time message which serves as a trigger to
-   * add IMU constraints
+   * add IMU constraints. All buffered triggers whose states are in the graph
+   * are sent in a single transaction, and triggers within
+   * trigger_coalescing_tolerance of the last constraint are tied to its state
+   * with a zero motion constraint instead of getting their own
    * @param[in] msg - The time msg to process
    */
   void processTrigger(const std_msgs::Time::ConstPtr& msg);
@@ -124,6 +182,11 @@ private:
    */
   void onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) override;
 
+  /**
+   * @brief queue graph updates on graph_update_lane_ if it is configured
+   */
+  void graphCallback(fuse_core::Graph::ConstSharedPtr graph) override;
+
   /**
    * @brief Computes relative motion and publishes to odometry
    * @param prev_stamp
@@ -142,9 +205,32 @@ private:
    * @brief Attempts to split an imu constraint
    * @param new_trigger_time
    *  @param constraint_data)
+   * @param transaction transaction to add the new constraints to
    */
   void BreakupConstraint(const ros::Time& new_trigger_time,
-                         const ImuConstraintData& constraint_data);
+                         const ImuConstraintData& constraint_data,
+                         fuse_core::Transaction::SharedPtr transaction);
+
+  /**
+   * @brief Adds a zero motion constraint between the state at some time in the
+   * most recent graph and a new state at a nearby time
+   * @param state_time time of the state in the graph
+   * @param new_time time of the new state
+   * @param transaction transaction to add the constraint to
+   * @return false if the state is not in the graph
+   */
+  bool AddZeroMotionConstraint(
+      const ros::Time& state_time, const ros::Time& new_time,
+      fuse_core::Transaction::SharedPtr transaction) const;
+
+  /**
+   * @brief Replaces the imu constraints whose start state biases moved past
+   * the relinearization tolerances since they were integrated with constraints
+   * re-integrated at the current biases, and sends them in one transaction.
+   * All other constraints are left as is
+   * @param graph_view view of the most recent graph
+   */
+  void RelinearizeConstraints(const bs_common::GraphView& graph_view);
 
   /**
    * @brief Resets to base state
@@ -170,6 +256,7 @@ private:
   // publishers
   ros::Publisher odometry_publisher_;
   ros::Publisher reset_publisher_;
+  ros::Publisher propagated_odometry_publisher_;
 
   // data storage
   ros::Time last_trigger_time_;
@@ -181,6 +268,17 @@ private:
   bs_models::ImuPreintegration::Params imu_params_;
   std::mutex mutex_;
 
+  // imu msgs waiting to be processed under mutex_, so the imu callback doesn't
+  // block while a graph update holds it
+  bs_common::SPSCQueue<sensor_msgs::Imu::ConstPtr> imu_queue_{2000};
+
+  // high rate propagation, everything but the slot is only used by the imu
+  // callback
+  bs_common::RcuSlot<bs_common::CompactImuState> optimized_state_;
+  bs_common::RcuSlot<bs_common::CompactImuState>::ConstPtr propagation_origin_;
+  bs_common::PreIntegrator propagation_preintegrator_;
+  int propagated_seq_ = 0;
+
   // extrinsics
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
@@ -194,6 +292,12 @@ private:
   using ThrottledTriggerCallback =
       fuse_core::ThrottledMessageCallback<std_msgs::Time>;
   ThrottledTriggerCallback throttled_trigger_callback_;
+
+  // graph updates, only set if graph_update_lane/queue_size or
+  // graph_update_lane/dedicated is set. Declared last so it is destroyed
+  // first, stopping its callbacks before the members they use are destroyed
+  std::unique_ptr<bs_common::CallbackLane<fuse_core::Graph>>
+      graph_update_lane_;
 };
 
 } // namespace bs_models
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/point_cloud.h>
+
+#include <beam_filtering/Utils.h>
+
+#include <bs_common/cloud_buffer_pool.h>
+#include <bs_models/lidar/lidar_point.h>
+#include <bs_models/lidar/parallel_voxel_grid.h>
+#include <bs_models/scan_registration/voxel_key.h>
+
+namespace bs_models {
+
+/**
+ * @brief true for the point types that can be filtered with beam_filtering,
+ * i.e., registered pcl point types
+ */
+template <typename PointT>
+struct SupportsPclFilters : std::true_type {};
+
+template <>
+struct SupportsPclFilters<LidarPoint> : std::false_type {};
+
+/**
+ * @brief Compiled version of a beam_filtering filter chain, equivalent to
+ * beam_filtering::FilterPointCloud but with much less copying. The
+ * chain is compiled once from the filter params, and consecutive filters are
+ * fused into stages:
+ *
+ *  - crop boxes are point-wise tests so any number of consecutive crop boxes
+ *    are checked in a single pass,
+ *  - a voxel filter is fused with the crop boxes that precede it, so points
+ *    are tested and accumulated into their voxel in the same pass,
+ *  - a radius outlier removal (ROR) filter is its own pass since it needs a
+ *    neighbour search over the output of the previous stage,
+ *  - any other filter type is run through beam_filtering.
+ *
+ * All passes run in place on the output cloud, so no intermediate clouds are
+ * copied, and the output cloud can be reused between calls to keep its
+ * memory. Non-finite points are removed by all fused stages.
+ *
+ * Point types which are not registered with pcl (e.g., LidarPoint) only
+ * support crop box, voxel and ROR filters, see Supports.
+ *
+ * The voxel filter outputs one point per voxel at the centroid of its points,
+ * with all other fields (e.g., intensity, ring) taken from the first point in
+ * the voxel (see scan_registration::VoxelMap). Points stay in the order they
+ * were first seen, instead of being sorted by voxel. Large clouds are
+ * voxelized over multiple threads with ParallelVoxelGrid, which gives the same
+ * output.
+ */
+template <typename PointT>
+class FilterPipeline {
+public:
+  using CloudType = pcl::PointCloud<PointT>;
+
+  FilterPipeline() = default;
+
+  /**
+   * @brief constructor
+   * @param filter_params filter chain, as loaded by
+   * beam_filtering::LoadFilterParamsVector
+   */
+  explicit FilterPipeline(
+      const std::vector<beam_filtering::FilterParamsType>& filter_params) {
+    if (!Supports(filter_params)) {
+      throw std::invalid_argument{
+          "filter chain not supported by the point type"};
+    }
+    for (const auto& filter : filter_params) {
+      const beam_filtering::FilterType type = filter.first;
+      const std::vector<double>& params = filter.second;
+      if (type == beam_filtering::FilterType::CROPBOX) {
+        // params: min (x, y, z), max (x, y, z), remove_outside_points
+        if (stages_.empty() || stages_.back().voxel ||
+            stages_.back().type != StageType::FUSED) {
+          stages_.emplace_back();
+        }
+        CropBox box;
+        box.min = Eigen::Vector3f(params[0], params[1], params[2]);
+        box.max = Eigen::Vector3f(params[3], params[4], params[5]);
+        box.remove_outside_points = params[6] != 0;
+        stages_.back().crop_boxes.push_back(box);
+      } else if (type == beam_filtering::FilterType::VOXEL) {
+        // params: voxel size (x, y, z)
+        if (stages_.empty() || stages_.back().voxel ||
+            stages_.back().type != StageType::FUSED) {
+          stages_.emplace_back();
+        }
+        stages_.back().voxel = true;
+        stages_.back().voxel_size =
+            Eigen::Vector3f(params[0], params[1], params[2]);
+        typename ParallelVoxelGrid<PointT>::Params grid_params;
+        grid_params.voxel_size = stages_.back().voxel_size;
+        stages_.back().voxel_grid.SetParams(grid_params);
+      } else if (type == beam_filtering::FilterType::ROR) {
+        // params: search radius, min neighbours
+        Stage stage;
+        stage.type = StageType::ROR;
+        stage.ror_radius = params[0];
+        stage.ror_min_neighbors = static_cast<int>(params[1]);
+        stages_.push_back(stage);
+      } else {
+        Stage stage;
+        stage.type = StageType::OTHER;
+        stage.other_params = {filter};
+        stages_.push_back(stage);
+      }
+    }
+  }
+
+  /**
+   * @brief check if a filter chain can run on this point type
+   */
+  static bool Supports(
+      const std::vector<beam_filtering::FilterParamsType>& filter_params) {
+    if (SupportsPclFilters<PointT>::value) { return true; }
+    for (const auto& filter : filter_params) {
+      if (filter.first != beam_filtering::FilterType::CROPBOX &&
+          filter.first != beam_filtering::FilterType::VOXEL &&
+          filter.first != beam_filtering::FilterType::ROR) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief filter a cloud
+   * @param input input cloud
+   * @param output filtered cloud, this can be the same as the input
+   */
+  void Filter(const CloudType& input, CloudType& output) const {
+    if (stages_.empty() || stages_.front().type != StageType::FUSED) {
+      if (&input != &output) { output = input; }
+      for (const auto& stage : stages_) { ApplyStage(stage, output); }
+      return;
+    }
+
+    // the first stage reads from the input directly to avoid copying it
+    ApplyFused(stages_.front(), input, output);
+    for (size_t i = 1; i < stages_.size(); i++) {
+      ApplyStage(stages_[i], output);
+    }
+  }
+
+  /**
+   * @brief filter a cloud
+   * @return filtered cloud
+   */
+  CloudType Filter(const CloudType& input) const {
+    CloudType output;
+    Filter(input, output);
+    return output;
+  }
+
+  /**
+   * @brief set the priority of the tasks of the voxel filters of large
+   * clouds, see ParallelVoxelGrid. Defaults to real-time
+   */
+  void SetTaskPriority(bs_common::TaskPriority priority) {
+    for (auto& stage : stages_) {
+      auto grid_params = stage.voxel_grid.GetParams();
+      grid_params.priority = priority;
+      stage.voxel_grid.SetParams(grid_params);
+    }
+  }
+
+  /**
+   * @brief get the number of passes over the cloud
+   */
+  size_t NumStages() const { return stages_.size(); }
+
+  /**
+   * @brief check if this has no filters
+   */
+  bool Empty() const { return stages_.empty(); }
+
+private:
+  enum class StageType { FUSED, ROR, OTHER };
+
+  struct CropBox {
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+    bool remove_outside_points;
+  };
+
+  struct Stage {
+    StageType type{StageType::FUSED};
+
+    // FUSED: crop boxes, then an optional voxel filter
+    std::vector<CropBox> crop_boxes;
+    bool voxel{false};
+    Eigen::Vector3f voxel_size;
+    ParallelVoxelGrid<PointT> voxel_grid;
+
+    // ROR
+    double ror_radius{0};
+    int ror_min_neighbors{0};
+
+    // OTHER
+    std::vector<beam_filtering::FilterParamsType> other_params;
+  };
+
+  void ApplyStage(const Stage& stage, CloudType& cloud) const {
+    if (stage.type == StageType::FUSED) {
+      ApplyFused(stage, cloud);
+    } else if (stage.type == StageType::ROR) {
+      ApplyROR(stage, cloud);
+    } else if constexpr (SupportsPclFilters<PointT>::value) {
+      cloud = beam_filtering::FilterPointCloud<PointT>(cloud,
+                                                       stage.other_params);
+    }
+  }
+
+  static bool KeepPoint(const Stage& stage, const PointT& p) {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      return false;
+    }
+    for (const auto& box : stage.crop_boxes) {
+      const bool inside = p.x >= box.min.x() && p.x <= box.max.x() &&
+                          p.y >= box.min.y() && p.y <= box.max.y() &&
+                          p.z >= box.min.z() && p.z <= box.max.z();
+      if (inside != box.remove_outside_points) { return false; }
+    }
+    return true;
+  }
+
+  static uint64_t VoxelKey(const Stage& stage, const PointT& p) {
+    return scan_registration::VoxelKey(Eigen::Vector3f(p.x, p.y, p.z),
+                                       stage.voxel_size);
+  }
+
+  /**
+   * @brief run a fused stage from the input into the output, which can be the
+   * same cloud. Kept points are compacted to the front, which is safe in place
+   * since they are never written past the point being read.
+   */
+  static void ApplyFused(const Stage& stage, const CloudType& input,
+                         CloudType& output) {
+    if (stage.voxel && stage.voxel_grid.IsParallel(input.size())) {
+      stage.voxel_grid.Filter(input, output, [&stage](const PointT& p) {
+        return KeepPoint(stage, p);
+      });
+      return;
+    }
+
+    const bool in_place = &input == &output;
+    const size_t size = input.size();
+    if (!in_place) {
+      output.clear();
+      output.header = input.header;
+    }
+
+    std::unordered_map<uint64_t, size_t> voxels;
+    std::vector<Eigen::Vector3d> sums;
+    std::vector<int> counts;
+    if (stage.voxel) { voxels.reserve(size / 4); }
+
+    size_t num_kept = 0;
+    for (size_t i = 0; i < size; i++) {
+      const PointT p = input[i];
+      if (!KeepPoint(stage, p)) { continue; }
+      if (stage.voxel) {
+        const auto result = voxels.emplace(VoxelKey(stage, p), num_kept);
+        if (!result.second) {
+          const size_t index = result.first->second;
+          sums[index] += Eigen::Vector3d(p.x, p.y, p.z);
+          counts[index]++;
+          continue;
+        }
+        sums.emplace_back(p.x, p.y, p.z);
+        counts.push_back(1);
+      }
+      if (in_place) {
+        output[num_kept] = p;
+      } else {
+        output.push_back(p);
+      }
+      num_kept++;
+    }
+    if (in_place) { output.resize(num_kept); }
+
+    if (stage.voxel) {
+      for (size_t i = 0; i < num_kept; i++) {
+        const Eigen::Vector3d centroid = sums[i] / counts[i];
+        output[i].x = centroid.x();
+        output[i].y = centroid.y();
+        output[i].z = centroid.z();
+      }
+    }
+    output.width = output.size();
+    output.height = 1;
+    output.is_dense = true;
+  }
+
+  static void ApplyFused(const Stage& stage, CloudType& cloud) {
+    ApplyFused(stage, cloud, cloud);
+  }
+
+  /**
+   * @brief remove points with less than ror_min_neighbors within ror_radius,
+   * same as pcl::RadiusOutlierRemoval
+   */
+  static void ApplyROR(const Stage& stage, CloudType& cloud) {
+    if (cloud.empty()) { return; }
+
+    // search on positions only, the default point representation of other
+    // point types would also use fields like intensity in the distance
+    auto& pool = bs_common::CloudBufferPool<pcl::PointXYZ>::Get();
+    pcl::PointCloud<pcl::PointXYZ> positions;
+    pool.Acquire(positions, cloud.size());
+    positions.resize(cloud.size());
+    for (size_t i = 0; i < cloud.size(); i++) {
+      const PointT& p = cloud[i];
+      positions[i] = pcl::PointXYZ(p.x, p.y, p.z);
+    }
+    positions.is_dense = false;
+    const auto points = pool.Share(positions);
+    pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
+    kdtree.setInputCloud(points);
+
+    std::vector<uint8_t> keep(cloud.size(), 0);
+    std::vector<int> indices;
+    std::vector<float> distances;
+    for (size_t i = 0; i < cloud.size(); i++) {
+      const pcl::PointXYZ& p = points->at(i);
+      if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+        continue;
+      }
+      // the query point is included in the results
+      const int num_found =
+          kdtree.radiusSearch(p, stage.ror_radius, indices, distances,
+                              stage.ror_min_neighbors + 1);
+      keep[i] = num_found > stage.ror_min_neighbors;
+    }
+
+    size_t num_kept = 0;
+    for (size_t i = 0; i < cloud.size(); i++) {
+      if (keep[i]) { cloud[num_kept++] = cloud[i]; }
+    }
+    cloud.resize(num_kept);
+    cloud.width = cloud.size();
+    cloud.height = 1;
+  }
+
+  std::vector<Stage> stages_;
+};
+
+} // namespace bs_models
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <future>
 #include <list>
+#include <mutex>
 
 #include <fuse_core/fuse_macros.h>
 #include <fuse_graphs/hash_graph.h>
@@ -11,6 +15,8 @@
 #include <beam_utils/pointclouds.h>
 
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/thread_pool.h>
+#include <bs_models/lidar/filter_pipeline.h>
 #include <bs_models/lidar/scan_pose.h>
 #include <bs_models/scan_registration/scan_to_map_registration.h>
 
@@ -20,10 +26,25 @@ using LidarTransactionType = bs_constraints::Pose3DStampedTransaction;
 
 class LidarPathInit {
 public:
+  /**
+   * @brief constructor
+   * @param lidar_buffer_size max number of keyframes to keep
+   * @param matcher_config loam matcher config, leave empty to use the default
+   * @param information_weight weight of the registration constraints
+   * @param num_threads if greater than 1, incoming scans are filtered and their
+   * features are extracted on this many threads, while the scans before them
+   * are registered. Registration itself stays sequential since each scan is
+   * registered against the map built from all previous scans
+   */
   explicit LidarPathInit(int lidar_buffer_size,
                          const std::string& matcher_config,
-                         double information_weight);
+                         double information_weight, int num_threads = 1);
 
+  /**
+   * @brief add a scan. If preparing scans in parallel, this registers all
+   * prepared scans that are ready (in order), so registration lags behind the
+   * incoming scans by up to num_threads scans
+   */
   void ProcessLidar(const sensor_msgs::PointCloud2::ConstPtr& msg);
 
   /**
@@ -94,6 +115,51 @@ public:
 private:
   struct Results {};
 
+  /**
+   * @brief filtered cloud and features of a scan, ready to be registered
+   */
+  struct ScanData {
+    ros::Time stamp;
+    PointCloud cloud;
+    beam_matching::LoamPointCloud loam_cloud;
+  };
+
+  /**
+   * @brief scan being prepared on the thread pool
+   */
+  struct PendingScan {
+    std::shared_ptr<ScanData> scan;
+    std::future<void> ready;
+  };
+
+  /**
+   * @brief filter a scan and extract its features. This does not depend on
+   * the registration state so it can be run concurrently
+   */
+  ScanData PrepareScan(const sensor_msgs::PointCloud2::ConstPtr& msg);
+
+  /**
+   * @brief register a prepared scan and add it to the keyframes
+   */
+  void RegisterScan(ScanData& scan);
+
+  /**
+   * @brief register pending scans in order until the oldest is not ready and
+   * at most max_pending are left
+   */
+  void RegisterPendingScans(size_t max_pending);
+
+  /**
+   * @brief get a feature extractor that is not used by another thread, this
+   * must be returned with ReleaseFeatureExtractor
+   */
+  std::shared_ptr<beam_matching::LoamFeatureExtractor>
+      AcquireFeatureExtractor();
+
+  void ReleaseFeatureExtractor(
+      const std::shared_ptr<beam_matching::LoamFeatureExtractor>&
+          feature_extractor);
+
   bool InitExtrinsics(const ros::Time& stamp);
 
   Eigen::Matrix4d Get_T_WORLD_BASELINKEST(const ros::Time& stamp);
@@ -101,8 +167,17 @@ private:
   // scan registration objects
   std::unique_ptr<scan_registration::ScanToMapLoamRegistration>
       scan_registration_;
-  std::shared_ptr<beam_matching::LoamFeatureExtractor> feature_extractor_;
-  std::vector<beam_filtering::FilterParamsType> input_filter_params_;
+  std::shared_ptr<beam_matching::LoamParams> matcher_params_;
+  FilterPipeline<pcl::PointXYZ> input_filters_;
+
+  // feature extractors not currently used by a scan being prepared
+  std::vector<std::shared_ptr<beam_matching::LoamFeatureExtractor>>
+      feature_extractors_;
+  std::mutex feature_extractors_mutex_;
+
+  // only used if preparing scans in parallel
+  std::unique_ptr<bs_common::ThreadPool> prepare_pool_;
+  std::deque<PendingScan> pending_scans_;
 
   // store all current keyframes to be processed. Data in scan poses have
   // already been converted to the baselink frame, and T_BASELINK_LIDAR is set
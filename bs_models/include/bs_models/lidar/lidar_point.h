@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include <pcl/point_cloud.h>
+
+namespace bs_models {
+
+/**
+ * @brief Lean point used by the lidar front end after deskewing, in place of
+ * the driver point types (e.g., PointXYZIRT and PointXYZITRRNR, which take 32
+ * and 48 bytes). Registration and feature extraction only need the position
+ * and the ring, so this keeps a float32 position plus a 16 bit ring and a 16
+ * bit intensity in 16 bytes, which halves the memory read by each pass of
+ * the filters, the range image and the feature extraction.
+ *
+ * This is not a registered pcl point type and it has no padding for SSE, so
+ * it can only be used with the code of this package that accesses the fields
+ * directly (FilterPipeline without beam_filtering stages, RangeImage and
+ * RingFeatureExtractor). All other fields of the scan (e.g., the time and
+ * reflectivity) stay in the deskewed cloud published by the
+ * LidarScanDeskewer, for consumers that need them.
+ */
+struct LidarPoint {
+  float x;
+  float y;
+  float z;
+  uint16_t ring;
+  uint16_t intensity;
+};
+
+static_assert(sizeof(LidarPoint) == 16, "LidarPoint must stay 16 bytes");
+
+/**
+ * @brief project a driver cloud to lean points, the intensity is clamped to
+ * 16 bits
+ * @param input cloud with a ring and an intensity field
+ * @param output lean cloud, its storage is reused
+ */
+template <typename PointT>
+void ToLidarPoints(const pcl::PointCloud<PointT>& input,
+                   pcl::PointCloud<LidarPoint>& output) {
+  output.header = input.header;
+  output.points.resize(input.size());
+  for (size_t i = 0; i < input.size(); i++) {
+    const PointT& p = input[i];
+    LidarPoint& q = output.points[i];
+    q.x = p.x;
+    q.y = p.y;
+    q.z = p.z;
+    q.ring = static_cast<uint16_t>(p.ring);
+    // negative and non finite intensities are 0
+    const float intensity = static_cast<float>(p.intensity);
+    q.intensity = intensity > 0
+                      ? static_cast<uint16_t>(std::min(intensity, 65535.0f))
+                      : 0;
+  }
+  output.width = input.width;
+  output.height = input.height;
+  output.is_dense = input.is_dense;
+}
+
+} // namespace bs_models
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <beam_matching/loam/LoamPointCloud.h>
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models {
+
+/**
+ * @brief Caps the number of strong LOAM features of a scan, so the cost of
+ * registering it does not depend on how many features the environment yields.
+ *
+ * The features of each class are split into azimuth buckets around the lidar
+ * and the budget is shared between the buckets: buckets with less features
+ * than their share keep all of them and their unused share goes to the other
+ * buckets, so the selected features are spread around the scan instead of
+ * coming from the most cluttered direction. Within a bucket the most
+ * informative features are kept, which are scored by their range: the
+ * displacement of a point under a rotation grows with its range, so far
+ * features constrain the orientation more than the many close ones. Ranges
+ * beyond max_informative_range_m are scored the same, since far points are
+ * sparse and noisy.
+ *
+ * Weak features are kept, they are only used as the map side of the matches.
+ * Selected features keep their input order.
+ */
+class LoamFeatureBudget {
+public:
+  struct Params {
+    /** max strong edges kept, 0 for no limit */
+    int max_edges{0};
+
+    /** max strong surfaces kept, 0 for no limit */
+    int max_surfaces{0};
+
+    /** number of azimuth buckets the budget is shared between */
+    int num_buckets{36};
+
+    double max_informative_range_m{30};
+  };
+
+  explicit LoamFeatureBudget(const Params& params);
+
+  /**
+   * @brief whether a budget is set for any class
+   */
+  bool Enabled() const {
+    return params_.max_edges > 0 || params_.max_surfaces > 0;
+  }
+
+  /**
+   * @brief cap the strong edges and surfaces of a scan (in the lidar frame)
+   */
+  void Apply(beam_matching::LoamPointCloud& features) const;
+
+  /**
+   * @brief select up to budget points of a cloud (in the lidar frame) as
+   * described above
+   */
+  PointCloud Select(const PointCloud& cloud, size_t budget) const;
+
+private:
+  Params params_;
+};
+
+} // namespace bs_models
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+
+#include <bs_common/task_scheduler.h>
+#include <bs_models/scan_registration/voxel_key.h>
+
+namespace bs_models {
+
+/**
+ * @brief Voxel grid filter which splits the work over the workers of the
+ * bs_common::TaskScheduler. Points are first assigned to partitions by a hash
+ * of their voxel key in contiguous chunks of the input, then each partition
+ * accumulates its voxels independently, so no voxel is shared between
+ * threads.
+ *
+ * The output is the same as the voxel filter of FilterPipeline, regardless of
+ * the number of partitions: one point per voxel at the centroid of its
+ * points, with all other fields taken from the first point in the voxel, and
+ * points in the order they were first seen. Non-finite points are removed.
+ * Clouds smaller than min_points_per_partition are filtered on the calling
+ * thread only.
+ */
+template <typename PointT>
+class ParallelVoxelGrid {
+public:
+  using CloudType = pcl::PointCloud<PointT>;
+
+  struct Params {
+    /** voxel side lengths in meters */
+    Eigen::Vector3f voxel_size{0.1, 0.1, 0.1};
+
+    /** the cloud is split in fewer partitions if they would get less points
+     * than this, since small clouds are faster to filter on one thread */
+    size_t min_points_per_partition{50000};
+
+    /** max number of partitions, if 0 one per worker plus one for the calling
+     * thread */
+    size_t max_partitions{0};
+
+    /** priority of the tasks, background work such as global mapping should
+     * not delay real-time work */
+    bs_common::TaskPriority priority{bs_common::TaskPriority::REALTIME};
+  };
+
+  ParallelVoxelGrid() = default;
+
+  explicit ParallelVoxelGrid(const Params& params) : params_(params) {}
+
+  /**
+   * @brief constructor with the default params and a cubic voxel size
+   */
+  explicit ParallelVoxelGrid(float voxel_size) {
+    params_.voxel_size = Eigen::Vector3f(voxel_size, voxel_size, voxel_size);
+  }
+
+  const Params& GetParams() const { return params_; }
+
+  void SetParams(const Params& params) { params_ = params; }
+
+  /**
+   * @brief check if a cloud of this size is split over multiple threads
+   */
+  bool IsParallel(size_t num_points) const {
+    return NumPartitions(num_points) > 1;
+  }
+
+  /**
+   * @brief filter a cloud, only keeping the points for which keep(point) is
+   * true before downsampling
+   * @param input input cloud
+   * @param output filtered cloud, this can be the same as the input
+   * @param keep predicate taking a const PointT&, it is called concurrently
+   */
+  template <typename Predicate>
+  void Filter(const CloudType& input, CloudType& output,
+              const Predicate& keep) const {
+    if (input.size() > std::numeric_limits<uint32_t>::max()) {
+      throw std::invalid_argument{"cloud too large for ParallelVoxelGrid"};
+    }
+    if (&input == &output) {
+      CloudType filtered;
+      Filter(input, filtered, keep);
+      output = std::move(filtered);
+      return;
+    }
+
+    const size_t num_partitions = NumPartitions(input.size());
+    std::vector<Partition> partitions(num_partitions);
+    if (num_partitions == 1) {
+      Partition& partition = partitions.front();
+      partition.voxels.reserve(input.size() / 4);
+      for (size_t i = 0; i < input.size(); i++) {
+        const PointT& p = input[i];
+        if (IsFinite(p) && keep(p)) { Accumulate(input, i, partition); }
+      }
+    } else {
+      // indices of the points of each chunk of the input, by partition
+      std::vector<std::vector<std::vector<uint32_t>>> chunks(
+          num_partitions,
+          std::vector<std::vector<uint32_t>>(num_partitions));
+      const size_t chunk_size =
+          (input.size() + num_partitions - 1) / num_partitions;
+      auto& scheduler = bs_common::TaskScheduler::GetInstance();
+      scheduler.ParallelFor(
+          params_.priority, num_partitions,
+          [&](size_t c) {
+            const size_t end = std::min(input.size(), (c + 1) * chunk_size);
+            for (size_t i = c * chunk_size; i < end; i++) {
+              const PointT& p = input[i];
+              if (!IsFinite(p) || !keep(p)) { continue; }
+              chunks[c][Hash(VoxelKey(p)) % num_partitions].push_back(i);
+            }
+          },
+          num_partitions);
+
+      // chunks are visited in order, so voxels of each partition are found
+      // in input order
+      scheduler.ParallelFor(
+          params_.priority, num_partitions,
+          [&](size_t p) {
+            Partition& partition = partitions[p];
+            size_t num_points = 0;
+            for (const auto& chunk : chunks) { num_points += chunk[p].size(); }
+            partition.voxels.reserve(num_points / 4);
+            for (const auto& chunk : chunks) {
+              for (const uint32_t i : chunk[p]) {
+                Accumulate(input, i, partition);
+              }
+            }
+          },
+          num_partitions);
+    }
+
+    Merge(input, partitions, output);
+  }
+
+  /**
+   * @brief filter a cloud
+   * @param input input cloud
+   * @param output filtered cloud, this can be the same as the input
+   */
+  void Filter(const CloudType& input, CloudType& output) const {
+    Filter(input, output, [](const PointT&) { return true; });
+  }
+
+  /**
+   * @brief filter a cloud
+   * @return filtered cloud
+   */
+  CloudType Filter(const CloudType& input) const {
+    CloudType output;
+    Filter(input, output);
+    return output;
+  }
+
+private:
+  struct Partition {
+    std::unordered_map<uint64_t, uint32_t> voxels; // <key, voxel>
+    std::vector<uint32_t> first_points;            // input index of each voxel
+    std::vector<Eigen::Vector3d> sums;
+    std::vector<int> counts;
+  };
+
+  static bool IsFinite(const PointT& p) {
+    return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+  }
+
+  size_t NumPartitions(size_t num_points) const {
+    size_t max_partitions = params_.max_partitions;
+    if (max_partitions == 0) {
+      max_partitions =
+          bs_common::TaskScheduler::GetInstance().NumThreads() + 1;
+    }
+    const size_t min_points =
+        std::max<size_t>(params_.min_points_per_partition, 1);
+    return std::max<size_t>(std::min(max_partitions, num_points / min_points),
+                            1);
+  }
+
+  uint64_t VoxelKey(const PointT& p) const {
+    return scan_registration::VoxelKey(Eigen::Vector3f(p.x, p.y, p.z),
+                                       params_.voxel_size);
+  }
+
+  /**
+   * @brief mixes the bits of a key (splitmix64 finalizer), since neighbouring
+   * voxels only differ in a few bits of their keys
+   */
+  static uint64_t Hash(uint64_t key) {
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+  }
+
+  void Accumulate(const CloudType& input, size_t i,
+                  Partition& partition) const {
+    const PointT& p = input[i];
+    const auto result = partition.voxels.emplace(
+        VoxelKey(p), static_cast<uint32_t>(partition.first_points.size()));
+    if (!result.second) {
+      const uint32_t voxel = result.first->second;
+      partition.sums[voxel] += Eigen::Vector3d(p.x, p.y, p.z);
+      partition.counts[voxel]++;
+      return;
+    }
+    partition.first_points.push_back(static_cast<uint32_t>(i));
+    partition.sums.emplace_back(p.x, p.y, p.z);
+    partition.counts.push_back(1);
+  }
+
+  /**
+   * @brief merge the voxels of all partitions in the order of their first
+   * points, which are sorted within each partition
+   */
+  static void Merge(const CloudType& input,
+                    const std::vector<Partition>& partitions,
+                    CloudType& output) {
+    size_t num_voxels = 0;
+    for (const Partition& partition : partitions) {
+      num_voxels += partition.first_points.size();
+    }
+    output.clear();
+    output.header = input.header;
+    output.reserve(num_voxels);
+    std::vector<size_t> next(partitions.size(), 0);
+    for (size_t n = 0; n < num_voxels; n++) {
+      size_t best = partitions.size();
+      uint32_t best_point = std::numeric_limits<uint32_t>::max();
+      for (size_t p = 0; p < partitions.size(); p++) {
+        const Partition& partition = partitions[p];
+        if (next[p] < partition.first_points.size() &&
+            partition.first_points[next[p]] <= best_point) {
+          best = p;
+          best_point = partition.first_points[next[p]];
+        }
+      }
+      const Partition& partition = partitions[best];
+      const size_t voxel = next[best]++;
+      const Eigen::Vector3d centroid =
+          partition.sums[voxel] / partition.counts[voxel];
+      PointT point = input[best_point];
+      point.x = centroid.x();
+      point.y = centroid.y();
+      point.z = centroid.z();
+      output.push_back(point);
+    }
+    output.width = output.size();
+    output.height = 1;
+    output.is_dense = true;
+  }
+
+  Params params_;
+};
+
+} // namespace bs_models
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models {
+
+/**
+ * @brief Per point covariances and normals of a cloud, as used by
+ * Generalized-ICP (Segal et al., 2009). The covariance of each point is the
+ * covariance of its k nearest neighbours with its eigenvalues replaced by
+ * (epsilon, 1, 1), which models the point as a sample of a plane, and its
+ * normal is the eigenvector of the smallest eigenvalue. Points with less than
+ * 3 finite neighbours get an identity covariance and a zero normal.
+ *
+ * Covariances and normals are stored in the frame of the cloud and in the
+ * order of its points, so they are only valid for the cloud they were
+ * computed from.
+ */
+struct PointCovariances {
+  /** number of neighbours used for each point */
+  int k{0};
+
+  std::vector<Eigen::Matrix3f, Eigen::aligned_allocator<Eigen::Matrix3f>>
+      covariances;
+
+  std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f>>
+      normals;
+
+  size_t Size() const { return covariances.size(); }
+
+  size_t MemoryUsage() const {
+    return covariances.size() * sizeof(Eigen::Matrix3f) +
+           normals.size() * sizeof(Eigen::Vector3f);
+  }
+};
+
+/**
+ * @brief compute the covariances and normals of all points of a cloud
+ * @param cloud input cloud
+ * @param k number of nearest neighbours (including the point itself)
+ * @param epsilon smallest eigenvalue of the regularized covariances
+ * @param covariances output, replaced
+ */
+void ComputePointCovariances(const PointCloud& cloud, int k,
+                             PointCovariances& covariances,
+                             float epsilon = 1e-3);
+
+/**
+ * @brief compute the covariances and normals of all points of a cloud from
+ * neighbours found elsewhere, e.g. on the GPU
+ * @param cloud input cloud
+ * @param neighbours indices of the k nearest neighbours of each point, in the
+ * order of the points (size k * cloud.size()), missing neighbours are -1 and
+ * last
+ * @param k number of nearest neighbours (including the point itself)
+ * @param epsilon smallest eigenvalue of the regularized covariances
+ * @param covariances output, replaced
+ */
+void ComputePointCovariances(const PointCloud& cloud,
+                             const std::vector<int>& neighbours, int k,
+                             PointCovariances& covariances,
+                             float epsilon = 1e-3);
+
+/**
+ * @brief save covariances to a binary file, see LoadPointCovariances
+ * @return false if the file cannot be written
+ */
+bool SavePointCovariances(const std::string& filename,
+                          const PointCovariances& covariances);
+
+/**
+ * @brief load covariances saved with SavePointCovariances
+ * @return false if the file cannot be read or is invalid
+ */
+bool LoadPointCovariances(const std::string& filename,
+                          PointCovariances& covariances);
+
+} // namespace bs_models
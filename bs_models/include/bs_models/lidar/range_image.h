@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+
+namespace bs_models {
+
+/**
+ * @brief true for point types with a time field
+ */
+template <typename PointT, typename = void>
+struct HasTimeField : std::false_type {};
+
+template <typename PointT>
+struct HasTimeField<PointT, std::void_t<decltype(std::declval<PointT>().time)>>
+    : std::true_type {};
+
+/**
+ * @brief Organized representation of a spinning lidar scan: one row per ring
+ * and one column per azimuth bin, so the neighbours of a point in the scan
+ * (same ring or adjacent rings) are found in O(1) instead of with a kd-tree.
+ *
+ * Fields are stored as structure of arrays in row major order, so loops over
+ * a ring or over the whole image read contiguous floats. Cells without a
+ * point are invalid. Each valid cell keeps the index of its point in the
+ * source cloud, so results computed on the image can be mapped back to the
+ * cloud and its other fields.
+ *
+ * Images are filled from clouds with a ring and an intensity field (e.g.,
+ * PointXYZIRT, PointXYZITRRNR and LidarPoint), the time of points without a
+ * time field is 0. The column of a point is its azimuth bin, with column 0 at
+ * azimuth -pi, and if two points of a ring fall in the same cell the closest
+ * one is kept. The memory is kept between fills.
+ */
+class RangeImage {
+public:
+  static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+  RangeImage() = default;
+
+  /**
+   * @brief constructor
+   * @param num_rings number of rows
+   * @param num_columns number of azimuth bins per row
+   */
+  RangeImage(size_t num_rings, size_t num_columns);
+
+  /**
+   * @brief resize the image and mark all cells invalid
+   */
+  void Reset(size_t num_rings, size_t num_columns);
+
+  /**
+   * @brief fill the image from a cloud with a ring field. The image is resized
+   * to the rings of the cloud, keeping its number of columns. Non finite
+   * points are skipped
+   */
+  template <typename PointT>
+  void Fill(const pcl::PointCloud<PointT>& cloud) {
+    size_t num_rings{0};
+    for (const auto& p : cloud) {
+      num_rings = std::max(num_rings, static_cast<size_t>(p.ring) + 1);
+    }
+    Reset(num_rings, num_columns_);
+    for (size_t i = 0; i < cloud.size(); i++) {
+      const PointT& p = cloud[i];
+      if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+        continue;
+      }
+      float time{0};
+      if constexpr (HasTimeField<PointT>::value) {
+        time = static_cast<float>(p.time);
+      }
+      Set(p.ring, ColumnOf(p.x, p.y), i, p.x, p.y, p.z, p.intensity, time);
+    }
+  }
+
+  /**
+   * @brief create an image from a cloud with a ring field
+   * @param cloud cloud with a ring field
+   * @param num_columns number of azimuth bins per row
+   */
+  template <typename PointT>
+  static RangeImage FromCloud(const pcl::PointCloud<PointT>& cloud,
+                              size_t num_columns) {
+    RangeImage image(0, num_columns);
+    image.Fill(cloud);
+    return image;
+  }
+
+  /**
+   * @brief column of the azimuth of a point
+   */
+  size_t ColumnOf(float x, float y) const;
+
+  size_t NumRings() const { return num_rings_; }
+
+  size_t NumColumns() const { return num_columns_; }
+
+  /**
+   * @brief number of valid cells
+   */
+  size_t NumValid() const { return num_valid_; }
+
+  /**
+   * @brief index of a cell in the field arrays, the column wraps around
+   */
+  size_t Index(size_t ring, int column) const {
+    const int n = static_cast<int>(num_columns_);
+    return ring * num_columns_ + static_cast<size_t>(((column % n) + n) % n);
+  }
+
+  bool Valid(size_t index) const { return source_[index] != INVALID; }
+
+  /**
+   * @brief index of the point of a cell in the source cloud, INVALID if the
+   * cell is empty
+   */
+  uint32_t SourceIndex(size_t index) const { return source_[index]; }
+
+  float X(size_t index) const { return x_[index]; }
+
+  float Y(size_t index) const { return y_[index]; }
+
+  float Z(size_t index) const { return z_[index]; }
+
+  float Range(size_t index) const { return range_[index]; }
+
+  float Intensity(size_t index) const { return intensity_[index]; }
+
+  float Time(size_t index) const { return time_[index]; }
+
+  /**
+   * @brief contiguous fields, NumRings() * NumColumns() values each
+   */
+  const float* XData() const { return x_.data(); }
+
+  const float* YData() const { return y_.data(); }
+
+  const float* ZData() const { return z_.data(); }
+
+  const float* RangeData() const { return range_.data(); }
+
+  const float* TimeData() const { return time_.data(); }
+
+  /**
+   * @brief calls f(index) for each valid cell within ring_radius rings and
+   * column_radius columns of a cell, excluding the cell itself
+   */
+  template <typename F>
+  void ForEachNeighbour(size_t ring, int column, size_t ring_radius,
+                        int column_radius, F f) const {
+    const size_t first_ring = ring > ring_radius ? ring - ring_radius : 0;
+    const size_t last_ring = std::min(ring + ring_radius, num_rings_ - 1);
+    for (size_t r = first_ring; r <= last_ring; r++) {
+      for (int c = column - column_radius; c <= column + column_radius; c++) {
+        if (r == ring && c == column) { continue; }
+        const size_t index = Index(r, c);
+        if (Valid(index)) { f(index); }
+      }
+    }
+  }
+
+private:
+  void Set(size_t ring, size_t column, size_t source_index, float x, float y,
+           float z, float intensity, float time);
+
+  size_t num_rings_{0};
+  size_t num_columns_{0};
+  size_t num_valid_{0};
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<float> range_;
+  std::vector<float> intensity_;
+  std::vector<float> time_;
+  std::vector<uint32_t> source_;
+};
+
+} // namespace bs_models
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+
+#include <beam_matching/loam/LoamParams.h>
+#include <beam_matching/loam/LoamPointCloud.h>
+#include <beam_utils/pointclouds.h>
+
+#include <bs_common/task_scheduler.h>
+#include <bs_models/lidar/range_image.h>
+
+namespace bs_models {
+
+/**
+ * @brief LOAM feature extractor which processes the rings of a scan in
+ * parallel. This implements the same classification as
+ * beam_matching::LoamFeatureExtractor (curvature over a neighbourhood of
+ * curvature_region points, n_feature_regions regions per ring, strong/weak
+ * edges and surfaces) and uses the same LoamParams.
+ *
+ * The points of each ring are first copied into contiguous x, y and z arrays.
+ * Rings are independent, so they are split over real-time tasks of the shared
+ * task scheduler and their features are merged in ring order once all are
+ * done, which makes the output independent of the number of threads. The
+ * curvature of a ring is computed with a sliding window sum, so the cost per
+ * point does not depend on curvature_region.
+ *
+ * Only clouds with a ring field are supported (e.g., PointXYZIRT and
+ * PointXYZITRRNR). The points of each ring must be in scan order, which is the
+ * case for the driver outputs. Features can also be extracted from a
+ * RangeImage, whose rows are rings in azimuth order, which skips the copy
+ * into rings when the scan is already organized.
+ */
+class RingFeatureExtractor {
+public:
+  /**
+   * @brief constructor
+   * @param params loam params, the feature extraction params are the same as
+   * for the beam_matching::LoamFeatureExtractor
+   * @param num_threads max number of tasks to split the rings over
+   */
+  RingFeatureExtractor(
+      const std::shared_ptr<beam_matching::LoamParams>& params,
+      int num_threads);
+
+  /**
+   * @brief extract loam features from a cloud with a ring field
+   */
+  template <typename PointT>
+  beam_matching::LoamPointCloud
+      ExtractFeatures(const pcl::PointCloud<PointT>& cloud) {
+    uint16_t max_ring{0};
+    for (const auto& p : cloud) { max_ring = std::max(max_ring, p.ring); }
+    if (rings_.size() < max_ring + 1) { rings_.resize(max_ring + 1); }
+    for (auto& ring : rings_) { ring.Clear(); }
+    for (const auto& p : cloud) {
+      if (!pcl::isFinite(p)) { continue; }
+      rings_[p.ring].Add(p.x, p.y, p.z);
+    }
+    return ExtractFeaturesFromRings(max_ring + 1);
+  }
+
+  /**
+   * @brief extract loam features from the valid cells of a range image, each
+   * row is a ring
+   */
+  beam_matching::LoamPointCloud ExtractFeatures(const RangeImage& image);
+
+private:
+  /**
+   * @brief points and working buffers of one ring. These are kept between
+   * scans to avoid reallocating them.
+   */
+  struct Ring {
+    void Clear();
+
+    void Add(float px, float py, float pz);
+
+    size_t Size() const { return x.size(); }
+
+    pcl::PointXYZ Point(size_t i) const {
+      return pcl::PointXYZ(x[i], y[i], z[i]);
+    }
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<double> prefix_x;
+    std::vector<double> prefix_y;
+    std::vector<double> prefix_z;
+    std::vector<float> curvature;
+    std::vector<uint8_t> picked;
+    std::vector<uint8_t> is_edge;
+    std::vector<size_t> region_indices;
+
+    PointCloud edges_strong;
+    PointCloud edges_weak;
+    PointCloud surfaces_strong;
+    PointCloud surfaces_weak;
+  };
+
+  beam_matching::LoamPointCloud ExtractFeaturesFromRings(size_t num_rings);
+
+  void ExtractRingFeatures(Ring& ring) const;
+
+  /**
+   * @brief mark points which are unreliable (occluded or on surfaces parallel
+   * to the beam) as picked so they are never selected as features
+   */
+  void MarkUnreliablePoints(Ring& ring) const;
+
+  /**
+   * @brief mark a point and its neighbours as picked, unless there is a jump
+   * between them
+   */
+  void MarkAsPicked(Ring& ring, size_t i) const;
+
+  std::shared_ptr<beam_matching::LoamParams> params_;
+  int num_threads_;
+  std::vector<Ring> rings_;
+};
+
+} // namespace bs_models
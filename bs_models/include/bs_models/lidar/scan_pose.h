@@ -7,6 +7,11 @@
 #include <beam_matching/loam/LoamFeatureExtractor.h>
 #include <beam_utils/pointclouds.h>
 
+#include <bs_common/chunk_file.h>
+#include <bs_common/graph_view.h>
+
+#include <bs_models/lidar/point_covariances.h>
+
 namespace bs_models {
 
 /**
@@ -17,6 +22,20 @@ namespace bs_models {
  * allows us to use these measurements for extrinsic calibration. The poses are
  * stored in the baselink frame to make SLAM easier with fuse. All post
  * variables in the graph will always be relative to the baselink
+ *
+ * Clouds are held through shared handles to immutable data, so copying a
+ * ScanPose (e.g., to store it in a map or a list of reference scans) does not
+ * copy any points, and the clouds can be read from any thread. Adding points
+ * to a cloud replaces its handle with a new cloud, other copies of the
+ * ScanPose keep the old one.
+ *
+ * For long term storage the clouds can be compressed with CompressClouds(),
+ * which quantizes each cloud to 16 bits per coordinate over its bounding box
+ * in the lidar frame. The compressed clouds are decoded when they are read,
+ * see Cloud() and CloudPtr().
+ *
+ * The GICP covariances and normals of the regular cloud can be computed once
+ * and kept with the scan, see Covariances(). They are saved by SaveData.
  */
 class ScanPose {
 public:
@@ -40,6 +59,17 @@ public:
       const std::shared_ptr<beam_matching::LoamFeatureExtractor>&
           feature_extractor = nullptr);
 
+  /**
+   * @brief same as above, but takes ownership of the cloud instead of copying
+   * it
+   */
+  ScanPose(
+      PointCloud&& cloud, const ros::Time& stamp,
+      const Eigen::Matrix4d& T_REFFRAME_BASELINK,
+      const Eigen::Matrix4d& T_BASELINK_LIDAR = Eigen::Matrix4d::Identity(),
+      const std::shared_ptr<beam_matching::LoamFeatureExtractor>&
+          feature_extractor = nullptr);
+
   /**
    * @brief constructor for when inputting a PointXYZIRT pointcloud
    * (velodyne pointcloud)
@@ -105,6 +135,20 @@ public:
    */
   void AddPointCloud(const PointCloud& cloud, bool override_cloud = false);
 
+  /**
+   * @brief same as above, but takes the storage of the cloud instead of
+   * copying it when overriding. The storage goes back to the
+   * bs_common::CloudBufferPool once no copy of this scan pose uses the cloud
+   */
+  void AddPointCloud(PointCloud&& cloud, bool override_cloud = false);
+
+  /**
+   * @brief same as above, but shares the cloud instead of copying it when
+   * overriding. The cloud must not be modified anymore by the caller
+   */
+  void AddPointCloud(const std::shared_ptr<const PointCloud>& cloud,
+                     bool override_cloud = false);
+
   /**
    * @brief add loam pointcloud
    * @param cloud input pointcloud of type LoamPointCloud, where points are
@@ -116,13 +160,30 @@ public:
                      bool override_cloud = false);
 
   /**
-   * @brief update the pose of this ScanPose given some graph message
+   * @brief same as above, but takes ownership of the cloud instead of copying
+   * it when overriding
+   */
+  void AddPointCloud(beam_matching::LoamPointCloud&& cloud,
+                     bool override_cloud = false);
+
+  /**
+   * @brief update the pose of this ScanPose given some graph message. If the
+   * graph message is a bs_common::GraphSnapshot, the pose variables are only
+   * copied if the delta says they changed.
    * @param graph_msg results from some optimizer which should contain the same
    * pose variable uuids that are stored herein
    * @return true update was successful (i.e., uuids were in the graph message)
    */
   bool UpdatePose(const fuse_core::Graph::ConstSharedPtr& graph_msg);
 
+  /**
+   * @brief update the pose of this ScanPose given a view of some graph
+   * message. Use this when updating many scan poses from the same graph.
+   * @param graph_view view of the results from some optimizer
+   * @return true update was successful (i.e., stamp was in the graph view)
+   */
+  bool UpdatePose(const bs_common::GraphView& graph_view);
+
   /**
    * @brief update the pose of this ScanPose given a transformation matrix
    * @param T_REFFRAME_BASELINK transformation from the lidar frame to
@@ -217,15 +278,76 @@ public:
   Eigen::Matrix4d T_LIDAR_BASELINK() const;
 
   /**
-   * @brief return regular cloud (not loam)
+   * @brief return regular cloud (not loam). If the clouds are compressed, the
+   * decoded cloud is kept until ReleaseDecodedClouds() is called
    * @return cloud, where points are expressed in the lidar frame
    */
-  PointCloud Cloud() const;
+  const PointCloud& Cloud() const;
+
+  /**
+   * @brief return a shared handle to the regular cloud, which stays valid
+   * after this ScanPose is destroyed or its cloud is replaced. If the clouds
+   * are compressed and not decoded yet, the cloud is decoded into a new handle
+   * which is not kept by this ScanPose
+   */
+  std::shared_ptr<const PointCloud> CloudPtr() const;
+
   /**
-   * @brief return loam pointcloud
+   * @brief return loam pointcloud. If the clouds are compressed, the decoded
+   * cloud is kept until ReleaseDecodedClouds() is called
    * @return cloud, where points are expressed in the lidar frame
    */
-  beam_matching::LoamPointCloud LoamCloud() const;
+  const beam_matching::LoamPointCloud& LoamCloud() const;
+
+  /**
+   * @brief return a shared handle to the loam cloud, which stays valid after
+   * this ScanPose is destroyed or its cloud is replaced. Compressed clouds are
+   * decoded the same way as in CloudPtr()
+   */
+  std::shared_ptr<const beam_matching::LoamPointCloud> LoamCloudPtr() const;
+
+  /**
+   * @brief return the GICP covariances and normals of the regular cloud (in
+   * the lidar frame, in the order of the points of CloudPtr()). They are
+   * computed on the first call and kept until the cloud is replaced, so
+   * matchers of the same scan can share them. Safe to call from multiple
+   * threads
+   * @param k number of nearest neighbours, if it differs from the kept
+   * covariances they are computed again
+   */
+  std::shared_ptr<const PointCovariances> Covariances(int k = 20) const;
+
+  /**
+   * @brief whether covariances are kept for the current regular cloud
+   */
+  bool HasCovariances() const;
+
+  /**
+   * @brief compress the regular and loam clouds by quantizing the coordinates
+   * of each cloud to 16 bits over its bounding box, which bounds the error of
+   * each coordinate to half the extent of the box divided by 65535. Non finite
+   * points are dropped. Adding points to a compressed cloud decompresses both
+   * clouds first. Other copies of this ScanPose keep their clouds
+   */
+  void CompressClouds();
+
+  /**
+   * @brief whether the clouds are stored compressed
+   */
+  bool IsCompressed() const { return compressed_clouds_ != nullptr; }
+
+  /**
+   * @brief drop the decoded copies of the compressed clouds kept by Cloud()
+   * and LoamCloud(). References returned by them must not be used after this
+   */
+  void ReleaseDecodedClouds();
+
+  /**
+   * @brief get the memory used by the clouds of this ScanPose, including the
+   * decoded copies of compressed clouds and the kept covariances. Shared clouds
+   * are counted in full
+   */
+  size_t CloudMemoryUsage() const;
 
   /**
    * @brief return timestamp associated with this scanpose
@@ -256,9 +378,10 @@ public:
    * @param save_path full path to output directory. This directory must exist
    * @param to_reference_frame whether or not to confert to REFFRAME
    * @param add_frame whether or not to add coordinate frame to cloud
+   * @param compress whether or not to save as compressed binary PCD files
    */
   void SaveCloud(const std::string& save_path, bool to_reference_frame = true,
-                 bool add_frame = true) const;
+                 bool add_frame = true, bool compress = false) const;
 
   /**
    * @brief save loam pointcloud of current scanpose
@@ -281,6 +404,7 @@ public:
    *    loam_edges_weak.pcd
    *    loam_surfaces_strong.pcd
    *    loam_surfaces_weak.pcd
+   *    point_covariances.bin (only if covariances are kept, see Covariances())
    *
    *
    * @param output_dir full path to empty directory. This path must exist, but
@@ -297,7 +421,86 @@ public:
    */
   bool LoadData(const std::string& root_dir);
 
+  /**
+   * @brief write the same data as SaveData to a binary buffer, used by the
+   * global map store (see global_mapping/map_store.h)
+   * @param writer buffer to append to
+   */
+  void Serialize(bs_common::ByteWriter& writer) const;
+
+  /**
+   * @brief read data written by Serialize
+   * @param reader buffer to read from
+   * @param load_clouds if false, only the pose data is read and the clouds are
+   * left empty, they can be read later with LoadClouds
+   * @return true if successful
+   */
+  bool Deserialize(bs_common::ByteReader& reader, bool load_clouds = true);
+
+  /**
+   * @brief read only the clouds of data written by Serialize, keeping the
+   * current pose data
+   * @param reader buffer to read from
+   * @return false if the data is invalid or of a scan with another stamp
+   */
+  bool LoadClouds(bs_common::ByteReader& reader);
+
+  /**
+   * @brief drop the clouds of this scan pose, other copies keep theirs. The
+   * cloud type is kept so the clouds can be loaded again with LoadClouds
+   */
+  void ReleaseClouds();
+
 protected:
+  /** cloud with each coordinate quantized to 16 bits over its bounding box */
+  struct QuantizedCloud {
+    Eigen::Vector3f min{Eigen::Vector3f::Zero()};
+    Eigen::Vector3f resolution{Eigen::Vector3f::Zero()};
+    std::vector<uint16_t> xyz;
+  };
+
+  struct CompressedClouds {
+    QuantizedCloud points;
+    QuantizedCloud edges_strong;
+    QuantizedCloud edges_weak;
+    QuantizedCloud surfaces_strong;
+    QuantizedCloud surfaces_weak;
+  };
+
+  static void Quantize(const PointCloud& cloud, QuantizedCloud& quantized);
+
+  static void Dequantize(const QuantizedCloud& quantized, PointCloud& cloud);
+
+  /**
+   * @brief get the regular cloud, decoding it if it is compressed
+   * @param keep whether to keep the decoded cloud in pointcloud_
+   */
+  std::shared_ptr<const PointCloud> DecodedCloud(bool keep) const;
+
+  /**
+   * @brief get the loam cloud, decoding it if it is compressed
+   * @param keep whether to keep the decoded cloud in loampointcloud_
+   */
+  std::shared_ptr<const beam_matching::LoamPointCloud>
+      DecodedLoamCloud(bool keep) const;
+
+  /**
+   * @brief replace the compressed clouds by their decoded clouds
+   */
+  void Decompress();
+
+  /**
+   * @brief handle of the regular cloud data that the covariances are valid
+   * for: the compressed clouds if compressed, else the regular cloud
+   */
+  std::shared_ptr<const void> CovarianceSource() const;
+
+  /** covariances with the cloud data they were computed from */
+  struct CovarianceCache {
+    std::shared_ptr<const void> source;
+    std::shared_ptr<const PointCovariances> covariances;
+  };
+
   // pose data
   ros::Time stamp_;
   int updates_{0};
@@ -306,9 +509,18 @@ protected:
   Eigen::Matrix4d T_REFFRAME_BASELINK_initial_;
   Eigen::Matrix4d T_BASELINK_LIDAR_;
 
-  // cloud data: all in lidar frame
-  PointCloud pointcloud_;
-  beam_matching::LoamPointCloud loampointcloud_;
+  // cloud data: all in lidar frame. These are never modified once set, so
+  // they can be shared between copies. If the clouds are compressed, these
+  // are null until decoded, and they are set atomically when decoded
+  mutable std::shared_ptr<const PointCloud> pointcloud_{
+      std::make_shared<const PointCloud>()};
+  mutable std::shared_ptr<const beam_matching::LoamPointCloud> loampointcloud_{
+      std::make_shared<const beam_matching::LoamPointCloud>()};
+  std::shared_ptr<const CompressedClouds> compressed_clouds_;
+
+  // covariances of the regular cloud, set atomically when computed. They are
+  // ignored once their source is no longer the current cloud data
+  mutable std::shared_ptr<const CovarianceCache> covariances_;
 
   /** This is mainly used to determine if the loam pointcloud is polutated or
    * not. If so, we can run loam scan registration. Options: PCLPOINTCLOUD,
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <ros/time.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_common/cloud_buffer_pool.h>
+#include <bs_common/intra_process.h>
+
+namespace bs_models {
+
+/**
+ * @brief lidar scan passed between the plugins of a process instead of a
+ * sensor_msgs::PointCloud2. The stamp is kept as a ros::Time since the pcl
+ * header stamp only has a precision of microseconds.
+ */
+template <typename PointT>
+struct StampedCloud {
+  ros::Time stamp;
+  std::string frame_id;
+  uint32_t seq{0};
+  pcl::PointCloud<PointT> cloud;
+};
+
+/**
+ * @brief make a stamped cloud whose points are taken from the
+ * bs_common::CloudBufferPool of the point type, and given back to it once the
+ * last subscriber drops the cloud
+ * @param capacity number of points to reserve
+ */
+template <typename PointT>
+std::shared_ptr<StampedCloud<PointT>> MakePooledStampedCloud(size_t capacity) {
+  auto& pool = bs_common::CloudBufferPool<PointT>::Get();
+  auto cloud = new StampedCloud<PointT>();
+  pool.Acquire(cloud->cloud, capacity);
+  return std::shared_ptr<StampedCloud<PointT>>(
+      cloud, [&pool](StampedCloud<PointT>* shared) {
+        pool.Release(shared->cloud);
+        delete shared;
+      });
+}
+
+template <typename PointT>
+sensor_msgs::PointCloud2 StampedCloudToMsg(const StampedCloud<PointT>& cloud) {
+  return beam::PCLToROS<PointT>(cloud.cloud, cloud.stamp, cloud.frame_id,
+                                cloud.seq);
+}
+
+template <typename PointT>
+std::shared_ptr<const StampedCloud<PointT>>
+    StampedCloudFromMsg(const sensor_msgs::PointCloud2& msg) {
+  auto cloud = MakePooledStampedCloud<PointT>(msg.width * msg.height);
+  cloud->stamp = msg.header.stamp;
+  cloud->frame_id = msg.header.frame_id;
+  cloud->seq = msg.header.seq;
+  beam::ROSToPCL(cloud->cloud, msg);
+  return cloud;
+}
+
+template <typename PointT>
+using StampedCloudPublisher =
+    bs_common::IntraProcessPublisher<StampedCloud<PointT>,
+                                     sensor_msgs::PointCloud2>;
+
+template <typename PointT>
+using StampedCloudSubscriber =
+    bs_common::IntraProcessSubscriber<StampedCloud<PointT>,
+                                      sensor_msgs::PointCloud2>;
+
+} // namespace bs_models
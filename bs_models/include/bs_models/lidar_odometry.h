@@ -1,11 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <unordered_map>
 
 #include <fuse_core/async_sensor_model.h>
 #include <fuse_core/fuse_macros.h>
-#include <fuse_core/throttled_callback.h>
 #include <fuse_core/uuid.h>
+#include <std_msgs/Bool.h>
+#include <std_msgs/String.h>
 #include <tf/transform_broadcaster.h>
 
 #include <beam_filtering/Utils.h>
@@ -13,9 +17,21 @@
 #include <beam_utils/pointclouds.h>
 #include <beam_utils/time.h>
 
+#include <bs_common/async_writer.h>
+#include <bs_common/callback_lane.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/graph_recorder.h>
+#include <bs_common/thread_pool.h>
 #include <bs_models/frame_initializers/frame_initializer.h>
+#include <bs_models/lidar/filter_pipeline.h>
+#include <bs_models/lidar/lidar_point.h>
+#include <bs_models/lidar/loam_feature_budget.h>
+#include <bs_models/lidar/range_image.h>
+#include <bs_models/lidar/ring_feature_extractor.h>
 #include <bs_models/lidar/scan_pose.h>
+#include <bs_models/lidar/stamped_cloud.h>
+#include <bs_models/scan_registration/prior_registration_map.h>
+#include <bs_models/scan_registration/scan_pose_buffer.h>
 #include <bs_models/scan_registration/scan_registration_base.h>
 #include <bs_parameters/models/lidar_odometry_params.h>
 
@@ -44,14 +60,144 @@ private:
 
   void onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) override;
 
-  void process(const sensor_msgs::PointCloud2::ConstPtr& msg);
+  /**
+   * @brief queue graph updates on graph_update_lane_ if it is configured
+   */
+  void graphCallback(fuse_core::Graph::ConstSharedPtr graph) override;
+
+  /**
+   * @brief filtered cloud and features of a scan, ready to be registered
+   */
+  struct ScanData {
+    ros::Time stamp;
+    ros::WallTime receive_time;
+    std::shared_ptr<const PointCloud> cloud;
+    std::shared_ptr<beam_matching::LoamPointCloud> loam_cloud;
+  };
+
+  /**
+   * @brief how buffered scans are processed when adaptive_scheduling is set
+   *
+   *  - FULL: all scans are registered,
+   *  - TRACKING: only keyframes are registered, other scans are tracked from
+   *    the last registered scan with the frame initializer motion and only
+   *    published as odometry,
+   *  - SKIPPING: only keyframes are registered, other scans are dropped.
+   */
+  enum class SchedulerMode { FULL, TRACKING, SKIPPING };
+
+  template <typename PointT>
+  void process(const std::shared_ptr<const StampedCloud<PointT>>& cloud);
+
+  /**
+   * @brief add a prepared scan to the buffer and update the scan period
+   */
+  void BufferScan(ScanData&& scan);
+
+  /**
+   * @brief convert and filter a scan and extract its features. This does not
+   * depend on the state of the odometry, so it can run while the previous scan
+   * is being registered.
+   */
+  template <typename PointT>
+  ScanData PrepareScan(const StampedCloud<PointT>& cloud,
+                       const FilterPipeline<PointT>& filters);
+
+  /**
+   * @brief filter a cloud into the scan and extract its features
+   */
+  template <typename PointT>
+  void FilterScan(const pcl::PointCloud<PointT>& cloud,
+                  const FilterPipeline<PointT>& filters, ScanData& scan);
+
+  template <typename PointT>
+  std::shared_ptr<beam_matching::LoamPointCloud>
+      ExtractFeatures(const pcl::PointCloud<PointT>& cloud);
+
+  /**
+   * @brief register all buffered scans, in order
+   */
+  void ProcessScanBuffer();
+
+  /**
+   * @brief register the buffered scans once the frame initializer reaches the
+   * oldest one, called by the wakeup requested by ProcessScanBuffer
+   */
+  void RetryScanBuffer();
+
+  /**
+   * @brief wait until the scans handed to the registration thread are
+   * registered, rethrows any exception thrown while registering
+   */
+  void WaitForRegistration();
+
+  /**
+   * @brief select the scheduler mode from the registration load and the scan
+   * buffer size, and publish it if it changed
+   */
+  void UpdateSchedulerMode();
+
+  /**
+   * @brief check if the motion since the last registered scan is large enough
+   * for a scan to be a keyframe
+   */
+  bool IsKeyframe(const Eigen::Matrix4d& T_World_BaselinkInit) const;
+
+  /**
+   * @brief publish the odometry of a scan which is tracked instead of
+   * registered. Its pose is the last registered pose moved by the frame
+   * initializer motion since, so it stays on the registered trajectory
+   */
+  void PublishTrackedScan(const ros::Time& stamp,
+                          const Eigen::Matrix4d& T_World_BaselinkInit);
+
+  void BackpressureCallback(const std_msgs::Bool::ConstPtr& msg);
 
   void SetupRegistration();
 
+  /**
+   * @brief publish the odometry of a marginalized scan, and queue its slam
+   * chunk for the global mapper on the results writer. The scan pose must not
+   * be modified afterwards
+   */
   void PublishMarginalizedScanPose(const std::shared_ptr<ScanPose>& scan_pose);
 
+  /**
+   * @brief build and publish the slam chunk of a marginalized scan, this is
+   * run by the results writer
+   * @param scan_pose marginalized scan
+   * @param T_WORLD_BASELINK pose of the scan when it was marginalized
+   */
+  void PublishSlamChunk(const std::shared_ptr<ScanPose>& scan_pose,
+                        const Eigen::Matrix4d& T_WORLD_BASELINK);
+
+  /**
+   * @brief publish and save a scan that was removed from the active clouds
+   */
+  void OutputMarginalizedScanPose(const std::shared_ptr<ScanPose>& scan_pose);
+
+  /**
+   * @brief queue a marginalized scan for saving, the scan pose must not be
+   * modified afterwards
+   */
   void SaveMarginalizedScanPose(const std::shared_ptr<ScanPose>& scan_pose);
 
+  /**
+   * @brief update the "lidar_odometry/active_clouds" memory account. If it is
+   * over budget, the oldest active scans are output and removed before they
+   * are marginalized, so their output poses may not be final
+   */
+  void UpdateActiveCloudsMemory();
+
+  /**
+   * @brief queue all active scans for saving to a new graph update directory,
+   * and record the graph
+   * @param graph graph of the update, recorded as a diff of the previous one
+   * @param stamp latest timestamp in the graph
+   */
+  void SaveGraphUpdate(fuse_core::Graph::ConstSharedPtr graph,
+                       const ros::Time& stamp);
+
   void PublishTfTransform(const Eigen::Matrix4d& T_Child_Parent,
                           const std::string& child_frame,
                           const std::string& parent_frame,
@@ -59,8 +205,13 @@ private:
 
   void PublishExtrinsics(fuse_core::Graph::ConstSharedPtr graph_msg);
 
-  /** subscribe to lidar data */
-  ros::Subscriber subscriber_;
+  /** subscribe to lidar data, only the one of the lidar type is used. Scans
+   * from a deskewer in the same process are received without conversion */
+  StampedCloudSubscriber<PointXYZIRT> velodyne_subscriber_;
+  StampedCloudSubscriber<PointXYZITRRNR> ouster_subscriber_;
+
+  /** subscribe to the optimizer back-pressure state */
+  ros::Subscriber backpressure_subscriber_;
 
   /** Publishers */
   ros::Publisher results_publisher_; // for global mapper
@@ -72,24 +223,43 @@ private:
   int odom_publisher_marginalized_counter_{0};
   ros::Publisher imu_constraint_trigger_publisher_;
   int imu_constraint_trigger_counter_{0};
+  ros::Publisher scheduler_mode_publisher_;
 
   tf::TransformBroadcaster tf_broadcaster_;
 
-  /** callback for lidar data */
-  using ThrottledCallback =
-      fuse_core::ThrottledMessageCallback<sensor_msgs::PointCloud2>;
-  ThrottledCallback throttled_callback_;
-  std::deque<sensor_msgs::PointCloud2::ConstPtr> scan_buffer_;
+  std::deque<ScanData> scan_buffer_;
+
+  /** serializes scan callbacks with the frame initializer wakeups and the
+   * graph updates */
+  std::mutex scan_buffer_mutex_;
+
+  /** Only used if pipeline_scan_processing is set, registers the buffered
+   * scans while the next scan is prepared in the subscriber callback. Graph
+   * updates wait for the running registration */
+  std::unique_ptr<bs_common::ThreadPool> registration_pool_;
+  std::future<void> registration_future_;
 
   /** Needed for outputing the slam results or saving final clouds or graph
    * updates */
-  std::list<std::shared_ptr<ScanPose>> active_clouds_;
+  scan_registration::ScanPoseBuffer active_clouds_;
+  // scans removed from active_clouds_ by the last graph update, kept to reuse
+  // its memory
+  std::vector<std::shared_ptr<ScanPose>> marginalized_clouds_;
 
   /** Only needed if using LoamMatcher */
   std::shared_ptr<beam_matching::LoamFeatureExtractor> feature_extractor_;
+  // the extractors are only read by ExtractFeatures, which runs on the scan
+  // callback threads outside of scan_buffer_mutex_. Per scan state such as
+  // the range image is therefore local to each call
+  std::unique_ptr<RingFeatureExtractor> ring_feature_extractor_;
+  // only set if a feature budget is set
+  std::unique_ptr<LoamFeatureBudget> feature_budget_;
 
   // register scans to map
   std::unique_ptr<scan_registration::ScanRegistrationBase> scan_registration_;
+  std::shared_ptr<scan_registration::RegistrationMap> registration_map_;
+  // only set when localizing against a prior map, kept loaded across resets
+  std::shared_ptr<scan_registration::PriorRegistrationMap> prior_map_;
 
   fuse_core::UUID device_id_; //!< The UUID of this device
   fuse_core::UUID extrinsics_position_uuid_;
@@ -103,17 +273,45 @@ private:
 
   bs_parameters::models::LidarOdometryParams params_;
 
-  std::vector<beam_filtering::FilterParamsType> input_filter_params_;
+  /** frame of the lidar this odometry registers scans from */
+  std::string lidar_frame_id_;
 
-  int updates_{0};
+  std::vector<beam_filtering::FilterParamsType> input_filter_params_;
+  FilterPipeline<PointXYZIRT> input_filters_velodyne_;
+  FilterPipeline<PointXYZITRRNR> input_filters_ouster_;
+  // only used if lean points are supported by the filters and features
+  FilterPipeline<LidarPoint> input_filters_lean_;
+  bool use_lean_points_{false};
+
+  // read by the scan callbacks before they take scan_buffer_mutex_, and
+  // written by the graph updates, which may run on a dedicated thread
+  std::atomic<int> updates_{0};
   Eigen::Matrix4d T_World_BaselinkLast_{Eigen::Matrix4d::Identity()};
   ros::Time last_scan_pose_time_{ros::Time(0)};
   std::string graph_updates_path_;
   std::string marginalized_scans_path_;
   std::string registration_results_path_;
+
+  /** Write the saved scans in the background, only created if saving */
+  std::unique_ptr<bs_common::AsyncWriter> marginalized_scans_writer_;
+  std::unique_ptr<bs_common::AsyncWriter> graph_updates_writer_;
+
+  /** Packs and publishes the slam chunks of the marginalized scans in order,
+   * only created if outputting points */
+  std::unique_ptr<bs_common::AsyncWriter> results_writer_;
+
+  /** binary recording of the graph updates, see graph_recording_main */
+  std::unique_ptr<bs_common::GraphRecorder> graph_recorder_;
   ros::Time last_map_update_time_{0};
   int skipped_scans_in_a_row_{0};
-  bool resetting_{false};
+  std::atomic<bool> resetting_{false};
+  std::atomic<bool> backpressure_{false};
+
+  SchedulerMode scheduler_mode_{SchedulerMode::FULL};
+  /** smoothed registration time and period of incoming scans, in seconds */
+  double registration_time_avg_{0};
+  double scan_period_avg_{0};
+  ros::Time last_buffered_scan_stamp_{0};
 
   /** Params that can only be updated here: */
   bool update_registration_map_all_scans_{false};
@@ -123,8 +321,18 @@ private:
   int max_scan_buffer_size_{4};
   bool publish_extrinsics_{false};
   bool log_registration_time_{false};
+  double scheduler_smoothing_{0.2};
+  double scheduler_hysteresis_{0.8};
 
   beam::HighResolutionTimer timer_;
+
+  // graph updates, only set if graph_update_lane/queue_size or
+  // graph_update_lane/dedicated is set. The callbacks take
+  // scan_buffer_mutex_, so they may run on the dedicated thread. Declared last
+  // so it is destroyed first, stopping its callbacks before the members they
+  // use are destroyed
+  std::unique_ptr<bs_common::CallbackLane<fuse_core::Graph>>
+      graph_update_lane_;
 };
 
 } // namespace bs_models
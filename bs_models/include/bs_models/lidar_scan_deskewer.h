@@ -7,6 +7,7 @@
 #include <fuse_core/throttled_callback.h>
 
 #include <bs_models/frame_initializers/frame_initializer.h>
+#include <bs_models/lidar/stamped_cloud.h>
 #include <bs_parameters/models/lidar_scan_deskewer_params.h>
 
 namespace bs_models {
@@ -32,11 +33,36 @@ private:
 
   void DeskewAndPublishOusterQueue();
 
+  /**
+   * @brief deskew the queued clouds again once the frame initializer reaches
+   * a time, if it's not there yet
+   * @param time end of the sweep of the oldest queued cloud
+   */
+  void WakeWhenAvailable(const ros::Time& time);
+
+  /**
+   * @brief deskew a scan into the frame of the lidar at the cloud stamp. The
+   * trajectory is only sampled at params_.num_pose_knots poses across the
+   * sweep, and each point's pose is interpolated between the two nearest knots
+   * @param cloud_stamp stamp of the cloud, point times are relative to this
+   * @param cloud input distorted cloud
+   * @param cloud_deskewed output cloud, its storage is reused
+   * @param end_time [out] end of the sweep, the latest time poses are needed
+   * @return false if the trajectory is not yet available over the sweep
+   */
+  template <typename PointT>
+  bool DeskewCloud(const ros::Time& cloud_stamp,
+                   const pcl::PointCloud<PointT>& cloud,
+                   pcl::PointCloud<PointT>& cloud_deskewed,
+                   ros::Time& end_time);
+
   /** subscribe to lidar data */
   ros::Subscriber pointcloud_subscriber_;
 
-  /** Publishers */
-  ros::Publisher pointcloud_publisher_;
+  /** Publishers, only the one of the lidar type is used. Plugins in the same
+   * process receive the deskewed clouds without conversion */
+  StampedCloudPublisher<PointXYZIRT> velodyne_publisher_;
+  StampedCloudPublisher<PointXYZITRRNR> ouster_publisher_;
 
   /** callbacks */
   using ThrottledCallbackPC =
@@ -47,14 +73,28 @@ private:
 
   int counter_{0};
 
+  /** frame scans are deskewed to and published in */
+  std::string lidar_frame_id_;
+
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
   std::unique_ptr<bs_models::FrameInitializer> frame_initializer_;
 
-  using VelodyneCloudWithStamp =
-      std::pair<ros::Time, pcl::PointCloud<PointXYZIRT>>;
-  using OusterCloudWithStamp =
-      std::pair<ros::Time, pcl::PointCloud<PointXYZITRRNR>>;
+  template <typename PointT>
+  struct CloudWithStamp {
+    ros::Time stamp;
+    ros::WallTime receive_time; // for the latency trace
+    pcl::PointCloud<PointT> cloud;
+  };
+  using VelodyneCloudWithStamp = CloudWithStamp<PointXYZIRT>;
+  using OusterCloudWithStamp = CloudWithStamp<PointXYZITRRNR>;
+
+  /**
+   * @brief pop the oldest queued cloud, giving its storage back to the cloud
+   * buffer pool
+   */
+  template <typename PointT>
+  static void PopCloud(std::queue<CloudWithStamp<PointT>>& queue);
 
   std::queue<VelodyneCloudWithStamp> queue_velodyne_;
   std::queue<OusterCloudWithStamp> queue_ouster_;
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <nlohmann/json.hpp>
+
 #include <bs_models/global_mapping/submap.h>
+#include <bs_models/global_mapping/submap_footprint.h>
+#include <bs_models/global_mapping/submap_position_index.h>
 
 namespace bs_models::reloc {
 
@@ -10,6 +14,32 @@ namespace bs_models::reloc {
  */
 class RelocCandidateSearchBase {
 public:
+  /**
+   * @brief params of the overlap prefilter, which rejects candidates whose
+   * submap footprints (see global_mapping::SubmapFootprint) cannot overlap at
+   * the estimated relative pose, before they are aligned or refined
+   */
+  struct OverlapPrefilterParams {
+    bool enabled{false};
+
+    /** the bounding boxes are grown by this before they are intersected */
+    double box_margin_m{2.0};
+
+    /** min fraction of the voxels of the smaller footprint which overlap the
+     * other footprint */
+    double min_occupancy_overlap{0.2};
+
+    /** min intersection of the height histograms */
+    double min_height_similarity{0.3};
+
+    global_mapping::SubmapFootprint::Params footprint;
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+  };
+
   /**
    * @brief default constructor
    */
@@ -47,7 +77,77 @@ public:
   static std::shared_ptr<RelocCandidateSearchBase>
       Create(const std::string& config_path);
 
+  /**
+   * @brief whether FindRelocCandidates reads the lidar clouds of the submaps,
+   * or only their poses. Callers that page in the clouds of the submaps (see
+   * global_mapping::SubmapWorkingSet) only load them if this is true
+   */
+  virtual bool UsesLidarClouds() const { return true; }
+
+  /**
+   * @brief compute anything FindRelocCandidates needs for a submap which can
+   * be done ahead of time, e.g. descriptors, once the submap is complete. Must
+   * not be called while FindRelocCandidates is running. This computes the
+   * footprint of the submap if the overlap prefilter is enabled
+   * @param submap completed submap
+   */
+  virtual void PrepareSubmap(const global_mapping::SubmapPtr& submap);
+
+  /**
+   * @brief configure a new submap before any measurements are added to it,
+   * e.g. so it computes descriptors as its scans are added instead of when
+   * PrepareSubmap is called
+   * @param submap new submap
+   */
+  virtual void ConfigureSubmap(const global_mapping::SubmapPtr& submap) {}
+
+  /**
+   * @brief set an index over the positions of the search submaps, which
+   * implementations can use to preselect submaps instead of comparing against
+   * all of them. Its ids must match the indices of the search submaps, and it
+   * must not be modified while FindRelocCandidates is running
+   */
+  void SetSubmapPositionIndex(
+      const std::shared_ptr<const global_mapping::SubmapPositionIndex>&
+          index) {
+    submap_position_index_ = index;
+  }
+
+  void SetOverlapPrefilterParams(const OverlapPrefilterParams& params) {
+    overlap_prefilter_params_ = params;
+  }
+
 protected:
+  /**
+   * @brief load the overlap prefilter params from the optional
+   * "overlap_prefilter" object of a candidate search config
+   */
+  void LoadOverlapPrefilterParams(const nlohmann::json& J);
+
+  /**
+   * @brief check if a candidate can overlap the query with the overlap
+   * prefilter. Candidates always pass if the prefilter is disabled or if a
+   * footprint cannot be computed, e.g. because the clouds are not loaded
+   * @param candidate candidate submap
+   * @param query query submap
+   * @param T_CANDIDATE_QUERY estimated pose of the query in the candidate
+   * @return false if the candidate is rejected
+   */
+  bool PassesOverlapPrefilter(const global_mapping::SubmapPtr& candidate,
+                              const global_mapping::SubmapPtr& query,
+                              const Eigen::Matrix4d& T_CANDIDATE_QUERY);
+
+  /**
+   * @brief get the footprint of a submap, it is computed once and stored in
+   * the submap
+   * @return footprint, or nullptr if the submap has no lidar points
+   */
+  const global_mapping::SubmapFootprint*
+      GetFootprint(const global_mapping::SubmapPtr& submap);
+
+  std::shared_ptr<const global_mapping::SubmapPositionIndex>
+      submap_position_index_;
+  OverlapPrefilterParams overlap_prefilter_params_;
 };
 
 } // namespace bs_models::reloc
@@ -9,7 +9,10 @@ namespace bs_models::reloc {
  * look for candidate relocs, this class simply looks through all
  * submaps supplied and calculates the norm between the candidate submap pose
  * and the query pose. If the norm is below some threshold, then the candidate
- * is return along with the relative pose between the two.
+ * is return along with the relative pose between the two. If a submap position
+ * index is set, only the submaps it returns within the threshold are checked.
+ * Candidates can then be rejected with the overlap prefilter (see
+ * RelocCandidateSearchBase::OverlapPrefilterParams).
  */
 class RelocCandidateSearchEucDist : public RelocCandidateSearchBase {
 public:
@@ -35,6 +38,14 @@ public:
       std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts_Candidate_Query,
       size_t ignore_last_n_submaps, const std::string& output_path) override;
 
+  /**
+   * @brief only the submap poses are used, unless the overlap prefilter needs
+   * the clouds for the submap footprints
+   */
+  bool UsesLidarClouds() const override {
+    return overlap_prefilter_params_.enabled;
+  }
+
 private:
   void LoadConfig();
   std::string config_path_;
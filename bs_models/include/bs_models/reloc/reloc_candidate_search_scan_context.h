@@ -5,7 +5,9 @@
 #include <beam_filtering/Utils.h>
 #include <beam_matching/Matchers.h>
 
+#include <bs_models/lidar/filter_pipeline.h>
 #include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_models/reloc/scan_context_index.h>
 
 namespace bs_models::reloc {
 
@@ -29,6 +31,18 @@ public:
       std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts_Candidate_Query,
       size_t ignore_last_n_submaps, const std::string& output_path) override;
 
+  /**
+   * @brief computes the descriptors and the descriptor index of the submap,
+   * and its footprint if the overlap prefilter is enabled
+   */
+  void PrepareSubmap(const global_mapping::SubmapPtr& submap) override;
+
+  /**
+   * @brief makes the submap accumulate its scan context descriptors as scans
+   * are added, so PrepareSubmap does not need to aggregate the scans
+   */
+  void ConfigureSubmap(const global_mapping::SubmapPtr& submap) override;
+
 private:
   struct MatchPair {
     int candidate_submap_id;
@@ -46,23 +60,42 @@ private:
       const Eigen::Matrix4d& T_World_QuerySubmap,
       const std::string& output_path) const;
 
+  /**
+   * @brief get the scan context descriptors of all lidar keyframes of a
+   * submap. They are taken from the descriptors accumulated by the submap if
+   * it was configured with ConfigureSubmap, or computed from the aggregated
+   * scans otherwise. They are stored in the submap, so they are saved with it
+   * and only recomputed if its keyframes change
+   */
+  const std::map<uint64_t, Eigen::MatrixXd>&
+      GetScanContexts(const global_mapping::SubmapPtr& submap);
+
+  /**
+   * @brief get the descriptor index of a submap, which is cached by submap
+   * stamp and rebuilt when its descriptors are recomputed
+   */
+  const ScanContextIndex&
+      GetScanContextIndex(const global_mapping::SubmapPtr& submap);
+
   PointCloudSC AggregateSubmapScan(const global_mapping::SubmapPtr& submap,
                                    int keyframe_id) const;
 
   std::vector<uint64_t>
-      GetTimesToAggregate(const std::map<uint64_t, ScanPose>& keyframes,
-                          int center_id) const;
+      GetTimesToAggregate(
+          const bs_common::FlatTimeMap<uint64_t, ScanPose>& keyframes,
+          int center_id) const;
 
   double GetMinDistBetweenSubmaps(const global_mapping::SubmapPtr& s1,
                                   const global_mapping::SubmapPtr& s2) const;
 
   std::string config_path_;
-  std::vector<beam_filtering::FilterParamsType> filters_;
+  FilterPipeline<pcl::PointXYZ> filters_;
   std::unique_ptr<beam_matching::Matcher<PointCloudPtr>> matcher_;
   double submap_distance_threshold_m_;
   double scan_context_dist_thres_{0.3};
   int num_scans_to_aggregate_{20};
-  bool log_scan_context_{false};
+  int num_ring_key_candidates_{10};
+  std::map<uint64_t, std::unique_ptr<ScanContextIndex>> indices_;
 };
 
 } // namespace bs_models::reloc
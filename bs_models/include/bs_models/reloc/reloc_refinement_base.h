@@ -3,6 +3,7 @@
 #include <map>
 
 #include <fuse_core/transaction.h>
+#include <nlohmann/json.hpp>
 #include <ros/time.h>
 
 #include <beam_utils/pointclouds.h>
@@ -14,6 +15,13 @@ struct RelocRefinementResults {
   Eigen::Matrix4d T_MATCH_QUERY{Eigen::Matrix4d::Identity()};
   std::optional<Eigen::Matrix<double, 6, 6>> covariance;
   bool successful{false};
+
+  /** overlap after coarse alignment, 1 if coarse alignment is disabled */
+  double coarse_overlap{1};
+
+  /** duration of each stage, fine is 0 if rejected by the coarse stage */
+  double coarse_time_s{0};
+  double fine_time_s{0};
 };
 
 /**
@@ -23,6 +31,30 @@ struct RelocRefinementResults {
  */
 class RelocRefinementBase {
 public:
+  /**
+   * @brief Params of the coarse alignment stage, which runs before the full
+   * resolution refinement to reject candidates cheaply
+   */
+  struct CoarseAlignmentParams {
+    /** if false, go straight to the full resolution refinement */
+    bool enabled{false};
+
+    /** size of the voxels of the coarse clouds and of the overlap score */
+    double voxel_size{1.0};
+
+    /** point to point ICP iterations on the coarse clouds, if 0 the estimate
+     * is only scored */
+    int max_iterations{10};
+
+    double max_correspondence_distance{3.0};
+
+    /** candidates with a lower voxel overlap are rejected */
+    double min_overlap{0.3};
+
+    /** load from a json object, all keys are optional */
+    void LoadFromJson(const nlohmann::json& J);
+  };
+
   /**
    * @brief constructor with a required path to a json config
    * @param config path to json config file. If empty, it will use default
@@ -59,7 +91,25 @@ public:
       Create(const std::string& config_path);
 
 protected:
+  /**
+   * @brief coarse alignment stage. Both clouds are voxelized and registered
+   * with a few ICP iterations, then the voxel overlap of the aligned query
+   * with the matched cloud is used to accept or reject the candidate. Does
+   * nothing if disabled
+   * @param matched_cloud cloud in matched submap frame
+   * @param query_cloud cloud in query submap frame
+   * @param T_MATCH_QUERY estimate to start from, updated with the coarse
+   * alignment
+   * @param results coarse overlap and timing are set
+   * @return false if the candidate is rejected
+   */
+  bool CoarseAlign(const PointCloud& matched_cloud,
+                   const PointCloud& query_cloud,
+                   Eigen::Matrix4d& T_MATCH_QUERY,
+                   RelocRefinementResults& results) const;
+
   std::string config_path_;
+  CoarseAlignmentParams coarse_params_;
 };
 
 } // namespace bs_models::reloc
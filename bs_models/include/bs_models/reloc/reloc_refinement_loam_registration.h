@@ -14,7 +14,9 @@
 namespace bs_models { namespace reloc {
 
 /**
- * @brief reloc refinement with loam scan matching
+ * @brief reloc refinement with loam scan matching. If enabled, a coarse
+ * alignment of the strong features first rejects candidates that do not
+ * overlap (see RelocRefinementBase::CoarseAlign)
  */
 class RelocRefinementLoam : public RelocRefinementBase {
 public:
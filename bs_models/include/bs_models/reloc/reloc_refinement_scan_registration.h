@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <map>
 
@@ -11,15 +12,21 @@
 #include <beam_utils/pointclouds.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/point_transforms.h>
 #include <bs_common/utils.h>
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
+#include <bs_models/lidar/filter_pipeline.h>
 #include <bs_models/reloc/reloc_refinement_base.h>
 #include <bs_models/scan_registration/scan_registration_base.h>
 
 namespace bs_models { namespace reloc {
 
 /**
- * @brief Templated class for reloc refinement with lidar scan matching
+ * @brief Templated class for reloc refinement with lidar scan matching. If
+ * enabled, a coarse alignment first rejects candidates that do not overlap
+ * (see RelocRefinementBase::CoarseAlign), so the input filters and the full
+ * resolution match only run on the remaining candidates
  */
 template <typename MatcherType, typename ParamsType>
 class RelocRefinementScanRegistration : public RelocRefinementBase {
@@ -42,22 +49,23 @@ public:
                     const global_mapping::SubmapPtr& query_submap,
                     const Eigen::Matrix4d& T_MATCH_QUERY_EST,
                     const std::string& output_path = "") override {
-    // extract and filter clouds from matched submap
-    PointCloud matched_submap_world = beam_filtering::FilterPointCloud(
-        matched_submap->GetLidarPointsInWorldFrameCombined(), filter_params_);
-    PointCloud matched_submap_in_submap_frame;
-    pcl::transformPointCloud(
-        matched_submap_world, matched_submap_in_submap_frame,
-        beam::InvertTransform(matched_submap->T_WORLD_SUBMAP()));
-
-    // extract and filter clouds from matched submap
-    PointCloud query_submap_world = beam_filtering::FilterPointCloud(
-        query_submap->GetLidarPointsInWorldFrameCombined(), filter_params_);
-
-    PointCloud query_submap_in_submap_frame;
-    pcl::transformPointCloud(
-        query_submap_world, query_submap_in_submap_frame,
-        beam::InvertTransform(query_submap->T_WORLD_SUBMAP()));
+    static bs_common::Metric& fine_metric =
+        bs_common::Instrumentation::GetInstance().GetMetric(
+            "reloc_refinement/fine");
+
+    // extract clouds in their submap frames, these are cached by the submaps
+    const PointCloud matched_submap_in_submap_frame =
+        matched_submap->GetLidarPointsInSubmapFrame();
+    const PointCloud query_submap_in_submap_frame =
+        query_submap->GetLidarPointsInSubmapFrame();
+
+    RelocRefinementResults results;
+    Eigen::Matrix4d T_MATCH_QUERY_COARSE = T_MATCH_QUERY_EST;
+    if (!CoarseAlign(matched_submap_in_submap_frame,
+                     query_submap_in_submap_frame, T_MATCH_QUERY_COARSE,
+                     results)) {
+      return results;
+    }
 
     std::string current_output_path;
     if (!output_path.empty()) {
@@ -73,11 +81,15 @@ public:
       std::filesystem::create_directory(current_output_path);
     }
 
-    // get refined transform
-    RelocRefinementResults results;
+    // filter clouds and get refined transform
+    const auto start = std::chrono::steady_clock::now();
     results.successful = GetRefinedT_SUBMAP_QUERY(
-        matched_submap_in_submap_frame, query_submap_in_submap_frame,
-        T_MATCH_QUERY_EST, current_output_path, results.T_MATCH_QUERY);
+        filter_pipeline_.Filter(matched_submap_in_submap_frame),
+        filter_pipeline_.Filter(query_submap_in_submap_frame),
+        T_MATCH_QUERY_COARSE, current_output_path, results.T_MATCH_QUERY);
+    const auto duration = std::chrono::steady_clock::now() - start;
+    fine_metric.Record(duration);
+    results.fine_time_s = std::chrono::duration<double>(duration).count();
     return results;
   }
 
@@ -113,7 +125,12 @@ private:
     nlohmann::json J_filters = J["filters"];
 
     filter_params_ = beam_filtering::LoadFilterParamsVector(J_filters);
+    filter_pipeline_ = FilterPipeline<pcl::PointXYZ>(filter_params_);
     BEAM_INFO("Loaded {} input filters", filter_params_.size());
+
+    if (J.contains("coarse_alignment")) {
+      coarse_params_.LoadFromJson(J["coarse_alignment"]);
+    }
   }
 
   /**
@@ -146,8 +163,8 @@ private:
     // convert query to estimated submap frame and make pointers
     PointCloudPtr submap_ptr = std::make_shared<PointCloud>(submap_cloud);
     PointCloudPtr query_in_submap_frame_est = std::make_shared<PointCloud>();
-    pcl::transformPointCloud(query_cloud, *query_in_submap_frame_est,
-                             T_SUBMAP_QUERY_EST);
+    bs_common::TransformCloud(query_cloud, *query_in_submap_frame_est,
+                              T_SUBMAP_QUERY_EST);
 
     // match clouds
     matcher_->SetRef(submap_ptr);
@@ -170,6 +187,7 @@ private:
   std::string matcher_config_;
   std::unique_ptr<PointcloudMatcher> matcher_;
   std::vector<beam_filtering::FilterParamsType> filter_params_;
+  FilterPipeline<pcl::PointXYZ> filter_pipeline_;
 };
 
 using RelocRefinementIcp =
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models::reloc {
+
+/**
+ * @brief Accumulates the scan context descriptors of the lidar keyframes of a
+ * submap as its scans are added, so they are ready when the submap is
+ * complete instead of being computed from the aggregated clouds then. The
+ * descriptor of a keyframe is the scan context (see beam_matching::SCManager)
+ * of the scans within num_scans_aggregated / 2 keyframes of it, in its lidar
+ * frame, as computed by RelocCandidateSearchScanContext::AggregateSubmapScan.
+ *
+ * Each scan is reduced once to its polar height map: the highest point of
+ * each cell of a polar grid which is finer than the descriptor and extends
+ * past its max radius. Only these points are transformed into the frames of
+ * the neighbouring keyframes and binned into their descriptors, which is
+ * exact for the keyframe of the scan itself. Since each bin keeps the max
+ * height, points of a scan are binned as they arrive and only keyframes whose
+ * neighbours are changed by out of order scans are recomputed.
+ */
+class ScanContextAccumulator {
+public:
+  /**
+   * @brief constructor of a disabled accumulator, which ignores all scans
+   */
+  ScanContextAccumulator() = default;
+
+  /**
+   * @brief constructor
+   * @param num_scans_aggregated number of scans aggregated around each
+   * keyframe, see RelocCandidateSearchScanContext
+   */
+  explicit ScanContextAccumulator(int num_scans_aggregated);
+
+  bool Enabled() const { return num_scans_aggregated_ > 0; }
+
+  int NumScansAggregated() const { return num_scans_aggregated_; }
+
+  /**
+   * @brief add a scan, or points to a scan that was already added
+   * @param stamp stamp of the lidar keyframe in nanoseconds
+   * @param T_REFFRAME_LIDAR pose of the lidar in the submap
+   * @param cloud points in the lidar frame, which can be empty for keyframes
+   * without a regular cloud (e.g. loam only keyframes)
+   */
+  void AddScan(uint64_t stamp, const Eigen::Matrix4d& T_REFFRAME_LIDAR,
+               const PointCloud& cloud);
+
+  /**
+   * @brief get the stamps of the keyframes that were added, in order
+   */
+  std::vector<uint64_t> Stamps() const;
+
+  /**
+   * @brief get the descriptors of all keyframes
+   * @return <time, descriptor> for each keyframe
+   */
+  std::map<uint64_t, Eigen::MatrixXd> Descriptors() const;
+
+  size_t Size() const { return scans_.size(); }
+
+private:
+  struct Scan {
+    Eigen::Matrix4d T_REFFRAME_LIDAR;
+
+    /** <cell, highest point> of the polar height map, sorted by cell */
+    std::vector<std::pair<int, Eigen::Vector3f>> height_map;
+
+    /** max height of each bin, kNoPoint if empty */
+    Eigen::MatrixXd descriptor;
+  };
+
+  using ScanIter = std::map<uint64_t, Scan>::iterator;
+
+  /**
+   * @brief add points to the height map of a scan
+   * @return points of the height map which were added or raised
+   */
+  std::vector<Eigen::Vector3f> UpdateHeightMap(Scan& scan,
+                                               const PointCloud& cloud) const;
+
+  /**
+   * @brief bin a point into a descriptor the same way as
+   * beam_matching::SCManager::makeScancontext
+   * @param point point in the frame of the descriptor
+   */
+  void Bin(const Eigen::Vector3f& point, Eigen::MatrixXd& descriptor) const;
+
+  /**
+   * @brief bin points of a scan into the descriptor of a keyframe
+   */
+  void Bin(const std::vector<Eigen::Vector3f>& points, const Scan& source,
+           Scan& target) const;
+
+  /**
+   * @brief recompute the descriptor of a keyframe from the height maps of its
+   * neighbours
+   */
+  void Rebuild(ScanIter target);
+
+  /**
+   * @brief get the first and past the end neighbours of a keyframe
+   */
+  std::pair<ScanIter, ScanIter> Neighbours(ScanIter center);
+
+  int num_scans_aggregated_{0};
+  int num_rings_{0};
+  int num_sectors_{0};
+  double max_radius_m_{0};
+  double lidar_height_m_{0};
+  std::map<uint64_t, Scan> scans_;
+};
+
+} // namespace bs_models::reloc
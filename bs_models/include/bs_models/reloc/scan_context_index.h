@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <flann/flann.hpp>
+
+namespace bs_models::reloc {
+
+/**
+ * @brief Search structure over the scan context descriptors of a submap. The
+ * ring keys (mean of each ring, which does not depend on the yaw of the scan)
+ * are stored in a kd-tree to preselect the closest descriptors, and only those
+ * are compared using the full scan context distance
+ */
+class ScanContextIndex {
+public:
+  /**
+   * @brief constructor
+   * @param descriptors scan context descriptors of size rings x sectors, all
+   * of the same size
+   */
+  explicit ScanContextIndex(const std::vector<Eigen::MatrixXd>& descriptors);
+
+  /**
+   * @brief find the closest descriptor to a query descriptor
+   * @param descriptor query descriptor
+   * @param num_candidates number of descriptors preselected using ring keys
+   * @return index of the closest descriptor and its distance, the index is -1
+   * if the index is empty
+   */
+  std::pair<int, double> Query(const Eigen::MatrixXd& descriptor,
+                               int num_candidates) const;
+
+  size_t Size() const { return descriptors_.size(); }
+
+  /**
+   * @brief scan context distance between two descriptors, which is the mean
+   * cosine distance between their non empty sectors minimized over all sector
+   * shifts (i.e., yaw rotations)
+   */
+  static double Distance(const Eigen::MatrixXd& sc1,
+                         const Eigen::MatrixXd& sc2);
+
+private:
+  struct NormalizedDescriptor {
+    Eigen::MatrixXd sectors; // columns normalized to unit length
+    Eigen::VectorXd valid;   // 1 for non empty sectors, 0 otherwise
+  };
+
+  static NormalizedDescriptor Normalize(const Eigen::MatrixXd& descriptor);
+
+  static double Distance(const NormalizedDescriptor& sc1,
+                         const NormalizedDescriptor& sc2);
+
+  std::vector<NormalizedDescriptor> descriptors_;
+  int num_rings_{0};
+  std::vector<float> ring_keys_; // one row per descriptor, used by the tree
+  std::unique_ptr<flann::Index<flann::L2<float>>> tree_;
+};
+
+} // namespace bs_models::reloc
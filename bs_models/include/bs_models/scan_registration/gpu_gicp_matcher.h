@@ -0,0 +1,137 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Eigen/Dense>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/point_covariances.h>
+
+namespace bs_models { namespace scan_registration {
+
+/**
+ * @brief Generalized-ICP (Segal et al., 2009) which runs its nearest
+ * neighbour searches on the GPU, as an alternative to beam_matching's
+ * GicpMatcher for dense lidars, where the searches for the point covariances
+ * and the correspondences take most of the matching time. The clouds are
+ * expected to be voxel downsampled already (see
+ * MultiScanRegistration::SetMatchVoxelSize), the Gauss-Newton steps are
+ * solved on the CPU.
+ *
+ * Each cloud is identified by a key (e.g. its scan stamp) and is uploaded and
+ * gets its covariances computed once, the first time it is matched. Its
+ * device buffer is then kept, so a scan is only uploaded once while it is a
+ * target and then a reference, until it is released with Retain. The matcher
+ * can be shared by threads, the device work is serialized.
+ *
+ * Params are loaded from the same matcher config as the CPU GICP matcher,
+ * which selects this backend with "backend": "CUDA". This is only available
+ * if OpenCV was built with its CUDA modules, see Available().
+ */
+class GpuGicpMatcher {
+public:
+  struct Params {
+    /** number of neighbours used for the point covariances */
+    int covariance_neighbours{20};
+
+    /** max number of Gauss-Newton iterations */
+    int max_iterations{100};
+
+    /** correspondences further apart than this [m] are not used */
+    double max_correspondence_distance{1.0};
+
+    /** stop once the rotation [rad] and translation [m] updates of an
+     * iteration are below these */
+    double rotation_epsilon{1e-4};
+    double translation_epsilon{1e-4};
+
+    /** min number of correspondences for a match to succeed */
+    int min_correspondences{30};
+
+    /**
+     * @brief load params from a GICP matcher config, missing params keep
+     * their defaults
+     */
+    void LoadFromJson(const std::string& matcher_config);
+  };
+
+  struct Result {
+    Eigen::Matrix4d T_REF_TGT{Eigen::Matrix4d::Identity()};
+
+    /** inverse of the Gauss-Newton hessian at the solution scaled by the
+     * residual variance, ordered as (translation, rotation) like
+     * HessianCovariance */
+    Eigen::Matrix<double, 6, 6> covariance{
+        Eigen::Matrix<double, 6, 6>::Identity()};
+
+    int iterations{0};
+    int correspondences{0};
+  };
+
+  /**
+   * @brief check the matcher backend set in a matcher config
+   */
+  static bool RequestedInConfig(const std::string& matcher_config);
+
+  /**
+   * @brief check if this was built with CUDA support and a device is present
+   */
+  static bool Available();
+
+  /**
+   * @brief constructor, throws if Available() is false
+   */
+  explicit GpuGicpMatcher(const Params& params);
+
+  ~GpuGicpMatcher();
+
+  /**
+   * @brief align the target cloud to the reference cloud
+   * @param ref_key key of the reference cloud
+   * @param ref reference cloud, only read if not already on the device
+   * @param tgt_key key of the target cloud
+   * @param tgt target cloud, only read if not already on the device
+   * @param T_REF_TGT_init initial guess
+   * @param result output
+   * @return false if there were not enough correspondences or the solve
+   * failed
+   */
+  bool Match(uint64_t ref_key, const PointCloud& ref, uint64_t tgt_key,
+             const PointCloud& tgt, const Eigen::Matrix4d& T_REF_TGT_init,
+             Result& result);
+
+  /**
+   * @brief release the device buffers of all clouds but these
+   */
+  void Retain(const std::unordered_set<uint64_t>& keys);
+
+  /**
+   * @brief get the number of clouds on the device
+   */
+  size_t NumClouds() const;
+
+private:
+  struct DeviceState;
+
+  /** cloud on the device, with its points and covariances on the host */
+  struct DeviceCloud;
+
+  /**
+   * @brief get a cloud, uploading it and computing its covariances if it's
+   * new. device_mutex_ must be held
+   */
+  std::shared_ptr<const DeviceCloud> GetCloud(uint64_t key,
+                                              const PointCloud& cloud);
+
+  Params params_;
+  mutable std::mutex device_mutex_;
+  std::unique_ptr<DeviceState> device_;
+  std::unordered_map<uint64_t, std::shared_ptr<const DeviceCloud>> clouds_;
+};
+
+}} // namespace bs_models::scan_registration
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models { namespace scan_registration {
+
+/**
+ * @brief Cheap covariance of a registration result, used instead of asking the
+ * matcher to estimate it. The reference clouds are binned into voxels and the
+ * planar (or linear, for edges) voxels are fit once per reference. Each point
+ * of the aligned target is then matched to the voxel it falls in, which gives
+ * the point to plane (or point to line) residuals and Jacobians of the final
+ * alignment in a single pass over the target, without any nearest neighbour
+ * search. The covariance is the inverse of the approximate Hessian J^T J of
+ * these correspondences scaled by the residual variance:
+ *
+ *   covariance = sigma^2 * (J^T J)^-1, sigma^2 = sum(r^2) / (m - 6)
+ *
+ * where m is the number of scalar residuals. The covariance is ordered as
+ * (translation, rotation), with the translation perturbed in the reference
+ * frame and the rotation in the target frame, which is the convention of the
+ * relative pose constraints when the reference is the previous scan.
+ */
+class HessianCovariance {
+public:
+  struct Params {
+    /** if false, registrations use the covariance of the matcher */
+    bool enabled{false};
+
+    double voxel_size{1.0};
+
+    int min_points_per_voxel{5};
+
+    /** a voxel is planar if its smallest eigenvalue is below this fraction of
+     * the middle one */
+    double planarity_threshold{0.1};
+
+    /** a voxel is linear if its middle eigenvalue is below this fraction of
+     * the largest one */
+    double linearity_threshold{0.1};
+
+    /** correspondences with larger residuals are treated as outliers */
+    double max_residual_m{0.3};
+
+    /** lower bound on the residual standard deviation, so near perfect
+     * matches do not give overconfident constraints */
+    double min_residual_std_m{0.01};
+
+    /** min number of correspondences, the matcher covariance is used below
+     * this */
+    int min_correspondences{50};
+
+    /** lower bound on the Hessian eigenvalues, unconstrained directions get a
+     * large but finite covariance */
+    double min_information{1e-6};
+
+    void LoadFromJson(const nlohmann::json& J);
+
+    void Print(std::ostream& stream = std::cout) const;
+  };
+
+  explicit HessianCovariance(const Params& params) : params_(params) {}
+
+  /**
+   * @brief fit the voxels of the reference clouds
+   * @param plane_clouds reference clouds fit with planes (e.g., surfaces)
+   * @param line_clouds reference clouds fit with lines (e.g., edges)
+   */
+  void SetReference(const std::vector<const PointCloud*>& plane_clouds,
+                    const std::vector<const PointCloud*>& line_clouds);
+
+  /**
+   * @brief compute the covariance of an alignment to the reference
+   * @param plane_clouds target clouds matched to the reference planes
+   * @param line_clouds target clouds matched to the reference lines
+   * @param T_REF_TARGET transform that brings the target clouds into the
+   * reference frame, i.e. the alignment result
+   * @param covariance output covariance
+   * @return false if there are too few correspondences
+   */
+  bool Compute(const std::vector<const PointCloud*>& plane_clouds,
+               const std::vector<const PointCloud*>& line_clouds,
+               const Eigen::Matrix4d& T_REF_TARGET,
+               Eigen::Matrix<double, 6, 6>& covariance);
+
+  /**
+   * @brief number of correspondences used by the last call to Compute
+   */
+  int NumCorrespondences() const { return num_correspondences_; }
+
+private:
+  struct Feature {
+    Eigen::Vector3d mean;
+
+    /** plane normal or line direction */
+    Eigen::Vector3d direction;
+  };
+
+  Params params_;
+  std::unordered_map<uint64_t, Feature> planes_;
+  std::unordered_map<uint64_t, Feature> lines_;
+  int num_correspondences_{0};
+};
+
+}} // namespace bs_models::scan_registration
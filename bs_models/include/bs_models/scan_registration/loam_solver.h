@@ -0,0 +1,201 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include <beam_matching/loam/LoamPointCloud.h>
+#include <beam_utils/pointclouds.h>
+
+namespace bs_models { namespace scan_registration {
+
+/**
+ * @brief Gauss-Newton / Levenberg-Marquardt solver for the alignment of a loam
+ * cloud to a reference loam cloud, used instead of beam_matching::LoamMatcher
+ * which evaluates each correspondence through its own ceres cost functor.
+ *
+ * Each strong edge of the target is matched to a line fit to its nearest
+ * reference edges, and each strong surface to a plane fit to its nearest
+ * reference surfaces. A plane gives one residual along its normal and a line
+ * two, along the two eigenvectors orthogonal to its direction, so all
+ * residuals are point to plane residuals:
+ *
+ *   r = n^T (R * q + t) - d
+ *
+ * with q in the target frame and (n, d) in the reference frame. These are
+ * packed into structure of arrays buffers, and the residuals, Jacobians and
+ * the normal equations of all correspondences are evaluated with coefficient
+ * wise Eigen array expressions, which are vectorized, instead of one point at
+ * a time. The nearest neighbour search is the expensive part, so the
+ * correspondences are kept across iterations until the estimate moved more
+ * than the reuse thresholds from the pose they were found at.
+ *
+ * The pose is perturbed as p = R * exp(dR) * q + t + dt, so the covariance is
+ * ordered as (translation, rotation), with the translation in the reference
+ * frame and the rotation in the target frame, the same as HessianCovariance.
+ */
+class LoamSolver {
+public:
+  struct Params {
+    /** if false, registrations use the LoamMatcher */
+    bool enabled{false};
+
+    int max_iterations{30};
+
+    /** number of reference points a line or plane is fit to */
+    int num_neighbors{5};
+
+    /** correspondences with a neighbor further than this are rejected */
+    double max_correspondence_distance_m{1.0};
+
+    /** a neighborhood is linear if its middle eigenvalue is below this
+     * fraction of the largest one */
+    double linearity_threshold{0.33};
+
+    /** a neighborhood is planar if its smallest eigenvalue is below this
+     * fraction of the middle one */
+    double planarity_threshold{0.3};
+
+    /** residuals are weighted with a huber loss of this width */
+    double huber_delta_m{0.1};
+
+    /** correspondences are searched again once the estimate moved more than
+     * this since the last search */
+    double reuse_correspondences_trans_m{0.05};
+    double reuse_correspondences_rot_deg{0.5};
+
+    /** converged once an update is smaller than both of these */
+    double convergence_trans_m{1e-4};
+    double convergence_rot_deg{1e-3};
+
+    /** min number of residuals, the match fails below this */
+    int min_residuals{50};
+
+    /** lower bound on the residual standard deviation of the covariance */
+    double min_residual_std_m{0.01};
+
+    /** lower bound on the Hessian eigenvalues of the covariance */
+    double min_information{1e-6};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    void Print(std::ostream& stream = std::cout) const;
+  };
+
+  explicit LoamSolver(const Params& params);
+
+  /**
+   * @brief build the kd-trees of the strong and weak edges and surfaces of
+   * the reference
+   */
+  void SetRef(const beam_matching::LoamPointCloudPtr& ref);
+
+  /**
+   * @brief set the cloud to align, only its strong features are used. It is
+   * not copied, so it must outlive the calls to Match
+   */
+  void SetTarget(const beam_matching::LoamPointCloud& target);
+
+  /**
+   * @brief align the target to the reference
+   * @param T_REF_TARGET_INIT initial estimate
+   * @return false if there are too few correspondences
+   */
+  bool Match(const Eigen::Matrix4d& T_REF_TARGET_INIT =
+                 Eigen::Matrix4d::Identity());
+
+  /**
+   * @brief transform that brings the target into the reference frame
+   */
+  const Eigen::Matrix4d& GetResult() const { return T_REF_TARGET_; }
+
+  /**
+   * @brief sigma^2 * H^-1 at the result, see the class description for the
+   * ordering
+   */
+  const Eigen::Matrix<double, 6, 6>& GetCovariance() const {
+    return covariance_;
+  }
+
+  int NumIterations() const { return num_iterations_; }
+
+  /**
+   * @brief number of correspondence searches in the last call to Match
+   */
+  int NumCorrespondenceSearches() const { return num_searches_; }
+
+  /**
+   * @brief number of residuals of the last correspondence search
+   */
+  size_t NumResiduals() const { return residuals_.Size(); }
+
+private:
+  /**
+   * @brief point to plane residuals, as structure of arrays
+   */
+  struct Residuals {
+    std::vector<double> qx, qy, qz;
+    std::vector<double> nx, ny, nz;
+    std::vector<double> d;
+
+    void Clear();
+
+    void Add(const Eigen::Vector3d& q, const Eigen::Vector3d& n, double d);
+
+    size_t Size() const { return d.size(); }
+  };
+
+  /**
+   * @brief a kd-tree and the cloud it was built on
+   */
+  struct FeatureTree {
+    PointCloudPtr cloud;
+    pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
+    bool empty{true};
+
+    void Build(const std::vector<const PointCloud*>& clouds);
+  };
+
+  /**
+   * @brief search the correspondences of the target features at a pose
+   */
+  void FindCorrespondences(const Eigen::Matrix3d& R, const Eigen::Vector3d& t);
+
+  /**
+   * @brief add the residuals of a cloud matched to lines (if linear) or
+   * planes
+   */
+  void AddCorrespondences(const PointCloud& cloud, const FeatureTree& tree,
+                          bool linear, const Eigen::Matrix3d& R,
+                          const Eigen::Vector3d& t);
+
+  /**
+   * @brief evaluate the huber cost of all residuals at a pose and, if H is
+   * not null, the weighted normal equations H dx = -g
+   * @return cost
+   */
+  double Evaluate(const Eigen::Matrix3d& R, const Eigen::Vector3d& t,
+                  Eigen::Matrix<double, 6, 6>* H = nullptr,
+                  Eigen::Matrix<double, 6, 1>* g = nullptr,
+                  double* weighted_sq = nullptr) const;
+
+  Params params_;
+  FeatureTree ref_edges_;
+  FeatureTree ref_surfaces_;
+  const beam_matching::LoamPointCloud* target_{nullptr};
+  Residuals residuals_;
+
+  Eigen::Matrix4d T_REF_TARGET_{Eigen::Matrix4d::Identity()};
+  Eigen::Matrix<double, 6, 6> covariance_{
+      Eigen::Matrix<double, 6, 6>::Identity()};
+  int num_iterations_{0};
+  int num_searches_{0};
+};
+
+}} // namespace bs_models::scan_registration
@@ -1,14 +1,18 @@
 #pragma once
 
-#include <list>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <beam_matching/Matcher.h>
 #include <beam_matching/loam/LoamPointCloud.h>
 #include <beam_utils/pointclouds.h>
 
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
+#include <bs_models/lidar/filter_pipeline.h>
 #include <bs_models/lidar/scan_pose.h>
+#include <bs_models/scan_registration/gpu_gicp_matcher.h>
+#include <bs_models/scan_registration/scan_pose_buffer.h>
 #include <bs_models/scan_registration/scan_registration_base.h>
 
 static bool _tmp_bool{true};
@@ -37,6 +41,15 @@ public:
     /** Set this to true if you don't want to build a lidar map */
     bool disable_lidar_map{false};
 
+    /** number of real-time tasks of the shared task scheduler used to match
+     * against the reference scans in parallel. One matcher is created per
+     * task. */
+    int num_threads{1};
+
+    /** voxel size used to downsample clouds before matching, 0 to match the
+     * full clouds. Only used by non-loam matchers. */
+    double match_voxel_size{0};
+
     /** load derived params & base params */
     void LoadFromJson(const std::string& config);
 
@@ -70,6 +83,15 @@ public:
   inline MultiScanRegistrationBase::Params GetParams() const { return params_; }
 
 protected:
+  /**
+   * @brief Results from matching a target scan against a reference scan
+   */
+  struct MatchResult {
+    Eigen::Matrix4d T_RefEst_Ref{Eigen::Matrix4d::Identity()};
+    Eigen::Matrix4d T_LIDARREF_LIDARTGT{Eigen::Matrix4d::Identity()};
+    Eigen::Matrix<double, 6, 6> covariance;
+  };
+
   /**
    * @brief Add scan to lidar map, if not disabled, and add prior to the
    * transaction
@@ -84,7 +106,7 @@ protected:
    * also clears the oldest scans if the list is larger than the max allowable
    * @param scan new scan pose to add
    */
-  void InsertCloudInReferences(const ScanPose& scan);
+  void InsertCloudInReferences(const ScanPoseBuffer::ScanPosePtr& scan);
 
   /**
    * @brief Registers a scan pose to all scan poses stored in the reference
@@ -97,11 +119,32 @@ protected:
 
   /**
    * @brief pure virtual function that must be overridden in each derived multi
-   * scan registration classes
+   * scan registration classes. This runs the matcher but does not validate the
+   * result. It must be safe to call concurrently with different matcher
+   * indices.
+   * @param scan_pose_ref reference scan
+   * @param scan_pose_tgt target scan
+   * @param matcher_index index of the matcher to use, in [0, NumMatchers())
+   * @param result reference to results to fill
+   * @return true if the matcher succeeded
    */
   virtual bool MatchScans(const ScanPose& scan_pose_ref,
-                          const ScanPose& scan_pose_tgt,
-                          Eigen::Matrix4d& T_LIDARREF_LIDARTGT) = 0;
+                          const ScanPose& scan_pose_tgt, int matcher_index,
+                          MatchResult& result) = 0;
+
+  /**
+   * @brief number of matchers available, this is the max number of matches
+   * that can be run in parallel
+   */
+  virtual int NumMatchers() const = 0;
+
+  /**
+   * @brief called once before matching a target scan against all reference
+   * scans, so derived classes can prepare the data shared by these matches.
+   * This is never called concurrently with MatchScans.
+   * @param scan_pose_tgt target scan
+   */
+  virtual void PrepareTarget(const ScanPose& scan_pose_tgt) {}
 
   /**
    * @brief this function does 3 things:
@@ -118,13 +161,7 @@ protected:
    */
   void CleanUpScanLists(const ros::Time& new_scan_time);
 
-  inline std::list<ScanPose>::iterator Begin() {
-    return reference_clouds_.begin();
-  }
-
-  inline std::list<ScanPose>::iterator End() { return reference_clouds_.end(); }
-
-  inline int GetNumStoredScans() { return reference_clouds_.size(); }
+  inline int GetNumStoredScans() { return reference_clouds_.Size(); }
 
   void PrintScanDetails(std::ostream& stream = std::cout);
 
@@ -136,13 +173,13 @@ protected:
 
   // keep a list of reference clouds. These are scan poses which have already
   // been registered and are in the graph.
-  std::list<ScanPose> reference_clouds_;
+  ScanPoseBuffer reference_clouds_;
 
   // keep a list of unregistered clouds. These are scan poses which failed the
   // scan matching, often because they did not pass the motion threshold. We
   // want to keep some of these to see if they can eventually be registered to
   // another scan and included in the graph.
-  std::list<ScanPose> unregistered_clouds_;
+  ScanPoseBuffer unregistered_clouds_;
 
   // set a max amount of clouds to keep as unregistered. This can only be
   // editted here.
@@ -154,6 +191,9 @@ protected:
 
   std::string current_scan_path_; // when output dir is set
   PointCloudCol coord_frame_;
+
+  // set to true by derived classes that should also output loam clouds
+  bool output_loam_results_{false};
 };
 
 class MultiScanLoamRegistration : public MultiScanRegistrationBase {
@@ -167,11 +207,22 @@ public:
                             int num_neighbors = 10, double lag_duration = 0,
                             bool disable_lidar_map = false);
 
+  /**
+   * @brief constructor that takes one matcher per thread, references will be
+   * matched in parallel if more than one matcher is given
+   */
+  MultiScanLoamRegistration(std::vector<std::unique_ptr<LoamMatcher>> matchers,
+                            const ScanRegistrationParamsBase& base_params,
+                            int num_neighbors = 10, double lag_duration = 0,
+                            bool disable_lidar_map = false);
+
 private:
   bool MatchScans(const ScanPose& scan_pose_ref, const ScanPose& scan_pose_tgt,
-                  Eigen::Matrix4d& T_LIDARREF_LIDARTGT) override;
+                  int matcher_index, MatchResult& result) override;
 
-  std::unique_ptr<LoamMatcher> matcher_;
+  int NumMatchers() const override { return matchers_.size(); }
+
+  std::vector<std::unique_ptr<LoamMatcher>> matchers_;
 };
 
 class MultiScanRegistration : public MultiScanRegistrationBase {
@@ -185,11 +236,57 @@ public:
                         int num_neighbors = 10, double lag_duration = 0,
                         bool disable_lidar_map = false);
 
+  /**
+   * @brief constructor that takes one matcher per thread, references will be
+   * matched in parallel if more than one matcher is given
+   */
+  MultiScanRegistration(
+      std::vector<std::unique_ptr<PointcloudMatcher>> matchers,
+      const ScanRegistrationParamsBase& base_params, int num_neighbors = 10,
+      double lag_duration = 0, bool disable_lidar_map = false);
+
+  /**
+   * @brief if set greater than 0, clouds are downsampled with a voxel grid of
+   * this size before matching. Nearest neighbour searches and covariance
+   * estimation (e.g., for GICP) scale with the number of points, so this is
+   * where most of the matching time goes for dense lidars.
+   */
+  void SetMatchVoxelSize(double voxel_size);
+
+  /**
+   * @brief match on the GPU with this matcher instead of the matchers given
+   * to the constructor, which are kept as the CPU backend. See GpuGicpMatcher
+   */
+  void SetGpuMatcher(std::unique_ptr<GpuGicpMatcher> matcher);
+
 private:
   bool MatchScans(const ScanPose& scan_pose_ref, const ScanPose& scan_pose_tgt,
-                  Eigen::Matrix4d& T_LIDARREF_LIDARTGT) override;
+                  int matcher_index, MatchResult& result) override;
+
+  int NumMatchers() const override { return matchers_.size(); }
+
+  /**
+   * @brief prepare the cloud of the target for matching and drop the clouds of
+   * scans that are no longer references
+   */
+  void PrepareTarget(const ScanPose& scan_pose_tgt) override;
+
+  /**
+   * @brief get the (downsampled) cloud of a scan to match. This is the cached
+   * cloud if the scan was prepared, otherwise it is computed
+   */
+  PointCloudPtr GetMatchCloud(const ScanPose& scan_pose) const;
+
+  std::vector<std::unique_ptr<PointcloudMatcher>> matchers_;
+
+  FilterPipeline<pcl::PointXYZ> match_filter_;
+
+  /** clouds to match by scan stamp in nsec, these are computed once per scan
+   * and shared by all matches instead of copying the scan cloud each time */
+  std::unordered_map<uint64_t, PointCloudPtr> match_clouds_;
 
-  std::unique_ptr<PointcloudMatcher> matcher_;
+  /** shared by all matching threads if set */
+  std::unique_ptr<GpuGicpMatcher> gpu_matcher_;
 };
 
 } // namespace bs_models::scan_registration
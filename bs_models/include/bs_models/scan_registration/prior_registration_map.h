@@ -0,0 +1,127 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_matching/loam/LoamPointCloud.h>
+
+#include <bs_models/global_mapping/global_map.h>
+#include <bs_models/global_mapping/submap_position_index.h>
+#include <bs_models/global_mapping/submap_working_set.h>
+#include <bs_models/scan_registration/voxel_map.h>
+
+namespace bs_models { namespace scan_registration {
+
+/**
+ * @brief Read-only lidar map built from a global map saved by a previous
+ * session, used to localize against a fixed map instead of building a new
+ * RegistrationMap. The submaps of the global map are the tiles of this map:
+ * they are loaded from the map store without their lidar clouds, and only the
+ * tiles within tile_radius_m of the robot are paged in (see SubmapWorkingSet)
+ * and merged into the map in the world frame. Tiles are added and removed
+ * incrementally as the robot moves, so the map size, and with it the
+ * registration cost and memory, stays bounded by the tile radius.
+ *
+ * Like RegistrationMap::GetLoamCloudMapPtr, the returned map is never modified
+ * and a new one is only built when the active tiles change, so its pointer
+ * tells whether structures built on it (e.g., matcher kd-trees) are still
+ * valid. This class is not thread safe.
+ */
+class PriorRegistrationMap {
+public:
+  struct Params {
+    /** submaps within this distance of the robot are paged in */
+    double tile_radius_m{60};
+
+    /** the active tiles are only updated once the robot moved this far since
+     * the last update */
+    double update_distance_m{5};
+
+    /** if greater than 0, the strong features of the map are downsampled with
+     * a voxel grid of this size */
+    double downsample_voxel_size{-1};
+
+    /** max estimated memory of the submap clouds kept loaded, see
+     * SubmapWorkingSet */
+    double memory_budget_mb{1024};
+  };
+
+  /**
+   * @brief load a global map, without its lidar clouds
+   * @param global_map_path root directory of a global map saved with its map
+   * store
+   */
+  PriorRegistrationMap(const std::string& global_map_path,
+                       const Params& params);
+
+  /**
+   * @brief constructor over submaps that were loaded without their lidar
+   * clouds
+   * @param submaps submaps in the order of the map store
+   * @param map_store open map store the submaps were loaded from
+   */
+  PriorRegistrationMap(
+      const std::vector<global_mapping::SubmapPtr>& submaps,
+      const std::shared_ptr<const bs_common::ChunkFileReader>& map_store,
+      const Params& params);
+
+  /**
+   * @brief page in the tiles around a position, if the robot moved enough
+   * since the last update. When no tile is within the radius the closest one
+   * is used
+   * @param position robot position in the world frame
+   * @return true if the active tiles changed
+   */
+  bool Update(const Eigen::Vector3d& position);
+
+  /**
+   * @brief get the map of the active tiles in the world frame, empty until
+   * the first update
+   */
+  beam_matching::LoamPointCloudPtr GetLoamCloudMapPtr() const { return map_; }
+
+  /**
+   * @brief get the ids (submap indices) of the active tiles
+   */
+  std::vector<size_t> ActiveTiles() const;
+
+  size_t NumTiles() const { return submaps_.size(); }
+
+  /**
+   * @brief estimated memory of the submap clouds currently loaded
+   */
+  size_t MemoryUsage() const { return working_set_->MemoryUsage(); }
+
+private:
+  using LoamFeatureCloud =
+      decltype(std::declval<beam_matching::LoamPointCloud>().edges.strong.cloud);
+  using LoamFeaturePointT = LoamFeatureCloud::PointType;
+
+  void
+      Setup(const std::shared_ptr<const bs_common::ChunkFileReader>& map_store);
+
+  /**
+   * @brief merge the active tiles into a new map
+   */
+  void BuildMap();
+
+  Params params_;
+  std::shared_ptr<global_mapping::GlobalMap> global_map_;
+  std::vector<global_mapping::SubmapPtr> submaps_;
+  std::shared_ptr<global_mapping::SubmapWorkingSet> working_set_;
+  global_mapping::SubmapPositionIndex tile_index_;
+
+  // active tiles in the world frame
+  std::map<size_t, beam_matching::LoamPointCloud> tiles_;
+  VoxelMap<LoamFeaturePointT> edges_strong_voxel_map_;
+  VoxelMap<LoamFeaturePointT> surfaces_strong_voxel_map_;
+  beam_matching::LoamPointCloudPtr map_;
+  std::optional<Eigen::Vector3d> last_update_position_;
+};
+
+}} // namespace bs_models::scan_registration
@@ -1,60 +1,181 @@
 #pragma once
 
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
 #include <fuse_core/graph.h>
 #include <fuse_core/uuid.h>
+#include <nlohmann/json.hpp>
 #include <ros/publisher.h>
 
 #include <beam_matching/loam/LoamPointCloud.h>
 #include <beam_utils/pointclouds.h>
 #include <beam_utils/time.h>
 
+#include <bs_common/graph_view.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_models/scan_registration/voxel_map.h>
+
 namespace bs_models { namespace scan_registration {
 
 /**
- * @brief class for building, maintaining, and storing a lidar map. This class
- * is implemented as a singleton because there should only be one lidar map
- * being built for each slam session, and it should be accessible by different
- * classes or sensor models. For example, ScanToMapRegistration may be building
- * this map and using it for generating frame to frame constraints, whereas the
- * sensor model that generates lidar-camera constraints will need to access a
- * lidar map of its local environment. So to remove computation duplication we
- * can use the map we are already generating with the scan to map registration.
+ * @brief class for building, maintaining, and storing a lidar map. A map is
+ * usually shared between different classes or sensor models. For example,
+ * ScanToMapRegistration may be building this map and using it for generating
+ * frame to frame constraints, whereas the sensor model that generates
+ * lidar-camera constraints will need to access a lidar map of its local
+ * environment. So to remove computation duplication we can use the map we are
+ * already generating with the scan to map registration.
+ *
+ * Shared maps are looked up by name with GetNamedInstance (GetInstance returns
+ * the default map used by a single lidar slam session), and independent maps
+ * (e.g., one per lidar, or for offline tools and tests) can be constructed
+ * directly. All methods lock a mutex of the instance, so different maps never
+ * block each other.
  */
 class RegistrationMap {
 public:
   struct ScanPoseInMapFrame {
     Eigen::Matrix4d T_Map_Scan;
+
+    /** points in the map frame, or in the scan frame if storing scans in the
+     * sensor frame */
     PointCloud cloud;
     beam_matching::LoamPointCloud loam_cloud;
     fuse_core::UUID orientation_uuid;
     fuse_core::UUID position_uuid;
+
+    /** frame of the sensor the scan was taken with, empty if unknown */
+    std::string sensor_frame;
+
+    /** pose the scan was added to the voxel maps with, only used when storing
+     * scans in the sensor frame */
+    mutable Eigen::Matrix4d T_Map_Scan_voxel_maps;
+
+    /** sorted keys of the coverage voxels of the scan in the map frame, only
+     * used with coverage based retention. These are cleared when the scan
+     * moves and computed again when needed */
+    mutable std::vector<uint64_t> coverage_voxels;
   };
 
   /**
-   * @brief Static Instance getter (singleton)
-   * @return reference to the singleton
+   * @brief which scans are kept in the map, see SetRetentionParams
+   */
+  struct RetentionParams {
+    /** if false, the oldest scans are removed once the map is full */
+    bool coverage_based{false};
+
+    /** size of the voxels used to compare the coverage of scans */
+    double coverage_voxel_size_m{1.0};
+
+    /** an old scan is replaced by a new scan which covers at least this
+     * fraction of its voxels */
+    double redundancy_threshold{0.9};
+
+    /** scans further than this from the newest scan are removed, disabled if
+     * not positive */
+    double max_distance_m{-1};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    void Print(std::ostream& stream = std::cout) const;
+  };
+
+  /**
+   * @brief constructor
+   * @param name name of the map, this is used in the topics the map is
+   * published to
+   */
+  explicit RegistrationMap(const std::string& name = "");
+
+  /**
+   * @brief get the map shared by all users of this name within the process,
+   * it is created on the first call
+   */
+  static std::shared_ptr<RegistrationMap>
+      GetNamedInstance(const std::string& name);
+
+  /**
+   * @brief get the default shared map, same as GetNamedInstance("")
+   * @return reference to the default map
    */
   static RegistrationMap& GetInstance();
 
   /**
-   * @brief if not set to -1, we will run a voxel
-   * downsample filter each time GetLoamCloudMap or  GetPointCloudMap is called.
-   * For the loam cloud, we filter each set of features separately
+   * @brief if not set to -1, the map will be downsampled using a voxel grid of
+   * this size. Downsampled maps are maintained incrementally as scans are
+   * added, updated or removed so GetLoamCloudMap and GetPointCloudMap do not
+   * need to merge and filter all scans on each call. For the loam cloud, we
+   * only downsample the strong features, each set separately
    */
   void SetVoxelDownsampleSize(double downsample_voxel_size);
 
+  /**
+   * @brief set the voxel sizes of the coarse levels of the map, for coarse to
+   * fine registration. Level 0 is the map itself, and level i is downsampled
+   * with voxel_sizes[i - 1], which must be positive and increasing. Coarse
+   * levels only contain the strong loam features, and are maintained
+   * incrementally the same way as the downsampled map. Set to an empty vector
+   * to only keep the map itself
+   */
+  void SetPyramidVoxelSizes(const std::vector<double>& voxel_sizes);
+
+  /**
+   * @brief number of levels of the map, including the map itself
+   */
+  int NumPyramidLevels() const;
+
   /**
    * @brief map_size: number of scans to store in this map. If already set,
    * it'll override and purge extra clouds
    */
   void SetMapSize(int map_size);
 
+  /**
+   * @brief set which scans are kept in the map. By default, the oldest scans
+   * are removed once there are more than map_size scans. With coverage based
+   * retention, a new scan replaces the scans whose coverage voxels it mostly
+   * covers, so a slow or stationary robot does not fill the map with
+   * redundant scans, and the scans furthest from the newest scan are removed
+   * once the map is full, instead of the oldest, so the map keeps the
+   * geometry around the robot when it moves fast
+   */
+  void SetRetentionParams(const RetentionParams& params);
+
   /**
    * @brief if set to true, this class with publish the full
-   * lidar map in the world frame whenever the map is updated
+   * lidar map in the world frame whenever the map is updated, and each new
+   * scan in the world frame when it is added (at its pose at that time). Maps
+   * and scans are only built and serialized if their topics have subscribers.
    */
   void SetPublishUpdates(bool publish_updates);
 
+  /**
+   * @brief set the min time between full map publishes, updates in between
+   * are not published. New scans are still published as they are added.
+   */
+  void SetMinPublishPeriod(double min_publish_period_s);
+
+  /**
+   * @brief if set to true, scans are stored in their sensor frame and their
+   * pose is only applied when the map is queried, instead of transforming the
+   * points each time a scan pose is updated. Updating poses from the graph
+   * then only stores the new poses, and the map (or the downsampled map if
+   * downsampling is enabled) is rebuilt for the scans that moved the next time
+   * it is requested. This is useful when poses are updated more often than
+   * the map is used (e.g., when updating all scans on every graph update).
+   * Existing scans are converted.
+   */
+  void SetStoreScansInSensorFrame(bool store_scans_in_sensor_frame);
+
   /**
    * @brief return map size
    * @return map_size
@@ -80,15 +201,20 @@ public:
    * @param loam_cloud loam pointcloud to add (in some scan frame)
    * @param stamp timestamp associated with this scan. This is used to queue the
    * clouds in the map, which will remove the oldest maps once the map gets
-   * larger than the max size
+   * larger than the max size, or once its memory account (see
+   * bs_common::MemoryAccounting) is over budget
    * @param T_Map_Scan ransform from scan frame to map frame. This
    * will be applied to the scan before adding (to reduce computation, assuming
    * we will be frequently asking for the full map). The map frame is usually
    * the world frame.
+   * @param sensor_frame frame of the sensor the scan was taken with. This is
+   * needed to get the baselink pose of scans when a map is built from multiple
+   * lidars
    */
   void AddPointCloud(const PointCloud& cloud,
                      const beam_matching::LoamPointCloud& loam_cloud,
-                     const ros::Time& stamp, const Eigen::Matrix4d& T_Map_Scan);
+                     const ros::Time& stamp, const Eigen::Matrix4d& T_Map_Scan,
+                     const std::string& sensor_frame = "");
 
   /**
    * @brief returns combined pointcloud in map frame
@@ -102,6 +228,17 @@ public:
    */
   beam_matching::LoamPointCloud GetLoamCloudMap() const;
 
+  /**
+   * @brief same as above without copying the map. The returned cloud is
+   * shared with the map and all other callers so it must not be modified. It
+   * is never changed by the map either: a new cloud is built the next time the
+   * map is queried after it changed, so callers can compare the pointers to
+   * know whether structures built on a previous map (e.g., the kd-trees of a
+   * matcher reference) are still valid.
+   * @param level level of the map, see SetPyramidVoxelSizes
+   */
+  beam_matching::LoamPointCloudPtr GetLoamCloudMapPtr(int level = 0) const;
+
   /**
    * @brief Updates all points in a scan if that scan is currently saved in the
    * map. It does this by checking for the timestmap in the loam_cloud_poses_ &
@@ -143,6 +280,16 @@ public:
    */
   bool GetScanPose(const ros::Time& stamp, Eigen::Matrix4d& T_Map_Scan) const;
 
+  /**
+   * @brief get the frame of the sensor a scan was taken with
+   * @param stamp when scan was collected
+   * @param sensor_frame reference to frame id, empty if it was not set when
+   * adding the scan
+   * @return true if scan with this timestamp exists
+   */
+  bool GetScanSensorFrame(const ros::Time& stamp,
+                          std::string& sensor_frame) const;
+
   /**
    * @brief get a scan collected at some timestamp, with points expressed in the
    * map frame
@@ -181,6 +328,11 @@ public:
   void UpdateScanPosesFromGraphMsg(
       const fuse_core::Graph::ConstSharedPtr& graph_msg);
 
+  /**
+   * @brief same as above but using a view of the graph message
+   */
+  void UpdateScanPosesFromGraphMsg(const bs_common::GraphView& graph_view);
+
   /**
    * @brief to correct for drift, we take the most recent scan pose in the
    * registration map that has a pose in the graph, calculate the difference
@@ -202,7 +354,8 @@ public:
 
   /**
    * @brief publish the current map. This gets called each time the map saves,
-   * if publish_updates_ is set to true
+   * if publish_updates_ is set to true, and at most once per min publish
+   * period
    */
   void Publish();
 
@@ -217,30 +370,150 @@ public:
   void operator=(RegistrationMap const&) = delete;
 
 private:
+  using LoamFeatureCloud =
+      decltype(std::declval<beam_matching::LoamPointCloud>().edges.strong.cloud);
+  using LoamFeaturePointT = LoamFeatureCloud::PointType;
+
+  /**
+   * @brief coarse level of the map, see SetPyramidVoxelSizes
+   */
+  struct PyramidLevel {
+    explicit PyramidLevel(double voxel_size)
+        : edges_strong_voxel_map(voxel_size),
+          surfaces_strong_voxel_map(voxel_size) {}
+
+    VoxelMap<LoamFeaturePointT> edges_strong_voxel_map;
+    VoxelMap<LoamFeaturePointT> surfaces_strong_voxel_map;
+    bool outdated{true};
+    beam_matching::LoamPointCloudPtr map;
+  };
+
+  /**
+   * @brief true if scans are added to voxel maps, i.e. if downsampling or
+   * coarse levels are enabled
+   */
+  bool UsesVoxelMaps() const {
+    return downsample_voxel_size_ != -1 || !pyramid_.empty();
+  }
+
   /**
-   * @brief constructor. Uses default member variables
+   * @brief mark all cached maps as outdated
    */
-  RegistrationMap();
+  void MarkMapsOutdated() const;
 
-  PointCloud DownsampleCloud(const PointCloud& cloud_in) const;
+  /**
+   * @brief remove a scan from the map
+   */
+  void RemoveScan(std::map<uint64_t, ScanPoseInMapFrame>::iterator scan);
 
-  pcl::PointCloud<PointXYZIRT>
-      DownsampleCloud(const pcl::PointCloud<PointXYZIRT>& cloud_in) const;
+  /**
+   * @brief remove a scan when the map is full: the oldest one, or with
+   * coverage based retention the one furthest from the newest scan
+   */
+  void EvictScan();
+
+  /**
+   * @brief remove the scans made redundant by a new scan or too far from it,
+   * only used with coverage based retention
+   */
+  void RemoveRedundantScans(uint64_t new_stamp_ns);
+
+  /**
+   * @brief compute the coverage voxels of a scan if they are not up to date
+   */
+  void UpdateCoverageVoxels(const ScanPoseInMapFrame& scan) const;
+
+  /**
+   * @brief update the memory account of this map with the points of all scans
+   * (not including the downsampled maps)
+   */
+  void UpdateMemoryAccount();
+
+  /**
+   * @brief add a scan to the voxel maps (only if downsampling or coarse
+   * levels are enabled)
+   */
+  void AddScanToVoxelMaps(uint64_t stamp_ns, const ScanPoseInMapFrame& scan);
+
+  /**
+   * @brief remove a scan from the voxel maps (only if downsampling or coarse
+   * levels are enabled)
+   */
+  void RemoveScanFromVoxelMaps(uint64_t stamp_ns,
+                               const ScanPoseInMapFrame& scan);
+
+  /**
+   * @brief rebuild the voxel maps from all scans, this is needed when the voxel
+   * sizes change
+   */
+  void RebuildVoxelMaps();
+
+  /**
+   * @brief publish a single scan in the map frame, this is called when a scan
+   * is added if publish_updates_ is set to true
+   */
+  void PublishScan(const ros::Time& stamp);
+
+  /**
+   * @brief mark a scan whose pose changed, only used when storing scans in the
+   * sensor frame
+   */
+  void MarkScanMoved(uint64_t stamp_ns);
+
+  /**
+   * @brief move the points of all scans whose pose changed since the last
+   * query to their new pose in the voxel maps. Only used when storing scans in
+   * the sensor frame.
+   */
+  void UpdateMovedScansInVoxelMaps() const;
+
+  /**
+   * @brief add or remove a scan from the voxel maps, with its points
+   * transformed by T_Map_Scan. Only used when storing scans in the sensor
+   * frame.
+   */
+  void UpdateVoxelMaps(uint64_t stamp_ns, const ScanPoseInMapFrame& scan,
+                       const Eigen::Matrix4d& T_Map_Scan, bool add) const;
 
   // publishers
   ros::Publisher lidar_map_publisher_;
   ros::Publisher loam_map_publisher_;
+  ros::Publisher lidar_scan_publisher_;
+  ros::Publisher loam_scan_publisher_;
 
-  std::mutex mutex_;
+  // recursive since public methods call each other (e.g., when publishing)
+  mutable std::recursive_mutex mutex_;
+  std::string name_;
+  bs_common::MemoryAccount* memory_account_;
   int map_size_{10};
+  RetentionParams retention_params_;
   double downsample_voxel_size_{-1};
+  std::vector<double> pyramid_voxel_sizes_;
   bool map_size_set_{false};
   int updates_counter_{0};
+  int scan_updates_counter_{0};
   bool publish_updates_{false};
+  ros::Duration min_publish_period_{0};
+  ros::Time last_publish_time_{0};
+  bool store_scans_in_sensor_frame_{false};
   std::string world_frame_id_;
 
   std::map<uint64_t, ScanPoseInMapFrame> scans_;
 
+  // incrementally maintained downsampled maps. When storing scans in the
+  // sensor frame, these are updated for the moved scans when queried
+  mutable VoxelMap<pcl::PointXYZ> cloud_voxel_map_;
+  mutable VoxelMap<LoamFeaturePointT> edges_strong_voxel_map_;
+  mutable VoxelMap<LoamFeaturePointT> surfaces_strong_voxel_map_;
+  mutable std::set<uint64_t> moved_scans_;
+  mutable std::vector<PyramidLevel> pyramid_;
+
+  // cached maps, these are regenerated only when the map has changed
+  mutable bool cloud_map_outdated_{true};
+  mutable bool loam_map_outdated_{true};
+  mutable PointCloud cloud_map_;
+  mutable beam_matching::LoamPointCloudPtr loam_map_;
+
   bool log_time_{false};
   mutable beam::HighResolutionTimer timer_;
 };
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <iostream>
 #include <list>
+#include <string>
+#include <vector>
 
 #include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+
+#include <beam_utils/pointclouds.h>
 
 namespace bs_models { namespace scan_registration {
 
@@ -59,4 +65,105 @@ private:
   double entropy_init_thresh_{-4}; // set empirically
 };
 
+/**
+ * @brief Cheap checks run before registration, to avoid paying for a full
+ * match on scans that cannot be registered reliably. Both checks use a coarse
+ * voxel grid over the target scan, already expressed in the reference frame
+ * at its estimated pose:
+ *
+ *  - Degeneracy: a normal is estimated for each planar voxel (smallest
+ *    eigenvector of the voxel point covariance), and the eigenvalues of the
+ *    normalized normal information matrix sum(n * n^T) / N tell how well each
+ *    translation direction is constrained. These sum to 1 and are 1/3 each for
+ *    a well constrained scan. Directions below degeneracy_threshold are
+ *    degenerate: one for a corridor (along the corridor), two for an open
+ *    field (both horizontal directions).
+ *  - Overlap: fraction of occupied target voxels that are also occupied by
+ *    the reference.
+ *
+ * The decision is then:
+ *  - REGISTER: scan is well constrained and overlaps the reference,
+ *  - CONSTRAINED: one degenerate direction, register but keep the prior along
+ *    the degenerate direction (see Result::degenerate_directions),
+ *  - USE_PRIOR: too little overlap or more than one degenerate direction, use
+ *    the estimated pose (i.e., the frame initializer prior) instead of
+ *    registering,
+ *  - SKIP: same as USE_PRIOR but when falling back to the prior is disabled,
+ *    so the scan is not registered at all.
+ *
+ * Only translational degeneracy is checked, rotation is rarely unconstrained
+ * in practice.
+ */
+class RegistrationPrecheck {
+public:
+  enum class Decision { REGISTER, CONSTRAINED, USE_PRIOR, SKIP };
+
+  struct Params {
+    /** if false, Check always returns REGISTER without doing any work */
+    bool enabled{false};
+
+    /** size of the voxels used for both normals and overlap */
+    double voxel_size{1.0};
+
+    /** min number of points for a voxel normal */
+    int min_points_per_voxel{5};
+
+    /** a voxel is planar if its smallest covariance eigenvalue is below this
+     * ratio of the middle one */
+    double planarity_threshold{0.1};
+
+    /** normalized normal information below which a direction is degenerate */
+    double degeneracy_threshold{0.03};
+
+    /** min fraction of overlapping voxels */
+    double min_overlap{0.3};
+
+    /** if false, scans that would use the prior are skipped instead */
+    bool allow_prior_fallback{true};
+
+    /** diagonal of the covariance used for constraints from the prior, and
+     * added along degenerate directions for constrained registrations */
+    double prior_covariance{0.1};
+
+    /** load from a json object, all keys are optional */
+    void LoadFromJson(const nlohmann::json& J);
+
+    void Print(std::ostream& stream = std::cout) const;
+  };
+
+  struct Result {
+    Decision decision{Decision::REGISTER};
+    double overlap{1};
+
+    /** eigenvalues of the normalized normal information, ascending */
+    Eigen::Vector3d information{Eigen::Vector3d::Constant(1.0 / 3)};
+
+    /** unit directions in the reference frame */
+    std::vector<Eigen::Vector3d> degenerate_directions;
+
+    int num_planar_voxels{0};
+  };
+
+  explicit RegistrationPrecheck(const Params& params = Params())
+      : params_(params) {}
+
+  void SetParams(const Params& params) { params_ = params; }
+
+  const Params& GetParams() const { return params_; }
+
+  /**
+   * @brief run the checks
+   * @param target_clouds clouds of the scan to register, in the reference
+   * frame at the estimated scan pose
+   * @param reference_clouds clouds that the scan will be registered against
+   */
+  Result Check(const std::vector<const PointCloud*>& target_clouds,
+               const std::vector<const PointCloud*>& reference_clouds) const;
+
+  static std::string DecisionToString(Decision decision);
+
+private:
+  Params params_;
+};
+
 }} // namespace bs_models::scan_registration
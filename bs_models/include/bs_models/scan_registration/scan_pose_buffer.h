@@ -0,0 +1,141 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+#include <ros/time.h>
+
+#include <bs_common/graph_view.h>
+#include <bs_models/lidar/scan_pose.h>
+
+namespace bs_models::scan_registration {
+
+/**
+ * @brief Scan poses sorted by stamp, stored as shared handles in a deque so
+ * that scans can be moved between buffers without copying their clouds. Scans
+ * mostly arrive in order and leave from the old end (lag duration or max
+ * size), so insertion and eviction are O(1) at the ends and lookups by stamp
+ * are a binary search. The pose variables of the scans are also indexed, so a
+ * graph update that carries a bs_common::GraphDelta only refreshes the scans
+ * whose variables changed instead of all of them.
+ */
+class ScanPoseBuffer {
+public:
+  using ScanPosePtr = std::shared_ptr<ScanPose>;
+  using const_iterator = std::deque<ScanPosePtr>::const_iterator;
+  using const_reverse_iterator =
+      std::deque<ScanPosePtr>::const_reverse_iterator;
+
+  /**
+   * @brief add a scan, keeping the stamps sorted
+   * @return false if a scan with the same stamp is already stored
+   */
+  bool Insert(const ScanPosePtr& scan);
+
+  /**
+   * @brief get a scan by stamp, nullptr if not found
+   */
+  ScanPosePtr Find(const ros::Time& stamp) const;
+
+  /**
+   * @brief remove a scan by stamp
+   * @return false if not found
+   */
+  bool Erase(const ros::Time& stamp);
+
+  /**
+   * @brief remove all scans for which pred(const ScanPose&) is true
+   * @return number of scans removed
+   */
+  template <typename Pred>
+  size_t EraseIf(Pred pred);
+
+  /**
+   * @brief remove all scans strictly older than a stamp
+   * @return number of scans removed
+   */
+  size_t EraseOlderThan(const ros::Time& stamp);
+
+  /**
+   * @brief remove the oldest scans until at most max_size are left
+   * @return number of scans removed
+   */
+  size_t TrimOldest(size_t max_size);
+
+  /**
+   * @brief update the poses of the scans from a graph message. If the graph
+   * carries a delta, only the scans with added or changed variables are
+   * updated, otherwise all scans are.
+   * @return number of scans updated
+   */
+  size_t UpdatePoses(const fuse_core::Graph::ConstSharedPtr& graph_msg);
+
+  /**
+   * @brief update the poses of the scans from a graph view and remove the
+   * scans that were marginalized, in one pass. If the graph of the view
+   * carries a delta, only the scans with added or changed variables are
+   * updated, along with the newest scans that were never updated. Otherwise
+   * all scans are updated. In both cases, the scans that were updated before
+   * but are no longer in the graph are marginalized, so no scan is left
+   * behind if the graphs with their removed variables were superseded.
+   * @param graph_view view of the graph message
+   * @param marginalized scans removed from the buffer, oldest first
+   * @return number of scans updated
+   */
+  size_t UpdatePoses(const bs_common::GraphView& graph_view,
+                     std::vector<ScanPosePtr>& marginalized);
+
+  size_t Size() const { return scans_.size(); }
+
+  bool Empty() const { return scans_.empty(); }
+
+  void Clear();
+
+  /** iterate from the oldest to the newest scan */
+  const_iterator begin() const { return scans_.begin(); }
+  const_iterator end() const { return scans_.end(); }
+
+  /** iterate from the newest to the oldest scan */
+  const_reverse_iterator rbegin() const { return scans_.rbegin(); }
+  const_reverse_iterator rend() const { return scans_.rend(); }
+
+private:
+  std::deque<ScanPosePtr>::const_iterator
+      LowerBound(const ros::Time& stamp) const;
+
+  void Unindex(const ScanPose& scan);
+
+  /**
+   * @brief add the stamps of the scans which own any of the variables
+   */
+  void AddStamps(const std::vector<fuse_core::UUID>& uuids,
+                 std::set<uint64_t>& stamps) const;
+
+  std::deque<ScanPosePtr> scans_;
+
+  // <variable uuid, scan stamp in nsec> for the pose variables of all scans
+  std::unordered_map<fuse_core::UUID, uint64_t, fuse_core::uuid::hash>
+      variables_;
+};
+
+template <typename Pred>
+size_t ScanPoseBuffer::EraseIf(Pred pred) {
+  const size_t size = scans_.size();
+  auto iter = scans_.begin();
+  for (auto& scan : scans_) {
+    if (pred(static_cast<const ScanPose&>(*scan))) {
+      Unindex(*scan);
+      continue;
+    }
+    *(iter++) = std::move(scan);
+  }
+  scans_.erase(iter, scans_.end());
+  return size - scans_.size();
+}
+
+} // namespace bs_models::scan_registration
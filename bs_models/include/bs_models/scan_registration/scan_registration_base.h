@@ -5,6 +5,7 @@
 #include <bs_common/extrinsics_lookup_online.h>
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
 #include <bs_models/lidar/scan_pose.h>
+#include <bs_models/scan_registration/hessian_covariance.h>
 #include <bs_models/scan_registration/registration_map.h>
 #include <bs_models/scan_registration/registration_validation.h>
 
@@ -40,6 +41,12 @@ struct ScanRegistrationParamsBase {
   /** If not empty, each method can save registration output to this path */
   std::string save_path;
 
+  /** cheap covariance estimation used instead of the matcher covariance, see
+   * HessianCovariance. This is optional in the config (json object
+   * "hessian_covariance") and disabled by default. A fixed covariance, if
+   * set, takes precedence. */
+  HessianCovariance::Params hessian_covariance;
+
   /** This will load the default params, and can be called by derived classes.
    */
   void LoadBaseFromJson(const std::string& config);
@@ -51,15 +58,18 @@ class ScanRegistrationBase {
 public:
   ScanRegistrationBase(const ScanRegistrationParamsBase& base_params);
 
-  ~ScanRegistrationBase() = default;
+  virtual ~ScanRegistrationBase() = default;
 
   /**
    * @brief Factory method to create a scan registration object at runtime
+   * @param map registration map to build. If null, the default shared map is
+   * used (see RegistrationMap::GetInstance)
    */
   static std::unique_ptr<ScanRegistrationBase>
       Create(const std::string& registration_config,
              const std::string& matcher_config,
-             const std::string& save_path = "", double extrinsics_prior = 0);
+             const std::string& save_path = "", double extrinsics_prior = 0,
+             const std::shared_ptr<RegistrationMap>& map = nullptr);
 
   void SetFixedCovariance(const Eigen::Matrix<double, 6, 6>& covariance);
 
@@ -69,6 +79,14 @@ public:
     extrinsics_prior_ = extrinsics_prior;
   }
 
+  /**
+   * @brief allocate the constraints and variables of registered scans from
+   * the pools of their types (see bs_common::MakePooled)
+   */
+  void SetUsePooledAllocation(bool use_pooled_allocation) {
+    use_pooled_allocation_ = use_pooled_allocation;
+  }
+
   /**
    * @brief pure virtual function that each derived class must implement. The
    * function must generate a frame to frame transaction of type
@@ -80,12 +98,54 @@ public:
   virtual bs_constraints::Pose3DStampedTransaction
       RegisterNewScan(const ScanPose& new_scan) = 0;
 
+  /**
+   * @brief set the registration map to build and register against, instead of
+   * the default shared map. This should be set before registering any scans.
+   */
+  virtual void SetMap(const std::shared_ptr<RegistrationMap>& map);
+
   const RegistrationMap& GetMap() const;
 
   RegistrationMap& GetMapMutable();
 
+  std::shared_ptr<RegistrationMap> GetMapPtr() const { return map_; }
+
+  /**
+   * @brief set the frame of the lidar whose scans are registered, this is used
+   * for the extrinsics variables and when adding scans to the map. Defaults to
+   * the lidar frame of the extrinsics, this only needs to be set when running
+   * one scan registration per lidar.
+   */
+  void SetLidarFrameId(const std::string& lidar_frame_id) {
+    lidar_frame_id_ = lidar_frame_id;
+  }
+
+  const std::string& GetLidarFrameId() const { return lidar_frame_id_; }
+
+  /**
+   * @brief get the baselink pose of a scan in the map. Scans added by other
+   * lidars sharing the map are converted using the extrinsics of their lidar
+   * @param stamp when scan was collected
+   * @param T_MAP_BASELINK reference to baselink pose of the scan
+   * @return false if the scan is not in the map, or its extrinsics cannot be
+   * looked up
+   */
+  bool GetScanBaselinkPose(const ros::Time& stamp,
+                           Eigen::Matrix4d& T_MAP_BASELINK);
+
   void SetInformationWeight(double w);
 
+  /**
+   * @brief get the lidar pose a scan was registered at
+   * @param stamp when scan was collected
+   * @param T_MAP_LIDAR reference to the registered pose
+   * @return false if the scan was not registered (or is no longer known)
+   */
+  virtual bool GetRegisteredScanPose(const ros::Time& stamp,
+                                     Eigen::Matrix4d& T_MAP_LIDAR) const {
+    return map_->GetScanPose(stamp, T_MAP_LIDAR);
+  }
+
   ScanRegistrationParamsBase& GetBaseParamsMutable() { return base_params_; }
 
 protected:
@@ -93,10 +153,13 @@ protected:
 
   ScanRegistrationParamsBase base_params_;
   Eigen::Matrix<double, 6, 6> covariance_;
+  Eigen::Matrix<double, 6, 6> fixed_covariance_;
   bool use_fixed_covariance_{false};
-  RegistrationMap& map_ = RegistrationMap::GetInstance();
+  std::shared_ptr<RegistrationMap> map_{
+      RegistrationMap::GetNamedInstance("")};
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
+  std::string lidar_frame_id_{extrinsics_.GetLidarFrameId()};
   RegistrationValidation registration_validation_;
   double covariance_weight_{1.0};
 
@@ -112,6 +175,8 @@ protected:
    * slam_initialization and not in lidar_odometry. For that reason, we leave
    * this out of the config file */
   double extrinsics_prior_{0};
+
+  bool use_pooled_allocation_{false};
 };
 
 } // namespace bs_models::scan_registration
@@ -8,6 +8,8 @@
 
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
 #include <bs_models/lidar/scan_pose.h>
+#include <bs_models/scan_registration/loam_solver.h>
+#include <bs_models/scan_registration/prior_registration_map.h>
 #include <bs_models/scan_registration/registration_map.h>
 #include <bs_models/scan_registration/scan_registration_base.h>
 
@@ -41,7 +43,8 @@ public:
    * @param new_scan scan pose to register to the current map
    * @return transaction with constraint between the current scan pose and the
    * previous, unless the map is empty then the transaction will only contain a
-   * prior constraint on this pose
+   * prior constraint on this pose. When localizing against a prior map, the
+   * transaction contains an absolute pose prior on the scan pose instead
    */
   bs_constraints::Pose3DStampedTransaction
       RegisterNewScan(const ScanPose& new_scan) override;
@@ -51,9 +54,41 @@ public:
    */
   void reset() { scan_pose_prev_ = nullptr; }
 
+  /**
+   * @brief localize against a fixed prior map instead of building the
+   * registration map. Scans are only registered against the prior map and
+   * never added to a map, and each registration adds an absolute pose prior
+   * on the scan pose instead of a relative constraint from the previous scan.
+   * The world frame must be the world frame of the prior map (e.g., by
+   * initializing with init_mode PRIOR_MAP). Set to nullptr to map again
+   */
+  void SetPriorMap(const std::shared_ptr<PriorRegistrationMap>& prior_map) {
+    prior_map_ = prior_map;
+    scan_pose_prev_ = nullptr;
+  }
+
+  const std::shared_ptr<PriorRegistrationMap>& GetPriorMap() const {
+    return prior_map_;
+  }
+
+  /**
+   * @brief same as the base class, but also returns the last registered scan
+   * when localizing against a prior map, since it is not added to the map
+   */
+  bool GetRegisteredScanPose(const ros::Time& stamp,
+                             Eigen::Matrix4d& T_MAP_LIDAR) const override;
+
 protected:
   /**
-   * @brief Pure virtual function for registering a new scan to the map.
+   * @brief register a new scan against the prior map, see SetPriorMap
+   */
+  bs_constraints::Pose3DStampedTransaction
+      RegisterNewScanToPriorMap(const ScanPose& new_scan);
+
+  /**
+   * @brief Pure virtual function for registering a new scan to the map. When
+   * localizing against a prior map, scan_pose_prev_ is null for the first
+   * scan.
    */
   virtual bool RegisterScanToMap(const ScanPose& scan_pose,
                                  Eigen::Matrix4d& T_MAP_SCAN) = 0;
@@ -76,6 +111,8 @@ protected:
    *
    */
   std::unique_ptr<ScanPose> scan_pose_prev_;
+
+  std::shared_ptr<PriorRegistrationMap> prior_map_;
 };
 
 /**
@@ -89,13 +126,39 @@ public:
 
     /** constructor that takes in a base params object */
     Params(const ScanRegistrationParamsBase& base_params, int _map_size,
-           double _downsample_voxel_size);
+           double _downsample_voxel_size,
+           bool _store_scans_in_sensor_frame = false);
 
     /** number of prev scans to save in the map */
     int map_size{10};
 
     double downsample_voxel_size{-1};
 
+    /** voxel sizes of the coarse levels of the map, see
+     * RegistrationMap::SetPyramidVoxelSizes. Scans are matched coarse to fine
+     * when the native loam solver is enabled. This is optional in the config
+     * and empty by default */
+    std::vector<double> pyramid_voxel_sizes;
+
+    /** which scans are kept in the map, see
+     * RegistrationMap::SetRetentionParams. This is optional in the config
+     * (json object "retention"), by default the oldest scans are removed */
+    RegistrationMap::RetentionParams retention;
+
+    /** see RegistrationMap::SetStoreScansInSensorFrame. This is optional in
+     * the config */
+    bool store_scans_in_sensor_frame{false};
+
+    /** checks run before each registration, see RegistrationPrecheck. This is
+     * optional in the config (json object "precheck") and disabled by
+     * default */
+    RegistrationPrecheck::Params precheck;
+
+    /** native solver used instead of the LoamMatcher, see LoamSolver. This
+     * is optional in the config (json object "loam_solver") and disabled by
+     * default */
+    LoamSolver::Params loam_solver;
+
     /** load derived params & base params */
     void LoadFromJson(const std::string& config);
 
@@ -108,17 +171,105 @@ public:
   ScanToMapLoamRegistration(std::unique_ptr<LoamMatcher> matcher,
                             const ScanRegistrationParamsBase& base_params,
                             int map_size = 10,
-                            double downsample_voxel_size = -1);
+                            double downsample_voxel_size = -1,
+                            bool store_scans_in_sensor_frame = false);
+
+  /**
+   * @brief set the map, this also applies the map params (size, downsampling)
+   * to it
+   */
+  void SetMap(const std::shared_ptr<RegistrationMap>& map) override;
+
+  /**
+   * @brief set the params of the checks run before each registration
+   */
+  void SetPrecheckParams(const RegistrationPrecheck::Params& params) {
+    params_.precheck = params;
+    precheck_.SetParams(params);
+  }
+
+  /**
+   * @brief set the params of the native loam solver. If enabled, scans are
+   * aligned with a LoamSolver instead of the matcher, and the matcher results
+   * are not saved
+   */
+  void SetLoamSolverParams(const LoamSolver::Params& params);
+
+  /**
+   * @brief set the voxel sizes of the coarse levels of the map. With the
+   * native loam solver, scans are aligned to the coarsest level first, and
+   * each result initializes the alignment to the next finer level, so fewer
+   * iterations are run on the full resolution map when the initial estimate
+   * is poor. Coarse levels are not used when localizing against a prior map
+   */
+  void SetPyramidVoxelSizes(const std::vector<double>& voxel_sizes);
+
+  /**
+   * @brief set which scans are kept in the map
+   */
+  void SetRetentionParams(const RegistrationMap::RetentionParams& params);
+
+  /**
+   * @brief get the result of the checks for the last registered scan
+   */
+  const RegistrationPrecheck::Result& GetLastPrecheckResult() const {
+    return last_precheck_result_;
+  }
 
 private:
+  void SetupMap();
+
+  /**
+   * @brief create one solver per map level if the native solver is enabled,
+   * the coarse levels accept correspondences and residuals scaled with their
+   * voxel size
+   */
+  void SetupSolvers();
+
+  /**
+   * @brief log the precheck decision and count it in the instrumentation
+   * metrics
+   */
+  void ReportPrecheck(const RegistrationPrecheck::Result& result,
+                      const ros::Time& stamp) const;
+
   bool RegisterScanToMap(const ScanPose& scan_pose,
                          Eigen::Matrix4d& T_MAP_SCAN) override;
 
+  /**
+   * @brief compute the covariance of a registration with hessian_covariance_,
+   * with the translation expressed in the frame of the constraint
+   * @return false if there are too few correspondences
+   */
+  bool ComputeHessianCovariance(const ScanPose& scan_pose,
+                                const LoamPointCloudPtr& current_map,
+                                const Eigen::Matrix4d& T_MAP_SCAN,
+                                const Eigen::Matrix3d& R_CONSTRAINT_MAP,
+                                Eigen::Matrix<double, 6, 6>& covariance);
+
   void AddScanToMap(const ScanPose& scan_pose,
                     const Eigen::Matrix4d& T_MAP_SCAN) override;
 
   std::unique_ptr<LoamMatcher> matcher_;
+
+  /** map the matcher reference was last set to, see
+   * RegistrationMap::GetLoamCloudMapPtr */
+  beam_matching::LoamPointCloudPtr matcher_ref_;
+
   Params params_;
+  HessianCovariance hessian_covariance_;
+
+  /** map the hessian_covariance_ reference was last set to */
+  beam_matching::LoamPointCloudPtr hessian_ref_;
+
+  RegistrationPrecheck precheck_;
+  RegistrationPrecheck::Result last_precheck_result_;
+
+  /** solver of each map level, empty unless the native solver is enabled */
+  std::vector<std::unique_ptr<LoamSolver>> solvers_;
+
+  /** map each solver reference was last set to */
+  std::vector<beam_matching::LoamPointCloudPtr> solver_refs_;
 };
 
 }} // namespace bs_models::scan_registration
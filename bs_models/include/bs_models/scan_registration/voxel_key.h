@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+namespace bs_models { namespace scan_registration {
+
+/**
+ * @brief Keys of the voxels of the voxel maps, grids and filters, so that all
+ * of them pack the same bit layout. The voxel indices are packed into a single
+ * key using 21 bits per axis (x in the high bits), offset so that indices in
+ * [-2^20, 2^20) get distinct keys. Indices outside that range wrap around and
+ * share the keys of the voxels 2^21 voxels away, e.g. 20 km away with 1 cm
+ * voxels.
+ */
+constexpr int kVoxelKeyBits = 21;
+
+/**
+ * @brief pack voxel indices into a key
+ */
+inline uint64_t VoxelKey(int64_t ix, int64_t iy, int64_t iz) {
+  constexpr int64_t offset = int64_t{1} << (kVoxelKeyBits - 1);
+  constexpr uint64_t mask = (uint64_t{1} << kVoxelKeyBits) - 1;
+  return ((static_cast<uint64_t>(ix + offset) & mask) << (2 * kVoxelKeyBits)) |
+         ((static_cast<uint64_t>(iy + offset) & mask) << kVoxelKeyBits) |
+         (static_cast<uint64_t>(iz + offset) & mask);
+}
+
+/**
+ * @brief get the key of the voxel a position is in, with cubic voxels
+ */
+inline uint64_t VoxelKey(const Eigen::Vector3d& p, double voxel_size) {
+  return VoxelKey(static_cast<int64_t>(std::floor(p.x() / voxel_size)),
+                  static_cast<int64_t>(std::floor(p.y() / voxel_size)),
+                  static_cast<int64_t>(std::floor(p.z() / voxel_size)));
+}
+
+/**
+ * @brief get the key of the voxel a position is in, with a voxel size per
+ * axis
+ */
+inline uint64_t VoxelKey(const Eigen::Vector3f& p,
+                         const Eigen::Vector3f& voxel_size) {
+  return VoxelKey(static_cast<int64_t>(std::floor(p.x() / voxel_size.x())),
+                  static_cast<int64_t>(std::floor(p.y() / voxel_size.y())),
+                  static_cast<int64_t>(std::floor(p.z() / voxel_size.z())));
+}
+
+}} // namespace bs_models::scan_registration
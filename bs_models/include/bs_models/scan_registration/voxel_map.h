@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+
+#include <bs_common/task_scheduler.h>
+#include <bs_models/scan_registration/voxel_key.h>
+
+namespace bs_models { namespace scan_registration {
+
+/**
+ * @brief Incremental voxel hash map used to store a downsampled map made up of
+ * multiple scans. Each voxel stores the contribution (point sum & count) of
+ * each scan that has points in it, so that scans can be added or removed in
+ * O(scan points) without having to re-merge and re-downsample all scans. The
+ * output cloud contains one point per voxel located at the centroid of all
+ * points in that voxel, which matches the result of a voxel grid filter.
+ */
+template <typename PointT>
+class VoxelMap {
+public:
+  /**
+   * @brief constructor
+   * @param voxel_size voxel side length in meters
+   */
+  explicit VoxelMap(double voxel_size = 0.1) : voxel_size_(voxel_size) {}
+
+  /**
+   * @brief set voxel size. This clears the map.
+   */
+  void SetVoxelSize(double voxel_size) {
+    voxel_size_ = voxel_size;
+    Clear();
+  }
+
+  /**
+   * @brief add a cloud to the map
+   * @param id unique id of the cloud (e.g., the scan timestamp in ns)
+   * @param cloud cloud to add, already expressed in the map frame
+   */
+  void AddCloud(uint64_t id, const pcl::PointCloud<PointT>& cloud) {
+    for (const auto& p : cloud) {
+      if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+        continue;
+      }
+      std::vector<Contribution>& voxel = voxels_[GetKey(p)];
+      auto it = FindContribution(voxel, id);
+      if (it == voxel.end()) {
+        voxel.push_back(Contribution{id, p, Eigen::Vector3d::Zero(), 0});
+        it = std::prev(voxel.end());
+      }
+      it->sum += Eigen::Vector3d(p.x, p.y, p.z);
+      it->count++;
+    }
+  }
+
+  /**
+   * @brief remove a cloud from the map
+   * @param id id used when adding the cloud
+   * @param cloud the same cloud that was used when adding, this is used to
+   * find which voxels the cloud contributed to
+   */
+  void RemoveCloud(uint64_t id, const pcl::PointCloud<PointT>& cloud) {
+    for (const auto& p : cloud) {
+      if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+        continue;
+      }
+      auto voxel_iter = voxels_.find(GetKey(p));
+      if (voxel_iter == voxels_.end()) { continue; }
+      std::vector<Contribution>& voxel = voxel_iter->second;
+      auto it = FindContribution(voxel, id);
+      if (it == voxel.end()) { continue; }
+      voxel.erase(it);
+      if (voxel.empty()) { voxels_.erase(voxel_iter); }
+    }
+  }
+
+  /**
+   * @brief get the downsampled map. Other point fields (e.g., intensity) are
+   * taken from the first point added to each voxel. The voxels of large maps
+   * are read over multiple threads, in contiguous ranges of buckets whose
+   * points are concatenated in order, so the output does not depend on the
+   * scheduling
+   */
+  pcl::PointCloud<PointT> GetCloud() const {
+    auto& scheduler = bs_common::TaskScheduler::GetInstance();
+    const size_t num_chunks = std::max<size_t>(
+        std::min<size_t>(scheduler.NumThreads() + 1,
+                         voxels_.size() / kMinVoxelsPerChunk),
+        1);
+    pcl::PointCloud<PointT> cloud;
+    if (num_chunks == 1) {
+      cloud.reserve(voxels_.size());
+      for (const auto& [key, voxel] : voxels_) {
+        cloud.push_back(Centroid(voxel));
+      }
+      return cloud;
+    }
+
+    const size_t num_buckets = voxels_.bucket_count();
+    const size_t buckets_per_chunk =
+        (num_buckets + num_chunks - 1) / num_chunks;
+    std::vector<pcl::PointCloud<PointT>> chunks(num_chunks);
+    scheduler.ParallelFor(
+        bs_common::TaskPriority::REALTIME, num_chunks,
+        [&](size_t c) {
+          const size_t end = std::min(num_buckets, (c + 1) * buckets_per_chunk);
+          for (size_t b = c * buckets_per_chunk; b < end; b++) {
+            for (auto it = voxels_.begin(b); it != voxels_.end(b); it++) {
+              chunks[c].push_back(Centroid(it->second));
+            }
+          }
+        },
+        num_chunks);
+    cloud.reserve(voxels_.size());
+    for (const auto& chunk : chunks) { cloud += chunk; }
+    return cloud;
+  }
+
+  /**
+   * @brief clear all voxels
+   */
+  void Clear() { voxels_.clear(); }
+
+  /**
+   * @brief return the number of occupied voxels
+   */
+  size_t NumVoxels() const { return voxels_.size(); }
+
+private:
+  // voxels are only read over multiple threads if each gets at least this many
+  static constexpr size_t kMinVoxelsPerChunk = 20000;
+
+  struct Contribution {
+    uint64_t id;
+    PointT point;
+    Eigen::Vector3d sum;
+    int count;
+  };
+
+  uint64_t GetKey(const PointT& p) const {
+    return VoxelKey(Eigen::Vector3d(p.x, p.y, p.z), voxel_size_);
+  }
+
+  static PointT Centroid(const std::vector<Contribution>& voxel) {
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    int count = 0;
+    for (const auto& c : voxel) {
+      sum += c.sum;
+      count += c.count;
+    }
+    PointT p = voxel.front().point;
+    const Eigen::Vector3d centroid = sum / count;
+    p.x = centroid.x();
+    p.y = centroid.y();
+    p.z = centroid.z();
+    return p;
+  }
+
+  typename std::vector<Contribution>::iterator
+      FindContribution(std::vector<Contribution>& voxel, uint64_t id) const {
+    for (auto it = voxel.begin(); it != voxel.end(); it++) {
+      if (it->id == id) { return it; }
+    }
+    return voxel.end();
+  }
+
+  double voxel_size_;
+  std::unordered_map<uint64_t, std::vector<Contribution>> voxels_;
+};
+
+}} // namespace bs_models::scan_registration
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <fuse_core/async_sensor_model.h>
+#include <fuse_core/fuse_macros.h>
+#include <ros/ros.h>
+
+#include <bs_common/bs_msgs.h>
+#include <bs_models/global_mapping/slam_chunk_budget.h>
+#include <bs_parameters/models/slam_chunk_relay_params.h>
+
+namespace bs_models {
+
+/**
+ * @brief Relays the slam chunks of the local mapper to a GlobalMapper running
+ * on another machine, over a link of limited bandwidth. Each chunk is
+ * compressed and reduced to the bandwidth budget (see
+ * global_mapping::SlamChunkBudget), then published on slam_chunks in the
+ * private namespace of this sensor model. The remote GlobalMapper subscribes
+ * to it with its slam_chunk_topic param.
+ *
+ * This sensor model does not send transactions: loop closures are optimized
+ * in the graph of the GlobalMapper, and relocalization against the global map
+ * goes back through its reloc request and response topics.
+ */
+class SlamChunkRelay : public fuse_core::AsyncSensorModel {
+public:
+  FUSE_SMART_PTR_DEFINITIONS(SlamChunkRelay);
+
+  SlamChunkRelay();
+
+  ~SlamChunkRelay() override = default;
+
+private:
+  void onInit() override;
+
+  void onStart() override;
+
+  void onStop() override;
+
+  void processSlamChunk(const bs_common::SlamChunkMsg::ConstPtr& msg);
+
+  bs_parameters::models::SlamChunkRelayParams params_;
+  global_mapping::SlamChunkBudget budget_;
+  ros::Subscriber slam_chunk_subscriber_;
+  ros::Publisher slam_chunk_publisher_;
+};
+
+} // namespace bs_models
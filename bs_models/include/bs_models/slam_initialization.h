@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <list>
 
 #include <fuse_core/async_sensor_model.h>
@@ -16,16 +17,30 @@
 
 #include <bs_common/bs_msgs.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/imu_sample_buffer.h>
+#include <bs_constraints/transaction_batch.h>
 #include <bs_models/frame_initializers/frame_initializer.h>
+#include <bs_models/global_mapping/global_map.h>
+#include <bs_models/global_mapping/submap_working_set.h>
+#include <bs_models/imu/inertial_alignment.h>
 #include <bs_models/imu/imu_preintegration.h>
 #include <bs_models/lidar/lidar_path_init.h>
+#include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_models/reloc/reloc_refinement_base.h>
+#include <bs_models/vision/batch_triangulator.h>
 #include <bs_models/vision/visual_map.h>
 #include <bs_parameters/models/calibration_params.h>
 #include <bs_parameters/models/slam_initialization_params.h>
 
 namespace bs_models {
 
-enum class InitMode { VISUAL = 0, LIDAR };
+/**
+ * VISUAL and LIDAR estimate an initial trajectory from scratch, which requires
+ * motion. PRIOR_MAP relocalizes the first scans in a global map saved by a
+ * previous session and seeds the graph directly in the map frame, falling back
+ * to LIDAR if it cannot relocalize
+ */
+enum class InitMode { VISUAL = 0, LIDAR, PRIOR_MAP };
 
 class SLAMInitialization : public fuse_core::AsyncSensorModel {
 public:
@@ -57,12 +72,27 @@ private:
    */
   void processIMU(const sensor_msgs::Imu::ConstPtr& msg);
 
+  /**
+   * @brief Updates the stationary imu statistics with a new sample. While the
+   * whole buffer is stationary, raw samples older than the stationary window
+   * are removed since they are summarized by the statistics
+   * @param sample new imu sample, already in the buffer
+   */
+  void UpdateStationaryStatistics(const bs_common::ImuSample& sample);
+
   /**
    * @brief Callback for lidar processing
    * @param[in] msg - The lidar msg to process
    */
   void processLidar(const sensor_msgs::PointCloud2::ConstPtr& msg);
 
+  /**
+   * @brief Lidar processing for PRIOR_MAP init, tries to relocalize each scan
+   * once the prior map is loaded. The vehicle must be stationary
+   * @param[in] msg - The lidar msg to process
+   */
+  void processLidarPriorMap(const sensor_msgs::PointCloud2::ConstPtr& msg);
+
   /**
    * @brief Process using a frame initializer if desired
    * @param[in] timestamp time of the current request
@@ -105,13 +135,58 @@ private:
   bool Initialize();
 
   /**
-   * @brief Triangulates a landmark
-   * @return position of landmark if it can be estimated
+   * @brief Start loading the prior map in the background, without its lidar
+   * clouds, and prepare the reloc candidate search for its submaps
+   */
+  void LoadPriorMap();
+
+  /**
+   * @brief Relocalize a scan in the prior map, using the best candidate of
+   * the candidate search which is accepted by the refinement
+   * @param msg scan to relocalize
+   * @param T_MAP_BASELINK output pose of the scan in the prior map frame
+   * @return false if no candidate was accepted
+   */
+  bool RelocalizeInPriorMap(const sensor_msgs::PointCloud2::ConstPtr& msg,
+                            Eigen::Matrix4d& T_MAP_BASELINK);
+
+  /**
+   * @brief Check that the vehicle has been stationary for at least the
+   * stationary window before a stamp, and get the gyroscope bias from the
+   * stationary imu statistics
+   * @param stamp end of the stationary window
+   * @param bg output mean angular velocity
+   * @return false if the vehicle is moving
    */
-  beam::opt<Eigen::Vector3d>
-      TriangulateLandmark(const uint64_t lm_id,
-                          Eigen::Vector3d& average_viewing_angle,
-                          uint64_t& visual_word_id);
+  bool EstimateStationaryGyroBias(const ros::Time& stamp, Eigen::Vector3d& bg);
+
+  /**
+   * @brief Seeds the fuse optimizer with a stationary imu state in the prior
+   * map frame, with a prior on the full state
+   */
+  void SendPriorMapInitialization(const ros::Time& stamp,
+                                  const Eigen::Matrix4d& T_MAP_BASELINK,
+                                  const Eigen::Vector3d& bg);
+
+  /**
+   * @brief Seeds the fuse optimizer with an imu state, with a prior on the
+   * full state
+   */
+  void SendImuStateInitialization(const bs_common::ImuState& imu_state);
+
+  /**
+   * @brief Gathers the measurements needed to triangulate a landmark. This
+   * only reads the local graph and landmark container, so it can be called
+   * for multiple landmarks in parallel
+   * @param request output poses and pixels of the landmark
+   * @param average_viewing_angle output average viewing angle in world frame
+   * @param visual_word_id output most common word id of the measurements
+   * @return false if less than 2 measurements have a pose in the map
+   */
+  bool GetTriangulationRequest(const uint64_t lm_id,
+                               vision::BatchTriangulator::Request& request,
+                               Eigen::Vector3d& average_viewing_angle,
+                               uint64_t& visual_word_id);
 
   /**
    * @brief If the path was estimated using FRAMEINIT or LIDAR, then we
@@ -127,7 +202,8 @@ private:
 
   /**
    * @brief Adds poses from the init_path to the graph and adds the imu
-   * constraints between them
+   * constraints between them. The imu measurements between poses are
+   * preintegrated in parallel
    */
   void AddPosesAndInertialConstraints();
 
@@ -137,9 +213,17 @@ private:
   void AddVisualConstraints();
 
   /**
-   * @brief Adds lidar constraints to the graph
+   * @brief Merges the lidar constraints built by the lidar path initialization
+   * into a transaction. This does not use the local graph, so it can run
+   * while the other constraints are added
+   */
+  void MergeLidarConstraints(fuse_core::Transaction& transaction);
+
+  /**
+   * @brief Applies a transaction to the local graph, and keeps it to build
+   * the initialization graph transaction
    */
-  void AddLidarConstraints();
+  void UpdateLocalGraph(const fuse_core::Transaction& transaction);
 
   /**
    * @brief Sends the local graph to the fuse optimizer
@@ -184,18 +268,31 @@ private:
   Eigen::Vector3d bg_;
   Eigen::Vector3d ba_;
   double scale_;
+  bs_models::imu::AlignmentSummary alignment_summary_;
 
   // data storage
-  std::list<sensor_msgs::Imu> imu_buffer_;
+  bs_common::ImuSampleBuffer imu_buffer_;
+
+  // running statistics of the current stationary period, which summarize the
+  // raw samples dropped from imu_buffer_ while waiting for motion
+  struct StationaryImuStatistics {
+    ros::Time start;
+    ros::Time end;
+    size_t count{0};
+    Eigen::Vector3d mean_w{Eigen::Vector3d::Zero()};
+    Eigen::Vector3d mean_a{Eigen::Vector3d::Zero()};
+  };
+  StationaryImuStatistics stationary_imu_;
   std::shared_ptr<beam_containers::LandmarkContainer> landmark_container_;
   std::list<ros::Time> frame_init_buffer_;
   ros::Time prev_frame_{ros::Time(0)};
   double last_lidar_scan_time_s_{0};
-  std::shared_ptr<beam_cv::ImageDatabase> image_db_;
+  // loaded in the background, see bs_common::LoadInBackground
+  std::shared_future<std::shared_ptr<beam_cv::ImageDatabase>> image_db_;
+  std::shared_ptr<vision::BatchTriangulator> triangulator_;
 
   // measurement buffer sizes
   int max_landmark_container_size_;
-  int imu_buffer_size_;
   int lidar_buffer_size_;
 
   // params only tunable here
@@ -211,6 +308,22 @@ private:
   bs_models::ImuPreintegration::Params imu_params_;
   std::unique_ptr<bs_models::FrameInitializer> frame_initializer_;
   fuse_core::Graph::SharedPtr local_graph_;
+  // all transactions applied to the local graph, their constraints are sent
+  // in the initialization graph
+  bs_constraints::TransactionBatch init_batch_;
+
+  // prior map for PRIOR_MAP init. The lidar clouds of its submaps are paged in
+  // by the working set when relocalizing
+  struct PriorMap {
+    std::shared_ptr<global_mapping::GlobalMap> global_map;
+    std::vector<global_mapping::SubmapPtr> submaps;
+    std::shared_ptr<global_mapping::SubmapWorkingSet> working_set;
+    std::shared_ptr<reloc::RelocCandidateSearchBase> candidate_search;
+    std::shared_ptr<reloc::RelocRefinementBase> refinement;
+  };
+  // loaded in the background, nullptr if it cannot be loaded
+  std::shared_future<std::shared_ptr<PriorMap>> prior_map_;
+  int prior_map_attempts_{0};
 
   // extrinsics
   Eigen::Matrix4d T_cam_baselink_;
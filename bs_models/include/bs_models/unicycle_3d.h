@@ -1,6 +1,6 @@
 #pragma once
 
-#include <map>
+#include <vector>
 
 #include <fuse_core/async_motion_model.h>
 #include <fuse_core/constraint.h>
@@ -13,6 +13,8 @@
 #include <ros/ros.h>
 #include <tf2/utils.h>
 
+#include <bs_common/graph_view.h>
+
 namespace bs_models {
 
 class Unicycle3D : public fuse_core::AsyncMotionModel {
@@ -36,6 +38,7 @@ protected:
    * @brief Structure used to maintain a history of "good" pose estimates
    */
   struct StateHistoryElement {
+    ros::Time stamp; //!< The stamp of the state
     fuse_core::UUID
         position_uuid; //!< The uuid of the associated position variable
     fuse_core::UUID
@@ -51,7 +54,13 @@ protected:
     tf2::Vector3 velocity_angular;
     tf2::Vector3 acceleration_linear;
   };
-  using StateHistory = std::map<ros::Time, StateHistoryElement>;
+
+  /**
+   * @brief History of states stored contiguously and sorted by stamp, so
+   * lookups are binary searches and pruning only moves the remaining states
+   */
+  using StateHistory = std::vector<StateHistoryElement>;
+
   /**
    * @brief Augment a transaction structure such that the provided timestamps
    * are connected by motion model constraints.
@@ -109,15 +118,30 @@ protected:
   /**
    * @brief Update all of the estimated states in the state history container
    * using the optimized values from the graph
-   * @param[in] graph         The graph object containing updated variable
+   * @param[in] graph_view    Index of the graph containing updated variable
    * values
    * @param[in] state_history The state history object to be updated
    * @param[in] buffer_length States older than this in the history will be
    * pruned
    */
-  static void updateStateHistoryEstimates(const fuse_core::Graph& graph,
-                                          StateHistory& state_history,
-                                          const ros::Duration& buffer_length);
+  static void
+      updateStateHistoryEstimates(const bs_common::GraphView& graph_view,
+                                  StateHistory& state_history,
+                                  const ros::Duration& buffer_length);
+
+  /**
+   * @brief Get the first state in the history with a stamp greater than the
+   * given stamp, or end if there is none
+   */
+  static StateHistory::iterator upperBound(StateHistory& state_history,
+                                           const ros::Time& stamp);
+
+  /**
+   * @brief Insert a state into the history, keeping it sorted. If a state
+   * already exists at its stamp, the existing state is kept
+   */
+  static void insertState(StateHistory& state_history,
+                          StateHistoryElement&& state);
 
   ros::Duration buffer_length_; //!< The length of the state history
   fuse_core::UUID device_id_;   //!< The UUID of the device to be published
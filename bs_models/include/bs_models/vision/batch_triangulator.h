@@ -0,0 +1,82 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_calibration/CameraModel.h>
+#include <beam_utils/optional.h>
+#include <beam_utils/utils.h>
+
+#include <bs_common/task_scheduler.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Triangulates many landmarks at once. The inputs of all landmarks
+ * (poses and pixels) are gathered first, then each landmark is triangulated
+ * (DLT followed by a nonlinear refinement, see beam_cv::Triangulation)
+ * independently as real-time tasks of the shared task scheduler. Results
+ * don't depend on the number of threads.
+ */
+class BatchTriangulator {
+public:
+  /**
+   * @brief all measurements of one landmark
+   */
+  struct Request {
+    /** world to camera transform of each measurement */
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_cam_world;
+
+    /** measured (distorted) pixel of each measurement */
+    std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+
+    /** camera model of the measurements (e.g., the camera of a rig that
+     * tracks the landmark), the camera model of the triangulator if null */
+    std::shared_ptr<beam_calibration::CameraModel> cam_model;
+  };
+
+  /**
+   * @brief constructor
+   * @param cam_model camera model used for requests without a camera model
+   * @param num_threads max number of tasks triangulating in parallel
+   */
+  BatchTriangulator(std::shared_ptr<beam_calibration::CameraModel> cam_model,
+                    int num_threads);
+
+  /**
+   * @brief triangulate each request without any thresholds
+   * @return one point per request, nullopt if triangulation failed or the
+   * landmark has less than 2 measurements
+   */
+  std::vector<beam::opt<Eigen::Vector3d>>
+      Triangulate(const std::vector<Request>& requests) const;
+
+  /**
+   * @brief triangulate each request, rejecting points that are too far or
+   * that reproject poorly
+   * @param max_distance max distance from the cameras to the point
+   * @param max_reprojection max reprojection error in any measurement
+   * @return one point per request, nullopt if triangulation failed, the point
+   * was rejected, or the landmark has less than 2 measurements
+   */
+  std::vector<beam::opt<Eigen::Vector3d>>
+      Triangulate(const std::vector<Request>& requests, double max_distance,
+                  double max_reprojection) const;
+
+private:
+  const std::shared_ptr<beam_calibration::CameraModel>&
+      CameraModel(const Request& request) const;
+
+  std::vector<beam::opt<Eigen::Vector3d>> Run(
+      const std::vector<Request>& requests,
+      const std::function<beam::opt<Eigen::Vector3d>(const Request&)>&
+          triangulate) const;
+
+  std::shared_ptr<beam_calibration::CameraModel> cam_model_;
+  int num_threads_;
+};
+
+}} // namespace bs_models::vision
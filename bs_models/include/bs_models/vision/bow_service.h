@@ -0,0 +1,173 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <beam_cv/ImageDatabase.h>
+#include <beam_utils/optional.h>
+#include <ros/time.h>
+
+#include <bs_common/thread_pool.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Bag of words service which runs all vocabulary lookups on one
+ * dedicated thread, away from the tracking critical path.
+ *
+ * Descriptors are submitted one frame at a time and quantized in a batch.
+ * Word ids of a frame are then looked up by landmark id, which only blocks if
+ * the frame hasn't been quantized yet. Frames can be added to an inverted
+ * index (word id -> frames) which is maintained incrementally, and queried
+ * asynchronously for frames that look like a given frame (place recognition).
+ *
+ * All jobs run in the order they were submitted, so a query or index update
+ * always sees the result of frames submitted before it. The image database is
+ * only ever used by the service thread, it must not be used elsewhere while
+ * the service is alive.
+ */
+class BowService {
+public:
+  struct PlaceMatch {
+    ros::Time stamp;
+
+    /** idf weighted histogram intersection of the normalized word
+     * histograms, in [0, sum of idf weights] */
+    double score;
+  };
+
+  /**
+   * @brief constructor
+   * @param image_db image database whose vocabulary is used to quantize
+   * descriptors
+   */
+  explicit BowService(std::shared_ptr<beam_cv::ImageDatabase> image_db);
+
+  /**
+   * @brief constructor which loads the image database (i.e., its vocabulary)
+   * as the first job of the service thread, so constructing does not block.
+   * Jobs submitted before it is loaded run once it is
+   * @param load_image_db creates the image database
+   * @param resource_name if not empty, the image database is signalled as
+   * ready with this name in the bs_common::StartupProfiler once loaded
+   */
+  BowService(
+      std::function<std::shared_ptr<beam_cv::ImageDatabase>()> load_image_db,
+      const std::string& resource_name = "");
+
+  /**
+   * @brief waits for all submitted jobs to finish
+   */
+  ~BowService() = default;
+
+  /**
+   * @brief queue the descriptors of a frame for quantization. Does nothing if
+   * the frame was already submitted
+   * @param stamp frame timestamp
+   * @param landmark_ids id of the landmark of each descriptor
+   * @param descriptors one descriptor (row) per landmark
+   */
+  void QuantizeFrame(const ros::Time& stamp,
+                     const std::vector<uint64_t>& landmark_ids,
+                     const std::vector<cv::Mat>& descriptors);
+
+  /**
+   * @brief get the word id of a landmark measurement. Blocks until the frame
+   * is quantized
+   * @return word id, or nullopt if the frame wasn't submitted (or was removed)
+   * or has no measurement of this landmark
+   */
+  beam::opt<uint64_t> GetWordID(const ros::Time& stamp, uint64_t landmark_id);
+
+  /**
+   * @brief drop the word ids of a frame. The frame stays in the inverted index
+   * if it was added to it
+   */
+  void RemoveFrame(const ros::Time& stamp);
+
+  /**
+   * @brief queue adding a submitted frame to the inverted index
+   */
+  void AddToIndex(const ros::Time& stamp);
+
+  /**
+   * @brief queue removing a frame from the inverted index
+   */
+  void RemoveFromIndex(const ros::Time& stamp);
+
+  /**
+   * @brief queue a place recognition query
+   * @param stamp query frame, which must have been submitted
+   * @param max_results max number of matches to return
+   * @param min_time_difference indexed frames closer than this to the query
+   * frame are ignored, e.g. to ignore the most recent frames for loop closure
+   * @return future with matches sorted by decreasing score
+   */
+  std::future<std::vector<PlaceMatch>>
+      Query(const ros::Time& stamp, size_t max_results,
+            const ros::Duration& min_time_difference = ros::Duration(0));
+
+  /**
+   * @brief queue clearing all frames and the inverted index. The vocabulary
+   * is kept
+   */
+  void Clear();
+
+  /**
+   * @brief blocks until all submitted jobs are done
+   */
+  void Wait();
+
+  /**
+   * @brief whether the image database is loaded
+   */
+  bool Loaded() const;
+
+private:
+  struct Frame {
+    std::shared_future<void> quantized;
+
+    /** landmark id -> word id, only written by the service thread before
+     * quantized is ready */
+    std::unordered_map<uint64_t, uint64_t> word_ids;
+  };
+
+  /** normalized word histogram, word id -> frequency */
+  using Histogram = std::unordered_map<uint64_t, double>;
+
+  /**
+   * @brief queue a job on the service thread
+   * @return future which is ready once the job ran
+   */
+  std::shared_future<void> Submit(std::function<void()> job);
+
+  std::shared_ptr<Frame> GetFrame(const ros::Time& stamp);
+
+  Histogram ComputeHistogram(const Frame& frame) const;
+
+  double InverseDocumentFrequency(uint64_t word_id) const;
+
+  std::shared_ptr<beam_cv::ImageDatabase> image_db_;
+
+  std::mutex frames_mutex_;
+  std::map<ros::Time, std::shared_ptr<Frame>> frames_;
+
+  // only used by the service thread
+  std::map<ros::Time, Histogram> indexed_frames_;
+  std::unordered_map<uint64_t, std::map<ros::Time, double>> inverted_index_;
+
+  std::mutex jobs_mutex_;
+  std::shared_future<void> last_job_;
+  std::shared_future<void> loaded_;
+
+  // must be last, so it is destroyed (and finishes its jobs) first
+  std::unique_ptr<bs_common::ThreadPool> pool_;
+};
+
+}} // namespace bs_models::vision
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <opencv2/core.hpp>
+
+#include <bs_common/CameraMeasurementMsg.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Packs landmark measurements into the packed arrays of a camera
+ * measurement message and sets msg.packed. The packed layout has one
+ * contiguous descriptor matrix and one array per field, instead of a message
+ * (and a float descriptor vector) per landmark, so it is much faster to build
+ * and serialize.
+ * @param landmark_ids ids of the landmarks
+ * @param descriptors descriptor of each landmark, all must have one row and
+ * the same size and type
+ * @param pixels pixel of each landmark
+ * @param msg output message, the other fields are not modified
+ */
+void PackLandmarkMeasurements(
+    const std::vector<uint64_t>& landmark_ids,
+    const std::vector<cv::Mat>& descriptors,
+    const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<
+                                           Eigen::Vector2d>>& pixels,
+    bs_common::CameraMeasurementMsg& msg);
+
+/**
+ * @brief Read only access to the landmark measurements of a camera
+ * measurement message, for both the packed and the per landmark layouts. For
+ * packed messages nothing is decoded up front, and descriptors are headers
+ * into the message data, so the message must outlive the view and any
+ * descriptor that is not cloned.
+ */
+class CameraMeasurementView {
+public:
+  /**
+   * @brief constructor, throws std::invalid_argument if the packed arrays
+   * don't have matching sizes
+   */
+  explicit CameraMeasurementView(const bs_common::CameraMeasurementMsg& msg);
+
+  /**
+   * @brief get the number of landmark measurements
+   */
+  size_t Size() const { return size_; }
+
+  /**
+   * @brief check if there are no landmark measurements
+   */
+  bool Empty() const { return size_ == 0; }
+
+  /**
+   * @brief get the id of the i-th landmark
+   */
+  uint64_t LandmarkId(size_t i) const;
+
+  /**
+   * @brief get the pixel of the i-th landmark
+   */
+  Eigen::Vector2d Pixel(size_t i) const;
+
+  /**
+   * @brief get the descriptor of the i-th landmark. For packed messages this
+   * points into the message, clone it to keep it after the message is gone
+   */
+  cv::Mat Descriptor(size_t i) const;
+
+private:
+  const bs_common::CameraMeasurementMsg& msg_;
+  size_t size_;
+  cv::Mat descriptors_;
+};
+
+}} // namespace bs_models::vision
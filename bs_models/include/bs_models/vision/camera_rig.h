@@ -0,0 +1,121 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_calibration/CameraModel.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief camera of a rig, with its calibration
+ */
+struct RigCamera {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  uint8_t sensor_id;
+  std::string frame_id;
+  std::shared_ptr<beam_calibration::CameraModel> model;
+
+  /** intrinsic matrix of the rectified model, used by the reprojection
+   * constraints */
+  Eigen::Matrix3d K;
+
+  Eigen::Matrix4d T_cam_baselink;
+  Eigen::Matrix4d T_baselink_cam;
+};
+
+/**
+ * @brief Cameras of a multi-camera rig. Each camera is tracked independently
+ * (one feature tracker per camera, configured with the sensor id of the
+ * camera) and the trackers make their landmark ids unique across the rig by
+ * storing the sensor id in the top bits (see GlobalLandmarkId), so landmarks
+ * of all cameras can share one visual map and the camera of any landmark
+ * measurement is known from its id.
+ *
+ * The first camera added is the primary camera, its frames define the stamps
+ * of the frame sets. A rig with one camera is the usual monocular setup, all
+ * landmarks then belong to the primary camera whatever their sensor id.
+ */
+class CameraRig {
+public:
+  /** position of the sensor id in landmark ids */
+  static constexpr int SENSOR_ID_SHIFT = 56;
+
+  /**
+   * @brief landmark id that is unique across the rig. For sensor id 0 this is
+   * the tracker id itself, so monocular ids are unchanged
+   */
+  static uint64_t GlobalLandmarkId(uint8_t sensor_id, uint64_t landmark_id);
+
+  /**
+   * @brief sensor id stored in a landmark id
+   */
+  static uint8_t SensorId(uint64_t landmark_id);
+
+  CameraRig() = default;
+
+  /**
+   * @brief add a camera
+   * @param sensor_id sensor id of the measurements of this camera, must be
+   * unique in the rig
+   * @param frame_id camera frame
+   * @param model camera model, its undistortion map must already be
+   * initialized (see CameraModel::InitUndistortMap)
+   * @param T_cam_baselink camera extrinsics
+   */
+  void AddCamera(uint8_t sensor_id, const std::string& frame_id,
+                 std::shared_ptr<beam_calibration::CameraModel> model,
+                 const Eigen::Matrix4d& T_cam_baselink);
+
+  /**
+   * @brief update the extrinsics of a camera, e.g. when they're estimated
+   * online
+   */
+  void SetExtrinsics(size_t index, const Eigen::Matrix4d& T_cam_baselink);
+
+  size_t Size() const { return cameras_.size(); }
+
+  bool Empty() const { return cameras_.empty(); }
+
+  /**
+   * @brief camera by index, in the order cameras were added
+   */
+  const RigCamera& Camera(size_t index) const { return cameras_.at(index); }
+
+  /**
+   * @brief primary camera, the rig must not be empty
+   */
+  const RigCamera& Primary() const { return cameras_.at(0); }
+
+  /**
+   * @brief index of the camera with a sensor id
+   * @return false if no camera has this sensor id
+   */
+  bool Index(uint8_t sensor_id, size_t& index) const;
+
+  /**
+   * @brief index of the camera that tracks a landmark
+   * @return false if the sensor id of the landmark is not in the rig
+   */
+  bool IndexOfLandmark(uint64_t landmark_id, size_t& index) const;
+
+  /**
+   * @brief camera that tracks a landmark, nullptr if the sensor id of the
+   * landmark is not in the rig
+   */
+  const RigCamera* CameraOfLandmark(uint64_t landmark_id) const;
+
+  /**
+   * @brief true if the landmark is tracked by the primary camera
+   */
+  bool IsPrimary(uint64_t landmark_id) const;
+
+private:
+  std::vector<RigCamera, Eigen::aligned_allocator<RigCamera>> cameras_;
+};
+
+}} // namespace bs_models::vision
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <ros/time.h>
+
+#include <beam_utils/optional.h>
+
+#include <bs_common/CameraMeasurementMsg.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Groups the camera measurements of the cameras of a rig into frame
+ * sets: one measurement per camera, all taken at the same time. Measurements
+ * are matched by stamp within a tolerance, so cameras that are triggered
+ * together but stamped independently still form sets.
+ *
+ * The stamp of a set is the stamp of the primary camera (index 0), and the
+ * measurements of the other cameras are restamped to it, so the whole set maps
+ * to one pose. Sets are emitted as soon as they are complete, incomplete sets
+ * older than an emitted set can't be completed anymore (measurements arrive in
+ * order for each camera) and are dropped.
+ */
+class FrameSetAssembler {
+public:
+  using FrameSet = std::vector<bs_common::CameraMeasurementMsg::ConstPtr>;
+
+  /**
+   * @brief constructor
+   * @param num_cameras number of cameras in the rig
+   * @param tolerance max stamp difference between measurements of a set
+   * @param max_pending max number of incomplete sets kept, the oldest is
+   * dropped when exceeded (e.g., a camera stopped publishing)
+   */
+  FrameSetAssembler(size_t num_cameras, const ros::Duration& tolerance,
+                    size_t max_pending = 10);
+
+  /**
+   * @brief add the measurement of a camera
+   * @param camera index of the camera in the rig
+   * @return the set this measurement completes, ordered by camera index
+   */
+  beam::opt<FrameSet>
+      Add(size_t camera,
+          const bs_common::CameraMeasurementMsg::ConstPtr& measurement);
+
+  /**
+   * @brief number of incomplete sets waiting for measurements
+   */
+  size_t NumPending() const { return pending_.size(); }
+
+  /**
+   * @brief number of incomplete sets dropped since construction or clear
+   */
+  size_t NumDropped() const { return num_dropped_; }
+
+  void Clear();
+
+private:
+  struct PendingSet {
+    ros::Time stamp;
+    FrameSet measurements;
+    size_t num_measurements{0};
+  };
+
+  size_t num_cameras_;
+  ros::Duration tolerance_;
+  size_t max_pending_;
+
+  // ordered by stamp
+  std::deque<PendingSet> pending_;
+  size_t num_dropped_{0};
+};
+
+}} // namespace bs_models::vision
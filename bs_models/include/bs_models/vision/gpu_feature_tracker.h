@@ -0,0 +1,130 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <opencv2/core.hpp>
+#include <ros/time.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief KLT feature tracker which runs on the GPU, as an alternative to
+ * beam_cv::KLTracker when the CPU is busy with other sensors. Images are
+ * uploaded through page locked memory, then tracked with pyramidal KLT, and
+ * new features are detected and described with ORB (FAST keypoints) once the
+ * number of tracks drops below the resample percentage. Tracked features keep
+ * the descriptor from when they were detected, so descriptors are only
+ * computed for new features.
+ *
+ * Params are loaded from the same tracker, detector and descriptor configs as
+ * the CPU tracker, so both backends can be switched without new configs.
+ *
+ * This is only available if OpenCV was built with its CUDA modules, see
+ * Available(). Only the tracks of the last window_size images are kept.
+ */
+class GpuFeatureTracker {
+public:
+  struct Params {
+    /** detect new features when less than this percentage of num_features
+     * are tracked */
+    double keypoint_resample_percentage{0.9};
+
+    /** KLT window size */
+    int win_size_u{21};
+    int win_size_v{21};
+
+    /** KLT max pyramid level */
+    int max_level{3};
+
+    /** KLT iterations */
+    int criteria_max_count{30};
+
+    /** max number of tracked features */
+    int num_features{150};
+
+    /** FAST threshold */
+    int threshold{20};
+
+    /** ORB descriptor params */
+    int tuple_size{2};
+    int patch_size{31};
+
+    /**
+     * @brief load params from the tracker, detector and descriptor configs,
+     * missing params keep their defaults
+     */
+    void LoadFromJson(const std::string& tracker_config,
+                      const std::string& detector_config,
+                      const std::string& descriptor_config);
+  };
+
+  /**
+   * @brief check if this was built with CUDA support and a device is present
+   */
+  static bool Available();
+
+  /**
+   * @brief constructor, throws if Available() is false
+   * @param params tracker params
+   * @param window_size number of images to keep tracks for
+   */
+  GpuFeatureTracker(const Params& params, int window_size);
+
+  ~GpuFeatureTracker();
+
+  /**
+   * @brief track features into a new image, and detect new features if
+   * needed
+   * @param image grayscale image
+   * @param stamp image time
+   */
+  void AddImage(const cv::Mat& image, const ros::Time& stamp);
+
+  /**
+   * @brief get the ids of all landmarks tracked in an image
+   */
+  std::vector<uint64_t> GetLandmarkIDsInImage(const ros::Time& stamp) const;
+
+  /**
+   * @brief get the pixel of a landmark in an image, throws std::out_of_range
+   * if the landmark is not in the image
+   */
+  Eigen::Vector2d Get(const ros::Time& stamp, uint64_t id) const;
+
+  /**
+   * @brief get the descriptor of a landmark in an image, throws
+   * std::out_of_range if the landmark is not in the image
+   */
+  cv::Mat GetDescriptor(const ros::Time& stamp, uint64_t id) const;
+
+private:
+  /**
+   * @brief tracks of one image, descriptors has one row per landmark
+   */
+  struct Frame {
+    std::vector<uint64_t> ids;
+    std::vector<cv::Point2f> pixels;
+    cv::Mat descriptors;
+    std::unordered_map<uint64_t, size_t> indices;
+  };
+
+  const Frame& GetFrame(const ros::Time& stamp) const;
+
+  size_t GetIndex(const Frame& frame, uint64_t id) const;
+
+  // device state, only defined when built with CUDA
+  struct DeviceState;
+  std::unique_ptr<DeviceState> device_;
+
+  Params params_;
+  int window_size_;
+  uint64_t next_id_{0};
+  std::map<ros::Time, Frame> frames_;
+};
+
+}} // namespace bs_models::vision
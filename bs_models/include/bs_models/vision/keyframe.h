@@ -2,6 +2,7 @@
 
 #include <beam_utils/utils.h>
 #include <bs_common/CameraMeasurementMsg.h>
+#include <bs_common/flat_time_map.h>
 #include <sensor_msgs/Image.h>
 
 namespace bs_models { namespace vision {
@@ -45,13 +46,13 @@ public:
    * @brief Read only access to this keyframes trajectory
    * <time, T_keyframe_frame)>
    */
-  const std::map<ros::Time, Eigen::Matrix4d>& Trajectory() const;
+  const bs_common::FlatTimeMap<ros::Time, Eigen::Matrix4d>& Trajectory() const;
 
 protected:
   ros::Time timestamp_;
   bs_common::CameraMeasurementMsg msg_;
   uint64_t sequence_number_;
-  std::map<ros::Time, Eigen::Matrix4d> trajectory_;
+  bs_common::FlatTimeMap<ros::Time, Eigen::Matrix4d> trajectory_;
 };
 
 }} // namespace bs_models::vision
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <opencv2/core.hpp>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Stores keyframe images with a bounded memory footprint. Images are
+ * only needed for visualization and for saving maps, so keeping every raw
+ * image for the lifetime of a map is usually not worth the memory. The storage
+ * policy is one of:
+ *
+ *  - KEEP: keep the raw images (default),
+ *  - DROP: don't keep images, Get returns empty images,
+ *  - DOWNSAMPLE: keep images downsampled by downsample_factor,
+ *  - COMPRESS: keep images encoded in memory (png or jpg), decoded on Get,
+ *  - SPILL: encode images and append them to a file on disk, which is memory
+ *    mapped and decoded on Get. The file is removed with the store.
+ *
+ * Copies of a store share the encoded data and the spill file, so copying
+ * is cheap.
+ */
+class KeyframeImageStore {
+public:
+  enum class Policy { KEEP, DROP, DOWNSAMPLE, COMPRESS, SPILL };
+
+  struct Params {
+    Policy policy{Policy::KEEP};
+
+    /** DOWNSAMPLE: image width and height are divided by this */
+    int downsample_factor{2};
+
+    /** COMPRESS and SPILL: png (lossless) or jpg */
+    std::string compression_format{"png"};
+
+    /** jpg quality in [0, 100] */
+    int jpeg_quality{90};
+
+    /** SPILL: directory of the spill files */
+    std::string spill_directory{"/tmp"};
+
+    /**
+     * @brief load params from json, missing params keep their defaults
+     */
+    void LoadFromJson(const nlohmann::json& J);
+
+    /**
+     * @brief get params as json
+     */
+    nlohmann::json ToJson() const;
+  };
+
+  /**
+   * @brief get the policy from its name, throws std::invalid_argument if
+   * invalid
+   */
+  static Policy PolicyFromString(const std::string& policy);
+
+  static std::string PolicyToString(Policy policy);
+
+  /**
+   * @brief default constructor, keeps raw images
+   */
+  KeyframeImageStore() = default;
+
+  /**
+   * @brief constructor
+   * @param params storage params
+   * @param name unique name of this store, used for the spill file name
+   */
+  KeyframeImageStore(const Params& params, const std::string& name);
+
+  /**
+   * @brief add an image, replacing any image with the same stamp
+   */
+  void Add(uint64_t stamp, const cv::Mat& image);
+
+  /**
+   * @brief get an image, decoding it if needed. The image is empty if there is
+   * no image at this stamp or if images are dropped
+   */
+  cv::Mat Get(uint64_t stamp) const;
+
+  /**
+   * @brief get the stamps of all images, in increasing order
+   */
+  std::vector<uint64_t> Stamps() const;
+
+  /**
+   * @brief get the number of images
+   */
+  size_t Size() const { return entries_.size(); }
+
+  /**
+   * @brief get the approximate number of bytes of images held in memory,
+   * this does not include spilled images
+   */
+  size_t MemoryUsage() const;
+
+  const Params& GetParams() const { return params_; }
+
+private:
+  class SpillFile;
+
+  struct Entry {
+    cv::Mat image;
+    std::shared_ptr<const std::vector<uchar>> encoded;
+    size_t offset{0};
+    size_t length{0};
+  };
+
+  std::vector<uchar> Encode(const cv::Mat& image) const;
+
+  Params params_;
+  std::map<uint64_t, Entry> entries_;
+  std::shared_ptr<SpillFile> spill_file_;
+};
+
+}} // namespace bs_models::vision
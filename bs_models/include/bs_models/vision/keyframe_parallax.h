@@ -0,0 +1,123 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ros/time.h>
+
+#include <beam_utils/utils.h>
+
+#include <bs_models/vision/camera_rig.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Incremental keyframe selection statistics. Frames are added as their
+ * measurements arrive, and each measurement of a landmark that is seen in the
+ * current keyframe is paired with its keyframe pixel (and back projected)
+ * right away. Deciding whether a frame is a new keyframe then only needs the
+ * number of pairs, which is O(1), and the rotation compensated parallax over
+ * the pairs, with no landmark container lookups.
+ *
+ * Frames can be added before the frame they are compared to becomes the
+ * keyframe (e.g., measurements buffered while waiting for the frame
+ * initializer), they are paired again when the keyframe changes. Frames must
+ * be added in increasing time order.
+ */
+class KeyframeParallax {
+public:
+  /**
+   * @brief constructor
+   * @param camera_rig cameras of the landmarks, used to back project and
+   * project pixels
+   */
+  explicit KeyframeParallax(std::shared_ptr<const CameraRig> camera_rig);
+
+  /**
+   * @brief Add all measurements of a frame. Frames must be newer than all
+   * frames already added, older (or repeated) frames are ignored
+   * @param stamp frame timestamp
+   * @param ids id of each measured landmark
+   * @param pixels measured (distorted) pixel of each landmark
+   * @return false if the frame was ignored
+   */
+  bool AddFrame(const ros::Time& stamp, const std::vector<uint64_t>& ids,
+                const std::vector<Eigen::Vector2d, beam::AlignVec2d>& pixels);
+
+  /**
+   * @brief Make a frame the keyframe the following frames are compared to.
+   * Older frames are removed
+   * @return false if the frame was never added, the keyframe then has no
+   * landmarks so no frame is tracked from it
+   */
+  bool SetKeyframe(const ros::Time& stamp);
+
+  /**
+   * @brief Number of landmarks measured in the keyframe
+   */
+  size_t NumKeyframeLandmarks() const { return keyframe_pixels_.size(); }
+
+  /**
+   * @brief Number of keyframe landmarks tracked into a frame, 0 if the frame
+   * is unknown
+   */
+  size_t NumTracked(const ros::Time& stamp) const;
+
+  /**
+   * @brief Average parallax (pixels) of the landmarks tracked from the
+   * keyframe into a frame, after removing the rotation between them
+   * @param stamp frame timestamp
+   * @param R_KEYFRAME_FRAME rotation between the keyframe and the frame. It is
+   * applied as is in the primary camera, and is mapped through the extrinsics
+   * for the other cameras
+   * @return 0 if no landmark is tracked
+   */
+  double AverageParallax(const ros::Time& stamp,
+                         const Eigen::Matrix3d& R_KEYFRAME_FRAME) const;
+
+  /**
+   * @brief Remove all frames older than stamp, the keyframe landmarks are kept
+   */
+  void RemoveBefore(const ros::Time& stamp);
+
+  /**
+   * @brief Remove everything, including the keyframe
+   */
+  void Clear();
+
+  /**
+   * @brief Number of frames stored
+   */
+  size_t NumFrames() const { return frames_.size(); }
+
+private:
+  struct Pair {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    size_t camera;
+    Eigen::Vector2d keyframe_pixel;
+    // bearing of the frame measurement
+    Eigen::Vector3d bearing;
+  };
+
+  struct Frame {
+    std::vector<uint64_t> ids;
+    std::vector<Eigen::Vector2d, beam::AlignVec2d> pixels;
+    std::vector<Pair, Eigen::aligned_allocator<Pair>> pairs;
+  };
+
+  /**
+   * @brief pair the measurements of a frame with the keyframe
+   */
+  void PairWithKeyframe(Frame& frame) const;
+
+  std::shared_ptr<const CameraRig> camera_rig_;
+  std::map<ros::Time, Frame> frames_;
+  std::unordered_map<uint64_t, Eigen::Vector2d> keyframe_pixels_;
+  bool has_keyframe_{false};
+};
+
+}} // namespace bs_models::vision
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_calibration/CameraModel.h>
+#include <beam_utils/utils.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Contiguous (structure of arrays) store of landmark positions in the
+ * world frame, with a coarse voxel index so that landmarks outside the camera
+ * frustum can be culled without transforming each landmark.
+ */
+class LandmarkStore {
+public:
+  /**
+   * @brief Custom constructor
+   * @param voxel_size side length of voxels used for frustum culling
+   */
+  explicit LandmarkStore(double voxel_size = 2.0);
+
+  /**
+   * @brief Removes all landmarks
+   */
+  void Clear();
+
+  /**
+   * @brief Adds a landmark. BuildIndex must be called after all landmarks are
+   * added
+   * @param id landmark id
+   * @param position landmark position in world frame
+   */
+  void Add(uint64_t id, const Eigen::Vector3d& position);
+
+  /**
+   * @brief Builds the voxel index over all landmarks
+   */
+  void BuildIndex();
+
+  /**
+   * @brief Gets the indices of all landmarks in voxels that intersect the
+   * viewing cone of the camera
+   * @param T_CAM_WORLD transform from world to camera frame
+   * @param max_view_angle max angle (rad) between the optical axis and any ray
+   * in the image
+   * @param indices output indices into the landmark arrays
+   */
+  void GetLandmarksInView(const Eigen::Matrix4d& T_CAM_WORLD,
+                          double max_view_angle,
+                          std::vector<int>& indices) const;
+
+  /**
+   * @brief Projects landmarks into the image
+   * @param cam_model camera model to project with
+   * @param T_CAM_WORLD transform from world to camera frame
+   * @param indices landmarks to project (see GetLandmarksInView)
+   * @param projected_indices output indices of landmarks that are in the image
+   * @param pixels output pixels, one per projected index
+   */
+  void Project(const std::shared_ptr<beam_calibration::CameraModel>& cam_model,
+               const Eigen::Matrix4d& T_CAM_WORLD,
+               const std::vector<int>& indices,
+               std::vector<int>& projected_indices,
+               std::vector<Eigen::Vector2d, beam::AlignVec2d>& pixels) const;
+
+  /**
+   * @brief Number of landmarks
+   */
+  size_t Size() const { return ids_.size(); }
+
+  /**
+   * @brief Id of landmark at some index
+   */
+  uint64_t Id(int index) const { return ids_[index]; }
+
+  /**
+   * @brief Position of landmark at some index
+   */
+  Eigen::Vector3d Position(int index) const {
+    return Eigen::Vector3d(x_[index], y_[index], z_[index]);
+  }
+
+private:
+  struct Voxel {
+    Eigen::Vector3d center;
+    std::vector<int> indices;
+  };
+
+  double voxel_size_;
+  std::vector<uint64_t> ids_;
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> z_;
+  std::vector<Voxel> voxels_;
+};
+
+/**
+ * @brief Flat grid of pixel buckets used to lookup projected landmarks near a
+ * pixel
+ */
+class PixelGrid {
+public:
+  /**
+   * @brief Resets the grid to be empty
+   * @param width image width
+   * @param height image height
+   * @param cell_size bucket size in pixels
+   */
+  void Reset(int width, int height, int cell_size);
+
+  /**
+   * @brief Adds a landmark id projected at some pixel
+   */
+  void Add(const Eigen::Vector2d& pixel, uint64_t id);
+
+  /**
+   * @brief Gets all ids within a square window (in pixels) around a pixel
+   * @param pixel center of search
+   * @param radius half width of window
+   * @param ids output ids
+   */
+  void Search(const Eigen::Vector2d& pixel, double radius,
+              std::vector<uint64_t>& ids) const;
+
+private:
+  struct Entry {
+    Eigen::Vector2d pixel;
+    uint64_t id;
+  };
+
+  int cell_size_{10};
+  int cols_{0};
+  int rows_{0};
+  std::vector<std::vector<Entry>> cells_;
+};
+
+}} // namespace bs_models::vision
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_calibration/CameraModel.h>
+#include <beam_utils/utils.h>
+
+#include <bs_common/task_scheduler.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Robust absolute pose estimation from 2D-3D correspondences. P3P
+ * hypotheses are generated in parallel from random minimal samples, and each
+ * is scored by reprojecting all points in one batch. The number of iterations
+ * is adapted to the best inlier ratio found so far, so easy frames terminate
+ * early. A prior pose (e.g., from a frame initializer) can be given, it is
+ * scored like any other hypothesis, so a poor prior is simply outvoted
+ * instead of costing the frame.
+ *
+ * Results are deterministic for a given number of threads, since each thread
+ * uses its own seeded random generator.
+ */
+class PnPRansac {
+public:
+  struct Params {
+    /** max number of minimal samples */
+    int max_iterations{200};
+
+    /** max reprojection error (pixels) of inliers */
+    double inlier_threshold{5.0};
+
+    /** probability of drawing at least one outlier free sample, used to
+     * terminate early */
+    double confidence{0.99};
+
+    /** min number of inliers for a successful estimate */
+    int min_inliers{10};
+
+    /** number of real-time tasks generating hypotheses, they run on the
+     * shared task scheduler */
+    int num_threads{1};
+
+    int seed{0};
+  };
+
+  struct Result {
+    bool success{false};
+
+    /** if true, the prior was the best hypothesis */
+    bool used_prior{false};
+
+    Eigen::Matrix4d T_CAMERA_WORLD{Eigen::Matrix4d::Identity()};
+
+    /** indices of the inlier correspondences */
+    std::vector<int> inliers;
+
+    /** number of minimal samples drawn */
+    int num_iterations{0};
+  };
+
+  explicit PnPRansac(const Params& params);
+
+  /**
+   * @brief estimate the camera pose
+   * @param cam_model camera model
+   * @param pixels measured pixels
+   * @param points world points of each pixel
+   * @param T_CAMERA_WORLD_prior optional prior pose, nullptr if none
+   */
+  Result
+      Estimate(const std::shared_ptr<beam_calibration::CameraModel>& cam_model,
+               const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+               const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
+               const Eigen::Matrix4d* T_CAMERA_WORLD_prior = nullptr);
+
+private:
+  /**
+   * @brief count the reprojection inliers of a pose. Stops early and returns
+   * a count of at most min_to_beat once min_to_beat can't be exceeded
+   * @param inliers if not nullptr, filled with the inlier indices
+   */
+  int CountInliers(
+      const std::shared_ptr<beam_calibration::CameraModel>& cam_model,
+      const Eigen::Matrix4d& T_CAMERA_WORLD, const Eigen::Matrix3Xd& points,
+      const Eigen::Matrix2Xd& pixels, int min_to_beat,
+      std::vector<int>* inliers = nullptr) const;
+
+  /**
+   * @brief number of samples needed to draw an outlier free sample with the
+   * configured confidence
+   */
+  int RequiredIterations(double inlier_ratio) const;
+
+  Params params_;
+};
+
+}} // namespace bs_models::vision
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <beam_utils/utils.h>
+
+#include <bs_models/vision/camera_rig.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Motion only bundle adjustment of the baselink pose of a camera rig.
+ * The 2D-3D correspondences of all cameras are refined jointly, each with the
+ * intrinsics and extrinsics of its camera, giving one pose estimate per frame
+ * set. Pixels are rectified and reprojected with the rectified intrinsics, as
+ * done by the reprojection constraints (see
+ * bs_constraints::EuclideanReprojectionFunctor), and a Huber loss
+ * reduces the influence of the remaining outliers.
+ */
+class RigPoseRefinement {
+public:
+  struct Params {
+    /** max solver time (s) */
+    double max_solver_time{0.02};
+
+    int max_iterations{20};
+
+    /** Huber loss threshold (pixels) */
+    double loss_threshold{2.0};
+  };
+
+  /**
+   * @brief 2D-3D correspondences of one camera
+   */
+  struct Correspondences {
+    /** measured (distorted) pixels */
+    std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+
+    /** world point of each pixel */
+    std::vector<Eigen::Vector3d, beam::AlignVec3d> points;
+  };
+
+  explicit RigPoseRefinement(const Params& params);
+
+  /**
+   * @brief refine the baselink pose
+   * @param rig camera rig
+   * @param correspondences correspondences of each camera of the rig, by
+   * camera index
+   * @param T_WORLD_BASELINK initial estimate, replaced by the refined pose
+   * @param covariance if not nullptr, filled with the pose covariance ordered
+   * as x, y, z, roll, pitch, yaw
+   * @return false if there were no usable correspondences or the solver
+   * failed, the pose is then unchanged
+   */
+  bool Refine(const CameraRig& rig,
+              const std::vector<Correspondences>& correspondences,
+              Eigen::Matrix4d& T_WORLD_BASELINK,
+              Eigen::Matrix<double, 6, 6>* covariance = nullptr) const;
+
+private:
+  Params params_;
+};
+
+}} // namespace bs_models::vision
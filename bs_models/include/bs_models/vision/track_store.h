@@ -0,0 +1,84 @@
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ros/time.h>
+
+#include <beam_utils/optional.h>
+#include <beam_utils/utils.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Store of landmark observations indexed by landmark id. Each landmark
+ * maps to a contiguous, time ordered span of its observations, so all
+ * observations of a landmark are visited in O(observations) without searching
+ * every frame. Frames must be added in increasing time order, and are
+ * compacted from the front with RemoveBefore.
+ */
+class TrackStore {
+public:
+  struct Observation {
+    ros::Time stamp;
+    Eigen::Vector2d pixel;
+  };
+
+  using Track = std::vector<Observation, Eigen::aligned_allocator<Observation>>;
+
+  /**
+   * @brief Add all observations of a frame. Frames must be newer than all
+   * frames already in the store, older (or repeated) frames are ignored
+   * @param stamp frame timestamp
+   * @param ids id of each observed landmark
+   * @param pixels pixel of each observed landmark
+   * @return false if the frame was ignored
+   */
+  bool AddFrame(const ros::Time& stamp, const std::vector<uint64_t>& ids,
+                const std::vector<Eigen::Vector2d, beam::AlignVec2d>& pixels);
+
+  /**
+   * @brief Get all observations of a landmark, ordered by time. Empty if the
+   * landmark isn't in the store
+   */
+  const Track& GetTrack(uint64_t id) const;
+
+  /**
+   * @brief Get the observation of a landmark in a frame
+   */
+  beam::opt<Eigen::Vector2d> GetPixel(const ros::Time& stamp,
+                                      uint64_t id) const;
+
+  /**
+   * @brief Remove all frames older than stamp, and landmarks that have no
+   * observations left
+   */
+  void RemoveBefore(const ros::Time& stamp);
+
+  /**
+   * @brief Remove everything
+   */
+  void Clear();
+
+  /**
+   * @brief Number of frames in the store
+   */
+  size_t NumFrames() const { return frames_.size(); }
+
+  /**
+   * @brief Number of landmarks with at least one observation
+   */
+  size_t NumLandmarks() const { return tracks_.size(); }
+
+private:
+  std::unordered_map<uint64_t, Track> tracks_;
+
+  // landmarks observed in each frame, used to compact tracks
+  std::map<ros::Time, std::vector<uint64_t>> frames_;
+
+  const Track empty_track_;
+};
+
+}} // namespace bs_models::vision
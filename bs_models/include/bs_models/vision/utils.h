@@ -25,4 +25,20 @@ std::map<uint64_t, Eigen::Matrix4d> ComputePathWithVision(
     double max_optimization_time = 0.5, double information_weight = 1.0,
     double keyframe_hz = 4.0);
 
+/**
+ * @brief Reprojection errors of 2D-3D correspondences. The points are moved
+ * into the camera frame in one batch before being projected
+ * @param camera_model camera model of the measured pixels
+ * @param T_CAMERA_WORLD camera pose
+ * @param pixels measured pixels
+ * @param points world point of each pixel
+ * @return error (pixels) of each correspondence, negative if the point doesn't
+ * project into the image
+ */
+Eigen::VectorXd ComputeReprojectionErrors(
+    const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
+    const Eigen::Matrix4d& T_CAMERA_WORLD,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+    const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points);
+
 }} // namespace bs_models::vision
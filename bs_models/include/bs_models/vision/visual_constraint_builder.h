@@ -0,0 +1,120 @@
+#pragma once
+
+#include <unordered_map>
+
+#include <fuse_core/transaction.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+
+#include <bs_common/arena_allocator.h>
+#include <bs_common/pool_allocator.h>
+#include <bs_models/vision/camera_rig.h>
+
+namespace bs_models { namespace vision {
+
+class VisualMap;
+
+/**
+ * @brief Adds the reprojection constraints of a batch of measurements (e.g.,
+ * all measurements added when extending the map with a keyframe) to one
+ * transaction. Compared to adding each measurement through the VisualMap, the
+ * extrinsics are resolved once, each pose (including inverse depth anchor
+ * poses) is looked up once and cached, and constraints are allocated from a
+ * shared arena rather than individually.
+ *
+ * Poses are cached on first use, so all poses must be added to the map before
+ * constraints are added to them. A builder should not outlive the batch: graph
+ * updates on the map are not seen by an existing builder.
+ */
+class VisualConstraintBuilder {
+public:
+  /**
+   * @brief constructor
+   * @param visual_map map to get landmarks, poses and extrinsics from
+   * @param transaction to add constraints to
+   * @param use_arena if false, each constraint is allocated on its own (from
+   * the pool of its type if the map uses pooled allocation). This is preferred
+   * when adding very few constraints
+   */
+  VisualConstraintBuilder(VisualMap& visual_map,
+                          fuse_core::Transaction::SharedPtr transaction,
+                          bool use_arena = true);
+
+  /**
+   * @brief add a constraint between a euclidean landmark and a pose
+   * @param stamp image timestamp to add constraint to
+   * @param lm_id landmark to add constraint to
+   * @param pixel measured (distorted) pixel of landmark in image at stamp
+   * @return true if the constraint was added
+   */
+  bool AddVisualConstraint(const ros::Time& stamp, uint64_t lm_id,
+                           const Eigen::Vector2d& pixel);
+
+  /**
+   * @brief add a constraint between an inverse depth landmark, its anchor
+   * pose and the measurement pose
+   * @param measurement_stamp image timestamp to add constraint to
+   * @param lm_id landmark to add constraint to
+   * @param pixel measured (distorted) pixel of landmark in image at
+   * measurement_stamp
+   * @return true if the constraint was added
+   */
+  bool AddInverseDepthVisualConstraint(const ros::Time& measurement_stamp,
+                                       uint64_t lm_id,
+                                       const Eigen::Vector2d& pixel);
+
+  /**
+   * @brief get the transaction constraints are added to
+   */
+  fuse_core::Transaction::SharedPtr Transaction() const {
+    return transaction_;
+  }
+
+  /**
+   * @brief get the number of constraints added so far
+   */
+  size_t NumConstraints() const { return num_constraints_; }
+
+private:
+  struct Pose {
+    fuse_variables::Position3DStamped::SharedPtr position;
+    fuse_variables::Orientation3DStamped::SharedPtr orientation;
+  };
+
+  /**
+   * @brief get a cached pose, looking it up in the map on first use. The
+   * position and orientation are null if the pose doesn't exist
+   */
+  const Pose& GetPose(const ros::Time& stamp);
+
+  /**
+   * @brief get the rig camera of a landmark that isn't tracked by the primary
+   * camera, see VisualMap::SetCameraRig
+   * @param camera set to nullptr for landmarks of the primary camera
+   * @return false if the camera of the landmark isn't in the rig
+   */
+  bool GetCamera(uint64_t lm_id, const RigCamera*& camera) const;
+
+  /**
+   * @brief rectify a measured pixel with the camera model of the map, or of
+   * the rig camera if not nullptr
+   * @return false if the pixel can't be rectified
+   */
+  bool Rectify(const Eigen::Vector2d& pixel, const RigCamera* camera,
+               Eigen::Vector2d& measurement);
+
+  /**
+   * @brief construct a constraint in the arena if in use, or its pool, set
+   * its loss and add it to the transaction
+   */
+  template <typename ConstraintType, typename... Args>
+  void EmplaceConstraint(Args&&... args);
+
+  VisualMap& visual_map_;
+  fuse_core::Transaction::SharedPtr transaction_;
+  std::shared_ptr<bs_common::MonotonicArena> arena_;
+  std::unordered_map<uint64_t, Pose> poses_;
+  size_t num_constraints_{0};
+};
+
+}} // namespace bs_models::vision
@@ -21,6 +21,9 @@
 #include <beam_utils/optional.h>
 
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/graph_view.h>
+#include <bs_models/vision/camera_rig.h>
+#include <bs_models/vision/landmark_index.h>
 
 namespace bs_models { namespace vision {
 
@@ -42,6 +45,24 @@ public:
    */
   ~VisualMap() = default;
 
+  /**
+   * @brief Allocate the pose variables and the constraints added one at a
+   * time from the pools of their types (see bs_common::MakePooled)
+   */
+  void SetUsePooledAllocation(bool use_pooled_allocation) {
+    use_pooled_allocation_ = use_pooled_allocation;
+  }
+
+  /**
+   * @brief Sets the camera rig of a multi-camera setup. Constraints on
+   * landmarks tracked by the other cameras of the rig use the calibration of
+   * their camera, while landmarks of the primary camera keep using the camera
+   * model given at construction (and the online calibration if used)
+   */
+  void SetCameraRig(std::shared_ptr<const CameraRig> camera_rig) {
+    camera_rig_ = camera_rig;
+  }
+
   /**
    * @brief Helper function to get T_WORLD_CAMERA at tiemstamp
    * @param stamp timestamp to get pose at
@@ -97,7 +118,8 @@ public:
                    fuse_core::Transaction::SharedPtr transaction);
 
   /**
-   * @brief Helper function to add a constraint between a landmark and a pose
+   * @brief Helper function to add a constraint between a landmark and a pose.
+   * When adding many constraints, use a VisualConstraintBuilder instead
    * @param stamp associated image timestamp to add constraint to
    * @param landmark_id landmark to add constraint to
    * @param pixel measured pixel of landmark in image at img_time
@@ -130,7 +152,8 @@ public:
       fuse_core::Transaction::SharedPtr transaction);
 
   /**
-   * @brief Helper function to add a constraint between a landmark and a pose
+   * @brief Helper function to add a constraint between a landmark and a pose.
+   * When adding many constraints, use a VisualConstraintBuilder instead
    * @param stamp associated image timestamp to add constraint to
    * @param landmark_id landmark to add constraint to
    * @param pixel measured pixel of landmark in image at img_time
@@ -141,6 +164,26 @@ public:
       const Eigen::Vector2d& pixel,
       fuse_core::Transaction::SharedPtr transaction);
 
+  /**
+   * @brief Helper function to replace an inverse depth landmark of the current
+   * graph by a Euclidean landmark with the same id, e.g. once its depth has
+   * converged. The inverse depth landmark and its reprojection constraints are
+   * removed in the transaction, the caller then adds the Euclidean
+   * constraints of the landmark
+   * @param landmark_id landmark to replace
+   * @param position position of the landmark in the world frame
+   * @param viewing_angle average viewing angle of the landmark
+   * @param word_id visual word of the landmark
+   * @param transaction to add to
+   * @return false if the landmark is not in the graph, or if it has other
+   * constraints than reprojection constraints (e.g., marginalization priors)
+   * which can't be converted
+   */
+  bool ReplaceInverseDepthLandmark(
+      uint64_t landmark_id, const Eigen::Vector3d& position,
+      const Eigen::Vector3d& viewing_angle, const uint64_t word_id,
+      fuse_core::Transaction::SharedPtr transaction);
+
   /**
    * @brief Helper function to get a landmark by id
    * @param landmark_id to retrieve
@@ -249,6 +292,13 @@ public:
    */
   std::map<uint64_t, Eigen::Vector3d> GetLandmarks();
 
+  /**
+   * @brief Gets all landmarks stored contiguously with a spatial index. This
+   * is only rebuilt when the graph or local landmarks change
+   * @return landmark store
+   */
+  const LandmarkStore& GetLandmarkStore();
+
   /**
    * @brief Gets fuse uuid of landmark
    * @param landmark_id of landmark
@@ -291,6 +341,14 @@ public:
    */
   void UpdateGraph(const fuse_core::Graph& graph_msg);
 
+  /**
+   * @brief Updates current graph by sharing the pointer instead of copying.
+   * This should only be used with graphs that won't be modified after being
+   * passed in (e.g., graphs received in onGraphUpdate)
+   * @param graph_msg graph to update with
+   */
+  void UpdateGraph(fuse_core::Graph::ConstSharedPtr graph_msg);
+
   /**
    * @brief Resets map to empty state
    */
@@ -302,6 +360,8 @@ public:
   std::set<ros::Time> CurrentTimestamps();
 
 protected:
+  friend class VisualConstraintBuilder;
+
   std::string source_;
   // temp maps for in between optimization cycles
   std::map<uint64_t, fuse_variables::Orientation3DStamped::SharedPtr>
@@ -314,8 +374,11 @@ protected:
   bs_variables::Position3D::SharedPtr p_BASELINK_CAM_;
   bs_variables::Orientation3D::SharedPtr o_BASELINK_CAM_;
 
-  // copy of the current graph
-  fuse_core::Graph::SharedPtr graph_;
+  // current graph, this is either a copy or a shared optimizer graph
+  fuse_core::Graph::ConstSharedPtr graph_;
+
+  // index over the current graph, rebuilt on each graph update
+  bs_common::GraphView graph_view_;
 
   // pointer to camera model to use when adding constraints
   std::shared_ptr<beam_calibration::CameraModel> cam_model_;
@@ -323,16 +386,25 @@ protected:
   Eigen::Matrix3d camera_intrinsic_matrix_;
   double reprojection_information_weight_;
 
+  // cameras of a multi-camera rig, null if the camera model is the only one
+  std::shared_ptr<const CameraRig> camera_rig_;
+
   // robot extrinsics
   Eigen::Matrix4d T_cam_baselink_;
   Eigen::Matrix4d T_baselink_cam_;
   bs_common::ExtrinsicsLookupOnline& extrinsics_ =
       bs_common::ExtrinsicsLookupOnline::GetInstance();
 
+  // contiguous copy of all landmarks, rebuilt when outdated
+  LandmarkStore landmark_store_;
+  bool landmark_store_outdated_{true};
+
   // online calib stuff
   bool use_online_calibration_{false};
   bool calibration_added_{false};
   bool add_calibration_prior_{false};
+
+  bool use_pooled_allocation_{false};
 };
 
 }} // namespace bs_models::vision
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <bs_common/CameraMeasurementMsg.h>
+#include <bs_models/vision/camera_rig.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Snapshot of the state VisualOdometry needs to resume tracking after a
+ * restart: the keyframes of the current window with their measurements and
+ * poses, and the landmarks of the map with the word ids and viewing angles
+ * used by local map matching. The bag of words index is not stored, since it
+ * is rebuilt from the keyframe descriptors.
+ *
+ * Checkpoints are stored in a chunk file (see bs_common::ChunkFileWriter) with
+ * one chunk per keyframe and one for all landmarks. Measurements are always
+ * stored packed (see PackLandmarkMeasurements). Saving writes a temporary file
+ * which then replaces the checkpoint, so a crash while saving leaves the
+ * previous checkpoint intact.
+ */
+struct VOCheckpoint {
+  /** version of the chunk data, bump whenever it changes */
+  static constexpr uint32_t VERSION = 1;
+
+  /** set in the landmark ids of a restored checkpoint, so they never collide
+   * with the ids of the restarted feature trackers. It is the highest bit
+   * below the sensor id of rig landmark ids (see CameraRig) */
+  static constexpr uint64_t RESTORED_LANDMARK_FLAG =
+      uint64_t{1} << (CameraRig::SENSOR_ID_SHIFT - 1);
+
+  enum class ChunkType : uint32_t { KEYFRAME = 0, LANDMARKS };
+
+  struct KeyframeState {
+    bs_common::CameraMeasurementMsg msg;
+    Eigen::Matrix4d T_WORLD_BASELINK{Eigen::Matrix4d::Identity()};
+  };
+
+  struct LandmarkState {
+    uint64_t id;
+    Eigen::Vector3d position;
+    Eigen::Vector3d viewing_angle;
+    uint64_t word_id;
+  };
+
+  /** sorted by stamp */
+  std::vector<KeyframeState> keyframes;
+  std::vector<LandmarkState> landmarks;
+
+  /**
+   * @brief save to a file, replacing any existing checkpoint
+   * @return false if the file cannot be written
+   */
+  bool Save(const std::string& path) const;
+
+  /**
+   * @brief load from a file, replacing the current content
+   * @return false if the file doesn't exist or is invalid, then the content
+   * is cleared
+   */
+  bool Load(const std::string& path);
+
+  /**
+   * @brief set RESTORED_LANDMARK_FLAG in the ids of all landmarks and
+   * keyframe measurements
+   */
+  void MarkRestoredLandmarks();
+
+  /**
+   * @brief get the stamp of the last keyframe, 0 if there are none
+   */
+  ros::Time Stamp() const;
+
+  void Clear();
+};
+
+}} // namespace bs_models::vision
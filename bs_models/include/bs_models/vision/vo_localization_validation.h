@@ -49,13 +49,40 @@ public:
   void Clear();
 
 private:
+  /**
+   * @brief mean and variance of a sliding window of values, updated with
+   * Welford's algorithm as values enter and leave the window so checking a
+   * new result doesn't iterate over the stored metrics
+   */
+  struct RunningStatistics {
+    void Add(double x);
+
+    void Remove(double x);
+
+    double StdDev() const;
+
+    size_t n{0};
+    double mean{0};
+    double m2{0};
+  };
+
   bool CheckStoredMetrics() const;
 
   bool CheckMetricInitial(const VOLocalizationMetrics& m) const;
 
+  void AddToStatistics(const VOLocalizationMetrics& m);
+
+  void RemoveFromStatistics(const VOLocalizationMetrics& m);
+
   std::list<VOLocalizationMetrics> metrics_;
   int list_size_{15};
 
+  // statistics of the metrics in metrics_
+  RunningStatistics r_stats_;
+  RunningStatistics t_stats_;
+  RunningStatistics entropy_stats_;
+  RunningStatistics reproj_stats_;
+
   // these are used when metrics_.size() < list_size_ since we don't have
   // enough data to get reliable statistics
   double t_init_thresh_{0.5};
@@ -1,20 +1,62 @@
 #pragma once
 
+#include <atomic>
+#include <future>
 #include <queue>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include <fuse_core/async_sensor_model.h>
 #include <fuse_core/fuse_macros.h>
 #include <fuse_core/throttled_callback.h>
+#include <sensor_msgs/CompressedImage.h>
 #include <sensor_msgs/Image.h>
 
 #include <beam_cv/trackers/Trackers.h>
 
 #include <bs_common/bs_msgs.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/spsc_queue.h>
+#include <bs_common/thread_pool.h>
+#include <bs_models/vision/gpu_feature_tracker.h>
 #include <bs_parameters/models/visual_feature_tracker_params.h>
 
 namespace bs_models {
 
+/**
+ * @brief Tracks features in the images of one camera and publishes them as
+ * camera measurements. By default each image is decoded, preprocessed,
+ * tracked and published in the image callback. If use_pipeline is set, these
+ * steps run as a pipeline instead, so that the callback only queues the image:
+ *
+ *  - images are decoded and preprocessed (CLAHE) on a pool of
+ *    num_preprocess_threads threads,
+ *  - a tracker thread adds the images to the tracker in the order they were
+ *    received, and copies the tracks of the previous image out of the tracker,
+ *  - a publisher thread packs the descriptors and publishes the measurements.
+ *
+ * Features are tracked with beam_cv::KLTracker by default, or on the GPU with
+ * vision::GpuFeatureTracker if tracker_backend is CUDA.
+ *
+ * If image_transport is compressed, the tracker subscribes to the JPEG or PNG
+ * images published by image_transport on image_topic/compressed instead of
+ * the raw images. They are decoded straight to grayscale, and the compressed
+ * image is forwarded in the measurements instead of a raw image.
+ *
+ * Tracks of an image are only complete once the next image is tracked, so
+ * measurements are published one image late by default. If
+ * publish_immediately is set, they are published as soon as the image is
+ * tracked, and the landmarks added to the image by the next one follow in an
+ * update message (see CameraMeasurementMsg::update), so visual odometry can
+ * localize an image without waiting for the next.
+ *
+ * Stages are connected by bounded lock-free queues. When the tracker falls
+ * behind, new images are dropped by the callback instead of queuing up
+ * latency. The output is the same for both modes. Each camera has its own
+ * instance of this sensor model, so multiple cameras are always tracked
+ * concurrently.
+ */
 class VisualFeatureTracker : public fuse_core::AsyncSensorModel {
 public:
   FUSE_SMART_PTR_DEFINITIONS(VisualFeatureTracker);
@@ -25,11 +67,48 @@ public:
   VisualFeatureTracker();
 
   /**
-   * @brief Default Destructor
+   * @brief Destructor, stops the pipeline if it is running
    */
-  ~VisualFeatureTracker() override = default;
+  ~VisualFeatureTracker() override;
 
 private:
+  /**
+   * @brief Image waiting to be (or being) preprocessed
+   */
+  struct PreprocessedImage {
+    std_msgs::Header header;
+    // only one of msg and compressed_msg is set
+    sensor_msgs::Image::ConstPtr msg;
+    sensor_msgs::CompressedImage::ConstPtr compressed_msg;
+    cv::Mat image;
+  };
+
+  /**
+   * @brief Image queued for tracking, done is ready once the image is
+   * preprocessed
+   */
+  struct PendingImage {
+    std::shared_ptr<PreprocessedImage> image;
+    std::future<void> done;
+  };
+
+  /**
+   * @brief Tracks copied out of the tracker, which is all that is needed to
+   * build a measurement message without accessing the tracker
+   */
+  struct TrackedImage {
+    ros::Time timestamp;
+    // both nullptr for updates, else one is set
+    sensor_msgs::Image::ConstPtr msg;
+    sensor_msgs::CompressedImage::ConstPtr compressed_msg;
+    // if true, only landmarks added to the already published image
+    bool update{false};
+    std::vector<uint64_t> landmark_ids;
+    std::vector<cv::Mat> descriptors;
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+        pixels;
+  };
+
   /**
    * @brief Callback for image processing, this callback will add visual
    * constraints and triangulate new landmarks when required
@@ -37,6 +116,19 @@ private:
    */
   void processImage(const sensor_msgs::Image::ConstPtr& msg);
 
+  /**
+   * @brief Callback for compressed images, see processImage
+   * @param[in] msg - The compressed image to process
+   */
+  void processCompressedImage(
+      const sensor_msgs::CompressedImage::ConstPtr& msg);
+
+  /**
+   * @brief Preprocesses and tracks an image in the callback, or queues it if
+   * the pipeline is used
+   */
+  void HandleImage(std::shared_ptr<PreprocessedImage> image);
+
   /**
    * @brief Perform any required initialization for the sensor model
    *
@@ -57,16 +149,67 @@ private:
   /**
    * @brief Unsubscribe to the input topic
    */
-  void onStop() override {}
+  void onStop() override;
 
   /**
-   * @brief Builds a camera measurement message for an image
-   * @param timestamp of image to build measurements for
-   * @param image current image
+   * @brief Decodes the message of an image and equalizes its histogram before
+   * tracking, throws if a compressed image cannot be decoded
+   */
+  static void PreprocessImage(PreprocessedImage& image);
+
+  /**
+   * @brief Adds a preprocessed image to the tracker and gets the tracks to
+   * publish: those of the previous image, since tracks are only complete once
+   * the next image is tracked, or if publish_immediately is set the update of
+   * the previous image and the tracks of this one
+   * @param image preprocessed image
+   * @param tracked [out] tracks to publish, in order
+   */
+  void TrackImage(const PreprocessedImage& image,
+                  std::vector<TrackedImage>& tracked);
+
+  /**
+   * @brief Copies the tracks of an image out of the tracker
+   * @param stamp stamp of the image
+   * @param tracked [out] tracks of the image, with landmark ids unique across
+   * the cameras of a rig
+   * @param exclude landmarks not to copy
+   */
+  void GetTracks(const ros::Time& stamp, TrackedImage& tracked,
+                 const std::unordered_set<uint64_t>& exclude = {}) const;
+
+  /**
+   * @brief Builds a camera measurement message from tracks
+   * @param tracked tracks of the image to build measurements for
    */
   bs_common::CameraMeasurementMsg
-      BuildCameraMeasurement(const ros::Time& timestamp,
-                             const sensor_msgs::Image& image);
+      BuildCameraMeasurement(const TrackedImage& tracked);
+
+  /**
+   * @brief Queues an image for preprocessing and tracking, or drops it if the
+   * pipeline is full
+   */
+  void QueueImage(std::shared_ptr<PreprocessedImage> image);
+
+  /**
+   * @brief Starts the tracker and publisher threads of the pipeline
+   */
+  void StartPipeline();
+
+  /**
+   * @brief Stops and joins the pipeline threads, queued images are discarded
+   */
+  void StopPipeline();
+
+  /**
+   * @brief Loop of the tracker thread
+   */
+  void RunTracker();
+
+  /**
+   * @brief Loop of the publisher thread
+   */
+  void RunPublisher();
 
   fuse_core::UUID device_id_; //!< The UUID of this device
   // loadable camera parameters
@@ -86,10 +229,25 @@ private:
   using ThrottledImageCallback =
       fuse_core::ThrottledMessageCallback<sensor_msgs::Image>;
   ThrottledImageCallback throttled_image_callback_;
+  using ThrottledCompressedImageCallback =
+      fuse_core::ThrottledMessageCallback<sensor_msgs::CompressedImage>;
+  ThrottledCompressedImageCallback throttled_compressed_image_callback_;
 
   std::shared_ptr<beam_cv::Tracker> tracker_;
+  // replaces tracker_ if the CUDA backend is used
+  std::unique_ptr<vision::GpuFeatureTracker> gpu_tracker_;
   std::shared_ptr<beam_cv::Descriptor> descriptor_;
   ros::Time prev_time_{0};
+  // landmarks published for prev_time_, only if publish_immediately is set
+  std::unordered_set<uint64_t> prev_published_ids_;
+
+  // pipeline
+  std::unique_ptr<bs_common::ThreadPool> preprocess_pool_;
+  std::unique_ptr<bs_common::SPSCQueue<PendingImage>> pending_images_;
+  std::unique_ptr<bs_common::SPSCQueue<TrackedImage>> tracked_images_;
+  std::thread tracker_thread_;
+  std::thread publisher_thread_;
+  std::atomic<bool> pipeline_running_{false};
 };
 
 } // namespace bs_models
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <queue>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <boost/bimap.hpp>
 
@@ -9,18 +12,34 @@
 #include <fuse_core/async_sensor_model.h>
 #include <fuse_core/macros.h>
 #include <fuse_core/throttled_callback.h>
+#include <std_msgs/Bool.h>
 
 #include <beam_calibration/CameraModel.h>
 #include <beam_containers/LandmarkContainer.h>
-#include <beam_cv/ImageDatabase.h>
 #include <beam_cv/geometry/PoseRefinement.h>
 
+#include <bs_common/async_writer.h>
 #include <bs_common/bs_msgs.h>
+#include <bs_common/callback_lane.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/flat_time_map.h>
+#include <bs_common/stamp_index.h>
+#include <bs_models/graph_visualization/landmark_cloud.h>
 #include <bs_models/frame_initializers/frame_initializer.h>
+#include <bs_models/vision/batch_triangulator.h>
+#include <bs_models/vision/bow_service.h>
+#include <bs_models/vision/camera_rig.h>
+#include <bs_models/vision/frame_set_assembler.h>
 #include <bs_models/vision/keyframe.h>
+#include <bs_models/vision/keyframe_parallax.h>
+#include <bs_models/vision/pnp_ransac.h>
+#include <bs_models/vision/rig_pose_refinement.h>
+#include <bs_models/vision/track_store.h>
+#include <bs_models/vision/visual_constraint_builder.h>
 #include <bs_models/vision/visual_map.h>
+#include <bs_models/vision/vo_checkpoint.h>
 #include <bs_models/vision/vo_localization_validation.h>
+#include <bs_optimizers/incremental_problem.h>
 #include <bs_parameters/models/calibration_params.h>
 #include <bs_parameters/models/visual_odometry_params.h>
 
@@ -39,10 +58,60 @@ public:
 private:
   /// @brief Callback for image processing, this callback will add visual
   /// constraints and triangulate new landmarks when required
-  /// @param msg The visual measurements to process
+  /// @param msg The visual measurements of the primary camera to process
   void
       processMeasurements(const bs_common::CameraMeasurementMsg::ConstPtr& msg);
 
+  /// @brief Adds the measurements of a camera of a multi-camera rig to their
+  /// frame set, and processes the set once it is complete
+  /// @param msg The visual measurements
+  /// @param camera index of the camera in the rig
+  void AddToFrameSet(const bs_common::CameraMeasurementMsg::ConstPtr& msg,
+                     size_t camera);
+
+  /// @brief Saves the keyframes and landmarks of the current map as a
+  /// checkpoint. The snapshot is taken here and written on the checkpoint
+  /// writer thread, it is skipped if the previous one is still being written
+  void SaveCheckpoint();
+
+  /// @brief Restores the loaded checkpoint before the first frame, if it's
+  /// recent enough. Its keyframe poses (with priors), landmarks and
+  /// reprojection constraints are sent to the graph, so the graph starts in the
+  /// world frame of the checkpoint, and its keyframe measurements are
+  /// buffered so that Initialize makes them the keyframes of the new graph
+  /// @param stamp stamp of the first frame
+  void RestoreCheckpoint(const ros::Time& stamp);
+
+  /// @brief Whether the previous keyframe is the last keyframe of a restored
+  /// checkpoint. The frame initializer has no poses from before the restart,
+  /// so the next frame starts at the pose of that keyframe, is matched to the
+  /// restored landmarks by local map matching and is always a keyframe
+  bool FollowsRestoredKeyframe() const;
+
+  /// @brief Matches the landmarks of a frame to the restored landmarks with
+  /// local map matching, the matches are added to new_to_old_lm_ids_
+  /// @param timestamp frame time
+  /// @param T_WORLD_BASELINK initial estimate of the frame pose
+  void MatchRestoredLandmarks(const ros::Time& timestamp,
+                              const Eigen::Matrix4d& T_WORLD_BASELINK);
+
+  /// @brief Adds the landmarks of an update message to the frame it updates,
+  /// which is already in the landmark container. Updates are sent by feature
+  /// trackers that publish measurements before their tracks are complete,
+  /// see CameraMeasurementMsg::update
+  /// @param msg The measurement update
+  void AddMeasurementUpdate(const bs_common::CameraMeasurementMsg& msg);
+
+  /// @brief Adds the measurements of all cameras of a frame to the landmark
+  /// container, then localizes the buffered frames
+  /// @param frame_set measurements of each camera, by camera index
+  void ProcessFrameSet(const vision::FrameSetAssembler::FrameSet& frame_set);
+
+  /// @brief Localizes the buffered frames in order, until one can't be
+  /// localized. If the frame initializer hasn't reached it yet, a wakeup is
+  /// requested to retry as soon as it does. buffer_mutex_ must be locked
+  void ProcessMeasurementBuffer();
+
   /// @brief Perform any required initialization for the sensor model
   /// This could include things like reading from the parameter server or
   /// subscribing to topics. The class's node handles will be
@@ -58,10 +127,20 @@ private:
   /// @brief Unsubscribe to the input topics and clear memory
   void onStop() override;
 
+  /// @brief Callback for the optimizer back-pressure state, keyframes are
+  /// selected less often while it is on
+  /// @param msg back-pressure state
+  void BackpressureCallback(const std_msgs::Bool::ConstPtr& msg);
+
   /// @brief Callback for when a newly optimized graph is available
   /// @param graph_msg incoming grpah
   void onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph) override;
 
+  /**
+   * @brief queue graph updates on graph_update_lane_ if it is configured
+   */
+  void graphCallback(fuse_core::Graph::ConstSharedPtr graph) override;
+
   /// @brief Localizes image and extends our visual map if its a keyframe
   /// @param msg visual measurements
   /// @return whether it succeeded in localizing
@@ -78,6 +157,36 @@ private:
                      Eigen::Matrix4d& T_WORLD_BASELINK,
                      Eigen::Matrix<double, 6, 6>& covariance);
 
+  /// @brief Refines the pose of a frame with the correspondences of a single
+  /// camera
+  /// @param correspondences 2d-3d correspondences, reduced to the inliers
+  /// @param T_WORLD_BASELINK_init initial estimate, replaced by the robust
+  /// estimate if it is better
+  /// @param T_WORLD_BASELINK refined pose
+  /// @param covariance
+  /// @return false if the refinement failed
+  bool RefineMonocular(
+      vision::RigPoseRefinement::Correspondences& correspondences,
+      Eigen::Matrix4d& T_WORLD_BASELINK_init,
+      Eigen::Matrix4d& T_WORLD_BASELINK,
+      Eigen::Matrix<double, 6, 6>& covariance);
+
+  /// @brief Refines the pose of a frame jointly with the correspondences of
+  /// all cameras of the rig. The robust estimate of each camera runs in
+  /// parallel
+  /// @param correspondences 2d-3d correspondences of each camera, reduced to
+  /// the inliers
+  /// @param T_WORLD_BASELINK_init initial estimate, replaced by the best
+  /// robust estimate of the cameras if it is better
+  /// @param T_WORLD_BASELINK refined pose
+  /// @param covariance
+  /// @return false if the refinement failed
+  bool RefineRig(
+      std::vector<vision::RigPoseRefinement::Correspondences>& correspondences,
+      Eigen::Matrix4d& T_WORLD_BASELINK_init,
+      Eigen::Matrix4d& T_WORLD_BASELINK,
+      Eigen::Matrix<double, 6, 6>& covariance);
+
   /// @brief Extends the map at the current keyframe time and adds the visual
   /// constraints
   /// @param timestamp
@@ -87,34 +196,78 @@ private:
                  const Eigen::Matrix4d& T_WORLD_BASELINK,
                  const Eigen::Matrix<double, 6, 6>& covariance);
 
-  /// @brief Determines if a frame is a keyframe
+  /// @brief Determines if a frame is a keyframe, from the statistics of
+  /// keyframe_parallax_ so the landmark container isn't searched
   /// @param timestamp
   /// @param T_WORLD_BASELINK
   /// @return whether a frame is a keyframe
   bool IsKeyframe(const ros::Time& timestamp,
                   const Eigen::Matrix4d& T_WORLD_BASELINK);
 
-  /// @brief Adds visual measurements to the landmark container
-  /// @param msg
+  /// @brief Adds the visual measurements of a frame to the landmark
+  /// container, after removing the track outliers of each camera
+  /// @param frame_set measurements of each camera, by camera index
   void AddMeasurementsToContainer(
-      const bs_common::CameraMeasurementMsg::ConstPtr& msg);
-
-  /// @brief Triangulates a landmark of the given id
+      const vision::FrameSetAssembler::FrameSet& frame_set);
+
+  /// @brief Finds the measurements of a camera that are outliers of the
+  /// epipolar geometry with the previous frame. This only reads the landmark
+  /// container, so the cameras of a rig are checked in parallel
+  /// @param msg measurements of the camera
+  /// @param camera camera of the measurements
+  /// @return landmark ids of the outliers
+  std::unordered_set<uint64_t>
+      FindTrackOutliers(const bs_common::CameraMeasurementMsg& msg,
+                        const vision::RigCamera& camera) const;
+
+  /// @brief Adds the measurements of a new keyframe (after outlier rejection)
+  /// to the keyframe tracks
+  /// @param timestamp keyframe time
+  void AddKeyframeObservations(const ros::Time& timestamp);
+
+  /// @brief A landmark triangulated at the current keyframe, which isn't in
+  /// the map yet
+  struct NewLandmark {
+    Eigen::Vector3d position;
+    Eigen::Vector3d average_viewing_angle;
+    uint64_t word_id;
+  };
+
+  /// @brief Gathers the keyframe measurements needed to triangulate a
+  /// landmark
   /// @param id of landmark
-  /// @return optional 3d location
-  beam::opt<Eigen::Vector3d>
-      TriangulateLandmark(const uint64_t id,
-                          Eigen::Vector3d& average_viewing_angle,
-                          uint64_t& visual_word_id);
+  /// @param request output poses and pixels of the landmark
+  /// @param average_viewing_angle output average viewing angle in world frame
+  /// @param visual_word_id output most common word id of the measurements
+  /// @return false if less than 2 keyframes with a pose have seen it
+  bool GetTriangulationRequest(const uint64_t id,
+                               vision::BatchTriangulator::Request& request,
+                               Eigen::Vector3d& average_viewing_angle,
+                               uint64_t& visual_word_id);
+
+  /// @brief Triangulates all given landmarks which aren't in the map yet in
+  /// one parallel batch
+  /// @param landmarks ids of landmarks seen in the current keyframe
+  /// @return successfully triangulated landmarks, by id
+  std::unordered_map<uint64_t, NewLandmark>
+      TriangulateNewLandmarks(const std::vector<uint64_t>& landmarks);
 
   /// @brief Gets 2d-3d correspondences for landmarks measured at a given time
   /// @param timestamp
-  /// @param pixels
-  /// @param points
-  void GetPixelPointPairs(
+  /// @param correspondences output correspondences of each camera of the
+  /// rig, by camera index
+  /// @return total number of correspondences
+  size_t GetPixelPointPairs(
       const ros::Time& timestamp,
-      std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
-      std::vector<Eigen::Vector3d, beam::AlignVec3d>& points);
+      std::vector<vision::RigPoseRefinement::Correspondences>&
+          correspondences);
+
+  /// @brief Gets the pose of the camera that tracks a landmark
+  /// @param stamp
+  /// @param landmark_id
+  /// @return T_WORLD_CAMERA, nullopt if the pose isn't in the map
+  beam::opt<Eigen::Matrix4d> GetCameraPose(const ros::Time& stamp,
+                                           uint64_t landmark_id);
 
   /// @brief
   /// @param timestamp
@@ -142,17 +295,39 @@ private:
   /// using the IDP parameterization
   /// @param id of landmark to add
   /// @param timestamp timestamp of measurement
-  /// @param transaction transaction to ammed to
-  void ProcessLandmarkIDP(const uint64_t id, const ros::Time& timestamp,
-                          fuse_core::Transaction::SharedPtr transaction);
+  /// @param new_landmarks landmarks triangulated at this keyframe
+  /// @param builder constraint builder of the keyframe transaction
+  void ProcessLandmarkIDP(
+      const uint64_t id, const ros::Time& timestamp,
+      const std::unordered_map<uint64_t, NewLandmark>& new_landmarks,
+      vision::VisualConstraintBuilder& builder);
+
+  /// @brief Replaces an inverse depth landmark of the graph by a euclidean
+  /// landmark once its depth has converged, which removes the anchor pose from
+  /// its constraints. The depth is converged once the relative depth standard
+  /// deviation estimated from the pixel noise and the parallax between the
+  /// anchor and current keyframes is below idp_conversion_max_depth_std
+  /// @param id of landmark to convert
+  /// @param timestamp timestamp of the current keyframe
+  /// @param landmark current estimate of the landmark
+  /// @param builder constraint builder of the keyframe transaction
+  /// @return true if the landmark was converted, then all of its keyframe
+  /// measurements have euclidean constraints
+  bool ConvertConvergedLandmark(
+      const uint64_t id, const ros::Time& timestamp,
+      const bs_variables::InverseDepthLandmark& landmark,
+      vision::VisualConstraintBuilder& builder);
 
   /// @brief Add all required variables and constraints for a specific landmark
   /// using the euclidean parameterization
   /// @param id of landmark to add
   /// @param timestamp timestamp of measurement
-  /// @param transaction transaction to ammed to
-  void ProcessLandmarkEUC(const uint64_t id, const ros::Time& timestamp,
-                          fuse_core::Transaction::SharedPtr transaction);
+  /// @param new_landmarks landmarks triangulated at this keyframe
+  /// @param builder constraint builder of the keyframe transaction
+  void ProcessLandmarkEUC(
+      const uint64_t id, const ros::Time& timestamp,
+      const std::unordered_map<uint64_t, NewLandmark>& new_landmarks,
+      vision::VisualConstraintBuilder& builder);
 
   /// @brief Creates a visual odometry factor between this frame and th previous
   /// keyframe
@@ -167,22 +342,39 @@ private:
 
   /// @brief Prunes the keyframes using the new graph and publishes them as
   /// slam chunks
-  /// @param new_graph the newly updated graph (from ongraphupdate or in our own
-  /// marginalization)
-  void PruneKeyframes(const fuse_core::Graph& new_graph);
+  /// @param new_stamps stamps of the newly updated graph (from ongraphupdate or
+  /// in our own marginalization)
+  void PruneKeyframes(const bs_common::StampIndex& new_stamps);
+
+  /// @brief Updates the memory accounts of the keyframes and the landmark
+  /// container, removing the oldest measurements from the container if it is
+  /// over budget
+  void UpdateMemoryAccounts();
 
   /// @brief Marginalizes the current local graph is standalone vo is being used
   /// @param new_graph graph pulled from on graph update
   void MarginalizeLocalGraph(const fuse_core::Graph& new_graph);
 
   /// @brief Updates the local graph with non visual constraints in the new
-  /// graph
+  /// graph. Only new variables and constraints are copied, variables that are
+  /// already in the local graph have their values updated in place
   /// @param new_graph graph pulled from on graph update
   void UpdateLocalGraph(const fuse_core::Graph& new_graph);
 
-  /// @brief Publishes all landmarks in the graph as a point cloud
-  /// @param graph
-  void PublishLandmarkPointCloud(const fuse_core::Graph& graph);
+  /// @brief Applies a transaction to the local graph and to the local problem
+  /// @param transaction
+  void ApplyLocalTransaction(const fuse_core::Transaction& transaction);
+
+  /// @brief Optimizes the local graph, reusing the local problem
+  /// @param max_time_s max solver time
+  void OptimizeLocalGraph(double max_time_s);
+
+  /// @brief Publishes the landmarks of the local graph as a point cloud, and
+  /// the landmarks added or moved since the previous publish. The cloud is
+  /// updated by each local transaction instead of scanning the graph, and
+  /// isn't kept while no one subscribes
+  /// @param transaction transaction that was just applied and optimized
+  void PublishLandmarkPointCloud(const fuse_core::Transaction& transaction);
 
   /// @brief Gets initial pose estimate using the frame initializer
   /// @param timestamp
@@ -196,6 +388,10 @@ private:
   /// @param T_WORLD_BASELINK frame to project into
   void ProjectMapPoints(const Eigen::Matrix4d& T_WORLD_BASELINK);
 
+  /// @brief Computes the max angle between the optical axis and any pixel ray
+  /// @return angle in radians, or pi if it cannot be computed
+  double ComputeMaxViewAngle();
+
   /// @brief Searches for a matching landmark using the projected local map
   /// points
   /// @param pixel input pixel measurement
@@ -215,13 +411,12 @@ private:
 
   /// @brief
   /// @param T_WORLD_BASELINK
-  /// @param pixels
-  /// @param points
+  /// @param correspondences of each camera of the rig
   /// @return
   double ComputeAverageReprojection(
       const Eigen::Matrix4d& T_WORLD_BASELINK,
-      const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
-      const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points);
+      const std::vector<vision::RigPoseRefinement::Correspondences>&
+          correspondences);
 
   /// @brief shuts down subscribers and resets to base state
   void shutdown();
@@ -243,6 +438,8 @@ private:
 
   /// @brief subscribers/clients
   ros::Subscriber measurement_subscriber_;
+  std::vector<ros::Subscriber> additional_measurement_subscribers_;
+  ros::Subscriber backpressure_subscriber_;
 
   /// @brief publishers
   ros::Publisher odometry_publisher_;
@@ -250,12 +447,17 @@ private:
   ros::Publisher slam_chunk_publisher_;
   ros::Publisher imu_constraint_trigger_publisher_;
   ros::Publisher camera_landmarks_publisher_;
+  ros::Publisher camera_landmark_updates_publisher_;
   ros::Publisher reset_publisher_;
 
   /// @brief book keeping variables
   bool is_initialized_{false};
   bool resetting_{false};
-  std::map<ros::Time, vision::Keyframe> keyframes_;
+  std::atomic<bool> backpressure_{false};
+  bs_common::FlatTimeMap<ros::Time, vision::Keyframe> keyframes_;
+  /// @brief measurements of each landmark in keyframes_, compacted along with
+  /// keyframes_ in PruneKeyframes
+  vision::TrackStore keyframe_tracks_;
   std::deque<bs_common::CameraMeasurementMsg::ConstPtr>
       visual_measurement_buffer_;
   ros::Time previous_keyframe_;
@@ -271,9 +473,17 @@ private:
 
   /// @brief local map matching stuff
   boost::bimap<uint64_t, uint64_t> new_to_old_lm_ids_;
-  cv::Mat landmark_projection_mask_;
-  std::map<uint64_t, uint64_t> image_projection_to_lm_id_;
-  std::shared_ptr<beam_cv::ImageDatabase> image_db_;
+  vision::PixelGrid projected_landmarks_grid_;
+  double max_view_angle_{M_PI};
+  std::vector<int> visible_landmarks_;
+  std::vector<int> projected_landmarks_;
+  std::vector<Eigen::Vector2d, beam::AlignVec2d> projected_pixels_;
+  std::vector<uint64_t> candidate_lm_matches_;
+  int local_map_search_radius_{10};
+  /// @brief word ids of all frames in the landmark container are computed on
+  /// the bow service thread, and keyframes are added to its place recognition
+  /// index
+  std::shared_ptr<vision::BowService> bow_service_;
 
   /// @brief callbacks for messages
   using ThrottledMeasurementCallback =
@@ -282,11 +492,28 @@ private:
 
   /// @brief computer vision objects
   std::shared_ptr<beam_calibration::CameraModel> cam_model_;
-  Eigen::Matrix3d cam_intrinsic_matrix_;
-  cv::Mat K_;
   std::shared_ptr<beam_containers::LandmarkContainer> landmark_container_;
   std::shared_ptr<vision::VisualMap> visual_map_;
   std::shared_ptr<beam_cv::PoseRefinement> pose_refiner_;
+  std::shared_ptr<vision::BatchTriangulator> triangulator_;
+  /// @brief only set if use_ransac_localization is true
+  std::shared_ptr<vision::PnPRansac> pnp_ransac_;
+
+  /// @brief cameras of the rig, the primary camera is cam_model_. With more
+  /// than one camera, the measurements of all cameras at the same time are
+  /// processed as one frame and localized jointly
+  std::shared_ptr<vision::CameraRig> camera_rig_;
+  std::shared_ptr<vision::RigPoseRefinement> rig_pose_refiner_;
+  std::unique_ptr<vision::FrameSetAssembler> frame_set_assembler_;
+
+  /// @brief tracking and parallax statistics wrt the previous keyframe,
+  /// updated as measurements are added to the landmark container
+  std::unique_ptr<vision::KeyframeParallax> keyframe_parallax_;
+
+  /// @brief landmarks of the local graph for visualization (standalone vo)
+  graph_visualization::LandmarkCloud landmark_cloud_;
+  ros::Time last_landmarks_publish_time_{0};
+  std::mutex frame_set_mutex_;
 
   /// @brief robot extrinsics
   Eigen::Matrix4d T_cam_baselink_;
@@ -298,8 +525,32 @@ private:
   fuse_core::Graph::SharedPtr local_graph_;
   ceres::Solver::Options local_solver_options_;
 
+  // kept in sync with the local graph so that each local solve reuses the
+  // same ceres problem, see ApplyLocalTransaction
+  bs_optimizers::IncrementalProblem local_problem_;
+
+  // main graph constraints that have been copied to the local graph
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash>
+      imported_constraints_;
+
+  // stamps of the pose states in the local graph, see ApplyLocalTransaction
+  bs_common::StampIndex local_stamps_;
+
+  /// @brief warm restart stuff, see vision::VOCheckpoint. The checkpoint
+  /// loaded on startup is kept until the first frame
+  std::unique_ptr<bs_common::AsyncWriter> checkpoint_writer_;
+  ros::Time last_checkpoint_time_{0};
+  std::unique_ptr<vision::VOCheckpoint> restored_checkpoint_;
+  ros::Time restored_keyframe_{0};
+
   /// @brief params only changeable here
   bool use_frame_init_relative_{true};
+
+  // graph updates, only set if graph_update_lane/queue_size or
+  // graph_update_lane/dedicated is set. Declared last so it is destroyed
+  // first, stopping its callbacks before the members they use are destroyed
+  std::unique_ptr<bs_common::CallbackLane<fuse_core::Graph>>
+      graph_update_lane_;
 };
 
 } // namespace bs_models
@@ -3,6 +3,7 @@
 #include <filesystem>
 
 #include <fuse_core/transaction.h>
+#include <pcl/common/transforms.h>
 #include <pluginlib/class_list_macros.h>
 
 #include <beam_utils/log.h>
@@ -11,6 +12,7 @@
 
 #include <bs_common/conversions.h>
 #include <bs_common/graph_access.h>
+#include <bs_common/startup_profiler.h>
 
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::GlobalMapper, fuse_core::SensorModel)
@@ -52,7 +54,8 @@ void GlobalMapper::ProcessSlamChunk(
     // uncomment if using self contained graph:
     graph_->update(*new_transaction);
     graph_->optimize();
-    global_map_->UpdateSubmapPoses(graph_, ros::Time::now());
+    global_map_->UpdateSubmapPoses(graph_snapshot_builder_.Build(*graph_),
+                                   ros::Time::now());
   }
 
   if (params_.publish_new_submaps || params_.publish_updated_global_map ||
@@ -70,12 +73,66 @@ void GlobalMapper::ProcessSlamChunk(
         global_map_lidar_publisher_.publish(ros_map->second);
       } else if (ros_map->first == RosMapType::VISUALGLOBALMAP) {
         global_map_keypoints_publisher_.publish(ros_map->second);
+      } else if (ros_map->first == RosMapType::LIDARGLOBALMAPTILE) {
+        global_map_lidar_tiles_publisher_.publish(ros_map->second);
       }
     }
   }
 }
 
+void GlobalMapper::ProcessRelocRequest(
+    const bs_common::RelocRequestMsg::ConstPtr& msg) {
+  // the query submaps read the extrinsics, which are set with the first slam
+  // chunk
+  if (!extrinsics_initialized_) {
+    ROS_WARN_THROTTLE(1, "Extrinsics not initialized, ignoring reloc request");
+    return;
+  }
+
+  RelocServer::Request request;
+  request.stamp = msg->T_WORLD_BASELINK.header.stamp;
+  bs_common::PoseMsgToTransformationMatrix(msg->T_WORLD_BASELINK,
+                                           request.T_WORLD_BASELINK);
+
+  // unpack lidar measurement, which is in the baselink frame
+  const bs_common::LidarMeasurementMsg& lid_measurement =
+      msg->lidar_measurement;
+  PointCloud cloud;
+  beam_matching::LoamPointCloud loam_cloud;
+  GlobalMap::UnpackLidarMeasurement(lid_measurement, cloud, loam_cloud);
+  if (cloud.empty() && loam_cloud.Size() == 0) {
+    BEAM_WARN("Reloc request {} has no lidar points, ignoring",
+              request.stamp.toSec());
+    return;
+  }
+
+  // the submaps store the clouds in the lidar frame
+  Eigen::Matrix4d T_LIDAR_BASELINK;
+  if (!extrinsics_data_->GetT_LIDAR_BASELINK(T_LIDAR_BASELINK)) {
+    BEAM_ERROR("Cannot get extrinsics, ignoring reloc request");
+    return;
+  }
+  pcl::transformPointCloud(cloud, request.cloud, T_LIDAR_BASELINK);
+  request.loam_cloud =
+      beam_matching::LoamPointCloud(loam_cloud, T_LIDAR_BASELINK);
+
+  global_map_->GetRelocServer()->Submit(std::move(request));
+}
+
+void GlobalMapper::PublishRelocResponse(
+    const RelocServer::Response& response) {
+  bs_common::RelocResponseMsg msg;
+  msg.request_stamp = response.stamp;
+  msg.success = response.successful;
+  msg.submap_id = response.submap_id;
+  bs_common::EigenTransformToPoseStamped(
+      response.T_WORLD_BASELINK, response.stamp, reloc_response_seq_++,
+      extrinsics_data_->GetWorldFrameId(), msg.T_WORLD_BASELINK);
+  reloc_response_publisher_.publish(msg);
+}
+
 void GlobalMapper::onInit() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_init");
   // load params
   params_.loadFromROS(private_node_handle_);
   calibration_params_.loadFromROS();
@@ -85,10 +142,11 @@ void GlobalMapper::onInit() {
 }
 
 void GlobalMapper::onStart() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_start");
   // init subscribers and publishers
   slam_chunk_subscriber_ =
       private_node_handle_.subscribe<bs_common::SlamChunkMsg>(
-          ros::names::resolve("/local_mapper/slam_results"), 100,
+          ros::names::resolve(params_.slam_chunk_topic), 100,
           &ThrottledCallbackSlamChunk::callback,
           &throttled_callback_slam_chunk_,
           ros::TransportHints().tcpNoDelay(false));
@@ -114,6 +172,10 @@ void GlobalMapper::onStart() {
     global_map_keypoints_publisher_ =
         private_node_handle_.advertise<sensor_msgs::PointCloud2>(
             "global_map/visual", 10);
+    // one message per changed tile, see TiledLidarMap
+    global_map_lidar_tiles_publisher_ =
+        private_node_handle_.advertise<sensor_msgs::PointCloud2>(
+            "global_map/lidar_tiles", 1000);
   }
 
   // get intrinsics
@@ -132,6 +194,27 @@ void GlobalMapper::onStart() {
   global_map_->SetStoreUpdatedGlobalMap(params_.publish_updated_global_map);
   global_map_->SetStoreNewScans(params_.publish_new_scans);
 
+  // reloc requests get their own queue and spinner so they are received while
+  // a slam chunk is being processed
+  if (global_map_->GetRelocServer()) {
+    reloc_response_publisher_ =
+        private_node_handle_.advertise<bs_common::RelocResponseMsg>(
+            "reloc_response", 10);
+    global_map_->GetRelocServer()->SetResponseCallback(
+        [this](const RelocServer::Response& response) {
+          PublishRelocResponse(response);
+        });
+    ros::SubscribeOptions options =
+        ros::SubscribeOptions::create<bs_common::RelocRequestMsg>(
+            ros::names::resolve("/local_mapper/reloc_request"), 10,
+            boost::bind(&GlobalMapper::ProcessRelocRequest, this, _1),
+            ros::VoidPtr(), &reloc_callback_queue_);
+    reloc_request_subscriber_ = private_node_handle_.subscribe(options);
+    reloc_spinner_ =
+        std::make_unique<ros::AsyncSpinner>(1, &reloc_callback_queue_);
+    reloc_spinner_->start();
+  }
+
   // setup output
   if (!std::filesystem::exists(params_.output_path)) {
     BEAM_ERROR("Invalid output path: {}", params_.output_path);
@@ -158,6 +241,27 @@ void GlobalMapper::onStart() {
 };
 
 void GlobalMapper::onStop() {
+  // stop answering reloc requests first, so the workers don't compete with
+  // the final loop closures and saving
+  if (reloc_spinner_) {
+    reloc_request_subscriber_.shutdown();
+    reloc_spinner_->stop();
+    global_map_->GetRelocServer()->Stop();
+  }
+
+  // finish any loop closures and submaps finalizing in the background
+  global_map_->FinishLoopClosures();
+  fuse_core::Transaction::SharedPtr async_transaction =
+      global_map_->GetCompletedLoopClosures();
+  if (async_transaction) {
+    BEAM_INFO("Adding {} loop closures completed in the background.",
+              bs_common::GetNumberOfConstraints(async_transaction));
+    graph_->update(*async_transaction);
+    graph_->optimize();
+    global_map_->UpdateSubmapPoses(graph_snapshot_builder_.Build(*graph_),
+                                   ros::Time::now());
+  }
+
   if (trigger_loop_closure_on_stop_) {
     // use beam logging here because ROS logging stops when a node shutdown gets
     // called
@@ -169,7 +273,8 @@ void GlobalMapper::onStop() {
                 bs_common::GetNumberOfConstraints(transaction_ptr));
       graph_->update(*transaction_ptr);
       graph_->optimize();
-      global_map_->UpdateSubmapPoses(graph_, ros::Time::now());
+      global_map_->UpdateSubmapPoses(graph_snapshot_builder_.Build(*graph_),
+                                     ros::Time::now());
     } else {
       BEAM_INFO("No loop closures added on stop.");
     }
@@ -1,7 +1,10 @@
 #include <bs_models/graph_publisher.h>
 
 #include <filesystem>
+#include <set>
 
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
 #include <pluginlib/class_list_macros.h>
@@ -16,7 +19,7 @@
 #include <bs_common/graph_access.h>
 #include <bs_common/utils.h>
 #include <bs_common/visualization.h>
-#include <bs_models/graph_visualization/helpers.h>
+#include <bs_models/vision/camera_measurement_view.h>
 
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::GraphPublisher, fuse_core::SensorModel);
@@ -26,6 +29,7 @@ const std::string k_visual_measurements_topic{
 const std::string k_graph_path_topic{"poses"};
 const std::string k_graph_odom_topic{"odom"};
 const std::string k_cam_landmarks_topic{"camera_landmarks"};
+const std::string k_cam_landmark_updates_topic{"camera_landmark_updates"};
 const std::string k_cam_keypoints_image_topic{"tracked_image"};
 
 namespace bs_models {
@@ -37,6 +41,11 @@ GraphPublisher::GraphPublisher()
                     std::placeholders::_1)) {}
 
 void GraphPublisher::onInit() {
+  private_node_handle_.param("path_publish_period", path_publish_period_,
+                             path_publish_period_);
+  private_node_handle_.param("landmarks_publish_period",
+                             landmarks_publish_period_,
+                             landmarks_publish_period_);
   landmark_container_ = std::make_shared<beam_containers::LandmarkContainer>();
   bs_parameters::models::CalibrationParams calibration_params_;
   calibration_params_.loadFromROS();
@@ -45,6 +54,11 @@ void GraphPublisher::onInit() {
 }
 
 void GraphPublisher::onStart() {
+  poses_.clear();
+  pose_stamps_.clear();
+  path_outdated_ = false;
+  landmark_cloud_.Clear();
+
   feature_track_subscriber_ =
       private_node_handle_.subscribe<bs_common::CameraMeasurementMsg>(
           k_visual_measurements_topic, 100,
@@ -61,6 +75,9 @@ void GraphPublisher::onStart() {
   camera_landmarks_publisher_.publisher =
       private_node_handle_.advertise<sensor_msgs::PointCloud2>(
           k_cam_landmarks_topic, 10);
+  camera_landmark_updates_publisher_.publisher =
+      private_node_handle_.advertise<sensor_msgs::PointCloud2>(
+          k_cam_landmark_updates_topic, 10);
   image_publisher_.publisher =
       private_node_handle_.advertise<sensor_msgs::Image>(
           k_cam_keypoints_image_topic, 10);
@@ -73,53 +90,195 @@ void GraphPublisher::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) {
 }
 
 void GraphPublisher::PublishPoses(fuse_core::Graph::ConstSharedPtr graph_msg) {
-  // publish path each time
+  // the delta is relative to the previous snapshot, so the first poses are
+  // read from the full graph
+  const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(*graph_msg);
+  if (delta && !poses_.empty()) {
+    UpdatePoses(*graph_msg, *delta);
+  } else {
+    ResetPoses(*graph_msg);
+  }
+  PublishPath();
+}
+
+void GraphPublisher::UpdatePoses(const fuse_core::Graph& graph,
+                                 const bs_common::GraphDelta& delta) {
+  // publish odom for poses that have been marginalized out, the other
+  // variable of the pose is removed with the first one
+  for (const fuse_core::UUID& uuid : delta.removed_variables) {
+    const auto stamp_it = pose_stamps_.find(uuid);
+    if (stamp_it == pose_stamps_.end()) { continue; }
+    const ros::Time stamp = stamp_it->second;
+    pose_stamps_.erase(fuse_core::uuid::generate(
+        "fuse_variables::Position3DStamped", stamp, fuse_core::uuid::NIL));
+    pose_stamps_.erase(fuse_core::uuid::generate(
+        "fuse_variables::Orientation3DStamped", stamp, fuse_core::uuid::NIL));
+    const auto pose_it = poses_.find(stamp);
+    if (pose_it == poses_.end()) { continue; }
+    PublishMarginalizedPose(stamp, pose_it->second);
+    poses_.erase(pose_it);
+    path_outdated_ = true;
+  }
+
+  // update the poses of new and changed variables
+  std::set<ros::Time> updated_stamps;
+  auto add_updated = [&](const std::vector<fuse_core::UUID>& uuids) {
+    for (const fuse_core::UUID& uuid : uuids) {
+      const auto stamp_it = pose_stamps_.find(uuid);
+      if (stamp_it != pose_stamps_.end()) {
+        updated_stamps.insert(stamp_it->second);
+        continue;
+      }
+      if (!graph.variableExists(uuid)) { continue; }
+      const fuse_core::Variable& variable = graph.getVariable(uuid);
+      ros::Time stamp;
+      const bs_common::VariableType type = bs_common::GetVariableType(variable);
+      if (type == bs_common::VariableType::POSITION) {
+        stamp = static_cast<const fuse_variables::Position3DStamped&>(variable)
+                    .stamp();
+      } else if (type == bs_common::VariableType::ORIENTATION) {
+        stamp =
+            static_cast<const fuse_variables::Orientation3DStamped&>(variable)
+                .stamp();
+      } else {
+        continue;
+      }
+      pose_stamps_.emplace(uuid, stamp);
+      updated_stamps.insert(stamp);
+    }
+  };
+  add_updated(delta.added_variables);
+  add_updated(delta.changed_variables);
+
+  for (const ros::Time& stamp : updated_stamps) {
+    Eigen::Matrix4d T_World_Baselink;
+    if (GetPose(graph, stamp, T_World_Baselink)) {
+      poses_[stamp] = T_World_Baselink;
+    }
+  }
+  if (!updated_stamps.empty()) { path_outdated_ = true; }
+}
+
+void GraphPublisher::ResetPoses(const fuse_core::Graph& graph) {
+  std::map<ros::Time, Eigen::Matrix4d> poses = bs_common::GetGraphPoses(graph);
+
+  // publish odom for poses that have been marginalized out, i.e., they don't
+  // exist in the new poses
+  for (const auto& [stamp, T_World_Baselink] : poses_) {
+    if (poses.find(stamp) == poses.end()) {
+      PublishMarginalizedPose(stamp, T_World_Baselink);
+    }
+  }
+
+  poses_ = std::move(poses);
+  pose_stamps_.clear();
+  for (const auto& [stamp, T_World_Baselink] : poses_) {
+    pose_stamps_.emplace(
+        fuse_core::uuid::generate("fuse_variables::Position3DStamped", stamp,
+                                  fuse_core::uuid::NIL),
+        stamp);
+    pose_stamps_.emplace(
+        fuse_core::uuid::generate("fuse_variables::Orientation3DStamped",
+                                  stamp, fuse_core::uuid::NIL),
+        stamp);
+  }
+  path_outdated_ = true;
+}
+
+bool GraphPublisher::GetPose(const fuse_core::Graph& graph,
+                             const ros::Time& stamp,
+                             Eigen::Matrix4d& T_World_Baselink) const {
+  const auto position = bs_common::GetPosition(graph, stamp);
+  const auto orientation = bs_common::GetOrientation(graph, stamp);
+  if (!position && !orientation) { return false; }
+  T_World_Baselink = Eigen::Matrix4d::Identity();
+  if (position) {
+    T_World_Baselink.block<3, 1>(0, 3) =
+        Eigen::Vector3d(position->x(), position->y(), position->z());
+  }
+  if (orientation) {
+    T_World_Baselink.block<3, 3>(0, 0) =
+        Eigen::Quaterniond(orientation->w(), orientation->x(),
+                           orientation->y(), orientation->z())
+            .toRotationMatrix();
+  }
+  return true;
+}
+
+void GraphPublisher::PublishMarginalizedPose(
+    const ros::Time& stamp, const Eigen::Matrix4d& T_World_Baselink) {
+  nav_msgs::Odometry odom_msg;
+  bs_common::EigenTransformToOdometryMsg(
+      T_World_Baselink, stamp, graph_odom_publisher_.counter,
+      extrinsics_.GetWorldFrameId(), extrinsics_.GetBaselinkFrameId(),
+      odom_msg);
+  graph_odom_publisher_.publisher.publish(odom_msg);
+  graph_odom_publisher_.counter++;
+}
+
+void GraphPublisher::PublishPath() {
+  // the path stays outdated until someone listens and the period elapsed.
+  // Time going backwards (e.g., restarting a bag) resets the limit
+  if (!path_outdated_) { return; }
+  if (graph_path_publisher_.publisher.getNumSubscribers() == 0) { return; }
+  const ros::Time& last_publish_time = graph_path_publisher_.last_publish_time;
+  if (current_time_ >= last_publish_time &&
+      current_time_ < last_publish_time + ros::Duration(path_publish_period_)) {
+    return;
+  }
+
   nav_msgs::Path path_msg;
-  path_msg.header.stamp = ros::Time::now();
+  path_msg.header.stamp = current_time_;
   path_msg.header.frame_id = extrinsics_.GetWorldFrameId();
   path_msg.header.seq = graph_path_publisher_.counter;
-  std::map<ros::Time, Eigen::Matrix4d> poses =
-      bs_common::GetGraphPoses(*graph_msg);
+  path_msg.poses.reserve(poses_.size());
   int counter = 0;
-  for (const auto& [stamp, T_World_Baselink] : poses) {
+  for (const auto& [stamp, T_World_Baselink] : poses_) {
     geometry_msgs::PoseStamped pose_stamped;
-    bs_common::EigenTransformToPoseStamped(T_World_Baselink, stamp, counter++,
-                                           extrinsics_.GetBaselinkFrameId(),
-                                           pose_stamped);
+    bs_common::EigenTransformToPoseStamped(
+        T_World_Baselink, stamp, counter++, extrinsics_.GetBaselinkFrameId(),
+        pose_stamped);
     path_msg.poses.push_back(pose_stamped);
   }
   graph_path_publisher_.publisher.publish(path_msg);
   graph_path_publisher_.counter++;
+  graph_path_publisher_.last_publish_time = current_time_;
+  path_outdated_ = false;
+}
 
-  // publish odom for poses that have been marginalized out, i.e., they don't
-  // exist in the last poses
-  if (poses_last_.empty()) {
-    poses_last_ = poses;
+void GraphPublisher::UpdateLandmarkCloud(const fuse_core::Graph& graph) {
+  // the cloud isn't kept without subscribers, it is rebuilt once someone
+  // subscribes
+  if (camera_landmarks_publisher_.publisher.getNumSubscribers() == 0 &&
+      camera_landmark_updates_publisher_.publisher.getNumSubscribers() == 0) {
+    landmark_cloud_.Clear();
     return;
   }
 
-  // publish marginalized poses as odom
-  for (const auto& [stamp, T_World_Baselink] : poses_last_) {
-    auto pose_it = poses.find(stamp);
-    // if we find the pose, then don't publish yet
-    if (pose_it != poses.end()) { continue; }
-    // otherwise, it has been marginalized so let's publish it
-    nav_msgs::Odometry odom_msg;
-    bs_common::EigenTransformToOdometryMsg(
-        T_World_Baselink, stamp, graph_odom_publisher_.counter,
-        extrinsics_.GetWorldFrameId(), extrinsics_.GetBaselinkFrameId(),
-        odom_msg);
-    graph_odom_publisher_.publisher.publish(odom_msg);
-    graph_odom_publisher_.counter++;
+  const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(graph);
+  if (delta && landmark_cloud_.Initialized()) {
+    landmark_cloud_.Update(graph, *delta);
+  } else {
+    landmark_cloud_.Reset(graph);
+  }
+
+  const ros::Time& last_publish_time =
+      camera_landmarks_publisher_.last_publish_time;
+  if (!landmark_cloud_.Changed() ||
+      current_time_ <
+          last_publish_time + ros::Duration(landmarks_publish_period_)) {
+    return;
   }
-  poses_last_ = poses;
+  PublishCloud<pcl::PointXYZRGBL>(camera_landmark_updates_publisher_,
+                                  landmark_cloud_.TakeUpdates());
+  PublishCloud<pcl::PointXYZRGBL>(camera_landmarks_publisher_,
+                                  landmark_cloud_.Cloud());
+  camera_landmarks_publisher_.last_publish_time = current_time_;
 }
 
 void GraphPublisher::PublishCameraLandmarks(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud =
-      graph_visualization::GetGraphCameraLandmarksAsCloud(*graph_msg);
-  PublishCloud<pcl::PointXYZRGBL>(camera_landmarks_publisher_, cloud);
+  UpdateLandmarkCloud(*graph_msg);
 
   // get all timestamps in the graph
   auto timestamps = bs_common::CurrentTimestamps(*graph_msg);
@@ -223,15 +382,12 @@ void GraphPublisher::processCameraMeasurements(
   if (times.find(msg->header.stamp) != times.end()) { return; }
 
   // put all measurements into landmark container
-  for (const auto& lm : msg->landmarks) {
-    Eigen::Vector2d landmark(static_cast<double>(lm.pixel_u),
-                             static_cast<double>(lm.pixel_v));
-    const cv::Mat landmark_descriptor =
-        beam_cv::Descriptor::VectorDescriptorToCvMat({lm.descriptor.data},
-                                                     msg->descriptor_type);
+  const vision::CameraMeasurementView measurements(*msg);
+  for (size_t i = 0; i < measurements.Size(); i++) {
     beam_containers::LandmarkMeasurement lm_measurement(
-        msg->header.stamp, msg->sensor_id, lm.landmark_id, msg->header.seq,
-        landmark, landmark_descriptor);
+        msg->header.stamp, msg->sensor_id, measurements.LandmarkId(i),
+        msg->header.seq, measurements.Pixel(i),
+        measurements.Descriptor(i).clone());
     landmark_container_->Insert(lm_measurement);
   }
 }
@@ -14,6 +14,7 @@
 #include <beam_utils/time.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/graph_view.h>
 #include <bs_common/utils.h>
 #include <bs_common/visualization.h>
 #include <bs_constraints/global/absolute_pose_3d_constraint.h>
@@ -23,6 +24,7 @@
 #include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
 #include <bs_constraints/visual/euclidean_reprojection_constraint.h>
 #include <bs_models/graph_visualization/helpers.h>
+#include <bs_models/vision/camera_measurement_view.h>
 
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::GraphVisualization, fuse_core::SensorModel);
@@ -103,20 +105,71 @@ void GraphVisualization::onStart() {
 void GraphVisualization::onGraphUpdate(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
   current_time_ = ros::Time::now();
-  VisualizePoses(graph_msg);
+
+  // graph snapshots tell which variables changed, nothing to do if none did
+  const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(*graph_msg);
+  if (delta && delta->Empty()) { return; }
+
+  // one traversal of the graph indexes it and collects the biases for all
+  // visualizations of this update
+  bs_common::ImuBiasCollector biases;
+  const bs_common::GraphView view(graph_msg, {&biases});
+
+  VisualizePoses(view, delta);
   VisualizeLidarRelativePoseConstraints(graph_msg);
   VisualizeImuRelativeConstraints(graph_msg);
-  VisualizeImuBiases(graph_msg);
+  VisualizeImuBiases(biases.biases);
   VisualizeImuGravityConstraints(graph_msg);
-  VisualizeCameraLandmarks(graph_msg);
-  ValidateGraphPriors(graph_msg);
-  ValidateGraphConnectivity(graph_msg);
+  VisualizeCameraLandmarks(view);
+  ValidateGraph(graph_msg, delta);
 }
 
-void GraphVisualization::VisualizePoses(
-    fuse_core::Graph::ConstSharedPtr graph_msg) {
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud =
-      bs_common::GetGraphPosesAsCloud(*graph_msg);
+void GraphVisualization::VisualizePoses(const bs_common::GraphView& view,
+                                        const bs_common::GraphDelta* delta) {
+  if (!IsCloudNeeded(poses_publisher_)) {
+    // the cached frames can't be kept up to date without visiting the graph
+    pose_clouds_.clear();
+    return;
+  }
+
+  const std::set<ros::Time>& stamps = view.Timestamps();
+  for (auto iter = pose_clouds_.begin(); iter != pose_clouds_.end();) {
+    if (stamps.find(iter->first) == stamps.end()) {
+      iter = pose_clouds_.erase(iter);
+    } else {
+      iter++;
+    }
+  }
+
+  // only regenerate the frames of new poses and of poses that were updated,
+  // all frames are regenerated if the graph has no delta
+  auto is_updated = [delta](const fuse_core::Variable* variable) {
+    return variable && delta->IsUpdated(variable->uuid());
+  };
+  for (const ros::Time& stamp : stamps) {
+    const auto position = view.GetPosition(stamp);
+    const auto orientation = view.GetOrientation(stamp);
+    const auto velocity = view.GetVelocity(stamp);
+    if (delta && pose_clouds_.find(stamp) != pose_clouds_.end() &&
+        !is_updated(position) && !is_updated(orientation) &&
+        !is_updated(velocity)) {
+      continue;
+    }
+
+    bs_common::ImuState state(stamp);
+    state.SetPosition(position->x(), position->y(), position->z());
+    if (orientation) {
+      state.SetOrientation(orientation->w(), orientation->x(),
+                           orientation->y(), orientation->z());
+    }
+    if (velocity) {
+      state.SetVelocity(velocity->x(), velocity->y(), velocity->z());
+    }
+    pose_clouds_[stamp] = bs_common::ImuStateToCloudInWorld(state);
+  }
+
+  pcl::PointCloud<pcl::PointXYZRGBL> cloud;
+  for (const auto& [stamp, pose_cloud] : pose_clouds_) { cloud += pose_cloud; }
   PublishCloud<pcl::PointXYZRGBL>(poses_publisher_, cloud);
   SaveCloud<pcl::PointXYZRGBL>(
       save_path_, std::to_string(current_time_.toSec()) + "_graph_poses",
@@ -125,6 +178,8 @@ void GraphVisualization::VisualizePoses(
 
 void GraphVisualization::VisualizeLidarRelativePoseConstraints(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
+  if (!IsCloudNeeded(lidar_relative_pose_constraints_publisher_)) { return; }
+
   pcl::PointCloud<pcl::PointXYZRGBL> cloud =
       bs_common::GetGraphRelativePoseConstraintsAsCloud(*graph_msg,
                                                         "LidarOdometry::");
@@ -143,6 +198,8 @@ void GraphVisualization::VisualizeLidarRelativePoseConstraints(
 
 void GraphVisualization::VisualizeImuRelativeConstraints(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
+  if (!IsCloudNeeded(relative_imu_constraints_publisher_)) { return; }
+
   pcl::PointCloud<pcl::PointXYZRGBL> cloud =
       GetGraphRelativeImuConstraintsAsCloud(*graph_msg, point_spacing_,
                                             frame_size_);
@@ -154,10 +211,16 @@ void GraphVisualization::VisualizeImuRelativeConstraints(
 }
 
 void GraphVisualization::VisualizeImuBiases(
-    fuse_core::Graph::ConstSharedPtr graph_msg) {
-  // load IMU biases
-  std::map<int64_t, bs_common::ImuBiases> biases_in_graph =
-      bs_common::GetImuBiasesFromGraph(*graph_msg);
+    const std::map<int64_t, bs_common::ImuBiases>& biases_in_graph) {
+  const bool biases_subscribed =
+      params_.publish && (imu_biases_publisher_gx_.getNumSubscribers() > 0 ||
+                          imu_biases_publisher_gy_.getNumSubscribers() > 0 ||
+                          imu_biases_publisher_gz_.getNumSubscribers() > 0 ||
+                          imu_biases_publisher_ax_.getNumSubscribers() > 0 ||
+                          imu_biases_publisher_ay_.getNumSubscribers() > 0 ||
+                          imu_biases_publisher_az_.getNumSubscribers() > 0);
+  if (!biases_subscribed && save_path_.empty()) { return; }
+
   if (biases_in_graph.empty()) { return; }
 
   // publish most recent
@@ -183,6 +246,8 @@ void GraphVisualization::VisualizeImuBiases(
 
 void GraphVisualization::VisualizeImuGravityConstraints(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
+  if (!IsCloudNeeded(gravity_constraints_publisher_)) { return; }
+
   pcl::PointCloud<pcl::PointXYZRGBL> cloud = GetGraphGravityConstraintsAsCloud(
       *graph_msg, point_spacing_, frame_size_, g_length_);
   PublishCloud<pcl::PointXYZRGBL>(gravity_constraints_publisher_, cloud);
@@ -192,16 +257,18 @@ void GraphVisualization::VisualizeImuGravityConstraints(
 }
 
 void GraphVisualization::VisualizeCameraLandmarks(
-    fuse_core::Graph::ConstSharedPtr graph_msg) {
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud =
-      GetGraphCameraLandmarksAsCloud(*graph_msg);
-  PublishCloud<pcl::PointXYZRGBL>(camera_landmarks_publisher_, cloud);
-  SaveCloud<pcl::PointXYZRGBL>(
-      save_path_, std::to_string(current_time_.toSec()) + "_camera_landmarks",
-      cloud);
+    const bs_common::GraphView& view) {
+  if (IsCloudNeeded(camera_landmarks_publisher_)) {
+    pcl::PointCloud<pcl::PointXYZRGBL> cloud =
+        GetGraphCameraLandmarksAsCloud(*view.Graph());
+    PublishCloud<pcl::PointXYZRGBL>(camera_landmarks_publisher_, cloud);
+    SaveCloud<pcl::PointXYZRGBL>(
+        save_path_,
+        std::to_string(current_time_.toSec()) + "_camera_landmarks", cloud);
+  }
 
   // get all timestamps in the graph
-  auto timestamps = bs_common::CurrentTimestamps(*graph_msg);
+  const std::set<ros::Time>& timestamps = view.Timestamps();
 
   Eigen::Matrix4d T_CAM_BASELINK;
   extrinsics_.GetT_CAMERA_BASELINK(T_CAM_BASELINK);
@@ -227,8 +294,9 @@ void GraphVisualization::VisualizeCameraLandmarks(
     }
 
     // get pose
-    const auto position = bs_common::GetPosition(*graph_msg, timestamp);
-    const auto orientation = bs_common::GetOrientation(*graph_msg, timestamp);
+    const auto position = view.GetPosition(timestamp);
+    const auto orientation = view.GetOrientation(timestamp);
+    if (!position || !orientation) { continue; }
     Eigen::Matrix4d T_WORLD_BASELINK =
         bs_common::FusePoseToEigenTransform(*position, *orientation);
 
@@ -237,9 +305,8 @@ void GraphVisualization::VisualizeCameraLandmarks(
     for (const auto id : lm_ids) {
       Eigen::Vector2d pixel = landmark_container_->GetValue(timestamp, id);
       cv::Point m(pixel[0], pixel[1]);
-      const auto lm_variable = bs_common::GetLandmark(*graph_msg, id);
-      const auto idp_lm_variable =
-          bs_common::GetInverseDepthLandmark(*graph_msg, id);
+      const auto lm_variable = view.GetLandmark(id);
+      const auto idp_lm_variable = view.GetInverseDepthLandmark(id);
       if (lm_variable || idp_lm_variable) {
         Eigen::Vector3d camera_t_point;
         if (lm_variable) {
@@ -249,10 +316,8 @@ void GraphVisualization::VisualizeCameraLandmarks(
                   .hnormalized();
         } else if (idp_lm_variable) {
           Eigen::Vector3d anchor_t_point = idp_lm_variable->camera_t_point();
-          const auto p = bs_common::GetPosition(*graph_msg,
-                                                idp_lm_variable->anchorStamp());
-          const auto o = bs_common::GetOrientation(
-              *graph_msg, idp_lm_variable->anchorStamp());
+          const auto p = view.GetPosition(idp_lm_variable->anchorStamp());
+          const auto o = view.GetOrientation(idp_lm_variable->anchorStamp());
           if (!o || !p) { continue; }
           Eigen::Matrix4d T_WORLD_CAMERAmeasurement =
               T_WORLD_BASELINK * T_BASELINK_CAM;
@@ -327,66 +392,31 @@ void GraphVisualization::processMeasurements(
   if (times.find(msg->header.stamp) != times.end()) { return; }
 
   // put all measurements into landmark container
-  for (const auto& lm : msg->landmarks) {
-    Eigen::Vector2d landmark(static_cast<double>(lm.pixel_u),
-                             static_cast<double>(lm.pixel_v));
-    const cv::Mat landmark_descriptor =
-        beam_cv::Descriptor::VectorDescriptorToCvMat({lm.descriptor.data},
-                                                     msg->descriptor_type);
+  const vision::CameraMeasurementView measurements(*msg);
+  for (size_t i = 0; i < measurements.Size(); i++) {
     beam_containers::LandmarkMeasurement lm_measurement(
-        msg->header.stamp, msg->sensor_id, lm.landmark_id, msg->header.seq,
-        landmark, landmark_descriptor);
+        msg->header.stamp, msg->sensor_id, measurements.LandmarkId(i),
+        msg->header.seq, measurements.Pixel(i),
+        measurements.Descriptor(i).clone());
     landmark_container_->Insert(lm_measurement);
   }
 }
 
-void GraphVisualization::ValidateGraphPriors(
-    fuse_core::Graph::ConstSharedPtr graph_msg) {
+void GraphVisualization::ValidateGraph(
+    fuse_core::Graph::ConstSharedPtr graph_msg,
+    const bs_common::GraphDelta* delta) {
   if (!params_.validate_graph) { return; }
 
+  UpdateConnectivity(*graph_msg, delta);
+
+  // constraints never change once added, so only new ones need validating
   const auto constraints = graph_msg->getConstraints();
   for (auto it = constraints.begin(); it != constraints.end(); it++) {
-    if (it->type() == "bs_constraints::AbsoluteImuState3DStampedConstraint") {
-      if (!absolute_imu_constraints_.empty()) {
-        if (absolute_imu_constraints_.find(it->uuid()) ==
-            absolute_imu_constraints_.end()) {
-          ROS_ERROR_ONCE("Detected multiple absolute constraints of type: "
-                         "bs_constraints::AbsoluteImuState3DStampedConstraint");
-        }
-        // else do nothing, this is the same one so it's ok
-      } else {
-        absolute_imu_constraints_.emplace(it->uuid());
-      }
-    } else if (it->type() == "bs_constraints::AbsolutePose3DConstraint") {
-      auto c =
-          dynamic_cast<const bs_constraints::AbsolutePose3DConstraint&>(*it);
-      auto position = c.getInitialPosition();
-      std::string T = "T_" + position.child() + "_" + position.parent();
-      auto iter = extrinsics_constraints_.find(T);
-      if (iter != extrinsics_constraints_.end()) {
-        if (iter->second != it->uuid()) {
-          ROS_ERROR_ONCE(
-              "Detected multiple time-invariant pose priors representing "
-              "the transform: %s",
-              T.c_str());
-        }
-        // else do nothing, this is the same one so it's ok
-      } else {
-        extrinsics_constraints_.emplace(T, it->uuid());
-      }
-    } else if (it->type() ==
-               "fuse_constraints::AbsolutePose3DStampedConstraint") {
-      if (!absolute_pose_constraints_.empty()) {
-        if (absolute_pose_constraints_.find(it->uuid()) ==
-            absolute_pose_constraints_.end()) {
-          ROS_ERROR_ONCE("Detected multiple absolute constraints of type: "
-                         "fuse_constraints::AbsolutePose3DStampedConstraint");
-        }
-        // else do nothing, this is the same one so it's ok
-      } else {
-        absolute_pose_constraints_.emplace(it->uuid());
-      }
+    if (constraint_positions_.find(it->uuid()) != constraint_positions_.end()) {
+      continue;
     }
+    ValidateGraphPrior(*it);
+    AddConnectivity(*it);
   }
 
   if (absolute_imu_constraints_.empty() && absolute_pose_constraints_.empty()) {
@@ -399,137 +429,176 @@ void GraphVisualization::ValidateGraphPriors(
         "Detected an absolute stamped pose constraint, and an IMU "
         "pose prior constraint. These constrain the same variables!");
   }
-}
 
-void GraphVisualization::ValidateGraphConnectivity(
-    fuse_core::Graph::ConstSharedPtr graph_msg) {
-  if (!params_.validate_graph) { return; }
+  ValidateGraphConnectivity();
+}
 
-  // get all stamped positions
-  VariableConnectivityType varConnectivity;
-  const auto v_range = graph_msg->getVariables();
-  for (auto it = v_range.begin(); it != v_range.end(); it++) {
-    if (it->type() == "fuse_variables::Position3DStamped") {
-      auto v = dynamic_cast<const fuse_variables::Position3DStamped&>(*it);
-      varConnectivity.emplace(it->uuid(), VariableConnectivity(v.stamp()));
-    }
-  }
-  if (varConnectivity.size() < 3) { return; }
-
-  // add connectivity for all constraints attached to position variables
-  const auto c_range = graph_msg->getConstraints();
-  for (auto it = c_range.begin(); it != c_range.end(); it++) {
-    if (it->type() == "bs_constraints::AbsoluteImuState3DStampedConstraint") {
-      auto c = dynamic_cast<
-          const bs_constraints::AbsoluteImuState3DStampedConstraint&>(*it);
-      const auto& pos_uuid = c.variables().at(1);
-      if (varConnectivity.find(pos_uuid) == varConnectivity.end()) {
-        ROS_ERROR_ONCE("no position variable found for constraint: %s",
-                       to_string(c.uuid()).c_str());
-        continue;
-      }
-      varConnectivity.at(pos_uuid).absolute_constraints.emplace(
-          c.uuid(), "bs_constraints::AbsoluteImuState3DStampedConstraint");
-    } else if (it->type() ==
-               "fuse_constraints::AbsolutePose3DStampedConstraint") {
-      auto c = dynamic_cast<
-          const fuse_constraints::AbsolutePose3DStampedConstraint&>(*it);
-      const auto& pos_uuid = c.variables().at(0);
-      if (varConnectivity.find(pos_uuid) == varConnectivity.end()) {
-        ROS_ERROR_ONCE("no position variable found for constraint: %s",
-                       to_string(c.uuid()).c_str());
-        continue;
+void GraphVisualization::ValidateGraphPrior(
+    const fuse_core::Constraint& constraint) {
+  const std::string type = constraint.type();
+  if (type == "bs_constraints::AbsoluteImuState3DStampedConstraint") {
+    if (!absolute_imu_constraints_.empty()) {
+      if (absolute_imu_constraints_.find(constraint.uuid()) ==
+          absolute_imu_constraints_.end()) {
+        ROS_ERROR_ONCE("Detected multiple absolute constraints of type: "
+                       "bs_constraints::AbsoluteImuState3DStampedConstraint");
       }
-      varConnectivity.at(pos_uuid).absolute_constraints.emplace(
-          c.uuid(), "fuse_constraints::AbsolutePose3DStampedConstraint");
-    } else if (it->type() == "bs_constraints::"
-                             "RelativePose3DStampedWithExtrinsicsConstraint") {
-      auto c = dynamic_cast<
-          const bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint&>(
-          *it);
-      const auto& pos_uuid1 = c.variables().at(0);
-      if (varConnectivity.find(pos_uuid1) == varConnectivity.end()) {
-        ROS_ERROR_ONCE(
-            "no position variable found for first position in constraint: %s",
-            to_string(c.uuid()).c_str());
-      } else {
-        varConnectivity.at(pos_uuid1).next_constraints.emplace(
-            c.uuid(),
-            "bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint");
-      }
-      const auto& pos_uuid2 = c.variables().at(2);
-      if (varConnectivity.find(pos_uuid2) == varConnectivity.end()) {
-        ROS_ERROR_ONCE(
-            "no position variable found for second position in constraint: %s",
-            to_string(c.uuid()).c_str());
-      } else {
-        varConnectivity.at(pos_uuid2).previous_constraints.emplace(
-            c.uuid(),
-            "bs_constraints::RelativePose3DStampedWithExtrinsicsConstraint");
-      }
-    } else if (it->type() ==
-               "fuse_constraints::RelativePose3DStampedConstraint") {
-      auto c = dynamic_cast<
-          const fuse_constraints::RelativePose3DStampedConstraint&>(*it);
-      const auto& pos_uuid1 = c.variables().at(0);
-      if (varConnectivity.find(pos_uuid1) == varConnectivity.end()) {
-        ROS_ERROR_ONCE(
-            "no position variable found for first position in constraint: %s",
-            to_string(c.uuid()).c_str());
-      } else {
-        varConnectivity.at(pos_uuid1).next_constraints.emplace(
-            c.uuid(), "fuse_constraints::RelativePose3DStampedConstraint");
-      }
-      const auto& pos_uuid2 = c.variables().at(2);
-      if (varConnectivity.find(pos_uuid2) == varConnectivity.end()) {
+      // else do nothing, this is the same one so it's ok
+    } else {
+      absolute_imu_constraints_.emplace(constraint.uuid());
+    }
+  } else if (type == "bs_constraints::AbsolutePose3DConstraint") {
+    auto c = dynamic_cast<const bs_constraints::AbsolutePose3DConstraint&>(
+        constraint);
+    auto position = c.getInitialPosition();
+    std::string T = "T_" + position.child() + "_" + position.parent();
+    auto iter = extrinsics_constraints_.find(T);
+    if (iter != extrinsics_constraints_.end()) {
+      if (iter->second != constraint.uuid()) {
         ROS_ERROR_ONCE(
-            "no position variable found for second position in constraint: %s",
-            to_string(c.uuid()).c_str());
-      } else {
-        varConnectivity.at(pos_uuid2).previous_constraints.emplace(
-            c.uuid(), "fuse_constraints::RelativePose3DStampedConstraint");
+            "Detected multiple time-invariant pose priors representing "
+            "the transform: %s",
+            T.c_str());
       }
-    } else if (it->type() ==
-               "bs_constraints::RelativeImuState3DStampedConstraint") {
-      auto c = dynamic_cast<
-          const bs_constraints::RelativeImuState3DStampedConstraint&>(*it);
-      const auto& pos_uuid1 = c.variables().at(1);
-      if (varConnectivity.find(pos_uuid1) == varConnectivity.end()) {
-        ROS_ERROR_ONCE(
-            "no position variable found for first position in constraint: %s",
-            to_string(c.uuid()).c_str());
-      } else {
-        varConnectivity.at(pos_uuid1).next_constraints.emplace(
-            c.uuid(), "bs_constraints::RelativeImuState3DStampedConstraint");
-      }
-      const auto& pos_uuid2 = c.variables().at(6);
-      if (varConnectivity.find(pos_uuid2) == varConnectivity.end()) {
-        ROS_ERROR_ONCE(
-            "no position variable found for second position in constraint: %s",
-            to_string(c.uuid()).c_str());
-      } else {
-        varConnectivity.at(pos_uuid2).previous_constraints.emplace(
-            c.uuid(), "bs_constraints::RelativeImuState3DStampedConstraint");
+      // else do nothing, this is the same one so it's ok
+    } else {
+      extrinsics_constraints_.emplace(T, constraint.uuid());
+    }
+  } else if (type == "fuse_constraints::AbsolutePose3DStampedConstraint") {
+    if (!absolute_pose_constraints_.empty()) {
+      if (absolute_pose_constraints_.find(constraint.uuid()) ==
+          absolute_pose_constraints_.end()) {
+        ROS_ERROR_ONCE("Detected multiple absolute constraints of type: "
+                       "fuse_constraints::AbsolutePose3DStampedConstraint");
       }
-    } else if (it->type() == "bs_constraints::AbsolutePose3DConstraint" ||
-               it->type() == "fuse_constraints::MarginalConstraint" ||
-               it->type() ==
-                   "bs_constraints::EuclideanReprojectionConstraint" ||
-               it->type() ==
-                   "bs_constraints::InverseDepthReprojectionConstraintUnary" ||
-               it->type() ==
-                   "bs_constraints::InverseDepthReprojectionConstraint") {
-      // skip all these types
+      // else do nothing, this is the same one so it's ok
     } else {
-      ROS_WARN_ONCE("Unknown constraint type: %s", it->type().c_str());
+      absolute_pose_constraints_.emplace(constraint.uuid());
+    }
+  }
+}
+
+void GraphVisualization::UpdateConnectivity(
+    const fuse_core::Graph& graph, const bs_common::GraphDelta* delta) {
+  // drop the removed constraints from the positions they connected
+  for (auto it = constraint_positions_.begin();
+       it != constraint_positions_.end();) {
+    if (graph.constraintExists(it->first)) {
+      it++;
+      continue;
+    }
+    for (const auto& pos_uuid : it->second) {
+      auto conn_iter = connectivity_.find(pos_uuid);
+      if (conn_iter == connectivity_.end()) { continue; }
+      conn_iter->second.absolute_constraints.erase(it->first);
+      conn_iter->second.previous_constraints.erase(it->first);
+      conn_iter->second.next_constraints.erase(it->first);
+    }
+    it = constraint_positions_.erase(it);
+  }
+
+  // drop the removed positions
+  for (auto it = connectivity_.begin(); it != connectivity_.end();) {
+    if (graph.variableExists(it->first)) {
+      it++;
+      continue;
     }
+    positions_by_stamp_.erase(it->second.stamp);
+    it = connectivity_.erase(it);
   }
 
+  // add the new positions, all variables are visited if there is no delta or
+  // if no positions were added yet
+  auto add_position = [this](const fuse_core::Variable& variable) {
+    if (variable.type() != "fuse_variables::Position3DStamped") { return; }
+    auto v = dynamic_cast<const fuse_variables::Position3DStamped&>(variable);
+    if (connectivity_.emplace(v.uuid(), VariableConnectivity(v.stamp()))
+            .second) {
+      positions_by_stamp_[v.stamp()] = v.uuid();
+    }
+  };
+  if (delta && !positions_by_stamp_.empty()) {
+    for (const auto& uuid : delta->added_variables) {
+      add_position(graph.getVariable(uuid));
+    }
+  } else {
+    const auto v_range = graph.getVariables();
+    for (auto it = v_range.begin(); it != v_range.end(); it++) {
+      if (connectivity_.find(it->uuid()) != connectivity_.end()) { continue; }
+      add_position(*it);
+    }
+  }
+}
+
+void GraphVisualization::AddConnectivity(
+    const fuse_core::Constraint& constraint) {
+  std::vector<fuse_core::UUID>& positions =
+      constraint_positions_[constraint.uuid()];
+  const std::string type = constraint.type();
+
+  // add a constraint to a position, returns false if there is no such position
+  auto add = [&](const fuse_core::UUID& pos_uuid,
+                 ConstraintTypeMap VariableConnectivity::*constraints) {
+    auto conn_iter = connectivity_.find(pos_uuid);
+    if (conn_iter == connectivity_.end()) { return false; }
+    (conn_iter->second.*constraints).emplace(constraint.uuid(), type);
+    positions.push_back(pos_uuid);
+    return true;
+  };
+  auto add_relative = [&](size_t first_index, size_t second_index) {
+    const auto& variables = constraint.variables();
+    if (!add(variables.at(first_index),
+             &VariableConnectivity::next_constraints)) {
+      ROS_ERROR_ONCE(
+          "no position variable found for first position in constraint: %s",
+          to_string(constraint.uuid()).c_str());
+    }
+    if (!add(variables.at(second_index),
+             &VariableConnectivity::previous_constraints)) {
+      ROS_ERROR_ONCE(
+          "no position variable found for second position in constraint: %s",
+          to_string(constraint.uuid()).c_str());
+    }
+  };
+
+  if (type == "bs_constraints::AbsoluteImuState3DStampedConstraint") {
+    if (!add(constraint.variables().at(1),
+             &VariableConnectivity::absolute_constraints)) {
+      ROS_ERROR_ONCE("no position variable found for constraint: %s",
+                     to_string(constraint.uuid()).c_str());
+    }
+  } else if (type == "fuse_constraints::AbsolutePose3DStampedConstraint") {
+    if (!add(constraint.variables().at(0),
+             &VariableConnectivity::absolute_constraints)) {
+      ROS_ERROR_ONCE("no position variable found for constraint: %s",
+                     to_string(constraint.uuid()).c_str());
+    }
+  } else if (type == "bs_constraints::"
+                     "RelativePose3DStampedWithExtrinsicsConstraint" ||
+             type == "fuse_constraints::RelativePose3DStampedConstraint") {
+    add_relative(0, 2);
+  } else if (type == "bs_constraints::RelativeImuState3DStampedConstraint") {
+    add_relative(1, 6);
+  } else if (type == "bs_constraints::AbsolutePose3DConstraint" ||
+             type == "fuse_constraints::MarginalConstraint" ||
+             type == "bs_constraints::EuclideanReprojectionConstraint" ||
+             type ==
+                 "bs_constraints::InverseDepthReprojectionConstraintUnary" ||
+             type == "bs_constraints::InverseDepthReprojectionConstraint") {
+    // skip all these types
+  } else {
+    ROS_WARN_ONCE("Unknown constraint type: %s", type.c_str());
+  }
+}
+
+void GraphVisualization::ValidateGraphConnectivity() {
+  if (connectivity_.size() < 3) { return; }
+
   // go through connectivity map and check
 
   // check first position:
-  auto first_uuid = GetFirstVariable(varConnectivity);
-  const auto& first_conn = varConnectivity.at(first_uuid);
+  const auto& first_uuid = positions_by_stamp_.begin()->second;
+  const auto& first_conn = connectivity_.at(first_uuid);
   if (!prior_found_on_first_ && first_conn.absolute_constraints.empty()) {
     ROS_ERROR_ONCE("First position (%s) does not have any priors",
                    to_string(first_uuid).c_str());
@@ -552,8 +621,8 @@ void GraphVisualization::ValidateGraphConnectivity(
   }
 
   // check last position
-  auto last_uuid = GetLastVariable(varConnectivity);
-  const auto& last_conn = varConnectivity.at(last_uuid);
+  const auto& last_uuid = positions_by_stamp_.rbegin()->second;
+  const auto& last_conn = connectivity_.at(last_uuid);
   if (last_conn.previous_constraints.empty()) {
     ROS_ERROR_ONCE(
         "Position (%s) has no constraints against previous positions",
@@ -565,7 +634,7 @@ void GraphVisualization::ValidateGraphConnectivity(
   }
 
   // check all intermediate positions:
-  for (const auto& [uuid, var_conn] : varConnectivity) {
+  for (const auto& [uuid, var_conn] : connectivity_) {
     if (uuid == first_uuid || uuid == last_uuid) { continue; }
     if (!var_conn.absolute_constraints.empty()) {
       ROS_ERROR_ONCE(
@@ -596,36 +665,6 @@ void GraphVisualization::ValidateGraphConnectivity(
   }
 }
 
-fuse_core::UUID GraphVisualization::GetFirstVariable(
-    const VariableConnectivityType& connectivity) const {
-  ros::Time first_time = connectivity.begin()->second.stamp;
-  fuse_core::UUID first_uuid = connectivity.begin()->first;
-
-  for (const auto& [uuid, conn] : connectivity) {
-    if (conn.stamp < first_time) {
-      first_time = conn.stamp;
-      first_uuid = uuid;
-    }
-  }
-
-  return first_uuid;
-}
-
-fuse_core::UUID GraphVisualization::GetLastVariable(
-    const VariableConnectivityType& connectivity) const {
-  ros::Time last_time = connectivity.begin()->second.stamp;
-  fuse_core::UUID last_uuid = connectivity.begin()->first;
-
-  for (const auto& [uuid, conn] : connectivity) {
-    if (conn.stamp > last_time) {
-      last_time = conn.stamp;
-      last_uuid = uuid;
-    }
-  }
-
-  return last_uuid;
-}
-
 bool GraphVisualization::HasImuConstraint(
     const ConstraintTypeMap& constraints) const {
   for (const auto& [id, type] : constraints) {
@@ -6,6 +6,8 @@
 #include <beam_utils/pointclouds.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/pool_allocator.h>
+#include <bs_common/utils.h>
 #include <bs_constraints/global/gravity_alignment_stamped_constraint.h>
 
 // Register this sensor model with ROS as a plugin.
@@ -27,6 +29,7 @@ void GravityAlignment::onInit() {
                 (params_.gravity_information_weight *
                  params_.gravity_information_weight) *
                 Eigen::Matrix2d::Identity();
+  imu_buffer_ = bs_common::ImuSampleBuffer(buffer_duration_);
   // check for non empty odom topic
   if (params_.constraint_odom_topic.empty()) {
     ROS_ERROR("Constraint odom topic cannot be empty, must be a valid odometry "
@@ -54,22 +57,25 @@ void GravityAlignment::onStart() {
 
 void GravityAlignment::processIMU(const sensor_msgs::Imu::ConstPtr& msg) {
   std::unique_lock<std::mutex> lk(gravity_mutex_);
-  imu_buffer_.emplace(msg->header.stamp.toNSec(), msg);
-  while (imu_buffer_.rbegin()->first - imu_buffer_.begin()->first >
-         buffer_duration_in_ns_) {
-    imu_buffer_.erase(imu_buffer_.begin());
-  }
+  imu_buffer_.Add(*msg);
 }
 
 void GravityAlignment::processOdometry(
     const nav_msgs::Odometry::ConstPtr& msg) {
-  int64_t odom_time_ns = msg->header.stamp.toNSec();
-  auto lower_bound = imu_buffer_.lower_bound(odom_time_ns);
+  std::unique_lock<std::mutex> lk(gravity_mutex_);
+
+  // only add one constraint per constraint period
+  if (params_.min_constraint_period_s > 0 &&
+      last_constraint_stamp_ != ros::Time(0) &&
+      msg->header.stamp - last_constraint_stamp_ <
+          ros::Duration(params_.min_constraint_period_s)) {
+    return;
+  }
 
   // if we get to the end, then IMU data doesn't exist so exit. This shouldn't
   // happen as we always expect the odom trigger to arrive after IMU data. If
   // this assumption isn't true, then something is wrong
-  if (lower_bound == imu_buffer_.end()) {
+  if (imu_buffer_.LowerBound(msg->header.stamp) == imu_buffer_.end()) {
     BEAM_ERROR("No IMU data available for incoming odom timestamp of {}s. Not "
                "adding gravity alignment constraint. Make sure your IMU data "
                "is arriving before your Odometry message",
@@ -77,76 +83,83 @@ void GravityAlignment::processOdometry(
     return;
   }
 
-  // get closest IMU time
-  int64_t closest_imu_time_ns;
-  if (lower_bound->first == odom_time_ns) {
-    // if exact time is returned, no need to check for closest
-    closest_imu_time_ns = lower_bound->first;
-  } else if (lower_bound == imu_buffer_.begin()) {
-    // if the first time is returned, then check the max time offset
-    if (lower_bound->first - odom_time_ns > max_time_offset_in_ns_) {
-      // this also shouldn't occur unless the buffer isn't long enough
-      BEAM_ERROR(
-          "No IMU data available for incoming odom timestamp of {}s. Not "
-          "adding gravity alignment constraint. Check the IMU buffer time.",
-          msg->header.stamp.toSec());
-      return;
-    }
-    closest_imu_time_ns = lower_bound->first;
-  } else {
-    // else then we are not at the bounds
-    auto prev = std::prev(lower_bound);
-    closest_imu_time_ns =
-        (odom_time_ns - prev->first > lower_bound->first - odom_time_ns)
-            ? lower_bound->first
-            : prev->first;
-    // double check that there isn't too much time offset (this also shouldn't
-    // occur unless we are having major IMU drops)
-    if (std::abs(closest_imu_time_ns - odom_time_ns) > max_time_offset_in_ns_) {
-      BEAM_ERROR(
-          "No IMU data available for incoming odom timestamp of {}s. Not "
-          "adding gravity alignment constraint. Check for IMU data drops",
-          msg->header.stamp.toSec());
-      return;
-    }
+  // get closest IMU sample and check that there isn't too much time offset.
+  // This shouldn't occur unless the buffer isn't long enough or we are having
+  // major IMU drops
+  const bs_common::ImuSample* closest =
+      imu_buffer_.Closest(msg->header.stamp, max_time_offset_);
+  if (!closest) {
+    BEAM_ERROR(
+        "No IMU data available for incoming odom timestamp of {}s. Not "
+        "adding gravity alignment constraint. Check the IMU buffer time and "
+        "check for IMU data drops",
+        msg->header.stamp.toSec());
+    return;
+  }
+  const bs_common::ImuSample imu_sample = *closest;
+  Eigen::Vector3d g_in_Imu = imu_sample.q_WORLD.inverse() * g_in_World_;
+  if (params_.averaging_window_s > 0 &&
+      !AverageGravity(imu_sample.stamp, g_in_Imu)) {
+    ROS_DEBUG("High dynamics in gravity averaging window at %.5f, not adding "
+              "gravity alignment constraint.",
+              msg->header.stamp.toSec());
+    return;
+  }
+  AddConstraint(g_in_Imu, msg->header.stamp);
+  last_constraint_stamp_ = msg->header.stamp;
+
+  // clear all IMU messages before constraint time, keeping the ones that can
+  // be in the next averaging window
+  const ros::Duration window(params_.averaging_window_s);
+  if (imu_sample.stamp.toSec() > window.toSec()) {
+    imu_buffer_.RemoveBefore(imu_sample.stamp - window);
   }
 
-  std::unique_lock<std::mutex> lk(gravity_mutex_);
-  AddConstraint(imu_buffer_.at(closest_imu_time_ns), msg->header.stamp);
+  Publish(imu_sample, msg);
+}
 
-  // clear all IMU messages before constraint time
-  while (!imu_buffer_.empty() &&
-         imu_buffer_.begin()->first < closest_imu_time_ns) {
-    imu_buffer_.erase(imu_buffer_.begin());
+bool GravityAlignment::AverageGravity(const ros::Time& end_time,
+                                      Eigen::Vector3d& g_in_Imu) const {
+  const ros::Duration window(params_.averaging_window_s);
+  const ros::Time start_time = end_time.toSec() > window.toSec()
+                                   ? end_time - window
+                                   : ros::Time(0);
+  const auto samples = imu_buffer_.Range(start_time, end_time);
+  if (samples.empty()) { return false; }
+
+  Eigen::Vector3d g_sum = Eigen::Vector3d::Zero();
+  for (const auto& sample : samples) {
+    if (sample.w.norm() > params_.max_angular_rate ||
+        std::abs(sample.a.norm() - GRAVITY_NOMINAL) >
+            params_.max_accel_deviation) {
+      return false;
+    }
+    g_sum += sample.q_WORLD.inverse() * g_in_World_;
   }
-
-  Publish(imu_buffer_.at(closest_imu_time_ns), msg);
+  if (g_sum.norm() < 1e-9) { return false; }
+  g_in_Imu = g_sum.normalized();
+  return true;
 }
 
-void GravityAlignment::AddConstraint(const sensor_msgs::Imu::ConstPtr& imu_msg,
+void GravityAlignment::AddConstraint(const Eigen::Vector3d& g_in_Imu,
                                      const ros::Time& stamp) {
   auto orientation_uuid = fuse_core::uuid::generate(
       "fuse_variables::Orientation3DStamped", stamp, fuse_core::uuid::NIL);
-  Eigen::Quaterniond q_World_Imu(imu_msg->orientation.w, imu_msg->orientation.x,
-                                 imu_msg->orientation.y,
-                                 imu_msg->orientation.z);
-  Eigen::Matrix3d R_Imu_World = q_World_Imu.inverse().toRotationMatrix();
   Eigen::Matrix4d T_Baselink_Imu;
   extrinsics_.GetT_BASELINK_IMU(T_Baselink_Imu);
-  Eigen::Matrix3d R_Baselink_World =
-      T_Baselink_Imu.block(0, 0, 3, 3) * R_Imu_World;
-  Eigen::Vector3d g_in_Baselink = R_Baselink_World * g_in_World_;
+  Eigen::Vector3d g_in_Baselink = T_Baselink_Imu.block(0, 0, 3, 3) * g_in_Imu;
   fuse_variables::Orientation3DStamped o_World_Imu(stamp);
-  auto constraint =
-      bs_constraints::GravityAlignmentStampedConstraint::make_shared(
-          source_, orientation_uuid, g_in_Baselink, covariance_);
+  auto constraint = bs_common::MakePooled<
+      bs_constraints::GravityAlignmentStampedConstraint>(
+      params_.use_pooled_allocation, source_, orientation_uuid, g_in_Baselink,
+      covariance_);
   auto transaction = std::make_shared<fuse_core::Transaction>();
   transaction->addConstraint(constraint);
   sendTransaction(transaction);
 }
 
 void GravityAlignment::Publish(
-    const sensor_msgs::Imu::ConstPtr& imu_data,
+    const bs_common::ImuSample& imu_sample,
     const nav_msgs::Odometry::ConstPtr& odom_data) const {
   pcl::PointCloud<pcl::PointXYZRGBL> cloud;
   auto frame = beam::CreateFrameCol(odom_data->header.stamp);
@@ -155,9 +168,7 @@ void GravityAlignment::Publish(
   bs_common::OdometryMsgToTransformationMatrix(*odom_data, T_World_Baselink);
   beam::MergeFrameToCloud(cloud, frame, T_World_Baselink);
 
-  Eigen::Quaterniond q(imu_data->orientation.w, imu_data->orientation.x,
-                       imu_data->orientation.y, imu_data->orientation.z);
-  Eigen::Matrix3d R_World_Imu = q.toRotationMatrix();
+  Eigen::Matrix3d R_World_Imu = imu_sample.q_WORLD.toRotationMatrix();
   Eigen::Vector3d t_World_Baselink = T_World_Baselink.block(0, 3, 3, 1);
   Eigen::Vector3d g_in_Imu = gravity_vector_length_ * params_.gravity_nominal;
   Eigen::Vector3d g_in_world = R_World_Imu * g_in_Imu + t_World_Baselink;
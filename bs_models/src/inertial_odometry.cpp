@@ -4,10 +4,15 @@
 #include <pluginlib/class_list_macros.h>
 
 #include <beam_utils/filesystem.h>
+#include <beam_utils/math.h>
 #include <std_msgs/Empty.h>
 
 #include <bs_common/conversions.h>
 #include <bs_common/graph_access.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_common/sampling_profiler.h>
+#include <bs_common/startup_profiler.h>
 #include <bs_constraints/inertial/relative_imu_state_3d_stamped_constraint.h>
 #include <fuse_constraints/relative_constraint.h>
 #include <fuse_constraints/relative_pose_3d_stamped_constraint.h>
@@ -17,22 +22,44 @@ PLUGINLIB_EXPORT_CLASS(bs_models::InertialOdometry, fuse_core::SensorModel);
 
 namespace bs_models {
 
-ImuBuffer::ImuBuffer(double buffer_length_s) {
-  buffer_length_ = ros::Duration(buffer_length_s);
+namespace {
+
+// reorder covariance from: roll,pitch,yaw,x,y,z to x,y,z,roll,pitch,yaw
+Eigen::Matrix<double, 6, 6>
+    ToOdometryCovariance(const Eigen::Matrix<double, 6, 6>& cov) {
+  Eigen::Matrix<double, 6, 6> cov_reordered =
+      Eigen::Matrix<double, 6, 6>::Zero();
+  cov_reordered.block<3, 3>(0, 0) = cov.block<3, 3>(3, 3);
+  cov_reordered.block<3, 3>(0, 3) = cov.block<3, 3>(3, 0);
+  cov_reordered.block<3, 3>(3, 0) = cov.block<3, 3>(0, 3);
+  cov_reordered.block<3, 3>(3, 3) = cov.block<3, 3>(0, 0);
+  return cov_reordered;
 }
 
+} // namespace
+
+ImuBuffer::ImuBuffer(double buffer_length_s)
+    : imu_samples_(ros::Duration(buffer_length_s)),
+      buffer_length_(buffer_length_s) {}
+
 void ImuBuffer::AddData(const sensor_msgs::Imu::ConstPtr& msg) {
-  imu_msgs_.emplace(msg->header.stamp, msg);
+  // the sample buffer removes its own overflow
+  if (imu_samples_.Add(*msg)) {
+    preintegration_tree_.AddData(bs_common::IMUData(*msg));
+    preintegration_tree_.RemoveBefore(imu_samples_.Front().stamp);
+  }
   CleanOverflow();
+
+  // the buffers are bounded by time, so this is only reported
+  static bs_common::MemoryAccount& account =
+      bs_common::MemoryAccounting::GetInstance().GetAccount(
+          "inertial_odometry/imu_buffer");
+  account.Update(imu_samples_.Size() + constraint_buffer_.size(),
+                 imu_samples_.Size() * sizeof(bs_common::ImuSample) +
+                     constraint_buffer_.size() * sizeof(ImuConstraintData));
 }
 
 void ImuBuffer::CleanOverflow() {
-  while (!imu_msgs_.empty() &&
-         imu_msgs_.rbegin()->first - imu_msgs_.begin()->first >
-             buffer_length_) {
-    imu_msgs_.erase(imu_msgs_.begin());
-  }
-
   while (!constraint_buffer_.empty() &&
          constraint_buffer_.rbegin()->first -
                  constraint_buffer_.begin()->first >
@@ -43,26 +70,71 @@ void ImuBuffer::CleanOverflow() {
 
 void ImuBuffer::AddConstraint(const ros::Time& start_time,
                               const ros::Time& end_time,
-                              const fuse_core::UUID& constraint_uuid) {
+                              const fuse_core::UUID& constraint_uuid,
+                              const Eigen::Vector3d& bg,
+                              const Eigen::Vector3d& ba) {
   ImuConstraintData data;
   data.constraint_uuid = constraint_uuid;
   data.start_time = start_time;
   data.end_time = end_time;
+  data.bg = bg;
+  data.ba = ba;
   constraint_buffer_.emplace(end_time, data);
 }
 
-std::map<ros::Time, sensor_msgs::Imu::ConstPtr>
+bs_common::ImuSampleBuffer::View
     ImuBuffer::GetImuData(const ros::Time& start_time,
                           const ros::Time& end_time) const {
-  if (imu_msgs_.empty()) { return {}; }
-  auto iter_start = imu_msgs_.lower_bound(start_time);
-  if (iter_start == imu_msgs_.end()) { return {}; }
-  std::map<ros::Time, sensor_msgs::Imu::ConstPtr> data;
-  for (auto it = iter_start; it != imu_msgs_.end(); it++) {
-    if (it->first > end_time) { break; }
-    data.insert(*it);
+  return imu_samples_.Range(start_time, end_time);
+}
+
+void ImuBuffer::SetPreintegrationNoise(
+    const ImuPreintegration::Params& params) {
+  preintegration_tree_.cov_w = params.cov_gyro_noise;
+  preintegration_tree_.cov_a = params.cov_accel_noise;
+  preintegration_tree_.cov_bg = params.cov_gyro_bias;
+  preintegration_tree_.cov_ba = params.cov_accel_bias;
+}
+
+bool ImuBuffer::Preintegrate(const ros::Time& start_time,
+                             const ros::Time& end_time,
+                             const Eigen::Vector3d& bg,
+                             const Eigen::Vector3d& ba,
+                             bs_common::PreIntegrator& pre_integrator) {
+  return preintegration_tree_.Integrate(start_time, end_time, bg, ba,
+                                        pre_integrator);
+}
+
+bool ImuBuffer::Reintegrate(const ros::Time& start_time,
+                            const ros::Time& end_time,
+                            const Eigen::Vector3d& bg,
+                            const Eigen::Vector3d& ba,
+                            bs_common::PreIntegrator& pre_integrator) const {
+  if (imu_samples_.Empty() || start_time < imu_samples_.Front().stamp ||
+      end_time <= start_time) {
+    return false;
   }
-  return data;
+
+  // the sample at or before the start time is held from the start time
+  auto it = imu_samples_.LowerBound(start_time);
+  if (it == imu_samples_.end() || it->stamp > start_time) { it--; }
+  bs_common::IMUData first = it->ToIMUData();
+  first.t = start_time;
+
+  pre_integrator.Reset();
+  pre_integrator.cov_w = preintegration_tree_.cov_w;
+  pre_integrator.cov_a = preintegration_tree_.cov_a;
+  pre_integrator.cov_bg = preintegration_tree_.cov_bg;
+  pre_integrator.cov_ba = preintegration_tree_.cov_ba;
+  pre_integrator.AddData(first);
+  for (it++; it != imu_samples_.end() && it->stamp < end_time; it++) {
+    pre_integrator.AddData(it->ToIMUData());
+  }
+  return pre_integrator.Integrate(end_time, bg, ba, true, true, true);
+}
+
+std::map<ros::Time, ImuConstraintData>& ImuBuffer::GetConstraints() {
+  return constraint_buffer_;
 }
 
 std::optional<ImuConstraintData>
@@ -89,12 +161,12 @@ ros::Time ImuBuffer::GetLastConstraintTime() const {
 }
 
 void ImuBuffer::ClearImuMsgs() {
-  imu_msgs_.clear();
+  imu_samples_.Clear();
+  preintegration_tree_.Clear();
 }
 
-const std::map<ros::Time, sensor_msgs::Imu::ConstPtr>&
-    ImuBuffer::GetImuMsgs() const {
-  return imu_msgs_;
+const bs_common::ImuSampleBuffer& ImuBuffer::GetImuSamples() const {
+  return imu_samples_;
 }
 
 InertialOdometry::InertialOdometry()
@@ -105,15 +177,26 @@ InertialOdometry::InertialOdometry()
                                             this, std::placeholders::_1)) {}
 
 void InertialOdometry::onInit() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_init");
   // Read settings from the parameter sever
   calibration_params_.loadFromROS();
   params_.loadFromROS(private_node_handle_);
+  graph_update_lane_ = bs_common::CallbackLane<fuse_core::Graph>::FromROS(
+      private_node_handle_, "graph_update_lane", name() + "/graph_lane",
+      [this](const fuse_core::Graph::ConstSharedPtr& graph) {
+        onGraphUpdate(graph);
+      });
 
   // setup publishers
   odometry_publisher_ =
       private_node_handle_.advertise<nav_msgs::Odometry>("odometry", 100);
   reset_publisher_ =
       private_node_handle_.advertise<std_msgs::Empty>("/local_mapper/reset", 1);
+  if (params_.publish_propagated_odometry) {
+    propagated_odometry_publisher_ =
+        private_node_handle_.advertise<nav_msgs::Odometry>(
+            "propagated_odometry", 100);
+  }
 
   // read imu parameters
   nlohmann::json J;
@@ -126,10 +209,18 @@ void InertialOdometry::onInit() {
   imu_params_.cov_gyro_bias = Eigen::Matrix3d::Identity() * J["cov_gyro_bias"];
   imu_params_.cov_accel_bias =
       Eigen::Matrix3d::Identity() * J["cov_accel_bias"];
+  imu_params_.use_pooled_allocation = params_.use_pooled_allocation;
+
+  propagation_preintegrator_.cov_w = imu_params_.cov_gyro_noise;
+  propagation_preintegrator_.cov_a = imu_params_.cov_accel_noise;
+  propagation_preintegrator_.cov_bg = imu_params_.cov_gyro_bias;
+  propagation_preintegrator_.cov_ba = imu_params_.cov_accel_bias;
+  imu_buffer_.SetPreintegrationNoise(imu_params_);
 }
 
 void InertialOdometry::onStart() {
   ROS_INFO_STREAM("Starting: " << name());
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_start");
   // subscribe to imu topic
   imu_subscriber_ = private_node_handle_.subscribe<sensor_msgs::Imu>(
       ros::names::resolve(params_.imu_topic), 1000,
@@ -144,36 +235,112 @@ void InertialOdometry::onStart() {
 
 void InertialOdometry::onStop() {
   ROS_INFO_STREAM("Stopping: " << name());
+  if (graph_update_lane_) { graph_update_lane_->Clear(); }
   shutdown();
 }
 
 void InertialOdometry::processIMU(const sensor_msgs::Imu::ConstPtr& msg) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "inertial_odometry/process_imu");
+  bs_common::ScopedTimer timer(metric);
+
   ROS_INFO_STREAM_ONCE(
       "InertialOdometry received IMU measurements: " << msg->header.stamp);
-  std::unique_lock<std::mutex> lk(mutex_);
-  imu_buffer_.AddData(msg);
-  // return if its not initialized_
-  if (!initialized_) {
-    ROS_INFO_THROTTLE(
-        1, "inertial odometry not yet initialized, waiting on first graph "
-           "update before beginning");
+  if (params_.publish_propagated_odometry) { PropagateImu(msg); }
+
+  // hand the msg over to the buffered path. If a graph update holds the lock,
+  // the queued msgs are processed with the next msg that gets it
+  if (!imu_queue_.TryPush(sensor_msgs::Imu::ConstPtr(msg))) {
+    // queue is full, wait for the lock rather than dropping data
+    std::unique_lock<std::mutex> lk(mutex_);
+    ProcessQueuedImu();
+    imu_queue_.TryPush(sensor_msgs::Imu::ConstPtr(msg));
+    ProcessQueuedImu();
     return;
   }
+  std::unique_lock<std::mutex> lk(mutex_, std::try_to_lock);
+  if (lk.owns_lock()) { ProcessQueuedImu(); }
+}
+
+void InertialOdometry::ProcessQueuedImu() {
+  sensor_msgs::Imu::ConstPtr msg;
+  while (imu_queue_.TryPop(msg)) {
+    imu_buffer_.AddData(msg);
+    // skip if its not initialized_
+    if (!initialized_) {
+      ROS_INFO_THROTTLE(
+          1, "inertial odometry not yet initialized, waiting on first graph "
+             "update before beginning");
+      continue;
+    }
 
-  // process each imu message as it comes in
-  imu_preint_->AddToBuffer(*msg);
-  // get relative pose and publish
-  ComputeRelativeMotion(prev_stamp_, msg->header.stamp);
-  odom_seq_++;
-  prev_stamp_ = msg->header.stamp;
+    // process each imu message as it comes in
+    imu_preint_->AddToBuffer(*msg);
+    // get relative pose and publish
+    ComputeRelativeMotion(prev_stamp_, msg->header.stamp);
+    odom_seq_++;
+    prev_stamp_ = msg->header.stamp;
+  }
+}
+
+void InertialOdometry::PropagateImu(const sensor_msgs::Imu::ConstPtr& msg) {
+  const ros::Time& stamp = msg->header.stamp;
+  propagation_preintegrator_.AddData(bs_common::IMUData(*msg));
+
+  const auto origin = optimized_state_.Load();
+  if (!origin) {
+    // keep enough data to propagate the first state once it arrives
+    propagation_preintegrator_.Clear(
+        stamp - ros::Duration(params_.measurement_buffer_duration));
+    return;
+  }
+  if (origin != propagation_origin_) {
+    // new optimized state, integrate from its stamp
+    propagation_origin_ = origin;
+    propagation_preintegrator_.Clear(origin->Stamp());
+  }
+  if (stamp <= origin->Stamp()) { return; }
+
+  // measurements are integrated incrementally, so this only increments over
+  // the new msg unless the state was just replaced
+  if (!propagation_preintegrator_.Integrate(stamp, origin->GyroBiasVec(),
+                                            origin->AccelBiasVec(), false,
+                                            true, false)) {
+    return;
+  }
+  const bs_common::CompactImuState state = ImuPreintegration::PredictState(
+      propagation_preintegrator_, *origin, stamp);
+
+  // covariance is that of the motion since the optimized state
+  Eigen::Matrix4d T_WORLD_IMU;
+  beam::QuaternionAndTranslationToTransformMatrix(
+      state.OrientationQuat(), state.PositionVec(), T_WORLD_IMU);
+  auto odom_msg = bs_common::TransformToOdometryMessage(
+      stamp, propagated_seq_++, extrinsics_.GetWorldFrameId(),
+      extrinsics_.GetImuFrameId(), T_WORLD_IMU,
+      ToOdometryCovariance(
+          propagation_preintegrator_.delta.cov.block<6, 6>(0, 0)));
+  propagated_odometry_publisher_.publish(odom_msg);
+}
+
+void InertialOdometry::PublishOptimizedState() {
+  if (!params_.publish_propagated_odometry) { return; }
+  optimized_state_.Store(imu_preint_->GetCompactImuState());
 }
 
 void InertialOdometry::processTrigger(const std_msgs::Time::ConstPtr& msg) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
   std::unique_lock<std::mutex> lk(mutex_);
+  ProcessQueuedImu();
   trigger_buffer_.push_back(msg);
 
   if (!initialized_) { return; }
 
+  // all triggers that are ready are sent in a single transaction
+  auto transaction = fuse_core::Transaction::make_shared();
+  ros::Time transaction_stamp(0);
   while (!trigger_buffer_.empty()) {
     const auto current_trigger = trigger_buffer_.front();
     const ros::Time& time(current_trigger->data);
@@ -181,33 +348,52 @@ void InertialOdometry::processTrigger(const std_msgs::Time::ConstPtr& msg) {
     trigger_buffer_.pop_front();
 
     ros::Time last_constraint_time = imu_buffer_.GetLastConstraintTime();
-    if (time == last_constraint_time) {
-      return;
-    } else if (time > last_constraint_time) {
+    if (time == last_constraint_time) { continue; }
+    transaction_stamp = std::max(transaction_stamp, time);
+
+    // near simultaneous triggers from other sensors are tied to the state of
+    // the last one instead of getting their own imu constraint
+    if (params_.trigger_coalescing_tolerance > 0 &&
+        std::abs((time - last_constraint_time).toSec()) <
+            params_.trigger_coalescing_tolerance &&
+        AddZeroMotionConstraint(last_constraint_time, time, transaction)) {
+      ROS_DEBUG("Coalesced imu trigger at %.5f with trigger at %.5f",
+                time.toSec(), last_constraint_time.toSec());
+      continue;
+    }
+
+    if (time > last_constraint_time) {
+      const bs_common::CompactImuState imu_state_i =
+          imu_preint_->GetCompactImuState();
       auto trans = imu_preint_->RegisterNewImuPreintegratedFactor(time);
-      if (!trans) { return; }
-      trans->stamp(time);
-      sendTransaction(trans);
+      if (!trans) { break; }
+      transaction->merge(*trans);
       auto added_constraints_range = trans->addedConstraints();
       // check that only one was added
       if (std::next(added_constraints_range.begin()) !=
           added_constraints_range.end()) {
         BEAM_ERROR(
             "invalid number of constraints added to graph from IMU data");
-        return;
+        break;
       }
       imu_buffer_.AddConstraint(last_trigger_time_, time,
-                                added_constraints_range.begin()->uuid());
+                                added_constraints_range.begin()->uuid(),
+                                imu_state_i.GyroBiasVec(),
+                                imu_state_i.AccelBiasVec());
     } else {
       // this means we have to remove a constraint and replace it with two
       std::optional<ImuConstraintData> maybeConstraintData =
           imu_buffer_.ExtractConstraintContainingTime(time);
       if (maybeConstraintData) {
-        BreakupConstraint(time, maybeConstraintData.value());
+        BreakupConstraint(time, maybeConstraintData.value(), transaction);
       }
     }
     last_trigger_time_ = time;
   }
+
+  if (transaction->empty()) { return; }
+  transaction->stamp(transaction_stamp);
+  sendTransaction(transaction);
 }
 
 void InertialOdometry::ComputeRelativeMotion(const ros::Time& prev_stamp,
@@ -216,33 +402,45 @@ void InertialOdometry::ComputeRelativeMotion(const ros::Time& prev_stamp,
   const auto [T_IMUprev_IMUcurr, cov_rel] =
       imu_preint_->GetRelativeMotion(prev_stamp, curr_stamp, velocity_curr);
 
-  // reorder covariance from: roll,pitch,yaw,x,y,z to x,y,z,roll,pitch,yaw
-  Eigen::Matrix<double, 6, 6> cov_reordered =
-      Eigen::Matrix<double, 6, 6>::Zero();
-  cov_reordered.block<3, 3>(0, 0) = cov_rel.block<3, 3>(3, 3);
-  cov_reordered.block<3, 3>(0, 3) = cov_rel.block<3, 3>(3, 0);
-  cov_reordered.block<3, 3>(3, 0) = cov_rel.block<3, 3>(0, 3);
-  cov_reordered.block<3, 3>(3, 3) = cov_rel.block<3, 3>(0, 0);
-
   // publish relative odometry
   T_ODOM_IMUprev_ = T_ODOM_IMUprev_ * T_IMUprev_IMUcurr;
   auto odom_msg_rel = bs_common::TransformToOdometryMessage(
       curr_stamp, odom_seq_, extrinsics_.GetWorldFrameId(),
-      extrinsics_.GetImuFrameId(), T_ODOM_IMUprev_, cov_reordered);
+      extrinsics_.GetImuFrameId(), T_ODOM_IMUprev_,
+      ToOdometryCovariance(cov_rel));
   odometry_publisher_.publish(odom_msg_rel);
 }
 
+void InertialOdometry::graphCallback(fuse_core::Graph::ConstSharedPtr graph) {
+  if (!graph_update_lane_) {
+    fuse_core::AsyncSensorModel::graphCallback(std::move(graph));
+    return;
+  }
+  graph_update_lane_->Push(std::move(graph));
+}
+
 void InertialOdometry::onGraphUpdate(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "inertial_odometry/graph_update");
+  bs_common::ScopedTimer timer(metric);
+
   std::unique_lock<std::mutex> lk(mutex_);
+  ProcessQueuedImu();
   most_recent_graph_msg_ = graph_msg;
   if (!initialized_) {
     Initialize(graph_msg);
+    PublishOptimizedState();
     return;
   }
-  imu_preint_->UpdateGraph(graph_msg);
+  const bs_common::GraphView graph_view(graph_msg);
+  imu_preint_->UpdateGraph(graph_view);
+  PublishOptimizedState();
+  if (params_.relinearize_constraints) { RelinearizeConstraints(graph_view); }
 
-  const auto cur_imu_state = imu_preint_->GetImuState();
+  const auto cur_imu_state = imu_preint_->GetCompactImuState();
   const auto bg_norm = cur_imu_state.GyroBiasVec().norm();
   const auto ba_norm = cur_imu_state.AccelBiasVec().norm();
 
@@ -309,18 +507,13 @@ void InertialOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph_msg) {
     if (next == timestamps.end()) { break; }
     auto next_stamp = *next;
     // for each imu message between cur_stamp and next_stamp, integrate
-    for (const auto& [imu_stamp, imu_msg] : imu_buffer_.GetImuMsgs()) {
-      if (imu_stamp <= cur_stamp) {
-        continue;
-      } else if (imu_stamp <= next_stamp) {
-        imu_preint_->AddToBuffer(*imu_msg);
-        // get relative pose and publish
-        ComputeRelativeMotion(prev_stamp_, imu_stamp);
-        odom_seq_++;
-        prev_stamp_ = imu_stamp;
-      } else {
-        break;
-      }
+    for (const auto& sample : imu_buffer_.GetImuSamples().After(cur_stamp)) {
+      if (sample.stamp > next_stamp) { break; }
+      imu_preint_->AddToBuffer(sample.ToIMUData());
+      // get relative pose and publish
+      ComputeRelativeMotion(prev_stamp_, sample.stamp);
+      odom_seq_++;
+      prev_stamp_ = sample.stamp;
     }
     imu_preint_->Clear();
   }
@@ -328,13 +521,12 @@ void InertialOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph_msg) {
   const ros::Time last_stamp = *timestamps.crbegin();
   last_trigger_time_ = last_stamp;
   // integrate remaining imu messages
-  for (const auto& [imu_stamp, imu_msg] : imu_buffer_.GetImuMsgs()) {
-    if (imu_stamp <= last_stamp) { continue; }
-    imu_preint_->AddToBuffer(*imu_msg);
+  for (const auto& sample : imu_buffer_.GetImuSamples().After(last_stamp)) {
+    imu_preint_->AddToBuffer(sample.ToIMUData());
     // get relative pose and publish
-    ComputeRelativeMotion(prev_stamp_, imu_stamp);
+    ComputeRelativeMotion(prev_stamp_, sample.stamp);
     odom_seq_++;
-    prev_stamp_ = imu_stamp;
+    prev_stamp_ = sample.stamp;
   }
 
   // add existing constraints to imu buffer
@@ -342,8 +534,10 @@ void InertialOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph_msg) {
     if (c.type() == "bs_constraints::RelativeImuState3DStampedConstraint") {
       auto imu_constraint = dynamic_cast<
           const bs_constraints::RelativeImuState3DStampedConstraint&>(c);
-      imu_buffer_.AddConstraint(imu_constraint.GetTime1(),
-                                imu_constraint.GetTime2(), c.uuid());
+      const bs_common::ImuState& imu_state_i = imu_constraint.GetImuState1();
+      imu_buffer_.AddConstraint(
+          imu_constraint.GetTime1(), imu_constraint.GetTime2(), c.uuid(),
+          imu_state_i.GyroBiasVec(), imu_state_i.AccelBiasVec());
     }
   }
 
@@ -351,11 +545,8 @@ void InertialOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph_msg) {
 }
 
 void InertialOdometry::BreakupConstraint(
-    const ros::Time& new_trigger_time,
-    const ImuConstraintData& constraint_data) {
-  auto transaction = fuse_core::Transaction::make_shared();
-  transaction->stamp(new_trigger_time);
-
+    const ros::Time& new_trigger_time, const ImuConstraintData& constraint_data,
+    fuse_core::Transaction::SharedPtr transaction) {
   auto velocity = bs_common::GetVelocity(*most_recent_graph_msg_,
                                          constraint_data.start_time);
   auto position = bs_common::GetPosition(*most_recent_graph_msg_,
@@ -366,128 +557,174 @@ void InertialOdometry::BreakupConstraint(
   imu_preint_->SetStart(constraint_data.start_time, orientation, position,
                         velocity);
 
-  // add first half
+  // add first half, preintegrating from the cached segments of the imu data
+  // instead of re-integrating all of it
   bool first_successful = false;
-  std::map<ros::Time, sensor_msgs::Imu::ConstPtr> imu_data1 =
-      imu_buffer_.GetImuData(constraint_data.start_time, new_trigger_time);
-  if (!imu_data1.empty()) {
-    for (const auto& [t, imu_msg] : imu_data1) {
-      imu_preint_->AddToBuffer(*imu_msg);
-    }
-    auto imu_trans1 =
-        imu_preint_->RegisterNewImuPreintegratedFactor(new_trigger_time);
+  bs_common::CompactImuState imu_state_i = imu_preint_->GetCompactImuState();
+  bs_common::PreIntegrator pre_integrator1;
+  if (imu_buffer_.Preintegrate(constraint_data.start_time, new_trigger_time,
+                               imu_state_i.GyroBiasVec(),
+                               imu_state_i.AccelBiasVec(), pre_integrator1)) {
+    auto imu_trans1 = imu_preint_->RegisterPreintegratedFactor(
+        new_trigger_time, pre_integrator1);
     if (!imu_trans1) {
       ROS_WARN_STREAM(
-          "cannot add constraint for second half of constraint being "
+          "cannot add constraint for first half of constraint being "
           "broken up. Constraint start time: "
           << bs_common::ToString(constraint_data.start_time)
           << ", constraint end time: " << bs_common::ToString(new_trigger_time)
           << ".");
-      ROS_DEBUG_STREAM(
-          "ImuPreintegration buffer: " << imu_preint_->PrintBuffer());
     } else {
       imu_buffer_.AddConstraint(constraint_data.start_time, new_trigger_time,
-                                imu_trans1->addedConstraints().begin()->uuid());
+                                imu_trans1->addedConstraints().begin()->uuid(),
+                                imu_state_i.GyroBiasVec(),
+                                imu_state_i.AccelBiasVec());
       transaction->merge(*imu_trans1);
       first_successful = true;
     }
   }
 
-  // add second half
+  // add second half, starting from the current key frame so that it covers
+  // the whole constraint if the first half failed
   bool second_successful = false;
-  std::map<ros::Time, sensor_msgs::Imu::ConstPtr> imu_data2 =
-      imu_buffer_.GetImuData(new_trigger_time, constraint_data.end_time);
-  if (!imu_data1.empty()) {
-    for (const auto& [t, imu_msg] : imu_data2) {
-      imu_preint_->AddToBuffer(*imu_msg);
-    }
-    auto imu_trans2 = imu_preint_->RegisterNewImuPreintegratedFactor(
-        constraint_data.end_time);
+  imu_state_i = imu_preint_->GetCompactImuState();
+  bs_common::PreIntegrator pre_integrator2;
+  if (imu_buffer_.Preintegrate(imu_state_i.Stamp(), constraint_data.end_time,
+                               imu_state_i.GyroBiasVec(),
+                               imu_state_i.AccelBiasVec(), pre_integrator2)) {
+    auto imu_trans2 = imu_preint_->RegisterPreintegratedFactor(
+        constraint_data.end_time, pre_integrator2);
     if (!imu_trans2) {
       ROS_WARN_STREAM(
           "cannot add constraint for second half of constraint being "
           "broken up. Constraint start time: "
-          << bs_common::ToString(new_trigger_time) << ", constraint end time: "
+          << bs_common::ToString(imu_state_i.Stamp())
+          << ", constraint end time: "
           << bs_common::ToString(constraint_data.end_time) << ".");
-      ROS_DEBUG_STREAM(
-          "ImuPreintegration buffer: " << imu_preint_->PrintBuffer());
     } else {
-      imu_buffer_.AddConstraint(new_trigger_time, constraint_data.end_time,
-                                imu_trans2->addedConstraints().begin()->uuid());
+      imu_buffer_.AddConstraint(imu_state_i.Stamp(), constraint_data.end_time,
+                                imu_trans2->addedConstraints().begin()->uuid(),
+                                imu_state_i.GyroBiasVec(),
+                                imu_state_i.AccelBiasVec());
       transaction->merge(*imu_trans2);
       second_successful = true;
     }
   }
 
   // add zero motion constraint if need be
+  constexpr double tolerance =
+      bs_parameters::models::InertialOdometryParams::
+          max_trigger_coalescing_tolerance;
   if (std::abs((new_trigger_time - constraint_data.start_time).toSec()) <
-      0.005) {
-    auto maybe_start_position = bs_common::GetPosition(
-        *most_recent_graph_msg_, constraint_data.start_time);
-    auto maybe_start_orientation = bs_common::GetOrientation(
-        *most_recent_graph_msg_, constraint_data.start_time);
-    if (maybe_start_position && maybe_start_orientation) {
-      bs_common::ImuState start_state(constraint_data.start_time);
-      start_state.SetPosition(*maybe_start_position);
-      start_state.SetOrientation(*maybe_start_orientation);
-      start_state.SetVelocity(Eigen::Vector3d::Zero());
-      start_state.SetGyroBias(Eigen::Vector3d::Zero());
-      start_state.SetAccelBias(Eigen::Vector3d::Zero());
-
-      bs_common::ImuState new_state(new_trigger_time);
-      new_state.SetPosition(start_state.PositionVec());
-      new_state.SetOrientation(start_state.OrientationQuat());
-      new_state.SetVelocity(start_state.VelocityVec());
-      new_state.SetGyroBias(start_state.GyroBiasVec());
-      new_state.SetAccelBias(start_state.AccelBiasVec());
-
-      auto zero_motion_transaction = fuse_core::Transaction::make_shared();
-      zero_motion_transaction->stamp(new_trigger_time);
-      bs_common::AddZeroMotionFactor(name(), start_state, new_state,
-                                     zero_motion_transaction);
-      transaction->merge(*zero_motion_transaction);
-    } else {
-      BEAM_ERROR("Cannot retrieve IMU state at time {}, not able to add zero "
-                 "motion constraint.",
-                 bs_common::ToString(constraint_data.start_time));
-    }
+      tolerance) {
+    AddZeroMotionConstraint(constraint_data.start_time, new_trigger_time,
+                            transaction);
   } else if (std::abs((new_trigger_time - constraint_data.end_time).toSec()) <
-             0.005) {
-    auto maybe_end_position = bs_common::GetPosition(*most_recent_graph_msg_,
-                                                     constraint_data.end_time);
-    auto maybe_end_orientation = bs_common::GetOrientation(
-        *most_recent_graph_msg_, constraint_data.end_time);
-    if (maybe_end_position && maybe_end_orientation) {
-      bs_common::ImuState end_state(constraint_data.end_time);
-      end_state.SetPosition(*maybe_end_position);
-      end_state.SetOrientation(*maybe_end_orientation);
-      end_state.SetVelocity(Eigen::Vector3d::Zero());
-      end_state.SetGyroBias(Eigen::Vector3d::Zero());
-      end_state.SetAccelBias(Eigen::Vector3d::Zero());
-
-      bs_common::ImuState new_state(new_trigger_time);
-      new_state.SetPosition(end_state.PositionVec());
-      new_state.SetOrientation(end_state.OrientationQuat());
-      new_state.SetVelocity(end_state.VelocityVec());
-      new_state.SetGyroBias(end_state.GyroBiasVec());
-      new_state.SetAccelBias(end_state.AccelBiasVec());
-
-      auto zero_motion_transaction = fuse_core::Transaction::make_shared();
-      zero_motion_transaction->stamp(new_trigger_time);
-      bs_common::AddZeroMotionFactor(name(), new_state, end_state,
-                                     zero_motion_transaction);
-      transaction->merge(*zero_motion_transaction);
-    } else {
-      BEAM_ERROR("Cannot retrieve IMU state at time {}, not able to add zero "
-                 "motion constraint.",
-                 bs_common::ToString(constraint_data.end_time));
-    }
+             tolerance) {
+    AddZeroMotionConstraint(constraint_data.end_time, new_trigger_time,
+                            transaction);
   }
 
   // only remove original if both are successful
   if (second_successful && first_successful) {
     transaction->removeConstraint(constraint_data.constraint_uuid);
   }
+}
+
+bool InertialOdometry::AddZeroMotionConstraint(
+    const ros::Time& state_time, const ros::Time& new_time,
+    fuse_core::Transaction::SharedPtr transaction) const {
+  auto maybe_position =
+      bs_common::GetPosition(*most_recent_graph_msg_, state_time);
+  auto maybe_orientation =
+      bs_common::GetOrientation(*most_recent_graph_msg_, state_time);
+  if (!maybe_position || !maybe_orientation) {
+    BEAM_ERROR("Cannot retrieve IMU state at time {}, not able to add zero "
+               "motion constraint.",
+               bs_common::ToString(state_time));
+    return false;
+  }
+
+  bs_common::ImuState state(state_time);
+  state.SetPosition(*maybe_position);
+  state.SetOrientation(*maybe_orientation);
+  state.SetVelocity(Eigen::Vector3d::Zero());
+  state.SetGyroBias(Eigen::Vector3d::Zero());
+  state.SetAccelBias(Eigen::Vector3d::Zero());
+
+  bs_common::ImuState new_state(new_time);
+  new_state.SetPosition(state.PositionVec());
+  new_state.SetOrientation(state.OrientationQuat());
+  new_state.SetVelocity(state.VelocityVec());
+  new_state.SetGyroBias(state.GyroBiasVec());
+  new_state.SetAccelBias(state.AccelBiasVec());
+
+  auto zero_motion_transaction = fuse_core::Transaction::make_shared();
+  zero_motion_transaction->stamp(new_time);
+  if (state_time < new_time) {
+    bs_common::AddZeroMotionFactor(name(), state, new_state,
+                                   zero_motion_transaction);
+  } else {
+    bs_common::AddZeroMotionFactor(name(), new_state, state,
+                                   zero_motion_transaction);
+  }
+  transaction->merge(*zero_motion_transaction);
+  return true;
+}
+
+void InertialOdometry::RelinearizeConstraints(
+    const bs_common::GraphView& graph_view) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "inertial_odometry/relinearize_constraints");
+  bs_common::ScopedTimer timer(metric);
+
+  const fuse_core::Graph& graph = *graph_view.Graph();
+  auto transaction = fuse_core::Transaction::make_shared();
+  ros::Time latest_stamp(0);
+  for (auto& [end_time, constraint_data] : imu_buffer_.GetConstraints()) {
+    // constraints that were marginalized are no longer in the graph
+    if (!graph.constraintExists(constraint_data.constraint_uuid)) {
+      continue;
+    }
+    bs_common::ImuState imu_state_i(constraint_data.start_time);
+    bs_common::ImuState imu_state_j(end_time);
+    if (!imu_state_i.Update(graph_view) || !imu_state_j.Update(graph_view)) {
+      continue;
+    }
+
+    // the constraint corrects small bias changes to first order, so its data
+    // is only re-integrated once the biases move past the tolerances
+    const Eigen::Vector3d bg = imu_state_i.GyroBiasVec();
+    const Eigen::Vector3d ba = imu_state_i.AccelBiasVec();
+    if ((bg - constraint_data.bg).norm() < params_.relinearization_tol_bg &&
+        (ba - constraint_data.ba).norm() < params_.relinearization_tol_ba) {
+      continue;
+    }
+
+    // the imu data may have been dropped from the buffer already
+    auto pre_integrator = std::make_shared<bs_common::PreIntegrator>();
+    if (!imu_buffer_.Reintegrate(constraint_data.start_time, end_time, bg, ba,
+                                 *pre_integrator)) {
+      continue;
+    }
+
+    auto constraint =
+        bs_constraints::RelativeImuState3DStampedConstraint::make_shared(
+            name(), imu_state_i, imu_state_j, pre_integrator,
+            params_.inertial_information_weight);
+    transaction->removeConstraint(constraint_data.constraint_uuid);
+    transaction->addConstraint(constraint);
+    transaction->addInvolvedStamp(constraint_data.start_time);
+    transaction->addInvolvedStamp(end_time);
+    constraint_data.constraint_uuid = constraint->uuid();
+    constraint_data.bg = bg;
+    constraint_data.ba = ba;
+    latest_stamp = std::max(latest_stamp, end_time);
+  }
+
+  if (transaction->empty()) { return; }
+  transaction->stamp(latest_stamp);
   sendTransaction(transaction);
 }
 
@@ -500,6 +737,14 @@ void InertialOdometry::shutdown() {
   T_ODOM_IMUprev_ = Eigen::Matrix4d::Identity();
   trigger_buffer_.clear();
   imu_buffer_ = ImuBuffer();
+  imu_buffer_.SetPreintegrationNoise(imu_params_);
+  sensor_msgs::Imu::ConstPtr queued_msg;
+  while (imu_queue_.TryPop(queued_msg)) {}
+  optimized_state_.Reset();
+  propagation_origin_.reset();
+  propagation_preintegrator_.Clear(ros::TIME_MAX);
+  propagation_preintegrator_.Reset();
+  propagated_seq_ = 0;
   imu_preint_->Reset();
 }
 
@@ -1,12 +1,15 @@
 #include <bs_models/frame_initializers/frame_initializer.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/make_shared.hpp>
+#include <fuse_core/callback_wrapper.h>
 #include <nlohmann/json.hpp>
 
 #include <beam_mapping/Poses.h>
 #include <beam_utils/filesystem.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/trajectory_file.h>
 
 namespace bs_models {
 
@@ -81,14 +84,22 @@ FrameInitializer::FrameInitializer(const std::string& config_path) {
         "Missing or misspelt parameter: 'poses_buffer_time'"};
   }
 
+  if (J.contains("spline_knot_interval_s") &&
+      J["spline_knot_interval_s"].get<double>() > 0) {
+    bs_common::TrajectorySplineCache::Params spline_params;
+    spline_params.knot_interval =
+        ros::Duration(J["spline_knot_interval_s"].get<double>());
+    spline_cache_ =
+        std::make_unique<bs_common::TrajectorySplineCache>(spline_params);
+  }
+
   // if type == posefile ->
   if (type_ == "POSEFILE") {
     InitializeFromPoseFile(info);
   } else if (type_ == "ODOMETRY") {
     poses_buffer_duration_ = ros::Duration(poses_buffer_time);
-    authority_ = "odometry";
-    poses_ = std::make_shared<tf2::BufferCore>(poses_buffer_duration_);
-    pose_lookup_ = std::make_shared<bs_common::PoseLookup>(poses_);
+    poses_ =
+        std::make_unique<bs_common::TrajectoryBuffer>(poses_buffer_duration_);
     T_ORIGINAL_OVERRIDE_ = T_ORIGINAL_OVERRIDE;
 
     ros::NodeHandle n;
@@ -119,47 +130,74 @@ FrameInitializer::FrameInitializer(const std::string& config_path) {
   }
 }
 
+FrameInitializer::~FrameInitializer() {
+  CancelWakeup();
+}
+
 bool FrameInitializer::GetPose(Eigen::Matrix4d& T_WORLD_SENSOR,
                                const ros::Time& time,
                                const std::string& sensor_frame_id,
                                std::string& error_msg) {
-  if (graph_path_.empty()) {
-    return pose_lookup_->GetT_WORLD_SENSOR(T_WORLD_SENSOR, sensor_frame_id,
-                                           time, error_msg);
-  }
   Eigen::Matrix4d T_BASELINK_SENSOR;
-  extrinsics_.GetT_BASELINK_SENSOR(T_BASELINK_SENSOR, sensor_frame_id);
+  if (!extrinsics_.GetT_BASELINK_SENSOR(T_BASELINK_SENSOR, sensor_frame_id,
+                                        time)) {
+    error_msg = "Cannot lookup extrinsics for frame: " + sensor_frame_id;
+    return false;
+  }
 
-  // copy graph path
-  path_mutex_.lock();
-  Path graph_path_copy = graph_path_;
-  path_mutex_.unlock();
+  const auto odometry = poses_->Get();
+  const auto graph_path = graph_path_.Load();
+  Eigen::Matrix4d T_WORLD_BASELINK;
+  if (!GetT_WORLD_BASELINK(T_WORLD_BASELINK, time, *odometry,
+                           graph_path ? *graph_path : bs_common::Trajectory(),
+                           error_msg)) {
+    return false;
+  }
+  T_WORLD_SENSOR = T_WORLD_BASELINK * T_BASELINK_SENSOR;
+  return true;
+}
 
-  if (time < (*graph_path_copy.begin()).first) {
-    error_msg = "Requested time is before the start of the current graph.";
+bool FrameInitializer::GetPoses(
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d>& T_WORLD_SENSORs,
+    const std::vector<ros::Time>& times, const std::string& sensor_frame_id,
+    std::string& error_msg) {
+  T_WORLD_SENSORs.clear();
+  if (times.empty()) { return true; }
+
+  // static extrinsics only need to be looked up once
+  Eigen::Matrix4d T_BASELINK_SENSOR;
+  if (!extrinsics_.GetT_BASELINK_SENSOR(T_BASELINK_SENSOR, sensor_frame_id,
+                                        times.front())) {
+    error_msg = "Cannot lookup extrinsics for frame: " + sensor_frame_id;
     return false;
   }
 
-  if (graph_path_copy.find(time) != graph_path_copy.end()) {
-    // we assume the graph path is in the baselink frame
-    Eigen::Matrix4d T_WORLD_BASELINK = graph_path_copy.at(time);
-    T_WORLD_SENSOR = T_WORLD_BASELINK * T_BASELINK_SENSOR;
+  const auto odometry = poses_->Get();
+  const auto graph_path = graph_path_.Load();
+  if (!graph_path || graph_path->Empty()) {
+    const bool success =
+        spline_cache_
+            ? spline_cache_->Get(*odometry, T_WORLD_SENSORs, times, error_msg)
+            : odometry->Get(T_WORLD_SENSORs, times, error_msg);
+    if (!success) { return false; }
   } else {
-    // get the graph pose that comes directly before current time (even if its
-    // the end)
-    auto lb = graph_path_copy.lower_bound(time);
-    lb = std::prev(lb);
-    const ros::Time closest_graph_time = lb->first;
-    Eigen::Matrix4d T_WORLD_BASELINKprev =
-        graph_path_copy.at(closest_graph_time);
-
-    // compute relative pose between the graph pose and the current time
-    Eigen::Matrix4d T_prev_now;
-    if (!GetRelativePose(T_prev_now, closest_graph_time, time, error_msg)) {
+    T_WORLD_SENSORs.resize(times.size());
+    for (size_t i = 0; i < times.size(); i++) {
+      if (!GetT_WORLD_BASELINK(T_WORLD_SENSORs[i], times[i], *odometry,
+                               *graph_path, error_msg)) {
+        return false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < times.size(); i++) {
+    if (!extrinsics_.IsStatic() &&
+        !extrinsics_.GetT_BASELINK_SENSOR(T_BASELINK_SENSOR, sensor_frame_id,
+                                          times[i])) {
+      error_msg = "Cannot lookup extrinsics for frame: " + sensor_frame_id;
       return false;
     }
-    Eigen::Matrix4d T_WORLD_BASELINKnow = T_WORLD_BASELINKprev * T_prev_now;
-    T_WORLD_SENSOR = T_WORLD_BASELINKnow * T_BASELINK_SENSOR;
+    T_WORLD_SENSORs[i] = T_WORLD_SENSORs[i] * T_BASELINK_SENSOR;
   }
   return true;
 }
@@ -167,16 +205,85 @@ bool FrameInitializer::GetPose(Eigen::Matrix4d& T_WORLD_SENSOR,
 bool FrameInitializer::GetRelativePose(Eigen::Matrix4d& T_A_B,
                                        const ros::Time& tA, const ros::Time& tB,
                                        std::string& error_msg) {
+  return GetRelativePose(T_A_B, tA, tB, *poses_->Get(), error_msg);
+}
+
+ros::Time FrameInitializer::OdometryEndTime() const {
+  const auto odometry = poses_->Get();
+  return odometry->Empty() ? ros::Time(0) : odometry->EndTime();
+}
+
+void FrameInitializer::WakeWhenAvailable(const ros::Time& time,
+                                         ros::CallbackQueueInterface* queue,
+                                         std::function<void()> callback) {
+  // the callback of the replaced wakeup isn't removed from its queue if it
+  // was already added: requesters may be running it and removing it would
+  // wait for it to return
+  std::lock_guard<std::mutex> lock(wakeup_mutex_);
+  poses_->CancelNotification(wakeup_id_);
+  wakeup_queue_ = queue;
+  // callbacks are added with this as owner so they can be removed on cancel
+  const uint64_t owner_id = reinterpret_cast<uint64_t>(this);
+  wakeup_id_ = poses_->NotifyWhenReached(
+      time, [queue, owner_id, callback = std::move(callback)]() {
+        queue->addCallback(
+            boost::make_shared<fuse_core::CallbackWrapper<void>>(callback),
+            owner_id);
+      });
+}
+
+void FrameInitializer::CancelWakeup() {
+  std::lock_guard<std::mutex> lock(wakeup_mutex_);
+  if (wakeup_queue_ == nullptr) { return; }
+  poses_->CancelNotification(wakeup_id_);
+  wakeup_queue_->removeByID(reinterpret_cast<uint64_t>(this));
+  wakeup_id_ = 0;
+  wakeup_queue_ = nullptr;
+}
+
+bool FrameInitializer::GetT_WORLD_BASELINK(
+    Eigen::Matrix4d& T_WORLD_BASELINK, const ros::Time& time,
+    const bs_common::Trajectory& odometry,
+    const bs_common::Trajectory& graph_path, std::string& error_msg) const {
+  if (graph_path.Empty()) {
+    return odometry.Get(T_WORLD_BASELINK, time, error_msg);
+  }
+
+  // get the graph pose that comes directly before current time (even if its
+  // the end). We assume the graph path is in the baselink frame
+  const bs_common::TrajectoryPose* graph_pose = graph_path.Before(time);
+  if (!graph_pose) {
+    error_msg = "Requested time is before the start of the current graph.";
+    return false;
+  }
+  const Eigen::Matrix4d T_WORLD_BASELINKprev = graph_pose->T();
+  if (graph_pose->stamp == time) {
+    T_WORLD_BASELINK = T_WORLD_BASELINKprev;
+    return true;
+  }
+
+  // compute relative pose between the graph pose and the current time
+  Eigen::Matrix4d T_prev_now;
+  if (!GetRelativePose(T_prev_now, graph_pose->stamp, time, odometry,
+                       error_msg)) {
+    return false;
+  }
+  T_WORLD_BASELINK = T_WORLD_BASELINKprev * T_prev_now;
+  return true;
+}
+
+bool FrameInitializer::GetRelativePose(Eigen::Matrix4d& T_A_B,
+                                       const ros::Time& tA, const ros::Time& tB,
+                                       const bs_common::Trajectory& odometry,
+                                       std::string& error_msg) const {
   // get pose at time a
   std::string error1;
   Eigen::Matrix4d p_WORLD_BASELINKa;
-  const auto A_success =
-      pose_lookup_->GetT_WORLD_BASELINK(p_WORLD_BASELINKa, tA, error1);
+  const auto A_success = odometry.Get(p_WORLD_BASELINKa, tA, error1);
   // get pose at time b
   std::string error2;
   Eigen::Matrix4d T_WORLD_BASELINKB;
-  const auto B_success =
-      pose_lookup_->GetT_WORLD_BASELINK(T_WORLD_BASELINKB, tB, error2);
+  const auto B_success = odometry.Get(T_WORLD_BASELINKB, tB, error2);
 
   if (!A_success || !B_success) {
     error_msg = "\n\tError 1: " + error1 + "\n\tError 2: " + error2;
@@ -230,12 +337,9 @@ void FrameInitializer::OdometryCallback(
 
   // if sensor_frame is already baselink, then we can directly copy
   if (sensor_frame_id_ == extrinsics_.GetBaselinkFrameId()) {
-    geometry_msgs::TransformStamped tf_stamped;
-    bs_common::OdometryMsgToTransformedStamped(
-        *message, message->header.stamp, message->header.seq,
-        extrinsics_.GetWorldFrameId(), extrinsics_.GetBaselinkFrameId(),
-        tf_stamped);
-    poses_->setTransform(tf_stamped, authority_, false);
+    Eigen::Matrix4d T_WORLD_BASELINK;
+    bs_common::OdometryMsgToTransformationMatrix(*message, T_WORLD_BASELINK);
+    poses_->Add(message->header.stamp, T_WORLD_BASELINK);
     return;
   }
 
@@ -249,13 +353,7 @@ void FrameInitializer::OdometryCallback(
     Eigen::Matrix4d T_WORLD_SENSOR = T_WORLD_ORIGINAL * T_ORIGINAL_OVERRIDE_;
 
     Eigen::Matrix4d T_WORLD_BASELINK = T_WORLD_SENSOR * T_SENSOR_BASELINK;
-
-    geometry_msgs::TransformStamped tf_stamped;
-    bs_common::EigenTransformToTransformStampedMsg(
-        T_WORLD_BASELINK, message->header.stamp, message->header.seq,
-        extrinsics_.GetWorldFrameId(), extrinsics_.GetBaselinkFrameId(),
-        tf_stamped);
-    poses_->setTransform(tf_stamped, authority_, false);
+    poses_->Add(message->header.stamp, T_WORLD_BASELINK);
     return;
   } else {
     BEAM_WARN("Skipping odometry message.");
@@ -264,42 +362,59 @@ void FrameInitializer::OdometryCallback(
 }
 
 void FrameInitializer::PathCallback(const nav_msgs::PathConstPtr message) {
-  path_mutex_.lock();
-  graph_path_.clear();
+  bs_common::TrajectoryPoses graph_path;
+  graph_path.reserve(message->poses.size());
   for (const auto& pose : message->poses) {
-    const ros::Time stamp = pose.header.stamp;
     Eigen::Matrix4d T;
     bs_common::PoseMsgToTransformationMatrix(pose, T);
-    graph_path_.insert({stamp, T});
+    graph_path.emplace_back(pose.header.stamp, T);
   }
-  path_mutex_.unlock();
+  graph_path_.Store(bs_common::Trajectory(std::move(graph_path)));
 }
 
 void FrameInitializer::InitializeFromPoseFile(const std::string& file_path) {
-  authority_ = "poses_file";
-
   if (!boost::filesystem::exists(file_path)) {
     BEAM_ERROR("Pose file not found: {}", file_path);
     throw std::invalid_argument{"Pose file not found."};
   }
 
-  beam_mapping::Poses poses_reader;
-  if (!poses_reader.LoadFromFile(file_path)) {
-    BEAM_ERROR(
-        "Invalid file extension for pose file. Options: .json, .txt, .ply");
-    throw std::invalid_argument{"Invalid extensions type."};
+  // binary trajectory files are mapped, text files are parsed
+  bs_common::TrajectoryFile pose_file;
+  if (bs_common::TrajectoryFile::IsTrajectoryFile(file_path)) {
+    if (!pose_file.Load(file_path)) {
+      BEAM_ERROR("Cannot load trajectory file: {}", file_path);
+      throw std::invalid_argument{"Invalid trajectory file."};
+    }
+  } else {
+    beam_mapping::Poses poses_reader;
+    if (!poses_reader.LoadFromFile(file_path)) {
+      BEAM_ERROR("Invalid file extension for pose file. Options: .json, .txt, "
+                 ".ply, or a binary trajectory file");
+      throw std::invalid_argument{"Invalid extensions type."};
+    }
+    const std::vector<Eigen::Matrix4d, beam::AlignMat4d>& transforms =
+        poses_reader.GetPoses();
+    const std::vector<ros::Time>& timestamps = poses_reader.GetTimeStamps();
+    bs_common::TrajectoryPoses poses;
+    poses.reserve(transforms.size());
+    for (int i = 0; i < transforms.size(); i++) {
+      poses.emplace_back(timestamps[i], transforms[i]);
+    }
+    pose_file.fixed_frame = poses_reader.GetFixedFrame();
+    pose_file.moving_frame = poses_reader.GetMovingFrame();
+    pose_file.trajectory = bs_common::Trajectory(std::move(poses));
   }
 
   // check for valid frame ids
-  if (poses_reader.GetFixedFrame() != extrinsics_.GetWorldFrameId()) {
+  if (pose_file.fixed_frame != extrinsics_.GetWorldFrameId()) {
     BEAM_WARN(
         "Fixed frame id in pose file is not consistend with world frame id "
         "from extrinsics. Using world frame from from extrinsics.");
   }
 
-  if (poses_reader.GetMovingFrame() != extrinsics_.GetImuFrameId() &&
-      poses_reader.GetMovingFrame() != extrinsics_.GetCameraFrameId() &&
-      poses_reader.GetMovingFrame() != extrinsics_.GetLidarFrameId()) {
+  if (pose_file.moving_frame != extrinsics_.GetImuFrameId() &&
+      pose_file.moving_frame != extrinsics_.GetCameraFrameId() &&
+      pose_file.moving_frame != extrinsics_.GetLidarFrameId()) {
     BEAM_ERROR(
         "Moving frame id in pose file must be equal to one of the frame ids in "
         "the extrinsics.");
@@ -307,7 +422,7 @@ void FrameInitializer::InitializeFromPoseFile(const std::string& file_path) {
   }
 
   if (!extrinsics_.IsStatic() &&
-      poses_reader.GetMovingFrame() != extrinsics_.GetBaselinkFrameId()) {
+      pose_file.moving_frame != extrinsics_.GetBaselinkFrameId()) {
     BEAM_ERROR(
         "Cannot use pose file with a moving frame that is not equal to the "
         "baselink frame when extrinsics are not static.");
@@ -316,36 +431,28 @@ void FrameInitializer::InitializeFromPoseFile(const std::string& file_path) {
 
   Eigen::Matrix4d T_MOVINGFRAME_BASELINK;
   if (!extrinsics_.GetT_SENSOR_BASELINK(T_MOVINGFRAME_BASELINK,
-                                        poses_reader.GetMovingFrame())) {
+                                        pose_file.moving_frame)) {
     BEAM_ERROR("Cannot lookup extrinsics. Exiting.");
     throw std::runtime_error{"Cannot lookup extrinsics."};
   }
 
-  const std::vector<Eigen::Matrix4d, beam::AlignMat4d>& transforms =
-      poses_reader.GetPoses();
-  const std::vector<ros::Time>& timestamps = poses_reader.GetTimeStamps();
-
-  // create buffer core with cache time slightly larger than the difference
-  // between the min and max timestamps. Also include a minimum
-  int64_t cache_time =
-      1.2 * (timestamps[timestamps.size() - 1].toSec() - timestamps[0].toSec());
-  if (cache_time < 10) { cache_time = 10; }
-
-  std::shared_ptr<tf2::BufferCore> poses =
-      std::make_shared<tf2::BufferCore>(ros::Duration(cache_time));
+  // the whole file is kept, so there is no buffer duration. Poses of the
+  // baselink are used in place, without copying them out of a mapped file
+  poses_ = std::make_unique<bs_common::TrajectoryBuffer>();
+  if (T_MOVINGFRAME_BASELINK.isIdentity()) {
+    poses_->Set(pose_file.trajectory);
+    return;
+  }
 
-  for (int i = 0; i < transforms.size(); i++) {
-    const Eigen::Matrix4d& T_WORLD_MOVINGFRAME = transforms[i];
+  bs_common::TrajectoryPoses poses;
+  poses.reserve(pose_file.trajectory.Size());
+  for (const bs_common::TrajectoryPose& pose : pose_file.trajectory) {
+    const Eigen::Matrix4d T_WORLD_MOVINGFRAME = pose.T();
     Eigen::Matrix4d T_WORLD_BASELINK =
         T_WORLD_MOVINGFRAME * T_MOVINGFRAME_BASELINK;
-    geometry_msgs::TransformStamped tf_stamped;
-    bs_common::EigenTransformToTransformStampedMsg(
-        T_WORLD_BASELINK, timestamps[i], i, extrinsics_.GetWorldFrameId(),
-        extrinsics_.GetBaselinkFrameId(), tf_stamped);
-    poses->setTransform(tf_stamped, authority_, false);
+    poses.emplace_back(pose.stamp, T_WORLD_BASELINK);
   }
-
-  pose_lookup_ = std::make_shared<bs_common::PoseLookup>(poses);
+  poses_->Set(bs_common::Trajectory(std::move(poses)));
 }
 
 } // namespace bs_models
\ No newline at end of file
@@ -1,10 +1,17 @@
 #include <bs_models/global_mapping/global_map.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <ctime>
 #include <filesystem>
+#include <map>
+#include <set>
 
 #include <pcl/conversions.h>
+#include <pcl/io/pcd_io.h>
 
 #include <beam_cv/OpenCVConversions.h>
 #include <beam_cv/descriptors/Descriptor.h>
@@ -17,13 +24,41 @@
 
 #include <bs_common/conversions.h>
 #include <bs_common/graph_access.h>
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_common/packed_cloud.h>
+#include <bs_common/thread_pool.h>
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
+#include <bs_models/global_mapping/map_store.h>
 #include <bs_models/reloc/reloc_methods.h>
+#include <bs_models/vision/camera_measurement_view.h>
 
 namespace bs_models::global_mapping {
 
 using namespace reloc;
 
+namespace {
+
+template <typename PointT>
+bool SavePCD(const std::string& path, const pcl::PointCloud<PointT>& cloud,
+             bool compress) {
+  std::string error_message{};
+  // pcl cannot write empty compressed pcds
+  if (compress && !cloud.empty()) {
+    if (pcl::io::savePCDFileBinaryCompressed(path, cloud) == 0) { return true; }
+    error_message = "cannot write compressed PCD file " + path;
+  } else if (beam::SavePointCloud<PointT>(path, cloud,
+                                          beam::PointCloudFileType::PCDBINARY,
+                                          error_message)) {
+    return true;
+  }
+  BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
+  return false;
+}
+
+} // namespace
+
 void GlobalMap::Params::LoadJson(const std::string& config_path) {
   if (config_path.empty()) {
     BEAM_INFO(
@@ -48,6 +83,49 @@ void GlobalMap::Params::LoadJson(const std::string& config_path) {
   submap_size = J["submap_size_m"];
   disable_loop_closure = J["disable_loop_closure"];
 
+  // optional async loop closure params
+  if (J.contains("async_loop_closure")) {
+    async_loop_closure = J["async_loop_closure"];
+  }
+  if (J.contains("loop_closure_queue_size")) {
+    loop_closure_queue_size = J["loop_closure_queue_size"];
+  }
+  if (J.contains("async_submap_finalization")) {
+    async_submap_finalization = J["async_submap_finalization"];
+  }
+  if (J.contains("compress_lidar_keyframes")) {
+    compress_lidar_keyframes = J["compress_lidar_keyframes"];
+  }
+  if (J.contains("loop_closure_num_threads")) {
+    loop_closure_num_threads = J["loop_closure_num_threads"];
+  }
+  if (J.contains("io_num_threads")) { io_num_threads = J["io_num_threads"]; }
+  if (loop_closure_queue_size < 1 || loop_closure_num_threads < 1 ||
+      io_num_threads < 1) {
+    BEAM_ERROR("loop_closure_queue_size, loop_closure_num_threads and "
+               "io_num_threads must be greater than 0");
+    throw std::runtime_error{"invalid global map config"};
+  }
+
+  // optional keyframe image storage params
+  if (J.contains("keyframe_images")) {
+    keyframe_images.LoadFromJson(J["keyframe_images"]);
+  }
+  if (J.contains("submap_eviction")) {
+    submap_eviction.LoadFromJson(J["submap_eviction"]);
+  }
+  if (J.contains("submap_prefetch")) {
+    submap_prefetch.LoadFromJson(J["submap_prefetch"]);
+  }
+  if (J.contains("adaptive_submaps")) {
+    adaptive_submaps.LoadFromJson(J["adaptive_submaps"]);
+  }
+  if (J.contains("reloc_server")) {
+    reloc_server.LoadFromJson(J["reloc_server"]);
+  }
+  if (J.contains("tile_store")) { tile_store.LoadFromJson(J["tile_store"]); }
+  if (J.contains("map_export")) { map_export.LoadFromJson(J["map_export"]); }
+
   std::string loop_closure_candidate_search_config_rel =
       J["loop_closure_candidate_search_config"];
   if (!loop_closure_candidate_search_config_rel.empty()) {
@@ -98,6 +176,18 @@ void GlobalMap::Params::LoadJson(const std::string& config_path) {
       beam_filtering::LoadFilterParamsVector(J_submap_filters);
   ros_globalmap_filter_params =
       beam_filtering::LoadFilterParamsVector(J_globalmap_filters);
+  ros_submap_filters = FilterPipeline<pcl::PointXYZ>(ros_submap_filter_params);
+  ros_globalmap_filters =
+      FilterPipeline<pcl::PointXYZ>(ros_globalmap_filter_params);
+  // the submap and global maps are built by the finalization worker or the
+  // publishing timer, which must not delay the real-time models
+  ros_submap_filters.SetTaskPriority(bs_common::TaskPriority::BACKGROUND);
+  ros_globalmap_filters.SetTaskPriority(bs_common::TaskPriority::BACKGROUND);
+
+  // optional tiled global map params
+  if (J_publishing.contains("globalmap_tiles")) {
+    ros_globalmap_tiles.LoadFromJson(J_publishing["globalmap_tiles"]);
+  }
 
   config_str = J.dump();
 }
@@ -118,6 +208,20 @@ void GlobalMap::Params::SaveJson(const std::string& filename) {
   } else {
     J = nlohmann::json{
         {"submap_size_m", submap_size},
+        {"disable_loop_closure", disable_loop_closure},
+        {"async_loop_closure", async_loop_closure},
+        {"loop_closure_queue_size", loop_closure_queue_size},
+        {"async_submap_finalization", async_submap_finalization},
+        {"compress_lidar_keyframes", compress_lidar_keyframes},
+        {"loop_closure_num_threads", loop_closure_num_threads},
+        {"io_num_threads", io_num_threads},
+        {"keyframe_images", keyframe_images.ToJson()},
+        {"submap_eviction", submap_eviction.ToJson()},
+        {"submap_prefetch", submap_prefetch.ToJson()},
+        {"adaptive_submaps", adaptive_submaps.ToJson()},
+        {"reloc_server", reloc_server.ToJson()},
+        {"tile_store", tile_store.ToJson()},
+        {"map_export", map_export.ToJson()},
         {"loop_closure_candidate_search_config",
          loop_closure_candidate_search_config_rel},
         {"loop_closure_refinement_config", loop_closure_refinement_config_rel},
@@ -134,6 +238,7 @@ void GlobalMap::Params::SaveJson(const std::string& filename) {
     nlohmann::json J_publishing;
     J_publishing["submap_lidar_filters"] = J_submap_filters;
     J_publishing["globalmap_lidar_filters"] = J_global_filters;
+    J_publishing["globalmap_tiles"] = ros_globalmap_tiles.ToJson();
     J["publishing"] = J_publishing;
   }
 
@@ -141,6 +246,20 @@ void GlobalMap::Params::SaveJson(const std::string& filename) {
   file << std::setw(4) << J << std::endl;
 }
 
+void GlobalMap::Params::ExportParams::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("compress_pcds")) { compress_pcds = J["compress_pcds"]; }
+  if (J.contains("tile_size_m")) { tile_size_m = J["tile_size_m"]; }
+  if (tile_size_m < 0) {
+    BEAM_ERROR("map_export tile_size_m must be 0 (disabled) or positive");
+    throw std::invalid_argument{"invalid map export params"};
+  }
+}
+
+nlohmann::json GlobalMap::Params::ExportParams::ToJson() const {
+  return nlohmann::json{{"compress_pcds", compress_pcds},
+                        {"tile_size_m", tile_size_m}};
+}
+
 GlobalMap::GlobalMap(
     const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
     const std::shared_ptr<bs_common::ExtrinsicsLookupBase>& extrinsics)
@@ -165,14 +284,19 @@ GlobalMap::GlobalMap(
   Setup();
 }
 
-GlobalMap::GlobalMap(const std::string& data_root_directory) {
-  if (!Load(data_root_directory)) {
+GlobalMap::GlobalMap(const std::string& data_root_directory,
+                     bool load_lidar_clouds) {
+  if (!Load(data_root_directory, load_lidar_clouds)) {
     BEAM_ERROR("Unable to load global map data, check data content/formats.");
     throw std::runtime_error{
         "Unable to instantiate GlobalMap with input data."};
   }
 }
 
+GlobalMap::~GlobalMap() {
+  FinishLoopClosures();
+}
+
 std::vector<SubmapPtr> GlobalMap::GetSubmaps() {
   return submaps_;
 }
@@ -181,8 +305,22 @@ GlobalMap::Params& GlobalMap::GetParamsMutable() {
   return params_;
 }
 
+std::shared_ptr<beam_calibration::CameraModel>
+    GlobalMap::GetCameraModel() const {
+  return camera_model_;
+}
+
+std::shared_ptr<bs_common::ExtrinsicsLookupBase>
+    GlobalMap::GetExtrinsics() const {
+  return extrinsics_;
+}
+
 void GlobalMap::SetSubmaps(const std::vector<SubmapPtr>& submaps) {
+  std::unique_lock<std::mutex> lk(submap_poses_mutex_);
   submaps_ = submaps;
+  submap_ids_by_pose_variable_.clear();
+  num_indexed_submaps_ = 0;
+  UpdateSubmapPositionIndex();
 }
 
 void GlobalMap::SetStoreNewSubmaps(bool store_new_submaps) {
@@ -210,14 +348,22 @@ void GlobalMap::SetLoopClosureResultsPath(const std::string& output_path) {
 }
 
 std::vector<std::shared_ptr<RosMap>> GlobalMap::GetRosMaps() {
+  if (ros_global_map_outdated_) {
+    AddRosGlobalMap();
+    ros_global_map_outdated_ = false;
+  }
+
   std::vector<std::shared_ptr<RosMap>> maps_vector;
   while (!ros_new_scans_.empty()) {
     maps_vector.push_back(ros_new_scans_.front());
     ros_new_scans_.pop();
   }
-  while (!ros_submaps_.empty()) {
-    maps_vector.push_back(ros_submaps_.front());
-    ros_submaps_.pop();
+  {
+    std::unique_lock<std::mutex> lk(ros_submaps_mutex_);
+    while (!ros_submaps_.empty()) {
+      maps_vector.push_back(ros_submaps_.front());
+      ros_submaps_.pop();
+    }
   }
   if (ros_global_lidar_map_ != nullptr) {
     maps_vector.push_back(ros_global_lidar_map_);
@@ -227,18 +373,78 @@ std::vector<std::shared_ptr<RosMap>> GlobalMap::GetRosMaps() {
     maps_vector.push_back(ros_global_keypoints_map_);
     ros_global_keypoints_map_ = nullptr;
   }
+  while (!ros_global_map_tiles_.empty()) {
+    maps_vector.push_back(ros_global_map_tiles_.front());
+    ros_global_map_tiles_.pop();
+  }
 
   return maps_vector;
 }
 
 void GlobalMap::Setup() {
+  ros_tiled_map_ = TiledLidarMap(params_.ros_globalmap_tiles);
+  ros_sent_tiles_.clear();
+
+  // the prefetcher leases from the evictor
+  submap_prefetcher_.reset();
+  submap_evictor_ = params_.submap_eviction.enabled
+                        ? std::make_shared<SubmapEvictor>(
+                              params_.submap_eviction)
+                        : nullptr;
+  submap_sizer_ = SubmapSizer(params_.adaptive_submaps);
+  if (params_.submap_prefetch.enabled) {
+    submap_prefetcher_ = std::make_unique<SubmapPrefetcher>(
+        params_.submap_prefetch,
+        [this](const std::vector<SubmapPtr>& submaps, size_t submap_id,
+               size_t& memory_bytes) -> SubmapPrefetcher::Handle {
+          auto lease = std::make_shared<SubmapLease>();
+          if (working_set_) {
+            lease->working_set = working_set_->Acquire({submap_id});
+            memory_bytes = working_set_->SubmapMemory(submap_id);
+          }
+          if (submap_evictor_) {
+            lease->evictor = submap_evictor_->Acquire(submaps, {submap_id});
+            std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+            memory_bytes = 0;
+            for (const auto& [stamp, scan_pose] :
+                 submaps.at(submap_id)->LidarKeyframes()) {
+              memory_bytes += scan_pose.CloudMemoryUsage();
+            }
+          }
+          if (!lease->working_set.Valid() || !lease->evictor.Valid()) {
+            return nullptr;
+          }
+          return lease;
+        });
+  }
+
   // initiate loop_closure candidate search
   loop_closure_candidate_search_ = reloc::RelocCandidateSearchBase::Create(
       params_.loop_closure_candidate_search_config);
-
   // initiate loop_closure refinement
   loop_closure_refinement_ = reloc::RelocRefinementBase::Create(
       params_.loop_closure_refinement_config);
+
+  // each loop closure thread needs its own refinement since the matchers are
+  // not thread safe
+  loop_closure_refinements_.clear();
+  loop_closure_refinements_.push_back(loop_closure_refinement_);
+  for (int i = 1; i < params_.loop_closure_num_threads; i++) {
+    loop_closure_refinements_.push_back(reloc::RelocRefinementBase::Create(
+        params_.loop_closure_refinement_config));
+  }
+
+  reloc_server_ = params_.reloc_server.enabled
+                      ? std::make_shared<RelocServer>(
+                            params_.reloc_server,
+                            params_.loop_closure_candidate_search_config,
+                            params_.loop_closure_refinement_config,
+                            camera_model_, extrinsics_)
+                      : nullptr;
+
+  tile_store_ = params_.tile_store.enabled
+                    ? std::make_shared<SubmapTileStore>(params_.tile_store)
+                    : nullptr;
 }
 
 fuse_core::Transaction::SharedPtr GlobalMap::AddMeasurement(
@@ -246,42 +452,92 @@ fuse_core::Transaction::SharedPtr GlobalMap::AddMeasurement(
     const bs_common::LidarMeasurementMsg& lid_measurement,
     const nav_msgs::Path& traj_measurement,
     const Eigen::Matrix4d& T_WORLD_BASELINK, const ros::Time& stamp) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "global_map/add_measurement");
+  bs_common::ScopedTimer timer(metric);
+
   fuse_core::Transaction::SharedPtr new_transaction = nullptr;
 
   int submap_id = GetSubmapId(T_WORLD_BASELINK);
+  ros_viewpoint_ = T_WORLD_BASELINK.block<3, 1>(0, 3);
 
   // if id is equal to submap size then we need to create a new submap
   if (submap_id == submaps_.size()) {
     SubmapPtr new_submap = std::make_shared<Submap>(stamp, T_WORLD_BASELINK,
                                                     camera_model_, extrinsics_);
+    new_submap->SetKeyframeImageParams(params_.keyframe_images);
+    if (!params_.disable_loop_closure) {
+      loop_closure_candidate_search_->ConfigureSubmap(new_submap);
+    }
     submaps_.push_back(new_submap);
+    submap_sizer_.Reset();
+    {
+      std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+      submap_position_index_->Update(
+          submaps_.size() - 1, new_submap->T_WORLD_SUBMAP().block<3, 1>(0, 3));
+    }
     new_transaction = InitiateNewSubmapPose();
 
-    // Run loop closure on the previously completed submap. Current submap is
-    // size -1, therefore the last is size - 2
-    fuse_core::Transaction::SharedPtr loop_closure_transaction =
-        RunLoopClosure(submaps_.size() - 2);
+    // Finalize the previously completed submap. Current submap is size -1,
+    // therefore the last is size - 2
+    const int completed_id = submaps_.size() - 2;
+    const bool add_ros_submap =
+        store_newly_completed_submaps_ && submaps_.size() > 1;
+    bool queued = false;
+    if (params_.async_submap_finalization) {
+      queued = QueueSubmapFinalization(completed_id, add_ros_submap, true);
+    } else {
+      // build the ros submap before a job can compress it
+      if (add_ros_submap) {
+        AddRosSubmap(submaps_.at(completed_id), completed_id);
+      }
+
+      if (params_.async_loop_closure) {
+        queued = QueueSubmapFinalization(completed_id, false, true);
+      } else {
+        fuse_core::Transaction::SharedPtr loop_closure_transaction =
+            RunLoopClosure(completed_id);
+
+        if (loop_closure_transaction != nullptr) {
+          new_transaction->merge(*loop_closure_transaction);
+        }
+      }
+    }
 
-    if (loop_closure_transaction != nullptr) {
-      new_transaction->merge(*loop_closure_transaction);
+    // a queued job finishes the submap once its loop closure is done
+    if (!queued && completed_id >= 0) {
+      FinishSubmap(completed_id, submaps_.at(completed_id));
     }
 
-    if (store_newly_completed_submaps_ && submaps_.size() > 1) {
-      AddRosSubmap(submaps_.size() - 2);
+    // submaps loaded from a map store are already paged by the working set.
+    // Submaps still used by a finalization job are leased by the job
+    if (submap_evictor_ && !map_store_) {
+      submap_evictor_->Update(submaps_, submaps_.size() - 1,
+                              T_WORLD_BASELINK.block<3, 1>(0, 3));
     }
   }
+  UpdatePrefetch(T_WORLD_BASELINK.block<3, 1>(0, 3), stamp);
 
   // add camera measurement if not empty
-  if (!cam_measurement.landmarks.empty()) {
+  const vision::CameraMeasurementView cam_view(cam_measurement);
+  if (!cam_view.Empty()) {
     ROS_DEBUG("Adding camera measurement to global map.");
     submaps_.at(submap_id)->AddCameraMeasurement(cam_measurement,
                                                  T_WORLD_BASELINK);
   }
 
+  // unpack lidar measurement
+  PointCloud cloud;
+  beam_matching::LoamPointCloud loamCloud;
+  UnpackLidarMeasurement(lid_measurement, cloud, loamCloud);
+  const size_t loam_size = loamCloud.edges.strong.cloud.size() +
+                           loamCloud.edges.weak.cloud.size() +
+                           loamCloud.surfaces.strong.cloud.size() +
+                           loamCloud.surfaces.weak.cloud.size();
+
   // if lidar measurement exists, check frame id
-  if (!lid_measurement.lidar_points.empty() ||
-      !lid_measurement.lidar_edges_strong.empty() ||
-      !lid_measurement.lidar_surfaces_strong.empty()) {
+  if (!cloud.empty() || loam_size > 0) {
     if (lid_measurement.frame_id != extrinsics_->GetLidarFrameId()) {
       BEAM_WARN(
           "Lidar measurement frame id not consistent with lidar frame in the "
@@ -290,33 +546,20 @@ fuse_core::Transaction::SharedPtr GlobalMap::AddMeasurement(
   }
 
   // add lidar measurement if not empty
-  // ROS_DEBUG("Adding lidar measurement to global map.");
-  PointCloud cloud;
-  if (!lid_measurement.lidar_points.empty()) {
-    cloud = beam::ROSVectorToPCL(lid_measurement.lidar_points);
-
+  if (!cloud.empty()) {
     // add ros msg if applicable
     if (store_new_scans_) { AddNewRosScan(cloud, T_WORLD_BASELINK, stamp); }
 
     submaps_.at(submap_id)->AddLidarMeasurement(cloud, T_WORLD_BASELINK, stamp);
   }
-  if (lid_measurement.lidar_edges_strong.size() +
-          lid_measurement.lidar_edges_strong.size() +
-          lid_measurement.lidar_surfaces_strong.size() +
-          lid_measurement.lidar_surfaces_weak.size() >
-      0) {
-    beam_matching::LoamPointCloud loamCloud;
-    loamCloud.edges.strong.cloud =
-        beam::ROSVectorToPCLIRT(lid_measurement.lidar_edges_strong);
-    loamCloud.edges.weak.cloud =
-        beam::ROSVectorToPCLIRT(lid_measurement.lidar_edges_weak);
-    loamCloud.surfaces.strong.cloud =
-        beam::ROSVectorToPCLIRT(lid_measurement.lidar_surfaces_strong);
-    loamCloud.surfaces.weak.cloud =
-        beam::ROSVectorToPCLIRT(lid_measurement.lidar_surfaces_weak);
+  if (loam_size > 0) {
     submaps_.at(submap_id)->AddLidarMeasurement(loamCloud, T_WORLD_BASELINK,
                                                 stamp);
   }
+  if (!cloud.empty() || loam_size > 0) { UpdateMemoryAccount(); }
+  const size_t num_keyframes =
+      (!cloud.empty() || loam_size > 0 ? 1 : 0) + (cam_view.Empty() ? 0 : 1);
+  submap_sizer_.Add(cloud.size() + loam_size, cam_view.Size(), num_keyframes);
 
   // add trajectory measurement if not empty
   if (!traj_measurement.poses.empty()) {
@@ -331,9 +574,73 @@ fuse_core::Transaction::SharedPtr GlobalMap::AddMeasurement(
     }
   }
 
+  // add any loop closures that were completed in the background
+  if (params_.async_loop_closure || params_.async_submap_finalization) {
+    fuse_core::Transaction::SharedPtr loop_closure_transaction =
+        GetCompletedLoopClosures();
+    if (loop_closure_transaction != nullptr) {
+      if (new_transaction == nullptr) {
+        new_transaction = loop_closure_transaction;
+      } else {
+        new_transaction->merge(*loop_closure_transaction);
+      }
+    }
+  }
+
   return new_transaction;
 }
 
+void GlobalMap::UnpackLidarMeasurement(
+    const bs_common::LidarMeasurementMsg& lid_measurement, PointCloud& cloud,
+    beam_matching::LoamPointCloud& loam_cloud) {
+  if (lid_measurement.packed) {
+    bs_common::PackedXYZMsgToPCL(lid_measurement.lidar_points_packed, cloud);
+    bs_common::PackedXYZMsgToPCL(lid_measurement.lidar_edges_strong_packed,
+                                 loam_cloud.edges.strong.cloud);
+    bs_common::PackedXYZMsgToPCL(lid_measurement.lidar_edges_weak_packed,
+                                 loam_cloud.edges.weak.cloud);
+    bs_common::PackedXYZMsgToPCL(lid_measurement.lidar_surfaces_strong_packed,
+                                 loam_cloud.surfaces.strong.cloud);
+    bs_common::PackedXYZMsgToPCL(lid_measurement.lidar_surfaces_weak_packed,
+                                 loam_cloud.surfaces.weak.cloud);
+  } else {
+    if (!lid_measurement.lidar_points.empty()) {
+      cloud = beam::ROSVectorToPCL(lid_measurement.lidar_points);
+    }
+    loam_cloud.edges.strong.cloud =
+        beam::ROSVectorToPCLIRT(lid_measurement.lidar_edges_strong);
+    loam_cloud.edges.weak.cloud =
+        beam::ROSVectorToPCLIRT(lid_measurement.lidar_edges_weak);
+    loam_cloud.surfaces.strong.cloud =
+        beam::ROSVectorToPCLIRT(lid_measurement.lidar_surfaces_strong);
+    loam_cloud.surfaces.weak.cloud =
+        beam::ROSVectorToPCLIRT(lid_measurement.lidar_surfaces_weak);
+  }
+}
+
+void GlobalMap::UpdateMemoryAccount() {
+  static bs_common::MemoryAccount& account =
+      bs_common::MemoryAccounting::GetInstance().GetAccount(
+          "global_map/submaps");
+  auto update = [this]() {
+    uint64_t num_keyframes{0};
+    uint64_t bytes{0};
+    for (const auto& submap : submaps_) {
+      for (const auto& [stamp, scan_pose] : submap->LidarKeyframes()) {
+        bytes += scan_pose.CloudMemoryUsage();
+      }
+      num_keyframes += submap->LidarKeyframes().size();
+    }
+    account.Update(num_keyframes, bytes);
+  };
+
+  update();
+  if (!submap_evictor_ || map_store_) { return; }
+  while (account.OverBudget() && submap_evictor_->EvictLeastRecentlyUsed()) {
+    update();
+  }
+}
+
 int GlobalMap::GetSubmapId(const Eigen::Matrix4d& T_WORLD_BASELINK) {
   // check if current pose is within "submap_size" from previous submap, or
   // current submap. We prioritize the previous submap for the case where data
@@ -347,7 +654,8 @@ int GlobalMap::GetSubmapId(const Eigen::Matrix4d& T_WORLD_BASELINK) {
   Eigen::Vector3d t_WORLD_SUBMAPCUR =
       submaps_.at(cur_submap_id)->T_WORLD_SUBMAP_INIT().block(0, 3, 3, 1);
 
-  if ((t_WORLD_FRAME - t_WORLD_SUBMAPCUR).norm() < params_.submap_size) {
+  if (!submap_sizer_.StartNewSubmap((t_WORLD_FRAME - t_WORLD_SUBMAPCUR).norm(),
+                                    params_.submap_size)) {
     return cur_submap_id;
   } else {
     return cur_submap_id + 1;
@@ -389,35 +697,94 @@ fuse_core::Transaction::SharedPtr GlobalMap::InitiateNewSubmapPose() {
 }
 
 fuse_core::Transaction::SharedPtr GlobalMap::RunLoopClosure(int query_index) {
+  return RunLoopClosure(submaps_, query_index, false);
+}
+
+fuse_core::Transaction::SharedPtr
+    GlobalMap::RunLoopClosure(const std::vector<SubmapPtr>& submaps,
+                              int query_index, bool snapshot_submaps) {
   if (params_.disable_loop_closure) { return nullptr; }
 
   // if first submap, don't look for loop_closures
-  if (submaps_.size() < 2) { return nullptr; }
+  if (submaps.size() < 2) { return nullptr; }
 
   int ignore_last_n_submaps;
   if (query_index == -1) {
     // this means we run on the last submap.
-    query_index = submaps_.size() - 1;
+    query_index = submaps.size() - 1;
     // Therefore ignore last and previous to last
     ignore_last_n_submaps = 2;
   } else {
     // ignore submap before, after and at the query index
-    ignore_last_n_submaps = submaps_.size() - query_index + 1;
+    ignore_last_n_submaps = submaps.size() - query_index + 1;
   }
 
   ROS_DEBUG("Searching for loop closure candidates");
 
   std::vector<int> matched_indices;
   std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
+  std::vector<SubmapPtr> matched_submaps;
+  SubmapPtr query_submap;
+
+  // snapshot the poses and the position index, so that the search and the
+  // copies below don't block the pose updates of the main thread. The submaps
+  // themselves can be read without the lock
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_WORLD_SUBMAP;
+  {
+    std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+    if (snapshot_submaps) {
+      Ts_WORLD_SUBMAP.reserve(submaps.size());
+      for (const auto& submap : submaps) {
+        Ts_WORLD_SUBMAP.push_back(submap->T_WORLD_SUBMAP());
+      }
+    }
+    loop_closure_candidate_search_->SetSubmapPositionIndex(
+        std::make_shared<SubmapPositionIndex>(*submap_position_index_));
+  }
+
+  // reload the evicted submaps for searches that read their clouds
+  SubmapEvictor::Lease search_lease;
+  if (submap_evictor_ && loop_closure_candidate_search_->UsesLidarClouds()) {
+    std::vector<size_t> search_ids{static_cast<size_t>(query_index)};
+    for (size_t i = 0; i + ignore_last_n_submaps < submaps.size(); i++) {
+      search_ids.push_back(i);
+    }
+    search_lease = submap_evictor_->Acquire(submaps, search_ids);
+  }
+
   // ignore the current empty submap, and the last full submap (the query)
   loop_closure_candidate_search_->FindRelocCandidates(
-      submaps_, submaps_.at(query_index), matched_indices, Ts_MATCH_QUERY,
+      submaps, submaps.at(query_index), matched_indices, Ts_MATCH_QUERY,
       ignore_last_n_submaps, lc_results_path_candidate_search_);
+  if (matched_indices.size() == 0) { return nullptr; }
+
+  // keep the query and candidates loaded until they are refined
+  SubmapEvictor::Lease refinement_lease;
+  if (submap_evictor_) {
+    std::vector<size_t> refinement_ids{static_cast<size_t>(query_index)};
+    refinement_ids.insert(refinement_ids.end(), matched_indices.begin(),
+                          matched_indices.end());
+    refinement_lease = submap_evictor_->Acquire(submaps, refinement_ids);
+  }
+  search_lease = SubmapEvictor::Lease();
+
+  // copy submaps if needed, with the snapshot poses so that the query and
+  // candidates have a consistent set of poses
+  auto get_submap = [&](int id) {
+    if (!snapshot_submaps) { return submaps.at(id); }
+    auto copy = std::make_shared<Submap>(*submaps.at(id));
+    copy->UpdatePose(Ts_WORLD_SUBMAP.at(id));
+    return copy;
+  };
+  query_submap = get_submap(query_index);
+  for (const auto& id : matched_indices) {
+    matched_submaps.push_back(get_submap(id));
+  }
+
   std::string candidates;
   for (const auto& id : matched_indices) {
     candidates += std::to_string(id) + " ";
   }
-  if (matched_indices.size() == 0) { return nullptr; }
 
   ROS_INFO(
       "Found %zu loop closure candidates for query index %d. Candidates: %s",
@@ -426,30 +793,46 @@ fuse_core::Transaction::SharedPtr GlobalMap::RunLoopClosure(int query_index) {
   ROS_DEBUG("Matched index[0]: %d, Query Index: %d, No. or submaps: %zu. "
             "Running loop "
             "closure refinement",
-            matched_indices.at(0), query_index, submaps_.size());
+            matched_indices.at(0), query_index, submaps.size());
+
+  // refine candidates, split across all refinement objects
+  std::vector<RelocRefinementResults> results(matched_indices.size());
+  auto refine = [&](int thread_id) {
+    for (int i = thread_id; i < matched_indices.size();
+         i += loop_closure_refinements_.size()) {
+      if (matched_indices[i] >= query_index - 1) {
+        BEAM_ERROR("Error in candidate search implementation, please fix!");
+        continue;
+      }
+      results[i] = loop_closure_refinements_[thread_id]->RunRefinement(
+          matched_submaps[i], query_submap, Ts_MATCH_QUERY[i],
+          lc_results_path_refinement_);
+    }
+  };
+  if (loop_closure_refinements_.size() == 1 || matched_indices.size() == 1) {
+    refine(0);
+  } else {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < loop_closure_refinements_.size(); t++) {
+      threads.emplace_back(refine, t);
+    }
+    for (auto& thread : threads) { thread.join(); }
+  }
 
+  // merge results in the same order as the candidates
   fuse_core::Transaction::SharedPtr transaction =
       std::make_shared<fuse_core::Transaction>();
   for (int i = 0; i < matched_indices.size(); i++) {
-    if (matched_indices[i] >= query_index - 1) {
-      BEAM_ERROR("Error in candidate search implementation, please fix!");
-      continue;
-    }
-
-    const auto& matched_submap = submaps_.at(matched_indices[i]);
-    const auto& query_submap = submaps_.at(query_index);
-    RelocRefinementResults results = loop_closure_refinement_->RunRefinement(
-        matched_submap, query_submap, Ts_MATCH_QUERY[i],
-        lc_results_path_refinement_);
-
-    if (!results.successful) { continue; }
+    if (!results[i].successful) { continue; }
 
+    const auto& matched_submap = matched_submaps[i];
     bs_constraints::Pose3DStampedTransaction new_transaction(
         query_submap->Stamp());
     new_transaction.AddPoseConstraint(
         matched_submap->Position(), query_submap->Position(),
         matched_submap->Orientation(), query_submap->Orientation(),
-        bs_common::TransformMatrixToVectorWithQuaternion(results.T_MATCH_QUERY),
+        bs_common::TransformMatrixToVectorWithQuaternion(
+            results[i].T_MATCH_QUERY),
         params_.loop_closure_covariance, "GlobalMap::RunLoopClosure");
 
     transaction->merge(*(new_transaction.GetTransaction()));
@@ -460,20 +843,215 @@ fuse_core::Transaction::SharedPtr GlobalMap::RunLoopClosure(int query_index) {
   return transaction;
 }
 
+bool GlobalMap::QueueSubmapFinalization(int submap_id, bool add_ros_submap,
+                                        bool run_loop_closure) {
+  run_loop_closure =
+      run_loop_closure && !params_.disable_loop_closure && submap_id >= 1;
+  const bool finish_submap =
+      params_.async_submap_finalization &&
+      (params_.compress_lidar_keyframes || reloc_server_ || tile_store_);
+  if (submap_id < 0 ||
+      (!add_ros_submap && !run_loop_closure && !finish_submap)) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lk(finalization_jobs_mutex_);
+  if (!finalization_thread_.joinable()) {
+    stop_finalization_worker_ = false;
+    finalization_thread_ =
+        std::thread(&GlobalMap::SubmapFinalizationWorker, this);
+  }
+
+  // drop the oldest loop closures if the worker can't keep up. The jobs are
+  // kept without the loop closure, since they still have to finish their
+  // submap
+  if (run_loop_closure) {
+    int num_loop_closures = 0;
+    for (const auto& job : finalization_jobs_) {
+      if (job.run_loop_closure) { num_loop_closures++; }
+    }
+    for (auto it = finalization_jobs_.begin();
+         it != finalization_jobs_.end() &&
+         num_loop_closures >= params_.loop_closure_queue_size;) {
+      if (!it->run_loop_closure) {
+        it++;
+        continue;
+      }
+      BEAM_WARN("Loop closure queue full, dropping stale job for submap {}",
+                it->submap_id);
+      num_loop_closures--;
+      it->run_loop_closure = false;
+      it++;
+    }
+  }
+
+  // copy the submap pointers so that new submaps don't affect this job. The
+  // completed submap itself no longer receives measurements
+  SubmapEvictor::Lease lease;
+  if (submap_evictor_) {
+    lease =
+        submap_evictor_->Acquire(submaps_, {static_cast<size_t>(submap_id)});
+  }
+  finalization_jobs_.push_back(FinalizationJob{
+      submap_id, submaps_, add_ros_submap, run_loop_closure, std::move(lease)});
+  lk.unlock();
+  finalization_jobs_cv_.notify_one();
+  return true;
+}
+
+void GlobalMap::SubmapFinalizationWorker() {
+  while (true) {
+    FinalizationJob job;
+    {
+      std::unique_lock<std::mutex> lk(finalization_jobs_mutex_);
+      finalization_jobs_cv_.wait(lk, [this] {
+        return stop_finalization_worker_ || !finalization_jobs_.empty();
+      });
+      // only stop once all pending jobs are processed
+      if (finalization_jobs_.empty()) { return; }
+      job = std::move(finalization_jobs_.front());
+      finalization_jobs_.pop_front();
+    }
+
+    const SubmapPtr& submap = job.submaps.at(job.submap_id);
+
+    // compute the descriptors first, so they are ready for later queries even
+    // if the loop closure of this submap is dropped
+    if (params_.async_submap_finalization && !params_.disable_loop_closure) {
+      static bs_common::Metric& metric =
+          bs_common::Instrumentation::GetInstance().GetMetric(
+              "global_map/prepare_submap");
+      bs_common::ScopedTimer timer(metric);
+      loop_closure_candidate_search_->PrepareSubmap(submap);
+    }
+
+    if (job.add_ros_submap) {
+      static bs_common::Metric& metric =
+          bs_common::Instrumentation::GetInstance().GetMetric(
+              "global_map/add_ros_submap");
+      bs_common::ScopedTimer timer(metric);
+      AddRosSubmap(submap, job.submap_id);
+    }
+
+    if (job.run_loop_closure) {
+      fuse_core::Transaction::SharedPtr transaction =
+          RunLoopClosure(job.submaps, job.submap_id, true);
+      if (transaction != nullptr &&
+          bs_common::GetNumberOfConstraints(transaction) > 0) {
+        std::unique_lock<std::mutex> lk(completed_loop_closures_mutex_);
+        completed_loop_closures_.push(transaction);
+      }
+    }
+
+    // compress last so the stages above don't need to decode the clouds. The
+    // job's lease keeps the clouds loaded until the copy is made
+    FinishSubmap(job.submap_id, submap);
+  }
+}
+
+void GlobalMap::FinishSubmap(int submap_id, const SubmapPtr& submap) {
+  // copy before the submap can be evicted, the copy keeps its clouds
+  SubmapPtr completed_copy;
+  {
+    std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+    if (params_.compress_lidar_keyframes) { submap->CompressLidarKeyframes(); }
+    if (reloc_server_ || tile_store_) {
+      completed_copy = std::make_shared<Submap>(*submap);
+    }
+  }
+  if (reloc_server_ && completed_copy) {
+    reloc_server_->AddSubmap(submap_id, completed_copy);
+  }
+  if (tile_store_ && completed_copy) {
+    tile_store_->Push(submap_id, completed_copy);
+  }
+}
+
+fuse_core::Transaction::SharedPtr GlobalMap::GetCompletedLoopClosures() {
+  std::unique_lock<std::mutex> lk(completed_loop_closures_mutex_);
+  if (completed_loop_closures_.empty()) { return nullptr; }
+
+  fuse_core::Transaction::SharedPtr transaction =
+      std::make_shared<fuse_core::Transaction>();
+  while (!completed_loop_closures_.empty()) {
+    transaction->merge(*completed_loop_closures_.front());
+    completed_loop_closures_.pop();
+  }
+  return transaction;
+}
+
+void GlobalMap::FinishLoopClosures() {
+  {
+    std::unique_lock<std::mutex> lk(finalization_jobs_mutex_);
+    if (!finalization_thread_.joinable()) { return; }
+    stop_finalization_worker_ = true;
+  }
+  finalization_jobs_cv_.notify_one();
+  finalization_thread_.join();
+}
+
 void GlobalMap::UpdateSubmapPoses(fuse_core::Graph::ConstSharedPtr graph_msg,
                                   const ros::Time& update_time) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "global_map/update_submap_poses");
+  bs_common::ScopedTimer timer(metric);
   last_update_time_ = update_time;
 
-  for (uint16_t i = 0; i < submaps_.size(); i++) {
-    submaps_.at(i)->UpdatePose(graph_msg);
+  bool submaps_moved = false;
+  {
+    std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+    const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(*graph_msg);
+    if (!delta) {
+      for (uint16_t i = 0; i < submaps_.size(); i++) {
+        submaps_moved |= submaps_.at(i)->UpdatePose(graph_msg);
+      }
+      UpdateSubmapPositionIndex();
+    } else {
+      // only the submaps with a pose variable in the delta can have moved
+      IndexSubmapPoseVariables();
+      std::set<uint16_t> submap_ids;
+      for (const auto* variables :
+           {&delta->added_variables, &delta->changed_variables}) {
+        for (const fuse_core::UUID& uuid : *variables) {
+          auto iter = submap_ids_by_pose_variable_.find(uuid);
+          if (iter != submap_ids_by_pose_variable_.end()) {
+            submap_ids.insert(iter->second);
+          }
+        }
+      }
+      for (const uint16_t i : submap_ids) {
+        if (!submaps_.at(i)->UpdatePose(graph_msg)) { continue; }
+        submap_position_index_->Update(
+            i, submaps_.at(i)->T_WORLD_SUBMAP().block<3, 1>(0, 3));
+        submaps_moved = true;
+      }
+    }
   }
 
-  if (store_updated_global_map_) { AddRosGlobalMap(); }
+  if (reloc_server_ && submaps_moved) {
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_WORLD_SUBMAP;
+    {
+      std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+      Ts_WORLD_SUBMAP.reserve(submaps_.size());
+      for (const auto& submap : submaps_) {
+        Ts_WORLD_SUBMAP.push_back(submap->T_WORLD_SUBMAP());
+      }
+    }
+    reloc_server_->UpdateSubmapPoses(Ts_WORLD_SUBMAP);
+  }
+
+  // the global map is rebuilt once when the ROS maps are retrieved, instead
+  // of on every update
+  if (store_updated_global_map_ && submaps_moved) {
+    ros_global_map_outdated_ = true;
+  }
 
   global_map_updates_++;
 }
 
-void GlobalMap::SaveData(const std::string& output_path) {
+void GlobalMap::SaveData(const std::string& output_path,
+                         bool use_map_store) {
   if (!std::filesystem::exists(output_path)) {
     BEAM_ERROR(
         "Global map output path does not exist, not saving map. Input: {}",
@@ -489,16 +1067,46 @@ void GlobalMap::SaveData(const std::string& output_path) {
       beam::CombinePaths(output_path, "extrinsics.json"));
   extrinsics_->SaveFrameIdsToJson(
       beam::CombinePaths(output_path, "frame_ids.json"));
-  for (uint16_t i = 0; i < submaps_.size(); i++) {
+  if (use_map_store) {
+    const std::string store_path =
+        beam::CombinePaths(output_path, kMapStoreFilename);
+    // the clouds are paged in from the loaded store, which cannot be replaced
+    // while it is mapped
+    if (map_store_ && std::filesystem::exists(store_path) &&
+        std::filesystem::equivalent(store_path, map_store_path_)) {
+      BEAM_ERROR("Cannot save global map over the map store it is loaded "
+                 "from: {}",
+                 store_path);
+      return;
+    }
+    bs_common::ChunkFileWriter writer;
+    if (!writer.Open(store_path, kMapStoreVersion)) { return; }
+    // submaps are serialized in parallel, the writer orders its index
+    const bool success =
+        ForEachSubmapParallel(submaps_.size(), "Saved", [&](size_t i) {
+          SubmapLease lease = LeaseSubmap(i);
+          return lease.Valid() && submaps_.at(i)->SaveData(writer, i);
+        });
+    if (!writer.Close() || !success) {
+      BEAM_ERROR("Cannot save submaps to map store: {}", store_path);
+      return;
+    }
+    BEAM_INFO("Done saving global map.");
+    return;
+  }
+  ForEachSubmapParallel(submaps_.size(), "Saved", [&](size_t i) {
     std::string submap_dir =
         beam::CombinePaths(output_path, "submap" + std::to_string(i));
     std::filesystem::create_directory(submap_dir);
+    SubmapLease lease = LeaseSubmap(i);
     submaps_.at(i)->SaveData(submap_dir);
-  }
+    return lease.Valid();
+  });
   BEAM_INFO("Done saving global map.");
 }
 
-bool GlobalMap::Load(const std::string& root_directory) {
+bool GlobalMap::Load(const std::string& root_directory,
+                     bool load_lidar_clouds) {
   if (!std::filesystem::exists(root_directory)) {
     BEAM_ERROR(
         "Global map root directory path does not exist, not loading map. "
@@ -544,18 +1152,39 @@ bool GlobalMap::Load(const std::string& root_directory) {
   // setup general stuff
   Setup();
 
+  const std::string store_path =
+      beam::CombinePaths(root_directory, kMapStoreFilename);
+  if (std::filesystem::exists(store_path)) {
+    return LoadMapStore(store_path, load_lidar_clouds);
+  }
+  if (!load_lidar_clouds) {
+    BEAM_ERROR("Global map has no map store, cannot load it without lidar "
+               "clouds. Save it with the map store first. Input: {}",
+               root_directory);
+    return false;
+  }
+
   int submap_num = 0;
-  while (true) {
-    std::string submap_dir = beam::CombinePaths(
-        root_directory, "submap" + std::to_string(submap_num));
-    if (!std::filesystem::exists(submap_dir)) { break; }
+  while (std::filesystem::exists(beam::CombinePaths(
+      root_directory, "submap" + std::to_string(submap_num)))) {
+    submap_num++;
+  }
 
-    SubmapPtr current_submap = std::make_shared<Submap>(
+  // load in parallel, each into its own slot so the order is kept
+  std::vector<SubmapPtr> submaps(submap_num);
+  ForEachSubmapParallel(submap_num, "Loaded", [&](size_t i) {
+    std::string submap_dir =
+        beam::CombinePaths(root_directory, "submap" + std::to_string(i));
+    submaps[i] = std::make_shared<Submap>(
         ros::Time(0), Eigen::Matrix4d::Identity(), camera_model_, extrinsics_);
     BEAM_INFO("Loading submap from: {}", submap_dir);
-    current_submap->LoadData(submap_dir, false);
-    submaps_.push_back(current_submap);
-    submap_num++;
+    submaps[i]->LoadData(submap_dir, false);
+    return true;
+  });
+  {
+    std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+    submaps_.insert(submaps_.end(), submaps.begin(), submaps.end());
+    UpdateSubmapPositionIndex();
   }
 
   if (submap_num == 0) {
@@ -567,69 +1196,256 @@ bool GlobalMap::Load(const std::string& root_directory) {
   }
 }
 
-void GlobalMap::SaveLidarSubmaps(const std::string& output_path,
-                                 bool save_initial) {
-  if (!std::filesystem::exists(output_path)) {
-    BEAM_ERROR("Invalid output path, not saving submaps. Input: {}",
-               output_path);
-    return;
+bool GlobalMap::LoadMapStore(const std::string& store_path,
+                             bool load_lidar_clouds) {
+  BEAM_INFO("Loading submaps from map store: {}", store_path);
+  auto store = std::make_shared<bs_common::ChunkFileReader>();
+  const bs_common::ChunkFileReader& reader = *store;
+  if (!store->Open(store_path)) { return false; }
+  if (reader.Version() > kMapStoreVersion) {
+    BEAM_ERROR("Map store version {} is newer than the supported version {}, "
+               "not loading GlobalMap.",
+               reader.Version(), kMapStoreVersion);
+    return false;
   }
 
-  // save optimized submap
-  std::string submaps_path =
-      beam::CombinePaths(output_path, "lidar_submaps_optimized");
-  std::filesystem::create_directory(submaps_path);
-  for (int i = 0; i < submaps_.size(); i++) {
-    std::string submap_path = beam::CombinePaths(
-        submaps_path, "lidar_submap" + std::to_string(i) + ".pcd");
-    submaps_.at(i)->SaveLidarMapInWorldFrame(submap_path, max_output_map_size_);
+  const auto submap_chunks =
+      reader.Chunks(static_cast<uint32_t>(MapChunkType::SUBMAP));
+  for (uint16_t i = 0; i < submap_chunks.size(); i++) {
+    if (submap_chunks.at(i).id != MapChunkId(i)) {
+      BEAM_ERROR("Submap {} missing from map store, not loading GlobalMap.",
+                 i);
+      return false;
+    }
   }
-  // save combined
+
+  // the reader is not modified while reading, so submaps are loaded in
+  // parallel, each into its own slot so the order is kept
+  std::vector<SubmapPtr> submaps(submap_chunks.size());
+  if (!ForEachSubmapParallel(submaps.size(), "Loaded", [&](size_t i) {
+        submaps[i] = std::make_shared<Submap>(ros::Time(0),
+                                              Eigen::Matrix4d::Identity(),
+                                              camera_model_, extrinsics_);
+        return submaps[i]->LoadData(reader, i, load_lidar_clouds);
+      })) {
+    return false;
+  }
+  if (!load_lidar_clouds) {
+    map_store_ = store;
+    map_store_path_ = store_path;
+  }
+  {
+    std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+    submaps_.insert(submaps_.end(), submaps.begin(), submaps.end());
+    UpdateSubmapPositionIndex();
+  }
+
+  if (submaps_.empty()) {
+    BEAM_ERROR("No submaps loaded, map store empty.");
+    return false;
+  }
+  BEAM_INFO("Done loading global map. Loaded {} submaps.", submaps_.size());
+  return true;
+}
+
+std::shared_ptr<RelocServer> GlobalMap::GetRelocServer() const {
+  return reloc_server_;
+}
+
+std::shared_ptr<SubmapTileStore> GlobalMap::GetTileStore() const {
+  return tile_store_;
+}
+
+std::shared_ptr<const bs_common::ChunkFileReader> GlobalMap::MapStore() const {
+  return map_store_;
+}
+
+void GlobalMap::SetWorkingSet(
+    const std::shared_ptr<SubmapWorkingSet>& working_set) {
+  if (working_set && working_set->Size() != submaps_.size()) {
+    BEAM_ERROR("Working set has {} submaps, global map has {}",
+               working_set->Size(), submaps_.size());
+    throw std::invalid_argument{"invalid working set"};
+  }
+  working_set_ = working_set;
+}
+
+void GlobalMap::UpdatePrefetch(const Eigen::Vector3d& t_WORLD_BASELINK,
+                               const ros::Time& stamp) {
+  if (!submap_prefetcher_ || submaps_.empty()) { return; }
+  const std::vector<Eigen::Vector3d> path =
+      submap_prefetcher_->PredictPath(t_WORLD_BASELINK, stamp);
+
+  // submaps in the order the path reaches them. The last submap is the one
+  // being built when mapping, which is never paged out
+  const size_t num_completed = map_store_ ? submaps_.size()
+                                          : submaps_.size() - 1;
+  std::vector<size_t> submap_ids;
   {
-    PointCloud map;
-    for (int i = 0; i < submaps_.size(); i++) {
-      map += submaps_.at(i)->GetLidarPointsInWorldFrameCombined(false);
+    std::unique_lock<std::mutex> lk(submap_poses_mutex_);
+    for (const Eigen::Vector3d& point : path) {
+      for (const size_t id : submap_position_index_->Radius(
+               point, params_.submap_prefetch.radius_m, num_completed)) {
+        if (std::find(submap_ids.begin(), submap_ids.end(), id) ==
+            submap_ids.end()) {
+          submap_ids.push_back(id);
+        }
+      }
     }
-    std::string submaps_combined_path =
-        beam::CombinePaths(submaps_path, "submaps_combined.pcd");
-    BEAM_INFO("Saving combined lidar submap of size {} to: {}", map.size(),
-              submaps_combined_path);
-    std::string error_message{};
-    if (!beam::SavePointCloud<pcl::PointXYZ>(
-            submaps_combined_path, map, beam::PointCloudFileType::PCDBINARY,
-            error_message)) {
-      BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
+  }
+  submap_prefetcher_->Request(submaps_, submap_ids);
+}
+
+void GlobalMap::SetPlannedPath(const std::vector<Eigen::Vector3d>& path) {
+  if (submap_prefetcher_) { submap_prefetcher_->SetPlannedPath(path); }
+}
+
+GlobalMap::SubmapLease GlobalMap::LeaseSubmap(size_t submap_id) const {
+  SubmapLease lease;
+  if (working_set_) { lease.working_set = working_set_->Acquire({submap_id}); }
+  if (submap_evictor_) {
+    lease.evictor = submap_evictor_->Acquire(submaps_, {submap_id});
+  }
+  return lease;
+}
+
+void GlobalMap::IndexSubmapPoseVariables() {
+  for (; num_indexed_submaps_ < submaps_.size(); num_indexed_submaps_++) {
+    const SubmapPtr& submap = submaps_.at(num_indexed_submaps_);
+    submap_ids_by_pose_variable_.emplace(submap->Position().uuid(),
+                                         num_indexed_submaps_);
+    submap_ids_by_pose_variable_.emplace(submap->Orientation().uuid(),
+                                         num_indexed_submaps_);
+  }
+}
+
+void GlobalMap::UpdateSubmapPositionIndex() {
+  submap_position_index_->Resize(submaps_.size());
+  for (size_t i = 0; i < submaps_.size(); i++) {
+    submap_position_index_->Update(
+        i, submaps_.at(i)->T_WORLD_SUBMAP().block<3, 1>(0, 3));
+  }
+}
+
+bool GlobalMap::ForEachSubmapParallel(
+    size_t num_submaps, const std::string& action,
+    const std::function<bool(size_t)>& task, const std::string& item) const {
+  if (num_submaps == 0) { return true; }
+  bs_common::ThreadPool pool(static_cast<int>(
+      std::min<size_t>(params_.io_num_threads, num_submaps)));
+  std::atomic<size_t> num_done{0};
+  std::atomic<bool> success{true};
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_submaps);
+  for (size_t i = 0; i < num_submaps; i++) {
+    futures.push_back(pool.Enqueue([&, i]() {
+      if (!task(i)) { success = false; }
+      BEAM_INFO("{} {} {} ({}/{})", action, item, i, ++num_done, num_submaps);
+    }));
+  }
+  for (auto& future : futures) {
+    try {
+      future.get();
+    } catch (const std::exception& e) {
+      BEAM_ERROR("{} {} failed: {}", action, item, e.what());
+      success = false;
     }
   }
+  return success;
+}
 
+void GlobalMap::SaveLidarSubmaps(const std::string& output_path,
+                                 bool save_initial) {
+  if (!std::filesystem::exists(output_path)) {
+    BEAM_ERROR("Invalid output path, not saving submaps. Input: {}",
+               output_path);
+    return;
+  }
+
+  ExportLidarSubmaps(beam::CombinePaths(output_path, "lidar_submaps_optimized"),
+                     false);
   if (!save_initial) { return; }
+  ExportLidarSubmaps(beam::CombinePaths(output_path, "lidar_submaps_initial"),
+                     true);
+}
 
-  // save initial submap
-  std::string submaps_path_initial =
-      beam::CombinePaths(output_path, "lidar_submaps_initial");
-  std::filesystem::create_directory(submaps_path_initial);
-  for (int i = 0; i < submaps_.size(); i++) {
-    std::string submap_path = beam::CombinePaths(
-        submaps_path_initial, "lidar_submap" + std::to_string(i) + ".pcd");
-    submaps_.at(i)->SaveLidarMapInWorldFrame(submap_path, max_output_map_size_,
-                                             true);
-  }
+void GlobalMap::ExportLidarSubmaps(const std::string& submaps_path,
+                                   bool use_initials) const {
+  std::filesystem::create_directory(submaps_path);
+  const bool compress = params_.map_export.compress_pcds;
+
+  // each worker saves the blocks of one submap, which are kept for the
+  // combined map so that the submap is only transformed once
+  std::vector<PointCloud> maps(submaps_.size());
+  ForEachSubmapParallel(submaps_.size(), "Saved lidar", [&](size_t i) {
+    SubmapLease lease = LeaseSubmap(i);
+    std::vector<PointCloud> blocks = submaps_.at(i)->GetLidarPointsInWorldFrame(
+        max_output_map_size_, use_initials);
+    bool success = true;
+    for (size_t j = 0; j < blocks.size(); j++) {
+      if (blocks[j].empty()) { continue; }
+      std::string block_path = beam::CombinePaths(
+          submaps_path, "lidar_submap" + std::to_string(i) + "_" +
+                            std::to_string(j) + ".pcd");
+      success = SavePCD(block_path, blocks[j], compress) && success;
+      maps[i] += blocks[j];
+    }
+    return success;
+  });
 
   // save combined
+  size_t map_size = 0;
+  for (const PointCloud& submap : maps) { map_size += submap.size(); }
   PointCloud map;
-  for (int i = 0; i < submaps_.size(); i++) {
-    map += submaps_.at(i)->GetLidarPointsInWorldFrameCombined(true);
+  map.reserve(map_size);
+  for (PointCloud& submap : maps) {
+    map += submap;
+    submap = PointCloud();
   }
+
+  if (params_.map_export.tile_size_m > 0) {
+    ExportLidarTiles(beam::CombinePaths(submaps_path, "submaps_combined_tiles"),
+                     map);
+    return;
+  }
+
   std::string submaps_combined_path =
-      beam::CombinePaths(submaps_path_initial, "submaps_combined.pcd");
+      beam::CombinePaths(submaps_path, "submaps_combined.pcd");
   BEAM_INFO("Saving combined lidar submap of size {} to: {}", map.size(),
             submaps_combined_path);
-  std::string error_message{};
-  if (!beam::SavePointCloud<pcl::PointXYZ>(submaps_combined_path, map,
-                                           beam::PointCloudFileType::PCDBINARY,
-                                           error_message)) {
-    BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
+  SavePCD(submaps_combined_path, map, compress);
+}
+
+void GlobalMap::ExportLidarTiles(const std::string& tiles_path,
+                                 const PointCloud& map) const {
+  std::filesystem::create_directory(tiles_path);
+  const double tile_size = params_.map_export.tile_size_m;
+  std::map<std::array<int64_t, 3>, PointCloud> tiles_map;
+  for (const pcl::PointXYZ& p : map) {
+    tiles_map[{static_cast<int64_t>(std::floor(p.x / tile_size)),
+               static_cast<int64_t>(std::floor(p.y / tile_size)),
+               static_cast<int64_t>(std::floor(p.z / tile_size))}]
+        .push_back(p);
   }
+  BEAM_INFO("Saving combined lidar submap of size {} as {} tiles to: {}",
+            map.size(), tiles_map.size(), tiles_path);
+
+  std::vector<std::pair<std::string, const PointCloud*>> tiles;
+  tiles.reserve(tiles_map.size());
+  for (const auto& [key, cloud] : tiles_map) {
+    tiles.emplace_back(beam::CombinePaths(
+                           tiles_path, "tile_" + std::to_string(key[0]) + "_" +
+                                           std::to_string(key[1]) + "_" +
+                                           std::to_string(key[2]) + ".pcd"),
+                       &cloud);
+  }
+  ForEachSubmapParallel(
+      tiles.size(), "Saved",
+      [&](size_t i) {
+        return SavePCD(tiles[i].first, *tiles[i].second,
+                       params_.map_export.compress_pcds);
+      },
+      "tile");
 }
 
 void GlobalMap::SaveKeypointSubmaps(const std::string& output_path,
@@ -640,27 +1456,26 @@ void GlobalMap::SaveKeypointSubmaps(const std::string& output_path,
     return;
   }
 
-  // save optimized submaps
-  std::string submaps_path =
-      beam::CombinePaths(output_path, "keypoint_submaps_optimized");
-  std::filesystem::create_directory(submaps_path);
-  for (int i = 0; i < submaps_.size(); i++) {
-    std::string submap_path = beam::CombinePaths(
-        submaps_path, "keypoint_submap" + std::to_string(i) + ".pcd");
-    submaps_.at(i)->SaveKeypointsMapInWorldFrame(submap_path);
-  }
-
+  auto save_submaps = [&](const std::string& submaps_path, bool use_initials) {
+    std::filesystem::create_directory(submaps_path);
+    ForEachSubmapParallel(submaps_.size(), "Saved keypoint", [&](size_t i) {
+      PointCloud map = submaps_.at(i)->GetKeypointsInWorldFrame(use_initials);
+      if (map.empty()) {
+        BEAM_WARN("No keypoints in submap {}, not saving.", i);
+        return true;
+      }
+      return SavePCD(
+          beam::CombinePaths(submaps_path,
+                             "keypoint_submap" + std::to_string(i) + ".pcd"),
+          map, params_.map_export.compress_pcds);
+    });
+  };
+
+  save_submaps(beam::CombinePaths(output_path, "keypoint_submaps_optimized"),
+               false);
   if (!save_initial) { return; }
-
-  // save initial submaps
-  std::string submaps_path_initial =
-      beam::CombinePaths(output_path, "keypoint_submaps_initial");
-  std::filesystem::create_directory(submaps_path_initial);
-  for (int i = 0; i < submaps_.size(); i++) {
-    std::string submap_path = beam::CombinePaths(
-        submaps_path_initial, "keypoint_submap" + std::to_string(i) + ".pcd");
-    submaps_.at(i)->SaveKeypointsMapInWorldFrame(submap_path, true);
-  }
+  save_submaps(beam::CombinePaths(output_path, "keypoint_submaps_initial"),
+               true);
 }
 
 void GlobalMap::SaveTrajectoryFile(const std::string& output_path,
@@ -728,115 +1543,88 @@ void GlobalMap::SaveTrajectoryClouds(const std::string& output_path,
     return;
   }
 
-  // get trajectory
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud;
-  for (uint16_t i = 0; i < submaps_.size(); i++) {
-    const SubmapPtr& submap = submaps_.at(i);
-    Eigen::Matrix4d T_WORLD_SUBMAP = submap->T_WORLD_SUBMAP();
-    std::vector<Submap::PoseStamped> poses_stamped = submap->GetTrajectory();
-    for (const Submap::PoseStamped& pose_stamped : poses_stamped) {
-      const Eigen::Matrix4d& T_SUBMAP_BASELINK = pose_stamped.pose;
-      Eigen::Vector4d p(0, 0, 0, 1);
-      p = T_WORLD_SUBMAP * T_SUBMAP_BASELINK * p;
-      pcl::PointXYZRGBL point;
-      point.x = p[0];
-      point.y = p[1];
-      point.z = p[2];
-      point.label = pose_stamped.stamp.toSec();
-      cloud.push_back(point);
-    }
-  }
+  // the optimized and initial clouds are built and written concurrently
+  bs_common::ThreadPool pool(save_initial ? 2 : 1);
+  std::vector<std::future<void>> futures;
+  auto save_cloud = [&](const std::string& filename, bool use_initials) {
+    futures.push_back(pool.Enqueue([this, &output_path, filename,
+                                    use_initials]() {
+      std::string output_file = beam::CombinePaths(output_path, filename);
+      BEAM_INFO("Saving trajectory cloud to: {}", output_file);
+      SavePCD(output_file, GetTrajectoryCloud(use_initials),
+              params_.map_export.compress_pcds);
+    }));
+  };
+  save_cloud("global_map_trajectory_optimized.pcd", false);
+  if (save_initial) { save_cloud("global_map_trajectory_initial.pcd", true); }
+  for (auto& future : futures) { future.get(); }
+}
 
-  std::string output_file =
-      beam::CombinePaths(output_path, "global_map_trajectory_optimized.pcd");
-  BEAM_INFO("Saving trajectory cloud to: {}", output_file);
-  std::string error_message;
-  if (!beam::SavePointCloud<pcl::PointXYZRGBL>(
-          output_file, cloud, beam::PointCloudFileType::PCDBINARY,
-          error_message)) {
-    BEAM_ERROR("Unable to save trajectory cloud. Reason: {}", error_message);
+void GlobalMap::SaveSubmapFrames(const std::string& output_path,
+                                 bool save_initial) {
+  if (!std::filesystem::exists(output_path)) {
+    BEAM_ERROR("Invalid output path, not saving submap frames. Input: {}",
+               output_path);
+    return;
   }
 
-  if (!save_initial) { return; }
+  // the optimized and initial clouds are built and written concurrently
+  bs_common::ThreadPool pool(save_initial ? 2 : 1);
+  std::vector<std::future<void>> futures;
+  auto save_cloud = [&](const std::string& filename, bool use_initials) {
+    futures.push_back(pool.Enqueue([this, &output_path, filename,
+                                    use_initials]() {
+      std::string output_file = beam::CombinePaths(output_path, filename);
+      BEAM_INFO("Saving submap frames to: {}", output_file);
+      SavePCD(output_file, GetSubmapFramesCloud(use_initials),
+              params_.map_export.compress_pcds);
+    }));
+  };
+  save_cloud("global_map_submap_poses_optimized.pcd", false);
+  if (save_initial) { save_cloud("global_map_submap_poses_initial.pcd", true); }
+  for (auto& future : futures) { future.get(); }
+}
 
-  // get trajectory initial
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud_initial;
-  for (uint16_t i = 0; i < submaps_.size(); i++) {
-    const SubmapPtr& submap = submaps_.at(i);
-    Eigen::Matrix4d T_WORLD_SUBMAP = submap->T_WORLD_SUBMAP_INIT();
-    auto poses_stamped = submap->GetTrajectory(true);
+pcl::PointCloud<pcl::PointXYZRGBL>
+    GlobalMap::GetTrajectoryCloud(bool use_initials) const {
+  pcl::PointCloud<pcl::PointXYZRGBL> cloud;
+  for (const SubmapPtr& submap : submaps_) {
+    Eigen::Matrix4d T_WORLD_SUBMAP = use_initials
+                                         ? submap->T_WORLD_SUBMAP_INIT()
+                                         : submap->T_WORLD_SUBMAP();
+    std::vector<Submap::PoseStamped> poses_stamped =
+        submap->GetTrajectory(use_initials);
     for (const Submap::PoseStamped& pose_stamped : poses_stamped) {
-      Eigen::Vector4d p(0, 0, 0, 1);
       const Eigen::Matrix4d& T_SUBMAP_BASELINK = pose_stamped.pose;
+      Eigen::Vector4d p(0, 0, 0, 1);
       p = T_WORLD_SUBMAP * T_SUBMAP_BASELINK * p;
       pcl::PointXYZRGBL point;
       point.x = p[0];
       point.y = p[1];
       point.z = p[2];
       point.label = pose_stamped.stamp.toSec();
-      cloud_initial.push_back(point);
+      cloud.push_back(point);
     }
   }
-
-  if (!beam::SavePointCloud<pcl::PointXYZRGBL>(
-          beam::CombinePaths(output_path, "global_map_trajectory_initial.pcd"),
-          cloud_initial, beam::PointCloudFileType::PCDBINARY, error_message)) {
-    BEAM_ERROR("Unable to save trajectory cloud. Reason: {}", error_message);
-  }
+  return cloud;
 }
 
-void GlobalMap::SaveSubmapFrames(const std::string& output_path,
-                                 bool save_initial) {
-  if (!std::filesystem::exists(output_path)) {
-    BEAM_ERROR("Invalid output path, not saving submap frames. Input: {}",
-               output_path);
-    return;
-  }
-
+pcl::PointCloud<pcl::PointXYZRGBL>
+    GlobalMap::GetSubmapFramesCloud(bool use_initials) const {
   pcl::PointCloud<pcl::PointXYZRGBL> cloud;
-  for (uint16_t i = 0; i < submaps_.size(); i++) {
-    const SubmapPtr& submap = submaps_.at(i);
+  for (const SubmapPtr& submap : submaps_) {
     pcl::PointCloud<pcl::PointXYZRGBL> frame =
         beam::CreateFrameCol(submap->Stamp());
     pcl::PointCloud<pcl::PointXYZRGBL> frame_transformed;
     pcl::transformPointCloud(frame, frame_transformed,
-                             submap->T_WORLD_SUBMAP());
+                             use_initials ? submap->T_WORLD_SUBMAP_INIT()
+                                          : submap->T_WORLD_SUBMAP());
     cloud += frame_transformed;
   }
-  std::string output_file =
-      beam::CombinePaths(output_path, "global_map_submap_poses_optimized.pcd");
-  BEAM_INFO("Saving submap frames to: {}", output_file);
-  std::string error_message{};
-  if (!beam::SavePointCloud<pcl::PointXYZRGBL>(
-          output_file, cloud, beam::PointCloudFileType::PCDBINARY,
-          error_message)) {
-    BEAM_ERROR("Unable to save trajectory cloud. Reason: {}", error_message);
-  }
-
-  if (!save_initial) { return; }
-
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud_initial;
-  for (uint16_t i = 0; i < submaps_.size(); i++) {
-    const SubmapPtr& submap = submaps_.at(i);
-    pcl::PointCloud<pcl::PointXYZRGBL> frame =
-        beam::CreateFrameCol(submap->Stamp());
-    pcl::PointCloud<pcl::PointXYZRGBL> frame_transformed;
-    pcl::transformPointCloud(frame, frame_transformed,
-                             submap->T_WORLD_SUBMAP_INIT());
-    cloud_initial += frame_transformed;
-  }
-  std::string output_file_initial =
-      beam::CombinePaths(output_path, "global_map_submap_poses_initial.pcd");
-  BEAM_INFO("Saving submap frames to: {}", output_file_initial);
-  if (!beam::SavePointCloud<pcl::PointXYZRGBL>(
-          output_file_initial, cloud_initial,
-          beam::PointCloudFileType::PCDBINARY, error_message)) {
-    BEAM_ERROR("Unable to save submap frames cloud. Reason: {}", error_message);
-  }
+  return cloud;
 }
 
-void GlobalMap::AddRosSubmap(int submap_id) {
-  const auto& submap_ptr = submaps_.at(submap_id);
+void GlobalMap::AddRosSubmap(const SubmapPtr& submap_ptr, int submap_id) {
 
   // get all lidar points in pcl pointcloud
   PointCloud new_submap_pcl_cloud =
@@ -846,8 +1634,8 @@ void GlobalMap::AddRosSubmap(int submap_id) {
 
   if (new_submap_pcl_cloud.size() > 0) {
     // filter cloud
-    new_submap_pcl_cloud = beam_filtering::FilterPointCloud(
-        new_submap_pcl_cloud, params_.ros_submap_filter_params);
+    params_.ros_submap_filters.Filter(new_submap_pcl_cloud,
+                                      new_submap_pcl_cloud);
 
     // convert to PointCloud2
     pointcloud2_msg = beam::PCLToROS<pcl::PointXYZ>(
@@ -856,6 +1644,7 @@ void GlobalMap::AddRosSubmap(int submap_id) {
 
     // set cloud
     RosMap new_ros_map_lidar(RosMapType::LIDARSUBMAP, pointcloud2_msg);
+    std::unique_lock<std::mutex> lk(ros_submaps_mutex_);
     ros_submaps_.push(std::make_shared<RosMap>(new_ros_map_lidar));
   }
 
@@ -870,10 +1659,12 @@ void GlobalMap::AddRosSubmap(int submap_id) {
 
     // set cloud
     RosMap new_ros_map_keypoints(RosMapType::VISUALSUBMAP, pointcloud2_msg);
+    std::unique_lock<std::mutex> lk(ros_submaps_mutex_);
     ros_submaps_.push(std::make_shared<RosMap>(new_ros_map_keypoints));
   }
 
   // clear submaps if there are too many in the queue;
+  std::unique_lock<std::mutex> lk(ros_submaps_mutex_);
   while (ros_submaps_.size() > max_num_ros_submaps_) { ros_submaps_.pop(); }
 }
 
@@ -881,22 +1672,29 @@ void GlobalMap::AddRosGlobalMap() {
   PointCloud global_lidar_map;
   PointCloud global_keypoints_map;
 
-  for (const auto& submap_ptr : submaps_) {
-    // get all lidar points in pcl pointcloud
+  const bool use_tiles = params_.ros_globalmap_tiles.enabled;
+  if (use_tiles) { AddRosGlobalMapTiles(); }
+
+  for (size_t i = 0; i < submaps_.size(); i++) {
+    const SubmapPtr& submap_ptr = submaps_.at(i);
     PointCloud new_submap_pcl_cloud;
-    std::vector<PointCloud> new_submap_points =
-        submap_ptr->GetLidarPointsInWorldFrame(10e6, false);
-    for (const PointCloud& cloud : new_submap_points) {
-      new_submap_pcl_cloud += cloud;
+    if (!use_tiles) {
+      // get all lidar points in pcl pointcloud
+      SubmapLease lease = LeaseSubmap(i);
+      std::vector<PointCloud> new_submap_points =
+          submap_ptr->GetLidarPointsInWorldFrame(10e6, false);
+      for (const PointCloud& cloud : new_submap_points) {
+        new_submap_pcl_cloud += cloud;
+      }
+
+      // filter submap
+      params_.ros_submap_filters.Filter(new_submap_pcl_cloud,
+                                        new_submap_pcl_cloud);
+
+      // add to global
+      global_lidar_map += new_submap_pcl_cloud;
     }
 
-    // filter submap
-    new_submap_pcl_cloud = beam_filtering::FilterPointCloud(
-        new_submap_pcl_cloud, params_.ros_submap_filter_params);
-
-    // add to global
-    global_lidar_map += new_submap_pcl_cloud;
-
     // get all keypoints in pcl pointcloud
     new_submap_pcl_cloud = submap_ptr->GetKeypointsInWorldFrame(false);
 
@@ -906,8 +1704,7 @@ void GlobalMap::AddRosGlobalMap() {
 
   if (global_lidar_map.size() > 0) {
     // filter global map
-    global_lidar_map = beam_filtering::FilterPointCloud(
-        global_lidar_map, params_.ros_globalmap_filter_params);
+    params_.ros_globalmap_filters.Filter(global_lidar_map, global_lidar_map);
 
     // convert lidar map to PointCloud2
     sensor_msgs::PointCloud2 pointcloud2_msg = beam::PCLToROS<pcl::PointXYZ>(
@@ -931,6 +1728,31 @@ void GlobalMap::AddRosGlobalMap() {
   }
 }
 
+void GlobalMap::AddRosGlobalMapTiles() {
+  // the last submap is still being built, it is added once completed
+  for (int i = 0; i + 1 < static_cast<int>(submaps_.size()); i++) {
+    const SubmapPtr& submap = submaps_.at(i);
+    if (ros_tiled_map_.UpdateSubmapPose(i, submap->T_WORLD_SUBMAP())) {
+      continue;
+    }
+    SubmapLease lease = LeaseSubmap(i);
+    PointCloud points = submap->GetLidarPointsInSubmapFrame();
+    params_.ros_submap_filters.Filter(points, points);
+    ros_tiled_map_.SetSubmap(i, points, submap->T_WORLD_SUBMAP());
+  }
+
+  for (const TiledLidarMap::Tile& tile :
+       ros_tiled_map_.GetTiles(ros_viewpoint_, ros_sent_tiles_)) {
+    // the sequence number is the tile version, so clients can tell which
+    // tiles they already have
+    sensor_msgs::PointCloud2 pointcloud2_msg = beam::PCLToROS<pcl::PointXYZ>(
+        tile.points, last_update_time_, extrinsics_->GetWorldFrameId(),
+        tile.version);
+    ros_global_map_tiles_.push(std::make_shared<RosMap>(
+        RosMapType::LIDARGLOBALMAPTILE, pointcloud2_msg));
+  }
+}
+
 void GlobalMap::AddNewRosScan(const PointCloud& cloud,
                               const Eigen::Matrix4d& T_WORLD_BASELINK,
                               const ros::Time& stamp) {
@@ -1,6 +1,7 @@
 #include <bs_models/global_mapping/global_map_batch_optimization.h>
 
 #include <filesystem>
+#include <set>
 
 #include <fuse_core/transaction.h>
 
@@ -34,34 +35,53 @@ using PointCloudSCPtr = std::shared_ptr<pcl::PointCloud<pcl::PointXYZI>>;
 GlobalMapBatchOptimization::GlobalMapBatchOptimization(
     const Params& params, const std::string& output_path)
     : params_(params), output_path_(output_path) {
-  // Setup matchers
+  // Setup one matcher per loop closure worker
+  const int num_workers = std::max(params_.lc_num_threads, 1);
   const auto& m_conf = params_.matcher_config;
   auto matcher_type = GetTypeFromConfig(m_conf);
-  if (matcher_type == MatcherType::LOAM) {
-    std::string ceres_config =
-        bs_common::GetAbsoluteConfigPathFromJson(m_conf, "ceres_config");
-    matcher_loam_ =
-        std::make_unique<LoamMatcher>(LoamParams(m_conf, ceres_config));
-  } else if (matcher_type == MatcherType::ICP) {
-    matcher_ = std::make_unique<IcpMatcher>(IcpMatcher::Params(m_conf));
-  } else if (matcher_type == MatcherType::GICP) {
-    matcher_ = std::make_unique<GicpMatcher>(GicpMatcher::Params(m_conf));
-  } else if (matcher_type == MatcherType::NDT) {
-    matcher_ = std::make_unique<NdtMatcher>(NdtMatcher::Params(m_conf));
-  } else {
-    BEAM_ERROR("Invalid matcher type");
-    throw std::invalid_argument{"invalid json"};
+  for (int i = 0; i < num_workers; i++) {
+    if (matcher_type == MatcherType::LOAM) {
+      std::string ceres_config =
+          bs_common::GetAbsoluteConfigPathFromJson(m_conf, "ceres_config");
+      matchers_loam_.push_back(
+          std::make_unique<LoamMatcher>(LoamParams(m_conf, ceres_config)));
+    } else if (matcher_type == MatcherType::ICP) {
+      matchers_.push_back(
+          std::make_unique<IcpMatcher>(IcpMatcher::Params(m_conf)));
+    } else if (matcher_type == MatcherType::GICP) {
+      matchers_.push_back(
+          std::make_unique<GicpMatcher>(GicpMatcher::Params(m_conf)));
+    } else if (matcher_type == MatcherType::NDT) {
+      matchers_.push_back(
+          std::make_unique<NdtMatcher>(NdtMatcher::Params(m_conf)));
+    } else {
+      BEAM_ERROR("Invalid matcher type");
+      throw std::invalid_argument{"invalid json"};
+    }
   }
+  pool_ = std::make_unique<bs_common::ThreadPool>(num_workers);
 
   // setup graph
   graph_ = fuse_graphs::HashGraph::make_shared();
 }
 
+void GlobalMapBatchOptimization::SetRegistrationCache(
+    const std::shared_ptr<RegistrationCache>& cache) {
+  cache_ = cache;
+  // covariances are scaled by the multiplier before they are cached
+  cache_context_ = RegistrationCache::ContextId(
+      "batch_loop_closure " + std::to_string(params_.lc_cov_multiplier),
+      params_.matcher_config);
+}
+
 bool GlobalMapBatchOptimization::Run(std::vector<SubmapPtr> submaps) {
   // get lidar frame id
   lidar_frame_id_ = submaps.at(0)->Extrinsics()->GetLidarFrameId();
 
   ConvertScanPosesToWorld(submaps);
+  if (working_set_) {
+    submaps_working_set_ = working_set_->ForSubmaps(submaps_);
+  }
 
   // get mapping from all scan stamps, to their respective submap ids
   scan_stamp_to_submap_id_.clear();
@@ -71,14 +91,14 @@ bool GlobalMapBatchOptimization::Run(std::vector<SubmapPtr> submaps) {
       scan_stamp_to_submap_id_.emplace(scan_iter->first, i);
     }
   }
+  rebuild_scan_position_index_ = true;
+  scan_contexts_.clear();
 
   // setup scan registration
   std::unique_ptr<sr::ScanRegistrationBase> scan_registration =
-      sr::ScanRegistrationBase::Create(params_.scan_registration_config,
-                                       params_.matcher_config, "", 1e-9);
-
-  // clear lidar map
-  scan_registration->GetMapMutable().Clear();
+      sr::ScanRegistrationBase::Create(
+          params_.scan_registration_config, params_.matcher_config, "", 1e-9,
+          std::make_shared<sr::RegistrationMap>());
 
   BEAM_INFO("Running batch optimization");
   for (int i = 0; i < submaps_.size(); i++) {
@@ -86,20 +106,21 @@ bool GlobalMapBatchOptimization::Run(std::vector<SubmapPtr> submaps) {
     const auto& submap = submaps_.at(i);
     for (auto scan_iter = submap->LidarKeyframesBegin();
          scan_iter != submap->LidarKeyframesEnd(); scan_iter++) {
+      SubmapWorkingSet::Lease lease =
+          LeaseAggregatedSubmaps({scan_iter->first});
       auto transaction = scan_registration->RegisterNewScan(scan_iter->second)
                              .GetTransaction();
-      if (transaction) { graph_->update(*transaction); }
+      if (transaction) { AddTransaction(*transaction); }
 
       if (params_.update_graph_on_all_scans) {
-        graph_->optimize();
-        UpdateSubmapScanPosesFromGraph(submaps_, graph_, scan_iter->first,
-                                       true);
-        UpdateSubmapPosesFromGraph(submaps_, graph_);
+        AddToOptimizationWindow(scan_iter->second);
+        OptimizeWindow(scan_iter->first);
       }
 
       RunLoopClosureOnAllScans(scan_iter->second);
     }
   }
+  if (submaps_working_set_) { submaps_working_set_->ReleaseAll(); }
 
   // visualize before
   std::filesystem::path p(output_path_);
@@ -124,6 +145,12 @@ bool GlobalMapBatchOptimization::Run(std::vector<SubmapPtr> submaps) {
 
   // optimize
   BEAM_INFO("Running final graph optimization");
+  for (const auto& uuid : held_variables_) {
+    graph_->holdVariable(uuid, false);
+  }
+  held_variables_.clear();
+  optimization_window_.clear();
+  problem_.Clear();
   graph_->optimize();
 
   // visualize after
@@ -155,45 +182,43 @@ bool GlobalMapBatchOptimization::Run(std::vector<SubmapPtr> submaps) {
 
 void GlobalMapBatchOptimization::RunLoopClosureOnAllScans(ScanPose& query) {
   if (params_.lc_max_per_query_scan == 0) { return; }
+  if (rebuild_scan_position_index_) { BuildScanPositionIndex(); }
+
+  // Get a map of candidate scans before the query that are within the dist
+  // thresholds. The kd-tree is searched with a margin since scans may have
+  // moved since it was built, then the thresholds use the current poses
+  const uint64_t timestamp_query_ns = query.Stamp().toNSec();
+  const Eigen::Matrix4d T_World_BaselinkQuery = query.T_REFFRAME_BASELINK();
+  const double trajectory_length_query =
+      trajectory_lengths_.at(timestamp_query_ns);
+  const pcl::PointXYZ p_query(T_World_BaselinkQuery(0, 3),
+                              T_World_BaselinkQuery(1, 3),
+                              T_World_BaselinkQuery(2, 3));
+  std::vector<int> indices;
+  std::vector<float> squared_distances;
+  scan_position_tree_.radiusSearch(
+      p_query, params_.lc_dist_thresh_m + lc_search_margin_m_, indices,
+      squared_distances);
 
-  // Aggregate around scan for helping scan context
-  uint64_t timestamp_query_ns = query.Stamp().toNSec();
-  PointCloudSC query_scan_agg = AggregateScan(timestamp_query_ns);
-  SCManager sc_manager;
-  auto sc_query = sc_manager.makeScancontext(query_scan_agg);
-
-  double trajectory_length = 0;
-  Eigen::Matrix4d T_World_BaselinkQuery = query.T_REFFRAME_BASELINK();
-  Eigen::Matrix4d T_World_Baselink_Last = T_World_BaselinkQuery;
-
-  // Get a map of candidate scans that are within the dist thresholds, by
-  // reverse iterating over all scan poses starting from the query timestamp
   std::map<double, std::pair<uint64_t, int>>
       candidates; // dist -> (scan_stamp, submap_id)
-  auto tmp = scan_stamp_to_submap_id_.find(timestamp_query_ns);
-  auto it_start = std::reverse_iterator(std::next(tmp));
-  for (auto it = it_start; it != scan_stamp_to_submap_id_.rend(); it++) {
-    // Get candidate scan
-    const auto candidate_stamp = it->first;
-    const auto candidate_submap_id = it->second;
-    const auto& candidate =
-        submaps_.at(candidate_submap_id)->LidarKeyframes().at(candidate_stamp);
-    Eigen::Matrix4d T_World_BaselinkCandidate = candidate.T_REFFRAME_BASELINK();
-
-    // check distance from scan, skip if lower than thresh
-    Eigen::Matrix4d T_BaselinkLast_BaselinkCandidate =
-        beam::InvertTransform(T_World_Baselink_Last) *
-        T_World_BaselinkCandidate;
-    T_World_Baselink_Last = T_World_BaselinkCandidate;
-    double dist_from_last =
-        T_BaselinkLast_BaselinkCandidate.block(0, 3, 3, 1).norm();
-    trajectory_length += dist_from_last;
+  for (const int index : indices) {
+    const uint64_t candidate_stamp = scan_position_stamps_.at(index);
+    if (candidate_stamp >= timestamp_query_ns) { continue; }
+
+    // check trajectory length from scan, skip if lower than thresh
+    const double trajectory_length =
+        trajectory_length_query - trajectory_lengths_.at(candidate_stamp);
     if (trajectory_length < params_.lc_min_traj_dist_m) { continue; }
 
     // check min distance threshold for LC
+    const int candidate_submap_id =
+        scan_stamp_to_submap_id_.at(candidate_stamp);
+    const auto& candidate =
+        submaps_.at(candidate_submap_id)->LidarKeyframes().at(candidate_stamp);
     Eigen::Matrix4d T_BaselinkQuery_BaselinkCandidate =
         beam::InvertTransform(T_World_BaselinkQuery) *
-        T_World_BaselinkCandidate;
+        candidate.T_REFFRAME_BASELINK();
     double dist_to_candidate =
         T_BaselinkQuery_BaselinkCandidate.block(0, 3, 3, 1).norm();
     if (dist_to_candidate > params_.lc_dist_thresh_m) { continue; }
@@ -201,72 +226,50 @@ void GlobalMapBatchOptimization::RunLoopClosureOnAllScans(ScanPose& query) {
     candidates.emplace(dist_to_candidate,
                        std::make_pair(candidate_stamp, candidate_submap_id));
   }
-
-  // iterate by smallest distance and store measurements
+  if (candidates.empty()) { return; }
+
+  // verify candidates in batches of one per worker, by smallest distance. The
+  // measurements are taken in distance order from each batch, so the result
+  // does not depend on the number of workers
+  const Eigen::MatrixXd sc_query = GetScanContext(timestamp_query_ns);
+  std::vector<std::pair<uint64_t, int>> ordered_candidates;
+  std::vector<uint64_t> candidate_stamps;
+  for (const auto& [dist, candidate] : candidates) {
+    ordered_candidates.push_back(candidate);
+    candidate_stamps.push_back(candidate.first);
+  }
+  SubmapWorkingSet::Lease lease = LeaseAggregatedSubmaps(candidate_stamps);
+  const size_t num_workers = std::max(matchers_.size(), matchers_loam_.size());
+  const size_t max_measurements = params_.lc_max_per_query_scan > 0
+                                      ? params_.lc_max_per_query_scan
+                                      : ordered_candidates.size();
   std::vector<LoopClosureMeasurement> measurements;
-  for (auto it = candidates.begin(); it != candidates.end(); it++) {
-    const auto candidate_stamp = it->second.first;
-    const auto candidate_submap_id = it->second.second;
-    const auto& candidate =
-        submaps_.at(candidate_submap_id)->LidarKeyframes().at(candidate_stamp);
-
-    // check scan context
-    PointCloudSC candidate_scan = AggregateScan(candidate_stamp);
-    auto sc_candidate = sc_manager.makeScancontext(candidate_scan);
-    std::pair<double, int> sc_result =
-        sc_manager.distanceBtnScanContext(sc_query, sc_candidate);
-    if (sc_result.first > params_.lc_scan_context_dist_thres) { continue; }
-
-    // register scans
-    Eigen::Matrix4d T_Query_Candidate_Init =
-        beam::InvertTransform(query.T_REFFRAME_LIDAR()) *
-        candidate.T_REFFRAME_LIDAR();
-    Eigen::Matrix4d T_Query_Candidate_Measured;
-    Eigen::Matrix<double, 6, 6> cov =
-        params_.lc_cov_multiplier * Eigen::Matrix<double, 6, 6>::Identity();
-    if (matcher_loam_) {
-      auto query_cloud = std::make_shared<LoamPointCloud>(query.LoamCloud());
-      auto candidate_in_query_est = std::make_shared<LoamPointCloud>(
-          candidate.LoamCloud(), T_Query_Candidate_Init);
-      matcher_loam_->SetRef(query_cloud);
-      matcher_loam_->SetTarget(candidate_in_query_est);
-      bool match_success = matcher_loam_->Match();
-      T_Query_Candidate_Measured =
-          matcher_loam_->ApplyResult(T_Query_Candidate_Init);
-      cov = params_.lc_cov_multiplier * matcher_loam_->GetCovariance();
-    } else {
-      auto query_cloud = std::make_shared<PointCloud>(query.Cloud());
-      auto candidate_cloud = candidate.Cloud();
-      auto candidate_in_query_est = std::make_shared<PointCloud>();
-      pcl::transformPointCloud(candidate_cloud, *candidate_in_query_est,
-                               Eigen::Affine3d(T_Query_Candidate_Init));
-      matcher_->SetRef(query_cloud);
-      matcher_->SetTarget(candidate_in_query_est);
-      if (!matcher_->Match()) {
-        BEAM_ERROR("Match not successful, skipping loop closure measurement");
-        continue;
-      }
-      T_Query_Candidate_Measured =
-          matcher_->ApplyResult(T_Query_Candidate_Init);
-    }
-
-    LoopClosureMeasurement measurement;
-    measurement.T_Query_Candidate_Measured = T_Query_Candidate_Measured;
-    measurement.covariance = cov;
-    measurement.candidate_position = candidate.Position();
-    measurement.candidate_orientation = candidate.Orientation();
-    measurement.scan_context_dist = sc_result.first;
-    measurements.push_back(measurement);
-
-    if (params_.lc_max_per_query_scan > 0 &&
-        measurements.size() >= params_.lc_max_per_query_scan) {
-      break;
+  for (size_t begin = 0; begin < ordered_candidates.size() &&
+                         measurements.size() < max_measurements;
+       begin += num_workers) {
+    const size_t batch_size =
+        std::min(num_workers, ordered_candidates.size() - begin);
+    std::vector<LoopClosureMeasurement> batch(batch_size);
+    std::vector<char> success(batch_size, false);
+    pool_->ParallelFor(batch_size, [&](size_t i) {
+      const auto& [candidate_stamp, candidate_submap_id] =
+          ordered_candidates.at(begin + i);
+      success[i] = MeasureLoopClosure(query, sc_query, candidate_stamp,
+                                      candidate_submap_id, i, batch[i]);
+    });
+    for (size_t i = 0;
+         i < batch_size && measurements.size() < max_measurements; i++) {
+      if (success[i]) { measurements.push_back(batch[i]); }
     }
   }
 
   measurements = RemoveOutlierMeasurements(measurements);
+  if (measurements.empty()) { return; }
+
+  // all loop closures of the query are added to the graph at once
+  bs_constraints::Pose3DStampedTransaction transaction(query.Stamp());
+  transaction.Reserve(0, measurements.size());
   for (const auto& m : measurements) {
-    bs_constraints::Pose3DStampedTransaction transaction(query.Stamp());
     transaction.AddPoseConstraint(
         m.candidate_position, query.Position(), m.candidate_orientation,
         query.Orientation(),
@@ -274,22 +277,14 @@ void GlobalMapBatchOptimization::RunLoopClosureOnAllScans(ScanPose& query) {
             beam::InvertTransform(m.T_Query_Candidate_Measured)),
         m.covariance, "GlobalMapBatchOptimization::RunLoopClosureOnAllScans",
         lidar_frame_id_);
-
-    graph_->update(*(transaction.GetTransaction()));
   }
-
-  if (measurements.empty()) { return; }
+  AddTransaction(*(transaction.GetTransaction()));
 
   // optimize
   if (params_.update_graph_on_all_lcs) {
     BEAM_INFO("Optimizing the graph with {} loop closure constraints",
               measurements.size());
-    graph_->optimize();
-    // update all scans
-    BEAM_INFO("Updating submap poses");
-    UpdateSubmapScanPosesFromGraph(submaps_, graph_, query.Stamp().toNSec(),
-                                   true);
-    UpdateSubmapPosesFromGraph(submaps_, graph_);
+    OptimizeAll(query.Stamp().toNSec());
     BEAM_INFO("Done updating submap poses");
   } else {
     BEAM_INFO("Added {} loop closure constraints to the graph for query scan "
@@ -298,6 +293,203 @@ void GlobalMapBatchOptimization::RunLoopClosureOnAllScans(ScanPose& query) {
   }
 }
 
+void GlobalMapBatchOptimization::AddTransaction(
+    const fuse_core::Transaction& transaction) {
+  graph_->update(transaction);
+  if (params_.update_graph_on_all_scans || params_.update_graph_on_all_lcs) {
+    problem_.Update(*graph_, transaction);
+  }
+}
+
+void GlobalMapBatchOptimization::AddToOptimizationWindow(const ScanPose& scan) {
+  if (params_.optimization_window_scans <= 0) { return; }
+  optimization_window_.push_back(scan.Stamp().toNSec());
+  while (optimization_window_.size() >
+         static_cast<size_t>(params_.optimization_window_scans)) {
+    const uint64_t stamp = optimization_window_.front();
+    optimization_window_.pop_front();
+    const ScanPose& oldest = submaps_.at(scan_stamp_to_submap_id_.at(stamp))
+                                 ->LidarKeyframes()
+                                 .at(stamp);
+    for (const auto& uuid :
+         {oldest.Position().uuid(), oldest.Orientation().uuid()}) {
+      if (!graph_->variableExists(uuid)) { continue; }
+      graph_->holdVariable(uuid, true);
+      held_variables_.push_back(uuid);
+    }
+  }
+}
+
+void GlobalMapBatchOptimization::OptimizeWindow(uint64_t max_timestamp) {
+  if (params_.optimization_window_scans <= 0) {
+    OptimizeAll(max_timestamp);
+    return;
+  }
+
+  // sync the holds, then only the scans in the window can change
+  problem_.Update(*graph_, fuse_core::Transaction());
+  problem_.Optimize(ceres::Solver::Options());
+  std::set<int> submap_ids;
+  for (const uint64_t stamp : optimization_window_) {
+    const int submap_id = scan_stamp_to_submap_id_.at(stamp);
+    submaps_.at(submap_id)->LidarKeyframesMutable().at(stamp).UpdatePose(
+        graph_);
+    submap_ids.insert(submap_id);
+  }
+  for (const int submap_id : submap_ids) {
+    submaps_.at(submap_id)->UpdatePose(graph_);
+  }
+  InvalidateScanContexts(optimization_window_.front());
+}
+
+void GlobalMapBatchOptimization::OptimizeAll(uint64_t max_timestamp) {
+  for (const auto& uuid : held_variables_) {
+    graph_->holdVariable(uuid, false);
+  }
+  problem_.Update(*graph_, fuse_core::Transaction());
+  problem_.Optimize(ceres::Solver::Options());
+  for (const auto& uuid : held_variables_) { graph_->holdVariable(uuid, true); }
+
+  UpdateSubmapScanPosesFromGraph(submaps_, graph_, max_timestamp, true);
+  UpdateSubmapPosesFromGraph(submaps_, graph_);
+  rebuild_scan_position_index_ = true;
+  std::lock_guard<std::mutex> lock(scan_contexts_mutex_);
+  scan_contexts_.clear();
+}
+
+void GlobalMapBatchOptimization::BuildScanPositionIndex() {
+  auto positions = std::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
+  scan_position_stamps_.clear();
+  trajectory_lengths_.clear();
+  double trajectory_length = 0;
+  Eigen::Vector3d t_World_Baselink_Last;
+  for (const auto& [stamp, submap_id] : scan_stamp_to_submap_id_) {
+    const auto& scan = submaps_.at(submap_id)->LidarKeyframes().at(stamp);
+    const Eigen::Vector3d t_World_Baselink =
+        scan.T_REFFRAME_BASELINK().block<3, 1>(0, 3);
+    if (!scan_position_stamps_.empty()) {
+      trajectory_length += (t_World_Baselink - t_World_Baselink_Last).norm();
+    }
+    t_World_Baselink_Last = t_World_Baselink;
+    positions->push_back(pcl::PointXYZ(
+        t_World_Baselink[0], t_World_Baselink[1], t_World_Baselink[2]));
+    scan_position_stamps_.push_back(stamp);
+    trajectory_lengths_.emplace(stamp, trajectory_length);
+  }
+  scan_position_tree_.setInputCloud(positions);
+  rebuild_scan_position_index_ = false;
+}
+
+Eigen::MatrixXd
+    GlobalMapBatchOptimization::GetScanContext(uint64_t scan_time_ns) {
+  {
+    std::lock_guard<std::mutex> lock(scan_contexts_mutex_);
+    auto iter = scan_contexts_.find(scan_time_ns);
+    if (iter != scan_contexts_.end()) { return iter->second; }
+  }
+
+  // Aggregate around scan for helping scan context
+  PointCloudSC scan_agg = AggregateScan(scan_time_ns);
+  SCManager sc_manager;
+  Eigen::MatrixXd sc = sc_manager.makeScancontext(scan_agg);
+  std::lock_guard<std::mutex> lock(scan_contexts_mutex_);
+  scan_contexts_.emplace(scan_time_ns, sc);
+  return sc;
+}
+
+bool GlobalMapBatchOptimization::MeasureLoopClosure(
+    const ScanPose& query, const Eigen::MatrixXd& sc_query,
+    uint64_t candidate_stamp, int candidate_submap_id, size_t worker,
+    LoopClosureMeasurement& measurement) {
+  const auto& candidate =
+      submaps_.at(candidate_submap_id)->LidarKeyframes().at(candidate_stamp);
+
+  // check scan context
+  SCManager sc_manager;
+  Eigen::MatrixXd sc_query_copy = sc_query;
+  Eigen::MatrixXd sc_candidate = GetScanContext(candidate_stamp);
+  std::pair<double, int> sc_result =
+      sc_manager.distanceBtnScanContext(sc_query_copy, sc_candidate);
+  if (sc_result.first > params_.lc_scan_context_dist_thres) { return false; }
+
+  // register scans
+  Eigen::Matrix4d T_Query_Candidate_Init =
+      beam::InvertTransform(query.T_REFFRAME_LIDAR()) *
+      candidate.T_REFFRAME_LIDAR();
+  Eigen::Matrix4d T_Query_Candidate_Measured;
+  Eigen::Matrix<double, 6, 6> cov =
+      params_.lc_cov_multiplier * Eigen::Matrix<double, 6, 6>::Identity();
+  RegistrationCache::Key key;
+  RegistrationCache::Result cached;
+  if (cache_) {
+    key = cache_->MakeKey(cache_context_,
+                          RegistrationCache::ScanId(query.Stamp()),
+                          RegistrationCache::ScanId(candidate.Stamp()),
+                          T_Query_Candidate_Init);
+  }
+  const bool found = cache_ && cache_->Find(key, cached);
+  if (found) {
+    if (!cached.successful) { return false; }
+    T_Query_Candidate_Measured = cached.T_REFERENCE_TARGET;
+    cov = cached.covariance.value_or(cov);
+  } else if (!matchers_loam_.empty()) {
+    const auto& matcher_loam = matchers_loam_.at(worker);
+    auto query_cloud = std::make_shared<LoamPointCloud>(query.LoamCloud());
+    auto candidate_in_query_est = std::make_shared<LoamPointCloud>(
+        candidate.LoamCloud(), T_Query_Candidate_Init);
+    matcher_loam->SetRef(query_cloud);
+    matcher_loam->SetTarget(candidate_in_query_est);
+    bool match_success = matcher_loam->Match();
+    T_Query_Candidate_Measured =
+        matcher_loam->ApplyResult(T_Query_Candidate_Init);
+    cov = params_.lc_cov_multiplier * matcher_loam->GetCovariance();
+  } else {
+    const auto& matcher = matchers_.at(worker);
+    auto query_cloud = std::make_shared<PointCloud>(query.Cloud());
+    const auto& candidate_cloud = candidate.Cloud();
+    auto candidate_in_query_est = std::make_shared<PointCloud>();
+    pcl::transformPointCloud(candidate_cloud, *candidate_in_query_est,
+                             Eigen::Affine3d(T_Query_Candidate_Init));
+    matcher->SetRef(query_cloud);
+    matcher->SetTarget(candidate_in_query_est);
+    if (!matcher->Match()) {
+      BEAM_ERROR("Match not successful, skipping loop closure measurement");
+      if (cache_) { cache_->Insert(key, cached); }
+      return false;
+    }
+    T_Query_Candidate_Measured = matcher->ApplyResult(T_Query_Candidate_Init);
+  }
+
+  if (cache_ && !found) {
+    cached.successful = true;
+    cached.T_REFERENCE_TARGET = T_Query_Candidate_Measured;
+    cached.covariance = cov;
+    cache_->Insert(key, cached);
+  }
+
+  measurement.T_Query_Candidate_Measured = T_Query_Candidate_Measured;
+  measurement.covariance = cov;
+  measurement.candidate_position = candidate.Position();
+  measurement.candidate_orientation = candidate.Orientation();
+  measurement.scan_context_dist = sc_result.first;
+  return true;
+}
+
+void GlobalMapBatchOptimization::InvalidateScanContexts(
+    uint64_t min_timestamp) {
+  // aggregated scans include the scans_to_aggregate_ scans on each side
+  auto iter = scan_stamp_to_submap_id_.lower_bound(min_timestamp);
+  for (int i = 0; i < scans_to_aggregate_ &&
+                  iter != scan_stamp_to_submap_id_.begin();
+       i++) {
+    iter--;
+  }
+  if (iter == scan_stamp_to_submap_id_.end()) { return; }
+  std::lock_guard<std::mutex> lock(scan_contexts_mutex_);
+  scan_contexts_.erase(scan_contexts_.lower_bound(iter->first),
+                       scan_contexts_.end());
+}
+
 std::vector<GlobalMapBatchOptimization::LoopClosureMeasurement>
     GlobalMapBatchOptimization::RemoveOutlierMeasurements(
         const std::vector<GlobalMapBatchOptimization::LoopClosureMeasurement>&
@@ -448,6 +640,32 @@ PointCloudSC
   return cloud_out;
 }
 
+SubmapWorkingSet::Lease GlobalMapBatchOptimization::LeaseAggregatedSubmaps(
+    const std::vector<uint64_t>& scan_times_ns) const {
+  if (!submaps_working_set_) { return SubmapWorkingSet::Lease(); }
+  std::vector<size_t> submap_ids;
+  for (const uint64_t scan_time_ns : scan_times_ns) {
+    auto iter = scan_stamp_to_submap_id_.find(scan_time_ns);
+    if (iter == scan_stamp_to_submap_id_.end()) { continue; }
+    auto back = iter;
+    for (int i = 0;
+         i < scans_to_aggregate_ && back != scan_stamp_to_submap_id_.begin();
+         i++) {
+      back--;
+    }
+    auto forward = iter;
+    for (int i = 0; i < scans_to_aggregate_ &&
+                    std::next(forward) != scan_stamp_to_submap_id_.end();
+         i++) {
+      forward++;
+    }
+    for (int id = back->second; id <= forward->second; id++) {
+      submap_ids.push_back(id);
+    }
+  }
+  return submaps_working_set_->Acquire(submap_ids);
+}
+
 void GlobalMapBatchOptimization::ConvertScanPosesToWorld(
     std::vector<SubmapPtr> submaps) {
   for (const auto& submap : submaps) {
@@ -0,0 +1,390 @@
+#include <bs_models/global_mapping/global_map_merger.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <queue>
+#include <set>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/thread_pool.h>
+#include <bs_common/utils.h>
+#include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_models/reloc/reloc_refinement_base.h>
+
+namespace bs_models::global_mapping {
+
+void GlobalMapMerger::Params::LoadJson(const std::string& config_path) {
+  if (config_path.empty()) {
+    BEAM_INFO("No config file provided to global map merger, using default "
+              "parameters.");
+    return;
+  }
+  BEAM_INFO("Loading global map merger config file: {}", config_path);
+  nlohmann::json J;
+  if (!beam::ReadJson(config_path, J)) {
+    BEAM_ERROR("Unable to read global map merger config");
+    throw std::runtime_error{"Unable to read global map merger config"};
+  }
+
+  beam::ValidateJsonKeysOrThrow({"candidate_search_config", "refinement_config",
+                                 "local_mapper_covariance",
+                                 "loop_closure_covariance"},
+                                J);
+
+  std::string candidate_search_config_rel = J["candidate_search_config"];
+  if (!candidate_search_config_rel.empty()) {
+    candidate_search_config = beam::CombinePaths(
+        bs_common::GetBeamSlamConfigPath(), candidate_search_config_rel);
+  }
+
+  std::string refinement_config_rel = J["refinement_config"];
+  if (!refinement_config_rel.empty()) {
+    refinement_config = beam::CombinePaths(bs_common::GetBeamSlamConfigPath(),
+                                           refinement_config_rel);
+  }
+
+  double lc_cov_dia = J["loop_closure_covariance"];
+  double lm_cov_dia = J["local_mapper_covariance"];
+  loop_closure_covariance =
+      Eigen::Matrix<double, 6, 6>::Identity() * lc_cov_dia;
+  local_mapper_covariance =
+      Eigen::Matrix<double, 6, 6>::Identity() * lm_cov_dia;
+
+  if (J.contains("num_threads")) {
+    num_threads = J["num_threads"];
+    if (num_threads < 1) {
+      BEAM_ERROR("global map merger num_threads must be at least 1");
+      throw std::runtime_error{"invalid global map merger num_threads"};
+    }
+  }
+  if (J.contains("search_loop_closures_on_union")) {
+    search_loop_closures_on_union = J["search_loop_closures_on_union"];
+  }
+}
+
+GlobalMapMerger::GlobalMapMerger(const Params& params,
+                                 const std::string& output_path)
+    : params_(params), output_path_(output_path) {
+  if (!output_path_.empty() && !std::filesystem::exists(output_path_)) {
+    BEAM_ERROR("Global map merger output path does not exist: {}",
+               output_path_);
+    throw std::invalid_argument{"invalid output path"};
+  }
+}
+
+std::vector<GlobalMapMerger::Candidate> GlobalMapMerger::FindCandidates(
+    const std::vector<std::shared_ptr<GlobalMap>>& maps) const {
+  std::shared_ptr<reloc::RelocCandidateSearchBase> candidate_search =
+      reloc::RelocCandidateSearchBase::Create(params_.candidate_search_config);
+  std::string candidate_search_path;
+  if (!output_path_.empty()) {
+    candidate_search_path =
+        beam::CombinePaths(output_path_, "candidate_search");
+    std::filesystem::create_directory(candidate_search_path);
+  }
+
+  std::vector<Candidate> candidates;
+  for (size_t query_map = 1; query_map < maps.size(); query_map++) {
+    const std::vector<SubmapPtr> query_submaps =
+        maps.at(query_map)->GetSubmaps();
+    for (size_t reference_map = 0; reference_map < query_map;
+         reference_map++) {
+      const std::vector<SubmapPtr> reference_submaps =
+          maps.at(reference_map)->GetSubmaps();
+      for (size_t query_submap = 0; query_submap < query_submaps.size();
+           query_submap++) {
+        std::vector<int> matched_indices;
+        std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
+        candidate_search->FindRelocCandidates(
+            reference_submaps, query_submaps.at(query_submap), matched_indices,
+            Ts_MATCH_QUERY, 0, candidate_search_path);
+        for (size_t i = 0; i < matched_indices.size(); i++) {
+          Candidate candidate;
+          candidate.reference_map = reference_map;
+          candidate.reference_submap = matched_indices.at(i);
+          candidate.query_map = query_map;
+          candidate.query_submap = query_submap;
+          candidate.T_REFERENCE_QUERY_EST = Ts_MATCH_QUERY.at(i);
+          candidates.push_back(candidate);
+        }
+      }
+      BEAM_INFO("Found {} candidates up to map {} queried against map {}",
+                candidates.size(), query_map, reference_map);
+    }
+  }
+  return candidates;
+}
+
+bool GlobalMapMerger::VerifyCandidates(
+    const std::vector<std::shared_ptr<GlobalMap>>& maps,
+    std::vector<Candidate>& candidates, size_t shard_index,
+    size_t num_shards) const {
+  if (num_shards == 0 || shard_index >= num_shards) {
+    BEAM_ERROR("Invalid shard {} of {} shards", shard_index, num_shards);
+    return false;
+  }
+
+  std::vector<std::vector<SubmapPtr>> submaps;
+  for (const auto& map : maps) { submaps.push_back(map->GetSubmaps()); }
+  std::vector<size_t> shard;
+  for (size_t i = shard_index; i < candidates.size(); i += num_shards) {
+    const Candidate& c = candidates.at(i);
+    if (c.reference_map >= submaps.size() || c.query_map >= submaps.size() ||
+        c.reference_submap >= submaps.at(c.reference_map).size() ||
+        c.query_submap >= submaps.at(c.query_map).size()) {
+      BEAM_ERROR("Candidate {} does not match the loaded maps", i);
+      return false;
+    }
+    shard.push_back(i);
+  }
+  if (shard.empty()) { return true; }
+
+  std::string refinement_path;
+  if (!output_path_.empty()) {
+    refinement_path = beam::CombinePaths(output_path_, "refinement");
+    std::filesystem::create_directory(refinement_path);
+  }
+
+  // each worker creates its refinement once since the matchers are not thread
+  // safe, then takes the next candidate until all are verified
+  bs_common::ThreadPool pool(static_cast<int>(
+      std::min<size_t>(std::max(params_.num_threads, 1), shard.size())));
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> num_successful{0};
+  pool.ParallelFor(pool.NumThreads(), [&](size_t) {
+    std::shared_ptr<reloc::RelocRefinementBase> refinement =
+        reloc::RelocRefinementBase::Create(params_.refinement_config);
+    for (size_t i = next++; i < shard.size(); i = next++) {
+      Candidate& c = candidates.at(shard.at(i));
+      const reloc::RelocRefinementResults results = refinement->RunRefinement(
+          submaps.at(c.reference_map).at(c.reference_submap),
+          submaps.at(c.query_map).at(c.query_submap), c.T_REFERENCE_QUERY_EST,
+          refinement_path);
+      c.verified = true;
+      c.successful = results.successful;
+      c.T_REFERENCE_QUERY = results.T_MATCH_QUERY;
+      if (c.successful) { num_successful++; }
+    }
+  });
+  BEAM_INFO("Verified {} candidates in shard {} of {}, {} successful",
+            shard.size(), shard_index, num_shards, num_successful.load());
+  return true;
+}
+
+std::shared_ptr<GlobalMap>
+    GlobalMapMerger::Merge(const std::vector<std::shared_ptr<GlobalMap>>& maps,
+                           const std::vector<Candidate>& candidates) const {
+  if (maps.empty()) {
+    BEAM_ERROR("No global maps to merge.");
+    return nullptr;
+  }
+  std::vector<std::vector<SubmapPtr>> submaps;
+  for (const auto& map : maps) { submaps.push_back(map->GetSubmaps()); }
+
+  // successful candidates of each map
+  std::vector<std::vector<const Candidate*>> map_candidates(maps.size());
+  for (const Candidate& c : candidates) {
+    if (!c.successful) { continue; }
+    if (c.reference_map >= maps.size() || c.query_map >= maps.size() ||
+        c.reference_submap >= submaps.at(c.reference_map).size() ||
+        c.query_submap >= submaps.at(c.query_map).size()) {
+      BEAM_ERROR("Invalid candidate between submap {} of map {} and submap {} "
+                 "of map {}",
+                 c.reference_submap, c.reference_map, c.query_submap,
+                 c.query_map);
+      return nullptr;
+    }
+    map_candidates.at(c.reference_map).push_back(&c);
+    map_candidates.at(c.query_map).push_back(&c);
+  }
+
+  // find the transform from the world frame of each map to the world frame of
+  // the first map, following the candidates from the first map
+  std::vector<std::optional<Eigen::Matrix4d>> Ts_WORLD_MAPWORLD(maps.size());
+  Ts_WORLD_MAPWORLD.at(0) = Eigen::Matrix4d::Identity();
+  std::queue<size_t> to_visit;
+  to_visit.push(0);
+  while (!to_visit.empty()) {
+    const size_t map_id = to_visit.front();
+    to_visit.pop();
+    for (const Candidate* c : map_candidates.at(map_id)) {
+      // T_REFWORLD_QUERYWORLD from the submap poses in their own world frame
+      const Eigen::Matrix4d T_REFWORLD_QUERYWORLD =
+          submaps.at(c->reference_map)
+                  .at(c->reference_submap)
+                  ->T_WORLD_SUBMAP() *
+          c->T_REFERENCE_QUERY *
+          beam::InvertTransform(
+              submaps.at(c->query_map).at(c->query_submap)->T_WORLD_SUBMAP());
+      if (c->reference_map == map_id && !Ts_WORLD_MAPWORLD.at(c->query_map)) {
+        Ts_WORLD_MAPWORLD.at(c->query_map) =
+            Ts_WORLD_MAPWORLD.at(map_id).value() * T_REFWORLD_QUERYWORLD;
+        to_visit.push(c->query_map);
+      } else if (c->query_map == map_id &&
+                 !Ts_WORLD_MAPWORLD.at(c->reference_map)) {
+        Ts_WORLD_MAPWORLD.at(c->reference_map) =
+            Ts_WORLD_MAPWORLD.at(map_id).value() *
+            beam::InvertTransform(T_REFWORLD_QUERYWORLD);
+        to_visit.push(c->reference_map);
+      }
+    }
+  }
+
+  // copy the submaps of all connected maps into the world frame of the first
+  std::vector<SubmapPtr> merged_submaps;
+  std::vector<size_t> session_starts;
+  std::vector<size_t> first_merged_id(maps.size(), 0);
+  std::set<ros::Time> stamps;
+  for (size_t map_id = 0; map_id < maps.size(); map_id++) {
+    if (!Ts_WORLD_MAPWORLD.at(map_id)) {
+      BEAM_WARN("Global map {} has no verified candidate connecting it to the "
+                "other maps, not merging it.",
+                map_id);
+      continue;
+    }
+    first_merged_id.at(map_id) = merged_submaps.size();
+    if (map_id > 0) { session_starts.push_back(merged_submaps.size()); }
+    for (const SubmapPtr& submap : submaps.at(map_id)) {
+      if (!stamps.insert(submap->Stamp()).second) {
+        BEAM_ERROR("Submaps of different maps have the same stamp {}s, cannot "
+                   "merge maps with submap pose variables that are not unique",
+                   submap->Stamp().toSec());
+        return nullptr;
+      }
+      auto merged_submap = std::make_shared<Submap>(*submap);
+      merged_submap->UpdatePose(Ts_WORLD_MAPWORLD.at(map_id).value() *
+                                submap->T_WORLD_SUBMAP());
+      merged_submaps.push_back(merged_submap);
+    }
+  }
+
+  std::vector<SubmapPoseGraphOptimization::LoopClosure> loop_closures;
+  for (const Candidate& c : candidates) {
+    if (!c.successful || !Ts_WORLD_MAPWORLD.at(c.reference_map) ||
+        !Ts_WORLD_MAPWORLD.at(c.query_map)) {
+      continue;
+    }
+    loop_closures.push_back(SubmapPoseGraphOptimization::LoopClosure{
+        first_merged_id.at(c.reference_map) + c.reference_submap,
+        first_merged_id.at(c.query_map) + c.query_submap, c.T_REFERENCE_QUERY});
+  }
+  BEAM_INFO("Merging {} submaps from {} sessions with {} loop closures",
+            merged_submaps.size(), session_starts.size() + 1,
+            loop_closures.size());
+
+  SubmapPoseGraphOptimization::Params pgo_params;
+  pgo_params.candidate_search_config = params_.candidate_search_config;
+  pgo_params.refinement_config = params_.refinement_config;
+  pgo_params.loop_closure_covariance = params_.loop_closure_covariance;
+  pgo_params.local_mapper_covariance = params_.local_mapper_covariance;
+  pgo_params.search_loop_closures = params_.search_loop_closures_on_union;
+  pgo_params.num_threads = params_.num_threads;
+  std::string pgo_path;
+  if (!output_path_.empty()) {
+    pgo_path = beam::CombinePaths(output_path_, "pose_graph_optimization");
+    std::filesystem::create_directory(pgo_path);
+  }
+  SubmapPoseGraphOptimization pgo(pgo_params, pgo_path);
+  pgo.SetSessionStarts(session_starts);
+  pgo.SetLoopClosures(loop_closures);
+  if (!pgo.Run(merged_submaps)) {
+    BEAM_ERROR("Pose graph optimization of the merged map failed.");
+    return nullptr;
+  }
+
+  auto merged_map = std::make_shared<GlobalMap>(
+      maps.at(0)->GetCameraModel(), maps.at(0)->GetExtrinsics(),
+      maps.at(0)->GetParamsMutable());
+  merged_map->SetSubmaps(merged_submaps);
+  return merged_map;
+}
+
+bool GlobalMapMerger::SaveCandidates(const std::string& filename,
+                                     const std::vector<std::string>& map_names,
+                                     const std::vector<Candidate>& candidates,
+                                     size_t shard_index, size_t num_shards) {
+  if (num_shards == 0 || shard_index >= num_shards) {
+    BEAM_ERROR("Invalid shard {} of {} shards", shard_index, num_shards);
+    return false;
+  }
+  std::vector<nlohmann::json> J_candidates;
+  for (size_t i = shard_index; i < candidates.size(); i += num_shards) {
+    const Candidate& c = candidates.at(i);
+    nlohmann::json J_candidate;
+    J_candidate["index"] = i;
+    J_candidate["reference_map"] = c.reference_map;
+    J_candidate["reference_submap"] = c.reference_submap;
+    J_candidate["query_map"] = c.query_map;
+    J_candidate["query_submap"] = c.query_submap;
+    J_candidate["verified"] = c.verified;
+    J_candidate["successful"] = c.successful;
+    beam::AddTransformToJson(J_candidate, c.T_REFERENCE_QUERY_EST,
+                             "T_REFERENCE_QUERY_EST");
+    beam::AddTransformToJson(J_candidate, c.T_REFERENCE_QUERY,
+                             "T_REFERENCE_QUERY");
+    J_candidates.push_back(J_candidate);
+  }
+  nlohmann::json J;
+  J["maps"] = map_names;
+  J["num_candidates"] = candidates.size();
+  J["candidates"] = J_candidates;
+
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    BEAM_ERROR("Cannot save candidates to: {}", filename);
+    return false;
+  }
+  file << std::setw(4) << J << std::endl;
+  return true;
+}
+
+bool GlobalMapMerger::LoadCandidates(const std::string& filename,
+                                     const std::vector<std::string>& map_names,
+                                     std::vector<Candidate>& candidates) {
+  nlohmann::json J;
+  if (!beam::ReadJson(filename, J)) {
+    BEAM_ERROR("Cannot read candidates file: {}", filename);
+    return false;
+  }
+  try {
+    if (J["maps"].get<std::vector<std::string>>() != map_names) {
+      BEAM_ERROR("Candidates in {} were found on different maps", filename);
+      return false;
+    }
+    const size_t num_candidates = J["num_candidates"];
+    if (candidates.empty()) { candidates.resize(num_candidates); }
+    if (candidates.size() != num_candidates) {
+      BEAM_ERROR("Candidates in {} are from a different candidate search",
+                 filename);
+      return false;
+    }
+    for (const auto& J_candidate : J["candidates"]) {
+      const size_t index = J_candidate["index"];
+      if (index >= num_candidates) {
+        throw std::out_of_range{"candidate index out of range"};
+      }
+      Candidate& c = candidates.at(index);
+      c.reference_map = J_candidate["reference_map"];
+      c.reference_submap = J_candidate["reference_submap"];
+      c.query_map = J_candidate["query_map"];
+      c.query_submap = J_candidate["query_submap"];
+      c.verified = J_candidate["verified"];
+      c.successful = J_candidate["successful"];
+      std::vector<double> T_est = J_candidate["T_REFERENCE_QUERY_EST"];
+      c.T_REFERENCE_QUERY_EST = beam::VectorToEigenTransform(T_est);
+      std::vector<double> T = J_candidate["T_REFERENCE_QUERY"];
+      c.T_REFERENCE_QUERY = beam::VectorToEigenTransform(T);
+    }
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Invalid candidates file {}: {}", filename, e.what());
+    return false;
+  }
+  return true;
+}
+
+} // namespace bs_models::global_mapping
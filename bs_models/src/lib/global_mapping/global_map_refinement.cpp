@@ -50,6 +50,41 @@ void GlobalMapRefinement::Params::LoadJson(const std::string& config_path) {
         bs_common::GetBeamSlamConfigPath(), refinement_config_rel);
   }
 
+  if (J_loop_closure.contains("num_threads")) {
+    submap_pgo.num_threads = J_loop_closure["num_threads"];
+    if (submap_pgo.num_threads < 1) {
+      BEAM_ERROR("loop_closure num_threads must be at least 1");
+      throw std::runtime_error{"invalid loop_closure num_threads"};
+    }
+  }
+
+  if (J_loop_closure.contains("sparsification")) {
+    auto J_sparsification = J_loop_closure["sparsification"];
+    auto& sparsification = submap_pgo.sparsification;
+    if (J_sparsification.contains("enabled")) {
+      sparsification.enabled = J_sparsification["enabled"];
+    }
+    if (J_sparsification.contains("merge_distance_m")) {
+      sparsification.merge_distance_m = J_sparsification["merge_distance_m"];
+    }
+    if (J_sparsification.contains("merge_rotation_deg")) {
+      sparsification.merge_rotation_deg =
+          J_sparsification["merge_rotation_deg"];
+    }
+    if (J_sparsification.contains("loop_closures_per_sparsification")) {
+      sparsification.loop_closures_per_sparsification =
+          J_sparsification["loop_closures_per_sparsification"];
+    }
+    if (sparsification.merge_distance_m < 0 ||
+        sparsification.merge_rotation_deg < 0 ||
+        sparsification.loop_closures_per_sparsification < 1) {
+      BEAM_ERROR("loop_closure sparsification merge thresholds must not be "
+                 "negative and loop_closures_per_sparsification must be at "
+                 "least 1");
+      throw std::runtime_error{"invalid loop_closure sparsification"};
+    }
+  }
+
   // load submap refinement params
   nlohmann::json J_submap_refinement = J["submap_refinement"];
   beam::ValidateJsonKeysOrThrow({"scan_registration_config", "matcher_config"},
@@ -68,6 +103,14 @@ void GlobalMapRefinement::Params::LoadJson(const std::string& config_path) {
         bs_common::GetBeamSlamConfigPath(), matcher_config_rel);
   }
 
+  if (J_submap_refinement.contains("num_threads")) {
+    submap_refinement.num_threads = J_submap_refinement["num_threads"];
+    if (submap_refinement.num_threads < 1) {
+      BEAM_ERROR("submap_refinement num_threads must be at least 1");
+      throw std::runtime_error{"invalid submap_refinement num_threads"};
+    }
+  }
+
   // load submap alignment params
   nlohmann::json J_submap_alignment = J["submap_alignment"];
   beam::ValidateJsonKeysOrThrow({"matcher_config"}, J_submap_alignment);
@@ -76,6 +119,17 @@ void GlobalMapRefinement::Params::LoadJson(const std::string& config_path) {
     submap_alignment.matcher_config = beam::CombinePaths(
         bs_common::GetBeamSlamConfigPath(), matcher_config_rel);
   }
+  if (J_submap_alignment.contains("num_threads")) {
+    submap_alignment.num_threads = J_submap_alignment["num_threads"];
+    if (submap_alignment.num_threads < 1) {
+      BEAM_ERROR("submap_alignment num_threads must be at least 1");
+      throw std::runtime_error{"invalid submap_alignment num_threads"};
+    }
+  }
+  if (J_submap_alignment.contains("pyramid_voxel_sizes")) {
+    submap_alignment.pyramid_voxel_sizes =
+        J_submap_alignment["pyramid_voxel_sizes"].get<std::vector<double>>();
+  }
 
   // load batch optimizer params
   nlohmann::json J_batch_optimizer = J["batch_optimizer"];
@@ -104,11 +158,56 @@ void GlobalMapRefinement::Params::LoadJson(const std::string& config_path) {
   batch.lc_scan_context_dist_thres =
       J_batch_optimizer["lc_scan_context_dist_thres"];
   batch.lc_cov_multiplier = J_batch_optimizer["lc_cov_multiplier"];
+  if (J_batch_optimizer.contains("optimization_window_scans")) {
+    batch.optimization_window_scans =
+        J_batch_optimizer["optimization_window_scans"];
+  }
+  if (J_batch_optimizer.contains("lc_num_threads")) {
+    batch.lc_num_threads = J_batch_optimizer["lc_num_threads"];
+    if (batch.lc_num_threads < 1) {
+      BEAM_ERROR("batch_optimizer lc_num_threads must be at least 1");
+      throw std::runtime_error{"invalid batch_optimizer lc_num_threads"};
+    }
+  }
 
   auto J_resize = J["submap_resize"];
   beam::ValidateJsonKeysOrThrow({"apply", "target_submap_length_m"}, J_resize);
   resize.apply = J_resize["apply"];
   resize.target_submap_length_m = J_resize["target_submap_length_m"];
+
+  if (J.contains("registration_cache")) {
+    auto J_cache = J["registration_cache"];
+    if (J_cache.contains("enabled")) {
+      registration_cache.enabled = J_cache["enabled"];
+    }
+    if (J_cache.contains("translation_resolution_m")) {
+      registration_cache.translation_resolution_m =
+          J_cache["translation_resolution_m"];
+    }
+    if (J_cache.contains("rotation_resolution_deg")) {
+      registration_cache.rotation_resolution_deg =
+          J_cache["rotation_resolution_deg"];
+    }
+    if (registration_cache.translation_resolution_m <= 0 ||
+        registration_cache.rotation_resolution_deg <= 0) {
+      BEAM_ERROR("registration_cache resolutions must be greater than 0");
+      throw std::runtime_error{"invalid registration_cache resolution"};
+    }
+  }
+
+  if (J.contains("streaming")) {
+    auto J_streaming = J["streaming"];
+    if (J_streaming.contains("enabled")) {
+      streaming.enabled = J_streaming["enabled"];
+    }
+    if (J_streaming.contains("memory_budget_mb")) {
+      streaming.memory_budget_mb = J_streaming["memory_budget_mb"];
+      if (streaming.memory_budget_mb <= 0) {
+        BEAM_ERROR("streaming memory_budget_mb must be greater than 0");
+        throw std::runtime_error{"invalid streaming memory_budget_mb"};
+      }
+    }
+  }
 }
 
 void GlobalMapRefinement::Summary::Save(const std::string& output_path) const {
@@ -135,6 +234,38 @@ void GlobalMapRefinement::Summary::Save(const std::string& output_path) const {
   }
   J["submap_alignment"] = J_submap_alignment;
 
+  nlohmann::json J_submap_pgo;
+  J_submap_pgo["num_queries"] = submap_pgo.num_queries;
+  J_submap_pgo["num_candidates"] = submap_pgo.num_candidates;
+  J_submap_pgo["num_successful"] = submap_pgo.num_successful;
+  J_submap_pgo["search_time_s"] = submap_pgo.search_time_s;
+  J_submap_pgo["refinement_time_s"] = submap_pgo.refinement_time_s;
+  J_submap_pgo["optimization_time_s"] = submap_pgo.optimization_time_s;
+  J_submap_pgo["num_merged_submaps"] = submap_pgo.num_merged_submaps;
+  J_submap_pgo["num_edges"] = submap_pgo.num_edges;
+  J_submap_pgo["sparsification_time_s"] = submap_pgo.sparsification_time_s;
+  std::vector<nlohmann::json> J_candidates;
+  for (const auto& candidate : submap_pgo.candidates) {
+    nlohmann::json J_candidate;
+    J_candidate["match_index"] = candidate.match_index;
+    J_candidate["query_index"] = candidate.query_index;
+    J_candidate["successful"] = candidate.successful;
+    J_candidate["coarse_overlap"] = candidate.coarse_overlap;
+    J_candidate["refinement_time_s"] = candidate.refinement_time_s;
+    J_candidates.push_back(J_candidate);
+  }
+  J_submap_pgo["candidates"] = J_candidates;
+  J["submap_pgo"] = J_submap_pgo;
+
+  nlohmann::json J_cache;
+  const size_t lookups = registration_cache_hits + registration_cache_misses;
+  J_cache["hits"] = registration_cache_hits;
+  J_cache["misses"] = registration_cache_misses;
+  J_cache["hit_rate"] =
+      lookups == 0 ? 0.0
+                   : static_cast<double>(registration_cache_hits) / lookups;
+  J["registration_cache"] = J_cache;
+
   std::string summary_path = beam::CombinePaths(output_path, "summary.json");
   std::ofstream file(summary_path);
   file << std::setw(4) << J << std::endl;
@@ -154,6 +285,40 @@ GlobalMapRefinement::GlobalMapRefinement(std::shared_ptr<GlobalMap>& global_map,
 }
 
 void GlobalMapRefinement::Initialize() {
+  const auto& cache_params = params_.registration_cache;
+  if (cache_params.enabled) {
+    registration_cache_ = std::make_shared<RegistrationCache>(
+        cache_params.translation_resolution_m,
+        cache_params.rotation_resolution_deg);
+    if (!cache_params.path.empty() &&
+        std::filesystem::exists(cache_params.path) &&
+        registration_cache_->Load(cache_params.path)) {
+      BEAM_INFO("Loaded {} registration results from: {}",
+                registration_cache_->Size(), cache_params.path);
+    }
+  }
+
+  if (params_.streaming.enabled) {
+    if (params_.resize.apply) {
+      BEAM_ERROR("Submap resizing is not supported when streaming, set "
+                 "submap_resize.apply to false.");
+      throw std::invalid_argument{"submap resizing not supported"};
+    }
+    if (!global_map_->MapStore()) {
+      BEAM_ERROR("Streaming requires a global map loaded from a map store "
+                 "without its lidar clouds.");
+      throw std::invalid_argument{"global map not loaded for streaming"};
+    }
+    working_set_ = std::make_shared<SubmapWorkingSet>(
+        global_map_->GetSubmaps(), global_map_->MapStore(),
+        static_cast<size_t>(params_.streaming.memory_budget_mb * 1e6));
+    global_map_->SetWorkingSet(working_set_);
+    BEAM_INFO("Streaming lidar clouds of {} submaps with a memory budget of "
+              "{} MB",
+              working_set_->Size(), params_.streaming.memory_budget_mb);
+    return;
+  }
+
   if (!params_.resize.apply) { return; }
   std::vector<SubmapPtr> submaps_init = global_map_->GetSubmaps();
   std::vector<SubmapPtr> submaps_new;
@@ -196,9 +361,12 @@ bool GlobalMapRefinement::RunSubmapRefinement(const std::string& output_path) {
         beam::CombinePaths(output_path, "trajectory_initial.pcd"));
   }
 
-  std::vector<SubmapPtr> submaps = global_map_->GetSubmaps();
   SubmapRefinement refinement(params_.submap_refinement, output_path);
-  refinement.Run(submaps);
+  if (!RunOnSubmapGroups(0, [&](const std::vector<SubmapPtr>& submaps) {
+        refinement.Run(submaps);
+      })) {
+    return false;
+  }
   summary_.submap_alignment = refinement.GetResults();
 
   if (!output_path.empty()) {
@@ -225,9 +393,17 @@ bool GlobalMapRefinement::RunSubmapAlignment(const std::string& output_path) {
         beam::CombinePaths(output_path, "trajectory_initial.pcd"));
   }
 
+  // each group starts with the last submap of the previous group, so the
+  // relative poses are chained through all submaps
   SubmapAlignment alignment(params_.submap_alignment, output_path);
-  alignment.Run(submaps);
+  alignment.SetRegistrationCache(registration_cache_);
+  if (!RunOnSubmapGroups(1, [&](const std::vector<SubmapPtr>& submaps) {
+        alignment.Run(submaps);
+      })) {
+    return false;
+  }
   summary_.submap_alignment = alignment.GetResults();
+  SaveRegistrationCache("submap alignment");
 
   if (!output_path.empty()) {
     global_map_->SaveTrajectoryClouds(output_path, false);
@@ -250,7 +426,12 @@ bool GlobalMapRefinement::RunPoseGraphOptimization(
 
   std::vector<SubmapPtr> submaps = global_map_->GetSubmaps();
   SubmapPoseGraphOptimization pgo(params_.submap_pgo, output_path);
+  pgo.SetWorkingSet(working_set_);
+  pgo.SetRegistrationCache(registration_cache_);
   pgo.Run(submaps);
+  summary_.submap_pgo = pgo.GetSummary();
+  SaveRegistrationCache("pose graph optimization");
+  if (working_set_) { working_set_->ReleaseAll(); }
 
   if (!output_path.empty()) {
     global_map_->SaveTrajectoryClouds(output_path, false);
@@ -272,7 +453,11 @@ bool GlobalMapRefinement::RunBatchOptimization(const std::string& output_path) {
 
   auto submaps = global_map_->GetSubmaps();
   GlobalMapBatchOptimization batch(params_.batch, output_path);
+  batch.SetWorkingSet(working_set_);
+  if (registration_cache_) { batch.SetRegistrationCache(registration_cache_); }
   batch.Run(submaps);
+  SaveRegistrationCache("batch optimization");
+  if (working_set_) { working_set_->ReleaseAll(); }
 
   // save final trajectory
   if (!output_path.empty()) {
@@ -285,6 +470,47 @@ bool GlobalMapRefinement::RunBatchOptimization(const std::string& output_path) {
   return true;
 }
 
+bool GlobalMapRefinement::RunOnSubmapGroups(
+    size_t overlap,
+    const std::function<void(const std::vector<SubmapPtr>&)>& step) {
+  const std::vector<SubmapPtr> submaps = global_map_->GetSubmaps();
+  if (!working_set_) {
+    step(submaps);
+    return true;
+  }
+
+  const auto groups = working_set_->Partition(overlap);
+  for (size_t i = 0; i < groups.size(); i++) {
+    BEAM_INFO("Loading submap group {}/{} with {} submaps", i + 1,
+              groups.size(), groups.at(i).size());
+    SubmapWorkingSet::Lease lease = working_set_->Acquire(groups.at(i));
+    if (!lease.Valid()) {
+      BEAM_ERROR("Cannot load lidar clouds of submap group {}", i + 1);
+      return false;
+    }
+    std::vector<SubmapPtr> group_submaps;
+    for (const size_t id : groups.at(i)) {
+      group_submaps.push_back(submaps.at(id));
+    }
+    step(group_submaps);
+  }
+  working_set_->ReleaseAll();
+  return true;
+}
+
+void GlobalMapRefinement::SaveRegistrationCache(const std::string& step) {
+  if (!registration_cache_) { return; }
+  summary_.registration_cache_hits = registration_cache_->Hits();
+  summary_.registration_cache_misses = registration_cache_->Misses();
+  BEAM_INFO("Registration cache after {}: {} results, {} hits, {} misses "
+            "({:.1f}% hit rate)",
+            step, registration_cache_->Size(), registration_cache_->Hits(),
+            registration_cache_->Misses(),
+            100 * registration_cache_->HitRate());
+  const std::string& path = params_.registration_cache.path;
+  if (!path.empty()) { registration_cache_->Save(path); }
+}
+
 void GlobalMapRefinement::SaveResults(const std::string& output_path,
                                       bool save_initial) {
   // create results directory
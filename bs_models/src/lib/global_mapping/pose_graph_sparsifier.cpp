@@ -0,0 +1,351 @@
+#include <bs_models/global_mapping/pose_graph_sparsifier.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <beam_utils/log.h>
+
+namespace bs_models::global_mapping {
+
+namespace {
+
+using Matrix6 = Eigen::Matrix<double, 6, 6>;
+using Vector6 = Eigen::Matrix<double, 6, 1>;
+
+constexpr double kJacobianStep = 1e-6;
+
+Eigen::Matrix3d ExpSO3(const Eigen::Vector3d& r) {
+  const double angle = r.norm();
+  if (angle < 1e-12) { return Eigen::Matrix3d::Identity(); }
+  return Eigen::AngleAxisd(angle, r / angle).toRotationMatrix();
+}
+
+Eigen::Vector3d LogSO3(const Eigen::Matrix3d& R) {
+  const Eigen::AngleAxisd aa(R);
+  return aa.angle() * aa.axis();
+}
+
+/** perturbation of a pose: world frame position, local orientation */
+Eigen::Matrix4d Perturb(const Eigen::Matrix4d& T, const Vector6& delta) {
+  Eigen::Matrix4d T_perturbed = T;
+  T_perturbed.block<3, 1>(0, 3) += delta.head<3>();
+  T_perturbed.block<3, 3>(0, 0) =
+      T.block<3, 3>(0, 0) * ExpSO3(delta.tail<3>());
+  return T_perturbed;
+}
+
+Eigen::Matrix4d Inverse(const Eigen::Matrix4d& T) {
+  Eigen::Matrix4d T_inv = Eigen::Matrix4d::Identity();
+  T_inv.block<3, 3>(0, 0) = T.block<3, 3>(0, 0).transpose();
+  T_inv.block<3, 1>(0, 3) =
+      -T.block<3, 3>(0, 0).transpose() * T.block<3, 1>(0, 3);
+  return T_inv;
+}
+
+Matrix6 InvertCovariance(const Matrix6& covariance) {
+  return covariance.ldlt().solve(Matrix6::Identity());
+}
+
+double LogDet(const Eigen::MatrixXd& covariance) {
+  const Eigen::LLT<Eigen::MatrixXd> llt(covariance);
+  return 2 * llt.matrixL().toDenseMatrix().diagonal().array().log().sum();
+}
+
+} // namespace
+
+PoseGraphSparsifier::PoseGraphSparsifier(const Params& params)
+    : params_(params) {}
+
+Eigen::Matrix<double, 6, 1>
+    PoseGraphSparsifier::Error(const Eigen::Matrix4d& T_WORLD_FROM,
+                               const Eigen::Matrix4d& T_WORLD_TO,
+                               const Eigen::Matrix4d& T_FROM_TO) {
+  const Eigen::Matrix4d T_FROM_TO_EST = Inverse(T_WORLD_FROM) * T_WORLD_TO;
+  Vector6 error;
+  error.head<3>() =
+      T_FROM_TO_EST.block<3, 1>(0, 3) - T_FROM_TO.block<3, 1>(0, 3);
+  error.tail<3>() = LogSO3(T_FROM_TO.block<3, 3>(0, 0).transpose() *
+                           T_FROM_TO_EST.block<3, 3>(0, 0));
+  return error;
+}
+
+void PoseGraphSparsifier::Jacobians(const Eigen::Matrix4d& T_WORLD_FROM,
+                                    const Eigen::Matrix4d& T_WORLD_TO,
+                                    const Eigen::Matrix4d& T_FROM_TO,
+                                    Matrix6& J_from, Matrix6& J_to) {
+  for (int i = 0; i < 6; i++) {
+    Vector6 delta = Vector6::Zero();
+    delta[i] = kJacobianStep;
+    J_from.col(i) = (Error(Perturb(T_WORLD_FROM, delta), T_WORLD_TO,
+                           T_FROM_TO) -
+                     Error(Perturb(T_WORLD_FROM, -delta), T_WORLD_TO,
+                           T_FROM_TO)) /
+                    (2 * kJacobianStep);
+    J_to.col(i) = (Error(T_WORLD_FROM, Perturb(T_WORLD_TO, delta),
+                         T_FROM_TO) -
+                   Error(T_WORLD_FROM, Perturb(T_WORLD_TO, -delta),
+                         T_FROM_TO)) /
+                  (2 * kJacobianStep);
+  }
+}
+
+size_t PoseGraphSparsifier::Sparsify(const Poses& Ts_WORLD_NODE,
+                                     const std::set<size_t>& fixed_nodes,
+                                     std::vector<Edge>& edges,
+                                     std::map<size_t, Merge>& merged) const {
+  std::set<size_t> nodes;
+  for (const Edge& edge : edges) {
+    if (edge.from >= Ts_WORLD_NODE.size() || edge.to >= Ts_WORLD_NODE.size()) {
+      BEAM_ERROR("Pose graph edge between nodes {} and {}, but only {} poses",
+                 edge.from, edge.to, Ts_WORLD_NODE.size());
+      throw std::invalid_argument{"invalid pose graph edge"};
+    }
+    nodes.insert(edge.from);
+    nodes.insert(edge.to);
+  }
+
+  size_t num_merged = 0;
+  for (const size_t node : nodes) {
+    if (fixed_nodes.count(node) > 0 || merged.count(node) > 0) { continue; }
+    size_t kept;
+    if (!FindKeptNode(node, Ts_WORLD_NODE, edges, merged, kept)) { continue; }
+
+    const Eigen::Matrix4d T_KEPT_MERGED =
+        Inverse(Ts_WORLD_NODE.at(kept)) * Ts_WORLD_NODE.at(node);
+    MarginalizeNode(node, Ts_WORLD_NODE, edges);
+    for (auto& [id, merge] : merged) {
+      if (merge.kept != node) { continue; }
+      merge.kept = kept;
+      merge.T_KEPT_MERGED = T_KEPT_MERGED * merge.T_KEPT_MERGED;
+    }
+    merged.emplace(node, Merge{kept, T_KEPT_MERGED});
+    num_merged++;
+  }
+  CombineParallelEdges(Ts_WORLD_NODE, edges);
+  return num_merged;
+}
+
+bool PoseGraphSparsifier::FindKeptNode(size_t node, const Poses& Ts_WORLD_NODE,
+                                       const std::vector<Edge>& edges,
+                                       const std::map<size_t, Merge>& merged,
+                                       size_t& kept) const {
+  const Eigen::Matrix4d& T_WORLD_NODE = Ts_WORLD_NODE.at(node);
+  const double max_angle = params_.merge_rotation_deg * M_PI / 180;
+  double min_distance = std::numeric_limits<double>::max();
+  for (const Edge& edge : edges) {
+    if (edge.from != node && edge.to != node) { continue; }
+    const size_t other = edge.from == node ? edge.to : edge.from;
+
+    // consecutive submaps are connected by the local mapper, only revisits
+    // are merged
+    if (other + 1 >= node || merged.count(other) > 0) { continue; }
+    const Eigen::Matrix4d& T_WORLD_OTHER = Ts_WORLD_NODE.at(other);
+    const double distance =
+        (T_WORLD_NODE.block<3, 1>(0, 3) - T_WORLD_OTHER.block<3, 1>(0, 3))
+            .norm();
+    const double angle =
+        Eigen::AngleAxisd(T_WORLD_OTHER.block<3, 3>(0, 0).transpose() *
+                          T_WORLD_NODE.block<3, 3>(0, 0))
+            .angle();
+    if (distance > params_.merge_distance_m || angle > max_angle ||
+        distance >= min_distance) {
+      continue;
+    }
+    min_distance = distance;
+    kept = other;
+  }
+  return min_distance < std::numeric_limits<double>::max();
+}
+
+void PoseGraphSparsifier::MarginalizeNode(size_t node,
+                                          const Poses& Ts_WORLD_NODE,
+                                          std::vector<Edge>& edges) {
+  // remove the edges to the node, and find its neighbours
+  std::vector<Edge> node_edges;
+  std::vector<size_t> neighbours;
+  auto iter = edges.begin();
+  while (iter != edges.end()) {
+    if (iter->from != node && iter->to != node) {
+      iter++;
+      continue;
+    }
+    const size_t other = iter->from == node ? iter->to : iter->from;
+    if (other != node &&
+        std::find(neighbours.begin(), neighbours.end(), other) ==
+            neighbours.end()) {
+      neighbours.push_back(other);
+    }
+    node_edges.push_back(*iter);
+    iter = edges.erase(iter);
+  }
+  // without at least two neighbours the node carries no information on the
+  // rest of the graph
+  if (neighbours.size() < 2) { return; }
+  std::sort(neighbours.begin(), neighbours.end());
+
+  // information of the clique, the node is block 0
+  const size_t m = neighbours.size();
+  auto block = [&](size_t id) -> size_t {
+    if (id == node) { return 0; }
+    return 6 * (1 + std::lower_bound(neighbours.begin(), neighbours.end(), id) -
+                neighbours.begin());
+  };
+  Eigen::MatrixXd H = Eigen::MatrixXd::Zero(6 * (m + 1), 6 * (m + 1));
+  for (const Edge& edge : node_edges) {
+    if (edge.from == edge.to) { continue; }
+    Matrix6 J_from, J_to;
+    Jacobians(Ts_WORLD_NODE.at(edge.from), Ts_WORLD_NODE.at(edge.to),
+              edge.T_FROM_TO, J_from, J_to);
+    const Matrix6 information = InvertCovariance(edge.covariance);
+    const size_t f = block(edge.from);
+    const size_t t = block(edge.to);
+    H.block<6, 6>(f, f) += J_from.transpose() * information * J_from;
+    H.block<6, 6>(f, t) += J_from.transpose() * information * J_to;
+    H.block<6, 6>(t, f) += J_to.transpose() * information * J_from;
+    H.block<6, 6>(t, t) += J_to.transpose() * information * J_to;
+  }
+
+  // marginalize the node, then condition on the first neighbour (the root)
+  // which removes the gauge freedom of the clique
+  const size_t n = 6 * m;
+  const Eigen::MatrixXd H_clique =
+      H.bottomRightCorner(n, n) -
+      H.bottomLeftCorner(n, 6) *
+          H.topLeftCorner(6, 6).ldlt().solve(H.topRightCorner(6, n));
+  const Eigen::MatrixXd H_conditioned =
+      H_clique.bottomRightCorner(n - 6, n - 6);
+  const Eigen::MatrixXd covariance = H_conditioned.ldlt().solve(
+      Eigen::MatrixXd::Identity(n - 6, n - 6));
+
+  // Chow-Liu tree over the other neighbours, i.e. the max spanning tree of
+  // their mutual information (Prim). Neighbour k is block k - 1
+  auto joint = [&](size_t a, size_t b) {
+    Eigen::MatrixXd joint_covariance(12, 12);
+    joint_covariance << covariance.block<6, 6>(6 * (a - 1), 6 * (a - 1)),
+        covariance.block<6, 6>(6 * (a - 1), 6 * (b - 1)),
+        covariance.block<6, 6>(6 * (b - 1), 6 * (a - 1)),
+        covariance.block<6, 6>(6 * (b - 1), 6 * (b - 1));
+    return joint_covariance;
+  };
+  std::vector<double> log_dets(m, 0);
+  for (size_t k = 1; k < m; k++) {
+    log_dets[k] = LogDet(covariance.block<6, 6>(6 * (k - 1), 6 * (k - 1)));
+  }
+  std::vector<bool> in_tree(m, false);
+  std::vector<size_t> parent(m, 1);
+  std::vector<double> best_information(m,
+                                       -std::numeric_limits<double>::max());
+  in_tree[1] = true;
+  size_t last_added = 1;
+  for (size_t num_in_tree = 1; num_in_tree + 1 < m; num_in_tree++) {
+    size_t next = 0;
+    for (size_t k = 2; k < m; k++) {
+      if (in_tree[k]) { continue; }
+      const double information =
+          0.5 * (log_dets[k] + log_dets[last_added] -
+                 LogDet(joint(last_added, k)));
+      if (information > best_information[k]) {
+        best_information[k] = information;
+        parent[k] = last_added;
+      }
+      if (next == 0 || best_information[k] > best_information[next]) {
+        next = k;
+      }
+    }
+    in_tree[next] = true;
+    last_added = next;
+  }
+
+  // add the marginal of each tree edge as a relative pose, the first
+  // neighbour in the tree is connected to the root
+  auto add_edge = [&](size_t from, size_t to) {
+    Edge edge;
+    edge.from = neighbours[from];
+    edge.to = neighbours[to];
+    const Eigen::Matrix4d& T_WORLD_FROM = Ts_WORLD_NODE.at(edge.from);
+    const Eigen::Matrix4d& T_WORLD_TO = Ts_WORLD_NODE.at(edge.to);
+    edge.T_FROM_TO = Inverse(T_WORLD_FROM) * T_WORLD_TO;
+    Matrix6 J_from, J_to;
+    Jacobians(T_WORLD_FROM, T_WORLD_TO, edge.T_FROM_TO, J_from, J_to);
+    Matrix6 relative_covariance;
+    if (from == 0) {
+      relative_covariance =
+          J_to * covariance.block<6, 6>(6 * (to - 1), 6 * (to - 1)) *
+          J_to.transpose();
+    } else {
+      Eigen::Matrix<double, 6, 12> J;
+      J << J_from, J_to;
+      relative_covariance = J * joint(from, to) * J.transpose();
+    }
+    edge.covariance =
+        0.5 * (relative_covariance + relative_covariance.transpose());
+    edges.push_back(edge);
+  };
+  add_edge(0, 1);
+  for (size_t k = 2; k < m; k++) { add_edge(parent[k], k); }
+}
+
+void PoseGraphSparsifier::CombineParallelEdges(const Poses& Ts_WORLD_NODE,
+                                               std::vector<Edge>& edges) {
+  std::map<std::pair<size_t, size_t>, std::vector<size_t>> groups;
+  std::vector<std::pair<size_t, size_t>> order;
+  for (size_t i = 0; i < edges.size(); i++) {
+    const auto key = std::minmax(edges[i].from, edges[i].to);
+    auto& group = groups[key];
+    if (group.empty()) { order.push_back(key); }
+    group.push_back(i);
+  }
+  if (order.size() == edges.size()) { return; }
+
+  // the combined edge has the same information on the second node, and the
+  // same gradient, at the current poses. The information on the first node
+  // follows as both are relative pose errors
+  std::vector<Edge> combined;
+  for (const auto& key : order) {
+    const std::vector<size_t>& group = groups.at(key);
+    if (group.size() == 1) {
+      combined.push_back(edges[group.front()]);
+      continue;
+    }
+    const auto [a, b] = key;
+    Matrix6 H_b = Matrix6::Zero();
+    Vector6 g_b = Vector6::Zero();
+    for (const size_t i : group) {
+      const Edge& edge = edges[i];
+      const Eigen::Matrix4d& T_WORLD_FROM = Ts_WORLD_NODE.at(edge.from);
+      const Eigen::Matrix4d& T_WORLD_TO = Ts_WORLD_NODE.at(edge.to);
+      Matrix6 J_from, J_to;
+      Jacobians(T_WORLD_FROM, T_WORLD_TO, edge.T_FROM_TO, J_from, J_to);
+      const Matrix6& J_b = edge.to == b ? J_to : J_from;
+      const Matrix6 information = InvertCovariance(edge.covariance);
+      H_b += J_b.transpose() * information * J_b;
+      g_b += J_b.transpose() * information *
+             Error(T_WORLD_FROM, T_WORLD_TO, edge.T_FROM_TO);
+    }
+
+    Edge edge;
+    edge.from = a;
+    edge.to = b;
+    const Eigen::Matrix4d T_FROM_TO_EST =
+        Inverse(Ts_WORLD_NODE.at(a)) * Ts_WORLD_NODE.at(b);
+    Matrix6 J_from, J_to;
+    Jacobians(Ts_WORLD_NODE.at(a), Ts_WORLD_NODE.at(b), T_FROM_TO_EST, J_from,
+              J_to);
+    const Matrix6 H_b_inv = InvertCovariance(H_b);
+    const Matrix6 covariance = J_to * H_b_inv * J_to.transpose();
+    edge.covariance = 0.5 * (covariance + covariance.transpose());
+    const Vector6 error = J_to * H_b_inv * g_b;
+
+    // measurement with this error at the current poses
+    edge.T_FROM_TO = T_FROM_TO_EST;
+    edge.T_FROM_TO.block<3, 1>(0, 3) -= error.head<3>();
+    edge.T_FROM_TO.block<3, 3>(0, 0) =
+        T_FROM_TO_EST.block<3, 3>(0, 0) * ExpSO3(-error.tail<3>());
+    combined.push_back(edge);
+  }
+  edges = std::move(combined);
+}
+
+} // namespace bs_models::global_mapping
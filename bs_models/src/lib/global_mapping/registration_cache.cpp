@@ -0,0 +1,218 @@
+#include <bs_models/global_mapping/registration_cache.h>
+
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <tuple>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/chunk_file.h>
+
+namespace bs_models::global_mapping {
+
+namespace {
+
+// file version, increase if the format changes
+constexpr uint32_t kCacheVersion = 1;
+
+// 64 bit FNV-1a
+constexpr uint64_t kHashSeed = 14695981039346656037ULL;
+
+uint64_t Hash(const void* data, size_t size, uint64_t hash = kHashSeed) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+template <typename T>
+uint64_t HashValue(const T& value, uint64_t hash) {
+  return Hash(&value, sizeof(T), hash);
+}
+
+} // namespace
+
+bool RegistrationCache::Key::operator<(const Key& other) const {
+  return std::tie(context, reference, target, initial_guess) <
+         std::tie(other.context, other.reference, other.target,
+                  other.initial_guess);
+}
+
+RegistrationCache::RegistrationCache(double translation_resolution_m,
+                                     double rotation_resolution_deg)
+    : translation_resolution_m_(translation_resolution_m),
+      rotation_resolution_rad_(rotation_resolution_deg * M_PI / 180) {
+  if (translation_resolution_m_ <= 0 || rotation_resolution_rad_ <= 0) {
+    BEAM_ERROR("Registration cache resolutions must be greater than 0");
+    throw std::invalid_argument{"invalid registration cache resolution"};
+  }
+}
+
+uint64_t RegistrationCache::ContextId(const std::string& stage,
+                                      const std::string& config_path) {
+  uint64_t hash = Hash(stage.data(), stage.size());
+  if (config_path.empty()) { return hash; }
+  std::ifstream file(config_path);
+  std::stringstream config;
+  config << file.rdbuf();
+  const std::string contents = config.str();
+  return Hash(contents.data(), contents.size(), hash);
+}
+
+uint64_t RegistrationCache::ScanId(const ros::Time& stamp) {
+  return HashValue(stamp.toNSec(), kHashSeed);
+}
+
+uint64_t RegistrationCache::SubmapId(const Submap& submap) const {
+  uint64_t hash = kHashSeed;
+  for (const auto& [stamp, scan_pose] : submap.LidarKeyframes()) {
+    hash = HashValue(stamp, hash);
+    const Key key = MakeKey(0, 0, 0, scan_pose.T_REFFRAME_BASELINK());
+    hash = Hash(key.initial_guess.data(), sizeof(key.initial_guess), hash);
+  }
+  return hash;
+}
+
+RegistrationCache::Key RegistrationCache::MakeKey(
+    uint64_t context, uint64_t reference, uint64_t target,
+    const Eigen::Matrix4d& T_REFERENCE_TARGET_init) const {
+  Key key;
+  key.context = context;
+  key.reference = reference;
+  key.target = target;
+  const Eigen::AngleAxisd aa(Eigen::Matrix3d(
+      T_REFERENCE_TARGET_init.block<3, 3>(0, 0)));
+  const Eigen::Vector3d r = aa.angle() * aa.axis();
+  for (int i = 0; i < 3; i++) {
+    key.initial_guess[i] = std::llround(T_REFERENCE_TARGET_init(i, 3) /
+                                        translation_resolution_m_);
+    key.initial_guess[i + 3] = std::llround(r[i] / rotation_resolution_rad_);
+  }
+  return key;
+}
+
+bool RegistrationCache::Find(const Key& key, Result& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = results_.find(key);
+  if (iter == results_.end()) {
+    misses_++;
+    return false;
+  }
+  hits_++;
+  result = iter->second;
+  return true;
+}
+
+void RegistrationCache::Insert(const Key& key, const Result& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  results_[key] = result;
+}
+
+bool RegistrationCache::Load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    BEAM_ERROR("Unable to open registration cache: {}", path);
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+
+  std::map<Key, Result> results;
+  try {
+    bs_common::ByteReader reader(data.data(), data.size());
+    if (reader.Read<uint32_t>() != kCacheVersion) {
+      BEAM_ERROR("Unsupported registration cache version: {}", path);
+      return false;
+    }
+    const double translation_resolution_m = reader.Read<double>();
+    const double rotation_resolution_rad = reader.Read<double>();
+    if (translation_resolution_m != translation_resolution_m_ ||
+        rotation_resolution_rad != rotation_resolution_rad_) {
+      BEAM_WARN("Registration cache {} was saved with other resolutions, not "
+                "loading it",
+                path);
+      return false;
+    }
+    const uint64_t size = reader.Read<uint64_t>();
+    for (uint64_t i = 0; i < size; i++) {
+      Key key;
+      key.context = reader.Read<uint64_t>();
+      key.reference = reader.Read<uint64_t>();
+      key.target = reader.Read<uint64_t>();
+      for (int64_t& q : key.initial_guess) { q = reader.Read<int64_t>(); }
+      Result result;
+      result.successful = reader.Read<uint8_t>() != 0;
+      reader.ReadMatrix(result.T_REFERENCE_TARGET);
+      if (reader.Read<uint8_t>() != 0) {
+        Eigen::Matrix<double, 6, 6> covariance;
+        reader.ReadMatrix(covariance);
+        result.covariance = covariance;
+      }
+      results.emplace(key, result);
+    }
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Cannot read registration cache {}: {}", path, e.what());
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  results_.insert(results.begin(), results.end());
+  return true;
+}
+
+bool RegistrationCache::Save(const std::string& path) const {
+  bs_common::ByteWriter writer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    writer.Write<uint32_t>(kCacheVersion);
+    writer.Write<double>(translation_resolution_m_);
+    writer.Write<double>(rotation_resolution_rad_);
+    writer.Write<uint64_t>(results_.size());
+    for (const auto& [key, result] : results_) {
+      writer.Write<uint64_t>(key.context);
+      writer.Write<uint64_t>(key.reference);
+      writer.Write<uint64_t>(key.target);
+      for (const int64_t q : key.initial_guess) { writer.Write<int64_t>(q); }
+      writer.Write<uint8_t>(result.successful);
+      writer.WriteMatrix(result.T_REFERENCE_TARGET);
+      writer.Write<uint8_t>(result.covariance.has_value());
+      if (result.covariance) { writer.WriteMatrix(*result.covariance); }
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(writer.Data().data()),
+             writer.Size());
+  if (!file) {
+    BEAM_ERROR("Unable to write registration cache to: {}", path);
+    return false;
+  }
+  return true;
+}
+
+size_t RegistrationCache::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return results_.size();
+}
+
+size_t RegistrationCache::Hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+size_t RegistrationCache::Misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+double RegistrationCache::HitRate() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t lookups = hits_ + misses_;
+  return lookups == 0 ? 0 : static_cast<double>(hits_) / lookups;
+}
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,265 @@
+#include <bs_models/global_mapping/reloc_server.h>
+
+#include <algorithm>
+#include <optional>
+
+#include <beam_utils/log.h>
+
+namespace bs_models::global_mapping {
+
+void RelocServer::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("num_workers")) { num_workers = J["num_workers"]; }
+  if (J.contains("max_queued_requests")) {
+    max_queued_requests = J["max_queued_requests"];
+  }
+  if (J.contains("deadline_s")) { deadline_s = J["deadline_s"]; }
+  if (num_workers < 1 || max_queued_requests < 1 || deadline_s < 0) {
+    BEAM_ERROR("Reloc server num_workers and max_queued_requests must be at "
+               "least 1, and deadline_s must not be negative");
+    throw std::invalid_argument{"invalid reloc server params"};
+  }
+}
+
+nlohmann::json RelocServer::Params::ToJson() const {
+  return nlohmann::json{{"enabled", enabled},
+                        {"num_workers", num_workers},
+                        {"max_queued_requests", max_queued_requests},
+                        {"deadline_s", deadline_s}};
+}
+
+RelocServer::RelocServer(
+    const Params& params, const std::string& candidate_search_config,
+    const std::string& refinement_config,
+    const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
+    const std::shared_ptr<bs_common::ExtrinsicsLookupBase>& extrinsics)
+    : params_(params), camera_model_(camera_model), extrinsics_(extrinsics) {
+  if (params_.num_workers < 1 || params_.max_queued_requests < 1) {
+    BEAM_ERROR("Reloc server needs at least one worker and one queued request");
+    throw std::invalid_argument{"invalid reloc server params"};
+  }
+  for (int i = 0; i < params_.num_workers; i++) {
+    auto worker = std::make_unique<Worker>();
+    worker->candidate_search =
+        reloc::RelocCandidateSearchBase::Create(candidate_search_config);
+    worker->refinement = reloc::RelocRefinementBase::Create(refinement_config);
+    workers_.push_back(std::move(worker));
+  }
+  // only start the threads once all workers are created, so a failing factory
+  // does not leave running threads behind
+  for (auto& worker : workers_) {
+    worker->thread = std::thread([this, &w = *worker]() { WorkerLoop(w); });
+  }
+}
+
+RelocServer::~RelocServer() {
+  Stop();
+}
+
+void RelocServer::SetResponseCallback(const ResponseCallback& callback) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  response_callback_ = callback;
+}
+
+void RelocServer::AddSubmap(int submap_id, const SubmapPtr& submap) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (stop_) { return; }
+    submaps_to_prepare_.push_back(QueuedSubmap{submap_id, submap});
+  }
+  queue_cv_.notify_one();
+}
+
+void RelocServer::UpdateSubmapPoses(
+    const std::vector<Eigen::Matrix4d, beam::AlignMat4d>& Ts_WORLD_SUBMAP) {
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  if (Ts_WORLD_SUBMAP_.size() < Ts_WORLD_SUBMAP.size()) {
+    Ts_WORLD_SUBMAP_.resize(Ts_WORLD_SUBMAP.size(),
+                            Eigen::Matrix4d::Identity());
+  }
+  std::copy(Ts_WORLD_SUBMAP.begin(), Ts_WORLD_SUBMAP.end(),
+            Ts_WORLD_SUBMAP_.begin());
+
+  // the submaps are shared with the previous snapshot, only the poses change
+  auto snapshot = std::make_shared<Snapshot>(*snapshot_);
+  for (size_t i = 0; i < snapshot->submap_ids.size(); i++) {
+    const size_t id = snapshot->submap_ids[i];
+    if (id < Ts_WORLD_SUBMAP.size()) {
+      snapshot->Ts_WORLD_SUBMAP[i] = Ts_WORLD_SUBMAP[id];
+    }
+  }
+  snapshot_ = std::move(snapshot);
+}
+
+bool RelocServer::Submit(Request&& request) {
+  std::vector<Response> dropped;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (stop_) { return false; }
+    while (requests_.size() >=
+           static_cast<size_t>(params_.max_queued_requests)) {
+      Response response;
+      response.stamp = requests_.front().request.stamp;
+      dropped.push_back(response);
+      requests_.pop_front();
+    }
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(params_.deadline_s));
+    requests_.push_back(QueuedRequest{std::move(request), deadline});
+  }
+  queue_cv_.notify_one();
+
+  for (const Response& response : dropped) {
+    BEAM_WARN("Reloc server queue is full, dropping request {}",
+              response.stamp.toSec());
+    SendResponse(response);
+  }
+  return true;
+}
+
+size_t RelocServer::NumSubmaps() const {
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  return snapshot_->submaps.size();
+}
+
+void RelocServer::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (stop_) { return; }
+    stop_ = true;
+    requests_.clear();
+    submaps_to_prepare_.clear();
+  }
+  queue_cv_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) { worker->thread.join(); }
+  }
+}
+
+void RelocServer::WorkerLoop(Worker& worker) {
+  while (true) {
+    std::optional<QueuedRequest> queued_request;
+    std::optional<QueuedSubmap> queued_submap;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cv_.wait(lock, [this]() {
+        return stop_ || !requests_.empty() || !submaps_to_prepare_.empty();
+      });
+      if (stop_) { return; }
+
+      // requests have deadlines, so they go before new submaps
+      if (!requests_.empty()) {
+        queued_request = std::move(requests_.front());
+        requests_.pop_front();
+      } else {
+        queued_submap = std::move(submaps_to_prepare_.front());
+        submaps_to_prepare_.pop_front();
+      }
+    }
+
+    if (queued_submap) {
+      PrepareSubmap(worker, std::move(*queued_submap));
+    } else {
+      SendResponse(Relocalize(worker, *queued_request));
+    }
+  }
+}
+
+void RelocServer::PrepareSubmap(Worker& worker, QueuedSubmap&& queued_submap) {
+  worker.candidate_search->PrepareSubmap(queued_submap.submap);
+
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  auto snapshot = std::make_shared<Snapshot>(*snapshot_);
+  const auto iter =
+      std::lower_bound(snapshot->submap_ids.begin(),
+                       snapshot->submap_ids.end(), queued_submap.submap_id);
+  const size_t i = iter - snapshot->submap_ids.begin();
+  const Eigen::Matrix4d T_WORLD_SUBMAP =
+      static_cast<size_t>(queued_submap.submap_id) < Ts_WORLD_SUBMAP_.size()
+          ? Ts_WORLD_SUBMAP_[queued_submap.submap_id]
+          : queued_submap.submap->T_WORLD_SUBMAP();
+  if (iter != snapshot->submap_ids.end() &&
+      *iter == queued_submap.submap_id) {
+    snapshot->submaps[i] = queued_submap.submap;
+    snapshot->Ts_WORLD_SUBMAP[i] = T_WORLD_SUBMAP;
+  } else {
+    snapshot->submap_ids.insert(iter, queued_submap.submap_id);
+    snapshot->submaps.insert(snapshot->submaps.begin() + i,
+                             queued_submap.submap);
+    snapshot->Ts_WORLD_SUBMAP.insert(snapshot->Ts_WORLD_SUBMAP.begin() + i,
+                                     T_WORLD_SUBMAP);
+  }
+  snapshot_ = std::move(snapshot);
+}
+
+RelocServer::Response RelocServer::Relocalize(
+    Worker& worker, const QueuedRequest& queued_request) {
+  const Request& request = queued_request.request;
+  Response response;
+  response.stamp = request.stamp;
+  auto expired = [&queued_request]() {
+    return std::chrono::steady_clock::now() > queued_request.deadline;
+  };
+  if (expired()) {
+    BEAM_WARN("Reloc request {} expired before it was processed",
+              request.stamp.toSec());
+    return response;
+  }
+
+  std::shared_ptr<const Snapshot> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    snapshot = snapshot_;
+  }
+  if (snapshot->submaps.empty()) { return response; }
+
+  // the query submap only has the scan, at the origin of the submap
+  auto query_submap = std::make_shared<Submap>(
+      request.stamp, request.T_WORLD_BASELINK, camera_model_, extrinsics_);
+  if (!request.cloud.empty()) {
+    query_submap->AddLidarMeasurement(request.cloud, request.T_WORLD_BASELINK,
+                                      request.stamp);
+  }
+  if (request.loam_cloud.Size() > 0) {
+    query_submap->AddLidarMeasurement(request.loam_cloud,
+                                      request.T_WORLD_BASELINK, request.stamp);
+  }
+  worker.candidate_search->PrepareSubmap(query_submap);
+
+  std::vector<int> matched_indices;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
+  worker.candidate_search->FindRelocCandidates(
+      snapshot->submaps, query_submap, matched_indices, Ts_MATCH_QUERY, 0);
+
+  // candidates are ordered by likelihood, so use the first accepted one
+  for (size_t i = 0; i < matched_indices.size(); i++) {
+    if (expired()) {
+      BEAM_WARN("Reloc request {} expired after {} refinements",
+                request.stamp.toSec(), i);
+      return response;
+    }
+    const size_t index = matched_indices[i];
+    const reloc::RelocRefinementResults results =
+        worker.refinement->RunRefinement(snapshot->submaps.at(index),
+                                         query_submap, Ts_MATCH_QUERY[i]);
+    if (!results.successful) { continue; }
+
+    // the submap copies keep the pose they had when they were added, so use
+    // the latest one
+    response.successful = true;
+    response.submap_id = snapshot->submap_ids[index];
+    response.T_WORLD_BASELINK =
+        snapshot->Ts_WORLD_SUBMAP[index] * results.T_MATCH_QUERY;
+    return response;
+  }
+  return response;
+}
+
+void RelocServer::SendResponse(const Response& response) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  if (response_callback_) { response_callback_(response); }
+}
+
+} // namespace bs_models::global_mapping
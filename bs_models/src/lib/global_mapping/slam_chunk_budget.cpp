@@ -0,0 +1,154 @@
+#include <bs_models/global_mapping/slam_chunk_budget.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <opencv2/imgcodecs.hpp>
+#include <ros/console.h>
+#include <ros/serialization.h>
+
+#include <beam_cv/OpenCVConversions.h>
+
+namespace bs_models::global_mapping {
+
+SlamChunkBudget::SlamChunkBudget(const Params& params) : params_(params) {
+  if (params_.min_jpeg_quality < 1 || params_.jpeg_quality > 100 ||
+      params_.min_jpeg_quality > params_.jpeg_quality) {
+    ROS_ERROR("Slam chunk JPEG qualities must be in [1, 100], with "
+              "min_jpeg_quality <= jpeg_quality.");
+    throw std::invalid_argument{"invalid slam chunk jpeg quality"};
+  }
+  if (params_.quality_step < 1) {
+    ROS_ERROR("Slam chunk quality_step must be positive.");
+    throw std::invalid_argument{"invalid slam chunk quality step"};
+  }
+  bytes_per_s_ = std::max(params_.budget_kbps, 0.0) * 1000 / 8;
+  burst_bytes_ = bytes_per_s_ * std::max(params_.burst_s, 0.0);
+  Reset();
+}
+
+SlamChunkBudget::Level SlamChunkBudget::Fit(bs_common::SlamChunkMsg& chunk,
+                                            const ros::Time& now) {
+  Refill(now);
+
+  // the raw image is never sent
+  bs_common::CameraMeasurementMsg& camera = chunk.camera_measurement;
+  sensor_msgs::Image image;
+  std::swap(image, camera.image);
+
+  // trackers subscribed to compressed images only forward those, decode them
+  // so that they can be recompressed at the quality that fits the budget
+  if (image.data.empty() && !camera.compressed_image.data.empty()) {
+    const cv::Mat mat =
+        cv::imdecode(camera.compressed_image.data, cv::IMREAD_UNCHANGED);
+    if (!mat.empty()) {
+      image = beam_cv::OpenCVConversions::MatToRosImg(
+          mat, camera.compressed_image.header,
+          mat.channels() == 1 ? "mono8" : "bgr8");
+    }
+  }
+
+  CompressImage(camera, image, quality_);
+  size_t size = ros::serialization::serializationLength(chunk);
+  if (!Enabled()) { return Take(Level::FULL, size); }
+  if (size <= available_bytes_) {
+    if (available_bytes_ - size > burst_bytes_ / 2) {
+      quality_ =
+          std::min(quality_ + params_.quality_step, params_.jpeg_quality);
+    }
+    return Take(Level::FULL, size);
+  }
+  quality_ =
+      std::max(quality_ - params_.quality_step, params_.min_jpeg_quality);
+
+  ClearLidarPoints(chunk.lidar_measurement);
+  CompressImage(camera, image, params_.min_jpeg_quality);
+  size = ros::serialization::serializationLength(chunk);
+  if (size <= available_bytes_) { return Take(Level::REDUCED, size); }
+
+  camera.image = sensor_msgs::Image();
+  camera.compressed_image = sensor_msgs::CompressedImage();
+  size = ros::serialization::serializationLength(chunk);
+  if (size <= available_bytes_) { return Take(Level::FEATURES, size); }
+
+  // keep the stamps, so the chunk is still matched to its keyframe
+  bs_common::CameraMeasurementMsg poses_only;
+  poses_only.header = camera.header;
+  poses_only.sensor_id = camera.sensor_id;
+  camera = std::move(poses_only);
+  ClearLidarFeatures(chunk.lidar_measurement);
+  size = ros::serialization::serializationLength(chunk);
+  return Take(Level::POSES, size);
+}
+
+void SlamChunkBudget::Reset() {
+  available_bytes_ = burst_bytes_;
+  last_refill_ = ros::Time();
+  quality_ = params_.jpeg_quality;
+}
+
+void SlamChunkBudget::Refill(const ros::Time& now) {
+  if (!last_refill_.isZero() && now > last_refill_) {
+    available_bytes_ = std::min(
+        available_bytes_ + (now - last_refill_).toSec() * bytes_per_s_,
+        burst_bytes_);
+  }
+  if (last_refill_.isZero() || now > last_refill_) { last_refill_ = now; }
+}
+
+void SlamChunkBudget::CompressImage(
+    bs_common::CameraMeasurementMsg& measurement,
+    const sensor_msgs::Image& image, int quality) {
+  measurement.compressed_image = sensor_msgs::CompressedImage();
+  if (image.data.empty()) { return; }
+
+  std::vector<uchar> jpeg;
+  try {
+    const cv::Mat mat = beam_cv::OpenCVConversions::RosImgToMat(image);
+    const std::vector<int> jpeg_params{cv::IMWRITE_JPEG_QUALITY, quality};
+    if (!cv::imencode(".jpg", mat, jpeg, jpeg_params)) { jpeg.clear(); }
+  } catch (const cv::Exception&) { jpeg.clear(); }
+
+  if (jpeg.empty()) {
+    ROS_WARN_THROTTLE(10.0,
+                      "Cannot compress %s images to JPEG, sending them raw",
+                      image.encoding.c_str());
+    measurement.image = image;
+    return;
+  }
+  measurement.image = sensor_msgs::Image();
+  measurement.compressed_image.header = image.header;
+  measurement.compressed_image.format = "jpeg";
+  measurement.compressed_image.data = std::move(jpeg);
+}
+
+void SlamChunkBudget::ClearLidarPoints(
+    bs_common::LidarMeasurementMsg& measurement) {
+  measurement.lidar_points.clear();
+  measurement.lidar_points_packed = sensor_msgs::PointCloud2();
+}
+
+void SlamChunkBudget::ClearLidarFeatures(
+    bs_common::LidarMeasurementMsg& measurement) {
+  ClearLidarPoints(measurement);
+  measurement.lidar_edges_strong.clear();
+  measurement.lidar_edges_weak.clear();
+  measurement.lidar_surfaces_strong.clear();
+  measurement.lidar_surfaces_weak.clear();
+  measurement.lidar_edges_strong_packed = sensor_msgs::PointCloud2();
+  measurement.lidar_edges_weak_packed = sensor_msgs::PointCloud2();
+  measurement.lidar_surfaces_strong_packed = sensor_msgs::PointCloud2();
+  measurement.lidar_surfaces_weak_packed = sensor_msgs::PointCloud2();
+}
+
+SlamChunkBudget::Level SlamChunkBudget::Take(Level level, size_t size) {
+  // a chunk over budget is paid back by the next ones
+  if (Enabled()) { available_bytes_ -= static_cast<double>(size); }
+  stats_.chunks[static_cast<size_t>(level)]++;
+  stats_.bytes += size;
+  return level;
+}
+
+} // namespace bs_models::global_mapping
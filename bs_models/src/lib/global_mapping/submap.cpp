@@ -1,33 +1,142 @@
 #include <bs_models/global_mapping/submap.h>
 
+#include <thread>
+#include <unordered_map>
+
 #include <nlohmann/json.hpp>
-#include <pcl/common/transforms.h>
+#include <opencv2/imgcodecs.hpp>
 #include <pcl/io/pcd_io.h>
 
 #include <beam_cv/OpenCVConversions.h>
 #include <beam_cv/descriptors/Descriptor.h>
-#include <beam_cv/geometry/Triangulation.h>
 #include <beam_utils/filesystem.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/point_transforms.h>
+#include <bs_common/pose_array.h>
+#include <bs_models/global_mapping/map_store.h>
+#include <bs_models/lidar/parallel_voxel_grid.h>
+#include <bs_models/vision/batch_triangulator.h>
+#include <bs_models/vision/camera_measurement_view.h>
 
 namespace bs_models { namespace global_mapping {
 
+namespace {
+
+// lidar only submaps return the iterators of these empty containers, the
+// same container for begin and end so that they can be compared
+bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d>& EmptyCameraKeyframes() {
+  static bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d> empty;
+  return empty;
+}
+
+beam_containers::LandmarkContainer& EmptyLandmarks() {
+  static beam_containers::LandmarkContainer empty;
+  return empty;
+}
+
+void WriteMat(bs_common::ByteWriter& writer, const cv::Mat& mat) {
+  const cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+  writer.Write<int32_t>(continuous.rows);
+  writer.Write<int32_t>(continuous.cols);
+  writer.Write<int32_t>(continuous.type());
+  writer.WriteBytes(continuous.data,
+                    continuous.total() * continuous.elemSize());
+}
+
+cv::Mat ReadMat(bs_common::ByteReader& reader) {
+  const int32_t rows = reader.Read<int32_t>();
+  const int32_t cols = reader.Read<int32_t>();
+  const int32_t type = reader.Read<int32_t>();
+  if (rows < 0 || cols < 0) {
+    throw std::runtime_error("invalid matrix size in chunk data");
+  }
+  cv::Mat mat(rows, cols, type);
+  const size_t size = mat.total() * mat.elemSize();
+  if (size > 0) { std::memcpy(mat.data, reader.ReadBytes(size), size); }
+  return mat;
+}
+
+void WriteMatrixXd(bs_common::ByteWriter& writer, const Eigen::MatrixXd& m) {
+  writer.Write<int32_t>(m.rows());
+  writer.Write<int32_t>(m.cols());
+  writer.WriteBytes(m.data(), m.size() * sizeof(double));
+}
+
+Eigen::MatrixXd ReadMatrixXd(bs_common::ByteReader& reader) {
+  const int32_t rows = reader.Read<int32_t>();
+  const int32_t cols = reader.Read<int32_t>();
+  if (rows < 0 || cols < 0) {
+    throw std::runtime_error("invalid matrix size in chunk data");
+  }
+  Eigen::MatrixXd m(rows, cols);
+  const size_t size = m.size() * sizeof(double);
+  if (size > 0) { std::memcpy(m.data(), reader.ReadBytes(size), size); }
+  return m;
+}
+
+} // namespace
+
+Submap::LidarMapCache::LidarMapCache(const LidarMapCache& other) {
+  *this = other;
+}
+
+Submap::LidarMapCache&
+    Submap::LidarMapCache::operator=(const LidarMapCache& other) {
+  if (this == &other) { return *this; }
+  std::scoped_lock lock(mutex, other.mutex);
+  T_SUBMAP_LIDAR = other.T_SUBMAP_LIDAR;
+  has_points = other.has_points;
+  points = other.points;
+  scan_sizes = other.scan_sizes;
+  has_loam_points = other.has_loam_points;
+  loam_points = other.loam_points;
+  return *this;
+}
+
+Submap::PoseState::PoseState(const PoseState& other) {
+  *this = other;
+}
+
+Submap::PoseState& Submap::PoseState::operator=(const PoseState& other) {
+  if (this == &other) { return *this; }
+  std::scoped_lock lock(mutex, other.mutex);
+  graph_updates = other.graph_updates;
+  position = other.position;
+  orientation = other.orientation;
+  T_WORLD_SUBMAP = other.T_WORLD_SUBMAP;
+  return *this;
+}
+
+Submap::CameraDataPtr::CameraDataPtr(const CameraDataPtr& other) {
+  *this = other;
+}
+
+Submap::CameraDataPtr&
+    Submap::CameraDataPtr::operator=(const CameraDataPtr& other) {
+  if (this == &other) { return *this; }
+  data = other.data ? std::make_unique<CameraData>(*other.data) : nullptr;
+  return *this;
+}
+
 Submap::Submap(
     const ros::Time& stamp, const Eigen::Matrix4d& T_WORLD_SUBMAP,
     const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
     const std::shared_ptr<bs_common::ExtrinsicsLookupBase>& extrinsics)
     : stamp_(stamp), camera_model_(camera_model), extrinsics_(extrinsics) {
   // create fuse variables
-  position_ = fuse_variables::Position3DStamped(stamp, fuse_core::uuid::NIL);
-  orientation_ =
+  pose_.position =
+      fuse_variables::Position3DStamped(stamp, fuse_core::uuid::NIL);
+  pose_.orientation =
       fuse_variables::Orientation3DStamped(stamp, fuse_core::uuid::NIL);
 
   // add transform
-  bs_common::EigenTransformToFusePose(T_WORLD_SUBMAP, position_, orientation_);
+  bs_common::EigenTransformToFusePose(T_WORLD_SUBMAP, pose_.position,
+                                      pose_.orientation);
 
   // store initial transforms
-  T_WORLD_SUBMAP_ = T_WORLD_SUBMAP;
+  pose_.T_WORLD_SUBMAP = T_WORLD_SUBMAP;
   T_WORLD_SUBMAP_initial_ = T_WORLD_SUBMAP;
   T_SUBMAP_WORLD_initial_ = beam::InvertTransform(T_WORLD_SUBMAP);
 }
@@ -37,31 +146,33 @@ Submap::Submap(
     const fuse_variables::Orientation3DStamped& orientation,
     const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
     const std::shared_ptr<bs_common::ExtrinsicsLookupBase>& extrinsics)
-    : position_(position),
-      orientation_(orientation),
-      stamp_(stamp),
-      camera_model_(camera_model),
-      extrinsics_(extrinsics) {
+    : stamp_(stamp), camera_model_(camera_model), extrinsics_(extrinsics) {
+  pose_.position = position;
+  pose_.orientation = orientation;
   // convert to eigen transform
   Eigen::Matrix4d T_WORLD_SUBMAP;
-  bs_common::FusePoseToEigenTransform(position_, orientation_, T_WORLD_SUBMAP);
+  bs_common::FusePoseToEigenTransform(pose_.position, pose_.orientation,
+                                      T_WORLD_SUBMAP);
 
   // store initial transforms
-  T_WORLD_SUBMAP_ = T_WORLD_SUBMAP;
+  pose_.T_WORLD_SUBMAP = T_WORLD_SUBMAP;
   T_WORLD_SUBMAP_initial_ = T_WORLD_SUBMAP;
   T_SUBMAP_WORLD_initial_ = beam::InvertTransform(T_WORLD_SUBMAP);
 }
 
 fuse_variables::Position3DStamped Submap::Position() const {
-  return position_;
+  std::lock_guard<std::mutex> lock(pose_.mutex);
+  return pose_.position;
 }
 
 fuse_variables::Orientation3DStamped Submap::Orientation() const {
-  return orientation_;
+  std::lock_guard<std::mutex> lock(pose_.mutex);
+  return pose_.orientation;
 }
 
 Eigen::Matrix4d Submap::T_WORLD_SUBMAP() const {
-  return T_WORLD_SUBMAP_;
+  std::lock_guard<std::mutex> lock(pose_.mutex);
+  return pose_.T_WORLD_SUBMAP;
 }
 
 Eigen::Matrix4d Submap::T_WORLD_SUBMAP_INIT() const {
@@ -69,7 +180,8 @@ Eigen::Matrix4d Submap::T_WORLD_SUBMAP_INIT() const {
 }
 
 int Submap::Updates() const {
-  return graph_updates_;
+  std::lock_guard<std::mutex> lock(pose_.mutex);
+  return pose_.graph_updates;
 }
 
 ros::Time Submap::Stamp() const {
@@ -80,58 +192,164 @@ std::string Submap::DescriptorType() const {
   return descriptor_type_;
 }
 
-const std::map<uint64_t, ScanPose>& Submap::LidarKeyframes() const {
+const bs_common::FlatTimeMap<uint64_t, ScanPose>&
+    Submap::LidarKeyframes() const {
   return lidar_keyframe_poses_;
 }
 
-std::map<uint64_t, ScanPose>& Submap::LidarKeyframesMutable() {
+bs_common::FlatTimeMap<uint64_t, ScanPose>& Submap::LidarKeyframesMutable() {
   return lidar_keyframe_poses_;
 }
 
-std::map<uint64_t, ScanPose>::iterator Submap::LidarKeyframesBegin() {
+bs_common::FlatTimeMap<uint64_t, ScanPose>::iterator
+    Submap::LidarKeyframesBegin() {
   return lidar_keyframe_poses_.begin();
 }
 
-std::map<uint64_t, ScanPose>::iterator Submap::LidarKeyframesEnd() {
+bs_common::FlatTimeMap<uint64_t, ScanPose>::iterator
+    Submap::LidarKeyframesEnd() {
   return lidar_keyframe_poses_.end();
 }
 
-std::map<uint64_t, Eigen::Matrix4d>::iterator Submap::CameraKeyframesBegin() {
-  return camera_keyframe_poses_.begin();
+bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d>::iterator
+    Submap::CameraKeyframesBegin() {
+  return camera_data_.data ? camera_data_.data->keyframe_poses.begin()
+                           : EmptyCameraKeyframes().begin();
 }
 
-std::map<uint64_t, Eigen::Matrix4d>::iterator Submap::CameraKeyframesEnd() {
-  return camera_keyframe_poses_.end();
+bs_common::FlatTimeMap<uint64_t, Eigen::Matrix4d>::iterator
+    Submap::CameraKeyframesEnd() {
+  return camera_data_.data ? camera_data_.data->keyframe_poses.end()
+                           : EmptyCameraKeyframes().end();
 }
 
-std::map<uint64_t, std::vector<Submap::PoseStamped>>::iterator
+bs_common::FlatTimeMap<uint64_t, std::vector<Submap::PoseStamped>>::iterator
     Submap::SubframesBegin() {
   return subframe_poses_.begin();
 }
 
-std::map<uint64_t, std::vector<Submap::PoseStamped>>::iterator
+bs_common::FlatTimeMap<uint64_t, std::vector<Submap::PoseStamped>>::iterator
     Submap::SubframesEnd() {
   return subframe_poses_.end();
 }
 
 beam_containers::landmark_container_iterator Submap::LandmarksBegin() {
-  return landmarks_.begin();
+  return camera_data_.data ? camera_data_.data->landmarks.begin()
+                           : EmptyLandmarks().begin();
 }
 
 beam_containers::landmark_container_iterator Submap::LandmarksEnd() {
-  return landmarks_.end();
+  return camera_data_.data ? camera_data_.data->landmarks.end()
+                           : EmptyLandmarks().end();
 }
 
 std::vector<cv::Mat> Submap::GetKeyframeVector() {
   std::vector<cv::Mat> image_vector;
-  std::transform(keyframe_images_.begin(), keyframe_images_.end(),
-                 std::back_inserter(image_vector),
-                 [&](const auto& pair) { return pair.second; });
+  if (!camera_data_.data) { return image_vector; }
+  const auto& keyframe_images = camera_data_.data->keyframe_images;
+  for (const uint64_t stamp : keyframe_images.Stamps()) {
+    image_vector.push_back(keyframe_images.Get(stamp));
+  }
   return image_vector;
 }
 
-const std::map<uint64_t, cv::Mat>& Submap::GetKeyframeMap() {
-  return keyframe_images_;
+std::map<uint64_t, cv::Mat> Submap::GetKeyframeMap() {
+  std::map<uint64_t, cv::Mat> image_map;
+  if (!camera_data_.data) { return image_map; }
+  const auto& keyframe_images = camera_data_.data->keyframe_images;
+  for (const uint64_t stamp : keyframe_images.Stamps()) {
+    image_map.emplace(stamp, keyframe_images.Get(stamp));
+  }
+  return image_map;
+}
+
+void Submap::SetKeyframeImageParams(
+    const vision::KeyframeImageStore::Params& params) {
+  keyframe_image_params_ = params;
+  if (camera_data_.data) {
+    camera_data_.data->keyframe_images = vision::KeyframeImageStore(
+        params, std::to_string(stamp_.toNSec()));
+  }
+}
+
+Submap::CameraData& Submap::CameraDataMutable() {
+  if (!camera_data_.data) {
+    camera_data_.data = std::make_unique<CameraData>();
+    camera_data_.data->keyframe_images = vision::KeyframeImageStore(
+        keyframe_image_params_, std::to_string(stamp_.toNSec()));
+  }
+  return *camera_data_.data;
+}
+
+void Submap::SetLidarMapCacheParams(const LidarMapCacheParams& params) {
+  lidar_map_cache_params_ = params;
+  lidar_map_cache_ = LidarMapCache();
+  lidar_map_cache_initial_ = LidarMapCache();
+}
+
+void Submap::SetScanContexts(
+    int num_scans_aggregated,
+    const std::map<uint64_t, Eigen::MatrixXd>& descriptors) {
+  scan_contexts_num_aggregated_ = num_scans_aggregated;
+  scan_contexts_ = descriptors;
+  scan_context_accumulator_ = reloc::ScanContextAccumulator();
+}
+
+const std::map<uint64_t, Eigen::MatrixXd>*
+    Submap::ScanContexts(int num_scans_aggregated) const {
+  if (scan_contexts_num_aggregated_ != num_scans_aggregated ||
+      scan_contexts_.size() != lidar_keyframe_poses_.size()) {
+    return nullptr;
+  }
+  for (auto sc_it = scan_contexts_.begin(),
+            kf_it = lidar_keyframe_poses_.begin();
+       sc_it != scan_contexts_.end(); sc_it++, kf_it++) {
+    if (sc_it->first != kf_it->first) { return nullptr; }
+  }
+  return &scan_contexts_;
+}
+
+void Submap::AccumulateScanContexts(int num_scans_aggregated) {
+  scan_context_accumulator_ =
+      reloc::ScanContextAccumulator(num_scans_aggregated);
+}
+
+bool Submap::AccumulatedScanContexts(
+    int num_scans_aggregated,
+    std::map<uint64_t, Eigen::MatrixXd>& descriptors) const {
+  if (!scan_context_accumulator_.Enabled() ||
+      scan_context_accumulator_.NumScansAggregated() != num_scans_aggregated ||
+      scan_context_accumulator_.Size() != lidar_keyframe_poses_.size()) {
+    return false;
+  }
+  const std::vector<uint64_t> stamps = scan_context_accumulator_.Stamps();
+  auto kf_it = lidar_keyframe_poses_.begin();
+  for (const uint64_t stamp : stamps) {
+    if (stamp != (kf_it++)->first) { return false; }
+  }
+  descriptors = scan_context_accumulator_.Descriptors();
+  return true;
+}
+
+void Submap::SetFootprint(const SubmapFootprint& footprint) {
+  footprint_ = footprint;
+  footprint_keyframe_stamps_.clear();
+  for (const auto& [stamp, scan_pose] : lidar_keyframe_poses_) {
+    footprint_keyframe_stamps_.push_back(stamp);
+  }
+}
+
+const SubmapFootprint*
+    Submap::Footprint(const SubmapFootprint::Params& params) const {
+  if (footprint_.Empty() || !(footprint_.GetParams() == params) ||
+      footprint_keyframe_stamps_.size() != lidar_keyframe_poses_.size()) {
+    return nullptr;
+  }
+  auto stamp_it = footprint_keyframe_stamps_.begin();
+  for (const auto& [stamp, scan_pose] : lidar_keyframe_poses_) {
+    if (*stamp_it++ != stamp) { return nullptr; }
+  }
+  return &footprint_;
 }
 
 void Submap::AddCameraMeasurement(
@@ -141,6 +359,9 @@ void Submap::AddCameraMeasurement(
   cv::Mat image;
   if (!camera_measurement.image.data.empty()) {
     image = beam_cv::OpenCVConversions::RosImgToMat(camera_measurement.image);
+  } else if (!camera_measurement.compressed_image.data.empty()) {
+    image = cv::imdecode(camera_measurement.compressed_image.data,
+                         cv::IMREAD_UNCHANGED);
   }
   const auto sensor_id = camera_measurement.sensor_id;
   const auto measurement_id = camera_measurement.header.seq;
@@ -161,24 +382,21 @@ void Submap::AddCameraMeasurement(
   Eigen::Matrix4d T_SUBMAP_BASELINK =
       T_SUBMAP_WORLD_initial_ * T_WORLDLM_BASELINK;
 
-  camera_keyframe_poses_.emplace(stamp.toNSec(), T_SUBMAP_BASELINK);
-  keyframe_images_.emplace(stamp.toNSec(), image);
-
-  const auto landmarks = camera_measurement.landmarks;
-  std::for_each(landmarks.begin(), landmarks.end(), [&](const auto& lm_msg) {
-    cv::Mat descriptor = beam_cv::Descriptor::VectorDescriptorToCvMat(
-        {lm_msg.descriptor.data}, descriptor_type_);
-    Eigen::Vector2d value(lm_msg.pixel_u, lm_msg.pixel_v);
+  CameraData& camera_data = CameraDataMutable();
+  camera_data.keyframe_poses.emplace(stamp.toNSec(), T_SUBMAP_BASELINK);
+  camera_data.keyframe_images.Add(stamp.toNSec(), image);
 
+  const vision::CameraMeasurementView measurements(camera_measurement);
+  for (size_t i = 0; i < measurements.Size(); i++) {
     beam_containers::LandmarkMeasurement new_landmark{
         .time_point = stamp,
         .sensor_id = static_cast<uint8_t>(sensor_id),
-        .landmark_id = static_cast<uint64_t>(lm_msg.landmark_id),
+        .landmark_id = measurements.LandmarkId(i),
         .image = static_cast<uint64_t>(measurement_id),
-        .value = value,
-        .descriptor = descriptor};
-    landmarks_.Insert(new_landmark);
-  });
+        .value = measurements.Pixel(i),
+        .descriptor = measurements.Descriptor(i).clone()};
+    camera_data.landmarks.Insert(new_landmark);
+  }
 }
 
 const std::shared_ptr<bs_common::ExtrinsicsLookupBase>&
@@ -211,9 +429,13 @@ void Submap::AddLidarMeasurement(const PointCloud& cloud,
     // Stamp does not exist: add new scanpose to map
     ScanPose new_scan_pose(stamp, T_SUBMAP_BASELINK, T_BASELINK_LIDAR);
     new_scan_pose.AddPointCloud(cloud, false);
-    lidar_keyframe_poses_.insert(
-        std::pair<uint64_t, ScanPose>(stamp.toNSec(), new_scan_pose));
+    iter = lidar_keyframe_poses_
+               .insert(std::pair<uint64_t, ScanPose>(stamp.toNSec(),
+                                                     new_scan_pose))
+               .first;
   }
+  scan_context_accumulator_.AddScan(
+      stamp.toNSec(), iter->second.T_REFFRAME_LIDAR(), cloud);
 }
 
 void Submap::AddLidarMeasurement(const beam_matching::LoamPointCloud& cloud,
@@ -237,9 +459,15 @@ void Submap::AddLidarMeasurement(const beam_matching::LoamPointCloud& cloud,
     // Stamp does not exist: add new scanpose to map
     ScanPose new_scan_pose(stamp, T_SUBMAP_BASELINK, T_BASELINK_LIDAR);
     new_scan_pose.AddPointCloud(cloud, false);
-    lidar_keyframe_poses_.insert(
-        std::pair<uint64_t, ScanPose>(stamp.toNSec(), new_scan_pose));
+    iter = lidar_keyframe_poses_
+               .insert(std::pair<uint64_t, ScanPose>(stamp.toNSec(),
+                                                     new_scan_pose))
+               .first;
   }
+  // scan contexts only use the regular clouds, but are computed for all
+  // keyframes
+  scan_context_accumulator_.AddScan(
+      stamp.toNSec(), iter->second.T_REFFRAME_LIDAR(), PointCloud());
 }
 
 void Submap::AddTrajectoryMeasurement(
@@ -262,24 +490,42 @@ void Submap::AddTrajectoryMeasurement(
 }
 
 bool Submap::UpdatePose(fuse_core::Graph::ConstSharedPtr graph_msg) {
-  if (graph_msg->variableExists(position_.uuid()) &&
-      graph_msg->variableExists(orientation_.uuid())) {
-    position_ = dynamic_cast<const fuse_variables::Position3DStamped&>(
-        graph_msg->getVariable(position_.uuid()));
-
-    orientation_ = dynamic_cast<const fuse_variables::Orientation3DStamped&>(
-        graph_msg->getVariable(orientation_.uuid()));
-    graph_updates_++;
-    bs_common::FusePoseToEigenTransform(position_, orientation_,
-                                        T_WORLD_SUBMAP_);
+  std::lock_guard<std::mutex> lock(pose_.mutex);
+  // if the graph came with a delta, only copy the variables if they changed
+  const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(*graph_msg);
+  if (delta && !delta->IsUpdated(pose_.position.uuid()) &&
+      !delta->IsUpdated(pose_.orientation.uuid())) {
+    if (delta->IsRemoved(pose_.position.uuid()) ||
+        delta->IsRemoved(pose_.orientation.uuid()) ||
+        !graph_msg->variableExists(pose_.position.uuid()) ||
+        !graph_msg->variableExists(pose_.orientation.uuid())) {
+      return false;
+    }
+    pose_.graph_updates++;
+    return true;
+  }
+
+  if (graph_msg->variableExists(pose_.position.uuid()) &&
+      graph_msg->variableExists(pose_.orientation.uuid())) {
+    pose_.position = dynamic_cast<const fuse_variables::Position3DStamped&>(
+        graph_msg->getVariable(pose_.position.uuid()));
+
+    pose_.orientation =
+        dynamic_cast<const fuse_variables::Orientation3DStamped&>(
+            graph_msg->getVariable(pose_.orientation.uuid()));
+    pose_.graph_updates++;
+    bs_common::FusePoseToEigenTransform(pose_.position, pose_.orientation,
+                                        pose_.T_WORLD_SUBMAP);
     return true;
   }
   return false;
 }
 
 void Submap::UpdatePose(const Eigen::Matrix4d& T_WORLD_SUBMAP) {
-  T_WORLD_SUBMAP_ = T_WORLD_SUBMAP;
-  bs_common::EigenTransformToFusePose(T_WORLD_SUBMAP, position_, orientation_);
+  std::lock_guard<std::mutex> lock(pose_.mutex);
+  pose_.T_WORLD_SUBMAP = T_WORLD_SUBMAP;
+  bs_common::EigenTransformToFusePose(T_WORLD_SUBMAP, pose_.position,
+                                      pose_.orientation);
 }
 
 bool Submap::Near(const ros::Time& time, const double tolerance) const {
@@ -287,8 +533,12 @@ bool Submap::Near(const ros::Time& time, const double tolerance) const {
 }
 
 bool Submap::InSubmap(const ros::Time& time) const {
-  const auto start = (*camera_keyframe_poses_.begin()).first;
-  const auto end = (*camera_keyframe_poses_.rbegin()).first;
+  if (!camera_data_.data || camera_data_.data->keyframe_poses.empty()) {
+    return false;
+  }
+  const auto& keyframe_poses = camera_data_.data->keyframe_poses;
+  const auto start = (*keyframe_poses.begin()).first;
+  const auto end = (*keyframe_poses.rbegin()).first;
   const auto query = time.toNSec();
   if (query >= start && query <= end) { return true; }
   return false;
@@ -361,19 +611,20 @@ void Submap::SaveLidarLoamMapInWorldFrame(const std::string& path,
 }
 
 PointCloud Submap::GetKeypointsInWorldFrame(bool use_initials) {
-  TriangulateKeypoints();
   PointCloud cloud;
-  for (auto it = landmark_positions_.begin(); it != landmark_positions_.end();
-       it++) {
-    const Eigen::Vector3d& P_SUBMAP = it->second;
-    Eigen::Vector4d P_WORLD;
-    if (use_initials) {
-      P_WORLD = T_WORLD_SUBMAP_initial_ * P_SUBMAP.homogeneous();
-    } else {
-      P_WORLD = T_WORLD_SUBMAP_ * P_SUBMAP.homogeneous();
-    }
-    pcl::PointXYZ p(P_WORLD[0], P_WORLD[1], P_WORLD[2]);
-    cloud.push_back(p);
+  if (!camera_data_.data) { return cloud; }
+  TriangulateKeypoints();
+  const auto& landmark_positions = camera_data_.data->landmark_positions;
+  Eigen::Matrix3Xd points(3, landmark_positions.size());
+  int i = 0;
+  for (const auto& [id, P_SUBMAP] : landmark_positions) {
+    points.col(i++) = P_SUBMAP;
+  }
+  bs_common::TransformPoints(
+      use_initials ? T_WORLD_SUBMAP_initial_ : T_WORLD_SUBMAP(), points);
+  cloud.reserve(points.cols());
+  for (int j = 0; j < points.cols(); j++) {
+    cloud.push_back(pcl::PointXYZ(points(0, j), points(1, j), points(2, j)));
   }
   return cloud;
 }
@@ -381,82 +632,152 @@ PointCloud Submap::GetKeypointsInWorldFrame(bool use_initials) {
 std::vector<PointCloud>
     Submap::GetLidarPointsInWorldFrame(int max_output_map_size,
                                        bool use_initials) const {
+  LidarMapCache& cache =
+      use_initials ? lidar_map_cache_initial_ : lidar_map_cache_;
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  FillLidarPointsCache(cache, use_initials);
+  PointCloud map_combined;
+  bs_common::TransformCloud(cache.points, map_combined,
+                            use_initials ? T_WORLD_SUBMAP_initial_
+                                         : T_WORLD_SUBMAP());
+
+  // split at scan boundaries when they are known (i.e., the points are not
+  // voxelized), otherwise split into blocks of the max size
+  const size_t max_size = std::max(max_output_map_size, 1);
+  std::vector<size_t> block_sizes = cache.scan_sizes;
+  if (block_sizes.empty()) {
+    for (size_t i = 0; i < map_combined.size(); i += max_size) {
+      block_sizes.push_back(std::min(max_size, map_combined.size() - i));
+    }
+  }
+
   std::vector<PointCloud> map;
   PointCloud map_current;
-  for (auto it = lidar_keyframe_poses_.begin();
-       it != lidar_keyframe_poses_.end(); it++) {
-    const PointCloud& cloud_in_lidar_frame = it->second.Cloud();
-    Eigen::Matrix4d T_WORLD_LIDAR;
-    if (use_initials) {
-      const Eigen::Matrix4d& T_SUBMAP_LIDAR =
-          it->second.T_REFFRAME_LIDAR_INIT();
-      T_WORLD_LIDAR = T_WORLD_SUBMAP_initial_ * T_SUBMAP_LIDAR;
-    } else {
-      Eigen::Matrix4d T_SUBMAP_LIDAR = it->second.T_REFFRAME_LIDAR();
-      T_WORLD_LIDAR = T_WORLD_SUBMAP_ * T_SUBMAP_LIDAR;
-    }
-
-    PointCloud cloud_in_world_frame;
-    pcl::transformPointCloud(cloud_in_lidar_frame, cloud_in_world_frame,
-                             T_WORLD_LIDAR);
-
-    if (map_current.empty()) {
-      map_current = cloud_in_world_frame;
-    } else if (map_current.size() + cloud_in_world_frame.size() >
-               max_output_map_size) {
+  auto block_begin = map_combined.begin();
+  for (const size_t block_size : block_sizes) {
+    if (!map_current.empty() &&
+        map_current.size() + block_size > max_size) {
       map.push_back(map_current);
-      map_current = cloud_in_world_frame;
-    } else {
-      map_current += cloud_in_world_frame;
+      map_current.clear();
     }
+    map_current.insert(map_current.end(), block_begin,
+                       block_begin + block_size);
+    block_begin += block_size;
   }
   map.push_back(map_current);
   return map;
 }
 
 PointCloud Submap::GetLidarPointsInWorldFrameCombined(bool use_initials) const {
+  LidarMapCache& cache =
+      use_initials ? lidar_map_cache_initial_ : lidar_map_cache_;
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  FillLidarPointsCache(cache, use_initials);
   PointCloud map;
-  for (auto it = lidar_keyframe_poses_.begin();
-       it != lidar_keyframe_poses_.end(); it++) {
-    const PointCloud& cloud_in_lidar_frame = it->second.Cloud();
-    Eigen::Matrix4d T_WORLD_LIDAR;
-    if (use_initials) {
-      const Eigen::Matrix4d& T_SUBMAP_LIDAR =
-          it->second.T_REFFRAME_LIDAR_INIT();
-      T_WORLD_LIDAR = T_WORLD_SUBMAP_initial_ * T_SUBMAP_LIDAR;
-    } else {
-      Eigen::Matrix4d T_SUBMAP_LIDAR = it->second.T_REFFRAME_LIDAR();
-      T_WORLD_LIDAR = T_WORLD_SUBMAP_ * T_SUBMAP_LIDAR;
-    }
-
-    PointCloud cloud_in_world_frame;
-    pcl::transformPointCloud(cloud_in_lidar_frame, cloud_in_world_frame,
-                             T_WORLD_LIDAR);
-    map += cloud_in_world_frame;
-  }
-
+  bs_common::TransformCloud(cache.points, map,
+                            use_initials ? T_WORLD_SUBMAP_initial_
+                                         : T_WORLD_SUBMAP());
   return map;
 }
 
 beam_matching::LoamPointCloud
     Submap::GetLidarLoamPointsInWorldFrame(bool use_initials) const {
-  beam_matching::LoamPointCloud map;
+  // loam points are always aggregated using the current scan poses, only the
+  // submap pose depends on use_initials
+  std::lock_guard<std::mutex> lock(lidar_map_cache_.mutex);
+  FillLidarLoamPointsCache(lidar_map_cache_);
+  return beam_matching::LoamPointCloud(
+      lidar_map_cache_.loam_points,
+      use_initials ? T_WORLD_SUBMAP_initial_ : T_WORLD_SUBMAP());
+}
+
+PointCloud Submap::GetLidarPointsInSubmapFrame() const {
+  std::lock_guard<std::mutex> lock(lidar_map_cache_.mutex);
+  FillLidarPointsCache(lidar_map_cache_, false);
+  return lidar_map_cache_.points;
+}
+
+beam_matching::LoamPointCloud Submap::GetLidarLoamPointsInSubmapFrame() const {
+  std::lock_guard<std::mutex> lock(lidar_map_cache_.mutex);
+  FillLidarLoamPointsCache(lidar_map_cache_);
+  return lidar_map_cache_.loam_points;
+}
+
+void Submap::ValidateLidarMapCache(LidarMapCache& cache,
+                                   bool use_initials) const {
+  bool valid = cache.T_SUBMAP_LIDAR.size() == lidar_keyframe_poses_.size();
+  auto cache_iter = cache.T_SUBMAP_LIDAR.begin();
+  for (auto it = lidar_keyframe_poses_.begin();
+       valid && it != lidar_keyframe_poses_.end(); it++, cache_iter++) {
+    if (cache_iter->first != it->first) {
+      valid = false;
+      break;
+    }
+    const Eigen::Matrix4d T_SUBMAP_LIDAR =
+        use_initials ? it->second.T_REFFRAME_LIDAR_INIT()
+                     : it->second.T_REFFRAME_LIDAR();
+    const Eigen::Matrix4d& T_SUBMAP_LIDAR_cached = cache_iter->second;
+    const double dt = (T_SUBMAP_LIDAR.block<3, 1>(0, 3) -
+                       T_SUBMAP_LIDAR_cached.block<3, 1>(0, 3))
+                          .norm();
+    const Eigen::AngleAxisd dR(
+        T_SUBMAP_LIDAR_cached.block<3, 3>(0, 0).transpose() *
+        T_SUBMAP_LIDAR.block<3, 3>(0, 0));
+    valid = dt <= lidar_map_cache_params_.translation_tol &&
+            std::abs(dR.angle()) <= lidar_map_cache_params_.rotation_tol;
+  }
+  if (valid) { return; }
+
+  cache.T_SUBMAP_LIDAR.clear();
   for (auto it = lidar_keyframe_poses_.begin();
        it != lidar_keyframe_poses_.end(); it++) {
-    const beam_matching::LoamPointCloud& cloud_in_lidar_frame =
-        it->second.LoamCloud();
-    const Eigen::Matrix4d& T_SUBMAP_LIDAR = it->second.T_REFFRAME_LIDAR();
-    Eigen::Matrix4d T_WORLD_LIDAR;
-    if (use_initials) {
-      T_WORLD_LIDAR = T_WORLD_SUBMAP_initial_ * T_SUBMAP_LIDAR;
-    } else {
-      T_WORLD_LIDAR = T_WORLD_SUBMAP_ * T_SUBMAP_LIDAR;
-    }
-    beam_matching::LoamPointCloud cloud_in_world_frame(cloud_in_lidar_frame,
-                                                       T_WORLD_LIDAR);
-    map.Merge(cloud_in_world_frame);
+    cache.T_SUBMAP_LIDAR.emplace(it->first,
+                                 use_initials
+                                     ? it->second.T_REFFRAME_LIDAR_INIT()
+                                     : it->second.T_REFFRAME_LIDAR());
   }
-  return map;
+  cache.has_points = false;
+  cache.points.clear();
+  cache.scan_sizes.clear();
+  cache.has_loam_points = false;
+  cache.loam_points = beam_matching::LoamPointCloud();
+}
+
+void Submap::FillLidarPointsCache(LidarMapCache& cache,
+                                  bool use_initials) const {
+  ValidateLidarMapCache(cache, use_initials);
+  if (cache.has_points) { return; }
+  for (const auto& [stamp, T_SUBMAP_LIDAR] : cache.T_SUBMAP_LIDAR) {
+    // read through a handle so that compressed clouds are not kept decoded
+    const auto cloud_in_lidar_frame =
+        lidar_keyframe_poses_.at(stamp).CloudPtr();
+    bs_common::AppendTransformedCloud(*cloud_in_lidar_frame, T_SUBMAP_LIDAR,
+                                      cache.points);
+    cache.scan_sizes.push_back(cloud_in_lidar_frame->size());
+  }
+
+  const float voxel_size = lidar_map_cache_params_.voxel_size;
+  if (voxel_size > 0 && !cache.points.empty()) {
+    ParallelVoxelGrid<pcl::PointXYZ>::Params voxel_params;
+    voxel_params.voxel_size =
+        Eigen::Vector3f(voxel_size, voxel_size, voxel_size);
+    voxel_params.priority = bs_common::TaskPriority::BACKGROUND;
+    ParallelVoxelGrid<pcl::PointXYZ>(voxel_params)
+        .Filter(cache.points, cache.points);
+    cache.scan_sizes.clear();
+  }
+  cache.has_points = true;
+}
+
+void Submap::FillLidarLoamPointsCache(LidarMapCache& cache) const {
+  ValidateLidarMapCache(cache, false);
+  if (cache.has_loam_points) { return; }
+  for (const auto& [stamp, T_SUBMAP_LIDAR] : cache.T_SUBMAP_LIDAR) {
+    beam_matching::LoamPointCloud cloud_in_submap_frame(
+        *lidar_keyframe_poses_.at(stamp).LoamCloudPtr(), T_SUBMAP_LIDAR);
+    cache.loam_points.Merge(cloud_in_submap_frame);
+  }
+  cache.has_loam_points = true;
 }
 
 std::vector<Submap::PoseStamped>
@@ -466,9 +787,9 @@ std::vector<Submap::PoseStamped>
   std::map<uint64_t, Eigen::Matrix4d> poses_stamped_map;
 
   // get all camera keyframe poses
-  for (auto it = camera_keyframe_poses_.begin();
-       it != camera_keyframe_poses_.end(); it++) {
-    poses_stamped_map.emplace(it->first, it->second);
+  if (camera_data_.data) {
+    poses_stamped_map.insert(camera_data_.data->keyframe_poses.begin(),
+                             camera_data_.data->keyframe_poses.end());
   }
 
   // get all lidar keyframe poses if they do not override camera poses
@@ -530,22 +851,26 @@ void Submap::Print(std::ostream& stream) const {
     num_subframes += it->second.size();
   }
 
+  const PoseState pose = pose_;
   stream << "  Stamp: " << stamp_ << "\n"
-         << "  Number of updates: " << graph_updates_ << "\n"
+         << "  Number of updates: " << pose.graph_updates << "\n"
          << "  Position:\n"
-         << "  - x: " << position_.x() << "\n"
-         << "  - y: " << position_.y() << "\n"
-         << "  - z: " << position_.z() << "\n"
+         << "  - x: " << pose.position.x() << "\n"
+         << "  - y: " << pose.position.y() << "\n"
+         << "  - z: " << pose.position.z() << "\n"
          << "  Orientation:\n"
-         << "  - x: " << orientation_.x() << "\n"
-         << "  - y: " << orientation_.y() << "\n"
-         << "  - z: " << orientation_.z() << "\n"
-         << "  - w: " << orientation_.w() << "\n"
+         << "  - x: " << pose.orientation.x() << "\n"
+         << "  - y: " << pose.orientation.y() << "\n"
+         << "  - z: " << pose.orientation.z() << "\n"
+         << "  - w: " << pose.orientation.w() << "\n"
          << "  Number of lidar keyframes: " << lidar_keyframe_poses_.size()
          << "\n"
-         << "  Number of camera keyframes: " << camera_keyframe_poses_.size()
+         << "  Number of camera keyframes: "
+         << (camera_data_.data ? camera_data_.data->keyframe_poses.size() : 0)
+         << "\n"
+         << "  Number of landmarks: "
+         << (camera_data_.data ? camera_data_.data->landmarks.size() : 0)
          << "\n"
-         << "  Number of landmarks: " << landmarks_.size() << "\n"
          << "  Number of subframes: " << num_subframes << "\n";
 }
 
@@ -566,26 +891,27 @@ bool Submap::LoadData(const std::string& input_dir,
   try {
     // load general data
     stamp_.fromNSec(J_submap["stamp_nsecs"]);
-    graph_updates_ = J_submap["graph_updates"];
+    pose_.graph_updates = J_submap["graph_updates"];
 
     // load position data
-    position_ = fuse_variables::Position3DStamped(
+    pose_.position = fuse_variables::Position3DStamped(
         stamp_, fuse_core::uuid::from_string(J_submap["device_id"]));
     std::vector<double> position_vector = J_submap["position_xyz"];
-    position_.x() = position_vector.at(0);
-    position_.y() = position_vector.at(1);
-    position_.z() = position_vector.at(2);
+    pose_.position.x() = position_vector.at(0);
+    pose_.position.y() = position_vector.at(1);
+    pose_.position.z() = position_vector.at(2);
 
-    orientation_ = fuse_variables::Orientation3DStamped(
+    pose_.orientation = fuse_variables::Orientation3DStamped(
         stamp_, fuse_core::uuid::from_string(J_submap["device_id"]));
     std::vector<double> orientation_vector = J_submap["orientation_xyzw"];
-    orientation_.x() = orientation_vector.at(0);
-    orientation_.y() = orientation_vector.at(1);
-    orientation_.z() = orientation_vector.at(2);
-    orientation_.w() = orientation_vector.at(3);
+    pose_.orientation.x() = orientation_vector.at(0);
+    pose_.orientation.y() = orientation_vector.at(1);
+    pose_.orientation.z() = orientation_vector.at(2);
+    pose_.orientation.w() = orientation_vector.at(3);
 
     std::vector<double> T_WORLD_SUBMAP_vec = J_submap["T_WORLD_SUBMAP"];
-    T_WORLD_SUBMAP_ = beam::VectorToEigenTransform(T_WORLD_SUBMAP_vec);
+    pose_.T_WORLD_SUBMAP =
+        beam::VectorToEigenTransform(T_WORLD_SUBMAP_vec);
 
     std::vector<double> T_WORLD_SUBMAP_initial_vec =
         J_submap["T_WORLD_SUBMAP_initial"];
@@ -597,17 +923,11 @@ bool Submap::LoadData(const std::string& input_dir,
     return false;
   }
 
-  // load camera model
+  // load camera model, lidar only submaps are saved without one
   std::string camera_model_path =
       beam::CombinePaths(input_dir, "camera_model.json");
-  if (override_camera_model_pointer) {
-    if (!boost::filesystem::exists(camera_model_path)) {
-      BEAM_ERROR(
-          "Cannot load camera model, camera_model.json does not exist inside "
-          "root folder. Not loading submap data. Input root directory: {}",
-          input_dir);
-      return false;
-    }
+  if (override_camera_model_pointer &&
+      boost::filesystem::exists(camera_model_path)) {
     try {
       camera_model_ = beam_calibration::CameraModel::Create(camera_model_path);
     } catch (...) {
@@ -616,12 +936,13 @@ bool Submap::LoadData(const std::string& input_dir,
     }
   }
 
-  // load camera keyframes json
+  // load camera keyframes json, which is not saved for lidar only submaps
   nlohmann::json J_cam_keyframes;
   beam::JsonReadErrorType error_type;
   std::string camera_keyframes_path =
       beam::CombinePaths(input_dir, "camera_keyframes.json");
-  if (!beam::ReadJson(camera_keyframes_path, J_cam_keyframes, error_type,
+  if (boost::filesystem::exists(camera_keyframes_path) &&
+      !beam::ReadJson(camera_keyframes_path, J_cam_keyframes, error_type,
                       false)) {
     if (error_type != beam::JsonReadErrorType::EMPTY) {
       BEAM_ERROR(
@@ -631,7 +952,7 @@ bool Submap::LoadData(const std::string& input_dir,
           camera_keyframes_path);
       return false;
     }
-  } else {
+  } else if (!J_cam_keyframes.is_null()) {
     // parse json
     try {
       std::map<uint64_t, std::vector<double>> cam_keyframes_map =
@@ -639,7 +960,7 @@ bool Submap::LoadData(const std::string& input_dir,
       for (auto it = cam_keyframes_map.begin(); it != cam_keyframes_map.end();
            it++) {
         Eigen::Matrix4d T = beam::VectorToEigenTransform(it->second);
-        camera_keyframe_poses_.emplace(it->first, T);
+        CameraDataMutable().keyframe_poses.emplace(it->first, T);
       }
     } catch (...) {
       BEAM_ERROR("Cannot load camera keyframes, invalid data. Input: {}",
@@ -648,14 +969,20 @@ bool Submap::LoadData(const std::string& input_dir,
     }
   }
 
-  // load landmarks
+  // load landmarks, only kept if there are any
   std::string landmarks_path = beam::CombinePaths(input_dir, "landmarks.json");
-  try {
-    landmarks_.LoadFromJson(landmarks_path, false);
-  } catch (...) {
-    BEAM_ERROR("Cannot load landmarks json, invalid data. Input: {}",
-               landmarks_path);
-    return false;
+  if (boost::filesystem::exists(landmarks_path)) {
+    beam_containers::LandmarkContainer landmarks;
+    try {
+      landmarks.LoadFromJson(landmarks_path, false);
+    } catch (...) {
+      BEAM_ERROR("Cannot load landmarks json, invalid data. Input: {}",
+                 landmarks_path);
+      return false;
+    }
+    if (landmarks.size() > 0) {
+      CameraDataMutable().landmarks = std::move(landmarks);
+    }
   }
 
   // load lidar keyframes
@@ -684,6 +1011,28 @@ bool Submap::LoadData(const std::string& input_dir,
     lidar_keyframe_num++;
   }
 
+  // load scan contexts if they were saved, they are recomputed otherwise
+  std::string scan_contexts_path =
+      beam::CombinePaths(input_dir, "scan_contexts.json");
+  if (boost::filesystem::exists(scan_contexts_path)) {
+    nlohmann::json J_scan_contexts;
+    if (beam::ReadJson(scan_contexts_path, J_scan_contexts)) {
+      try {
+        std::map<uint64_t, Eigen::MatrixXd> descriptors;
+        for (const auto& J_sc : J_scan_contexts["scan_contexts"]) {
+          std::vector<double> data = J_sc["data"];
+          Eigen::MatrixXd descriptor = Eigen::Map<Eigen::MatrixXd>(
+              data.data(), J_sc["rows"], J_sc["cols"]);
+          descriptors.emplace(J_sc["stamp_nsecs"], descriptor);
+        }
+        SetScanContexts(J_scan_contexts["num_scans_aggregated"], descriptors);
+      } catch (...) {
+        BEAM_WARN("Cannot load scan contexts, invalid data. Input: {}",
+                  scan_contexts_path);
+      }
+    }
+  }
+
   // load subframe poses
   std::string subframes_root = beam::CombinePaths(input_dir, "subframes");
   if (!boost::filesystem::exists(subframes_root)) {
@@ -757,19 +1106,23 @@ void Submap::SaveData(const std::string& output_dir) {
   }
 
   // First, save general submap data to a json
+  const PoseState pose = pose_;
   nlohmann::json J_submap = {
       {"stamp_nsecs", stamp_.toNSec()},
-      {"graph_updates", graph_updates_},
+      {"graph_updates", pose.graph_updates},
       {"num_lidar_keyframes", lidar_keyframe_poses_.size()},
-      {"num_camera_keyframes", camera_keyframe_poses_.size()},
+      {"num_camera_keyframes",
+       camera_data_.data ? camera_data_.data->keyframe_poses.size() : 0},
       {"num_subframes", subframe_poses_.size()},
-      {"num_landmarks", landmarks_.size()},
+      {"num_landmarks",
+       camera_data_.data ? camera_data_.data->landmarks.size() : 0},
       {"device_id", fuse_core::uuid::to_string(fuse_core::uuid::NIL)},
-      {"position_xyz", {position_.x(), position_.y(), position_.z()}},
+      {"position_xyz",
+       {pose.position.x(), pose.position.y(), pose.position.z()}},
       {"orientation_xyzw",
-       {orientation_.x(), orientation_.y(), orientation_.z(),
-        orientation_.w()}}};
-  beam::AddTransformToJson(J_submap, T_WORLD_SUBMAP_, "T_WORLD_SUBMAP");
+       {pose.orientation.x(), pose.orientation.y(), pose.orientation.z(),
+        pose.orientation.w()}}};
+  beam::AddTransformToJson(J_submap, pose.T_WORLD_SUBMAP, "T_WORLD_SUBMAP");
   beam::AddTransformToJson(J_submap, T_WORLD_SUBMAP_initial_,
                            "T_WORLD_SUBMAP_initial");
 
@@ -778,12 +1131,17 @@ void Submap::SaveData(const std::string& output_dir) {
   submap_file << std::setw(4) << J_submap << std::endl;
 
   // Save intrinsics
-  std::string camera_model_filename =
-      beam::CombinePaths(output_dir, "camera_model.json");
-  camera_model_->WriteJSON(camera_model_filename);
+  if (camera_model_) {
+    std::string camera_model_filename =
+        beam::CombinePaths(output_dir, "camera_model.json");
+    camera_model_->WriteJSON(camera_model_filename);
+  }
 
   // save landmarks
-  landmarks_.SaveToJson(beam::CombinePaths(output_dir, "landmarks.json"));
+  if (camera_data_.data) {
+    camera_data_.data->landmarks.SaveToJson(
+        beam::CombinePaths(output_dir, "landmarks.json"));
+  }
 
   // save lidar keyframes
   std::string lidar_keyframes_dir =
@@ -803,23 +1161,27 @@ void Submap::SaveData(const std::string& output_dir) {
     lidar_keyframes_counter++;
   }
 
-  // save camera keyframes
-  nlohmann::json J_camera_keyframes;
-  for (auto it = camera_keyframe_poses_.begin();
-       it != camera_keyframe_poses_.end(); it++) {
-    beam::AddPoseToJson(J_camera_keyframes, it->first, it->second);
-  }
-  std::string camera_keyframes_filename =
-      beam::CombinePaths(output_dir, "camera_keyframes.json");
-  std::ofstream camera_keyframe_file(camera_keyframes_filename);
-  camera_keyframe_file << std::setw(4) << J_camera_keyframes << std::endl;
-
-  // save keyframe images
-  std::string keyframe_dir = beam::CombinePaths(output_dir, "image_keyframes");
-  for (const auto& [time, image] : keyframe_images_) {
-    std::string keyframe_filename =
-        beam::CombinePaths(keyframe_dir, std::to_string(time) + ".png");
-    cv::imwrite(keyframe_filename, image);
+  // save camera keyframes and keyframe images
+  if (camera_data_.data) {
+    nlohmann::json J_camera_keyframes;
+    for (const auto& [stamp, T] : camera_data_.data->keyframe_poses) {
+      beam::AddPoseToJson(J_camera_keyframes, stamp, T);
+    }
+    std::string camera_keyframes_filename =
+        beam::CombinePaths(output_dir, "camera_keyframes.json");
+    std::ofstream camera_keyframe_file(camera_keyframes_filename);
+    camera_keyframe_file << std::setw(4) << J_camera_keyframes << std::endl;
+
+    const auto& keyframe_images = camera_data_.data->keyframe_images;
+    std::string keyframe_dir =
+        beam::CombinePaths(output_dir, "image_keyframes");
+    for (const uint64_t time : keyframe_images.Stamps()) {
+      const cv::Mat image = keyframe_images.Get(time);
+      if (image.empty()) { continue; }
+      std::string keyframe_filename =
+          beam::CombinePaths(keyframe_dir, std::to_string(time) + ".png");
+      cv::imwrite(keyframe_filename, image);
+    }
   }
 
   // save subframes
@@ -846,66 +1208,375 @@ void Submap::SaveData(const std::string& output_dir) {
     subframe_file << std::setw(4) << J_subframes << std::endl;
     subframes_counter++;
   }
+
+  // save scan contexts
+  if (scan_contexts_.empty()) { return; }
+  nlohmann::json J_scan_contexts;
+  J_scan_contexts["num_scans_aggregated"] = scan_contexts_num_aggregated_;
+  J_scan_contexts["scan_contexts"] = nlohmann::json::array();
+  for (const auto& [stamp, descriptor] : scan_contexts_) {
+    J_scan_contexts["scan_contexts"].push_back(
+        {{"stamp_nsecs", stamp},
+         {"rows", descriptor.rows()},
+         {"cols", descriptor.cols()},
+         {"data", std::vector<double>(descriptor.data(),
+                                      descriptor.data() + descriptor.size())}});
+  }
+  std::string scan_contexts_filename =
+      beam::CombinePaths(output_dir, "scan_contexts.json");
+  std::ofstream scan_contexts_file(scan_contexts_filename);
+  scan_contexts_file << J_scan_contexts << std::endl;
 }
 
-void Submap::TriangulateKeypoints(bool override_points) {
-  if (landmark_positions_.size() != 0 && !override_points) { return; }
+bool Submap::SaveData(bs_common::ChunkFileWriter& writer,
+                      uint16_t submap_id) {
+  // general data, camera keyframes and subframes
+  bs_common::ByteWriter data;
+  data.Write<uint64_t>(stamp_.toNSec());
+  const PoseState pose = pose_;
+  data.Write<int32_t>(pose.graph_updates);
+  data.WriteMatrix(
+      Eigen::Vector3d(pose.position.x(), pose.position.y(), pose.position.z()));
+  data.WriteMatrix(Eigen::Vector4d(pose.orientation.x(), pose.orientation.y(),
+                                   pose.orientation.z(), pose.orientation.w()));
+  data.WriteMatrix(pose.T_WORLD_SUBMAP);
+  data.WriteMatrix(T_WORLD_SUBMAP_initial_);
+  const CameraData* camera_data = camera_data_.data.get();
+  data.Write<uint64_t>(camera_data ? camera_data->keyframe_poses.size() : 0);
+  if (camera_data) {
+    for (const auto& [stamp, T_SUBMAP_KEYFRAME] : camera_data->keyframe_poses) {
+      data.Write<uint64_t>(stamp);
+      data.WriteMatrix(T_SUBMAP_KEYFRAME);
+    }
+  }
+  data.Write<uint64_t>(subframe_poses_.size());
+  for (const auto& [stamp, poses] : subframe_poses_) {
+    data.Write<uint64_t>(stamp);
+    data.Write<uint64_t>(poses.size());
+    for (const auto& pose_stamped : poses) {
+      data.Write<uint64_t>(pose_stamped.stamp.toNSec());
+      data.WriteMatrix(pose_stamped.pose);
+    }
+  }
+  data.Write<uint32_t>(lidar_keyframe_poses_.size());
+  const std::vector<uint64_t> image_stamps =
+      camera_data ? camera_data->keyframe_images.Stamps()
+                  : std::vector<uint64_t>();
+  data.Write<uint32_t>(image_stamps.size());
+  if (!writer.AddChunk(static_cast<uint32_t>(MapChunkType::SUBMAP),
+                       MapChunkId(submap_id), data)) {
+    return false;
+  }
 
-  // get the sensor id for the first landmark measurement.
-  // Note: this will only work for one camera
-  auto sensor_id = landmarks_.begin()->sensor_id;
+  // landmarks
+  if (camera_data && camera_data->landmarks.size() > 0) {
+    data.Clear();
+    data.Write<uint64_t>(camera_data->landmarks.size());
+    for (const auto& measurement : camera_data->landmarks) {
+      data.Write<uint64_t>(measurement.time_point.toNSec());
+      data.Write<uint8_t>(measurement.sensor_id);
+      data.Write<uint64_t>(measurement.landmark_id);
+      data.Write<uint64_t>(measurement.image);
+      data.WriteMatrix(measurement.value);
+      WriteMat(data, measurement.descriptor);
+    }
+    if (!writer.AddChunk(static_cast<uint32_t>(MapChunkType::LANDMARKS),
+                         MapChunkId(submap_id), data)) {
+      return false;
+    }
+  }
 
-  // get all landmark ids
-  std::vector<uint64_t> landmark_ids = landmarks_.GetLandmarkIDs();
+  if (!SaveLidarClouds(writer, submap_id)) { return false; }
+
+  // keyframe images, encoded the same as the png files of the directory
+  // format
+  uint32_t index = 0;
+  for (const uint64_t stamp : image_stamps) {
+    const cv::Mat image = camera_data->keyframe_images.Get(stamp);
+    std::vector<uint8_t> encoded;
+    if (!image.empty()) { cv::imencode(".png", image, encoded); }
+    data.Clear();
+    data.Write<uint64_t>(stamp);
+    data.WriteVector(encoded);
+    if (!writer.AddChunk(static_cast<uint32_t>(MapChunkType::KEYFRAME_IMAGE),
+                         MapChunkId(submap_id, index++), data)) {
+      return false;
+    }
+  }
 
-  // iterate through all landmarks and triangulate point based on track
-  for (auto landmark_id : landmark_ids) {
-    // get track
-    auto track = landmarks_.GetTrack(landmark_id);
-    if (track.size() < 2) { continue; }
+  // scan contexts
+  if (scan_contexts_.empty()) { return true; }
+  data.Clear();
+  data.Write<int32_t>(scan_contexts_num_aggregated_);
+  data.Write<uint64_t>(scan_contexts_.size());
+  for (const auto& [stamp, descriptor] : scan_contexts_) {
+    data.Write<uint64_t>(stamp);
+    WriteMatrixXd(data, descriptor);
+  }
+  return writer.AddChunk(static_cast<uint32_t>(MapChunkType::SCAN_CONTEXTS),
+                         MapChunkId(submap_id), data);
+}
 
-    // precompute inverse submap pose
-    Eigen::Matrix4d T_SUBMAP_WORLD = beam::InvertTransform(T_WORLD_SUBMAP_);
+bool Submap::LoadData(const bs_common::ChunkFileReader& reader,
+                      uint16_t submap_id, bool load_lidar_clouds) {
+  const bs_common::ChunkInfo* submap_chunk = reader.Find(
+      static_cast<uint32_t>(MapChunkType::SUBMAP), MapChunkId(submap_id));
+  // the landmarks chunk is only stored if there are landmarks
+  const bs_common::ChunkInfo* landmarks_chunk = reader.Find(
+      static_cast<uint32_t>(MapChunkType::LANDMARKS), MapChunkId(submap_id));
+  if (!submap_chunk) {
+    BEAM_ERROR("Submap {} not found in map store, not loading submap data.",
+               submap_id);
+    return false;
+  }
 
-    // get poses and pixels for each measurement in the track
-    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_CAM_WORLD;
-    std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
-    for (const beam_containers::LandmarkMeasurement& measurement : track) {
-      // find keyframe from measurement stamp
-      std::map<uint64_t, Eigen::Matrix4d>::const_iterator keyframe_pose =
-          camera_keyframe_poses_.find(measurement.time_point.toNSec());
-      if (keyframe_pose == camera_keyframe_poses_.end()) { continue; }
-
-      // get transform from world to camera to project points
-      const Eigen::Matrix4d& T_SUBMAP_BASELINK = keyframe_pose->second;
-      Eigen::Matrix4d T_BASELINK_SUBMAP =
-          beam::InvertTransform(T_SUBMAP_BASELINK);
-      Eigen::Matrix4d T_CAM_BASELINK(Eigen::Matrix4d::Identity());
-      if (!extrinsics_->GetT_CAMERA_IMU(T_CAM_BASELINK)) {
-        BEAM_ERROR(
-            "Cannot lookup transform from camera to IMU. Using identity.");
+  uint32_t num_lidar_keyframes;
+  uint32_t num_images;
+  try {
+    // general data, camera keyframes and subframes
+    bs_common::ByteReader data = reader.Read(*submap_chunk);
+    stamp_.fromNSec(data.Read<uint64_t>());
+    pose_.graph_updates = data.Read<int32_t>();
+    Eigen::Vector3d position;
+    Eigen::Vector4d orientation_xyzw;
+    data.ReadMatrix(position);
+    data.ReadMatrix(orientation_xyzw);
+    pose_.position =
+        fuse_variables::Position3DStamped(stamp_, fuse_core::uuid::NIL);
+    pose_.position.x() = position.x();
+    pose_.position.y() = position.y();
+    pose_.position.z() = position.z();
+    pose_.orientation =
+        fuse_variables::Orientation3DStamped(stamp_, fuse_core::uuid::NIL);
+    pose_.orientation.x() = orientation_xyzw[0];
+    pose_.orientation.y() = orientation_xyzw[1];
+    pose_.orientation.z() = orientation_xyzw[2];
+    pose_.orientation.w() = orientation_xyzw[3];
+    data.ReadMatrix(pose_.T_WORLD_SUBMAP);
+    data.ReadMatrix(T_WORLD_SUBMAP_initial_);
+    T_SUBMAP_WORLD_initial_ = beam::InvertTransform(T_WORLD_SUBMAP_initial_);
+
+    const uint64_t num_camera_keyframes = data.Read<uint64_t>();
+    for (uint64_t i = 0; i < num_camera_keyframes; i++) {
+      const uint64_t stamp = data.Read<uint64_t>();
+      Eigen::Matrix4d T_SUBMAP_KEYFRAME;
+      data.ReadMatrix(T_SUBMAP_KEYFRAME);
+      CameraDataMutable().keyframe_poses.emplace(stamp, T_SUBMAP_KEYFRAME);
+    }
+    const uint64_t num_subframes = data.Read<uint64_t>();
+    for (uint64_t i = 0; i < num_subframes; i++) {
+      const uint64_t stamp = data.Read<uint64_t>();
+      const uint64_t num_poses = data.Read<uint64_t>();
+      if (num_poses > data.Remaining()) {
+        throw std::runtime_error("invalid number of subframe poses");
+      }
+      std::vector<PoseStamped> poses(num_poses);
+      for (auto& pose_stamped : poses) {
+        pose_stamped.stamp.fromNSec(data.Read<uint64_t>());
+        data.ReadMatrix(pose_stamped.pose);
       }
-      Eigen::Matrix4d T_CAM_WORLD =
-          T_CAM_BASELINK * T_BASELINK_SUBMAP * T_SUBMAP_WORLD;
+      subframe_poses_.emplace(stamp, std::move(poses));
+    }
+    num_lidar_keyframes = data.Read<uint32_t>();
+    num_images = data.Read<uint32_t>();
+
+    // landmarks
+    if (landmarks_chunk) { data = reader.Read(*landmarks_chunk); }
+    const uint64_t num_landmarks = landmarks_chunk ? data.Read<uint64_t>() : 0;
+    for (uint64_t i = 0; i < num_landmarks; i++) {
+      beam_containers::LandmarkMeasurement measurement;
+      measurement.time_point.fromNSec(data.Read<uint64_t>());
+      measurement.sensor_id = data.Read<uint8_t>();
+      measurement.landmark_id = data.Read<uint64_t>();
+      measurement.image = data.Read<uint64_t>();
+      data.ReadMatrix(measurement.value);
+      measurement.descriptor = ReadMat(data);
+      CameraDataMutable().landmarks.Insert(measurement);
+    }
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Cannot load submap {} from map store, invalid data: {}",
+               submap_id, e.what());
+    return false;
+  }
+
+  // lidar keyframes
+  for (uint32_t i = 0; i < num_lidar_keyframes; i++) {
+    const bs_common::ChunkInfo* chunk =
+        reader.Find(static_cast<uint32_t>(MapChunkType::LIDAR_KEYFRAME),
+                    MapChunkId(submap_id, i));
+    if (!chunk) {
+      BEAM_ERROR("Lidar keyframe {} of submap {} not found in map store.", i,
+                 submap_id);
+      return false;
+    }
+    bs_common::ByteReader data = reader.Read(*chunk);
+    ScanPose scan_pose(ros::Time(0), Eigen::Matrix4d::Identity());
+    if (!scan_pose.Deserialize(data, load_lidar_clouds)) { return false; }
+    lidar_keyframe_poses_.emplace(scan_pose.Stamp().toNSec(), scan_pose);
+  }
+
+  // keyframe images, the encoded data is decoded straight from the mapping
+  for (uint32_t i = 0; i < num_images; i++) {
+    const bs_common::ChunkInfo* chunk =
+        reader.Find(static_cast<uint32_t>(MapChunkType::KEYFRAME_IMAGE),
+                    MapChunkId(submap_id, i));
+    if (!chunk) { continue; }
+    try {
+      bs_common::ByteReader data = reader.Read(*chunk);
+      const uint64_t stamp = data.Read<uint64_t>();
+      const uint64_t size = data.Read<uint64_t>();
+      if (size == 0) { continue; }
+      const cv::Mat encoded(1, static_cast<int>(size), CV_8U,
+                            const_cast<uint8_t*>(data.ReadBytes(size)));
+      CameraDataMutable().keyframe_images.Add(
+          stamp, cv::imdecode(encoded, cv::IMREAD_UNCHANGED));
+    } catch (const std::runtime_error& e) {
+      BEAM_WARN("Cannot load keyframe image {} of submap {}: {}", i, submap_id,
+                e.what());
+    }
+  }
+
+  // scan contexts, optional since they are recomputed when missing
+  const bs_common::ChunkInfo* scan_contexts_chunk =
+      reader.Find(static_cast<uint32_t>(MapChunkType::SCAN_CONTEXTS),
+                  MapChunkId(submap_id));
+  if (!scan_contexts_chunk) { return true; }
+  try {
+    bs_common::ByteReader data = reader.Read(*scan_contexts_chunk);
+    const int32_t num_scans_aggregated = data.Read<int32_t>();
+    const uint64_t num_descriptors = data.Read<uint64_t>();
+    std::map<uint64_t, Eigen::MatrixXd> descriptors;
+    for (uint64_t i = 0; i < num_descriptors; i++) {
+      const uint64_t stamp = data.Read<uint64_t>();
+      descriptors.emplace(stamp, ReadMatrixXd(data));
+    }
+    SetScanContexts(num_scans_aggregated, descriptors);
+  } catch (const std::runtime_error& e) {
+    BEAM_WARN("Cannot load scan contexts of submap {}: {}", submap_id,
+              e.what());
+  }
+  return true;
+}
+
+bool Submap::SaveLidarClouds(bs_common::ChunkFileWriter& writer,
+                             uint16_t submap_id) const {
+  bs_common::ByteWriter data;
+  uint32_t index = 0;
+  for (const auto& [stamp, scan_pose] : lidar_keyframe_poses_) {
+    data.Clear();
+    scan_pose.Serialize(data);
+    if (!writer.AddChunk(static_cast<uint32_t>(MapChunkType::LIDAR_KEYFRAME),
+                         MapChunkId(submap_id, index++), data)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Submap::LoadLidarClouds(const bs_common::ChunkFileReader& reader,
+                             uint16_t submap_id) {
+  // keyframes are stored in stamp order, same as the map
+  uint32_t index = 0;
+  for (auto& [stamp, scan_pose] : lidar_keyframe_poses_) {
+    const bs_common::ChunkInfo* chunk =
+        reader.Find(static_cast<uint32_t>(MapChunkType::LIDAR_KEYFRAME),
+                    MapChunkId(submap_id, index++));
+    if (!chunk) {
+      BEAM_ERROR("Lidar keyframe {} of submap {} not found in map store.",
+                 index - 1, submap_id);
+      return false;
+    }
+    bs_common::ByteReader data = reader.Read(*chunk);
+    if (!scan_pose.LoadClouds(data)) { return false; }
+  }
+  lidar_map_cache_ = LidarMapCache();
+  lidar_map_cache_initial_ = LidarMapCache();
+  return true;
+}
+
+void Submap::ReleaseLidarClouds() {
+  for (auto& [stamp, scan_pose] : lidar_keyframe_poses_) {
+    scan_pose.ReleaseClouds();
+  }
+  lidar_map_cache_ = LidarMapCache();
+  lidar_map_cache_initial_ = LidarMapCache();
+}
+
+void Submap::CompressLidarKeyframes() {
+  for (auto& [stamp, scan_pose] : lidar_keyframe_poses_) {
+    scan_pose.CompressClouds();
+  }
+}
+
+void Submap::TriangulateKeypoints(bool override_points) {
+  if (!camera_data_.data) { return; }
+  CameraData& camera_data = *camera_data_.data;
+  if (!override_points &&
+      camera_data.landmark_positions_num_measurements ==
+          camera_data.landmarks.size() &&
+      camera_data.landmark_positions_keyframe_poses ==
+          camera_data.keyframe_poses) {
+    return;
+  }
+  camera_data.landmark_positions.clear();
+  camera_data.landmark_positions_keyframe_poses = camera_data.keyframe_poses;
+  camera_data.landmark_positions_num_measurements =
+      camera_data.landmarks.size();
+  if (camera_data.landmarks.size() == 0) { return; }
+  if (!camera_model_) {
+    BEAM_ERROR("Submap has no camera model, cannot triangulate keypoints.");
+    return;
+  }
+
+  Eigen::Matrix4d T_CAM_BASELINK(Eigen::Matrix4d::Identity());
+  if (!extrinsics_->GetT_CAMERA_IMU(T_CAM_BASELINK)) {
+    BEAM_ERROR("Cannot lookup transform from camera to IMU. Using identity.");
+  }
 
-      // add results to vector
-      Ts_CAM_WORLD.push_back(T_CAM_WORLD);
-      pixels.push_back(measurement.value.cast<int>());
+  // precompute the transform from submap to camera of each keyframe
+  std::unordered_map<uint64_t, Eigen::Matrix4d> Ts_CAM_SUBMAP;
+  for (const auto& [stamp, T_SUBMAP_BASELINK] : camera_data.keyframe_poses) {
+    Ts_CAM_SUBMAP.emplace(stamp, T_CAM_BASELINK *
+                                     beam::InvertTransform(T_SUBMAP_BASELINK));
+  }
+
+  // get poses and pixels for each measurement in the track of each landmark
+  std::vector<uint64_t> landmark_ids;
+  std::vector<vision::BatchTriangulator::Request> requests;
+  for (auto landmark_id : camera_data.landmarks.GetLandmarkIDs()) {
+    auto track = camera_data.landmarks.GetTrack(landmark_id);
+    if (track.size() < 2) { continue; }
+    vision::BatchTriangulator::Request request;
+    for (const beam_containers::LandmarkMeasurement& measurement : track) {
+      auto T_CAM_SUBMAP = Ts_CAM_SUBMAP.find(measurement.time_point.toNSec());
+      if (T_CAM_SUBMAP == Ts_CAM_SUBMAP.end()) { continue; }
+      request.T_cam_world.push_back(T_CAM_SUBMAP->second);
+      request.pixels.push_back(measurement.value.cast<int>());
+    }
+    landmark_ids.push_back(landmark_id);
+    requests.push_back(std::move(request));
+  }
+
+  // triangulate points and add the successful ones
+  const vision::BatchTriangulator triangulator(
+      camera_model_, std::max<int>(std::thread::hardware_concurrency(), 1));
+  const auto points = triangulator.Triangulate(requests, 100.0, 20.0);
+  for (size_t i = 0; i < points.size(); i++) {
+    if (points[i]) {
+      camera_data.landmark_positions.emplace(landmark_ids[i], *points[i]);
     }
-    // triangulate point and add if successful
-    auto point = beam_cv::Triangulation::TriangulatePoint(
-        camera_model_, Ts_CAM_WORLD, pixels, 100.0, 20.0);
-    if (point) { landmark_positions_.emplace(landmark_id, point.value()); }
   }
 }
 
 bool Submap::FindT_SUBMAP_KEYFRAME(uint64_t time,
                                    Eigen::Matrix4d& T_SUBMAP_KEYFRAME) const {
   // first, look for timestamp in camera keyframe poses (these take priority)
-  auto iter_cam = camera_keyframe_poses_.find(time);
-  if (iter_cam != camera_keyframe_poses_.end()) {
-    T_SUBMAP_KEYFRAME = iter_cam->second;
-    return true;
+  if (camera_data_.data) {
+    auto iter_cam = camera_data_.data->keyframe_poses.find(time);
+    if (iter_cam != camera_data_.data->keyframe_poses.end()) {
+      T_SUBMAP_KEYFRAME = iter_cam->second;
+      return true;
+    }
   }
 
   auto iter_lid = lidar_keyframe_poses_.find(time);
@@ -1,13 +1,29 @@
 #include <bs_models/global_mapping/submap_alignment.h>
 
+#include <atomic>
 #include <filesystem>
 
+#include <beam_filtering/VoxelDownsample.h>
 #include <beam_matching/Matchers.h>
 
+#include <bs_common/thread_pool.h>
+
 namespace bs_models::global_mapping {
 
 using namespace beam_matching;
 
+namespace {
+
+PointCloud Downsample(const PointCloud& cloud, double voxel_size) {
+  const float v = voxel_size;
+  beam_filtering::VoxelDownsample voxel_filter(Eigen::Vector3f(v, v, v));
+  voxel_filter.SetInputCloud(std::make_shared<PointCloud>(cloud));
+  voxel_filter.Filter();
+  return voxel_filter.GetFilteredCloud();
+}
+
+} // namespace
+
 SubmapAlignment::SubmapAlignment(const SubmapAlignment::Params& params,
                                  const std::string& output_path)
     : params_(params), output_path_(output_path) {}
@@ -18,27 +34,81 @@ bool SubmapAlignment::Run(std::vector<SubmapPtr> submaps) {
         "Not enough submaps to run submap alignment, at least two are needed");
     return true;
   }
+  if (!output_path_.empty() && !std::filesystem::exists(output_path_)) {
+    BEAM_ERROR("Invalid output path for submap alignment: {}", output_path_);
+    throw std::runtime_error{"invalid path"};
+  }
 
-  for (uint16_t i = 1; i < submaps.size(); i++) {
-    BEAM_INFO("Aligning submap No. {}/{}", i, submaps.size() - 1);
-    if (!AlignSubmaps(submaps.at(i - 1), submaps.at(i))) {
-      BEAM_ERROR("Submap alignment failed, exiting.");
-      return false;
+  // cached results depend on the matcher config and the pyramid levels
+  uint64_t cache_context = 0;
+  if (cache_) {
+    std::string stage = "submap_alignment";
+    for (const double voxel_size : params_.pyramid_voxel_sizes) {
+      stage += " " + std::to_string(voxel_size);
     }
+    cache_context = RegistrationCache::ContextId(stage, params_.matcher_config);
   }
-  return true;
-}
 
-bool SubmapAlignment::AlignSubmaps(const SubmapPtr& submap_ref,
-                                   SubmapPtr& submap_tgt) {
-  if (!output_path_.empty() && !std::filesystem::exists(output_path_)) {
-    BEAM_ERROR("Invalid output path for submap alignment: {}", output_path_);
-    throw std::runtime_error{"invalid path"};
+  // align all pairs (i, i + 1) in parallel. Each worker creates its matcher
+  // once, then takes the next pair until all are aligned
+  const size_t num_pairs = submaps.size() - 1;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_SubmapRef_SubmapTgt(
+      num_pairs);
+  bs_common::ThreadPool pool(static_cast<int>(
+      std::min<size_t>(std::max(params_.num_threads, 1), num_pairs)));
+  std::atomic<size_t> next_pair{0};
+  std::atomic<size_t> num_done{0};
+  try {
+    pool.ParallelFor(pool.NumThreads(), [&](size_t) {
+      std::unique_ptr<Matcher<PointCloudPtr>> matcher;
+      std::unique_ptr<Matcher<LoamPointCloudPtr>> matcher_loam;
+      CreateMatchers(matcher, matcher_loam);
+      for (size_t i = next_pair++; i < num_pairs; i = next_pair++) {
+        if (!AlignSubmapsCached(*submaps.at(i), *submaps.at(i + 1),
+                                matcher.get(), matcher_loam.get(),
+                                cache_context, T_SubmapRef_SubmapTgt.at(i))) {
+          BEAM_WARN("Failed to align submap No. {}, keeping its initial "
+                    "relative pose",
+                    i + 1);
+        }
+        BEAM_INFO("Aligned submap No. {} ({}/{})", i + 1, ++num_done,
+                  num_pairs);
+      }
+    });
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Submap alignment failed, exiting. Reason: {}", e.what());
+    return false;
   }
 
-  // Setup matchers
-  std::unique_ptr<Matcher<PointCloudPtr>> matcher;
-  std::unique_ptr<Matcher<LoamPointCloudPtr>> matcher_loam;
+  // chain the relative poses starting from the first submap
+  for (size_t i = 0; i < num_pairs; i++) {
+    const SubmapPtr& submap_ref = submaps.at(i);
+    SubmapPtr& submap_tgt = submaps.at(i + 1);
+    const auto T_W_B_i = submap_tgt->T_WORLD_SUBMAP();
+    if (!output_path_.empty()) {
+      SaveSubmaps(*submap_ref, *submap_tgt, "target_initial.pcd", 255, 0, 0,
+                  true);
+    }
+
+    // set new submap pose
+    submap_tgt->UpdatePose(submap_ref->T_WORLD_SUBMAP() *
+                           T_SubmapRef_SubmapTgt.at(i));
+
+    if (!output_path_.empty()) {
+      SaveSubmaps(*submap_ref, *submap_tgt, "target_aligned.pcd", 0, 255, 0,
+                  false);
+    }
+
+    const auto T_W_B_f = submap_tgt->T_WORLD_SUBMAP();
+    RegistrationResult result(T_W_B_i, T_W_B_f);
+    results_.emplace(submap_tgt->Stamp(), result);
+  }
+  return true;
+}
+
+void SubmapAlignment::CreateMatchers(
+    std::unique_ptr<Matcher<PointCloudPtr>>& matcher,
+    std::unique_ptr<Matcher<LoamPointCloudPtr>>& matcher_loam) const {
   const auto& m_conf = params_.matcher_config;
   auto matcher_type = GetTypeFromConfig(m_conf);
   if (matcher_type == MatcherType::LOAM) {
@@ -56,141 +126,127 @@ bool SubmapAlignment::AlignSubmaps(const SubmapPtr& submap_ref,
     BEAM_ERROR("Invalid matcher type");
     throw std::invalid_argument{"invalid json"};
   }
+}
 
-  std::string dir = "submap_" + std::to_string(submap_tgt->Stamp().toSec());
-  std::string submap_output = output_path_.empty()
-                                  ? output_path_
-                                  : beam::CombinePaths(output_path_, dir);
-  std::filesystem::create_directory(submap_output);
+bool SubmapAlignment::AlignSubmapsCached(
+    const Submap& submap_ref, const Submap& submap_tgt,
+    Matcher<PointCloudPtr>* matcher, Matcher<LoamPointCloudPtr>* matcher_loam,
+    uint64_t cache_context, Eigen::Matrix4d& T_SubmapRef_SubmapTgt) const {
+  if (!cache_) {
+    return AlignSubmaps(submap_ref, submap_tgt, matcher, matcher_loam,
+                        T_SubmapRef_SubmapTgt);
+  }
 
-  Eigen::Matrix4d T_World_SubmapRef = submap_ref->T_WORLD_SUBMAP();
-  Eigen::Matrix4d T_World_SubmapRef_Init = submap_ref->T_WORLD_SUBMAP_INIT();
-  Eigen::Matrix4d T_World_SubmapTgt_Init = submap_tgt->T_WORLD_SUBMAP_INIT();
+  const RegistrationCache::Key key = cache_->MakeKey(
+      cache_context, cache_->SubmapId(submap_ref), cache_->SubmapId(submap_tgt),
+      beam::InvertTransform(submap_ref.T_WORLD_SUBMAP_INIT()) *
+          submap_tgt.T_WORLD_SUBMAP_INIT());
+  RegistrationCache::Result result;
+  if (cache_->Find(key, result)) {
+    T_SubmapRef_SubmapTgt = result.T_REFERENCE_TARGET;
+    return result.successful;
+  }
+
+  result.successful = AlignSubmaps(submap_ref, submap_tgt, matcher,
+                                   matcher_loam, T_SubmapRef_SubmapTgt);
+  result.T_REFERENCE_TARGET = T_SubmapRef_SubmapTgt;
+  cache_->Insert(key, result);
+  return result.successful;
+}
 
+bool SubmapAlignment::AlignSubmaps(
+    const Submap& submap_ref, const Submap& submap_tgt,
+    Matcher<PointCloudPtr>* matcher, Matcher<LoamPointCloudPtr>* matcher_loam,
+    Eigen::Matrix4d& T_SubmapRef_SubmapTgt) const {
   // get initial relative pose
-  Eigen::Matrix4d T_SubmapRef_SubmapTgt_Init =
-      beam::InvertTransform(T_World_SubmapRef_Init) * T_World_SubmapTgt_Init;
+  const Eigen::Matrix4d T_SubmapRef_SubmapTgt_Init =
+      beam::InvertTransform(submap_ref.T_WORLD_SUBMAP_INIT()) *
+      submap_tgt.T_WORLD_SUBMAP_INIT();
+  T_SubmapRef_SubmapTgt = T_SubmapRef_SubmapTgt_Init;
 
-  const auto T_W_B_i = submap_tgt->T_WORLD_SUBMAP();
-  const bool use_initials = false;
   if (matcher_loam) {
-    // first get maps in their initial world frame
     LoamPointCloudPtr ref_in_ref_submap_frame =
         std::make_shared<LoamPointCloud>(
-            submap_ref->GetLidarLoamPointsInWorldFrame(use_initials));
+            submap_ref.GetLidarLoamPointsInSubmapFrame());
     LoamPointCloudPtr tgt_in_ref_submap_frame =
         std::make_shared<LoamPointCloud>(
-            submap_tgt->GetLidarLoamPointsInWorldFrame(use_initials));
-
-    // then transform to the reference submap frame
-    Eigen::Matrix4d T_SubmapRef_WorldInit =
-        beam::InvertTransform(T_World_SubmapRef_Init);
-    ref_in_ref_submap_frame->TransformPointCloud(T_SubmapRef_WorldInit);
-    tgt_in_ref_submap_frame->TransformPointCloud(T_SubmapRef_WorldInit);
+            submap_tgt.GetLidarLoamPointsInSubmapFrame(),
+            T_SubmapRef_SubmapTgt_Init);
 
     // align
     matcher_loam->SetRef(ref_in_ref_submap_frame);
     matcher_loam->SetTarget(tgt_in_ref_submap_frame);
-    bool match_success = matcher_loam->Match();
-    Eigen::Matrix4d T_SubmapRef_SubmapTgt =
+    if (!matcher_loam->Match()) { return false; }
+    T_SubmapRef_SubmapTgt =
         matcher_loam->ApplyResult(T_SubmapRef_SubmapTgt_Init);
-    Eigen::Matrix4d T_World_SubmapTgt =
-        T_World_SubmapRef * T_SubmapRef_SubmapTgt;
-
-    Eigen::Vector3d t_W_BS = submap_tgt->LidarKeyframes()
-                                 .begin()
-                                 ->second.T_REFFRAME_BASELINK()
-                                 .block(0, 3, 3, 1);
-    Eigen::Vector3d t_W_BE = submap_tgt->LidarKeyframes()
-                                 .rbegin()
-                                 ->second.T_REFFRAME_BASELINK()
-                                 .block(0, 3, 3, 1);
-
-    if (!output_path_.empty()) {
-      PointCloud ref_in_world =
-          submap_ref->GetLidarPointsInWorldFrameCombined(use_initials);
-      PointCloud tgt_in_world =
-          submap_tgt->GetLidarPointsInWorldFrameCombined(use_initials);
-
-      std::string path_ref = beam::CombinePaths(submap_output, "reference.pcd");
-      SaveViewableSubmap(path_ref, ref_in_world, 0, 0, 255, t_W_BS, t_W_BE);
+    return true;
+  }
 
-      std::string path_init =
-          beam::CombinePaths(submap_output, "target_initial.pcd");
-      SaveViewableSubmap(path_init, tgt_in_world, 255, 0, 0, t_W_BS, t_W_BE);
+  const PointCloud ref_in_ref_submap_frame =
+      submap_ref.GetLidarPointsInSubmapFrame();
+  const PointCloud tgt_in_tgt_submap_frame =
+      submap_tgt.GetLidarPointsInSubmapFrame();
+
+  // align coarse to fine, where each level starts from the estimate of the
+  // previous one and the last level is at full resolution
+  std::vector<double> voxel_sizes = params_.pyramid_voxel_sizes;
+  voxel_sizes.push_back(0);
+  Eigen::Matrix4d T_SubmapRef_SubmapTgt_Est = T_SubmapRef_SubmapTgt_Init;
+  bool match_success = false;
+  for (const double voxel_size : voxel_sizes) {
+    PointCloudPtr ref = std::make_shared<PointCloud>();
+    PointCloudPtr tgt = std::make_shared<PointCloud>();
+    if (voxel_size > 0) {
+      *ref = Downsample(ref_in_ref_submap_frame, voxel_size);
+      pcl::transformPointCloud(Downsample(tgt_in_tgt_submap_frame, voxel_size),
+                               *tgt, T_SubmapRef_SubmapTgt_Est.cast<float>());
+    } else {
+      *ref = ref_in_ref_submap_frame;
+      pcl::transformPointCloud(tgt_in_tgt_submap_frame, *tgt,
+                               T_SubmapRef_SubmapTgt_Est.cast<float>());
     }
 
-    // set new submap pose
-    submap_tgt->UpdatePose(T_World_SubmapTgt);
-
-    if (!output_path_.empty()) {
-      PointCloud tgt_in_world_opt =
-          submap_tgt->GetLidarPointsInWorldFrameCombined();
-      std::string path_opt =
-          beam::CombinePaths(submap_output, "target_aligned.pcd");
-      SaveViewableSubmap(path_opt, tgt_in_world_opt, 0, 255, 0, t_W_BS, t_W_BE);
+    matcher->SetRef(ref);
+    matcher->SetTarget(tgt);
+    match_success = matcher->Match();
+    if (match_success) {
+      T_SubmapRef_SubmapTgt_Est =
+          matcher->ApplyResult(T_SubmapRef_SubmapTgt_Est);
     }
-  } else {
-    // first get maps in their initial world frame
-    PointCloud ref_in_world =
-        submap_ref->GetLidarPointsInWorldFrameCombined(use_initials);
-    PointCloud tgt_in_world =
-        submap_tgt->GetLidarPointsInWorldFrameCombined(use_initials);
-
-    // then transform to the reference submap frame
-    Eigen::Matrix4d T_SubmapRef_WorldInit =
-        beam::InvertTransform(T_World_SubmapRef_Init);
-    PointCloudPtr ref_in_ref_submap_frame = std::make_shared<PointCloud>();
-    PointCloudPtr tgt_in_ref_submap_frame = std::make_shared<PointCloud>();
-    pcl::transformPointCloud(ref_in_world, *ref_in_ref_submap_frame,
-                             T_SubmapRef_WorldInit.cast<float>());
-    pcl::transformPointCloud(tgt_in_world, *tgt_in_ref_submap_frame,
-                             T_SubmapRef_WorldInit.cast<float>());
-
-    // align
-    matcher->SetRef(ref_in_ref_submap_frame);
-    matcher->SetTarget(tgt_in_ref_submap_frame);
-    bool match_success = matcher->Match();
-    Eigen::Matrix4d T_SubmapRef_SubmapTgt =
-        matcher->ApplyResult(T_SubmapRef_SubmapTgt_Init);
-    Eigen::Matrix4d T_World_SubmapTgt =
-        T_World_SubmapRef * T_SubmapRef_SubmapTgt;
-
-    Eigen::Vector3d t_W_BS = submap_tgt->LidarKeyframes()
-                                 .begin()
-                                 ->second.T_REFFRAME_BASELINK()
-                                 .block(0, 3, 3, 1);
-    Eigen::Vector3d t_W_BE = submap_tgt->LidarKeyframes()
-                                 .rbegin()
-                                 ->second.T_REFFRAME_BASELINK()
-                                 .block(0, 3, 3, 1);
-
-    if (!output_path_.empty()) {
-      std::string path_ref = beam::CombinePaths(submap_output, "reference.pcd");
-      SaveViewableSubmap(path_ref, ref_in_world, 0, 0, 255, t_W_BS, t_W_BE);
+  }
 
-      std::string path_init =
-          beam::CombinePaths(submap_output, "target_initial.pcd");
-      SaveViewableSubmap(path_init, tgt_in_world, 255, 0, 0, t_W_BS, t_W_BE);
-    }
+  // only the full resolution result decides if the alignment succeeded
+  if (!match_success) { return false; }
+  T_SubmapRef_SubmapTgt = T_SubmapRef_SubmapTgt_Est;
+  return true;
+}
 
-    // set new submap pose
-    submap_tgt->UpdatePose(T_World_SubmapTgt);
+void SubmapAlignment::SaveSubmaps(const Submap& submap_ref,
+                                  const Submap& submap_tgt,
+                                  const std::string& tgt_filename, uint8_t r,
+                                  uint8_t g, uint8_t b, bool save_ref) const {
+  std::string dir = "submap_" + std::to_string(submap_tgt.Stamp().toSec());
+  std::string submap_output = beam::CombinePaths(output_path_, dir);
+  std::filesystem::create_directory(submap_output);
 
-    if (!output_path_.empty()) {
-      PointCloud tgt_in_world_opt =
-          submap_tgt->GetLidarPointsInWorldFrameCombined();
-      std::string path_opt =
-          beam::CombinePaths(submap_output, "target_initial.pcd");
-      SaveViewableSubmap(path_opt, tgt_in_world_opt, 0, 255, 0, t_W_BS, t_W_BE);
-    }
+  Eigen::Vector3d t_W_BS = submap_tgt.LidarKeyframes()
+                               .begin()
+                               ->second.T_REFFRAME_BASELINK()
+                               .block(0, 3, 3, 1);
+  Eigen::Vector3d t_W_BE = submap_tgt.LidarKeyframes()
+                               .rbegin()
+                               ->second.T_REFFRAME_BASELINK()
+                               .block(0, 3, 3, 1);
+
+  if (save_ref) {
+    std::string path_ref = beam::CombinePaths(submap_output, "reference.pcd");
+    SaveViewableSubmap(path_ref,
+                       submap_ref.GetLidarPointsInWorldFrameCombined(), 0, 0,
+                       255, t_W_BS, t_W_BE);
   }
-
-  const auto T_W_B_f = submap_tgt->T_WORLD_SUBMAP();
-  RegistrationResult result(T_W_B_i, T_W_B_f);
-  results_.emplace(submap_tgt->Stamp(), result);
-
-  return true;
+  std::string path_tgt = beam::CombinePaths(submap_output, tgt_filename);
+  SaveViewableSubmap(path_tgt, submap_tgt.GetLidarPointsInWorldFrameCombined(),
+                     r, g, b, t_W_BS, t_W_BE);
 }
 
-} // namespace bs_models::global_mapping
\ No newline at end of file
+} // namespace bs_models::global_mapping
@@ -0,0 +1,257 @@
+#include <bs_models/global_mapping/submap_evictor.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+#include <unistd.h>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/instrumentation.h>
+#include <bs_models/global_mapping/map_store.h>
+
+namespace bs_models::global_mapping {
+
+void SubmapEvictor::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("distance_m")) { distance_m = J["distance_m"]; }
+  if (J.contains("max_resident_submaps")) {
+    max_resident_submaps = J["max_resident_submaps"];
+  }
+  if (J.contains("directory")) { directory = J["directory"]; }
+  if (distance_m < 0 || max_resident_submaps < 0) {
+    BEAM_ERROR("Submap eviction distance_m and max_resident_submaps must not "
+               "be negative");
+    throw std::invalid_argument{"invalid submap eviction params"};
+  }
+}
+
+nlohmann::json SubmapEvictor::Params::ToJson() const {
+  return nlohmann::json{{"enabled", enabled},
+                        {"distance_m", distance_m},
+                        {"max_resident_submaps", max_resident_submaps},
+                        {"directory", directory}};
+}
+
+SubmapEvictor::Lease::~Lease() {
+  Release();
+}
+
+SubmapEvictor::Lease::Lease(Lease&& other) noexcept
+    : evictor_(other.evictor_),
+      submap_ids_(std::move(other.submap_ids_)),
+      valid_(other.valid_) {
+  other.evictor_ = nullptr;
+  other.submap_ids_.clear();
+}
+
+SubmapEvictor::Lease& SubmapEvictor::Lease::operator=(Lease&& other) noexcept {
+  if (this == &other) { return *this; }
+  Release();
+  evictor_ = other.evictor_;
+  submap_ids_ = std::move(other.submap_ids_);
+  valid_ = other.valid_;
+  other.evictor_ = nullptr;
+  other.submap_ids_.clear();
+  return *this;
+}
+
+void SubmapEvictor::Lease::Release() {
+  if (evictor_) { evictor_->Unpin(submap_ids_); }
+  evictor_ = nullptr;
+  submap_ids_.clear();
+}
+
+SubmapEvictor::SubmapEvictor(const Params& params) : params_(params) {
+  if (!std::filesystem::is_directory(params_.directory)) {
+    BEAM_ERROR("Submap eviction directory does not exist: {}",
+               params_.directory);
+    throw std::invalid_argument{"invalid submap eviction directory"};
+  }
+}
+
+SubmapEvictor::~SubmapEvictor() {
+  for (const std::string& path : spill_paths_) {
+    if (!path.empty()) { std::remove(path.c_str()); }
+  }
+}
+
+size_t SubmapEvictor::Update(const std::vector<SubmapPtr>& submaps,
+                             size_t num_completed,
+                             const Eigen::Vector3d& t_WORLD_BASELINK) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AddSubmaps(submaps);
+  t_WORLD_BASELINK_ = t_WORLD_BASELINK;
+
+  // newly completed submaps are the most recently used
+  num_completed = std::min(num_completed, submaps_.size());
+  for (size_t id = 0; id < num_completed; id++) {
+    if (resident_.at(id) || evicted_.at(id)) { continue; }
+    resident_.at(id) = true;
+    lru_.push_front(id);
+    lru_positions_.at(id) = lru_.begin();
+  }
+  return EvictToPolicy();
+}
+
+SubmapEvictor::Lease
+    SubmapEvictor::Acquire(const std::vector<SubmapPtr>& submaps,
+                           std::vector<size_t> submap_ids) {
+  static bs_common::Metric& load_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_evictor/load");
+  std::sort(submap_ids.begin(), submap_ids.end());
+  submap_ids.erase(std::unique(submap_ids.begin(), submap_ids.end()),
+                   submap_ids.end());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  AddSubmaps(submaps);
+  Lease lease;
+  lease.evictor_ = this;
+  for (const size_t id : submap_ids) {
+    if (id >= submaps_.size()) {
+      throw std::out_of_range{"submap id out of range of evictor"};
+    }
+    num_leases_.at(id)++;
+    lease.submap_ids_.push_back(id);
+    if (resident_.at(id)) {
+      lru_.splice(lru_.begin(), lru_, lru_positions_.at(id));
+      continue;
+    }
+    if (!evicted_.at(id)) { continue; }
+
+    const auto start = std::chrono::steady_clock::now();
+    bs_common::ChunkFileReader reader;
+    if (!reader.Open(spill_paths_.at(id)) ||
+        !submaps_.at(id)->LoadLidarClouds(reader, id)) {
+      BEAM_ERROR("Cannot reload lidar clouds of submap {} from: {}", id,
+                 spill_paths_.at(id));
+      lease.valid_ = false;
+      continue;
+    }
+    if (compressed_.at(id)) { submaps_.at(id)->CompressLidarKeyframes(); }
+    load_metric.Record(std::chrono::steady_clock::now() - start);
+
+    evicted_.at(id) = false;
+    num_evicted_--;
+    resident_.at(id) = true;
+    lru_.push_front(id);
+    lru_positions_.at(id) = lru_.begin();
+  }
+  return lease;
+}
+
+bool SubmapEvictor::EvictLeastRecentlyUsed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto iter = lru_.end(); iter != lru_.begin();) {
+    iter--;
+    const size_t id = *iter;
+    if (num_leases_.at(id) > 0 || !Evict(id)) { continue; }
+    lru_.erase(iter);
+    return true;
+  }
+  return false;
+}
+
+bool SubmapEvictor::IsEvicted(size_t submap_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return submap_id < evicted_.size() && evicted_.at(submap_id);
+}
+
+size_t SubmapEvictor::NumEvicted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_evicted_;
+}
+
+void SubmapEvictor::Unpin(const std::vector<size_t>& submap_ids) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const size_t id : submap_ids) { num_leases_.at(id)--; }
+  EvictToPolicy();
+}
+
+void SubmapEvictor::AddSubmaps(const std::vector<SubmapPtr>& submaps) {
+  if (submaps.size() <= submaps_.size()) { return; }
+  submaps_.insert(submaps_.end(), submaps.begin() + submaps_.size(),
+                  submaps.end());
+  const size_t num_submaps = submaps_.size();
+  spill_paths_.resize(num_submaps);
+  evicted_.resize(num_submaps, false);
+  compressed_.resize(num_submaps, false);
+  num_leases_.resize(num_submaps, 0);
+  resident_.resize(num_submaps, false);
+  lru_positions_.resize(num_submaps);
+}
+
+size_t SubmapEvictor::EvictToPolicy() {
+  size_t num_evicted = 0;
+  if (params_.distance_m > 0 && t_WORLD_BASELINK_) {
+    for (auto iter = lru_.begin(); iter != lru_.end();) {
+      const size_t id = *iter;
+      const Eigen::Vector3d t_WORLD_SUBMAP =
+          submaps_.at(id)->T_WORLD_SUBMAP().block<3, 1>(0, 3);
+      if (num_leases_.at(id) > 0 ||
+          (t_WORLD_SUBMAP - *t_WORLD_BASELINK_).norm() <= params_.distance_m ||
+          !Evict(id)) {
+        iter++;
+        continue;
+      }
+      iter = lru_.erase(iter);
+      num_evicted++;
+    }
+  }
+
+  if (params_.max_resident_submaps > 0) {
+    const size_t max_resident = params_.max_resident_submaps;
+    auto iter = lru_.end();
+    while (lru_.size() > max_resident && iter != lru_.begin()) {
+      iter--;
+      const size_t id = *iter;
+      if (num_leases_.at(id) > 0 || !Evict(id)) { continue; }
+      iter = lru_.erase(iter);
+      num_evicted++;
+    }
+  }
+  return num_evicted;
+}
+
+bool SubmapEvictor::Evict(size_t submap_id) {
+  const SubmapPtr& submap = submaps_.at(submap_id);
+  static bs_common::Metric& save_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_evictor/save");
+  if (spill_paths_.at(submap_id).empty()) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::string path = SpillPath(submap);
+    bs_common::ChunkFileWriter writer;
+    if (!writer.Open(path, kMapStoreVersion) ||
+        !submap->SaveLidarClouds(writer, submap_id) || !writer.Close()) {
+      BEAM_ERROR("Cannot write lidar clouds of submap {} to: {}", submap_id,
+                 path);
+      std::remove(path.c_str());
+      return false;
+    }
+    spill_paths_.at(submap_id) = path;
+    save_metric.Record(std::chrono::steady_clock::now() - start);
+  }
+
+  const auto& keyframes = submap->LidarKeyframes();
+  compressed_.at(submap_id) =
+      !keyframes.empty() && keyframes.begin()->second.IsCompressed();
+  submap->ReleaseLidarClouds();
+  evicted_.at(submap_id) = true;
+  resident_.at(submap_id) = false;
+  num_evicted_++;
+  return true;
+}
+
+std::string SubmapEvictor::SpillPath(const SubmapPtr& submap) const {
+  const std::string filename =
+      "submap_clouds_" + std::to_string(submap->Stamp().toNSec()) + "_" +
+      std::to_string(::getpid()) + ".bin";
+  return beam::CombinePaths(params_.directory, filename);
+}
+
+} // namespace bs_models::global_mapping
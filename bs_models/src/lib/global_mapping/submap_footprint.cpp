@@ -0,0 +1,230 @@
+#include <bs_models/global_mapping/submap_footprint.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <beam_utils/log.h>
+
+namespace bs_models::global_mapping {
+
+namespace {
+
+// grids larger than this are not stored, e.g. if a submap has far outliers
+constexpr int64_t kMaxGridBits = int64_t(1) << 27;
+
+Eigen::Vector3i ToVoxel(const Eigen::Vector3f& p, float voxel_size) {
+  return Eigen::Vector3i(static_cast<int>(std::floor(p.x() / voxel_size)),
+                         static_cast<int>(std::floor(p.y() / voxel_size)),
+                         static_cast<int>(std::floor(p.z() / voxel_size)));
+}
+
+} // namespace
+
+void SubmapFootprint::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("voxel_size_m")) { voxel_size_m = J["voxel_size_m"]; }
+  if (J.contains("height_bin_size_m")) {
+    height_bin_size_m = J["height_bin_size_m"];
+  }
+  if (J.contains("num_height_bins")) { num_height_bins = J["num_height_bins"]; }
+  if (voxel_size_m <= 0 || height_bin_size_m <= 0 || num_height_bins < 1) {
+    BEAM_ERROR("SubmapFootprint needs positive voxel_size_m and "
+               "height_bin_size_m, and num_height_bins >= 1");
+    throw std::invalid_argument{"invalid submap footprint params"};
+  }
+}
+
+void SubmapFootprint::Params::Print(std::ostream& stream) const {
+  stream << "SubmapFootprint::Params: \n";
+  stream << "voxel_size_m: " << voxel_size_m << "\n";
+  stream << "height_bin_size_m: " << height_bin_size_m << "\n";
+  stream << "num_height_bins: " << num_height_bins << "\n";
+}
+
+bool SubmapFootprint::Params::operator==(const Params& other) const {
+  return voxel_size_m == other.voxel_size_m &&
+         height_bin_size_m == other.height_bin_size_m &&
+         num_height_bins == other.num_height_bins;
+}
+
+SubmapFootprint::SubmapFootprint(const PointCloud& points,
+                                 const Params& params)
+    : params_(params) {
+  const float voxel_size = params_.voxel_size_m;
+  std::vector<Eigen::Vector3i> voxels;
+  voxels.reserve(points.size());
+  for (const auto& p : points) {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      continue;
+    }
+    voxels.push_back(ToVoxel(p.getVector3fMap(), voxel_size));
+  }
+  if (voxels.empty()) { return; }
+
+  // pad the grid by one voxel on all sides for the dilation
+  Eigen::Vector3i min = voxels.front();
+  Eigen::Vector3i max = voxels.front();
+  for (const auto& voxel : voxels) {
+    min = min.cwiseMin(voxel);
+    max = max.cwiseMax(voxel);
+  }
+  const Eigen::Matrix<int64_t, 3, 1> size =
+      (max - min).cast<int64_t>() + Eigen::Matrix<int64_t, 3, 1>::Constant(3);
+  if (size.prod() > kMaxGridBits) {
+    BEAM_WARN("Submap footprint grid of {}x{}x{} voxels is too large, not "
+              "computing the footprint",
+              size.x(), size.y(), size.z());
+    return;
+  }
+  grid_min_ = min - Eigen::Vector3i::Ones();
+  grid_size_ = size.cast<int>();
+  const size_t num_words = (size.prod() + 63) / 64;
+
+  // occupied voxels, each only once
+  std::vector<uint64_t> occupied(num_words, 0);
+  std::vector<Eigen::Vector3i> unique_voxels;
+  for (const auto& voxel : voxels) {
+    const int64_t bit = BitIndex(voxel);
+    uint64_t& word = occupied[bit / 64];
+    const uint64_t mask = uint64_t(1) << (bit % 64);
+    if (word & mask) { continue; }
+    word |= mask;
+    unique_voxels.push_back(voxel);
+  }
+
+  occupancy_.assign(num_words, 0);
+  voxel_centers_.resize(3, unique_voxels.size());
+  for (size_t i = 0; i < unique_voxels.size(); i++) {
+    const Eigen::Vector3i& voxel = unique_voxels[i];
+    voxel_centers_.col(i) =
+        (voxel.cast<float>() + Eigen::Vector3f::Constant(0.5)) * voxel_size;
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dz = -1; dz <= 1; dz++) {
+          const int64_t bit = BitIndex(voxel + Eigen::Vector3i(dx, dy, dz));
+          occupancy_[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+      }
+    }
+  }
+
+  // bounding box along the principal axes of the voxel centers
+  const Eigen::Matrix3Xd centers = voxel_centers_.cast<double>();
+  const Eigen::Vector3d mean = centers.rowwise().mean();
+  const Eigen::Matrix3Xd centered = centers.colwise() - mean;
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigen_solver(
+      centered * centered.transpose());
+  box_axes_ = eigen_solver.eigenvectors();
+  if (box_axes_.determinant() < 0) { box_axes_.col(2) *= -1; }
+  const Eigen::Matrix3Xd projected = box_axes_.transpose() * centered;
+  const Eigen::Vector3d projected_min = projected.rowwise().minCoeff();
+  const Eigen::Vector3d projected_max = projected.rowwise().maxCoeff();
+  box_center_ = mean + box_axes_ * (projected_min + projected_max) / 2;
+  box_half_extents_ = (projected_max - projected_min) / 2 +
+                      Eigen::Vector3d::Constant(params_.voxel_size_m / 2);
+
+  // heights above the floor, taken as a low percentile of the voxel heights
+  // so that a few voxels of noise below the ground do not shift it
+  std::vector<float> heights(voxel_centers_.cols());
+  for (size_t i = 0; i < heights.size(); i++) {
+    heights[i] = voxel_centers_(2, i);
+  }
+  auto floor_iter = heights.begin() + heights.size() / 50;
+  std::nth_element(heights.begin(), floor_iter, heights.end());
+  const float floor = *floor_iter;
+  height_histogram_.assign(params_.num_height_bins, 0);
+  for (int64_t i = 0; i < voxel_centers_.cols(); i++) {
+    const int bin = static_cast<int>(std::floor(
+        (voxel_centers_(2, i) - floor) / params_.height_bin_size_m));
+    height_histogram_[std::clamp(bin, 0, params_.num_height_bins - 1)] += 1;
+  }
+  for (float& bin : height_histogram_) { bin /= voxel_centers_.cols(); }
+}
+
+bool SubmapFootprint::BoxesIntersect(const SubmapFootprint& other,
+                                     const Eigen::Matrix4d& T_THIS_OTHER,
+                                     double margin_m) const {
+  if (Empty() || other.Empty()) { return false; }
+
+  // separating axis test (real-time collision detection, Ericson 2004, 4.4.1)
+  // in the frame of this box. Terms are padded so that parallel axes, where
+  // the cross products vanish, do not give false separations
+  const Eigen::Matrix3d R_THIS_OTHER = T_THIS_OTHER.block<3, 3>(0, 0);
+  const Eigen::Matrix3d R =
+      box_axes_.transpose() * R_THIS_OTHER * other.box_axes_;
+  const Eigen::Matrix3d absR =
+      R.cwiseAbs() + Eigen::Matrix3d::Constant(1e-9);
+  const Eigen::Vector3d other_center =
+      R_THIS_OTHER * other.box_center_ + T_THIS_OTHER.block<3, 1>(0, 3);
+  const Eigen::Vector3d t =
+      box_axes_.transpose() * (other_center - box_center_);
+  const Eigen::Vector3d a =
+      box_half_extents_ + Eigen::Vector3d::Constant(margin_m);
+  const Eigen::Vector3d b =
+      other.box_half_extents_ + Eigen::Vector3d::Constant(margin_m);
+
+  // axes of this box and of the other box
+  for (int i = 0; i < 3; i++) {
+    if (std::abs(t[i]) > a[i] + absR.row(i).dot(b)) { return false; }
+  }
+  for (int j = 0; j < 3; j++) {
+    if (std::abs(t.dot(R.col(j))) > absR.col(j).dot(a) + b[j]) {
+      return false;
+    }
+  }
+
+  // cross products of the axes of both boxes
+  for (int i = 0; i < 3; i++) {
+    const int i1 = (i + 1) % 3;
+    const int i2 = (i + 2) % 3;
+    for (int j = 0; j < 3; j++) {
+      const int j1 = (j + 1) % 3;
+      const int j2 = (j + 2) % 3;
+      const double ra = a[i1] * absR(i2, j) + a[i2] * absR(i1, j);
+      const double rb = b[j1] * absR(i, j2) + b[j2] * absR(i, j1);
+      if (std::abs(t[i2] * R(i1, j) - t[i1] * R(i2, j)) > ra + rb) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+double SubmapFootprint::OccupancyOverlap(
+    const SubmapFootprint& other, const Eigen::Matrix4d& T_THIS_OTHER) const {
+  if (Empty() || other.Empty()) { return 0; }
+  const Eigen::Matrix3f R = T_THIS_OTHER.block<3, 3>(0, 0).cast<float>();
+  const Eigen::Vector3f t = T_THIS_OTHER.block<3, 1>(0, 3).cast<float>();
+  const float voxel_size = params_.voxel_size_m;
+  size_t num_overlapping = 0;
+  for (int64_t i = 0; i < other.voxel_centers_.cols(); i++) {
+    const int64_t bit =
+        BitIndex(ToVoxel(R * other.voxel_centers_.col(i) + t, voxel_size));
+    if (bit >= 0 && (occupancy_[bit / 64] >> (bit % 64)) & 1) {
+      num_overlapping++;
+    }
+  }
+  return static_cast<double>(num_overlapping) / other.voxel_centers_.cols();
+}
+
+double SubmapFootprint::HeightSimilarity(const SubmapFootprint& other) const {
+  const size_t num_bins =
+      std::min(height_histogram_.size(), other.height_histogram_.size());
+  double similarity = 0;
+  for (size_t i = 0; i < num_bins; i++) {
+    similarity += std::min(height_histogram_[i], other.height_histogram_[i]);
+  }
+  return similarity;
+}
+
+int64_t SubmapFootprint::BitIndex(const Eigen::Vector3i& voxel) const {
+  const Eigen::Vector3i local = voxel - grid_min_;
+  if ((local.array() < 0).any() ||
+      (local.array() >= grid_size_.array()).any()) {
+    return -1;
+  }
+  return (static_cast<int64_t>(local.x()) * grid_size_.y() + local.y()) *
+             grid_size_.z() +
+         local.z();
+}
+
+} // namespace bs_models::global_mapping
@@ -1,10 +1,13 @@
 #include <bs_models/global_mapping/submap_pose_graph_optimization.h>
 
+#include <atomic>
+#include <chrono>
+
 #include <fuse_core/transaction.h>
 
-#include <bs_models/reloc/reloc_candidate_search_base.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_models/reloc/reloc_methods.h>
-#include <bs_models/reloc/reloc_refinement_base.h>
 
 namespace bs_models::global_mapping {
 
@@ -22,11 +25,11 @@ SubmapPoseGraphOptimization::SubmapPoseGraphOptimization(
 bool SubmapPoseGraphOptimization::Run(std::vector<SubmapPtr> submaps) {
   // Setup
   ros::Time::init();
+  summary_ = Summary();
   std::shared_ptr<reloc::RelocCandidateSearchBase>
       loop_closure_candidate_search = reloc::RelocCandidateSearchBase::Create(
           params_.candidate_search_config);
-  std::shared_ptr<reloc::RelocRefinementBase> loop_closure_refinement =
-      reloc::RelocRefinementBase::Create(params_.refinement_config);
+  refinements_.clear();
 
   size_t num_submaps = submaps.size();
   if (num_submaps <= pgo_skip_first_n_submaps_) {
@@ -43,111 +46,372 @@ bool SubmapPoseGraphOptimization::Run(std::vector<SubmapPtr> submaps) {
   std::filesystem::create_directory(lc_results_path_candidate_search);
 
   BEAM_INFO("Running pose-graph optimization on submaps");
-  std::shared_ptr<fuse_graphs::HashGraph> graph =
-      fuse_graphs::HashGraph::make_shared();
-
-  // add first pose prior
-  {
-    const SubmapPtr& first_submap = submaps.at(0);
-    bs_constraints::Pose3DStampedTransaction prior_transaction(
-        first_submap->Stamp());
-    prior_transaction.AddPoseVariables(first_submap->Position(),
-                                       first_submap->Orientation(),
-                                       first_submap->Stamp());
-    prior_transaction.AddPosePrior(
-        first_submap->Position(), first_submap->Orientation(),
-        pose_prior_noise_fixed_, "SubmapPoseGraphOptimization::Run");
-    graph->update(*prior_transaction.GetTransaction());
-  }
-
-  // add all relative pose transactions
-  fuse_core::Transaction::SharedPtr transaction =
-      std::make_shared<fuse_core::Transaction>();
-  for (int i = 1; i < num_submaps; i++) {
-    const SubmapPtr& current_submap = submaps.at(i);
-    bs_constraints::Pose3DStampedTransaction new_transaction(
-        current_submap->Stamp());
-    new_transaction.AddPoseVariables(current_submap->Position(),
-                                     current_submap->Orientation(),
-                                     current_submap->Stamp());
-
-    // If first submap, continue
-    if (i < 1) { continue; }
+  edges_.clear();
+  merged_.clear();
+  loop_closures_since_sparsification_ = 0;
 
-    // add relative constraint to prev
+  // add all relative poses between consecutive submaps, except for the first
+  // submap of a session
+  for (size_t i = 1; i < num_submaps; i++) {
+    if (session_starts_.count(i) > 0) { continue; }
     const SubmapPtr& previous_submap = submaps.at(i - 1);
+    const SubmapPtr& current_submap = submaps.at(i);
     Eigen::Matrix4d T_PREVIOUS_CURRENT =
         beam::InvertTransform(previous_submap->T_WORLD_SUBMAP()) *
         current_submap->T_WORLD_SUBMAP();
-    new_transaction.AddPoseConstraint(
-        previous_submap->Position(), current_submap->Position(),
-        previous_submap->Orientation(), current_submap->Orientation(),
-        bs_common::TransformMatrixToVectorWithQuaternion(T_PREVIOUS_CURRENT),
-        params_.local_mapper_covariance, "SubmapPoseGraphOptimization::Run");
-    graph->update(*new_transaction.GetTransaction());
+    edges_.push_back(PoseGraphSparsifier::Edge{
+        i - 1, i, T_PREVIOUS_CURRENT, params_.local_mapper_covariance});
+  }
+
+  // add known loop closures
+  for (const LoopClosure& loop_closure : loop_closures_) {
+    if (loop_closure.match_index >= num_submaps ||
+        loop_closure.query_index >= num_submaps) {
+      BEAM_ERROR("Invalid loop closure between submaps {} and {}, only {} "
+                 "submaps",
+                 loop_closure.match_index, loop_closure.query_index,
+                 num_submaps);
+      return false;
+    }
+    edges_.push_back(PoseGraphSparsifier::Edge{
+        loop_closure.match_index, loop_closure.query_index,
+        loop_closure.T_MATCH_QUERY, params_.loop_closure_covariance});
+  }
+
+  std::shared_ptr<fuse_graphs::HashGraph> graph = BuildGraph(submaps);
+  if (!loop_closures_.empty()) {
+    graph->optimize();
+    UpdateSubmapPoses(submaps, graph);
   }
+  if (!params_.search_loop_closures) { return true; }
 
   // now iterate through all submaps, check if loop closures can be run, and if
   // so, update graph after each loop closure
-  for (int query_index = pgo_skip_first_n_submaps_; query_index < num_submaps;
-       query_index++) {
-    std::vector<int> matched_indices;
-    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
-
-    // ignore all submaps equal to or after the submap before query.
-    // I.e. if query is 2 and we have 5 submaps, ignore 1, 2, 3, 4. Check 0.
-    // (size = 5 - 2 + 1 = 4)
-    int ignore_last_n_submaps = submaps.size() - query_index + 1;
-    BEAM_INFO("Finding reloc candidates for query submap id: {}", query_index);
-    loop_closure_candidate_search->FindRelocCandidates(
-        submaps, submaps.at(query_index), matched_indices, Ts_MATCH_QUERY,
-        ignore_last_n_submaps, lc_results_path_candidate_search);
-    std::string candidates;
-    for (const auto& id : matched_indices) {
-      candidates += std::to_string(id) + " ";
+  if (params_.num_threads <= 1) {
+    for (size_t query_index = pgo_skip_first_n_submaps_;
+         query_index < num_submaps; query_index++) {
+      const std::vector<Candidate> candidates =
+          FindCandidates(*loop_closure_candidate_search, submaps, query_index,
+                         lc_results_path_candidate_search);
+      if (candidates.empty()) { continue; }
+      const std::vector<RelocRefinementResults> results =
+          RefineCandidates(submaps, candidates, lc_results_path_refinement);
+      AddLoopClosures(submaps, candidates, results, graph);
     }
+    return true;
+  }
+
+  // otherwise find the candidates of all queries first, so that they can be
+  // refined in parallel and solved once
+  std::vector<Candidate> candidates;
+  for (size_t query_index = pgo_skip_first_n_submaps_;
+       query_index < num_submaps; query_index++) {
+    const std::vector<Candidate> query_candidates =
+        FindCandidates(*loop_closure_candidate_search, submaps, query_index,
+                       lc_results_path_candidate_search);
+    candidates.insert(candidates.end(), query_candidates.begin(),
+                      query_candidates.end());
+  }
+  if (candidates.empty()) { return true; }
+  const std::vector<RelocRefinementResults> results =
+      RefineCandidates(submaps, candidates, lc_results_path_refinement);
+  AddLoopClosures(submaps, candidates, results, graph);
+  return true;
+}
+
+std::shared_ptr<fuse_graphs::HashGraph>
+    SubmapPoseGraphOptimization::BuildGraph(
+        const std::vector<SubmapPtr>& submaps) {
+  std::shared_ptr<fuse_graphs::HashGraph> graph =
+      fuse_graphs::HashGraph::make_shared();
+
+  // add first pose prior
+  const SubmapPtr& first_submap = submaps.at(0);
+  bs_constraints::Pose3DStampedTransaction prior_transaction(
+      first_submap->Stamp());
+  prior_transaction.AddPoseVariables(first_submap->Position(),
+                                     first_submap->Orientation(),
+                                     first_submap->Stamp());
+  prior_transaction.AddPosePrior(
+      first_submap->Position(), first_submap->Orientation(),
+      pose_prior_noise_fixed_, "SubmapPoseGraphOptimization::Run");
+  graph->update(*prior_transaction.GetTransaction());
+
+  auto transaction = std::make_shared<fuse_core::Transaction>();
+  for (size_t i = 1; i < submaps.size(); i++) {
+    if (merged_.count(i) > 0) { continue; }
+    const SubmapPtr& submap = submaps.at(i);
+    bs_constraints::Pose3DStampedTransaction new_transaction(submap->Stamp());
+    new_transaction.AddPoseVariables(submap->Position(), submap->Orientation(),
+                                     submap->Stamp());
+    transaction->merge(*(new_transaction.GetTransaction()));
+  }
+  for (const PoseGraphSparsifier::Edge& edge : edges_) {
+    const SubmapPtr& from_submap = submaps.at(edge.from);
+    const SubmapPtr& to_submap = submaps.at(edge.to);
+    bs_constraints::Pose3DStampedTransaction new_transaction(
+        to_submap->Stamp());
+    new_transaction.AddPoseConstraint(
+        from_submap->Position(), to_submap->Position(),
+        from_submap->Orientation(), to_submap->Orientation(),
+        bs_common::TransformMatrixToVectorWithQuaternion(edge.T_FROM_TO),
+        edge.covariance, "SubmapPoseGraphOptimization::Run");
+    transaction->merge(*(new_transaction.GetTransaction()));
+  }
+  graph->update(*transaction);
+  summary_.num_edges = edges_.size();
+  return graph;
+}
 
-    if (matched_indices.size() == 0) {
-      BEAM_INFO("No loop closure candidates for query index {}", query_index);
+void SubmapPoseGraphOptimization::UpdateSubmapPoses(
+    const std::vector<SubmapPtr>& submaps,
+    const std::shared_ptr<fuse_graphs::HashGraph>& graph) {
+  UpdateSubmapPosesFromGraph(submaps, graph);
+  for (const auto& [id, merge] : merged_) {
+    submaps.at(id)->UpdatePose(submaps.at(merge.kept)->T_WORLD_SUBMAP() *
+                               merge.T_KEPT_MERGED);
+  }
+}
+
+void SubmapPoseGraphOptimization::Sparsify(
+    const std::vector<SubmapPtr>& submaps,
+    std::shared_ptr<fuse_graphs::HashGraph>& graph) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_pgo/sparsification");
+  const auto start = std::chrono::steady_clock::now();
+  PoseGraphSparsifier::Poses Ts_WORLD_SUBMAP;
+  for (const SubmapPtr& submap : submaps) {
+    Ts_WORLD_SUBMAP.push_back(submap->T_WORLD_SUBMAP());
+  }
+  const size_t num_edges = edges_.size();
+  const size_t num_merged =
+      PoseGraphSparsifier(params_.sparsification)
+          .Sparsify(Ts_WORLD_SUBMAP, {0}, edges_, merged_);
+  graph = BuildGraph(submaps);
+  loop_closures_since_sparsification_ = 0;
+
+  const auto duration = std::chrono::steady_clock::now() - start;
+  metric.Record(duration);
+  summary_.num_merged_submaps += num_merged;
+  summary_.sparsification_time_s +=
+      std::chrono::duration<double>(duration).count();
+  BEAM_INFO("Merged {} redundant submaps, pose graph reduced from {} to {} "
+            "edges",
+            num_merged, num_edges, edges_.size());
+}
+
+std::vector<SubmapPoseGraphOptimization::Candidate>
+    SubmapPoseGraphOptimization::FindCandidates(
+        reloc::RelocCandidateSearchBase& candidate_search,
+        const std::vector<SubmapPtr>& submaps, size_t query_index,
+        const std::string& output_path) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_pgo/candidate_search");
+  const auto start = std::chrono::steady_clock::now();
+  summary_.num_queries++;
+
+  std::vector<int> matched_indices;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
+
+  // ignore all submaps equal to or after the submap before query.
+  // I.e. if query is 2 and we have 5 submaps, ignore 1, 2, 3, 4. Check 0.
+  // (size = 5 - 2 + 1 = 4)
+  int ignore_last_n_submaps = submaps.size() - query_index + 1;
+  BEAM_INFO("Finding reloc candidates for query submap id: {}", query_index);
+  SubmapWorkingSet::Lease search_lease;
+  if (working_set_ && candidate_search.UsesLidarClouds()) {
+    std::vector<size_t> search_ids{query_index};
+    for (size_t i = 0; i + 1 < query_index; i++) { search_ids.push_back(i); }
+    search_lease = working_set_->Acquire(search_ids);
+  }
+  candidate_search.FindRelocCandidates(
+      submaps, submaps.at(query_index), matched_indices, Ts_MATCH_QUERY,
+      ignore_last_n_submaps, output_path);
+  search_lease.Release();
+
+  const auto duration = std::chrono::steady_clock::now() - start;
+  metric.Record(duration);
+  summary_.search_time_s += std::chrono::duration<double>(duration).count();
+
+  if (matched_indices.size() == 0) {
+    BEAM_INFO("No loop closure candidates for query index {}", query_index);
+    return {};
+  }
+
+  std::string candidates_str;
+  std::vector<Candidate> candidates;
+  for (int i = 0; i < matched_indices.size(); i++) {
+    candidates_str += std::to_string(matched_indices[i]) + " ";
+    if (matched_indices[i] < 0 ||
+        static_cast<size_t>(matched_indices[i]) + 1 >= query_index) {
+      BEAM_ERROR("Error in candidate search implementation, please fix!");
       continue;
     }
+    candidates.push_back(Candidate{static_cast<size_t>(matched_indices[i]),
+                                   query_index, Ts_MATCH_QUERY[i]});
+  }
+  BEAM_INFO(
+      "Found {} loop closure candidates for query index {}. Candidates: {}",
+      matched_indices.size(), query_index, candidates_str);
+  return candidates;
+}
 
-    BEAM_INFO(
-        "Found {} loop closure candidates for query index {}. Candidates: {}",
-        matched_indices.size(), query_index, candidates);
+std::vector<RelocRefinementResults>
+    SubmapPoseGraphOptimization::RefineCandidates(
+        const std::vector<SubmapPtr>& submaps,
+        const std::vector<Candidate>& candidates,
+        const std::string& output_path) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<RelocRefinementResults> results(candidates.size());
+  std::vector<double> refinement_times(candidates.size(), 0);
+  const size_t num_workers =
+      std::min<size_t>(std::max(params_.num_threads, 1), candidates.size());
+  const bool log_progress = candidates.size() > 1;
+  if (log_progress) {
+    BEAM_INFO("Refining {} loop closure candidates on {} threads",
+              candidates.size(), num_workers);
+  }
 
-    auto transaction = std::make_shared<fuse_core::Transaction>();
-    for (int i = 0; i < matched_indices.size(); i++) {
-      if (matched_indices[i] >= query_index - 1) {
-        BEAM_ERROR("Error in candidate search implementation, please fix!");
-        continue;
+  // each worker is a background task with its own refinement, kept between
+  // calls, and takes the next candidate until all are refined
+  while (refinements_.size() < num_workers) {
+    refinements_.push_back(
+        RelocRefinementBase::Create(params_.refinement_config));
+  }
+  const uint64_t cache_context =
+      cache_ ? RegistrationCache::ContextId("submap_pgo",
+                                            params_.refinement_config)
+             : 0;
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> num_refined{0};
+  const size_t progress_step = std::max<size_t>(candidates.size() / 10, 1);
+  auto refine_candidates = [&](size_t worker) {
+    RelocRefinementBase& refinement = *refinements_.at(worker);
+    for (size_t i = next++; i < candidates.size(); i = next++) {
+      const Candidate& candidate = candidates.at(i);
+      const auto candidate_start = std::chrono::steady_clock::now();
+      RegistrationCache::Key key;
+      RegistrationCache::Result cached;
+      if (cache_) {
+        key = cache_->MakeKey(
+            cache_context,
+            cache_->SubmapId(*submaps.at(candidate.match_index)),
+            cache_->SubmapId(*submaps.at(candidate.query_index)),
+            candidate.T_MATCH_QUERY_EST);
+      }
+      if (cache_ && cache_->Find(key, cached)) {
+        results.at(i).successful = cached.successful;
+        results.at(i).T_MATCH_QUERY = cached.T_REFERENCE_TARGET;
+        results.at(i).covariance = cached.covariance;
+      } else {
+        SubmapWorkingSet::Lease lease;
+        if (working_set_) {
+          lease = working_set_->Acquire(
+              {candidate.match_index, candidate.query_index});
+        }
+        results.at(i) = refinement.RunRefinement(
+            submaps.at(candidate.match_index),
+            submaps.at(candidate.query_index), candidate.T_MATCH_QUERY_EST,
+            output_path);
+        if (cache_) {
+          cached.successful = results.at(i).successful;
+          cached.T_REFERENCE_TARGET = results.at(i).T_MATCH_QUERY;
+          cached.covariance = results.at(i).covariance;
+          cache_->Insert(key, cached);
+        }
+      }
+      refinement_times.at(i) = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() -
+                                   candidate_start)
+                                   .count();
+      const size_t refined = ++num_refined;
+      if (log_progress &&
+          (refined % progress_step == 0 || refined == candidates.size())) {
+        BEAM_INFO("Refined {}/{} loop closure candidates", refined,
+                  candidates.size());
       }
+    }
+  };
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::BACKGROUND, num_workers, refine_candidates,
+      num_workers);
+
+  for (size_t i = 0; i < candidates.size(); i++) {
+    CandidateResult candidate_result;
+    candidate_result.match_index = candidates.at(i).match_index;
+    candidate_result.query_index = candidates.at(i).query_index;
+    candidate_result.successful = results.at(i).successful;
+    candidate_result.coarse_overlap = results.at(i).coarse_overlap;
+    candidate_result.refinement_time_s = refinement_times.at(i);
+    summary_.candidates.push_back(candidate_result);
+    summary_.num_candidates++;
+    if (candidate_result.successful) { summary_.num_successful++; }
+  }
+  summary_.refinement_time_s += std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count();
+  return results;
+}
 
-      const auto& matched_submap = submaps.at(matched_indices[i]);
-      const auto& query_submap = submaps.at(query_index);
-      RelocRefinementResults results = loop_closure_refinement->RunRefinement(
-          matched_submap, query_submap, Ts_MATCH_QUERY[i],
-          lc_results_path_refinement);
-
-      if (!results.successful) { continue; }
-
-      bs_constraints::Pose3DStampedTransaction new_transaction(
-          query_submap->Stamp());
-      new_transaction.AddPoseConstraint(
-          matched_submap->Position(), query_submap->Position(),
-          matched_submap->Orientation(), query_submap->Orientation(),
-          bs_common::TransformMatrixToVectorWithQuaternion(
-              results.T_MATCH_QUERY),
-          params_.loop_closure_covariance, "SubmapPoseGraphOptimization::Run");
-      transaction->merge(*(new_transaction.GetTransaction()));
+void SubmapPoseGraphOptimization::AddLoopClosures(
+    const std::vector<SubmapPtr>& submaps,
+    const std::vector<Candidate>& candidates,
+    const std::vector<RelocRefinementResults>& results,
+    std::shared_ptr<fuse_graphs::HashGraph>& graph) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_pgo/optimization");
+  auto transaction = std::make_shared<fuse_core::Transaction>();
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (!results.at(i).successful) { continue; }
+    PoseGraphSparsifier::Edge edge{candidates.at(i).match_index,
+                                   candidates.at(i).query_index,
+                                   results.at(i).T_MATCH_QUERY,
+                                   params_.loop_closure_covariance};
+    if (auto iter = merged_.find(edge.from); iter != merged_.end()) {
+      edge.from = iter->second.kept;
+      edge.T_FROM_TO = iter->second.T_KEPT_MERGED * edge.T_FROM_TO;
     }
+    if (auto iter = merged_.find(edge.to); iter != merged_.end()) {
+      edge.to = iter->second.kept;
+      edge.T_FROM_TO =
+          edge.T_FROM_TO * beam::InvertTransform(iter->second.T_KEPT_MERGED);
+    }
+    // both submaps were merged into the same one
+    if (edge.from == edge.to) { continue; }
+    edges_.push_back(edge);
+    loop_closures_since_sparsification_++;
 
-    graph->update(*transaction);
-    graph->optimize();
-    UpdateSubmapPosesFromGraph(submaps, graph);
+    const auto& matched_submap = submaps.at(edge.from);
+    const auto& query_submap = submaps.at(edge.to);
+    bs_constraints::Pose3DStampedTransaction new_transaction(
+        query_submap->Stamp());
+    new_transaction.AddPoseConstraint(
+        matched_submap->Position(), query_submap->Position(),
+        matched_submap->Orientation(), query_submap->Orientation(),
+        bs_common::TransformMatrixToVectorWithQuaternion(edge.T_FROM_TO),
+        edge.covariance, "SubmapPoseGraphOptimization::Run");
+    transaction->merge(*(new_transaction.GetTransaction()));
   }
+  summary_.num_edges = edges_.size();
 
-  return true;
+  const auto start = std::chrono::steady_clock::now();
+  graph->update(*transaction);
+  graph->optimize();
+  UpdateSubmapPoses(submaps, graph);
+  const auto duration = std::chrono::steady_clock::now() - start;
+  metric.Record(duration);
+  summary_.optimization_time_s +=
+      std::chrono::duration<double>(duration).count();
+
+  // the next queries are solved on the sparsified graph
+  if (params_.sparsification.enabled && params_.num_threads <= 1 &&
+      loop_closures_since_sparsification_ >=
+          params_.sparsification.loop_closures_per_sparsification) {
+    Sparsify(submaps, graph);
+  }
 }
 
 } // namespace bs_models::global_mapping
\ No newline at end of file
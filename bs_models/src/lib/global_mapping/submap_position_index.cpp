@@ -0,0 +1,182 @@
+#include <bs_models/global_mapping/submap_position_index.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace bs_models::global_mapping {
+
+namespace {
+
+std::vector<size_t>
+    SortedIds(std::vector<std::pair<double, size_t>>& distances) {
+  std::sort(distances.begin(), distances.end());
+  std::vector<size_t> ids;
+  ids.reserve(distances.size());
+  for (const auto& [distance, id] : distances) { ids.push_back(id); }
+  return ids;
+}
+
+} // namespace
+
+SubmapPositionIndex::SubmapPositionIndex(double cell_size_m)
+    : cell_size_m_(cell_size_m) {
+  if (cell_size_m_ <= 0) {
+    throw std::invalid_argument{"cell size must be greater than zero"};
+  }
+}
+
+size_t SubmapPositionIndex::CellHash::operator()(const Cell& cell) const {
+  // large primes from "Optimized Spatial Hashing for Collision Detection of
+  // Deformable Objects" (Teschner et al. 2003)
+  return static_cast<size_t>(cell[0] * 73856093) ^
+         static_cast<size_t>(cell[1] * 19349663) ^
+         static_cast<size_t>(cell[2] * 83492791);
+}
+
+SubmapPositionIndex::Cell
+    SubmapPositionIndex::ToCell(const Eigen::Vector3d& position) const {
+  return {static_cast<int64_t>(std::floor(position.x() / cell_size_m_)),
+          static_cast<int64_t>(std::floor(position.y() / cell_size_m_)),
+          static_cast<int64_t>(std::floor(position.z() / cell_size_m_))};
+}
+
+void SubmapPositionIndex::Update(size_t id, const Eigen::Vector3d& position) {
+  if (id > positions_.size()) {
+    throw std::out_of_range{"submap ids must be added in order"};
+  }
+  const Cell cell = ToCell(position);
+  if (id == positions_.size()) {
+    positions_.push_back(position);
+    cells_.push_back(cell);
+  } else {
+    positions_[id] = position;
+    if (cells_[id] == cell) { return; }
+    RemoveFromCell(id);
+    cells_[id] = cell;
+  }
+  grid_[cell].push_back(id);
+
+  if (positions_.size() == 1) {
+    min_cell_ = cell;
+    max_cell_ = cell;
+  }
+  for (int i = 0; i < 3; i++) {
+    min_cell_[i] = std::min(min_cell_[i], cell[i]);
+    max_cell_[i] = std::max(max_cell_[i], cell[i]);
+  }
+}
+
+void SubmapPositionIndex::Resize(size_t size) {
+  while (positions_.size() > size) {
+    RemoveFromCell(positions_.size() - 1);
+    positions_.pop_back();
+    cells_.pop_back();
+  }
+}
+
+void SubmapPositionIndex::Clear() {
+  positions_.clear();
+  cells_.clear();
+  grid_.clear();
+}
+
+void SubmapPositionIndex::RemoveFromCell(size_t id) {
+  auto iter = grid_.find(cells_[id]);
+  if (iter == grid_.end()) { return; }
+  auto& ids = iter->second;
+  ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+  if (ids.empty()) { grid_.erase(iter); }
+}
+
+std::vector<std::pair<double, size_t>>
+    SubmapPositionIndex::AllDistances(const Eigen::Vector3d& position,
+                                      size_t max_id) const {
+  std::vector<std::pair<double, size_t>> distances;
+  const size_t n = std::min(max_id, positions_.size());
+  distances.reserve(n);
+  for (size_t id = 0; id < n; id++) {
+    distances.emplace_back((positions_[id] - position).norm(), id);
+  }
+  return distances;
+}
+
+std::vector<size_t> SubmapPositionIndex::Radius(
+    const Eigen::Vector3d& position, double radius_m, size_t max_id) const {
+  std::vector<std::pair<double, size_t>> distances;
+  const Cell min = ToCell(position - Eigen::Vector3d::Constant(radius_m));
+  const Cell max = ToCell(position + Eigen::Vector3d::Constant(radius_m));
+  const double num_cells = static_cast<double>(max[0] - min[0] + 1) *
+                           (max[1] - min[1] + 1) * (max[2] - min[2] + 1);
+  if (num_cells > grid_.size()) {
+    for (const auto& d : AllDistances(position, max_id)) {
+      if (d.first <= radius_m) { distances.push_back(d); }
+    }
+    return SortedIds(distances);
+  }
+
+  for (int64_t x = min[0]; x <= max[0]; x++) {
+    for (int64_t y = min[1]; y <= max[1]; y++) {
+      for (int64_t z = min[2]; z <= max[2]; z++) {
+        auto iter = grid_.find(Cell{x, y, z});
+        if (iter == grid_.end()) { continue; }
+        for (const size_t id : iter->second) {
+          if (id >= max_id) { continue; }
+          const double distance = (positions_[id] - position).norm();
+          if (distance <= radius_m) { distances.emplace_back(distance, id); }
+        }
+      }
+    }
+  }
+  return SortedIds(distances);
+}
+
+std::vector<size_t> SubmapPositionIndex::Nearest(
+    const Eigen::Vector3d& position, size_t k, size_t max_id) const {
+  std::vector<std::pair<double, size_t>> distances;
+  if (k == 0 || positions_.empty()) { return {}; }
+
+  // visit shells of cells around the query cell until the k closest submaps
+  // are found and no cell further out can contain a closer one
+  const Cell center = ToCell(position);
+  int64_t max_shell = 0;
+  for (int i = 0; i < 3; i++) {
+    max_shell = std::max({max_shell, std::abs(center[i] - min_cell_[i]),
+                          std::abs(max_cell_[i] - center[i])});
+  }
+  for (int64_t shell = 0; shell <= max_shell; shell++) {
+    const double shell_cells = 6.0 * (2 * shell + 1) * (2 * shell + 1);
+    if (shell_cells > grid_.size()) {
+      distances = AllDistances(position, max_id);
+      break;
+    }
+    for (int64_t x = -shell; x <= shell; x++) {
+      for (int64_t y = -shell; y <= shell; y++) {
+        const bool on_face = std::abs(x) == shell || std::abs(y) == shell;
+        for (int64_t z = -shell; z <= shell; z += on_face ? 1 : 2 * shell) {
+          auto iter =
+              grid_.find(Cell{center[0] + x, center[1] + y, center[2] + z});
+          if (iter != grid_.end()) {
+            for (const size_t id : iter->second) {
+              if (id >= max_id) { continue; }
+              distances.emplace_back((positions_[id] - position).norm(), id);
+            }
+          }
+        }
+      }
+    }
+
+    // any submap in the next shell is at least this far from the query
+    if (distances.size() >= k) {
+      std::nth_element(distances.begin(), distances.begin() + k - 1,
+                       distances.end());
+      if (distances[k - 1].first <= shell * cell_size_m_) { break; }
+    }
+  }
+
+  std::vector<size_t> ids = SortedIds(distances);
+  if (ids.size() > k) { ids.resize(k); }
+  return ids;
+}
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,272 @@
+#include <bs_models/global_mapping/submap_prefetcher.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/instrumentation.h>
+
+namespace bs_models::global_mapping {
+
+namespace {
+
+// weight of the newest velocity measurement in the smoothed velocity
+constexpr double kVelocitySmoothing = 0.5;
+
+/**
+ * @brief sample points every spacing along a polyline, starting at its first
+ * point and up to a length along it
+ */
+std::vector<Eigen::Vector3d>
+    SamplePolyline(const std::vector<Eigen::Vector3d>& polyline, double length,
+                   double spacing) {
+  std::vector<Eigen::Vector3d> samples{polyline.front()};
+  double travelled = 0;
+  double next_sample = spacing;
+  for (size_t i = 1; i < polyline.size() && next_sample <= length; i++) {
+    const Eigen::Vector3d segment = polyline[i] - polyline[i - 1];
+    const double segment_length = segment.norm();
+    while (next_sample <= length &&
+           next_sample <= travelled + segment_length) {
+      const double ratio = (next_sample - travelled) / segment_length;
+      samples.push_back(polyline[i - 1] + ratio * segment);
+      next_sample += spacing;
+    }
+    travelled += segment_length;
+  }
+  return samples;
+}
+
+} // namespace
+
+void SubmapPrefetcher::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("horizon_s")) { horizon_s = J["horizon_s"]; }
+  if (J.contains("min_horizon_m")) { min_horizon_m = J["min_horizon_m"]; }
+  if (J.contains("radius_m")) { radius_m = J["radius_m"]; }
+  if (J.contains("sample_spacing_m")) {
+    sample_spacing_m = J["sample_spacing_m"];
+  }
+  if (J.contains("memory_budget_mb")) {
+    memory_budget_mb = J["memory_budget_mb"];
+  }
+  if (horizon_s < 0 || min_horizon_m < 0 || radius_m < 0 ||
+      sample_spacing_m <= 0 || memory_budget_mb < 0) {
+    BEAM_ERROR("Submap prefetch needs a positive sample_spacing_m, and "
+               "horizon_s, min_horizon_m, radius_m and memory_budget_mb must "
+               "not be negative");
+    throw std::invalid_argument{"invalid submap prefetch params"};
+  }
+}
+
+nlohmann::json SubmapPrefetcher::Params::ToJson() const {
+  return nlohmann::json{{"enabled", enabled},
+                        {"horizon_s", horizon_s},
+                        {"min_horizon_m", min_horizon_m},
+                        {"radius_m", radius_m},
+                        {"sample_spacing_m", sample_spacing_m},
+                        {"memory_budget_mb", memory_budget_mb}};
+}
+
+SubmapPrefetcher::SubmapPrefetcher(const Params& params, LoadFunction load)
+    : params_(params),
+      load_(std::move(load)),
+      memory_budget_bytes_(
+          static_cast<size_t>(std::max(params_.memory_budget_mb, 0.0) * 1e6)) {
+  if (!load_) {
+    BEAM_ERROR("Submap prefetcher needs a load function");
+    throw std::invalid_argument{"invalid submap prefetcher load function"};
+  }
+  thread_ = std::thread(&SubmapPrefetcher::Run, this);
+}
+
+SubmapPrefetcher::~SubmapPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) { thread_.join(); }
+}
+
+std::vector<Eigen::Vector3d>
+    SubmapPrefetcher::PredictPath(const Eigen::Vector3d& t_WORLD_BASELINK,
+                                  const ros::Time& stamp) {
+  std::lock_guard<std::mutex> lock(motion_mutex_);
+  if (last_position_ && stamp > last_stamp_) {
+    const Eigen::Vector3d velocity =
+        (t_WORLD_BASELINK - *last_position_) / (stamp - last_stamp_).toSec();
+    if (velocity_) {
+      velocity_ = Eigen::Vector3d(kVelocitySmoothing * velocity +
+                                  (1 - kVelocitySmoothing) * *velocity_);
+    } else {
+      velocity_ = velocity;
+    }
+  }
+  if (!last_position_ || stamp > last_stamp_) {
+    last_position_ = t_WORLD_BASELINK;
+    last_stamp_ = stamp;
+  }
+
+  const double speed = velocity_ ? velocity_->norm() : 0;
+  const double length =
+      std::max(speed * params_.horizon_s, params_.min_horizon_m);
+  if (!planned_path_.empty()) {
+    // follow the planned path from the point of it closest to the robot
+    std::vector<Eigen::Vector3d> polyline{t_WORLD_BASELINK};
+    if (planned_path_.size() == 1) {
+      polyline.push_back(planned_path_.front());
+      return SamplePolyline(polyline, length, params_.sample_spacing_m);
+    }
+    size_t closest_segment = 0;
+    Eigen::Vector3d closest_point = planned_path_.front();
+    double closest_distance = std::numeric_limits<double>::max();
+    for (size_t i = 0; i + 1 < planned_path_.size(); i++) {
+      const Eigen::Vector3d segment = planned_path_[i + 1] - planned_path_[i];
+      const double t =
+          segment.squaredNorm() > 0
+              ? std::clamp((t_WORLD_BASELINK - planned_path_[i]).dot(segment) /
+                               segment.squaredNorm(),
+                           0.0, 1.0)
+              : 0.0;
+      const Eigen::Vector3d point = planned_path_[i] + t * segment;
+      const double distance = (point - t_WORLD_BASELINK).squaredNorm();
+      if (distance < closest_distance) {
+        closest_distance = distance;
+        closest_segment = i;
+        closest_point = point;
+      }
+    }
+    polyline.push_back(closest_point);
+    polyline.insert(polyline.end(), planned_path_.begin() + closest_segment + 1,
+                    planned_path_.end());
+    return SamplePolyline(polyline, length, params_.sample_spacing_m);
+  }
+
+  // without a velocity, the path ahead is unknown
+  if (speed < 1e-3) { return {t_WORLD_BASELINK}; }
+  const Eigen::Vector3d end =
+      t_WORLD_BASELINK + velocity_->normalized() * length;
+  return SamplePolyline({t_WORLD_BASELINK, end}, length,
+                        params_.sample_spacing_m);
+}
+
+void SubmapPrefetcher::SetPlannedPath(
+    const std::vector<Eigen::Vector3d>& path) {
+  std::lock_guard<std::mutex> lock(motion_mutex_);
+  planned_path_ = path;
+}
+
+void SubmapPrefetcher::Request(const std::vector<SubmapPtr>& submaps,
+                               const std::vector<size_t>& submap_ids) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (submap_ids == requested_ids_) { return; }
+    submaps_ = submaps;
+    requested_ids_ = submap_ids;
+    request_version_++;
+  }
+  cv_.notify_all();
+}
+
+void SubmapPrefetcher::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() {
+    return stop_ || processed_version_ == request_version_;
+  });
+}
+
+std::vector<size_t> SubmapPrefetcher::PrefetchedIds() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<size_t> ids;
+  for (const auto& prefetched : prefetched_) {
+    ids.push_back(prefetched.submap_id);
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+size_t SubmapPrefetcher::MemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_usage_;
+}
+
+void SubmapPrefetcher::Run() {
+  static bs_common::Metric& prefetch_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_prefetcher/prefetched");
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() {
+      return stop_ || processed_version_ != request_version_;
+    });
+    if (stop_) { break; }
+    const uint64_t version = request_version_;
+    const std::vector<size_t> ids = requested_ids_;
+    const std::vector<SubmapPtr> submaps = submaps_;
+
+    // release the submaps that are not requested anymore. Handles are
+    // destroyed outside of the lock since releasing may evict them
+    std::vector<Prefetched> released;
+    for (auto iter = prefetched_.begin(); iter != prefetched_.end();) {
+      if (std::find(ids.begin(), ids.end(), iter->submap_id) != ids.end()) {
+        iter++;
+        continue;
+      }
+      memory_usage_ -= iter->memory_bytes;
+      released.push_back(std::move(*iter));
+      iter = prefetched_.erase(iter);
+    }
+    lock.unlock();
+    released.clear();
+    lock.lock();
+
+    // load in the order requested until the budget is used, or until a new
+    // request replaces this one
+    for (const size_t id : ids) {
+      if (stop_ || request_version_ != version) { break; }
+      if (memory_usage_ >= memory_budget_bytes_) { break; }
+      const auto is_id = [id](const Prefetched& p) {
+        return p.submap_id == id;
+      };
+      if (std::any_of(prefetched_.begin(), prefetched_.end(), is_id)) {
+        continue;
+      }
+
+      lock.unlock();
+      size_t memory_bytes = 0;
+      Handle handle = load_(submaps, id, memory_bytes);
+      lock.lock();
+      if (!handle) {
+        BEAM_WARN("Cannot prefetch submap {}", id);
+        continue;
+      }
+      if (memory_usage_ + memory_bytes > memory_budget_bytes_) {
+        lock.unlock();
+        handle.reset();
+        lock.lock();
+        break;
+      }
+      prefetch_metric.Increment();
+      memory_usage_ += memory_bytes;
+      prefetched_.push_back(Prefetched{id, memory_bytes, std::move(handle)});
+    }
+
+    if (request_version_ == version) {
+      processed_version_ = version;
+      cv_.notify_all();
+    }
+  }
+
+  // release all prefetched submaps before the thread ends
+  std::vector<Prefetched> prefetched = std::move(prefetched_);
+  prefetched_.clear();
+  memory_usage_ = 0;
+  lock.unlock();
+  prefetched.clear();
+  cv_.notify_all();
+}
+
+} // namespace bs_models::global_mapping
@@ -1,5 +1,6 @@
 #include <bs_models/global_mapping/submap_refinement.h>
 
+#include <atomic>
 #include <filesystem>
 
 #include <fuse_core/transaction.h>
@@ -7,6 +8,7 @@
 
 // #include <beam_matching/Matchers.h>
 
+#include <bs_common/thread_pool.h>
 #include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
 #include <bs_models/scan_registration/multi_scan_registration.h>
 #include <bs_models/scan_registration/scan_to_map_registration.h>
@@ -22,21 +24,51 @@ SubmapRefinement::SubmapRefinement(const SubmapRefinement::Params& params,
     : params_(params), output_path_(output_path) {}
 
 bool SubmapRefinement::Run(std::vector<SubmapPtr> submaps) {
-  for (uint16_t i = 0; i < submaps.size(); i++) {
-    BEAM_INFO("Refining submap No. {}/{}", i+1, submaps.size());
-    if (!RefineSubmap(submaps.at(i))) {
-      BEAM_ERROR("Submap refinement failed, exiting.");
-      return false;
+  if (!output_path_.empty() && !std::filesystem::exists(output_path_)) {
+    BEAM_ERROR("Invalid output path for submap refinement: {}", output_path_);
+    throw std::runtime_error{"invalid path"};
+  }
+  if (submaps.empty()) { return true; }
+
+  // submap poses are decoupled during refinement so each submap is refined
+  // independently, then the results are merged in submap order
+  bs_common::ThreadPool pool(static_cast<int>(
+      std::min<size_t>(std::max(params_.num_threads, 1), submaps.size())));
+  std::vector<RegistrationResults> submap_results(submaps.size());
+  std::atomic<size_t> num_done{0};
+  std::atomic<bool> success{true};
+  std::vector<std::future<void>> futures;
+  futures.reserve(submaps.size());
+  for (size_t i = 0; i < submaps.size(); i++) {
+    futures.push_back(pool.Enqueue([&, i]() {
+      if (!RefineSubmap(submaps.at(i), submap_results.at(i))) {
+        success = false;
+      }
+      BEAM_INFO("Refined submap No. {} ({}/{})", i + 1, ++num_done,
+                submaps.size());
+    }));
+  }
+  for (auto& future : futures) {
+    try {
+      future.get();
+    } catch (const std::exception& e) {
+      BEAM_ERROR("Submap refinement threw: {}", e.what());
+      success = false;
     }
   }
+  if (!success) {
+    BEAM_ERROR("Submap refinement failed, exiting.");
+    return false;
+  }
+
+  for (const RegistrationResults& results : submap_results) {
+    results_.insert(results.begin(), results.end());
+  }
   return true;
 }
 
-bool SubmapRefinement::RefineSubmap(SubmapPtr& submap) {
-  if (!output_path_.empty() && !std::filesystem::exists(output_path_)) {
-    BEAM_ERROR("Invalid output path for submap refinement: {}", output_path_);
-    throw std::runtime_error{"invalid path"};
-  }
+bool SubmapRefinement::RefineSubmap(SubmapPtr& submap,
+                                    RegistrationResults& results) const {
   std::string dir = "submap_" + std::to_string(submap->Stamp().toSec());
   std::string submap_output = output_path_.empty()
                                   ? output_path_
@@ -47,15 +79,12 @@ bool SubmapRefinement::RefineSubmap(SubmapPtr& submap) {
   std::shared_ptr<fuse_graphs::HashGraph> graph =
       fuse_graphs::HashGraph::make_shared();
   std::unique_ptr<sr::ScanRegistrationBase> scan_registration =
-      sr::ScanRegistrationBase::Create(params_.scan_registration_config,
-                                       params_.matcher_config, "", 1e-9);
-
-  // clear lidar map
-  scan_registration->GetMapMutable().Clear();
+      sr::ScanRegistrationBase::Create(
+          params_.scan_registration_config, params_.matcher_config, "", 1e-9,
+          std::make_shared<sr::RegistrationMap>());
 
   // iterate through stored scan poses and add run scan registration. We store
   // the transactions and covariances to later add to the graph at the same time
-  BEAM_INFO("Registering scans");
   std::map<ros::Time, fuse_core::Transaction::SharedPtr> reg_transactions;
   std::map<ros::Time, Eigen::Matrix<double, 6, 6>> reg_covariances;
   for (auto scan_iter = submap->LidarKeyframesBegin();
@@ -110,12 +139,10 @@ bool SubmapRefinement::RefineSubmap(SubmapPtr& submap) {
   }
 
   // Optimize graph and update data
-  BEAM_INFO("Optimizing graph");
   graph->optimize();
 
   PointCloud submap_init;
   PointCloud submap_refined;
-  BEAM_INFO("updating scan poses");
   for (auto scan_iter = submap->LidarKeyframesBegin();
        scan_iter != submap->LidarKeyframesEnd(); scan_iter++) {
     auto& sp = scan_iter->second;
@@ -123,9 +150,9 @@ bool SubmapRefinement::RefineSubmap(SubmapPtr& submap) {
     sp.UpdatePose(graph);
     Eigen::Matrix4d T_W_B_after = sp.T_REFFRAME_BASELINK();
     RegistrationResult result(T_W_B_init, T_W_B_after);
-    results_.emplace(sp.Stamp(), result);
+    results.emplace(sp.Stamp(), result);
     if (!submap_output.empty()) {
-      auto scan_in_lidar = sp.Cloud();
+      const auto& scan_in_lidar = sp.Cloud();
       PointCloud scan_in_world_init;
       PointCloud scan_in_world_after;
       pcl::transformPointCloud(
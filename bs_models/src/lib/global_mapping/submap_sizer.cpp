@@ -0,0 +1,87 @@
+#include <bs_models/global_mapping/submap_sizer.h>
+
+#include <stdexcept>
+
+#include <beam_utils/log.h>
+
+namespace bs_models::global_mapping {
+
+void SubmapSizer::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("max_lidar_points")) {
+    max_lidar_points = J["max_lidar_points"];
+  }
+  if (J.contains("max_landmark_measurements")) {
+    max_landmark_measurements = J["max_landmark_measurements"];
+  }
+  if (J.contains("max_keyframes")) { max_keyframes = J["max_keyframes"]; }
+  if (J.contains("min_submap_size_m")) {
+    min_submap_size_m = J["min_submap_size_m"];
+  }
+  if (J.contains("max_submap_size_m")) {
+    max_submap_size_m = J["max_submap_size_m"];
+  }
+  if (J.contains("min_fill_fraction")) {
+    min_fill_fraction = J["min_fill_fraction"];
+  }
+  if (min_submap_size_m < 0 || max_submap_size_m < min_submap_size_m ||
+      min_fill_fraction < 0 || min_fill_fraction > 1) {
+    BEAM_ERROR("Adaptive submap sizes must satisfy 0 <= min_submap_size_m <= "
+               "max_submap_size_m, and min_fill_fraction must be in [0, 1]");
+    throw std::invalid_argument{"invalid adaptive submap params"};
+  }
+}
+
+nlohmann::json SubmapSizer::Params::ToJson() const {
+  return nlohmann::json{
+      {"enabled", enabled},
+      {"max_lidar_points", max_lidar_points},
+      {"max_landmark_measurements", max_landmark_measurements},
+      {"max_keyframes", max_keyframes},
+      {"min_submap_size_m", min_submap_size_m},
+      {"max_submap_size_m", max_submap_size_m},
+      {"min_fill_fraction", min_fill_fraction}};
+}
+
+SubmapSizer::SubmapSizer(const Params& params) : params_(params) {}
+
+bool SubmapSizer::StartNewSubmap(double distance_m,
+                                 double submap_size_m) const {
+  if (!params_.enabled) { return distance_m >= submap_size_m; }
+  if (distance_m >= params_.min_submap_size_m && OverBudget()) { return true; }
+  if (distance_m < submap_size_m) { return false; }
+  return distance_m >= params_.max_submap_size_m || !Underfilled();
+}
+
+void SubmapSizer::Add(size_t lidar_points, size_t landmark_measurements,
+                      size_t keyframes) {
+  fill_.lidar_points += lidar_points;
+  fill_.landmark_measurements += landmark_measurements;
+  fill_.keyframes += keyframes;
+}
+
+bool SubmapSizer::OverBudget() const {
+  auto over = [](size_t value, size_t budget) {
+    return budget > 0 && value >= budget;
+  };
+  return over(fill_.lidar_points, params_.max_lidar_points) ||
+         over(fill_.landmark_measurements, params_.max_landmark_measurements) ||
+         over(fill_.keyframes, params_.max_keyframes);
+}
+
+bool SubmapSizer::Underfilled() const {
+  // without budgets there is nothing to fill
+  bool has_budget = false;
+  auto under = [&](size_t value, size_t budget) {
+    if (budget == 0) { return true; }
+    has_budget = true;
+    return value < params_.min_fill_fraction * budget;
+  };
+  const bool underfilled =
+      under(fill_.lidar_points, params_.max_lidar_points) &&
+      under(fill_.landmark_measurements, params_.max_landmark_measurements) &&
+      under(fill_.keyframes, params_.max_keyframes);
+  return has_budget && underfilled;
+}
+
+} // namespace bs_models::global_mapping
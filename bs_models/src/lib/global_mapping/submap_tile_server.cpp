@@ -0,0 +1,206 @@
+#include <bs_models/global_mapping/submap_tile_server.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/thread_pool.h>
+#include <bs_common/utils.h>
+
+namespace bs_models::global_mapping {
+
+void SubmapTileServer::Params::LoadJson(const std::string& config_path) {
+  if (config_path.empty()) {
+    BEAM_INFO("No config file provided to submap tile server, using default "
+              "parameters.");
+    return;
+  }
+  BEAM_INFO("Loading submap tile server config file: {}", config_path);
+  nlohmann::json J;
+  if (!beam::ReadJson(config_path, J)) {
+    BEAM_ERROR("Unable to read submap tile server config");
+    throw std::runtime_error{"Unable to read submap tile server config"};
+  }
+
+  beam::ValidateJsonKeysOrThrow(
+      {"candidate_search_config", "refinement_config"}, J);
+
+  std::string candidate_search_config_rel = J["candidate_search_config"];
+  if (!candidate_search_config_rel.empty()) {
+    candidate_search_config = beam::CombinePaths(
+        bs_common::GetBeamSlamConfigPath(), candidate_search_config_rel);
+  }
+
+  std::string refinement_config_rel = J["refinement_config"];
+  if (!refinement_config_rel.empty()) {
+    refinement_config = beam::CombinePaths(bs_common::GetBeamSlamConfigPath(),
+                                           refinement_config_rel);
+  }
+
+  if (J.contains("num_threads")) {
+    num_threads = J["num_threads"];
+    if (num_threads < 1) {
+      BEAM_ERROR("submap tile server num_threads must be at least 1");
+      throw std::runtime_error{"invalid submap tile server num_threads"};
+    }
+  }
+}
+
+SubmapTileServer::SubmapTileServer(
+    const Params& params, const std::shared_ptr<SubmapTileStore>& store)
+    : params_(params), store_(store) {
+  candidate_search_ =
+      reloc::RelocCandidateSearchBase::Create(params_.candidate_search_config);
+
+  // each thread needs its own refinement since the matchers are not thread
+  // safe
+  for (int i = 0; i < std::max(params_.num_threads, 1); i++) {
+    refinements_.push_back(
+        reloc::RelocRefinementBase::Create(params_.refinement_config));
+  }
+}
+
+std::vector<SubmapTileServer::LoopClosure>
+    SubmapTileServer::ProcessNewTiles() {
+  const std::vector<size_t> new_tiles = store_->Refresh();
+
+  // replaced tiles are loaded again
+  for (const size_t tile : new_tiles) { search_tiles_.erase(tile); }
+
+  struct Candidate {
+    size_t reference;
+    size_t query;
+    Eigen::Matrix4d T_REFERENCE_QUERY_EST;
+  };
+  std::vector<Candidate> candidates;
+  for (const size_t query : new_tiles) {
+    const std::string robot_name = store_->GetTile(query).robot_name;
+    std::vector<size_t> reference_tiles;
+    std::vector<SubmapPtr> reference_submaps;
+    for (size_t reference = 0; reference < query; reference++) {
+      if (store_->GetTile(reference).robot_name == robot_name) { continue; }
+      SubmapPtr submap = GetSearchTile(reference);
+      if (!submap) { continue; }
+      reference_tiles.push_back(reference);
+      reference_submaps.push_back(submap);
+    }
+    const SubmapPtr query_submap = GetSearchTile(query);
+    if (reference_submaps.empty() || !query_submap) { continue; }
+
+    std::vector<int> matched_indices;
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
+    candidate_search_->FindRelocCandidates(reference_submaps, query_submap,
+                                           matched_indices, Ts_MATCH_QUERY, 0);
+    for (size_t i = 0; i < matched_indices.size(); i++) {
+      candidates.push_back(Candidate{reference_tiles.at(matched_indices[i]),
+                                     query, Ts_MATCH_QUERY.at(i)});
+    }
+  }
+  if (candidates.empty()) { return {}; }
+
+  // the search tiles only have their clouds if the search uses them
+  const bool has_clouds = candidate_search_->UsesLidarClouds();
+  const auto get_submap = [&](size_t tile) {
+    return has_clouds ? search_tiles_.at(tile) : store_->Fetch(tile);
+  };
+
+  // each worker uses its own refinement, and takes the next candidate until
+  // all are verified
+  std::vector<LoopClosure> loop_closures;
+  std::mutex loop_closures_mutex;
+  bs_common::ThreadPool pool(static_cast<int>(
+      std::min<size_t>(refinements_.size(), candidates.size())));
+  std::atomic<size_t> next{0};
+  pool.ParallelFor(pool.NumThreads(), [&](size_t worker) {
+    reloc::RelocRefinementBase& refinement = *refinements_.at(worker);
+    for (size_t i = next++; i < candidates.size(); i = next++) {
+      const Candidate& c = candidates.at(i);
+      const SubmapPtr reference = get_submap(c.reference);
+      const SubmapPtr query = get_submap(c.query);
+      if (!reference || !query) { continue; }
+      const reloc::RelocRefinementResults results =
+          refinement.RunRefinement(reference, query, c.T_REFERENCE_QUERY_EST);
+      if (!results.successful) { continue; }
+      LoopClosure loop_closure{store_->GetTile(c.reference),
+                               store_->GetTile(c.query), results.T_MATCH_QUERY};
+      std::lock_guard<std::mutex> lock(loop_closures_mutex);
+      loop_closures.push_back(std::move(loop_closure));
+    }
+  });
+  BEAM_INFO("Verified {} inter-robot candidates of {} new tiles, {} "
+            "successful",
+            candidates.size(), new_tiles.size(), loop_closures.size());
+  return loop_closures;
+}
+
+bool SubmapTileServer::SaveLoopClosures(
+    const std::string& filename,
+    const std::vector<LoopClosure>& loop_closures) {
+  nlohmann::json J = nlohmann::json::array();
+  if (std::filesystem::exists(filename) && !beam::ReadJson(filename, J)) {
+    BEAM_ERROR("Cannot read loop closures file: {}", filename);
+    return false;
+  }
+  for (const LoopClosure& loop_closure : loop_closures) {
+    nlohmann::json J_loop_closure;
+    J_loop_closure["reference_robot"] = loop_closure.reference.robot_name;
+    J_loop_closure["reference_submap"] = loop_closure.reference.submap_id;
+    J_loop_closure["query_robot"] = loop_closure.query.robot_name;
+    J_loop_closure["query_submap"] = loop_closure.query.submap_id;
+    beam::AddTransformToJson(J_loop_closure, loop_closure.T_REFERENCE_QUERY,
+                             "T_REFERENCE_QUERY");
+    J.push_back(J_loop_closure);
+  }
+
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    BEAM_ERROR("Cannot save loop closures to: {}", filename);
+    return false;
+  }
+  file << std::setw(4) << J << std::endl;
+  return true;
+}
+
+bool SubmapTileServer::LoadLoopClosures(
+    const std::string& filename, std::vector<LoopClosure>& loop_closures) {
+  nlohmann::json J;
+  if (!beam::ReadJson(filename, J)) {
+    BEAM_ERROR("Cannot read loop closures file: {}", filename);
+    return false;
+  }
+  try {
+    for (const auto& J_loop_closure : J) {
+      LoopClosure loop_closure;
+      loop_closure.reference.robot_name = J_loop_closure["reference_robot"];
+      loop_closure.reference.submap_id = J_loop_closure["reference_submap"];
+      loop_closure.query.robot_name = J_loop_closure["query_robot"];
+      loop_closure.query.submap_id = J_loop_closure["query_submap"];
+      std::vector<double> T = J_loop_closure["T_REFERENCE_QUERY"];
+      loop_closure.T_REFERENCE_QUERY = beam::VectorToEigenTransform(T);
+      loop_closures.push_back(loop_closure);
+    }
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Invalid loop closures file {}: {}", filename, e.what());
+    return false;
+  }
+  return true;
+}
+
+SubmapPtr SubmapTileServer::GetSearchTile(size_t tile) {
+  auto iter = search_tiles_.find(tile);
+  if (iter != search_tiles_.end()) { return iter->second; }
+
+  SubmapPtr submap = store_->Fetch(tile, candidate_search_->UsesLidarClouds());
+  if (!submap) { return nullptr; }
+  candidate_search_->PrepareSubmap(submap);
+  search_tiles_.emplace(tile, submap);
+  return submap;
+}
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,297 @@
+#include <bs_models/global_mapping/submap_tile_store.h>
+
+#include <algorithm>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/chunk_file.h>
+#include <bs_models/global_mapping/map_store.h>
+
+namespace bs_models::global_mapping {
+
+namespace {
+
+constexpr char kTilePrefix[] = "submap";
+constexpr char kTileExtension[] = ".bin";
+
+} // namespace
+
+void SubmapTileStore::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("directory")) { directory = J["directory"]; }
+  if (J.contains("robot_name")) { robot_name = J["robot_name"]; }
+  if (J.contains("cell_size_m")) { cell_size_m = J["cell_size_m"]; }
+  if (cell_size_m <= 0) {
+    BEAM_ERROR("Submap tile store cell_size_m must be positive");
+    throw std::invalid_argument{"invalid submap tile store params"};
+  }
+  if (robot_name.find('/') != std::string::npos) {
+    BEAM_ERROR("Submap tile store robot_name cannot contain '/': {}",
+               robot_name);
+    throw std::invalid_argument{"invalid submap tile store params"};
+  }
+}
+
+nlohmann::json SubmapTileStore::Params::ToJson() const {
+  return nlohmann::json{{"enabled", enabled},
+                        {"directory", directory},
+                        {"robot_name", robot_name},
+                        {"cell_size_m", cell_size_m}};
+}
+
+SubmapTileStore::SubmapTileStore(const Params& params)
+    : params_(params), position_index_(params.cell_size_m) {
+  if (!std::filesystem::is_directory(params_.directory)) {
+    BEAM_ERROR("Submap tile store directory does not exist: {}",
+               params_.directory);
+    throw std::invalid_argument{"invalid submap tile store directory"};
+  }
+}
+
+bool SubmapTileStore::Push(uint16_t submap_id, const SubmapPtr& submap) {
+  if (params_.robot_name.empty()) {
+    BEAM_ERROR("Submap tile store has no robot_name, cannot push submaps");
+    return false;
+  }
+  std::error_code error;
+  std::filesystem::create_directories(
+      beam::CombinePaths(params_.directory, params_.robot_name), error);
+  if (error || !WriteCalibration(*submap)) {
+    BEAM_ERROR("Cannot write the calibration of robot {} to the tile store",
+               params_.robot_name);
+    return false;
+  }
+
+  Tile tile;
+  tile.robot_name = params_.robot_name;
+  tile.submap_id = submap_id;
+  tile.stamp = submap->Stamp();
+  tile.T_WORLD_SUBMAP = submap->T_WORLD_SUBMAP();
+  tile.path = TilePath(params_.robot_name, submap_id);
+
+  // readers only ever see complete tiles
+  const std::string tmp_path = tile.path + ".tmp";
+  bs_common::ChunkFileWriter writer;
+  if (!writer.Open(tmp_path, kMapStoreVersion)) { return false; }
+  bs_common::ByteWriter info;
+  info.Write<uint32_t>(submap_id);
+  info.WriteString(tile.robot_name);
+  info.Write<uint32_t>(tile.stamp.sec);
+  info.Write<uint32_t>(tile.stamp.nsec);
+  info.WriteMatrix(tile.T_WORLD_SUBMAP);
+  const bool success =
+      submap->SaveData(writer, submap_id) &&
+      writer.AddChunk(static_cast<uint32_t>(MapChunkType::TILE_INFO),
+                      MapChunkId(submap_id), info);
+  if (!writer.Close() || !success) {
+    BEAM_ERROR("Cannot write submap tile: {}", tmp_path);
+    std::filesystem::remove(tmp_path, error);
+    return false;
+  }
+  std::filesystem::rename(tmp_path, tile.path, error);
+  if (error) {
+    BEAM_ERROR("Cannot move submap tile to {}: {}", tile.path,
+               error.message());
+    std::filesystem::remove(tmp_path, error);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  write_times_[tile.path] = std::filesystem::last_write_time(tile.path, error);
+  AddTile(tile);
+  return true;
+}
+
+std::vector<size_t> SubmapTileStore::Refresh() {
+  // list the tiles which changed without holding the lock, the store may be on
+  // a slow network mount
+  std::vector<std::pair<std::string, std::filesystem::file_time_type>> changed;
+  try {
+    for (const auto& robot_dir :
+         std::filesystem::directory_iterator(params_.directory)) {
+      if (!robot_dir.is_directory()) { continue; }
+      for (const auto& entry :
+           std::filesystem::directory_iterator(robot_dir.path())) {
+        const std::string filename = entry.path().filename().string();
+        if (filename.rfind(kTilePrefix, 0) != 0 ||
+            entry.path().extension() != kTileExtension) {
+          continue;
+        }
+        const auto write_time = entry.last_write_time();
+        const std::string path = entry.path().string();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = write_times_.find(path);
+        if (iter == write_times_.end() || iter->second != write_time) {
+          changed.emplace_back(path, write_time);
+        }
+      }
+    }
+  } catch (const std::filesystem::filesystem_error& e) {
+    BEAM_WARN("Cannot list all submap tiles in {}: {}", params_.directory,
+              e.what());
+  }
+
+  std::vector<size_t> refreshed;
+  for (const auto& [path, write_time] : changed) {
+    Tile tile;
+    if (!ReadTileInfo(path, tile)) { continue; }
+    tile.path = path;
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_times_[path] = write_time;
+    refreshed.push_back(AddTile(tile));
+  }
+  std::sort(refreshed.begin(), refreshed.end());
+  refreshed.erase(std::unique(refreshed.begin(), refreshed.end()),
+                  refreshed.end());
+  return refreshed;
+}
+
+std::vector<size_t>
+    SubmapTileStore::Nearby(const Eigen::Vector3d& position, double radius_m,
+                            const std::string& robot_name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<size_t> tiles =
+      position_index_.Radius(position, radius_m, tiles_.size());
+  if (robot_name.empty()) { return tiles; }
+  tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+                             [&](size_t i) {
+                               return tiles_.at(i).robot_name != robot_name;
+                             }),
+              tiles.end());
+  return tiles;
+}
+
+SubmapPtr SubmapTileStore::Fetch(size_t tile_index,
+                                 bool load_lidar_clouds) const {
+  const Tile tile = GetTile(tile_index);
+  Calibration calibration;
+  if (!GetCalibration(tile.robot_name, calibration)) {
+    BEAM_ERROR("No calibration for the tiles of robot {}", tile.robot_name);
+    return nullptr;
+  }
+
+  bs_common::ChunkFileReader reader;
+  if (!reader.Open(tile.path)) { return nullptr; }
+  if (reader.Version() > kMapStoreVersion) {
+    BEAM_ERROR("Submap tile version {} is newer than the supported version "
+               "{}: {}",
+               reader.Version(), kMapStoreVersion, tile.path);
+    return nullptr;
+  }
+  auto submap = std::make_shared<Submap>(tile.stamp, tile.T_WORLD_SUBMAP,
+                                         calibration.camera_model,
+                                         calibration.extrinsics);
+  if (!submap->LoadData(reader, tile.submap_id, load_lidar_clouds)) {
+    BEAM_ERROR("Cannot load submap tile: {}", tile.path);
+    return nullptr;
+  }
+  return submap;
+}
+
+SubmapTileStore::Tile SubmapTileStore::GetTile(size_t tile) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tiles_.at(tile);
+}
+
+size_t SubmapTileStore::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tiles_.size();
+}
+
+std::string SubmapTileStore::TilePath(const std::string& robot_name,
+                                      uint16_t submap_id) const {
+  return beam::CombinePaths(
+      beam::CombinePaths(params_.directory, robot_name),
+      kTilePrefix + std::to_string(submap_id) + kTileExtension);
+}
+
+bool SubmapTileStore::WriteCalibration(Submap& submap) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (calibrations_.count(params_.robot_name) > 0) { return true; }
+  if (!submap.Extrinsics()) { return false; }
+
+  const std::string robot_dir =
+      beam::CombinePaths(params_.directory, params_.robot_name);
+  Calibration calibration{submap.CameraModel(), submap.Extrinsics()};
+  if (calibration.camera_model) {
+    calibration.camera_model->WriteJSON(
+        beam::CombinePaths(robot_dir, "camera_model.json"));
+  }
+  calibration.extrinsics->SaveExtrinsicsToJson(
+      beam::CombinePaths(robot_dir, "extrinsics.json"));
+  calibration.extrinsics->SaveFrameIdsToJson(
+      beam::CombinePaths(robot_dir, "frame_ids.json"));
+  calibrations_.emplace(params_.robot_name, std::move(calibration));
+  return true;
+}
+
+bool SubmapTileStore::GetCalibration(const std::string& robot_name,
+                                     Calibration& calibration) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = calibrations_.find(robot_name);
+  if (iter != calibrations_.end()) {
+    calibration = iter->second;
+    return true;
+  }
+
+  const std::string robot_dir =
+      beam::CombinePaths(params_.directory, robot_name);
+  const std::string camera_model_path =
+      beam::CombinePaths(robot_dir, "camera_model.json");
+  const std::string extrinsics_path =
+      beam::CombinePaths(robot_dir, "extrinsics.json");
+  const std::string frame_ids_path =
+      beam::CombinePaths(robot_dir, "frame_ids.json");
+  if (!std::filesystem::exists(extrinsics_path) ||
+      !std::filesystem::exists(frame_ids_path)) {
+    return false;
+  }
+
+  // robots without a camera have no camera model
+  if (std::filesystem::exists(camera_model_path)) {
+    calibration.camera_model =
+        beam_calibration::CameraModel::Create(camera_model_path);
+  }
+  calibration.extrinsics = std::make_shared<bs_common::ExtrinsicsLookupBase>(
+      frame_ids_path, extrinsics_path);
+  calibrations_.emplace(robot_name, calibration);
+  return true;
+}
+
+bool SubmapTileStore::ReadTileInfo(const std::string& path, Tile& tile) {
+  bs_common::ChunkFileReader reader;
+  if (!reader.Open(path)) { return false; }
+  const auto chunks =
+      reader.Chunks(static_cast<uint32_t>(MapChunkType::TILE_INFO));
+  if (chunks.size() != 1) {
+    BEAM_WARN("Submap tile has no info, skipping it: {}", path);
+    return false;
+  }
+  try {
+    bs_common::ByteReader info = reader.Read(chunks.front());
+    tile.submap_id = static_cast<uint16_t>(info.Read<uint32_t>());
+    tile.robot_name = info.ReadString();
+    const uint32_t sec = info.Read<uint32_t>();
+    const uint32_t nsec = info.Read<uint32_t>();
+    tile.stamp = ros::Time(sec, nsec);
+    info.ReadMatrix(tile.T_WORLD_SUBMAP);
+  } catch (const std::runtime_error& e) {
+    BEAM_WARN("Invalid submap tile info in {}: {}", path, e.what());
+    return false;
+  }
+  return true;
+}
+
+size_t SubmapTileStore::AddTile(const Tile& tile) {
+  auto [iter, added] = tiles_by_path_.emplace(tile.path, tiles_.size());
+  if (added) {
+    tiles_.push_back(tile);
+  } else {
+    tiles_.at(iter->second) = tile;
+  }
+  position_index_.Update(iter->second, tile.T_WORLD_SUBMAP.block<3, 1>(0, 3));
+  return iter->second;
+}
+
+} // namespace bs_models::global_mapping
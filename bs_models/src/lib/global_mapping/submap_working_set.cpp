@@ -0,0 +1,198 @@
+#include <bs_models/global_mapping/submap_working_set.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/instrumentation.h>
+#include <bs_models/global_mapping/map_store.h>
+
+namespace bs_models::global_mapping {
+
+SubmapWorkingSet::Lease::~Lease() {
+  Release();
+}
+
+SubmapWorkingSet::Lease::Lease(Lease&& other) noexcept
+    : working_set_(other.working_set_),
+      submap_ids_(std::move(other.submap_ids_)),
+      valid_(other.valid_) {
+  other.working_set_ = nullptr;
+  other.submap_ids_.clear();
+}
+
+SubmapWorkingSet::Lease&
+    SubmapWorkingSet::Lease::operator=(Lease&& other) noexcept {
+  if (this == &other) { return *this; }
+  Release();
+  working_set_ = other.working_set_;
+  submap_ids_ = std::move(other.submap_ids_);
+  valid_ = other.valid_;
+  other.working_set_ = nullptr;
+  other.submap_ids_.clear();
+  return *this;
+}
+
+void SubmapWorkingSet::Lease::Release() {
+  if (working_set_) { working_set_->Unpin(submap_ids_); }
+  working_set_ = nullptr;
+  submap_ids_.clear();
+}
+
+SubmapWorkingSet::SubmapWorkingSet(
+    const std::vector<SubmapPtr>& submaps,
+    const std::shared_ptr<const bs_common::ChunkFileReader>& map_store,
+    size_t memory_budget_bytes)
+    : submaps_(submaps),
+      map_store_(map_store),
+      memory_budget_bytes_(memory_budget_bytes),
+      chunks_(submaps.size()),
+      memory_(submaps.size(), 0),
+      num_leases_(submaps.size(), 0),
+      loaded_(submaps.size(), false),
+      lru_positions_(submaps.size()) {
+  if (!map_store_ || !map_store_->IsOpen()) {
+    BEAM_ERROR("Submap working set requires an open map store.");
+    throw std::invalid_argument{"map store not open"};
+  }
+  for (size_t i = 0; i < submaps_.size(); i++) {
+    const uint32_t num_keyframes = submaps_.at(i)->LidarKeyframes().size();
+    for (uint32_t k = 0; k < num_keyframes; k++) {
+      const bs_common::ChunkInfo* chunk = map_store_->Find(
+          static_cast<uint32_t>(MapChunkType::LIDAR_KEYFRAME),
+          MapChunkId(i, k));
+      if (!chunk) { continue; }
+      chunks_.at(i).push_back(*chunk);
+      // points are stored as 3 floats but take 4 in memory
+      memory_.at(i) += chunk->size * 4 / 3;
+    }
+  }
+}
+
+std::shared_ptr<SubmapWorkingSet> SubmapWorkingSet::ForSubmaps(
+    const std::vector<SubmapPtr>& submaps) const {
+  if (submaps.size() != submaps_.size()) {
+    BEAM_ERROR("Cannot create submap working set over {} submaps, the map "
+               "store has {}",
+               submaps.size(), submaps_.size());
+    throw std::invalid_argument{"invalid number of submaps"};
+  }
+  for (const auto& submap : submaps) { submap->ReleaseLidarClouds(); }
+  return std::make_shared<SubmapWorkingSet>(submaps, map_store_,
+                                            memory_budget_bytes_);
+}
+
+SubmapWorkingSet::Lease
+    SubmapWorkingSet::Acquire(std::vector<size_t> submap_ids) {
+  static bs_common::Metric& load_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "submap_working_set/load");
+  std::sort(submap_ids.begin(), submap_ids.end());
+  submap_ids.erase(std::unique(submap_ids.begin(), submap_ids.end()),
+                   submap_ids.end());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Lease lease;
+  lease.working_set_ = this;
+  for (const size_t id : submap_ids) {
+    if (id >= submaps_.size()) {
+      throw std::out_of_range{"submap id out of range of working set"};
+    }
+    num_leases_.at(id)++;
+    lease.submap_ids_.push_back(id);
+    if (loaded_.at(id)) {
+      lru_.splice(lru_.begin(), lru_, lru_positions_.at(id));
+      continue;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!submaps_.at(id)->LoadLidarClouds(*map_store_, id)) {
+      BEAM_ERROR("Cannot load lidar clouds of submap {}", id);
+      lease.valid_ = false;
+    }
+    load_metric.Record(std::chrono::steady_clock::now() - start);
+
+    // kept even if loading failed so the partial clouds are released
+    loaded_.at(id) = true;
+    memory_usage_ += memory_.at(id);
+    lru_.push_front(id);
+    lru_positions_.at(id) = lru_.begin();
+  }
+  EvictToBudget();
+
+  if (memory_usage_ > memory_budget_bytes_ && !warned_over_budget_) {
+    BEAM_WARN("Leased submaps use {} MB, which is more than the memory budget "
+              "of {} MB",
+              memory_usage_ / 1e6, memory_budget_bytes_ / 1e6);
+    warned_over_budget_ = true;
+  }
+  return lease;
+}
+
+void SubmapWorkingSet::ReleaseAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t budget = memory_budget_bytes_;
+  memory_budget_bytes_ = 0;
+  EvictToBudget();
+  memory_budget_bytes_ = budget;
+}
+
+void SubmapWorkingSet::Unpin(const std::vector<size_t>& submap_ids) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const size_t id : submap_ids) { num_leases_.at(id)--; }
+  EvictToBudget();
+}
+
+void SubmapWorkingSet::EvictToBudget() {
+  auto iter = lru_.end();
+  while (memory_usage_ > memory_budget_bytes_ && iter != lru_.begin()) {
+    iter--;
+    const size_t id = *iter;
+    if (num_leases_.at(id) > 0) { continue; }
+    submaps_.at(id)->ReleaseLidarClouds();
+    for (const auto& chunk : chunks_.at(id)) { map_store_->Evict(chunk); }
+    loaded_.at(id) = false;
+    memory_usage_ -= memory_.at(id);
+    iter = lru_.erase(iter);
+  }
+}
+
+std::vector<std::vector<size_t>>
+    SubmapWorkingSet::Partition(size_t overlap) const {
+  std::vector<std::vector<size_t>> groups;
+  size_t begin = 0;
+  while (begin < submaps_.size()) {
+    std::vector<size_t> group;
+    size_t memory = 0;
+    size_t id = begin;
+    for (; id < submaps_.size(); id++) {
+      if (group.size() > overlap &&
+          memory + memory_.at(id) > memory_budget_bytes_) {
+        break;
+      }
+      group.push_back(id);
+      memory += memory_.at(id);
+    }
+    groups.push_back(group);
+    if (id == submaps_.size()) { break; }
+    begin = id - std::min(overlap, group.size() - 1);
+  }
+  return groups;
+}
+
+size_t SubmapWorkingSet::SubmapMemory(size_t submap_id) const {
+  return memory_.at(submap_id);
+}
+
+size_t SubmapWorkingSet::MemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_usage_;
+}
+
+size_t SubmapWorkingSet::NumLoaded() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lru_.size();
+}
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,185 @@
+#include <bs_models/global_mapping/tiled_lidar_map.h>
+
+#include <cmath>
+
+#include <pcl/common/transforms.h>
+
+#include <beam_utils/log.h>
+#include <beam_utils/math.h>
+#include <beam_utils/se3.h>
+
+#include <bs_models/lidar/parallel_voxel_grid.h>
+
+namespace bs_models::global_mapping {
+
+void TiledLidarMap::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("tile_size_m")) { tile_size_m = J["tile_size_m"]; }
+  if (J.contains("voxel_size_m")) { voxel_size_m = J["voxel_size_m"]; }
+  if (J.contains("num_levels")) { num_levels = J["num_levels"]; }
+  if (J.contains("lod_distance_m")) { lod_distance_m = J["lod_distance_m"]; }
+  if (J.contains("max_distance_m")) { max_distance_m = J["max_distance_m"]; }
+  if (J.contains("translation_tol_m")) {
+    translation_tol_m = J["translation_tol_m"];
+  }
+  if (J.contains("rotation_tol_rad")) {
+    rotation_tol_rad = J["rotation_tol_rad"];
+  }
+  if (tile_size_m <= 0 || voxel_size_m <= 0 || lod_distance_m <= 0 ||
+      num_levels < 1) {
+    BEAM_ERROR("Invalid lidar map tile params, tile_size_m, voxel_size_m and "
+               "lod_distance_m must be greater than 0 and num_levels at least "
+               "1");
+    throw std::invalid_argument{"invalid lidar map tile params"};
+  }
+}
+
+nlohmann::json TiledLidarMap::Params::ToJson() const {
+  return nlohmann::json{{"enabled", enabled},
+                        {"tile_size_m", tile_size_m},
+                        {"voxel_size_m", voxel_size_m},
+                        {"num_levels", num_levels},
+                        {"lod_distance_m", lod_distance_m},
+                        {"max_distance_m", max_distance_m},
+                        {"translation_tol_m", translation_tol_m},
+                        {"rotation_tol_rad", rotation_tol_rad}};
+}
+
+TiledLidarMap::TiledLidarMap(const Params& params) : params_(params) {}
+
+void TiledLidarMap::SetSubmap(int submap_id, const PointCloud& points,
+                              const Eigen::Matrix4d& T_WORLD_SUBMAP) {
+  auto iter = submaps_.find(submap_id);
+  if (iter != submaps_.end()) { RemoveFromTiles(submap_id, iter->second); }
+  SubmapLevels& submap = submaps_[submap_id];
+  submap.T_WORLD_SUBMAP = T_WORLD_SUBMAP;
+  submap.levels.clear();
+
+  // each level is downsampled from the previous one
+  const PointCloud* cloud = &points;
+  ParallelVoxelGrid<pcl::PointXYZ>::Params voxel_params;
+  voxel_params.priority = bs_common::TaskPriority::BACKGROUND;
+  float voxel_size = params_.voxel_size_m;
+  submap.levels.reserve(params_.num_levels);
+  for (int level = 0; level < params_.num_levels; level++) {
+    voxel_params.voxel_size =
+        Eigen::Vector3f(voxel_size, voxel_size, voxel_size);
+    submap.levels.push_back(
+        ParallelVoxelGrid<pcl::PointXYZ>(voxel_params).Filter(*cloud));
+    cloud = &submap.levels.back();
+    voxel_size *= 2;
+  }
+  AddToTiles(submap_id, submap);
+}
+
+bool TiledLidarMap::UpdateSubmapPose(int submap_id,
+                                     const Eigen::Matrix4d& T_WORLD_SUBMAP) {
+  auto iter = submaps_.find(submap_id);
+  if (iter == submaps_.end()) { return false; }
+  SubmapLevels& submap = iter->second;
+  const Eigen::Matrix4d T_delta =
+      beam::InvertTransform(submap.T_WORLD_SUBMAP) * T_WORLD_SUBMAP;
+  const Eigen::AngleAxisd dR(Eigen::Matrix3d(T_delta.block<3, 3>(0, 0)));
+  if (T_delta.block<3, 1>(0, 3).norm() <= params_.translation_tol_m &&
+      std::abs(dR.angle()) <= params_.rotation_tol_rad) {
+    return true;
+  }
+  RemoveFromTiles(submap_id, submap);
+  submap.T_WORLD_SUBMAP = T_WORLD_SUBMAP;
+  AddToTiles(submap_id, submap);
+  return true;
+}
+
+bool TiledLidarMap::HasSubmap(int submap_id) const {
+  return submaps_.find(submap_id) != submaps_.end();
+}
+
+void TiledLidarMap::Clear() {
+  submaps_.clear();
+  tiles_.clear();
+}
+
+TiledLidarMap::TileKey TiledLidarMap::ToTileKey(const pcl::PointXYZ& p) const {
+  return {static_cast<int64_t>(std::floor(p.x / params_.tile_size_m)),
+          static_cast<int64_t>(std::floor(p.y / params_.tile_size_m)),
+          static_cast<int64_t>(std::floor(p.z / params_.tile_size_m))};
+}
+
+void TiledLidarMap::AddToTiles(int submap_id, SubmapLevels& submap) {
+  const int num_levels = submap.levels.size();
+  for (int level = 0; level < num_levels; level++) {
+    PointCloud points_world;
+    pcl::transformPointCloud(submap.levels[level], points_world,
+                             submap.T_WORLD_SUBMAP);
+    for (const auto& p : points_world) {
+      const TileKey key = ToTileKey(p);
+      std::vector<PointCloud>& tile_levels =
+          tiles_[key].submap_levels[submap_id];
+      tile_levels.resize(num_levels);
+      tile_levels[level].push_back(p);
+      submap.tiles.insert(key);
+    }
+  }
+  for (const TileKey& key : submap.tiles) {
+    tiles_[key].version = next_version_++;
+  }
+}
+
+void TiledLidarMap::RemoveFromTiles(int submap_id, SubmapLevels& submap) {
+  for (const TileKey& key : submap.tiles) {
+    TileData& tile = tiles_[key];
+    tile.submap_levels.erase(submap_id);
+    tile.version = next_version_++;
+  }
+  submap.tiles.clear();
+}
+
+double TiledLidarMap::DistanceToTile(const TileKey& key,
+                                     const Eigen::Vector3d& viewpoint) const {
+  const Eigen::Vector3d center =
+      (Eigen::Vector3d(key[0], key[1], key[2]).array() + 0.5) *
+      params_.tile_size_m;
+  return (center - viewpoint).norm();
+}
+
+int TiledLidarMap::GetLevel(const TileKey& key,
+                            const Eigen::Vector3d& viewpoint) const {
+  const double distance = DistanceToTile(key, viewpoint);
+  if (distance <= params_.lod_distance_m) { return 0; }
+  const int level =
+      static_cast<int>(std::log2(distance / params_.lod_distance_m)) + 1;
+  return std::min(level, params_.num_levels - 1);
+}
+
+std::vector<TiledLidarMap::Tile>
+    TiledLidarMap::GetTiles(const Eigen::Vector3d& viewpoint,
+                            TileVersions& sent_versions) const {
+  std::vector<Tile> tiles;
+  for (const auto& [key, tile_data] : tiles_) {
+    if (params_.max_distance_m > 0 &&
+        DistanceToTile(key, viewpoint) > params_.max_distance_m) {
+      continue;
+    }
+    const int level = GetLevel(key, viewpoint);
+
+    auto sent = sent_versions.find(key);
+    if (sent != sent_versions.end() &&
+        sent->second == std::make_pair(level, tile_data.version)) {
+      continue;
+    }
+    // emptied tiles are only needed by clients that have them
+    if (tile_data.submap_levels.empty() && sent == sent_versions.end()) {
+      continue;
+    }
+
+    Tile tile{key, level, tile_data.version, PointCloud()};
+    for (const auto& [submap_id, levels] : tile_data.submap_levels) {
+      tile.points += levels.at(level);
+    }
+    sent_versions[key] = {level, tile_data.version};
+    tiles.push_back(std::move(tile));
+  }
+  return tiles;
+}
+
+} // namespace bs_models::global_mapping
@@ -0,0 +1,120 @@
+#include <bs_models/graph_visualization/landmark_cloud.h>
+
+#include <random>
+
+#include <bs_variables/point_3d_landmark.h>
+
+namespace bs_models::graph_visualization {
+
+namespace {
+
+const std::string k_landmark_type{"bs_variables::Point3DLandmark"};
+
+pcl::PointXYZRGBL ToPoint(const bs_variables::Point3DLandmark& landmark) {
+  pcl::PointXYZRGBL p;
+  p.x = landmark.x();
+  p.y = landmark.y();
+  p.z = landmark.z();
+  p.label = landmark.id();
+  // a local generator so colors don't depend on (or change) the global seed
+  std::minstd_rand generator(landmark.id() + 1);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  p.r = distribution(generator);
+  p.g = distribution(generator);
+  p.b = distribution(generator);
+  return p;
+}
+
+} // namespace
+
+void LandmarkCloud::Reset(const fuse_core::Graph& graph) {
+  Clear();
+  for (const auto& variable : graph.getVariables()) {
+    if (variable.type() != k_landmark_type) { continue; }
+    points_.emplace(
+        variable.uuid(),
+        ToPoint(dynamic_cast<const bs_variables::Point3DLandmark&>(variable)));
+    updated_.insert(variable.uuid());
+  }
+  cloud_outdated_ = true;
+  initialized_ = true;
+}
+
+void LandmarkCloud::Update(const fuse_core::Graph& graph,
+                           const bs_common::GraphDelta& delta) {
+  for (const auto& uuid : delta.removed_variables) { RemoveLandmark(uuid); }
+  for (const auto& uuid : delta.added_variables) {
+    UpdateLandmark(graph, uuid);
+  }
+  for (const auto& uuid : delta.changed_variables) {
+    UpdateLandmark(graph, uuid);
+  }
+}
+
+void LandmarkCloud::Update(const fuse_core::Graph& graph,
+                           const fuse_core::Transaction& transaction) {
+  for (const auto& uuid : transaction.removedVariables()) {
+    RemoveLandmark(uuid);
+  }
+  for (const auto& variable : transaction.addedVariables()) {
+    if (variable.type() != k_landmark_type) { continue; }
+    UpdateLandmark(graph, variable.uuid());
+  }
+
+  // the same landmark is usually constrained by several measurements
+  UUIDSet visited;
+  for (const auto& constraint : transaction.addedConstraints()) {
+    for (const auto& uuid : constraint.variables()) {
+      if (visited.insert(uuid).second) { UpdateLandmark(graph, uuid); }
+    }
+  }
+}
+
+const pcl::PointCloud<pcl::PointXYZRGBL>& LandmarkCloud::Cloud() {
+  if (cloud_outdated_) {
+    cloud_.clear();
+    cloud_.reserve(points_.size());
+    for (const auto& [uuid, point] : points_) { cloud_.push_back(point); }
+    cloud_outdated_ = false;
+  }
+  return cloud_;
+}
+
+pcl::PointCloud<pcl::PointXYZRGBL> LandmarkCloud::TakeUpdates() {
+  pcl::PointCloud<pcl::PointXYZRGBL> updates;
+  updates.reserve(updated_.size());
+  for (const auto& uuid : updated_) {
+    const auto iter = points_.find(uuid);
+    if (iter != points_.end()) { updates.push_back(iter->second); }
+  }
+  updated_.clear();
+  return updates;
+}
+
+void LandmarkCloud::Clear() {
+  points_.clear();
+  updated_.clear();
+  cloud_.clear();
+  cloud_outdated_ = false;
+  initialized_ = false;
+}
+
+bool LandmarkCloud::UpdateLandmark(const fuse_core::Graph& graph,
+                                   const fuse_core::UUID& uuid) {
+  if (!graph.variableExists(uuid)) { return false; }
+  const auto landmark = dynamic_cast<const bs_variables::Point3DLandmark*>(
+      &graph.getVariable(uuid));
+  if (!landmark) { return false; }
+  points_[uuid] = ToPoint(*landmark);
+  updated_.insert(uuid);
+  cloud_outdated_ = true;
+  return true;
+}
+
+void LandmarkCloud::RemoveLandmark(const fuse_core::UUID& uuid) {
+  if (points_.erase(uuid) == 0) { return; }
+  updated_.erase(uuid);
+  cloud_outdated_ = true;
+}
+
+} // namespace bs_models::graph_visualization
@@ -88,8 +88,17 @@ void ImuPreintegration::AddToBuffer(const sensor_msgs::Imu& msg) {
 
 void ImuPreintegration::AddToBuffer(const bs_common::IMUData& imu_data) {
   std::unique_lock<std::mutex> lk(preint_mutex_);
-  pre_integrator_ij_.data.emplace(imu_data.t, imu_data);
-  pre_integrator_kj_.data.emplace(imu_data.t, imu_data);
+  pre_integrator_ij_.AddData(imu_data);
+  pre_integrator_kj_.AddData(imu_data);
+
+  // integrate new measurements as they arrive so that only the measurements
+  // since the last cached state need to be integrated for the next factor
+  if (!imu_state_i_.Stamp().isZero()) {
+    pre_integrator_ij_.Integrate(pre_integrator_ij_.Data().Back().t,
+                                 imu_state_i_.GyroBiasVec(),
+                                 imu_state_i_.AccelBiasVec(), true, true,
+                                 false);
+  }
 }
 
 PoseWithCovariance ImuPreintegration::GetPose(const ros::Time& t_now) {
@@ -100,7 +109,7 @@ PoseWithCovariance ImuPreintegration::GetPose(const ros::Time& t_now) {
   }
   std::unique_lock<std::mutex> lk(preint_mutex_);
   // integrate between frames if there is data to integrate
-  if (!pre_integrator_kj_.data.empty()) {
+  if (!pre_integrator_kj_.Data().Empty()) {
     pre_integrator_kj_.Integrate(t_now, imu_state_i_.GyroBiasVec(),
                                  imu_state_i_.AccelBiasVec(), false, true,
                                  false);
@@ -126,17 +135,17 @@ PoseWithCovariance ImuPreintegration::GetPose(const ros::Time& t_now) {
 
 PoseWithCovariance ImuPreintegration::GetRelativeMotion(
     const ros::Time& t1, const ros::Time& t2, Eigen::Vector3d& velocity_t2) {
-  if (pre_integrator_ij_.data.empty()) {
+  if (pre_integrator_ij_.Data().Empty()) {
     throw std::runtime_error{
         "No data in preintegrator, cannot retrieve relative motion."};
   } else if (t1 < imu_state_i_.Stamp()) {
     throw std::runtime_error{
         "Requested time is before current window of measurements."};
-  } else if (t1 > pre_integrator_ij_.data.rbegin()->first) {
+  } else if (t1 > pre_integrator_ij_.Data().Back().t) {
     throw std::runtime_error{
         "Requested start time is after the end of the current window of imu "
         "measurements."};
-  } else if (t2 < pre_integrator_ij_.data.begin()->first) {
+  } else if (t2 < pre_integrator_ij_.Data().Front().t) {
     throw std::runtime_error{
         "Requested end time is before the start of the current window of imu "
         "measurements."};
@@ -145,7 +154,7 @@ PoseWithCovariance ImuPreintegration::GetRelativeMotion(
   }
   std::unique_lock<std::mutex> lk(preint_mutex_);
   // get state at t1
-  bs_common::ImuState imu_state_1;
+  bs_common::CompactImuState imu_state_1;
   if (window_states_.find(t1.toNSec()) == window_states_.end()) {
     pre_integrator_ij_.Integrate(t1, imu_state_i_.GyroBiasVec(),
                                  imu_state_i_.AccelBiasVec(), false, false,
@@ -155,16 +164,26 @@ PoseWithCovariance ImuPreintegration::GetRelativeMotion(
     imu_state_1 = window_states_[t1.toNSec()];
   }
 
-  // copy preintegrator ij
-  bs_common::PreIntegrator pre_integrator = pre_integrator_ij_;
-  pre_integrator.Clear(t1);
-  pre_integrator.Reset();
+  // copy the measurements in [t1, t2] from preintegrator ij, including the
+  // first measurement after t2 so the window ends at the same measurement as
+  // when integrating the full buffer
+  bs_common::PreIntegrator pre_integrator;
+  pre_integrator.cov_w = pre_integrator_ij_.cov_w;
+  pre_integrator.cov_a = pre_integrator_ij_.cov_a;
+  pre_integrator.cov_bg = pre_integrator_ij_.cov_bg;
+  pre_integrator.cov_ba = pre_integrator_ij_.cov_ba;
+  const auto& data = pre_integrator_ij_.Data();
+  for (size_t i = 0; i < data.Size(); i++) {
+    if (data[i].t < t1) { continue; }
+    pre_integrator.AddData(data[i]);
+    if (data[i].t > t2) { break; }
+  }
 
   // integrate to t2
   pre_integrator.Integrate(t2, imu_state_i_.GyroBiasVec(),
                            imu_state_i_.AccelBiasVec(), false, true, false);
   // get state at t2
-  bs_common::ImuState imu_state_2 =
+  bs_common::CompactImuState imu_state_2 =
       PredictState(pre_integrator, imu_state_1, t2);
 
   // store for potential next t1
@@ -206,7 +225,7 @@ void ImuPreintegration::SetStart(
   pre_integrator_kj_.Reset();
 
   // set IMU state
-  bs_common::ImuState imu_state_i(t_start);
+  bs_common::CompactImuState imu_state_i(t_start);
   if (R_WORLD_IMU) { imu_state_i.SetOrientation(R_WORLD_IMU->data()); }
   if (t_WORLD_IMU) { imu_state_i.SetPosition(t_WORLD_IMU->data()); }
   if (velocity) { imu_state_i.SetVelocity(velocity->data()); }
@@ -220,6 +239,13 @@ void ImuPreintegration::SetStart(
 bs_common::ImuState ImuPreintegration::PredictState(
     const bs_common::PreIntegrator& pre_integrator,
     const bs_common::ImuState& imu_state_curr, const ros::Time& t_now) {
+  return bs_common::ImuState(
+      PredictState(pre_integrator, imu_state_curr.Compact(), t_now));
+}
+
+bs_common::CompactImuState ImuPreintegration::PredictState(
+    const bs_common::PreIntegrator& pre_integrator,
+    const bs_common::CompactImuState& imu_state_curr, const ros::Time& t_now) {
   // get commonly used variables
   const double& dt = pre_integrator.delta.t.toSec();
   const Eigen::Matrix3d& q_curr = imu_state_curr.OrientationMat();
@@ -237,9 +263,11 @@ bs_common::ImuState ImuPreintegration::PredictState(
   if (t_now != ros::Time(0)) { t_new = t_now; }
 
   // return predicted IMU state
-  bs_common::ImuState imu_state_new(t_new, q_new, p_new, v_new,
-                                    imu_state_curr.GyroBiasVec(),
-                                    imu_state_curr.AccelBiasVec());
+  bs_common::CompactImuState imu_state_new = imu_state_curr;
+  imu_state_new.stamp = t_new;
+  imu_state_new.SetOrientation(q_new);
+  imu_state_new.SetPosition(p_new);
+  imu_state_new.SetVelocity(v_new);
   return imu_state_new;
 }
 
@@ -249,14 +277,15 @@ fuse_core::Transaction::SharedPtr
         fuse_variables::Orientation3DStamped::SharedPtr R_WORLD_IMU,
         fuse_variables::Position3DStamped::SharedPtr t_WORLD_IMU,
         fuse_variables::VelocityLinear3DStamped::SharedPtr velocity) {
-  bs_constraints::ImuState3DStampedTransaction transaction(t_now);
+  bs_constraints::ImuState3DStampedTransaction transaction(
+      t_now, params_.use_pooled_allocation);
   std::unique_lock<std::mutex> lk(preint_mutex_);
   // check requested time
-  if (pre_integrator_ij_.data.empty()) {
+  if (pre_integrator_ij_.Data().Empty()) {
     ROS_WARN("Cannot register IMU factor, no imu data is available.");
     return nullptr;
   }
-  if (t_now < pre_integrator_ij_.data.begin()->first) {
+  if (t_now < pre_integrator_ij_.Data().Front().t) {
     ROS_WARN(
         "Cannot register IMU factor, requested time is prior to the front "
         "of the window. Request a pose at a timestamp >= the previous call.");
@@ -264,20 +293,11 @@ fuse_core::Transaction::SharedPtr
   }
 
   // generate prior constraint at start
-  if (first_window_ && add_prior_on_first_window_) {
-    Eigen::Matrix<double, 15, 15> prior_covariance =
-        params_.cov_prior_noise * Eigen::Matrix<double, 15, 15>::Identity();
-
-    // Add relative constraints and variables for first key frame
-    transaction.AddPriorImuStateConstraint(imu_state_i_, prior_covariance,
-                                           source_);
-    transaction.AddImuStateVariables(imu_state_i_);
-    first_window_ = false;
-  }
+  AddFirstWindowPrior(transaction);
 
   // if current time is equal to the first imu time, then we can't add a
   // relative constraint
-  if (t_now == pre_integrator_ij_.data.begin()->first) {
+  if (t_now == pre_integrator_ij_.Data().Front().t) {
     return transaction.GetTransaction();
   }
 
@@ -286,14 +306,64 @@ fuse_core::Transaction::SharedPtr
   pre_integrator_ij_.Integrate(t_now, imu_state_i_.GyroBiasVec(),
                                imu_state_i_.AccelBiasVec(), true, true, true);
 
-  // predict state at end of window using integrated imu measurements
-  bs_common::ImuState imu_state_j =
-      PredictState(pre_integrator_ij_, imu_state_i_, t_now);
+  AddRelativeFactor(transaction, t_now, pre_integrator_ij_, R_WORLD_IMU,
+                    t_WORLD_IMU, velocity);
+  return transaction.GetTransaction();
+}
 
-  // Add relative constraints and variables between key frames
-  transaction.AddRelativeImuStateConstraint(
-      imu_state_i_, imu_state_j, pre_integrator_ij_, info_weight_, source_);
-  transaction.AddImuStateVariables(imu_state_j);
+fuse_core::Transaction::SharedPtr
+    ImuPreintegration::RegisterPreintegratedFactor(
+        const ros::Time& t_now, const bs_common::PreIntegrator& pre_integrator,
+        fuse_variables::Orientation3DStamped::SharedPtr R_WORLD_IMU,
+        fuse_variables::Position3DStamped::SharedPtr t_WORLD_IMU,
+        fuse_variables::VelocityLinear3DStamped::SharedPtr velocity) {
+  bs_constraints::ImuState3DStampedTransaction transaction(
+      t_now, params_.use_pooled_allocation);
+  std::unique_lock<std::mutex> lk(preint_mutex_);
+  if (t_now <= imu_state_i_.Stamp()) {
+    ROS_WARN("Cannot register IMU factor, requested time is not after the "
+             "current key frame.");
+    return nullptr;
+  }
+
+  AddFirstWindowPrior(transaction);
+  AddRelativeFactor(transaction, t_now, pre_integrator, R_WORLD_IMU,
+                    t_WORLD_IMU, velocity);
+  return transaction.GetTransaction();
+}
+
+void ImuPreintegration::AddFirstWindowPrior(
+    bs_constraints::ImuState3DStampedTransaction& transaction) {
+  if (!first_window_ || !add_prior_on_first_window_) { return; }
+  Eigen::Matrix<double, 15, 15> prior_covariance =
+      params_.cov_prior_noise * Eigen::Matrix<double, 15, 15>::Identity();
+
+  // Add relative constraints and variables for first key frame
+  const bs_common::ImuState imu_state_i(imu_state_i_);
+  transaction.AddPriorImuStateConstraint(imu_state_i, prior_covariance,
+                                         source_);
+  transaction.AddImuStateVariables(imu_state_i);
+  first_window_ = false;
+}
+
+void ImuPreintegration::AddRelativeFactor(
+    bs_constraints::ImuState3DStampedTransaction& transaction,
+    const ros::Time& t_now, const bs_common::PreIntegrator& pre_integrator,
+    fuse_variables::Orientation3DStamped::SharedPtr R_WORLD_IMU,
+    fuse_variables::Position3DStamped::SharedPtr t_WORLD_IMU,
+    fuse_variables::VelocityLinear3DStamped::SharedPtr velocity) {
+  // predict state at end of window using integrated imu measurements
+  bs_common::CompactImuState imu_state_j =
+      PredictState(pre_integrator, imu_state_i_, t_now);
+
+  // Add relative constraints and variables between key frames, these are the
+  // only variables built for the states
+  const bs_common::ImuState imu_state_i_vars(imu_state_i_);
+  const bs_common::ImuState imu_state_j_vars(imu_state_j);
+  transaction.AddRelativeImuStateConstraint(imu_state_i_vars, imu_state_j_vars,
+                                            pre_integrator, info_weight_,
+                                            source_);
+  transaction.AddImuStateVariables(imu_state_j_vars);
 
   // update orientation, position and velocity of predicted imu state with
   // arguments
@@ -316,14 +386,15 @@ fuse_core::Transaction::SharedPtr
 
   // clear state storage within the window
   window_states_.clear();
-  return transaction.GetTransaction();
 }
 
 void ImuPreintegration::UpdateGraph(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
   std::unique_lock<std::mutex> lk(preint_mutex_);
   // update state i with all info, reset state k to updated state i
-  if (imu_state_i_.Update(graph_msg)) {
+  bs_common::ImuState imu_state_i(imu_state_i_);
+  if (imu_state_i.Update(graph_msg)) {
+    imu_state_i_ = imu_state_i.Compact();
     // reset kj integrator to the ij integrator
     pre_integrator_kj_ = pre_integrator_ij_;
     // reset state k to state i
@@ -335,38 +406,52 @@ void ImuPreintegration::UpdateGraph(
   window_states_.clear();
 }
 
+void ImuPreintegration::UpdateGraph(const bs_common::GraphView& graph_view) {
+  std::unique_lock<std::mutex> lk(preint_mutex_);
+  bs_common::ImuState imu_state_i(imu_state_i_);
+  if (imu_state_i.Update(graph_view)) {
+    imu_state_i_ = imu_state_i.Compact();
+    pre_integrator_kj_ = pre_integrator_ij_;
+    imu_state_k_ = imu_state_i_;
+    bg_ = imu_state_i_.GyroBiasVec();
+    ba_ = imu_state_i_.AccelBiasVec();
+  }
+  window_states_.clear();
+}
+
 void ImuPreintegration::UpdateState(
     const fuse_variables::Position3DStamped position,
     const fuse_variables::Orientation3DStamped orientation,
     const fuse_variables::VelocityLinear3DStamped velocity,
     const bs_variables::GyroscopeBias3DStamped gyro_bias,
     const bs_variables::AccelerationBias3DStamped accel_bias) {
-  imu_state_i_.SetStamp(position.stamp());
-  imu_state_i_.SetPosition(position);
-  imu_state_i_.SetOrientation(orientation);
-  imu_state_i_.SetVelocity(velocity);
-  imu_state_i_.SetGyroBias(gyro_bias);
-  imu_state_i_.SetAccelBias(accel_bias);
+  imu_state_i_.stamp = position.stamp();
+  imu_state_i_.SetPosition(position.data());
+  imu_state_i_.SetOrientation(orientation.data());
+  imu_state_i_.SetVelocity(velocity.data());
+  imu_state_i_.SetGyroBias(gyro_bias.data());
+  imu_state_i_.SetAccelBias(accel_bias.data());
 }
 
 void ImuPreintegration::Clear() {
   std::unique_lock<std::mutex> lk(preint_mutex_);
-  pre_integrator_kj_.data.clear();
+  pre_integrator_kj_.Clear(ros::TIME_MAX);
   pre_integrator_kj_.Reset();
-  pre_integrator_ij_.data.clear();
+  pre_integrator_ij_.Clear(ros::TIME_MAX);
   pre_integrator_ij_.Reset();
 }
 
 std::string ImuPreintegration::PrintBuffer() {
   std::string str;
-  for (const auto& [t, _] : pre_integrator_ij_.data) {
-    str += "IMU time: " + std::to_string(t.toSec()) + "\n";
+  const auto& data = pre_integrator_ij_.Data();
+  for (size_t i = 0; i < data.Size(); i++) {
+    str += "IMU time: " + std::to_string(data[i].t.toSec()) + "\n";
   }
   return str;
 }
 
 size_t ImuPreintegration::CurrentBufferSize() {
-  return pre_integrator_ij_.data.size();
+  return pre_integrator_ij_.Data().Size();
 }
 
 void ImuPreintegration::Reset() {
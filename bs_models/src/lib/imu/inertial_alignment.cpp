@@ -1,13 +1,19 @@
 #include <bs_models/imu/inertial_alignment.h>
 
+#include <beam_utils/time.h>
+
 namespace bs_models { namespace imu {
 void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
-                        const std::list<sensor_msgs::Imu>& imu_buffer,
+                        const bs_common::ImuSampleBuffer& imu_buffer,
                         const bs_models::ImuPreintegration::Params& params,
                         Eigen::Vector3d& gravity, Eigen::Vector3d& bg,
                         Eigen::Vector3d& ba,
                         std::map<uint64_t, Eigen::Vector3d>& velocities,
-                        double& scale) {
+                        double& scale, AlignmentMethod method,
+                        AlignmentSummary& summary) {
+  summary = AlignmentSummary();
+  summary.method = method;
+
   // set parameter estimates to 0
   gravity = Eigen::Vector3d::Zero();
   bg = Eigen::Vector3d::Zero();
@@ -16,12 +22,9 @@ void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
   velocities.clear();
   std::vector<std::pair<uint64_t, Eigen::Vector3d>> velocities_vec;
 
-  // make copy of imu buffer
-  std::list<sensor_msgs::Imu> imu_buffer_copy = imu_buffer;
-
   // check for invalid input
-  auto second_imu_msg = std::next(imu_buffer_copy.begin());
-  if (path.begin()->first < second_imu_msg->header.stamp.toNSec()) {
+  if (imu_buffer.Size() < 2 ||
+      path.begin()->first < imu_buffer[1].stamp.toNSec()) {
     const std::string msg =
         std::string(__func__) +
         ": Pose in path has less than 2 messages prior to it.";
@@ -31,6 +34,7 @@ void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
 
   // build set of imu frames
   std::vector<bs_common::ImuState> imu_frames;
+  size_t imu_index = 0;
   for (auto& [time_nsec, T_WORLD_BASELINK] : path) {
     const auto stamp = beam::NSecToRos(time_nsec);
 
@@ -40,14 +44,13 @@ void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
     preintegrator.cov_a = params.cov_accel_noise;
     preintegrator.cov_bg = params.cov_gyro_bias;
     preintegrator.cov_ba = params.cov_accel_bias;
-    while (imu_buffer_copy.front().header.stamp < stamp &&
-           !imu_buffer_copy.empty()) {
-      preintegrator.data.emplace(imu_buffer_copy.front().header.stamp,
-                                 imu_buffer_copy.front());
-      imu_buffer_copy.pop_front();
+    while (imu_index < imu_buffer.Size() &&
+           imu_buffer[imu_index].stamp < stamp) {
+      preintegrator.AddData(imu_buffer[imu_index].ToIMUData());
+      imu_index++;
     }
 
-    if (preintegrator.data.empty()) {
+    if (preintegrator.Data().Empty()) {
       const std::string msg = std::string(__func__) +
                               ": Empty preintegrator for pose in init path.";
       ROS_ERROR_STREAM(msg);
@@ -65,6 +68,7 @@ void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
   }
 
   const int N = imu_frames.size();
+  summary.num_frames = N;
 
   // initialize velocities as 0 and reserve memory
   velocities_vec.resize(N, {0, Eigen::Vector3d::Zero()});
@@ -87,15 +91,27 @@ void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
     return;
   }
 
+  beam::HighResolutionTimer timer;
   std::for_each(imu_frames.begin(), imu_frames.end(), integrate);
   EstimateGyroBias(imu_frames, bg);
 
   std::for_each(imu_frames.begin(), imu_frames.end(), integrate);
-  EstimateGravityScaleVelocities(imu_frames, gravity, scale, velocities_vec);
+  if (method == AlignmentMethod::CLOSED_FORM) {
+    EstimateGravityScaleVelocitiesClosedForm(imu_frames, gravity, scale,
+                                             velocities_vec, summary);
+  } else {
+    EstimateGravityScaleVelocities(imu_frames, gravity, scale, velocities_vec,
+                                   summary);
+  }
+  summary.solve_time_s = timer.elapsed();
 
   // std::for_each(imu_frames.begin(), imu_frames.end(), integrate);
   // RefineGravityScaleVelocities(imu_frames, gravity, scale, velocities_vec);
 
+  ComputeAlignmentResiduals(imu_frames, gravity, scale, velocities_vec,
+                            summary);
+  summary.success = true;
+
   // convert velocities to map
   std::for_each(
       velocities_vec.begin(), velocities_vec.end(),
@@ -107,7 +123,10 @@ void EstimateParameters(const std::map<uint64_t, Eigen::Matrix4d>& path,
        "\n \tScale: " << scale <<  
        "\n \tGravity: [" << gravity.x() << ", " << gravity.y() << ", " << gravity.z() << "]" 
        "\n \tGyro Bias: [" << bg.x() << ", " << bg.y() << ", " << bg.z() << "]" 
-       "\n\tAccel Bias: [" << ba.x() << ", " << ba.y() << ", " << ba.z() << "]" );
+       "\n\tAccel Bias: [" << ba.x() << ", " << ba.y() << ", " << ba.z() << "]" 
+       "\n\tSolve Time: " << summary.solve_time_s << "s" <<
+       "\n\tRMS Position Residual: " << summary.rms_position_residual << "m" <<
+       "\n\tRMS Velocity Residual: " << summary.rms_velocity_residual << "m/s");
   // clang-format on
 }
 
@@ -163,7 +182,8 @@ void EstimateGyroBias(const std::vector<bs_common::ImuState>& imu_frames,
 void EstimateGravityScaleVelocities(
     const std::vector<bs_common::ImuState>& imu_frames,
     Eigen::Vector3d& gravity, double& scale,
-    std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities) {
+    std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities,
+    AlignmentSummary& summary) {
   const int N = imu_frames.size();
 
   Eigen::MatrixXd A;
@@ -194,6 +214,7 @@ void EstimateGravityScaleVelocities(
   }
 
   Eigen::VectorXd x = A.fullPivHouseholderQr().solve(b);
+  summary.unconstrained_gravity_norm = x.segment<3>(0).norm();
   gravity = x.segment<3>(0).normalized() * GRAVITY_NOMINAL;
   scale = x(3);
   for (size_t i = 0; i < N; ++i) {
@@ -201,6 +222,84 @@ void EstimateGravityScaleVelocities(
   }
 }
 
+void EstimateGravityScaleVelocitiesClosedForm(
+    const std::vector<bs_common::ImuState>& imu_frames,
+    Eigen::Vector3d& gravity, double& scale,
+    std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities,
+    AlignmentSummary& summary, int max_iterations) {
+  const int N = imu_frames.size();
+
+  // Each position delta gives 3 rows of A * [g; s; v_0] = b, with v_i
+  // expressed using the velocity deltas integrated up to frame i:
+  //   (-0.5 * dt^2 - dt * T_i) * g + s * (p_j - p_i) - dt * v_0
+  //     = R_i * dp + dt * c_i
+  // These are stored so the refinement doesn't need to revisit the frames
+  std::vector<double> a_g(N - 1);
+  std::vector<double> dts(N - 1);
+  std::vector<Eigen::Vector3d> dps(N - 1);
+  std::vector<Eigen::Vector3d> rhs(N - 1);
+  std::vector<Eigen::Vector3d> c(N, Eigen::Vector3d::Zero());
+  std::vector<double> T(N, 0);
+
+  Eigen::Matrix<double, 7, 7> H = Eigen::Matrix<double, 7, 7>::Zero();
+  Eigen::Matrix<double, 7, 1> b = Eigen::Matrix<double, 7, 1>::Zero();
+  for (size_t j = 1; j < N; ++j) {
+    const size_t i = j - 1;
+    const bs_common::Delta& delta = imu_frames[j].GetPreintegratorConst().delta;
+    const double dt = delta.t.toSec();
+    const Eigen::Matrix3d R_i =
+        imu_frames[i].OrientationQuat().toRotationMatrix();
+
+    a_g[i] = -0.5 * dt * dt - dt * T[i];
+    dts[i] = dt;
+    dps[i] = imu_frames[j].PositionVec() - imu_frames[i].PositionVec();
+    rhs[i] = R_i * delta.p + dt * c[i];
+    T[j] = T[i] + dt;
+    c[j] = c[i] + R_i * delta.v;
+
+    Eigen::Matrix<double, 3, 7> A;
+    A.block<3, 3>(0, 0) = a_g[i] * Eigen::Matrix3d::Identity();
+    A.block<3, 1>(0, 3) = dps[i];
+    A.block<3, 3>(0, 4) = -dt * Eigen::Matrix3d::Identity();
+    H.noalias() += A.transpose() * A;
+    b.noalias() += A.transpose() * rhs[i];
+  }
+
+  const Eigen::Matrix<double, 7, 1> x = H.llt().solve(b);
+  summary.unconstrained_gravity_norm = x.head<3>().norm();
+  gravity = x.head<3>().normalized() * GRAVITY_NOMINAL;
+  scale = x(3);
+  Eigen::Vector3d v_0 = x.tail<3>();
+
+  // gauss-newton on [dtheta; s; v_0], with g = |g| * normalize(g + Tg *
+  // dtheta). The residual is linear in s and v_0, so each step solves for
+  // them directly
+  summary.refinement_iterations = 0;
+  for (int iter = 0; iter < max_iterations; ++iter) {
+    const Eigen::Matrix<double, 3, 2> Tg = beam::S2TangentialBasis(gravity);
+    Eigen::Matrix<double, 6, 6> H_r = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> g_r = Eigen::Matrix<double, 6, 1>::Zero();
+    for (size_t i = 0; i < N - 1; ++i) {
+      Eigen::Matrix<double, 3, 6> A;
+      A.block<3, 2>(0, 0) = a_g[i] * Tg;
+      A.block<3, 1>(0, 2) = dps[i];
+      A.block<3, 3>(0, 3) = -dts[i] * Eigen::Matrix3d::Identity();
+      H_r.noalias() += A.transpose() * A;
+      g_r.noalias() += A.transpose() * (rhs[i] - a_g[i] * gravity);
+    }
+    const Eigen::Matrix<double, 6, 1> dx = H_r.llt().solve(g_r);
+    gravity = (gravity + Tg * dx.head<2>()).normalized() * GRAVITY_NOMINAL;
+    scale = dx(2);
+    v_0 = dx.tail<3>();
+    summary.refinement_iterations++;
+    if (dx.head<2>().norm() < 1e-6 * GRAVITY_NOMINAL) { break; }
+  }
+
+  for (size_t i = 0; i < N; ++i) {
+    velocities[i].second = v_0 + T[i] * gravity + c[i];
+  }
+}
+
 void RefineGravityScaleVelocities(
     const std::vector<bs_common::ImuState>& imu_frames,
     Eigen::Vector3d& gravity, double& scale,
@@ -246,4 +345,30 @@ void RefineGravityScaleVelocities(
   }
 }
 
+void ComputeAlignmentResiduals(
+    const std::vector<bs_common::ImuState>& imu_frames,
+    const Eigen::Vector3d& gravity, double scale,
+    const std::vector<std::pair<uint64_t, Eigen::Vector3d>>& velocities,
+    AlignmentSummary& summary) {
+  const int N = imu_frames.size();
+  double sum_p = 0;
+  double sum_v = 0;
+  for (size_t j = 1; j < N; ++j) {
+    const size_t i = j - 1;
+    const bs_common::Delta& delta = imu_frames[j].GetPreintegratorConst().delta;
+    const double dt = delta.t.toSec();
+    const Eigen::Quaterniond& q_i = imu_frames[i].OrientationQuat();
+    const Eigen::Vector3d& v_i = velocities[i].second;
+    const Eigen::Vector3d& v_j = velocities[j].second;
+    const Eigen::Vector3d r_p =
+        scale * (imu_frames[j].PositionVec() - imu_frames[i].PositionVec()) -
+        dt * v_i - 0.5 * dt * dt * gravity - q_i * delta.p;
+    const Eigen::Vector3d r_v = v_j - v_i - dt * gravity - q_i * delta.v;
+    sum_p += r_p.squaredNorm();
+    sum_v += r_v.squaredNorm();
+  }
+  summary.rms_position_residual = N > 1 ? std::sqrt(sum_p / (N - 1)) : 0;
+  summary.rms_velocity_residual = N > 1 ? std::sqrt(sum_v / (N - 1)) : 0;
+}
+
 }} // namespace bs_models::imu
\ No newline at end of file
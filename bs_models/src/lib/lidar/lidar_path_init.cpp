@@ -18,7 +18,7 @@ using namespace beam_matching;
 
 LidarPathInit::LidarPathInit(int lidar_buffer_size,
                              const std::string& matcher_config,
-                             double information_weight)
+                             double information_weight, int num_threads)
     : lidar_buffer_size_(lidar_buffer_size) {
   // init scan registration
   std::shared_ptr<LoamParams> matcher_params;
@@ -55,7 +55,12 @@ LidarPathInit::LidarPathInit(int lidar_buffer_size,
       std::make_unique<scan_registration::ScanToMapLoamRegistration>(
           std::move(matcher), reg_params.GetBaseParams(), reg_params.map_size);
   scan_registration_->SetInformationWeight(information_weight);
-  feature_extractor_ = std::make_shared<LoamFeatureExtractor>(matcher_params);
+  matcher_params_ = matcher_params;
+  feature_extractors_.push_back(
+      std::make_shared<LoamFeatureExtractor>(matcher_params));
+  if (num_threads > 1) {
+    prepare_pool_ = std::make_unique<bs_common::ThreadPool>(num_threads);
+  }
 
   // get filter params
   nlohmann::json J;
@@ -71,8 +76,10 @@ LidarPathInit::LidarPathInit(int lidar_buffer_size,
 
   beam::ValidateJsonKeysOrThrow({"filters"}, J);
   nlohmann::json J_filters = J["filters"];
-  input_filter_params_ = beam_filtering::LoadFilterParamsVector(J_filters);
-  BEAM_INFO("Loaded {} input filters", input_filter_params_.size());
+  const auto input_filter_params =
+      beam_filtering::LoadFilterParamsVector(J_filters);
+  input_filters_ = FilterPipeline<pcl::PointXYZ>(input_filter_params);
+  BEAM_INFO("Loaded {} input filters", input_filter_params.size());
 }
 
 void LidarPathInit::ProcessLidar(
@@ -81,20 +88,73 @@ void LidarPathInit::ProcessLidar(
 
   if (!InitExtrinsics(msg->header.stamp)) { return; }
 
+  if (prepare_pool_ == nullptr) {
+    ScanData scan = PrepareScan(msg);
+    RegisterScan(scan);
+    return;
+  }
+
+  PendingScan pending;
+  pending.scan = std::make_shared<ScanData>();
+  pending.ready = prepare_pool_->Enqueue(
+      [this, scan = pending.scan, msg]() { *scan = PrepareScan(msg); });
+  pending_scans_.push_back(std::move(pending));
+  RegisterPendingScans(prepare_pool_->NumThreads());
+}
+
+void LidarPathInit::RegisterPendingScans(size_t max_pending) {
+  while (!pending_scans_.empty()) {
+    if (pending_scans_.size() <= max_pending &&
+        pending_scans_.front().ready.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      return;
+    }
+    PendingScan pending = std::move(pending_scans_.front());
+    pending_scans_.pop_front();
+    pending.ready.get();
+    RegisterScan(*pending.scan);
+  }
+}
+
+LidarPathInit::ScanData
+    LidarPathInit::PrepareScan(const sensor_msgs::PointCloud2::ConstPtr& msg) {
   beam::HighResolutionTimer timer;
-  PointCloud cloud_current = beam::ROSToPCL(*msg);
+  ScanData scan;
+  scan.stamp = msg->header.stamp;
+  scan.cloud = beam::ROSToPCL(*msg);
+  input_filters_.Filter(scan.cloud, scan.cloud);
+
+  const auto feature_extractor = AcquireFeatureExtractor();
+  scan.loam_cloud = feature_extractor->ExtractFeatures(scan.cloud);
+  ReleaseFeatureExtractor(feature_extractor);
+  ROS_DEBUG("Time to prepare scan: %.5f", timer.elapsed());
+  return scan;
+}
+
+std::shared_ptr<LoamFeatureExtractor> LidarPathInit::AcquireFeatureExtractor() {
+  std::lock_guard<std::mutex> lock(feature_extractors_mutex_);
+  if (feature_extractors_.empty()) {
+    return std::make_shared<LoamFeatureExtractor>(matcher_params_);
+  }
+  auto feature_extractor = feature_extractors_.back();
+  feature_extractors_.pop_back();
+  return feature_extractor;
+}
 
-  PointCloud cloud_filtered = beam_filtering::FilterPointCloud<pcl::PointXYZ>(
-      cloud_current, input_filter_params_);
+void LidarPathInit::ReleaseFeatureExtractor(
+    const std::shared_ptr<LoamFeatureExtractor>& feature_extractor) {
+  std::lock_guard<std::mutex> lock(feature_extractors_mutex_);
+  feature_extractors_.push_back(feature_extractor);
+}
 
-  Eigen::Matrix4d T_WORLD_BASELINK_EST =
-      Get_T_WORLD_BASELINKEST(msg->header.stamp);
+void LidarPathInit::RegisterScan(ScanData& scan) {
+  beam::HighResolutionTimer timer;
+  Eigen::Matrix4d T_WORLD_BASELINK_EST = Get_T_WORLD_BASELINKEST(scan.stamp);
 
   // create scan pose
-  ScanPose current_scan_pose(cloud_filtered, msg->header.stamp,
-                             T_WORLD_BASELINK_EST, T_BASELINK_LIDAR_,
-                             feature_extractor_);
-  ROS_DEBUG("Time to build scan pose: %.5f", timer.elapsedAndRestart());
+  ScanPose current_scan_pose(std::move(scan.cloud), scan.stamp,
+                             T_WORLD_BASELINK_EST, T_BASELINK_LIDAR_);
+  current_scan_pose.AddPointCloud(std::move(scan.loam_cloud), true);
   bs_constraints::Pose3DStampedTransaction transaction =
       scan_registration_->RegisterNewScan(current_scan_pose);
   registration_times_.insert(timer.elapsed());
@@ -379,6 +439,9 @@ double LidarPathInit::GetMedianRegistrationTimeInS() {
 }
 
 void LidarPathInit::Reset() {
+  // scans still being prepared reference this object, so wait for them
+  for (auto& pending : pending_scans_) { pending.ready.wait(); }
+  pending_scans_.clear();
   keyframes_.clear();
   keyframe_transactions_.clear();
   registration_times_.clear();
@@ -0,0 +1,82 @@
+#include <bs_models/lidar/loam_feature_budget.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <ros/console.h>
+
+namespace bs_models {
+
+LoamFeatureBudget::LoamFeatureBudget(const Params& params) : params_(params) {
+  if (params_.num_buckets < 1) {
+    ROS_ERROR("Feature budget must have at least one bucket.");
+    throw std::invalid_argument{"invalid feature budget buckets"};
+  }
+}
+
+void LoamFeatureBudget::Apply(beam_matching::LoamPointCloud& features) const {
+  if (params_.max_edges > 0) {
+    features.edges.strong.cloud =
+        Select(features.edges.strong.cloud, params_.max_edges);
+  }
+  if (params_.max_surfaces > 0) {
+    features.surfaces.strong.cloud =
+        Select(features.surfaces.strong.cloud, params_.max_surfaces);
+  }
+}
+
+PointCloud LoamFeatureBudget::Select(const PointCloud& cloud,
+                                     size_t budget) const {
+  if (cloud.size() <= budget) { return cloud; }
+
+  // split the points into azimuth buckets, with their scores
+  const size_t num_buckets = static_cast<size_t>(params_.num_buckets);
+  std::vector<std::vector<uint32_t>> buckets(num_buckets);
+  std::vector<float> scores(cloud.size());
+  const float max_range = params_.max_informative_range_m;
+  for (size_t i = 0; i < cloud.size(); i++) {
+    const pcl::PointXYZ& p = cloud[i];
+    const double azimuth = std::atan2(p.y, p.x);
+    const size_t bucket = std::min(
+        num_buckets - 1,
+        static_cast<size_t>((azimuth + M_PI) / (2 * M_PI) * num_buckets));
+    buckets[bucket].push_back(i);
+    scores[i] = std::min(p.getVector3fMap().norm(), max_range);
+  }
+
+  // share the budget from the smallest bucket up, so the share of buckets
+  // that cannot use it goes to the larger ones
+  std::vector<size_t> order(num_buckets);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buckets[a].size() < buckets[b].size();
+  });
+  std::vector<uint32_t> selected;
+  selected.reserve(budget);
+  size_t remaining = budget;
+  for (size_t i = 0; i < num_buckets; i++) {
+    std::vector<uint32_t>& bucket = buckets[order[i]];
+    const size_t share =
+        std::min(bucket.size(), remaining / (num_buckets - i));
+    remaining -= share;
+    if (share < bucket.size()) {
+      std::nth_element(bucket.begin(), bucket.begin() + share, bucket.end(),
+                       [&](uint32_t a, uint32_t b) {
+                         return scores[a] > scores[b] ||
+                                (scores[a] == scores[b] && a < b);
+                       });
+    }
+    selected.insert(selected.end(), bucket.begin(), bucket.begin() + share);
+  }
+
+  std::sort(selected.begin(), selected.end());
+  PointCloud output;
+  output.reserve(selected.size());
+  for (const uint32_t i : selected) { output.push_back(cloud[i]); }
+  return output;
+}
+
+} // namespace bs_models
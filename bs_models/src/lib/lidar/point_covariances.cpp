@@ -0,0 +1,162 @@
+#include <bs_models/lidar/point_covariances.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/chunk_file.h>
+
+namespace bs_models {
+
+namespace {
+
+// file version, increase if the format changes
+constexpr uint32_t kCovariancesVersion = 1;
+
+// upper triangle of the covariance then the normal
+constexpr size_t kFloatsPerPoint = 9;
+
+// regularized covariance and normal of a point from its n neighbours
+bool ComputePointCovariance(const PointCloud& cloud, const int* indices, int n,
+                            float epsilon, Eigen::Matrix3f& covariance,
+                            Eigen::Vector3f& normal) {
+  if (n < 3) { return false; }
+  Eigen::Vector3f mean = Eigen::Vector3f::Zero();
+  for (int j = 0; j < n; j++) { mean += cloud[indices[j]].getVector3fMap(); }
+  mean /= static_cast<float>(n);
+  Eigen::Matrix3f sample_covariance = Eigen::Matrix3f::Zero();
+  for (int j = 0; j < n; j++) {
+    const Eigen::Vector3f d = cloud[indices[j]].getVector3fMap() - mean;
+    sample_covariance += d * d.transpose();
+  }
+  sample_covariance /= static_cast<float>(n);
+
+  // eigenvalues are in increasing order
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver;
+  solver.computeDirect(sample_covariance);
+  const Eigen::Matrix3f& V = solver.eigenvectors();
+  covariance = V * Eigen::Vector3f(epsilon, 1, 1).asDiagonal() * V.transpose();
+  normal = V.col(0);
+  return true;
+}
+
+bool IsFinite(const pcl::PointXYZ& p) {
+  return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+} // namespace
+
+void ComputePointCovariances(const PointCloud& cloud, int k,
+                             PointCovariances& covariances, float epsilon) {
+  covariances.k = k;
+  covariances.covariances.assign(cloud.size(), Eigen::Matrix3f::Identity());
+  covariances.normals.assign(cloud.size(), Eigen::Vector3f::Zero());
+  if (cloud.size() < 3 || k < 3) { return; }
+
+  // the kd-tree skips non finite points, so it needs a copy of the cloud that
+  // keeps the indices of the input
+  auto points = std::make_shared<PointCloud>(cloud);
+  pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
+  kdtree.setInputCloud(points);
+
+  std::vector<int> indices;
+  std::vector<float> distances;
+  for (size_t i = 0; i < cloud.size(); i++) {
+    const pcl::PointXYZ& p = cloud[i];
+    if (!IsFinite(p)) { continue; }
+    const int n = kdtree.nearestKSearch(p, k, indices, distances);
+    ComputePointCovariance(cloud, indices.data(), n, epsilon,
+                           covariances.covariances[i], covariances.normals[i]);
+  }
+}
+
+void ComputePointCovariances(const PointCloud& cloud,
+                             const std::vector<int>& neighbours, int k,
+                             PointCovariances& covariances, float epsilon) {
+  covariances.k = k;
+  covariances.covariances.assign(cloud.size(), Eigen::Matrix3f::Identity());
+  covariances.normals.assign(cloud.size(), Eigen::Vector3f::Zero());
+  if (k < 3 || neighbours.size() != cloud.size() * k) { return; }
+
+  for (size_t i = 0; i < cloud.size(); i++) {
+    if (!IsFinite(cloud[i])) { continue; }
+    const int* indices = neighbours.data() + i * k;
+    const int n = std::find(indices, indices + k, -1) - indices;
+    ComputePointCovariance(cloud, indices, n, epsilon,
+                           covariances.covariances[i], covariances.normals[i]);
+  }
+}
+
+bool SavePointCovariances(const std::string& filename,
+                          const PointCovariances& covariances) {
+  std::vector<float> values;
+  values.reserve(covariances.Size() * kFloatsPerPoint);
+  for (size_t i = 0; i < covariances.Size(); i++) {
+    const Eigen::Matrix3f& c = covariances.covariances[i];
+    const Eigen::Vector3f& n = covariances.normals[i];
+    values.insert(values.end(), {c(0, 0), c(0, 1), c(0, 2), c(1, 1), c(1, 2),
+                                 c(2, 2), n[0], n[1], n[2]});
+  }
+
+  bs_common::ByteWriter writer;
+  writer.Write<uint32_t>(kCovariancesVersion);
+  writer.Write<int32_t>(covariances.k);
+  writer.WriteVector(values);
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(writer.Data().data()),
+             writer.Size());
+  if (!file) {
+    BEAM_ERROR("Unable to write point covariances to: {}", filename);
+    return false;
+  }
+  return true;
+}
+
+bool LoadPointCovariances(const std::string& filename,
+                          PointCovariances& covariances) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    BEAM_ERROR("Unable to open point covariances file: {}", filename);
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+
+  std::vector<float> values;
+  try {
+    bs_common::ByteReader reader(data.data(), data.size());
+    if (reader.Read<uint32_t>() != kCovariancesVersion) {
+      BEAM_ERROR("Unsupported point covariances file version: {}", filename);
+      return false;
+    }
+    covariances.k = reader.Read<int32_t>();
+    reader.ReadVector(values);
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Cannot read point covariances file {}: {}", filename, e.what());
+    return false;
+  }
+  if (values.size() % kFloatsPerPoint != 0) {
+    BEAM_ERROR("Invalid point covariances file: {}", filename);
+    return false;
+  }
+
+  const size_t size = values.size() / kFloatsPerPoint;
+  covariances.covariances.resize(size);
+  covariances.normals.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    const float* v = &values[i * kFloatsPerPoint];
+    Eigen::Matrix3f& c = covariances.covariances[i];
+    c << v[0], v[1], v[2], v[1], v[3], v[4], v[2], v[4], v[5];
+    covariances.normals[i] = Eigen::Vector3f(v[6], v[7], v[8]);
+  }
+  return true;
+}
+
+} // namespace bs_models
@@ -0,0 +1,52 @@
+#include <bs_models/lidar/range_image.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace bs_models {
+
+RangeImage::RangeImage(size_t num_rings, size_t num_columns) {
+  Reset(num_rings, num_columns);
+}
+
+void RangeImage::Reset(size_t num_rings, size_t num_columns) {
+  num_rings_ = num_rings;
+  num_columns_ = std::max<size_t>(num_columns, 1);
+  num_valid_ = 0;
+  const size_t size = num_rings_ * num_columns_;
+  x_.assign(size, 0);
+  y_.assign(size, 0);
+  z_.assign(size, 0);
+  range_.assign(size, 0);
+  intensity_.assign(size, 0);
+  time_.assign(size, 0);
+  source_.assign(size, INVALID);
+}
+
+size_t RangeImage::ColumnOf(float x, float y) const {
+  const double azimuth = std::atan2(static_cast<double>(y), x);
+  const size_t column = static_cast<size_t>((azimuth + M_PI) / (2 * M_PI) *
+                                            static_cast<double>(num_columns_));
+  // azimuth pi is the same as -pi
+  return column >= num_columns_ ? 0 : column;
+}
+
+void RangeImage::Set(size_t ring, size_t column, size_t source_index, float x,
+                     float y, float z, float intensity, float time) {
+  const size_t index = ring * num_columns_ + column;
+  const float range = std::sqrt(x * x + y * y + z * z);
+  if (Valid(index)) {
+    if (range >= range_[index]) { return; }
+  } else {
+    num_valid_++;
+  }
+  x_[index] = x;
+  y_[index] = y;
+  z_[index] = z;
+  range_[index] = range;
+  intensity_[index] = intensity;
+  time_[index] = time;
+  source_[index] = static_cast<uint32_t>(source_index);
+}
+
+} // namespace bs_models
@@ -0,0 +1,244 @@
+#include <bs_models/lidar/ring_feature_extractor.h>
+
+#include <cmath>
+
+#include <pcl/filters/voxel_grid.h>
+
+namespace bs_models {
+
+namespace {
+
+float SquaredDiff(const std::vector<float>& x, const std::vector<float>& y,
+                  const std::vector<float>& z, size_t i, size_t j,
+                  float weight_j = 1) {
+  const float dx = x[i] - weight_j * x[j];
+  const float dy = y[i] - weight_j * y[j];
+  const float dz = z[i] - weight_j * z[j];
+  return dx * dx + dy * dy + dz * dz;
+}
+
+} // namespace
+
+void RingFeatureExtractor::Ring::Clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+}
+
+void RingFeatureExtractor::Ring::Add(float px, float py, float pz) {
+  x.push_back(px);
+  y.push_back(py);
+  z.push_back(pz);
+}
+
+RingFeatureExtractor::RingFeatureExtractor(
+    const std::shared_ptr<beam_matching::LoamParams>& params, int num_threads)
+    : params_(params), num_threads_(std::max(num_threads, 1)) {}
+
+beam_matching::LoamPointCloud
+    RingFeatureExtractor::ExtractFeatures(const RangeImage& image) {
+  const size_t num_rings = image.NumRings();
+  if (rings_.size() < num_rings) { rings_.resize(num_rings); }
+  // rows are contiguous, so rings are filled with sequential reads
+  const float* x = image.XData();
+  const float* y = image.YData();
+  const float* z = image.ZData();
+  for (size_t r = 0; r < num_rings; r++) {
+    Ring& ring = rings_[r];
+    ring.Clear();
+    const size_t begin = r * image.NumColumns();
+    const size_t end = begin + image.NumColumns();
+    for (size_t i = begin; i < end; i++) {
+      if (image.Valid(i)) { ring.Add(x[i], y[i], z[i]); }
+    }
+  }
+  return ExtractFeaturesFromRings(num_rings);
+}
+
+beam_matching::LoamPointCloud
+    RingFeatureExtractor::ExtractFeaturesFromRings(size_t num_rings) {
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, num_rings,
+      [this](size_t i) { ExtractRingFeatures(rings_[i]); }, num_threads_);
+
+  // merge in ring order so the result does not depend on the scheduling
+  beam_matching::LoamPointCloud features;
+  for (size_t i = 0; i < num_rings; i++) {
+    const Ring& ring = rings_[i];
+    features.edges.strong.cloud += ring.edges_strong;
+    features.edges.weak.cloud += ring.edges_weak;
+    features.surfaces.strong.cloud += ring.surfaces_strong;
+    features.surfaces.weak.cloud += ring.surfaces_weak;
+  }
+  return features;
+}
+
+void RingFeatureExtractor::ExtractRingFeatures(Ring& ring) const {
+  ring.edges_strong.clear();
+  ring.edges_weak.clear();
+  ring.surfaces_strong.clear();
+  ring.surfaces_weak.clear();
+
+  const int region = params_->curvature_region;
+  const size_t n = ring.Size();
+  if (region < 1 || n < 2 * static_cast<size_t>(region) + 2) { return; }
+
+  // curvature of point i is the squared norm of the sum of the differences to
+  // its 2 * region neighbours, i.e. |window sum - (2 * region + 1) * p_i|^2.
+  // Window sums are taken from prefix sums, which keeps this loop branch free.
+  ring.prefix_x.resize(n + 1);
+  ring.prefix_y.resize(n + 1);
+  ring.prefix_z.resize(n + 1);
+  ring.prefix_x[0] = 0;
+  ring.prefix_y[0] = 0;
+  ring.prefix_z[0] = 0;
+  for (size_t i = 0; i < n; i++) {
+    ring.prefix_x[i + 1] = ring.prefix_x[i] + ring.x[i];
+    ring.prefix_y[i + 1] = ring.prefix_y[i] + ring.y[i];
+    ring.prefix_z[i + 1] = ring.prefix_z[i] + ring.z[i];
+  }
+  ring.curvature.assign(n, 0);
+  const double window_size = 2 * region + 1;
+  for (size_t i = region; i < n - region; i++) {
+    const double dx = ring.prefix_x[i + region + 1] -
+                      ring.prefix_x[i - region] - window_size * ring.x[i];
+    const double dy = ring.prefix_y[i + region + 1] -
+                      ring.prefix_y[i - region] - window_size * ring.y[i];
+    const double dz = ring.prefix_z[i + region + 1] -
+                      ring.prefix_z[i - region] - window_size * ring.z[i];
+    ring.curvature[i] = static_cast<float>(dx * dx + dy * dy + dz * dz);
+  }
+
+  ring.picked.assign(n, 0);
+  ring.is_edge.assign(n, 0);
+  MarkUnreliablePoints(ring);
+
+  PointCloud::Ptr less_flat = std::make_shared<PointCloud>();
+  const int num_regions = params_->n_feature_regions;
+  const float threshold = params_->surface_curvature_threshold;
+  const size_t first = region;
+  const size_t last = n - 1 - region;
+  for (int j = 0; j < num_regions; j++) {
+    const size_t start =
+        (first * (num_regions - j) + last * j) / num_regions;
+    const size_t end =
+        (first * (num_regions - 1 - j) + last * (j + 1)) / num_regions;
+    if (end == 0 || end - 1 <= start) { continue; }
+
+    // [start, end) sorted by increasing curvature, ties keep the scan order
+    ring.region_indices.resize(end - start);
+    for (size_t i = start; i < end; i++) {
+      ring.region_indices[i - start] = i;
+    }
+    std::stable_sort(ring.region_indices.begin(), ring.region_indices.end(),
+                     [&ring](size_t a, size_t b) {
+                       return ring.curvature[a] < ring.curvature[b];
+                     });
+
+    // edges, starting from the largest curvature
+    int num_edges{0};
+    for (auto iter = ring.region_indices.rbegin();
+         iter != ring.region_indices.rend() &&
+         num_edges < params_->max_corner_less_sharp;
+         iter++) {
+      const size_t i = *iter;
+      if (ring.picked[i] || ring.curvature[i] <= threshold) { continue; }
+      num_edges++;
+      if (num_edges <= params_->max_corner_sharp) {
+        ring.edges_strong.push_back(ring.Point(i));
+      }
+      ring.edges_weak.push_back(ring.Point(i));
+      ring.is_edge[i] = 1;
+      MarkAsPicked(ring, i);
+    }
+
+    // surfaces, starting from the smallest curvature
+    int num_surfaces{0};
+    for (auto iter = ring.region_indices.begin();
+         iter != ring.region_indices.end() &&
+         num_surfaces < params_->max_surface_flat;
+         iter++) {
+      const size_t i = *iter;
+      if (ring.picked[i] || ring.curvature[i] >= threshold) { continue; }
+      num_surfaces++;
+      ring.surfaces_strong.push_back(ring.Point(i));
+      MarkAsPicked(ring, i);
+    }
+
+    // every other point of the region is a weak surface
+    for (size_t i = start; i < end; i++) {
+      if (!ring.is_edge[i]) { less_flat->push_back(ring.Point(i)); }
+    }
+  }
+
+  if (params_->less_flat_filter_size <= 0) {
+    ring.surfaces_weak = *less_flat;
+    return;
+  }
+  const float leaf = params_->less_flat_filter_size;
+  pcl::VoxelGrid<pcl::PointXYZ> voxel_filter;
+  voxel_filter.setInputCloud(less_flat);
+  voxel_filter.setLeafSize(leaf, leaf, leaf);
+  voxel_filter.filter(ring.surfaces_weak);
+}
+
+void RingFeatureExtractor::MarkUnreliablePoints(Ring& ring) const {
+  const size_t region = params_->curvature_region;
+  const size_t n = ring.Size();
+  for (size_t i = region; i < n - region - 1; i++) {
+    const float diff_next = SquaredDiff(ring.x, ring.y, ring.z, i + 1, i);
+    if (diff_next > 0.1) {
+      // occluded points: the further of two neighbouring points at a depth
+      // discontinuity, and the points behind it
+      const float depth =
+          std::sqrt(SquaredDiff(ring.x, ring.y, ring.z, i, i, 0));
+      const float depth_next =
+          std::sqrt(SquaredDiff(ring.x, ring.y, ring.z, i + 1, i + 1, 0));
+      if (depth > depth_next) {
+        const float weighted_distance =
+            std::sqrt(SquaredDiff(ring.x, ring.y, ring.z, i + 1, i,
+                                  depth_next / depth)) /
+            depth_next;
+        if (weighted_distance < 0.1) {
+          std::fill_n(ring.picked.begin() + i - region, region + 1, 1);
+          continue;
+        }
+      } else {
+        const float weighted_distance =
+            std::sqrt(SquaredDiff(ring.x, ring.y, ring.z, i, i + 1,
+                                  depth / depth_next)) /
+            depth;
+        if (weighted_distance < 0.1) {
+          std::fill_n(ring.picked.begin() + i + 1, region + 1, 1);
+        }
+      }
+    }
+
+    // points on surfaces almost parallel to the beam
+    const float diff_previous = SquaredDiff(ring.x, ring.y, ring.z, i, i - 1);
+    const float squared_depth = SquaredDiff(ring.x, ring.y, ring.z, i, i, 0);
+    if (diff_next > 0.0002 * squared_depth &&
+        diff_previous > 0.0002 * squared_depth) {
+      ring.picked[i] = 1;
+    }
+  }
+}
+
+void RingFeatureExtractor::MarkAsPicked(Ring& ring, size_t i) const {
+  ring.picked[i] = 1;
+  const size_t region = params_->curvature_region;
+  for (size_t j = 1; j <= region; j++) {
+    if (SquaredDiff(ring.x, ring.y, ring.z, i + j, i + j - 1) > 0.05) {
+      break;
+    }
+    ring.picked[i + j] = 1;
+  }
+  for (size_t j = 1; j <= region; j++) {
+    if (SquaredDiff(ring.x, ring.y, ring.z, i - j, i - j + 1) > 0.05) {
+      break;
+    }
+    ring.picked[i - j] = 1;
+  }
+}
+
+} // namespace bs_models
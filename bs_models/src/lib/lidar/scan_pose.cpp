@@ -1,7 +1,13 @@
 #include <bs_models/lidar/scan_pose.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
 #include <boost/filesystem.hpp>
 #include <nlohmann/json.hpp>
+#include <pcl/common/point_tests.h>
 #include <pcl/common/transforms.h>
 #include <pcl/io/pcd_io.h>
 
@@ -9,16 +15,64 @@
 #include <beam_utils/math.h>
 #include <beam_utils/se3.h>
 
+#include <bs_common/cloud_buffer_pool.h>
 #include <bs_common/conversions.h>
+#include <bs_common/graph_snapshot.h>
 
 namespace bs_models {
 
+namespace {
+
+template <typename PointT>
+bool SavePCD(const std::string& path, const pcl::PointCloud<PointT>& cloud,
+             bool compress, std::string& error_message) {
+  if (!compress) {
+    return beam::SavePointCloud<PointT>(
+        path, cloud, beam::PointCloudFileType::PCDBINARY, error_message);
+  }
+  if (pcl::io::savePCDFileBinaryCompressed(path, cloud) != 0) {
+    error_message = "cannot write compressed PCD file " + path;
+    return false;
+  }
+  return true;
+}
+
+// clouds are stored as a vector of packed xyz floats
+void WriteCloud(bs_common::ByteWriter& writer, const PointCloud& cloud) {
+  writer.Write<uint64_t>(3 * cloud.size());
+  for (const auto& p : cloud) {
+    writer.Write<float>(p.x);
+    writer.Write<float>(p.y);
+    writer.Write<float>(p.z);
+  }
+}
+
+void ReadCloud(bs_common::ByteReader& reader, PointCloud& cloud) {
+  std::vector<float> xyz;
+  reader.ReadVector(xyz);
+  cloud.clear();
+  cloud.reserve(xyz.size() / 3);
+  for (size_t i = 0; i + 2 < xyz.size(); i += 3) {
+    cloud.push_back(pcl::PointXYZ(xyz[i], xyz[i + 1], xyz[i + 2]));
+  }
+}
+
+} // namespace
+
 ScanPose::ScanPose(const PointCloud& cloud, const ros::Time& stamp,
                    const Eigen::Matrix4d& T_REFFRAME_BASELINK,
                    const Eigen::Matrix4d& T_BASELINK_LIDAR,
                    const std::shared_ptr<beam_matching::LoamFeatureExtractor>&
                        feature_extractor)
-    : pointcloud_(cloud),
+    : ScanPose(PointCloud(cloud), stamp, T_REFFRAME_BASELINK, T_BASELINK_LIDAR,
+               feature_extractor) {}
+
+ScanPose::ScanPose(PointCloud&& cloud, const ros::Time& stamp,
+                   const Eigen::Matrix4d& T_REFFRAME_BASELINK,
+                   const Eigen::Matrix4d& T_BASELINK_LIDAR,
+                   const std::shared_ptr<beam_matching::LoamFeatureExtractor>&
+                       feature_extractor)
+    : pointcloud_(std::make_shared<const PointCloud>(std::move(cloud))),
       stamp_(stamp),
       T_REFFRAME_BASELINK_initial_(T_REFFRAME_BASELINK),
       T_BASELINK_LIDAR_(T_BASELINK_LIDAR) {
@@ -33,7 +87,8 @@ ScanPose::ScanPose(const PointCloud& cloud, const ros::Time& stamp,
 
   if (feature_extractor != nullptr) {
     cloud_type_ = "LOAMPOINTCLOUD";
-    loampointcloud_ = feature_extractor->ExtractFeatures(cloud);
+    loampointcloud_ = std::make_shared<const beam_matching::LoamPointCloud>(
+        feature_extractor->ExtractFeatures(*pointcloud_));
   }
 }
 
@@ -47,9 +102,12 @@ ScanPose::ScanPose(const pcl::PointCloud<PointXYZIRT>& cloud,
       T_REFFRAME_BASELINK_initial_(T_REFFRAME_BASELINK),
       T_BASELINK_LIDAR_(T_BASELINK_LIDAR) {
   // convert to regular pointcloud
+  auto pointcloud = std::make_shared<PointCloud>();
+  pointcloud->reserve(cloud.size());
   for (const auto& p : cloud) {
-    pointcloud_.push_back(pcl::PointXYZ(p.x, p.y, p.z));
+    pointcloud->push_back(pcl::PointXYZ(p.x, p.y, p.z));
   }
+  pointcloud_ = pointcloud;
 
   // create fuse variables
   position_ = fuse_variables::Position3DStamped(stamp, fuse_core::uuid::NIL);
@@ -62,7 +120,8 @@ ScanPose::ScanPose(const pcl::PointCloud<PointXYZIRT>& cloud,
 
   if (feature_extractor != nullptr) {
     cloud_type_ = "LOAMPOINTCLOUD";
-    loampointcloud_ = feature_extractor->ExtractFeatures(cloud);
+    loampointcloud_ = std::make_shared<const beam_matching::LoamPointCloud>(
+        feature_extractor->ExtractFeatures(cloud));
   }
 }
 
@@ -76,9 +135,12 @@ ScanPose::ScanPose(const pcl::PointCloud<PointXYZITRRNR>& cloud,
       T_REFFRAME_BASELINK_initial_(T_REFFRAME_BASELINK),
       T_BASELINK_LIDAR_(T_BASELINK_LIDAR) {
   // convert to regular pointcloud
+  auto pointcloud = std::make_shared<PointCloud>();
+  pointcloud->reserve(cloud.size());
   for (const auto& p : cloud) {
-    pointcloud_.push_back(pcl::PointXYZ(p.x, p.y, p.z));
+    pointcloud->push_back(pcl::PointXYZ(p.x, p.y, p.z));
   }
+  pointcloud_ = pointcloud;
 
   // create fuse variables
   position_ = fuse_variables::Position3DStamped(stamp, fuse_core::uuid::NIL);
@@ -91,7 +153,8 @@ ScanPose::ScanPose(const pcl::PointCloud<PointXYZITRRNR>& cloud,
 
   if (feature_extractor != nullptr) {
     cloud_type_ = "LOAMPOINTCLOUD";
-    loampointcloud_ = feature_extractor->ExtractFeatures(cloud);
+    loampointcloud_ = std::make_shared<const beam_matching::LoamPointCloud>(
+        feature_extractor->ExtractFeatures(cloud));
   }
 }
 
@@ -112,24 +175,81 @@ ScanPose::ScanPose(const ros::Time& stamp,
 }
 
 void ScanPose::AddPointCloud(const PointCloud& cloud, bool override_cloud) {
-  if (override_cloud) {
-    pointcloud_ = cloud;
-  } else {
-    pointcloud_ += cloud;
+  Decompress();
+  if (override_cloud || pointcloud_->empty()) {
+    pointcloud_ = std::make_shared<const PointCloud>(cloud);
+    return;
+  }
+
+  // other copies of this scan pose may still hold the current cloud, so
+  // merge into a new one
+  auto merged = std::make_shared<PointCloud>(*pointcloud_);
+  *merged += cloud;
+  pointcloud_ = merged;
+}
+
+void ScanPose::AddPointCloud(PointCloud&& cloud, bool override_cloud) {
+  Decompress();
+  if (!override_cloud && !pointcloud_->empty()) {
+    AddPointCloud(static_cast<const PointCloud&>(cloud), false);
+    return;
   }
+  pointcloud_ = bs_common::CloudBufferPool<pcl::PointXYZ>::Get().Share(cloud);
+}
+
+void ScanPose::AddPointCloud(const std::shared_ptr<const PointCloud>& cloud,
+                             bool override_cloud) {
+  Decompress();
+  if (!override_cloud && !pointcloud_->empty()) {
+    AddPointCloud(*cloud, false);
+    return;
+  }
+  pointcloud_ = cloud;
 }
 
 void ScanPose::AddPointCloud(const beam_matching::LoamPointCloud& cloud,
                              bool override_cloud) {
+  Decompress();
   if (override_cloud) {
-    loampointcloud_ = cloud;
+    loampointcloud_ =
+        std::make_shared<const beam_matching::LoamPointCloud>(cloud);
   } else {
-    loampointcloud_.Merge(cloud);
+    auto merged =
+        std::make_shared<beam_matching::LoamPointCloud>(*loampointcloud_);
+    merged->Merge(cloud);
+    loampointcloud_ = merged;
   }
   cloud_type_ = "LOAMPOINTCLOUD";
 }
 
+void ScanPose::AddPointCloud(beam_matching::LoamPointCloud&& cloud,
+                             bool override_cloud) {
+  Decompress();
+  if (!override_cloud) {
+    AddPointCloud(static_cast<const beam_matching::LoamPointCloud&>(cloud),
+                  false);
+    return;
+  }
+  loampointcloud_ =
+      std::make_shared<const beam_matching::LoamPointCloud>(std::move(cloud));
+  cloud_type_ = "LOAMPOINTCLOUD";
+}
+
 bool ScanPose::UpdatePose(const fuse_core::Graph::ConstSharedPtr& graph_msg) {
+  // if the graph came with a delta, only copy the variables if they changed
+  const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(*graph_msg);
+  if (delta && !delta->IsUpdated(position_.uuid()) &&
+      !delta->IsUpdated(orientation_.uuid())) {
+    if (delta->IsRemoved(position_.uuid()) ||
+        delta->IsRemoved(orientation_.uuid()) ||
+        !graph_msg->variableExists(position_.uuid()) ||
+        !graph_msg->variableExists(orientation_.uuid())) {
+      return false;
+    }
+    updates_++;
+    return true;
+  }
+
   if (graph_msg->variableExists(position_.uuid()) &&
       graph_msg->variableExists(orientation_.uuid())) {
     position_ = dynamic_cast<const fuse_variables::Position3DStamped&>(
@@ -143,6 +263,16 @@ bool ScanPose::UpdatePose(const fuse_core::Graph::ConstSharedPtr& graph_msg) {
   return false;
 }
 
+bool ScanPose::UpdatePose(const bs_common::GraphView& graph_view) {
+  const auto position = graph_view.GetPosition(stamp_);
+  const auto orientation = graph_view.GetOrientation(stamp_);
+  if (!position || !orientation) { return false; }
+  position_ = *position;
+  orientation_ = *orientation;
+  updates_++;
+  return true;
+}
+
 void ScanPose::UpdatePose(const Eigen::Matrix4d& T_REFFRAME_BASELINK) {
   bs_common::EigenTransformToFusePose(T_REFFRAME_BASELINK, position_,
                                       orientation_);
@@ -199,12 +329,209 @@ Eigen::Matrix4d ScanPose::T_LIDAR_BASELINK() const {
   return beam::InvertTransform(T_BASELINK_LIDAR_);
 }
 
-PointCloud ScanPose::Cloud() const {
+const PointCloud& ScanPose::Cloud() const {
+  if (!compressed_clouds_) { return *pointcloud_; }
+  return *DecodedCloud(true);
+}
+
+std::shared_ptr<const PointCloud> ScanPose::CloudPtr() const {
+  if (!compressed_clouds_) { return pointcloud_; }
+  return DecodedCloud(false);
+}
+
+const beam_matching::LoamPointCloud& ScanPose::LoamCloud() const {
+  if (!compressed_clouds_) { return *loampointcloud_; }
+  return *DecodedLoamCloud(true);
+}
+
+std::shared_ptr<const beam_matching::LoamPointCloud>
+    ScanPose::LoamCloudPtr() const {
+  if (!compressed_clouds_) { return loampointcloud_; }
+  return DecodedLoamCloud(false);
+}
+
+std::shared_ptr<const PointCovariances> ScanPose::Covariances(int k) const {
+  const auto source = CovarianceSource();
+  const auto cache = std::atomic_load(&covariances_);
+  if (cache && cache->source == source && cache->covariances->k == k) {
+    return cache->covariances;
+  }
+
+  auto covariances = std::make_shared<PointCovariances>();
+  ComputePointCovariances(*CloudPtr(), k, *covariances);
+  auto computed = std::make_shared<CovarianceCache>();
+  computed->source = source;
+  computed->covariances = covariances;
+
+  // if another thread computed them first, we only keep ours if theirs are for
+  // another cloud or k
+  std::shared_ptr<const CovarianceCache> expected = cache;
+  if (!std::atomic_compare_exchange_strong(
+          &covariances_, &expected,
+          std::shared_ptr<const CovarianceCache>(computed)) &&
+      expected && expected->source == source &&
+      expected->covariances->k == k) {
+    return expected->covariances;
+  }
+  return covariances;
+}
+
+bool ScanPose::HasCovariances() const {
+  const auto cache = std::atomic_load(&covariances_);
+  return cache && cache->source == CovarianceSource();
+}
+
+std::shared_ptr<const void> ScanPose::CovarianceSource() const {
+  if (compressed_clouds_) { return compressed_clouds_; }
   return pointcloud_;
 }
 
-beam_matching::LoamPointCloud ScanPose::LoamCloud() const {
-  return loampointcloud_;
+void ScanPose::CompressClouds() {
+  if (compressed_clouds_) { return; }
+  auto compressed = std::make_shared<CompressedClouds>();
+  Quantize(*pointcloud_, compressed->points);
+  Quantize(loampointcloud_->edges.strong.cloud, compressed->edges_strong);
+  Quantize(loampointcloud_->edges.weak.cloud, compressed->edges_weak);
+  Quantize(loampointcloud_->surfaces.strong.cloud, compressed->surfaces_strong);
+  Quantize(loampointcloud_->surfaces.weak.cloud, compressed->surfaces_weak);
+  // compressing keeps the order of the finite points, so the covariances stay
+  // valid unless points were dropped
+  const auto cache = std::atomic_load(&covariances_);
+  if (cache && cache->source == pointcloud_ &&
+      compressed->points.xyz.size() == 3 * pointcloud_->size()) {
+    auto moved = std::make_shared<CovarianceCache>(*cache);
+    moved->source = compressed;
+    covariances_ = moved;
+  }
+  compressed_clouds_ = compressed;
+  pointcloud_ = nullptr;
+  loampointcloud_ = nullptr;
+}
+
+void ScanPose::ReleaseDecodedClouds() {
+  if (!compressed_clouds_) { return; }
+  pointcloud_ = nullptr;
+  loampointcloud_ = nullptr;
+}
+
+size_t ScanPose::CloudMemoryUsage() const {
+  size_t memory = 0;
+  const auto pointcloud = std::atomic_load(&pointcloud_);
+  if (pointcloud) { memory += pointcloud->size() * sizeof(pcl::PointXYZ); }
+  const auto loampointcloud = std::atomic_load(&loampointcloud_);
+  const auto cache = std::atomic_load(&covariances_);
+  if (cache) { memory += cache->covariances->MemoryUsage(); }
+  if (loampointcloud) {
+    memory += (loampointcloud->edges.strong.cloud.size() +
+               loampointcloud->edges.weak.cloud.size() +
+               loampointcloud->surfaces.strong.cloud.size() +
+               loampointcloud->surfaces.weak.cloud.size()) *
+              sizeof(pcl::PointXYZ);
+  }
+  if (compressed_clouds_) {
+    memory += sizeof(CompressedClouds) +
+              (compressed_clouds_->points.xyz.size() +
+               compressed_clouds_->edges_strong.xyz.size() +
+               compressed_clouds_->edges_weak.xyz.size() +
+               compressed_clouds_->surfaces_strong.xyz.size() +
+               compressed_clouds_->surfaces_weak.xyz.size()) *
+                  sizeof(uint16_t);
+  }
+  return memory;
+}
+
+void ScanPose::Quantize(const PointCloud& cloud, QuantizedCloud& quantized) {
+  constexpr float max_value = std::numeric_limits<uint16_t>::max();
+  quantized = QuantizedCloud();
+  Eigen::Vector3f min =
+      Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+  Eigen::Vector3f max = -min;
+  size_t num_finite = 0;
+  for (const auto& p : cloud) {
+    if (!pcl::isFinite(p)) { continue; }
+    min = min.cwiseMin(p.getVector3fMap());
+    max = max.cwiseMax(p.getVector3fMap());
+    num_finite++;
+  }
+  if (num_finite == 0) { return; }
+
+  quantized.min = min;
+  quantized.resolution = (max - min) / max_value;
+  quantized.xyz.reserve(3 * num_finite);
+  for (const auto& p : cloud) {
+    if (!pcl::isFinite(p)) { continue; }
+    for (int i = 0; i < 3; i++) {
+      const float resolution = quantized.resolution[i];
+      const float value =
+          resolution > 0 ? std::round((p.data[i] - min[i]) / resolution) : 0;
+      quantized.xyz.push_back(
+          static_cast<uint16_t>(std::clamp(value, 0.0f, max_value)));
+    }
+  }
+}
+
+void ScanPose::Dequantize(const QuantizedCloud& quantized, PointCloud& cloud) {
+  cloud.clear();
+  cloud.reserve(quantized.xyz.size() / 3);
+  const uint16_t* q = quantized.xyz.data();
+  for (size_t i = 0; i + 2 < quantized.xyz.size(); i += 3) {
+    cloud.push_back(
+        pcl::PointXYZ(quantized.min[0] + q[i] * quantized.resolution[0],
+                      quantized.min[1] + q[i + 1] * quantized.resolution[1],
+                      quantized.min[2] + q[i + 2] * quantized.resolution[2]));
+  }
+}
+
+std::shared_ptr<const PointCloud> ScanPose::DecodedCloud(bool keep) const {
+  std::shared_ptr<const PointCloud> cloud = std::atomic_load(&pointcloud_);
+  if (cloud) { return cloud; }
+
+  auto decoded = std::make_shared<PointCloud>();
+  Dequantize(compressed_clouds_->points, *decoded);
+  cloud = decoded;
+  if (!keep) { return cloud; }
+
+  // another thread may have decoded it first, in which case we use theirs
+  std::shared_ptr<const PointCloud> expected;
+  if (!std::atomic_compare_exchange_strong(&pointcloud_, &expected, cloud)) {
+    return expected;
+  }
+  return cloud;
+}
+
+std::shared_ptr<const beam_matching::LoamPointCloud>
+    ScanPose::DecodedLoamCloud(bool keep) const {
+  std::shared_ptr<const beam_matching::LoamPointCloud> cloud =
+      std::atomic_load(&loampointcloud_);
+  if (cloud) { return cloud; }
+
+  auto decoded = std::make_shared<beam_matching::LoamPointCloud>();
+  Dequantize(compressed_clouds_->edges_strong, decoded->edges.strong.cloud);
+  Dequantize(compressed_clouds_->edges_weak, decoded->edges.weak.cloud);
+  Dequantize(compressed_clouds_->surfaces_strong,
+             decoded->surfaces.strong.cloud);
+  Dequantize(compressed_clouds_->surfaces_weak, decoded->surfaces.weak.cloud);
+  cloud = decoded;
+  if (!keep) { return cloud; }
+
+  std::shared_ptr<const beam_matching::LoamPointCloud> expected;
+  if (!std::atomic_compare_exchange_strong(&loampointcloud_, &expected,
+                                           cloud)) {
+    return expected;
+  }
+  return cloud;
+}
+
+void ScanPose::Decompress() {
+  if (!compressed_clouds_) { return; }
+  pointcloud_ = DecodedCloud(false);
+  loampointcloud_ = DecodedLoamCloud(false);
+  if (covariances_ && covariances_->source == compressed_clouds_) {
+    auto moved = std::make_shared<CovarianceCache>(*covariances_);
+    moved->source = pointcloud_;
+    covariances_ = moved;
+  }
+  compressed_clouds_ = nullptr;
 }
 
 ros::Time ScanPose::Stamp() const {
@@ -222,7 +549,7 @@ void ScanPose::SetCloudTypeToLoam() {
 void ScanPose::Print(std::ostream& stream) const {
   stream << "  Stamp: " << stamp_ << "\n"
          << "  Cloud Type: " << cloud_type_ << "\n"
-         << "  Cloud size: " << pointcloud_.size() << "\n"
+         << "  Cloud size: " << CloudPtr()->size() << "\n"
          << "  Number of Updates: " << updates_ << "\n"
          << "  Position:\n"
          << "  - x: " << position_.x() << "\n"
@@ -241,16 +568,18 @@ void ScanPose::SaveData(const std::string& output_dir) const {
                output_dir);
     return;
   }
+  const auto pointcloud = CloudPtr();
+  const auto loampointcloud = LoamCloudPtr();
 
   // save general data
   nlohmann::json J_scanpose = {
       {"stamp_nsecs", stamp_.toNSec()},
       {"updates", updates_},
-      {"pointcloud_size", pointcloud_.size()},
-      {"loam_edges_strong", loampointcloud_.edges.strong.cloud.size()},
-      {"loam_surfaces_strong", loampointcloud_.surfaces.strong.cloud.size()},
-      {"loam_edges_weak", loampointcloud_.edges.weak.cloud.size()},
-      {"loam_surfaces_weak", loampointcloud_.surfaces.weak.cloud.size()},
+      {"pointcloud_size", pointcloud->size()},
+      {"loam_edges_strong", loampointcloud->edges.strong.cloud.size()},
+      {"loam_surfaces_strong", loampointcloud->surfaces.strong.cloud.size()},
+      {"loam_edges_weak", loampointcloud->edges.weak.cloud.size()},
+      {"loam_surfaces_weak", loampointcloud->surfaces.weak.cloud.size()},
       {"cloud_type", cloud_type_},
       {"device_id", fuse_core::uuid::to_string(position_.deviceId())},
       {"position_xyz", {position_.x(), position_.y(), position_.z()}},
@@ -268,17 +597,25 @@ void ScanPose::SaveData(const std::string& output_dir) const {
   // save pointclouds
   std::string error_message;
   std::string cloud_path = beam::CombinePaths(output_dir, "pointcloud.pcd");
-  if (!beam::SavePointCloud<pcl::PointXYZ>(cloud_path, pointcloud_,
+  if (!beam::SavePointCloud<pcl::PointXYZ>(cloud_path, *pointcloud,
                                            beam::PointCloudFileType::PCDBINARY,
                                            error_message)) {
     BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
   }
 
-  loampointcloud_.SaveCombined(output_dir, "loam_cloud.pcd", 255, 255, 255,
-                               false);
+  loampointcloud->SaveCombined(output_dir, "loam_cloud.pcd", 255, 255, 255,
+                              false);
+
+  const auto cache = std::atomic_load(&covariances_);
+  if (cache && cache->source == CovarianceSource()) {
+    SavePointCovariances(
+        beam::CombinePaths(output_dir, "point_covariances.bin"),
+        *cache->covariances);
+  }
 }
 
 bool ScanPose::LoadData(const std::string& root_dir) {
+  Decompress();
   if (!boost::filesystem::exists(root_dir)) {
     BEAM_ERROR("Invalid input directory, not loading scanpose data. Input: {}",
                root_dir);
@@ -328,11 +665,13 @@ bool ScanPose::LoadData(const std::string& root_dir) {
   std::string pointcloud_filename =
       beam::CombinePaths(root_dir, "pointcloud.pcd");
   if (boost::filesystem::exists(pointcloud_filename)) {
-    if (pcl::io::loadPCDFile<pcl::PointXYZ>(pointcloud_filename, pointcloud_) ==
+    auto pointcloud = std::make_shared<PointCloud>();
+    if (pcl::io::loadPCDFile<pcl::PointXYZ>(pointcloud_filename, *pointcloud) ==
         -1) {
       BEAM_ERROR("Couldn't read pointcloud file: {}", pointcloud_filename);
       return false;
     }
+    pointcloud_ = pointcloud;
   }
 
   pointcloud_filename = beam::CombinePaths(root_dir, "loam_cloud.pcd");
@@ -342,33 +681,143 @@ bool ScanPose::LoadData(const std::string& root_dir) {
         -1) {
       BEAM_ERROR("Couldn't read pointcloud file: {}", pointcloud_filename);
     }
-    loampointcloud_.LoadFromCombined(loam_combined);
+    auto loampointcloud = std::make_shared<beam_matching::LoamPointCloud>();
+    loampointcloud->LoadFromCombined(loam_combined);
+    loampointcloud_ = loampointcloud;
   }
 
-  if (loampointcloud_.edges.strong.cloud.size() > 0 ||
-      loampointcloud_.edges.weak.cloud.size() > 0 ||
-      loampointcloud_.surfaces.strong.cloud.size() > 0 ||
-      loampointcloud_.surfaces.weak.cloud.size() > 0) {
+  if (loampointcloud_->edges.strong.cloud.size() > 0 ||
+      loampointcloud_->edges.weak.cloud.size() > 0 ||
+      loampointcloud_->surfaces.strong.cloud.size() > 0 ||
+      loampointcloud_->surfaces.weak.cloud.size() > 0) {
     cloud_type_ = "PCLPOINTCLOUD";
   }
 
+  covariances_ = nullptr;
+  const std::string covariances_filename =
+      beam::CombinePaths(root_dir, "point_covariances.bin");
+  if (boost::filesystem::exists(covariances_filename)) {
+    auto covariances = std::make_shared<PointCovariances>();
+    if (LoadPointCovariances(covariances_filename, *covariances) &&
+        covariances->Size() == pointcloud_->size()) {
+      auto cache = std::make_shared<CovarianceCache>();
+      cache->source = pointcloud_;
+      cache->covariances = covariances;
+      covariances_ = cache;
+    } else {
+      BEAM_ERROR("Ignoring invalid point covariances file: {}",
+                 covariances_filename);
+    }
+  }
+
   return true;
 }
 
+void ScanPose::Serialize(bs_common::ByteWriter& writer) const {
+  writer.Write<uint64_t>(stamp_.toNSec());
+  writer.Write<int32_t>(updates_);
+  writer.WriteString(cloud_type_);
+  writer.Write(position_.deviceId());
+  writer.WriteMatrix(
+      Eigen::Vector3d(position_.x(), position_.y(), position_.z()));
+  writer.WriteMatrix(Eigen::Vector4d(orientation_.x(), orientation_.y(),
+                                     orientation_.z(), orientation_.w()));
+  writer.WriteMatrix(T_BASELINK_LIDAR_);
+  writer.WriteMatrix(T_REFFRAME_BASELINK_initial_);
+  const auto loampointcloud = LoamCloudPtr();
+  WriteCloud(writer, *CloudPtr());
+  WriteCloud(writer, loampointcloud->edges.strong.cloud);
+  WriteCloud(writer, loampointcloud->surfaces.strong.cloud);
+  WriteCloud(writer, loampointcloud->edges.weak.cloud);
+  WriteCloud(writer, loampointcloud->surfaces.weak.cloud);
+}
+
+bool ScanPose::Deserialize(bs_common::ByteReader& reader, bool load_clouds) {
+  try {
+    stamp_.fromNSec(reader.Read<uint64_t>());
+    updates_ = reader.Read<int32_t>();
+    const std::string cloud_type_read = reader.ReadString();
+    const auto device_id = reader.Read<fuse_core::UUID>();
+    Eigen::Vector3d position;
+    Eigen::Vector4d orientation_xyzw;
+    reader.ReadMatrix(position);
+    reader.ReadMatrix(orientation_xyzw);
+    reader.ReadMatrix(T_BASELINK_LIDAR_);
+    reader.ReadMatrix(T_REFFRAME_BASELINK_initial_);
+
+    auto pointcloud = std::make_shared<PointCloud>();
+    auto loampointcloud = std::make_shared<beam_matching::LoamPointCloud>();
+    if (load_clouds) {
+      ReadCloud(reader, *pointcloud);
+      ReadCloud(reader, loampointcloud->edges.strong.cloud);
+      ReadCloud(reader, loampointcloud->surfaces.strong.cloud);
+      ReadCloud(reader, loampointcloud->edges.weak.cloud);
+      ReadCloud(reader, loampointcloud->surfaces.weak.cloud);
+    }
+
+    if (cloud_type_read == "PCLPOINTCLOUD" ||
+        cloud_type_read == "LOAMPOINTCLOUD") {
+      cloud_type_ = cloud_type_read;
+    } else {
+      cloud_type_ = "PCLPOINTCLOUD";
+    }
+    position_ = fuse_variables::Position3DStamped(stamp_, device_id);
+    position_.x() = position.x();
+    position_.y() = position.y();
+    position_.z() = position.z();
+    orientation_ = fuse_variables::Orientation3DStamped(stamp_, device_id);
+    orientation_.x() = orientation_xyzw[0];
+    orientation_.y() = orientation_xyzw[1];
+    orientation_.z() = orientation_xyzw[2];
+    orientation_.w() = orientation_xyzw[3];
+    pointcloud_ = pointcloud;
+    loampointcloud_ = loampointcloud;
+    compressed_clouds_ = nullptr;
+    covariances_ = nullptr;
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Cannot read scanpose data: {}", e.what());
+    return false;
+  }
+  return true;
+}
+
+bool ScanPose::LoadClouds(bs_common::ByteReader& reader) {
+  ScanPose loaded(ros::Time(0), Eigen::Matrix4d::Identity());
+  if (!loaded.Deserialize(reader)) { return false; }
+  if (loaded.Stamp() != stamp_) {
+    BEAM_ERROR("Cannot load clouds of scan with stamp {} into scanpose with "
+               "stamp {}",
+               loaded.Stamp().toNSec(), stamp_.toNSec());
+    return false;
+  }
+  pointcloud_ = loaded.pointcloud_;
+  loampointcloud_ = loaded.loampointcloud_;
+  compressed_clouds_ = nullptr;
+  cloud_type_ = loaded.cloud_type_;
+  return true;
+}
+
+void ScanPose::ReleaseClouds() {
+  pointcloud_ = std::make_shared<const PointCloud>();
+  loampointcloud_ = std::make_shared<const beam_matching::LoamPointCloud>();
+  compressed_clouds_ = nullptr;
+  covariances_ = nullptr;
+}
+
 void ScanPose::SaveCloud(const std::string& save_path, bool to_reference_frame,
-                         bool add_frame) const {
+                         bool add_frame, bool compress) const {
   if (!boost::filesystem::exists(save_path)) {
     BEAM_ERROR("Cannot save cloud, directory does not exist: {}", save_path);
     return;
   }
+  const auto pointcloud = CloudPtr();
 
   if (!to_reference_frame) {
     std::string filename = std::to_string(stamp_.toSec()) + ".pcd";
-    std::string save_path = beam::CombinePaths(save_path, filename);
+    std::string file_path = beam::CombinePaths(save_path, filename);
     std::string error_message;
-    if (!beam::SavePointCloud<pcl::PointXYZ>(
-            save_path, pointcloud_, beam::PointCloudFileType::PCDBINARY,
-            error_message)) {
+    if (!SavePCD<pcl::PointXYZ>(file_path, *pointcloud, compress,
+                                error_message)) {
       BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
     }
     return;
@@ -377,13 +826,13 @@ void ScanPose::SaveCloud(const std::string& save_path, bool to_reference_frame,
   PointCloud cloud_initial;
   Eigen::Matrix4d T_REFFRAME_LIDAR_initial =
       T_REFFRAME_BASELINK_initial_ * T_BASELINK_LIDAR_;
-  pcl::transformPointCloud(pointcloud_, cloud_initial,
+  pcl::transformPointCloud(*pointcloud, cloud_initial,
                            T_REFFRAME_LIDAR_initial);
 
   PointCloud cloud_final;
   Eigen::Matrix4d T_REFFRAME_LIDAR_final =
       T_REFFRAME_BASELINK() * T_BASELINK_LIDAR_;
-  pcl::transformPointCloud(pointcloud_, cloud_final, T_REFFRAME_LIDAR_final);
+  pcl::transformPointCloud(*pointcloud, cloud_final, T_REFFRAME_LIDAR_final);
 
   PointCloudCol cloud_initial_col =
       beam::ColorPointCloud(cloud_initial, 255, 0, 0);
@@ -400,16 +849,14 @@ void ScanPose::SaveCloud(const std::string& save_path, bool to_reference_frame,
   std::string save_path_init =
       beam::CombinePaths(save_path, "initial_" + filename);
   std::string error_message{};
-  if (!beam::SavePointCloud<pcl::PointXYZRGB>(
-          save_path_init, cloud_initial_col,
-          beam::PointCloudFileType::PCDBINARY, error_message)) {
+  if (!SavePCD<pcl::PointXYZRGB>(save_path_init, cloud_initial_col, compress,
+                                 error_message)) {
     BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
   }
   std::string save_path_final =
       beam::CombinePaths(save_path, "final_" + filename);
-  if (!beam::SavePointCloud<pcl::PointXYZRGB>(
-          save_path_final, cloud_final_col, beam::PointCloudFileType::PCDBINARY,
-          error_message)) {
+  if (!SavePCD<pcl::PointXYZRGB>(save_path_final, cloud_final_col, compress,
+                                 error_message)) {
     BEAM_ERROR("Unable to save cloud. Reason: {}", error_message);
   }
   if (error_message.empty()) {
@@ -428,17 +875,18 @@ void ScanPose::SaveLoamCloud(const std::string& save_path,
     BEAM_ERROR("Cannot save cloud, directory does not exist: {}", save_path);
     return;
   }
+  const auto loampointcloud = LoamCloudPtr();
 
   if (!to_reference_frame) {
-    loampointcloud_.SaveCombined(save_path,
-                                 std::to_string(stamp_.toSec()) + ".pcd", 255,
-                                 255, 255, false);
+    loampointcloud->SaveCombined(save_path,
+                                std::to_string(stamp_.toSec()) + ".pcd", 255,
+                                255, 255, false);
     return;
   }
 
   Eigen::Matrix4d T_REFFRAME_LIDAR_final =
       T_REFFRAME_BASELINK() * T_BASELINK_LIDAR_;
-  beam_matching::LoamPointCloud loam_cloud_transformed(loampointcloud_,
+  beam_matching::LoamPointCloud loam_cloud_transformed(*loampointcloud,
                                                        T_REFFRAME_LIDAR_final);
   loam_cloud_transformed.SaveCombined(
       save_path, std::to_string(stamp_.toSec()) + ".pcd", 255, 255, 255, false);
@@ -1,7 +1,11 @@
 #include <bs_models/reloc/reloc_candidate_search_base.h>
 
+#include <algorithm>
+
 #include <beam_utils/filesystem.h>
 #include <beam_utils/log.h>
+#include <beam_utils/se3.h>
+#include <bs_common/instrumentation.h>
 #include <bs_common/utils.h>
 
 #include <bs_models/reloc/reloc_candidate_search_eucdist.h>
@@ -9,6 +13,19 @@
 
 namespace bs_models::reloc {
 
+void RelocCandidateSearchBase::OverlapPrefilterParams::LoadFromJson(
+    const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("box_margin_m")) { box_margin_m = J["box_margin_m"]; }
+  if (J.contains("min_occupancy_overlap")) {
+    min_occupancy_overlap = J["min_occupancy_overlap"];
+  }
+  if (J.contains("min_height_similarity")) {
+    min_height_similarity = J["min_height_similarity"];
+  }
+  if (J.contains("footprint")) { footprint.LoadFromJson(J["footprint"]); }
+}
+
 std::shared_ptr<RelocCandidateSearchBase>
     RelocCandidateSearchBase::Create(const std::string& config_path) {
   if (config_path.empty()) {
@@ -36,4 +53,75 @@ std::shared_ptr<RelocCandidateSearchBase>
   }
 }
 
+void RelocCandidateSearchBase::PrepareSubmap(
+    const global_mapping::SubmapPtr& submap) {
+  if (overlap_prefilter_params_.enabled) { GetFootprint(submap); }
+}
+
+void RelocCandidateSearchBase::LoadOverlapPrefilterParams(
+    const nlohmann::json& J) {
+  if (J.contains("overlap_prefilter")) {
+    overlap_prefilter_params_.LoadFromJson(J["overlap_prefilter"]);
+  }
+}
+
+bool RelocCandidateSearchBase::PassesOverlapPrefilter(
+    const global_mapping::SubmapPtr& candidate,
+    const global_mapping::SubmapPtr& query,
+    const Eigen::Matrix4d& T_CANDIDATE_QUERY) {
+  if (!overlap_prefilter_params_.enabled) { return true; }
+  const global_mapping::SubmapFootprint* candidate_footprint =
+      GetFootprint(candidate);
+  const global_mapping::SubmapFootprint* query_footprint = GetFootprint(query);
+  if (!candidate_footprint || !query_footprint) { return true; }
+
+  static bs_common::Metric& rejected_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "reloc_candidate_search/prefilter_rejected");
+  const OverlapPrefilterParams& params = overlap_prefilter_params_;
+  if (!candidate_footprint->BoxesIntersect(*query_footprint, T_CANDIDATE_QUERY,
+                                           params.box_margin_m)) {
+    rejected_metric.Increment();
+    BEAM_INFO("Rejected reloc candidate, bounding boxes do not intersect");
+    return false;
+  }
+
+  const double height_similarity =
+      candidate_footprint->HeightSimilarity(*query_footprint);
+  if (height_similarity < params.min_height_similarity) {
+    rejected_metric.Increment();
+    BEAM_INFO("Rejected reloc candidate, height similarity: {} (min: {})",
+              height_similarity, params.min_height_similarity);
+    return false;
+  }
+
+  // the smaller submap may be covered by the larger one but not the
+  // opposite, so the best direction is used
+  const double overlap = std::max(
+      candidate_footprint->OccupancyOverlap(*query_footprint,
+                                            T_CANDIDATE_QUERY),
+      query_footprint->OccupancyOverlap(
+          *candidate_footprint, beam::InvertTransform(T_CANDIDATE_QUERY)));
+  if (overlap < params.min_occupancy_overlap) {
+    rejected_metric.Increment();
+    BEAM_INFO("Rejected reloc candidate, occupancy overlap: {} (min: {})",
+              overlap, params.min_occupancy_overlap);
+    return false;
+  }
+  return true;
+}
+
+const global_mapping::SubmapFootprint* RelocCandidateSearchBase::GetFootprint(
+    const global_mapping::SubmapPtr& submap) {
+  const auto& params = overlap_prefilter_params_.footprint;
+  const auto* stored = submap->Footprint(params);
+  if (stored) { return stored; }
+
+  global_mapping::SubmapFootprint footprint(
+      submap->GetLidarPointsInSubmapFrame(), params);
+  if (footprint.Empty()) { return nullptr; }
+  submap->SetFootprint(footprint);
+  return submap->Footprint(params);
+}
+
 } // namespace bs_models::reloc
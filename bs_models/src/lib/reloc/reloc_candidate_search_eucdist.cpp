@@ -45,6 +45,7 @@ void RelocCandidateSearchEucDist::LoadConfig() {
 
   beam::ValidateJsonKeysOrThrow({"distance_threshold_m"}, J);
   distance_threshold_m_ = J["distance_threshold_m"];
+  LoadOverlapPrefilterParams(J);
 }
 
 void RelocCandidateSearchEucDist::FindRelocCandidates(
@@ -57,9 +58,22 @@ void RelocCandidateSearchEucDist::FindRelocCandidates(
 
   const Eigen::Matrix4d& T_WORLD_QUERY = query_submap->T_WORLD_SUBMAP();
 
+  // preselect submaps using the position index if it covers the search submaps
+  const size_t num_search_submaps =
+      search_submaps.size() - ignore_last_n_submaps;
+  std::vector<size_t> search_ids;
+  if (submap_position_index_ &&
+      submap_position_index_->Size() >= num_search_submaps) {
+    search_ids = submap_position_index_->Radius(
+        T_WORLD_QUERY.block<3, 1>(0, 3), distance_threshold_m_,
+        num_search_submaps);
+  } else {
+    for (size_t i = 0; i < num_search_submaps; i++) { search_ids.push_back(i); }
+  }
+
   // create a sorted map to store distances
   std::map<double, std::pair<int, Eigen::Matrix4d>> candidates_sorted;
-  for (int i = 0; i < search_submaps.size() - ignore_last_n_submaps; i++) {
+  for (const size_t i : search_ids) {
     Eigen::Matrix4d T_WORLD_SUBMAPCANDIDATE =
         search_submaps.at(i)->T_WORLD_SUBMAP();
     Eigen::Matrix4d T_SUBMAPCANDIDATE_QUERY =
@@ -67,7 +81,9 @@ void RelocCandidateSearchEucDist::FindRelocCandidates(
 
     double distance = T_SUBMAPCANDIDATE_QUERY.block(0, 3, 3, 1).norm();
 
-    if (distance < distance_threshold_m_) {
+    if (distance < distance_threshold_m_ &&
+        PassesOverlapPrefilter(search_submaps.at(i), query_submap,
+                               T_SUBMAPCANDIDATE_QUERY)) {
       candidates_sorted.emplace(distance, std::pair<int, Eigen::Matrix4d>(
                                               i, T_SUBMAPCANDIDATE_QUERY));
     }
@@ -51,7 +51,16 @@ void RelocCandidateSearchScanContext::LoadConfig() {
   submap_distance_threshold_m_ = J["submap_distance_threshold_m"];
   scan_context_dist_thres_ = J["scan_context_dist_thres"];
   num_scans_to_aggregate_ = J["num_scans_to_aggregate"];
-  filters_ = beam_filtering::LoadFilterParamsVector(J["filters"]);
+  if (J.contains("num_ring_key_candidates")) {
+    num_ring_key_candidates_ = J["num_ring_key_candidates"];
+    if (num_ring_key_candidates_ < 1) {
+      BEAM_ERROR("num_ring_key_candidates must be at least 1");
+      throw std::runtime_error{"invalid json inputs"};
+    }
+  }
+  filters_ = FilterPipeline<pcl::PointXYZ>(
+      beam_filtering::LoadFilterParamsVector(J["filters"]));
+  LoadOverlapPrefilterParams(J);
 
   std::string matcher_config_rel = J["matcher_config"];
   if (matcher_config_rel.empty()) {
@@ -100,7 +109,12 @@ void RelocCandidateSearchScanContext::FindRelocCandidates(
         GetMinDistBetweenSubmaps(query_submap, search_submaps.at(i));
     BEAM_INFO("Min distance between query submap and submap {} is {}", i,
               distance);
-    if (distance < submap_distance_threshold_m_) {
+    if (distance >= submap_distance_threshold_m_) { continue; }
+    const Eigen::Matrix4d T_CANDIDATE_QUERY =
+        beam::InvertTransform(search_submaps.at(i)->T_WORLD_SUBMAP()) *
+        query_submap->T_WORLD_SUBMAP();
+    if (PassesOverlapPrefilter(search_submaps.at(i), query_submap,
+                               T_CANDIDATE_QUERY)) {
       initial_candidates_sorted.emplace(distance, i);
     }
   }
@@ -112,40 +126,30 @@ void RelocCandidateSearchScanContext::FindRelocCandidates(
     return;
   }
 
-  int num_query_submap_keyframes = query_submap->LidarKeyframes().size();
-
   // build map from scan context scores to match pairs for all candidate submaps
+  const std::map<uint64_t, Eigen::MatrixXd>& query_descriptors =
+      GetScanContexts(query_submap);
   std::map<float, MatchPair> sc_dist_to_match_pair;
   for (const auto& [distance, submap_id] : initial_candidates_sorted) {
-    SCManager sc_manager;
-    sc_manager.SC_DIST_THRES = scan_context_dist_thres_;
-
-    // build scan context using aggregated candidate keyframes
-    int num_candidate_submap_keyframes =
-        search_submaps.at(submap_id)->LidarKeyframes().size();
-    for (int candidate_scan_id = 0;
-         candidate_scan_id < num_candidate_submap_keyframes;
-         candidate_scan_id++) {
-      PointCloudSC candidate_scan =
-          AggregateSubmapScan(search_submaps.at(submap_id), candidate_scan_id);
-      sc_manager.makeAndSaveScancontextAndKeys(candidate_scan);
-    }
+    const ScanContextIndex& index =
+        GetScanContextIndex(search_submaps.at(submap_id));
 
     // for each keyframe in the query submap, find best match in candidate
     // submap
-    for (int query_scan_id = 0; query_scan_id < num_query_submap_keyframes;
-         query_scan_id++) {
-      PointCloudSC query_scan =
-          AggregateSubmapScan(query_submap, query_scan_id);
-      std::pair<int, float> candidate_scan_id_and_dist =
-          sc_manager.detectLoopClosureID(query_scan, 0, log_scan_context_);
-      if (candidate_scan_id_and_dist.first == -1) { continue; }
-      MatchPair match_pair;
-      match_pair.candidate_submap_id = submap_id;
-      match_pair.candidate_scan_id = candidate_scan_id_and_dist.first;
-      match_pair.query_scan_id = query_scan_id;
-      sc_dist_to_match_pair.emplace(candidate_scan_id_and_dist.second,
-                                    match_pair);
+    int query_scan_id = 0;
+    for (const auto& [stamp, descriptor] : query_descriptors) {
+      std::pair<int, double> candidate_scan_id_and_dist =
+          index.Query(descriptor, num_ring_key_candidates_);
+      if (candidate_scan_id_and_dist.first != -1 &&
+          candidate_scan_id_and_dist.second < scan_context_dist_thres_) {
+        MatchPair match_pair;
+        match_pair.candidate_submap_id = submap_id;
+        match_pair.candidate_scan_id = candidate_scan_id_and_dist.first;
+        match_pair.query_scan_id = query_scan_id;
+        sc_dist_to_match_pair.emplace(candidate_scan_id_and_dist.second,
+                                      match_pair);
+      }
+      query_scan_id++;
     }
   }
 
@@ -223,11 +227,8 @@ std::optional<Eigen::Matrix4d>
 
   // filter clouds
   PointCloudPtr scan_candidate_filtered = std::make_shared<PointCloud>();
-  *scan_candidate_filtered = beam_filtering::FilterPointCloud<pcl::PointXYZ>(
-      scan_candidate_converted, filters_);
-  PointCloud scan_query_filtered =
-      beam_filtering::FilterPointCloud<pcl::PointXYZ>(scan_query_converted,
-                                                      filters_);
+  filters_.Filter(scan_candidate_converted, *scan_candidate_filtered);
+  PointCloud scan_query_filtered = filters_.Filter(scan_query_converted);
 
   // transform query scan into candidate submap frame
   auto scan_query_in_candidate = std::make_shared<PointCloud>();
@@ -261,15 +262,62 @@ std::optional<Eigen::Matrix4d>
   }
 }
 
+void RelocCandidateSearchScanContext::PrepareSubmap(
+    const global_mapping::SubmapPtr& submap) {
+  RelocCandidateSearchBase::PrepareSubmap(submap);
+  GetScanContextIndex(submap);
+}
+
+void RelocCandidateSearchScanContext::ConfigureSubmap(
+    const global_mapping::SubmapPtr& submap) {
+  submap->AccumulateScanContexts(num_scans_to_aggregate_);
+}
+
+const std::map<uint64_t, Eigen::MatrixXd>&
+    RelocCandidateSearchScanContext::GetScanContexts(
+        const global_mapping::SubmapPtr& submap) {
+  const auto* stored = submap->ScanContexts(num_scans_to_aggregate_);
+  if (stored) { return *stored; }
+
+  std::map<uint64_t, Eigen::MatrixXd> descriptors;
+  if (!submap->AccumulatedScanContexts(num_scans_to_aggregate_, descriptors)) {
+    SCManager sc_manager;
+    int keyframe_id = 0;
+    for (const auto& [stamp, scan_pose] : submap->LidarKeyframes()) {
+      PointCloudSC scan = AggregateSubmapScan(submap, keyframe_id++);
+      descriptors.emplace(stamp, sc_manager.makeScancontext(scan));
+    }
+  }
+  submap->SetScanContexts(num_scans_to_aggregate_, descriptors);
+  indices_.erase(submap->Stamp().toNSec());
+  return *submap->ScanContexts(num_scans_to_aggregate_);
+}
+
+const ScanContextIndex& RelocCandidateSearchScanContext::GetScanContextIndex(
+    const global_mapping::SubmapPtr& submap) {
+  const std::map<uint64_t, Eigen::MatrixXd>& descriptors =
+      GetScanContexts(submap);
+  auto& index = indices_[submap->Stamp().toNSec()];
+  if (!index || index->Size() != descriptors.size()) {
+    std::vector<Eigen::MatrixXd> descriptors_vec;
+    descriptors_vec.reserve(descriptors.size());
+    for (const auto& [stamp, descriptor] : descriptors) {
+      descriptors_vec.push_back(descriptor);
+    }
+    index = std::make_unique<ScanContextIndex>(descriptors_vec);
+  }
+  return *index;
+}
+
 PointCloudSC RelocCandidateSearchScanContext::AggregateSubmapScan(
     const global_mapping::SubmapPtr& submap, int keyframe_id) const {
   auto curr_scan_pose_iter = submap->LidarKeyframes().begin();
   std::advance(curr_scan_pose_iter, keyframe_id);
-  const std::map<uint64_t, ScanPose>& lidar_keyframes =
+  const bs_common::FlatTimeMap<uint64_t, ScanPose>& lidar_keyframes =
       submap->LidarKeyframes();
 
   PointCloudSC cloud;
-  pcl::copyPointCloud(curr_scan_pose_iter->second.Cloud(), cloud);
+  pcl::copyPointCloud(*curr_scan_pose_iter->second.CloudPtr(), cloud);
   auto T_Submap_ScanCenter = curr_scan_pose_iter->second.T_REFFRAME_LIDAR();
 
   std::vector<uint64_t> times =
@@ -280,7 +328,7 @@ PointCloudSC RelocCandidateSearchScanContext::AggregateSubmapScan(
     auto T_ScanCenter_ScanToAgg =
         beam::InvertTransform(T_Submap_ScanCenter) * T_Submap_ScanToAgg;
     PointCloud cloud_new;
-    pcl::transformPointCloud(scan_pose_to_agg.Cloud(), cloud_new,
+    pcl::transformPointCloud(*scan_pose_to_agg.CloudPtr(), cloud_new,
                              Eigen::Affine3d(T_ScanCenter_ScanToAgg));
     PointCloudSC cloud_new_conv;
     pcl::copyPointCloud(cloud_new, cloud_new_conv);
@@ -290,7 +338,8 @@ PointCloudSC RelocCandidateSearchScanContext::AggregateSubmapScan(
 }
 
 std::vector<uint64_t> RelocCandidateSearchScanContext::GetTimesToAggregate(
-    const std::map<uint64_t, ScanPose>& keyframes, int center_id) const {
+    const bs_common::FlatTimeMap<uint64_t, ScanPose>& keyframes,
+    int center_id) const {
   // first, get the IDs we will keep
   std::vector<int> ids;
   double curr_id = center_id - num_scans_to_aggregate_ / 2;
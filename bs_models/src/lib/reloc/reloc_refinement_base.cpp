@@ -1,14 +1,51 @@
 #include <bs_models/reloc/reloc_refinement_base.h>
 
+#include <chrono>
+
+#include <pcl/common/transforms.h>
+#include <pcl/registration/icp.h>
+
+#include <beam_filtering/VoxelDownsample.h>
 #include <beam_utils/filesystem.h>
 #include <beam_utils/log.h>
 
+#include <bs_common/instrumentation.h>
+#include <bs_common/point_transforms.h>
 #include <bs_common/utils.h>
 #include <bs_models/reloc/reloc_refinement_loam_registration.h>
 #include <bs_models/reloc/reloc_refinement_scan_registration.h>
+#include <bs_models/scan_registration/registration_validation.h>
 
 namespace bs_models::reloc {
 
+namespace {
+
+PointCloudPtr Voxelize(const PointCloud& cloud, double voxel_size) {
+  beam_filtering::VoxelDownsample voxel_filter(
+      Eigen::Vector3f(voxel_size, voxel_size, voxel_size));
+  voxel_filter.SetInputCloud(std::make_shared<PointCloud>(cloud));
+  voxel_filter.Filter();
+  return std::make_shared<PointCloud>(voxel_filter.GetFilteredCloud());
+}
+
+} // namespace
+
+void RelocRefinementBase::CoarseAlignmentParams::LoadFromJson(
+    const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("voxel_size")) { voxel_size = J["voxel_size"]; }
+  if (J.contains("max_iterations")) { max_iterations = J["max_iterations"]; }
+  if (J.contains("max_correspondence_distance")) {
+    max_correspondence_distance = J["max_correspondence_distance"];
+  }
+  if (J.contains("min_overlap")) { min_overlap = J["min_overlap"]; }
+  if (voxel_size <= 0 || max_iterations < 0) {
+    BEAM_ERROR("Invalid coarse_alignment params, voxel_size must be greater "
+               "than 0 and max_iterations cannot be negative");
+    throw std::runtime_error{"invalid json inputs"};
+  }
+}
+
 std::shared_ptr<RelocRefinementBase>
     RelocRefinementBase::Create(const std::string& config_path) {
   if (config_path.empty()) {
@@ -42,4 +79,63 @@ std::shared_ptr<RelocRefinementBase>
   }
 }
 
+bool RelocRefinementBase::CoarseAlign(const PointCloud& matched_cloud,
+                                      const PointCloud& query_cloud,
+                                      Eigen::Matrix4d& T_MATCH_QUERY,
+                                      RelocRefinementResults& results) const {
+  static bs_common::Metric& coarse_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "reloc_refinement/coarse");
+  static bs_common::Metric& rejected_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "reloc_refinement/coarse_rejected");
+  if (!coarse_params_.enabled) { return true; }
+  const auto start = std::chrono::steady_clock::now();
+
+  PointCloudPtr matched_coarse =
+      Voxelize(matched_cloud, coarse_params_.voxel_size);
+  PointCloudPtr query_coarse = Voxelize(query_cloud, coarse_params_.voxel_size);
+
+  PointCloud query_aligned;
+  if (coarse_params_.max_iterations > 0 && !matched_coarse->empty() &&
+      !query_coarse->empty()) {
+    pcl::IterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
+    icp.setInputSource(query_coarse);
+    icp.setInputTarget(matched_coarse);
+    icp.setMaximumIterations(coarse_params_.max_iterations);
+    icp.setMaxCorrespondenceDistance(
+        coarse_params_.max_correspondence_distance);
+    icp.align(query_aligned, T_MATCH_QUERY.cast<float>());
+    if (icp.hasConverged()) {
+      T_MATCH_QUERY = icp.getFinalTransformation().cast<double>();
+    } else {
+      bs_common::TransformCloud(*query_coarse, query_aligned, T_MATCH_QUERY);
+    }
+  } else {
+    bs_common::TransformCloud(*query_coarse, query_aligned, T_MATCH_QUERY);
+  }
+
+  // only the overlap of the precheck is used, degeneracy is expected for
+  // some reloc candidates and is left to the refinement
+  scan_registration::RegistrationPrecheck::Params precheck_params;
+  precheck_params.enabled = true;
+  precheck_params.voxel_size = coarse_params_.voxel_size;
+  scan_registration::RegistrationPrecheck precheck(precheck_params);
+  results.coarse_overlap =
+      precheck.Check({&query_aligned}, {matched_coarse.get()}).overlap;
+
+  const auto duration = std::chrono::steady_clock::now() - start;
+  coarse_metric.Record(duration);
+  results.coarse_time_s = std::chrono::duration<double>(duration).count();
+  if (results.coarse_overlap < coarse_params_.min_overlap) {
+    rejected_metric.Increment();
+    BEAM_INFO("Rejected reloc candidate after coarse alignment, overlap: {} "
+              "(min: {}), time: {}s",
+              results.coarse_overlap, coarse_params_.min_overlap,
+              results.coarse_time_s);
+    return false;
+  }
+  return true;
+}
+
 } // namespace bs_models::reloc
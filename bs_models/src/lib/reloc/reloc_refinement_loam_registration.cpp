@@ -1,5 +1,6 @@
 #include <bs_models/reloc/reloc_refinement_loam_registration.h>
 
+#include <chrono>
 #include <filesystem>
 
 #include <nlohmann/json.hpp>
@@ -7,6 +8,7 @@
 #include <beam_utils/filesystem.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/instrumentation.h>
 #include <bs_common/utils.h>
 
 namespace bs_models::reloc {
@@ -14,6 +16,17 @@ namespace bs_models::reloc {
 using namespace global_mapping;
 using namespace beam_matching;
 
+namespace {
+
+// strong features only, which is enough for the coarse alignment
+PointCloud StrongFeatures(const LoamPointCloud& cloud) {
+  PointCloud features = cloud.edges.strong.cloud;
+  features += cloud.surfaces.strong.cloud;
+  return features;
+}
+
+} // namespace
+
 RelocRefinementLoam::RelocRefinementLoam(const std::string& config)
     : RelocRefinementBase(config) {
   LoadConfig();
@@ -24,15 +37,23 @@ RelocRefinementResults RelocRefinementLoam::RunRefinement(
     const global_mapping::SubmapPtr& matched_submap,
     const global_mapping::SubmapPtr& query_submap,
     const Eigen::Matrix4d& T_MATCH_QUERY_EST, const std::string& output_path) {
-  // extract and filter clouds from matched submap
-  LoamPointCloud matched_submap_in_submap_frame(
-      matched_submap->GetLidarLoamPointsInWorldFrame(),
-      beam::InvertTransform(matched_submap->T_WORLD_SUBMAP()));
+  static bs_common::Metric& fine_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "reloc_refinement/fine");
+
+  // extract clouds in their submap frames, these are cached by the submaps
+  const LoamPointCloud matched_submap_in_submap_frame =
+      matched_submap->GetLidarLoamPointsInSubmapFrame();
+  const LoamPointCloud query_submap_in_submap_frame =
+      query_submap->GetLidarLoamPointsInSubmapFrame();
 
-  // extract and filter clouds from matched submap
-  LoamPointCloud query_submap_in_submap_frame(
-      query_submap->GetLidarLoamPointsInWorldFrame(),
-      beam::InvertTransform(query_submap->T_WORLD_SUBMAP()));
+  RelocRefinementResults results;
+  Eigen::Matrix4d T_MATCH_QUERY_COARSE = T_MATCH_QUERY_EST;
+  if (!CoarseAlign(StrongFeatures(matched_submap_in_submap_frame),
+                   StrongFeatures(query_submap_in_submap_frame),
+                   T_MATCH_QUERY_COARSE, results)) {
+    return results;
+  }
 
   // create output path
   std::string current_output_path;
@@ -50,13 +71,16 @@ RelocRefinementResults RelocRefinementLoam::RunRefinement(
   }
 
   // get refined transform
-  RelocRefinementResults results;
+  const auto start = std::chrono::steady_clock::now();
   Eigen::Matrix<double, 6, 6> covariance;
   results.successful = GetRefinedT_SUBMAP_QUERY(
       matched_submap_in_submap_frame, query_submap_in_submap_frame,
-      T_MATCH_QUERY_EST, current_output_path, results.T_MATCH_QUERY,
+      T_MATCH_QUERY_COARSE, current_output_path, results.T_MATCH_QUERY,
       covariance);
   results.covariance = covariance;
+  const auto duration = std::chrono::steady_clock::now() - start;
+  fine_metric.Record(duration);
+  results.fine_time_s = std::chrono::duration<double>(duration).count();
   return results;
 }
 
@@ -82,6 +106,10 @@ void RelocRefinementLoam::LoadConfig() {
   }
   matcher_config_ = beam::CombinePaths(bs_common::GetBeamSlamConfigPath(),
                                        matcher_config_rel);
+
+  if (J.contains("coarse_alignment")) {
+    coarse_params_.LoadFromJson(J["coarse_alignment"]);
+  }
 }
 
 void RelocRefinementLoam::Setup() {
@@ -0,0 +1,191 @@
+#include <bs_models/reloc/scan_context_accumulator.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <beam_matching/Scancontext.h>
+
+namespace bs_models::reloc {
+
+namespace {
+
+// value of empty bins, as in SCManager::makeScancontext
+constexpr double kNoPoint = -1000;
+
+// cells of the polar height maps per ring and per sector of the descriptor
+constexpr int kSubdivisions = 2;
+
+// the height maps extend past the max radius of the descriptor by this
+// factor, so that points of nearby scans which are within the max radius of a
+// neighbouring keyframe are kept
+constexpr double kHeightMapRadiusFactor = 1.5;
+
+double Azimuth(double x, double y) {
+  double theta = std::atan2(y, x) * 180.0 / M_PI;
+  if (theta < 0) { theta += 360.0; }
+  return theta;
+}
+
+} // namespace
+
+ScanContextAccumulator::ScanContextAccumulator(int num_scans_aggregated)
+    : num_scans_aggregated_(num_scans_aggregated) {
+  // use the params of the scan context manager so the descriptors match the
+  // ones it computes
+  beam_matching::SCManager sc_manager;
+  num_rings_ = sc_manager.PC_NUM_RING;
+  num_sectors_ = sc_manager.PC_NUM_SECTOR;
+  max_radius_m_ = sc_manager.PC_MAX_RADIUS;
+  lidar_height_m_ = sc_manager.LIDAR_HEIGHT;
+}
+
+void ScanContextAccumulator::AddScan(uint64_t stamp,
+                                     const Eigen::Matrix4d& T_REFFRAME_LIDAR,
+                                     const PointCloud& cloud) {
+  if (!Enabled()) { return; }
+
+  auto [iter, inserted] = scans_.try_emplace(stamp);
+  Scan& scan = iter->second;
+  if (inserted) {
+    scan.T_REFFRAME_LIDAR = T_REFFRAME_LIDAR;
+    scan.descriptor =
+        Eigen::MatrixXd::Constant(num_rings_, num_sectors_, kNoPoint);
+  }
+  const std::vector<Eigen::Vector3f> points = UpdateHeightMap(scan, cloud);
+
+  // a keyframe inserted before the last one shifts the neighbours of the
+  // keyframes around it, which may lose one, so these are recomputed
+  if (inserted && std::next(iter) != scans_.end()) {
+    auto [first, last] = Neighbours(iter);
+    for (auto it = first; it != last; it++) { Rebuild(it); }
+    return;
+  }
+
+  if (inserted) { Rebuild(iter); }
+  auto [first, last] = Neighbours(iter);
+  for (auto it = first; it != last; it++) {
+    if (inserted && it == iter) { continue; }
+    Bin(points, scan, it->second);
+  }
+}
+
+std::vector<uint64_t> ScanContextAccumulator::Stamps() const {
+  std::vector<uint64_t> stamps;
+  stamps.reserve(scans_.size());
+  for (const auto& [stamp, scan] : scans_) { stamps.push_back(stamp); }
+  return stamps;
+}
+
+std::map<uint64_t, Eigen::MatrixXd>
+    ScanContextAccumulator::Descriptors() const {
+  std::map<uint64_t, Eigen::MatrixXd> descriptors;
+  for (const auto& [stamp, scan] : scans_) {
+    descriptors.emplace(stamp, (scan.descriptor.array() == kNoPoint)
+                                   .select(0, scan.descriptor));
+  }
+  return descriptors;
+}
+
+std::vector<Eigen::Vector3f>
+    ScanContextAccumulator::UpdateHeightMap(Scan& scan,
+                                            const PointCloud& cloud) const {
+  // the cells nest in the bins of the descriptor, which use the same ceil
+  // based indexing
+  const int num_rings = static_cast<int>(
+      std::ceil(kHeightMapRadiusFactor * num_rings_ * kSubdivisions));
+  const int num_sectors = num_sectors_ * kSubdivisions;
+  const double max_radius_m = kHeightMapRadiusFactor * max_radius_m_;
+  std::map<int, Eigen::Vector3f> highest;
+  for (const auto& p : cloud) {
+    const double range = std::sqrt(p.x * p.x + p.y * p.y);
+    if (!std::isfinite(range) || range > max_radius_m) { continue; }
+    const int ring = std::min<int>(
+        num_rings, std::ceil(range / max_radius_m * num_rings));
+    const int sector = std::min<int>(
+        num_sectors, std::ceil(Azimuth(p.x, p.y) / 360.0 * num_sectors));
+    const int cell = ring * (num_sectors + 1) + sector;
+    auto [iter, inserted] =
+        highest.try_emplace(cell, Eigen::Vector3f(p.x, p.y, p.z));
+    if (!inserted && iter->second.z() < p.z) {
+      iter->second = Eigen::Vector3f(p.x, p.y, p.z);
+    }
+  }
+
+  // merge into the sorted height map, keeping the highest point of each cell
+  std::vector<Eigen::Vector3f> updated;
+  std::vector<std::pair<int, Eigen::Vector3f>> merged;
+  merged.reserve(scan.height_map.size() + highest.size());
+  auto iter = scan.height_map.begin();
+  for (const auto& [cell, point] : highest) {
+    while (iter != scan.height_map.end() && iter->first < cell) {
+      merged.push_back(*iter++);
+    }
+    if (iter != scan.height_map.end() && iter->first == cell) {
+      if (iter->second.z() >= point.z()) {
+        merged.push_back(*iter++);
+        continue;
+      }
+      iter++;
+    }
+    merged.emplace_back(cell, point);
+    updated.push_back(point);
+  }
+  merged.insert(merged.end(), iter, scan.height_map.end());
+  scan.height_map = std::move(merged);
+  return updated;
+}
+
+void ScanContextAccumulator::Bin(const Eigen::Vector3f& point,
+                                 Eigen::MatrixXd& descriptor) const {
+  const double range = std::sqrt(point.x() * point.x() + point.y() * point.y());
+  if (range > max_radius_m_) { return; }
+  const int ring = std::max(
+      std::min<int>(num_rings_, std::ceil(range / max_radius_m_ * num_rings_)),
+      1);
+  const int sector = std::max(
+      std::min<int>(num_sectors_, std::ceil(Azimuth(point.x(), point.y()) /
+                                            360.0 * num_sectors_)),
+      1);
+  double& height = descriptor(ring - 1, sector - 1);
+  height = std::max(height, point.z() + lidar_height_m_);
+}
+
+void ScanContextAccumulator::Bin(const std::vector<Eigen::Vector3f>& points,
+                                 const Scan& source, Scan& target) const {
+  const Eigen::Matrix4f T_TARGET_SOURCE =
+      (target.T_REFFRAME_LIDAR.inverse() * source.T_REFFRAME_LIDAR)
+          .cast<float>();
+  const Eigen::Matrix3f R = T_TARGET_SOURCE.block<3, 3>(0, 0);
+  const Eigen::Vector3f t = T_TARGET_SOURCE.block<3, 1>(0, 3);
+  for (const Eigen::Vector3f& point : points) {
+    Bin(R * point + t, target.descriptor);
+  }
+}
+
+void ScanContextAccumulator::Rebuild(ScanIter target) {
+  Scan& scan = target->second;
+  scan.descriptor.setConstant(kNoPoint);
+  auto [first, last] = Neighbours(target);
+  std::vector<Eigen::Vector3f> points;
+  for (auto it = first; it != last; it++) {
+    points.clear();
+    for (const auto& [cell, point] : it->second.height_map) {
+      points.push_back(point);
+    }
+    Bin(points, it->second, scan);
+  }
+}
+
+std::pair<ScanContextAccumulator::ScanIter, ScanContextAccumulator::ScanIter>
+    ScanContextAccumulator::Neighbours(ScanIter center) {
+  const int half_window = num_scans_aggregated_ / 2;
+  ScanIter first = center;
+  ScanIter last = std::next(center);
+  for (int i = 0; i < half_window; i++) {
+    if (first != scans_.begin()) { first--; }
+    if (last != scans_.end()) { last++; }
+  }
+  return {first, last};
+}
+
+} // namespace bs_models::reloc
@@ -0,0 +1,104 @@
+#include <bs_models/reloc/scan_context_index.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace bs_models::reloc {
+
+ScanContextIndex::ScanContextIndex(
+    const std::vector<Eigen::MatrixXd>& descriptors) {
+  if (descriptors.empty()) { return; }
+  num_rings_ = descriptors.front().rows();
+  descriptors_.reserve(descriptors.size());
+  ring_keys_.reserve(descriptors.size() * num_rings_);
+  for (const auto& descriptor : descriptors) {
+    descriptors_.push_back(Normalize(descriptor));
+    const Eigen::VectorXf ring_key =
+        descriptor.rowwise().mean().cast<float>();
+    ring_keys_.insert(ring_keys_.end(), ring_key.data(),
+                      ring_key.data() + ring_key.size());
+  }
+
+  // the tree references ring_keys_, which is not modified after this
+  flann::Matrix<float> dataset(ring_keys_.data(), descriptors_.size(),
+                               num_rings_);
+  tree_ = std::make_unique<flann::Index<flann::L2<float>>>(
+      dataset, flann::KDTreeSingleIndexParams(10));
+  tree_->buildIndex();
+}
+
+std::pair<int, double>
+    ScanContextIndex::Query(const Eigen::MatrixXd& descriptor,
+                            int num_candidates) const {
+  if (descriptors_.empty() || descriptor.rows() != num_rings_) {
+    return {-1, std::numeric_limits<double>::max()};
+  }
+
+  Eigen::VectorXf ring_key = descriptor.rowwise().mean().cast<float>();
+  flann::Matrix<float> query(ring_key.data(), 1, num_rings_);
+  const size_t k = std::min<size_t>(std::max(num_candidates, 1),
+                                    descriptors_.size());
+  std::vector<std::vector<int>> indices;
+  std::vector<std::vector<float>> distances;
+  tree_->knnSearch(query, indices, distances, k,
+                   flann::SearchParams(flann::FLANN_CHECKS_UNLIMITED));
+
+  const NormalizedDescriptor query_normalized = Normalize(descriptor);
+  std::pair<int, double> best{-1, std::numeric_limits<double>::max()};
+  for (const int i : indices.front()) {
+    const double distance = Distance(query_normalized, descriptors_.at(i));
+    if (distance < best.second) { best = {i, distance}; }
+  }
+  return best;
+}
+
+double ScanContextIndex::Distance(const Eigen::MatrixXd& sc1,
+                                  const Eigen::MatrixXd& sc2) {
+  return Distance(Normalize(sc1), Normalize(sc2));
+}
+
+ScanContextIndex::NormalizedDescriptor
+    ScanContextIndex::Normalize(const Eigen::MatrixXd& descriptor) {
+  NormalizedDescriptor normalized;
+  normalized.sectors = descriptor;
+  normalized.valid = Eigen::VectorXd::Zero(descriptor.cols());
+  for (int j = 0; j < descriptor.cols(); j++) {
+    const double norm = descriptor.col(j).norm();
+    if (norm == 0) { continue; }
+    normalized.sectors.col(j) /= norm;
+    normalized.valid[j] = 1;
+  }
+  return normalized;
+}
+
+double ScanContextIndex::Distance(const NormalizedDescriptor& sc1,
+                                  const NormalizedDescriptor& sc2) {
+  const int num_sectors = sc1.sectors.cols();
+  if (sc2.sectors.cols() != num_sectors ||
+      sc2.sectors.rows() != sc1.sectors.rows()) {
+    return std::numeric_limits<double>::max();
+  }
+
+  // cosine distances and validity of all sector pairs, computed with two
+  // matrix products instead of one column comparison per shift and sector
+  const Eigen::MatrixXd valid = sc1.valid * sc2.valid.transpose();
+  const Eigen::MatrixXd distances =
+      valid.cwiseProduct(Eigen::MatrixXd::Ones(num_sectors, num_sectors) -
+                         sc1.sectors.transpose() * sc2.sectors);
+
+  // shifting sc2 by s compares sector j of sc1 to sector (j + s) of sc2
+  double min_distance = std::numeric_limits<double>::max();
+  for (int shift = 0; shift < num_sectors; shift++) {
+    double sum = 0;
+    double count = 0;
+    for (int j = 0; j < num_sectors; j++) {
+      const int k = (j + shift) % num_sectors;
+      sum += distances(j, k);
+      count += valid(j, k);
+    }
+    if (count > 0) { min_distance = std::min(min_distance, sum / count); }
+  }
+  return min_distance;
+}
+
+} // namespace bs_models::reloc
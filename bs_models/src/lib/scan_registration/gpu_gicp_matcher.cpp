@@ -0,0 +1,321 @@
+#include <bs_models/scan_registration/gpu_gicp_matcher.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <nlohmann/json.hpp>
+
+#include <beam_utils/log.h>
+#include <beam_utils/math.h>
+#include <beam_utils/utils.h>
+
+#ifdef BS_MODELS_WITH_CUDA
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudafeatures2d.hpp>
+#endif
+
+namespace bs_models { namespace scan_registration {
+
+void GpuGicpMatcher::Params::LoadFromJson(const std::string& matcher_config) {
+  nlohmann::json J;
+  if (!beam::ReadJson(matcher_config, J)) {
+    BEAM_ERROR("Unable to read matcher config: {}", matcher_config);
+    throw std::runtime_error{"Unable to read config"};
+  }
+  // same meaning as in the CPU matcher config
+  if (J.contains("corr_rand")) { covariance_neighbours = J["corr_rand"]; }
+  if (J.contains("max_iter")) { max_iterations = J["max_iter"]; }
+
+  // only used by this backend
+  if (J.contains("max_corr_dist")) {
+    max_correspondence_distance = J["max_corr_dist"];
+  }
+  if (J.contains("rot_eps")) { rotation_epsilon = J["rot_eps"]; }
+  if (J.contains("trans_eps")) { translation_epsilon = J["trans_eps"]; }
+  if (J.contains("min_corr")) { min_correspondences = J["min_corr"]; }
+}
+
+bool GpuGicpMatcher::RequestedInConfig(const std::string& matcher_config) {
+  nlohmann::json J;
+  if (!beam::ReadJson(matcher_config, J) || !J.contains("backend")) {
+    return false;
+  }
+  const std::string backend = J["backend"];
+  if (backend != "CPU" && backend != "CUDA") {
+    BEAM_ERROR("Invalid matcher backend: {}, options: CPU, CUDA. Using CPU.",
+               backend);
+  }
+  return backend == "CUDA";
+}
+
+#ifdef BS_MODELS_WITH_CUDA
+
+namespace {
+
+// the brute force knn search of OpenCV keeps the distances of all pairs of a
+// batch of queries, so large clouds are searched in batches of this size
+constexpr size_t kMaxDistanceBytes = 64 * 1024 * 1024;
+
+bool IsFinite(const pcl::PointXYZ& p) {
+  return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+} // namespace
+
+struct GpuGicpMatcher::DeviceState {
+  cv::cuda::Stream stream;
+  cv::cuda::HostMem staging{cv::cuda::HostMem::PAGE_LOCKED};
+  cv::cuda::GpuMat query;
+  cv::cuda::GpuMat matches;
+  cv::Ptr<cv::cuda::DescriptorMatcher> matcher;
+
+  /**
+   * @brief upload points as the rows of a N x 3 float matrix, through page
+   * locked memory
+   */
+  void Upload(const PointCloud& cloud, const Eigen::Matrix4d& T,
+              cv::cuda::GpuMat& points) {
+    // the previous upload may still read the staging memory
+    stream.waitForCompletion();
+    if (cloud.empty()) {
+      points.release();
+      return;
+    }
+    staging.create(cloud.size(), 3, CV_32F);
+    cv::Mat host = staging.createMatHeader();
+    const Eigen::Matrix3f R = T.block<3, 3>(0, 0).cast<float>();
+    const Eigen::Vector3f t = T.block<3, 1>(0, 3).cast<float>();
+    for (size_t i = 0; i < cloud.size(); i++) {
+      Eigen::Map<Eigen::Vector3f>(host.ptr<float>(i)) =
+          R * cloud[i].getVector3fMap() + t;
+    }
+    points.upload(host, stream);
+  }
+
+  /**
+   * @brief search the k nearest neighbours in train of each row of query
+   * @param indices output, k indices per query, -1 and last if missing
+   * @param distances output, k distances per query
+   */
+  void Search(const cv::cuda::GpuMat& query_points,
+              const cv::cuda::GpuMat& train_points, int k,
+              std::vector<int>& indices, std::vector<float>& distances) {
+    indices.assign(query_points.rows * k, -1);
+    distances.assign(query_points.rows * k,
+                     std::numeric_limits<float>::max());
+    if (query_points.empty() || train_points.empty()) { return; }
+
+    if (k == 1) {
+      std::vector<cv::DMatch> result;
+      matcher->matchAsync(query_points, train_points, matches, cv::noArray(),
+                          stream);
+      stream.waitForCompletion();
+      matcher->matchConvert(matches, result);
+      for (const auto& match : result) {
+        indices[match.queryIdx] = match.trainIdx;
+        distances[match.queryIdx] = match.distance;
+      }
+      return;
+    }
+
+    const int batch = std::max<int>(
+        1, kMaxDistanceBytes / (sizeof(float) * train_points.rows));
+    std::vector<std::vector<cv::DMatch>> result;
+    for (int start = 0; start < query_points.rows; start += batch) {
+      const int end = std::min(start + batch, query_points.rows);
+      matcher->knnMatchAsync(query_points.rowRange(start, end), train_points,
+                             matches, k, cv::noArray(), stream);
+      stream.waitForCompletion();
+      matcher->knnMatchConvert(matches, result);
+      for (const auto& knn : result) {
+        for (size_t j = 0; j < knn.size(); j++) {
+          const size_t i = (start + knn[j].queryIdx) * k + j;
+          indices[i] = knn[j].trainIdx;
+          distances[i] = knn[j].distance;
+        }
+      }
+    }
+  }
+};
+
+struct GpuGicpMatcher::DeviceCloud {
+  PointCloud points;
+  PointCovariances covariances;
+  cv::cuda::GpuMat device_points;
+};
+
+bool GpuGicpMatcher::Available() {
+  return cv::cuda::getCudaEnabledDeviceCount() > 0;
+}
+
+#else
+
+struct GpuGicpMatcher::DeviceState {};
+
+struct GpuGicpMatcher::DeviceCloud {};
+
+bool GpuGicpMatcher::Available() {
+  return false;
+}
+
+#endif
+
+GpuGicpMatcher::GpuGicpMatcher(const Params& params) : params_(params) {
+  if (!Available()) {
+    BEAM_ERROR("GPU GICP matcher requires OpenCV with CUDA and a CUDA device");
+    throw std::runtime_error{"GPU GICP matcher is not available"};
+  }
+
+  device_ = std::make_unique<DeviceState>();
+#ifdef BS_MODELS_WITH_CUDA
+  device_->matcher = cv::cuda::DescriptorMatcher::createBFMatcher(cv::NORM_L2);
+#endif
+}
+
+GpuGicpMatcher::~GpuGicpMatcher() = default;
+
+bool GpuGicpMatcher::Match(uint64_t ref_key, const PointCloud& ref,
+                           uint64_t tgt_key, const PointCloud& tgt,
+                           const Eigen::Matrix4d& T_REF_TGT_init,
+                           Result& result) {
+#ifdef BS_MODELS_WITH_CUDA
+  if (params_.max_iterations < 1) { return false; }
+
+  // the clouds are kept alive by these if they are released meanwhile
+  std::shared_ptr<const DeviceCloud> ref_cloud;
+  std::shared_ptr<const DeviceCloud> tgt_cloud;
+  {
+    std::lock_guard<std::mutex> lock(device_mutex_);
+    ref_cloud = GetCloud(ref_key, ref);
+    tgt_cloud = GetCloud(tgt_key, tgt);
+  }
+  const PointCloud& ref_points = ref_cloud->points;
+  const PointCloud& tgt_points = tgt_cloud->points;
+
+  // the target points are perturbed as p = R * exp(dR) * q + t + dt, so the
+  // Jacobian of a residual e = r - p is [-I, R * [q]x], ordered as
+  // (translation, rotation) like HessianCovariance
+  const float max_distance = params_.max_correspondence_distance;
+  Eigen::Matrix3d R = T_REF_TGT_init.block<3, 3>(0, 0);
+  Eigen::Vector3d t = T_REF_TGT_init.block<3, 1>(0, 3);
+  Eigen::Matrix<double, 6, 6> H;
+  double chi2{0};
+  int num_correspondences{0};
+  std::vector<int> indices;
+  std::vector<float> distances;
+  int iteration = 0;
+  while (iteration < params_.max_iterations) {
+    iteration++;
+    Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+    T.block<3, 3>(0, 0) = R;
+    T.block<3, 1>(0, 3) = t;
+    {
+      std::lock_guard<std::mutex> lock(device_mutex_);
+      device_->Upload(tgt_points, T, device_->query);
+      device_->Search(device_->query, ref_cloud->device_points, 1, indices,
+                      distances);
+    }
+
+    H.setZero();
+    Eigen::Matrix<double, 6, 1> b = Eigen::Matrix<double, 6, 1>::Zero();
+    chi2 = 0;
+    num_correspondences = 0;
+    for (size_t i = 0; i < tgt_points.size(); i++) {
+      if (indices[i] < 0 || distances[i] > max_distance) { continue; }
+      const Eigen::Vector3d q = tgt_points[i].getVector3fMap().cast<double>();
+      const Eigen::Vector3d p = R * q + t;
+      const Eigen::Vector3d e =
+          ref_points[indices[i]].getVector3fMap().cast<double>() - p;
+      const Eigen::Matrix3d C =
+          ref_cloud->covariances.covariances[indices[i]].cast<double>() +
+          R * tgt_cloud->covariances.covariances[i].cast<double>() *
+              R.transpose();
+      const Eigen::Matrix3d M = C.inverse();
+
+      Eigen::Matrix<double, 3, 6> J;
+      J.block<3, 3>(0, 0) = -Eigen::Matrix3d::Identity();
+      J.block<3, 3>(0, 3) = R * beam::SkewTransform(q);
+      H += J.transpose() * M * J;
+      b += J.transpose() * M * e;
+      chi2 += e.dot(M * e);
+      num_correspondences++;
+    }
+    if (num_correspondences < params_.min_correspondences) {
+      BEAM_WARN("GPU GICP found {} correspondences, min is {}",
+                num_correspondences, params_.min_correspondences);
+      return false;
+    }
+
+    const Eigen::Matrix<double, 6, 1> delta = H.ldlt().solve(-b);
+    if (!delta.allFinite()) { return false; }
+    const Eigen::Vector3d dt = delta.head<3>();
+    const Eigen::Vector3d dR = delta.tail<3>();
+    t += dt;
+    if (dR.norm() > 0) {
+      R = R * Eigen::AngleAxisd(dR.norm(), dR.normalized()).toRotationMatrix();
+    }
+    if (dR.norm() < params_.rotation_epsilon &&
+        dt.norm() < params_.translation_epsilon) {
+      break;
+    }
+  }
+
+  result.T_REF_TGT.setIdentity();
+  result.T_REF_TGT.block<3, 3>(0, 0) = R;
+  result.T_REF_TGT.block<3, 1>(0, 3) = t;
+  const int dof = std::max(3 * num_correspondences - 6, 1);
+  result.covariance = chi2 / dof * H.inverse();
+  result.iterations = iteration;
+  result.correspondences = num_correspondences;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void GpuGicpMatcher::Retain(const std::unordered_set<uint64_t>& keys) {
+  std::lock_guard<std::mutex> lock(device_mutex_);
+  for (auto iter = clouds_.begin(); iter != clouds_.end();) {
+    if (keys.count(iter->first) == 0) {
+      iter = clouds_.erase(iter);
+    } else {
+      iter++;
+    }
+  }
+}
+
+size_t GpuGicpMatcher::NumClouds() const {
+  std::lock_guard<std::mutex> lock(device_mutex_);
+  return clouds_.size();
+}
+
+std::shared_ptr<const GpuGicpMatcher::DeviceCloud>
+    GpuGicpMatcher::GetCloud(uint64_t key, const PointCloud& cloud) {
+  auto iter = clouds_.find(key);
+  if (iter != clouds_.end()) { return iter->second; }
+
+  auto device_cloud = std::make_shared<DeviceCloud>();
+#ifdef BS_MODELS_WITH_CUDA
+  // the knn search has no notion of invalid points
+  device_cloud->points.reserve(cloud.size());
+  for (const auto& p : cloud) {
+    if (IsFinite(p)) { device_cloud->points.push_back(p); }
+  }
+  device_->Upload(device_cloud->points, Eigen::Matrix4d::Identity(),
+                  device_cloud->device_points);
+
+  std::vector<int> neighbours;
+  std::vector<float> distances;
+  const int k = std::min<int>(params_.covariance_neighbours,
+                              device_cloud->points.size());
+  device_->Search(device_cloud->device_points, device_cloud->device_points, k,
+                  neighbours, distances);
+  ComputePointCovariances(device_cloud->points, neighbours, k,
+                          device_cloud->covariances);
+#endif
+  clouds_.emplace(key, device_cloud);
+  return device_cloud;
+}
+
+}} // namespace bs_models::scan_registration
@@ -0,0 +1,183 @@
+#include <bs_models/scan_registration/hessian_covariance.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <beam_utils/math.h>
+
+#include <bs_models/scan_registration/voxel_key.h>
+
+namespace bs_models { namespace scan_registration {
+
+namespace {
+
+bool IsFinite(const pcl::PointXYZ& p) {
+  return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+struct VoxelStats {
+  Eigen::Vector3d sum{Eigen::Vector3d::Zero()};
+  Eigen::Matrix3d sum_sq{Eigen::Matrix3d::Zero()};
+  int count{0};
+};
+
+std::unordered_map<uint64_t, VoxelStats>
+    BinPoints(const std::vector<const PointCloud*>& clouds, double voxel_size) {
+  std::unordered_map<uint64_t, VoxelStats> voxels;
+  for (const PointCloud* cloud : clouds) {
+    for (const auto& p : *cloud) {
+      if (!IsFinite(p)) { continue; }
+      const Eigen::Vector3d v(p.x, p.y, p.z);
+      VoxelStats& voxel = voxels[VoxelKey(v, voxel_size)];
+      voxel.sum += v;
+      voxel.sum_sq += v * v.transpose();
+      voxel.count++;
+    }
+  }
+  return voxels;
+}
+
+} // namespace
+
+void HessianCovariance::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("voxel_size")) { voxel_size = J["voxel_size"]; }
+  if (J.contains("min_points_per_voxel")) {
+    min_points_per_voxel = J["min_points_per_voxel"];
+  }
+  if (J.contains("planarity_threshold")) {
+    planarity_threshold = J["planarity_threshold"];
+  }
+  if (J.contains("linearity_threshold")) {
+    linearity_threshold = J["linearity_threshold"];
+  }
+  if (J.contains("max_residual_m")) { max_residual_m = J["max_residual_m"]; }
+  if (J.contains("min_residual_std_m")) {
+    min_residual_std_m = J["min_residual_std_m"];
+  }
+  if (J.contains("min_correspondences")) {
+    min_correspondences = J["min_correspondences"];
+  }
+  if (J.contains("min_information")) {
+    min_information = J["min_information"];
+  }
+}
+
+void HessianCovariance::Params::Print(std::ostream& stream) const {
+  stream << "HessianCovariance::Params: \n";
+  stream << "enabled: " << enabled << "\n";
+  stream << "voxel_size: " << voxel_size << "\n";
+  stream << "min_points_per_voxel: " << min_points_per_voxel << "\n";
+  stream << "planarity_threshold: " << planarity_threshold << "\n";
+  stream << "linearity_threshold: " << linearity_threshold << "\n";
+  stream << "max_residual_m: " << max_residual_m << "\n";
+  stream << "min_residual_std_m: " << min_residual_std_m << "\n";
+  stream << "min_correspondences: " << min_correspondences << "\n";
+  stream << "min_information: " << min_information << "\n";
+}
+
+void HessianCovariance::SetReference(
+    const std::vector<const PointCloud*>& plane_clouds,
+    const std::vector<const PointCloud*>& line_clouds) {
+  planes_.clear();
+  lines_.clear();
+
+  // eigenvalues are in increasing order
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+  for (const auto& [key, voxel] :
+       BinPoints(plane_clouds, params_.voxel_size)) {
+    if (voxel.count < params_.min_points_per_voxel) { continue; }
+    const Eigen::Vector3d mean = voxel.sum / voxel.count;
+    solver.computeDirect(voxel.sum_sq / voxel.count - mean * mean.transpose());
+    const Eigen::Vector3d& eigenvalues = solver.eigenvalues();
+    if (eigenvalues[0] >= params_.planarity_threshold * eigenvalues[1]) {
+      continue;
+    }
+    planes_.emplace(key, Feature{mean, solver.eigenvectors().col(0)});
+  }
+  for (const auto& [key, voxel] : BinPoints(line_clouds, params_.voxel_size)) {
+    if (voxel.count < params_.min_points_per_voxel) { continue; }
+    const Eigen::Vector3d mean = voxel.sum / voxel.count;
+    solver.computeDirect(voxel.sum_sq / voxel.count - mean * mean.transpose());
+    const Eigen::Vector3d& eigenvalues = solver.eigenvalues();
+    if (eigenvalues[1] >= params_.linearity_threshold * eigenvalues[2]) {
+      continue;
+    }
+    lines_.emplace(key, Feature{mean, solver.eigenvectors().col(2)});
+  }
+}
+
+bool HessianCovariance::Compute(
+    const std::vector<const PointCloud*>& plane_clouds,
+    const std::vector<const PointCloud*>& line_clouds,
+    const Eigen::Matrix4d& T_REF_TARGET,
+    Eigen::Matrix<double, 6, 6>& covariance) {
+  const Eigen::Matrix3d R = T_REF_TARGET.block<3, 3>(0, 0);
+  const Eigen::Vector3d t = T_REF_TARGET.block<3, 1>(0, 3);
+
+  // the target points are perturbed as p = R * exp(dR) * q + t + dt, so the
+  // Jacobian of a residual e(p) is [de/dp, -de/dp * R * [q]x]
+  Eigen::Matrix<double, 6, 6> H = Eigen::Matrix<double, 6, 6>::Zero();
+  double sum_sq = 0;
+  int num_residuals = 0;
+  num_correspondences_ = 0;
+  for (const PointCloud* cloud : plane_clouds) {
+    for (const auto& point : *cloud) {
+      if (!IsFinite(point)) { continue; }
+      const Eigen::Vector3d q(point.x, point.y, point.z);
+      const Eigen::Vector3d p = R * q + t;
+      auto iter = planes_.find(VoxelKey(p, params_.voxel_size));
+      if (iter == planes_.end()) { continue; }
+      const Feature& plane = iter->second;
+      const double r = plane.direction.dot(p - plane.mean);
+      if (std::abs(r) > params_.max_residual_m) { continue; }
+      Eigen::Matrix<double, 1, 6> J;
+      J.head<3>() = plane.direction.transpose();
+      J.tail<3>() = q.cross(R.transpose() * plane.direction).transpose();
+      H += J.transpose() * J;
+      sum_sq += r * r;
+      num_residuals++;
+      num_correspondences_++;
+    }
+  }
+  for (const PointCloud* cloud : line_clouds) {
+    for (const auto& point : *cloud) {
+      if (!IsFinite(point)) { continue; }
+      const Eigen::Vector3d q(point.x, point.y, point.z);
+      const Eigen::Vector3d p = R * q + t;
+      auto iter = lines_.find(VoxelKey(p, params_.voxel_size));
+      if (iter == lines_.end()) { continue; }
+      const Feature& line = iter->second;
+      const Eigen::Matrix3d P = Eigen::Matrix3d::Identity() -
+                                line.direction * line.direction.transpose();
+      const Eigen::Vector3d e = P * (p - line.mean);
+      if (e.norm() > params_.max_residual_m) { continue; }
+      Eigen::Matrix<double, 3, 6> J;
+      J.leftCols<3>() = P;
+      J.rightCols<3>() = -P * R * beam::SkewTransform(q);
+      H += J.transpose() * J;
+      sum_sq += e.squaredNorm();
+      num_residuals += 2;
+      num_correspondences_++;
+    }
+  }
+
+  if (num_correspondences_ < params_.min_correspondences ||
+      num_residuals <= 6) {
+    return false;
+  }
+
+  const double min_variance =
+      params_.min_residual_std_m * params_.min_residual_std_m;
+  const double variance =
+      std::max(sum_sq / (num_residuals - 6), min_variance);
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> solver(H);
+  const Eigen::Matrix<double, 6, 1> information =
+      solver.eigenvalues().cwiseMax(params_.min_information);
+  covariance = variance * solver.eigenvectors() *
+               information.cwiseInverse().asDiagonal() *
+               solver.eigenvectors().transpose();
+  return true;
+}
+
+}} // namespace bs_models::scan_registration
@@ -0,0 +1,322 @@
+#include <bs_models/scan_registration/loam_solver.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <beam_utils/angles.h>
+#include <beam_utils/log.h>
+
+namespace bs_models { namespace scan_registration {
+
+namespace {
+
+bool IsFinite(const pcl::PointXYZ& p) {
+  return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+/**
+ * @brief rotation angle of a rotation matrix, in degrees
+ */
+double RotationDeg(const Eigen::Matrix3d& R) {
+  return beam::Rad2Deg(Eigen::AngleAxisd(R).angle());
+}
+
+} // namespace
+
+void LoamSolver::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("max_iterations")) { max_iterations = J["max_iterations"]; }
+  if (J.contains("num_neighbors")) { num_neighbors = J["num_neighbors"]; }
+  if (J.contains("max_correspondence_distance_m")) {
+    max_correspondence_distance_m = J["max_correspondence_distance_m"];
+  }
+  if (J.contains("linearity_threshold")) {
+    linearity_threshold = J["linearity_threshold"];
+  }
+  if (J.contains("planarity_threshold")) {
+    planarity_threshold = J["planarity_threshold"];
+  }
+  if (J.contains("huber_delta_m")) { huber_delta_m = J["huber_delta_m"]; }
+  if (J.contains("reuse_correspondences_trans_m")) {
+    reuse_correspondences_trans_m = J["reuse_correspondences_trans_m"];
+  }
+  if (J.contains("reuse_correspondences_rot_deg")) {
+    reuse_correspondences_rot_deg = J["reuse_correspondences_rot_deg"];
+  }
+  if (J.contains("convergence_trans_m")) {
+    convergence_trans_m = J["convergence_trans_m"];
+  }
+  if (J.contains("convergence_rot_deg")) {
+    convergence_rot_deg = J["convergence_rot_deg"];
+  }
+  if (J.contains("min_residuals")) { min_residuals = J["min_residuals"]; }
+  if (J.contains("min_residual_std_m")) {
+    min_residual_std_m = J["min_residual_std_m"];
+  }
+  if (J.contains("min_information")) {
+    min_information = J["min_information"];
+  }
+  if (num_neighbors < 3 || max_iterations < 1 || huber_delta_m <= 0) {
+    BEAM_ERROR("LoamSolver needs num_neighbors >= 3, max_iterations >= 1 and "
+               "a positive huber_delta_m");
+    throw std::invalid_argument{"invalid loam solver params"};
+  }
+}
+
+void LoamSolver::Params::Print(std::ostream& stream) const {
+  stream << "LoamSolver::Params: \n";
+  stream << "enabled: " << enabled << "\n";
+  stream << "max_iterations: " << max_iterations << "\n";
+  stream << "num_neighbors: " << num_neighbors << "\n";
+  stream << "max_correspondence_distance_m: " << max_correspondence_distance_m
+         << "\n";
+  stream << "linearity_threshold: " << linearity_threshold << "\n";
+  stream << "planarity_threshold: " << planarity_threshold << "\n";
+  stream << "huber_delta_m: " << huber_delta_m << "\n";
+  stream << "reuse_correspondences_trans_m: " << reuse_correspondences_trans_m
+         << "\n";
+  stream << "reuse_correspondences_rot_deg: " << reuse_correspondences_rot_deg
+         << "\n";
+  stream << "convergence_trans_m: " << convergence_trans_m << "\n";
+  stream << "convergence_rot_deg: " << convergence_rot_deg << "\n";
+  stream << "min_residuals: " << min_residuals << "\n";
+  stream << "min_residual_std_m: " << min_residual_std_m << "\n";
+  stream << "min_information: " << min_information << "\n";
+}
+
+void LoamSolver::Residuals::Clear() {
+  for (auto* v : {&qx, &qy, &qz, &nx, &ny, &nz, &d}) { v->clear(); }
+}
+
+void LoamSolver::Residuals::Add(const Eigen::Vector3d& q,
+                                const Eigen::Vector3d& n, double _d) {
+  qx.push_back(q.x());
+  qy.push_back(q.y());
+  qz.push_back(q.z());
+  nx.push_back(n.x());
+  ny.push_back(n.y());
+  nz.push_back(n.z());
+  d.push_back(_d);
+}
+
+void LoamSolver::FeatureTree::Build(
+    const std::vector<const PointCloud*>& clouds) {
+  cloud = std::make_shared<PointCloud>();
+  for (const PointCloud* c : clouds) {
+    for (const auto& p : *c) {
+      if (IsFinite(p)) { cloud->push_back(p); }
+    }
+  }
+  empty = cloud->empty();
+  if (!empty) { kdtree.setInputCloud(cloud); }
+}
+
+LoamSolver::LoamSolver(const Params& params) : params_(params) {}
+
+void LoamSolver::SetRef(const beam_matching::LoamPointCloudPtr& ref) {
+  ref_edges_.Build({&ref->edges.strong.cloud, &ref->edges.weak.cloud});
+  ref_surfaces_.Build(
+      {&ref->surfaces.strong.cloud, &ref->surfaces.weak.cloud});
+}
+
+void LoamSolver::SetTarget(const beam_matching::LoamPointCloud& target) {
+  target_ = &target;
+}
+
+bool LoamSolver::Match(const Eigen::Matrix4d& T_REF_TARGET_INIT) {
+  num_iterations_ = 0;
+  num_searches_ = 0;
+  T_REF_TARGET_ = T_REF_TARGET_INIT;
+  if (!target_) { return false; }
+
+  Eigen::Matrix3d R = T_REF_TARGET_INIT.block<3, 3>(0, 0);
+  Eigen::Vector3d t = T_REF_TARGET_INIT.block<3, 1>(0, 3);
+  Eigen::Matrix3d R_search = R;
+  Eigen::Vector3d t_search = t;
+  FindCorrespondences(R, t);
+  if (residuals_.Size() < static_cast<size_t>(params_.min_residuals)) {
+    return false;
+  }
+
+  Eigen::Matrix<double, 6, 6> H;
+  Eigen::Matrix<double, 6, 1> g;
+  double cost = Evaluate(R, t, &H, &g);
+  double lambda = 1e-4;
+  for (; num_iterations_ < params_.max_iterations; num_iterations_++) {
+    // levenberg-marquardt step, the damping is scaled by the diagonal so it
+    // does not depend on the units of the translation and rotation
+    Eigen::Matrix<double, 6, 6> H_damped = H;
+    H_damped.diagonal() += lambda * H.diagonal();
+    const Eigen::Matrix<double, 6, 1> dx = H_damped.ldlt().solve(-g);
+    if (!dx.allFinite()) { break; }
+    const Eigen::Vector3d dt = dx.head<3>();
+    const Eigen::Vector3d dr = dx.tail<3>();
+    Eigen::Matrix3d R_new = R;
+    if (dr.norm() > 0) {
+      R_new = R * Eigen::AngleAxisd(dr.norm(), dr.normalized())
+                      .toRotationMatrix();
+    }
+    const Eigen::Vector3d t_new = t + dt;
+
+    const double cost_new = Evaluate(R_new, t_new);
+    if (cost_new > cost) {
+      lambda *= 10;
+      if (lambda > 1e8) { break; }
+      continue;
+    }
+    lambda = std::max(lambda / 10, 1e-8);
+    R = R_new;
+    t = t_new;
+    const bool converged = dt.norm() < params_.convergence_trans_m &&
+                           beam::Rad2Deg(dr.norm()) <
+                               params_.convergence_rot_deg;
+
+    // the correspondences stay valid for small motions, which saves the
+    // nearest neighbour searches
+    if (!converged &&
+        ((t - t_search).norm() > params_.reuse_correspondences_trans_m ||
+         RotationDeg(R_search.transpose() * R) >
+             params_.reuse_correspondences_rot_deg)) {
+      FindCorrespondences(R, t);
+      R_search = R;
+      t_search = t;
+      if (residuals_.Size() < static_cast<size_t>(params_.min_residuals)) {
+        return false;
+      }
+    }
+    cost = Evaluate(R, t, &H, &g);
+    if (converged) { break; }
+  }
+
+  T_REF_TARGET_.setIdentity();
+  T_REF_TARGET_.block<3, 3>(0, 0) = R;
+  T_REF_TARGET_.block<3, 1>(0, 3) = t;
+
+  double weighted_sq = 0;
+  Evaluate(R, t, &H, &g, &weighted_sq);
+  const double num_residuals = static_cast<double>(residuals_.Size());
+  const double min_variance =
+      params_.min_residual_std_m * params_.min_residual_std_m;
+  const double variance =
+      num_residuals > 6 ? std::max(weighted_sq / (num_residuals - 6),
+                                   min_variance)
+                        : min_variance;
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> solver(H);
+  const Eigen::Matrix<double, 6, 1> information =
+      solver.eigenvalues().cwiseMax(params_.min_information);
+  covariance_ = variance * solver.eigenvectors() *
+                information.cwiseInverse().asDiagonal() *
+                solver.eigenvectors().transpose();
+  return true;
+}
+
+void LoamSolver::FindCorrespondences(const Eigen::Matrix3d& R,
+                                     const Eigen::Vector3d& t) {
+  num_searches_++;
+  residuals_.Clear();
+  AddCorrespondences(target_->edges.strong.cloud, ref_edges_, true, R, t);
+  AddCorrespondences(target_->surfaces.strong.cloud, ref_surfaces_, false, R,
+                     t);
+}
+
+void LoamSolver::AddCorrespondences(const PointCloud& cloud,
+                                    const FeatureTree& tree, bool linear,
+                                    const Eigen::Matrix3d& R,
+                                    const Eigen::Vector3d& t) {
+  if (tree.empty) { return; }
+  const int k = params_.num_neighbors;
+  const double max_sq = params_.max_correspondence_distance_m *
+                        params_.max_correspondence_distance_m;
+  std::vector<int> indices(k);
+  std::vector<float> sq_distances(k);
+
+  // eigenvalues are in increasing order
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+  for (const auto& point : cloud) {
+    if (!IsFinite(point)) { continue; }
+    const Eigen::Vector3d q(point.x, point.y, point.z);
+    const Eigen::Vector3d p = R * q + t;
+    pcl::PointXYZ search_point(p.x(), p.y(), p.z());
+    if (tree.kdtree.nearestKSearch(search_point, k, indices, sq_distances) <
+            k ||
+        sq_distances.back() > max_sq) {
+      continue;
+    }
+
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_sq = Eigen::Matrix3d::Zero();
+    for (const int i : indices) {
+      const auto& n = tree.cloud->at(i);
+      const Eigen::Vector3d v(n.x, n.y, n.z);
+      mean += v;
+      sum_sq += v * v.transpose();
+    }
+    mean /= k;
+    solver.computeDirect(sum_sq / k - mean * mean.transpose());
+    const Eigen::Vector3d& eigenvalues = solver.eigenvalues();
+    if (linear) {
+      if (eigenvalues[1] >= params_.linearity_threshold * eigenvalues[2]) {
+        continue;
+      }
+      // the distance to the line is split along the two directions
+      // orthogonal to it
+      for (int j = 0; j < 2; j++) {
+        const Eigen::Vector3d n = solver.eigenvectors().col(j);
+        residuals_.Add(q, n, n.dot(mean));
+      }
+    } else {
+      if (eigenvalues[0] >= params_.planarity_threshold * eigenvalues[1]) {
+        continue;
+      }
+      const Eigen::Vector3d n = solver.eigenvectors().col(0);
+      residuals_.Add(q, n, n.dot(mean));
+    }
+  }
+}
+
+double LoamSolver::Evaluate(const Eigen::Matrix3d& R, const Eigen::Vector3d& t,
+                            Eigen::Matrix<double, 6, 6>* H,
+                            Eigen::Matrix<double, 6, 1>* g,
+                            double* weighted_sq) const {
+  using Array = Eigen::Map<const Eigen::ArrayXd>;
+  const Eigen::Index m = static_cast<Eigen::Index>(residuals_.Size());
+  const Array qx(residuals_.qx.data(), m), qy(residuals_.qy.data(), m),
+      qz(residuals_.qz.data(), m);
+  const Array nx(residuals_.nx.data(), m), ny(residuals_.ny.data(), m),
+      nz(residuals_.nz.data(), m);
+  const Array d(residuals_.d.data(), m);
+
+  // r = n^T (R * q + t) - d = (R^T n)^T q + n^T t - d
+  const Eigen::ArrayXd mx = R(0, 0) * nx + R(1, 0) * ny + R(2, 0) * nz;
+  const Eigen::ArrayXd my = R(0, 1) * nx + R(1, 1) * ny + R(2, 1) * nz;
+  const Eigen::ArrayXd mz = R(0, 2) * nx + R(1, 2) * ny + R(2, 2) * nz;
+  const Eigen::ArrayXd r = mx * qx + my * qy + mz * qz + t.x() * nx +
+                           t.y() * ny + t.z() * nz - d;
+
+  // huber loss, with the weights of the iteratively reweighted least squares
+  const double delta = params_.huber_delta_m;
+  const Eigen::ArrayXd abs_r = r.abs();
+  const double cost =
+      (abs_r <= delta)
+          .select(0.5 * r.square(), delta * (abs_r - 0.5 * delta))
+          .sum();
+  if (!H) { return cost; }
+  const Eigen::ArrayXd w = (abs_r <= delta).select(1.0, delta / abs_r);
+
+  // J = [n^T, (q x R^T n)^T]
+  Eigen::Matrix<double, 6, Eigen::Dynamic> J(6, m);
+  J.row(0) = nx.matrix().transpose();
+  J.row(1) = ny.matrix().transpose();
+  J.row(2) = nz.matrix().transpose();
+  J.row(3) = (qy * mz - qz * my).matrix().transpose();
+  J.row(4) = (qz * mx - qx * mz).matrix().transpose();
+  J.row(5) = (qx * my - qy * mx).matrix().transpose();
+  const Eigen::Matrix<double, 6, Eigen::Dynamic> JW =
+      J * w.matrix().asDiagonal();
+  *H = JW * J.transpose();
+  *g = JW * r.matrix();
+  if (weighted_sq) { *weighted_sq = (w * r.square()).sum(); }
+  return cost;
+}
+
+}} // namespace bs_models::scan_registration
@@ -1,11 +1,14 @@
 #include <bs_models/scan_registration/multi_scan_registration.h>
 
+#include <algorithm>
+
 #include <fuse_constraints/absolute_pose_3d_stamped_constraint.h>
 #include <fuse_core/transaction.h>
 
 #include <beam_matching/Matchers.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_common/utils.h>
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
 
@@ -56,6 +59,14 @@ void MultiScanRegistrationBase::Params::LoadFromJson(
 
   num_neighbors = J["num_neighbors"];
   disable_lidar_map = J["disable_lidar_map"];
+  if (J.contains("num_threads")) { num_threads = J["num_threads"]; }
+  if (num_threads < 1) {
+    BEAM_WARN("Invalid num_threads param, using 1 thread.");
+    num_threads = 1;
+  }
+  if (J.contains("match_voxel_size")) {
+    match_voxel_size = J["match_voxel_size"];
+  }
 }
 
 ScanRegistrationParamsBase MultiScanRegistrationBase::Params::GetBaseParams() {
@@ -63,7 +74,8 @@ ScanRegistrationParamsBase MultiScanRegistrationBase::Params::GetBaseParams() {
       .min_motion_trans_m = min_motion_trans_m,
       .min_motion_rot_deg = min_motion_rot_deg,
       .max_motion_trans_m = max_motion_trans_m,
-      .fix_first_scan = fix_first_scan};
+      .fix_first_scan = fix_first_scan,
+      .hessian_covariance = hessian_covariance};
   return base_params;
 }
 
@@ -80,12 +92,13 @@ MultiScanRegistrationBase::MultiScanRegistrationBase(
 bs_constraints::Pose3DStampedTransaction
     MultiScanRegistrationBase::RegisterNewScan(const ScanPose& new_scan) {
   // create empty transaction
-  bs_constraints::Pose3DStampedTransaction transaction(new_scan.Stamp());
+  bs_constraints::Pose3DStampedTransaction transaction(
+      new_scan.Stamp(), true, true, use_pooled_allocation_);
 
   // if first scan, add to list then exit
-  if (reference_clouds_.empty()) {
+  if (reference_clouds_.Empty()) {
     AddFirstScan(new_scan, transaction);
-    transaction.AddExtrinsicVariablesForFrame(extrinsics_.GetLidarFrameId(),
+    transaction.AddExtrinsicVariablesForFrame(lidar_frame_id_,
                                               extrinsics_prior_);
     return transaction;
   }
@@ -94,24 +107,22 @@ bs_constraints::Pose3DStampedTransaction
 
   // first, let's go through the unregistered scans and try to register them to
   // a scan in the reference scans
-  auto unreg_iter = unregistered_clouds_.begin();
-  while (unreg_iter != unregistered_clouds_.end()) {
-    int num_measurements = RegisterScanToReferences(*unreg_iter, transaction);
-
-    if (num_measurements > 0) {
-      ROS_DEBUG("Adding %d measurements to unregistered scan with stamp %d.%d.",
-                num_measurements, new_scan.Stamp().sec, new_scan.Stamp().nsec);
-      InsertCloudInReferences(*unreg_iter);
-
-      // add pose variables for this scan
-      transaction.AddPoseVariables(unreg_iter->Position(),
-                                   unreg_iter->Orientation(),
-                                   unreg_iter->Stamp());
-
-      unregistered_clouds_.erase(unreg_iter++);
-    } else {
-      ++unreg_iter;
-    }
+  std::vector<ros::Time> registered_stamps;
+  for (const auto& unreg : unregistered_clouds_) {
+    int num_measurements = RegisterScanToReferences(*unreg, transaction);
+    if (num_measurements == 0) { continue; }
+
+    ROS_DEBUG("Adding %d measurements to unregistered scan with stamp %d.%d.",
+              num_measurements, new_scan.Stamp().sec, new_scan.Stamp().nsec);
+    InsertCloudInReferences(unreg);
+
+    // add pose variables for this scan
+    transaction.AddPoseVariables(unreg->Position(), unreg->Orientation(),
+                                 unreg->Stamp());
+    registered_stamps.push_back(unreg->Stamp());
+  }
+  for (const auto& stamp : registered_stamps) {
+    unregistered_clouds_.Erase(stamp);
   }
 
   // now, let's register the new scan to the reference scans
@@ -123,13 +134,13 @@ bs_constraints::Pose3DStampedTransaction
         "No constraints added to new scan with stamp %d.%d, adding scan to "
         "unregistered list.",
         new_scan.Stamp().sec, new_scan.Stamp().nsec);
-    unregistered_clouds_.push_back(new_scan);
+    unregistered_clouds_.Insert(std::make_shared<ScanPose>(new_scan));
   } else {
     ROS_DEBUG("Adding %d measurements to scan with stamp %d.%d",
               num_new_measurements, new_scan.Stamp().sec,
               new_scan.Stamp().nsec);
     // add cloud to reference cloud list
-    reference_clouds_.push_front(new_scan);
+    reference_clouds_.Insert(std::make_shared<ScanPose>(new_scan));
 
     // add pose variables for new scan
     transaction.AddPoseVariables(new_scan.Position(), new_scan.Orientation(),
@@ -144,7 +155,7 @@ void MultiScanRegistrationBase::AddFirstScan(
     bs_constraints::Pose3DStampedTransaction& transaction) {
   ROS_DEBUG("Adding first scan to reference scans.");
   // BEAM_DEBUG("Adding first scan to reference scans.");
-  reference_clouds_.push_front(scan);
+  reference_clouds_.Insert(std::make_shared<ScanPose>(scan));
 
   // add pose variables for new scan
   transaction.AddPoseVariables(scan.Position(), scan.Orientation(),
@@ -157,8 +168,8 @@ void MultiScanRegistrationBase::AddFirstScan(
   }
 
   if (!params_.disable_lidar_map) {
-    map_.AddPointCloud(scan.Cloud(), scan.LoamCloud(), scan.Stamp(),
-                       scan.T_REFFRAME_LIDAR());
+    map_->AddPointCloud(scan.Cloud(), scan.LoamCloud(), scan.Stamp(),
+                        scan.T_REFFRAME_LIDAR(), lidar_frame_id_);
   }
 
   return;
@@ -186,17 +197,50 @@ int MultiScanRegistrationBase::RegisterScanToReferences(
                       << new_scan.Stamp().nsec << "\n\n";
   }
 
+  // run all matches first, in parallel if we have more than one matcher.
+  // Validation is done after in order since it depends on previous results,
+  // starting from the newest reference
+  PrepareTarget(new_scan);
+  std::vector<const ScanPose*> references;
+  for (auto iter = reference_clouds_.rbegin(); iter != reference_clouds_.rend();
+       iter++) {
+    references.push_back(iter->get());
+  }
+  std::vector<MatchResult> results(references.size());
+  std::vector<uint8_t> matched(references.size(), 0);
+  auto match_references = [&](int matcher_index) {
+    for (int i = matcher_index; i < references.size(); i += NumMatchers()) {
+      matched[i] =
+          MatchScans(*references[i], new_scan, matcher_index, results[i]);
+    }
+  };
+  if (NumMatchers() == 1 || references.size() < 2) {
+    match_references(0);
+  } else {
+    const size_t num_tasks =
+        std::min<size_t>(NumMatchers(), references.size());
+    bs_common::TaskScheduler::GetInstance().ParallelFor(
+        bs_common::TaskPriority::REALTIME, num_tasks,
+        [&](size_t t) { match_references(t); }, num_tasks);
+  }
+
   std::vector<Eigen::Matrix4d, beam::AlignMat4d> lidar_poses_est;
-  for (auto ref_iter = reference_clouds_.begin();
-       ref_iter != reference_clouds_.end(); ref_iter++) {
+  for (int i = 0; i < references.size(); i++) {
+    const ScanPose* ref_iter = references[i];
     counter++;
 
     // BEAM_DEBUG("Matching against neighbor no. {}", counter);
     ROS_DEBUG("Matching against neighbor no. %d", counter);
 
-    // run matcher to get refined cloud pose
-    Eigen::Matrix4d T_LIDARREF_LIDARTGT;
-    if (!MatchScans(*ref_iter, new_scan, T_LIDARREF_LIDARTGT)) { continue; }
+    if (!matched[i]) { continue; }
+    const MatchResult& result = results[i];
+    const Eigen::Matrix4d& T_LIDARREF_LIDARTGT = result.T_LIDARREF_LIDARTGT;
+    OutputResults(*ref_iter, new_scan, T_LIDARREF_LIDARTGT,
+                  output_loam_results_);
+    if (!use_fixed_covariance_) { covariance_ = result.covariance; }
+    if (!registration_validation_.Validate(result.T_RefEst_Ref, covariance_)) {
+      continue;
+    }
 
     // keep track of all results so that we can average the transform for the
     // lidar map
@@ -235,8 +279,7 @@ int MultiScanRegistrationBase::RegisterScanToReferences(
         ref_iter->Position(), new_scan.Position(), ref_iter->Orientation(),
         new_scan.Orientation(),
         bs_common::TransformMatrixToVectorWithQuaternion(T_LIDARREF_LIDARTGT),
-        covariance_weight_ * covariance_, source_,
-        extrinsics_.GetLidarFrameId());
+        covariance_weight_ * covariance_, source_, lidar_frame_id_);
 
     num_constraints++;
   }
@@ -248,112 +291,70 @@ int MultiScanRegistrationBase::RegisterScanToReferences(
   if (!params_.disable_lidar_map) {
     Eigen::Matrix4d T_WORLD_LIDAR_AVG =
         beam::AverageTransforms(lidar_poses_est);
-    map_.AddPointCloud(new_scan.Cloud(), new_scan.LoamCloud(), new_scan.Stamp(),
-                       T_WORLD_LIDAR_AVG);
+    map_->AddPointCloud(new_scan.Cloud(), new_scan.LoamCloud(),
+                        new_scan.Stamp(), T_WORLD_LIDAR_AVG, lidar_frame_id_);
   }
 
   return num_constraints;
 }
 
-void MultiScanRegistrationBase::InsertCloudInReferences(const ScanPose& scan) {
-  // iterate through list and insert when the new scan has a timestamp less than
-  // the current scan in reference scans
-  for (auto iter = reference_clouds_.begin(); iter != reference_clouds_.end();
-       iter++) {
-    if (scan.Stamp() > iter->Stamp()) { continue; }
-
-    // insert and then check size of references
-    reference_clouds_.insert(iter, scan);
-    while (reference_clouds_.size() >= params_.num_neighbors) {
-      reference_clouds_.pop_back();
-    }
-
-    return;
-  }
-
-  // if all scans were prior to new scan, or list was empty, then push to back
-  reference_clouds_.push_back(scan);
+void MultiScanRegistrationBase::InsertCloudInReferences(
+    const ScanPoseBuffer::ScanPosePtr& scan) {
+  // the buffer keeps the stamps sorted, then drop the oldest references if
+  // there are too many
+  reference_clouds_.Insert(scan);
+  reference_clouds_.TrimOldest(std::max(params_.num_neighbors - 1, 0));
 }
 
 void MultiScanRegistrationBase::UpdateScanPoses(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
-  for (auto iter = reference_clouds_.begin(); iter != reference_clouds_.end();
-       iter++) {
-    iter->UpdatePose(graph_msg);
-  }
+  reference_clouds_.UpdatePoses(graph_msg);
 }
 
 void MultiScanRegistrationBase::CleanUpScanLists(
     const ros::Time& new_scan_time) {
-  while (reference_clouds_.size() > params_.num_neighbors) {
-    reference_clouds_.pop_back();
-  }
-
-  while (unregistered_clouds_.size() > max_unregistered_clouds_) {
-    unregistered_clouds_.pop_back();
-  }
-
-  if (params_.lag_duration == 0) { return; }
+  reference_clouds_.TrimOldest(params_.num_neighbors);
+  unregistered_clouds_.TrimOldest(max_unregistered_clouds_);
 
-  // clear old reference clouds
-  auto i = reference_clouds_.begin();
-  while (i != reference_clouds_.end()) {
-    // remove scan if new_scan_time - ref_scan_time > lag_duration
-    if (new_scan_time - i->Stamp() > ros::Duration(params_.lag_duration)) {
-      reference_clouds_.erase(i++);
-    } else {
-      ++i;
-    }
+  if (params_.lag_duration == 0 ||
+      new_scan_time.toSec() <= params_.lag_duration) {
+    return;
   }
 
-  // clear old unregistred clouds
-  auto j = unregistered_clouds_.begin();
-  while (j != unregistered_clouds_.end()) {
-    // remove scan if new_scan_time - unregistered scan time > lag_duration
-    if (new_scan_time - j->Stamp() > ros::Duration(params_.lag_duration)) {
-      unregistered_clouds_.erase(j++);
-    } else {
-      ++j;
-    }
-  }
+  // remove scans if new_scan_time - scan_time > lag_duration
+  const ros::Time oldest_stamp =
+      new_scan_time - ros::Duration(params_.lag_duration);
+  reference_clouds_.EraseOlderThan(oldest_stamp);
+  unregistered_clouds_.EraseOlderThan(oldest_stamp);
 }
 
 void MultiScanRegistrationBase::RemoveMissingScans(
     fuse_core::Graph::ConstSharedPtr graph_msg, bool require_one_update) {
-  auto i = reference_clouds_.begin();
-  while (i != reference_clouds_.end()) {
+  reference_clouds_.EraseIf([&](const ScanPose& scan) {
     // first, check that number of updates is greater than 0
-    if (require_one_update && i->Updates() == 0) {
-      ++i;
-      continue;
-    }
+    if (require_one_update && scan.Updates() == 0) { return false; }
 
-    // check if variables exist
-    bool keep_scan = (graph_msg->variableExists(i->Position().uuid()) &&
-                      graph_msg->variableExists(i->Orientation().uuid()));
-
-    // remove variable is required, and update iterator
-    if (!keep_scan) {
-      reference_clouds_.erase(i++);
-    } else {
-      ++i;
-    }
-  }
+    // remove if its variables are not in the graph anymore
+    return !graph_msg->variableExists(scan.Position().uuid()) ||
+           !graph_msg->variableExists(scan.Orientation().uuid());
+  });
 }
 
 ScanPose MultiScanRegistrationBase::GetScan(const ros::Time& t, bool& success) {
-  for (auto iter = Begin(); iter != End(); iter++) {
-    if (iter->Stamp() == t) {
-      success = true;
-      return *iter;
-    }
+  const auto scan = reference_clouds_.Find(t);
+  if (scan) {
+    success = true;
+    return *scan;
   }
   success = false;
   return ScanPose(PointCloud(), ros::Time(0), Eigen::Matrix4d::Identity());
 }
 
 void MultiScanRegistrationBase::PrintScanDetails(std::ostream& stream) {
-  for (auto iter = Begin(); iter != End(); iter++) { iter->Print(stream); }
+  for (auto iter = reference_clouds_.rbegin();
+       iter != reference_clouds_.rend(); iter++) {
+    (*iter)->Print(stream);
+  }
 }
 
 void MultiScanRegistrationBase::OutputResults(
@@ -444,59 +445,161 @@ MultiScanRegistration::MultiScanRegistration(
     std::unique_ptr<Matcher<PointCloudPtr>> matcher,
     const ScanRegistrationParamsBase& base_params, int num_neighbors,
     double lag_duration, bool disable_lidar_map)
+    : MultiScanRegistrationBase(base_params, num_neighbors, lag_duration,
+                                disable_lidar_map) {
+  matchers_.push_back(std::move(matcher));
+}
+
+MultiScanRegistration::MultiScanRegistration(
+    std::vector<std::unique_ptr<Matcher<PointCloudPtr>>> matchers,
+    const ScanRegistrationParamsBase& base_params, int num_neighbors,
+    double lag_duration, bool disable_lidar_map)
     : MultiScanRegistrationBase(base_params, num_neighbors, lag_duration,
                                 disable_lidar_map),
-      matcher_(std::move(matcher)) {}
+      matchers_(std::move(matchers)) {
+  if (matchers_.empty()) {
+    BEAM_ERROR("MultiScanRegistration requires at least one matcher");
+    throw std::invalid_argument{"no matchers provided"};
+  }
+}
+
+void MultiScanRegistration::SetMatchVoxelSize(double voxel_size) {
+  match_clouds_.clear();
+  if (voxel_size <= 0) {
+    match_filter_ = FilterPipeline<pcl::PointXYZ>();
+    return;
+  }
+  std::vector<beam_filtering::FilterParamsType> filter_params{
+      {beam_filtering::FilterType::VOXEL,
+       {voxel_size, voxel_size, voxel_size}}};
+  match_filter_ = FilterPipeline<pcl::PointXYZ>(filter_params);
+}
+
+void MultiScanRegistration::SetGpuMatcher(
+    std::unique_ptr<GpuGicpMatcher> matcher) {
+  gpu_matcher_ = std::move(matcher);
+}
+
+void MultiScanRegistration::PrepareTarget(const ScanPose& scan_pose_tgt) {
+  std::unordered_map<uint64_t, PointCloudPtr> match_clouds;
+  std::unordered_set<uint64_t> stamps;
+  for (const auto& ref : reference_clouds_) {
+    match_clouds.emplace(ref->Stamp().toNSec(), GetMatchCloud(*ref));
+    stamps.insert(ref->Stamp().toNSec());
+  }
+  match_clouds.emplace(scan_pose_tgt.Stamp().toNSec(),
+                       GetMatchCloud(scan_pose_tgt));
+  stamps.insert(scan_pose_tgt.Stamp().toNSec());
+  match_clouds_ = std::move(match_clouds);
+
+  // the device buffers follow the references, so each scan is uploaded once
+  if (gpu_matcher_) { gpu_matcher_->Retain(stamps); }
+}
+
+PointCloudPtr
+    MultiScanRegistration::GetMatchCloud(const ScanPose& scan_pose) const {
+  auto iter = match_clouds_.find(scan_pose.Stamp().toNSec());
+  if (iter != match_clouds_.end()) { return iter->second; }
+  auto cloud = std::make_shared<PointCloud>();
+  match_filter_.Filter(scan_pose.Cloud(), *cloud);
+  return cloud;
+}
 
 bool MultiScanRegistration::MatchScans(const ScanPose& scan_pose_ref,
                                        const ScanPose& scan_pose_tgt,
-                                       Eigen::Matrix4d& T_LIDARREF_LIDARTGT) {
+                                       int matcher_index, MatchResult& result) {
   Eigen::Matrix4d T_LidarRefEst_LidarTgt =
       beam::InvertTransform(scan_pose_ref.T_REFFRAME_LIDAR()) *
       scan_pose_tgt.T_REFFRAME_LIDAR();
 
   if (!PassedMotionThresholds(T_LidarRefEst_LidarTgt)) { return false; }
 
-  // transform tgt cloud into est ref frame
-  PointCloud tgtcloud_in_ref_est_frame;
-  pcl::transformPointCloud(scan_pose_tgt.Cloud(), tgtcloud_in_ref_est_frame,
-                           T_LidarRefEst_LidarTgt);
+  PointCloudPtr refcloud = GetMatchCloud(scan_pose_ref);
+  PointCloudPtr tgtcloud = GetMatchCloud(scan_pose_tgt);
+
+  // the device matcher starts from the estimate instead of transforming the
+  // target, so that the target on the device can be reused as a reference
+  GpuGicpMatcher::Result gpu_result;
+  if (gpu_matcher_) {
+    if (!gpu_matcher_->Match(scan_pose_ref.Stamp().toNSec(), *refcloud,
+                             scan_pose_tgt.Stamp().toNSec(), *tgtcloud,
+                             T_LidarRefEst_LidarTgt, gpu_result)) {
+      BEAM_WARN("Failed scan matching on the GPU. Skipping measurement.");
+      return false;
+    }
+    result.T_LIDARREF_LIDARTGT = gpu_result.T_REF_TGT;
+    result.T_RefEst_Ref = T_LidarRefEst_LidarTgt *
+                          beam::InvertTransform(result.T_LIDARREF_LIDARTGT);
+  } else {
+    // transform tgt cloud into est ref frame
+    auto tgtcloud_in_ref_est_frame = std::make_shared<PointCloud>();
+    pcl::transformPointCloud(*tgtcloud, *tgtcloud_in_ref_est_frame,
+                             T_LidarRefEst_LidarTgt);
+
+    // match clouds
+    const auto& matcher = matchers_.at(matcher_index);
+    matcher->SetRef(refcloud);
+    matcher->SetTarget(tgtcloud_in_ref_est_frame);
+    if (!matcher->Match()) {
+      BEAM_WARN(
+          "Failed scan matching within matcher class. Skipping measurement.");
+      return false;
+    }
 
-  // match clouds
-  matcher_->SetRef(std::make_shared<PointCloud>(scan_pose_ref.Cloud()));
-  matcher_->SetTarget(std::make_shared<PointCloud>(tgtcloud_in_ref_est_frame));
-  if (!matcher_->Match()) {
-    BEAM_WARN(
-        "Failed scan matching within matcher class. Skipping measurement.");
-    return false;
+    result.T_RefEst_Ref = matcher->GetResult().matrix();
+    result.T_LIDARREF_LIDARTGT =
+        beam::InvertTransform(result.T_RefEst_Ref) * T_LidarRefEst_LidarTgt;
   }
 
-  Eigen::Matrix4d T_RefEst_Ref = matcher_->GetResult().matrix();
-  T_LIDARREF_LIDARTGT =
-      beam::InvertTransform(T_RefEst_Ref) * T_LidarRefEst_LidarTgt;
-
-  OutputResults(scan_pose_ref, scan_pose_tgt, T_LIDARREF_LIDARTGT, false);
-
-  if (!use_fixed_covariance_) {
-    BEAM_WARN(
-        "Automated covariance estimation not tested, use fixed covariance!");
-    covariance_ = matcher_->GetCovariance();
+  if (use_fixed_covariance_) { return true; }
+  if (params_.hessian_covariance.enabled) {
+    HessianCovariance hessian_covariance(params_.hessian_covariance);
+    hessian_covariance.SetReference({refcloud.get()}, {});
+    if (hessian_covariance.Compute({tgtcloud.get()}, {},
+                                   result.T_LIDARREF_LIDARTGT,
+                                   result.covariance)) {
+      return true;
+    }
+  }
+  if (gpu_matcher_) {
+    result.covariance = gpu_result.covariance;
+    return true;
   }
+  BEAM_WARN(
+      "Automated covariance estimation not tested, use fixed covariance!");
+  result.covariance = matchers_.at(matcher_index)->GetCovariance();
 
-  return registration_validation_.Validate(T_RefEst_Ref, covariance_);
+  return true;
 }
 
 MultiScanLoamRegistration::MultiScanLoamRegistration(
     std::unique_ptr<LoamMatcher> matcher,
     const ScanRegistrationParamsBase& base_params, int num_neighbors,
     double lag_duration, bool disable_lidar_map)
+    : MultiScanRegistrationBase(base_params, num_neighbors, lag_duration,
+                                disable_lidar_map) {
+  matchers_.push_back(std::move(matcher));
+  output_loam_results_ = true;
+}
+
+MultiScanLoamRegistration::MultiScanLoamRegistration(
+    std::vector<std::unique_ptr<LoamMatcher>> matchers,
+    const ScanRegistrationParamsBase& base_params, int num_neighbors,
+    double lag_duration, bool disable_lidar_map)
     : MultiScanRegistrationBase(base_params, num_neighbors, lag_duration,
                                 disable_lidar_map),
-      matcher_(std::move(matcher)) {}
+      matchers_(std::move(matchers)) {
+  if (matchers_.empty()) {
+    BEAM_ERROR("MultiScanLoamRegistration requires at least one matcher");
+    throw std::invalid_argument{"no matchers provided"};
+  }
+  output_loam_results_ = true;
+}
 
-bool MultiScanLoamRegistration::MatchScans(
-    const ScanPose& scan_pose_ref, const ScanPose& scan_pose_tgt,
-    Eigen::Matrix4d& T_LIDARREF_LIDARTGT) {
+bool MultiScanLoamRegistration::MatchScans(const ScanPose& scan_pose_ref,
+                                           const ScanPose& scan_pose_tgt,
+                                           int matcher_index,
+                                           MatchResult& result) {
   Eigen::Matrix4d T_LidarRefEst_LidarTgt =
       beam::InvertTransform(scan_pose_ref.T_REFFRAME_LIDAR()) *
       scan_pose_tgt.T_REFFRAME_LIDAR();
@@ -511,23 +614,37 @@ bool MultiScanLoamRegistration::MatchScans(
       std::make_shared<LoamPointCloud>(scan_pose_ref.LoamCloud());
 
   // match clouds
-  matcher_->SetRef(refcloud_in_ref_frame);
-  matcher_->SetTarget(tgtcloud_in_ref_est_frame);
-  if (!matcher_->Match()) {
+  const auto& matcher = matchers_.at(matcher_index);
+  matcher->SetRef(refcloud_in_ref_frame);
+  matcher->SetTarget(tgtcloud_in_ref_est_frame);
+  if (!matcher->Match()) {
     BEAM_WARN(
         "Failed scan matching within matcher class. Skipping measurement.");
     return false;
   }
 
-  Eigen::Matrix4d T_RefEst_Ref = matcher_->GetResult().matrix();
-  T_LIDARREF_LIDARTGT =
-      beam::InvertTransform(T_RefEst_Ref) * T_LidarRefEst_LidarTgt;
-
-  OutputResults(scan_pose_ref, scan_pose_tgt, T_LIDARREF_LIDARTGT, true);
-
-  if (!use_fixed_covariance_) { covariance_ = matcher_->GetCovariance(); }
+  result.T_RefEst_Ref = matcher->GetResult().matrix();
+  result.T_LIDARREF_LIDARTGT =
+      beam::InvertTransform(result.T_RefEst_Ref) * T_LidarRefEst_LidarTgt;
+
+  if (use_fixed_covariance_) { return true; }
+  if (params_.hessian_covariance.enabled) {
+    const LoamPointCloud& ref = scan_pose_ref.LoamCloud();
+    const LoamPointCloud& tgt = scan_pose_tgt.LoamCloud();
+    HessianCovariance hessian_covariance(params_.hessian_covariance);
+    hessian_covariance.SetReference(
+        {&ref.surfaces.strong.cloud, &ref.surfaces.weak.cloud},
+        {&ref.edges.strong.cloud, &ref.edges.weak.cloud});
+    if (hessian_covariance.Compute({&tgt.surfaces.strong.cloud},
+                                   {&tgt.edges.strong.cloud},
+                                   result.T_LIDARREF_LIDARTGT,
+                                   result.covariance)) {
+      return true;
+    }
+  }
+  result.covariance = matcher->GetCovariance();
 
-  return registration_validation_.Validate(T_RefEst_Ref, covariance_);
+  return true;
 }
 
 }} // namespace bs_models::scan_registration
@@ -0,0 +1,134 @@
+#include <bs_models/scan_registration/prior_registration_map.h>
+
+#include <algorithm>
+
+#include <beam_utils/log.h>
+
+namespace bs_models { namespace scan_registration {
+
+using namespace global_mapping;
+
+PriorRegistrationMap::PriorRegistrationMap(const std::string& global_map_path,
+                                           const Params& params)
+    : params_(params), tile_index_(params.tile_radius_m) {
+  global_map_ = std::make_shared<GlobalMap>(global_map_path, false);
+  if (!global_map_->MapStore()) {
+    BEAM_ERROR("Prior map {} must be saved with a map store", global_map_path);
+    throw std::invalid_argument{"prior map has no map store"};
+  }
+  submaps_ = global_map_->GetSubmaps();
+  Setup(global_map_->MapStore());
+  BEAM_INFO("Loaded prior map with {} tiles from {}", submaps_.size(),
+            global_map_path);
+}
+
+PriorRegistrationMap::PriorRegistrationMap(
+    const std::vector<SubmapPtr>& submaps,
+    const std::shared_ptr<const bs_common::ChunkFileReader>& map_store,
+    const Params& params)
+    : params_(params), submaps_(submaps), tile_index_(params.tile_radius_m) {
+  Setup(map_store);
+}
+
+void PriorRegistrationMap::Setup(
+    const std::shared_ptr<const bs_common::ChunkFileReader>& map_store) {
+  if (params_.tile_radius_m <= 0) {
+    BEAM_ERROR("Prior map tile radius must be greater than 0");
+    throw std::invalid_argument{"invalid prior map tile radius"};
+  }
+  if (submaps_.empty()) {
+    BEAM_ERROR("Prior map has no submaps");
+    throw std::invalid_argument{"empty prior map"};
+  }
+  working_set_ = std::make_shared<SubmapWorkingSet>(
+      submaps_, map_store,
+      static_cast<size_t>(params_.memory_budget_mb * 1e6));
+  for (size_t i = 0; i < submaps_.size(); i++) {
+    tile_index_.Update(i, submaps_[i]->T_WORLD_SUBMAP().block<3, 1>(0, 3));
+  }
+  if (params_.downsample_voxel_size > 0) {
+    edges_strong_voxel_map_.SetVoxelSize(params_.downsample_voxel_size);
+    surfaces_strong_voxel_map_.SetVoxelSize(params_.downsample_voxel_size);
+  }
+}
+
+bool PriorRegistrationMap::Update(const Eigen::Vector3d& position) {
+  if (last_update_position_ &&
+      (position - *last_update_position_).norm() < params_.update_distance_m) {
+    return false;
+  }
+  last_update_position_ = position;
+
+  std::vector<size_t> ids =
+      tile_index_.Radius(position, params_.tile_radius_m, submaps_.size());
+  if (ids.empty()) { ids = tile_index_.Nearest(position, 1, submaps_.size()); }
+  std::sort(ids.begin(), ids.end());
+
+  // drop the tiles that are out of range
+  bool changed = false;
+  for (auto iter = tiles_.begin(); iter != tiles_.end();) {
+    if (std::binary_search(ids.begin(), ids.end(), iter->first)) {
+      ++iter;
+      continue;
+    }
+    if (params_.downsample_voxel_size > 0) {
+      edges_strong_voxel_map_.RemoveCloud(iter->first,
+                                          iter->second.edges.strong.cloud);
+      surfaces_strong_voxel_map_.RemoveCloud(
+          iter->first, iter->second.surfaces.strong.cloud);
+    }
+    iter = tiles_.erase(iter);
+    changed = true;
+  }
+
+  // page in the new tiles, their clouds stay loaded in the working set until
+  // it is over budget so tiles that come back in range are cheap to add
+  std::vector<size_t> new_ids;
+  for (size_t id : ids) {
+    if (tiles_.find(id) == tiles_.end()) { new_ids.push_back(id); }
+  }
+  if (!new_ids.empty()) {
+    const auto lease = working_set_->Acquire(new_ids);
+    if (!lease.Valid()) {
+      BEAM_WARN("Cannot load the lidar clouds of some prior map tiles");
+    }
+    for (size_t id : new_ids) {
+      auto iter =
+          tiles_.emplace(id, submaps_[id]->GetLidarLoamPointsInWorldFrame())
+              .first;
+      if (params_.downsample_voxel_size > 0) {
+        edges_strong_voxel_map_.AddCloud(id, iter->second.edges.strong.cloud);
+        surfaces_strong_voxel_map_.AddCloud(
+            id, iter->second.surfaces.strong.cloud);
+      }
+    }
+    changed = true;
+  }
+
+  if (changed || !map_) { BuildMap(); }
+  return changed;
+}
+
+std::vector<size_t> PriorRegistrationMap::ActiveTiles() const {
+  std::vector<size_t> ids;
+  for (const auto& [id, tile] : tiles_) { ids.push_back(id); }
+  return ids;
+}
+
+void PriorRegistrationMap::BuildMap() {
+  // always build a new cloud since the previous one may still be in use
+  auto map = std::make_shared<beam_matching::LoamPointCloud>();
+  if (params_.downsample_voxel_size > 0) {
+    for (const auto& [id, tile] : tiles_) {
+      map->edges.weak.cloud += tile.edges.weak.cloud;
+      map->surfaces.weak.cloud += tile.surfaces.weak.cloud;
+    }
+    map->edges.strong.cloud = edges_strong_voxel_map_.GetCloud();
+    map->surfaces.strong.cloud = surfaces_strong_voxel_map_.GetCloud();
+  } else {
+    for (const auto& [id, tile] : tiles_) { map->Merge(tile); }
+  }
+  map_ = std::move(map);
+}
+
+}} // namespace bs_models::scan_registration
@@ -1,153 +1,573 @@
 #include <bs_models/scan_registration/registration_map.h>
 
+#include <algorithm>
+#include <cmath>
+
 #include <boost/filesystem.hpp>
 #include <fuse_variables/orientation_3d_stamped.h>
 #include <fuse_variables/position_3d_stamped.h>
-#include <pcl/common/transforms.h>
 #include <pcl/io/pcd_io.h>
 
-#include <beam_filtering/VoxelDownsample.h>
 #include <beam_utils/math.h>
 #include <beam_utils/se3.h>
 
 #include <bs_common/conversions.h>
 #include <bs_common/extrinsics_lookup_online.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_common/point_transforms.h>
+#include <bs_models/scan_registration/voxel_key.h>
 
 namespace bs_models { namespace scan_registration {
 
 using namespace beam_matching;
 
-RegistrationMap::RegistrationMap() {
-  bs_common::ExtrinsicsLookupOnline& extrinsics_online =
-      bs_common::ExtrinsicsLookupOnline::GetInstance();
-  world_frame_id_ = extrinsics_online.GetWorldFrameId();
+namespace {
+
+/**
+ * @brief append the points of a cloud transformed by T_Out_In to the output
+ * cloud, without creating a temporary transformed cloud. This always gives the
+ * same points for the same inputs, which is needed to remove scans from the
+ * voxel maps.
+ */
+template <typename PointT>
+void AppendTransformed(const pcl::PointCloud<PointT>& cloud,
+                       const Eigen::Matrix4d& T_Out_In,
+                       pcl::PointCloud<PointT>& output) {
+  bs_common::AppendTransformedCloud(cloud, T_Out_In, output);
+}
 
-  // setup publishers
-  ros::NodeHandle n;
-  lidar_map_publisher_ = n.advertise<sensor_msgs::PointCloud2>(
-      "/local_mapper/local_map/lidar_map", 10);
-  loam_map_publisher_ = n.advertise<sensor_msgs::PointCloud2>(
-      "/local_mapper/local_map/loam_map", 10);
+void AppendTransformed(const LoamPointCloud& cloud,
+                       const Eigen::Matrix4d& T_Out_In,
+                       LoamPointCloud& output) {
+  AppendTransformed(cloud.edges.strong.cloud, T_Out_In,
+                    output.edges.strong.cloud);
+  AppendTransformed(cloud.edges.weak.cloud, T_Out_In, output.edges.weak.cloud);
+  AppendTransformed(cloud.surfaces.strong.cloud, T_Out_In,
+                    output.surfaces.strong.cloud);
+  AppendTransformed(cloud.surfaces.weak.cloud, T_Out_In,
+                    output.surfaces.weak.cloud);
 }
 
-RegistrationMap& RegistrationMap::GetInstance() {
-  static RegistrationMap instance;
+template <typename PointT>
+void AddVoxelKeys(const pcl::PointCloud<PointT>& cloud,
+                  const Eigen::Matrix4d& T_Map_Cloud, double voxel_size,
+                  std::vector<uint64_t>& keys) {
+  const Eigen::Matrix3d R = T_Map_Cloud.block<3, 3>(0, 0);
+  const Eigen::Vector3d t = T_Map_Cloud.block<3, 1>(0, 3);
+  for (const auto& p : cloud) {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      continue;
+    }
+    const Eigen::Vector3d v(p.x, p.y, p.z);
+    keys.push_back(VoxelKey(R * v + t, voxel_size));
+  }
+}
+
+} // namespace
+
+void RegistrationMap::RetentionParams::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("coverage_based")) { coverage_based = J["coverage_based"]; }
+  if (J.contains("coverage_voxel_size_m")) {
+    coverage_voxel_size_m = J["coverage_voxel_size_m"];
+  }
+  if (J.contains("redundancy_threshold")) {
+    redundancy_threshold = J["redundancy_threshold"];
+  }
+  if (J.contains("max_distance_m")) { max_distance_m = J["max_distance_m"]; }
+  if (coverage_voxel_size_m <= 0 || redundancy_threshold <= 0 ||
+      redundancy_threshold > 1) {
+    BEAM_ERROR("Registration map retention needs a positive "
+               "coverage_voxel_size_m and a redundancy_threshold in (0, 1]");
+    throw std::invalid_argument{"invalid retention params"};
+  }
+}
+
+void RegistrationMap::RetentionParams::Print(std::ostream& stream) const {
+  stream << "RegistrationMap::RetentionParams: \n";
+  stream << "coverage_based: " << coverage_based << "\n";
+  stream << "coverage_voxel_size_m: " << coverage_voxel_size_m << "\n";
+  stream << "redundancy_threshold: " << redundancy_threshold << "\n";
+  stream << "max_distance_m: " << max_distance_m << "\n";
+}
+
+RegistrationMap::RegistrationMap(const std::string& name)
+    : name_(name),
+      memory_account_(&bs_common::MemoryAccounting::GetInstance().GetAccount(
+          name.empty() ? "registration_map" : "registration_map/" + name)) {}
+
+std::shared_ptr<RegistrationMap>
+    RegistrationMap::GetNamedInstance(const std::string& name) {
+  static std::mutex instances_mutex;
+  static std::map<std::string, std::shared_ptr<RegistrationMap>> instances;
+  std::lock_guard<std::mutex> lock(instances_mutex);
+  auto& instance = instances[name];
+  if (!instance) { instance = std::make_shared<RegistrationMap>(name); }
   return instance;
 }
 
+RegistrationMap& RegistrationMap::GetInstance() {
+  static std::shared_ptr<RegistrationMap> instance = GetNamedInstance("");
+  return *instance;
+}
+
 void RegistrationMap::SetMapSize(int map_size) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (map_size_set_ && map_size != map_size_) {
     BEAM_WARN(
         "Map parameters already set, overriding and purging extra clouds.");
     // in case the map size decreased and existing scans are here, let's purge
-    while (scans_.size() > map_size) {
-      uint64_t first_scan_stamp = scans_.begin()->first;
-      scans_.erase(first_scan_stamp);
-    }
+    while (scans_.size() > map_size) { EvictScan(); }
+    UpdateMemoryAccount();
   }
   map_size_ = map_size;
   map_size_set_ = true;
 }
 
+void RegistrationMap::SetRetentionParams(const RetentionParams& params) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (params.coverage_voxel_size_m != retention_params_.coverage_voxel_size_m) {
+    for (auto& [stamp_ns, scan] : scans_) { scan.coverage_voxels.clear(); }
+  }
+  retention_params_ = params;
+}
+
 void RegistrationMap::SetPublishUpdates(bool publish_updates) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   publish_updates_ = publish_updates;
+  if (!publish_updates_ || lidar_map_publisher_) { return; }
+
+  // publishers are only setup when needed, so maps can be used without ROS
+  // (e.g., offline tools and tests)
+  world_frame_id_ =
+      bs_common::ExtrinsicsLookupOnline::GetInstance().GetWorldFrameId();
+  std::string topic_prefix = "/local_mapper/local_map/";
+  if (!name_.empty()) { topic_prefix += name_ + "/"; }
+  ros::NodeHandle n;
+  lidar_map_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>(topic_prefix + "lidar_map", 10);
+  loam_map_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>(topic_prefix + "loam_map", 10);
+  lidar_scan_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>(topic_prefix + "lidar_scans", 10);
+  loam_scan_publisher_ =
+      n.advertise<sensor_msgs::PointCloud2>(topic_prefix + "loam_scans", 10);
+}
+
+void RegistrationMap::SetMinPublishPeriod(double min_publish_period_s) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  min_publish_period_ = ros::Duration(min_publish_period_s);
+}
+
+void RegistrationMap::SetStoreScansInSensorFrame(
+    bool store_scans_in_sensor_frame) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (store_scans_in_sensor_frame == store_scans_in_sensor_frame_) { return; }
+  for (auto& [stamp_ns, scan] : scans_) {
+    const Eigen::Matrix4d T = store_scans_in_sensor_frame
+                                  ? beam::InvertTransform(scan.T_Map_Scan)
+                                  : scan.T_Map_Scan;
+    bs_common::TransformCloud(scan.cloud, scan.cloud, T);
+    scan.loam_cloud.TransformPointCloud(T);
+  }
+  store_scans_in_sensor_frame_ = store_scans_in_sensor_frame;
+  moved_scans_.clear();
+  RebuildVoxelMaps();
 }
 
 void RegistrationMap::SetVoxelDownsampleSize(double downsample_voxel_size) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (downsample_voxel_size == downsample_voxel_size_) { return; }
   downsample_voxel_size_ = downsample_voxel_size;
+  RebuildVoxelMaps();
+}
+
+void RegistrationMap::SetPyramidVoxelSizes(
+    const std::vector<double>& voxel_sizes) {
+  for (size_t i = 0; i < voxel_sizes.size(); i++) {
+    if (voxel_sizes[i] <= 0 ||
+        (i > 0 && voxel_sizes[i] <= voxel_sizes[i - 1])) {
+      BEAM_ERROR("Registration map pyramid voxel sizes must be positive and "
+                 "increasing");
+      throw std::invalid_argument{"invalid pyramid voxel sizes"};
+    }
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (voxel_sizes == pyramid_voxel_sizes_) { return; }
+  pyramid_voxel_sizes_ = voxel_sizes;
+  pyramid_.clear();
+  for (double voxel_size : voxel_sizes) { pyramid_.emplace_back(voxel_size); }
+  RebuildVoxelMaps();
+}
+
+int RegistrationMap::NumPyramidLevels() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  return 1 + pyramid_.size();
 }
 
 int RegistrationMap::MapSize() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   return map_size_;
 }
 
 bool RegistrationMap::Empty() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   return scans_.empty();
 }
 
 int RegistrationMap::NumScans() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   return scans_.size();
 }
 
 void RegistrationMap::AddPointCloud(const PointCloud& cloud,
                                     const LoamPointCloud& loam_cloud,
                                     const ros::Time& stamp,
-                                    const Eigen::Matrix4d& T_Map_Scan) {
+                                    const Eigen::Matrix4d& T_Map_Scan,
+                                    const std::string& sensor_frame) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  // if this scan already exists, remove its points from the voxel maps first
+  auto existing_scan = scans_.find(stamp.toNSec());
+  if (existing_scan != scans_.end()) {
+    RemoveScanFromVoxelMaps(existing_scan->first, existing_scan->second);
+  }
+
   // transform to map
   scans_.emplace(stamp.toNSec(), ScanPoseInMapFrame());
   ScanPoseInMapFrame& scan = scans_.at(stamp.toNSec());
   scan.T_Map_Scan = T_Map_Scan;
-  pcl::transformPointCloud(cloud, scan.cloud, T_Map_Scan);
-  scan.loam_cloud = LoamPointCloud(loam_cloud, T_Map_Scan);
+  scan.sensor_frame = sensor_frame;
+  if (store_scans_in_sensor_frame_) {
+    scan.cloud = cloud;
+    scan.loam_cloud = loam_cloud;
+  } else {
+    bs_common::TransformCloud(cloud, scan.cloud, T_Map_Scan);
+    scan.loam_cloud = LoamPointCloud(loam_cloud, T_Map_Scan);
+  }
   scan.orientation_uuid = fuse_core::uuid::generate(
       "fuse_variables::Orientation3DStamped", stamp, fuse_core::uuid::NIL);
   scan.position_uuid = fuse_core::uuid::generate(
       "fuse_variables::Position3DStamped", stamp, fuse_core::uuid::NIL);
+  scan.coverage_voxels.clear();
+  AddScanToVoxelMaps(stamp.toNSec(), scan);
+  PublishScan(stamp);
+  if (retention_params_.coverage_based) {
+    RemoveRedundantScans(stamp.toNSec());
+  }
 
   // remove cloud & pose if map is greater than max size
-  if (scans_.size() > map_size_) {
-    uint64_t first_scan_stamp = scans_.begin()->first;
-    scans_.erase(first_scan_stamp);
+  while (scans_.size() > map_size_) { EvictScan(); }
+
+  // keep at least the newest scan so there is always something to register to
+  UpdateMemoryAccount();
+  while (memory_account_->OverBudget() && scans_.size() > 1) {
+    EvictScan();
+    UpdateMemoryAccount();
   }
 
   Publish();
 }
 
 PointCloud RegistrationMap::GetPointCloudMap() const {
-  PointCloud cloud;
-  for (auto it = scans_.begin(); it != scans_.end(); it++) {
-    cloud += it->second.cloud;
-  }
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!cloud_map_outdated_) { return cloud_map_; }
 
   if (downsample_voxel_size_ == -1) {
-    return cloud;
+    cloud_map_.clear();
+    for (auto it = scans_.begin(); it != scans_.end(); it++) {
+      if (store_scans_in_sensor_frame_) {
+        AppendTransformed(it->second.cloud, it->second.T_Map_Scan, cloud_map_);
+      } else {
+        cloud_map_ += it->second.cloud;
+      }
+    }
   } else {
-    return DownsampleCloud(cloud);
+    UpdateMovedScansInVoxelMaps();
+    cloud_map_ = cloud_voxel_map_.GetCloud();
   }
+  cloud_map_outdated_ = false;
+  return cloud_map_;
 }
 
 LoamPointCloud RegistrationMap::GetLoamCloudMap() const {
-  LoamPointCloud cloud;
-  for (auto it = scans_.begin(); it != scans_.end(); it++) {
-    cloud.Merge(it->second.loam_cloud);
+  return *GetLoamCloudMapPtr();
+}
+
+LoamPointCloudPtr RegistrationMap::GetLoamCloudMapPtr(int level) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (level > 0) {
+    PyramidLevel& pyramid_level = pyramid_.at(level - 1);
+    if (!pyramid_level.outdated && pyramid_level.map) {
+      return pyramid_level.map;
+    }
+    UpdateMovedScansInVoxelMaps();
+    auto map = std::make_shared<LoamPointCloud>();
+    map->edges.strong.cloud = pyramid_level.edges_strong_voxel_map.GetCloud();
+    map->surfaces.strong.cloud =
+        pyramid_level.surfaces_strong_voxel_map.GetCloud();
+    pyramid_level.map = std::move(map);
+    pyramid_level.outdated = false;
+    return pyramid_level.map;
   }
+  if (!loam_map_outdated_ && loam_map_) { return loam_map_; }
 
+  if (log_time_) { timer_.restart(); }
+  // always build a new cloud since the previous one may still be in use
+  auto map = std::make_shared<LoamPointCloud>();
+  LoamPointCloud& cloud = *map;
   if (downsample_voxel_size_ == -1) {
-    return cloud;
+    for (auto it = scans_.begin(); it != scans_.end(); it++) {
+      if (store_scans_in_sensor_frame_) {
+        AppendTransformed(it->second.loam_cloud, it->second.T_Map_Scan, cloud);
+      } else {
+        cloud.Merge(it->second.loam_cloud);
+      }
+    }
   } else {
-    if (log_time_) { timer_.restart(); }
     // Downsample only strong features because we rarely use weak features if
-    // check_strong_features_first is set to true (default)
-    cloud.edges.strong.cloud = DownsampleCloud(cloud.edges.strong.cloud);
-    cloud.surfaces.strong.cloud = DownsampleCloud(cloud.surfaces.strong.cloud);
-    if (log_time_) { BEAM_INFO("Downsampling time: {}s", timer_.elapsed()); }
-    return cloud;
+    // check_strong_features_first is set to true (default). Strong features
+    // are kept in voxel maps so we don't need to merge them here
+    for (auto it = scans_.begin(); it != scans_.end(); it++) {
+      const LoamPointCloud& scan_cloud = it->second.loam_cloud;
+      if (store_scans_in_sensor_frame_) {
+        const Eigen::Matrix4d& T_Map_Scan = it->second.T_Map_Scan;
+        AppendTransformed(scan_cloud.edges.weak.cloud, T_Map_Scan,
+                          cloud.edges.weak.cloud);
+        AppendTransformed(scan_cloud.surfaces.weak.cloud, T_Map_Scan,
+                          cloud.surfaces.weak.cloud);
+      } else {
+        cloud.edges.weak.cloud += scan_cloud.edges.weak.cloud;
+        cloud.surfaces.weak.cloud += scan_cloud.surfaces.weak.cloud;
+      }
+    }
+    UpdateMovedScansInVoxelMaps();
+    cloud.edges.strong.cloud = edges_strong_voxel_map_.GetCloud();
+    cloud.surfaces.strong.cloud = surfaces_strong_voxel_map_.GetCloud();
+  }
+  if (log_time_) { BEAM_INFO("Map building time: {}s", timer_.elapsed()); }
+  loam_map_ = std::move(map);
+  loam_map_outdated_ = false;
+  return loam_map_;
+}
+
+void RegistrationMap::RemoveScan(
+    std::map<uint64_t, ScanPoseInMapFrame>::iterator scan) {
+  RemoveScanFromVoxelMaps(scan->first, scan->second);
+  moved_scans_.erase(scan->first);
+  scans_.erase(scan);
+}
+
+void RegistrationMap::EvictScan() {
+  if (!retention_params_.coverage_based || scans_.size() < 2) {
+    RemoveScan(scans_.begin());
+    return;
+  }
+
+  // the newest scan is where the robot is, and is never removed
+  const Eigen::Vector3d robot_position =
+      scans_.rbegin()->second.T_Map_Scan.block<3, 1>(0, 3);
+  auto furthest = scans_.begin();
+  double max_distance = -1;
+  for (auto it = scans_.begin(); it != std::prev(scans_.end()); it++) {
+    const double distance =
+        (it->second.T_Map_Scan.block<3, 1>(0, 3) - robot_position).norm();
+    if (distance > max_distance) {
+      max_distance = distance;
+      furthest = it;
+    }
+  }
+  RemoveScan(furthest);
+}
+
+void RegistrationMap::RemoveRedundantScans(uint64_t new_stamp_ns) {
+  const ScanPoseInMapFrame& new_scan = scans_.at(new_stamp_ns);
+  UpdateCoverageVoxels(new_scan);
+  const std::vector<uint64_t>& new_voxels = new_scan.coverage_voxels;
+  const Eigen::Vector3d robot_position = new_scan.T_Map_Scan.block<3, 1>(0, 3);
+
+  for (auto it = scans_.begin(); it != scans_.end();) {
+    if (it->first == new_stamp_ns) {
+      it++;
+      continue;
+    }
+    const double distance =
+        (it->second.T_Map_Scan.block<3, 1>(0, 3) - robot_position).norm();
+    bool remove = retention_params_.max_distance_m > 0 &&
+                  distance > retention_params_.max_distance_m;
+    if (!remove) {
+      // both voxel lists are sorted
+      UpdateCoverageVoxels(it->second);
+      const std::vector<uint64_t>& voxels = it->second.coverage_voxels;
+      size_t covered = 0;
+      auto new_voxel = new_voxels.begin();
+      for (uint64_t voxel : voxels) {
+        new_voxel = std::lower_bound(new_voxel, new_voxels.end(), voxel);
+        if (new_voxel == new_voxels.end()) { break; }
+        if (*new_voxel == voxel) { covered++; }
+      }
+      const double min_covered =
+          retention_params_.redundancy_threshold * voxels.size();
+      remove = !voxels.empty() && covered >= min_covered;
+    }
+    if (remove) {
+      auto next = std::next(it);
+      RemoveScan(it);
+      it = next;
+    } else {
+      it++;
+    }
+  }
+}
+
+void RegistrationMap::UpdateCoverageVoxels(
+    const ScanPoseInMapFrame& scan) const {
+  if (!scan.coverage_voxels.empty()) { return; }
+  const Eigen::Matrix4d T = store_scans_in_sensor_frame_
+                                ? scan.T_Map_Scan
+                                : Eigen::Matrix4d::Identity().eval();
+  const double voxel_size = retention_params_.coverage_voxel_size_m;
+  std::vector<uint64_t>& keys = scan.coverage_voxels;
+  if (!scan.cloud.empty()) {
+    AddVoxelKeys(scan.cloud, T, voxel_size, keys);
+  } else {
+    AddVoxelKeys(scan.loam_cloud.edges.strong.cloud, T, voxel_size, keys);
+    AddVoxelKeys(scan.loam_cloud.surfaces.strong.cloud, T, voxel_size, keys);
   }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
 }
 
-PointCloud RegistrationMap::DownsampleCloud(const PointCloud& cloud_in) const {
-  beam_filtering::VoxelDownsample voxel_filter(Eigen::Vector3f(
-      downsample_voxel_size_, downsample_voxel_size_, downsample_voxel_size_));
-  auto cloud_ptr = std::make_shared<PointCloud>(cloud_in);
-  voxel_filter.SetInputCloud(cloud_ptr);
-  voxel_filter.Filter();
-  return voxel_filter.GetFilteredCloud();
+void RegistrationMap::UpdateMemoryAccount() {
+  uint64_t num_points{0};
+  uint64_t num_loam_points{0};
+  for (const auto& [stamp_ns, scan] : scans_) {
+    num_points += scan.cloud.size();
+    num_loam_points += scan.loam_cloud.edges.strong.cloud.size() +
+                       scan.loam_cloud.edges.weak.cloud.size() +
+                       scan.loam_cloud.surfaces.strong.cloud.size() +
+                       scan.loam_cloud.surfaces.weak.cloud.size();
+  }
+  memory_account_->Update(num_points + num_loam_points,
+                          num_points * sizeof(pcl::PointXYZ) +
+                              num_loam_points * sizeof(LoamFeaturePointT));
+}
+
+void RegistrationMap::MarkMapsOutdated() const {
+  cloud_map_outdated_ = true;
+  loam_map_outdated_ = true;
+  for (PyramidLevel& level : pyramid_) { level.outdated = true; }
+}
+
+void RegistrationMap::AddScanToVoxelMaps(uint64_t stamp_ns,
+                                         const ScanPoseInMapFrame& scan) {
+  MarkMapsOutdated();
+  if (!UsesVoxelMaps()) { return; }
+  if (store_scans_in_sensor_frame_) {
+    UpdateVoxelMaps(stamp_ns, scan, scan.T_Map_Scan, true);
+    moved_scans_.erase(stamp_ns);
+    return;
+  }
+  const LoamFeatureCloud& edges = scan.loam_cloud.edges.strong.cloud;
+  const LoamFeatureCloud& surfaces = scan.loam_cloud.surfaces.strong.cloud;
+  if (downsample_voxel_size_ != -1) {
+    cloud_voxel_map_.AddCloud(stamp_ns, scan.cloud);
+    edges_strong_voxel_map_.AddCloud(stamp_ns, edges);
+    surfaces_strong_voxel_map_.AddCloud(stamp_ns, surfaces);
+  }
+  for (PyramidLevel& level : pyramid_) {
+    level.edges_strong_voxel_map.AddCloud(stamp_ns, edges);
+    level.surfaces_strong_voxel_map.AddCloud(stamp_ns, surfaces);
+  }
+}
+
+void RegistrationMap::RemoveScanFromVoxelMaps(uint64_t stamp_ns,
+                                              const ScanPoseInMapFrame& scan) {
+  MarkMapsOutdated();
+  if (!UsesVoxelMaps()) { return; }
+  if (store_scans_in_sensor_frame_) {
+    UpdateVoxelMaps(stamp_ns, scan, scan.T_Map_Scan_voxel_maps, false);
+    return;
+  }
+  const LoamFeatureCloud& edges = scan.loam_cloud.edges.strong.cloud;
+  const LoamFeatureCloud& surfaces = scan.loam_cloud.surfaces.strong.cloud;
+  if (downsample_voxel_size_ != -1) {
+    cloud_voxel_map_.RemoveCloud(stamp_ns, scan.cloud);
+    edges_strong_voxel_map_.RemoveCloud(stamp_ns, edges);
+    surfaces_strong_voxel_map_.RemoveCloud(stamp_ns, surfaces);
+  }
+  for (PyramidLevel& level : pyramid_) {
+    level.edges_strong_voxel_map.RemoveCloud(stamp_ns, edges);
+    level.surfaces_strong_voxel_map.RemoveCloud(stamp_ns, surfaces);
+  }
+}
+
+void RegistrationMap::RebuildVoxelMaps() {
+  cloud_voxel_map_.SetVoxelSize(downsample_voxel_size_);
+  edges_strong_voxel_map_.SetVoxelSize(downsample_voxel_size_);
+  surfaces_strong_voxel_map_.SetVoxelSize(downsample_voxel_size_);
+  for (PyramidLevel& level : pyramid_) {
+    level.edges_strong_voxel_map.Clear();
+    level.surfaces_strong_voxel_map.Clear();
+  }
+  MarkMapsOutdated();
+  for (const auto& [stamp_ns, scan] : scans_) {
+    AddScanToVoxelMaps(stamp_ns, scan);
+  }
+}
+
+void RegistrationMap::MarkScanMoved(uint64_t stamp_ns) {
+  MarkMapsOutdated();
+  if (UsesVoxelMaps()) { moved_scans_.insert(stamp_ns); }
 }
 
-pcl::PointCloud<PointXYZIRT> RegistrationMap::DownsampleCloud(
-    const pcl::PointCloud<PointXYZIRT>& cloud_in) const {
-  beam_filtering::VoxelDownsample<PointXYZIRT> voxel_filter(Eigen::Vector3f(
-      downsample_voxel_size_, downsample_voxel_size_, downsample_voxel_size_));
-  auto cloud_ptr = std::make_shared<pcl::PointCloud<PointXYZIRT>>(cloud_in);
-  voxel_filter.SetInputCloud(cloud_ptr);
-  voxel_filter.Filter();
-  return voxel_filter.GetFilteredCloud();
+void RegistrationMap::UpdateMovedScansInVoxelMaps() const {
+  for (uint64_t stamp_ns : moved_scans_) {
+    const ScanPoseInMapFrame& scan = scans_.at(stamp_ns);
+    UpdateVoxelMaps(stamp_ns, scan, scan.T_Map_Scan_voxel_maps, false);
+    UpdateVoxelMaps(stamp_ns, scan, scan.T_Map_Scan, true);
+  }
+  moved_scans_.clear();
+}
+
+void RegistrationMap::UpdateVoxelMaps(uint64_t stamp_ns,
+                                      const ScanPoseInMapFrame& scan,
+                                      const Eigen::Matrix4d& T_Map_Scan,
+                                      bool add) const {
+  PointCloud cloud;
+  LoamFeatureCloud edges;
+  LoamFeatureCloud surfaces;
+  AppendTransformed(scan.cloud, T_Map_Scan, cloud);
+  AppendTransformed(scan.loam_cloud.edges.strong.cloud, T_Map_Scan, edges);
+  AppendTransformed(scan.loam_cloud.surfaces.strong.cloud, T_Map_Scan,
+                    surfaces);
+  if (add) {
+    if (downsample_voxel_size_ != -1) {
+      cloud_voxel_map_.AddCloud(stamp_ns, cloud);
+      edges_strong_voxel_map_.AddCloud(stamp_ns, edges);
+      surfaces_strong_voxel_map_.AddCloud(stamp_ns, surfaces);
+    }
+    for (PyramidLevel& level : pyramid_) {
+      level.edges_strong_voxel_map.AddCloud(stamp_ns, edges);
+      level.surfaces_strong_voxel_map.AddCloud(stamp_ns, surfaces);
+    }
+    scan.T_Map_Scan_voxel_maps = T_Map_Scan;
+  } else {
+    if (downsample_voxel_size_ != -1) {
+      cloud_voxel_map_.RemoveCloud(stamp_ns, cloud);
+      edges_strong_voxel_map_.RemoveCloud(stamp_ns, edges);
+      surfaces_strong_voxel_map_.RemoveCloud(stamp_ns, surfaces);
+    }
+    for (PyramidLevel& level : pyramid_) {
+      level.edges_strong_voxel_map.RemoveCloud(stamp_ns, edges);
+      level.surfaces_strong_voxel_map.RemoveCloud(stamp_ns, surfaces);
+    }
+  }
 }
 
 bool RegistrationMap::UpdateScan(const ros::Time& stamp,
                                  const Eigen::Matrix4d& T_Map_Scan,
                                  double rotation_threshold_deg,
                                  double translation_threshold_m) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   bool scan_found{false};
   uint64_t stamp_nsecs = stamp.toNSec();
 
@@ -162,12 +582,25 @@ bool RegistrationMap::UpdateScan(const ros::Time& stamp,
     return false;
   }
 
-  // update pointclouds
+  // when storing scans in the sensor frame, points are only moved when the map
+  // is queried
+  scan.coverage_voxels.clear();
+  if (store_scans_in_sensor_frame_) {
+    scan.T_Map_Scan = T_Map_Scan;
+    MarkScanMoved(stamp_nsecs);
+    Publish();
+    return true;
+  }
+
+  // update pointclouds, the points are moved by the correction composed in
+  // double
+  RemoveScanFromVoxelMaps(stamp_nsecs, scan);
   Eigen::Matrix4d T_MAPNEW_MAPOLD =
       T_Map_Scan * beam::InvertTransform(scan.T_Map_Scan);
-  pcl::transformPointCloud(scan.cloud, scan.cloud, T_MAPNEW_MAPOLD);
+  bs_common::TransformCloud(scan.cloud, scan.cloud, T_MAPNEW_MAPOLD);
   scan.loam_cloud.TransformPointCloud(T_MAPNEW_MAPOLD);
   scan.T_Map_Scan = T_Map_Scan;
+  AddScanToVoxelMaps(stamp_nsecs, scan);
 
   Publish();
   return true;
@@ -175,6 +608,7 @@ bool RegistrationMap::UpdateScan(const ros::Time& stamp,
 
 void RegistrationMap::Save(const std::string& save_path, bool add_frames,
                            uint8_t r, uint8_t g, uint8_t b) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (!boost::filesystem::exists(save_path)) {
     BEAM_ERROR("Invalid output path for RegistrationMap: {}", save_path);
     return;
@@ -185,9 +619,9 @@ void RegistrationMap::Save(const std::string& save_path, bool add_frames,
     return;
   }
 
-  LoamPointCloud loam_map = GetLoamCloudMap();
-  if (!loam_map.Empty()) {
-    loam_map.SaveCombined(save_path, "registration_map_loam.pcd");
+  LoamPointCloudPtr loam_map = GetLoamCloudMapPtr();
+  if (!loam_map->Empty()) {
+    loam_map->SaveCombined(save_path, "registration_map_loam.pcd");
   }
 
   PointCloud map = GetPointCloudMap();
@@ -223,6 +657,7 @@ void RegistrationMap::Save(const std::string& save_path, bool add_frames,
 
 bool RegistrationMap::GetScanPose(const ros::Time& stamp,
                                   Eigen::Matrix4d& T_Map_Scan) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   auto iter = scans_.find(stamp.toNSec());
   if (iter == scans_.end()) { return false; }
 
@@ -230,11 +665,27 @@ bool RegistrationMap::GetScanPose(const ros::Time& stamp,
   return true;
 }
 
+bool RegistrationMap::GetScanSensorFrame(const ros::Time& stamp,
+                                         std::string& sensor_frame) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  auto iter = scans_.find(stamp.toNSec());
+  if (iter == scans_.end()) { return false; }
+
+  sensor_frame = iter->second.sensor_frame;
+  return true;
+}
+
 bool RegistrationMap::GetScanInMapFrame(const ros::Time& stamp,
                                         PointCloud& cloud) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   auto iter = scans_.find(stamp.toNSec());
   if (iter != scans_.end()) {
-    cloud = iter->second.cloud;
+    if (store_scans_in_sensor_frame_) {
+      cloud.clear();
+      AppendTransformed(iter->second.cloud, iter->second.T_Map_Scan, cloud);
+    } else {
+      cloud = iter->second.cloud;
+    }
     return true;
   }
 
@@ -243,9 +694,16 @@ bool RegistrationMap::GetScanInMapFrame(const ros::Time& stamp,
 
 bool RegistrationMap::GetScanInMapFrame(const ros::Time& stamp,
                                         LoamPointCloud& cloud) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   auto iter = scans_.find(stamp.toNSec());
   if (iter != scans_.end()) {
-    cloud = iter->second.loam_cloud;
+    if (store_scans_in_sensor_frame_) {
+      cloud = LoamPointCloud();
+      AppendTransformed(iter->second.loam_cloud, iter->second.T_Map_Scan,
+                        cloud);
+    } else {
+      cloud = iter->second.loam_cloud;
+    }
     return true;
   }
 
@@ -254,6 +712,7 @@ bool RegistrationMap::GetScanInMapFrame(const ros::Time& stamp,
 
 bool RegistrationMap::GetUUIDStamp(const fuse_core::UUID& uuid,
                                    ros::Time& stamp) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   for (const auto& [t, scan] : scans_) {
     if (scan.position_uuid == uuid || scan.orientation_uuid == uuid) {
       stamp.fromNSec(t);
@@ -264,35 +723,90 @@ bool RegistrationMap::GetUUIDStamp(const fuse_core::UUID& uuid,
 }
 
 void RegistrationMap::Clear() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   scans_.clear();
+  cloud_voxel_map_.Clear();
+  edges_strong_voxel_map_.Clear();
+  surfaces_strong_voxel_map_.Clear();
+  for (PyramidLevel& level : pyramid_) {
+    level.edges_strong_voxel_map.Clear();
+    level.surfaces_strong_voxel_map.Clear();
+  }
+  moved_scans_.clear();
+  MarkMapsOutdated();
+  UpdateMemoryAccount();
 }
 
 void RegistrationMap::Publish() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (!publish_updates_) { return; }
 
+  // building and serializing the full map is expensive and this gets called
+  // on every map update, so only do it if someone is listening and the last
+  // publish is old enough. Time going backwards (e.g., restarting a bag)
+  // resets the limit
   ros::Time update_time = ros::Time::now();
+  if (update_time >= last_publish_time_ &&
+      update_time < last_publish_time_ + min_publish_period_) {
+    return;
+  }
+  const bool publish_lidar = lidar_map_publisher_.getNumSubscribers() > 0;
+  const bool publish_loam = loam_map_publisher_.getNumSubscribers() > 0;
+  if (!publish_lidar && !publish_loam) { return; }
+  last_publish_time_ = update_time;
 
   // get maps
-  PointCloud lidar_map = GetPointCloudMap();
-  LoamPointCloud loam_map = GetLoamCloudMap();
-
-  if (!lidar_map.empty()) {
-    sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
-        lidar_map, update_time, world_frame_id_, updates_counter_);
-    lidar_map_publisher_.publish(pc_msg);
+  if (publish_lidar) {
+    PointCloud lidar_map = GetPointCloudMap();
+    if (!lidar_map.empty()) {
+      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
+          lidar_map, update_time, world_frame_id_, updates_counter_);
+      lidar_map_publisher_.publish(pc_msg);
+    }
   }
 
-  if (!loam_map.Empty()) {
-    LoamPointCloudCombined loam_combined = loam_map.GetCombinedCloud();
-    sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<PointLoam>(
-        loam_combined, update_time, world_frame_id_, updates_counter_);
-    loam_map_publisher_.publish(pc_msg);
+  if (publish_loam) {
+    LoamPointCloudPtr loam_map = GetLoamCloudMapPtr();
+    if (!loam_map->Empty()) {
+      LoamPointCloudCombined loam_combined = loam_map->GetCombinedCloud();
+      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<PointLoam>(
+          loam_combined, update_time, world_frame_id_, updates_counter_);
+      loam_map_publisher_.publish(pc_msg);
+    }
   }
 
   updates_counter_++;
 }
 
+void RegistrationMap::PublishScan(const ros::Time& stamp) {
+  if (!publish_updates_) { return; }
+
+  if (lidar_scan_publisher_.getNumSubscribers() > 0) {
+    PointCloud cloud;
+    GetScanInMapFrame(stamp, cloud);
+    if (!cloud.empty()) {
+      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<pcl::PointXYZ>(
+          cloud, stamp, world_frame_id_, scan_updates_counter_);
+      lidar_scan_publisher_.publish(pc_msg);
+    }
+  }
+
+  if (loam_scan_publisher_.getNumSubscribers() > 0) {
+    LoamPointCloud loam_cloud;
+    GetScanInMapFrame(stamp, loam_cloud);
+    if (!loam_cloud.Empty()) {
+      LoamPointCloudCombined loam_combined = loam_cloud.GetCombinedCloud();
+      sensor_msgs::PointCloud2 pc_msg = beam::PCLToROS<PointLoam>(
+          loam_combined, stamp, world_frame_id_, scan_updates_counter_);
+      loam_scan_publisher_.publish(pc_msg);
+    }
+  }
+
+  scan_updates_counter_++;
+}
+
 ros::Time RegistrationMap::GetLastCloudPoseStamp() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (scans_.empty()) { return {}; }
   uint64_t t_in_ns = scans_.rbegin()->first;
   ros::Time stamp;
@@ -302,6 +816,7 @@ ros::Time RegistrationMap::GetLastCloudPoseStamp() const {
 
 void RegistrationMap::UpdateScanPosesFromGraphMsg(
     const fuse_core::Graph::ConstSharedPtr& graph_msg) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   for (const auto& [t_in_ns, scan] : scans_) {
     if (!graph_msg->variableExists(scan.position_uuid) ||
         !graph_msg->variableExists(scan.orientation_uuid)) {
@@ -330,8 +845,31 @@ void RegistrationMap::UpdateScanPosesFromGraphMsg(
   }
 }
 
+void RegistrationMap::UpdateScanPosesFromGraphMsg(
+    const bs_common::GraphView& graph_view) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  bs_common::ExtrinsicsLookupOnline& extrinsics =
+      bs_common::ExtrinsicsLookupOnline::GetInstance();
+  Eigen::Matrix4d T_Baselink_Scan;
+  extrinsics.GetT_BASELINK_LIDAR(T_Baselink_Scan);
+
+  for (const auto& [t_in_ns, scan] : scans_) {
+    ros::Time stamp;
+    stamp.fromNSec(t_in_ns);
+    const auto position = graph_view.GetPosition(stamp);
+    const auto orientation = graph_view.GetOrientation(stamp);
+    if (!position || !orientation) { continue; }
+
+    Eigen::Matrix4d T_World_Baselink;
+    bs_common::FusePoseToEigenTransform(*position, *orientation,
+                                        T_World_Baselink);
+    UpdateScan(stamp, T_World_Baselink * T_Baselink_Scan);
+  }
+}
+
 Eigen::Matrix4d RegistrationMap::CorrectMapDriftFromGraphMsg(
     const fuse_core::Graph::ConstSharedPtr& graph_msg, double update_point) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   Eigen::Matrix4d T_WorldCorrected_World;
   bool success = false;
   uint64_t time_start_ns = scans_.begin()->first;
@@ -371,9 +909,10 @@ Eigen::Matrix4d RegistrationMap::CorrectMapDriftFromGraphMsg(
   }
 
   // update all poses
-  std::unique_lock<std::mutex> lk(mutex_);
   for (auto& [t_in_ns, scan] : scans_) {
     scan.T_Map_Scan = T_WorldCorrected_World * scan.T_Map_Scan;
+    scan.coverage_voxels.clear();
+    if (store_scans_in_sensor_frame_) { MarkScanMoved(t_in_ns); }
   }
   return T_WorldCorrected_World;
 }
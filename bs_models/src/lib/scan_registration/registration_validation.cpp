@@ -2,9 +2,13 @@
 
 #include <math.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include <beam_utils/log.h>
 
 #include <bs_common/utils.h>
+#include <bs_models/scan_registration/voxel_key.h>
 
 namespace bs_models { namespace scan_registration {
 
@@ -114,4 +118,148 @@ bool RegistrationValidation::CheckMetricInitial(
   return true;
 }
 
-}} // namespace bs_models::scan_registration
\ No newline at end of file
+namespace {
+
+uint64_t VoxelKey(const pcl::PointXYZ& p, double voxel_size) {
+  return scan_registration::VoxelKey(Eigen::Vector3d(p.x, p.y, p.z),
+                                     voxel_size);
+}
+
+bool IsFinite(const pcl::PointXYZ& p) {
+  return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+struct VoxelStats {
+  Eigen::Vector3d sum{Eigen::Vector3d::Zero()};
+  Eigen::Matrix3d sum_sq{Eigen::Matrix3d::Zero()};
+  int count{0};
+};
+
+} // namespace
+
+void RegistrationPrecheck::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("enabled")) { enabled = J["enabled"]; }
+  if (J.contains("voxel_size")) { voxel_size = J["voxel_size"]; }
+  if (J.contains("min_points_per_voxel")) {
+    min_points_per_voxel = J["min_points_per_voxel"];
+  }
+  if (J.contains("planarity_threshold")) {
+    planarity_threshold = J["planarity_threshold"];
+  }
+  if (J.contains("degeneracy_threshold")) {
+    degeneracy_threshold = J["degeneracy_threshold"];
+  }
+  if (J.contains("min_overlap")) { min_overlap = J["min_overlap"]; }
+  if (J.contains("allow_prior_fallback")) {
+    allow_prior_fallback = J["allow_prior_fallback"];
+  }
+  if (J.contains("prior_covariance")) {
+    prior_covariance = J["prior_covariance"];
+  }
+}
+
+void RegistrationPrecheck::Params::Print(std::ostream& stream) const {
+  stream << "RegistrationPrecheck::Params: \n";
+  stream << "enabled: " << enabled << "\n";
+  stream << "voxel_size: " << voxel_size << "\n";
+  stream << "min_points_per_voxel: " << min_points_per_voxel << "\n";
+  stream << "planarity_threshold: " << planarity_threshold << "\n";
+  stream << "degeneracy_threshold: " << degeneracy_threshold << "\n";
+  stream << "min_overlap: " << min_overlap << "\n";
+  stream << "allow_prior_fallback: " << allow_prior_fallback << "\n";
+  stream << "prior_covariance: " << prior_covariance << "\n";
+}
+
+RegistrationPrecheck::Result RegistrationPrecheck::Check(
+    const std::vector<const PointCloud*>& target_clouds,
+    const std::vector<const PointCloud*>& reference_clouds) const {
+  Result result;
+  if (!params_.enabled) { return result; }
+
+  // bin the target points
+  std::unordered_map<uint64_t, VoxelStats> target_voxels;
+  for (const PointCloud* cloud : target_clouds) {
+    for (const auto& p : *cloud) {
+      if (!IsFinite(p)) { continue; }
+      VoxelStats& voxel = target_voxels[VoxelKey(p, params_.voxel_size)];
+      const Eigen::Vector3d v(p.x, p.y, p.z);
+      voxel.sum += v;
+      voxel.sum_sq += v * v.transpose();
+      voxel.count++;
+    }
+  }
+
+  // overlap, only the voxel occupancy of the reference is needed
+  std::unordered_set<uint64_t> reference_voxels;
+  for (const PointCloud* cloud : reference_clouds) {
+    for (const auto& p : *cloud) {
+      if (IsFinite(p)) {
+        reference_voxels.insert(VoxelKey(p, params_.voxel_size));
+      }
+    }
+  }
+  int num_overlapping = 0;
+  for (const auto& [key, voxel] : target_voxels) {
+    if (reference_voxels.find(key) != reference_voxels.end()) {
+      num_overlapping++;
+    }
+  }
+  result.overlap = 0;
+  if (!target_voxels.empty()) {
+    result.overlap =
+        static_cast<double>(num_overlapping) / target_voxels.size();
+  }
+
+  // normal information
+  Eigen::Matrix3d information = Eigen::Matrix3d::Zero();
+  for (const auto& [key, voxel] : target_voxels) {
+    if (voxel.count < params_.min_points_per_voxel) { continue; }
+    const Eigen::Vector3d mean = voxel.sum / voxel.count;
+    const Eigen::Matrix3d covariance =
+        voxel.sum_sq / voxel.count - mean * mean.transpose();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> voxel_solver(covariance);
+    const Eigen::Vector3d& eigenvalues = voxel_solver.eigenvalues();
+    if (eigenvalues[0] >= params_.planarity_threshold * eigenvalues[1]) {
+      continue;
+    }
+    const Eigen::Vector3d normal = voxel_solver.eigenvectors().col(0);
+    information += normal * normal.transpose();
+    result.num_planar_voxels++;
+  }
+
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(information);
+  if (result.num_planar_voxels > 0) {
+    result.information = solver.eigenvalues() / result.num_planar_voxels;
+  } else {
+    result.information = Eigen::Vector3d::Zero();
+  }
+  for (int i = 0; i < 3; i++) {
+    if (result.information[i] < params_.degeneracy_threshold) {
+      result.degenerate_directions.push_back(solver.eigenvectors().col(i));
+    }
+  }
+
+  if (result.overlap < params_.min_overlap ||
+      result.degenerate_directions.size() > 1) {
+    result.decision = params_.allow_prior_fallback ? Decision::USE_PRIOR
+                                                   : Decision::SKIP;
+  } else if (result.degenerate_directions.size() == 1) {
+    result.decision = Decision::CONSTRAINED;
+  }
+  return result;
+}
+
+std::string RegistrationPrecheck::DecisionToString(Decision decision) {
+  if (decision == Decision::REGISTER) {
+    return "REGISTER";
+  } else if (decision == Decision::CONSTRAINED) {
+    return "CONSTRAINED";
+  } else if (decision == Decision::USE_PRIOR) {
+    return "USE_PRIOR";
+  } else if (decision == Decision::SKIP) {
+    return "SKIP";
+  }
+  return "UNKNOWN";
+}
+
+}} // namespace bs_models::scan_registration
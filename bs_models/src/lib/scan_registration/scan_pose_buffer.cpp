@@ -0,0 +1,172 @@
+#include <bs_models/scan_registration/scan_pose_buffer.h>
+
+#include <algorithm>
+
+#include <bs_common/graph_snapshot.h>
+
+namespace bs_models::scan_registration {
+
+bool ScanPoseBuffer::Insert(const ScanPosePtr& scan) {
+  // scans are usually newer than all others, so check the end first
+  auto iter = scans_.empty() || scans_.back()->Stamp() < scan->Stamp()
+                  ? scans_.cend()
+                  : LowerBound(scan->Stamp());
+  if (iter != scans_.end() && (*iter)->Stamp() == scan->Stamp()) {
+    return false;
+  }
+  scans_.insert(iter, scan);
+  const uint64_t t_in_ns = scan->Stamp().toNSec();
+  variables_[scan->Position().uuid()] = t_in_ns;
+  variables_[scan->Orientation().uuid()] = t_in_ns;
+  return true;
+}
+
+ScanPoseBuffer::ScanPosePtr
+    ScanPoseBuffer::Find(const ros::Time& stamp) const {
+  auto iter = LowerBound(stamp);
+  if (iter == scans_.end() || (*iter)->Stamp() != stamp) { return nullptr; }
+  return *iter;
+}
+
+bool ScanPoseBuffer::Erase(const ros::Time& stamp) {
+  auto iter = LowerBound(stamp);
+  if (iter == scans_.end() || (*iter)->Stamp() != stamp) { return false; }
+  Unindex(**iter);
+  scans_.erase(iter);
+  return true;
+}
+
+size_t ScanPoseBuffer::EraseOlderThan(const ros::Time& stamp) {
+  size_t num_removed = 0;
+  while (!scans_.empty() && scans_.front()->Stamp() < stamp) {
+    Unindex(*scans_.front());
+    scans_.pop_front();
+    num_removed++;
+  }
+  return num_removed;
+}
+
+size_t ScanPoseBuffer::TrimOldest(size_t max_size) {
+  size_t num_removed = 0;
+  while (scans_.size() > max_size) {
+    Unindex(*scans_.front());
+    scans_.pop_front();
+    num_removed++;
+  }
+  return num_removed;
+}
+
+size_t ScanPoseBuffer::UpdatePoses(
+    const fuse_core::Graph::ConstSharedPtr& graph_msg) {
+  const bs_common::GraphDelta* delta = bs_common::GetGraphDelta(*graph_msg);
+  if (!delta) {
+    size_t num_updated = 0;
+    for (const auto& scan : scans_) {
+      if (scan->UpdatePose(graph_msg)) { num_updated++; }
+    }
+    return num_updated;
+  }
+
+  // position and orientation usually both changed, only update once
+  std::set<uint64_t> stamps;
+  AddStamps(delta->added_variables, stamps);
+  AddStamps(delta->changed_variables, stamps);
+
+  size_t num_updated = 0;
+  for (uint64_t t_in_ns : stamps) {
+    ros::Time stamp;
+    stamp.fromNSec(t_in_ns);
+    const ScanPosePtr scan = Find(stamp);
+    if (scan && scan->UpdatePose(graph_msg)) { num_updated++; }
+  }
+  return num_updated;
+}
+
+size_t ScanPoseBuffer::UpdatePoses(const bs_common::GraphView& graph_view,
+                                   std::vector<ScanPosePtr>& marginalized) {
+  marginalized.clear();
+  const bs_common::GraphDelta* delta =
+      graph_view.Graph() ? bs_common::GetGraphDelta(*graph_view.Graph())
+                         : nullptr;
+  size_t num_updated = 0;
+  if (!delta) {
+    // scans that were never updated are probably not in the window yet
+    auto iter = scans_.begin();
+    for (auto& scan : scans_) {
+      if (scan->UpdatePose(graph_view)) {
+        num_updated++;
+      } else if (scan->Updates() > 0) {
+        Unindex(*scan);
+        marginalized.push_back(std::move(scan));
+        continue;
+      }
+      *(iter++) = std::move(scan);
+    }
+    scans_.erase(iter, scans_.end());
+    return num_updated;
+  }
+
+  // the removed variables of graphs that were superseded (see CallbackLane)
+  // are in no delta, so updated scans are marginalized once their variables
+  // are missing from the graph rather than when they are removed
+  const fuse_core::Graph& graph = *graph_view.Graph();
+  auto iter = scans_.begin();
+  for (auto& scan : scans_) {
+    if (scan->Updates() > 0 &&
+        (!graph.variableExists(scan->Position().uuid()) ||
+         !graph.variableExists(scan->Orientation().uuid()))) {
+      Unindex(*scan);
+      marginalized.push_back(std::move(scan));
+      continue;
+    }
+    *(iter++) = std::move(scan);
+  }
+  scans_.erase(iter, scans_.end());
+
+  std::set<uint64_t> stamps;
+  AddStamps(delta->added_variables, stamps);
+  AddStamps(delta->changed_variables, stamps);
+  for (uint64_t t_in_ns : stamps) {
+    ros::Time stamp;
+    stamp.fromNSec(t_in_ns);
+    const ScanPosePtr scan = Find(stamp);
+    if (scan && scan->UpdatePose(graph_view)) { num_updated++; }
+  }
+
+  // scans inserted after the update which added their variables are not in
+  // any delta, these are the newest scans
+  for (auto iter = scans_.rbegin();
+       iter != scans_.rend() && (*iter)->Updates() == 0; iter++) {
+    if ((*iter)->UpdatePose(graph_view)) { num_updated++; }
+  }
+  return num_updated;
+}
+
+void ScanPoseBuffer::Clear() {
+  scans_.clear();
+  variables_.clear();
+}
+
+std::deque<ScanPoseBuffer::ScanPosePtr>::const_iterator
+    ScanPoseBuffer::LowerBound(const ros::Time& stamp) const {
+  return std::lower_bound(
+      scans_.begin(), scans_.end(), stamp,
+      [](const ScanPosePtr& scan, const ros::Time& t) {
+        return scan->Stamp() < t;
+      });
+}
+
+void ScanPoseBuffer::Unindex(const ScanPose& scan) {
+  variables_.erase(scan.Position().uuid());
+  variables_.erase(scan.Orientation().uuid());
+}
+
+void ScanPoseBuffer::AddStamps(const std::vector<fuse_core::UUID>& uuids,
+                               std::set<uint64_t>& stamps) const {
+  for (const auto& uuid : uuids) {
+    auto iter = variables_.find(uuid);
+    if (iter != variables_.end()) { stamps.insert(iter->second); }
+  }
+}
+
+} // namespace bs_models::scan_registration
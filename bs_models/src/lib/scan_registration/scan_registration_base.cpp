@@ -19,7 +19,8 @@ using namespace bs_common;
 
 std::unique_ptr<ScanRegistrationBase> ScanRegistrationBase::Create(
     const std::string& registration_config, const std::string& matcher_config,
-    const std::string& save_path, double extrinsics_prior) {
+    const std::string& save_path, double extrinsics_prior,
+    const std::shared_ptr<RegistrationMap>& map) {
   // get registration type
   if (!std::filesystem::exists(registration_config)) {
     BEAM_ERROR("invalid file path for matcher config, file path: {}",
@@ -51,19 +52,35 @@ std::unique_ptr<ScanRegistrationBase> ScanRegistrationBase::Create(
       ScanToMapLoamRegistration::Params params;
       params.LoadFromJson(registration_config);
       params.save_path = save_path;
-      registration = std::make_unique<ScanToMapLoamRegistration>(
-          std::move(matcher), params.GetBaseParams(), params.map_size,
-          params.downsample_voxel_size);
+      auto scan_to_map_registration =
+          std::make_unique<ScanToMapLoamRegistration>(
+              std::move(matcher), params.GetBaseParams(), params.map_size,
+              params.downsample_voxel_size, params.store_scans_in_sensor_frame);
+      scan_to_map_registration->SetPrecheckParams(params.precheck);
+      scan_to_map_registration->SetRetentionParams(params.retention);
+      scan_to_map_registration->SetLoamSolverParams(params.loam_solver);
+      scan_to_map_registration->SetPyramidVoxelSizes(
+          params.pyramid_voxel_sizes);
+      registration = std::move(scan_to_map_registration);
       registration->SetExtrinsicsPrior(extrinsics_prior);
+      if (map) { registration->SetMap(map); }
       return std::move(registration);
     } else if (registration_type == "MULTISCAN") {
       MultiScanRegistrationBase::Params params;
       params.LoadFromJson(registration_config);
       params.save_path = save_path;
+      // create one matcher per thread
+      std::vector<std::unique_ptr<LoamMatcher>> matchers;
+      matchers.push_back(std::move(matcher));
+      for (int i = 1; i < params.num_threads; i++) {
+        matchers.push_back(std::make_unique<LoamMatcher>(
+            LoamParams(matcher_config, ceres_config)));
+      }
       registration = std::make_unique<MultiScanLoamRegistration>(
-          std::move(matcher), params.GetBaseParams(), params.num_neighbors,
+          std::move(matchers), params.GetBaseParams(), params.num_neighbors,
           params.lag_duration, params.disable_lidar_map);
       registration->SetExtrinsicsPrior(extrinsics_prior);
+      if (map) { registration->SetMap(map); }
       return std::move(registration);
     } else {
       BEAM_ERROR("registration type not yet implemented");
@@ -72,40 +89,52 @@ std::unique_ptr<ScanRegistrationBase> ScanRegistrationBase::Create(
   }
 
   // non-loam, only multi scan is implemented so far
-  std::unique_ptr<Matcher<PointCloudPtr>> matcher;
+  std::vector<std::unique_ptr<Matcher<PointCloudPtr>>> matchers;
   MultiScanRegistrationBase::Params params;
   params.LoadFromJson(registration_config);
   params.save_path = save_path;
   if (registration_type == "MULTISCAN") {
-    if (matcher_type == beam_matching::MatcherType::ICP) {
-      matcher =
-          std::make_unique<IcpMatcher>(IcpMatcher::Params(matcher_config));
-      registration = std::make_unique<MultiScanRegistration>(
-          std::move(matcher), params.GetBaseParams(), params.num_neighbors,
-          params.lag_duration, params.disable_lidar_map);
-    } else if (matcher_type == beam_matching::MatcherType::GICP) {
-      matcher =
-          std::make_unique<GicpMatcher>(GicpMatcher::Params(matcher_config));
-      registration = std::make_unique<MultiScanRegistration>(
-          std::move(matcher), params.GetBaseParams(), params.num_neighbors,
-          params.lag_duration, params.disable_lidar_map);
-    } else if (matcher_type == beam_matching::MatcherType::NDT) {
-      matcher =
-          std::make_unique<NdtMatcher>(NdtMatcher::Params(matcher_config));
-      registration = std::make_unique<MultiScanRegistration>(
-          std::move(matcher), params.GetBaseParams(), params.num_neighbors,
-          params.lag_duration, params.disable_lidar_map);
-    } else {
-      ROS_ERROR(
-          "Invalid global matcher type. Not creating scan registration class");
-      throw std::invalid_argument{"invalid json"};
+    // create one matcher per thread
+    for (int i = 0; i < params.num_threads; i++) {
+      if (matcher_type == beam_matching::MatcherType::ICP) {
+        matchers.push_back(
+            std::make_unique<IcpMatcher>(IcpMatcher::Params(matcher_config)));
+      } else if (matcher_type == beam_matching::MatcherType::GICP) {
+        matchers.push_back(
+            std::make_unique<GicpMatcher>(GicpMatcher::Params(matcher_config)));
+      } else if (matcher_type == beam_matching::MatcherType::NDT) {
+        matchers.push_back(
+            std::make_unique<NdtMatcher>(NdtMatcher::Params(matcher_config)));
+      } else {
+        ROS_ERROR(
+            "Invalid global matcher type. Not creating scan registration "
+            "class");
+        throw std::invalid_argument{"invalid json"};
+      }
     }
+    auto multi_scan_registration = std::make_unique<MultiScanRegistration>(
+        std::move(matchers), params.GetBaseParams(), params.num_neighbors,
+        params.lag_duration, params.disable_lidar_map);
+    multi_scan_registration->SetMatchVoxelSize(params.match_voxel_size);
+    if (matcher_type == beam_matching::MatcherType::GICP &&
+        GpuGicpMatcher::RequestedInConfig(matcher_config)) {
+      if (GpuGicpMatcher::Available()) {
+        GpuGicpMatcher::Params gpu_params;
+        gpu_params.LoadFromJson(matcher_config);
+        multi_scan_registration->SetGpuMatcher(
+            std::make_unique<GpuGicpMatcher>(gpu_params));
+      } else {
+        BEAM_WARN("CUDA GICP matcher is not available, using CPU matcher.");
+      }
+    }
+    registration = std::move(multi_scan_registration);
   } else {
     BEAM_ERROR("registration type not yet implemented");
     throw std::runtime_error{"function not implemented"};
   }
 
   registration->SetExtrinsicsPrior(extrinsics_prior);
+  if (map) { registration->SetMap(map); }
   return std::move(registration);
 }
 
@@ -116,6 +145,7 @@ void ScanRegistrationParamsBase::Print(std::ostream& stream) const {
   stream << "max_motion_trans_m: " << max_motion_trans_m << "\n";
   stream << "fix_first_scan: " << fix_first_scan << "\n";
   stream << "save_path: " << save_path << "\n";
+  hessian_covariance.Print(stream);
 }
 
 void ScanRegistrationParamsBase::LoadBaseFromJson(const std::string& config) {
@@ -144,6 +174,9 @@ void ScanRegistrationParamsBase::LoadBaseFromJson(const std::string& config) {
   min_motion_rot_deg = J["min_motion_rot_deg"];
   max_motion_trans_m = J["max_motion_trans_m"];
   fix_first_scan = J["fix_first_scan"];
+  if (J.contains("hessian_covariance")) {
+    hessian_covariance.LoadFromJson(J["hessian_covariance"]);
+  }
 }
 
 ScanRegistrationBase::ScanRegistrationBase(
@@ -153,6 +186,7 @@ ScanRegistrationBase::ScanRegistrationBase(
 void ScanRegistrationBase::SetFixedCovariance(
     const Eigen::Matrix<double, 6, 6>& covariance) {
   covariance_ = covariance;
+  fixed_covariance_ = covariance;
   use_fixed_covariance_ = true;
 }
 
@@ -161,15 +195,39 @@ void ScanRegistrationBase::SetFixedCovariance(double covariance) {
   cov_vec << covariance, covariance, covariance, covariance, covariance,
       covariance;
   covariance_ = cov_vec.asDiagonal();
+  fixed_covariance_ = covariance_;
   use_fixed_covariance_ = true;
 }
 
+void ScanRegistrationBase::SetMap(const std::shared_ptr<RegistrationMap>& map) {
+  map_ = map;
+}
+
 const RegistrationMap& ScanRegistrationBase::GetMap() const {
-  return map_;
+  return *map_;
 }
 
 RegistrationMap& ScanRegistrationBase::GetMapMutable() {
-  return map_;
+  return *map_;
+}
+
+bool ScanRegistrationBase::GetScanBaselinkPose(
+    const ros::Time& stamp, Eigen::Matrix4d& T_MAP_BASELINK) {
+  Eigen::Matrix4d T_MAP_SCAN;
+  if (!map_->GetScanPose(stamp, T_MAP_SCAN)) { return false; }
+
+  // scans added without a frame are assumed to be from this lidar
+  std::string scan_frame;
+  map_->GetScanSensorFrame(stamp, scan_frame);
+  if (scan_frame.empty()) { scan_frame = lidar_frame_id_; }
+
+  Eigen::Matrix4d T_SCAN_BASELINK;
+  if (!extrinsics_.GetT_SENSOR_BASELINK(T_SCAN_BASELINK, scan_frame, stamp)) {
+    BEAM_ERROR("Cannot lookup transform from {} to baselink", scan_frame);
+    return false;
+  }
+  T_MAP_BASELINK = T_MAP_SCAN * T_SCAN_BASELINK;
+  return true;
 }
 
 bool ScanRegistrationBase::PassedMotionThresholds(
@@ -6,6 +6,7 @@
 #include <beam_matching/Matchers.h>
 
 #include <bs_common/conversions.h>
+#include <bs_common/instrumentation.h>
 #include <bs_common/utils.h>
 #include <bs_constraints/relative_pose/pose_3d_stamped_transaction.h>
 #include <bs_models/scan_registration/registration_map.h>
@@ -21,18 +22,21 @@ ScanToMapRegistrationBase::ScanToMapRegistrationBase(
 
 bs_constraints::Pose3DStampedTransaction
     ScanToMapRegistrationBase::RegisterNewScan(const ScanPose& new_scan) {
-  bs_constraints::Pose3DStampedTransaction transaction(new_scan.Stamp());
+  if (prior_map_) { return RegisterNewScanToPriorMap(new_scan); }
+
+  bs_constraints::Pose3DStampedTransaction transaction(
+      new_scan.Stamp(), true, true, use_pooled_allocation_);
   // add pose variables for new scan
   transaction.AddPoseVariables(new_scan.Position(), new_scan.Orientation(),
                                new_scan.Stamp());
 
   // if this is the first scan, we need to treat it differently
   if (scan_pose_prev_ == nullptr) {
-    transaction.AddExtrinsicVariablesForFrame(extrinsics_.GetLidarFrameId(),
+    transaction.AddExtrinsicVariablesForFrame(lidar_frame_id_,
                                               extrinsics_prior_);
 
     // if registration map is empty, then just add prior, add to map and return
-    if (map_.Empty()) {
+    if (map_->Empty()) {
       Eigen::Matrix4d T_MAP_SCAN = new_scan.T_REFFRAME_LIDAR();
       AddScanToMap(new_scan, T_MAP_SCAN);
       if (base_params_.fix_first_scan) {
@@ -47,12 +51,13 @@ bs_constraints::Pose3DStampedTransaction
     } else {
       // if map exists, then use the last scan in the map as the previous with a
       // prior
-      ros::Time last_time = map_.GetLastCloudPoseStamp();
-      Eigen::Matrix4d T_MAP_SCAN;
-      map_.GetScanPose(last_time, T_MAP_SCAN);
+      ros::Time last_time = map_->GetLastCloudPoseStamp();
+      Eigen::Matrix4d T_MAP_BASELINK;
+      if (!GetScanBaselinkPose(last_time, T_MAP_BASELINK)) {
+        throw std::runtime_error{"cannot lookup transform"};
+      }
       scan_pose_prev_ = std::make_unique<ScanPose>(
-          last_time, T_MAP_SCAN * new_scan.T_LIDAR_BASELINK(),
-          new_scan.T_BASELINK_LIDAR());
+          last_time, T_MAP_BASELINK, new_scan.T_BASELINK_LIDAR());
       if (base_params_.fix_first_scan) {
         transaction.AddPosePrior(
             scan_pose_prev_->Position(), scan_pose_prev_->Orientation(),
@@ -75,7 +80,7 @@ bs_constraints::Pose3DStampedTransaction
       scan_pose_prev_->Position(), new_scan.Position(),
       scan_pose_prev_->Orientation(), new_scan.Orientation(),
       bs_common::TransformMatrixToVectorWithQuaternion(T_LidarPrev_LidarNew),
-      covariance_weight_ * covariance_, source_, extrinsics_.GetLidarFrameId());
+      covariance_weight_ * covariance_, source_, lidar_frame_id_);
 
   // add new registered scan and then trim the map
   AddScanToMap(new_scan, T_MAP_SCAN);
@@ -87,12 +92,54 @@ bs_constraints::Pose3DStampedTransaction
   return transaction;
 }
 
+bs_constraints::Pose3DStampedTransaction
+    ScanToMapRegistrationBase::RegisterNewScanToPriorMap(
+        const ScanPose& new_scan) {
+  Eigen::Matrix4d T_MAP_SCAN;
+  if (!RegisterScanToMap(new_scan, T_MAP_SCAN)) {
+    return bs_constraints::Pose3DStampedTransaction(new_scan.Stamp());
+  }
+
+  bs_constraints::Pose3DStampedTransaction transaction(
+      new_scan.Stamp(), true, true, use_pooled_allocation_);
+  transaction.AddPoseVariables(new_scan.Position(), new_scan.Orientation(),
+                               new_scan.Stamp());
+  if (scan_pose_prev_ == nullptr) {
+    transaction.AddExtrinsicVariablesForFrame(lidar_frame_id_,
+                                              extrinsics_prior_);
+  }
+
+  // the prior map is fixed, so the registered pose is an absolute measurement
+  fuse_variables::Position3DStamped position = new_scan.Position();
+  fuse_variables::Orientation3DStamped orientation = new_scan.Orientation();
+  const Eigen::Matrix4d T_MAP_BASELINK =
+      T_MAP_SCAN * new_scan.T_LIDAR_BASELINK();
+  bs_common::EigenTransformToFusePose(T_MAP_BASELINK, position, orientation);
+  transaction.AddPosePrior(position, orientation,
+                           covariance_weight_ * covariance_, source_);
+
+  scan_pose_prev_ = std::make_unique<ScanPose>(
+      new_scan.Stamp(), T_MAP_BASELINK, new_scan.T_BASELINK_LIDAR());
+  return transaction;
+}
+
+bool ScanToMapRegistrationBase::GetRegisteredScanPose(
+    const ros::Time& stamp, Eigen::Matrix4d& T_MAP_LIDAR) const {
+  if (prior_map_) {
+    if (!scan_pose_prev_ || scan_pose_prev_->Stamp() != stamp) { return false; }
+    T_MAP_LIDAR = scan_pose_prev_->T_REFFRAME_LIDAR();
+    return true;
+  }
+  return ScanRegistrationBase::GetRegisteredScanPose(stamp, T_MAP_LIDAR);
+}
+
 ScanToMapLoamRegistration::Params::Params(
     const ScanRegistrationParamsBase& base_params, int _map_size,
-    double _downsample_voxel_size)
+    double _downsample_voxel_size, bool _store_scans_in_sensor_frame)
     : ScanRegistrationParamsBase(base_params),
       map_size(_map_size),
-      downsample_voxel_size(_downsample_voxel_size) {}
+      downsample_voxel_size(_downsample_voxel_size),
+      store_scans_in_sensor_frame(_store_scans_in_sensor_frame) {}
 
 void ScanToMapLoamRegistration::Params::LoadFromJson(
     const std::string& config) {
@@ -134,6 +181,17 @@ void ScanToMapLoamRegistration::Params::LoadFromJson(
 
   map_size = J["map_size"];
   downsample_voxel_size = J["downsample_voxel_size"];
+  if (J.contains("store_scans_in_sensor_frame")) {
+    store_scans_in_sensor_frame = J["store_scans_in_sensor_frame"];
+  }
+  if (J.contains("pyramid_voxel_sizes")) {
+    pyramid_voxel_sizes = J["pyramid_voxel_sizes"].get<std::vector<double>>();
+  }
+  if (J.contains("retention")) { retention.LoadFromJson(J["retention"]); }
+  if (J.contains("precheck")) { precheck.LoadFromJson(J["precheck"]); }
+  if (J.contains("loam_solver")) {
+    loam_solver.LoadFromJson(J["loam_solver"]);
+  }
 }
 
 void ScanToMapLoamRegistration::Params::Print(std::ostream& stream) const {
@@ -141,6 +199,16 @@ void ScanToMapLoamRegistration::Params::Print(std::ostream& stream) const {
   stream << "ScanToMapLoamRegistration::Params: \n";
   stream << "map_size: " << map_size << "\n";
   stream << "downsample_voxel_size: " << downsample_voxel_size << "\n";
+  stream << "store_scans_in_sensor_frame: " << store_scans_in_sensor_frame
+         << "\n";
+  stream << "pyramid_voxel_sizes: [";
+  for (size_t i = 0; i < pyramid_voxel_sizes.size(); i++) {
+    stream << (i > 0 ? ", " : "") << pyramid_voxel_sizes[i];
+  }
+  stream << "]\n";
+  retention.Print(stream);
+  precheck.Print(stream);
+  loam_solver.Print(stream);
 }
 
 ScanRegistrationParamsBase
@@ -150,44 +218,196 @@ ScanRegistrationParamsBase
       .min_motion_rot_deg = min_motion_rot_deg,
       .max_motion_trans_m = max_motion_trans_m,
       .fix_first_scan = fix_first_scan,
-      .save_path = save_path};
+      .save_path = save_path,
+      .hessian_covariance = hessian_covariance};
   return base_params;
 }
 
 ScanToMapLoamRegistration::ScanToMapLoamRegistration(
     std::unique_ptr<LoamMatcher> matcher,
     const ScanRegistrationParamsBase& base_params, int map_size,
-    double downsample_voxel_size)
+    double downsample_voxel_size, bool store_scans_in_sensor_frame)
     : ScanToMapRegistrationBase(base_params),
       matcher_(std::move(matcher)),
-      params_(base_params, map_size, downsample_voxel_size) {
-  map_.SetMapSize(params_.map_size);
-  map_.SetVoxelDownsampleSize(params_.downsample_voxel_size);
+      params_(base_params, map_size, downsample_voxel_size,
+              store_scans_in_sensor_frame),
+      hessian_covariance_(params_.hessian_covariance),
+      precheck_(params_.precheck) {
+  SetupMap();
+}
+
+void ScanToMapLoamRegistration::SetMap(
+    const std::shared_ptr<RegistrationMap>& map) {
+  ScanToMapRegistrationBase::SetMap(map);
+  matcher_ref_ = nullptr;
+  hessian_ref_ = nullptr;
+  solver_refs_.assign(solvers_.size(), nullptr);
+  SetupMap();
+}
+
+void ScanToMapLoamRegistration::SetLoamSolverParams(
+    const LoamSolver::Params& params) {
+  params_.loam_solver = params;
+  SetupSolvers();
+  SetupMap();
+}
+
+void ScanToMapLoamRegistration::SetPyramidVoxelSizes(
+    const std::vector<double>& voxel_sizes) {
+  params_.pyramid_voxel_sizes = voxel_sizes;
+  SetupSolvers();
+  SetupMap();
+}
+
+void ScanToMapLoamRegistration::SetRetentionParams(
+    const RegistrationMap::RetentionParams& params) {
+  params_.retention = params;
+  SetupMap();
+}
+
+void ScanToMapLoamRegistration::SetupMap() {
+  map_->SetMapSize(params_.map_size);
+  map_->SetRetentionParams(params_.retention);
+  map_->SetVoxelDownsampleSize(params_.downsample_voxel_size);
+  map_->SetStoreScansInSensorFrame(params_.store_scans_in_sensor_frame);
+
+  // the coarse levels are only matched by the native solver
+  map_->SetPyramidVoxelSizes(solvers_.empty() ? std::vector<double>{}
+                                              : params_.pyramid_voxel_sizes);
+}
+
+void ScanToMapLoamRegistration::SetupSolvers() {
+  solvers_.clear();
+  if (params_.loam_solver.enabled) {
+    solvers_.push_back(std::make_unique<LoamSolver>(params_.loam_solver));
+    for (double voxel_size : params_.pyramid_voxel_sizes) {
+      LoamSolver::Params params = params_.loam_solver;
+      params.max_correspondence_distance_m =
+          std::max(params.max_correspondence_distance_m, 3 * voxel_size);
+      params.huber_delta_m = std::max(params.huber_delta_m, 0.5 * voxel_size);
+      solvers_.push_back(std::make_unique<LoamSolver>(params));
+    }
+  }
+  solver_refs_.assign(solvers_.size(), nullptr);
 }
 
 bool ScanToMapLoamRegistration::RegisterScanToMap(const ScanPose& scan_pose,
                                                   Eigen::Matrix4d& T_MAP_SCAN) {
   const Eigen::Matrix4d& T_MAPEST_SCAN = scan_pose.T_REFFRAME_LIDAR();
-  const Eigen::Matrix4d& T_MAP_SCANPREV = scan_pose_prev_->T_REFFRAME_LIDAR();
-  Eigen::Matrix4d T_SCANPREV_SCANNEW =
-      beam::InvertTransform(T_MAP_SCANPREV) * T_MAPEST_SCAN;
-  if (!PassedMotionThresholds(T_SCANPREV_SCANNEW)) { return false; }
 
+  // the constraint covariance is expressed in the previous scan frame, or in
+  // the map frame for the absolute constraints against a prior map
+  Eigen::Matrix3d R_CONSTRAINT_MAP = Eigen::Matrix3d::Identity();
+  if (scan_pose_prev_) {
+    const Eigen::Matrix4d& T_MAP_SCANPREV =
+        scan_pose_prev_->T_REFFRAME_LIDAR();
+    Eigen::Matrix4d T_SCANPREV_SCANNEW =
+        beam::InvertTransform(T_MAP_SCANPREV) * T_MAPEST_SCAN;
+    if (!PassedMotionThresholds(T_SCANPREV_SCANNEW)) { return false; }
+    if (!prior_map_) {
+      R_CONSTRAINT_MAP = T_MAP_SCANPREV.block<3, 3>(0, 0).transpose();
+    }
+  }
+
+  // the matcher needs the scan in the map frame, this is the only copy of the
+  // scan made for a registration
   LoamPointCloudPtr scan_in_map_frame =
       std::make_shared<LoamPointCloud>(scan_pose.LoamCloud(), T_MAPEST_SCAN);
-  // get combined loam cloud map
-  LoamPointCloudPtr current_map =
-      std::make_shared<LoamPointCloud>(map_.GetLoamCloudMap());
-  matcher_->SetRef(current_map);
-  matcher_->SetTarget(scan_in_map_frame);
-  if (!matcher_->Match()) { return false; }
-  if (!params_.save_path.empty()) {
-    matcher_->SaveResults(params_.save_path,
-                          std::to_string(scan_pose.Stamp().toSec()));
+  // get combined loam cloud map, shared with the map without copying
+  LoamPointCloudPtr current_map;
+  if (prior_map_) {
+    prior_map_->Update(T_MAPEST_SCAN.block<3, 1>(0, 3));
+    current_map = prior_map_->GetLoamCloudMapPtr();
+  } else {
+    current_map = map_->GetLoamCloudMapPtr();
   }
-  Eigen::Matrix4d T_MAPEST_MAP = matcher_->GetResult().matrix();
 
-  if (!use_fixed_covariance_) { covariance_ = matcher_->GetCovariance(); }
+  // check the scan can be registered before paying for the match
+  using Decision = RegistrationPrecheck::Decision;
+  last_precheck_result_ = precheck_.Check(
+      {&scan_in_map_frame->surfaces.strong.cloud,
+       &scan_in_map_frame->surfaces.weak.cloud},
+      {&current_map->surfaces.strong.cloud,
+       &current_map->surfaces.weak.cloud});
+  ReportPrecheck(last_precheck_result_, scan_pose.Stamp());
+  if (last_precheck_result_.decision == Decision::SKIP) { return false; }
+  if (last_precheck_result_.decision == Decision::USE_PRIOR) {
+    covariance_ = params_.precheck.prior_covariance *
+                  Eigen::Matrix<double, 6, 6>::Identity();
+    T_MAP_SCAN = T_MAPEST_SCAN;
+    return true;
+  }
+
+  // only rebuild the reference kd-trees if the map changed since the last
+  // registration (e.g., not after skipped or failed registrations)
+  Eigen::Matrix4d T_MAPEST_MAP;
+  if (!solvers_.empty()) {
+    // the solvers align the scan in its own frame, from the coarsest map level
+    // to the full map, each starting from the result of the previous one
+    Eigen::Matrix4d T_MAP_SCAN_EST = T_MAPEST_SCAN;
+    const int num_levels = prior_map_ ? 1 : static_cast<int>(solvers_.size());
+    for (int level = num_levels - 1; level >= 0; level--) {
+      const LoamPointCloudPtr level_map =
+          level == 0 ? current_map : map_->GetLoamCloudMapPtr(level);
+      LoamSolver& solver = *solvers_.at(level);
+      if (level_map != solver_refs_.at(level)) {
+        solver.SetRef(level_map);
+        solver_refs_.at(level) = level_map;
+      }
+      solver.SetTarget(scan_pose.LoamCloud());
+      // a coarse level may be too sparse to match, the finer levels still
+      // start from the last result
+      if (!solver.Match(T_MAP_SCAN_EST)) {
+        if (level == 0) { return false; }
+        continue;
+      }
+      T_MAP_SCAN_EST = solver.GetResult();
+    }
+    T_MAPEST_MAP = T_MAPEST_SCAN * beam::InvertTransform(T_MAP_SCAN_EST);
+  } else {
+    if (current_map != matcher_ref_) {
+      matcher_->SetRef(current_map);
+      matcher_ref_ = current_map;
+    }
+    matcher_->SetTarget(scan_in_map_frame);
+    if (!matcher_->Match()) { return false; }
+    if (!params_.save_path.empty()) {
+      matcher_->SaveResults(params_.save_path,
+                            std::to_string(scan_pose.Stamp().toSec()));
+    }
+    T_MAPEST_MAP = matcher_->GetResult().matrix();
+  }
+
+  if (use_fixed_covariance_) {
+    covariance_ = fixed_covariance_;
+  } else if (!params_.hessian_covariance.enabled ||
+             !ComputeHessianCovariance(
+                 scan_pose, current_map,
+                 beam::InvertTransform(T_MAPEST_MAP) * T_MAPEST_SCAN,
+                 R_CONSTRAINT_MAP, covariance_)) {
+    if (!solvers_.empty()) {
+      // same convention as the hessian covariance
+      Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Identity();
+      A.block<3, 3>(0, 0) = R_CONSTRAINT_MAP;
+      covariance_ = A * solvers_.front()->GetCovariance() * A.transpose();
+    } else {
+      covariance_ = matcher_->GetCovariance();
+    }
+  }
+
+  // the match is unconstrained along degenerate directions, so keep the
+  // estimate along these and inflate the covariance of the constraint to
+  // match
+  if (last_precheck_result_.decision == Decision::CONSTRAINED) {
+    for (const Eigen::Vector3d& d :
+         last_precheck_result_.degenerate_directions) {
+      Eigen::Vector3d t = T_MAPEST_MAP.block<3, 1>(0, 3);
+      T_MAPEST_MAP.block<3, 1>(0, 3) = t - d * d.dot(t);
+      const Eigen::Vector3d d_constraint = R_CONSTRAINT_MAP * d;
+      covariance_.block<3, 3>(0, 0) += params_.precheck.prior_covariance *
+                                       d_constraint * d_constraint.transpose();
+    }
+  }
 
   if (registration_validation_.Validate(T_MAPEST_MAP, covariance_)) {
     T_MAP_SCAN = beam::InvertTransform(T_MAPEST_MAP) * T_MAPEST_SCAN;
@@ -196,10 +416,67 @@ bool ScanToMapLoamRegistration::RegisterScanToMap(const ScanPose& scan_pose,
   return false;
 }
 
+bool ScanToMapLoamRegistration::ComputeHessianCovariance(
+    const ScanPose& scan_pose, const LoamPointCloudPtr& current_map,
+    const Eigen::Matrix4d& T_MAP_SCAN, const Eigen::Matrix3d& R_CONSTRAINT_MAP,
+    Eigen::Matrix<double, 6, 6>& covariance) {
+  if (current_map != hessian_ref_) {
+    hessian_covariance_.SetReference(
+        {&current_map->surfaces.strong.cloud,
+         &current_map->surfaces.weak.cloud},
+        {&current_map->edges.strong.cloud, &current_map->edges.weak.cloud});
+    hessian_ref_ = current_map;
+  }
+  const LoamPointCloud& scan = scan_pose.LoamCloud();
+  if (!hessian_covariance_.Compute({&scan.surfaces.strong.cloud},
+                                   {&scan.edges.strong.cloud}, T_MAP_SCAN,
+                                   covariance)) {
+    BEAM_WARN("Too few correspondences ({}) for the hessian covariance, using "
+              "the matcher covariance",
+              hessian_covariance_.NumCorrespondences());
+    return false;
+  }
+
+  // the translation is perturbed in the map frame
+  Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Identity();
+  A.block<3, 3>(0, 0) = R_CONSTRAINT_MAP;
+  covariance = A * covariance * A.transpose();
+  return true;
+}
+
+void ScanToMapLoamRegistration::ReportPrecheck(
+    const RegistrationPrecheck::Result& result, const ros::Time& stamp) const {
+  static bs_common::Metric& constrained_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "scan_registration/precheck_constrained");
+  static bs_common::Metric& prior_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "scan_registration/precheck_used_prior");
+  static bs_common::Metric& skipped_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "scan_registration/precheck_skipped");
+
+  using Decision = RegistrationPrecheck::Decision;
+  if (!params_.precheck.enabled) { return; }
+  if (result.decision == Decision::CONSTRAINED) {
+    constrained_metric.Increment();
+  } else if (result.decision == Decision::USE_PRIOR) {
+    prior_metric.Increment();
+  } else if (result.decision == Decision::SKIP) {
+    skipped_metric.Increment();
+  }
+  ROS_DEBUG("Registration precheck for scan at %.5f: %s (overlap: %.3f, "
+            "information: [%.3f, %.3f, %.3f], planar voxels: %d)",
+            stamp.toSec(),
+            RegistrationPrecheck::DecisionToString(result.decision).c_str(),
+            result.overlap, result.information[0], result.information[1],
+            result.information[2], result.num_planar_voxels);
+}
+
 void ScanToMapLoamRegistration::AddScanToMap(
     const ScanPose& scan_pose, const Eigen::Matrix4d& T_MAP_SCAN) {
-  map_.AddPointCloud(scan_pose.Cloud(), scan_pose.LoamCloud(),
-                     scan_pose.Stamp(), T_MAP_SCAN);
+  map_->AddPointCloud(scan_pose.Cloud(), scan_pose.LoamCloud(),
+                      scan_pose.Stamp(), T_MAP_SCAN, lidar_frame_id_);
 }
 
 }} // namespace bs_models::scan_registration
@@ -0,0 +1,54 @@
+#include <bs_models/vision/batch_triangulator.h>
+
+#include <algorithm>
+
+#include <beam_cv/geometry/Triangulation.h>
+
+namespace bs_models { namespace vision {
+
+BatchTriangulator::BatchTriangulator(
+    std::shared_ptr<beam_calibration::CameraModel> cam_model,
+    int num_threads)
+    : cam_model_(cam_model), num_threads_(std::max(num_threads, 1)) {}
+
+std::vector<beam::opt<Eigen::Vector3d>>
+    BatchTriangulator::Triangulate(const std::vector<Request>& requests) const {
+  return Run(requests, [this](const Request& request) {
+    return beam_cv::Triangulation::TriangulatePoint(
+        CameraModel(request), request.T_cam_world, request.pixels);
+  });
+}
+
+std::vector<beam::opt<Eigen::Vector3d>>
+    BatchTriangulator::Triangulate(const std::vector<Request>& requests,
+                                   double max_distance,
+                                   double max_reprojection) const {
+  return Run(requests, [&](const Request& request) {
+    return beam_cv::Triangulation::TriangulatePoint(
+        CameraModel(request), request.T_cam_world, request.pixels,
+        max_distance, max_reprojection);
+  });
+}
+
+const std::shared_ptr<beam_calibration::CameraModel>&
+    BatchTriangulator::CameraModel(const Request& request) const {
+  return request.cam_model ? request.cam_model : cam_model_;
+}
+
+std::vector<beam::opt<Eigen::Vector3d>> BatchTriangulator::Run(
+    const std::vector<Request>& requests,
+    const std::function<beam::opt<Eigen::Vector3d>(const Request&)>&
+        triangulate) const {
+  // each result is only written by one task, so no locking is needed
+  std::vector<beam::opt<Eigen::Vector3d>> points(requests.size());
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, requests.size(),
+      [&](size_t i) {
+        if (requests[i].T_cam_world.size() < 2) { return; }
+        points[i] = triangulate(requests[i]);
+      },
+      num_threads_);
+  return points;
+}
+
+}} // namespace bs_models::vision
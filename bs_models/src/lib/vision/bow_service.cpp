@@ -0,0 +1,193 @@
+#include <bs_models/vision/bow_service.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <bs_common/startup_profiler.h>
+
+namespace bs_models { namespace vision {
+
+BowService::BowService(std::shared_ptr<beam_cv::ImageDatabase> image_db)
+    : image_db_(image_db),
+      pool_(std::make_unique<bs_common::ThreadPool>(1)) {
+  std::promise<void> loaded;
+  loaded.set_value();
+  loaded_ = loaded.get_future().share();
+}
+
+BowService::BowService(
+    std::function<std::shared_ptr<beam_cv::ImageDatabase>()> load_image_db,
+    const std::string& resource_name)
+    : pool_(std::make_unique<bs_common::ThreadPool>(1)) {
+  loaded_ = Submit([this, load_image_db, resource_name]() {
+    bs_common::ScopedStartupTimer timer(
+        resource_name.empty() ? "bow_service/image_db" : resource_name);
+    image_db_ = load_image_db();
+    timer.Stop();
+    if (!resource_name.empty()) {
+      bs_common::StartupProfiler::GetInstance().SetReady(resource_name);
+    }
+  });
+}
+
+void BowService::QuantizeFrame(const ros::Time& stamp,
+                               const std::vector<uint64_t>& landmark_ids,
+                               const std::vector<cv::Mat>& descriptors) {
+  std::unique_lock<std::mutex> lk(frames_mutex_);
+  if (frames_.find(stamp) != frames_.end()) { return; }
+
+  auto frame = std::make_shared<Frame>();
+  frame->quantized = Submit([this, frame, landmark_ids, descriptors]() {
+    frame->word_ids.reserve(landmark_ids.size());
+    for (size_t i = 0; i < landmark_ids.size(); i++) {
+      frame->word_ids.emplace(landmark_ids[i],
+                              image_db_->GetWordID(descriptors[i]));
+    }
+  });
+  frames_.emplace(stamp, frame);
+}
+
+beam::opt<uint64_t> BowService::GetWordID(const ros::Time& stamp,
+                                          uint64_t landmark_id) {
+  const auto frame = GetFrame(stamp);
+  if (!frame) { return {}; }
+  frame->quantized.wait();
+  const auto iter = frame->word_ids.find(landmark_id);
+  if (iter == frame->word_ids.end()) { return {}; }
+  return iter->second;
+}
+
+void BowService::RemoveFrame(const ros::Time& stamp) {
+  std::unique_lock<std::mutex> lk(frames_mutex_);
+  frames_.erase(stamp);
+}
+
+void BowService::AddToIndex(const ros::Time& stamp) {
+  const auto frame = GetFrame(stamp);
+  if (!frame) { return; }
+  Submit([this, frame, stamp]() {
+    if (indexed_frames_.find(stamp) != indexed_frames_.end()) { return; }
+    const Histogram histogram = ComputeHistogram(*frame);
+    for (const auto& [word_id, frequency] : histogram) {
+      inverted_index_[word_id].emplace(stamp, frequency);
+    }
+    indexed_frames_.emplace(stamp, histogram);
+  });
+}
+
+void BowService::RemoveFromIndex(const ros::Time& stamp) {
+  Submit([this, stamp]() {
+    const auto frame_iter = indexed_frames_.find(stamp);
+    if (frame_iter == indexed_frames_.end()) { return; }
+    for (const auto& [word_id, frequency] : frame_iter->second) {
+      auto word_iter = inverted_index_.find(word_id);
+      word_iter->second.erase(stamp);
+      if (word_iter->second.empty()) { inverted_index_.erase(word_iter); }
+    }
+    indexed_frames_.erase(frame_iter);
+  });
+}
+
+std::future<std::vector<BowService::PlaceMatch>>
+    BowService::Query(const ros::Time& stamp, size_t max_results,
+                      const ros::Duration& min_time_difference) {
+  auto promise = std::make_shared<std::promise<std::vector<PlaceMatch>>>();
+  auto result = promise->get_future();
+  const auto frame = GetFrame(stamp);
+  if (!frame) {
+    promise->set_value({});
+    return result;
+  }
+
+  Submit([this, frame, stamp, max_results, min_time_difference, promise]() {
+    // only visit frames which share at least one word with the query
+    std::map<ros::Time, double> scores;
+    for (const auto& [word_id, frequency] : ComputeHistogram(*frame)) {
+      const auto word_iter = inverted_index_.find(word_id);
+      if (word_iter == inverted_index_.end()) { continue; }
+      const double idf = InverseDocumentFrequency(word_id);
+      for (const auto& [indexed_stamp, indexed_frequency] :
+           word_iter->second) {
+        const ros::Duration dt = indexed_stamp > stamp ? indexed_stamp - stamp
+                                                       : stamp - indexed_stamp;
+        if (dt < min_time_difference) { continue; }
+        scores[indexed_stamp] += idf * std::min(frequency, indexed_frequency);
+      }
+    }
+
+    std::vector<PlaceMatch> matches;
+    matches.reserve(scores.size());
+    for (const auto& [indexed_stamp, score] : scores) {
+      matches.push_back(PlaceMatch{indexed_stamp, score});
+    }
+    const size_t num_results = std::min(max_results, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + num_results,
+                      matches.end(),
+                      [](const PlaceMatch& a, const PlaceMatch& b) {
+                        return a.score > b.score;
+                      });
+    matches.resize(num_results);
+    promise->set_value(std::move(matches));
+  });
+  return result;
+}
+
+void BowService::Clear() {
+  {
+    std::unique_lock<std::mutex> lk(frames_mutex_);
+    frames_.clear();
+  }
+  Submit([this]() {
+    indexed_frames_.clear();
+    inverted_index_.clear();
+  });
+}
+
+void BowService::Wait() {
+  std::shared_future<void> last_job;
+  {
+    std::unique_lock<std::mutex> lk(jobs_mutex_);
+    last_job = last_job_;
+  }
+  if (last_job.valid()) { last_job.wait(); }
+}
+
+bool BowService::Loaded() const {
+  return loaded_.wait_for(std::chrono::seconds(0)) ==
+         std::future_status::ready;
+}
+
+std::shared_future<void> BowService::Submit(std::function<void()> job) {
+  std::unique_lock<std::mutex> lk(jobs_mutex_);
+  last_job_ = pool_->Enqueue(std::move(job)).share();
+  return last_job_;
+}
+
+std::shared_ptr<BowService::Frame>
+    BowService::GetFrame(const ros::Time& stamp) {
+  std::unique_lock<std::mutex> lk(frames_mutex_);
+  const auto iter = frames_.find(stamp);
+  if (iter == frames_.end()) { return nullptr; }
+  return iter->second;
+}
+
+BowService::Histogram BowService::ComputeHistogram(const Frame& frame) const {
+  Histogram histogram;
+  if (frame.word_ids.empty()) { return histogram; }
+  const double weight = 1.0 / frame.word_ids.size();
+  for (const auto& [landmark_id, word_id] : frame.word_ids) {
+    histogram[word_id] += weight;
+  }
+  return histogram;
+}
+
+double BowService::InverseDocumentFrequency(uint64_t word_id) const {
+  // words seen in every indexed frame carry no information
+  const auto iter = inverted_index_.find(word_id);
+  const size_t num_frames_with_word =
+      iter == inverted_index_.end() ? 0 : iter->second.size();
+  return std::log(static_cast<double>(indexed_frames_.size() + 1) /
+                  static_cast<double>(num_frames_with_word + 1));
+}
+
+}} // namespace bs_models::vision
@@ -0,0 +1,91 @@
+#include <bs_models/vision/camera_measurement_view.h>
+
+#include <cstring>
+
+#include <beam_cv/descriptors/Descriptor.h>
+
+namespace bs_models { namespace vision {
+
+void PackLandmarkMeasurements(
+    const std::vector<uint64_t>& landmark_ids,
+    const std::vector<cv::Mat>& descriptors,
+    const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<
+                                           Eigen::Vector2d>>& pixels,
+    bs_common::CameraMeasurementMsg& msg) {
+  const size_t size = landmark_ids.size();
+  msg.packed = true;
+  msg.landmark_ids = landmark_ids;
+  msg.pixels_u.resize(size);
+  msg.pixels_v.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    msg.pixels_u[i] = pixels[i][0];
+    msg.pixels_v[i] = pixels[i][1];
+  }
+
+  msg.descriptors.clear();
+  msg.descriptor_cols = 0;
+  msg.descriptor_cv_type = 0;
+  if (size == 0) { return; }
+  const cv::Mat& first = descriptors.front();
+  msg.descriptor_cols = first.cols;
+  msg.descriptor_cv_type = first.type();
+  const size_t row_size = first.cols * first.elemSize();
+  msg.descriptors.resize(size * row_size);
+  for (size_t i = 0; i < size; i++) {
+    const cv::Mat& descriptor = descriptors[i];
+    if (descriptor.type() != first.type() || descriptor.cols != first.cols) {
+      throw std::invalid_argument{"All descriptors must have the same size "
+                                  "and type"};
+    }
+    // rows of a matrix are always contiguous
+    std::memcpy(msg.descriptors.data() + i * row_size, descriptor.ptr(0),
+                row_size);
+  }
+}
+
+CameraMeasurementView::CameraMeasurementView(
+    const bs_common::CameraMeasurementMsg& msg)
+    : msg_(msg) {
+  if (!msg_.packed) {
+    size_ = msg_.landmarks.size();
+    return;
+  }
+
+  size_ = msg_.landmark_ids.size();
+  if (msg_.pixels_u.size() != size_ || msg_.pixels_v.size() != size_) {
+    throw std::invalid_argument{"Packed pixel arrays do not match the number "
+                                "of landmarks"};
+  }
+  if (size_ == 0) { return; }
+  const size_t row_size =
+      msg_.descriptor_cols * CV_ELEM_SIZE(msg_.descriptor_cv_type);
+  if (row_size == 0 || msg_.descriptors.size() != size_ * row_size) {
+    throw std::invalid_argument{"Packed descriptors do not match the number "
+                                "of landmarks"};
+  }
+  // header over the message data, nothing is copied
+  descriptors_ = cv::Mat(size_, msg_.descriptor_cols, msg_.descriptor_cv_type,
+                         const_cast<uint8_t*>(msg_.descriptors.data()));
+}
+
+uint64_t CameraMeasurementView::LandmarkId(size_t i) const {
+  if (msg_.packed) { return msg_.landmark_ids[i]; }
+  return msg_.landmarks[i].landmark_id;
+}
+
+Eigen::Vector2d CameraMeasurementView::Pixel(size_t i) const {
+  if (msg_.packed) {
+    return Eigen::Vector2d(static_cast<double>(msg_.pixels_u[i]),
+                           static_cast<double>(msg_.pixels_v[i]));
+  }
+  return Eigen::Vector2d(static_cast<double>(msg_.landmarks[i].pixel_u),
+                         static_cast<double>(msg_.landmarks[i].pixel_v));
+}
+
+cv::Mat CameraMeasurementView::Descriptor(size_t i) const {
+  if (msg_.packed) { return descriptors_.row(i); }
+  return beam_cv::Descriptor::VectorDescriptorToCvMat(
+      {msg_.landmarks[i].descriptor.data}, msg_.descriptor_type);
+}
+
+}} // namespace bs_models::vision
@@ -0,0 +1,72 @@
+#include <bs_models/vision/camera_rig.h>
+
+#include <ros/console.h>
+
+#include <beam_utils/math.h>
+
+namespace bs_models { namespace vision {
+
+uint64_t CameraRig::GlobalLandmarkId(uint8_t sensor_id, uint64_t landmark_id) {
+  return landmark_id | (static_cast<uint64_t>(sensor_id) << SENSOR_ID_SHIFT);
+}
+
+uint8_t CameraRig::SensorId(uint64_t landmark_id) {
+  return static_cast<uint8_t>(landmark_id >> SENSOR_ID_SHIFT);
+}
+
+void CameraRig::AddCamera(uint8_t sensor_id, const std::string& frame_id,
+                          std::shared_ptr<beam_calibration::CameraModel> model,
+                          const Eigen::Matrix4d& T_cam_baselink) {
+  size_t index;
+  if (Index(sensor_id, index)) {
+    ROS_ERROR("Camera rig already has a camera with sensor id %d.", sensor_id);
+    throw std::runtime_error{"Duplicate sensor id in camera rig."};
+  }
+  RigCamera camera;
+  camera.sensor_id = sensor_id;
+  camera.frame_id = frame_id;
+  camera.model = model;
+  camera.K = model->GetRectifiedModel()->GetIntrinsicMatrix();
+  camera.T_cam_baselink = T_cam_baselink;
+  camera.T_baselink_cam = beam::InvertTransform(T_cam_baselink);
+  cameras_.push_back(camera);
+}
+
+void CameraRig::SetExtrinsics(size_t index,
+                              const Eigen::Matrix4d& T_cam_baselink) {
+  RigCamera& camera = cameras_.at(index);
+  camera.T_cam_baselink = T_cam_baselink;
+  camera.T_baselink_cam = beam::InvertTransform(T_cam_baselink);
+}
+
+bool CameraRig::Index(uint8_t sensor_id, size_t& index) const {
+  // rigs only have a few cameras, so this is faster than a map
+  for (size_t i = 0; i < cameras_.size(); i++) {
+    if (cameras_[i].sensor_id == sensor_id) {
+      index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CameraRig::IndexOfLandmark(uint64_t landmark_id, size_t& index) const {
+  if (cameras_.size() == 1) {
+    index = 0;
+    return true;
+  }
+  return Index(SensorId(landmark_id), index);
+}
+
+const RigCamera* CameraRig::CameraOfLandmark(uint64_t landmark_id) const {
+  size_t index;
+  if (!IndexOfLandmark(landmark_id, index)) { return nullptr; }
+  return &cameras_[index];
+}
+
+bool CameraRig::IsPrimary(uint64_t landmark_id) const {
+  size_t index;
+  return IndexOfLandmark(landmark_id, index) && index == 0;
+}
+
+}} // namespace bs_models::vision
@@ -0,0 +1,79 @@
+#include <bs_models/vision/frame_set_assembler.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include <boost/make_shared.hpp>
+
+namespace bs_models { namespace vision {
+
+FrameSetAssembler::FrameSetAssembler(size_t num_cameras,
+                                     const ros::Duration& tolerance,
+                                     size_t max_pending)
+    : num_cameras_(num_cameras),
+      tolerance_(tolerance),
+      max_pending_(std::max<size_t>(max_pending, 1)) {}
+
+beam::opt<FrameSetAssembler::FrameSet> FrameSetAssembler::Add(
+    size_t camera,
+    const bs_common::CameraMeasurementMsg::ConstPtr& measurement) {
+  if (camera >= num_cameras_) { return {}; }
+  const ros::Time& stamp = measurement->header.stamp;
+
+  // find the closest set within the tolerance, or where a new one goes
+  auto iter = pending_.begin();
+  auto match = pending_.end();
+  ros::Duration best_difference = tolerance_;
+  for (; iter != pending_.end(); iter++) {
+    const ros::Duration difference =
+        iter->stamp > stamp ? iter->stamp - stamp : stamp - iter->stamp;
+    if (difference <= best_difference) {
+      match = iter;
+      best_difference = difference;
+    }
+    if (iter->stamp > stamp + tolerance_) { break; }
+  }
+  if (match == pending_.end()) {
+    // insert before the first set that is newer than this measurement
+    auto position = pending_.begin();
+    while (position != pending_.end() && position->stamp < stamp) {
+      position++;
+    }
+    PendingSet set;
+    set.stamp = stamp;
+    set.measurements.resize(num_cameras_);
+    match = pending_.insert(position, std::move(set));
+  }
+
+  PendingSet& set = *match;
+  if (!set.measurements[camera]) { set.num_measurements++; }
+  set.measurements[camera] = measurement;
+  if (camera == 0) { set.stamp = stamp; }
+
+  if (set.num_measurements == num_cameras_) {
+    FrameSet frame_set = std::move(set.measurements);
+    for (auto& m : frame_set) {
+      if (m->header.stamp == set.stamp) { continue; }
+      auto restamped = boost::make_shared<bs_common::CameraMeasurementMsg>(*m);
+      restamped->header.stamp = set.stamp;
+      m = restamped;
+    }
+    // older sets can't be completed anymore
+    num_dropped_ += std::distance(pending_.begin(), match);
+    pending_.erase(pending_.begin(), match + 1);
+    return frame_set;
+  }
+
+  if (pending_.size() > max_pending_) {
+    pending_.pop_front();
+    num_dropped_++;
+  }
+  return {};
+}
+
+void FrameSetAssembler::Clear() {
+  pending_.clear();
+  num_dropped_ = 0;
+}
+
+}} // namespace bs_models::vision
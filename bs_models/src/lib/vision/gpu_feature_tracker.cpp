@@ -0,0 +1,223 @@
+#include <bs_models/vision/gpu_feature_tracker.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include <nlohmann/json.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <beam_utils/log.h>
+#include <beam_utils/utils.h>
+
+#ifdef BS_MODELS_WITH_CUDA
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudafeatures2d.hpp>
+#include <opencv2/cudaoptflow.hpp>
+#endif
+
+namespace bs_models { namespace vision {
+
+namespace {
+
+void ReadJsonOrThrow(const std::string& path, nlohmann::json& J) {
+  if (!beam::ReadJson(path, J)) {
+    BEAM_ERROR("Unable to read config: {}", path);
+    throw std::runtime_error{"Unable to read config"};
+  }
+}
+
+} // namespace
+
+void GpuFeatureTracker::Params::LoadFromJson(
+    const std::string& tracker_config, const std::string& detector_config,
+    const std::string& descriptor_config) {
+  nlohmann::json J;
+  ReadJsonOrThrow(tracker_config, J);
+  if (J.contains("keypoint_resample_percentage")) {
+    keypoint_resample_percentage = J["keypoint_resample_percentage"];
+  }
+  if (J.contains("win_size_u")) { win_size_u = J["win_size_u"]; }
+  if (J.contains("win_size_v")) { win_size_v = J["win_size_v"]; }
+  if (J.contains("max_level")) { max_level = J["max_level"]; }
+  if (J.contains("criteria_max_count")) {
+    criteria_max_count = J["criteria_max_count"];
+  }
+
+  ReadJsonOrThrow(detector_config, J);
+  if (J.contains("num_features")) { num_features = J["num_features"]; }
+  if (J.contains("threshold")) { threshold = J["threshold"]; }
+
+  ReadJsonOrThrow(descriptor_config, J);
+  if (J.contains("tuple_size")) { tuple_size = J["tuple_size"]; }
+  if (J.contains("patch_size")) { patch_size = J["patch_size"]; }
+}
+
+#ifdef BS_MODELS_WITH_CUDA
+
+struct GpuFeatureTracker::DeviceState {
+  cv::cuda::Stream stream;
+  cv::cuda::HostMem staging{cv::cuda::HostMem::PAGE_LOCKED};
+  cv::cuda::GpuMat image;
+  cv::cuda::GpuMat prev_image;
+  cv::cuda::GpuMat prev_points;
+  cv::cuda::GpuMat next_points;
+  cv::cuda::GpuMat status;
+  cv::cuda::GpuMat mask;
+  cv::cuda::GpuMat keypoints;
+  cv::cuda::GpuMat descriptors;
+  cv::Ptr<cv::cuda::SparsePyrLKOpticalFlow> klt;
+  cv::Ptr<cv::cuda::ORB> orb;
+};
+
+bool GpuFeatureTracker::Available() {
+  return cv::cuda::getCudaEnabledDeviceCount() > 0;
+}
+
+#else
+
+struct GpuFeatureTracker::DeviceState {};
+
+bool GpuFeatureTracker::Available() {
+  return false;
+}
+
+#endif
+
+GpuFeatureTracker::GpuFeatureTracker(const Params& params, int window_size)
+    : params_(params), window_size_(std::max(window_size, 1)) {
+  if (!Available()) {
+    BEAM_ERROR("GPU feature tracker requires OpenCV with CUDA and a CUDA "
+               "device");
+    throw std::runtime_error{"GPU feature tracker is not available"};
+  }
+
+  device_ = std::make_unique<DeviceState>();
+#ifdef BS_MODELS_WITH_CUDA
+  device_->klt = cv::cuda::SparsePyrLKOpticalFlow::create(
+      cv::Size(params_.win_size_u, params_.win_size_v), params_.max_level,
+      params_.criteria_max_count);
+  // single level so keypoints are the same FAST corners as the CPU detector
+  device_->orb = cv::cuda::ORB::create(
+      params_.num_features, 1.2f, 1, params_.patch_size, 0, params_.tuple_size,
+      cv::ORB::HARRIS_SCORE, params_.patch_size, params_.threshold);
+#endif
+}
+
+GpuFeatureTracker::~GpuFeatureTracker() = default;
+
+void GpuFeatureTracker::AddImage(const cv::Mat& image, const ros::Time& stamp) {
+  Frame frame;
+#ifdef BS_MODELS_WITH_CUDA
+  DeviceState& d = *device_;
+
+  // copy into page locked memory so the upload is an async DMA transfer
+  d.staging.create(image.rows, image.cols, image.type());
+  image.copyTo(d.staging.createMatHeader());
+  d.image.upload(d.staging, d.stream);
+
+  // track the features of the previous image
+  if (!d.prev_image.empty() && !frames_.empty() &&
+      !frames_.rbegin()->second.pixels.empty()) {
+    const Frame& prev = frames_.rbegin()->second;
+    const cv::Mat prev_points(1, prev.pixels.size(), CV_32FC2,
+                              const_cast<cv::Point2f*>(prev.pixels.data()));
+    d.prev_points.upload(prev_points, d.stream);
+    d.klt->calc(d.prev_image, d.image, d.prev_points, d.next_points,
+                d.status, cv::noArray(), d.stream);
+    std::vector<cv::Point2f> next_points;
+    std::vector<uchar> status;
+    d.next_points.download(next_points, d.stream);
+    d.status.download(status, d.stream);
+    d.stream.waitForCompletion();
+
+    const cv::Rect bounds(0, 0, image.cols, image.rows);
+    for (size_t i = 0; i < status.size(); i++) {
+      if (!status[i] || !bounds.contains(next_points[i])) { continue; }
+      frame.ids.push_back(prev.ids[i]);
+      frame.pixels.push_back(next_points[i]);
+      frame.descriptors.push_back(prev.descriptors.row(i));
+    }
+  }
+
+  // detect new features away from the tracked ones
+  const size_t min_tracks =
+      params_.keypoint_resample_percentage * params_.num_features;
+  if (frame.ids.size() < min_tracks) {
+    cv::Mat mask(image.size(), CV_8U, cv::Scalar(255));
+    const int radius = std::max(params_.win_size_u / 2, 1);
+    for (const auto& pixel : frame.pixels) {
+      cv::circle(mask, pixel, radius, cv::Scalar(0), -1);
+    }
+    d.mask.upload(mask, d.stream);
+    d.orb->detectAndComputeAsync(d.image, d.mask, d.keypoints, d.descriptors,
+                                 false, d.stream);
+    d.stream.waitForCompletion();
+    std::vector<cv::KeyPoint> keypoints;
+    d.orb->convert(d.keypoints, keypoints);
+    cv::Mat descriptors;
+    d.descriptors.download(descriptors);
+
+    // strongest first, up to the max number of features
+    std::vector<size_t> order(keypoints.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keypoints](size_t a, size_t b) {
+      return keypoints[a].response > keypoints[b].response;
+    });
+    for (size_t i : order) {
+      if (frame.ids.size() >= static_cast<size_t>(params_.num_features)) {
+        break;
+      }
+      frame.ids.push_back(next_id_++);
+      frame.pixels.push_back(keypoints[i].pt);
+      frame.descriptors.push_back(descriptors.row(i));
+    }
+  }
+
+  d.prev_image.swap(d.image);
+#endif
+
+  for (size_t i = 0; i < frame.ids.size(); i++) {
+    frame.indices.emplace(frame.ids[i], i);
+  }
+  frames_[stamp] = std::move(frame);
+  while (frames_.size() > static_cast<size_t>(window_size_)) {
+    frames_.erase(frames_.begin());
+  }
+}
+
+std::vector<uint64_t>
+    GpuFeatureTracker::GetLandmarkIDsInImage(const ros::Time& stamp) const {
+  return GetFrame(stamp).ids;
+}
+
+Eigen::Vector2d GpuFeatureTracker::Get(const ros::Time& stamp,
+                                       uint64_t id) const {
+  const Frame& frame = GetFrame(stamp);
+  const cv::Point2f& pixel = frame.pixels[GetIndex(frame, id)];
+  return Eigen::Vector2d(pixel.x, pixel.y);
+}
+
+cv::Mat GpuFeatureTracker::GetDescriptor(const ros::Time& stamp,
+                                         uint64_t id) const {
+  const Frame& frame = GetFrame(stamp);
+  return frame.descriptors.row(GetIndex(frame, id));
+}
+
+const GpuFeatureTracker::Frame&
+    GpuFeatureTracker::GetFrame(const ros::Time& stamp) const {
+  const auto iter = frames_.find(stamp);
+  if (iter == frames_.end()) {
+    throw std::out_of_range{"No tracks for image"};
+  }
+  return iter->second;
+}
+
+size_t GpuFeatureTracker::GetIndex(const Frame& frame, uint64_t id) const {
+  const auto iter = frame.indices.find(id);
+  if (iter == frame.indices.end()) {
+    throw std::out_of_range{"Landmark is not in image"};
+  }
+  return iter->second;
+}
+
+}} // namespace bs_models::vision
@@ -28,7 +28,8 @@ const bs_common::CameraMeasurementMsg& Keyframe::MeasurementMessage() const {
   return msg_;
 }
 
-const std::map<ros::Time, Eigen::Matrix4d>& Keyframe::Trajectory() const {
+const bs_common::FlatTimeMap<ros::Time, Eigen::Matrix4d>&
+    Keyframe::Trajectory() const {
   return trajectory_;
 }
 
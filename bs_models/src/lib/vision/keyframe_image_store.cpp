@@ -0,0 +1,227 @@
+#include <bs_models/vision/keyframe_image_store.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <mutex>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+namespace bs_models { namespace vision {
+
+/**
+ * @brief Append only file of encoded images, which is memory mapped for
+ * reading. The mapping is grown when reading an image past its end.
+ */
+class KeyframeImageStore::SpillFile {
+public:
+  explicit SpillFile(const std::string& path) : path_(path) {
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      BEAM_ERROR("Cannot open keyframe image spill file: {}", path_);
+      throw std::runtime_error{"Cannot open keyframe image spill file"};
+    }
+  }
+
+  ~SpillFile() {
+    if (data_) { ::munmap(data_, mapped_size_); }
+    ::close(fd_);
+    ::unlink(path_.c_str());
+  }
+
+  SpillFile(const SpillFile& other) = delete;
+
+  SpillFile& operator=(const SpillFile& other) = delete;
+
+  /**
+   * @return offset of the data in the file
+   */
+  size_t Append(const std::vector<uchar>& bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t offset = size_;
+    size_t written = 0;
+    while (written < bytes.size()) {
+      const ssize_t n = ::pwrite(fd_, bytes.data() + written,
+                                 bytes.size() - written, offset + written);
+      if (n <= 0) {
+        BEAM_ERROR("Failed to write keyframe image spill file: {}", path_);
+        throw std::runtime_error{"Failed to write keyframe image spill file"};
+      }
+      written += n;
+    }
+    size_ += bytes.size();
+    return offset;
+  }
+
+  cv::Mat Decode(size_t offset, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (offset + length > mapped_size_) { Remap(); }
+    const cv::Mat buffer(1, length, CV_8U, data_ + offset);
+    return cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+  }
+
+private:
+  void Remap() {
+    if (data_) { ::munmap(data_, mapped_size_); }
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+      data_ = nullptr;
+      mapped_size_ = 0;
+      BEAM_ERROR("Cannot map keyframe image spill file: {}", path_);
+      throw std::runtime_error{"Cannot map keyframe image spill file"};
+    }
+    data_ = static_cast<uchar*>(data);
+    mapped_size_ = size_;
+  }
+
+  std::string path_;
+  int fd_{-1};
+  size_t size_{0};
+  uchar* data_{nullptr};
+  size_t mapped_size_{0};
+  std::mutex mutex_;
+};
+
+void KeyframeImageStore::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("policy")) { policy = PolicyFromString(J["policy"]); }
+  if (J.contains("downsample_factor")) {
+    downsample_factor = J["downsample_factor"];
+  }
+  if (J.contains("compression_format")) {
+    compression_format = J["compression_format"];
+  }
+  if (J.contains("jpeg_quality")) { jpeg_quality = J["jpeg_quality"]; }
+  if (J.contains("spill_directory")) {
+    spill_directory = J["spill_directory"];
+  }
+  if (compression_format != "png" && compression_format != "jpg") {
+    BEAM_ERROR("Invalid keyframe image compression format: {}, options: png, "
+               "jpg",
+               compression_format);
+    throw std::invalid_argument{"invalid keyframe image compression format"};
+  }
+  if (downsample_factor < 1) {
+    BEAM_ERROR("Keyframe image downsample factor must be at least 1");
+    throw std::invalid_argument{"invalid keyframe image downsample factor"};
+  }
+}
+
+nlohmann::json KeyframeImageStore::Params::ToJson() const {
+  return nlohmann::json{{"policy", PolicyToString(policy)},
+                        {"downsample_factor", downsample_factor},
+                        {"compression_format", compression_format},
+                        {"jpeg_quality", jpeg_quality},
+                        {"spill_directory", spill_directory}};
+}
+
+KeyframeImageStore::Policy
+    KeyframeImageStore::PolicyFromString(const std::string& policy) {
+  if (policy == "KEEP") {
+    return Policy::KEEP;
+  } else if (policy == "DROP") {
+    return Policy::DROP;
+  } else if (policy == "DOWNSAMPLE") {
+    return Policy::DOWNSAMPLE;
+  } else if (policy == "COMPRESS") {
+    return Policy::COMPRESS;
+  } else if (policy == "SPILL") {
+    return Policy::SPILL;
+  }
+  BEAM_ERROR("Invalid keyframe image policy: {}, options: KEEP, DROP, "
+             "DOWNSAMPLE, COMPRESS, SPILL",
+             policy);
+  throw std::invalid_argument{"invalid keyframe image policy"};
+}
+
+std::string KeyframeImageStore::PolicyToString(Policy policy) {
+  if (policy == Policy::DROP) {
+    return "DROP";
+  } else if (policy == Policy::DOWNSAMPLE) {
+    return "DOWNSAMPLE";
+  } else if (policy == Policy::COMPRESS) {
+    return "COMPRESS";
+  } else if (policy == Policy::SPILL) {
+    return "SPILL";
+  }
+  return "KEEP";
+}
+
+KeyframeImageStore::KeyframeImageStore(const Params& params,
+                                       const std::string& name)
+    : params_(params) {
+  if (params_.policy != Policy::SPILL) { return; }
+  const std::string filename = "keyframe_images_" + name + "_" +
+                               std::to_string(::getpid()) + ".bin";
+  spill_file_ = std::make_shared<SpillFile>(
+      beam::CombinePaths(params_.spill_directory, filename));
+}
+
+void KeyframeImageStore::Add(uint64_t stamp, const cv::Mat& image) {
+  // dropped images still get an entry so the keyframe stamps are kept
+  Entry& entry = entries_[stamp];
+  entry = Entry();
+  if (image.empty() || params_.policy == Policy::DROP) { return; }
+
+  if (params_.policy == Policy::KEEP) {
+    entry.image = image;
+  } else if (params_.policy == Policy::DOWNSAMPLE) {
+    const double scale = 1.0 / params_.downsample_factor;
+    cv::resize(image, entry.image, cv::Size(), scale, scale, cv::INTER_AREA);
+  } else if (params_.policy == Policy::COMPRESS) {
+    entry.encoded = std::make_shared<const std::vector<uchar>>(Encode(image));
+  } else {
+    const std::vector<uchar> encoded = Encode(image);
+    entry.offset = spill_file_->Append(encoded);
+    entry.length = encoded.size();
+  }
+}
+
+cv::Mat KeyframeImageStore::Get(uint64_t stamp) const {
+  const auto iter = entries_.find(stamp);
+  if (iter == entries_.end()) { return cv::Mat(); }
+  const Entry& entry = iter->second;
+  if (entry.encoded) {
+    return cv::imdecode(*entry.encoded, cv::IMREAD_UNCHANGED);
+  }
+  if (entry.length > 0) {
+    return spill_file_->Decode(entry.offset, entry.length);
+  }
+  return entry.image;
+}
+
+std::vector<uint64_t> KeyframeImageStore::Stamps() const {
+  std::vector<uint64_t> stamps;
+  stamps.reserve(entries_.size());
+  for (const auto& [stamp, entry] : entries_) { stamps.push_back(stamp); }
+  return stamps;
+}
+
+size_t KeyframeImageStore::MemoryUsage() const {
+  size_t bytes = 0;
+  for (const auto& [stamp, entry] : entries_) {
+    bytes += entry.image.total() * entry.image.elemSize();
+    if (entry.encoded) { bytes += entry.encoded->size(); }
+  }
+  return bytes;
+}
+
+std::vector<uchar> KeyframeImageStore::Encode(const cv::Mat& image) const {
+  std::vector<int> encode_params;
+  if (params_.compression_format == "jpg") {
+    encode_params = {cv::IMWRITE_JPEG_QUALITY, params_.jpeg_quality};
+  }
+  std::vector<uchar> encoded;
+  if (!cv::imencode("." + params_.compression_format, image, encoded,
+                    encode_params)) {
+    BEAM_ERROR("Failed to encode keyframe image");
+    throw std::runtime_error{"Failed to encode keyframe image"};
+  }
+  return encoded;
+}
+
+}} // namespace bs_models::vision
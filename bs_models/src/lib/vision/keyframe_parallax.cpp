@@ -0,0 +1,115 @@
+#include <bs_models/vision/keyframe_parallax.h>
+
+#include <iterator>
+
+namespace bs_models { namespace vision {
+
+KeyframeParallax::KeyframeParallax(std::shared_ptr<const CameraRig> camera_rig)
+    : camera_rig_(camera_rig) {}
+
+bool KeyframeParallax::AddFrame(
+    const ros::Time& stamp, const std::vector<uint64_t>& ids,
+    const std::vector<Eigen::Vector2d, beam::AlignVec2d>& pixels) {
+  if (!frames_.empty() && stamp <= frames_.rbegin()->first) { return false; }
+  Frame& frame = frames_[stamp];
+  frame.ids = ids;
+  frame.pixels = pixels;
+  if (has_keyframe_) { PairWithKeyframe(frame); }
+  return true;
+}
+
+bool KeyframeParallax::SetKeyframe(const ros::Time& stamp) {
+  has_keyframe_ = true;
+  keyframe_pixels_.clear();
+  const auto keyframe = frames_.find(stamp);
+  if (keyframe == frames_.end()) {
+    frames_.erase(frames_.begin(), frames_.lower_bound(stamp));
+    for (auto& frame : frames_) { frame.second.pairs.clear(); }
+    return false;
+  }
+
+  const Frame& frame = keyframe->second;
+  keyframe_pixels_.reserve(frame.ids.size());
+  for (size_t i = 0; i < frame.ids.size(); i++) {
+    keyframe_pixels_.emplace(frame.ids[i], frame.pixels[i]);
+  }
+  frames_.erase(frames_.begin(), keyframe);
+
+  // frames added while waiting for this keyframe were paired with the
+  // previous one
+  for (auto iter = std::next(frames_.begin()); iter != frames_.end(); iter++) {
+    PairWithKeyframe(iter->second);
+  }
+  return true;
+}
+
+size_t KeyframeParallax::NumTracked(const ros::Time& stamp) const {
+  const auto iter = frames_.find(stamp);
+  if (iter == frames_.end()) { return 0; }
+  return iter->second.pairs.size();
+}
+
+double KeyframeParallax::AverageParallax(
+    const ros::Time& stamp, const Eigen::Matrix3d& R_KEYFRAME_FRAME) const {
+  const auto iter = frames_.find(stamp);
+  if (iter == frames_.end() || iter->second.pairs.empty()) { return 0; }
+
+  // rotation seen by each camera of the rig
+  const Eigen::Matrix3d R_PRIMARY_BASELINK =
+      camera_rig_->Primary().T_cam_baselink.block<3, 3>(0, 0);
+  std::vector<Eigen::Matrix3d> R_KEYFRAME_FRAME_cameras;
+  for (size_t i = 0; i < camera_rig_->Size(); i++) {
+    const Eigen::Matrix3d R_CAMERA_PRIMARY =
+        camera_rig_->Camera(i).T_cam_baselink.block<3, 3>(0, 0) *
+        R_PRIMARY_BASELINK.transpose();
+    R_KEYFRAME_FRAME_cameras.push_back(R_CAMERA_PRIMARY * R_KEYFRAME_FRAME *
+                                       R_CAMERA_PRIMARY.transpose());
+  }
+
+  double total_parallax = 0.0;
+  size_t num_correspondences = 0;
+  for (const Pair& pair : iter->second.pairs) {
+    // rotate bearing from the frame to the keyframe
+    const Eigen::Vector3d bearing_in_kf =
+        R_KEYFRAME_FRAME_cameras[pair.camera] * pair.bearing;
+    Eigen::Vector2d reprojection;
+    if (!camera_rig_->Camera(pair.camera).model->ProjectPoint(bearing_in_kf,
+                                                              reprojection)) {
+      continue;
+    }
+    total_parallax += (pair.keyframe_pixel - reprojection).norm();
+    num_correspondences++;
+  }
+  if (num_correspondences == 0) { return 0; }
+  return total_parallax / static_cast<double>(num_correspondences);
+}
+
+void KeyframeParallax::RemoveBefore(const ros::Time& stamp) {
+  frames_.erase(frames_.begin(), frames_.lower_bound(stamp));
+}
+
+void KeyframeParallax::Clear() {
+  frames_.clear();
+  keyframe_pixels_.clear();
+  has_keyframe_ = false;
+}
+
+void KeyframeParallax::PairWithKeyframe(Frame& frame) const {
+  frame.pairs.clear();
+  for (size_t i = 0; i < frame.ids.size(); i++) {
+    const auto keyframe_pixel = keyframe_pixels_.find(frame.ids[i]);
+    if (keyframe_pixel == keyframe_pixels_.end()) { continue; }
+    size_t camera;
+    if (!camera_rig_->IndexOfLandmark(frame.ids[i], camera)) { continue; }
+    Pair pair;
+    if (!camera_rig_->Camera(camera).model->BackProject(
+            frame.pixels[i].cast<int>(), pair.bearing)) {
+      continue;
+    }
+    pair.camera = camera;
+    pair.keyframe_pixel = keyframe_pixel->second;
+    frame.pairs.push_back(pair);
+  }
+}
+
+}} // namespace bs_models::vision
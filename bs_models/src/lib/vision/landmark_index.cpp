@@ -0,0 +1,135 @@
+#include <bs_models/vision/landmark_index.h>
+
+#include <cmath>
+
+#include <bs_common/pose_array.h>
+#include <bs_models/scan_registration/voxel_key.h>
+
+namespace bs_models { namespace vision {
+
+LandmarkStore::LandmarkStore(double voxel_size) : voxel_size_(voxel_size) {}
+
+void LandmarkStore::Clear() {
+  ids_.clear();
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  voxels_.clear();
+}
+
+void LandmarkStore::Add(uint64_t id, const Eigen::Vector3d& position) {
+  ids_.push_back(id);
+  x_.push_back(position[0]);
+  y_.push_back(position[1]);
+  z_.push_back(position[2]);
+}
+
+void LandmarkStore::BuildIndex() {
+  voxels_.clear();
+  std::unordered_map<uint64_t, int> key_to_voxel;
+  for (int i = 0; i < ids_.size(); i++) {
+    const int64_t ix = std::floor(x_[i] / voxel_size_);
+    const int64_t iy = std::floor(y_[i] / voxel_size_);
+    const int64_t iz = std::floor(z_[i] / voxel_size_);
+    const uint64_t key = scan_registration::VoxelKey(ix, iy, iz);
+    auto iter = key_to_voxel.find(key);
+    if (iter == key_to_voxel.end()) {
+      Voxel voxel;
+      voxel.center =
+          (Eigen::Vector3d(ix, iy, iz) + Eigen::Vector3d::Constant(0.5)) *
+          voxel_size_;
+      iter = key_to_voxel.emplace(key, voxels_.size()).first;
+      voxels_.push_back(voxel);
+    }
+    voxels_[iter->second].indices.push_back(i);
+  }
+}
+
+void LandmarkStore::GetLandmarksInView(const Eigen::Matrix4d& T_CAM_WORLD,
+                                       double max_view_angle,
+                                       std::vector<int>& indices) const {
+  indices.clear();
+  const Eigen::Matrix3d R = T_CAM_WORLD.block<3, 3>(0, 0);
+  const Eigen::Vector3d t = T_CAM_WORLD.block<3, 1>(0, 3);
+  const double voxel_radius = std::sqrt(3.0) * voxel_size_ / 2;
+  for (const auto& voxel : voxels_) {
+    const Eigen::Vector3d center_cam = R * voxel.center + t;
+    const double dist = center_cam.norm();
+    if (dist > voxel_radius) {
+      // check the bounding sphere of the voxel intersects the viewing cone
+      const double angle = std::acos(center_cam[2] / dist);
+      const double margin = std::asin(voxel_radius / dist);
+      if (angle - margin > max_view_angle) { continue; }
+    }
+    indices.insert(indices.end(), voxel.indices.begin(), voxel.indices.end());
+  }
+}
+
+void LandmarkStore::Project(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam_model,
+    const Eigen::Matrix4d& T_CAM_WORLD, const std::vector<int>& indices,
+    std::vector<int>& projected_indices,
+    std::vector<Eigen::Vector2d, beam::AlignVec2d>& pixels) const {
+  projected_indices.clear();
+  pixels.clear();
+
+  // transform all points at once
+  Eigen::Matrix3Xd points(3, indices.size());
+  for (int i = 0; i < indices.size(); i++) {
+    const int j = indices[i];
+    points.col(i) << x_[j], y_[j], z_[j];
+  }
+  bs_common::TransformPoints(T_CAM_WORLD, points);
+
+  for (int i = 0; i < indices.size(); i++) {
+    if (points(2, i) <= 0) { continue; }
+    Eigen::Vector2d pixel;
+    bool in_image = false;
+    if (!cam_model->ProjectPoint(points.col(i), pixel, in_image) ||
+        !in_image) {
+      continue;
+    }
+    projected_indices.push_back(indices[i]);
+    pixels.push_back(pixel);
+  }
+}
+
+void PixelGrid::Reset(int width, int height, int cell_size) {
+  cell_size_ = cell_size;
+  cols_ = width / cell_size_ + 1;
+  rows_ = height / cell_size_ + 1;
+  cells_.resize(cols_ * rows_);
+  for (auto& cell : cells_) { cell.clear(); }
+}
+
+void PixelGrid::Add(const Eigen::Vector2d& pixel, uint64_t id) {
+  const int col = static_cast<int>(pixel[0]) / cell_size_;
+  const int row = static_cast<int>(pixel[1]) / cell_size_;
+  if (col < 0 || row < 0 || col >= cols_ || row >= rows_) { return; }
+  cells_[row * cols_ + col].push_back(Entry{pixel, id});
+}
+
+void PixelGrid::Search(const Eigen::Vector2d& pixel, double radius,
+                       std::vector<uint64_t>& ids) const {
+  ids.clear();
+  const int col_min =
+      std::max(0, static_cast<int>(pixel[0] - radius) / cell_size_);
+  const int row_min =
+      std::max(0, static_cast<int>(pixel[1] - radius) / cell_size_);
+  const int col_max =
+      std::min(cols_ - 1, static_cast<int>(pixel[0] + radius) / cell_size_);
+  const int row_max =
+      std::min(rows_ - 1, static_cast<int>(pixel[1] + radius) / cell_size_);
+  for (int row = row_min; row <= row_max; row++) {
+    for (int col = col_min; col <= col_max; col++) {
+      for (const auto& entry : cells_[row * cols_ + col]) {
+        if (std::abs(entry.pixel[0] - pixel[0]) <= radius &&
+            std::abs(entry.pixel[1] - pixel[1]) <= radius) {
+          ids.push_back(entry.id);
+        }
+      }
+    }
+  }
+}
+
+}} // namespace bs_models::vision
@@ -0,0 +1,161 @@
+#include <bs_models/vision/pnp_ransac.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <random>
+
+#include <beam_cv/geometry/AbsolutePoseEstimator.h>
+
+#include <bs_common/instrumentation.h>
+
+namespace bs_models { namespace vision {
+
+PnPRansac::PnPRansac(const Params& params)
+    : params_(params) {
+  params_.num_threads = std::max(params_.num_threads, 1);
+}
+
+PnPRansac::Result PnPRansac::Estimate(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam_model,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+    const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points,
+    const Eigen::Matrix4d* T_CAMERA_WORLD_prior) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "pnp_ransac/estimate");
+  bs_common::ScopedTimer timer(metric);
+
+  Result result;
+  const size_t n = pixels.size();
+  if (n < 4 || points.size() != n) { return result; }
+
+  // contiguous copies so hypotheses are scored in one batch
+  Eigen::Matrix3Xd points_mat(3, n);
+  Eigen::Matrix2Xd pixels_mat(2, n);
+  for (size_t i = 0; i < n; i++) {
+    points_mat.col(i) = points[i];
+    pixels_mat.col(i) = pixels[i].cast<double>();
+  }
+
+  std::mutex best_mutex;
+  Eigen::Matrix4d best_T = Eigen::Matrix4d::Identity();
+  int best_inliers = 0;
+  bool best_is_prior = false;
+  if (T_CAMERA_WORLD_prior) {
+    best_T = *T_CAMERA_WORLD_prior;
+    best_inliers = CountInliers(cam_model, best_T, points_mat, pixels_mat, 0);
+    best_is_prior = true;
+  }
+
+  std::atomic<int> next_iteration{0};
+  std::atomic<int> required_iterations{
+      std::min(params_.max_iterations,
+               RequiredIterations(static_cast<double>(best_inliers) / n))};
+  const auto run_worker = [&](size_t thread_id) {
+    std::mt19937 generator(params_.seed + thread_id);
+    std::uniform_int_distribution<size_t> distribution(0, n - 1);
+    std::vector<Eigen::Vector2i, beam::AlignVec2i> sample_pixels(3);
+    std::vector<Eigen::Vector3d, beam::AlignVec3d> sample_points(3);
+    while (next_iteration.fetch_add(1) < required_iterations.load()) {
+      size_t indices[3];
+      indices[0] = distribution(generator);
+      do {
+        indices[1] = distribution(generator);
+      } while (indices[1] == indices[0]);
+      do {
+        indices[2] = distribution(generator);
+      } while (indices[2] == indices[0] || indices[2] == indices[1]);
+      for (int j = 0; j < 3; j++) {
+        sample_pixels[j] = pixels[indices[j]];
+        sample_points[j] = points[indices[j]];
+      }
+
+      std::vector<Eigen::Matrix4d> hypotheses;
+      try {
+        hypotheses = beam_cv::AbsolutePoseEstimator::P3PEstimator(
+            cam_model, sample_pixels, sample_points);
+      } catch (const std::exception& e) { continue; }
+
+      for (const auto& T : hypotheses) {
+        int min_to_beat;
+        {
+          std::lock_guard<std::mutex> lock(best_mutex);
+          min_to_beat = best_inliers;
+        }
+        const int num_inliers =
+            CountInliers(cam_model, T, points_mat, pixels_mat, min_to_beat);
+        if (num_inliers <= min_to_beat) { continue; }
+
+        std::lock_guard<std::mutex> lock(best_mutex);
+        if (num_inliers <= best_inliers) { continue; }
+        best_T = T;
+        best_inliers = num_inliers;
+        best_is_prior = false;
+        const int required =
+            RequiredIterations(static_cast<double>(num_inliers) / n);
+        if (required < required_iterations.load()) {
+          required_iterations = required;
+        }
+      }
+    }
+  };
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, params_.num_threads, run_worker,
+      params_.num_threads);
+
+  result.num_iterations =
+      std::min(next_iteration.load(), required_iterations.load());
+  result.T_CAMERA_WORLD = best_T;
+  result.used_prior = best_is_prior;
+  CountInliers(cam_model, best_T, points_mat, pixels_mat, 0, &result.inliers);
+  result.success =
+      static_cast<int>(result.inliers.size()) >= params_.min_inliers;
+  return result;
+}
+
+int PnPRansac::CountInliers(
+    const std::shared_ptr<beam_calibration::CameraModel>& cam_model,
+    const Eigen::Matrix4d& T_CAMERA_WORLD, const Eigen::Matrix3Xd& points,
+    const Eigen::Matrix2Xd& pixels, int min_to_beat,
+    std::vector<int>* inliers) const {
+  const Eigen::Matrix3Xd points_camera =
+      (T_CAMERA_WORLD.block<3, 3>(0, 0) * points).colwise() +
+      T_CAMERA_WORLD.block<3, 1>(0, 3);
+  const double threshold_sq =
+      params_.inlier_threshold * params_.inlier_threshold;
+  const int n = points.cols();
+  int num_inliers = 0;
+  for (int i = 0; i < n; i++) {
+    // stop once this can't beat the best hypothesis
+    if (!inliers && num_inliers + (n - i) <= min_to_beat) {
+      return num_inliers;
+    }
+    if (points_camera(2, i) <= 0) { continue; }
+    Eigen::Vector2d projection;
+    bool in_image{false};
+    if (!cam_model->ProjectPoint(points_camera.col(i), projection, in_image) ||
+        !in_image) {
+      continue;
+    }
+    if ((projection - pixels.col(i)).squaredNorm() > threshold_sq) {
+      continue;
+    }
+    num_inliers++;
+    if (inliers) { inliers->push_back(i); }
+  }
+  return num_inliers;
+}
+
+int PnPRansac::RequiredIterations(double inlier_ratio) const {
+  const double p_good_sample = std::pow(inlier_ratio, 3);
+  if (p_good_sample <= 0) { return params_.max_iterations; }
+  if (p_good_sample >= 1) { return 1; }
+  const double iterations =
+      std::log(1 - params_.confidence) / std::log(1 - p_good_sample);
+  return static_cast<int>(
+      std::min<double>(std::ceil(iterations), params_.max_iterations));
+}
+
+}} // namespace bs_models::vision
@@ -0,0 +1,127 @@
+#include <bs_models/vision/rig_pose_refinement.h>
+
+#include <ceres/autodiff_cost_function.h>
+#include <ceres/covariance.h>
+#include <ceres/loss_function.h>
+#include <ceres/problem.h>
+#include <ceres/rotation.h>
+#include <ceres/solver.h>
+
+#include <bs_constraints/visual/euclidean_reprojection_functor.h>
+
+namespace bs_models { namespace vision {
+
+namespace {
+
+/**
+ * @brief reprojection of a fixed world point into a camera of the rig. The
+ * orientation is parameterized by a rotation vector applied to the initial
+ * orientation (in the world frame), so the pose has 6 parameters
+ */
+class RigReprojectionFunctor {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  RigReprojectionFunctor(const Eigen::Vector2d& pixel, const RigCamera& camera,
+                         const Eigen::Vector3d& point,
+                         const Eigen::Quaterniond& q_WORLD_BASELINK_init)
+      : reprojection_(Eigen::Matrix2d::Identity(), pixel, camera.K,
+                      camera.T_cam_baselink),
+        point_(point),
+        q_init_(q_WORLD_BASELINK_init) {}
+
+  template <typename T>
+  bool operator()(const T* const r_WORLD_BASELINK,
+                  const T* const p_WORLD_BASELINK, T* residual) const {
+    T q_delta[4];
+    ceres::AngleAxisToQuaternion(r_WORLD_BASELINK, q_delta);
+    const T q_init[4] = {T(q_init_.w()), T(q_init_.x()), T(q_init_.y()),
+                         T(q_init_.z())};
+    T o_WORLD_BASELINK[4];
+    ceres::QuaternionProduct(q_delta, q_init, o_WORLD_BASELINK);
+    const T P[3] = {T(point_[0]), T(point_[1]), T(point_[2])};
+    return reprojection_(o_WORLD_BASELINK, p_WORLD_BASELINK, P, residual);
+  }
+
+private:
+  bs_constraints::EuclideanReprojectionFunctor reprojection_;
+  Eigen::Vector3d point_;
+  Eigen::Quaterniond q_init_;
+};
+
+} // namespace
+
+RigPoseRefinement::RigPoseRefinement(const Params& params) : params_(params) {}
+
+bool RigPoseRefinement::Refine(
+    const CameraRig& rig, const std::vector<Correspondences>& correspondences,
+    Eigen::Matrix4d& T_WORLD_BASELINK,
+    Eigen::Matrix<double, 6, 6>* covariance) const {
+  const Eigen::Quaterniond q_init =
+      Eigen::Quaterniond(T_WORLD_BASELINK.block<3, 3>(0, 0)).normalized();
+  double r[3] = {0, 0, 0};
+  double p[3] = {T_WORLD_BASELINK(0, 3), T_WORLD_BASELINK(1, 3),
+                 T_WORLD_BASELINK(2, 3)};
+
+  // the problem takes ownership of the loss once it is used by a residual, it
+  // is shared by all residuals
+  ceres::Problem problem;
+  ceres::LossFunction* loss = new ceres::HuberLoss(params_.loss_threshold);
+  int num_residuals = 0;
+  for (size_t i = 0; i < correspondences.size() && i < rig.Size(); i++) {
+    const RigCamera& camera = rig.Camera(i);
+    const Correspondences& c = correspondences[i];
+    for (size_t j = 0; j < c.pixels.size(); j++) {
+      Eigen::Vector2i rectified_pixel;
+      if (!camera.model->UndistortPixel(c.pixels[j], rectified_pixel)) {
+        continue;
+      }
+      problem.AddResidualBlock(
+          new ceres::AutoDiffCostFunction<RigReprojectionFunctor, 2, 3, 3>(
+              new RigReprojectionFunctor(rectified_pixel.cast<double>(), camera,
+                                         c.points[j], q_init)),
+          loss, r, p);
+      num_residuals++;
+    }
+  }
+  if (num_residuals < 3) {
+    if (num_residuals == 0) { delete loss; }
+    return false;
+  }
+
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.max_num_iterations = params_.max_iterations;
+  options.max_solver_time_in_seconds = params_.max_solver_time;
+  options.minimizer_progress_to_stdout = false;
+  options.logging_type = ceres::SILENT;
+  options.num_threads = 1;
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+  if (!summary.IsSolutionUsable()) { return false; }
+
+  if (covariance) {
+    ceres::Covariance::Options covariance_options;
+    ceres::Covariance ceres_covariance(covariance_options);
+    std::vector<std::pair<const double*, const double*>> blocks{
+        {r, r}, {r, p}, {p, p}};
+    if (!ceres_covariance.Compute(blocks, &problem)) { return false; }
+    Eigen::Matrix<double, 6, 6, Eigen::RowMajor> covariance_rp;
+    ceres_covariance.GetCovarianceMatrix({r, p}, covariance_rp.data());
+    // reorder covariance to be x, y, z, roll, pitch, yaw
+    covariance->block<3, 3>(0, 0) = covariance_rp.block<3, 3>(3, 3);
+    covariance->block<3, 3>(0, 3) = covariance_rp.block<3, 3>(3, 0);
+    covariance->block<3, 3>(3, 0) = covariance_rp.block<3, 3>(0, 3);
+    covariance->block<3, 3>(3, 3) = covariance_rp.block<3, 3>(0, 0);
+  }
+
+  double q[4];
+  ceres::AngleAxisToQuaternion(r, q);
+  const Eigen::Quaterniond q_delta(q[0], q[1], q[2], q[3]);
+  T_WORLD_BASELINK.block<3, 3>(0, 0) =
+      (q_delta * q_init).normalized().toRotationMatrix();
+  T_WORLD_BASELINK.block<3, 1>(0, 3) = Eigen::Vector3d(p[0], p[1], p[2]);
+  return true;
+}
+
+}} // namespace bs_models::vision
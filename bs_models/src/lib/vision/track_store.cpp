@@ -0,0 +1,57 @@
+#include <bs_models/vision/track_store.h>
+
+#include <algorithm>
+
+namespace bs_models { namespace vision {
+
+bool TrackStore::AddFrame(
+    const ros::Time& stamp, const std::vector<uint64_t>& ids,
+    const std::vector<Eigen::Vector2d, beam::AlignVec2d>& pixels) {
+  if (!frames_.empty() && stamp <= frames_.rbegin()->first) { return false; }
+  for (size_t i = 0; i < ids.size(); i++) {
+    tracks_[ids[i]].push_back(Observation{stamp, pixels[i]});
+  }
+  frames_.emplace(stamp, ids);
+  return true;
+}
+
+const TrackStore::Track& TrackStore::GetTrack(uint64_t id) const {
+  const auto iter = tracks_.find(id);
+  if (iter == tracks_.end()) { return empty_track_; }
+  return iter->second;
+}
+
+beam::opt<Eigen::Vector2d> TrackStore::GetPixel(const ros::Time& stamp,
+                                                uint64_t id) const {
+  // most lookups are for the newest frame, so search from the back
+  const Track& track = GetTrack(id);
+  for (auto iter = track.rbegin(); iter != track.rend(); iter++) {
+    if (iter->stamp == stamp) { return iter->pixel; }
+    if (iter->stamp < stamp) { break; }
+  }
+  return {};
+}
+
+void TrackStore::RemoveBefore(const ros::Time& stamp) {
+  const auto end = frames_.lower_bound(stamp);
+  for (auto frame_iter = frames_.begin(); frame_iter != end; frame_iter++) {
+    for (const uint64_t id : frame_iter->second) {
+      auto track_iter = tracks_.find(id);
+      if (track_iter == tracks_.end()) { continue; }
+      Track& track = track_iter->second;
+      const auto first_kept = std::find_if(
+          track.begin(), track.end(),
+          [&stamp](const Observation& o) { return o.stamp >= stamp; });
+      track.erase(track.begin(), first_kept);
+      if (track.empty()) { tracks_.erase(track_iter); }
+    }
+  }
+  frames_.erase(frames_.begin(), end);
+}
+
+void TrackStore::Clear() {
+  tracks_.clear();
+  frames_.clear();
+}
+
+}} // namespace bs_models::vision
@@ -207,4 +207,43 @@ std::map<uint64_t, Eigen::Matrix4d> ComputePathWithVision(
   return init_path;
 }
 
+Eigen::VectorXd ComputeReprojectionErrors(
+    const std::shared_ptr<beam_calibration::CameraModel>& camera_model,
+    const Eigen::Matrix4d& T_CAMERA_WORLD,
+    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
+    const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points) {
+  const size_t n = std::min(pixels.size(), points.size());
+  Eigen::VectorXd errors = Eigen::VectorXd::Constant(n, -1);
+  if (n == 0) { return errors; }
+
+  // both vectors are contiguous, so they can be mapped as matrices
+  const Eigen::Map<const Eigen::Matrix3Xd> points_world(points[0].data(), 3,
+                                                        n);
+  const Eigen::Map<const Eigen::Matrix2Xi> measured(pixels[0].data(), 2, n);
+  const Eigen::Matrix3Xd points_camera =
+      (T_CAMERA_WORLD.block<3, 3>(0, 0) * points_world).colwise() +
+      T_CAMERA_WORLD.block<3, 1>(0, 3);
+
+  Eigen::Matrix2Xd projections = Eigen::Matrix2Xd::Zero(2, n);
+  std::vector<bool> valid(n, false);
+  for (size_t i = 0; i < n; i++) {
+    if (points_camera(2, i) <= 0) { continue; }
+    Eigen::Vector2d projection;
+    bool in_image{false};
+    if (!camera_model->ProjectPoint(points_camera.col(i), projection,
+                                    in_image) ||
+        !in_image) {
+      continue;
+    }
+    projections.col(i) = projection;
+    valid[i] = true;
+  }
+  const Eigen::VectorXd norms =
+      (projections - measured.cast<double>()).colwise().norm().transpose();
+  for (size_t i = 0; i < n; i++) {
+    if (valid[i]) { errors[i] = norms[i]; }
+  }
+  return errors;
+}
+
 }} // namespace bs_models::vision
\ No newline at end of file
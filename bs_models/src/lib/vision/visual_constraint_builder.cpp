@@ -0,0 +1,150 @@
+#include <bs_models/vision/visual_constraint_builder.h>
+
+#include <bs_constraints/visual/euclidean_reprojection_constraint.h>
+#include <bs_constraints/visual/euclidean_reprojection_constraint_online_calib.h>
+#include <bs_constraints/visual/inversedepth_reprojection_constraint.h>
+#include <bs_constraints/visual/inversedepth_reprojection_constraint_unary.h>
+
+#include <bs_models/vision/visual_map.h>
+
+namespace bs_models { namespace vision {
+
+VisualConstraintBuilder::VisualConstraintBuilder(
+    VisualMap& visual_map, fuse_core::Transaction::SharedPtr transaction,
+    bool use_arena)
+    : visual_map_(visual_map), transaction_(transaction) {
+  // if the camera calibration hasn't been added yet
+  if (!visual_map_.calibration_added_) {
+    visual_map_.AddCameraCalibration(transaction_);
+  }
+  if (use_arena) { arena_ = std::make_shared<bs_common::MonotonicArena>(); }
+}
+
+template <typename ConstraintType, typename... Args>
+void VisualConstraintBuilder::EmplaceConstraint(Args&&... args) {
+  std::shared_ptr<ConstraintType> constraint;
+  if (arena_) {
+    constraint = std::allocate_shared<ConstraintType>(
+        bs_common::ArenaAllocator<ConstraintType>(arena_),
+        std::forward<Args>(args)...);
+  } else {
+    constraint = bs_common::MakePooled<ConstraintType>(
+        visual_map_.use_pooled_allocation_, std::forward<Args>(args)...);
+  }
+  constraint->loss(visual_map_.loss_function_);
+  transaction_->addConstraint(constraint);
+  num_constraints_++;
+}
+
+bool VisualConstraintBuilder::AddVisualConstraint(
+    const ros::Time& stamp, uint64_t lm_id, const Eigen::Vector2d& pixel) {
+  const auto lm = visual_map_.GetLandmark(lm_id);
+  if (!lm) { return false; }
+
+  const Pose& pose = GetPose(stamp);
+  if (!pose.position || !pose.orientation) { return false; }
+
+  const RigCamera* camera;
+  if (!GetCamera(lm_id, camera)) { return false; }
+
+  Eigen::Vector2d measurement;
+  if (!Rectify(pixel, camera, measurement)) { return false; }
+
+  try {
+    if (camera) {
+      // the extrinsics of the other cameras of a rig are not estimated
+      EmplaceConstraint<bs_constraints::EuclideanReprojectionConstraint>(
+          visual_map_.source_, *pose.orientation, *pose.position, *lm,
+          camera->T_cam_baselink, camera->K, measurement,
+          visual_map_.reprojection_information_weight_);
+    } else if (!visual_map_.use_online_calibration_) {
+      EmplaceConstraint<bs_constraints::EuclideanReprojectionConstraint>(
+          visual_map_.source_, *pose.orientation, *pose.position, *lm,
+          visual_map_.T_cam_baselink_, visual_map_.camera_intrinsic_matrix_,
+          measurement, visual_map_.reprojection_information_weight_);
+    } else {
+      EmplaceConstraint<
+          bs_constraints::EuclideanReprojectionConstraintOnlineCalib>(
+          visual_map_.source_, *pose.orientation, *pose.position, *lm,
+          *visual_map_.o_BASELINK_CAM_, *visual_map_.p_BASELINK_CAM_,
+          visual_map_.camera_intrinsic_matrix_, measurement,
+          visual_map_.reprojection_information_weight_);
+    }
+  } catch (const std::logic_error& le) { return false; }
+  return true;
+}
+
+bool VisualConstraintBuilder::AddInverseDepthVisualConstraint(
+    const ros::Time& measurement_stamp, uint64_t lm_id,
+    const Eigen::Vector2d& pixel) {
+  const auto lm = visual_map_.GetInverseDepthLandmark(lm_id);
+  if (!lm) { return false; }
+
+  const Pose& pose_m = GetPose(measurement_stamp);
+  const Pose& pose_a = GetPose(lm->anchorStamp());
+  if (!pose_a.position || !pose_a.orientation || !pose_m.position ||
+      !pose_m.orientation) {
+    return false;
+  }
+
+  const RigCamera* camera;
+  if (!GetCamera(lm_id, camera)) { return false; }
+
+  Eigen::Vector2d measurement;
+  if (!Rectify(pixel, camera, measurement)) { return false; }
+
+  const Eigen::Matrix4d& T_cam_baselink =
+      camera ? camera->T_cam_baselink : visual_map_.T_cam_baselink_;
+  const Eigen::Matrix3d& K =
+      camera ? camera->K : visual_map_.camera_intrinsic_matrix_;
+  try {
+    if (lm->anchorStamp() == measurement_stamp) {
+      EmplaceConstraint<
+          bs_constraints::InverseDepthReprojectionConstraintUnary>(
+          visual_map_.source_, *pose_a.orientation, *pose_a.position, *lm,
+          T_cam_baselink, K, measurement,
+          visual_map_.reprojection_information_weight_);
+    } else {
+      EmplaceConstraint<bs_constraints::InverseDepthReprojectionConstraint>(
+          visual_map_.source_, *pose_a.orientation, *pose_a.position,
+          *pose_m.orientation, *pose_m.position, *lm, T_cam_baselink, K,
+          measurement, visual_map_.reprojection_information_weight_);
+    }
+  } catch (const std::logic_error& le) { return false; }
+  return true;
+}
+
+const VisualConstraintBuilder::Pose&
+    VisualConstraintBuilder::GetPose(const ros::Time& stamp) {
+  const auto [iter, inserted] = poses_.emplace(stamp.toNSec(), Pose());
+  if (inserted) {
+    iter->second.position = visual_map_.GetPosition(stamp);
+    iter->second.orientation = visual_map_.GetOrientation(stamp);
+  }
+  return iter->second;
+}
+
+bool VisualConstraintBuilder::GetCamera(uint64_t lm_id,
+                                        const RigCamera*& camera) const {
+  camera = nullptr;
+  const auto& rig = visual_map_.camera_rig_;
+  if (!rig || rig->Size() < 2) { return true; }
+  size_t index;
+  if (!rig->IndexOfLandmark(lm_id, index)) { return false; }
+  if (index != 0) { camera = &rig->Camera(index); }
+  return true;
+}
+
+bool VisualConstraintBuilder::Rectify(const Eigen::Vector2d& pixel,
+                                      const RigCamera* camera,
+                                      Eigen::Vector2d& measurement) {
+  const auto& cam_model = camera ? camera->model : visual_map_.cam_model_;
+  Eigen::Vector2i rectified_pixel;
+  if (!cam_model->UndistortPixel(pixel.cast<int>(), rectified_pixel)) {
+    return false;
+  }
+  measurement = rectified_pixel.cast<double>();
+  return true;
+}
+
+}} // namespace bs_models::vision
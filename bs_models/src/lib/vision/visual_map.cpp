@@ -7,15 +7,16 @@
 
 #include <bs_common/conversions.h>
 #include <bs_common/graph_access.h>
+#include <bs_common/pool_allocator.h>
 #include <bs_constraints/global/absolute_pose_3d_constraint.h>
 #include <bs_constraints/relative_pose/relative_pose_3d_stamped_with_extrinsics_constraint.h>
-#include <bs_constraints/visual/euclidean_reprojection_constraint.h>
-#include <bs_constraints/visual/euclidean_reprojection_constraint_online_calib.h>
 #include <bs_constraints/visual/inversedepth_reprojection_constraint.h>
 #include <bs_constraints/visual/inversedepth_reprojection_constraint_unary.h>
 #include <fuse_constraints/absolute_pose_3d_stamped_constraint.h>
 #include <fuse_constraints/relative_pose_3d_stamped_constraint.h>
 
+#include <bs_models/vision/visual_constraint_builder.h>
+
 namespace bs_models { namespace vision {
 
 VisualMap::VisualMap(const std::string& source,
@@ -70,152 +71,56 @@ beam::opt<Eigen::Matrix4d> VisualMap::GetBaselinkPose(const ros::Time& stamp) {
 
 bs_variables::InverseDepthLandmark::SharedPtr
     VisualMap::GetInverseDepthLandmark(uint64_t landmark_id) {
-  bs_variables::InverseDepthLandmark::SharedPtr landmark =
-      bs_variables::InverseDepthLandmark::make_shared();
-  auto landmark_uuid = fuse_core::uuid::generate(landmark->type(), landmark_id);
-  if (graph_) {
-    try {
-      *landmark = dynamic_cast<const bs_variables::InverseDepthLandmark&>(
-          graph_->getVariable(landmark_uuid));
-      return landmark;
-    } catch (const std::out_of_range& oor) {
-      if (inversedepth_landmark_positions_.find(landmark_id) ==
-          inversedepth_landmark_positions_.end()) {
-        return nullptr;
-      } else {
-        return inversedepth_landmark_positions_[landmark_id];
-      }
-    }
-  } else if (inversedepth_landmark_positions_.find(landmark_id) !=
-             inversedepth_landmark_positions_.end()) {
-    return inversedepth_landmark_positions_[landmark_id];
+  const auto graph_landmark = graph_view_.GetInverseDepthLandmark(landmark_id);
+  if (graph_landmark) {
+    return std::make_shared<bs_variables::InverseDepthLandmark>(
+        *graph_landmark);
   }
-
-  return nullptr;
+  const auto iter = inversedepth_landmark_positions_.find(landmark_id);
+  if (iter == inversedepth_landmark_positions_.end()) { return nullptr; }
+  return iter->second;
 }
 
 bs_variables::Point3DLandmark::SharedPtr
     VisualMap::GetLandmark(uint64_t landmark_id) {
-  bs_variables::Point3DLandmark::SharedPtr landmark =
-      bs_variables::Point3DLandmark::make_shared();
-  auto landmark_uuid = fuse_core::uuid::generate(landmark->type(), landmark_id);
-  if (graph_) {
-    try {
-      *landmark = dynamic_cast<const bs_variables::Point3DLandmark&>(
-          graph_->getVariable(landmark_uuid));
-      return landmark;
-    } catch (const std::out_of_range& oor) {
-      if (landmark_positions_.find(landmark_id) == landmark_positions_.end()) {
-        return nullptr;
-      } else {
-        return landmark_positions_[landmark_id];
-      }
-    }
-  } else if (landmark_positions_.find(landmark_id) !=
-             landmark_positions_.end()) {
-    return landmark_positions_[landmark_id];
+  const auto graph_landmark = graph_view_.GetLandmark(landmark_id);
+  if (graph_landmark) {
+    return std::make_shared<bs_variables::Point3DLandmark>(*graph_landmark);
   }
-
-  return nullptr;
+  const auto iter = landmark_positions_.find(landmark_id);
+  if (iter == landmark_positions_.end()) { return nullptr; }
+  return iter->second;
 }
 
 fuse_variables::Orientation3DStamped::SharedPtr
     VisualMap::GetOrientation(const ros::Time& stamp) {
-  fuse_variables::Orientation3DStamped::SharedPtr corr_orientation =
-      fuse_variables::Orientation3DStamped::make_shared();
-  auto corr_orientation_uuid = fuse_core::uuid::generate(
-      corr_orientation->type(), stamp, fuse_core::uuid::NIL);
-  if (graph_) {
-    try {
-      *corr_orientation =
-          dynamic_cast<const fuse_variables::Orientation3DStamped&>(
-              graph_->getVariable(corr_orientation_uuid));
-      return corr_orientation;
-    } catch (const std::out_of_range& oor) {
-      if (orientations_.find(stamp.toNSec()) == orientations_.end()) {
-        return nullptr;
-      } else {
-        return orientations_[stamp.toNSec()];
-      }
-    }
-  } else if (orientations_.find(stamp.toNSec()) != orientations_.end()) {
-    return orientations_[stamp.toNSec()];
+  const auto graph_orientation = graph_view_.GetOrientation(stamp);
+  if (graph_orientation) {
+    return std::make_shared<fuse_variables::Orientation3DStamped>(
+        *graph_orientation);
   }
-
-  return nullptr;
+  const auto iter = orientations_.find(stamp.toNSec());
+  if (iter == orientations_.end()) { return nullptr; }
+  return iter->second;
 }
 
 fuse_variables::Position3DStamped::SharedPtr
     VisualMap::GetPosition(const ros::Time& stamp) {
-  fuse_variables::Position3DStamped::SharedPtr corr_position =
-      fuse_variables::Position3DStamped::make_shared();
-  auto corr_position_uuid = fuse_core::uuid::generate(
-      corr_position->type(), stamp, fuse_core::uuid::NIL);
-  if (graph_) {
-    try {
-      *corr_position = dynamic_cast<const fuse_variables::Position3DStamped&>(
-          graph_->getVariable(corr_position_uuid));
-      return corr_position;
-    } catch (const std::out_of_range& oor) {
-      if (positions_.find(stamp.toNSec()) == positions_.end()) {
-        return nullptr;
-      } else {
-        return positions_[stamp.toNSec()];
-      }
-    }
-  } else if (positions_.find(stamp.toNSec()) != positions_.end()) {
-    return positions_[stamp.toNSec()];
+  const auto graph_position = graph_view_.GetPosition(stamp);
+  if (graph_position) {
+    return std::make_shared<fuse_variables::Position3DStamped>(
+        *graph_position);
   }
-
-  return nullptr;
+  const auto iter = positions_.find(stamp.toNSec());
+  if (iter == positions_.end()) { return nullptr; }
+  return iter->second;
 }
 
 bool VisualMap::AddVisualConstraint(
     const ros::Time& stamp, uint64_t lm_id, const Eigen::Vector2d& pixel,
     fuse_core::Transaction::SharedPtr transaction) {
-  // if the camera calibration hasn't been added yet
-  if (!calibration_added_) { AddCameraCalibration(transaction); }
-
-  // get landmark
-  bs_variables::Point3DLandmark::SharedPtr lm = GetLandmark(lm_id);
-
-  // get robot pose
-  fuse_variables::Position3DStamped::SharedPtr position = GetPosition(stamp);
-  fuse_variables::Orientation3DStamped::SharedPtr orientation =
-      GetOrientation(stamp);
-
-  // rectify pixel
-  Eigen::Vector2i rectified_pixel;
-  if (!cam_model_->UndistortPixel(pixel.cast<int>(), rectified_pixel)) {
-    return false;
-  }
-  Eigen::Vector2d measurement = rectified_pixel.cast<double>();
-
-  if (!position || !orientation) { return false; }
-  try {
-    if (lm) {
-      if (!use_online_calibration_) {
-        auto vis_constraint =
-            std::make_shared<bs_constraints::EuclideanReprojectionConstraint>(
-                source_, *orientation, *position, *lm, T_cam_baselink_,
-                camera_intrinsic_matrix_, measurement,
-                reprojection_information_weight_);
-        vis_constraint->loss(loss_function_);
-        transaction->addConstraint(vis_constraint);
-      } else {
-        auto vis_constraint = std::make_shared<
-            bs_constraints::EuclideanReprojectionConstraintOnlineCalib>(
-            source_, *orientation, *position, *lm, *o_BASELINK_CAM_,
-            *p_BASELINK_CAM_, camera_intrinsic_matrix_, measurement,
-            reprojection_information_weight_);
-        vis_constraint->loss(loss_function_);
-        transaction->addConstraint(vis_constraint);
-      }
-      return true;
-    }
-  } catch (const std::logic_error& le) {}
-
-  return false;
+  VisualConstraintBuilder builder(*this, transaction, false);
+  return builder.AddVisualConstraint(stamp, lm_id, pixel);
 }
 
 void VisualMap::AddCameraPose(const Eigen::Matrix4d& T_WORLD_CAMERA,
@@ -252,8 +157,9 @@ void VisualMap::AddOrientation(const Eigen::Quaterniond& q_WORLD_BASELINK,
                                const ros::Time& stamp,
                                fuse_core::Transaction::SharedPtr transaction) {
   // cosntruct orientation variable
-  fuse_variables::Orientation3DStamped::SharedPtr orientation =
-      fuse_variables::Orientation3DStamped::make_shared(stamp);
+  auto orientation =
+      bs_common::MakePooled<fuse_variables::Orientation3DStamped>(
+          use_pooled_allocation_, stamp);
   orientation->w() = q_WORLD_BASELINK.w();
   orientation->x() = q_WORLD_BASELINK.x();
   orientation->y() = q_WORLD_BASELINK.y();
@@ -267,8 +173,8 @@ void VisualMap::AddPosition(const Eigen::Vector3d& p_WORLD_BASELINK,
                             const ros::Time& stamp,
                             fuse_core::Transaction::SharedPtr transaction) {
   // construct position variable
-  fuse_variables::Position3DStamped::SharedPtr position =
-      fuse_variables::Position3DStamped::make_shared(stamp);
+  auto position = bs_common::MakePooled<fuse_variables::Position3DStamped>(
+      use_pooled_allocation_, stamp);
   position->x() = p_WORLD_BASELINK[0];
   position->y() = p_WORLD_BASELINK[1];
   position->z() = p_WORLD_BASELINK[2];
@@ -319,6 +225,7 @@ void VisualMap::AddLandmark(bs_variables::Point3DLandmark::SharedPtr landmark,
   // add to transaction
   transaction->addVariable(landmark);
   landmark_positions_[landmark->id()] = landmark;
+  landmark_store_outdated_ = true;
 
   // if the camera calibration hasn't been added yet
   if (!calibration_added_) { AddCameraCalibration(transaction); }
@@ -343,68 +250,47 @@ void VisualMap::AddInverseDepthLandmark(
   // add to transaction
   transaction->addVariable(landmark);
   inversedepth_landmark_positions_[landmark->id()] = landmark;
+  landmark_store_outdated_ = true;
 
   // if the camera calibration hasn't been added yet
   if (!calibration_added_) { AddCameraCalibration(transaction); }
 }
 
-bool VisualMap::AddInverseDepthVisualConstraint(
-    const ros::Time& measurement_stamp, uint64_t lm_id,
-    const Eigen::Vector2d& pixel,
+bool VisualMap::ReplaceInverseDepthLandmark(
+    uint64_t landmark_id, const Eigen::Vector3d& position,
+    const Eigen::Vector3d& viewing_angle, const uint64_t word_id,
     fuse_core::Transaction::SharedPtr transaction) {
-  // if the camera calibration hasn't been added yet
-  if (!calibration_added_) { AddCameraCalibration(transaction); }
-
-  // get landmark
-  bs_variables::InverseDepthLandmark::SharedPtr lm =
-      GetInverseDepthLandmark(lm_id);
-
-  // get measurement robot pose
-  fuse_variables::Position3DStamped::SharedPtr position_m =
-      GetPosition(measurement_stamp);
-  fuse_variables::Orientation3DStamped::SharedPtr orientation_m =
-      GetOrientation(measurement_stamp);
-
-  // get anchor robot pose
-  fuse_variables::Position3DStamped::SharedPtr position_a =
-      GetPosition(lm->anchorStamp());
-  fuse_variables::Orientation3DStamped::SharedPtr orientation_a =
-      GetOrientation(lm->anchorStamp());
-
-  // rectify pixel
-  Eigen::Vector2i rectified_pixel;
-  if (!cam_model_->UndistortPixel(pixel.cast<int>(), rectified_pixel)) {
-    return false;
+  const auto graph_landmark = graph_view_.GetInverseDepthLandmark(landmark_id);
+  if (!graph_landmark) { return false; }
+
+  // the variable can only be removed with all of its constraints
+  using Reprojection = bs_constraints::InverseDepthReprojectionConstraint;
+  using ReprojectionUnary =
+      bs_constraints::InverseDepthReprojectionConstraintUnary;
+  std::vector<fuse_core::UUID> constraints;
+  for (const auto& constraint :
+       graph_->getConnectedConstraints(graph_landmark->uuid())) {
+    if (!dynamic_cast<const Reprojection*>(&constraint) &&
+        !dynamic_cast<const ReprojectionUnary*>(&constraint)) {
+      return false;
+    }
+    constraints.push_back(constraint.uuid());
   }
-  Eigen::Vector2d measurement = rectified_pixel.cast<double>();
+  for (const auto& uuid : constraints) { transaction->removeConstraint(uuid); }
+  transaction->removeVariable(graph_landmark->uuid());
+  inversedepth_landmark_positions_.erase(landmark_id);
 
-  if (!position_a || !orientation_a || !position_m || !orientation_m) {
-    return false;
-  }
-  try {
-    if (lm) {
-      if (lm->anchorStamp() == measurement_stamp) {
-        auto vis_constraint = std::make_shared<
-            bs_constraints::InverseDepthReprojectionConstraintUnary>(
-            source_, *orientation_a, *position_a, *lm, T_cam_baselink_,
-            camera_intrinsic_matrix_, measurement,
-            reprojection_information_weight_);
-        vis_constraint->loss(loss_function_);
-        transaction->addConstraint(vis_constraint);
-      } else {
-        auto vis_constraint = std::make_shared<
-            bs_constraints::InverseDepthReprojectionConstraint>(
-            source_, *orientation_a, *position_a, *orientation_m, *position_m,
-            *lm, T_cam_baselink_, camera_intrinsic_matrix_, measurement,
-            reprojection_information_weight_);
-        vis_constraint->loss(loss_function_);
-        transaction->addConstraint(vis_constraint);
-      }
-      return true;
-    }
-  } catch (const std::logic_error& le) {}
+  AddLandmark(position, viewing_angle, word_id, landmark_id, transaction);
+  return true;
+}
 
-  return false;
+bool VisualMap::AddInverseDepthVisualConstraint(
+    const ros::Time& measurement_stamp, uint64_t lm_id,
+    const Eigen::Vector2d& pixel,
+    fuse_core::Transaction::SharedPtr transaction) {
+  VisualConstraintBuilder builder(*this, transaction, false);
+  return builder.AddInverseDepthVisualConstraint(measurement_stamp, lm_id,
+                                                 pixel);
 }
 
 fuse_core::UUID VisualMap::GetLandmarkUUID(uint64_t landmark_id) {
@@ -505,14 +391,18 @@ void VisualMap::AddRelativePoseConstraintOnlineCalib(
 }
 
 void VisualMap::UpdateGraph(const fuse_core::Graph& graph_msg) {
-  graph_ = std::move(graph_msg.clone());
+  UpdateGraph(fuse_core::Graph::ConstSharedPtr(graph_msg.clone()));
+}
+
+void VisualMap::UpdateGraph(fuse_core::Graph::ConstSharedPtr graph_msg) {
+  graph_ = graph_msg;
+  graph_view_ = bs_common::GraphView(graph_);
+  landmark_store_outdated_ = true;
 
   // remove local copies of poses that are in the new graph
-  const auto graph_timestamps = bs_common::CurrentTimestamps(graph_msg);
   std::vector<uint64_t> times_to_remove;
   for (const auto [t_nsec, position] : positions_) {
-    if (graph_timestamps.find(beam::NSecToRos(t_nsec)) !=
-        graph_timestamps.end()) {
+    if (graph_view_.GetPosition(beam::NSecToRos(t_nsec))) {
       times_to_remove.push_back(t_nsec);
     }
   }
@@ -522,7 +412,7 @@ void VisualMap::UpdateGraph(const fuse_core::Graph& graph_msg) {
   }
 
   // remove local copies of landmarks that are in the new graph
-  const auto graph_lm_ids = bs_common::CurrentLandmarkIDs(graph_msg);
+  const auto& graph_lm_ids = graph_view_.LandmarkIDs();
   std::vector<uint64_t> lms_to_remove;
   for (const auto [id, position] : landmark_positions_) {
     if (graph_lm_ids.find(id) != graph_lm_ids.end()) {
@@ -543,7 +433,7 @@ void VisualMap::UpdateGraph(const fuse_core::Graph& graph_msg) {
   // update T_cam_baselink_ from the graph if it exists
   if (use_online_calibration_) {
     auto maybe_extrinsic =
-        bs_common::GetExtrinsic(graph_msg, extrinsics_.GetBaselinkFrameId(),
+        bs_common::GetExtrinsic(*graph_, extrinsics_.GetBaselinkFrameId(),
                                 extrinsics_.GetCameraFrameId());
     if (maybe_extrinsic) {
       p_BASELINK_CAM_ = bs_common::GetPositionExtrinsic(
@@ -565,10 +455,12 @@ void VisualMap::Clear() {
 
   inversedepth_landmark_positions_.clear();
   if (graph_) { graph_ = nullptr; }
+  graph_view_ = bs_common::GraphView();
+  landmark_store_outdated_ = true;
 }
 
 std::set<ros::Time> VisualMap::CurrentTimestamps() {
-  auto graph_timestamps = bs_common::CurrentTimestamps(*graph_);
+  auto graph_timestamps = graph_view_.Timestamps();
   for (const auto& [t, pos] : positions_) {
     graph_timestamps.insert(beam::NSecToRos(t));
   }
@@ -577,9 +469,9 @@ std::set<ros::Time> VisualMap::CurrentTimestamps() {
 
 std::map<uint64_t, Eigen::Vector3d> VisualMap::GetLandmarks() {
   std::map<uint64_t, Eigen::Vector3d> landmarks;
-  std::set<uint64_t> graph_lms = bs_common::CurrentLandmarkIDs(*graph_);
-  for (const auto& id : graph_lms) {
-    landmarks[id] = bs_common::GetLandmark(*graph_, id)->point();
+  for (const auto& id : graph_view_.LandmarkIDs()) {
+    const auto landmark = graph_view_.GetLandmark(id);
+    if (landmark) { landmarks[id] = landmark->point(); }
   }
   for (const auto& [id, landmark] : landmark_positions_) {
     landmarks[id] = landmark->point();
@@ -587,8 +479,27 @@ std::map<uint64_t, Eigen::Vector3d> VisualMap::GetLandmarks() {
   return landmarks;
 }
 
+const LandmarkStore& VisualMap::GetLandmarkStore() {
+  if (!landmark_store_outdated_) { return landmark_store_; }
+
+  landmark_store_.Clear();
+  for (const auto& id : graph_view_.LandmarkIDs()) {
+    if (landmark_positions_.find(id) != landmark_positions_.end()) {
+      continue;
+    }
+    const auto landmark = graph_view_.GetLandmark(id);
+    if (landmark) { landmark_store_.Add(id, landmark->point()); }
+  }
+  for (const auto& [id, landmark] : landmark_positions_) {
+    landmark_store_.Add(id, landmark->point());
+  }
+  landmark_store_.BuildIndex();
+  landmark_store_outdated_ = false;
+  return landmark_store_;
+}
+
 std::set<uint64_t> VisualMap::GetLandmarkIDs() {
-  std::set<uint64_t> graph_lms = bs_common::CurrentLandmarkIDs(*graph_);
+  std::set<uint64_t> graph_lms = graph_view_.LandmarkIDs();
   for (const auto& [id, landmark] : landmark_positions_) {
     graph_lms.insert(id);
   }
@@ -0,0 +1,205 @@
+#include <bs_models/vision/vo_checkpoint.h>
+
+#include <cstdio>
+#include <filesystem>
+
+#include <beam_utils/log.h>
+
+#include <bs_common/chunk_file.h>
+#include <bs_models/vision/camera_measurement_view.h>
+
+namespace bs_models { namespace vision {
+
+namespace {
+
+void WriteKeyframe(const VOCheckpoint::KeyframeState& keyframe,
+                   bs_common::ByteWriter& data) {
+  const bs_common::CameraMeasurementMsg& msg = keyframe.msg;
+  data.WriteMatrix(keyframe.T_WORLD_BASELINK);
+  data.Write<uint64_t>(msg.header.stamp.toNSec());
+  data.Write<uint32_t>(msg.header.seq);
+  data.WriteString(msg.header.frame_id);
+  data.Write<uint8_t>(msg.sensor_id);
+  data.WriteString(msg.descriptor_type);
+
+  const sensor_msgs::Image& image = msg.image;
+  data.Write<uint64_t>(image.header.stamp.toNSec());
+  data.WriteString(image.header.frame_id);
+  data.Write<uint32_t>(image.height);
+  data.Write<uint32_t>(image.width);
+  data.WriteString(image.encoding);
+  data.Write<uint8_t>(image.is_bigendian);
+  data.Write<uint32_t>(image.step);
+  data.WriteVector(image.data);
+
+  // measurements are always stored packed
+  bs_common::CameraMeasurementMsg packed;
+  const bs_common::CameraMeasurementMsg* measurements = &msg;
+  if (!msg.packed) {
+    const CameraMeasurementView view(msg);
+    std::vector<uint64_t> ids;
+    std::vector<cv::Mat> descriptors;
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+        pixels;
+    for (size_t i = 0; i < view.Size(); i++) {
+      ids.push_back(view.LandmarkId(i));
+      descriptors.push_back(view.Descriptor(i));
+      pixels.push_back(view.Pixel(i));
+    }
+    PackLandmarkMeasurements(ids, descriptors, pixels, packed);
+    measurements = &packed;
+  }
+  data.WriteVector(measurements->landmark_ids);
+  data.WriteVector(measurements->pixels_u);
+  data.WriteVector(measurements->pixels_v);
+  data.WriteVector(measurements->descriptors);
+  data.Write<uint32_t>(measurements->descriptor_cols);
+  data.Write<int32_t>(measurements->descriptor_cv_type);
+}
+
+void ReadKeyframe(bs_common::ByteReader& data,
+                  VOCheckpoint::KeyframeState& keyframe) {
+  bs_common::CameraMeasurementMsg& msg = keyframe.msg;
+  data.ReadMatrix(keyframe.T_WORLD_BASELINK);
+  msg.header.stamp.fromNSec(data.Read<uint64_t>());
+  msg.header.seq = data.Read<uint32_t>();
+  msg.header.frame_id = data.ReadString();
+  msg.sensor_id = data.Read<uint8_t>();
+  msg.descriptor_type = data.ReadString();
+
+  sensor_msgs::Image& image = msg.image;
+  image.header.stamp.fromNSec(data.Read<uint64_t>());
+  image.header.frame_id = data.ReadString();
+  image.height = data.Read<uint32_t>();
+  image.width = data.Read<uint32_t>();
+  image.encoding = data.ReadString();
+  image.is_bigendian = data.Read<uint8_t>();
+  image.step = data.Read<uint32_t>();
+  data.ReadVector(image.data);
+
+  msg.packed = true;
+  msg.update = false;
+  data.ReadVector(msg.landmark_ids);
+  data.ReadVector(msg.pixels_u);
+  data.ReadVector(msg.pixels_v);
+  data.ReadVector(msg.descriptors);
+  msg.descriptor_cols = data.Read<uint32_t>();
+  msg.descriptor_cv_type = data.Read<int32_t>();
+
+  // validates the packed arrays
+  CameraMeasurementView view(msg);
+}
+
+} // namespace
+
+bool VOCheckpoint::Save(const std::string& path) const {
+  const std::string tmp_path = path + ".tmp";
+  bs_common::ChunkFileWriter writer;
+  if (!writer.Open(tmp_path, VERSION)) { return false; }
+
+  bs_common::ByteWriter data;
+  for (size_t i = 0; i < keyframes.size(); i++) {
+    data.Clear();
+    WriteKeyframe(keyframes[i], data);
+    if (!writer.AddChunk(static_cast<uint32_t>(ChunkType::KEYFRAME), i,
+                         data)) {
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+
+  data.Clear();
+  data.Write<uint64_t>(landmarks.size());
+  for (const LandmarkState& landmark : landmarks) {
+    data.Write<uint64_t>(landmark.id);
+    data.WriteMatrix(landmark.position);
+    data.WriteMatrix(landmark.viewing_angle);
+    data.Write<uint64_t>(landmark.word_id);
+  }
+  if (!writer.AddChunk(static_cast<uint32_t>(ChunkType::LANDMARKS), 0, data) ||
+      !writer.Close()) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tmp_path, path, error);
+  if (error) {
+    BEAM_ERROR("Cannot replace VO checkpoint {}: {}", path, error.message());
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool VOCheckpoint::Load(const std::string& path) {
+  Clear();
+  if (!std::filesystem::exists(path)) { return false; }
+  bs_common::ChunkFileReader reader;
+  if (!reader.Open(path)) {
+    BEAM_ERROR("Invalid VO checkpoint: {}", path);
+    return false;
+  }
+  if (reader.Version() != VERSION) {
+    BEAM_ERROR("VO checkpoint {} has version {}, expected {}", path,
+               reader.Version(), VERSION);
+    return false;
+  }
+  const bs_common::ChunkInfo* landmarks_chunk =
+      reader.Find(static_cast<uint32_t>(ChunkType::LANDMARKS), 0);
+  if (!landmarks_chunk) {
+    BEAM_ERROR("VO checkpoint {} has no landmarks chunk", path);
+    return false;
+  }
+
+  try {
+    for (const bs_common::ChunkInfo& chunk :
+         reader.Chunks(static_cast<uint32_t>(ChunkType::KEYFRAME))) {
+      bs_common::ByteReader data = reader.Read(chunk);
+      keyframes.emplace_back();
+      ReadKeyframe(data, keyframes.back());
+    }
+
+    bs_common::ByteReader data = reader.Read(*landmarks_chunk);
+    const uint64_t num_landmarks = data.Read<uint64_t>();
+    for (uint64_t i = 0; i < num_landmarks; i++) {
+      LandmarkState landmark;
+      landmark.id = data.Read<uint64_t>();
+      data.ReadMatrix(landmark.position);
+      data.ReadMatrix(landmark.viewing_angle);
+      landmark.word_id = data.Read<uint64_t>();
+      landmarks.push_back(landmark);
+    }
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Cannot read VO checkpoint {}: {}", path, e.what());
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+void VOCheckpoint::MarkRestoredLandmarks() {
+  for (LandmarkState& landmark : landmarks) {
+    landmark.id |= RESTORED_LANDMARK_FLAG;
+  }
+  for (KeyframeState& keyframe : keyframes) {
+    for (uint64_t& id : keyframe.msg.landmark_ids) {
+      id |= RESTORED_LANDMARK_FLAG;
+    }
+    for (auto& landmark : keyframe.msg.landmarks) {
+      landmark.landmark_id |= RESTORED_LANDMARK_FLAG;
+    }
+  }
+}
+
+ros::Time VOCheckpoint::Stamp() const {
+  if (keyframes.empty()) { return ros::Time(0); }
+  return keyframes.back().msg.header.stamp;
+}
+
+void VOCheckpoint::Clear() {
+  keyframes.clear();
+  landmarks.clear();
+}
+
+}} // namespace bs_models::vision
@@ -1,5 +1,6 @@
 #include <bs_models/vision/vo_localization_validation.h>
 
+#include <algorithm>
 #include <math.h>
 
 #include <beam_utils/log.h>
@@ -21,8 +22,10 @@ bool VOLocalizationValidation::Validate(
   m.avg_reprojection = avg_reprojection;
 
   metrics_.push_back(m);
+  AddToStatistics(m);
   bool passed;
   if (metrics_.size() > list_size_) {
+    RemoveFromStatistics(metrics_.front());
     metrics_.pop_front();
     passed = CheckStoredMetrics();
   } else {
@@ -32,39 +35,15 @@ bool VOLocalizationValidation::Validate(
 }
 
 bool VOLocalizationValidation::CheckStoredMetrics() const {
-  double r_sum{0};
-  double t_sum{0};
-  double entropy_sum{0};
-  double reproj_sum{0};
-
-  for (const auto& m : metrics_) {
-    r_sum += m.r;
-    t_sum += m.t;
-    entropy_sum += m.entropy;
-    reproj_sum += m.avg_reprojection;
-  }
-
-  double r_mean = r_sum / list_size_;
-  double t_mean = t_sum / list_size_;
-  double entropy_mean = entropy_sum / list_size_;
-  double reproj_mean = reproj_sum / list_size_;
-
-  double r_diffsqrd;
-  double t_diffsqrd;
-  double entropy_diffsqrd;
-  double reproj_diffsqrd;
-  for (const auto& m : metrics_) {
-    r_diffsqrd += (m.r - r_mean) * (m.r - r_mean);
-    t_diffsqrd += (m.t - t_mean) * (m.t - t_mean);
-    entropy_diffsqrd += (m.entropy - entropy_mean) * (m.entropy - entropy_mean);
-    reproj_diffsqrd +=
-        (m.avg_reprojection - reproj_mean) * (m.avg_reprojection - reproj_mean);
-  }
+  const double r_mean = r_stats_.mean;
+  const double t_mean = t_stats_.mean;
+  const double entropy_mean = entropy_stats_.mean;
+  const double reproj_mean = reproj_stats_.mean;
 
-  double r_stddev = std::sqrt(r_diffsqrd / list_size_);
-  double t_stddev = std::sqrt(t_diffsqrd / list_size_);
-  double entropy_stddev = std::sqrt(entropy_diffsqrd / list_size_);
-  double reproj_stddev = std::sqrt(reproj_diffsqrd / list_size_);
+  const double r_stddev = r_stats_.StdDev();
+  const double t_stddev = t_stats_.StdDev();
+  const double entropy_stddev = entropy_stats_.StdDev();
+  const double reproj_stddev = reproj_stats_.StdDev();
 
   const VOLocalizationMetrics& m_recent = metrics_.back();
   if (m_recent.r > r_mean + 2 * r_stddev) {
@@ -136,6 +115,51 @@ bool VOLocalizationValidation::CheckMetricInitial(
 
 void VOLocalizationValidation::Clear() {
   metrics_.clear();
+  r_stats_ = RunningStatistics();
+  t_stats_ = RunningStatistics();
+  entropy_stats_ = RunningStatistics();
+  reproj_stats_ = RunningStatistics();
+}
+
+void VOLocalizationValidation::AddToStatistics(
+    const VOLocalizationMetrics& m) {
+  r_stats_.Add(m.r);
+  t_stats_.Add(m.t);
+  entropy_stats_.Add(m.entropy);
+  reproj_stats_.Add(m.avg_reprojection);
+}
+
+void VOLocalizationValidation::RemoveFromStatistics(
+    const VOLocalizationMetrics& m) {
+  r_stats_.Remove(m.r);
+  t_stats_.Remove(m.t);
+  entropy_stats_.Remove(m.entropy);
+  reproj_stats_.Remove(m.avg_reprojection);
+}
+
+void VOLocalizationValidation::RunningStatistics::Add(double x) {
+  n++;
+  const double delta = x - mean;
+  mean += delta / n;
+  m2 += delta * (x - mean);
+}
+
+void VOLocalizationValidation::RunningStatistics::Remove(double x) {
+  if (n <= 1) {
+    *this = RunningStatistics();
+    return;
+  }
+  n--;
+  const double delta = x - mean;
+  mean -= delta / n;
+  m2 = std::max(m2 - delta * (x - mean), 0.0);
+}
+
+double VOLocalizationValidation::RunningStatistics::StdDev() const {
+  // population standard deviation, as the checks compare the most recent
+  // metric against the whole window
+  if (n == 0) { return 0; }
+  return std::sqrt(m2 / n);
 }
 
 }} // namespace bs_models::vision
\ No newline at end of file
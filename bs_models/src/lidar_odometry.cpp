@@ -1,15 +1,28 @@
 #include <bs_models/lidar_odometry.h>
 
 #include <filesystem>
+#include <type_traits>
 
 #include <fuse_core/transaction.h>
 #include <pluginlib/class_list_macros.h>
 #include <std_msgs/Time.h>
 
+#include <beam_utils/angles.h>
 #include <beam_utils/filesystem.h>
+#include <beam_utils/math.h>
+#include <beam_utils/se3.h>
 
 #include <bs_common/bs_msgs.h>
+#include <bs_common/cloud_buffer_pool.h>
 #include <bs_common/conversions.h>
+#include <bs_common/graph_view.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/latency_tracer.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_common/packed_cloud.h>
+#include <bs_common/reset_context.h>
+#include <bs_common/sampling_profiler.h>
+#include <bs_common/startup_profiler.h>
 #include <bs_models/frame_initializers/frame_initializer.h>
 #include <bs_models/graph_visualization/helpers.h>
 #include <bs_models/scan_registration/multi_scan_registration.h>
@@ -27,12 +40,22 @@ using namespace beam_matching;
 
 LidarOdometry::LidarOdometry()
     : fuse_core::AsyncSensorModel(3),
-      device_id_(fuse_core::uuid::NIL),
-      throttled_callback_(
-          std::bind(&LidarOdometry::process, this, std::placeholders::_1)) {}
+      device_id_(fuse_core::uuid::NIL) {}
 
 void LidarOdometry::onInit() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_init");
   params_.loadFromROS(private_node_handle_);
+  graph_update_lane_ = bs_common::CallbackLane<fuse_core::Graph>::FromROS(
+      private_node_handle_, "graph_update_lane", name() + "/graph_lane",
+      [this](const fuse_core::Graph::ConstSharedPtr& graph) {
+        onGraphUpdate(graph);
+      });
+  lidar_frame_id_ = params_.lidar_frame.empty() ? extrinsics_.GetLidarFrameId()
+                                                : params_.lidar_frame;
+
+  if (params_.pipeline_scan_processing) {
+    registration_pool_ = std::make_unique<bs_common::ThreadPool>(1);
+  }
 
   // get filter params
   nlohmann::json J;
@@ -58,6 +81,10 @@ void LidarOdometry::onInit() {
       if (json_valid) {
         input_filter_params_ =
             beam_filtering::LoadFilterParamsVector(J_filters);
+        input_filters_velodyne_ =
+            FilterPipeline<PointXYZIRT>(input_filter_params_);
+        input_filters_ouster_ =
+            FilterPipeline<PointXYZITRRNR>(input_filter_params_);
         ROS_INFO("Loaded %zu input filters", input_filter_params_.size());
       }
     }
@@ -80,6 +107,24 @@ void LidarOdometry::onInit() {
         std::filesystem::remove_all(graph_updates_path_);
       }
       std::filesystem::create_directory(graph_updates_path_);
+      bs_common::AsyncWriter::Params writer_params;
+      writer_params.queue_size = params_.output_queue_size;
+      writer_params.num_threads = params_.output_writer_threads;
+      writer_params.sync_batch_size = params_.output_sync_batch_size;
+      writer_params.policy = params_.drop_graph_updates_when_full
+                                 ? bs_common::AsyncWriter::Policy::DROP
+                                 : bs_common::AsyncWriter::Policy::BLOCK;
+      graph_updates_writer_ = std::make_unique<bs_common::AsyncWriter>(
+          graph_updates_path_, writer_params);
+
+      const std::string graph_path =
+          beam::CombinePaths(graph_updates_path_, "graph");
+      std::filesystem::create_directory(graph_path);
+      bs_common::GraphRecorder::Params recorder_params;
+      recorder_params.queue_size = params_.output_queue_size;
+      recorder_params.drop_when_full = params_.drop_graph_updates_when_full;
+      graph_recorder_ = std::make_unique<bs_common::GraphRecorder>(
+          graph_path, recorder_params);
     }
 
     if (params_.save_scan_registration_results) {
@@ -98,22 +143,69 @@ void LidarOdometry::onInit() {
         std::filesystem::remove_all(marginalized_scans_path_);
       }
       std::filesystem::create_directory(marginalized_scans_path_);
+      bs_common::AsyncWriter::Params writer_params;
+      writer_params.queue_size = params_.output_queue_size;
+      writer_params.num_threads = params_.output_writer_threads;
+      writer_params.sync_batch_size = params_.output_sync_batch_size;
+      writer_params.policy = params_.drop_marginalized_scans_when_full
+                                 ? bs_common::AsyncWriter::Policy::DROP
+                                 : bs_common::AsyncWriter::Policy::BLOCK;
+      marginalized_scans_writer_ = std::make_unique<bs_common::AsyncWriter>(
+          marginalized_scans_path_, writer_params);
     }
   }
+
+  // packing the slam chunks is the costly part of outputting scans, it is done
+  // on a single thread so the global mapper receives them in order
+  if (params_.output_loam_points || params_.output_lidar_points) {
+    bs_common::AsyncWriter::Params writer_params;
+    writer_params.queue_size = params_.output_queue_size;
+    writer_params.num_threads = 1;
+    results_writer_ =
+        std::make_unique<bs_common::AsyncWriter>("", writer_params);
+  }
 }
 
 void LidarOdometry::onStart() {
   ROS_INFO_STREAM("Starting: " << name());
-  // init frame initializer
-  if (!params_.frame_initializer_config.empty()) {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_start");
+  // init frame initializer, which is kept on fast resets in the same world
+  // frame
+  if (!params_.frame_initializer_config.empty() &&
+      (!frame_initializer_ ||
+       !bs_common::ResetContext::GetInstance().KeepsWorldFrame())) {
     frame_initializer_ = std::make_unique<bs_models::FrameInitializer>(
         params_.frame_initializer_config);
   }
 
-  subscriber_ = private_node_handle_.subscribe<sensor_msgs::PointCloud2>(
-      ros::names::resolve(params_.input_topic), 10,
-      &ThrottledCallback::callback, &throttled_callback_,
-      ros::TransportHints().tcpNoDelay(false));
+  const std::string input_topic = ros::names::resolve(params_.input_topic);
+  if (params_.lidar_type == LidarType::VELODYNE) {
+    velodyne_subscriber_ = StampedCloudSubscriber<PointXYZIRT>(
+        private_node_handle_, input_topic, 10,
+        [this](const std::shared_ptr<const StampedCloud<PointXYZIRT>>& cloud) {
+          process(cloud);
+        },
+        StampedCloudFromMsg<PointXYZIRT>,
+        ros::TransportHints().tcpNoDelay(false));
+  } else if (params_.lidar_type == LidarType::OUSTER) {
+    ouster_subscriber_ = StampedCloudSubscriber<PointXYZITRRNR>(
+        private_node_handle_, input_topic, 10,
+        [this](
+            const std::shared_ptr<const StampedCloud<PointXYZITRRNR>>& cloud) {
+          process(cloud);
+        },
+        StampedCloudFromMsg<PointXYZITRRNR>,
+        ros::TransportHints().tcpNoDelay(false));
+  } else {
+    ROS_ERROR(
+        "Invalid lidar type param. Lidar type may not be implemented yet.");
+    throw std::runtime_error(
+        "Invalid lidar type param. Lidar type may not be implemented yet.");
+  }
+
+  backpressure_subscriber_ = private_node_handle_.subscribe(
+      "/local_mapper/backpressure", 1, &LidarOdometry::BackpressureCallback,
+      this);
 
   if (params_.output_loam_points || params_.output_lidar_points) {
     results_publisher_ =
@@ -131,48 +223,73 @@ void LidarOdometry::onStart() {
           "/local_mapper/inertial_odometry/trigger", 10);
   reset_publisher_ =
       private_node_handle_.advertise<std_msgs::Empty>("/local_mapper/reset", 1);
+  if (params_.adaptive_scheduling) {
+    scheduler_mode_publisher_ =
+        private_node_handle_.advertise<std_msgs::String>("scheduler_mode", 1,
+                                                         true);
+  }
 
   std::string baselink_frame = extrinsics_.GetBaselinkFrameId();
-  std::string lidar_frame = extrinsics_.GetLidarFrameId();
   bs_variables::Position3D p_tmp;
-  extrinsics_position_uuid_ =
-      fuse_core::uuid::generate(p_tmp.type(), baselink_frame + lidar_frame);
+  extrinsics_position_uuid_ = fuse_core::uuid::generate(
+      p_tmp.type(), baselink_frame + lidar_frame_id_);
   bs_variables::Orientation3D o_tmp;
-  extrinsics_orientation_uuid_ =
-      fuse_core::uuid::generate(o_tmp.type(), baselink_frame + lidar_frame);
+  extrinsics_orientation_uuid_ = fuse_core::uuid::generate(
+      o_tmp.type(), baselink_frame + lidar_frame_id_);
 }
 
 void LidarOdometry::onStop() {
   ROS_INFO_STREAM("Stopping: " << name());
+  if (graph_update_lane_) { graph_update_lane_->Clear(); }
+  if (frame_initializer_) { frame_initializer_->CancelWakeup(); }
+  {
+    std::lock_guard<std::mutex> lock(scan_buffer_mutex_);
+    WaitForRegistration();
+    scan_buffer_.clear();
+  }
+
   // if output set, save scans before stopping
   ROS_INFO("LidarOdometry stopped, processing remaining scans in window.");
-  for (auto iter = active_clouds_.begin(); iter != active_clouds_.end();
-       iter++) {
-    PublishMarginalizedScanPose(*iter);
-    if (params_.save_marginalized_scans) {
-      (*iter)->SaveCloud(marginalized_scans_path_);
-    }
+  for (const auto& scan_pose : active_clouds_) {
+    OutputMarginalizedScanPose(scan_pose);
   }
-  active_clouds_.clear();
-  subscriber_.shutdown();
+  active_clouds_.Clear();
+  UpdateActiveCloudsMemory();
+  if (results_writer_) { results_writer_->Flush(); }
+  if (marginalized_scans_writer_) { marginalized_scans_writer_->Flush(); }
+  if (graph_updates_writer_) { graph_updates_writer_->Flush(); }
+  if (graph_recorder_) { graph_recorder_->Flush(); }
+  velodyne_subscriber_.Shutdown();
+  ouster_subscriber_.Shutdown();
+  backpressure_subscriber_.shutdown();
+  backpressure_ = false;
   updates_ = 0;
   T_World_BaselinkLast_ = Eigen::Matrix4d::Identity();
   last_map_update_time_ = ros::Time(0);
   last_scan_pose_time_ = ros::Time(0);
-  RegistrationMap& map = RegistrationMap::GetInstance();
-  map.Clear();
+  scheduler_mode_ = SchedulerMode::FULL;
+  registration_time_avg_ = 0;
+  scan_period_avg_ = 0;
+  last_buffered_scan_stamp_ = ros::Time(0);
+  if (registration_map_) { registration_map_->Clear(); }
   skipped_scans_in_a_row_ = 0;
   resetting_ = false;
 }
 
 void LidarOdometry::SetupRegistration() {
+  registration_map_ =
+      RegistrationMap::GetNamedInstance(params_.registration_map_name);
+
   // setup registration
   beam_matching::MatcherType matcher_type;
   if (!params_.matcher_config.empty()) {
     const auto& reg_filepath = params_.registration_config;
     const auto& matcher_filepath = params_.matcher_config;
     scan_registration_ = ScanRegistrationBase::Create(
-        reg_filepath, matcher_filepath, registration_results_path_, 1e-5);
+        reg_filepath, matcher_filepath, registration_results_path_, 1e-5,
+        registration_map_);
+    scan_registration_->SetLidarFrameId(lidar_frame_id_);
+    scan_registration_->SetUsePooledAllocation(params_.use_pooled_allocation);
 
     // setup feature extractor if needed
     matcher_type = beam_matching::GetTypeFromConfig(matcher_filepath);
@@ -183,51 +300,119 @@ void LidarOdometry::SetupRegistration() {
           std::make_shared<LoamParams>(matcher_filepath, ceres_config);
       feature_extractor_ =
           std::make_shared<LoamFeatureExtractor>(matcher_params);
+      if (params_.feature_extraction_threads > 1) {
+        ring_feature_extractor_ = std::make_unique<RingFeatureExtractor>(
+            matcher_params, params_.feature_extraction_threads);
+      }
+      LoamFeatureBudget::Params budget_params;
+      budget_params.max_edges = params_.feature_budget_edges;
+      budget_params.max_surfaces = params_.feature_budget_surfaces;
+      budget_params.num_buckets = params_.feature_budget_buckets;
+      feature_budget_ = std::make_unique<LoamFeatureBudget>(budget_params);
+      if (!feature_budget_->Enabled()) { feature_budget_ = nullptr; }
+    }
+  }
+
+  // the beam_matching feature extractor and filters only take pcl point types
+  use_lean_points_ = false;
+  if (params_.lean_points) {
+    if (!FilterPipeline<LidarPoint>::Supports(input_filter_params_)) {
+      ROS_WARN("Input filters other than crop box, voxel and ROR filters do "
+               "not support lean points, not using them");
+    } else if (feature_extractor_ && !ring_feature_extractor_) {
+      ROS_WARN("Lean points require feature_extraction_threads > 1 with the "
+               "loam matcher, not using them");
+    } else {
+      input_filters_lean_ = FilterPipeline<LidarPoint>(input_filter_params_);
+      use_lean_points_ = true;
+    }
+  }
+
+  // localization only, scans are registered against the prior map and the
+  // registration map is not built
+  if (!params_.prior_map_path.empty()) {
+    auto scan_to_map =
+        dynamic_cast<ScanToMapLoamRegistration*>(scan_registration_.get());
+    if (!scan_to_map) {
+      ROS_ERROR("Localizing against a prior map requires SCANTOMAP "
+                "registration with the loam matcher.");
+      throw std::invalid_argument{"invalid registration for prior map"};
     }
+    if (!prior_map_) {
+      PriorRegistrationMap::Params prior_map_params;
+      prior_map_params.tile_radius_m = params_.prior_map_tile_radius_m;
+      prior_map_params.update_distance_m = params_.prior_map_update_distance_m;
+      prior_map_params.downsample_voxel_size =
+          params_.prior_map_downsample_voxel_size;
+      prior_map_params.memory_budget_mb = params_.prior_map_memory_budget_mb;
+      prior_map_ = std::make_shared<PriorRegistrationMap>(
+          params_.prior_map_path, prior_map_params);
+    }
+    scan_to_map->SetPriorMap(prior_map_);
+    ROS_INFO("Localizing against prior map: %s",
+             params_.prior_map_path.c_str());
   }
 
   // set registration map to publish
-  RegistrationMap& map = RegistrationMap::GetInstance();
+  RegistrationMap& map = *registration_map_;
   if (params_.publish_registration_map) {
     map.SetPublishUpdates(true);
+    map.SetMinPublishPeriod(params_.registration_map_publish_period);
     ROS_INFO("Publishing initial lidar_odometry registration map");
     map.Publish();
   }
 
-  // Get last scan pose to initialize with if registration map isn't empty
-  if (!map.Empty()) {
-    // get extrinsics
-    Eigen::Matrix4d T_Lidar_Baselink;
-    if (!extrinsics_.GetT_LIDAR_BASELINK(T_Lidar_Baselink)) {
+  // Get last scan pose to initialize with if registration map isn't empty.
+  // The last scan may be from another lidar if the map is shared
+  if (!map.Empty() && !prior_map_) {
+    last_scan_pose_time_ = map.GetLastCloudPoseStamp();
+    if (!scan_registration_->GetScanBaselinkPose(last_scan_pose_time_,
+                                                 T_World_BaselinkLast_)) {
       ROS_ERROR(
           "Cannot lookup transform from lidar to baselink, not sending reloc "
           "request.");
       throw std::runtime_error{"cannot lookup transform"};
     }
-
-    // get scan pose
-    Eigen::Matrix4d T_MAP_SCAN;
-    ros::Time last_stamp;
-    last_scan_pose_time_ = map.GetLastCloudPoseStamp();
-    map.GetScanPose(last_scan_pose_time_, T_MAP_SCAN);
-
-    T_World_BaselinkLast_ = T_MAP_SCAN * T_Lidar_Baselink;
     last_map_update_time_ = ros::Time::now();
   }
 
   scan_registration_->SetInformationWeight(params_.lidar_information_weight);
 }
 
+void LidarOdometry::graphCallback(fuse_core::Graph::ConstSharedPtr graph) {
+  if (!graph_update_lane_) {
+    fuse_core::AsyncSensorModel::graphCallback(std::move(graph));
+    return;
+  }
+  graph_update_lane_->Push(std::move(graph));
+}
+
 void LidarOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "lidar_odometry/graph_update");
+  bs_common::ScopedTimer timer(metric);
+
+  // the scan callbacks and the registration thread use the active clouds and
+  // the registration map too
+  std::lock_guard<std::mutex> lock(scan_buffer_mutex_);
+  WaitForRegistration();
+
+  // index the graph once, this is shared by all lookups below
+  const bs_common::GraphView graph_view(graph_msg);
+
   if (updates_ == 0) {
     ROS_INFO("received first graph update, initializing registration and "
              "starting lidar odometry");
+    bs_common::ScopedStartupTimer startup_timer(name() +
+                                                "/setup_registration");
     SetupRegistration();
+    startup_timer.Stop();
 
-    const auto timestamps = bs_common::CurrentTimestamps(*graph_msg);
-    for (const auto& t : timestamps) {
-      auto maybe_p = bs_common::GetPosition(*graph_msg, t);
-      auto maybe_o = bs_common::GetOrientation(*graph_msg, t);
+    for (const auto& t : graph_view.Timestamps()) {
+      const auto maybe_p = graph_view.GetPosition(t);
+      const auto maybe_o = graph_view.GetOrientation(t);
       if (maybe_p && maybe_o) {
         Eigen::Matrix4d T_WORLD_BASELINK =
             bs_common::FusePoseToEigenTransform(*maybe_p, *maybe_o);
@@ -243,9 +428,13 @@ void LidarOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) {
   updates_++;
   PublishExtrinsics(graph_msg);
 
-  // update map
-  if (update_registration_map_all_scans_) {
-    scan_registration_->GetMapMutable().UpdateScanPosesFromGraphMsg(graph_msg);
+  // update map, the prior map is fixed when localizing
+  if (prior_map_) {
+    ROS_DEBUG("Prior map tiles: %zu active, %zu MB loaded",
+              prior_map_->ActiveTiles().size(),
+              prior_map_->MemoryUsage() / 1000000);
+  } else if (update_registration_map_all_scans_) {
+    scan_registration_->GetMapMutable().UpdateScanPosesFromGraphMsg(graph_view);
   } else if (update_registration_map_in_batch_) {
     ros::Time now = ros::Time::now();
     if (now >= (last_map_update_time_ + registration_map_batch_update_dur_)) {
@@ -257,47 +446,97 @@ void LidarOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph_msg) {
     }
   }
 
-  // the remainder just publishes and/or saves results.
-  auto i = active_clouds_.begin();
-  while (i != active_clouds_.end()) {
-    std::shared_ptr<ScanPose>& scan_pose = *i;
-    bool update_successful = scan_pose->UpdatePose(graph_msg);
-    if (update_successful) {
-      ++i;
-      continue;
-    }
+  // the remainder just publishes and/or saves results. Scans that have never
+  // been updated are probably just not yet in the window, the others are
+  // output once their variables are marginalized
+  active_clouds_.UpdatePoses(graph_view, marginalized_clouds_);
+  for (const auto& scan_pose : marginalized_clouds_) {
+    OutputMarginalizedScanPose(scan_pose);
+  }
+  marginalized_clouds_.clear();
+  UpdateActiveCloudsMemory();
 
-    // if scan has never been updated, then it is probably just not yet in the
-    // window so do nothing
-    if (scan_pose->Updates() == 0) {
-      ++i;
-      continue;
-    }
+  if (params_.save_graph_updates && !graph_view.Timestamps().empty()) {
+    SaveGraphUpdate(graph_msg, *graph_view.Timestamps().rbegin());
+  }
+}
 
-    // Otherwise, it has probably been marginalized out, so output and remove
-    // from active list
-    PublishMarginalizedScanPose(*i);
-    if (params_.save_marginalized_scans) {
-      scan_pose->SaveCloud(marginalized_scans_path_);
+void LidarOdometry::UpdateActiveCloudsMemory() {
+  static bs_common::MemoryAccount& account =
+      bs_common::MemoryAccounting::GetInstance().GetAccount(
+          "lidar_odometry/active_clouds");
+  auto update = [this]() {
+    uint64_t bytes{0};
+    for (const auto& scan_pose : active_clouds_) {
+      bytes += scan_pose->CloudMemoryUsage();
     }
-    active_clouds_.erase(i++);
+    account.Update(active_clouds_.Size(), bytes);
+  };
+
+  // output the oldest scans early if over budget, keeping the newest scan
+  update();
+  while (account.OverBudget() && active_clouds_.Size() > 1) {
+    const std::shared_ptr<ScanPose> scan_pose = *active_clouds_.begin();
+    active_clouds_.Erase(scan_pose->Stamp());
+    OutputMarginalizedScanPose(scan_pose);
+    update();
   }
+}
 
-  if (params_.save_graph_updates) {
-    std::string update_time =
-        beam::ConvertTimeToDate(std::chrono::system_clock::now());
-    std::string curent_path =
-        beam::CombinePaths(graph_updates_path_,
-                           "U" + std::to_string(updates_) + "_" + update_time);
-    std::filesystem::create_directory(curent_path);
-    for (auto iter = active_clouds_.begin(); iter != active_clouds_.end();
-         iter++) {
-      (*iter)->SaveCloud(curent_path);
-    }
+void LidarOdometry::OutputMarginalizedScanPose(
+    const std::shared_ptr<ScanPose>& scan_pose) {
+  PublishMarginalizedScanPose(scan_pose);
+  if (params_.save_marginalized_scans) { SaveMarginalizedScanPose(scan_pose); }
+}
+
+void LidarOdometry::SaveMarginalizedScanPose(
+    const std::shared_ptr<ScanPose>& scan_pose) {
+  // marginalized scans are no longer updated, so the writer can read them
+  // without copying
+  const std::string& path = marginalized_scans_path_;
+  const bool compress = params_.compress_output_clouds;
+  marginalized_scans_writer_->Enqueue([scan_pose, path, compress]() {
+    scan_pose->SaveCloud(path, true, true, compress);
+  });
+}
+
+void LidarOdometry::SaveGraphUpdate(fuse_core::Graph::ConstSharedPtr graph,
+                                    const ros::Time& stamp) {
+  graph_recorder_->Record(graph, updates_, stamp);
+
+  std::string update_time =
+      beam::ConvertTimeToDate(std::chrono::system_clock::now());
+  std::string curent_path =
+      beam::CombinePaths(graph_updates_path_,
+                         "U" + std::to_string(updates_) + "_" + update_time);
+
+  // active scans keep getting updated, so copy their poses. This does not copy
+  // the clouds, which are shared between copies
+  std::vector<ScanPose> scan_poses;
+  scan_poses.reserve(active_clouds_.Size());
+  for (const auto& scan_pose : active_clouds_) {
+    scan_poses.push_back(*scan_pose);
   }
+
+  const bool compress = params_.compress_output_clouds;
+  graph_updates_writer_->Enqueue(
+      [scan_poses = std::move(scan_poses), curent_path, compress]() {
+        std::filesystem::create_directory(curent_path);
+        for (const auto& scan_pose : scan_poses) {
+          scan_pose.SaveCloud(curent_path, true, true, compress);
+        }
+      });
 }
 
-void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
+template <typename PointT>
+void LidarOdometry::process(
+    const std::shared_ptr<const StampedCloud<PointT>>& cloud) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "lidar_odometry/process");
+  bs_common::ScopedTimer timer(metric);
+
   if (updates_ == 0) {
     ROS_INFO_THROTTLE(
         1, "lidar odometry not yet initialized, waiting on first graph "
@@ -307,8 +546,205 @@ void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
 
   if (resetting_) { return; }
 
-  // buffer the message
-  scan_buffer_.push_back(msg);
+  ScanData scan;
+  if constexpr (std::is_same_v<PointT, PointXYZIRT>) {
+    scan = PrepareScan(*cloud, input_filters_velodyne_);
+  } else {
+    scan = PrepareScan(*cloud, input_filters_ouster_);
+  }
+
+  std::lock_guard<std::mutex> lock(scan_buffer_mutex_);
+  if (registration_pool_ == nullptr) {
+    BufferScan(std::move(scan));
+    ProcessScanBuffer();
+    return;
+  }
+
+  // the buffer is only used by the registration thread until it's done
+  WaitForRegistration();
+  if (resetting_) { return; }
+  BufferScan(std::move(scan));
+  registration_future_ =
+      registration_pool_->Enqueue([this]() { ProcessScanBuffer(); });
+}
+
+void LidarOdometry::RetryScanBuffer() {
+  std::lock_guard<std::mutex> lock(scan_buffer_mutex_);
+  if (registration_pool_ == nullptr) {
+    if (!resetting_) { ProcessScanBuffer(); }
+    return;
+  }
+
+  WaitForRegistration();
+  if (resetting_ || scan_buffer_.empty()) { return; }
+  registration_future_ =
+      registration_pool_->Enqueue([this]() { ProcessScanBuffer(); });
+}
+
+void LidarOdometry::BufferScan(ScanData&& scan) {
+  if (!last_buffered_scan_stamp_.isZero() &&
+      scan.stamp > last_buffered_scan_stamp_) {
+    const double period = (scan.stamp - last_buffered_scan_stamp_).toSec();
+    scan_period_avg_ = scan_period_avg_ == 0
+                           ? period
+                           : (1 - scheduler_smoothing_) * scan_period_avg_ +
+                                 scheduler_smoothing_ * period;
+  }
+  last_buffered_scan_stamp_ = scan.stamp;
+  scan_buffer_.push_back(std::move(scan));
+}
+
+template <typename PointT>
+std::shared_ptr<beam_matching::LoamPointCloud>
+    LidarOdometry::ExtractFeatures(const pcl::PointCloud<PointT>& cloud) {
+  std::shared_ptr<beam_matching::LoamPointCloud> features;
+  if (ring_feature_extractor_ && params_.range_image_columns > 0) {
+    RangeImage range_image(0, params_.range_image_columns);
+    range_image.Fill(cloud);
+    features = std::make_shared<beam_matching::LoamPointCloud>(
+        ring_feature_extractor_->ExtractFeatures(range_image));
+  } else if (ring_feature_extractor_) {
+    features = std::make_shared<beam_matching::LoamPointCloud>(
+        ring_feature_extractor_->ExtractFeatures(cloud));
+  } else if constexpr (!std::is_same_v<PointT, LidarPoint>) {
+    if (feature_extractor_) {
+      features = std::make_shared<beam_matching::LoamPointCloud>(
+          feature_extractor_->ExtractFeatures(cloud));
+    }
+  }
+  if (features && feature_budget_) { feature_budget_->Apply(*features); }
+  return features;
+}
+
+template <typename PointT>
+LidarOdometry::ScanData
+    LidarOdometry::PrepareScan(const StampedCloud<PointT>& cloud,
+                               const FilterPipeline<PointT>& filters) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "lidar_odometry/prepare_scan");
+  bs_common::ScopedTimer timer(metric);
+
+  ScanData scan;
+  scan.stamp = cloud.stamp;
+  scan.receive_time = ros::WallTime::now();
+  if (!use_lean_points_) {
+    FilterScan(cloud.cloud, filters, scan);
+    return scan;
+  }
+
+  // the lean cloud is projected first so that all passes read less memory
+  auto& lean_pool = bs_common::CloudBufferPool<LidarPoint>::Get();
+  pcl::PointCloud<LidarPoint> lean_cloud;
+  lean_pool.Acquire(lean_cloud, cloud.cloud.size());
+  ToLidarPoints(cloud.cloud, lean_cloud);
+  FilterScan(lean_cloud, input_filters_lean_, scan);
+  lean_pool.Release(lean_cloud);
+  return scan;
+}
+
+template <typename PointT>
+void LidarOdometry::FilterScan(const pcl::PointCloud<PointT>& cloud,
+                               const FilterPipeline<PointT>& filters,
+                               ScanData& scan) {
+  // the clouds reuse the storage of previous scans, the scan cloud goes back
+  // to the pool once the last copy of its scan pose is gone
+  auto& filtered_pool = bs_common::CloudBufferPool<PointT>::Get();
+  pcl::PointCloud<PointT> cloud_filtered;
+  filtered_pool.Acquire(cloud_filtered, cloud.size());
+  filters.Filter(cloud, cloud_filtered);
+  auto& scan_pool = bs_common::CloudBufferPool<pcl::PointXYZ>::Get();
+  PointCloud scan_cloud;
+  scan_pool.Acquire(scan_cloud, cloud_filtered.size());
+  for (const auto& p : cloud_filtered) {
+    scan_cloud.push_back(pcl::PointXYZ(p.x, p.y, p.z));
+  }
+  scan.cloud = scan_pool.Share(scan_cloud);
+  scan.loam_cloud = ExtractFeatures(cloud_filtered);
+  filtered_pool.Release(cloud_filtered);
+}
+
+void LidarOdometry::WaitForRegistration() {
+  if (registration_future_.valid()) { registration_future_.get(); }
+}
+
+void LidarOdometry::UpdateSchedulerMode() {
+  if (!params_.adaptive_scheduling) { return; }
+
+  const double load =
+      scan_period_avg_ > 0 ? registration_time_avg_ / scan_period_avg_ : 0;
+  SchedulerMode mode = scheduler_mode_;
+  if (scan_buffer_.size() >= max_scan_buffer_size_) {
+    mode = SchedulerMode::SKIPPING;
+  } else if (scan_buffer_.size() > 1 || load > params_.scheduler_max_load) {
+    mode = SchedulerMode::TRACKING;
+  } else if (load < scheduler_hysteresis_ * params_.scheduler_max_load) {
+    mode = SchedulerMode::FULL;
+  } else if (mode == SchedulerMode::SKIPPING) {
+    mode = SchedulerMode::TRACKING;
+  }
+  if (mode == scheduler_mode_) { return; }
+
+  scheduler_mode_ = mode;
+  std_msgs::String msg;
+  if (mode == SchedulerMode::FULL) {
+    msg.data = "FULL";
+  } else if (mode == SchedulerMode::TRACKING) {
+    msg.data = "TRACKING";
+  } else {
+    msg.data = "SKIPPING";
+  }
+  scheduler_mode_publisher_.publish(msg);
+  ROS_INFO_STREAM(name() << ": scheduler mode set to " << msg.data
+                         << " (load: " << load
+                         << ", buffered scans: " << scan_buffer_.size() << ")");
+}
+
+bool LidarOdometry::IsKeyframe(
+    const Eigen::Matrix4d& T_World_BaselinkInit) const {
+  // without a frame initializer there is no motion estimate
+  if (frame_initializer_ == nullptr) { return true; }
+
+  const Eigen::Matrix4d T_BaselinkLast_BaselinkCurrent =
+      beam::InvertTransform(T_World_BaselinkLast_) * T_World_BaselinkInit;
+  const double translation =
+      T_BaselinkLast_BaselinkCurrent.block(0, 3, 3, 1).norm();
+  Eigen::Matrix3d R = T_BaselinkLast_BaselinkCurrent.block(0, 0, 3, 3);
+  const double rotation_deg =
+      beam::Rad2Deg(Eigen::AngleAxis<double>(R).angle());
+  return translation >= params_.keyframe_min_translation_m ||
+         rotation_deg >= params_.keyframe_min_rotation_deg;
+}
+
+void LidarOdometry::PublishTrackedScan(
+    const ros::Time& stamp, const Eigen::Matrix4d& T_World_BaselinkInit) {
+  // absolute initializer poses drift from the registered ones, only the
+  // initializer motion since the last registered scan is used
+  Eigen::Matrix4d T_World_BaselinkTracked = T_World_BaselinkInit;
+  Eigen::Matrix4d T_BaselinkLast_BaselinkCurrent;
+  if (!use_frame_init_relative_ &&
+      frame_initializer_->GetRelativePose(T_BaselinkLast_BaselinkCurrent,
+                                          last_scan_pose_time_, stamp)) {
+    T_World_BaselinkTracked =
+        T_World_BaselinkLast_ * T_BaselinkLast_BaselinkCurrent;
+  }
+
+  nav_msgs::Odometry odom_msg;
+  bs_common::EigenTransformToOdometryMsg(
+      T_World_BaselinkTracked, stamp, odom_publisher_counter_,
+      extrinsics_.GetWorldFrameId(), extrinsics_.GetBaselinkFrameId(),
+      odom_msg);
+  odom_publisher_.publish(odom_msg);
+  odom_publisher_counter_++;
+  PublishTfTransform(T_World_BaselinkTracked, "lidar_world",
+                     extrinsics_.GetBaselinkFrameId(), stamp);
+}
+
+void LidarOdometry::ProcessScanBuffer() {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "lidar_odometry/register_scans");
+  bs_common::ScopedTimer timer(metric);
 
   while (!scan_buffer_.empty() && scan_buffer_.size() > max_scan_buffer_size_) {
     ROS_WARN("Lidar buffer size exceeded max of %d, removing last scan",
@@ -317,16 +753,27 @@ void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
   }
 
   while (!scan_buffer_.empty()) {
-    const auto current_msg = scan_buffer_.front();
+    ScanData& current_scan = scan_buffer_.front();
 
     // ensure monotonically increasing data
-    if (current_msg->header.stamp <= last_scan_pose_time_) {
+    if (current_scan.stamp <= last_scan_pose_time_) {
       ROS_WARN(
           "detected non-monotonically increasing lidar stamp, skipping scan");
       scan_buffer_.pop_front();
       break;
     }
 
+    // reduce the keyframe rate while the optimizer is falling behind
+    if (backpressure_ && (current_scan.stamp - last_scan_pose_time_).toSec() <
+                             params_.backpressure_min_scan_period) {
+      static bs_common::Metric& dropped_metric =
+          bs_common::Instrumentation::GetInstance().GetMetric(
+              "lidar_odometry/backpressure_dropped_scans");
+      dropped_metric.Increment();
+      scan_buffer_.pop_front();
+      continue;
+    }
+
     Eigen::Matrix4d T_World_BaselinkInit;
     bool init_successful{true};
     std::string error_msg;
@@ -337,71 +784,95 @@ void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
       Eigen::Matrix4d T_BaselinkLast_BaselinkCurrent;
       init_successful = frame_initializer_->GetRelativePose(
           T_BaselinkLast_BaselinkCurrent, last_scan_pose_time_,
-          current_msg->header.stamp, error_msg);
+          current_scan.stamp, error_msg);
       T_World_BaselinkInit =
           T_World_BaselinkLast_ * T_BaselinkLast_BaselinkCurrent;
     } else {
       init_successful = frame_initializer_->GetPose(
-          T_World_BaselinkInit, current_msg->header.stamp,
+          T_World_BaselinkInit, current_scan.stamp,
           extrinsics_.GetBaselinkFrameId(), error_msg);
     }
 
     if (!init_successful) {
       ROS_DEBUG("Could not initialize frame, buffering scan. Reason: %s",
                 error_msg.c_str());
+      // retry as soon as the odometry reaches the scan instead of on the next
+      // scan
+      if (current_scan.stamp > frame_initializer_->OdometryEndTime()) {
+        frame_initializer_->WakeWhenAvailable(
+            current_scan.stamp, private_node_handle_.getCallbackQueue(),
+            [this]() { RetryScanBuffer(); });
+      }
       break;
     }
+
+    // only register keyframes while registration can't keep up
+    UpdateSchedulerMode();
+    if (scheduler_mode_ != SchedulerMode::FULL &&
+        !IsKeyframe(T_World_BaselinkInit)) {
+      if (scheduler_mode_ == SchedulerMode::TRACKING) {
+        static bs_common::Metric& tracked_metric =
+            bs_common::Instrumentation::GetInstance().GetMetric(
+                "lidar_odometry/scheduler_tracked_scans");
+        tracked_metric.Increment();
+        PublishTrackedScan(current_scan.stamp, T_World_BaselinkInit);
+      } else {
+        static bs_common::Metric& skipped_metric =
+            bs_common::Instrumentation::GetInstance().GetMetric(
+                "lidar_odometry/scheduler_skipped_scans");
+        skipped_metric.Increment();
+      }
+      scan_buffer_.pop_front();
+      continue;
+    }
     Eigen::Matrix4d T_Baselink_Lidar;
-    if (!extrinsics_.GetT_BASELINK_LIDAR(T_Baselink_Lidar, ros::Time::now())) {
+    if (!extrinsics_.GetT_BASELINK_SENSOR(T_Baselink_Lidar, lidar_frame_id_,
+                                          ros::Time::now())) {
       ROS_ERROR("Cannot get transform from lidar to baselink for stamp: %.8f. "
                 "Buffering scan.",
-                current_msg->header.stamp.toSec());
+                current_scan.stamp.toSec());
       break;
     }
 
-    std::shared_ptr<ScanPose> current_scan_pose;
-    if (params_.lidar_type == LidarType::VELODYNE) {
-      pcl::PointCloud<PointXYZIRT> cloud_current_unfiltered;
-      beam::ROSToPCL(cloud_current_unfiltered, *msg);
-      pcl::PointCloud<PointXYZIRT> cloud_filtered =
-          beam_filtering::FilterPointCloud<PointXYZIRT>(
-              cloud_current_unfiltered, input_filter_params_);
-      current_scan_pose = std::make_shared<ScanPose>(
-          cloud_filtered, current_msg->header.stamp, T_World_BaselinkInit,
-          T_Baselink_Lidar, feature_extractor_);
-    } else if (params_.lidar_type == LidarType::OUSTER) {
-      pcl::PointCloud<PointXYZITRRNR> cloud_current_unfiltered;
-      beam::ROSToPCL(cloud_current_unfiltered, *msg);
-      pcl::PointCloud<PointXYZITRRNR> cloud_filtered =
-          beam_filtering::FilterPointCloud(cloud_current_unfiltered,
-                                           input_filter_params_);
-      current_scan_pose = std::make_shared<ScanPose>(
-          cloud_filtered, current_msg->header.stamp, T_World_BaselinkInit,
-          T_Baselink_Lidar, feature_extractor_);
-    } else {
-      ROS_ERROR(
-          "Invalid lidar type param. Lidar type may not be implemented yet.");
-      throw std::runtime_error(
-          "Invalid lidar type param. Lidar type may not be implemented yet.");
+    auto current_scan_pose = std::make_shared<ScanPose>(
+        current_scan.stamp, T_World_BaselinkInit, T_Baselink_Lidar);
+    // the scan is popped from the buffer once it is registered, so its clouds
+    // can be handed over to the scan pose
+    current_scan_pose->AddPointCloud(current_scan.cloud, true);
+    if (current_scan.loam_cloud) {
+      current_scan_pose->AddPointCloud(std::move(*current_scan.loam_cloud),
+                                       true);
     }
 
     Eigen::Matrix4d T_World_BaselinkCurrent;
     fuse_core::Transaction::SharedPtr transaction;
-    if (log_registration_time_) { timer_.restart(); }
+    // the time from receiving to registering the scan includes preparing it
+    // and waiting in the buffer for the frame initializer
+    bs_common::ScopedTrace trace("lidar_odometry", current_scan.stamp,
+                                 current_scan.receive_time);
+    timer_.restart();
     transaction = scan_registration_->RegisterNewScan(*current_scan_pose)
                       .GetTransaction();
+    const double registration_time = timer_.elapsed();
     if (log_registration_time_) {
-      BEAM_INFO("Registration time: {}s", timer_.elapsed());
+      BEAM_INFO("Registration time: {}s", registration_time);
     }
+    registration_time_avg_ =
+        registration_time_avg_ == 0
+            ? registration_time
+            : (1 - scheduler_smoothing_) * registration_time_avg_ +
+                  scheduler_smoothing_ * registration_time;
     Eigen::Matrix4d T_WORLD_LIDAR;
 
-    scan_registration_->GetMap().GetScanPose(current_scan_pose->Stamp(),
-                                             T_WORLD_LIDAR);
+    scan_registration_->GetRegisteredScanPose(current_scan_pose->Stamp(),
+                                              T_WORLD_LIDAR);
 
-    T_World_BaselinkCurrent = T_WORLD_LIDAR * T_Baselink_Lidar;
+    T_World_BaselinkCurrent =
+        T_WORLD_LIDAR * current_scan_pose->T_LIDAR_BASELINK();
 
     if (transaction == nullptr) {
       ROS_WARN("No transaction generated, skipping scan.");
+      trace.Cancel();
       scan_buffer_.pop_front();
       skipped_scans_in_a_row_++;
       if (skipped_scans_in_a_row_ >= 10) {
@@ -416,6 +887,7 @@ void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
     }
     skipped_scans_in_a_row_ = 0;
     sendTransaction(transaction);
+    trace.Stop();
 
     // add priors from initializer
     fuse_core::Transaction::SharedPtr prior_transaction;
@@ -448,7 +920,8 @@ void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
       imu_constraint_trigger_counter_++;
     }
 
-    active_clouds_.push_back(current_scan_pose);
+    active_clouds_.Insert(current_scan_pose);
+    UpdateActiveCloudsMemory();
 
     // publish odom
     nav_msgs::Odometry odom_msg;
@@ -470,6 +943,12 @@ void LidarOdometry::process(const sensor_msgs::PointCloud2::ConstPtr& msg) {
   }
 }
 
+void LidarOdometry::BackpressureCallback(const std_msgs::Bool::ConstPtr& msg) {
+  if (backpressure_.exchange(msg->data) == msg->data) { return; }
+  ROS_INFO_STREAM(name() << ": optimizer back-pressure "
+                         << (msg->data ? "on" : "off"));
+}
+
 void LidarOdometry::PublishMarginalizedScanPose(
     const std::shared_ptr<ScanPose>& scan_pose) {
   nav_msgs::Odometry odom_msg;
@@ -480,17 +959,55 @@ void LidarOdometry::PublishMarginalizedScanPose(
   odom_publisher_marginalized_.publish(odom_msg);
   odom_publisher_marginalized_counter_++;
 
-  if (!params_.output_loam_points && !params_.output_lidar_points) { return; }
+  // marginalized scans are no longer updated, so the writer can read their
+  // clouds without copying
+  if (!results_writer_) { return; }
+  const Eigen::Matrix4d T_WORLD_BASELINK = scan_pose->T_REFFRAME_BASELINK();
+  results_writer_->Enqueue([this, scan_pose, T_WORLD_BASELINK]() {
+    PublishSlamChunk(scan_pose, T_WORLD_BASELINK);
+  });
+}
 
-  // output to global mapper
-  bs_common::SlamChunkMsg slam_chunk_msg;
+void LidarOdometry::PublishSlamChunk(
+    const std::shared_ptr<ScanPose>& scan_pose,
+    const Eigen::Matrix4d& T_WORLD_BASELINK) {
+  // output to global mapper. This is published as a shared pointer so that
+  // subscribers in the same process receive it without serialization
+  bs_common::SlamChunkMsg::Ptr slam_chunk_msg =
+      boost::make_shared<bs_common::SlamChunkMsg>();
   static uint64_t seq = 0;
   geometry_msgs::PoseStamped pose_stamped;
-  bs_common::EigenTransformToPoseStamped(
-      scan_pose->T_REFFRAME_BASELINK(), scan_pose->Stamp(), seq++,
-      extrinsics_.GetLidarFrameId(), pose_stamped);
-  slam_chunk_msg.T_WORLD_BASELINK = pose_stamped;
-  slam_chunk_msg.lidar_measurement.frame_id = extrinsics_.GetLidarFrameId();
+  bs_common::EigenTransformToPoseStamped(T_WORLD_BASELINK, scan_pose->Stamp(),
+                                         seq++, lidar_frame_id_, pose_stamped);
+  slam_chunk_msg->T_WORLD_BASELINK = pose_stamped;
+  bs_common::LidarMeasurementMsg& lidar_measurement =
+      slam_chunk_msg->lidar_measurement;
+  lidar_measurement.frame_id = lidar_frame_id_;
+  lidar_measurement.packed = params_.pack_output_points;
+
+  const beam_matching::LoamPointCloud& loam_cloud = scan_pose->LoamCloud();
+  if (params_.pack_output_points) {
+    if (params_.output_lidar_points) {
+      bs_common::PCLToPackedXYZMsg(scan_pose->Cloud(),
+                                   lidar_measurement.lidar_points_packed);
+    }
+    if (params_.output_loam_points) {
+      bs_common::PCLToPackedXYZMsg(
+          loam_cloud.edges.strong.cloud,
+          lidar_measurement.lidar_edges_strong_packed);
+      bs_common::PCLToPackedXYZMsg(loam_cloud.edges.weak.cloud,
+                                   lidar_measurement.lidar_edges_weak_packed);
+      bs_common::PCLToPackedXYZMsg(
+          loam_cloud.surfaces.strong.cloud,
+          lidar_measurement.lidar_surfaces_strong_packed);
+      bs_common::PCLToPackedXYZMsg(
+          loam_cloud.surfaces.weak.cloud,
+          lidar_measurement.lidar_surfaces_weak_packed);
+    }
+    ROS_DEBUG("Publishing slam chunk msg");
+    results_publisher_.publish(slam_chunk_msg);
+    return;
+  }
 
   if (params_.output_lidar_points) {
     // add regular points
@@ -500,12 +1017,11 @@ void LidarOdometry::PublishMarginalizedScanPose(
       point.x = p.x;
       point.y = p.y;
       point.z = p.z;
-      slam_chunk_msg.lidar_measurement.lidar_points.push_back(point);
+      lidar_measurement.lidar_points.push_back(point);
     }
   }
 
   // if loam cloud not to be outputted, or empty, publish current msg
-  const beam_matching::LoamPointCloud& loam_cloud = scan_pose->LoamCloud();
   if (params_.output_loam_points) {
     // add strong edges
     for (const auto& p : loam_cloud.edges.strong.cloud) {
@@ -513,7 +1029,7 @@ void LidarOdometry::PublishMarginalizedScanPose(
       point.x = p.x;
       point.y = p.y;
       point.z = p.z;
-      slam_chunk_msg.lidar_measurement.lidar_edges_strong.push_back(point);
+      lidar_measurement.lidar_edges_strong.push_back(point);
     }
 
     // add weak edges
@@ -522,7 +1038,7 @@ void LidarOdometry::PublishMarginalizedScanPose(
       point.x = p.x;
       point.y = p.y;
       point.z = p.z;
-      slam_chunk_msg.lidar_measurement.lidar_edges_weak.push_back(point);
+      lidar_measurement.lidar_edges_weak.push_back(point);
     }
 
     // add strong surfaces
@@ -531,7 +1047,7 @@ void LidarOdometry::PublishMarginalizedScanPose(
       point.x = p.x;
       point.y = p.y;
       point.z = p.z;
-      slam_chunk_msg.lidar_measurement.lidar_surfaces_strong.push_back(point);
+      lidar_measurement.lidar_surfaces_strong.push_back(point);
     }
 
     // add weak surfaces
@@ -540,7 +1056,7 @@ void LidarOdometry::PublishMarginalizedScanPose(
       point.x = p.x;
       point.y = p.y;
       point.z = p.z;
-      slam_chunk_msg.lidar_measurement.lidar_surfaces_weak.push_back(point);
+      lidar_measurement.lidar_surfaces_weak.push_back(point);
     }
   }
 
@@ -566,11 +1082,12 @@ void LidarOdometry::PublishTfTransform(const Eigen::Matrix4d& T_Child_Parent,
 
 void LidarOdometry::PublishExtrinsics(
     fuse_core::Graph::ConstSharedPtr graph_msg) {
-  if (!publish_extrinsics_) { return; }
-  const auto var_range = graph_msg->getVariables();
+  if (!publish_extrinsics_ && extrinsics_.IsStatic()) { return; }
   if (!graph_msg->variableExists(extrinsics_position_uuid_) ||
       !graph_msg->variableExists(extrinsics_orientation_uuid_)) {
-    ROS_WARN_THROTTLE(5, "No extrinsics variables found for Lidar.");
+    if (publish_extrinsics_) {
+      ROS_WARN_THROTTLE(5, "No extrinsics variables found for Lidar.");
+    }
     return;
   }
 
@@ -579,13 +1096,23 @@ void LidarOdometry::PublishExtrinsics(
   auto o = dynamic_cast<const bs_variables::Orientation3D&>(
       graph_msg->getVariable(extrinsics_orientation_uuid_));
 
+  // feed the estimate straight to the extrinsics cache so that models looking
+  // up dynamic extrinsics don't need to poll tf
+  const ros::Time stamp = ros::Time::now();
+  Eigen::Matrix4d T_LIDAR_BASELINK;
+  beam::QuaternionAndTranslationToTransformMatrix(
+      Eigen::Quaterniond(o.w(), o.x(), o.y(), o.z()),
+      Eigen::Vector3d(p.x(), p.y(), p.z()), T_LIDAR_BASELINK);
+  extrinsics_.AddT_BASELINK_SENSOR(beam::InvertTransform(T_LIDAR_BASELINK),
+                                   lidar_frame_id_, stamp);
+
+  if (!publish_extrinsics_) { return; }
   tf::Transform transform;
   transform.setOrigin(tf::Vector3(p.x(), p.y(), p.z()));
   tf::Quaternion q(o.x(), o.y(), o.z(), o.w());
   transform.setRotation(q);
   tf_broadcaster_.sendTransform(tf::StampedTransform(
-      transform, ros::Time::now(), extrinsics_.GetLidarFrameId(),
-      extrinsics_.GetBaselinkFrameId()));
+      transform, stamp, lidar_frame_id_, extrinsics_.GetBaselinkFrameId()));
 }
 
 } // namespace bs_models
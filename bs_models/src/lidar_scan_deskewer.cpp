@@ -1,10 +1,12 @@
 #include <bs_models/lidar_scan_deskewer.h>
 
-#include <pcl/common/transforms.h>
 #include <pluginlib/class_list_macros.h>
 
 #include <beam_utils/se3.h>
 
+#include <bs_common/instrumentation.h>
+#include <bs_common/latency_tracer.h>
+
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::LidarScanDeskewer, fuse_core::SensorModel)
 
@@ -19,6 +21,8 @@ void LidarScanDeskewer::onInit() {
   ROS_DEBUG("Initialzing LidarScanDeskewer");
   params_.loadFromROS(private_node_handle_);
   ROS_DEBUG("Loaded params");
+  lidar_frame_id_ = params_.lidar_frame.empty() ? extrinsics_.GetLidarFrameId()
+                                                : params_.lidar_frame;
 
   frame_initializer_ =
       std::make_unique<bs_models::FrameInitializer>(
@@ -34,31 +38,53 @@ void LidarScanDeskewer::onStart() {
           &throttled_callback_pc_, ros::TransportHints().tcpNoDelay(false));
 
   ROS_DEBUG("Starting publisher");
-  pointcloud_publisher_ =
-      private_node_handle_.advertise<sensor_msgs::PointCloud2>(
-          "points_undistorted", pointcloud_publisher_queue_size_);
+  if (params_.lidar_type == LidarType::VELODYNE) {
+    velodyne_publisher_ = StampedCloudPublisher<PointXYZIRT>(
+        private_node_handle_, "points_undistorted",
+        pointcloud_publisher_queue_size_, StampedCloudToMsg<PointXYZIRT>);
+  } else if (params_.lidar_type == LidarType::OUSTER) {
+    ouster_publisher_ = StampedCloudPublisher<PointXYZITRRNR>(
+        private_node_handle_, "points_undistorted",
+        pointcloud_publisher_queue_size_, StampedCloudToMsg<PointXYZITRRNR>);
+  }
   ROS_DEBUG("Done start routine");
 }
 
 void LidarScanDeskewer::onStop() {
   ROS_DEBUG("Shutting down publishers and subscribers");
   pointcloud_subscriber_.shutdown();
+  frame_initializer_->CancelWakeup();
+  velodyne_publisher_.Shutdown();
+  ouster_publisher_.Shutdown();
   ROS_DEBUG("Done shutdown routine");
 }
 
 void LidarScanDeskewer::ProcessPointcloud(
     const sensor_msgs::PointCloud2::ConstPtr& msg) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "lidar_scan_deskewer/process");
+  bs_common::ScopedTimer timer(metric);
+
   if (params_.lidar_type == LidarType::VELODYNE) {
     ROS_DEBUG("Processing Velodyne poincloud message");
-    pcl::PointCloud<PointXYZIRT> cloud;
-    beam::ROSToPCL(cloud, *msg);
-    queue_velodyne_.emplace(VelodyneCloudWithStamp{msg->header.stamp, cloud});
+    // the cloud is filled in place, moving it would copy it
+    VelodyneCloudWithStamp& queued = queue_velodyne_.emplace();
+    queued.stamp = msg->header.stamp;
+    queued.receive_time = ros::WallTime::now();
+    bs_common::CloudBufferPool<PointXYZIRT>::Get().Acquire(queued.cloud,
+                                                   msg->width * msg->height);
+    beam::ROSToPCL(queued.cloud, *msg);
     DeskewAndPublishVelodyneQueue();
   } else if (params_.lidar_type == LidarType::OUSTER) {
     ROS_DEBUG("Processing Ouster poincloud message");
-    pcl::PointCloud<PointXYZITRRNR> cloud;
-    beam::ROSToPCL(cloud, *msg);
-    queue_ouster_.emplace(OusterCloudWithStamp{msg->header.stamp, cloud});
+    // the cloud is filled in place, moving it would copy it
+    OusterCloudWithStamp& queued = queue_ouster_.emplace();
+    queued.stamp = msg->header.stamp;
+    queued.receive_time = ros::WallTime::now();
+    bs_common::CloudBufferPool<PointXYZITRRNR>::Get().Acquire(queued.cloud,
+                                                   msg->width * msg->height);
+    beam::ROSToPCL(queued.cloud, *msg);
     DeskewAndPublishOusterQueue();
   } else {
     throw std::runtime_error{
@@ -68,86 +94,152 @@ void LidarScanDeskewer::ProcessPointcloud(
 
 void LidarScanDeskewer::DeskewAndPublishVelodyneQueue() {
   while (!queue_velodyne_.empty()) {
-    const ros::Time& cloud_stamp = queue_velodyne_.front().first;
-    const pcl::PointCloud<PointXYZIRT>& cloud = queue_velodyne_.front().second;
-
-    // get pose of the cloud stamp (this may or may not be the first point)
-    Eigen::Matrix4d T_World_Lidar0;
-    if (!frame_initializer_->GetPose(T_World_Lidar0, cloud_stamp,
-                                     extrinsics_.GetLidarFrameId())) {
+    const ros::Time& cloud_stamp = queue_velodyne_.front().stamp;
+    const pcl::PointCloud<PointXYZIRT>& cloud = queue_velodyne_.front().cloud;
+    bs_common::ScopedTrace trace("lidar_scan_deskewer", cloud_stamp,
+                                 queue_velodyne_.front().receive_time);
+
+    auto cloud_deskewed = MakePooledStampedCloud<PointXYZIRT>(cloud.size());
+    ros::Time end_time;
+    if (!DeskewCloud<PointXYZIRT>(cloud_stamp, cloud, cloud_deskewed->cloud,
+                                  end_time)) {
+      trace.Cancel();
+      WakeWhenAvailable(end_time);
       break;
     }
-    Eigen::Matrix4f T_Lidar0_World =
-        beam::InvertTransform(T_World_Lidar0).cast<float>();
-
-    pcl::PointCloud<PointXYZIRT> cloud_deskewed;
-    for (const auto& p : cloud) {
-      ros::Time pt = cloud_stamp + ros::Duration(p.time);
-      Eigen::Matrix4d T_World_LidarN;
-      if (!frame_initializer_->GetPose(T_World_LidarN, pt,
-                                       extrinsics_.GetLidarFrameId())) {
-        // if any point doesn't return a valid result, then skip
-        break;
-      }
-      Eigen::Affine3f T_Lidar0_LidarN(T_Lidar0_World *
-                                      T_World_LidarN.cast<float>());
-      PointXYZIRT p_deskewed =
-          pcl::transformPoint<PointXYZIRT>(p, T_Lidar0_LidarN);
-      cloud_deskewed.push_back(p_deskewed);
-    }
 
-    sensor_msgs::PointCloud2 cloud_msg = beam::PCLToROS<PointXYZIRT>(
-        cloud_deskewed, cloud_stamp, extrinsics_.GetLidarFrameId(), counter_++);
-    pointcloud_publisher_.publish(cloud_msg);
-    queue_velodyne_.pop();
+    cloud_deskewed->stamp = cloud_stamp;
+    cloud_deskewed->frame_id = lidar_frame_id_;
+    cloud_deskewed->seq = counter_++;
+    velodyne_publisher_.Publish(cloud_deskewed);
+    trace.Stop();
+    PopCloud(queue_velodyne_);
   }
 
   // clear buffer overflow
   while (queue_velodyne_.size() > params_.scan_buffer_size) {
-    queue_velodyne_.pop();
+    PopCloud(queue_velodyne_);
   }
 }
 
 void LidarScanDeskewer::DeskewAndPublishOusterQueue() {
   while (!queue_ouster_.empty()) {
-    const ros::Time& cloud_stamp = queue_ouster_.front().first;
-    const pcl::PointCloud<PointXYZITRRNR>& cloud = queue_ouster_.front().second;
-
-    // get pose of the cloud stamp (this may or may not be the first point)
-    Eigen::Matrix4d T_World_Lidar0;
-    if (!frame_initializer_->GetPose(T_World_Lidar0, cloud_stamp,
-                                     extrinsics_.GetLidarFrameId())) {
+    const ros::Time& cloud_stamp = queue_ouster_.front().stamp;
+    const pcl::PointCloud<PointXYZITRRNR>& cloud = queue_ouster_.front().cloud;
+    bs_common::ScopedTrace trace("lidar_scan_deskewer", cloud_stamp,
+                                 queue_ouster_.front().receive_time);
+
+    auto cloud_deskewed =
+        MakePooledStampedCloud<PointXYZITRRNR>(cloud.size());
+    ros::Time end_time;
+    if (!DeskewCloud<PointXYZITRRNR>(cloud_stamp, cloud,
+                                     cloud_deskewed->cloud, end_time)) {
+      trace.Cancel();
+      WakeWhenAvailable(end_time);
       break;
     }
-    Eigen::Matrix4f T_Lidar0_World =
-        beam::InvertTransform(T_World_Lidar0).cast<float>();
-
-    pcl::PointCloud<PointXYZITRRNR> cloud_deskewed;
-    for (const auto& p : cloud) {
-      ros::Time pt = cloud_stamp + ros::Duration(p.time);
-      Eigen::Matrix4d T_World_LidarN;
-      if (!frame_initializer_->GetPose(T_World_LidarN, pt,
-                                       extrinsics_.GetLidarFrameId())) {
-        // if any point doesn't return a valid result, then skip
-        break;
-      }
-      Eigen::Affine3f T_Lidar0_LidarN(T_Lidar0_World *
-                                      T_World_LidarN.cast<float>());
-      PointXYZITRRNR p_deskewed =
-          pcl::transformPoint<PointXYZITRRNR>(p, T_Lidar0_LidarN);
-      cloud_deskewed.push_back(p_deskewed);
-    }
 
-    sensor_msgs::PointCloud2 cloud_msg = beam::PCLToROS<PointXYZITRRNR>(
-        cloud_deskewed, cloud_stamp, extrinsics_.GetLidarFrameId(), counter_++);
-    pointcloud_publisher_.publish(cloud_msg);
-    queue_ouster_.pop();
+    cloud_deskewed->stamp = cloud_stamp;
+    cloud_deskewed->frame_id = lidar_frame_id_;
+    cloud_deskewed->seq = counter_++;
+    ouster_publisher_.Publish(cloud_deskewed);
+    trace.Stop();
+    PopCloud(queue_ouster_);
   }
 
   // clear buffer overflow
   while (queue_ouster_.size() > params_.scan_buffer_size) {
-    queue_ouster_.pop();
+    PopCloud(queue_ouster_);
+  }
+}
+
+void LidarScanDeskewer::WakeWhenAvailable(const ros::Time& time) {
+  if (time <= frame_initializer_->OdometryEndTime()) { return; }
+  frame_initializer_->WakeWhenAvailable(
+      time, private_node_handle_.getCallbackQueue(), [this]() {
+        if (params_.lidar_type == LidarType::VELODYNE) {
+          DeskewAndPublishVelodyneQueue();
+        } else if (params_.lidar_type == LidarType::OUSTER) {
+          DeskewAndPublishOusterQueue();
+        }
+      });
+}
+
+template <typename PointT>
+void LidarScanDeskewer::PopCloud(std::queue<CloudWithStamp<PointT>>& queue) {
+  bs_common::CloudBufferPool<PointT>::Get().Release(queue.front().cloud);
+  queue.pop();
+}
+
+template <typename PointT>
+bool LidarScanDeskewer::DeskewCloud(const ros::Time& cloud_stamp,
+                                    const pcl::PointCloud<PointT>& cloud,
+                                    pcl::PointCloud<PointT>& cloud_deskewed,
+                                    ros::Time& end_time) {
+  cloud_deskewed.clear();
+  end_time = cloud_stamp;
+  if (cloud.empty()) { return true; }
+
+  // get time range of the sweep
+  double t_min = static_cast<double>(cloud.points.front().time);
+  double t_max = t_min;
+  for (const auto& p : cloud) {
+    t_min = std::min(t_min, static_cast<double>(p.time));
+    t_max = std::max(t_max, static_cast<double>(p.time));
+  }
+  end_time = std::max(cloud_stamp, cloud_stamp + ros::Duration(t_max));
+
+  // get pose of the cloud stamp (this may or may not be the first point)
+  Eigen::Matrix4d T_World_Lidar0;
+  if (!frame_initializer_->GetPose(T_World_Lidar0, cloud_stamp,
+                                   lidar_frame_id_)) {
+    return false;
+  }
+  const Eigen::Matrix4d T_Lidar0_World = beam::InvertTransform(T_World_Lidar0);
+
+  // sample the trajectory at each knot
+  const int num_knots = params_.num_pose_knots;
+  const double dt = std::max((t_max - t_min) / (num_knots - 1), 1e-9);
+  std::vector<Eigen::Quaternionf, Eigen::aligned_allocator<Eigen::Quaternionf>>
+      q_Lidar0_LidarK(num_knots);
+  std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f>>
+      t_Lidar0_LidarK(num_knots);
+  std::vector<ros::Time> knot_stamps(num_knots);
+  for (int k = 0; k < num_knots; k++) {
+    knot_stamps[k] = cloud_stamp + ros::Duration(t_min + k * dt);
+  }
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_World_LidarK;
+  if (!frame_initializer_->GetPoses(Ts_World_LidarK, knot_stamps,
+                                    lidar_frame_id_)) {
+    return false;
+  }
+  for (int k = 0; k < num_knots; k++) {
+    const Eigen::Matrix4d T_Lidar0_LidarK = T_Lidar0_World * Ts_World_LidarK[k];
+    q_Lidar0_LidarK[k] = Eigen::Quaternionf(
+        T_Lidar0_LidarK.block<3, 3>(0, 0).cast<float>());
+    q_Lidar0_LidarK[k].normalize();
+    t_Lidar0_LidarK[k] = T_Lidar0_LidarK.block<3, 1>(0, 3).cast<float>();
+  }
+
+  // interpolate between knots for each point. Motion between knots is small
+  // so we use a normalized lerp for the rotation instead of a slerp. The copy
+  // reuses the storage of the output
+  cloud_deskewed = cloud;
+  for (auto& p : cloud_deskewed) {
+    const double s = (static_cast<double>(p.time) - t_min) / dt;
+    const int k = std::min(static_cast<int>(s), num_knots - 2);
+    const float alpha = static_cast<float>(s - k);
+    const Eigen::Quaternionf& q1 = q_Lidar0_LidarK[k];
+    Eigen::Quaternionf q2 = q_Lidar0_LidarK[k + 1];
+    if (q1.dot(q2) < 0) { q2.coeffs() = -q2.coeffs(); }
+    Eigen::Quaternionf q;
+    q.coeffs() = (1 - alpha) * q1.coeffs() + alpha * q2.coeffs();
+    q.normalize();
+    const Eigen::Vector3f t =
+        (1 - alpha) * t_Lidar0_LidarK[k] + alpha * t_Lidar0_LidarK[k + 1];
+    p.getVector3fMap() = q * p.getVector3fMap() + t;
   }
+  return true;
 }
 
 } // namespace bs_models
@@ -0,0 +1,66 @@
+#include <bs_models/slam_chunk_relay.h>
+
+#include <boost/make_shared.hpp>
+#include <pluginlib/class_list_macros.h>
+
+// Register this sensor model with ROS as a plugin.
+PLUGINLIB_EXPORT_CLASS(bs_models::SlamChunkRelay, fuse_core::SensorModel);
+
+const std::string k_slam_chunks_topic{"slam_chunks"};
+
+namespace bs_models {
+
+using Level = global_mapping::SlamChunkBudget::Level;
+
+SlamChunkRelay::SlamChunkRelay() : fuse_core::AsyncSensorModel(1) {}
+
+void SlamChunkRelay::onInit() {
+  params_.loadFromROS(private_node_handle_);
+  global_mapping::SlamChunkBudget::Params budget_params;
+  budget_params.budget_kbps = params_.budget_kbps;
+  budget_params.burst_s = params_.burst_s;
+  budget_params.jpeg_quality = params_.jpeg_quality;
+  budget_params.min_jpeg_quality = params_.min_jpeg_quality;
+  budget_params.quality_step = params_.quality_step;
+  budget_ = global_mapping::SlamChunkBudget(budget_params);
+}
+
+void SlamChunkRelay::onStart() {
+  budget_.Reset();
+  slam_chunk_publisher_ =
+      private_node_handle_.advertise<bs_common::SlamChunkMsg>(
+          k_slam_chunks_topic, 100);
+  slam_chunk_subscriber_ =
+      private_node_handle_.subscribe<bs_common::SlamChunkMsg>(
+          ros::names::resolve(params_.input_topic), 100,
+          &SlamChunkRelay::processSlamChunk, this,
+          ros::TransportHints().tcpNoDelay(false));
+}
+
+void SlamChunkRelay::onStop() {
+  slam_chunk_subscriber_.shutdown();
+  slam_chunk_publisher_.shutdown();
+
+  const auto& stats = budget_.GetStats();
+  const auto count = [&stats](Level level) {
+    return static_cast<size_t>(stats.chunks[static_cast<size_t>(level)]);
+  };
+  ROS_INFO("Relayed slam chunks: %zu full, %zu reduced, %zu features only, "
+           "%zu poses only, %.1f MB",
+           count(Level::FULL), count(Level::REDUCED), count(Level::FEATURES),
+           count(Level::POSES), stats.bytes / 1e6);
+}
+
+void SlamChunkRelay::processSlamChunk(
+    const bs_common::SlamChunkMsg::ConstPtr& msg) {
+  auto chunk = boost::make_shared<bs_common::SlamChunkMsg>(*msg);
+  const Level level = budget_.Fit(*chunk, ros::Time::now());
+  if (level != Level::FULL) {
+    ROS_DEBUG("Slam chunk at %.3f over budget, reduced to level %d",
+              msg->T_WORLD_BASELINK.header.stamp.toSec(),
+              static_cast<int>(level));
+  }
+  slam_chunk_publisher_.publish(chunk);
+}
+
+} // namespace bs_models
@@ -6,14 +6,22 @@
 #include <fuse_variables/velocity_angular_3d_stamped.h>
 #include <pluginlib/class_list_macros.h>
 
-#include <beam_cv/geometry/Triangulation.h>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
 #include <beam_utils/utils.h>
 
+#include <bs_common/reset_context.h>
+#include <bs_common/startup_profiler.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_common/visualization.h>
+#include <bs_constraints/inertial/imu_state_3d_stamped_transaction.h>
 #include <bs_models/graph_visualization/helpers.h>
-#include <bs_models/imu/inertial_alignment.h>
 #include <bs_models/scan_registration/registration_map.h>
+#include <bs_models/vision/camera_measurement_view.h>
 #include <bs_models/vision/utils.h>
+#include <bs_models/vision/visual_constraint_builder.h>
 
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::SLAMInitialization, fuse_core::SensorModel);
@@ -22,6 +30,16 @@ namespace bs_models {
 
 using namespace vision;
 
+namespace {
+
+// window of imu samples and max deviations for the vehicle to be considered
+// stationary when initializing in a prior map
+constexpr double kStationaryWindowS = 1.0;
+constexpr double kStationaryMaxGyroDeviation = 0.05; // rad/s
+constexpr double kStationaryMaxAccelDeviation = 0.5; // m/s^2
+
+} // namespace
+
 SLAMInitialization::SLAMInitialization()
     : fuse_core::AsyncSensorModel(3),
       device_id_(fuse_core::uuid::NIL),
@@ -34,10 +52,13 @@ SLAMInitialization::SLAMInitialization()
                                           this, std::placeholders::_1)) {}
 
 void SLAMInitialization::onInit() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_init");
   // Read settings from the parameter sever
   device_id_ = fuse_variables::loadDeviceId(private_node_handle_);
   calibration_params_.loadFromROS();
   params_.loadFromROS(private_node_handle_);
+  bs_common::ResetContext::GetInstance().SetReigniteAfterFastReset(
+      params_.reignite_after_fast_reset);
 
   // Load camera model and create map object
   cam_model_ = beam_calibration::CameraModel::Create(
@@ -52,7 +73,13 @@ void SLAMInitialization::onInit() {
       params_.reprojection_information_weight, params_.use_online_calibration,
       true);
 
-  image_db_ = std::make_shared<beam_cv::ImageDatabase>();
+  // the vocabulary is only needed once enough frames are tracked
+  image_db_ = bs_common::LoadInBackground<
+      std::shared_ptr<beam_cv::ImageDatabase>>(name() + "/vocabulary", []() {
+    return std::make_shared<beam_cv::ImageDatabase>();
+  });
+  triangulator_ = std::make_shared<vision::BatchTriangulator>(
+      cam_model_, params_.triangulation_threads);
 
   // create optimization graph
   local_graph_ = std::make_shared<fuse_graphs::HashGraph>();
@@ -85,8 +112,13 @@ void SLAMInitialization::onInit() {
 
   max_landmark_container_size_ =
       params_.initialization_window_s * calibration_params_.camera_hz;
-  imu_buffer_size_ =
-      params_.initialization_window_s * 2.0 * calibration_params_.imu_hz;
+  // the ring is sized for the buffer duration so memory stays bounded even if
+  // the imu runs faster than its calibrated rate
+  const double imu_buffer_duration_s = params_.initialization_window_s * 2.0;
+  imu_buffer_ = bs_common::ImuSampleBuffer(
+      ros::Duration(imu_buffer_duration_s),
+      static_cast<size_t>(std::max(calibration_params_.imu_hz, 0) *
+                          imu_buffer_duration_s * 2));
 
   if (calibration_params_.lidar_hz < 1 / min_lidar_scan_period_s_) {
     lidar_buffer_size_ =
@@ -101,25 +133,46 @@ void SLAMInitialization::onInit() {
     ROS_FATAL(
         "JAKE - Visual not working -> gravity and scale estimate is wrong.");
     mode_ = InitMode::VISUAL;
-  } else if (params_.init_mode == "LIDAR") {
-    mode_ = InitMode::LIDAR;
+  } else if (params_.init_mode == "LIDAR" ||
+             params_.init_mode == "PRIOR_MAP") {
+    // PRIOR_MAP falls back to LIDAR if it cannot relocalize
+    mode_ = params_.init_mode == "LIDAR" ? InitMode::LIDAR
+                                         : InitMode::PRIOR_MAP;
     lidar_path_init_ = std::make_unique<LidarPathInit>(
         lidar_buffer_size_, params_.matcher_config,
-        params_.lidar_information_weight);
+        params_.lidar_information_weight, params_.lidar_init_threads);
+    if (mode_ == InitMode::PRIOR_MAP) { LoadPriorMap(); }
   } else {
-    throw std::invalid_argument{"invalid init mode, options: VISUAL, LIDAR"};
+    throw std::invalid_argument{
+        "invalid init mode, options: VISUAL, LIDAR, PRIOR_MAP"};
   }
 }
 
 void SLAMInitialization::onStart() {
   ROS_INFO_STREAM("Starting: " << name());
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_start");
 
-  // initialize frame init
-  if (!params_.frame_initializer_config.empty()) {
+  // initialize frame init, which is kept on fast resets in the same world
+  // frame
+  auto& reset_context = bs_common::ResetContext::GetInstance();
+  if (!params_.frame_initializer_config.empty() &&
+      (!frame_initializer_ || !reset_context.KeepsWorldFrame())) {
     frame_initializer_ = std::make_unique<bs_models::FrameInitializer>(
         params_.frame_initializer_config);
   }
 
+  // the world frame is kept when re-igniting after a fast reset, so there is
+  // nothing to initialize
+  if (params_.reignite_after_fast_reset) {
+    const auto last_good_state = reset_context.TakeLastGoodState();
+    if (last_good_state) {
+      BEAM_INFO("Re-igniting from the last good state at {}s",
+                last_good_state->Stamp().toSec());
+      SendImuStateInitialization(last_good_state.value());
+      return;
+    }
+  }
+
   // subscribe to topics
   visual_measurement_subscriber_ =
       private_node_handle_.subscribe<bs_common::CameraMeasurementMsg>(
@@ -142,7 +195,9 @@ void SLAMInitialization::onStart() {
 void SLAMInitialization::onStop() {
   ROS_INFO_STREAM("Stopping: " << name());
   shutdown();
-  // reset and clear registration map
+  // reset and clear registration map, unless the optimizer is re-ignited in
+  // the same world frame
+  if (bs_common::ResetContext::GetInstance().KeepsWorldFrame()) { return; }
   bs_models::scan_registration::RegistrationMap::GetInstance().Clear();
 }
 
@@ -152,19 +207,32 @@ void SLAMInitialization::processFrameInit(const ros::Time& timestamp) {
 
   frame_init_buffer_.push_back(timestamp);
 
-  auto front_timestamp = frame_init_buffer_.front();
+  // all buffered frames covered by the odometry are looked up in one pass,
+  // the others wait for the odometry to catch up
+  const ros::Time odometry_end = frame_initializer_->OdometryEndTime();
+  std::vector<ros::Time> stamps;
+  for (const auto& stamp : frame_init_buffer_) {
+    if (stamp <= odometry_end) { stamps.push_back(stamp); }
+  }
+  if (stamps.empty()) { return; }
+  std::sort(stamps.begin(), stamps.end());
 
-  Eigen::Matrix4d T_WORLD_BASELINK;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_WORLD_BASELINKs;
   std::string error_msg;
-  if (!frame_initializer_->GetPose(T_WORLD_BASELINK, front_timestamp,
-                                   extrinsics_.GetBaselinkFrameId(),
-                                   error_msg)) {
-    ROS_WARN("Error getting pose from frame initializer, error: %s",
+  if (!frame_initializer_->GetPoses(T_WORLD_BASELINKs, stamps,
+                                    extrinsics_.GetBaselinkFrameId(),
+                                    error_msg)) {
+    ROS_WARN("Error getting poses from frame initializer, error: %s",
              error_msg.c_str());
     return;
   }
-  init_path_[front_timestamp.toNSec()] = T_WORLD_BASELINK;
-  frame_init_buffer_.pop_front();
+  for (size_t i = 0; i < stamps.size(); i++) {
+    init_path_.emplace_hint(init_path_.end(), stamps[i].toNSec(),
+                            T_WORLD_BASELINKs[i]);
+  }
+  frame_init_buffer_.remove_if([&odometry_end](const ros::Time& stamp) {
+    return stamp <= odometry_end;
+  });
 
   // check if path is long enough
   const Eigen::Matrix4d& first_pose = init_path_.begin()->second;
@@ -244,6 +312,10 @@ void SLAMInitialization::processLidar(
     return;
   }
 
+  if (mode_ == InitMode::PRIOR_MAP) {
+    processLidarPriorMap(msg);
+    return;
+  }
   if (mode_ != InitMode::LIDAR) { return; }
 
   double time_in_s = msg->header.stamp.toSec();
@@ -270,26 +342,90 @@ void SLAMInitialization::processLidar(
   }
 }
 
+void SLAMInitialization::processLidarPriorMap(
+    const sensor_msgs::PointCloud2::ConstPtr& msg) {
+  // scans received while the map is loading are skipped
+  if (!prior_map_.valid() || prior_map_.wait_for(std::chrono::seconds(0)) !=
+                                 std::future_status::ready) {
+    return;
+  }
+  const ros::Time& stamp = msg->header.stamp;
+  if (imu_buffer_.Range(stamp - ros::Duration(kStationaryWindowS), stamp)
+          .size() < 2) {
+    return;
+  }
+
+  Eigen::Vector3d bg;
+  Eigen::Matrix4d T_MAP_BASELINK;
+  if (prior_map_.get() && EstimateStationaryGyroBias(stamp, bg) &&
+      RelocalizeInPriorMap(msg, T_MAP_BASELINK)) {
+    SendPriorMapInitialization(stamp, T_MAP_BASELINK, bg);
+    shutdown();
+    return;
+  }
+
+  prior_map_attempts_++;
+  if (prior_map_.get() &&
+      prior_map_attempts_ < params_.prior_map_max_attempts) {
+    return;
+  }
+  BEAM_WARN("Cannot relocalize in prior map after {} scans, falling back to "
+            "LIDAR initialization",
+            prior_map_attempts_);
+  mode_ = InitMode::LIDAR;
+  prior_map_ = {};
+}
+
 void SLAMInitialization::processIMU(const sensor_msgs::Imu::ConstPtr& msg) {
   ROS_INFO_STREAM_ONCE(
       "SLAMInitialization received IMU measurements: " << msg->header.stamp);
-  imu_buffer_.push_back(*msg);
-  if (imu_buffer_.size() > imu_buffer_size_) { imu_buffer_.pop_front(); }
+  const bs_common::ImuSample sample(*msg);
+  if (!imu_buffer_.Add(sample)) { return; }
+  UpdateStationaryStatistics(sample);
+}
+
+void SLAMInitialization::UpdateStationaryStatistics(
+    const bs_common::ImuSample& sample) {
+  StationaryImuStatistics& stats = stationary_imu_;
+  const bool stationary =
+      std::abs(sample.a.norm() - GRAVITY_NOMINAL) <
+          kStationaryMaxAccelDeviation &&
+      (stats.count == 0 ||
+       (sample.w - stats.mean_w).norm() < kStationaryMaxGyroDeviation);
+  if (!stationary) {
+    stats = StationaryImuStatistics();
+    return;
+  }
+
+  if (stats.count == 0) { stats.start = sample.stamp; }
+  stats.end = std::max(stats.end, sample.stamp);
+  stats.count++;
+  stats.mean_w += (sample.w - stats.mean_w) / stats.count;
+  stats.mean_a += (sample.a - stats.mean_a) / stats.count;
+
+  // only compress while waiting for the first motion, so the samples of an
+  // earlier motion are never dropped
+  const ros::Time keep_start = stats.end - ros::Duration(kStationaryWindowS);
+  if (stats.start < keep_start && imu_buffer_.Front().stamp >= stats.start) {
+    imu_buffer_.RemoveBefore(keep_start);
+  }
 }
 
 bool SLAMInitialization::Initialize() {
-  if (imu_buffer_.empty()) {
-    ROS_ERROR_STREAM(__func__ << ": IMU buffer empty, cannot initialize!");
+  if (imu_buffer_.Size() < 2) {
+    ROS_ERROR_STREAM(__func__
+                     << ": Less than 2 IMU measurements, cannot initialize!");
     return false;
   }
 
   // prune poses in path at start that don't have >= imu messages before it
-  auto second_imu_msg = std::next(imu_buffer_.begin());
+  const ros::Time second_imu_stamp = imu_buffer_[1].stamp;
   if (lidar_path_init_) {
-    lidar_path_init_->SetTrajectoryStart(imu_buffer_.begin()->header.stamp);
+    lidar_path_init_->SetTrajectoryStart(imu_buffer_.Front().stamp);
   }
 
-  while (init_path_.begin()->first < second_imu_msg->header.stamp.toNSec()) {
+  while (!init_path_.empty() &&
+         init_path_.begin()->first < second_imu_stamp.toNSec()) {
     init_path_.erase(init_path_.begin()->first);
   }
 
@@ -307,8 +443,13 @@ bool SLAMInitialization::Initialize() {
   }
 
   // Estimate imu biases and gravity using the initial path
+  const auto alignment_method =
+      params_.inertial_alignment_method == "CLOSED_FORM"
+          ? bs_models::imu::AlignmentMethod::CLOSED_FORM
+          : bs_models::imu::AlignmentMethod::QR;
   bs_models::imu::EstimateParameters(init_path_, imu_buffer_, imu_params_,
-                                     gravity_, bg_, ba_, velocities_, scale_);
+                                     gravity_, bg_, ba_, velocities_, scale_,
+                                     alignment_method, alignment_summary_);
   if (!frame_initializer_ && mode_ == InitMode::VISUAL &&
       (scale_ < 0.02 || scale_ > 1.0)) {
     ROS_WARN_STREAM(__func__ << ": Invalid scale estimate: " << scale_);
@@ -318,11 +459,26 @@ bool SLAMInitialization::Initialize() {
   imu_preint_ = std::make_shared<bs_models::ImuPreintegration>(
       name(), imu_params_, bg_, ba_, params_.inertial_information_weight);
 
+  // the lidar constraints were built by the lidar path initialization and only
+  // need to be merged, which is done while the other constraints are built
+  init_batch_.Clear();
+  auto lidar_transaction = fuse_core::Transaction::make_shared();
+  std::future<void> lidar_merged;
+  if (mode_ == InitMode::LIDAR) {
+    lidar_merged = bs_common::TaskScheduler::GetInstance().Enqueue(
+        bs_common::TaskPriority::REALTIME, [this, lidar_transaction]() {
+          MergeLidarConstraints(*lidar_transaction);
+        });
+  }
+
   AlignPathAndVelocities(mode_ == InitMode::VISUAL && !frame_initializer_);
   InterpolateVisualMeasurements();
   AddPosesAndInertialConstraints();
   AddVisualConstraints();
-  AddLidarConstraints();
+  if (lidar_merged.valid()) {
+    lidar_merged.get();
+    UpdateLocalGraph(*lidar_transaction);
+  }
 
   if (!params_.output_folder.empty()) {
     graph_poses_before_opt_ = bs_common::GetGraphPosesAsCloud(*local_graph_);
@@ -372,28 +528,54 @@ bool SLAMInitialization::Initialize() {
 }
 
 void SLAMInitialization::InterpolateVisualMeasurements() {
-  if (landmark_container_->NumImages() == 0) { return; }
+  if (landmark_container_->NumImages() == 0 || init_path_.size() < 2) {
+    return;
+  }
 
-  // interpolate for existing visual measurements if they aren't in the path
-  auto visual_measurements = landmark_container_->GetMeasurementTimes();
-  for (const auto& stamp : visual_measurements) {
-    auto nsec = stamp.toNSec();
-    auto lb = init_path_.lower_bound(nsec);
-    auto ub = init_path_.upper_bound(nsec);
-    if (lb == init_path_.end() || ub == init_path_.end() || lb->first == nsec) {
-      continue;
+  // visual measurements within the path which aren't in it yet
+  const uint64_t path_start = init_path_.begin()->first;
+  const uint64_t path_end = init_path_.rbegin()->first;
+  std::vector<ros::Time> stamps;
+  for (const auto& stamp : landmark_container_->GetMeasurementTimes()) {
+    const uint64_t nsec = stamp.toNSec();
+    if (nsec > path_start && nsec < path_end &&
+        init_path_.find(nsec) == init_path_.end()) {
+      stamps.push_back(stamp);
     }
-    lb = std::prev(lb);
-    auto ub_time = beam::NSecToRos(ub->first).toSec();
-    auto lb_time = beam::NSecToRos(lb->first).toSec();
-    // interpolate pose at image time
-    init_path_[nsec] = beam::InterpolateTransform(
-        init_path_.at(lb->first), lb_time, init_path_.at(ub->first), ub_time,
-        stamp.toSec());
-    // interpolate velocity at image time
-    velocities_[nsec] = beam::InterpolateVector(
-        velocities_.at(lb->first), lb_time, velocities_.at(ub->first), ub_time,
-        stamp.toSec());
+  }
+  if (stamps.empty()) { return; }
+  std::sort(stamps.begin(), stamps.end());
+
+  // interpolate all poses in one walk of the path
+  bs_common::TrajectoryPoses poses;
+  poses.reserve(init_path_.size());
+  for (const auto& [nsec, T_WORLD_BASELINK] : init_path_) {
+    poses.emplace_back(beam::NSecToRos(nsec), T_WORLD_BASELINK);
+  }
+  const bs_common::Trajectory path(std::move(poses));
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_WORLD_BASELINKs;
+  std::string error_msg;
+  if (!path.Get(T_WORLD_BASELINKs, stamps, error_msg)) {
+    ROS_WARN_STREAM(__func__ << ": Cannot interpolate visual measurement "
+                                "poses: "
+                             << error_msg);
+    return;
+  }
+
+  // velocities are keyed the same as the path, so they are walked the same
+  // way. New velocities are only inserted before ub, which stays valid
+  auto ub = velocities_.begin();
+  for (size_t i = 0; i < stamps.size(); i++) {
+    const uint64_t nsec = stamps[i].toNSec();
+    init_path_.emplace(nsec, T_WORLD_BASELINKs[i]);
+    while (ub != velocities_.end() && ub->first <= nsec) { ub++; }
+    if (ub == velocities_.begin() || ub == velocities_.end()) { continue; }
+    const auto lb = std::prev(ub);
+    velocities_.emplace_hint(
+        ub, nsec,
+        beam::InterpolateVector(lb->second, beam::NSecToRos(lb->first).toSec(),
+                                ub->second, beam::NSecToRos(ub->first).toSec(),
+                                stamps[i].toSec()));
   }
 }
 
@@ -431,45 +613,65 @@ void SLAMInitialization::AlignPathAndVelocities(bool apply_scale) {
 }
 
 void SLAMInitialization::AddPosesAndInertialConstraints() {
-  // add imu constraints between all poses in the path
-  bool start_set = false;
-  auto process_frame = [&](const auto& pair) {
-    auto [stamp, T_WORLD_BASELINK] = pair;
-    const auto timestamp = beam::NSecToRos(stamp);
+  std::vector<ros::Time> stamps;
+  stamps.reserve(init_path_.size());
+  for (const auto& [stamp, T_WORLD_BASELINK] : init_path_) {
+    stamps.push_back(beam::NSecToRos(stamp));
+  }
+
+  // preintegrate the imu measurements between consecutive poses in parallel.
+  // The biases are fixed to the initial estimate, so each segment only depends
+  // on its own measurements. segments[i] ends at stamps[i], and is left empty
+  // if there are no measurements in it
+  std::vector<bs_common::PreIntegrator> segments(stamps.size());
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, stamps.size() - 1, [&](size_t i) {
+        const ros::Time& start = stamps[i];
+        const ros::Time& end = stamps[i + 1];
+        bs_common::PreIntegrator& pre_integrator = segments[i + 1];
+        pre_integrator.cov_w = imu_params_.cov_gyro_noise;
+        pre_integrator.cov_a = imu_params_.cov_accel_noise;
+        pre_integrator.cov_bg = imu_params_.cov_gyro_bias;
+        pre_integrator.cov_ba = imu_params_.cov_accel_bias;
+        for (auto it = imu_buffer_.LowerBound(start);
+             it != imu_buffer_.end() && it->stamp < end; it++) {
+          pre_integrator.AddData(it->ToIMUData());
+        }
+        if (pre_integrator.Data().Empty()) { return; }
+        pre_integrator.Integrate(end, bg_, ba_, true, true, true);
+      });
+
+  // add the poses and constraints in order, since each imu constraint starts
+  // from the state of the previous one
+  for (size_t i = 0; i < stamps.size(); i++) {
+    const ros::Time& timestamp = stamps[i];
     auto transaction = fuse_core::Transaction::make_shared();
     transaction->stamp(timestamp);
 
-    // add imu data to preint for this frame
-    while (imu_buffer_.front().header.stamp < timestamp &&
-           !imu_buffer_.empty()) {
-      imu_preint_->AddToBuffer(imu_buffer_.front());
-      imu_buffer_.pop_front();
-    }
-
     // add pose and velocity to graph
-    visual_map_->AddBaselinkPose(T_WORLD_BASELINK, timestamp, transaction);
-    Eigen::Vector3d velocity_estimate = velocities_[stamp];
+    visual_map_->AddBaselinkPose(init_path_.at(timestamp.toNSec()), timestamp,
+                                 transaction);
+    Eigen::Vector3d velocity_estimate = velocities_[timestamp.toNSec()];
     auto velocity =
         std::make_shared<fuse_variables::VelocityLinear3DStamped>(timestamp);
     velocity->x() = velocity_estimate.x();
     velocity->y() = velocity_estimate.y();
     velocity->z() = velocity_estimate.z();
     transaction->addVariable(velocity);
-    local_graph_->update(*transaction);
+    UpdateLocalGraph(*transaction);
 
     // get the fuse pose variables
     auto img_orientation = visual_map_->GetOrientation(timestamp);
     auto img_position = visual_map_->GetPosition(timestamp);
 
     // Add appropriate imu constraints
-    if (!start_set) {
+    if (i == 0) {
       imu_preint_->SetStart(timestamp, img_orientation, img_position, velocity);
-      start_set = true;
-      return;
+      continue;
     }
 
     // no imu measurements between states -> add zero motion constraint
-    if (imu_preint_->CurrentBufferSize() == 0) {
+    if (segments[i].Data().Empty()) {
       auto zero_motion_transaction = fuse_core::Transaction::make_shared();
       zero_motion_transaction->stamp(timestamp);
 
@@ -486,17 +688,19 @@ void SLAMInitialization::AddPosesAndInertialConstraints() {
           start_state.AccelBiasVec());
       bs_common::AddZeroMotionFactor("SLAMINIT", start_state, new_state,
                                      zero_motion_transaction);
-      local_graph_->update(*zero_motion_transaction);
-      return;
+      UpdateLocalGraph(*zero_motion_transaction);
+      continue;
     }
 
-    auto imu_transaction = imu_preint_->RegisterNewImuPreintegratedFactor(
-        timestamp, img_orientation, img_position, velocity);
-    local_graph_->update(*imu_transaction);
-  };
+    auto imu_transaction = imu_preint_->RegisterPreintegratedFactor(
+        timestamp, segments[i], img_orientation, img_position, velocity);
+    UpdateLocalGraph(*imu_transaction);
+  }
 
-  // process each frame in the path
-  std::for_each(init_path_.begin(), init_path_.end(), process_frame);
+  // the measurements up to the last pose are used
+  while (!imu_buffer_.Empty() && imu_buffer_.Front().stamp < stamps.back()) {
+    imu_buffer_.PopFront();
+  }
 
   // update visual map with updated graph
   visual_map_->UpdateGraph(*local_graph_);
@@ -508,7 +712,7 @@ void SLAMInitialization::AddVisualConstraints() {
   // get the keyframe times we want to add constraints to
   std::set<ros::Time> kf_times;
   auto visual_measurements = landmark_container_->GetMeasurementTimes();
-  if (params_.init_mode == "VISUAL") {
+  if (mode_ == InitMode::VISUAL) {
     // keyframes = poses in init path
     for (const auto& [nsec, pose] : init_path_) {
       const auto timestamp = beam::NSecToRos(nsec);
@@ -532,25 +736,21 @@ void SLAMInitialization::AddVisualConstraints() {
   size_t num_landmarks = 0;
   auto landmark_transaction = fuse_core::Transaction::make_shared();
   landmark_transaction->stamp(start);
-  auto process_landmark = [&](const auto& id) {
-    // triangulate and add landmark
-    Eigen::Vector3d avg_viewing_angle;
-    uint64_t word_id;
-    const auto initial_point =
-        TriangulateLandmark(id, avg_viewing_angle, word_id);
-    if (!initial_point.has_value()) { return; }
-
+  vision::VisualConstraintBuilder builder(*visual_map_, landmark_transaction);
+  auto process_landmark = [&](const uint64_t id,
+                              const Eigen::Vector3d& initial_point,
+                              const Eigen::Vector3d& avg_viewing_angle,
+                              const uint64_t word_id) {
     if (!params_.use_idp) {
-      visual_map_->AddLandmark(initial_point.value(), avg_viewing_angle,
-                               word_id, id, landmark_transaction);
+      visual_map_->AddLandmark(initial_point, avg_viewing_angle, word_id, id,
+                               landmark_transaction);
       num_landmarks++;
 
       // add constraints to keyframes that view it
       for (const auto& stamp : kf_times) {
         try {
           Eigen::Vector2d pixel = landmark_container_->GetValue(stamp, id);
-          visual_map_->AddVisualConstraint(stamp, id, pixel,
-                                           landmark_transaction);
+          builder.AddVisualConstraint(stamp, id, pixel);
         } catch (const std::out_of_range& oor) { continue; }
       }
     } else {
@@ -587,7 +787,7 @@ void SLAMInitialization::AddVisualConstraints() {
       if (!T_WORLD_CAMERA.has_value()) { return; }
       Eigen::Vector3d camera_t_point =
           (beam::InvertTransform(T_WORLD_CAMERA.value()) *
-           initial_point.value().homogeneous())
+           initial_point.homogeneous())
               .hnormalized();
       double inverse_depth = 1.0 / camera_t_point.norm();
 
@@ -600,20 +800,42 @@ void SLAMInitialization::AddVisualConstraints() {
       for (const auto& stamp : kf_times) {
         try {
           Eigen::Vector2d pixel = landmark_container_->GetValue(stamp, id);
-          visual_map_->AddInverseDepthVisualConstraint(stamp, id, pixel,
-                                                       landmark_transaction);
+          builder.AddInverseDepthVisualConstraint(stamp, id, pixel);
         } catch (const std::out_of_range& oor) { continue; }
       }
     }
   };
 
-  // process each landmark
+  // gather the measurements of all landmarks in parallel, each landmark only
+  // reads the graph and its own track. Landmarks without enough measurements
+  // keep an empty request, which the triangulator skips
   const auto landmarks =
       landmark_container_->GetLandmarkIDsInWindow(start, end);
-  std::for_each(landmarks.begin(), landmarks.end(), process_landmark);
+  const std::vector<uint64_t> ids(landmarks.begin(), landmarks.end());
+  std::vector<vision::BatchTriangulator::Request> requests(ids.size());
+  std::vector<Eigen::Vector3d, beam::AlignVec3d> avg_viewing_angles(
+      ids.size());
+  std::vector<uint64_t> word_ids(ids.size());
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, ids.size(), [&](size_t i) {
+        if (!GetTriangulationRequest(ids[i], requests[i],
+                                     avg_viewing_angles[i], word_ids[i])) {
+          requests[i] = vision::BatchTriangulator::Request();
+        }
+      });
+  const auto points = triangulator_->Triangulate(
+      requests, params_.max_triangulation_distance,
+      params_.max_triangulation_reprojection);
+
+  // process each triangulated landmark
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (!points[i].has_value()) { continue; }
+    process_landmark(ids[i], points[i].value(), avg_viewing_angles[i],
+                     word_ids[i]);
+  }
 
   // send transaction to graph
-  local_graph_->update(*landmark_transaction);
+  UpdateLocalGraph(*landmark_transaction);
   // update visual map with updated graph
   visual_map_->UpdateGraph(*local_graph_);
 
@@ -621,23 +843,141 @@ void SLAMInitialization::AddVisualConstraints() {
                            << " visual landmarks to initialization graph.");
 }
 
-void SLAMInitialization::AddLidarConstraints() {
-  if (params_.init_mode != "LIDAR") { return; }
-
-  fuse_core::Transaction::SharedPtr transaction_combined =
-      fuse_core::Transaction::make_shared();
-  for (const auto& [timeInNs, transaction] :
+void SLAMInitialization::MergeLidarConstraints(
+    fuse_core::Transaction& transaction) {
+  for (const auto& [timeInNs, keyframe_transaction] :
        lidar_path_init_->GetTransactions()) {
-    transaction_combined->merge(*(transaction.GetTransaction()));
+    transaction.merge(*(keyframe_transaction.GetTransaction()));
   }
-  local_graph_->update(*transaction_combined);
 }
 
-beam::opt<Eigen::Vector3d> SLAMInitialization::TriangulateLandmark(
-    const uint64_t lm_id, Eigen::Vector3d& average_viewing_angle,
-    uint64_t& visual_word_id) {
-  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_cam_world_v;
-  std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+void SLAMInitialization::LoadPriorMap() {
+  const std::string path = params_.prior_map_path;
+  const std::string candidate_search_config =
+      params_.prior_map_candidate_search_config;
+  const std::string refinement_config = params_.prior_map_refinement_config;
+  const size_t memory_budget_bytes =
+      static_cast<size_t>(params_.prior_map_memory_budget_mb * 1e6);
+  prior_map_ = bs_common::LoadInBackground<std::shared_ptr<PriorMap>>(
+      name() + "/prior_map",
+      [path, candidate_search_config, refinement_config,
+       memory_budget_bytes]() -> std::shared_ptr<PriorMap> {
+        auto prior_map = std::make_shared<PriorMap>();
+        try {
+          prior_map->global_map =
+              std::make_shared<global_mapping::GlobalMap>(path, false);
+          prior_map->candidate_search =
+              reloc::RelocCandidateSearchBase::Create(candidate_search_config);
+          prior_map->refinement =
+              reloc::RelocRefinementBase::Create(refinement_config);
+        } catch (const std::exception& e) {
+          BEAM_ERROR("Cannot load prior map {}: {}", path, e.what());
+          return nullptr;
+        }
+        prior_map->submaps = prior_map->global_map->GetSubmaps();
+        prior_map->working_set =
+            std::make_shared<global_mapping::SubmapWorkingSet>(
+                prior_map->submaps, prior_map->global_map->MapStore(),
+                memory_budget_bytes);
+
+        // prepare the submaps once, paging in their clouds one at a time
+        for (size_t i = 0; i < prior_map->submaps.size(); i++) {
+          const auto lease = prior_map->working_set->Acquire({i});
+          if (!lease.Valid()) { continue; }
+          prior_map->candidate_search->PrepareSubmap(prior_map->submaps[i]);
+        }
+        BEAM_INFO("Loaded prior map with {} submaps from {}",
+                  prior_map->submaps.size(), path);
+        return prior_map;
+      });
+}
+
+bool SLAMInitialization::RelocalizeInPriorMap(
+    const sensor_msgs::PointCloud2::ConstPtr& msg,
+    Eigen::Matrix4d& T_MAP_BASELINK) {
+  const std::shared_ptr<PriorMap> prior_map = prior_map_.get();
+
+  // the query submap only has the scan, at the origin of the query frame
+  PointCloud cloud;
+  beam::ROSToPCL(cloud, *msg);
+  auto query_submap = std::make_shared<global_mapping::Submap>(
+      msg->header.stamp, Eigen::Matrix4d::Identity(),
+      prior_map->global_map->GetCameraModel(),
+      prior_map->global_map->GetExtrinsics());
+  query_submap->AddLidarMeasurement(cloud, Eigen::Matrix4d::Identity(),
+                                    msg->header.stamp);
+  prior_map->candidate_search->PrepareSubmap(query_submap);
+
+  std::vector<int> matched_indices;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_MATCH_QUERY;
+  {
+    global_mapping::SubmapWorkingSet::Lease search_lease;
+    if (prior_map->candidate_search->UsesLidarClouds()) {
+      std::vector<size_t> search_ids(prior_map->submaps.size());
+      std::iota(search_ids.begin(), search_ids.end(), 0);
+      search_lease = prior_map->working_set->Acquire(search_ids);
+    }
+    prior_map->candidate_search->FindRelocCandidates(
+        prior_map->submaps, query_submap, matched_indices, Ts_MATCH_QUERY, 0);
+  }
+
+  // candidates are ordered by likelihood, so use the first accepted one
+  for (size_t i = 0; i < matched_indices.size(); i++) {
+    const size_t id = matched_indices[i];
+    const auto lease = prior_map->working_set->Acquire({id});
+    if (!lease.Valid()) { continue; }
+    const global_mapping::SubmapPtr& matched_submap = prior_map->submaps.at(id);
+    const reloc::RelocRefinementResults results =
+        prior_map->refinement->RunRefinement(matched_submap, query_submap,
+                                             Ts_MATCH_QUERY[i]);
+    if (!results.successful) { continue; }
+    T_MAP_BASELINK = matched_submap->T_WORLD_SUBMAP() * results.T_MATCH_QUERY;
+    BEAM_INFO("Relocalized scan {} in submap {} of prior map",
+              msg->header.stamp.toSec(), id);
+    return true;
+  }
+  return false;
+}
+
+bool SLAMInitialization::EstimateStationaryGyroBias(const ros::Time& stamp,
+                                                    Eigen::Vector3d& bg) {
+  const StationaryImuStatistics& stats = stationary_imu_;
+  const ros::Duration window(kStationaryWindowS);
+  if (stats.count == 0 || stats.start > stamp - window ||
+      stats.end < stamp - window) {
+    ROS_WARN_STREAM_THROTTLE(
+        1, __func__ << ": Vehicle is moving, cannot initialize in prior map");
+    return false;
+  }
+  bg = stats.mean_w;
+  return true;
+}
+
+void SLAMInitialization::SendPriorMapInitialization(
+    const ros::Time& stamp, const Eigen::Matrix4d& T_MAP_BASELINK,
+    const Eigen::Vector3d& bg) {
+  Eigen::Quaterniond q;
+  Eigen::Vector3d p;
+  beam::TransformMatrixToQuaternionAndTranslation(T_MAP_BASELINK, q, p);
+  bs_common::ImuState imu_state(stamp, q, p, Eigen::Vector3d::Zero(), bg,
+                                Eigen::Vector3d::Zero());
+  SendImuStateInitialization(imu_state);
+}
+
+void SLAMInitialization::SendImuStateInitialization(
+    const bs_common::ImuState& imu_state) {
+  bs_constraints::ImuState3DStampedTransaction transaction(imu_state.Stamp());
+  transaction.AddPriorImuStateConstraint(
+      imu_state,
+      imu_params_.cov_prior_noise * Eigen::Matrix<double, 15, 15>::Identity(),
+      name());
+  transaction.AddImuStateVariables(imu_state);
+  sendTransaction(transaction.GetTransaction());
+}
+
+bool SLAMInitialization::GetTriangulationRequest(
+    const uint64_t lm_id, vision::BatchTriangulator::Request& request,
+    Eigen::Vector3d& average_viewing_angle, uint64_t& visual_word_id) {
   std::vector<Eigen::Vector3d, beam::AlignVec3d> viewing_angles;
   std::vector<uint64_t> word_ids;
 
@@ -650,8 +990,8 @@ beam::opt<Eigen::Vector3d> SLAMInitialization::TriangulateLandmark(
       Eigen::Matrix4d T_WORLD_CAMERA =
           beam::InvertTransform(T_camera_world.value());
 
-      pixels.push_back(pixel_i);
-      T_cam_world_v.push_back(T_WORLD_CAMERA);
+      request.pixels.push_back(pixel_i);
+      request.T_cam_world.push_back(T_WORLD_CAMERA);
 
       if (params_.local_map_matching) {
         Eigen::Vector3d bearing_cam;
@@ -661,12 +1001,12 @@ beam::opt<Eigen::Vector3d> SLAMInitialization::TriangulateLandmark(
               (T_WORLD_CAMERA * bearing_cam.homogeneous()).hnormalized();
           viewing_angles.push_back(bearing_world);
           // compute word id
-          word_ids.push_back(image_db_->GetWordID(m.descriptor));
+          word_ids.push_back(image_db_.get()->GetWordID(m.descriptor));
         }
       }
     }
   }
-  if (T_cam_world_v.size() >= 2) {
+  if (request.T_cam_world.size() >= 2) {
     if (params_.local_map_matching) {
       // compute average viewing angle
       average_viewing_angle = Eigen::Vector3d::Zero();
@@ -695,26 +1035,26 @@ beam::opt<Eigen::Vector3d> SLAMInitialization::TriangulateLandmark(
       average_viewing_angle = Eigen::Vector3d::Zero();
       visual_word_id = 0;
     }
-
-    return beam_cv::Triangulation::TriangulatePoint(
-        cam_model_, T_cam_world_v, pixels, params_.max_triangulation_distance,
-        params_.max_triangulation_reprojection);
+    return true;
   }
-  return {};
+  return false;
+}
+
+void SLAMInitialization::UpdateLocalGraph(
+    const fuse_core::Transaction& transaction) {
+  local_graph_->update(transaction);
+  init_batch_.Merge(transaction);
 }
 
 void SLAMInitialization::SendInitializationGraph() {
   const auto first_stamp = beam::NSecToRos(init_path_.begin()->first);
-  auto transaction = fuse_core::Transaction::make_shared();
-  transaction->stamp(first_stamp);
-  // add each variable
+  // the constraints of all transactions applied to the local graph are sent
+  // with each variable at its optimized value, which replaces the one first
+  // added. Duplicates are only resolved once, when building the transaction
   for (auto& var : local_graph_->getVariables()) {
-    transaction->addVariable(std::move(var.clone()));
-  }
-  // add each constraint in the graph
-  for (auto& constraint : local_graph_->getConstraints()) {
-    transaction->addConstraint(std::move(constraint.clone()));
+    init_batch_.AddVariable(var.clone(), true);
   }
+  auto transaction = init_batch_.ToTransaction(first_stamp);
   // send transaction to fuse optimizer
   sendTransaction(transaction);
 }
@@ -750,6 +1090,38 @@ void SLAMInitialization::OutputResults() {
   out_graph_file << ss2.rdbuf();
   out_graph_file.close();
 
+  // output inertial alignment summary
+  const std::string alignment_method =
+      alignment_summary_.method == bs_models::imu::AlignmentMethod::CLOSED_FORM
+          ? "CLOSED_FORM"
+          : "QR";
+  BEAM_INFO("Inertial alignment ({}): solve time {}s, rms position residual "
+            "{}m, rms velocity residual {}m/s, unconstrained gravity norm {}",
+            alignment_method, alignment_summary_.solve_time_s,
+            alignment_summary_.rms_position_residual,
+            alignment_summary_.rms_velocity_residual,
+            alignment_summary_.unconstrained_gravity_norm);
+  std::ofstream out_alignment_file(
+      beam::CombinePaths({save_path, "inertial_alignment.txt"}));
+  out_alignment_file << "method: " << alignment_method << "\n"
+                     << "success: " << alignment_summary_.success << "\n"
+                     << "num_frames: " << alignment_summary_.num_frames << "\n"
+                     << "solve_time_s: " << alignment_summary_.solve_time_s
+                     << "\n"
+                     << "refinement_iterations: "
+                     << alignment_summary_.refinement_iterations << "\n"
+                     << "unconstrained_gravity_norm: "
+                     << alignment_summary_.unconstrained_gravity_norm << "\n"
+                     << "rms_position_residual_m: "
+                     << alignment_summary_.rms_position_residual << "\n"
+                     << "rms_velocity_residual_mps: "
+                     << alignment_summary_.rms_velocity_residual << "\n"
+                     << "scale: " << scale_ << "\n"
+                     << "gravity: " << gravity_.transpose() << "\n"
+                     << "gyro_bias: " << bg_.transpose() << "\n"
+                     << "accel_bias: " << ba_.transpose() << "\n";
+  out_alignment_file.close();
+
   // output trajectory
   auto traj_cloud = bs_common::TrajectoryToCloud(init_path_);
   std::string traj_path =
@@ -842,21 +1214,18 @@ void SLAMInitialization::AddMeasurementsToContainer(
   std::map<uint64_t, Eigen::Vector2d> cur_undistorted_measurements;
 
   // put all measurements into landmark container
-  for (const auto& lm : msg->landmarks) {
-    Eigen::Vector2d landmark(static_cast<double>(lm.pixel_u),
-                             static_cast<double>(lm.pixel_v));
-    const cv::Mat landmark_descriptor =
-        beam_cv::Descriptor::VectorDescriptorToCvMat({lm.descriptor.data},
-                                                     msg->descriptor_type);
+  const vision::CameraMeasurementView measurements(*msg);
+  for (size_t i = 0; i < measurements.Size(); i++) {
+    const uint64_t id = measurements.LandmarkId(i);
+    const Eigen::Vector2d landmark = measurements.Pixel(i);
     beam_containers::LandmarkMeasurement lm_measurement(
-        msg->header.stamp, msg->sensor_id, lm.landmark_id, msg->header.seq,
-        landmark, landmark_descriptor);
+        msg->header.stamp, msg->sensor_id, id, msg->header.seq, landmark,
+        measurements.Descriptor(i).clone());
     landmark_container_->Insert(lm_measurement);
 
     Eigen::Vector2i rectified_pixel;
     if (cam_model_->UndistortPixel(landmark.cast<int>(), rectified_pixel)) {
-      cur_undistorted_measurements.insert(
-          {lm.landmark_id, rectified_pixel.cast<double>()});
+      cur_undistorted_measurements.insert({id, rectified_pixel.cast<double>()});
     }
   }
 
@@ -915,18 +1284,21 @@ void SLAMInitialization::shutdown() {
   visual_measurement_subscriber_.shutdown();
   imu_subscriber_.shutdown();
   lidar_subscriber_.shutdown();
-  imu_buffer_.clear();
+  imu_buffer_.Clear();
   frame_init_buffer_.clear();
   local_graph_->clear();
   visual_map_->Clear();
   imu_preint_->Reset();
-  image_db_->Clear();
+  image_db_.get()->Clear();
   init_path_.clear();
   velocities_.clear();
   last_lidar_scan_time_s_ = 0;
   prev_frame_ = ros::Time(0);
   if (lidar_path_init_) { lidar_path_init_->Reset(); }
   landmark_container_->clear();
+  prior_map_ = {};
+  prior_map_attempts_ = 0;
+  stationary_imu_ = StationaryImuStatistics();
 }
 
 } // namespace bs_models
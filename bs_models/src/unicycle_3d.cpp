@@ -1,9 +1,8 @@
 #include <bs_models/unicycle_3d.h>
 
+#include <algorithm>
 #include <stdexcept>
 
-#include <boost/range/size.hpp>
-
 #include <fuse_variables/acceleration_linear_3d_stamped.h>
 #include <fuse_variables/orientation_3d_stamped.h>
 #include <fuse_variables/position_3d_stamped.h>
@@ -31,11 +30,6 @@ Unicycle3D::Unicycle3D()
                          ros::DURATION_MAX) {}
 
 bool Unicycle3D::applyCallback(fuse_core::Transaction& transaction) {
-  auto s =
-      boost::range_detail::range_calculate_size(transaction.addedConstraints());
-  auto v =
-      boost::range_detail::range_calculate_size(transaction.addedVariables());
-
   try {
     // Now actually generate the motion model segments
     timestamp_manager_.query(transaction, false);
@@ -51,7 +45,8 @@ bool Unicycle3D::applyCallback(fuse_core::Transaction& transaction) {
 }
 
 void Unicycle3D::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph) {
-  updateStateHistoryEstimates(*graph, state_history_, buffer_length_);
+  updateStateHistoryEstimates(bs_common::GraphView(graph), state_history_,
+                              buffer_length_);
 }
 
 void Unicycle3D::onInit() {
@@ -95,8 +90,8 @@ void Unicycle3D::generateMotionModel(
   StateHistoryElement base_state;
   ros::Time base_time;
 
-  auto base_state_pair_it = state_history_.upper_bound(beginning_stamp);
-  if (base_state_pair_it == state_history_.begin()) {
+  auto base_state_it = upperBound(state_history_, beginning_stamp);
+  if (base_state_it == state_history_.begin()) {
     ROS_WARN_STREAM_COND_NAMED(
         !state_history_.empty(), "UnicycleModel",
         "Unable to locate a state in this history "
@@ -104,9 +99,9 @@ void Unicycle3D::generateMotionModel(
             << beginning_stamp << ". Variables will all be initialized to 0.");
     base_time = beginning_stamp;
   } else {
-    --base_state_pair_it;
-    base_time = base_state_pair_it->first;
-    base_state = base_state_pair_it->second;
+    --base_state_it;
+    base_time = base_state_it->stamp;
+    base_state = *base_state_it;
   }
 
   StateHistoryElement state1;
@@ -166,8 +161,6 @@ void Unicycle3D::generateMotionModel(
   position1->data()[fuse_variables::Position3DStamped::Z] =
       state1.pose.getOrigin().z();
 
-  double roll1, pitch1, yaw1;
-  state1.pose.getBasis().getRPY(roll1, pitch1, yaw1);
   orientation1->data()[fuse_variables::Orientation3DStamped::X] =
       state1.pose.getRotation().x();
   orientation1->data()[fuse_variables::Orientation3DStamped::Y] =
@@ -205,8 +198,6 @@ void Unicycle3D::generateMotionModel(
   position2->data()[fuse_variables::Position3DStamped::Z] =
       state2.pose.getOrigin().z();
 
-  double roll2, pitch2, yaw2;
-  state2.pose.getBasis().getRPY(roll2, pitch2, yaw2);
   orientation2->data()[fuse_variables::Orientation3DStamped::X] =
       state2.pose.getRotation().x();
   orientation2->data()[fuse_variables::Orientation3DStamped::Y] =
@@ -249,8 +240,10 @@ void Unicycle3D::generateMotionModel(
   state2.vel_angular_uuid = velocity_angular2->uuid();
   state2.acc_linear_uuid = acceleration_linear2->uuid();
 
-  state_history_.emplace(beginning_stamp, std::move(state1));
-  state_history_.emplace(ending_stamp, std::move(state2));
+  state1.stamp = beginning_stamp;
+  state2.stamp = ending_stamp;
+  insertState(state_history_, std::move(state1));
+  insertState(state_history_, std::move(state2));
 
   // Create the constraints for this motion model segment
   auto constraint =
@@ -274,85 +267,96 @@ void Unicycle3D::generateMotionModel(
   variables.push_back(acceleration_linear2);
 }
 
+Unicycle3D::StateHistory::iterator
+    Unicycle3D::upperBound(StateHistory& state_history,
+                           const ros::Time& stamp) {
+  return std::upper_bound(
+      state_history.begin(), state_history.end(), stamp,
+      [](const ros::Time& t, const StateHistoryElement& state) {
+        return t < state.stamp;
+      });
+}
+
+void Unicycle3D::insertState(StateHistory& state_history,
+                             StateHistoryElement&& state) {
+  // states are almost always added at the end
+  if (state_history.empty() || state_history.back().stamp < state.stamp) {
+    state_history.push_back(std::move(state));
+    return;
+  }
+  auto it = std::lower_bound(
+      state_history.begin(), state_history.end(), state.stamp,
+      [](const StateHistoryElement& s, const ros::Time& t) {
+        return s.stamp < t;
+      });
+  if (it != state_history.end() && it->stamp == state.stamp) { return; }
+  state_history.insert(it, std::move(state));
+}
+
 void Unicycle3D::updateStateHistoryEstimates(
-    const fuse_core::Graph& graph, StateHistory& state_history,
+    const bs_common::GraphView& graph_view, StateHistory& state_history,
     const ros::Duration& buffer_length) {
   if (state_history.empty()) { return; }
 
   ros::Time expiration_time;
 
   // ROS can't handle negative times
-  if (state_history.rbegin()->first.toSec() < buffer_length.toSec()) {
+  if (state_history.back().stamp.toSec() < buffer_length.toSec()) {
     expiration_time = ros::Time(0);
   } else {
-    expiration_time = state_history.rbegin()->first - buffer_length;
+    expiration_time = state_history.back().stamp - buffer_length;
   }
 
-  auto current_iter = state_history.begin();
-
   // always keep at least one entry in the buffer
-  while (state_history.size() > 1 && current_iter->first < expiration_time) {
-    current_iter = state_history.erase(current_iter);
-  }
+  auto expired_end = std::lower_bound(
+      state_history.begin(), std::prev(state_history.end()), expiration_time,
+      [](const StateHistoryElement& s, const ros::Time& t) {
+        return s.stamp < t;
+      });
+  state_history.erase(state_history.begin(), expired_end);
+
+  // returns the variable if it is in the graph and is the one the state was
+  // created with (the view is indexed by stamp only)
+  auto get = [](const auto* variable, const fuse_core::UUID& uuid) {
+    return variable && variable->uuid() == uuid ? variable : nullptr;
+  };
 
   // Update the states in the state history with information from the graph
   // If a state is not in the graph yet, predict the state in question from the
   // closest previous state
   for (auto current_iter = state_history.begin();
        current_iter != state_history.end(); ++current_iter) {
-    const auto& current_stamp = current_iter->first;
-    auto& current_state = current_iter->second;
-    if (graph.variableExists(current_state.position_uuid) &&
-        graph.variableExists(current_state.orientation_uuid) &&
-        graph.variableExists(current_state.vel_linear_uuid) &&
-        graph.variableExists(current_state.vel_angular_uuid) &&
-        graph.variableExists(current_state.acc_linear_uuid)) {
+    const auto& current_stamp = current_iter->stamp;
+    auto& current_state = *current_iter;
+    const auto* position = get(graph_view.GetPosition(current_stamp),
+                               current_state.position_uuid);
+    const auto* orientation = get(graph_view.GetOrientation(current_stamp),
+                                  current_state.orientation_uuid);
+    const auto* vel_linear = get(graph_view.GetVelocity(current_stamp),
+                                 current_state.vel_linear_uuid);
+    const auto* vel_angular = get(graph_view.GetAngularVelocity(current_stamp),
+                                  current_state.vel_angular_uuid);
+    const auto* acc_linear =
+        get(graph_view.GetLinearAcceleration(current_stamp),
+            current_state.acc_linear_uuid);
+    if (position && orientation && vel_linear && vel_angular && acc_linear) {
       // This pose does exist in the graph. Update it directly.
-      const auto& position = graph.getVariable(current_state.position_uuid);
-      const auto& orientation =
-          graph.getVariable(current_state.orientation_uuid);
-      const auto& vel_linear = graph.getVariable(current_state.vel_linear_uuid);
-      const auto& vel_angular =
-          graph.getVariable(current_state.vel_angular_uuid);
-      const auto& acc_linear = graph.getVariable(current_state.acc_linear_uuid);
-
       current_state.pose.setOrigin(
-          tf2::Vector3{position.data()[fuse_variables::Position3DStamped::X],
-                       position.data()[fuse_variables::Position3DStamped::Y],
-                       position.data()[fuse_variables::Position3DStamped::Z]});
+          tf2::Vector3{position->x(), position->y(), position->z()});
 
       // tf2::Quaternion assumes a (x,y,z,w) input
-      current_state.pose.setRotation(tf2::Quaternion{
-          orientation.data()[fuse_variables::Orientation3DStamped::X],
-          orientation.data()[fuse_variables::Orientation3DStamped::Y],
-          orientation.data()[fuse_variables::Orientation3DStamped::Z],
-          orientation.data()[fuse_variables::Orientation3DStamped::W]});
-
-      current_state.velocity_linear.setX(
-          vel_linear.data()[fuse_variables::VelocityLinear3DStamped::X]);
-      current_state.velocity_linear.setY(
-          vel_linear.data()[fuse_variables::VelocityLinear3DStamped::Y]);
-      current_state.velocity_linear.setZ(
-          vel_linear.data()[fuse_variables::VelocityLinear3DStamped::Z]);
-
-      current_state.velocity_angular.setX(
-          vel_angular.data()[fuse_variables::VelocityAngular3DStamped::ROLL]);
-      current_state.velocity_angular.setY(
-          vel_angular.data()[fuse_variables::VelocityAngular3DStamped::PITCH]);
-      current_state.velocity_angular.setZ(
-          vel_angular.data()[fuse_variables::VelocityAngular3DStamped::YAW]);
-
-      current_state.acceleration_linear.setX(
-          acc_linear.data()[fuse_variables::AccelerationLinear3DStamped::X]);
-      current_state.acceleration_linear.setY(
-          acc_linear.data()[fuse_variables::AccelerationLinear3DStamped::Y]);
-      current_state.acceleration_linear.setZ(
-          acc_linear.data()[fuse_variables::AccelerationLinear3DStamped::Z]);
-
+      current_state.pose.setRotation(
+          tf2::Quaternion{orientation->x(), orientation->y(), orientation->z(),
+                          orientation->w()});
+
+      current_state.velocity_linear.setValue(
+          vel_linear->x(), vel_linear->y(), vel_linear->z());
+      current_state.velocity_angular.setValue(
+          vel_angular->roll(), vel_angular->pitch(), vel_angular->yaw());
+      current_state.acceleration_linear.setValue(
+          acc_linear->x(), acc_linear->y(), acc_linear->z());
     } else if (current_iter != state_history.begin()) {
-      auto previous_iter = std::prev(current_iter);
-      const auto& previous_stamp = previous_iter->first;
-      const auto& previous_state = previous_iter->second;
+      const auto& previous_state = *std::prev(current_iter);
 
       // This state is not in the graph yet, so we can't update/correct the
       // value in our state history. However, the state *before* this one may
@@ -362,16 +366,11 @@ void Unicycle3D::updateStateHistoryEstimates(
       bs_constraints::predict(
           previous_state.pose, previous_state.velocity_linear,
           previous_state.velocity_angular, previous_state.acceleration_linear,
-          (current_stamp - previous_stamp).toSec(), current_state.pose,
+          (current_stamp - previous_state.stamp).toSec(), current_state.pose,
           current_state.velocity_linear, current_state.velocity_angular,
           current_state.acceleration_linear);
-
-      double roll1, pitch1, yaw1;
-      previous_state.pose.getBasis().getRPY(roll1, pitch1, yaw1);
-      double roll2, pitch2, yaw2;
-      current_state.pose.getBasis().getRPY(roll2, pitch2, yaw2);
     }
   }
 }
 
-} // namespace bs_models
+} // namespace bs_models
\ No newline at end of file
@@ -1,26 +1,52 @@
 #include <bs_models/visual_feature_tracker.h>
+#include <boost/make_shared.hpp>
+#include <opencv2/imgcodecs.hpp>
 #include <pluginlib/class_list_macros.h>
 
 #include <beam_cv/OpenCVConversions.h>
 #include <beam_cv/Utils.h>
 #include <beam_cv/descriptors/ORBDescriptor.h>
 #include <beam_cv/detectors/FASTSSCDetector.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/startup_profiler.h>
 #include <bs_common/utils.h>
+#include <bs_models/vision/camera_measurement_view.h>
+#include <bs_models/vision/camera_rig.h>
 
 #include <algorithm>
+#include <chrono>
+#include <stdexcept>
 
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::VisualFeatureTracker, fuse_core::SensorModel);
 
 namespace bs_models {
 
+namespace {
+
+// time pipeline threads sleep for when their input queue is empty or their
+// output queue is full, this is short compared to the time between images
+void WaitForQueue() {
+  std::this_thread::sleep_for(std::chrono::microseconds(500));
+}
+
+} // namespace
+
 VisualFeatureTracker::VisualFeatureTracker()
     : fuse_core::AsyncSensorModel(1),
       device_id_(fuse_core::uuid::NIL),
       throttled_image_callback_(std::bind(&VisualFeatureTracker::processImage,
-                                          this, std::placeholders::_1)) {}
+                                          this, std::placeholders::_1)),
+      throttled_compressed_image_callback_(
+          std::bind(&VisualFeatureTracker::processCompressedImage, this,
+                    std::placeholders::_1)) {}
+
+VisualFeatureTracker::~VisualFeatureTracker() {
+  StopPipeline();
+}
 
 void VisualFeatureTracker::onInit() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_init");
   // Read settings from the parameter sever
   device_id_ = fuse_variables::loadDeviceId(private_node_handle_);
   params_.loadFromROS(private_node_handle_);
@@ -37,22 +63,65 @@ void VisualFeatureTracker::onInit() {
       std::make_shared<beam_cv::FASTSSCDetector>(detector_params);
 
   // Initialize tracker
+  if (params_.tracker_backend == "CUDA") {
+    if (vision::GpuFeatureTracker::Available()) {
+      vision::GpuFeatureTracker::Params gpu_params;
+      gpu_params.LoadFromJson(params_.tracker_config, params_.detector_config,
+                              params_.descriptor_config);
+      gpu_tracker_ = std::make_unique<vision::GpuFeatureTracker>(gpu_params, 3);
+    } else {
+      ROS_WARN("CUDA feature tracker is not available, using CPU tracker.");
+    }
+  } else if (params_.tracker_backend != "CPU") {
+    ROS_ERROR("Invalid tracker backend: %s, options: CPU, CUDA. Using CPU.",
+              params_.tracker_backend.c_str());
+  }
   beam_cv::KLTracker::Params tracker_params;
   tracker_params.LoadFromJson(params_.tracker_config);
   tracker_ = std::make_shared<beam_cv::KLTracker>(tracker_params, detector,
                                                   descriptor_, 3);
+
+  if (params_.image_transport != "raw" &&
+      params_.image_transport != "compressed") {
+    ROS_ERROR("Invalid image transport: %s, options: raw, compressed. Using "
+              "raw.",
+              params_.image_transport.c_str());
+    params_.image_transport = "raw";
+  }
+
+  if (params_.use_pipeline) {
+    preprocess_pool_ =
+        std::make_unique<bs_common::ThreadPool>(params_.num_preprocess_threads);
+  }
 }
 
 void VisualFeatureTracker::onStart() {
-  // subscribe to image topic
-  image_subscriber_ = private_node_handle_.subscribe<sensor_msgs::Image>(
-      ros::names::resolve(params_.image_topic), 10,
-      &ThrottledImageCallback::callback, &throttled_image_callback_,
-      ros::TransportHints().tcpNoDelay(false));
+  // subscribe to image topic, compressed images are published by
+  // image_transport on a subtopic of the raw images
+  if (params_.image_transport == "compressed") {
+    image_subscriber_ =
+        private_node_handle_.subscribe<sensor_msgs::CompressedImage>(
+            ros::names::resolve(params_.image_topic) + "/compressed", 10,
+            &ThrottledCompressedImageCallback::callback,
+            &throttled_compressed_image_callback_,
+            ros::TransportHints().tcpNoDelay(false));
+  } else {
+    image_subscriber_ = private_node_handle_.subscribe<sensor_msgs::Image>(
+        ros::names::resolve(params_.image_topic), 10,
+        &ThrottledImageCallback::callback, &throttled_image_callback_,
+        ros::TransportHints().tcpNoDelay(false));
+  }
 
   measurement_publisher_ =
       private_node_handle_.advertise<bs_common::CameraMeasurementMsg>(
-          "/feature_tracker/visual_measurements", 5);
+          params_.measurement_topic, 5);
+
+  if (params_.use_pipeline) { StartPipeline(); }
+}
+
+void VisualFeatureTracker::onStop() {
+  image_subscriber_.shutdown();
+  StopPipeline();
 }
 
 /************************************************************
@@ -60,55 +129,269 @@ void VisualFeatureTracker::onStart() {
  ************************************************************/
 void VisualFeatureTracker::processImage(
     const sensor_msgs::Image::ConstPtr& msg) {
+  auto image = std::make_shared<PreprocessedImage>();
+  image->header = msg->header;
+  image->msg = msg;
+  HandleImage(std::move(image));
+}
+
+void VisualFeatureTracker::processCompressedImage(
+    const sensor_msgs::CompressedImage::ConstPtr& msg) {
+  auto image = std::make_shared<PreprocessedImage>();
+  image->header = msg->header;
+  image->compressed_msg = msg;
+  HandleImage(std::move(image));
+}
+
+void VisualFeatureTracker::HandleImage(
+    std::shared_ptr<PreprocessedImage> image) {
+  if (params_.use_pipeline) {
+    QueueImage(std::move(image));
+    return;
+  }
+
   // track features in image
-  cv::Mat image = beam_cv::OpenCVConversions::RosImgToMat(*msg);
-  cv::Mat clahe_image = beam_cv::AdaptiveHistogram(image);
-  tracker_->AddImage(clahe_image, msg->header.stamp);
+  try {
+    PreprocessImage(*image);
+  } catch (const std::exception& e) {
+    ROS_ERROR("Failed to preprocess image with stamp %f: %s",
+              image->header.stamp.toSec(), e.what());
+    return;
+  }
+  std::vector<TrackedImage> tracked;
+  TrackImage(*image, tracked);
+  for (const auto& t : tracked) {
+    measurement_publisher_.publish(BuildCameraMeasurement(t));
+  }
+}
+
+void VisualFeatureTracker::PreprocessImage(PreprocessedImage& image) {
+  if (image.msg) {
+    image.image = beam_cv::AdaptiveHistogram(
+        beam_cv::OpenCVConversions::RosImgToMat(*image.msg));
+    return;
+  }
+
+  // JPEG images are decoded to their luma channel only, which skips the
+  // chroma upsampling and color conversion of a full decode
+  const cv::Mat gray =
+      cv::imdecode(image.compressed_msg->data, cv::IMREAD_GRAYSCALE);
+  if (gray.empty()) {
+    throw std::runtime_error{"cannot decode compressed image of format " +
+                             image.compressed_msg->format};
+  }
+  image.image = beam_cv::AdaptiveHistogram(gray);
+}
+
+void VisualFeatureTracker::TrackImage(const PreprocessedImage& image,
+                                      std::vector<TrackedImage>& tracked) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "visual_feature_tracker/track");
+  bs_common::ScopedTimer timer(metric);
+
+  tracked.clear();
+  const ros::Time& stamp = image.header.stamp;
+  if (gpu_tracker_) {
+    gpu_tracker_->AddImage(image.image, stamp);
+  } else {
+    tracker_->AddImage(image.image, stamp);
+  }
+
+  if (params_.publish_immediately) {
+    // publish what this image added to the previous one, then this image
+    if (prev_time_ != ros::Time(0)) {
+      TrackedImage update;
+      GetTracks(prev_time_, update, prev_published_ids_);
+      if (!update.landmark_ids.empty()) {
+        update.update = true;
+        tracked.push_back(std::move(update));
+      }
+    }
+    TrackedImage current;
+    GetTracks(stamp, current);
+    current.msg = image.msg;
+    current.compressed_msg = image.compressed_msg;
+    prev_published_ids_ = std::unordered_set<uint64_t>(
+        current.landmark_ids.begin(), current.landmark_ids.end());
+    tracked.push_back(std::move(current));
+    prev_time_ = stamp;
+    return;
+  }
 
   // delay publishing by one image to ensure that the tracks are actually
   // published
   if (prev_time_ == ros::Time(0)) {
-    prev_time_ = msg->header.stamp;
+    prev_time_ = stamp;
     return;
   }
 
-  const auto measurement_msg = BuildCameraMeasurement(prev_time_, *msg);
-  measurement_publisher_.publish(measurement_msg);
-  prev_time_ = msg->header.stamp;
+  TrackedImage previous;
+  GetTracks(prev_time_, previous);
+  previous.msg = image.msg;
+  previous.compressed_msg = image.compressed_msg;
+  tracked.push_back(std::move(previous));
+  prev_time_ = stamp;
+}
+
+void VisualFeatureTracker::GetTracks(
+    const ros::Time& stamp, TrackedImage& tracked,
+    const std::unordered_set<uint64_t>& exclude) const {
+  tracked.timestamp = stamp;
+  tracked.landmark_ids.clear();
+  tracked.descriptors.clear();
+  tracked.pixels.clear();
+  const std::vector<uint64_t> ids =
+      gpu_tracker_ ? gpu_tracker_->GetLandmarkIDsInImage(stamp)
+                   : tracker_->GetLandmarkIDsInImage(stamp);
+  for (const auto& id : ids) {
+    // make the ids unique across the cameras of a rig
+    const uint64_t global_id =
+        vision::CameraRig::GlobalLandmarkId(params_.sensor_id, id);
+    if (exclude.find(global_id) != exclude.end()) { continue; }
+    tracked.landmark_ids.push_back(global_id);
+    if (gpu_tracker_) {
+      tracked.descriptors.push_back(gpu_tracker_->GetDescriptor(stamp, id));
+      tracked.pixels.push_back(gpu_tracker_->Get(stamp, id));
+    } else {
+      tracked.descriptors.push_back(tracker_->GetDescriptor(stamp, id));
+      tracked.pixels.push_back(tracker_->Get(stamp, id));
+    }
+  }
 }
 
 bs_common::CameraMeasurementMsg VisualFeatureTracker::BuildCameraMeasurement(
-    const ros::Time& timestamp, const sensor_msgs::Image& image) {
+    const TrackedImage& tracked) {
   static uint64_t measurement_id = 0;
-  // build landmark measurements msg
-  std::vector<bs_common::LandmarkMeasurementMsg> landmarks;
-  std::vector<uint64_t> landmark_ids =
-      tracker_->GetLandmarkIDsInImage(timestamp);
-  for (auto& id : landmark_ids) {
-    bs_common::LandmarkMeasurementMsg lm;
-    lm.landmark_id = id;
-    const cv::Mat descriptor = tracker_->GetDescriptor(timestamp, id);
-    lm.descriptor.descriptor_type = descriptor_->GetTypeString();
-    lm.descriptor.data = beam_cv::Descriptor::CvMatDescriptorToVector(
-        descriptor, descriptor_->GetType());
-    Eigen::Vector2d pixel = tracker_->Get(timestamp, id);
-    lm.pixel_u = pixel[0];
-    lm.pixel_v = pixel[1];
-    landmarks.push_back(lm);
-  }
 
   // build camera measurement msg
   bs_common::CameraMeasurementMsg camera_measurement;
-  camera_measurement.header.seq = measurement_id++;
-  camera_measurement.header.stamp = timestamp;
-  camera_measurement.header.frame_id = extrinsics_.GetCameraFrameId();
+  // updates are published right after the measurement they update
+  camera_measurement.header.seq =
+      tracked.update ? measurement_id - 1 : measurement_id++;
+  camera_measurement.header.stamp = tracked.timestamp;
+  camera_measurement.header.frame_id = params_.camera_frame.empty()
+                                            ? extrinsics_.GetCameraFrameId()
+                                            : params_.camera_frame;
 
   camera_measurement.descriptor_type = descriptor_->GetTypeString();
   camera_measurement.sensor_id = params_.sensor_id;
-  camera_measurement.image = image;
-  camera_measurement.landmarks = landmarks;
+  camera_measurement.update = tracked.update;
+  if (tracked.msg) { camera_measurement.image = *tracked.msg; }
+  if (tracked.compressed_msg) {
+    camera_measurement.compressed_image = *tracked.compressed_msg;
+  }
+
+  if (params_.pack_measurements) {
+    vision::PackLandmarkMeasurements(tracked.landmark_ids, tracked.descriptors,
+                                     tracked.pixels, camera_measurement);
+    return camera_measurement;
+  }
+
+  // build landmark measurements msg
+  camera_measurement.landmarks.reserve(tracked.landmark_ids.size());
+  for (size_t i = 0; i < tracked.landmark_ids.size(); i++) {
+    bs_common::LandmarkMeasurementMsg lm;
+    lm.landmark_id = tracked.landmark_ids[i];
+    lm.descriptor.descriptor_type = descriptor_->GetTypeString();
+    lm.descriptor.data = beam_cv::Descriptor::CvMatDescriptorToVector(
+        tracked.descriptors[i], descriptor_->GetType());
+    lm.pixel_u = tracked.pixels[i][0];
+    lm.pixel_v = tracked.pixels[i][1];
+    camera_measurement.landmarks.push_back(lm);
+  }
   // return message
   return camera_measurement;
 }
 
+/************************************************************
+ *                          Pipeline                        *
+ ************************************************************/
+void VisualFeatureTracker::QueueImage(
+    std::shared_ptr<PreprocessedImage> image) {
+  static bs_common::Metric& dropped_metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "visual_feature_tracker/dropped_images");
+  if (!pipeline_running_) { return; }
+
+  // the callback is the only producer, so the queue can't fill up between
+  // this check and the push
+  if (pending_images_->Full()) {
+    dropped_metric.Increment();
+    ROS_WARN_THROTTLE(1, "Visual feature tracker pipeline is full, dropping "
+                         "image with stamp: %f",
+                      image->header.stamp.toSec());
+    return;
+  }
+
+  PendingImage pending;
+  pending.image = image;
+  pending.done =
+      preprocess_pool_->Enqueue([image]() { PreprocessImage(*image); });
+  pending_images_->TryPush(std::move(pending));
+}
+
+void VisualFeatureTracker::StartPipeline() {
+  if (pipeline_running_) { return; }
+  const size_t queue_size = std::max(params_.pipeline_queue_size, 1);
+  pending_images_ =
+      std::make_unique<bs_common::SPSCQueue<PendingImage>>(queue_size);
+  tracked_images_ =
+      std::make_unique<bs_common::SPSCQueue<TrackedImage>>(queue_size);
+  pipeline_running_ = true;
+  tracker_thread_ = std::thread(&VisualFeatureTracker::RunTracker, this);
+  publisher_thread_ = std::thread(&VisualFeatureTracker::RunPublisher, this);
+}
+
+void VisualFeatureTracker::StopPipeline() {
+  pipeline_running_ = false;
+  if (tracker_thread_.joinable()) { tracker_thread_.join(); }
+  if (publisher_thread_.joinable()) { publisher_thread_.join(); }
+}
+
+void VisualFeatureTracker::RunTracker() {
+  PendingImage pending;
+  while (pipeline_running_) {
+    if (!pending_images_->TryPop(pending)) {
+      WaitForQueue();
+      continue;
+    }
+
+    // images are preprocessed in parallel but tracked in the order received
+    try {
+      pending.done.get();
+    } catch (const std::exception& e) {
+      ROS_ERROR("Failed to preprocess image with stamp %f: %s",
+                pending.image->header.stamp.toSec(), e.what());
+      continue;
+    }
+
+    std::vector<TrackedImage> tracked;
+    TrackImage(*pending.image, tracked);
+
+    // wait for the publisher instead of dropping, tracks are already in the
+    // tracker so dropping here would lose measurements
+    for (auto& t : tracked) {
+      while (pipeline_running_ && !tracked_images_->TryPush(std::move(t))) {
+        WaitForQueue();
+      }
+    }
+  }
+}
+
+void VisualFeatureTracker::RunPublisher() {
+  TrackedImage tracked;
+  while (pipeline_running_) {
+    if (!tracked_images_->TryPop(tracked)) {
+      WaitForQueue();
+      continue;
+    }
+    // published as a shared pointer so that subscribers in the same process
+    // (e.g. visual odometry) receive it without serialization
+    measurement_publisher_.publish(
+        boost::make_shared<bs_common::CameraMeasurementMsg>(
+            BuildCameraMeasurement(tracked)));
+  }
+}
+
 } // namespace bs_models
\ No newline at end of file
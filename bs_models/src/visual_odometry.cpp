@@ -1,5 +1,8 @@
 #include <bs_models/visual_odometry.h>
 
+#include <algorithm>
+#include <filesystem>
+
 #include <pluginlib/class_list_macros.h>
 
 #include <fuse_core/transaction.h>
@@ -16,14 +19,22 @@
 #include <beam_cv/detectors/Detectors.h>
 #include <beam_cv/geometry/AbsolutePoseEstimator.h>
 #include <beam_cv/geometry/RelativePoseEstimator.h>
-#include <beam_cv/geometry/Triangulation.h>
 #include <beam_utils/pointclouds.h>
 
 #include <bs_common/conversions.h>
 #include <bs_common/graph_access.h>
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_common/reset_context.h>
+#include <bs_common/sampling_profiler.h>
+#include <bs_common/startup_profiler.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_constraints/inertial/absolute_imu_state_3d_stamped_constraint.h>
 #include <bs_constraints/visual/euclidean_reprojection_constraint.h>
 #include <bs_models/graph_visualization/helpers.h>
+#include <bs_models/vision/camera_measurement_view.h>
+#include <bs_models/vision/utils.h>
 
 // Register this sensor model with ROS as a plugin.
 PLUGINLIB_EXPORT_CLASS(bs_models::VisualOdometry, fuse_core::SensorModel)
@@ -39,18 +50,20 @@ VisualOdometry::VisualOdometry()
           &VisualOdometry::processMeasurements, this, std::placeholders::_1)) {}
 
 void VisualOdometry::onInit() {
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_init");
   // Read settings from the parameter sever
   device_id_ = fuse_variables::loadDeviceId(private_node_handle_);
   vo_params_.loadFromROS(private_node_handle_);
+  graph_update_lane_ = bs_common::CallbackLane<fuse_core::Graph>::FromROS(
+      private_node_handle_, "graph_update_lane", name() + "/graph_lane",
+      [this](const fuse_core::Graph::ConstSharedPtr& graph) {
+        onGraphUpdate(graph);
+      });
   calibration_params_.loadFromROS();
 
   // Load camera model and create visua map object
   cam_model_ = beam_calibration::CameraModel::Create(
       calibration_params_.cam_intrinsics_path);
-  cam_intrinsic_matrix_ = cam_model_->GetRectifiedModel()->GetIntrinsicMatrix();
-  cv::Mat K(3, 3, CV_32F);
-  cv::eigen2cv(cam_intrinsic_matrix_, K);
-  K_ = K;
 
   // create visual map
   bool use_online_calib_for_reproj_constraints =
@@ -59,17 +72,102 @@ void VisualOdometry::onInit() {
       name(), cam_model_, vo_params_.reprojection_loss,
       vo_params_.reprojection_information_weight,
       use_online_calib_for_reproj_constraints, false);
+  visual_map_->SetUsePooledAllocation(vo_params_.use_pooled_allocation);
+
+  // create the camera rig, the additional cameras have sensor ids 1, 2, ... in
+  // the order of the calibration params
+  camera_rig_ = std::make_shared<vision::CameraRig>();
+  Eigen::Matrix4d T_cam_baselink;
+  extrinsics_.GetT_CAMERA_BASELINK(T_cam_baselink);
+  camera_rig_->AddCamera(0, extrinsics_.GetCameraFrameId(), cam_model_,
+                         T_cam_baselink);
+  const auto& additional_frames = calibration_params_.additional_camera_frames;
+  for (size_t i = 0; i < additional_frames.size(); i++) {
+    auto cam_model = beam_calibration::CameraModel::Create(
+        calibration_params_.additional_cam_intrinsics_paths[i]);
+    cam_model->InitUndistortMap();
+    if (!extrinsics_.GetT_SENSOR_BASELINK(T_cam_baselink,
+                                          additional_frames[i])) {
+      ROS_ERROR("Unable to get baselink to camera transform for camera: %s",
+                additional_frames[i].c_str());
+      throw std::runtime_error("Unable to get baselink to camera transform.");
+    }
+    camera_rig_->AddCamera(i + 1, additional_frames[i], cam_model,
+                           T_cam_baselink);
+  }
+  if (vo_params_.additional_measurement_topics.size() + 1 !=
+      camera_rig_->Size()) {
+    ROS_ERROR("Number of additional measurement topics doesn't match the "
+              "number of additional cameras.");
+    throw std::runtime_error("Invalid additional measurement topics.");
+  }
+  visual_map_->SetCameraRig(camera_rig_);
+  keyframe_parallax_ = std::make_unique<vision::KeyframeParallax>(camera_rig_);
+  if (camera_rig_->Size() > 1) {
+    rig_pose_refiner_ = std::make_shared<vision::RigPoseRefinement>(
+        vision::RigPoseRefinement::Params());
+    frame_set_assembler_ = std::make_unique<vision::FrameSetAssembler>(
+        camera_rig_->Size(), ros::Duration(vo_params_.frame_set_tolerance));
+    if (vo_params_.local_map_matching) {
+      ROS_WARN("Local map matching only uses the primary camera of the rig.");
+    }
+  }
 
-  // local map matching stuff
-  image_db_ = std::make_shared<beam_cv::ImageDatabase>();
-  landmark_projection_mask_ = cv::Mat(
-      cam_model_->GetWidth(), cam_model_->GetHeight(), CV_8UC1, cv::Scalar(0));
+  // local map matching stuff. The vocabulary is loaded on the service thread
+  // so it doesn't delay startup, frames are quantized once it is loaded
+  bow_service_ = std::make_shared<vision::BowService>(
+      []() { return std::make_shared<beam_cv::ImageDatabase>(); },
+      name() + "/vocabulary");
+  max_view_angle_ = ComputeMaxViewAngle();
 
   // Initialize landmark measurement container
   landmark_container_ = std::make_shared<beam_containers::LandmarkContainer>();
 
+  // warm restart, the restarted feature trackers have new landmark ids so the
+  // restored landmarks are only found by local map matching
+  if (!vo_params_.checkpoint_path.empty()) {
+    if (!vo_params_.local_map_matching || vo_params_.use_idp) {
+      ROS_WARN("VO checkpoints require local_map_matching and euclidean "
+               "landmarks, not using checkpoints.");
+    } else {
+      if (vo_params_.checkpoint_period > 0) {
+        bs_common::AsyncWriter::Params writer_params;
+        writer_params.queue_size = 1;
+        writer_params.policy = bs_common::AsyncWriter::Policy::DROP;
+        checkpoint_writer_ = std::make_unique<bs_common::AsyncWriter>(
+            std::filesystem::path(vo_params_.checkpoint_path)
+                .parent_path()
+                .string(),
+            writer_params);
+      }
+      auto checkpoint = std::make_unique<vision::VOCheckpoint>();
+      if (vo_params_.restore_checkpoint &&
+          checkpoint->Load(vo_params_.checkpoint_path)) {
+        ROS_INFO_STREAM(name() << ": loaded VO checkpoint with "
+                               << checkpoint->keyframes.size()
+                               << " keyframes and "
+                               << checkpoint->landmarks.size()
+                               << " landmarks");
+        restored_checkpoint_ = std::move(checkpoint);
+      }
+    }
+  }
+
   // create pose refiner for motion only BA
   pose_refiner_ = std::make_shared<beam_cv::PoseRefinement>(0.02, true, 0.2);
+  triangulator_ = std::make_shared<vision::BatchTriangulator>(
+      cam_model_, vo_params_.triangulation_threads);
+  if (vo_params_.use_ransac_localization) {
+    vision::PnPRansac::Params ransac_params;
+    ransac_params.max_iterations = vo_params_.ransac_max_iterations;
+    ransac_params.inlier_threshold = vo_params_.ransac_inlier_threshold;
+    ransac_params.confidence = vo_params_.ransac_confidence;
+    // with a rig, each camera is estimated on its own
+    ransac_params.min_inliers = vo_params_.required_points_to_refine /
+                                static_cast<int>(camera_rig_->Size());
+    ransac_params.num_threads = vo_params_.localization_threads;
+    pnp_ransac_ = std::make_shared<vision::PnPRansac>(ransac_params);
+  }
   validator_ = std::make_shared<vision::VOLocalizationValidation>();
 
   // compute the max container size
@@ -92,9 +190,14 @@ void VisualOdometry::onInit() {
 
 void VisualOdometry::onStart() {
   ROS_INFO_STREAM("Starting: " << name());
-  // initialize frame init
-  frame_initializer_ = std::make_unique<bs_models::FrameInitializer>(
-      vo_params_.frame_initializer_config);
+  bs_common::ScopedStartupTimer startup_timer(name() + "/on_start");
+  // initialize frame init, which is kept on fast resets in the same world
+  // frame
+  if (!frame_initializer_ ||
+      !bs_common::ResetContext::GetInstance().KeepsWorldFrame()) {
+    frame_initializer_ = std::make_unique<bs_models::FrameInitializer>(
+        vo_params_.frame_initializer_config);
+  }
 
   // setup subscriber
   measurement_subscriber_ =
@@ -103,6 +206,20 @@ void VisualOdometry::onStart() {
           &ThrottledMeasurementCallback::callback,
           &throttled_measurement_callback_,
           ros::TransportHints().tcpNoDelay(false));
+  additional_measurement_subscribers_.clear();
+  for (size_t i = 0; i < vo_params_.additional_measurement_topics.size();
+       i++) {
+    boost::function<void(const bs_common::CameraMeasurementMsg::ConstPtr&)>
+        callback = [this, i](const bs_common::CameraMeasurementMsg::ConstPtr&
+                                 msg) { AddToFrameSet(msg, i + 1); };
+    additional_measurement_subscribers_.push_back(
+        private_node_handle_.subscribe<bs_common::CameraMeasurementMsg>(
+            ros::names::resolve(vo_params_.additional_measurement_topics[i]),
+            10, callback));
+  }
+  backpressure_subscriber_ = private_node_handle_.subscribe(
+      "/local_mapper/backpressure", 1, &VisualOdometry::BackpressureCallback,
+      this);
 
   // setup publishers
   reset_publisher_ =
@@ -120,24 +237,74 @@ void VisualOdometry::onStart() {
   camera_landmarks_publisher_ =
       private_node_handle_.advertise<sensor_msgs::PointCloud2>(
           "camera_landmarks", 10);
+  camera_landmark_updates_publisher_ =
+      private_node_handle_.advertise<sensor_msgs::PointCloud2>(
+          "camera_landmark_updates", 10);
 
   // get extrinsics
   extrinsics_.GetT_CAMERA_BASELINK(T_cam_baselink_);
   T_baselink_cam_ = beam::InvertTransform(T_cam_baselink_);
+  camera_rig_->SetExtrinsics(0, T_cam_baselink_);
 }
 
 void VisualOdometry::onStop() {
   ROS_INFO_STREAM("Stopping: " << name());
+  if (graph_update_lane_) { graph_update_lane_->Clear(); }
   shutdown();
 }
 
 void VisualOdometry::processMeasurements(
     const bs_common::CameraMeasurementMsg::ConstPtr& msg) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
   ROS_INFO_STREAM_ONCE(
       "VisualOdometry received VISUAL measurements: " << msg->header.stamp);
+  if (msg->update) {
+    AddMeasurementUpdate(*msg);
+    return;
+  }
+  if (frame_set_assembler_) {
+    AddToFrameSet(msg, 0);
+  } else {
+    ProcessFrameSet({msg});
+  }
+}
+
+void VisualOdometry::AddToFrameSet(
+    const bs_common::CameraMeasurementMsg::ConstPtr& msg, size_t camera) {
+  const vision::RigCamera& rig_camera = camera_rig_->Camera(camera);
+  if (msg->sensor_id != rig_camera.sensor_id) {
+    ROS_ERROR_THROTTLE(10.0,
+                       "Measurements of camera %s have sensor id %d instead "
+                       "of %d, check the sensor_id of its feature tracker.",
+                       rig_camera.frame_id.c_str(), msg->sensor_id,
+                       rig_camera.sensor_id);
+    return;
+  }
+
+  // sets are processed while holding the lock, so they're processed in order
+  std::lock_guard<std::mutex> lk(frame_set_mutex_);
+  if (msg->update) {
+    AddMeasurementUpdate(*msg);
+    return;
+  }
+  const auto frame_set = frame_set_assembler_->Add(camera, msg);
+  if (frame_set) { ProcessFrameSet(frame_set.value()); }
+}
+
+void VisualOdometry::ProcessFrameSet(
+    const vision::FrameSetAssembler::FrameSet& frame_set) {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "visual_odometry/process_measurements");
+  bs_common::ScopedTimer timer(metric);
+
+  // restore before adding the first frame, so the restored keyframes are
+  // older than all frames in the container
+  const auto& msg = frame_set.front();
+  if (restored_checkpoint_) { RestoreCheckpoint(msg->header.stamp); }
 
   // add measurements to local container
-  AddMeasurementsToContainer(msg);
+  AddMeasurementsToContainer(frame_set);
 
   // buffer the message
   std::unique_lock<std::mutex> lk(buffer_mutex_);
@@ -146,6 +313,19 @@ void VisualOdometry::processMeasurements(
   // don't process until we have initialized
   if (!is_initialized_) { return; }
 
+  ProcessMeasurementBuffer();
+
+  // remove measurements from container if we are over the limit
+  while (landmark_container_->NumImages() > max_container_size_) {
+    bow_service_->RemoveFrame(
+        *landmark_container_->GetMeasurementTimes().begin());
+    landmark_container_->PopFront();
+  }
+  keyframe_parallax_->RemoveBefore(landmark_container_->FrontTimestamp());
+  UpdateMemoryAccounts();
+}
+
+void VisualOdometry::ProcessMeasurementBuffer() {
   while (!visual_measurement_buffer_.empty()) {
     // if we are currently resetting, don't process
     if (resetting_) { break; }
@@ -155,17 +335,23 @@ void VisualOdometry::processMeasurements(
     const auto current_msg = visual_measurement_buffer_.front();
     const auto success = ComputeOdometryAndExtendMap(current_msg);
 
-    // buffer frame if localization fails (only if frame init isnt caught up)
-    if (!success) { break; }
+    // buffer frame if localization fails (only if frame init isnt caught up),
+    // and retry as soon as it is instead of on the next frame
+    if (!success) {
+      const ros::Time& stamp = current_msg->header.stamp;
+      if (stamp > frame_initializer_->OdometryEndTime()) {
+        frame_initializer_->WakeWhenAvailable(
+            stamp, private_node_handle_.getCallbackQueue(), [this]() {
+              std::unique_lock<std::mutex> lk(buffer_mutex_);
+              if (is_initialized_) { ProcessMeasurementBuffer(); }
+            });
+      }
+      break;
+    }
 
     visual_measurement_buffer_.pop_front();
     ROS_DEBUG_STREAM("Frame processing time: " << timer.elapsed());
   }
-
-  // remove measurements from container if we are over the limit
-  while (landmark_container_->NumImages() > max_container_size_) {
-    landmark_container_->PopFront();
-  }
 }
 
 bool VisualOdometry::ComputeOdometryAndExtendMap(
@@ -193,6 +379,8 @@ bool VisualOdometry::ComputeOdometryAndExtendMap(
   ROS_DEBUG_STREAM("VisualOdometry: New keyframe detected at: " << timestamp);
   Keyframe kf(*msg);
   keyframes_.insert({timestamp, kf});
+  AddKeyframeObservations(timestamp);
+  if (vo_params_.local_map_matching) { bow_service_->AddToIndex(timestamp); }
 
   // extend existing map and add constraints
   ExtendMap(timestamp, T_WORLD_BASELINK, covariance);
@@ -200,8 +388,15 @@ bool VisualOdometry::ComputeOdometryAndExtendMap(
   // publish keyframe pose
   PublishPose(timestamp, T_WORLD_BASELINK);
 
+  if (checkpoint_writer_ && (timestamp - last_checkpoint_time_).toSec() >=
+                                vo_params_.checkpoint_period) {
+    SaveCheckpoint();
+    last_checkpoint_time_ = timestamp;
+  }
+
   // update previous keyframe time only after extending map
   previous_keyframe_ = timestamp;
+  keyframe_parallax_->SetKeyframe(timestamp);
 
   // send IO trigger
   if (vo_params_.trigger_inertial_odom_constraints) {
@@ -220,43 +415,29 @@ bool VisualOdometry::LocalizeFrame(const ros::Time& timestamp,
   std::string error;
   Eigen::Matrix4d T_WORLD_BASELINKcur;
   if (!GetInitialPoseEstimate(timestamp, T_WORLD_BASELINKcur)) { return false; }
+  if (FollowsRestoredKeyframe()) {
+    MatchRestoredLandmarks(timestamp, T_WORLD_BASELINKcur);
+  }
 
-  // get 2d-3d correspondences
-  std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
-  std::vector<Eigen::Vector3d, beam::AlignVec3d> points;
-  GetPixelPointPairs(timestamp, pixels, points);
+  // get 2d-3d correspondences of each camera
+  std::vector<vision::RigPoseRefinement::Correspondences> correspondences;
+  const size_t num_points = GetPixelPointPairs(timestamp, correspondences);
 
   // perform visual refinement
-  if (pixels.size() >= vo_params_.required_points_to_refine) {
+  if (num_points >= vo_params_.required_points_to_refine) {
     if (track_lost_) { track_lost_ = false; }
-    // get initial estimate in camera frame
-    Eigen::Matrix4d T_CAMERA_WORLD_est = beam::InvertTransform(
-        T_WORLD_BASELINKcur * beam::InvertTransform(T_cam_baselink_));
-
-    // perform non-linear pose refinement
-    Eigen::Matrix4d T_CAMERA_WORLD_ref = T_CAMERA_WORLD_est;
-    bool passed_refinement{true};
-    try {
-      auto out_covariance = std::make_shared<Eigen::Matrix<double, 6, 6>>();
-      T_CAMERA_WORLD_ref =
-          pose_refiner_->RefinePose(T_CAMERA_WORLD_est, cam_model_, pixels,
-                                    points, nullptr, out_covariance);
-      // reorder covariance to be x, y, z, roll, pitch, yaw
-      covariance.block<3, 3>(0, 0) = out_covariance->block<3, 3>(3, 3);
-      covariance.block<3, 3>(0, 3) = out_covariance->block<3, 3>(3, 0);
-      covariance.block<3, 3>(3, 0) = out_covariance->block<3, 3>(0, 3);
-      covariance.block<3, 3>(3, 3) = out_covariance->block<3, 3>(0, 0);
-    } catch (const std::runtime_error& re) { passed_refinement = false; }
-
-    // compute baselink pose
-    T_WORLD_BASELINK =
-        beam::InvertTransform(T_CAMERA_WORLD_ref) * T_cam_baselink_;
+    const bool passed_refinement =
+        camera_rig_->Size() == 1
+            ? RefineMonocular(correspondences[0], T_WORLD_BASELINKcur,
+                              T_WORLD_BASELINK, covariance)
+            : RefineRig(correspondences, T_WORLD_BASELINKcur,
+                        T_WORLD_BASELINK, covariance);
 
     // validate localization
     bool passed_localization{true};
     if (passed_refinement) {
       const double avg_reprojection =
-          ComputeAverageReprojection(T_WORLD_BASELINK, pixels, points);
+          ComputeAverageReprojection(T_WORLD_BASELINK, correspondences);
       const Eigen::Matrix4d T_init_refined =
           beam::InvertTransform(T_WORLD_BASELINKcur) * T_WORLD_BASELINK;
       passed_localization =
@@ -275,8 +456,7 @@ bool VisualOdometry::LocalizeFrame(const ros::Time& timestamp,
     }
 
   } else {
-    ROS_WARN_STREAM(
-        "Not enough points for visual refinement: " << pixels.size());
+    ROS_WARN_STREAM("Not enough points for visual refinement: " << num_points);
     T_WORLD_BASELINK = T_WORLD_BASELINKcur;
     track_lost_ = true;
     covariance = vo_params_.invalid_localization_covariance_weight *
@@ -300,6 +480,113 @@ bool VisualOdometry::LocalizeFrame(const ros::Time& timestamp,
   return true;
 }
 
+bool VisualOdometry::RefineMonocular(
+    vision::RigPoseRefinement::Correspondences& correspondences,
+    Eigen::Matrix4d& T_WORLD_BASELINK_init, Eigen::Matrix4d& T_WORLD_BASELINK,
+    Eigen::Matrix<double, 6, 6>& covariance) {
+  auto& pixels = correspondences.pixels;
+  auto& points = correspondences.points;
+
+  // get initial estimate in camera frame
+  Eigen::Matrix4d T_CAMERA_WORLD_est = beam::InvertTransform(
+      T_WORLD_BASELINK_init * beam::InvertTransform(T_cam_baselink_));
+
+  // robust estimate, which replaces the initial estimate if it better
+  // explains the correspondences. Only inliers are refined
+  if (pnp_ransac_) {
+    const auto ransac_result =
+        pnp_ransac_->Estimate(cam_model_, pixels, points, &T_CAMERA_WORLD_est);
+    if (ransac_result.success) {
+      if (!ransac_result.used_prior) {
+        T_CAMERA_WORLD_est = ransac_result.T_CAMERA_WORLD;
+        T_WORLD_BASELINK_init =
+            beam::InvertTransform(T_CAMERA_WORLD_est) * T_cam_baselink_;
+      }
+      std::vector<Eigen::Vector2i, beam::AlignVec2i> inlier_pixels;
+      std::vector<Eigen::Vector3d, beam::AlignVec3d> inlier_points;
+      for (const int i : ransac_result.inliers) {
+        inlier_pixels.push_back(pixels[i]);
+        inlier_points.push_back(points[i]);
+      }
+      pixels = std::move(inlier_pixels);
+      points = std::move(inlier_points);
+    }
+  }
+
+  // perform non-linear pose refinement
+  Eigen::Matrix4d T_CAMERA_WORLD_ref;
+  try {
+    auto out_covariance = std::make_shared<Eigen::Matrix<double, 6, 6>>();
+    T_CAMERA_WORLD_ref =
+        pose_refiner_->RefinePose(T_CAMERA_WORLD_est, cam_model_, pixels,
+                                  points, nullptr, out_covariance);
+    // reorder covariance to be x, y, z, roll, pitch, yaw
+    covariance.block<3, 3>(0, 0) = out_covariance->block<3, 3>(3, 3);
+    covariance.block<3, 3>(0, 3) = out_covariance->block<3, 3>(3, 0);
+    covariance.block<3, 3>(3, 0) = out_covariance->block<3, 3>(0, 3);
+    covariance.block<3, 3>(3, 3) = out_covariance->block<3, 3>(0, 0);
+  } catch (const std::runtime_error& re) { return false; }
+
+  // compute baselink pose
+  T_WORLD_BASELINK =
+      beam::InvertTransform(T_CAMERA_WORLD_ref) * T_cam_baselink_;
+  return true;
+}
+
+bool VisualOdometry::RefineRig(
+    std::vector<vision::RigPoseRefinement::Correspondences>& correspondences,
+    Eigen::Matrix4d& T_WORLD_BASELINK_init, Eigen::Matrix4d& T_WORLD_BASELINK,
+    Eigen::Matrix<double, 6, 6>& covariance) {
+  // robust estimate of each camera, with the initial estimate as prior
+  if (pnp_ransac_) {
+    std::vector<vision::PnPRansac::Result> results(camera_rig_->Size());
+    bs_common::TaskScheduler::GetInstance().ParallelFor(
+        bs_common::TaskPriority::REALTIME, camera_rig_->Size(), [&](size_t i) {
+          if (correspondences[i].pixels.empty()) { return; }
+          const vision::RigCamera& camera = camera_rig_->Camera(i);
+          const Eigen::Matrix4d T_CAMERA_WORLD_prior =
+              camera.T_cam_baselink *
+              beam::InvertTransform(T_WORLD_BASELINK_init);
+          results[i] = pnp_ransac_->Estimate(
+              camera.model, correspondences[i].pixels,
+              correspondences[i].points, &T_CAMERA_WORLD_prior);
+        });
+
+    // the estimate of the camera with the most inliers replaces the initial
+    // estimate if it better explains its correspondences. Only inliers are
+    // refined, and cameras without a robust estimate are left out unless no
+    // camera has one
+    int best = -1;
+    for (size_t i = 0; i < results.size(); i++) {
+      if (!results[i].success) { continue; }
+      if (best < 0 ||
+          results[i].inliers.size() > results[best].inliers.size()) {
+        best = static_cast<int>(i);
+      }
+    }
+    if (best >= 0) {
+      if (!results[best].used_prior) {
+        T_WORLD_BASELINK_init =
+            beam::InvertTransform(results[best].T_CAMERA_WORLD) *
+            camera_rig_->Camera(best).T_cam_baselink;
+      }
+      for (size_t i = 0; i < results.size(); i++) {
+        vision::RigPoseRefinement::Correspondences inliers;
+        for (const int j : results[i].inliers) {
+          inliers.pixels.push_back(correspondences[i].pixels[j]);
+          inliers.points.push_back(correspondences[i].points[j]);
+        }
+        correspondences[i] = std::move(inliers);
+      }
+    }
+  }
+
+  // refine the pose with all cameras at once
+  T_WORLD_BASELINK = T_WORLD_BASELINK_init;
+  return rig_pose_refiner_->Refine(*camera_rig_, correspondences,
+                                   T_WORLD_BASELINK, &covariance);
+}
+
 void VisualOdometry::ExtendMap(const ros::Time& timestamp,
                                const Eigen::Matrix4d& T_WORLD_BASELINK,
                                const Eigen::Matrix<double, 6, 6>& covariance) {
@@ -317,21 +604,24 @@ void VisualOdometry::ExtendMap(const ros::Time& timestamp,
   // project all current landmarks into current image and store as
   if (vo_params_.local_map_matching) { ProjectMapPoints(T_WORLD_BASELINK); }
 
-  // process each landmark
+  // process each landmark, all poses are in the map at this point so the
+  // constraints are added in one batch
+  vision::VisualConstraintBuilder builder(*visual_map_, transaction);
   const auto landmarks = landmark_container_->GetLandmarkIDsInImage(timestamp);
+  const auto new_landmarks = TriangulateNewLandmarks(landmarks);
   for (const auto id : landmarks) {
     if (vo_params_.use_idp) {
-      ProcessLandmarkIDP(id, timestamp, transaction);
+      ProcessLandmarkIDP(id, timestamp, new_landmarks, builder);
     } else {
-      ProcessLandmarkEUC(id, timestamp, transaction);
+      ProcessLandmarkEUC(id, timestamp, new_landmarks, builder);
     }
   }
 
   if (vo_params_.use_standalone_vo) {
-    local_graph_->update(*transaction);
+    ApplyLocalTransaction(*transaction);
 
     // optimize graph
-    local_graph_->optimizeFor(ros::Duration(0.05), local_solver_options_);
+    OptimizeLocalGraph(0.05);
 
     // send just a relative pose constraint to the main graph
     auto pose_transaction =
@@ -339,13 +629,34 @@ void VisualOdometry::ExtendMap(const ros::Time& timestamp,
     sendTransaction(pose_transaction);
 
     // publish landmarks as a point cloud
-    PublishLandmarkPointCloud(*local_graph_);
+    PublishLandmarkPointCloud(*transaction);
   } else {
     sendTransaction(transaction);
   }
 }
 
+void VisualOdometry::BackpressureCallback(
+    const std_msgs::Bool::ConstPtr& msg) {
+  if (backpressure_.exchange(msg->data) == msg->data) { return; }
+  ROS_INFO_STREAM(name() << ": optimizer back-pressure "
+                         << (msg->data ? "on" : "off"));
+}
+
+void VisualOdometry::graphCallback(fuse_core::Graph::ConstSharedPtr graph) {
+  if (!graph_update_lane_) {
+    fuse_core::AsyncSensorModel::graphCallback(std::move(graph));
+    return;
+  }
+  graph_update_lane_->Push(std::move(graph));
+}
+
 void VisualOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph) {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(name());
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "visual_odometry/graph_update");
+  bs_common::ScopedTimer timer(metric);
+
   ROS_INFO_STREAM_ONCE("VisualOdometry received initial graph.");
   std::unique_lock<std::mutex> lk(buffer_mutex_);
 
@@ -357,6 +668,7 @@ void VisualOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph) {
     if (maybe_extrinsic) {
       T_baselink_cam_ = maybe_extrinsic.value();
       T_cam_baselink_ = beam::InvertTransform(T_baselink_cam_);
+      camera_rig_->SetExtrinsics(0, T_cam_baselink_);
     }
   }
 
@@ -371,18 +683,19 @@ void VisualOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph) {
   if (!vo_params_.use_standalone_vo) {
     // update visual map with main graph
     old_ids = visual_map_->GetLandmarkIDs();
-    PruneKeyframes(*graph);
-    visual_map_->UpdateGraph(*graph);
+    PruneKeyframes(*bs_common::GetStampIndex(*graph));
+    visual_map_->UpdateGraph(graph);
     new_ids = visual_map_->GetLandmarkIDs();
   } else {
     // update local graph using main graph
     old_ids = visual_map_->GetLandmarkIDs();
     MarginalizeLocalGraph(*graph);
     UpdateLocalGraph(*graph);
-    PruneKeyframes(*local_graph_);
+    PruneKeyframes(local_stamps_);
     visual_map_->UpdateGraph(*local_graph_);
     new_ids = visual_map_->GetLandmarkIDs();
   }
+  UpdateMemoryAccounts();
 
   // clean up new to old landmark map if its used
   if (vo_params_.local_map_matching) {
@@ -400,7 +713,7 @@ void VisualOdometry::onGraphUpdate(fuse_core::Graph::ConstSharedPtr graph) {
 
 bool VisualOdometry::IsKeyframe(const ros::Time& timestamp,
                                 const Eigen::Matrix4d& T_WORLD_BASELINK) {
-  if (keyframes_.empty()) { return true; }
+  if (keyframes_.empty() || FollowsRestoredKeyframe()) { return true; }
 
   Eigen::Matrix4d T_PREVKF_CURFRAME;
   if (!frame_initializer_->GetRelativePose(T_PREVKF_CURFRAME,
@@ -410,218 +723,319 @@ bool VisualOdometry::IsKeyframe(const ros::Time& timestamp,
     return false;
   }
 
-  // compute rotation adjusted parallax
-  Eigen::Matrix3d R_PREVKF_CURFRAME = T_PREVKF_CURFRAME.block<3, 3>(0, 0);
-  std::vector<uint64_t> frame1_ids =
-      landmark_container_->GetLandmarkIDsInImage(previous_keyframe_);
-  double total_parallax = 0.0;
-  int num_correspondences = 0;
-  std::vector<double> parallaxes;
-  for (auto& id : frame1_ids) {
-    try {
-      Eigen::Vector2d p1 =
-          landmark_container_->GetValue(previous_keyframe_, id);
-      Eigen::Vector2d p2 = landmark_container_->GetValue(timestamp, id);
-      Eigen::Vector3d bp2;
-      if (!cam_model_->BackProject(p2.cast<int>(), bp2)) { continue; }
-      // rotate pixel from current frame to keyframe
-      Eigen::Vector3d bp2_in_kf = R_PREVKF_CURFRAME * bp2;
-      Eigen::Vector2d bp2_reproj;
-      if (!cam_model_->ProjectPoint(bp2_in_kf, bp2_reproj)) { continue; }
-      // add to total parallax
-      double d = beam::distance(p1, bp2_reproj);
-      total_parallax += d;
-      num_correspondences++;
-    } catch (const std::out_of_range& oor) {}
-  }
-
-  const double avg_parallax =
-      total_parallax / static_cast<double>(num_correspondences);
-  const double percent_tracked = static_cast<double>(num_correspondences) /
-                                 static_cast<double>(frame1_ids.size());
-
-  if (avg_parallax > vo_params_.keyframe_parallax) {
-    return true;
-  } else if (percent_tracked <= 0.5) {
+  // the tracking and time checks are O(1), so parallax is only computed when
+  // they don't already make this a keyframe
+  const size_t num_keyframe_landmarks =
+      keyframe_parallax_->NumKeyframeLandmarks();
+  const double percent_tracked =
+      num_keyframe_landmarks == 0
+          ? 0.0
+          : static_cast<double>(keyframe_parallax_->NumTracked(timestamp)) /
+                static_cast<double>(num_keyframe_landmarks);
+  if (percent_tracked <= 0.5) {
     return true;
   } else if ((timestamp - previous_keyframe_).toSec() >
              ((lag_duration_ / 2.0) - 0.5)) {
     return true;
   }
-  return false;
+
+  // compute rotation adjusted parallax
+  const double avg_parallax = keyframe_parallax_->AverageParallax(
+      timestamp, T_PREVKF_CURFRAME.block<3, 3>(0, 0));
+  const double keyframe_parallax =
+      backpressure_ ? vo_params_.backpressure_keyframe_parallax_scale *
+                          vo_params_.keyframe_parallax
+                    : vo_params_.keyframe_parallax;
+  return avg_parallax > keyframe_parallax;
 }
 
 void VisualOdometry::AddMeasurementsToContainer(
-    const bs_common::CameraMeasurementMsg::ConstPtr& msg) {
+    const vision::FrameSetAssembler::FrameSet& frame_set) {
   // check that message hasnt already been added to container
+  const ros::Time& stamp = frame_set.front()->header.stamp;
   const auto times = landmark_container_->GetMeasurementTimes();
-  if (times.find(msg->header.stamp) != times.end()) { return; }
+  if (times.find(stamp) != times.end()) { return; }
+
+  // find the outliers of each camera in parallel, the container is only read
+  // until all cameras are done
+  std::vector<std::unordered_set<uint64_t>> outliers(frame_set.size());
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, frame_set.size(), [&](size_t i) {
+        outliers[i] = FindTrackOutliers(*frame_set[i], camera_rig_->Camera(i));
+      });
+
+  // put all inlier measurements into landmark container
+  std::vector<uint64_t> ids;
+  std::vector<cv::Mat> descriptors;
+  std::vector<uint64_t> inlier_ids;
+  std::vector<Eigen::Vector2d, beam::AlignVec2d> inlier_pixels;
+  for (size_t c = 0; c < frame_set.size(); c++) {
+    const auto& msg = frame_set[c];
+    const vision::CameraMeasurementView measurements(*msg);
+    for (size_t i = 0; i < measurements.Size(); i++) {
+      const uint64_t id = measurements.LandmarkId(i);
+      if (vo_params_.local_map_matching) {
+        ids.push_back(id);
+        descriptors.push_back(measurements.Descriptor(i).clone());
+      }
+      if (outliers[c].find(id) != outliers[c].end()) { continue; }
+      beam_containers::LandmarkMeasurement lm_measurement(
+          stamp, msg->sensor_id, id, msg->header.seq, measurements.Pixel(i),
+          measurements.Descriptor(i).clone());
+      landmark_container_->Insert(lm_measurement);
+      inlier_ids.push_back(id);
+      inlier_pixels.push_back(measurements.Pixel(i));
+    }
+  }
+  keyframe_parallax_->AddFrame(stamp, inlier_ids, inlier_pixels);
 
-  std::map<uint64_t, Eigen::Vector2d> cur_undistorted_measurements;
+  // quantize descriptors off the critical path, the word ids are only needed
+  // once landmarks are triangulated
+  if (vo_params_.local_map_matching) {
+    bow_service_->QuantizeFrame(stamp, ids, descriptors);
+  }
+  prev_frame_ = stamp;
+}
 
-  // put all measurements into landmark container
-  for (const auto& lm : msg->landmarks) {
-    Eigen::Vector2d landmark(static_cast<double>(lm.pixel_u),
-                             static_cast<double>(lm.pixel_v));
-    const cv::Mat landmark_descriptor =
-        beam_cv::Descriptor::VectorDescriptorToCvMat({lm.descriptor.data},
-                                                     msg->descriptor_type);
+void VisualOdometry::AddMeasurementUpdate(
+    const bs_common::CameraMeasurementMsg& msg) {
+  // measurements of additional cameras were restamped to their frame set, so
+  // find the closest frame within the set tolerance
+  const auto times = landmark_container_->GetMeasurementTimes();
+  const ros::Duration tolerance(
+      frame_set_assembler_ ? vo_params_.frame_set_tolerance : 0);
+  const ros::Time& update_stamp = msg.header.stamp;
+  auto iter = times.lower_bound(update_stamp - tolerance);
+  if (iter == times.end() || *iter > update_stamp + tolerance) {
+    ROS_DEBUG_STREAM("No frame for measurement update: " << update_stamp);
+    return;
+  }
+  if (std::next(iter) != times.end() && *std::next(iter) - update_stamp <
+                                            update_stamp - *iter) {
+    iter++;
+  }
+  const ros::Time stamp = *iter;
+
+  const vision::CameraMeasurementView measurements(msg);
+  for (size_t i = 0; i < measurements.Size(); i++) {
     beam_containers::LandmarkMeasurement lm_measurement(
-        msg->header.stamp, msg->sensor_id, lm.landmark_id, msg->header.seq,
-        landmark, landmark_descriptor);
+        stamp, msg.sensor_id, measurements.LandmarkId(i), msg.header.seq,
+        measurements.Pixel(i), measurements.Descriptor(i).clone());
     landmark_container_->Insert(lm_measurement);
+  }
+}
 
+std::unordered_set<uint64_t> VisualOdometry::FindTrackOutliers(
+    const bs_common::CameraMeasurementMsg& msg,
+    const vision::RigCamera& camera) const {
+  if (prev_frame_ == ros::Time(0)) { return {}; }
+
+  std::map<uint64_t, Eigen::Vector2d> cur_undistorted_measurements;
+  const vision::CameraMeasurementView measurements(msg);
+  for (size_t i = 0; i < measurements.Size(); i++) {
     Eigen::Vector2i rectified_pixel;
-    if (cam_model_->UndistortPixel(landmark.cast<int>(), rectified_pixel)) {
+    if (camera.model->UndistortPixel(measurements.Pixel(i).cast<int>(),
+                                     rectified_pixel)) {
       cur_undistorted_measurements.insert(
-          {lm.landmark_id, rectified_pixel.cast<double>()});
+          {measurements.LandmarkId(i), rectified_pixel.cast<double>()});
     }
   }
 
-  // get previous frame undistorted measurements
-  if (prev_frame_ != ros::Time(0)) {
-    std::map<uint64_t, Eigen::Vector2d> prev_undistorted_measurements;
-    std::vector<uint64_t> landmarks =
-        landmark_container_->GetLandmarkIDsInImage(prev_frame_);
-    for (auto& id : landmarks) {
-      try {
-        const Eigen::Vector2d prev_measurement =
-            landmark_container_->GetValue(prev_frame_, id);
-
-        Eigen::Vector2i rectified_pixel;
-        if (cam_model_->UndistortPixel(prev_measurement.cast<int>(),
-                                       rectified_pixel)) {
-          prev_undistorted_measurements.insert(
-              {id, rectified_pixel.cast<double>()});
-        }
-      } catch (const std::out_of_range& oor) {}
+  // get previous frame undistorted measurements of this camera
+  std::map<uint64_t, Eigen::Vector2d> prev_undistorted_measurements;
+  std::vector<uint64_t> landmarks =
+      landmark_container_->GetLandmarkIDsInImage(prev_frame_);
+  for (auto& id : landmarks) {
+    if (cur_undistorted_measurements.find(id) ==
+        cur_undistorted_measurements.end()) {
+      continue;
     }
+    try {
+      const Eigen::Vector2d prev_measurement =
+          landmark_container_->GetValue(prev_frame_, id);
 
-    // get matches to previous frame
-    std::vector<cv::Point2f> fp1, fp2;
-    std::vector<uint64_t> matched_ids;
-    for (const auto& [id, pixel] : prev_undistorted_measurements) {
-      if (cur_undistorted_measurements.find(id) !=
-          cur_undistorted_measurements.end()) {
-        cv::Point2f p1 =
-            beam_cv::ConvertKeypoint(prev_undistorted_measurements[id]);
-        cv::Point2f p2 =
-            beam_cv::ConvertKeypoint(cur_undistorted_measurements[id]);
-        fp1.push_back(p1);
-        fp2.push_back(p2);
-        matched_ids.push_back(id);
+      Eigen::Vector2i rectified_pixel;
+      if (camera.model->UndistortPixel(prev_measurement.cast<int>(),
+                                       rectified_pixel)) {
+        prev_undistorted_measurements.insert(
+            {id, rectified_pixel.cast<double>()});
       }
-    }
+    } catch (const std::out_of_range& oor) {}
+  }
+
+  // get matches to previous frame
+  std::vector<cv::Point2f> fp1, fp2;
+  std::vector<uint64_t> matched_ids;
+  for (const auto& [id, pixel] : prev_undistorted_measurements) {
+    fp1.push_back(beam_cv::ConvertKeypoint(pixel));
+    fp2.push_back(
+        beam_cv::ConvertKeypoint(cur_undistorted_measurements.at(id)));
+    matched_ids.push_back(id);
+  }
 
-    // attempt essential matrix estimation
-    std::vector<uchar> mask;
-    cv::findEssentialMat(fp1, fp2, K_, cv::RANSAC, 0.99,
-                         vo_params_.track_outlier_pixel_threshold, mask);
+  // attempt essential matrix estimation
+  cv::Mat K;
+  cv::eigen2cv(camera.K, K);
+  std::vector<uchar> mask;
+  cv::findEssentialMat(fp1, fp2, K, cv::RANSAC, 0.99,
+                       vo_params_.track_outlier_pixel_threshold, mask);
 
-    // remove outliers from container
-    for (size_t i = 0; i < mask.size(); i++) {
-      if (mask.at(i) == 0) {
-        const auto id = matched_ids[i];
-        landmark_container_->Erase(msg->header.stamp, id);
-      }
-    }
+  std::unordered_set<uint64_t> outliers;
+  for (size_t i = 0; i < mask.size(); i++) {
+    if (mask.at(i) == 0) { outliers.insert(matched_ids[i]); }
   }
-  prev_frame_ = msg->header.stamp;
+  return outliers;
 }
 
-beam::opt<Eigen::Vector3d>
-    VisualOdometry::TriangulateLandmark(const uint64_t id,
-                                        Eigen::Vector3d& average_viewing_angle,
-                                        uint64_t& visual_word_id) {
-  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_cam_world_v;
-  std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels;
+void VisualOdometry::AddKeyframeObservations(const ros::Time& timestamp) {
+  const auto times = landmark_container_->GetMeasurementTimes();
+  if (times.find(timestamp) == times.end()) { return; }
+
+  std::vector<uint64_t> ids;
+  std::vector<Eigen::Vector2d, beam::AlignVec2d> pixels;
+  for (const uint64_t id :
+       landmark_container_->GetLandmarkIDsInImage(timestamp)) {
+    try {
+      pixels.push_back(landmark_container_->GetValue(timestamp, id));
+      ids.push_back(id);
+    } catch (const std::out_of_range& oor) {}
+  }
+  keyframe_tracks_.AddFrame(timestamp, ids, pixels);
+}
+
+bool VisualOdometry::GetTriangulationRequest(
+    const uint64_t id, vision::BatchTriangulator::Request& request,
+    Eigen::Vector3d& average_viewing_angle, uint64_t& visual_word_id) {
   std::vector<Eigen::Vector3d, beam::AlignVec3d> viewing_angles;
   std::vector<uint64_t> word_ids;
 
-  beam_containers::Track track = landmark_container_->GetTrack(id);
-  for (auto& m : track) {
-    const auto T_camera_world = visual_map_->GetCameraPose(m.time_point);
+  const vision::RigCamera* camera = camera_rig_->CameraOfLandmark(id);
+  if (!camera) { return false; }
+  request.cam_model = camera->model;
+  for (const auto& m : keyframe_tracks_.GetTrack(id)) {
+    const auto T_camera_world = GetCameraPose(m.stamp, id);
     // check if the pose is in the graph
     if (T_camera_world.has_value()) {
-      Eigen::Vector2i pixel_i = m.value.cast<int>();
+      Eigen::Vector2i pixel_i = m.pixel.cast<int>();
       Eigen::Matrix4d T_WORLD_CAMERA =
           beam::InvertTransform(T_camera_world.value());
 
-      pixels.push_back(pixel_i);
-      T_cam_world_v.push_back(T_WORLD_CAMERA);
+      request.pixels.push_back(pixel_i);
+      request.T_cam_world.push_back(T_WORLD_CAMERA);
 
       if (vo_params_.local_map_matching) {
         Eigen::Vector3d bearing_cam;
-        if (cam_model_->BackProject(pixel_i, bearing_cam)) {
+        if (camera->model->BackProject(pixel_i, bearing_cam)) {
           // compute viewing angle in world frame
           Eigen::Vector3d bearing_world =
               (T_WORLD_CAMERA * bearing_cam.homogeneous()).hnormalized();
           viewing_angles.push_back(bearing_world);
-          // compute word id
-          word_ids.push_back(image_db_->GetWordID(m.descriptor));
+          // get word id, computed when the frame was added
+          const auto word_id = bow_service_->GetWordID(m.stamp, id);
+          if (word_id) { word_ids.push_back(word_id.value()); }
         }
       }
     }
   }
 
   // must have at least 2 keyframes that have seen the landmark
-  if (T_cam_world_v.size() >= 2) {
-    if (vo_params_.local_map_matching) {
-      // compute average viewing angle
-      average_viewing_angle = Eigen::Vector3d::Zero();
-      for (const auto& viewing_angle : viewing_angles) {
-        average_viewing_angle += viewing_angle;
-      }
+  if (request.T_cam_world.size() < 2) { return false; }
+
+  average_viewing_angle = Eigen::Vector3d::Zero();
+  visual_word_id = 0;
+  if (vo_params_.local_map_matching) {
+    // compute average viewing angle
+    for (const auto& viewing_angle : viewing_angles) {
+      average_viewing_angle += viewing_angle;
+    }
+    if (!viewing_angles.empty()) {
       average_viewing_angle /= static_cast<double>(viewing_angles.size());
+    }
 
-      // compute mode word id
-      std::map<uint64_t, int> word_id_counts;
-      for (const auto& word_id : word_ids) {
-        if (word_id_counts.find(word_id) == word_id_counts.end()) {
-          word_id_counts[word_id] = 1;
-        } else {
-          word_id_counts[word_id]++;
-        }
+    // compute mode word id
+    std::map<uint64_t, int> word_id_counts;
+    for (const auto& word_id : word_ids) {
+      if (word_id_counts.find(word_id) == word_id_counts.end()) {
+        word_id_counts[word_id] = 1;
+      } else {
+        word_id_counts[word_id]++;
       }
-      int max = 0;
-      for (const auto& [id, count] : word_id_counts) {
-        if (count > max) {
-          visual_word_id = id;
-          max = count;
-        }
+    }
+    int max = 0;
+    for (const auto& [id, count] : word_id_counts) {
+      if (count > max) {
+        visual_word_id = id;
+        max = count;
       }
-    } else {
-      average_viewing_angle = Eigen::Vector3d::Zero();
-      visual_word_id = 0;
     }
+  }
+  return true;
+}
 
-    // if we've lost track, ease the requirements on new landmarks
-    if (track_lost_) {
-      return beam_cv::Triangulation::TriangulatePoint(cam_model_, T_cam_world_v,
-                                                      pixels);
-    } else {
-      return beam_cv::Triangulation::TriangulatePoint(
-          cam_model_, T_cam_world_v, pixels,
-          vo_params_.max_triangulation_distance,
-          vo_params_.max_triangulation_reprojection);
+std::unordered_map<uint64_t, VisualOdometry::NewLandmark>
+    VisualOdometry::TriangulateNewLandmarks(
+        const std::vector<uint64_t>& landmarks) {
+  // gather the measurements of all landmarks that aren't in the map yet
+  std::vector<uint64_t> ids;
+  std::vector<NewLandmark> new_landmarks;
+  std::vector<vision::BatchTriangulator::Request> requests;
+  for (const auto id : landmarks) {
+    if (vo_params_.use_idp) {
+      if (visual_map_->GetInverseDepthLandmark(id) ||
+          visual_map_->GetLandmark(id)) {
+        continue;
+      }
+    } else if (visual_map_->GetLandmark(id) ||
+               new_to_old_lm_ids_.left.find(id) !=
+                   new_to_old_lm_ids_.left.end()) {
+      continue;
     }
+
+    vision::BatchTriangulator::Request request;
+    NewLandmark new_landmark;
+    if (!GetTriangulationRequest(id, request,
+                                 new_landmark.average_viewing_angle,
+                                 new_landmark.word_id)) {
+      continue;
+    }
+    ids.push_back(id);
+    new_landmarks.push_back(new_landmark);
+    requests.push_back(std::move(request));
+  }
+
+  // if we've lost track, ease the requirements on new landmarks
+  const auto points =
+      track_lost_ ? triangulator_->Triangulate(requests)
+                  : triangulator_->Triangulate(
+                        requests, vo_params_.max_triangulation_distance,
+                        vo_params_.max_triangulation_reprojection);
+
+  std::unordered_map<uint64_t, NewLandmark> triangulated;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (!points[i].has_value()) { continue; }
+    new_landmarks[i].position = points[i].value();
+    triangulated.emplace(ids[i], new_landmarks[i]);
   }
-  return {};
+  return triangulated;
 }
 
-void VisualOdometry::GetPixelPointPairs(
+size_t VisualOdometry::GetPixelPointPairs(
     const ros::Time& timestamp,
-    std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
-    std::vector<Eigen::Vector3d, beam::AlignVec3d>& points) {
-  std::vector<std::pair<Eigen::Vector2i, Eigen::Vector3d>> pixel_point_pairs;
+    std::vector<vision::RigPoseRefinement::Correspondences>& correspondences) {
+  correspondences.assign(camera_rig_->Size(), {});
+  size_t num_points = 0;
   std::vector<uint64_t> landmarks =
       landmark_container_->GetLandmarkIDsInImage(timestamp);
   for (const uint64_t id : landmarks) {
+    size_t camera;
+    if (!camera_rig_->IndexOfLandmark(id, camera)) { continue; }
+    auto& pixels = correspondences[camera].pixels;
+    auto& points = correspondences[camera].points;
     if (vo_params_.use_idp) {
       auto lm = visual_map_->GetInverseDepthLandmark(id);
       if (lm) {
         Eigen::Vector3d camera_t_point = lm->camera_t_point();
-        auto T_WORLD_CAMERA = visual_map_->GetCameraPose(lm->anchorStamp());
+        auto T_WORLD_CAMERA = GetCameraPose(lm->anchorStamp(), id);
         if (!T_WORLD_CAMERA.has_value()) { continue; }
         Eigen::Vector3d world_t_point =
             (T_WORLD_CAMERA.value() * camera_t_point.homogeneous())
@@ -630,6 +1044,12 @@ void VisualOdometry::GetPixelPointPairs(
             landmark_container_->GetValue(timestamp, id).cast<int>();
         points.push_back(world_t_point);
         pixels.push_back(pixel);
+        num_points++;
+      } else if (auto euclidean_lm = visual_map_->GetLandmark(id)) {
+        points.push_back(euclidean_lm->point());
+        pixels.push_back(
+            landmark_container_->GetValue(timestamp, id).cast<int>());
+        num_points++;
       }
     } else {
       uint64_t graph_lm_id = id;
@@ -645,13 +1065,28 @@ void VisualOdometry::GetPixelPointPairs(
             landmark_container_->GetValue(timestamp, id).cast<int>();
         points.push_back(point);
         pixels.push_back(pixel);
+        num_points++;
       }
     }
   }
+  return num_points;
+}
+
+beam::opt<Eigen::Matrix4d>
+    VisualOdometry::GetCameraPose(const ros::Time& stamp,
+                                  uint64_t landmark_id) {
+  const vision::RigCamera* camera = camera_rig_->CameraOfLandmark(landmark_id);
+  if (!camera) { return {}; }
+  if (camera == &camera_rig_->Primary()) {
+    return visual_map_->GetCameraPose(stamp);
+  }
+  const auto T_WORLD_BASELINK = visual_map_->GetBaselinkPose(stamp);
+  if (!T_WORLD_BASELINK.has_value()) { return {}; }
+  return Eigen::Matrix4d(T_WORLD_BASELINK.value() * camera->T_baselink_cam);
 }
 
 void VisualOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph) {
-  const auto timestamps = bs_common::CurrentTimestamps(*graph);
+  const auto timestamps = bs_common::GetStampIndex(*graph)->Stamps();
   const auto current_landmark_ids = bs_common::CurrentLandmarkIDs(*graph);
   if (current_landmark_ids.empty()) {
     ROS_ERROR("Cannot use Visual Odometry without initializing with visual "
@@ -661,10 +1096,17 @@ void VisualOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph) {
   }
 
   if (vo_params_.use_standalone_vo) {
+    // one time copy, after this the local graph is updated incrementally
     local_graph_ = std::move(graph->clone());
+    local_problem_.Rebuild(*local_graph_);
+    local_stamps_ = bs_common::StampIndex(*local_graph_);
+    imported_constraints_.clear();
+    for (const auto& c : local_graph_->getConstraints()) {
+      imported_constraints_.insert(c.uuid());
+    }
     visual_map_->UpdateGraph(*local_graph_);
   } else {
-    visual_map_->UpdateGraph(*graph);
+    visual_map_->UpdateGraph(graph);
   }
 
   T_WORLD_BASELINKprevframe_ =
@@ -700,143 +1142,329 @@ void VisualOdometry::Initialize(fuse_core::Graph::ConstSharedPtr graph) {
     const auto msg = measurement_map.at(stamp);
     vision::Keyframe kf(*msg);
     keyframes_.insert({msg->header.stamp, kf});
+    AddKeyframeObservations(msg->header.stamp);
     previous_keyframe_ = msg->header.stamp;
   }
+  keyframe_parallax_->SetKeyframe(previous_keyframe_);
 
-  // remove measurements
+  // remove measurements, a restored keyframe is removed too since it can't
+  // be localized again (see FollowsRestoredKeyframe)
   const uint64_t last_stamp = *union_stamps.rbegin();
+  const uint64_t last_removed_stamp =
+      last_stamp == restored_keyframe_.toNSec() ? last_stamp + 1 : last_stamp;
   while (!visual_measurement_buffer_.empty() &&
          visual_measurement_buffer_.front()->header.stamp.toNSec() <
-             last_stamp) {
+             last_removed_stamp) {
     visual_measurement_buffer_.pop_front();
   }
 
   // process visual information in buffer that isn't in the graph yet
-  while (!visual_measurement_buffer_.empty()) {
-    const auto msg = visual_measurement_buffer_.front();
-    if (!ComputeOdometryAndExtendMap(msg)) { break; }
-    visual_measurement_buffer_.pop_front();
+  ProcessMeasurementBuffer();
+}
+
+void VisualOdometry::SaveCheckpoint() {
+  static bs_common::Metric& metric =
+      bs_common::Instrumentation::GetInstance().GetMetric(
+          "visual_odometry/checkpoint_snapshot");
+  bs_common::ScopedTimer timer(metric);
+
+  // measurements of landmarks matched to older landmarks are stored with the
+  // id of the older landmark, which is the one in the map
+  auto map_id = [this](uint64_t id) {
+    const auto iter = new_to_old_lm_ids_.left.find(id);
+    return iter == new_to_old_lm_ids_.left.end() ? id : iter->second;
+  };
+
+  auto checkpoint = std::make_shared<vision::VOCheckpoint>();
+  for (const auto& [stamp, keyframe] : keyframes_) {
+    const auto T_WORLD_BASELINK = visual_map_->GetBaselinkPose(stamp);
+    if (!T_WORLD_BASELINK.has_value()) { continue; }
+    vision::VOCheckpoint::KeyframeState state;
+    state.msg = keyframe.MeasurementMessage();
+    state.T_WORLD_BASELINK = T_WORLD_BASELINK.value();
+    for (uint64_t& id : state.msg.landmark_ids) { id = map_id(id); }
+    for (auto& landmark : state.msg.landmarks) {
+      landmark.landmark_id = map_id(landmark.landmark_id);
+    }
+    checkpoint->keyframes.push_back(std::move(state));
+  }
+  for (const uint64_t id : visual_map_->GetLandmarkIDs()) {
+    const auto landmark = visual_map_->GetLandmark(id);
+    if (!landmark) { continue; }
+    checkpoint->landmarks.push_back({id, landmark->point(),
+                                     landmark->viewing_angle(),
+                                     landmark->word_id()});
+  }
+
+  const std::string path = vo_params_.checkpoint_path;
+  if (!checkpoint_writer_->Enqueue([checkpoint, path]() {
+        if (!checkpoint->Save(path)) {
+          ROS_ERROR("Cannot save VO checkpoint to: %s", path.c_str());
+        }
+      })) {
+    ROS_DEBUG("Previous VO checkpoint is still being written, skipping.");
+  }
+}
+
+void VisualOdometry::RestoreCheckpoint(const ros::Time& stamp) {
+  std::unique_ptr<vision::VOCheckpoint> checkpoint =
+      std::move(restored_checkpoint_);
+  const double age = (stamp - checkpoint->Stamp()).toSec();
+  if (is_initialized_ || checkpoint->keyframes.empty() || age < 0 ||
+      age > vo_params_.checkpoint_max_age) {
+    ROS_WARN_STREAM(name() << ": VO checkpoint is " << age
+                           << " s older than the first frame, not restoring.");
+    return;
+  }
+  checkpoint->MarkRestoredLandmarks();
+
+  // the restored poses are optimized estimates, so they get a tight prior
+  const Eigen::Matrix<double, 6, 6> prior_covariance =
+      1e-6 * Eigen::Matrix<double, 6, 6>::Identity();
+  auto transaction = fuse_core::Transaction::make_shared();
+  transaction->stamp(checkpoint->Stamp());
+  for (const auto& keyframe : checkpoint->keyframes) {
+    visual_map_->AddBaselinkPose(keyframe.T_WORLD_BASELINK,
+                                 keyframe.msg.header.stamp, transaction);
+    visual_map_->AddPosePrior(keyframe.msg.header.stamp, prior_covariance,
+                              transaction);
+  }
+  std::unordered_set<uint64_t> landmark_ids;
+  for (const auto& landmark : checkpoint->landmarks) {
+    visual_map_->AddLandmark(landmark.position, landmark.viewing_angle,
+                             landmark.word_id, landmark.id, transaction);
+    landmark_ids.insert(landmark.id);
+  }
+  vision::VisualConstraintBuilder builder(*visual_map_, transaction);
+  for (const auto& keyframe : checkpoint->keyframes) {
+    const vision::CameraMeasurementView measurements(keyframe.msg);
+    for (size_t i = 0; i < measurements.Size(); i++) {
+      const uint64_t id = measurements.LandmarkId(i);
+      if (landmark_ids.find(id) == landmark_ids.end()) { continue; }
+      builder.AddVisualConstraint(keyframe.msg.header.stamp, id,
+                                  measurements.Pixel(i));
+    }
+  }
+  sendTransaction(transaction);
+
+  // replay the keyframes, which also rebuilds the bag of words index from
+  // their descriptors
+  for (auto& keyframe : checkpoint->keyframes) {
+    const auto msg = boost::make_shared<bs_common::CameraMeasurementMsg>(
+        std::move(keyframe.msg));
+    AddMeasurementsToContainer({msg});
+    bow_service_->AddToIndex(msg->header.stamp);
+    std::lock_guard<std::mutex> lk(buffer_mutex_);
+    visual_measurement_buffer_.push_back(msg);
+  }
+  restored_keyframe_ = checkpoint->Stamp();
+  ROS_INFO_STREAM(name() << ": restored VO checkpoint from "
+                         << restored_keyframe_ << " with "
+                         << builder.NumConstraints() << " constraints");
+}
+
+bool VisualOdometry::FollowsRestoredKeyframe() const {
+  return !restored_keyframe_.isZero() &&
+         previous_keyframe_ == restored_keyframe_;
+}
+
+void VisualOdometry::MatchRestoredLandmarks(
+    const ros::Time& timestamp, const Eigen::Matrix4d& T_WORLD_BASELINK) {
+  ProjectMapPoints(T_WORLD_BASELINK);
+
+  // viewing angles are computed as in GetTriangulationRequest
+  const Eigen::Matrix4d T_CAMERA_WORLD =
+      T_cam_baselink_ * beam::InvertTransform(T_WORLD_BASELINK);
+  size_t num_matched = 0;
+  for (const uint64_t id :
+       landmark_container_->GetLandmarkIDsInImage(timestamp)) {
+    if (!camera_rig_->IsPrimary(id) ||
+        new_to_old_lm_ids_.left.find(id) != new_to_old_lm_ids_.left.end()) {
+      continue;
+    }
+    const auto word_id = bow_service_->GetWordID(timestamp, id);
+    if (!word_id) { continue; }
+    const Eigen::Vector2d pixel = landmark_container_->GetValue(timestamp, id);
+    Eigen::Vector3d bearing_cam;
+    if (!cam_model_->BackProject(pixel.cast<int>(), bearing_cam)) { continue; }
+    const Eigen::Vector3d viewing_angle =
+        (T_CAMERA_WORLD * bearing_cam.homogeneous()).hnormalized();
+    uint64_t matched_id;
+    if (SearchLocalMap(pixel, viewing_angle, word_id.value(), matched_id)) {
+      new_to_old_lm_ids_.insert({id, matched_id});
+      num_matched++;
+    }
   }
+  ROS_INFO_STREAM(name() << ": matched " << num_matched
+                         << " landmarks to the restored checkpoint");
 }
 
 void VisualOdometry::ProcessLandmarkIDP(
     const uint64_t id, const ros::Time& timestamp,
-    fuse_core::Transaction::SharedPtr transaction) {
+    const std::unordered_map<uint64_t, NewLandmark>& new_landmarks,
+    vision::VisualConstraintBuilder& builder) {
+  const auto transaction = builder.Transaction();
+
+  // landmarks with a converged depth continue as euclidean landmarks
+  if (visual_map_->GetLandmark(id)) {
+    const auto pixel = keyframe_tracks_.GetPixel(timestamp, id);
+    if (pixel) { builder.AddVisualConstraint(timestamp, id, pixel.value()); }
+    return;
+  }
+
   auto lm = visual_map_->GetInverseDepthLandmark(id);
   if (lm) {
+    if (ConvertConvergedLandmark(id, timestamp, *lm, builder)) { return; }
+
     // if the landmark exists, just add a constraint to the current keyframe
-    try {
-      Eigen::Vector2d pixel = landmark_container_->GetValue(timestamp, id);
-      visual_map_->AddInverseDepthVisualConstraint(timestamp, id, pixel,
-                                                   transaction);
-    } catch (const std::out_of_range& oor) { return; }
+    const auto pixel = keyframe_tracks_.GetPixel(timestamp, id);
+    if (pixel) {
+      builder.AddInverseDepthVisualConstraint(timestamp, id, pixel.value());
+    }
   } else {
-    // if the landmark doesnt exist we try to initialize it
-    // triangulate and add landmark
-    Eigen::Vector3d avg_viewing_angle;
-    uint64_t word_id;
-    const auto initial_point =
-        TriangulateLandmark(id, avg_viewing_angle, word_id);
-    if (!initial_point.has_value()) { return; }
+    // if the landmark doesnt exist we try to initialize it from its
+    // triangulated position
+    const auto new_landmark = new_landmarks.find(id);
+    if (new_landmark == new_landmarks.end()) { return; }
+    const Eigen::Vector3d& initial_point = new_landmark->second.position;
 
     // use the first keyframe that sees the landmark as the anchor frame
-    auto track = landmark_container_->GetTrack(id);
-    beam_containers::LandmarkMeasurement anchor_measurement;
-    for (auto m : track) {
-      if (keyframes_.find(m.time_point) != keyframes_.end()) {
-        anchor_measurement = m;
-        break;
-      }
-    }
+    const vision::TrackStore::Track& track = keyframe_tracks_.GetTrack(id);
+    const vision::TrackStore::Observation& anchor_measurement = track.front();
 
     // get the bearing vector to the measurement
+    const vision::RigCamera* camera = camera_rig_->CameraOfLandmark(id);
+    if (!camera) { return; }
     Eigen::Vector3d bearing;
     Eigen::Vector2i rectified_pixel;
-    if (!cam_model_->UndistortPixel(anchor_measurement.value.cast<int>(),
-                                    rectified_pixel)) {
+    if (!camera->model->UndistortPixel(anchor_measurement.pixel.cast<int>(),
+                                       rectified_pixel)) {
       return;
     }
-    if (!cam_model_->GetRectifiedModel()->BackProject(rectified_pixel,
-                                                      bearing)) {
+    if (!camera->model->GetRectifiedModel()->BackProject(rectified_pixel,
+                                                         bearing)) {
       return;
     }
     bearing.normalize();
 
     // find the inverse depth of the point
-    auto T_WORLD_CAMERA =
-        visual_map_->GetCameraPose(anchor_measurement.time_point);
+    auto T_WORLD_CAMERA = GetCameraPose(anchor_measurement.stamp, id);
     if (!T_WORLD_CAMERA.has_value()) { return; }
     Eigen::Vector3d camera_t_point =
         (beam::InvertTransform(T_WORLD_CAMERA.value()) *
-         initial_point.value().homogeneous())
+         initial_point.homogeneous())
             .hnormalized();
     double inverse_depth = 1.0 / camera_t_point.norm();
 
     // add landmark to transaction
     visual_map_->AddInverseDepthLandmark(
-        bearing, inverse_depth, id, anchor_measurement.time_point, transaction);
+        bearing, inverse_depth, id, anchor_measurement.stamp, transaction);
 
     // add constraints to keyframes that view it
-    for (const auto& [kf_stamp, kf] : keyframes_) {
-      try {
-        Eigen::Vector2d pixel = landmark_container_->GetValue(kf_stamp, id);
-        visual_map_->AddInverseDepthVisualConstraint(timestamp, id, pixel,
-                                                     transaction);
-      } catch (const std::out_of_range& oor) { continue; }
+    for (const auto& m : track) {
+      builder.AddInverseDepthVisualConstraint(m.stamp, id, m.pixel);
     }
   }
 }
 
+bool VisualOdometry::ConvertConvergedLandmark(
+    const uint64_t id, const ros::Time& timestamp,
+    const bs_variables::InverseDepthLandmark& landmark,
+    vision::VisualConstraintBuilder& builder) {
+  if (vo_params_.idp_conversion_max_depth_std <= 0) { return false; }
+  const vision::RigCamera* camera = camera_rig_->CameraOfLandmark(id);
+  if (!camera) { return false; }
+
+  // the constraints to replace must all be in the graph, i.e., the previous
+  // keyframe that measured the landmark must be optimized already
+  const vision::TrackStore::Track& track = keyframe_tracks_.GetTrack(id);
+  if (track.size() < 2 || track.back().stamp != timestamp ||
+      !visual_map_->PoseExists(track[track.size() - 2].stamp)) {
+    return false;
+  }
+
+  const auto T_WORLD_ANCHOR = GetCameraPose(landmark.anchorStamp(), id);
+  const auto T_WORLD_CAMERA = GetCameraPose(timestamp, id);
+  if (!T_WORLD_ANCHOR.has_value() || !T_WORLD_CAMERA.has_value()) {
+    return false;
+  }
+  const Eigen::Vector3d world_t_point =
+      (T_WORLD_ANCHOR.value() * landmark.camera_t_point().homogeneous())
+          .hnormalized();
+
+  // an angular error of sigma over a parallax angle a gives a relative depth
+  // error of about sigma / sin(a). The reprojection information weight is
+  // the inverse of the pixel standard deviation
+  const Eigen::Vector3d ray_anchor =
+      (world_t_point - T_WORLD_ANCHOR.value().block<3, 1>(0, 3)).normalized();
+  const Eigen::Vector3d ray_current =
+      (world_t_point - T_WORLD_CAMERA.value().block<3, 1>(0, 3)).normalized();
+  const double sin_parallax = ray_anchor.cross(ray_current).norm();
+  const double angular_std =
+      1.0 / (vo_params_.reprojection_information_weight * camera->K(0, 0));
+  if (angular_std > vo_params_.idp_conversion_max_depth_std * sin_parallax) {
+    return false;
+  }
+
+  vision::BatchTriangulator::Request unused_request;
+  Eigen::Vector3d average_viewing_angle = Eigen::Vector3d::Zero();
+  uint64_t word_id = 0;
+  GetTriangulationRequest(id, unused_request, average_viewing_angle, word_id);
+  if (!visual_map_->ReplaceInverseDepthLandmark(id, world_t_point,
+                                                average_viewing_angle, word_id,
+                                                builder.Transaction())) {
+    return false;
+  }
+
+  // keyframes which have been marginalized have no pose and are skipped
+  for (const auto& m : track) {
+    builder.AddVisualConstraint(m.stamp, id, m.pixel);
+  }
+  return true;
+}
+
 void VisualOdometry::ProcessLandmarkEUC(
     const uint64_t id, const ros::Time& timestamp,
-    fuse_core::Transaction::SharedPtr transaction) {
+    const std::unordered_map<uint64_t, NewLandmark>& new_landmarks,
+    vision::VisualConstraintBuilder& builder) {
+  const auto transaction = builder.Transaction();
+  const auto cur_pixel = keyframe_tracks_.GetPixel(timestamp, id);
+  if (!cur_pixel) { return; }
   if (visual_map_->GetLandmark(id)) {
-    try {
-      Eigen::Vector2d pixel = landmark_container_->GetValue(timestamp, id);
-      visual_map_->AddVisualConstraint(timestamp, id, pixel, transaction);
-    } catch (const std::out_of_range& oor) { return; }
+    builder.AddVisualConstraint(timestamp, id, cur_pixel.value());
   } else if (new_to_old_lm_ids_.left.find(id) !=
              new_to_old_lm_ids_.left.end()) {
-    try {
-      Eigen::Vector2d pixel = landmark_container_->GetValue(timestamp, id);
-      visual_map_->AddVisualConstraint(
-          timestamp, new_to_old_lm_ids_.left.at(id), pixel, transaction);
-    } catch (const std::out_of_range& oor) { return; }
+    builder.AddVisualConstraint(timestamp, new_to_old_lm_ids_.left.at(id),
+                                cur_pixel.value());
   } else {
-    // triangulate landmark
-    Eigen::Vector3d avg_viewing_angle;
-    uint64_t word_id;
-    const auto initial_point =
-        TriangulateLandmark(id, avg_viewing_angle, word_id);
-    if (!initial_point.has_value()) { return; }
+    // get triangulated landmark
+    const auto new_landmark = new_landmarks.find(id);
+    if (new_landmark == new_landmarks.end()) { return; }
+    const NewLandmark& lm = new_landmark->second;
 
-    if (vo_params_.local_map_matching) {
-      Eigen::Vector2d cur_pixel = landmark_container_->GetValue(timestamp, id);
+    if (vo_params_.local_map_matching && camera_rig_->IsPrimary(id)) {
       uint64_t matched_id;
-      if (SearchLocalMap(cur_pixel, avg_viewing_angle, word_id, matched_id)) {
+      if (SearchLocalMap(cur_pixel.value(), lm.average_viewing_angle,
+                         lm.word_id, matched_id)) {
         // add constraint to matched id
-        visual_map_->AddVisualConstraint(timestamp, matched_id, cur_pixel,
-                                         transaction);
+        builder.AddVisualConstraint(timestamp, matched_id, cur_pixel.value());
         new_to_old_lm_ids_.insert({id, matched_id});
         return;
       }
     }
 
-    visual_map_->AddLandmark(initial_point.value(), avg_viewing_angle, word_id,
-                             id, transaction);
+    visual_map_->AddLandmark(lm.position, lm.average_viewing_angle,
+                             lm.word_id, id, transaction);
 
-    // add constraints to keyframes that view its
-    for (const auto& [kf_stamp, kf] : keyframes_) {
-      try {
-        Eigen::Vector2d pixel = landmark_container_->GetValue(kf_stamp, id);
-        visual_map_->AddVisualConstraint(kf_stamp, id, pixel, transaction);
-      } catch (const std::out_of_range& oor) { continue; }
+    // add constraints to keyframes that view it
+    for (const auto& m : keyframe_tracks_.GetTrack(id)) {
+      builder.AddVisualConstraint(m.stamp, id, m.pixel);
     }
   }
 }
 
 void VisualOdometry::UpdateLocalGraph(const fuse_core::Graph& new_graph) {
-  const auto graph_stamps = bs_common::CurrentTimestamps(new_graph);
+  const auto graph_stamps = bs_common::GetStampIndex(new_graph)->Stamps();
 
   // get the pose of a reference keyframe wrt both graphs
   ros::Time reference_kf_time;
@@ -859,6 +1487,15 @@ void VisualOdometry::UpdateLocalGraph(const fuse_core::Graph& new_graph) {
     }
   }
 
+  // the local graph owns its variables and the local problem points at their
+  // data, so existing variables are updated by writing to that data
+  auto update_values = [](const fuse_core::Variable& source,
+                          const fuse_core::Variable& target) {
+    std::copy(source.data(), source.data() + source.size(),
+              const_cast<double*>(target.data()));
+  };
+  fuse_core::Transaction transaction;
+
   // compute pose states with respect to the local graph
   for (const auto& t : graph_stamps) {
     if (keyframes_.find(t) == keyframes_.end()) {
@@ -874,52 +1511,114 @@ void VisualOdometry::UpdateLocalGraph(const fuse_core::Graph& new_graph) {
         Eigen::Matrix4d T_WORLDlocal_BASELINKcur =
             T_WORLDlocal_BASELINKrefkf * T_BASELINKrefkf_BASELINKcur;
 
-        // add variables to local graph
+        // add variables to local graph, or update them
         fuse_variables::Position3DStamped::SharedPtr p_local =
             std::make_shared<fuse_variables::Position3DStamped>(t);
         fuse_variables::Orientation3DStamped::SharedPtr o_local =
             std::make_shared<fuse_variables::Orientation3DStamped>(t);
         bs_common::EigenTransformToFusePose(T_WORLDlocal_BASELINKcur, *p_local,
                                             *o_local);
-        local_graph_->addVariable(p_local);
-        local_graph_->addVariable(o_local);
+        if (local_graph_->variableExists(p_local->uuid())) {
+          update_values(*p_local, local_graph_->getVariable(p_local->uuid()));
+        } else {
+          transaction.addVariable(p_local);
+        }
+        if (local_graph_->variableExists(o_local->uuid())) {
+          update_values(*o_local, local_graph_->getVariable(o_local->uuid()));
+        } else {
+          transaction.addVariable(o_local);
+        }
       }
     }
   }
 
-  // add variables
+  // add or update all other variables, poses are expressed in the local graph
+  // world frame so they are handled above
   for (const auto& v : new_graph.getVariables()) {
-    if (v.type() != "fuse_variables::Position3DStamped" ||
-        v.type() != "fuse_variables::Orientation3DStamped") {
-      local_graph_->addVariable(std::move(v.clone()));
+    if (v.type() == "fuse_variables::Position3DStamped" ||
+        v.type() == "fuse_variables::Orientation3DStamped") {
+      continue;
+    }
+    if (local_graph_->variableExists(v.uuid())) {
+      update_values(v, local_graph_->getVariable(v.uuid()));
+    } else {
+      transaction.addVariable(std::move(v.clone()));
     }
   }
 
-  // add inertial and motion model constraints
+  // add new inertial and motion model constraints
   for (const auto& c : new_graph.getConstraints()) {
-    if (c.source() == "bs_models::Unicycle3D" ||
-        c.source() == "bs_models::InertialOdometry") {
-      local_graph_->addConstraint(std::move(c.clone()));
+    if (c.source() != "bs_models::Unicycle3D" &&
+        c.source() != "bs_models::InertialOdometry") {
+      continue;
+    }
+    if (imported_constraints_.insert(c.uuid()).second &&
+        !local_graph_->constraintExists(c.uuid())) {
+      transaction.addConstraint(std::move(c.clone()));
     }
   }
-  local_graph_->optimizeFor(ros::Duration(0.02), local_solver_options_);
-}
 
-void VisualOdometry::MarginalizeLocalGraph(const fuse_core::Graph& new_graph) {
-  const auto new_timestamps = bs_common::CurrentTimestamps(new_graph);
-  const auto current_timestamps = bs_common::CurrentTimestamps(*local_graph_);
-  const ros::Time oldest_new_time = *new_timestamps.begin();
+  // remove constraints that were removed from the main graph
+  for (auto iter = imported_constraints_.begin();
+       iter != imported_constraints_.end();) {
+    if (new_graph.constraintExists(*iter)) {
+      iter++;
+      continue;
+    }
+    if (local_graph_->constraintExists(*iter)) {
+      transaction.removeConstraint(*iter);
+    }
+    iter = imported_constraints_.erase(iter);
+  }
 
-  for (const auto& t : current_timestamps) {
-    if (t > oldest_new_time) { break; }
+  ApplyLocalTransaction(transaction);
+  OptimizeLocalGraph(0.02);
+}
 
-    std::vector<fuse_core::UUID> constraints_to_remove;
+void VisualOdometry::ApplyLocalTransaction(
+    const fuse_core::Transaction& transaction) {
+  for (const auto& uuid : transaction.removedVariables()) {
+    if (!local_graph_->variableExists(uuid)) { continue; }
+    const auto position =
+        dynamic_cast<const fuse_variables::Position3DStamped*>(
+            &local_graph_->getVariable(uuid));
+    if (position) { local_stamps_.Erase(position->stamp()); }
+  }
+  local_graph_->update(transaction);
+  local_problem_.Update(*local_graph_, transaction);
+  if (landmark_cloud_.Initialized()) {
+    landmark_cloud_.Update(*local_graph_, transaction);
+  }
+  for (const auto& variable : transaction.addedVariables()) {
+    const auto position =
+        dynamic_cast<const fuse_variables::Position3DStamped*>(&variable);
+    if (position) { local_stamps_.Insert(position->stamp()); }
+  }
+}
+
+void VisualOdometry::OptimizeLocalGraph(double max_time_s) {
+  ceres::Solver::Options options = local_solver_options_;
+  options.max_solver_time_in_seconds = max_time_s;
+  local_problem_.Optimize(options);
+}
 
+void VisualOdometry::MarginalizeLocalGraph(const fuse_core::Graph& new_graph) {
+  const auto new_stamps = bs_common::GetStampIndex(new_graph);
+  if (new_stamps->Empty() || local_stamps_.Empty()) { return; }
+  const ros::Time oldest_new_time = new_stamps->Oldest();
+
+  // constraints need to be removed before the variables they use, which the
+  // graph does when applying a transaction
+  fuse_core::Transaction transaction;
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash>
+      constraints_to_remove;
+  for (const auto& t :
+       local_stamps_.Range(local_stamps_.Oldest(), oldest_new_time)) {
     auto p = bs_common::GetPosition(*local_graph_, t);
     if (p) {
       auto p_constraints = local_graph_->getConnectedConstraints(p->uuid());
       for (const auto& c : p_constraints) {
-        constraints_to_remove.push_back(c.uuid());
+        constraints_to_remove.insert(c.uuid());
       }
     }
 
@@ -927,7 +1626,7 @@ void VisualOdometry::MarginalizeLocalGraph(const fuse_core::Graph& new_graph) {
     if (o) {
       auto o_constraints = local_graph_->getConnectedConstraints(o->uuid());
       for (const auto& c : o_constraints) {
-        constraints_to_remove.push_back(c.uuid());
+        constraints_to_remove.insert(c.uuid());
       }
     }
 
@@ -935,7 +1634,7 @@ void VisualOdometry::MarginalizeLocalGraph(const fuse_core::Graph& new_graph) {
     if (bg) {
       auto bg_constraints = local_graph_->getConnectedConstraints(bg->uuid());
       for (const auto& c : bg_constraints) {
-        constraints_to_remove.push_back(c.uuid());
+        constraints_to_remove.insert(c.uuid());
       }
     }
 
@@ -943,7 +1642,7 @@ void VisualOdometry::MarginalizeLocalGraph(const fuse_core::Graph& new_graph) {
     if (ba) {
       auto ba_constraints = local_graph_->getConnectedConstraints(ba->uuid());
       for (const auto& c : ba_constraints) {
-        constraints_to_remove.push_back(c.uuid());
+        constraints_to_remove.insert(c.uuid());
       }
     }
 
@@ -951,34 +1650,30 @@ void VisualOdometry::MarginalizeLocalGraph(const fuse_core::Graph& new_graph) {
     if (v) {
       auto v_constraints = local_graph_->getConnectedConstraints(v->uuid());
       for (const auto& c : v_constraints) {
-        constraints_to_remove.push_back(c.uuid());
-      }
-    }
-
-    for (const auto uuid : constraints_to_remove) {
-      if (local_graph_->constraintExists(uuid)) {
-        try {
-          local_graph_->removeConstraint(uuid);
-        } catch (const std::exception& e) {}
+        constraints_to_remove.insert(c.uuid());
       }
     }
 
-    if (p) { local_graph_->removeVariable(p->uuid()); }
-    if (o) { local_graph_->removeVariable(o->uuid()); }
-    if (ba) { local_graph_->removeVariable(ba->uuid()); }
-    if (bg) { local_graph_->removeVariable(bg->uuid()); }
-    if (v) { local_graph_->removeVariable(v->uuid()); }
+    if (p) { transaction.removeVariable(p->uuid()); }
+    if (o) { transaction.removeVariable(o->uuid()); }
+    if (ba) { transaction.removeVariable(ba->uuid()); }
+    if (bg) { transaction.removeVariable(bg->uuid()); }
+    if (v) { transaction.removeVariable(v->uuid()); }
   }
+  for (const auto& uuid : constraints_to_remove) {
+    transaction.removeConstraint(uuid);
+  }
+  ApplyLocalTransaction(transaction);
 
   // remove any disconnected landmarks
+  fuse_core::Transaction landmark_transaction;
   const auto landmarks = bs_common::CurrentLandmarkIDs(*local_graph_);
   for (auto& lm : landmarks) {
     const auto lm_uuid = visual_map_->GetLandmarkUUID(lm);
     auto constraints = local_graph_->getConnectedConstraints(lm_uuid);
-    auto num_constraints =
-        std::distance(constraints.begin(), constraints.end());
-    if (constraints.empty()) { local_graph_->removeVariable(lm_uuid); }
+    if (constraints.empty()) { landmark_transaction.removeVariable(lm_uuid); }
   }
+  ApplyLocalTransaction(landmark_transaction);
 }
 
 fuse_core::Transaction::SharedPtr VisualOdometry::CreateVisualOdometryFactor(
@@ -1063,6 +1758,15 @@ fuse_core::Transaction::SharedPtr VisualOdometry::CreateVisualOdometryFactor(
 bool VisualOdometry::GetInitialPoseEstimate(const ros::Time& timestamp,
                                             Eigen::Matrix4d& T_WORLD_BASELINK) {
   std::string error;
+  if (FollowsRestoredKeyframe()) {
+    // assumes the robot didn't move much during the restart, the pose is
+    // refined against the restored landmarks
+    auto T_WORLD_BASELINKrestored =
+        visual_map_->GetBaselinkPose(previous_keyframe_);
+    if (!T_WORLD_BASELINKrestored.has_value()) { return false; }
+    T_WORLD_BASELINK = T_WORLD_BASELINKrestored.value();
+    return true;
+  }
   if (use_frame_init_relative_) {
     Eigen::Matrix4d T_PREVKF_CURFRAME;
     if (!frame_initializer_->GetRelativePose(T_PREVKF_CURFRAME,
@@ -1090,25 +1794,100 @@ bool VisualOdometry::GetInitialPoseEstimate(const ros::Time& timestamp,
   return true;
 }
 
-void VisualOdometry::PruneKeyframes(const fuse_core::Graph& new_graph) {
-  // publish keyframes as chunks and remove them
-  const auto new_timestamps = bs_common::CurrentTimestamps(new_graph);
-  while (!keyframes_.empty() &&
-         new_timestamps.find((*keyframes_.begin()).first) ==
-             new_timestamps.end()) {
-    PublishSlamChunk((*keyframes_.begin()).second);
-    keyframes_.erase((*keyframes_.begin()).first);
+void VisualOdometry::PruneKeyframes(const bs_common::StampIndex& new_stamps) {
+  // publish keyframes as chunks and remove them, all at once since the
+  // keyframes are stored contiguously
+  auto first_kept = keyframes_.begin();
+  while (first_kept != keyframes_.end() &&
+         !new_stamps.Contains(first_kept->first)) {
+    PublishSlamChunk(first_kept->second);
+    bow_service_->RemoveFromIndex(first_kept->first);
+    first_kept++;
+  }
+  keyframes_.erase(keyframes_.begin(), first_kept);
+  if (keyframes_.empty()) {
+    keyframe_tracks_.Clear();
+  } else {
+    keyframe_tracks_.RemoveBefore(keyframes_.begin()->first);
   }
 }
 
-void VisualOdometry::PublishLandmarkPointCloud(const fuse_core::Graph& graph) {
+void VisualOdometry::UpdateMemoryAccounts() {
+  static bs_common::MemoryAccount& keyframes_account =
+      bs_common::MemoryAccounting::GetInstance().GetAccount(
+          "visual_odometry/keyframes");
+  static bs_common::MemoryAccount& landmarks_account =
+      bs_common::MemoryAccounting::GetInstance().GetAccount(
+          "visual_odometry/landmark_container");
+
+  // keyframes are only removed once marginalized, so this is only reported
+  uint64_t keyframe_bytes{0};
+  for (const auto& [stamp, keyframe] : keyframes_) {
+    const auto& msg = keyframe.MeasurementMessage();
+    keyframe_bytes +=
+        msg.image.data.size() + msg.descriptors.size() +
+        msg.landmarks.size() * sizeof(bs_common::LandmarkMeasurementMsg) +
+        msg.landmark_ids.size() * (sizeof(uint64_t) + 2 * sizeof(float)) +
+        keyframe.Trajectory().size() * sizeof(Eigen::Matrix4d);
+  }
+  keyframes_account.Update(keyframes_.size(), keyframe_bytes);
+
+  // remove the oldest measurements if over budget, as for max_container_size
+  auto update_landmarks = [&]() {
+    landmarks_account.Update(
+        landmark_container_->size(),
+        landmark_container_->size() *
+            sizeof(beam_containers::LandmarkMeasurement));
+  };
+  update_landmarks();
+  while (landmarks_account.OverBudget() &&
+         landmark_container_->NumImages() > 1) {
+    bow_service_->RemoveFrame(
+        *landmark_container_->GetMeasurementTimes().begin());
+    landmark_container_->PopFront();
+    update_landmarks();
+  }
+}
+
+void VisualOdometry::PublishLandmarkPointCloud(
+    const fuse_core::Transaction& transaction) {
   static size_t count = 0;
-  // publish landmarks as a point cloud
-  pcl::PointCloud<pcl::PointXYZRGBL> cloud =
-      bs_models::graph_visualization::GetGraphCameraLandmarksAsCloud(graph);
-  sensor_msgs::PointCloud2 ros_cloud = beam::PCLToROS<pcl::PointXYZRGBL>(
-      cloud, ros::Time::now(), extrinsics_.GetWorldFrameId(), count++);
-  camera_landmarks_publisher_.publish(ros_cloud);
+  // the cloud isn't kept without subscribers, it is rebuilt from the local
+  // graph once someone subscribes
+  if (camera_landmarks_publisher_.getNumSubscribers() == 0 &&
+      camera_landmark_updates_publisher_.getNumSubscribers() == 0) {
+    landmark_cloud_.Clear();
+    return;
+  }
+  if (landmark_cloud_.Initialized()) {
+    // the landmarks of the transaction were just optimized
+    landmark_cloud_.Update(*local_graph_, transaction);
+  } else {
+    landmark_cloud_.Reset(*local_graph_);
+  }
+
+  const ros::Time now = ros::Time::now();
+  if (!landmark_cloud_.Changed() ||
+      now < last_landmarks_publish_time_ +
+                ros::Duration(vo_params_.landmarks_publish_period)) {
+    return;
+  }
+  last_landmarks_publish_time_ = now;
+
+  // publish landmarks moved since the last publish, and all landmarks
+  if (camera_landmark_updates_publisher_.getNumSubscribers() > 0) {
+    camera_landmark_updates_publisher_.publish(
+        beam::PCLToROS<pcl::PointXYZRGBL>(landmark_cloud_.TakeUpdates(), now,
+                                          extrinsics_.GetWorldFrameId(),
+                                          count));
+  } else {
+    landmark_cloud_.TakeUpdates();
+  }
+  if (camera_landmarks_publisher_.getNumSubscribers() > 0) {
+    camera_landmarks_publisher_.publish(beam::PCLToROS<pcl::PointXYZRGBL>(
+        landmark_cloud_.Cloud(), now, extrinsics_.GetWorldFrameId(), count));
+  }
+  count++;
 }
 
 void VisualOdometry::PublishOdometry(
@@ -1159,60 +1938,54 @@ void VisualOdometry::PublishPose(const ros::Time& timestamp,
 }
 
 void VisualOdometry::ProjectMapPoints(const Eigen::Matrix4d& T_WORLD_BASELINK) {
-  landmark_projection_mask_ =
-      cv::Mat::zeros(cam_model_->GetWidth(), cam_model_->GetHeight(), CV_8UC1);
-  image_projection_to_lm_id_.clear();
+  projected_landmarks_grid_.Reset(cam_model_->GetWidth(),
+                                  cam_model_->GetHeight(),
+                                  local_map_search_radius_);
+
+  // cull landmarks outside the camera view, then project the rest
+  const vision::LandmarkStore& landmarks = visual_map_->GetLandmarkStore();
+  const Eigen::Matrix4d T_CAM_WORLD =
+      T_cam_baselink_ * beam::InvertTransform(T_WORLD_BASELINK);
+  landmarks.GetLandmarksInView(T_CAM_WORLD, max_view_angle_,
+                               visible_landmarks_);
+  landmarks.Project(cam_model_, T_CAM_WORLD, visible_landmarks_,
+                    projected_landmarks_, projected_pixels_);
+  for (int i = 0; i < projected_landmarks_.size(); i++) {
+    projected_landmarks_grid_.Add(projected_pixels_[i],
+                                  landmarks.Id(projected_landmarks_[i]));
+  }
+}
 
-  const auto landmarks = visual_map_->GetLandmarks();
-  for (const auto& [id, point] : landmarks) {
-    // transform into current frame
-    Eigen::Vector3d point_t_cam =
-        ((T_cam_baselink_ * beam::InvertTransform(T_WORLD_BASELINK)) *
-         point.homogeneous())
-            .hnormalized();
-    // project into image and store
-    Eigen::Vector2d pixel;
-    bool in_image = false;
-    if (!cam_model_->ProjectPoint(point_t_cam, pixel, in_image) || !in_image) {
-      continue;
+double VisualOdometry::ComputeMaxViewAngle() {
+  // back project the image corners and edge midpoints to find the max angle
+  // from the optical axis
+  const int w = cam_model_->GetWidth() - 1;
+  const int h = cam_model_->GetHeight() - 1;
+  const std::vector<Eigen::Vector2i, beam::AlignVec2i> pixels{
+      {0, 0},     {w / 2, 0}, {w, 0},     {0, h / 2},
+      {w, h / 2}, {0, h},     {w / 2, h}, {w, h}};
+  double max_angle = 0;
+  for (const auto& pixel : pixels) {
+    Eigen::Vector3d ray;
+    if (!cam_model_->BackProject(pixel, ray)) {
+      // don't cull anything if we can't determine the field of view
+      return M_PI;
     }
-    landmark_projection_mask_.at<uchar>(pixel[0], pixel[1]) = 1;
-    uint64_t pixel_index = pixel[1] * cam_model_->GetWidth() + pixel[0];
-    image_projection_to_lm_id_[pixel_index] = id;
+    max_angle = std::max(max_angle, std::acos(ray[2] / ray.norm()));
   }
+  return max_angle;
 }
 
 bool VisualOdometry::SearchLocalMap(const Eigen::Vector2d& pixel,
                                     const Eigen::Vector3d& viewing_angle,
                                     const uint64_t word_id,
                                     uint64_t& matched_id) {
-  // compute the search radius around the pixel
-  Eigen::Vector2i top_left{static_cast<int>(pixel[0]) - 10,
-                           static_cast<int>(pixel[1]) - 10};
-  Eigen::Vector2i bottom_right{static_cast<int>(pixel[0]) + 10,
-                               static_cast<int>(pixel[1]) + 10};
-  if (top_left[0] < 0) { top_left[0] = 0; }
-  if (top_left[1] < 0) { top_left[1] = 0; }
-  if (bottom_right[0] > cam_model_->GetHeight()) {
-    bottom_right[0] = cam_model_->GetHeight();
-  }
-  if (bottom_right[1] > cam_model_->GetWidth()) {
-    bottom_right[1] = cam_model_->GetWidth();
-  }
-
   // find all candidate landmarks within the radius
-  std::vector<uint64_t> candidate_lm_matches;
-  for (int row = top_left[1]; row < bottom_right[1]; row++) {
-    for (int col = top_left[0]; col < bottom_right[0]; col++) {
-      if (landmark_projection_mask_.at<uchar>(col, row) != 0) {
-        uint64_t pixel_index = row * cam_model_->GetWidth() + col;
-        candidate_lm_matches.push_back(image_projection_to_lm_id_[pixel_index]);
-      }
-    }
-  }
+  projected_landmarks_grid_.Search(pixel, local_map_search_radius_,
+                                   candidate_lm_matches_);
 
   // check each candidate for a match
-  for (const uint64_t id : candidate_lm_matches) {
+  for (const uint64_t id : candidate_lm_matches_) {
     auto landmark = visual_map_->GetLandmark(id);
     if (!landmark) { continue; }
     if (landmark->word_id() == word_id) {
@@ -1246,33 +2019,34 @@ void VisualOdometry::CleanNewToOldLandmarkMap(
 
 double VisualOdometry::ComputeAverageReprojection(
     const Eigen::Matrix4d& T_WORLD_BASELINK,
-    const std::vector<Eigen::Vector2i, beam::AlignVec2i>& pixels,
-    const std::vector<Eigen::Vector3d, beam::AlignVec3d>& points) {
-  if (pixels.size() == 0) { return 0; }
+    const std::vector<vision::RigPoseRefinement::Correspondences>&
+        correspondences) {
+  size_t num_points = 0;
   double total_reproj = 0.0;
   const Eigen::Matrix4d T_BASELINK_WORLD =
       beam::InvertTransform(T_WORLD_BASELINK);
-  for (int i = 0; i < pixels.size(); i++) {
-    const auto p_WORLD = points[i];
-    const Eigen::Vector3d p_CAMERA =
-        ((T_cam_baselink_ * T_BASELINK_WORLD) * p_WORLD.homogeneous())
-            .hnormalized();
-
-    Eigen::Vector2d projection;
-    bool in_image{false};
-    if (!cam_model_->ProjectPoint(p_CAMERA, projection, in_image) ||
-        !in_image) {
-      continue;
-    } else {
-      total_reproj += (pixels[i].cast<double>() - projection).norm();
-    }
+  for (size_t c = 0; c < correspondences.size(); c++) {
+    const vision::RigCamera& camera = camera_rig_->Camera(c);
+    const Eigen::VectorXd errors = vision::ComputeReprojectionErrors(
+        camera.model, camera.T_cam_baselink * T_BASELINK_WORLD,
+        correspondences[c].pixels, correspondences[c].points);
+    // points that don't project into the image count as a zero error
+    num_points += correspondences[c].pixels.size();
+    total_reproj += errors.cwiseMax(0.0).sum();
   }
 
-  return total_reproj / static_cast<double>(pixels.size());
+  if (num_points == 0) { return 0; }
+  return total_reproj / static_cast<double>(num_points);
 }
 
 void VisualOdometry::shutdown() {
+  if (frame_initializer_) { frame_initializer_->CancelWakeup(); }
   measurement_subscriber_.shutdown();
+  for (auto& subscriber : additional_measurement_subscribers_) {
+    subscriber.shutdown();
+  }
+  backpressure_subscriber_.shutdown();
+  backpressure_ = false;
   imu_constraint_trigger_counter_ = 0;
   num_loc_fails_in_a_row_ = 0;
   track_lost_ = false;
@@ -1281,13 +2055,24 @@ void VisualOdometry::shutdown() {
   is_initialized_ = false;
   resetting_ = false;
   keyframes_.clear();
+  keyframe_tracks_.Clear();
   visual_measurement_buffer_.clear();
+  if (frame_set_assembler_) {
+    std::lock_guard<std::mutex> lk(frame_set_mutex_);
+    frame_set_assembler_->Clear();
+  }
   prev_frame_ = ros::Time(0);
   previous_keyframe_ = ros::Time(0);
+  restored_keyframe_ = ros::Time(0);
+  keyframe_parallax_->Clear();
+  landmark_cloud_.Clear();
   if (local_graph_) { local_graph_->clear(); }
+  local_problem_.Clear();
+  local_stamps_.Clear();
+  imported_constraints_.clear();
   visual_map_->Clear();
   validator_->Clear();
-  image_db_->Clear();
+  bow_service_->Clear();
   landmark_container_->clear();
 }
 
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/vision/camera_measurement_view.h>
+
+using namespace bs_models::vision;
+
+TEST(CameraMeasurementView, PackedRoundTrip) {
+  std::vector<uint64_t> ids{3, 7, 42};
+  std::vector<cv::Mat> descriptors;
+  std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+      pixels;
+  for (size_t i = 0; i < ids.size(); i++) {
+    cv::Mat descriptor(1, 32, CV_8U);
+    for (int j = 0; j < 32; j++) { descriptor.at<uint8_t>(0, j) = i * 32 + j; }
+    descriptors.push_back(descriptor);
+    pixels.emplace_back(10.5 * i, 20.25 * i);
+  }
+
+  bs_common::CameraMeasurementMsg msg;
+  PackLandmarkMeasurements(ids, descriptors, pixels, msg);
+  EXPECT_TRUE(msg.packed);
+  EXPECT_TRUE(msg.landmarks.empty());
+  EXPECT_EQ(msg.descriptors.size(), ids.size() * 32);
+
+  const CameraMeasurementView view(msg);
+  ASSERT_EQ(view.Size(), ids.size());
+  for (size_t i = 0; i < ids.size(); i++) {
+    EXPECT_EQ(view.LandmarkId(i), ids[i]);
+    EXPECT_EQ(view.Pixel(i), pixels[i]);
+    const cv::Mat descriptor = view.Descriptor(i);
+    EXPECT_EQ(descriptor.type(), CV_8U);
+    EXPECT_EQ(cv::norm(descriptor, descriptors[i], cv::NORM_HAMMING), 0);
+    // descriptors are views into the message
+    EXPECT_EQ(descriptor.data, msg.descriptors.data() + i * 32);
+  }
+}
+
+TEST(CameraMeasurementView, Empty) {
+  bs_common::CameraMeasurementMsg msg;
+  EXPECT_TRUE(CameraMeasurementView(msg).Empty());
+  PackLandmarkMeasurements({}, {}, {}, msg);
+  EXPECT_TRUE(CameraMeasurementView(msg).Empty());
+}
+
+TEST(CameraMeasurementView, InvalidPackedSizes) {
+  bs_common::CameraMeasurementMsg msg;
+  msg.packed = true;
+  msg.landmark_ids = {1, 2};
+  msg.pixels_u = {1, 2};
+  msg.pixels_v = {1};
+  EXPECT_THROW(CameraMeasurementView view(msg), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
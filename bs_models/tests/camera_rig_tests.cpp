@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <beam_utils/math.h>
+
+#include <bs_models/vision/camera_rig.h>
+#include <bs_models/vision/rig_pose_refinement.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+std::shared_ptr<beam_calibration::CameraModel> LoadCameraModel() {
+  std::string current_file = "camera_rig_tests.cpp";
+  std::string test_path = __FILE__;
+  test_path.erase(test_path.end() - current_file.size(), test_path.end());
+  auto cam_model = beam_calibration::CameraModel::Create(
+      test_path + "data/intrinsics.json");
+  cam_model->InitUndistortMap();
+  return cam_model;
+}
+
+Eigen::Matrix4d Transform(double yaw, const Eigen::Vector3d& t) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  T.block<3, 1>(0, 3) = t;
+  return T;
+}
+
+// points in front of the camera, with their measured (distorted) pixels
+RigPoseRefinement::Correspondences
+    MakeCorrespondences(const RigCamera& camera,
+                        const Eigen::Matrix4d& T_WORLD_BASELINK) {
+  RigPoseRefinement::Correspondences correspondences;
+  const Eigen::Matrix4d T_WORLD_CAMERA =
+      T_WORLD_BASELINK * camera.T_baselink_cam;
+  for (int x = -2; x <= 2; x++) {
+    for (int y = -2; y <= 2; y++) {
+      const Eigen::Vector3d p_CAMERA(x, 0.6 * y, 6 + 0.5 * ((x + y) % 3));
+      Eigen::Vector2d pixel;
+      bool in_image{false};
+      if (!camera.model->ProjectPoint(p_CAMERA, pixel, in_image) ||
+          !in_image) {
+        continue;
+      }
+      correspondences.pixels.push_back(pixel.array().round().cast<int>());
+      correspondences.points.push_back(
+          (T_WORLD_CAMERA * p_CAMERA.homogeneous()).hnormalized());
+    }
+  }
+  return correspondences;
+}
+
+} // namespace
+
+TEST(CameraRig, LandmarkIds) {
+  EXPECT_EQ(CameraRig::GlobalLandmarkId(0, 42), 42);
+  const uint64_t id = CameraRig::GlobalLandmarkId(3, 42);
+  EXPECT_NE(id, 42);
+  EXPECT_EQ(CameraRig::SensorId(id), 3);
+  EXPECT_EQ(CameraRig::SensorId(42), 0);
+  EXPECT_NE(CameraRig::GlobalLandmarkId(1, 42),
+            CameraRig::GlobalLandmarkId(2, 42));
+}
+
+TEST(CameraRig, Cameras) {
+  auto cam_model = LoadCameraModel();
+  CameraRig rig;
+  EXPECT_TRUE(rig.Empty());
+  rig.AddCamera(2, "cam0", cam_model, Eigen::Matrix4d::Identity());
+
+  // a single camera rig owns all landmarks
+  size_t index;
+  ASSERT_TRUE(rig.IndexOfLandmark(CameraRig::GlobalLandmarkId(5, 1), index));
+  EXPECT_EQ(index, 0);
+  EXPECT_TRUE(rig.IsPrimary(CameraRig::GlobalLandmarkId(5, 1)));
+
+  // with more cameras the sensor id selects the camera
+  const Eigen::Matrix4d T = Transform(0.5, Eigen::Vector3d(0.1, 0, 0));
+  rig.AddCamera(5, "cam1", cam_model, T);
+  EXPECT_EQ(rig.Size(), 2);
+  EXPECT_THROW(rig.AddCamera(5, "cam2", cam_model, T), std::runtime_error);
+  ASSERT_TRUE(rig.IndexOfLandmark(CameraRig::GlobalLandmarkId(5, 1), index));
+  EXPECT_EQ(index, 1);
+  EXPECT_TRUE(rig.IsPrimary(CameraRig::GlobalLandmarkId(2, 1)));
+  EXPECT_FALSE(rig.IsPrimary(CameraRig::GlobalLandmarkId(5, 1)));
+  EXPECT_FALSE(rig.IndexOfLandmark(CameraRig::GlobalLandmarkId(7, 1), index));
+  EXPECT_EQ(rig.CameraOfLandmark(CameraRig::GlobalLandmarkId(7, 1)), nullptr);
+  EXPECT_EQ(rig.CameraOfLandmark(CameraRig::GlobalLandmarkId(5, 1))->frame_id,
+            "cam1");
+  EXPECT_TRUE(rig.Camera(1).T_baselink_cam.isApprox(beam::InvertTransform(T)));
+
+  rig.SetExtrinsics(0, T);
+  EXPECT_TRUE(rig.Primary().T_cam_baselink.isApprox(T));
+  EXPECT_TRUE(rig.Primary().T_baselink_cam.isApprox(beam::InvertTransform(T)));
+}
+
+TEST(RigPoseRefinement, TwoCameras) {
+  auto cam_model = LoadCameraModel();
+  CameraRig rig;
+  rig.AddCamera(0, "cam0", cam_model, Eigen::Matrix4d::Identity());
+  rig.AddCamera(1, "cam1", cam_model,
+                Transform(M_PI / 2, Eigen::Vector3d(0.2, 0, -0.1)));
+
+  const Eigen::Matrix4d T_WORLD_BASELINK =
+      Transform(0.3, Eigen::Vector3d(1, 2, 0.5));
+  std::vector<RigPoseRefinement::Correspondences> correspondences{
+      MakeCorrespondences(rig.Camera(0), T_WORLD_BASELINK),
+      MakeCorrespondences(rig.Camera(1), T_WORLD_BASELINK)};
+  ASSERT_GT(correspondences[0].pixels.size(), 10);
+  ASSERT_GT(correspondences[1].pixels.size(), 10);
+
+  RigPoseRefinement::Params params;
+  params.max_solver_time = 1.0;
+  params.max_iterations = 50;
+  RigPoseRefinement refiner(params);
+
+  Eigen::Matrix4d T_estimate = T_WORLD_BASELINK;
+  T_estimate.block<3, 3>(0, 0) *=
+      Eigen::AngleAxisd(0.03, Eigen::Vector3d(1, 1, 0).normalized())
+          .toRotationMatrix();
+  T_estimate.block<3, 1>(0, 3) += Eigen::Vector3d(0.1, -0.05, 0.08);
+  Eigen::Matrix<double, 6, 6> covariance;
+  ASSERT_TRUE(refiner.Refine(rig, correspondences, T_estimate, &covariance));
+
+  EXPECT_LT((T_estimate.block<3, 1>(0, 3) - T_WORLD_BASELINK.block<3, 1>(0, 3))
+                .norm(),
+            0.02);
+  const Eigen::AngleAxisd error(T_estimate.block<3, 3>(0, 0).transpose() *
+                                T_WORLD_BASELINK.block<3, 3>(0, 0));
+  EXPECT_LT(std::abs(error.angle()), 0.005);
+  EXPECT_TRUE(covariance.isApprox(covariance.transpose()));
+  for (int i = 0; i < 6; i++) { EXPECT_GT(covariance(i, i), 0); }
+
+  // not enough correspondences
+  std::vector<RigPoseRefinement::Correspondences> empty(2);
+  Eigen::Matrix4d T_unchanged = T_WORLD_BASELINK;
+  EXPECT_FALSE(refiner.Refine(rig, empty, T_unchanged));
+  EXPECT_TRUE(T_unchanged.isApprox(T_WORLD_BASELINK));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include <nlohmann/json.hpp>
+
+#include <beam_filtering/Utils.h>
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/filter_pipeline.h>
+
+using namespace bs_models;
+
+namespace {
+
+PointCloud CreateRandomCloud(size_t size) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> distribution(-30, 30);
+  PointCloud cloud;
+  for (size_t i = 0; i < size; i++) {
+    cloud.push_back(pcl::PointXYZ(distribution(generator),
+                                  distribution(generator),
+                                  distribution(generator)));
+  }
+  return cloud;
+}
+
+std::vector<beam_filtering::FilterParamsType>
+    LoadFilters(const std::string& json_str) {
+  return beam_filtering::LoadFilterParamsVector(
+      nlohmann::json::parse(json_str)["filters"]);
+}
+
+const std::string kCropBoxFilters = R"({
+  "filters":[
+    {
+      "filter_type": "CROPBOX",
+      "min": [-1.5, -0.5, -1],
+      "max": [0.5, 0.5, 1],
+      "remove_outside_points": false
+    },
+    {
+      "filter_type": "CROPBOX",
+      "min": [-25, -25, -25],
+      "max": [25, 25, 25],
+      "remove_outside_points": true
+    }
+  ]
+})";
+
+const std::string kCropBoxVoxelFilters = R"({
+  "filters":[
+    {
+      "filter_type": "CROPBOX",
+      "min": [-25, -25, -25],
+      "max": [25, 25, 25],
+      "remove_outside_points": true
+    },
+    {
+      "filter_type": "VOXEL",
+      "cell_size": [0.5, 0.5, 0.5]
+    }
+  ]
+})";
+
+} // namespace
+
+TEST(FilterPipeline, CropBoxesMatchBeamFiltering) {
+  const PointCloud cloud = CreateRandomCloud(10000);
+  const auto filter_params = LoadFilters(kCropBoxFilters);
+  FilterPipeline<pcl::PointXYZ> pipeline(filter_params);
+  EXPECT_EQ(pipeline.NumStages(), 1u);
+
+  const PointCloud expected =
+      beam_filtering::FilterPointCloud<pcl::PointXYZ>(cloud, filter_params);
+  const PointCloud filtered = pipeline.Filter(cloud);
+  ASSERT_EQ(filtered.size(), expected.size());
+  for (size_t i = 0; i < filtered.size(); i++) {
+    EXPECT_EQ(filtered[i].x, expected[i].x);
+    EXPECT_EQ(filtered[i].y, expected[i].y);
+    EXPECT_EQ(filtered[i].z, expected[i].z);
+  }
+}
+
+TEST(FilterPipeline, VoxelMatchesBeamFiltering) {
+  const PointCloud cloud = CreateRandomCloud(100000);
+  const auto filter_params = LoadFilters(kCropBoxVoxelFilters);
+  FilterPipeline<pcl::PointXYZ> pipeline(filter_params);
+  EXPECT_EQ(pipeline.NumStages(), 1u);
+
+  // same voxels, but the point order differs. beam_filtering may split large
+  // clouds before downsampling so allow a few extra voxels
+  const PointCloud expected =
+      beam_filtering::FilterPointCloud<pcl::PointXYZ>(cloud, filter_params);
+  const PointCloud filtered = pipeline.Filter(cloud);
+  EXPECT_NEAR(filtered.size(), expected.size(), 0.01 * expected.size());
+  for (const auto& p : filtered) {
+    EXPECT_LE(std::abs(p.x), 25);
+    EXPECT_LE(std::abs(p.y), 25);
+    EXPECT_LE(std::abs(p.z), 25);
+  }
+}
+
+TEST(FilterPipeline, InPlace) {
+  const PointCloud cloud = CreateRandomCloud(10000);
+  FilterPipeline<pcl::PointXYZ> pipeline(LoadFilters(kCropBoxVoxelFilters));
+
+  const PointCloud expected = pipeline.Filter(cloud);
+  PointCloud filtered = cloud;
+  pipeline.Filter(filtered, filtered);
+  ASSERT_EQ(filtered.size(), expected.size());
+  for (size_t i = 0; i < filtered.size(); i++) {
+    EXPECT_EQ(filtered[i].x, expected[i].x);
+    EXPECT_EQ(filtered[i].y, expected[i].y);
+    EXPECT_EQ(filtered[i].z, expected[i].z);
+  }
+}
+
+TEST(FilterPipeline, LeanPoints) {
+  const PointCloud cloud = CreateRandomCloud(10000);
+  pcl::PointCloud<PointXYZIRT> wide;
+  for (size_t i = 0; i < cloud.size(); i++) {
+    PointXYZIRT p;
+    p.x = cloud[i].x;
+    p.y = cloud[i].y;
+    p.z = cloud[i].z;
+    p.ring = i % 16;
+    p.intensity = i % 2 == 0 ? -1.0f : 100000.0f;
+    wide.push_back(p);
+  }
+  pcl::PointCloud<LidarPoint> lean;
+  ToLidarPoints(wide, lean);
+  ASSERT_EQ(lean.size(), wide.size());
+  EXPECT_EQ(lean[3].ring, 3);
+  EXPECT_EQ(lean[0].intensity, 0);
+  EXPECT_EQ(lean[1].intensity, 65535);
+
+  // same points as the pcl type, in the same order
+  const auto filter_params = LoadFilters(kCropBoxVoxelFilters);
+  ASSERT_TRUE(FilterPipeline<LidarPoint>::Supports(filter_params));
+  FilterPipeline<LidarPoint> lean_pipeline(filter_params);
+  FilterPipeline<pcl::PointXYZ> pipeline(filter_params);
+  const auto filtered_lean = lean_pipeline.Filter(lean);
+  const PointCloud filtered = pipeline.Filter(cloud);
+  ASSERT_EQ(filtered_lean.size(), filtered.size());
+  for (size_t i = 0; i < filtered.size(); i++) {
+    EXPECT_EQ(filtered_lean[i].x, filtered[i].x);
+    EXPECT_EQ(filtered_lean[i].y, filtered[i].y);
+    EXPECT_EQ(filtered_lean[i].z, filtered[i].z);
+  }
+
+  std::vector<beam_filtering::FilterParamsType> other_params{
+      {beam_filtering::FilterType::DROR, {}}};
+  EXPECT_FALSE(FilterPipeline<LidarPoint>::Supports(other_params));
+  EXPECT_TRUE(FilterPipeline<pcl::PointXYZ>::Supports(other_params));
+  EXPECT_THROW(FilterPipeline<LidarPoint>{other_params},
+               std::invalid_argument);
+}
+
+TEST(FilterPipeline, Empty) {
+  const PointCloud cloud = CreateRandomCloud(100);
+  FilterPipeline<pcl::PointXYZ> pipeline;
+  EXPECT_TRUE(pipeline.Empty());
+  EXPECT_EQ(pipeline.Filter(cloud).size(), cloud.size());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
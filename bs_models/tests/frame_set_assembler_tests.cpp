@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <boost/make_shared.hpp>
+
+#include <bs_models/vision/frame_set_assembler.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+bs_common::CameraMeasurementMsg::ConstPtr Measurement(double time,
+                                                      uint8_t sensor_id) {
+  auto msg = boost::make_shared<bs_common::CameraMeasurementMsg>();
+  msg->header.stamp = ros::Time(time);
+  msg->sensor_id = sensor_id;
+  return msg;
+}
+
+} // namespace
+
+TEST(FrameSetAssembler, CompleteSets) {
+  FrameSetAssembler assembler(3, ros::Duration(0.005));
+  EXPECT_FALSE(assembler.Add(1, Measurement(1.002, 1)));
+  EXPECT_FALSE(assembler.Add(0, Measurement(1.0, 0)));
+  EXPECT_EQ(assembler.NumPending(), 1);
+  const auto set = assembler.Add(2, Measurement(0.997, 2));
+  ASSERT_TRUE(set);
+  ASSERT_EQ(set->size(), 3);
+  EXPECT_EQ(assembler.NumPending(), 0);
+
+  // ordered by camera and restamped to the primary camera
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(set->at(i)->sensor_id, i);
+    EXPECT_EQ(set->at(i)->header.stamp, ros::Time(1.0));
+  }
+}
+
+TEST(FrameSetAssembler, Tolerance) {
+  FrameSetAssembler assembler(2, ros::Duration(0.005));
+  EXPECT_FALSE(assembler.Add(0, Measurement(1.0, 0)));
+  EXPECT_FALSE(assembler.Add(0, Measurement(1.008, 0)));
+  EXPECT_EQ(assembler.NumPending(), 2);
+
+  // matches the closest set, the older one can't be completed anymore
+  const auto set = assembler.Add(1, Measurement(1.005, 1));
+  ASSERT_TRUE(set);
+  EXPECT_EQ(set->at(1)->header.stamp, ros::Time(1.008));
+  EXPECT_EQ(assembler.NumPending(), 0);
+  EXPECT_EQ(assembler.NumDropped(), 1);
+
+  // outside of the tolerance
+  EXPECT_FALSE(assembler.Add(0, Measurement(2.0, 0)));
+  EXPECT_FALSE(assembler.Add(1, Measurement(2.006, 1)));
+  EXPECT_EQ(assembler.NumPending(), 2);
+}
+
+TEST(FrameSetAssembler, DropsIncompleteSets) {
+  FrameSetAssembler assembler(2, ros::Duration(0.005), 3);
+  EXPECT_FALSE(assembler.Add(0, Measurement(1.0, 0)));
+  EXPECT_FALSE(assembler.Add(0, Measurement(2.0, 0)));
+  ASSERT_TRUE(assembler.Add(1, Measurement(2.0, 1)));
+  EXPECT_EQ(assembler.NumPending(), 0);
+  EXPECT_EQ(assembler.NumDropped(), 1);
+
+  // a camera that stopped publishing
+  for (int i = 0; i < 5; i++) {
+    EXPECT_FALSE(assembler.Add(0, Measurement(3.0 + i, 0)));
+  }
+  EXPECT_EQ(assembler.NumPending(), 3);
+  EXPECT_EQ(assembler.NumDropped(), 3);
+
+  assembler.Clear();
+  EXPECT_EQ(assembler.NumPending(), 0);
+  EXPECT_EQ(assembler.NumDropped(), 0);
+
+  // measurements of a camera outside the rig are ignored
+  EXPECT_FALSE(assembler.Add(2, Measurement(10.0, 2)));
+  EXPECT_EQ(assembler.NumPending(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/global_map_merger.h>
+
+using namespace bs_models::global_mapping;
+
+TEST(GlobalMapMerger, SaveLoadShards) {
+  const std::vector<std::string> maps{"session1", "session2", "session3"};
+  std::vector<GlobalMapMerger::Candidate> candidates(5);
+  for (size_t i = 0; i < candidates.size(); i++) {
+    candidates[i].reference_map = i % 2;
+    candidates[i].reference_submap = i;
+    candidates[i].query_map = 2;
+    candidates[i].query_submap = 10 + i;
+    candidates[i].T_REFERENCE_QUERY_EST(0, 3) = i;
+  }
+  const std::string prefix =
+      "/tmp/bs_models_merger_test_" + std::to_string(getpid());
+  ASSERT_TRUE(GlobalMapMerger::SaveCandidates(prefix + "_all.json", maps,
+                                              candidates));
+
+  // each shard verifies its own candidates from the full list
+  for (size_t shard = 0; shard < 2; shard++) {
+    std::vector<GlobalMapMerger::Candidate> loaded;
+    ASSERT_TRUE(GlobalMapMerger::LoadCandidates(prefix + "_all.json", maps,
+                                                loaded));
+    ASSERT_EQ(loaded.size(), candidates.size());
+    for (size_t i = shard; i < loaded.size(); i += 2) {
+      loaded[i].verified = true;
+      loaded[i].successful = i != 3;
+      loaded[i].T_REFERENCE_QUERY(1, 3) = i;
+    }
+    ASSERT_TRUE(GlobalMapMerger::SaveCandidates(
+        prefix + "_" + std::to_string(shard) + ".json", maps, loaded, shard,
+        2));
+  }
+
+  // shards combine into the full list
+  std::vector<GlobalMapMerger::Candidate> merged;
+  ASSERT_TRUE(
+      GlobalMapMerger::LoadCandidates(prefix + "_all.json", maps, merged));
+  for (size_t shard = 0; shard < 2; shard++) {
+    ASSERT_TRUE(GlobalMapMerger::LoadCandidates(
+        prefix + "_" + std::to_string(shard) + ".json", maps, merged));
+  }
+  for (size_t i = 0; i < merged.size(); i++) {
+    EXPECT_EQ(merged[i].reference_map, i % 2);
+    EXPECT_EQ(merged[i].query_submap, 10 + i);
+    EXPECT_TRUE(merged[i].verified);
+    EXPECT_EQ(merged[i].successful, i != 3);
+    EXPECT_NEAR(merged[i].T_REFERENCE_QUERY_EST(0, 3), i, 1e-9);
+    EXPECT_NEAR(merged[i].T_REFERENCE_QUERY(1, 3), i, 1e-9);
+  }
+
+  // candidates of other maps are rejected
+  std::vector<GlobalMapMerger::Candidate> other;
+  EXPECT_FALSE(GlobalMapMerger::LoadCandidates(
+      prefix + "_all.json", {"session1", "session2"}, other));
+
+  for (const std::string suffix : {"_all.json", "_0.json", "_1.json"}) {
+    std::remove((prefix + suffix).c_str());
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
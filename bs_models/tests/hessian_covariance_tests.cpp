@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/scan_registration/hessian_covariance.h>
+
+using namespace bs_models::scan_registration;
+
+namespace {
+
+/**
+ * @brief points of the planes x = 5 (if wall), z = 0 and, if box, y = 5,
+ * with noise of the given standard deviation along the normals
+ */
+PointCloud CreatePlanes(bool wall, bool box, double noise, int seed = 0) {
+  std::mt19937 generator(seed);
+  std::normal_distribution<double> distribution(0, noise);
+  auto n = [&]() { return noise > 0 ? distribution(generator) : 0; };
+  PointCloud cloud;
+  for (double u = -4.95; u < 5; u += 0.1) {
+    for (double v = 0.05; v < 5; v += 0.1) {
+      cloud.push_back(pcl::PointXYZ(u, v, n()));
+      if (wall) { cloud.push_back(pcl::PointXYZ(5 + n(), u, v)); }
+      if (box) { cloud.push_back(pcl::PointXYZ(u, 5 + n(), v)); }
+    }
+  }
+  return cloud;
+}
+
+PointCloud TransformCloud(const PointCloud& cloud, const Eigen::Matrix4d& T) {
+  PointCloud transformed;
+  for (const auto& p : cloud) {
+    const Eigen::Vector3d v =
+        T.block<3, 3>(0, 0) * Eigen::Vector3d(p.x, p.y, p.z) +
+        T.block<3, 1>(0, 3);
+    transformed.push_back(pcl::PointXYZ(v.x(), v.y(), v.z()));
+  }
+  return transformed;
+}
+
+} // namespace
+
+TEST(HessianCovariance, Constrained) {
+  HessianCovariance::Params params;
+  HessianCovariance hessian_covariance(params);
+  const PointCloud reference = CreatePlanes(true, true, 0);
+  hessian_covariance.SetReference({&reference}, {});
+
+  const PointCloud target = CreatePlanes(true, true, 0.02, 1);
+  Eigen::Matrix<double, 6, 6> covariance;
+  ASSERT_TRUE(hessian_covariance.Compute(
+      {&target}, {}, Eigen::Matrix4d::Identity(), covariance));
+  EXPECT_GT(hessian_covariance.NumCorrespondences(), 0.4 * target.size());
+  EXPECT_TRUE(covariance.isApprox(covariance.transpose()));
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> solver(
+      covariance);
+  EXPECT_GT(solver.eigenvalues().minCoeff(), 0);
+  EXPECT_LT(solver.eigenvalues().maxCoeff(), 1e-4);
+
+  // more noise gives a larger covariance
+  const PointCloud noisy_target = CreatePlanes(true, true, 0.1, 1);
+  Eigen::Matrix<double, 6, 6> noisy_covariance;
+  ASSERT_TRUE(hessian_covariance.Compute(
+      {&noisy_target}, {}, Eigen::Matrix4d::Identity(), noisy_covariance));
+  for (int i = 0; i < 6; i++) {
+    EXPECT_GT(noisy_covariance(i, i), 5 * covariance(i, i));
+  }
+}
+
+TEST(HessianCovariance, Degenerate) {
+  // a floor and one wall in the reference, with the target rotated by 90 deg
+  // so the unconstrained translation is along y in the reference frame
+  HessianCovariance::Params params;
+  HessianCovariance hessian_covariance(params);
+  const PointCloud reference = CreatePlanes(true, false, 0);
+  hessian_covariance.SetReference({&reference}, {});
+
+  Eigen::Matrix4d T_REF_TARGET = Eigen::Matrix4d::Identity();
+  T_REF_TARGET.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(M_PI / 2, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T_REF_TARGET(0, 3) = 0.5;
+  const PointCloud target =
+      TransformCloud(CreatePlanes(true, false, 0.02, 1),
+                     T_REF_TARGET.inverse());
+  Eigen::Matrix<double, 6, 6> covariance;
+  ASSERT_TRUE(
+      hessian_covariance.Compute({&target}, {}, T_REF_TARGET, covariance));
+  EXPECT_GT(covariance(1, 1), 1e3 * covariance(0, 0));
+  EXPECT_GT(covariance(1, 1), 1e3 * covariance(2, 2));
+}
+
+TEST(HessianCovariance, TooFewCorrespondences) {
+  HessianCovariance::Params params;
+  HessianCovariance hessian_covariance(params);
+  const PointCloud reference = CreatePlanes(true, true, 0);
+  hessian_covariance.SetReference({&reference}, {});
+
+  // target far away from the reference
+  Eigen::Matrix4d T_REF_TARGET = Eigen::Matrix4d::Identity();
+  T_REF_TARGET(0, 3) = 100;
+  Eigen::Matrix<double, 6, 6> covariance;
+  EXPECT_FALSE(
+      hessian_covariance.Compute({&reference}, {}, T_REF_TARGET, covariance));
+  EXPECT_EQ(hessian_covariance.NumCorrespondences(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/vision/keyframe_image_store.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+cv::Mat CreateImage(int seed) {
+  cv::Mat image(48, 64, CV_8UC1);
+  cv::randu(image, seed, 255);
+  return image;
+}
+
+bool ImagesEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+KeyframeImageStore CreateStore(KeyframeImageStore::Policy policy) {
+  KeyframeImageStore::Params params;
+  params.policy = policy;
+  return KeyframeImageStore(params, "test");
+}
+
+} // namespace
+
+TEST(KeyframeImageStore, LosslessPolicies) {
+  for (const auto policy :
+       {KeyframeImageStore::Policy::KEEP, KeyframeImageStore::Policy::COMPRESS,
+        KeyframeImageStore::Policy::SPILL}) {
+    KeyframeImageStore store = CreateStore(policy);
+    store.Add(10, CreateImage(1));
+    store.Add(20, CreateImage(2));
+    ASSERT_EQ(store.Size(), 2);
+    EXPECT_EQ(store.Stamps(), std::vector<uint64_t>({10, 20}));
+    EXPECT_TRUE(ImagesEqual(store.Get(10), CreateImage(1)));
+    EXPECT_TRUE(ImagesEqual(store.Get(20), CreateImage(2)));
+    EXPECT_TRUE(store.Get(30).empty());
+
+    // copies share the stored images
+    const KeyframeImageStore copy = store;
+    EXPECT_TRUE(ImagesEqual(copy.Get(20), CreateImage(2)));
+  }
+}
+
+TEST(KeyframeImageStore, DropAndDownsample) {
+  KeyframeImageStore dropped = CreateStore(KeyframeImageStore::Policy::DROP);
+  dropped.Add(10, CreateImage(1));
+  EXPECT_EQ(dropped.Size(), 1);
+  EXPECT_TRUE(dropped.Get(10).empty());
+  EXPECT_EQ(dropped.MemoryUsage(), 0);
+
+  KeyframeImageStore downsampled =
+      CreateStore(KeyframeImageStore::Policy::DOWNSAMPLE);
+  downsampled.Add(10, CreateImage(1));
+  const cv::Mat image = downsampled.Get(10);
+  EXPECT_EQ(image.cols, 32);
+  EXPECT_EQ(image.rows, 24);
+}
+
+TEST(KeyframeImageStore, PolicyStrings) {
+  for (const std::string policy :
+       {"KEEP", "DROP", "DOWNSAMPLE", "COMPRESS", "SPILL"}) {
+    EXPECT_EQ(KeyframeImageStore::PolicyToString(
+                  KeyframeImageStore::PolicyFromString(policy)),
+              policy);
+  }
+  EXPECT_THROW(KeyframeImageStore::PolicyFromString("RAW"),
+               std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/vision/keyframe_parallax.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+std::shared_ptr<CameraRig> CreateRig() {
+  std::string current_file = "keyframe_parallax_tests.cpp";
+  std::string test_path = __FILE__;
+  test_path.erase(test_path.end() - current_file.size(), test_path.end());
+  auto cam_model = beam_calibration::CameraModel::Create(
+      test_path + "data/intrinsics.json");
+  cam_model->InitUndistortMap();
+  auto rig = std::make_shared<CameraRig>();
+  rig->AddCamera(0, "cam0", cam_model, Eigen::Matrix4d::Identity());
+  return rig;
+}
+
+std::vector<Eigen::Vector2d, beam::AlignVec2d>
+    Pixels(const std::vector<uint64_t>& ids, double offset) {
+  std::vector<Eigen::Vector2d, beam::AlignVec2d> pixels;
+  for (const uint64_t id : ids) {
+    pixels.emplace_back(300 + 10 * id + offset, 200 + 5 * id);
+  }
+  return pixels;
+}
+
+} // namespace
+
+TEST(KeyframeParallax, Tracking) {
+  KeyframeParallax parallax(CreateRig());
+  const std::vector<uint64_t> ids{1, 2, 3, 4};
+  EXPECT_TRUE(parallax.AddFrame(ros::Time(1), ids, Pixels(ids, 0)));
+  EXPECT_FALSE(parallax.AddFrame(ros::Time(1), ids, Pixels(ids, 0)));
+  EXPECT_TRUE(parallax.SetKeyframe(ros::Time(1)));
+  EXPECT_EQ(parallax.NumKeyframeLandmarks(), 4);
+
+  const std::vector<uint64_t> tracked{2, 3, 5};
+  parallax.AddFrame(ros::Time(2), tracked, Pixels(tracked, 0));
+  EXPECT_EQ(parallax.NumTracked(ros::Time(2)), 2);
+  EXPECT_EQ(parallax.NumTracked(ros::Time(3)), 0);
+
+  // no motion, no parallax
+  EXPECT_NEAR(
+      parallax.AverageParallax(ros::Time(2), Eigen::Matrix3d::Identity()), 0,
+      1.0);
+
+  // pixels moved by 20 pixels
+  parallax.AddFrame(ros::Time(3), tracked, Pixels(tracked, 20));
+  EXPECT_NEAR(
+      parallax.AverageParallax(ros::Time(3), Eigen::Matrix3d::Identity()), 20,
+      2.0);
+}
+
+TEST(KeyframeParallax, FramesAddedBeforeKeyframe) {
+  KeyframeParallax parallax(CreateRig());
+  const std::vector<uint64_t> ids1{1, 2, 3, 4};
+  const std::vector<uint64_t> ids2{3, 4, 5, 6};
+  const std::vector<uint64_t> ids3{4, 5, 6};
+  parallax.AddFrame(ros::Time(1), ids1, Pixels(ids1, 0));
+  parallax.AddFrame(ros::Time(2), ids2, Pixels(ids2, 0));
+  parallax.AddFrame(ros::Time(3), ids3, Pixels(ids3, 0));
+
+  // nothing is tracked until there is a keyframe
+  EXPECT_EQ(parallax.NumTracked(ros::Time(2)), 0);
+  parallax.SetKeyframe(ros::Time(1));
+  EXPECT_EQ(parallax.NumTracked(ros::Time(2)), 2);
+  EXPECT_EQ(parallax.NumTracked(ros::Time(3)), 1);
+
+  // frame 3 is paired again with the new keyframe, and frame 1 is removed
+  parallax.SetKeyframe(ros::Time(2));
+  EXPECT_EQ(parallax.NumFrames(), 2);
+  EXPECT_EQ(parallax.NumTracked(ros::Time(3)), 3);
+
+  parallax.RemoveBefore(ros::Time(3));
+  EXPECT_EQ(parallax.NumFrames(), 1);
+  EXPECT_EQ(parallax.NumKeyframeLandmarks(), 4);
+
+  // an unknown keyframe tracks nothing
+  EXPECT_FALSE(parallax.SetKeyframe(ros::Time(10)));
+  EXPECT_EQ(parallax.NumKeyframeLandmarks(), 0);
+
+  parallax.Clear();
+  EXPECT_EQ(parallax.NumFrames(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
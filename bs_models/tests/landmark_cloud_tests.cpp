@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_variables/position_3d_stamped.h>
+
+#include <bs_models/graph_visualization/landmark_cloud.h>
+#include <bs_variables/point_3d_landmark.h>
+
+using namespace bs_models::graph_visualization;
+
+namespace {
+
+bs_variables::Point3DLandmark::SharedPtr
+    Landmark(uint64_t id, const Eigen::Vector3d& point) {
+  auto landmark = bs_variables::Point3DLandmark::make_shared(
+      id, Eigen::Vector3d::UnitZ(), 0);
+  landmark->x() = point[0];
+  landmark->y() = point[1];
+  landmark->z() = point[2];
+  return landmark;
+}
+
+} // namespace
+
+TEST(LandmarkCloud, Transactions) {
+  fuse_graphs::HashGraph graph;
+  LandmarkCloud cloud;
+  EXPECT_FALSE(cloud.Initialized());
+
+  fuse_core::Transaction transaction;
+  transaction.addVariable(Landmark(1, Eigen::Vector3d(1, 0, 0)));
+  transaction.addVariable(Landmark(2, Eigen::Vector3d(2, 0, 0)));
+  transaction.addVariable(
+      fuse_variables::Position3DStamped::make_shared(ros::Time(1)));
+  graph.update(transaction);
+
+  // only landmarks are in the cloud
+  cloud.Reset(graph);
+  EXPECT_TRUE(cloud.Initialized());
+  EXPECT_TRUE(cloud.Changed());
+  ASSERT_EQ(cloud.Cloud().size(), 2);
+  EXPECT_FALSE(cloud.Changed());
+  EXPECT_EQ(cloud.TakeUpdates().size(), 2);
+  EXPECT_TRUE(cloud.TakeUpdates().empty());
+
+  // add a landmark and remove another
+  fuse_core::Transaction transaction2;
+  const auto landmark3 = Landmark(3, Eigen::Vector3d(3, 0, 0));
+  transaction2.addVariable(landmark3);
+  transaction2.removeVariable(Landmark(1, Eigen::Vector3d::Zero())->uuid());
+  graph.update(transaction2);
+  cloud.Update(graph, transaction2);
+  EXPECT_EQ(cloud.Size(), 2);
+  const auto updates = cloud.TakeUpdates();
+  ASSERT_EQ(updates.size(), 1);
+  EXPECT_EQ(updates[0].label, 3);
+  EXPECT_FLOAT_EQ(updates[0].x, 3);
+
+  const auto& points = cloud.Cloud();
+  ASSERT_EQ(points.size(), 2);
+  for (const auto& p : points) {
+    EXPECT_TRUE(p.label == 2 || p.label == 3);
+    EXPECT_FLOAT_EQ(p.x, static_cast<float>(p.label));
+  }
+
+  // colors only depend on the landmark id
+  LandmarkCloud other;
+  other.Reset(graph);
+  const auto other_updates = other.TakeUpdates();
+  for (const auto& p : other_updates) {
+    if (p.label != 3) { continue; }
+    EXPECT_EQ(p.r, updates[0].r);
+    EXPECT_EQ(p.g, updates[0].g);
+    EXPECT_EQ(p.b, updates[0].b);
+  }
+
+  cloud.Clear();
+  EXPECT_FALSE(cloud.Initialized());
+  EXPECT_EQ(cloud.Size(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
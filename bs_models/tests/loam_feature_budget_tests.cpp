@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/loam_feature_budget.h>
+
+using namespace bs_models;
+
+namespace {
+
+pcl::PointXYZ MakePoint(double azimuth, double range) {
+  return pcl::PointXYZ(range * std::cos(azimuth), range * std::sin(azimuth),
+                       0);
+}
+
+size_t CountInAzimuth(const PointCloud& cloud, double min, double max) {
+  size_t count = 0;
+  for (const auto& p : cloud) {
+    const double azimuth = std::atan2(p.y, p.x);
+    if (azimuth >= min && azimuth < max) { count++; }
+  }
+  return count;
+}
+
+} // namespace
+
+TEST(LoamFeatureBudget, UnderBudget) {
+  LoamFeatureBudget::Params params;
+  params.max_edges = 10;
+  LoamFeatureBudget budget(params);
+  PointCloud cloud;
+  for (int i = 0; i < 10; i++) { cloud.push_back(MakePoint(0.1 * i, 5)); }
+  const PointCloud selected = budget.Select(cloud, 10);
+  ASSERT_EQ(selected.size(), cloud.size());
+  for (size_t i = 0; i < cloud.size(); i++) {
+    EXPECT_EQ(selected[i].x, cloud[i].x);
+  }
+}
+
+TEST(LoamFeatureBudget, SpreadOverBuckets) {
+  LoamFeatureBudget::Params params;
+  params.num_buckets = 4;
+  LoamFeatureBudget budget(params);
+
+  // a cluttered quadrant and three sparse ones, which keep all their points
+  PointCloud cloud;
+  for (int i = 0; i < 1000; i++) {
+    cloud.push_back(MakePoint(0.1 + 1.3 * i / 1000.0, 2 + i % 10));
+  }
+  for (const double start : {-M_PI, -M_PI / 2, M_PI / 2}) {
+    for (int i = 0; i < 10; i++) {
+      cloud.push_back(MakePoint(start + 0.1 + 0.1 * i, 5));
+    }
+  }
+  const PointCloud selected = budget.Select(cloud, 100);
+  ASSERT_EQ(selected.size(), 100);
+  EXPECT_EQ(CountInAzimuth(selected, 0, M_PI / 2), 70);
+  EXPECT_EQ(CountInAzimuth(selected, -M_PI, 0), 20);
+  EXPECT_EQ(CountInAzimuth(selected, M_PI / 2, M_PI), 10);
+
+  // the far points of the cluttered quadrant are kept
+  for (const auto& p : selected) {
+    const double azimuth = std::atan2(p.y, p.x);
+    if (azimuth < 0 || azimuth >= M_PI / 2) { continue; }
+    EXPECT_GE(p.getVector3fMap().norm(), 11 - 1e-4);
+  }
+}
+
+TEST(LoamFeatureBudget, Apply) {
+  LoamFeatureBudget::Params params;
+  params.max_surfaces = 50;
+  LoamFeatureBudget budget(params);
+  EXPECT_TRUE(budget.Enabled());
+
+  beam_matching::LoamPointCloud features;
+  for (int i = 0; i < 200; i++) {
+    const pcl::PointXYZ p = MakePoint(2 * M_PI * i / 200.0 - M_PI, 10);
+    features.edges.strong.cloud.push_back(p);
+    features.surfaces.strong.cloud.push_back(p);
+    features.surfaces.weak.cloud.push_back(p);
+  }
+  budget.Apply(features);
+  EXPECT_EQ(features.edges.strong.cloud.size(), 200);
+  EXPECT_EQ(features.surfaces.strong.cloud.size(), 50);
+  EXPECT_EQ(features.surfaces.weak.cloud.size(), 200);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/scan_registration/loam_solver.h>
+
+using namespace bs_models::scan_registration;
+
+namespace {
+
+/**
+ * @brief corner of a room: surfaces on the planes z = 0, x = 5 and y = 5, and
+ * edges along their intersections
+ */
+beam_matching::LoamPointCloudPtr CreateRoom() {
+  auto room = std::make_shared<beam_matching::LoamPointCloud>();
+  for (double u = 0.05; u < 5; u += 0.1) {
+    for (double v = 0.05; v < 5; v += 0.1) {
+      room->surfaces.strong.cloud.push_back(pcl::PointXYZ(u, v, 0));
+      room->surfaces.strong.cloud.push_back(pcl::PointXYZ(5, u, v));
+      room->surfaces.strong.cloud.push_back(pcl::PointXYZ(u, 5, v));
+    }
+  }
+  for (double u = 0.025; u < 5; u += 0.05) {
+    room->edges.strong.cloud.push_back(pcl::PointXYZ(5, 5, u));
+    room->edges.strong.cloud.push_back(pcl::PointXYZ(5, u, 0));
+    room->edges.strong.cloud.push_back(pcl::PointXYZ(u, 5, 0));
+  }
+  return room;
+}
+
+PointCloud TransformCloud(const PointCloud& cloud, const Eigen::Matrix4d& T) {
+  PointCloud transformed;
+  for (const auto& p : cloud) {
+    const Eigen::Vector3d v =
+        T.block<3, 3>(0, 0) * Eigen::Vector3d(p.x, p.y, p.z) +
+        T.block<3, 1>(0, 3);
+    transformed.push_back(pcl::PointXYZ(v.x(), v.y(), v.z()));
+  }
+  return transformed;
+}
+
+Eigen::Matrix4d TrueTransform() {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      (Eigen::AngleAxisd(2 * M_PI / 180, Eigen::Vector3d::UnitZ()) *
+       Eigen::AngleAxisd(1 * M_PI / 180, Eigen::Vector3d::UnitX()))
+          .toRotationMatrix();
+  T.block<3, 1>(0, 3) = Eigen::Vector3d(0.2, -0.1, 0.05);
+  return T;
+}
+
+/**
+ * @brief the room seen from a frame where T_REF_TARGET = TrueTransform()
+ */
+beam_matching::LoamPointCloud CreateTarget(
+    const beam_matching::LoamPointCloud& room) {
+  const Eigen::Matrix4d T_TARGET_REF = TrueTransform().inverse();
+  beam_matching::LoamPointCloud target;
+  target.surfaces.strong.cloud =
+      TransformCloud(room.surfaces.strong.cloud, T_TARGET_REF);
+  target.edges.strong.cloud =
+      TransformCloud(room.edges.strong.cloud, T_TARGET_REF);
+  return target;
+}
+
+} // namespace
+
+TEST(LoamSolver, Converges) {
+  LoamSolver solver(LoamSolver::Params{});
+  const auto room = CreateRoom();
+  const beam_matching::LoamPointCloud target = CreateTarget(*room);
+  solver.SetRef(room);
+  solver.SetTarget(target);
+  ASSERT_TRUE(solver.Match());
+  EXPECT_GT(solver.NumResiduals(), target.surfaces.strong.cloud.size() / 2);
+  EXPECT_TRUE(solver.GetResult().isApprox(TrueTransform(), 1e-3));
+
+  const Eigen::Matrix<double, 6, 6>& covariance = solver.GetCovariance();
+  EXPECT_TRUE(covariance.isApprox(covariance.transpose()));
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> eigen_solver(
+      covariance);
+  EXPECT_GT(eigen_solver.eigenvalues().minCoeff(), 0);
+  EXPECT_LT(eigen_solver.eigenvalues().maxCoeff(), 1e-3);
+}
+
+TEST(LoamSolver, ReusesCorrespondences) {
+  const auto room = CreateRoom();
+  const beam_matching::LoamPointCloud target = CreateTarget(*room);
+
+  // correspondences are searched at each iteration without reuse
+  LoamSolver::Params params;
+  params.reuse_correspondences_trans_m = 0;
+  params.reuse_correspondences_rot_deg = 0;
+  LoamSolver no_reuse(params);
+  no_reuse.SetRef(room);
+  no_reuse.SetTarget(target);
+  ASSERT_TRUE(no_reuse.Match());
+  EXPECT_TRUE(no_reuse.GetResult().isApprox(TrueTransform(), 1e-3));
+
+  LoamSolver reuse(LoamSolver::Params{});
+  reuse.SetRef(room);
+  reuse.SetTarget(target);
+  ASSERT_TRUE(reuse.Match());
+  EXPECT_TRUE(reuse.GetResult().isApprox(TrueTransform(), 1e-3));
+  EXPECT_LT(reuse.NumCorrespondenceSearches(),
+            no_reuse.NumCorrespondenceSearches());
+
+  // starting close to the result, the first correspondences are kept
+  ASSERT_TRUE(reuse.Match(TrueTransform()));
+  EXPECT_EQ(reuse.NumCorrespondenceSearches(), 1);
+}
+
+TEST(LoamSolver, TooFewCorrespondences) {
+  LoamSolver solver(LoamSolver::Params{});
+  const auto room = CreateRoom();
+  const beam_matching::LoamPointCloud target = CreateTarget(*room);
+  solver.SetRef(std::make_shared<beam_matching::LoamPointCloud>());
+  solver.SetTarget(target);
+  EXPECT_FALSE(solver.Match());
+  EXPECT_EQ(solver.NumResiduals(), 0u);
+}
+
+TEST(LoamSolver, InvalidParams) {
+  LoamSolver::Params params;
+  nlohmann::json J{{"num_neighbors", 2}};
+  EXPECT_THROW(params.LoadFromJson(J), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
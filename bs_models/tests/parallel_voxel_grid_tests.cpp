@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <tuple>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/parallel_voxel_grid.h>
+
+using namespace bs_models;
+
+namespace {
+
+PointCloud CreateRandomCloud(size_t size) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> distribution(-30, 30);
+  PointCloud cloud;
+  for (size_t i = 0; i < size; i++) {
+    cloud.push_back(pcl::PointXYZ(distribution(generator),
+                                  distribution(generator),
+                                  distribution(generator)));
+  }
+  return cloud;
+}
+
+// one point per voxel at its centroid, in the order voxels are first seen
+PointCloud VoxelizeReference(const PointCloud& cloud, float voxel_size) {
+  using Key = std::tuple<int, int, int>;
+  std::map<Key, size_t> voxels;
+  std::vector<Eigen::Vector3d> sums;
+  std::vector<int> counts;
+  for (const auto& p : cloud) {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      continue;
+    }
+    const Key key{static_cast<int>(std::floor(p.x / voxel_size)),
+                  static_cast<int>(std::floor(p.y / voxel_size)),
+                  static_cast<int>(std::floor(p.z / voxel_size))};
+    const auto [iter, inserted] = voxels.emplace(key, sums.size());
+    if (inserted) {
+      sums.emplace_back(0, 0, 0);
+      counts.push_back(0);
+    }
+    sums[iter->second] += Eigen::Vector3d(p.x, p.y, p.z);
+    counts[iter->second]++;
+  }
+  PointCloud output;
+  for (size_t i = 0; i < sums.size(); i++) {
+    const Eigen::Vector3d centroid = sums[i] / counts[i];
+    output.push_back(pcl::PointXYZ(centroid.x(), centroid.y(), centroid.z()));
+  }
+  return output;
+}
+
+void ExpectCloudsEqual(const PointCloud& expected, const PointCloud& cloud) {
+  ASSERT_EQ(expected.size(), cloud.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i].x, cloud[i].x);
+    EXPECT_FLOAT_EQ(expected[i].y, cloud[i].y);
+    EXPECT_FLOAT_EQ(expected[i].z, cloud[i].z);
+  }
+}
+
+} // namespace
+
+TEST(ParallelVoxelGrid, MatchesReference) {
+  PointCloud cloud = CreateRandomCloud(50000);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  cloud.push_back(pcl::PointXYZ(nan, 0, 0));
+  const PointCloud expected = VoxelizeReference(cloud, 1.0);
+
+  // the output must not depend on the number of partitions
+  for (const size_t max_partitions : {1, 2, 3, 8}) {
+    ParallelVoxelGrid<pcl::PointXYZ>::Params params;
+    params.voxel_size = Eigen::Vector3f(1, 1, 1);
+    params.min_points_per_partition = 1000;
+    params.max_partitions = max_partitions;
+    ParallelVoxelGrid<pcl::PointXYZ> voxel_grid(params);
+    EXPECT_EQ(voxel_grid.IsParallel(cloud.size()), max_partitions > 1);
+    ExpectCloudsEqual(expected, voxel_grid.Filter(cloud));
+  }
+}
+
+TEST(ParallelVoxelGrid, InPlaceWithPredicate) {
+  PointCloud cloud = CreateRandomCloud(20000);
+  PointCloud kept;
+  for (const auto& p : cloud) {
+    if (p.z > 0) { kept.push_back(p); }
+  }
+  const PointCloud expected = VoxelizeReference(kept, 2.0);
+
+  ParallelVoxelGrid<pcl::PointXYZ>::Params params;
+  params.voxel_size = Eigen::Vector3f(2, 2, 2);
+  params.min_points_per_partition = 1000;
+  params.max_partitions = 4;
+  ParallelVoxelGrid<pcl::PointXYZ> voxel_grid(params);
+  voxel_grid.Filter(cloud, cloud,
+                    [](const pcl::PointXYZ& p) { return p.z > 0; });
+  ExpectCloudsEqual(expected, cloud);
+  EXPECT_EQ(cloud.width, cloud.size());
+  EXPECT_TRUE(cloud.is_dense);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/pose_graph_sparsifier.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+using Edge = PoseGraphSparsifier::Edge;
+
+Eigen::Matrix4d MakePose(double x, double y, double yaw) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T(0, 3) = x;
+  T(1, 3) = y;
+  return T;
+}
+
+Edge MakeEdge(const PoseGraphSparsifier::Poses& poses, size_t from, size_t to,
+              double variance) {
+  Edge edge;
+  edge.from = from;
+  edge.to = to;
+  edge.T_FROM_TO = poses.at(from).inverse() * poses.at(to);
+  edge.covariance = Eigen::Matrix<double, 6, 6>::Identity() * variance;
+  return edge;
+}
+
+bool Touches(const std::vector<Edge>& edges, size_t node) {
+  for (const Edge& edge : edges) {
+    if (edge.from == node || edge.to == node) { return true; }
+  }
+  return false;
+}
+
+} // namespace
+
+TEST(PoseGraphSparsifier, MarginalizeChain) {
+  // a node between two others, the new edge compounds both
+  PoseGraphSparsifier::Poses poses(3, Eigen::Matrix4d::Identity());
+  std::vector<Edge> edges{MakeEdge(poses, 0, 1, 0.01),
+                          MakeEdge(poses, 1, 2, 0.01)};
+  PoseGraphSparsifier::MarginalizeNode(1, poses, edges);
+  ASSERT_EQ(edges.size(), 1u);
+  EXPECT_EQ(edges[0].from, 0u);
+  EXPECT_EQ(edges[0].to, 2u);
+  EXPECT_TRUE(edges[0].covariance.isApprox(
+      Eigen::Matrix<double, 6, 6>::Identity() * 0.02, 1e-4));
+}
+
+TEST(PoseGraphSparsifier, MarginalizeClique) {
+  PoseGraphSparsifier::Poses poses{MakePose(0, 0, 0), MakePose(5, 0, 0.3),
+                                   MakePose(10, 1, 0.5), MakePose(5, 5, 1),
+                                   MakePose(0, 5, 2)};
+  std::vector<Edge> edges;
+  for (size_t i = 1; i < poses.size(); i++) {
+    edges.push_back(MakeEdge(poses, 0, i, 0.01));
+  }
+  edges.push_back(MakeEdge(poses, 1, 2, 0.01));
+
+  // the four neighbours are connected by a tree, and the measurements are
+  // consistent with the poses
+  PoseGraphSparsifier::MarginalizeNode(0, poses, edges);
+  EXPECT_FALSE(Touches(edges, 0));
+  EXPECT_EQ(edges.size(), 4u);
+  for (const Edge& edge : edges) {
+    const auto error = PoseGraphSparsifier::Error(
+        poses.at(edge.from), poses.at(edge.to), edge.T_FROM_TO);
+    EXPECT_LT(error.norm(), 1e-9);
+    EXPECT_GT(edge.covariance.determinant(), 0);
+  }
+}
+
+TEST(PoseGraphSparsifier, CombineParallelEdges) {
+  PoseGraphSparsifier::Poses poses{MakePose(0, 0, 0), MakePose(1, 0, 0)};
+  std::vector<Edge> edges{MakeEdge(poses, 0, 1, 0.01)};
+  Edge other = MakeEdge(poses, 0, 1, 0.01);
+  other.T_FROM_TO(0, 3) = 1.2;
+  edges.push_back(other);
+
+  // same covariance, so the measurement is the mean
+  PoseGraphSparsifier::CombineParallelEdges(poses, edges);
+  ASSERT_EQ(edges.size(), 1u);
+  EXPECT_NEAR(edges[0].T_FROM_TO(0, 3), 1.1, 1e-6);
+  EXPECT_TRUE(edges[0].covariance.isApprox(
+      Eigen::Matrix<double, 6, 6>::Identity() * 0.005, 1e-4));
+
+  // reversed edges are combined too
+  edges.push_back(MakeEdge(poses, 1, 0, 0.005));
+  PoseGraphSparsifier::CombineParallelEdges(poses, edges);
+  ASSERT_EQ(edges.size(), 1u);
+  EXPECT_NEAR(edges[0].T_FROM_TO(0, 3), 1.05, 1e-6);
+}
+
+TEST(PoseGraphSparsifier, MergeRevisit) {
+  // out and back, submap 3 revisits submap 1 and submap 4 revisits submap 0
+  PoseGraphSparsifier::Poses poses{MakePose(0, 0, 0), MakePose(10, 0, 0),
+                                   MakePose(20, 0, 0), MakePose(10.5, 0, 0.1),
+                                   MakePose(0.5, 0, 0)};
+  std::vector<Edge> edges;
+  for (size_t i = 0; i + 1 < poses.size(); i++) {
+    edges.push_back(MakeEdge(poses, i, i + 1, 0.01));
+  }
+  edges.push_back(MakeEdge(poses, 1, 3, 0.001));
+  edges.push_back(MakeEdge(poses, 2, 4, 0.001));
+
+  PoseGraphSparsifier::Params params;
+  params.merge_distance_m = 1;
+  PoseGraphSparsifier sparsifier(params);
+  std::map<size_t, PoseGraphSparsifier::Merge> merged;
+  EXPECT_EQ(sparsifier.Sparsify(poses, {0}, edges, merged), 1u);
+  ASSERT_EQ(merged.size(), 1u);
+  EXPECT_EQ(merged.at(3).kept, 1u);
+  EXPECT_TRUE((poses[1] * merged.at(3).T_KEPT_MERGED).isApprox(poses[3]));
+
+  // submap 4 has no loop closure to submap 0 so it is kept
+  EXPECT_FALSE(Touches(edges, 3));
+  EXPECT_TRUE(Touches(edges, 4));
+  for (size_t i = 0; i < edges.size(); i++) {
+    for (size_t j = i + 1; j < edges.size(); j++) {
+      EXPECT_FALSE(std::minmax(edges[i].from, edges[i].to) ==
+                   std::minmax(edges[j].from, edges[j].to));
+    }
+  }
+
+  // nothing left to merge
+  EXPECT_EQ(sparsifier.Sparsify(poses, {0}, edges, merged), 0u);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/extrinsics_lookup_base.h>
+#include <bs_models/global_mapping/map_store.h>
+#include <bs_models/scan_registration/prior_registration_map.h>
+
+using namespace bs_models::global_mapping;
+using namespace bs_models::scan_registration;
+
+class PriorRegistrationMapTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::string current_file = "prior_registration_map_tests.cpp";
+    std::string test_path = __FILE__;
+    test_path.erase(test_path.end() - current_file.size(), test_path.end());
+    extrinsics_ = std::make_shared<bs_common::ExtrinsicsLookupBase>(
+        test_path + "data/frame_ids.json", test_path + "data/extrinsics.json");
+    store_path_ = "/tmp/bs_models_prior_map_test_" +
+                  std::to_string(getpid()) + ".bin";
+
+    // submaps 10 m apart with one scan of 100 surface points each
+    bs_common::ChunkFileWriter writer;
+    ASSERT_TRUE(writer.Open(store_path_, kMapStoreVersion));
+    ros::Time stamp(1);
+    for (uint16_t i = 0; i < num_submaps_; i++) {
+      Eigen::Matrix4d T_WORLD_SUBMAP = Eigen::Matrix4d::Identity();
+      T_WORLD_SUBMAP(0, 3) = 10 * i;
+      Submap submap(stamp, T_WORLD_SUBMAP, nullptr, extrinsics_);
+      PointCloud cloud;
+      for (int p = 0; p < 100; p++) {
+        cloud.push_back(pcl::PointXYZ(p * 0.01, 0, 0));
+      }
+      beam_matching::LoamPointCloud loam_cloud;
+      loam_cloud.surfaces.strong.cloud = cloud;
+      submap.AddLidarMeasurement(cloud, T_WORLD_SUBMAP, stamp);
+      submap.AddLidarMeasurement(loam_cloud, T_WORLD_SUBMAP, stamp);
+      stamp += ros::Duration(1);
+      ASSERT_TRUE(submap.SaveData(writer, i));
+    }
+    ASSERT_TRUE(writer.Close());
+
+    map_store_ = std::make_shared<bs_common::ChunkFileReader>();
+    ASSERT_TRUE(map_store_->Open(store_path_));
+    for (uint16_t i = 0; i < num_submaps_; i++) {
+      submaps_.push_back(std::make_shared<Submap>(
+          ros::Time(0), Eigen::Matrix4d::Identity(), nullptr, extrinsics_));
+      ASSERT_TRUE(submaps_.back()->LoadData(*map_store_, i, false));
+    }
+
+    params_.tile_radius_m = 12;
+    params_.update_distance_m = 5;
+  }
+
+  void TearDown() override {
+    map_store_->Close();
+    std::remove(store_path_.c_str());
+  }
+
+  const uint16_t num_submaps_{5};
+  std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_;
+  std::string store_path_;
+  std::shared_ptr<bs_common::ChunkFileReader> map_store_;
+  std::vector<SubmapPtr> submaps_;
+  PriorRegistrationMap::Params params_;
+};
+
+TEST_F(PriorRegistrationMapTest, Tiles) {
+  PriorRegistrationMap prior_map(submaps_, map_store_, params_);
+  EXPECT_EQ(prior_map.NumTiles(), 5u);
+  EXPECT_FALSE(prior_map.GetLoamCloudMapPtr());
+
+  EXPECT_TRUE(prior_map.Update(Eigen::Vector3d(0, 0, 0)));
+  EXPECT_EQ(prior_map.ActiveTiles(), std::vector<size_t>({0, 1}));
+  const auto map = prior_map.GetLoamCloudMapPtr();
+  ASSERT_TRUE(map);
+  EXPECT_EQ(map->surfaces.strong.cloud.size(), 200u);
+  EXPECT_GT(prior_map.MemoryUsage(), 0u);
+
+  // small motions keep the same map
+  EXPECT_FALSE(prior_map.Update(Eigen::Vector3d(4, 0, 0)));
+  EXPECT_EQ(prior_map.GetLoamCloudMapPtr(), map);
+
+  // tiles are swapped in and out as the robot moves
+  EXPECT_TRUE(prior_map.Update(Eigen::Vector3d(30, 0, 0)));
+  EXPECT_EQ(prior_map.ActiveTiles(), std::vector<size_t>({2, 3, 4}));
+  EXPECT_NE(prior_map.GetLoamCloudMapPtr(), map);
+  EXPECT_EQ(prior_map.GetLoamCloudMapPtr()->surfaces.strong.cloud.size(),
+            300u);
+  EXPECT_EQ(map->surfaces.strong.cloud.size(), 200u);
+
+  // the closest tile is used when none is in range
+  EXPECT_TRUE(prior_map.Update(Eigen::Vector3d(100, 0, 0)));
+  EXPECT_EQ(prior_map.ActiveTiles(), std::vector<size_t>({4}));
+}
+
+TEST_F(PriorRegistrationMapTest, Downsample) {
+  params_.downsample_voxel_size = 0.1;
+  PriorRegistrationMap prior_map(submaps_, map_store_, params_);
+  EXPECT_TRUE(prior_map.Update(Eigen::Vector3d(0, 0, 0)));
+  const auto map = prior_map.GetLoamCloudMapPtr();
+  ASSERT_TRUE(map);
+  EXPECT_GT(map->surfaces.strong.cloud.size(), 0u);
+  EXPECT_LT(map->surfaces.strong.cloud.size(), 200u);
+
+  // removed tiles are also removed from the voxel maps
+  EXPECT_TRUE(prior_map.Update(Eigen::Vector3d(100, 0, 0)));
+  EXPECT_LT(prior_map.GetLoamCloudMapPtr()->surfaces.strong.cloud.size(),
+            map->surfaces.strong.cloud.size());
+}
+
+TEST_F(PriorRegistrationMapTest, InvalidParams) {
+  params_.tile_radius_m = 0;
+  EXPECT_THROW(PriorRegistrationMap(submaps_, map_store_, params_),
+               std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/range_image.h>
+
+using namespace bs_models;
+
+namespace {
+
+PointXYZIRT MakePoint(uint16_t ring, double azimuth, double range,
+                      float time = 0) {
+  PointXYZIRT p;
+  p.x = range * std::cos(azimuth);
+  p.y = range * std::sin(azimuth);
+  p.z = 0;
+  p.intensity = static_cast<float>(range);
+  p.ring = ring;
+  p.time = time;
+  return p;
+}
+
+// azimuth at the center of a column
+double Azimuth(size_t column, size_t num_columns) {
+  return -M_PI + 2 * M_PI * (column + 0.5) / num_columns;
+}
+
+} // namespace
+
+TEST(RangeImage, Fill) {
+  const size_t num_columns = 8;
+  pcl::PointCloud<PointXYZIRT> cloud;
+  cloud.push_back(MakePoint(0, Azimuth(0, num_columns), 2, 0.1));
+  cloud.push_back(MakePoint(2, Azimuth(5, num_columns), 3, 0.2));
+  // closer point in the same cell replaces the first one
+  cloud.push_back(MakePoint(2, Azimuth(5, num_columns), 1, 0.3));
+  cloud.push_back(MakePoint(2, Azimuth(5, num_columns), 4, 0.4));
+  PointXYZIRT invalid = MakePoint(1, 0, 1);
+  invalid.x = std::numeric_limits<float>::quiet_NaN();
+  cloud.push_back(invalid);
+
+  const RangeImage image = RangeImage::FromCloud(cloud, num_columns);
+  EXPECT_EQ(image.NumRings(), 3u);
+  EXPECT_EQ(image.NumColumns(), num_columns);
+  EXPECT_EQ(image.NumValid(), 2u);
+
+  const size_t i0 = image.Index(0, 0);
+  ASSERT_TRUE(image.Valid(i0));
+  EXPECT_EQ(image.SourceIndex(i0), 0u);
+  EXPECT_NEAR(image.Range(i0), 2, 1e-5);
+  EXPECT_FLOAT_EQ(image.Time(i0), 0.1);
+
+  const size_t i2 = image.Index(2, 5);
+  ASSERT_TRUE(image.Valid(i2));
+  EXPECT_EQ(image.SourceIndex(i2), 2u);
+  EXPECT_NEAR(image.Range(i2), 1, 1e-5);
+  EXPECT_FLOAT_EQ(image.Intensity(i2), 1);
+  EXPECT_FALSE(image.Valid(image.Index(1, 4)));
+  EXPECT_EQ(image.SourceIndex(image.Index(1, 4)), RangeImage::INVALID);
+}
+
+TEST(RangeImage, Neighbours) {
+  const size_t num_rings = 4;
+  const size_t num_columns = 16;
+  pcl::PointCloud<PointXYZIRT> cloud;
+  for (uint16_t r = 0; r < num_rings; r++) {
+    for (size_t c = 0; c < num_columns; c++) {
+      cloud.push_back(MakePoint(r, Azimuth(c, num_columns), 5));
+    }
+  }
+  RangeImage image;
+  image.Reset(0, num_columns);
+  image.Fill(cloud);
+  ASSERT_EQ(image.NumValid(), num_rings * num_columns);
+  for (size_t r = 0; r < num_rings; r++) {
+    for (size_t c = 0; c < num_columns; c++) {
+      EXPECT_EQ(image.SourceIndex(image.Index(r, c)), r * num_columns + c);
+    }
+  }
+
+  // columns wrap around, rings don't
+  EXPECT_EQ(image.Index(1, -1), image.Index(1, num_columns - 1));
+  EXPECT_EQ(image.Index(1, num_columns), image.Index(1, 0));
+  std::vector<size_t> neighbours;
+  image.ForEachNeighbour(0, 0, 1, 1,
+                         [&](size_t i) { neighbours.push_back(i); });
+  ASSERT_EQ(neighbours.size(), 5u);
+  EXPECT_EQ(neighbours[0], image.Index(0, num_columns - 1));
+  EXPECT_EQ(neighbours[1], image.Index(0, 1));
+  EXPECT_EQ(neighbours[2], image.Index(1, num_columns - 1));
+
+  neighbours.clear();
+  image.ForEachNeighbour(2, 8, 1, 2,
+                         [&](size_t i) { neighbours.push_back(i); });
+  EXPECT_EQ(neighbours.size(), 14u);
+
+  // refilling keeps the columns and resizes to the rings of the cloud
+  cloud.resize(num_columns);
+  image.Fill(cloud);
+  EXPECT_EQ(image.NumRings(), 1u);
+  EXPECT_EQ(image.NumValid(), num_columns);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
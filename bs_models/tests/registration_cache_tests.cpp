@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/registration_cache.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+Eigen::Matrix4d CreatePose(double x, double yaw) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T(0, 3) = x;
+  return T;
+}
+
+} // namespace
+
+TEST(RegistrationCache, Lookup) {
+  RegistrationCache cache(0.01, 0.1);
+  const uint64_t context = RegistrationCache::ContextId("test", "");
+  const uint64_t s1 = RegistrationCache::ScanId(ros::Time(1));
+  const uint64_t s2 = RegistrationCache::ScanId(ros::Time(2));
+
+  RegistrationCache::Result result;
+  result.successful = true;
+  result.T_REFERENCE_TARGET = CreatePose(1.05, 0.2);
+  cache.Insert(cache.MakeKey(context, s1, s2, CreatePose(1, 0.2)), result);
+
+  // nearly the same guess hits, another guess, pair or context misses
+  RegistrationCache::Result found;
+  EXPECT_TRUE(
+      cache.Find(cache.MakeKey(context, s1, s2, CreatePose(1.001, 0.2001)),
+                 found));
+  EXPECT_TRUE(found.successful);
+  EXPECT_TRUE(found.T_REFERENCE_TARGET.isApprox(result.T_REFERENCE_TARGET));
+  EXPECT_FALSE(found.covariance.has_value());
+  EXPECT_FALSE(
+      cache.Find(cache.MakeKey(context, s1, s2, CreatePose(1.1, 0.2)), found));
+  EXPECT_FALSE(
+      cache.Find(cache.MakeKey(context, s1, s2, CreatePose(1, 0.21)), found));
+  EXPECT_FALSE(
+      cache.Find(cache.MakeKey(context, s2, s1, CreatePose(1, 0.2)), found));
+  EXPECT_FALSE(cache.Find(
+      cache.MakeKey(RegistrationCache::ContextId("other", ""), s1, s2,
+                    CreatePose(1, 0.2)),
+      found));
+  EXPECT_EQ(cache.Hits(), 1);
+  EXPECT_EQ(cache.Misses(), 4);
+  EXPECT_DOUBLE_EQ(cache.HitRate(), 0.2);
+}
+
+TEST(RegistrationCache, SaveLoad) {
+  RegistrationCache cache(0.01, 0.1);
+  const uint64_t context = RegistrationCache::ContextId("test", "");
+  for (int i = 0; i < 10; i++) {
+    RegistrationCache::Result result;
+    result.successful = i % 3 != 0;
+    result.T_REFERENCE_TARGET = CreatePose(i, 0.1 * i);
+    if (i % 2 == 0) {
+      result.covariance = Eigen::Matrix<double, 6, 6>::Identity() * i;
+    }
+    cache.Insert(cache.MakeKey(context, RegistrationCache::ScanId(ros::Time(i)),
+                               RegistrationCache::ScanId(ros::Time(i + 1)),
+                               CreatePose(i, 0)),
+                 result);
+  }
+  const std::string path = "/tmp/bs_models_registration_cache_test_" +
+                           std::to_string(getpid()) + ".bin";
+  ASSERT_TRUE(cache.Save(path));
+
+  RegistrationCache loaded(0.01, 0.1);
+  ASSERT_TRUE(loaded.Load(path));
+  ASSERT_EQ(loaded.Size(), 10);
+  for (int i = 0; i < 10; i++) {
+    RegistrationCache::Result result;
+    ASSERT_TRUE(loaded.Find(
+        loaded.MakeKey(context, RegistrationCache::ScanId(ros::Time(i)),
+                       RegistrationCache::ScanId(ros::Time(i + 1)),
+                       CreatePose(i, 0)),
+        result));
+    EXPECT_EQ(result.successful, i % 3 != 0);
+    EXPECT_TRUE(result.T_REFERENCE_TARGET.isApprox(CreatePose(i, 0.1 * i)));
+    ASSERT_EQ(result.covariance.has_value(), i % 2 == 0);
+    if (result.covariance) {
+      EXPECT_TRUE(result.covariance->isApprox(
+          Eigen::Matrix<double, 6, 6>::Identity() * i));
+    }
+  }
+
+  // keys of other resolutions are not compatible
+  RegistrationCache other(0.05, 0.1);
+  EXPECT_FALSE(other.Load(path));
+  EXPECT_EQ(other.Size(), 0);
+  std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
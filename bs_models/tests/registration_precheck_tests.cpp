@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <bs_models/scan_registration/registration_validation.h>
+
+using namespace bs_models;
+using namespace scan_registration;
+
+namespace {
+
+// add a grid of points on an axis aligned plane, with a fixed coordinate
+// along the axis with index fixed_axis
+void AddPlane(PointCloud& cloud, int fixed_axis, double value,
+              const Eigen::Vector3d& min, const Eigen::Vector3d& max,
+              double spacing = 0.1) {
+  const int a1 = (fixed_axis + 1) % 3;
+  const int a2 = (fixed_axis + 2) % 3;
+  for (double u = min[a1]; u <= max[a1]; u += spacing) {
+    for (double v = min[a2]; v <= max[a2]; v += spacing) {
+      Eigen::Vector3d p;
+      p[fixed_axis] = value;
+      p[a1] = u;
+      p[a2] = v;
+      cloud.push_back(pcl::PointXYZ(p.x(), p.y(), p.z()));
+    }
+  }
+}
+
+// corridor along x with walls, floor and ceiling
+PointCloud CreateCorridor() {
+  PointCloud cloud;
+  const Eigen::Vector3d min(-10.05, -2.05, -1.05);
+  const Eigen::Vector3d max(10.05, 2.05, 2.05);
+  AddPlane(cloud, 1, min.y(), min, max);
+  AddPlane(cloud, 1, max.y(), min, max);
+  AddPlane(cloud, 2, min.z(), min, max);
+  AddPlane(cloud, 2, max.z(), min, max);
+  return cloud;
+}
+
+RegistrationPrecheck::Params EnabledParams() {
+  RegistrationPrecheck::Params params;
+  params.enabled = true;
+  return params;
+}
+
+} // namespace
+
+TEST(RegistrationPrecheck, Disabled) {
+  const PointCloud corridor = CreateCorridor();
+  RegistrationPrecheck precheck;
+  const auto result = precheck.Check({&corridor}, {});
+  EXPECT_EQ(result.decision, RegistrationPrecheck::Decision::REGISTER);
+}
+
+TEST(RegistrationPrecheck, Room) {
+  PointCloud room = CreateCorridor();
+  const Eigen::Vector3d min(-10.05, -2.05, -1.05);
+  const Eigen::Vector3d max(10.05, 2.05, 2.05);
+  AddPlane(room, 0, min.x(), min, max);
+  AddPlane(room, 0, max.x(), min, max);
+
+  RegistrationPrecheck precheck(EnabledParams());
+  const auto result = precheck.Check({&room}, {&room});
+  EXPECT_EQ(result.decision, RegistrationPrecheck::Decision::REGISTER);
+  EXPECT_NEAR(result.overlap, 1, 1e-9);
+  EXPECT_TRUE(result.degenerate_directions.empty());
+}
+
+TEST(RegistrationPrecheck, Corridor) {
+  const PointCloud corridor = CreateCorridor();
+  RegistrationPrecheck precheck(EnabledParams());
+  const auto result = precheck.Check({&corridor}, {&corridor});
+  EXPECT_EQ(result.decision, RegistrationPrecheck::Decision::CONSTRAINED);
+  ASSERT_EQ(result.degenerate_directions.size(), 1);
+  EXPECT_NEAR(std::abs(result.degenerate_directions[0].x()), 1, 1e-6);
+}
+
+TEST(RegistrationPrecheck, OpenField) {
+  PointCloud ground;
+  AddPlane(ground, 2, -1.05, Eigen::Vector3d(-20, -20, 0),
+           Eigen::Vector3d(20, 20, 0));
+
+  RegistrationPrecheck precheck(EnabledParams());
+  const auto result = precheck.Check({&ground}, {&ground});
+  EXPECT_EQ(result.decision, RegistrationPrecheck::Decision::USE_PRIOR);
+  EXPECT_EQ(result.degenerate_directions.size(), 2);
+
+  auto params = EnabledParams();
+  params.allow_prior_fallback = false;
+  precheck.SetParams(params);
+  EXPECT_EQ(precheck.Check({&ground}, {&ground}).decision,
+            RegistrationPrecheck::Decision::SKIP);
+}
+
+TEST(RegistrationPrecheck, NoOverlap) {
+  const PointCloud corridor = CreateCorridor();
+  PointCloud reference = corridor;
+  for (auto& p : reference) { p.x += 100; }
+
+  RegistrationPrecheck precheck(EnabledParams());
+  const auto result = precheck.Check({&corridor}, {&reference});
+  EXPECT_EQ(result.decision, RegistrationPrecheck::Decision::USE_PRIOR);
+  EXPECT_NEAR(result.overlap, 0, 1e-9);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
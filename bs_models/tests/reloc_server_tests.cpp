@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <bs_models/global_mapping/reloc_server.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+/**
+ * @brief collects the responses of a server
+ */
+class ResponseCollector {
+public:
+  explicit ResponseCollector(RelocServer& server) {
+    server.SetResponseCallback([this](const RelocServer::Response& response) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      responses_.push_back(response);
+      cv_.notify_all();
+    });
+  }
+
+  std::vector<RelocServer::Response> Wait(size_t num_responses) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::seconds(5), [&]() {
+      return responses_.size() >= num_responses;
+    });
+    return responses_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<RelocServer::Response> responses_;
+};
+
+RelocServer::Request CreateRequest(double stamp) {
+  RelocServer::Request request;
+  request.stamp = ros::Time(stamp);
+  request.cloud.push_back(pcl::PointXYZ(1, 0, 0));
+  return request;
+}
+
+} // namespace
+
+TEST(RelocServer, NoSubmaps) {
+  RelocServer::Params params;
+  RelocServer server(params, "", "", nullptr, nullptr);
+  ResponseCollector collector(server);
+  EXPECT_EQ(server.NumSubmaps(), 0);
+
+  EXPECT_TRUE(server.Submit(CreateRequest(1)));
+  const auto responses = collector.Wait(1);
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].stamp, ros::Time(1));
+  EXPECT_FALSE(responses[0].successful);
+  EXPECT_EQ(responses[0].submap_id, -1);
+}
+
+TEST(RelocServer, Deadline) {
+  RelocServer::Params params;
+  params.deadline_s = 0;
+  RelocServer server(params, "", "", nullptr, nullptr);
+  ResponseCollector collector(server);
+
+  // every request gets a response, even if it expired
+  for (int i = 1; i <= 3; i++) { EXPECT_TRUE(server.Submit(CreateRequest(i))); }
+  const auto responses = collector.Wait(3);
+  ASSERT_EQ(responses.size(), 3);
+  for (const auto& response : responses) {
+    EXPECT_FALSE(response.successful);
+  }
+}
+
+TEST(RelocServer, Stop) {
+  RelocServer::Params params;
+  RelocServer server(params, "", "", nullptr, nullptr);
+  server.Stop();
+  EXPECT_FALSE(server.Submit(CreateRequest(1)));
+}
+
+TEST(RelocServer, InvalidParams) {
+  RelocServer::Params params;
+  EXPECT_THROW(params.LoadFromJson({{"num_workers", 0}}),
+               std::invalid_argument);
+  EXPECT_THROW(params.LoadFromJson({{"num_workers", 1}, {"deadline_s", -1}}),
+               std::invalid_argument);
+
+  RelocServer::Params loaded;
+  params = RelocServer::Params();
+  params.enabled = true;
+  params.num_workers = 3;
+  loaded.LoadFromJson(params.ToJson());
+  EXPECT_TRUE(loaded.enabled);
+  EXPECT_EQ(loaded.num_workers, 3);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <beam_matching/loam/LoamParams.h>
+#include <beam_utils/pointclouds.h>
+
+#include <bs_models/lidar/ring_feature_extractor.h>
+
+using namespace bs_models;
+
+namespace {
+
+// scan of a 10 x 10 m square room centered at the lidar, points are ordered
+// by ring and then azimuth like a velodyne output. The azimuths are offset by
+// azimuth_offset times the angle between points
+pcl::PointCloud<PointXYZIRT> CreateRoomScan(int num_rings, int points_per_ring,
+                                            double azimuth_offset = 0) {
+  pcl::PointCloud<PointXYZIRT> cloud;
+  for (int ring = 0; ring < num_rings; ring++) {
+    const double elevation = -0.2 + 0.4 * ring / (num_rings - 1);
+    for (int i = 0; i < points_per_ring; i++) {
+      const double azimuth = 2 * M_PI * (i + azimuth_offset) / points_per_ring;
+      const double c = std::cos(azimuth);
+      const double s = std::sin(azimuth);
+      // distance to the closest wall along this azimuth
+      const double range_xy = 5 / std::max(std::abs(c), std::abs(s));
+      PointXYZIRT p;
+      p.x = range_xy * c;
+      p.y = range_xy * s;
+      p.z = range_xy * std::tan(elevation);
+      p.intensity = 0;
+      p.ring = ring;
+      p.time = static_cast<float>(i) / points_per_ring * 0.1;
+      cloud.push_back(p);
+    }
+  }
+  return cloud;
+}
+
+std::shared_ptr<beam_matching::LoamParams> LoadParams() {
+  std::string current_file = "ring_feature_extractor_tests.cpp";
+  std::string test_path = __FILE__;
+  test_path.erase(test_path.end() - current_file.size(), test_path.end());
+  return std::make_shared<beam_matching::LoamParams>(test_path +
+                                                     "data/loam_config.json");
+}
+
+void ExpectCloudsEqual(const PointCloud& c1, const PointCloud& c2) {
+  ASSERT_EQ(c1.size(), c2.size());
+  for (size_t i = 0; i < c1.size(); i++) {
+    EXPECT_EQ(c1[i].x, c2[i].x);
+    EXPECT_EQ(c1[i].y, c2[i].y);
+    EXPECT_EQ(c1[i].z, c2[i].z);
+  }
+}
+
+} // namespace
+
+TEST(RingFeatureExtractor, EdgesAtCorners) {
+  const auto cloud = CreateRoomScan(16, 1800);
+  RingFeatureExtractor extractor(LoadParams(), 1);
+  const auto features = extractor.ExtractFeatures(cloud);
+
+  EXPECT_FALSE(features.edges.strong.cloud.empty());
+  EXPECT_FALSE(features.surfaces.strong.cloud.empty());
+  EXPECT_FALSE(features.surfaces.weak.cloud.empty());
+
+  // the walls are flat so all strong edges should be at the room corners
+  for (const auto& p : features.edges.strong.cloud) {
+    EXPECT_NEAR(std::abs(p.x), 5, 0.1);
+    EXPECT_NEAR(std::abs(p.y), 5, 0.1);
+  }
+}
+
+TEST(RingFeatureExtractor, SameResultForAnyNumberOfThreads) {
+  const auto cloud = CreateRoomScan(16, 1800);
+  RingFeatureExtractor extractor1(LoadParams(), 1);
+  RingFeatureExtractor extractor4(LoadParams(), 4);
+  const auto features1 = extractor1.ExtractFeatures(cloud);
+  const auto features4 = extractor4.ExtractFeatures(cloud);
+
+  ExpectCloudsEqual(features1.edges.strong.cloud,
+                    features4.edges.strong.cloud);
+  ExpectCloudsEqual(features1.edges.weak.cloud, features4.edges.weak.cloud);
+  ExpectCloudsEqual(features1.surfaces.strong.cloud,
+                    features4.surfaces.strong.cloud);
+  ExpectCloudsEqual(features1.surfaces.weak.cloud,
+                    features4.surfaces.weak.cloud);
+
+  // buffers are reused between scans
+  const auto features4_again = extractor4.ExtractFeatures(cloud);
+  ExpectCloudsEqual(features4.edges.strong.cloud,
+                    features4_again.edges.strong.cloud);
+}
+
+TEST(RingFeatureExtractor, RangeImageInput) {
+  // one point per column of the image
+  const auto cloud = CreateRoomScan(16, 1800, 0.5);
+  const RangeImage image = RangeImage::FromCloud(cloud, 1800);
+  ASSERT_EQ(image.NumValid(), cloud.size());
+
+  // same scan with the points of each ring in column order
+  pcl::PointCloud<PointXYZIRT> organized;
+  for (size_t r = 0; r < image.NumRings(); r++) {
+    for (size_t c = 0; c < image.NumColumns(); c++) {
+      const size_t i = image.Index(r, c);
+      if (image.Valid(i)) { organized.push_back(cloud[image.SourceIndex(i)]); }
+    }
+  }
+
+  RingFeatureExtractor extractor(LoadParams(), 2);
+  const auto features_image = extractor.ExtractFeatures(image);
+  const auto features_cloud = extractor.ExtractFeatures(organized);
+  EXPECT_FALSE(features_image.edges.strong.cloud.empty());
+  ExpectCloudsEqual(features_image.edges.strong.cloud,
+                    features_cloud.edges.strong.cloud);
+  ExpectCloudsEqual(features_image.surfaces.strong.cloud,
+                    features_cloud.surfaces.strong.cloud);
+  ExpectCloudsEqual(features_image.surfaces.weak.cloud,
+                    features_cloud.surfaces.weak.cloud);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
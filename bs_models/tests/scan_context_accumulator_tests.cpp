@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <beam_matching/Scancontext.h>
+
+#include <bs_models/reloc/scan_context_accumulator.h>
+
+using namespace bs_models::reloc;
+
+namespace {
+
+struct TestScan {
+  uint64_t stamp;
+  Eigen::Matrix4d T_REFFRAME_LIDAR;
+  PointCloud cloud;
+};
+
+// poles of random heights around a straight path, seen from poses along it
+std::vector<TestScan> CreateScans(int num_scans) {
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> position(-60, 60);
+  std::uniform_real_distribution<double> height(0.5, 8);
+  std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d>>
+      poles;
+  for (int i = 0; i < 300; i++) {
+    poles.emplace_back(position(generator), position(generator),
+                       height(generator), 1);
+  }
+
+  std::vector<TestScan> scans;
+  for (int i = 0; i < num_scans; i++) {
+    TestScan scan;
+    scan.stamp = 1000 + 100 * i;
+    scan.T_REFFRAME_LIDAR = Eigen::Matrix4d::Identity();
+    const double yaw = 0.02 * i;
+    scan.T_REFFRAME_LIDAR.block<2, 2>(0, 0) << std::cos(yaw), -std::sin(yaw),
+        std::sin(yaw), std::cos(yaw);
+    scan.T_REFFRAME_LIDAR.block<3, 1>(0, 3) = Eigen::Vector3d(0.5 * i, 0, 0);
+    const Eigen::Matrix4d T_LIDAR_REFFRAME = scan.T_REFFRAME_LIDAR.inverse();
+    for (const auto& pole : poles) {
+      for (double z = -2; z < pole[2]; z += 0.5) {
+        const Eigen::Vector4d p =
+            T_LIDAR_REFFRAME * Eigen::Vector4d(pole[0], pole[1], z, 1);
+        scan.cloud.push_back(pcl::PointXYZ(p[0], p[1], p[2]));
+      }
+    }
+    scans.push_back(scan);
+  }
+  return scans;
+}
+
+// as in RelocCandidateSearchScanContext::AggregateSubmapScan
+Eigen::MatrixXd AggregatedScanContext(const std::vector<TestScan>& scans,
+                                      int center, int num_scans_aggregated) {
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  const int half_window = num_scans_aggregated / 2;
+  for (int i = std::max(center - half_window, 0);
+       i <= std::min<int>(center + half_window, scans.size() - 1); i++) {
+    const Eigen::Matrix4d T_CENTER_SCAN =
+        scans[center].T_REFFRAME_LIDAR.inverse() * scans[i].T_REFFRAME_LIDAR;
+    for (const auto& p : scans[i].cloud) {
+      const Eigen::Vector4d q =
+          T_CENTER_SCAN * Eigen::Vector4d(p.x, p.y, p.z, 1);
+      pcl::PointXYZI point;
+      point.x = q[0];
+      point.y = q[1];
+      point.z = q[2];
+      point.intensity = 0;
+      cloud.push_back(point);
+    }
+  }
+  beam_matching::SCManager sc_manager;
+  return sc_manager.makeScancontext(cloud);
+}
+
+} // namespace
+
+TEST(ScanContextAccumulator, Disabled) {
+  const std::vector<TestScan> scans = CreateScans(2);
+  ScanContextAccumulator accumulator;
+  accumulator.AddScan(scans[0].stamp, scans[0].T_REFFRAME_LIDAR,
+                      scans[0].cloud);
+  EXPECT_FALSE(accumulator.Enabled());
+  EXPECT_EQ(accumulator.Size(), 0);
+}
+
+TEST(ScanContextAccumulator, SingleScan) {
+  const std::vector<TestScan> scans = CreateScans(1);
+  ScanContextAccumulator accumulator(20);
+  accumulator.AddScan(scans[0].stamp, scans[0].T_REFFRAME_LIDAR,
+                      scans[0].cloud);
+  const auto descriptors = accumulator.Descriptors();
+  ASSERT_EQ(descriptors.size(), 1);
+  EXPECT_TRUE(descriptors.at(scans[0].stamp).isApprox(
+      AggregatedScanContext(scans, 0, 20)));
+}
+
+TEST(ScanContextAccumulator, MatchesAggregatedScans) {
+  const int num_scans_aggregated = 6;
+  const std::vector<TestScan> scans = CreateScans(12);
+  ScanContextAccumulator accumulator(num_scans_aggregated);
+  for (const auto& scan : scans) {
+    accumulator.AddScan(scan.stamp, scan.T_REFFRAME_LIDAR, scan.cloud);
+  }
+  const auto descriptors = accumulator.Descriptors();
+  ASSERT_EQ(descriptors.size(), scans.size());
+  for (int i = 0; i < static_cast<int>(scans.size()); i++) {
+    const Eigen::MatrixXd expected =
+        AggregatedScanContext(scans, i, num_scans_aggregated);
+    const Eigen::MatrixXd& descriptor = descriptors.at(scans[i].stamp);
+    // only the points of the other scans are approximated by their height
+    // maps, and the highest points of the bins are the same in most of them
+    const double num_close =
+        ((descriptor - expected).array().abs() < 0.5).count();
+    EXPECT_GT(num_close / expected.size(), 0.95);
+  }
+}
+
+TEST(ScanContextAccumulator, OrderIndependent) {
+  const int num_scans_aggregated = 4;
+  const std::vector<TestScan> scans = CreateScans(10);
+  ScanContextAccumulator in_order(num_scans_aggregated);
+  for (const auto& scan : scans) {
+    in_order.AddScan(scan.stamp, scan.T_REFFRAME_LIDAR, scan.cloud);
+  }
+
+  // scans out of order and split into partial scans
+  std::vector<int> order{3, 0, 9, 1, 5, 2, 8, 4, 7, 6};
+  ScanContextAccumulator shuffled(num_scans_aggregated);
+  for (const int i : order) {
+    PointCloud first_half;
+    PointCloud second_half;
+    for (size_t j = 0; j < scans[i].cloud.size(); j++) {
+      (j % 2 == 0 ? first_half : second_half)
+          .push_back(scans[i].cloud.points[j]);
+    }
+    shuffled.AddScan(scans[i].stamp, scans[i].T_REFFRAME_LIDAR, first_half);
+    shuffled.AddScan(scans[i].stamp, scans[i].T_REFFRAME_LIDAR, second_half);
+  }
+
+  EXPECT_EQ(in_order.Stamps(), shuffled.Stamps());
+  const auto expected = in_order.Descriptors();
+  const auto descriptors = shuffled.Descriptors();
+  for (const auto& [stamp, descriptor] : expected) {
+    EXPECT_TRUE(descriptors.at(stamp).isApprox(descriptor));
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,56 @@
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include <bs_models/reloc/scan_context_index.h>
+
+using namespace bs_models::reloc;
+
+namespace {
+
+Eigen::MatrixXd CreateDescriptor(int seed) {
+  std::srand(seed);
+  Eigen::MatrixXd descriptor = Eigen::MatrixXd::Random(20, 60).cwiseAbs();
+  // empty sectors, as seen behind walls or the vehicle
+  descriptor.col(seed % 60).setZero();
+  return descriptor;
+}
+
+Eigen::MatrixXd ShiftSectors(const Eigen::MatrixXd& descriptor, int shift) {
+  Eigen::MatrixXd shifted(descriptor.rows(), descriptor.cols());
+  for (int j = 0; j < descriptor.cols(); j++) {
+    shifted.col((j + shift) % descriptor.cols()) = descriptor.col(j);
+  }
+  return shifted;
+}
+
+} // namespace
+
+TEST(ScanContextIndex, Distance) {
+  const Eigen::MatrixXd sc = CreateDescriptor(1);
+  EXPECT_NEAR(ScanContextIndex::Distance(sc, sc), 0, 1e-9);
+  EXPECT_NEAR(ScanContextIndex::Distance(sc, ShiftSectors(sc, 17)), 0, 1e-9);
+  EXPECT_GT(ScanContextIndex::Distance(sc, CreateDescriptor(2)), 0.01);
+  EXPECT_EQ(ScanContextIndex::Distance(sc, Eigen::MatrixXd::Zero(20, 60)),
+            std::numeric_limits<double>::max());
+}
+
+TEST(ScanContextIndex, Query) {
+  std::vector<Eigen::MatrixXd> descriptors;
+  for (int i = 0; i < 50; i++) { descriptors.push_back(CreateDescriptor(i)); }
+  ScanContextIndex index(descriptors);
+  ASSERT_EQ(index.Size(), 50u);
+  for (int i = 0; i < 50; i += 7) {
+    const auto [id, distance] = index.Query(ShiftSectors(descriptors[i], i), 5);
+    EXPECT_EQ(id, i);
+    EXPECT_NEAR(distance, 0, 1e-9);
+  }
+
+  ScanContextIndex empty({});
+  EXPECT_EQ(empty.Query(descriptors[0], 5).first, -1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
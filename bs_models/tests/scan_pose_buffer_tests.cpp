@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <fuse_graphs/hash_graph.h>
+
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/graph_view.h>
+#include <bs_models/scan_registration/scan_pose_buffer.h>
+
+using namespace bs_models;
+using namespace bs_models::scan_registration;
+
+namespace {
+
+ScanPoseBuffer::ScanPosePtr CreateScan(double t) {
+  Eigen::Matrix4d T_WORLD_BASELINK = Eigen::Matrix4d::Identity();
+  T_WORLD_BASELINK(0, 3) = t;
+  return std::make_shared<ScanPose>(PointCloud(), ros::Time(t),
+                                    T_WORLD_BASELINK);
+}
+
+std::vector<double> Stamps(const ScanPoseBuffer& buffer) {
+  std::vector<double> stamps;
+  for (const auto& scan : buffer) { stamps.push_back(scan->Stamp().toSec()); }
+  return stamps;
+}
+
+/**
+ * @brief add the pose of a scan to a graph, moved by dx along x
+ */
+void AddPose(const ScanPose& scan, double dx, fuse_graphs::HashGraph& graph) {
+  auto position =
+      std::make_shared<fuse_variables::Position3DStamped>(scan.Position());
+  position->x() += dx;
+  graph.addVariable(position);
+  graph.addVariable(std::make_shared<fuse_variables::Orientation3DStamped>(
+      scan.Orientation()));
+}
+
+} // namespace
+
+TEST(ScanPoseBuffer, SortedInsertAndFind) {
+  ScanPoseBuffer buffer;
+  for (double t : {2.0, 3.0, 1.0, 5.0, 4.0}) {
+    EXPECT_TRUE(buffer.Insert(CreateScan(t)));
+  }
+  EXPECT_FALSE(buffer.Insert(CreateScan(3)));
+  EXPECT_EQ(Stamps(buffer), std::vector<double>({1, 2, 3, 4, 5}));
+  EXPECT_EQ((*buffer.rbegin())->Stamp(), ros::Time(5));
+
+  const auto scan = buffer.Find(ros::Time(4));
+  ASSERT_TRUE(scan);
+  EXPECT_EQ(scan->Stamp(), ros::Time(4));
+  EXPECT_FALSE(buffer.Find(ros::Time(3.5)));
+  EXPECT_FALSE(buffer.Find(ros::Time(6)));
+}
+
+TEST(ScanPoseBuffer, Eviction) {
+  ScanPoseBuffer buffer;
+  for (double t = 1; t <= 10; t++) { buffer.Insert(CreateScan(t)); }
+
+  EXPECT_EQ(buffer.TrimOldest(8), 2u);
+  EXPECT_EQ(Stamps(buffer).front(), 3);
+  EXPECT_EQ(buffer.EraseOlderThan(ros::Time(5)), 2u);
+  EXPECT_EQ(Stamps(buffer).front(), 5);
+  EXPECT_TRUE(buffer.Erase(ros::Time(7)));
+  EXPECT_FALSE(buffer.Erase(ros::Time(7)));
+  auto is_new = [](const ScanPose& scan) { return scan.Stamp() > ros::Time(8); };
+  EXPECT_EQ(buffer.EraseIf(is_new), 2u);
+  EXPECT_EQ(Stamps(buffer), std::vector<double>({5, 6, 8}));
+  buffer.Clear();
+  EXPECT_TRUE(buffer.Empty());
+}
+
+TEST(ScanPoseBuffer, UpdatePoses) {
+  ScanPoseBuffer buffer;
+  for (double t = 1; t <= 3; t++) { buffer.Insert(CreateScan(t)); }
+
+  // without a delta, all scans in the graph are updated
+  auto graph = std::make_shared<fuse_graphs::HashGraph>();
+  for (const auto& scan : buffer) { AddPose(*scan, 1, *graph); }
+  EXPECT_EQ(buffer.UpdatePoses(graph), 3u);
+  for (const auto& scan : buffer) {
+    EXPECT_NEAR(scan->Position().x(), scan->Stamp().toSec() + 1, 1e-9);
+    EXPECT_EQ(scan->Updates(), 1);
+  }
+
+  // with a delta, only the scans with changed variables are
+  auto snapshot = std::make_shared<bs_common::GraphSnapshot>();
+  for (const auto& scan : buffer) { AddPose(*scan, 1, *snapshot); }
+  const auto scan2 = buffer.Find(ros::Time(2));
+  snapshot->DeltaMutable().changed_variables.push_back(
+      scan2->Position().uuid());
+  snapshot->DeltaMutable().BuildIndex();
+  EXPECT_EQ(buffer.UpdatePoses(snapshot), 1u);
+  EXPECT_NEAR(scan2->Position().x(), 4, 1e-9);
+  EXPECT_EQ(scan2->Updates(), 2);
+  EXPECT_NEAR(buffer.Find(ros::Time(1))->Position().x(), 2, 1e-9);
+  EXPECT_EQ(buffer.Find(ros::Time(1))->Updates(), 1);
+
+  // removed scans are not indexed anymore
+  buffer.Erase(ros::Time(2));
+  EXPECT_EQ(buffer.UpdatePoses(snapshot), 0u);
+}
+
+TEST(ScanPoseBuffer, UpdatePosesFromView) {
+  ScanPoseBuffer buffer;
+  for (double t = 1; t <= 4; t++) { buffer.Insert(CreateScan(t)); }
+
+  // scans that were never updated are kept
+  auto graph = std::make_shared<fuse_graphs::HashGraph>();
+  for (double t = 1; t <= 3; t++) {
+    AddPose(*buffer.Find(ros::Time(t)), 1, *graph);
+  }
+  std::vector<ScanPoseBuffer::ScanPosePtr> marginalized;
+  EXPECT_EQ(buffer.UpdatePoses(bs_common::GraphView(graph), marginalized), 3u);
+  EXPECT_TRUE(marginalized.empty());
+  EXPECT_EQ(buffer.Find(ros::Time(4))->Updates(), 0);
+
+  // without a delta, updated scans which left the graph are marginalized
+  graph = std::make_shared<fuse_graphs::HashGraph>();
+  for (double t = 2; t <= 4; t++) {
+    AddPose(*buffer.Find(ros::Time(t)), 1, *graph);
+  }
+  EXPECT_EQ(buffer.UpdatePoses(bs_common::GraphView(graph), marginalized), 3u);
+  ASSERT_EQ(marginalized.size(), 1u);
+  EXPECT_EQ(marginalized.front()->Stamp(), ros::Time(1));
+  EXPECT_EQ(Stamps(buffer), std::vector<double>({2, 3, 4}));
+
+  // with a delta, scans with removed variables are marginalized and only the
+  // changed and the new scans are updated
+  buffer.Insert(CreateScan(5));
+  auto snapshot = std::make_shared<bs_common::GraphSnapshot>();
+  for (double t = 3; t <= 5; t++) {
+    AddPose(*buffer.Find(ros::Time(t)), 1, *snapshot);
+  }
+  const auto scan2 = buffer.Find(ros::Time(2));
+  const auto scan3 = buffer.Find(ros::Time(3));
+  snapshot->DeltaMutable().removed_variables.push_back(
+      scan2->Position().uuid());
+  snapshot->DeltaMutable().changed_variables.push_back(
+      scan3->Position().uuid());
+  snapshot->DeltaMutable().BuildIndex();
+  EXPECT_EQ(buffer.UpdatePoses(bs_common::GraphView(snapshot), marginalized),
+            2u);
+  ASSERT_EQ(marginalized.size(), 1u);
+  EXPECT_EQ(marginalized.front(), scan2);
+  EXPECT_EQ(Stamps(buffer), std::vector<double>({3, 4, 5}));
+  EXPECT_EQ(scan3->Updates(), 3);
+  EXPECT_EQ(buffer.Find(ros::Time(4))->Updates(), 1);
+  EXPECT_EQ(buffer.Find(ros::Time(5))->Updates(), 1);
+
+  // the removed variables of a superseded graph are in no delta, the scans
+  // are marginalized anyway once they are no longer in the graph
+  snapshot = std::make_shared<bs_common::GraphSnapshot>();
+  for (double t = 4; t <= 5; t++) {
+    AddPose(*buffer.Find(ros::Time(t)), 1, *snapshot);
+  }
+  snapshot->DeltaMutable().BuildIndex();
+  EXPECT_EQ(buffer.UpdatePoses(bs_common::GraphView(snapshot), marginalized),
+            0u);
+  ASSERT_EQ(marginalized.size(), 1u);
+  EXPECT_EQ(marginalized.front(), scan3);
+  EXPECT_EQ(Stamps(buffer), std::vector<double>({4, 5}));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -3,12 +3,16 @@
 #include <ctime>
 #include <random>
 
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
 #include <fuse_constraints/absolute_pose_3d_stamped_constraint.h>
 #include <fuse_constraints/relative_pose_3d_stamped_constraint.h>
 #include <fuse_core/constraint.h>
 #include <fuse_core/uuid.h>
 #include <fuse_core/variable.h>
 #include <fuse_graphs/hash_graph.h>
+#include <pcl/common/common.h>
 #include <pcl/io/pcd_io.h>
 
 #include <beam_filtering/VoxelDownsample.h>
@@ -181,6 +185,97 @@ TEST_F(ScanPoseTest, IO) {
   EXPECT_EQ(SP2.Stamp(), ros::Time(1));
 }
 
+TEST_F(ScanPoseTest, Compression) {
+  ScanPose SP1(S1, ros::Time(0), T_WORLD_S1);
+  beam_matching::LoamPointCloud loam_cloud;
+  loam_cloud.edges.strong.cloud = S2;
+  SP1.AddPointCloud(loam_cloud, true);
+  const size_t memory = SP1.CloudMemoryUsage();
+
+  SP1.CompressClouds();
+  EXPECT_TRUE(SP1.IsCompressed());
+  EXPECT_LT(SP1.CloudMemoryUsage(), memory / 2);
+
+  // coordinates are within half a quantization step of their bounding box
+  Eigen::Vector4f min, max;
+  pcl::getMinMax3D(S1, min, max);
+  const float tolerance = (max - min).maxCoeff() / 65535;
+  auto decoded = SP1.CloudPtr();
+  ASSERT_EQ(decoded->size(), S1.size());
+  for (size_t i = 0; i < S1.size(); i++) {
+    EXPECT_NEAR(decoded->at(i).x, S1.at(i).x, tolerance);
+    EXPECT_NEAR(decoded->at(i).y, S1.at(i).y, tolerance);
+    EXPECT_NEAR(decoded->at(i).z, S1.at(i).z, tolerance);
+  }
+  EXPECT_EQ(SP1.LoamCloud().edges.strong.cloud.size(), S2.size());
+  SP1.ReleaseDecodedClouds();
+
+  // serialized clouds are decoded
+  bs_common::ByteWriter writer;
+  SP1.Serialize(writer);
+  ScanPose SP2(ros::Time(1), T_WORLD_S2);
+  bs_common::ByteReader reader(writer.Data().data(), writer.Size());
+  ASSERT_TRUE(SP2.Deserialize(reader));
+  EXPECT_FALSE(SP2.IsCompressed());
+  EXPECT_EQ(SP2.Cloud().size(), S1.size());
+  EXPECT_EQ(SP2.LoamCloud().edges.strong.cloud.size(), S2.size());
+
+  // adding points decompresses the clouds
+  SP1.AddPointCloud(S3);
+  EXPECT_FALSE(SP1.IsCompressed());
+  EXPECT_EQ(SP1.Cloud().size(), S1.size() + S3.size());
+  EXPECT_EQ(SP1.LoamCloud().edges.strong.cloud.size(), S2.size());
+}
+
+TEST_F(ScanPoseTest, Covariances) {
+  // points on the plane z = 1 have normals along z
+  PointCloud plane;
+  for (int i = 0; i < 20; i++) {
+    for (int j = 0; j < 20; j++) {
+      plane.push_back(pcl::PointXYZ(0.1 * i, 0.1 * j, 1));
+    }
+  }
+  ScanPose SP1(plane, ros::Time(0), T_WORLD_S1);
+  EXPECT_FALSE(SP1.HasCovariances());
+  const auto covariances = SP1.Covariances(10);
+  ASSERT_EQ(covariances->Size(), plane.size());
+  EXPECT_TRUE(SP1.HasCovariances());
+  for (size_t i = 0; i < plane.size(); i++) {
+    EXPECT_NEAR(std::abs(covariances->normals[i].z()), 1, 1e-4);
+    EXPECT_NEAR(covariances->covariances[i](2, 2), 1e-3, 1e-4);
+    EXPECT_NEAR(covariances->covariances[i](0, 0), 1, 1e-4);
+  }
+
+  // covariances are kept, shared by copies and survive compression
+  EXPECT_EQ(SP1.Covariances(10), covariances);
+  ScanPose SP2 = SP1;
+  EXPECT_EQ(SP2.Covariances(10), covariances);
+  SP2.CompressClouds();
+  EXPECT_EQ(SP2.Covariances(10), covariances);
+  EXPECT_NE(SP1.Covariances(5), covariances);
+
+  // covariances are saved with the scan
+  const std::string output_dir =
+      "/tmp/bs_models_scan_pose_test_" + std::to_string(getpid());
+  boost::filesystem::create_directories(output_dir);
+  SP2.SaveData(output_dir);
+  ScanPose SP3(ros::Time(1), T_WORLD_S2);
+  ASSERT_TRUE(SP3.LoadData(output_dir));
+  boost::filesystem::remove_all(output_dir);
+  ASSERT_TRUE(SP3.HasCovariances());
+  const auto loaded = SP3.Covariances(10);
+  ASSERT_EQ(loaded->Size(), plane.size());
+  for (size_t i = 0; i < plane.size(); i++) {
+    EXPECT_TRUE(loaded->covariances[i].isApprox(covariances->covariances[i]));
+    EXPECT_TRUE(loaded->normals[i].isApprox(covariances->normals[i]));
+  }
+
+  // replacing the cloud drops them
+  SP3.AddPointCloud(S1);
+  EXPECT_FALSE(SP3.HasCovariances());
+  EXPECT_EQ(SP3.Covariances(10)->Size(), plane.size() + S1.size());
+}
+
 TEST_F(ScanPoseTest, 2NodeFG) {
   // create scan poses
   ScanPose SP1(S1, ros::Time(0), T_WORLD_S1);
@@ -278,6 +278,119 @@ TEST_F(ScanToMapLoamRegistrationTest, 3Scans) {
   EXPECT_TRUE(beam::ArePosesEqual(T_WORLD_S3_mea, T_WORLD_S3, 1, 0.06, true));
 }
 
+TEST_F(ScanToMapLoamRegistrationTest, SharedLoamMap) {
+  std::shared_ptr<LoamFeatureExtractor> feature_extractor =
+      std::make_shared<LoamFeatureExtractor>(loam_params);
+  ScanPose SP1(S1, ros::Time(0), T_WORLD_S1, T_BASELINK_LIDAR,
+               feature_extractor);
+  ScanPose SP2(S2, ros::Time(1), T_WORLD_S2, T_BASELINK_LIDAR,
+               feature_extractor);
+
+  RegistrationMap map("shared_loam_map_test");
+  map.AddPointCloud(SP1.Cloud(), SP1.LoamCloud(), SP1.Stamp(), T_WORLD_S1);
+
+  // the map is only rebuilt once it changed
+  LoamPointCloudPtr map1 = map.GetLoamCloudMapPtr();
+  EXPECT_EQ(map.GetLoamCloudMapPtr(), map1);
+  const size_t map1_size = map1->surfaces.strong.cloud.size();
+  EXPECT_GT(map1_size, 0);
+
+  // clouds handed out are not modified by later updates
+  map.AddPointCloud(SP2.Cloud(), SP2.LoamCloud(), SP2.Stamp(), T_WORLD_S2);
+  LoamPointCloudPtr map2 = map.GetLoamCloudMapPtr();
+  EXPECT_NE(map2, map1);
+  EXPECT_EQ(map1->surfaces.strong.cloud.size(), map1_size);
+  EXPECT_GT(map2->surfaces.strong.cloud.size(), map1_size);
+  EXPECT_EQ(map.GetLoamCloudMap().surfaces.strong.cloud.size(),
+            map2->surfaces.strong.cloud.size());
+}
+
+TEST_F(ScanToMapLoamRegistrationTest, LoamMapPyramid) {
+  std::shared_ptr<LoamFeatureExtractor> feature_extractor =
+      std::make_shared<LoamFeatureExtractor>(loam_params);
+  ScanPose SP1(S1, ros::Time(0), T_WORLD_S1, T_BASELINK_LIDAR,
+               feature_extractor);
+  ScanPose SP2(S2, ros::Time(1), T_WORLD_S2, T_BASELINK_LIDAR,
+               feature_extractor);
+
+  RegistrationMap map("loam_map_pyramid_test");
+  EXPECT_THROW(map.SetPyramidVoxelSizes({0.5, 0.2}), std::invalid_argument);
+  map.SetPyramidVoxelSizes({0.2, 0.5});
+  EXPECT_EQ(map.NumPyramidLevels(), 3);
+  map.AddPointCloud(SP1.Cloud(), SP1.LoamCloud(), SP1.Stamp(), T_WORLD_S1);
+  map.AddPointCloud(SP2.Cloud(), SP2.LoamCloud(), SP2.Stamp(), T_WORLD_S2);
+
+  // each level is coarser than the one below it
+  const LoamPointCloudPtr level1 = map.GetLoamCloudMapPtr(1);
+  const LoamPointCloudPtr level2 = map.GetLoamCloudMapPtr(2);
+  EXPECT_EQ(map.GetLoamCloudMapPtr(1), level1);
+  EXPECT_GT(level2->surfaces.strong.cloud.size(), 0);
+  EXPECT_LT(level2->surfaces.strong.cloud.size(),
+            level1->surfaces.strong.cloud.size());
+  EXPECT_LT(level1->surfaces.strong.cloud.size(),
+            map.GetLoamCloudMapPtr()->surfaces.strong.cloud.size());
+  EXPECT_TRUE(level1->surfaces.weak.cloud.empty());
+
+  // levels are maintained incrementally, removing a scan gives the level of
+  // the remaining scan
+  RegistrationMap single_map("loam_map_pyramid_single_test");
+  single_map.SetPyramidVoxelSizes({0.2, 0.5});
+  single_map.AddPointCloud(SP2.Cloud(), SP2.LoamCloud(), SP2.Stamp(),
+                           T_WORLD_S2);
+  map.SetMapSize(1);
+  EXPECT_NE(map.GetLoamCloudMapPtr(1), level1);
+  EXPECT_EQ(map.GetLoamCloudMapPtr(1)->surfaces.strong.cloud.size(),
+            single_map.GetLoamCloudMapPtr(1)->surfaces.strong.cloud.size());
+}
+
+TEST(RegistrationMapRetention, CoverageBased) {
+  // a 3 x 3 m patch of floor in the scan frame
+  PointCloud cloud;
+  for (double x = 0; x < 3; x += 0.1) {
+    for (double y = 0; y < 3; y += 0.1) {
+      cloud.push_back(pcl::PointXYZ(x, y, 0));
+    }
+  }
+  const auto T_at = [](double x) {
+    Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+    T(0, 3) = x;
+    return T;
+  };
+
+  RegistrationMap::RetentionParams params;
+  params.coverage_based = true;
+  RegistrationMap map("coverage_retention_test");
+  map.SetMapSize(2);
+  map.SetRetentionParams(params);
+
+  // a stationary robot replaces its previous scans
+  for (int i = 0; i < 3; i++) {
+    map.AddPointCloud(cloud, LoamPointCloud(), ros::Time(i), T_at(0));
+  }
+  EXPECT_EQ(map.NumScans(), 1);
+  Eigen::Matrix4d T;
+  EXPECT_TRUE(map.GetScanPose(ros::Time(2), T));
+
+  // once full, the scan furthest from the newest one is removed
+  map.AddPointCloud(cloud, LoamPointCloud(), ros::Time(3), T_at(20));
+  map.AddPointCloud(cloud, LoamPointCloud(), ros::Time(4), T_at(5));
+  EXPECT_EQ(map.NumScans(), 2);
+  EXPECT_TRUE(map.GetScanPose(ros::Time(2), T));
+  EXPECT_FALSE(map.GetScanPose(ros::Time(3), T));
+  EXPECT_TRUE(map.GetScanPose(ros::Time(4), T));
+
+  // scans are also removed once too far from the newest one
+  params.max_distance_m = 10;
+  map.SetRetentionParams(params);
+  map.AddPointCloud(cloud, LoamPointCloud(), ros::Time(5), T_at(14));
+  EXPECT_EQ(map.NumScans(), 2);
+  EXPECT_FALSE(map.GetScanPose(ros::Time(2), T));
+  EXPECT_TRUE(map.GetScanPose(ros::Time(4), T));
+
+  nlohmann::json J{{"redundancy_threshold", 1.5}};
+  EXPECT_THROW(params.LoadFromJson(J), std::invalid_argument);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   std::cout << "Starting ROS test, make sure you have a roscore going\n";
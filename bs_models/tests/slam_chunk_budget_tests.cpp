@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include <opencv2/imgcodecs.hpp>
+#include <ros/serialization.h>
+
+#include <bs_models/global_mapping/slam_chunk_budget.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+geometry_msgs::Vector3 MakePoint(double x, double y, double z) {
+  geometry_msgs::Vector3 p;
+  p.x = x;
+  p.y = y;
+  p.z = z;
+  return p;
+}
+
+bs_common::SlamChunkMsg MakeChunk() {
+  bs_common::SlamChunkMsg chunk;
+  chunk.T_WORLD_BASELINK.header.stamp = ros::Time(10);
+  chunk.T_WORLD_BASELINK.pose.position.x = 1;
+  chunk.T_WORLD_BASELINK.pose.orientation.w = 1;
+  chunk.trajectory_measurement.poses.resize(5);
+
+  // noise, so the images cannot be compressed much
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> pixel(0, 255);
+  sensor_msgs::Image& image = chunk.camera_measurement.image;
+  image.header.stamp = ros::Time(10);
+  image.height = 120;
+  image.width = 160;
+  image.encoding = "mono8";
+  image.step = 160;
+  image.data.resize(image.height * image.step);
+  for (auto& p : image.data) { p = static_cast<uint8_t>(pixel(rng)); }
+  chunk.camera_measurement.header.stamp = ros::Time(10);
+  chunk.camera_measurement.descriptor_type = "ORB";
+  chunk.camera_measurement.landmark_ids = {1, 2, 3};
+
+  bs_common::LidarMeasurementMsg& lidar = chunk.lidar_measurement;
+  lidar.frame_id = "lidar";
+  for (int i = 0; i < 2000; i++) {
+    lidar.lidar_points.push_back(MakePoint(i, 0, 1));
+  }
+  for (int i = 0; i < 100; i++) {
+    lidar.lidar_edges_strong.push_back(MakePoint(i, 1, 0));
+    lidar.lidar_surfaces_strong.push_back(MakePoint(i, 2, 0));
+  }
+  return chunk;
+}
+
+/** size of a chunk without its image and dense points */
+size_t FeaturesSize(bs_common::SlamChunkMsg chunk) {
+  chunk.camera_measurement.image = sensor_msgs::Image();
+  chunk.lidar_measurement.lidar_points.clear();
+  return ros::serialization::serializationLength(chunk);
+}
+
+SlamChunkBudget::Params BudgetOfBytes(size_t bytes) {
+  SlamChunkBudget::Params params;
+  params.budget_kbps = bytes * 8 / 1000.0;
+  params.burst_s = 1;
+  return params;
+}
+
+} // namespace
+
+TEST(SlamChunkBudget, CompressesImagesWithoutBudget) {
+  SlamChunkBudget budget;
+  bs_common::SlamChunkMsg chunk = MakeChunk();
+  const size_t num_points = chunk.lidar_measurement.lidar_points.size();
+
+  EXPECT_EQ(budget.Fit(chunk, ros::Time(1)), SlamChunkBudget::Level::FULL);
+  EXPECT_TRUE(chunk.camera_measurement.image.data.empty());
+  EXPECT_EQ(chunk.camera_measurement.compressed_image.format, "jpeg");
+  EXPECT_EQ(chunk.lidar_measurement.lidar_points.size(), num_points);
+
+  const cv::Mat image = cv::imdecode(
+      chunk.camera_measurement.compressed_image.data, cv::IMREAD_UNCHANGED);
+  EXPECT_EQ(image.rows, 120);
+  EXPECT_EQ(image.cols, 160);
+  EXPECT_EQ(budget.GetStats().chunks[0], 1u);
+  EXPECT_EQ(budget.GetStats().bytes,
+            ros::serialization::serializationLength(chunk));
+}
+
+TEST(SlamChunkBudget, RecompressesCompressedImages) {
+  SlamChunkBudget budget;
+  bs_common::SlamChunkMsg chunk = MakeChunk();
+
+  // as forwarded by a tracker subscribed to compressed images
+  auto& camera = chunk.camera_measurement;
+  const cv::Mat raw(camera.image.height, camera.image.width, CV_8UC1,
+                    camera.image.data.data());
+  cv::imencode(".png", raw, camera.compressed_image.data);
+  camera.compressed_image.format = "png";
+  camera.image = sensor_msgs::Image();
+
+  EXPECT_EQ(budget.Fit(chunk, ros::Time(1)), SlamChunkBudget::Level::FULL);
+  EXPECT_EQ(camera.compressed_image.format, "jpeg");
+  const cv::Mat image =
+      cv::imdecode(camera.compressed_image.data, cv::IMREAD_UNCHANGED);
+  EXPECT_EQ(image.rows, 120);
+  EXPECT_EQ(image.cols, 160);
+}
+
+TEST(SlamChunkBudget, DropsImagesThenPointsThenFeatures) {
+  const bs_common::SlamChunkMsg original = MakeChunk();
+  SlamChunkBudget budget(BudgetOfBytes(FeaturesSize(original) + 16));
+
+  bs_common::SlamChunkMsg chunk = original;
+  EXPECT_EQ(budget.Fit(chunk, ros::Time(1)),
+            SlamChunkBudget::Level::FEATURES);
+  EXPECT_TRUE(chunk.camera_measurement.image.data.empty());
+  EXPECT_TRUE(chunk.camera_measurement.compressed_image.data.empty());
+  EXPECT_EQ(chunk.camera_measurement.landmark_ids.size(), 3u);
+  EXPECT_TRUE(chunk.lidar_measurement.lidar_points.empty());
+  EXPECT_EQ(chunk.lidar_measurement.lidar_edges_strong.size(), 100u);
+
+  // the budget is used, only the poses are sent
+  chunk = original;
+  EXPECT_EQ(budget.Fit(chunk, ros::Time(1.01)), SlamChunkBudget::Level::POSES);
+  EXPECT_TRUE(chunk.camera_measurement.landmark_ids.empty());
+  EXPECT_TRUE(chunk.lidar_measurement.lidar_edges_strong.empty());
+  EXPECT_EQ(chunk.camera_measurement.header.stamp, ros::Time(10));
+  EXPECT_EQ(chunk.T_WORLD_BASELINK, original.T_WORLD_BASELINK);
+  EXPECT_EQ(chunk.trajectory_measurement.poses.size(), 5u);
+
+  // the budget refills up to the burst
+  chunk = original;
+  EXPECT_EQ(budget.Fit(chunk, ros::Time(100)),
+            SlamChunkBudget::Level::FEATURES);
+
+  const auto& stats = budget.GetStats();
+  const auto count = [&stats](SlamChunkBudget::Level level) {
+    return stats.chunks[static_cast<size_t>(level)];
+  };
+  EXPECT_EQ(count(SlamChunkBudget::Level::FULL), 0u);
+  EXPECT_EQ(count(SlamChunkBudget::Level::FEATURES), 2u);
+  EXPECT_EQ(count(SlamChunkBudget::Level::POSES), 1u);
+}
+
+TEST(SlamChunkBudget, KeepsImagesAtMinQuality) {
+  const bs_common::SlamChunkMsg original = MakeChunk();
+  bs_common::SlamChunkMsg reduced = original;
+  SlamChunkBudget::Params params;
+  params.jpeg_quality = params.min_jpeg_quality;
+  SlamChunkBudget unlimited(params);
+  reduced.lidar_measurement.lidar_points.clear();
+  unlimited.Fit(reduced, ros::Time(1));
+
+  // enough for the reduced chunk, not the full one
+  SlamChunkBudget budget(
+      BudgetOfBytes(ros::serialization::serializationLength(reduced) + 16));
+  bs_common::SlamChunkMsg chunk = original;
+  EXPECT_EQ(budget.Fit(chunk, ros::Time(1)), SlamChunkBudget::Level::REDUCED);
+  EXPECT_FALSE(chunk.camera_measurement.compressed_image.data.empty());
+  EXPECT_TRUE(chunk.lidar_measurement.lidar_points.empty());
+  EXPECT_EQ(chunk.lidar_measurement.lidar_edges_strong.size(), 100u);
+}
+
+TEST(SlamChunkBudget, AdaptsJpegQuality) {
+  const bs_common::SlamChunkMsg original = MakeChunk();
+  SlamChunkBudget budget(BudgetOfBytes(FeaturesSize(original) + 16));
+  EXPECT_EQ(budget.JpegQuality(), 90);
+
+  // full chunks do not fit, down to the min quality
+  for (int i = 0; i < 10; i++) {
+    bs_common::SlamChunkMsg chunk = original;
+    budget.Fit(chunk, ros::Time(100 * (i + 1)));
+  }
+  EXPECT_EQ(budget.JpegQuality(), 40);
+
+  // small chunks fit with budget to spare
+  bs_common::SlamChunkMsg small;
+  small.T_WORLD_BASELINK = original.T_WORLD_BASELINK;
+  EXPECT_EQ(budget.Fit(small, ros::Time(2000)), SlamChunkBudget::Level::FULL);
+  EXPECT_EQ(budget.JpegQuality(), 50);
+
+  budget.Reset();
+  EXPECT_EQ(budget.JpegQuality(), 90);
+}
+
+TEST(SlamChunkBudget, InvalidParams) {
+  SlamChunkBudget::Params params;
+  params.min_jpeg_quality = 95;
+  EXPECT_THROW(SlamChunkBudget{params}, std::invalid_argument);
+  params = SlamChunkBudget::Params();
+  params.quality_step = 0;
+  EXPECT_THROW(SlamChunkBudget{params}, std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,110 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/extrinsics_lookup_base.h>
+#include <bs_models/global_mapping/submap_evictor.h>
+
+using namespace bs_models::global_mapping;
+
+class SubmapEvictorTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::string current_file = "submap_evictor_tests.cpp";
+    std::string test_path = __FILE__;
+    test_path.erase(test_path.end() - current_file.size(), test_path.end());
+    extrinsics_ = std::make_shared<bs_common::ExtrinsicsLookupBase>(
+        test_path + "data/frame_ids.json", test_path + "data/extrinsics.json");
+
+    // submaps 10 m apart with 3 scans of 1000 points each
+    ros::Time stamp(1);
+    for (uint16_t i = 0; i < num_submaps_; i++) {
+      Eigen::Matrix4d T_WORLD_SUBMAP = Eigen::Matrix4d::Identity();
+      T_WORLD_SUBMAP(0, 3) = 10 * i;
+      submaps_.push_back(std::make_shared<Submap>(stamp, T_WORLD_SUBMAP,
+                                                  nullptr, extrinsics_));
+      for (int s = 0; s < 3; s++) {
+        PointCloud cloud;
+        for (int p = 0; p < 1000; p++) {
+          cloud.push_back(pcl::PointXYZ(p * 0.01, i, s));
+        }
+        submaps_.back()->AddLidarMeasurement(cloud, T_WORLD_SUBMAP, stamp);
+        stamp += ros::Duration(1);
+      }
+    }
+  }
+
+  bool IsLoaded(size_t id) const {
+    return !submaps_.at(id)->LidarKeyframes().begin()->second.Cloud().empty();
+  }
+
+  const uint16_t num_submaps_{5};
+  std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_;
+  std::vector<SubmapPtr> submaps_;
+};
+
+TEST_F(SubmapEvictorTest, Distance) {
+  SubmapEvictor::Params params;
+  params.enabled = true;
+  params.distance_m = 25;
+  SubmapEvictor evictor(params);
+
+  // the last submap is not completed and is never evicted
+  EXPECT_EQ(evictor.Update(submaps_, 4, Eigen::Vector3d(45, 0, 0)), 2u);
+  EXPECT_TRUE(evictor.IsEvicted(0));
+  EXPECT_TRUE(evictor.IsEvicted(1));
+  EXPECT_FALSE(IsLoaded(0));
+  EXPECT_FALSE(IsLoaded(1));
+  for (uint16_t i = 2; i < num_submaps_; i++) { EXPECT_TRUE(IsLoaded(i)); }
+
+  // reload, then evict again once released
+  {
+    auto lease = evictor.Acquire(submaps_, {1, 1});
+    EXPECT_TRUE(lease.Valid());
+    EXPECT_EQ(evictor.NumEvicted(), 1u);
+    ASSERT_TRUE(IsLoaded(1));
+    const auto& cloud =
+        submaps_.at(1)->LidarKeyframes().begin()->second.Cloud();
+    EXPECT_EQ(cloud.size(), 1000u);
+    EXPECT_FLOAT_EQ(cloud.at(0).y, 1);
+  }
+  EXPECT_TRUE(evictor.IsEvicted(1));
+  EXPECT_EQ(evictor.NumEvicted(), 2u);
+
+  // evicted submaps stay evicted when the robot comes back, until leased
+  EXPECT_EQ(evictor.Update(submaps_, 4, Eigen::Vector3d::Zero()), 1u);
+  EXPECT_TRUE(evictor.IsEvicted(0));
+  EXPECT_TRUE(evictor.IsEvicted(3));
+  EXPECT_FALSE(evictor.IsEvicted(4));
+  EXPECT_TRUE(IsLoaded(4));
+}
+
+TEST_F(SubmapEvictorTest, MaxResident) {
+  SubmapEvictor::Params params;
+  params.enabled = true;
+  params.distance_m = 0;
+  params.max_resident_submaps = 2;
+  SubmapEvictor evictor(params);
+
+  submaps_.at(0)->CompressLidarKeyframes();
+  EXPECT_EQ(evictor.Update(submaps_, 4, Eigen::Vector3d::Zero()), 2u);
+  EXPECT_EQ(evictor.NumEvicted(), 2u);
+
+  // leased submaps are kept even when over the limit
+  {
+    auto lease = evictor.Acquire(submaps_, {0, 1, 2});
+    EXPECT_TRUE(lease.Valid());
+    for (uint16_t i = 0; i < 3; i++) { EXPECT_TRUE(IsLoaded(i)); }
+    EXPECT_TRUE(
+        submaps_.at(0)->LidarKeyframes().begin()->second.IsCompressed());
+    EXPECT_FALSE(
+        submaps_.at(1)->LidarKeyframes().begin()->second.IsCompressed());
+  }
+
+  // the least recently used submaps are evicted first
+  EXPECT_EQ(evictor.NumEvicted(), 2u);
+  EXPECT_TRUE(evictor.IsEvicted(0));
+  EXPECT_TRUE(evictor.IsEvicted(3));
+  EXPECT_FALSE(evictor.IsEvicted(1));
+  EXPECT_FALSE(evictor.IsEvicted(2));
+}
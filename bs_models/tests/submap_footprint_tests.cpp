@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <bs_models/global_mapping/submap_footprint.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+/**
+ * @brief floor and walls of a 40 x 10 m corridor, with 3 m high walls, with
+ * its floor at height z0
+ */
+PointCloud CreateCorridor(double z0 = 0) {
+  PointCloud cloud;
+  for (double x = 0; x < 40; x += 0.25) {
+    for (double y = 0; y < 10; y += 0.25) {
+      cloud.push_back(pcl::PointXYZ(x, y, z0));
+    }
+    for (double z = 0; z < 3; z += 0.25) {
+      cloud.push_back(pcl::PointXYZ(x, 0, z0 + z));
+      cloud.push_back(pcl::PointXYZ(x, 10, z0 + z));
+    }
+  }
+  return cloud;
+}
+
+Eigen::Matrix4d Pose(double yaw, const Eigen::Vector3d& t) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) =
+      Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T.block<3, 1>(0, 3) = t;
+  return T;
+}
+
+} // namespace
+
+TEST(SubmapFootprint, Compute) {
+  SubmapFootprint::Params params;
+  params.voxel_size_m = 1;
+  const SubmapFootprint footprint(CreateCorridor(), params);
+  ASSERT_FALSE(footprint.Empty());
+
+  // the longest axis is along the corridor
+  EXPECT_NEAR(std::abs(footprint.BoxAxes().col(2).x()), 1, 1e-6);
+  EXPECT_NEAR(footprint.BoxHalfExtents()[2], 20, 1);
+  EXPECT_NEAR(footprint.BoxCenter().x(), 20, 1);
+
+  double sum = 0;
+  for (float bin : footprint.HeightHistogram()) { sum += bin; }
+  EXPECT_NEAR(sum, 1, 1e-5);
+  EXPECT_EQ(footprint.HeightHistogram().size(), 32u);
+
+  EXPECT_TRUE(SubmapFootprint(PointCloud(), params).Empty());
+}
+
+TEST(SubmapFootprint, Overlap) {
+  SubmapFootprint::Params params;
+  params.voxel_size_m = 1;
+  const SubmapFootprint footprint(CreateCorridor(), params);
+  const Eigen::Matrix4d I = Eigen::Matrix4d::Identity();
+  EXPECT_TRUE(footprint.BoxesIntersect(footprint, I));
+  EXPECT_NEAR(footprint.OccupancyOverlap(footprint, I), 1, 1e-9);
+  EXPECT_NEAR(footprint.HeightSimilarity(footprint), 1, 1e-5);
+
+  // a small pose error is absorbed by the dilation
+  const Eigen::Matrix4d T_small = Pose(0.01, Eigen::Vector3d(0.6, -0.4, 0));
+  EXPECT_GT(footprint.OccupancyOverlap(footprint, T_small), 0.9);
+
+  // next to each other along the corridor, the boxes only touch with a margin
+  const Eigen::Matrix4d T_next = Pose(0, Eigen::Vector3d(42, 0, 0));
+  EXPECT_FALSE(footprint.BoxesIntersect(footprint, T_next));
+  EXPECT_TRUE(footprint.BoxesIntersect(footprint, T_next, 2));
+  EXPECT_LT(footprint.OccupancyOverlap(footprint, T_next), 0.05);
+
+  // rotated by 90 degrees around the center, the corridors cross
+  const Eigen::Matrix4d T_crossing =
+      Pose(M_PI / 2, Eigen::Vector3d(25, -15, 0));
+  EXPECT_TRUE(footprint.BoxesIntersect(footprint, T_crossing));
+  EXPECT_LT(footprint.OccupancyOverlap(footprint, T_crossing), 0.5);
+
+  // far away
+  const Eigen::Matrix4d T_far = Pose(0.3, Eigen::Vector3d(500, 200, 0));
+  EXPECT_FALSE(footprint.BoxesIntersect(footprint, T_far, 2));
+  EXPECT_EQ(footprint.OccupancyOverlap(footprint, T_far), 0);
+}
+
+TEST(SubmapFootprint, HeightSimilarity) {
+  SubmapFootprint::Params params;
+  params.voxel_size_m = 1;
+  const SubmapFootprint corridor(CreateCorridor(), params);
+
+  // heights are measured from the floor
+  const SubmapFootprint raised(CreateCorridor(7), params);
+  EXPECT_NEAR(corridor.HeightSimilarity(raised), 1, 1e-5);
+
+  // two floors of a building have a different height distribution
+  PointCloud two_floors = CreateCorridor();
+  two_floors += CreateCorridor(6);
+  const SubmapFootprint building(two_floors, params);
+  EXPECT_LT(corridor.HeightSimilarity(building), 0.6);
+}
+
+TEST(SubmapFootprint, InvalidParams) {
+  SubmapFootprint::Params params;
+  nlohmann::json J{{"voxel_size_m", 0}};
+  EXPECT_THROW(params.LoadFromJson(J), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
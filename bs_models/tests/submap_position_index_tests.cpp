@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/submap_position_index.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+std::vector<Eigen::Vector3d> CreatePositions(size_t n) {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<double> distribution(-200, 200);
+  std::vector<Eigen::Vector3d> positions;
+  for (size_t i = 0; i < n; i++) {
+    positions.emplace_back(distribution(generator), distribution(generator),
+                           0.1 * distribution(generator));
+  }
+  return positions;
+}
+
+std::vector<size_t> BruteForce(const std::vector<Eigen::Vector3d>& positions,
+                               const Eigen::Vector3d& query, size_t max_id) {
+  std::vector<std::pair<double, size_t>> distances;
+  for (size_t i = 0; i < std::min(max_id, positions.size()); i++) {
+    distances.emplace_back((positions[i] - query).norm(), i);
+  }
+  std::sort(distances.begin(), distances.end());
+  std::vector<size_t> ids;
+  for (const auto& d : distances) { ids.push_back(d.second); }
+  return ids;
+}
+
+} // namespace
+
+TEST(SubmapPositionIndex, Queries) {
+  const auto positions = CreatePositions(500);
+  SubmapPositionIndex index(10);
+  for (size_t i = 0; i < positions.size(); i++) {
+    index.Update(i, positions[i]);
+  }
+  ASSERT_EQ(index.Size(), positions.size());
+
+  for (const auto& query : CreatePositions(20)) {
+    const size_t max_id = 400;
+    const auto expected = BruteForce(positions, query, max_id);
+
+    const auto nearest = index.Nearest(query, 5, max_id);
+    EXPECT_EQ(nearest,
+              std::vector<size_t>(expected.begin(), expected.begin() + 5));
+
+    const double radius = 30;
+    std::vector<size_t> expected_radius;
+    for (const size_t id : expected) {
+      if ((positions[id] - query).norm() <= radius) {
+        expected_radius.push_back(id);
+      }
+    }
+    EXPECT_EQ(index.Radius(query, radius, max_id), expected_radius);
+    EXPECT_EQ(index.Radius(query, 1000, max_id), expected);
+  }
+}
+
+TEST(SubmapPositionIndex, Update) {
+  SubmapPositionIndex index(10);
+  EXPECT_TRUE(index.Nearest(Eigen::Vector3d::Zero(), 3, 10).empty());
+  index.Update(0, Eigen::Vector3d(0, 0, 0));
+  index.Update(1, Eigen::Vector3d(50, 0, 0));
+  index.Update(2, Eigen::Vector3d(100, 0, 0));
+  EXPECT_THROW(index.Update(4, Eigen::Vector3d::Zero()), std::out_of_range);
+
+  // move submap 2 next to the query
+  index.Update(2, Eigen::Vector3d(1, 0, 0));
+  EXPECT_EQ(index.Radius(Eigen::Vector3d::Zero(), 5, 3),
+            (std::vector<size_t>{0, 2}));
+  EXPECT_EQ(index.Radius(Eigen::Vector3d::Zero(), 5, 2),
+            (std::vector<size_t>{0}));
+
+  index.Resize(1);
+  EXPECT_EQ(index.Size(), 1u);
+  EXPECT_EQ(index.Nearest(Eigen::Vector3d(50, 0, 0), 3, 10),
+            (std::vector<size_t>{0}));
+  index.Clear();
+  EXPECT_TRUE(index.Radius(Eigen::Vector3d::Zero(), 1000, 10).empty());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,136 @@
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/submap_prefetcher.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+/**
+ * @brief fake loads, each submap takes 1 MB and is released when its handle
+ * is destroyed
+ */
+class FakeLoader {
+public:
+  SubmapPrefetcher::LoadFunction Function() {
+    return [this](const std::vector<SubmapPtr>& submaps, size_t submap_id,
+                  size_t& memory_bytes) -> SubmapPrefetcher::Handle {
+      if (submap_id == failing_id) { return nullptr; }
+      num_loads++;
+      memory_bytes = 1000000;
+      return std::shared_ptr<void>(new int(0), [this](void* p) {
+        delete static_cast<int*>(p);
+        num_releases++;
+      });
+    };
+  }
+
+  size_t failing_id{100};
+  std::atomic<int> num_loads{0};
+  std::atomic<int> num_releases{0};
+};
+
+SubmapPrefetcher::Params DefaultParams() {
+  SubmapPrefetcher::Params params;
+  params.enabled = true;
+  params.horizon_s = 10;
+  params.min_horizon_m = 10;
+  params.sample_spacing_m = 5;
+  params.memory_budget_mb = 2.5;
+  return params;
+}
+
+} // namespace
+
+TEST(SubmapPrefetcher, ExtrapolatesVelocity) {
+  FakeLoader loader;
+  SubmapPrefetcher prefetcher(DefaultParams(), loader.Function());
+
+  // no velocity yet, nothing ahead of the robot is known
+  EXPECT_EQ(prefetcher.PredictPath(Eigen::Vector3d::Zero(), ros::Time(1))
+                .size(),
+            1u);
+
+  // 2 m/s along x for 10 s
+  const std::vector<Eigen::Vector3d> path =
+      prefetcher.PredictPath(Eigen::Vector3d(2, 0, 0), ros::Time(2));
+  ASSERT_EQ(path.size(), 5u);
+  EXPECT_TRUE(path.front().isApprox(Eigen::Vector3d(2, 0, 0)));
+  EXPECT_TRUE(path.back().isApprox(Eigen::Vector3d(22, 0, 0)));
+}
+
+TEST(SubmapPrefetcher, FollowsPlannedPath) {
+  FakeLoader loader;
+  SubmapPrefetcher::Params params = DefaultParams();
+  params.min_horizon_m = 30;
+  params.sample_spacing_m = 10;
+  SubmapPrefetcher prefetcher(params, loader.Function());
+  prefetcher.SetPlannedPath({Eigen::Vector3d(0, 0, 0),
+                             Eigen::Vector3d(0, 20, 0),
+                             Eigen::Vector3d(20, 20, 0)});
+
+  // next to the first segment, along the corner of the path
+  const std::vector<Eigen::Vector3d> path =
+      prefetcher.PredictPath(Eigen::Vector3d(1, 1, 0), ros::Time(1));
+  ASSERT_EQ(path.size(), 4u);
+  EXPECT_TRUE(path[1].isApprox(Eigen::Vector3d(0, 10, 0)));
+  EXPECT_TRUE(path[2].isApprox(Eigen::Vector3d(0, 20, 0)));
+  EXPECT_TRUE(path[3].isApprox(Eigen::Vector3d(10, 20, 0)));
+
+  // back to extrapolating
+  prefetcher.SetPlannedPath({});
+  EXPECT_EQ(prefetcher.PredictPath(Eigen::Vector3d(1, 1, 0), ros::Time(2))
+                .size(),
+            1u);
+}
+
+TEST(SubmapPrefetcher, LoadsWithinBudget) {
+  FakeLoader loader;
+  SubmapPrefetcher prefetcher(DefaultParams(), loader.Function());
+
+  // only the first two fit in the budget
+  prefetcher.Request({}, {3, 1, 4});
+  prefetcher.Flush();
+  EXPECT_EQ(prefetcher.PrefetchedIds(), std::vector<size_t>({1, 3}));
+  EXPECT_EQ(prefetcher.MemoryUsage(), 2000000u);
+  EXPECT_EQ(loader.num_releases, 1);
+
+  // submaps that are still requested are kept
+  prefetcher.Request({}, {1, 2});
+  prefetcher.Flush();
+  EXPECT_EQ(prefetcher.PrefetchedIds(), std::vector<size_t>({1, 2}));
+  EXPECT_EQ(loader.num_loads, 4);
+  EXPECT_EQ(loader.num_releases, 2);
+
+  // failed loads are skipped
+  loader.failing_id = 5;
+  prefetcher.Request({}, {5, 6});
+  prefetcher.Flush();
+  EXPECT_EQ(prefetcher.PrefetchedIds(), std::vector<size_t>({6}));
+  EXPECT_EQ(loader.num_releases, 4);
+}
+
+TEST(SubmapPrefetcher, ReleasesOnDestruction) {
+  FakeLoader loader;
+  {
+    SubmapPrefetcher prefetcher(DefaultParams(), loader.Function());
+    prefetcher.Request({}, {0, 1});
+    prefetcher.Flush();
+  }
+  EXPECT_EQ(loader.num_loads, 2);
+  EXPECT_EQ(loader.num_releases, 2);
+}
+
+TEST(SubmapPrefetcher, InvalidParams) {
+  SubmapPrefetcher::Params params;
+  nlohmann::json J{{"sample_spacing_m", 0}};
+  EXPECT_THROW(params.LoadFromJson(J), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
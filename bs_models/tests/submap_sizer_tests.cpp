@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/submap_sizer.h>
+
+using namespace bs_models::global_mapping;
+
+TEST(SubmapSizer, Disabled) {
+  SubmapSizer sizer;
+  sizer.Add(1000000, 1000000, 1000);
+  EXPECT_FALSE(sizer.StartNewSubmap(9.9, 10));
+  EXPECT_TRUE(sizer.StartNewSubmap(10, 10));
+}
+
+TEST(SubmapSizer, SplitOverBudget) {
+  SubmapSizer::Params params;
+  params.enabled = true;
+  params.max_lidar_points = 1000;
+  params.min_submap_size_m = 2;
+  SubmapSizer sizer(params);
+  sizer.Add(999, 0, 1);
+  EXPECT_FALSE(sizer.StartNewSubmap(5, 10));
+  sizer.Add(1, 0, 1);
+  EXPECT_TRUE(sizer.StartNewSubmap(5, 10));
+
+  // never split below the min size
+  EXPECT_FALSE(sizer.StartNewSubmap(1, 10));
+
+  sizer.Reset();
+  EXPECT_EQ(sizer.GetFill().lidar_points, 0u);
+  EXPECT_FALSE(sizer.StartNewSubmap(5, 10));
+}
+
+TEST(SubmapSizer, GrowUnderfilled) {
+  SubmapSizer::Params params;
+  params.enabled = true;
+  params.max_lidar_points = 1000;
+  params.max_keyframes = 100;
+  params.max_submap_size_m = 30;
+  params.min_fill_fraction = 0.25;
+  SubmapSizer sizer(params);
+
+  // below a quarter of all budgets, so it grows up to the max size
+  sizer.Add(100, 0, 10);
+  EXPECT_FALSE(sizer.StartNewSubmap(15, 10));
+  EXPECT_TRUE(sizer.StartNewSubmap(30, 10));
+
+  // one budget is filled enough
+  sizer.Add(0, 0, 20);
+  EXPECT_TRUE(sizer.StartNewSubmap(15, 10));
+}
+
+TEST(SubmapSizer, Json) {
+  SubmapSizer::Params params;
+  params.enabled = true;
+  params.max_keyframes = 50;
+  SubmapSizer::Params loaded;
+  loaded.LoadFromJson(params.ToJson());
+  EXPECT_TRUE(loaded.enabled);
+  EXPECT_EQ(loaded.max_keyframes, 50u);
+  EXPECT_THROW(loaded.LoadFromJson(
+                   {{"min_submap_size_m", 10}, {"max_submap_size_m", 5}}),
+               std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
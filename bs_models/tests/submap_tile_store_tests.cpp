@@ -0,0 +1,107 @@
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/extrinsics_lookup_base.h>
+#include <bs_models/global_mapping/submap_tile_store.h>
+
+using namespace bs_models::global_mapping;
+
+class SubmapTileStoreTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::string current_file = "submap_tile_store_tests.cpp";
+    std::string test_path = __FILE__;
+    test_path.erase(test_path.end() - current_file.size(), test_path.end());
+    extrinsics_ = std::make_shared<bs_common::ExtrinsicsLookupBase>(
+        test_path + "data/frame_ids.json", test_path + "data/extrinsics.json");
+    directory_ =
+        "/tmp/bs_models_tile_store_test_" + std::to_string(getpid());
+    std::filesystem::create_directory(directory_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  SubmapTileStore::Params StoreParams(const std::string& robot_name) const {
+    SubmapTileStore::Params params;
+    params.enabled = true;
+    params.directory = directory_;
+    params.robot_name = robot_name;
+    return params;
+  }
+
+  /** submap with 2 scans of 100 points */
+  SubmapPtr MakeSubmap(double x, int seed) const {
+    Eigen::Matrix4d T_WORLD_SUBMAP = Eigen::Matrix4d::Identity();
+    T_WORLD_SUBMAP(0, 3) = x;
+    ros::Time stamp(1 + seed);
+    auto submap = std::make_shared<Submap>(stamp, T_WORLD_SUBMAP, nullptr,
+                                           extrinsics_);
+    for (int s = 0; s < 2; s++) {
+      PointCloud cloud;
+      for (int p = 0; p < 100; p++) {
+        cloud.push_back(pcl::PointXYZ(p * 0.01, seed, s));
+      }
+      submap->AddLidarMeasurement(cloud, T_WORLD_SUBMAP, stamp);
+      stamp += ros::Duration(0.1);
+    }
+    return submap;
+  }
+
+  std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_;
+  std::string directory_;
+};
+
+TEST_F(SubmapTileStoreTest, PushRefreshFetch) {
+  SubmapTileStore robot_a(StoreParams("robot_a"));
+  SubmapTileStore robot_b(StoreParams("robot_b"));
+  ASSERT_TRUE(robot_a.Push(0, MakeSubmap(0, 1)));
+  ASSERT_TRUE(robot_a.Push(1, MakeSubmap(50, 2)));
+  ASSERT_TRUE(robot_b.Push(0, MakeSubmap(5, 3)));
+  EXPECT_EQ(robot_a.Size(), 2u);
+
+  // own tiles are already indexed, the others are picked up by a refresh
+  EXPECT_EQ(robot_a.Refresh().size(), 1u);
+  EXPECT_EQ(robot_a.Size(), 3u);
+  EXPECT_TRUE(robot_a.Refresh().empty());
+  EXPECT_EQ(robot_a.Nearby(Eigen::Vector3d::Zero(), 10).size(), 2u);
+  const auto nearby =
+      robot_a.Nearby(Eigen::Vector3d::Zero(), 10, "robot_b");
+  ASSERT_EQ(nearby.size(), 1u);
+
+  // the server indexes all tiles, and reads the calibration of each robot
+  SubmapTileStore server(StoreParams(""));
+  EXPECT_EQ(server.Refresh().size(), 3u);
+  const auto tiles = server.Nearby(Eigen::Vector3d(5, 0, 0), 1);
+  ASSERT_EQ(tiles.size(), 1u);
+  const SubmapTileStore::Tile tile = server.GetTile(tiles.front());
+  EXPECT_EQ(tile.robot_name, "robot_b");
+  EXPECT_EQ(tile.submap_id, 0);
+  EXPECT_EQ(tile.stamp, ros::Time(4));
+
+  const SubmapPtr submap = server.Fetch(tiles.front());
+  ASSERT_TRUE(submap);
+  EXPECT_NEAR(submap->T_WORLD_SUBMAP()(0, 3), 5, 1e-9);
+  ASSERT_EQ(submap->LidarKeyframes().size(), 2u);
+  const auto& cloud = submap->LidarKeyframes().begin()->second.Cloud();
+  ASSERT_EQ(cloud.size(), 100u);
+  EXPECT_FLOAT_EQ(cloud.at(0).y, 3);
+  EXPECT_FALSE(server.Push(1, submap));
+}
+
+TEST_F(SubmapTileStoreTest, InvalidParams) {
+  SubmapTileStore::Params params = StoreParams("robot_a");
+  params.directory = directory_ + "/missing";
+  EXPECT_THROW(SubmapTileStore{params}, std::invalid_argument);
+
+  nlohmann::json J{{"robot_name", "a/b"}};
+  EXPECT_THROW(params.LoadFromJson(J), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
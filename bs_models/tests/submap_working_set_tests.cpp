@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bs_common/extrinsics_lookup_base.h>
+#include <bs_models/global_mapping/map_store.h>
+#include <bs_models/global_mapping/submap_working_set.h>
+
+using namespace bs_models::global_mapping;
+
+class SubmapWorkingSetTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::string current_file = "submap_working_set_tests.cpp";
+    std::string test_path = __FILE__;
+    test_path.erase(test_path.end() - current_file.size(), test_path.end());
+    extrinsics_ = std::make_shared<bs_common::ExtrinsicsLookupBase>(
+        test_path + "data/frame_ids.json", test_path + "data/extrinsics.json");
+    store_path_ = "/tmp/bs_models_working_set_test_" +
+                  std::to_string(getpid()) + ".bin";
+
+    // submaps with 3 scans of 1000 points each
+    bs_common::ChunkFileWriter writer;
+    ASSERT_TRUE(writer.Open(store_path_, kMapStoreVersion));
+    ros::Time stamp(1);
+    for (uint16_t i = 0; i < num_submaps_; i++) {
+      Eigen::Matrix4d T_WORLD_SUBMAP = Eigen::Matrix4d::Identity();
+      T_WORLD_SUBMAP(0, 3) = 10 * i;
+      Submap submap(stamp, T_WORLD_SUBMAP, nullptr, extrinsics_);
+      for (int s = 0; s < 3; s++) {
+        PointCloud cloud;
+        for (int p = 0; p < 1000; p++) {
+          cloud.push_back(pcl::PointXYZ(p * 0.01, i, s));
+        }
+        submap.AddLidarMeasurement(cloud, T_WORLD_SUBMAP, stamp);
+        stamp += ros::Duration(1);
+      }
+      ASSERT_TRUE(submap.SaveData(writer, i));
+    }
+    ASSERT_TRUE(writer.Close());
+
+    map_store_ = std::make_shared<bs_common::ChunkFileReader>();
+    ASSERT_TRUE(map_store_->Open(store_path_));
+    for (uint16_t i = 0; i < num_submaps_; i++) {
+      submaps_.push_back(std::make_shared<Submap>(
+          ros::Time(0), Eigen::Matrix4d::Identity(), nullptr, extrinsics_));
+      ASSERT_TRUE(submaps_.back()->LoadData(*map_store_, i, false));
+    }
+  }
+
+  void TearDown() override {
+    map_store_->Close();
+    std::remove(store_path_.c_str());
+  }
+
+  bool IsLoaded(size_t id) const {
+    return !submaps_.at(id)->LidarKeyframes().begin()->second.Cloud().empty();
+  }
+
+  const uint16_t num_submaps_{5};
+  std::shared_ptr<bs_common::ExtrinsicsLookupBase> extrinsics_;
+  std::string store_path_;
+  std::shared_ptr<bs_common::ChunkFileReader> map_store_;
+  std::vector<SubmapPtr> submaps_;
+};
+
+TEST_F(SubmapWorkingSetTest, LoadPosesOnly) {
+  for (uint16_t i = 0; i < num_submaps_; i++) {
+    EXPECT_EQ(submaps_.at(i)->LidarKeyframes().size(), 3u);
+    EXPECT_FALSE(IsLoaded(i));
+    EXPECT_FALSE(submaps_.at(i)->HasCameraData());
+    EXPECT_NEAR(submaps_.at(i)->T_WORLD_SUBMAP()(0, 3), 10 * i, 1e-9);
+  }
+}
+
+TEST_F(SubmapWorkingSetTest, Budget) {
+  SubmapWorkingSet probe(submaps_, map_store_, 0);
+  const size_t submap_memory = probe.SubmapMemory(0);
+  EXPECT_GT(submap_memory, 3 * 1000 * sizeof(pcl::PointXYZ));
+
+  // room for two submaps
+  SubmapWorkingSet working_set(submaps_, map_store_, 2 * submap_memory + 1);
+  {
+    auto lease = working_set.Acquire({0, 1});
+    EXPECT_TRUE(lease.Valid());
+    EXPECT_TRUE(IsLoaded(0));
+    EXPECT_TRUE(IsLoaded(1));
+    const auto& cloud =
+        submaps_.at(1)->LidarKeyframes().begin()->second.Cloud();
+    EXPECT_EQ(cloud.size(), 1000u);
+    EXPECT_FLOAT_EQ(cloud.at(0).y, 1);
+  }
+  EXPECT_EQ(working_set.NumLoaded(), 2u);
+
+  // the least recently used submap is released
+  { auto lease = working_set.Acquire({1}); }
+  { auto lease = working_set.Acquire({2}); }
+  EXPECT_FALSE(IsLoaded(0));
+  EXPECT_TRUE(IsLoaded(1));
+  EXPECT_TRUE(IsLoaded(2));
+
+  // leased submaps are kept even when over budget
+  {
+    auto lease = working_set.Acquire({2, 3, 4});
+    EXPECT_EQ(working_set.NumLoaded(), 3u);
+    EXPECT_GT(working_set.MemoryUsage(), working_set.MemoryBudget());
+  }
+  EXPECT_LE(working_set.MemoryUsage(), working_set.MemoryBudget());
+
+  working_set.ReleaseAll();
+  EXPECT_EQ(working_set.NumLoaded(), 0u);
+  for (uint16_t i = 0; i < num_submaps_; i++) { EXPECT_FALSE(IsLoaded(i)); }
+}
+
+TEST_F(SubmapWorkingSetTest, Partition) {
+  SubmapWorkingSet probe(submaps_, map_store_, 0);
+  const size_t submap_memory = probe.SubmapMemory(0);
+  SubmapWorkingSet working_set(submaps_, map_store_, 2 * submap_memory + 1);
+
+  const auto groups = working_set.Partition();
+  ASSERT_EQ(groups.size(), 3u);
+  EXPECT_EQ(groups.at(0), std::vector<size_t>({0, 1}));
+  EXPECT_EQ(groups.at(2), std::vector<size_t>({4}));
+
+  // overlapping groups always progress, even if they do not fit
+  const auto overlapping = probe.Partition(1);
+  ASSERT_EQ(overlapping.size(), 4u);
+  EXPECT_EQ(overlapping.at(0), std::vector<size_t>({0, 1}));
+  EXPECT_EQ(overlapping.at(3), std::vector<size_t>({3, 4}));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
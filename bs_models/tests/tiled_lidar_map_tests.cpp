@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/global_mapping/tiled_lidar_map.h>
+
+using namespace bs_models::global_mapping;
+
+namespace {
+
+// points on a 0.1 m grid filling [0, size) along x and y
+PointCloud CreateFloor(double size) {
+  PointCloud cloud;
+  for (double x = 0.05; x < size; x += 0.1) {
+    for (double y = 0.05; y < size; y += 0.1) {
+      cloud.push_back(pcl::PointXYZ(x, y, 0.5));
+    }
+  }
+  return cloud;
+}
+
+Eigen::Matrix4d Translation(double x, double y) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T(0, 3) = x;
+  T(1, 3) = y;
+  return T;
+}
+
+TiledLidarMap::Params CreateParams() {
+  TiledLidarMap::Params params;
+  params.enabled = true;
+  params.tile_size_m = 10;
+  params.voxel_size_m = 0.2;
+  params.num_levels = 3;
+  params.lod_distance_m = 10;
+  return params;
+}
+
+} // namespace
+
+TEST(TiledLidarMap, Levels) {
+  TiledLidarMap map(CreateParams());
+  map.SetSubmap(0, CreateFloor(20), Eigen::Matrix4d::Identity());
+  EXPECT_EQ(map.NumTiles(), 4u);
+
+  // close tiles are at the finest level, far ones are coarser
+  TiledLidarMap::TileVersions sent;
+  auto tiles = map.GetTiles(Eigen::Vector3d(5, 5, 0), sent);
+  ASSERT_EQ(tiles.size(), 4u);
+  std::map<TiledLidarMap::TileKey, TiledLidarMap::Tile> by_key;
+  for (const auto& tile : tiles) { by_key.emplace(tile.key, tile); }
+  const auto& near = by_key.at({0, 0, 0});
+  const auto& far = by_key.at({1, 1, 0});
+  EXPECT_EQ(near.level, 0);
+  EXPECT_EQ(far.level, 1);
+  EXPECT_GT(near.points.size(), far.points.size());
+
+  // nothing changed, nothing to send
+  EXPECT_TRUE(map.GetTiles(Eigen::Vector3d(5, 5, 0), sent).empty());
+
+  // moving the viewpoint only resends the tiles which change level
+  tiles = map.GetTiles(Eigen::Vector3d(15, 15, 0), sent);
+  ASSERT_EQ(tiles.size(), 2u);
+  for (const auto& tile : tiles) {
+    EXPECT_TRUE((tile.key == TiledLidarMap::TileKey{0, 0, 0}) ||
+                (tile.key == TiledLidarMap::TileKey{1, 1, 0}));
+  }
+}
+
+TEST(TiledLidarMap, SubmapUpdates) {
+  TiledLidarMap map(CreateParams());
+  EXPECT_FALSE(map.UpdateSubmapPose(0, Eigen::Matrix4d::Identity()));
+  map.SetSubmap(0, CreateFloor(10), Eigen::Matrix4d::Identity());
+  map.SetSubmap(1, CreateFloor(10), Translation(20, 0));
+  EXPECT_TRUE(map.HasSubmap(1));
+
+  TiledLidarMap::TileVersions sent;
+  EXPECT_EQ(map.GetTiles(Eigen::Vector3d::Zero(), sent).size(), 2u);
+
+  // small moves are ignored
+  EXPECT_TRUE(map.UpdateSubmapPose(1, Translation(20.01, 0)));
+  EXPECT_TRUE(map.GetTiles(Eigen::Vector3d::Zero(), sent).empty());
+
+  // moving submap 1 empties its tile and fills a new one, submap 0 is not
+  // resent
+  EXPECT_TRUE(map.UpdateSubmapPose(1, Translation(40, 0)));
+  auto tiles = map.GetTiles(Eigen::Vector3d::Zero(), sent);
+  ASSERT_EQ(tiles.size(), 2u);
+  std::map<TiledLidarMap::TileKey, TiledLidarMap::Tile> by_key;
+  for (const auto& tile : tiles) { by_key.emplace(tile.key, tile); }
+  EXPECT_TRUE(by_key.at({2, 0, 0}).points.empty());
+  EXPECT_FALSE(by_key.at({4, 0, 0}).points.empty());
+  EXPECT_GT(by_key.at({4, 0, 0}).version, by_key.at({2, 0, 0}).version);
+
+  // a new client does not get the emptied tile
+  TiledLidarMap::TileVersions new_client;
+  EXPECT_EQ(map.GetTiles(Eigen::Vector3d::Zero(), new_client).size(), 2u);
+  EXPECT_EQ(new_client.count({2, 0, 0}), 0u);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
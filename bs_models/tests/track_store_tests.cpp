@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/vision/track_store.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+void AddFrame(TrackStore& store, double time,
+              const std::vector<uint64_t>& ids) {
+  std::vector<Eigen::Vector2d, beam::AlignVec2d> pixels;
+  for (const uint64_t id : ids) { pixels.emplace_back(id, time); }
+  store.AddFrame(ros::Time(time), ids, pixels);
+}
+
+} // namespace
+
+TEST(TrackStore, Tracks) {
+  TrackStore store;
+  AddFrame(store, 1, {1, 2});
+  AddFrame(store, 2, {2, 3});
+  AddFrame(store, 3, {1, 2, 3});
+  EXPECT_EQ(store.NumFrames(), 3);
+  EXPECT_EQ(store.NumLandmarks(), 3);
+
+  const auto& track = store.GetTrack(2);
+  ASSERT_EQ(track.size(), 3);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(track[i].stamp, ros::Time(i + 1));
+    EXPECT_EQ(track[i].pixel, Eigen::Vector2d(2, i + 1));
+  }
+  EXPECT_EQ(store.GetTrack(1).size(), 2);
+  EXPECT_TRUE(store.GetTrack(4).empty());
+
+  ASSERT_TRUE(store.GetPixel(ros::Time(2), 3));
+  EXPECT_EQ(store.GetPixel(ros::Time(2), 3).value(), Eigen::Vector2d(3, 2));
+  EXPECT_FALSE(store.GetPixel(ros::Time(2), 1));
+  EXPECT_FALSE(store.GetPixel(ros::Time(4), 1));
+  EXPECT_FALSE(store.GetPixel(ros::Time(1), 4));
+}
+
+TEST(TrackStore, OutOfOrderFrames) {
+  TrackStore store;
+  AddFrame(store, 2, {1});
+  std::vector<Eigen::Vector2d, beam::AlignVec2d> pixels{
+      Eigen::Vector2d(0, 0)};
+  EXPECT_FALSE(store.AddFrame(ros::Time(1), {1}, pixels));
+  EXPECT_FALSE(store.AddFrame(ros::Time(2), {1}, pixels));
+  EXPECT_EQ(store.NumFrames(), 1);
+  EXPECT_EQ(store.GetTrack(1).size(), 1);
+}
+
+TEST(TrackStore, Compaction) {
+  TrackStore store;
+  AddFrame(store, 1, {1, 2});
+  AddFrame(store, 2, {2, 3});
+  AddFrame(store, 3, {2, 3});
+
+  store.RemoveBefore(ros::Time(2));
+  EXPECT_EQ(store.NumFrames(), 2);
+  EXPECT_EQ(store.NumLandmarks(), 2);
+  EXPECT_TRUE(store.GetTrack(1).empty());
+  ASSERT_EQ(store.GetTrack(2).size(), 2);
+  EXPECT_EQ(store.GetTrack(2).front().stamp, ros::Time(2));
+
+  store.RemoveBefore(ros::Time(10));
+  EXPECT_EQ(store.NumFrames(), 0);
+  EXPECT_EQ(store.NumLandmarks(), 0);
+
+  // frames can be added again after compacting
+  AddFrame(store, 11, {1});
+  EXPECT_EQ(store.GetTrack(1).size(), 1);
+  store.Clear();
+  EXPECT_EQ(store.NumFrames(), 0);
+  EXPECT_EQ(store.NumLandmarks(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <bs_models/vision/camera_measurement_view.h>
+#include <bs_models/vision/vo_checkpoint.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+std::string TmpPath(const std::string& name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+bs_common::CameraMeasurementMsg MakeMessage(double time,
+                                            const std::vector<uint64_t>& ids,
+                                            bool packed) {
+  bs_common::CameraMeasurementMsg msg;
+  msg.header.stamp = ros::Time(time);
+  msg.header.seq = static_cast<uint32_t>(time);
+  msg.descriptor_type = "ORB";
+  msg.image.height = 2;
+  msg.image.width = 3;
+  msg.image.encoding = "mono8";
+  msg.image.step = 3;
+  msg.image.data = {1, 2, 3, 4, 5, 6};
+
+  std::vector<cv::Mat> descriptors;
+  std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+      pixels;
+  for (const uint64_t id : ids) {
+    descriptors.push_back(cv::Mat(1, 32, CV_8U, cv::Scalar(id)));
+    pixels.emplace_back(id + 0.5, time);
+  }
+  PackLandmarkMeasurements(ids, descriptors, pixels, msg);
+  if (packed) { return msg; }
+
+  // per landmark layout
+  const CameraMeasurementView view(msg);
+  bs_common::CameraMeasurementMsg unpacked = msg;
+  unpacked.packed = false;
+  unpacked.landmark_ids.clear();
+  unpacked.pixels_u.clear();
+  unpacked.pixels_v.clear();
+  unpacked.descriptors.clear();
+  for (size_t i = 0; i < view.Size(); i++) {
+    bs_common::LandmarkMeasurementMsg landmark;
+    landmark.landmark_id = view.LandmarkId(i);
+    landmark.pixel_u = view.Pixel(i)[0];
+    landmark.pixel_v = view.Pixel(i)[1];
+    landmark.descriptor.data.assign(32, view.LandmarkId(i));
+    landmark.descriptor.descriptor_type = "ORB";
+    unpacked.landmarks.push_back(landmark);
+  }
+  return unpacked;
+}
+
+VOCheckpoint MakeCheckpoint() {
+  VOCheckpoint checkpoint;
+  VOCheckpoint::KeyframeState keyframe;
+  keyframe.msg = MakeMessage(1, {1, 2, 3}, true);
+  keyframe.T_WORLD_BASELINK(0, 3) = 1;
+  checkpoint.keyframes.push_back(keyframe);
+  keyframe.msg = MakeMessage(2, {2, 3, 4}, true);
+  keyframe.T_WORLD_BASELINK(1, 3) = 2;
+  checkpoint.keyframes.push_back(keyframe);
+  for (uint64_t id = 1; id <= 4; id++) {
+    checkpoint.landmarks.push_back({id, Eigen::Vector3d(id, 0, 5),
+                                    Eigen::Vector3d(0, 0, 1), 10 * id});
+  }
+  return checkpoint;
+}
+
+} // namespace
+
+TEST(VOCheckpoint, RoundTrip) {
+  const std::string path = TmpPath("vo_checkpoint_round_trip.bin");
+  VOCheckpoint checkpoint = MakeCheckpoint();
+  ASSERT_TRUE(checkpoint.Save(path));
+  EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+  VOCheckpoint loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.Stamp(), ros::Time(2));
+  ASSERT_EQ(loaded.keyframes.size(), 2);
+  for (size_t k = 0; k < 2; k++) {
+    const auto& expected = checkpoint.keyframes[k];
+    const auto& keyframe = loaded.keyframes[k];
+    EXPECT_TRUE(keyframe.T_WORLD_BASELINK.isApprox(expected.T_WORLD_BASELINK));
+    EXPECT_EQ(keyframe.msg.header.stamp, expected.msg.header.stamp);
+    EXPECT_EQ(keyframe.msg.header.seq, expected.msg.header.seq);
+    EXPECT_EQ(keyframe.msg.descriptor_type, "ORB");
+    EXPECT_EQ(keyframe.msg.image.encoding, "mono8");
+    EXPECT_EQ(keyframe.msg.image.data, expected.msg.image.data);
+    EXPECT_EQ(keyframe.msg.landmark_ids, expected.msg.landmark_ids);
+    EXPECT_EQ(keyframe.msg.pixels_u, expected.msg.pixels_u);
+    EXPECT_EQ(keyframe.msg.descriptors, expected.msg.descriptors);
+  }
+  ASSERT_EQ(loaded.landmarks.size(), 4);
+  EXPECT_EQ(loaded.landmarks[2].id, 3);
+  EXPECT_EQ(loaded.landmarks[2].position, Eigen::Vector3d(3, 0, 5));
+  EXPECT_EQ(loaded.landmarks[2].word_id, 30);
+  std::remove(path.c_str());
+}
+
+TEST(VOCheckpoint, UnpackedMeasurements) {
+  const std::string path = TmpPath("vo_checkpoint_unpacked.bin");
+  VOCheckpoint checkpoint;
+  VOCheckpoint::KeyframeState keyframe;
+  keyframe.msg = MakeMessage(1, {5, 6}, false);
+  checkpoint.keyframes.push_back(keyframe);
+  ASSERT_TRUE(checkpoint.Save(path));
+
+  // measurements are loaded packed
+  VOCheckpoint loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  ASSERT_EQ(loaded.keyframes.size(), 1);
+  const auto& msg = loaded.keyframes[0].msg;
+  EXPECT_TRUE(msg.packed);
+  const CameraMeasurementView view(msg);
+  ASSERT_EQ(view.Size(), 2);
+  EXPECT_EQ(view.LandmarkId(1), 6);
+  EXPECT_EQ(view.Pixel(1), Eigen::Vector2d(6.5, 1));
+  EXPECT_EQ(view.Descriptor(1).total() * view.Descriptor(1).elemSize(), 32);
+  std::remove(path.c_str());
+}
+
+TEST(VOCheckpoint, MarkRestoredLandmarks) {
+  VOCheckpoint checkpoint = MakeCheckpoint();
+  const uint64_t rig_id = CameraRig::GlobalLandmarkId(2, 7);
+  checkpoint.landmarks.push_back(
+      {rig_id, Eigen::Vector3d::Zero(), Eigen::Vector3d::UnitZ(), 0});
+  checkpoint.MarkRestoredLandmarks();
+
+  EXPECT_EQ(checkpoint.landmarks[0].id,
+            1 | VOCheckpoint::RESTORED_LANDMARK_FLAG);
+  EXPECT_EQ(CameraRig::SensorId(checkpoint.landmarks.back().id), 2);
+  for (const auto& keyframe : checkpoint.keyframes) {
+    for (const uint64_t id : keyframe.msg.landmark_ids) {
+      EXPECT_TRUE(id & VOCheckpoint::RESTORED_LANDMARK_FLAG);
+    }
+  }
+}
+
+TEST(VOCheckpoint, InvalidFile) {
+  VOCheckpoint checkpoint;
+  EXPECT_FALSE(checkpoint.Load(TmpPath("vo_checkpoint_missing.bin")));
+
+  const std::string path = TmpPath("vo_checkpoint_invalid.bin");
+  std::ofstream(path) << "not a checkpoint";
+  EXPECT_FALSE(checkpoint.Load(path));
+  EXPECT_TRUE(checkpoint.keyframes.empty());
+  std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include <bs_models/vision/vo_localization_validation.h>
+
+using namespace bs_models::vision;
+
+namespace {
+
+Eigen::Matrix4d Motion(double t) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T(0, 3) = t;
+  return T;
+}
+
+Eigen::Matrix<double, 6, 6> Covariance(double variance) {
+  return variance * Eigen::Matrix<double, 6, 6>::Identity();
+}
+
+} // namespace
+
+TEST(VOLocalizationValidation, InitialThresholds) {
+  VOLocalizationValidation validator;
+  EXPECT_TRUE(validator.Validate(Motion(0.01), Covariance(1e-4), 1.0));
+  EXPECT_FALSE(validator.Validate(Motion(1.0), Covariance(1e-4), 1.0));
+  EXPECT_FALSE(validator.Validate(Motion(0.01), Covariance(1.0), 1.0));
+}
+
+TEST(VOLocalizationValidation, StoredMetrics) {
+  VOLocalizationValidation validator;
+  for (int i = 0; i < 100; i++) {
+    const double noise = 0.001 * (i % 5);
+    EXPECT_TRUE(validator.Validate(Motion(0.02 + noise),
+                                   Covariance(1e-4 * (1 + noise)),
+                                   1.0 + noise));
+  }
+
+  // a spike in motion is an outlier
+  EXPECT_FALSE(validator.Validate(Motion(0.2), Covariance(1e-4), 1.0));
+
+  // the window recovers after the outliers have left it
+  for (int i = 0; i < 30; i++) {
+    const double noise = 0.001 * (i % 5);
+    validator.Validate(Motion(0.02 + noise), Covariance(1e-4 * (1 + noise)),
+                       1.0 + noise);
+  }
+  EXPECT_TRUE(validator.Validate(Motion(0.022), Covariance(1.002e-4), 1.002));
+
+  // back to the initial thresholds
+  validator.Clear();
+  EXPECT_TRUE(validator.Validate(Motion(0.2), Covariance(1e-4), 1.0));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -35,21 +35,37 @@
 #define BS_OPTIMIZERS_FIXED_LAG_SMOOTHER_H
 
 #include <bs_common/imu_state.h>
+#include <bs_common/sampling_profiler.h>
+#include <bs_common/task_scheduler.h>
+#include <bs_optimizers/graph_snapshot_builder.h>
+#include <bs_optimizers/incremental_problem.h>
+#include <bs_optimizers/lag_window_policy.h>
+#include <bs_optimizers/marginalization_index.h>
+#include <bs_optimizers/mpsc_queue.h>
+#include <bs_optimizers/online_calibration_manager.h>
+#include <bs_optimizers/parallel_graph_operations.h>
+#include <bs_optimizers/remote_smoother_transport.h>
 #include <fuse_core/graph.h>
 #include <fuse_core/transaction.h>
 #include <fuse_optimizers/fixed_lag_smoother_params.h>
 #include <fuse_optimizers/optimizer.h>
-#include <fuse_optimizers/variable_stamp_index.h>
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
+#include <std_srvs/SetBool.h>
+#include <std_srvs/Trigger.h>
+#include <std_msgs/Bool.h>
 #include <std_msgs/Empty.h>
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 using namespace fuse_optimizers;
@@ -85,6 +101,15 @@ namespace bs_optimizers {
  * Parameters:
  *  - lag_duration (float, default: 5.0) The duration of the smoothing window in
  * seconds
+ *  - window_policy (string, default: FIXED) How the start of the window is
+ * chosen. FIXED keeps the full lag_duration. INFORMATION keeps at least
+ * window/min_lag_duration (float, default: 1.0) seconds, then marginalizes
+ * early from the first redundant state, which moved less than
+ * window/min_translation (float, default: 0.05) metres and
+ * window/min_rotation_deg (float, default: 2.0) degrees combined, or once the
+ * motion kept exceeds window/information_budget (float, default: 0, disabled)
+ * in units of these thresholds, or window/max_states (int, default: 0,
+ * disabled) states. See bs_optimizers::InformationLagWindowPolicy
  *  - motion_models (struct array) The set of motion model plugins to load
  *    @code{.yaml}
  *    - name: string  (A unique name for this motion model)
@@ -115,6 +140,91 @@ namespace bs_optimizers {
  * processes sequentially, so no new transactions will be added to the graph
  * while waiting for motion models to be generated. Once the timeout expires,
  * that transaction will be deleted from the queue.
+ *  - use_graph_snapshots (bool, default: false) If true, the graph sent to all
+ * sensor models and publishers is a bs_common::GraphSnapshot which shares all
+ * unchanged variables and constraints with the previous snapshot instead of a
+ * deep copy of the full graph. The snapshot also contains the GraphDelta
+ * w.r.t. the previous update.
+ *  - parallel_marginalization (bool, default: false) If true, the constraints
+ * of the marginalized variables are linearized in parallel on the
+ * bs_common::TaskScheduler, see bs_optimizers::ParallelMarginalizeVariables.
+ * Not used with pseudo_marginalization.
+ *  - parallel_graph_clone (bool, default: false) If true, the graph copy sent
+ * to all sensor models and publishers is cloned in parallel on the
+ * bs_common::TaskScheduler. Not used with use_graph_snapshots.
+ *  - incremental_problem (bool, default: false) If true, the ceres problem is
+ * kept between optimization cycles and only the added and removed variables
+ * and constraints are applied to it, instead of rebuilding the full problem
+ * from the graph every cycle.
+ *  - landmark_ordering (bool, default: false) If true, an elimination ordering
+ * is built every cycle with all landmark variables
+ * (bs_variables::Point3DLandmark and bs_variables::InverseDepthLandmark) in
+ * the first group and all other variables in the second, and the linear
+ * solver is switched to SPARSE_SCHUR unless a schur based solver is already
+ * configured.
+ *  - realtime_mode (bool, default: false) If true, the solver time of each
+ * cycle is limited to the time left before the optimization deadline, and the
+ * max number of iterations is limited using the average time per iteration
+ * of the last realtime_num_cycles (int, default: 10) cycles. The configured
+ * solver options are used as upper bounds.
+ *  - backpressure_cycles (int, default: 3) Number of consecutive cycles that
+ * must exceed the deadline (or have more than backpressure_max_pending (int,
+ * default: 10) pending transactions) before back-pressure is turned on, and
+ * the number of consecutive cycles on time before it is turned off again.
+ * The back-pressure state is published (latched) as a std_msgs::Bool on the
+ * private topic "backpressure", sensor models should reduce their keyframe
+ * rate while it is true. Set to 0 to disable.
+ *  - external_trigger (bool, default: false) If true, optimizations are not
+ * triggered by a timer and optimizeOnce() must be called instead. This is used
+ * to run the smoother in lock-step with an offline replay.
+ *  - memory_budgets_mb (struct, default: empty) Budgets in MB of the
+ * bs_common::MemoryAccounting accounts in this process, nested names are
+ * joined with "/", e.g. {lidar_odometry: {active_clouds: 500}}. Components
+ * over budget drop their oldest data. The memory of all accounts is reported
+ * in the diagnostics.
+ *  - wait_for_resources (list of strings, default: empty) Resources loaded in
+ * the background by the plugins (e.g. "visual_odometry/vocabulary", see
+ * bs_common::StartupProfiler) which must be ready before the optimizer
+ * starts. Waits at most resource_wait_timeout (double, default: 60) seconds,
+ * or forever if negative.
+ *  - task_scheduler/num_threads (int, default: 0) Number of workers of the
+ * bs_common::TaskScheduler shared by all plugins of this process, 0 uses one
+ * per core. At most task_scheduler/max_background_threads (int, default: 0,
+ * half of the workers) run background tasks (e.g. loop closures) at once, so
+ * real-time tasks (e.g. scan registration) never wait for them. The workers
+ * are pinned to task_scheduler/cores (list of ints, default: empty, not
+ * pinned), round robin.
+ *  - optimization_thread_cores (list of ints, default: empty) Cores the
+ * optimization thread is pinned to, not pinned if empty.
+ *  - low_priority_sensors (list of strings, default: empty) Sensor models
+ * whose transactions (e.g. loop closures) are applied in a separate lane so
+ * they never delay the odometry. Regular cycles only apply the other
+ * transactions. Every low_priority_period (float, default: 1.0) seconds, a
+ * regular cycle is immediately followed by a low priority cycle which applies
+ * the low priority transactions only, with a deadline of low_priority_budget
+ * (float, default: 0.5) seconds for realtime_mode.
+ *  - online_calibration/enabled (bool, default: false) If true, extrinsics
+ * variables estimated online are held constant once they converged and freed
+ * again when they drift, see bs_optimizers::OnlineCalibrationManager for the
+ * other parameters in online_calibration/ (convergence_cycles,
+ * max_translation_change, max_rotation_change_deg, max_translation_std,
+ * max_rotation_std_deg, probe_period, probe_cycles, drift_translation and
+ * drift_rotation_deg).
+ *  - fast_reset (bool, default: false) If true, resets keep the resources
+ * loaded by the plugins and the allocated structures of the optimizer, see
+ * bs_common::ResetContext. The newest state of the last successful cycle is
+ * offered to the ignition sensor to re-ignite from, with its biases reset in
+ * case they diverged. A reset less than fast_reset_min_period (float,
+ * default: 5.0) seconds after a fast reset is a full reset, so a state that
+ * keeps failing is not restored again.
+ *  - remote_transport/enabled (bool, default: false) If true, the sensor
+ * models run in another process (see bs_optimizers::RemoteSmootherProxy) and
+ * exchange transactions and graph updates with this one through shared memory
+ * rings named after remote_transport/name (string, default: beam_slam) of
+ * remote_transport/ring_size_mb (int, default: 64) MB each. Graph updates are
+ * sent as diffs of the previous one. The sensor models are not loaded in
+ * this process, the ignition sensors are those of the remote process, and
+ * resets are forwarded to it, see bs_optimizers::RemoteSmootherServer.
  */
 class FixedLagSmoother : public Optimizer {
 public:
@@ -140,6 +250,15 @@ public:
    */
   virtual ~FixedLagSmoother();
 
+  /**
+   * @brief Trigger an optimization cycle if there are pending transactions
+   * and block until it completes. This is meant to be used with
+   * external_trigger set to true.
+   * @param[in] optimization_deadline The deadline for the optimization to
+   * complete
+   */
+  void optimizeOnce(const ros::Time& optimization_deadline);
+
 protected:
   /**
    * Structure containing the information required to process a transaction
@@ -148,6 +267,7 @@ protected:
   struct TransactionQueueElement {
     std::string sensor_name;
     fuse_core::Transaction::SharedPtr transaction;
+    ros::WallTime receive_time; //!< For the latency trace
 
     const ros::Time& stamp() const { return transaction->stamp(); }
     const ros::Time& minStamp() const { return transaction->minStamp(); }
@@ -172,6 +292,27 @@ protected:
                                     //!< background process
   ParameterType params_; //!< Configuration settings for this fixed-lag smoother
   bool use_pseudo_marginalization_;
+  bool use_graph_snapshots_;
+  bool use_parallel_marginalization_;
+  bool use_parallel_graph_clone_;
+  bool use_incremental_problem_;
+  bool use_landmark_ordering_;
+  bool realtime_mode_;
+  int realtime_num_cycles_;
+  int backpressure_cycles_;
+  int backpressure_max_pending_;
+  bool external_trigger_;
+  std::string latency_trace_path_;
+  bs_common::SamplingProfiler::Params profiler_params_;
+  std::string profiler_output_path_;
+  std::vector<int> optimization_thread_cores_;
+  std::unique_ptr<LagWindowPolicy> window_policy_;
+  std::unordered_set<std::string> low_priority_sensors_;
+  ros::Duration low_priority_period_;
+  ros::Duration low_priority_budget_;
+  bool fast_reset_;
+  ros::WallDuration fast_reset_min_period_;
+  RemoteTransportParams remote_params_;
 
   // Inherently thread-safe
   std::atomic<bool> ignited_; //!< Flag indicating the optimizer has received a
@@ -184,28 +325,62 @@ protected:
   std::atomic<bool> started_; //!< Flag indicating the optimizer has received a
                               //!< transaction from an ignition sensor
 
-  // Guarded by pending_transactions_mutex_
-  std::mutex pending_transactions_mutex_; //!< Synchronize modification of the
-                                          //!< pending_transactions_ container
-  TransactionQueue
-      pending_transactions_; //!< The set of received transactions that have not
-                             //!< been added to the optimizer yet. Transactions
-                             //!< are added by the main thread, and removed and
-                             //!< processed by the optimization thread.
+  MPSCQueue<TransactionQueueElement>
+      transaction_inbox_; //!< Lock-free queue of received transactions.
+                          //!< Transactions are pushed by the transaction
+                          //!< callbacks and moved to pending_transactions_ by
+                          //!< the optimization thread.
+  std::atomic<size_t> num_pending_transactions_{
+      0}; //!< Size of pending_transactions_, for the timer and diagnostics
 
   // Guarded by optimization_mutex_
   std::mutex
       optimization_mutex_; //!< Mutex held while the graph is begin optimized
   // fuse_core::Graph* graph_ member from the base class
+  TransactionQueue
+      pending_transactions_; //!< The set of received transactions that have not
+                             //!< been added to the optimizer yet, sorted by
+                             //!< stamp. Only accessed by the optimization
+                             //!< thread, and by the reset callbacks.
   ros::Time lag_expiration_; //!< The oldest stamp that is inside the fixed-lag
                              //!< smoother window
   fuse_core::Transaction marginal_transaction_; //!< The marginals to add during
                                                 //!< the next optimization cycle
-  VariableStampIndex timestamp_tracking_; //!< Object that tracks the timestamp
-                                          //!< associated with each variable
+  MarginalizationIndex
+      timestamp_tracking_; //!< Object that tracks the timestamp associated
+                           //!< with each variable and the constraints
+                           //!< connected to each variable
   ceres::Solver::Summary
       summary_; //!< Optimization summary, written by optimizationLoop and read
                 //!< by setDiagnostics
+  GraphSnapshotBuilder
+      snapshot_builder_; //!< Builds the graph snapshots sent to all plugins
+                         //!< when use_graph_snapshots_ is true
+  IncrementalProblem
+      incremental_problem_; //!< Persistent problem used to optimize the graph
+                            //!< when use_incremental_problem_ is true
+  OnlineCalibrationManager
+      calibration_manager_; //!< Holds the converged extrinsics variables
+  std::deque<std::pair<double, int>>
+      cycle_costs_; //!< Solver time and iterations of the last cycles, used
+                    //!< to limit the iterations in realtime mode
+  std::vector<std::pair<ros::Time, ros::WallTime>>
+      traced_transactions_; //!< Stamp and receive time of the transactions
+                            //!< added in this cycle, for the latency trace
+  int overrun_cycles_{0}; //!< Consecutive cycles behind schedule
+  ros::Time last_low_priority_cycle_; //!< Start of the last low priority cycle
+  bool run_low_priority_cycle_{false}; //!< Flag indicating the next cycle is
+                                       //!< a low priority one
+  int on_time_cycles_{0}; //!< Consecutive cycles on schedule
+  std::atomic<bool> backpressure_{false}; //!< Flag indicating sensor models
+                                          //!< have been asked to slow down
+  std::optional<bs_common::ImuState>
+      last_good_state_; //!< Newest state of the last successful cycle, only
+                        //!< tracked when fast_reset_ is true
+  ros::WallTime last_fast_reset_; //!< Time of the last fast reset
+  std::unique_ptr<RemoteSmootherServer>
+      remote_server_; //!< Transport to the sensor models of the remote
+                      //!< front-end, when remote_params_.enabled is true
 
   // Guarded by optimization_requested_mutex_
   std::mutex
@@ -217,6 +392,10 @@ protected:
       optimization_requested_; //!< Condition variable used by the optimization
                                //!< thread to wait until a new optimization is
                                //!< requested by the main thread
+  uint64_t completed_cycles_{0}; //!< Number of completed optimization cycles
+  std::condition_variable
+      optimization_completed_; //!< Condition variable used by optimizeOnce()
+                               //!< to wait until the cycle is done
 
   // Guarded by start_time_mutex_
   mutable std::mutex start_time_mutex_; //!< Synchronize modification to the
@@ -224,6 +403,11 @@ protected:
   ros::Time
       start_time_; //!< The timestamp of the first ignition sensor transaction
 
+  // Only accessed by setDiagnostics
+  bs_common::TaskScheduler::Stats
+      last_scheduler_stats_; //!< Scheduler stats of the last diagnostics, used
+                             //!< to report the utilization since then
+
   // Ordering ROS objects with callbacks last
   ros::Timer optimize_timer_; //!< Trigger an optimization operation at a fixed
                               //!< frequency
@@ -231,13 +415,24 @@ protected:
                                             //!< optimizer to its initial state
   ros::Subscriber reset_subscriber_;        //!< Subscriber that resets the
                                             //!< optimizer to its initial state
+  ros::ServiceServer profiler_enable_service_server_; //!< Starts or stops the
+                                                      //!< sampling profiler
+  ros::ServiceServer profiler_dump_service_server_; //!< Writes the profile
+  ros::Publisher backpressure_publisher_; //!< Publishes the back-pressure
+                                          //!< state when it changes
 
   /**
    * @brief Automatically start the smoother if no ignition sensors are
-   * specified
+   * specified. With a remote front-end, this waits until it is connected
    */
   void autostart();
 
+  /**
+   * @brief Check if a sensor model, local or of the remote front-end, is an
+   * ignition sensor
+   */
+  bool isIgnitionSensor(const std::string& sensor_name) const;
+
   /**
    * @brief Perform any required preprocessing steps before \p
    * computeVariablesToMarginalize() is called
@@ -254,10 +449,16 @@ protected:
 
   /**
    * @brief Compute the oldest timestamp that is part of the configured lag
-   * window
+   * window, using the window policy. The window start never moves back.
    */
   ros::Time computeLagExpirationTime() const;
 
+  /**
+   * @brief Get the poses of all states in the graph stamped after a time,
+   * sorted by stamp
+   */
+  WindowStates getWindowStates(const ros::Time& after) const;
+
   /**
    * @brief Compute the set of variables that should be marginalized from the
    * graph
@@ -287,6 +488,12 @@ protected:
   void postprocessMarginalization(
       const fuse_core::Transaction& marginal_transaction);
 
+  /**
+   * @brief Update the "fixed_lag_smoother/graph" memory account with the
+   * variables and constraints of the graph
+   */
+  void updateGraphMemoryAccount();
+
   /**
    * @brief Function that optimizes all constraints, designed to be run in a
    * separate thread.
@@ -323,9 +530,31 @@ protected:
    * motion model and sensor transactions
    * @param[in]  lag_expiration The oldest timestamp that should remain in the
    * graph
+   * @param[in]  low_priority Only the transactions of this priority lane are
+   * merged, see low_priority_sensors
    */
   void processQueue(fuse_core::Transaction& transaction,
-                    const ros::Time& lag_expiration);
+                    const ros::Time& lag_expiration, bool low_priority = false);
+
+  /**
+   * @brief Check if the low priority lane should run after this cycle, i.e.
+   * its period elapsed and it has pending transactions
+   */
+  bool isLowPriorityCycleDue(const ros::Time& now) const;
+
+  /**
+   * @brief Move all transactions received since the last call from the
+   * transaction inbox into the sorted pending queue. This is also where the
+   * start of the optimizer is detected, when the first transaction from an
+   * ignition sensor is received.
+   */
+  void drainTransactionInbox();
+
+  /**
+   * @brief Reset the optimizer to its original state, keeping the plugin
+   * resources if fast_reset is enabled
+   */
+  void reset();
 
   /**
    * @brief Service callback that resets the optimizer to its original state
@@ -338,6 +567,21 @@ protected:
    */
   void resetCallback(const std_msgs::Empty::ConstPtr&);
 
+  /**
+   * @brief Service callback that starts (true) or stops (false) the sampling
+   * profiler, the samples are kept when stopped
+   */
+  bool profilerEnableServiceCallback(std_srvs::SetBool::Request& req,
+                                     std_srvs::SetBool::Response& res);
+
+  /**
+   * @brief Service callback that writes the samples of the profiler as folded
+   * stacks to profiler/output_path and clears them, the path is returned in
+   * the message
+   */
+  bool profilerDumpServiceCallback(std_srvs::Trigger::Request&,
+                                   std_srvs::Trigger::Response& res);
+
   /**
    * @brief Thread-safe read-only access to the optimizer start time
    */
@@ -380,6 +624,44 @@ protected:
       diagnostic_updater::DiagnosticStatusWrapper& status) override;
 
   bs_common::ImuState GetWindowStartState();
+
+  /**
+   * @brief Get the imu state at a stamp from the graph
+   * @throw std::out_of_range if not all imu state variables exist
+   */
+  bs_common::ImuState getImuState(const ros::Time& stamp) const;
+
+  /**
+   * @brief Get the newest imu state in the graph
+   * @return state, nullopt if the newest stamp is not a full imu state
+   */
+  std::optional<bs_common::ImuState> getNewestImuState() const;
+
+  /**
+   * @brief Build an elimination ordering with all landmarks in group 0 and all
+   * other variables in group 1, so that schur based solvers eliminate the
+   * landmarks first
+   * @return ordering, or nullptr if there are no landmarks in the graph in
+   * which case ceres should compute its own ordering
+   */
+  std::shared_ptr<ceres::ParameterBlockOrdering> computeLandmarkOrdering();
+
+  /**
+   * @brief Limit the solver time and iterations so that the optimization
+   * completes before the deadline, using the cost of the last cycles
+   * @param[in] optimization_deadline deadline of the current cycle
+   * @param[in, out] solver_options options to limit
+   */
+  void applyRealtimeLimits(const ros::Time& optimization_deadline,
+                           ceres::Solver::Options& solver_options) const;
+
+  /**
+   * @brief Update the back-pressure state after each cycle and publish it if
+   * it changed
+   * @param[in] deadline_exceeded true if the cycle completed after its
+   * deadline
+   */
+  void updateBackpressure(bool deadline_exceeded);
 };
 
 } // namespace bs_optimizers
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <fuse_core/constraint.h>
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+#include <fuse_core/variable.h>
+
+#include <bs_common/graph_snapshot.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Class for building immutable graph snapshots to notify sensor models
+ * and publishers with, instead of deep copying the full graph every
+ * optimization cycle.
+ *
+ * Constraints never change once they've been added to a graph, so they only
+ * get cloned the first time they are seen and are then shared between all
+ * following snapshots. Variables are only cloned if their values have changed
+ * since the last snapshot, otherwise the copy from the last snapshot is shared.
+ * Each snapshot also stores the GraphDelta w.r.t. the previous snapshot, and
+ * the StampIndex of its pose states, which is updated with the delta.
+ */
+class GraphSnapshotBuilder {
+public:
+  GraphSnapshotBuilder() = default;
+
+  ~GraphSnapshotBuilder() = default;
+
+  /**
+   * @brief build a new snapshot of the input graph. This is not thread safe,
+   * the caller must ensure the graph is not modified during this call
+   * @param graph graph to take a snapshot of
+   * @return snapshot of the graph
+   */
+  bs_common::GraphSnapshot::ConstSharedPtr Build(const fuse_core::Graph& graph);
+
+  /**
+   * @brief clear all cached variables and constraints. The next snapshot will
+   * report all variables as added.
+   */
+  void Clear();
+
+private:
+  bool HasSameValue(const fuse_core::Variable& v1,
+                    const fuse_core::Variable& v2) const;
+
+  std::unordered_map<fuse_core::UUID, fuse_core::Variable::SharedPtr,
+                     fuse_core::uuid::hash>
+      variables_;
+  std::unordered_map<fuse_core::UUID, fuse_core::Constraint::SharedPtr,
+                     fuse_core::uuid::hash>
+      constraints_;
+  bs_common::StampIndex::ConstSharedPtr stamps_{
+      bs_common::StampIndex::make_shared()};
+};
+
+} // namespace bs_optimizers
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include <ceres/problem.h>
+#include <ceres/solver.h>
+#include <fuse_core/constraint.h>
+#include <fuse_core/graph.h>
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+#include <fuse_core/variable.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Ceres problem that persists between optimization cycles and is kept
+ * in sync with a graph, instead of rebuilding the full problem from scratch
+ * every time the graph is optimized (which is what fuse_graphs::HashGraph
+ * does).
+ *
+ * Parameter blocks point directly at the data of the variables stored in the
+ * graph, so solving this problem updates the graph in place and each solve is
+ * warm started from the last solution. After each transaction is applied to
+ * the graph, Update must be called with that same transaction so that the
+ * corresponding parameter blocks and residual blocks get added and removed.
+ *
+ * This is not thread safe, the caller must ensure the graph is not modified
+ * while calling Update or Optimize.
+ */
+class IncrementalProblem {
+public:
+  IncrementalProblem();
+
+  ~IncrementalProblem() = default;
+
+  /**
+   * @brief add and remove parameter blocks and residual blocks according to
+   * a transaction that has already been applied to the graph. Additions and
+   * removals in the transaction are checked against the graph, so anything
+   * that was rejected by the graph is ignored.
+   * @param graph graph after having applied the transaction
+   * @param transaction transaction that was applied
+   */
+  void Update(const fuse_core::Graph& graph,
+              const fuse_core::Transaction& transaction);
+
+  /**
+   * @brief solve the problem, this writes the solution to the graph variables
+   * @param options solver options
+   * @return solver summary
+   */
+  ceres::Solver::Summary Optimize(const ceres::Solver::Options& options);
+
+  /**
+   * @brief remove everything from the problem, this must be called whenever
+   * the graph is cleared
+   */
+  void Clear();
+
+  /**
+   * @brief rebuild the problem from all variables and constraints in a graph
+   */
+  void Rebuild(const fuse_core::Graph& graph);
+
+  int NumParameterBlocks() const { return problem_->NumParameterBlocks(); }
+
+  int NumResidualBlocks() const { return problem_->NumResidualBlocks(); }
+
+private:
+  void AddVariable(const fuse_core::Graph& graph,
+                   const fuse_core::Variable& variable);
+
+  void AddConstraint(const fuse_core::Graph& graph,
+                     const fuse_core::Constraint& constraint);
+
+  ceres::Problem::Options problem_options_;
+  std::unique_ptr<ceres::Problem> problem_;
+
+  // parameter block of each variable in the problem
+  std::unordered_map<fuse_core::UUID, double*, fuse_core::uuid::hash>
+      variables_;
+
+  // residual block of each constraint in the problem
+  std::unordered_map<fuse_core::UUID, ceres::ResidualBlockId,
+                     fuse_core::uuid::hash>
+      constraints_;
+};
+
+} // namespace bs_optimizers
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include <ros/time.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Pose of a stamped state in the smoother window, as used by the window
+ * policies
+ */
+struct WindowState {
+  ros::Time stamp;
+  Eigen::Vector3d position;
+  Eigen::Quaterniond orientation;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+using WindowStates =
+    std::vector<WindowState, Eigen::aligned_allocator<WindowState>>;
+
+/**
+ * @brief Decides where the window of the fixed-lag smoother starts, all
+ * variables before it are marginalized. Policies only move the start of the
+ * window: removing states from within the window would break the motion
+ * models and sensor models which still reference them.
+ */
+class LagWindowPolicy {
+public:
+  virtual ~LagWindowPolicy() = default;
+
+  /**
+   * @brief if false, LagExpiration is always called with no states and they
+   * don't need to be collected from the graph
+   */
+  virtual bool NeedsStates() const { return false; }
+
+  /**
+   * @brief Compute the oldest stamp that is inside the window
+   * @param start_time start time of the smoother, the window never starts
+   * before it
+   * @param now stamp of the most recent variable
+   * @param states poses of the window, sorted by stamp. Only given if
+   * NeedsStates() is true
+   */
+  virtual ros::Time LagExpiration(const ros::Time& start_time,
+                                  const ros::Time& now,
+                                  const WindowStates& states) const = 0;
+};
+
+/**
+ * @brief The window is always lag duration long
+ */
+class FixedLagWindowPolicy : public LagWindowPolicy {
+public:
+  explicit FixedLagWindowPolicy(const ros::Duration& lag_duration);
+
+  ros::Time LagExpiration(const ros::Time& start_time, const ros::Time& now,
+                          const WindowStates& states) const override;
+
+private:
+  ros::Duration lag_duration_;
+};
+
+/**
+ * @brief The window is sized by the information of its states. Walking back
+ * from the newest state, the window always keeps min_lag_duration and then
+ * ends before the first redundant state (stationary or low parallax), or once
+ * the information of the states kept exceeds the information budget. It is
+ * never longer than the lag duration, or than max_states.
+ *
+ * The information a state adds is its motion to the next state, with the
+ * translation and rotation normalized by min_translation and min_rotation_deg
+ * and summed, so a redundant state has less than 1. The states leaving the
+ * window are marginalized, so their information is kept in the prior of the
+ * window.
+ */
+class InformationLagWindowPolicy : public LagWindowPolicy {
+public:
+  struct Params {
+    /** the window is at most this long */
+    ros::Duration lag_duration{5.0};
+
+    /** the window is at least this long, whatever its information */
+    ros::Duration min_lag_duration{1.0};
+
+    /** motion that makes a state informative */
+    double min_translation{0.05};
+    double min_rotation_deg{2.0};
+
+    /** max sum of the information of the states kept, 0 to disable */
+    double information_budget{0};
+
+    /** max number of states kept, 0 to disable */
+    int max_states{0};
+  };
+
+  explicit InformationLagWindowPolicy(const Params& params);
+
+  bool NeedsStates() const override { return true; }
+
+  ros::Time LagExpiration(const ros::Time& start_time, const ros::Time& now,
+                          const WindowStates& states) const override;
+
+  /**
+   * @brief information added by a state, given the next one
+   */
+  double Information(const WindowState& state,
+                     const WindowState& next) const;
+
+private:
+  Params params_;
+};
+
+} // namespace bs_optimizers
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+#include <ros/time.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Incremental index of the variables and constraints in the smoother
+ * graph, used to select and marginalize the variables that leave the window.
+ * This replaces fuse_optimizers::VariableStampIndex, which needs to visit the
+ * full window every time it is queried.
+ *
+ * It stores the variables sorted by stamp and the constraints connected to
+ * each variable, and is updated with each transaction applied to the graph.
+ * The variables selected for marginalization are the same as with the
+ * VariableStampIndex: all variables that are not part of, or connected by a
+ * non-marginal constraint to, a stamped variable inside the window. Only
+ * variables stamped before the window, variables connected to them, and
+ * unstamped variables without a non-marginal constraint to any stamped variable
+ * need to be visited to find them, so the cost of a query depends on the size
+ * of the time slice leaving the window rather than the size of the window.
+ */
+class MarginalizationIndex {
+public:
+  using UUIDSet = std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash>;
+
+  MarginalizationIndex() = default;
+
+  ~MarginalizationIndex() = default;
+
+  /**
+   * @brief add a new (non-marginal) transaction to the index
+   */
+  void AddNewTransaction(const fuse_core::Transaction& transaction);
+
+  /**
+   * @brief add a marginal transaction to the index. Constraints added by
+   * marginal transactions are tracked so they can be removed later, but they
+   * do not keep variables connected to the window.
+   */
+  void AddMarginalTransaction(const fuse_core::Transaction& transaction);
+
+  /**
+   * @brief get the most recent stamp of all stamped variables, or zero if
+   * there are none
+   */
+  ros::Time CurrentStamp() const;
+
+  /**
+   * @brief get all variables that should be marginalized
+   * @param lag_expiration oldest stamp that is inside the window
+   * @return variables to marginalize, in no specific order
+   */
+  std::vector<fuse_core::UUID> Query(const ros::Time& lag_expiration) const;
+
+  /**
+   * @brief get all constraints (including marginal constraints) connected to a
+   * variable, empty if the variable does not exist
+   */
+  const UUIDSet& ConnectedConstraints(const fuse_core::UUID& variable) const;
+
+  /**
+   * @brief get all constraints connected to a set of variables, each
+   * constraint is only returned once
+   */
+  std::vector<fuse_core::UUID> ConnectedConstraints(
+      const std::vector<fuse_core::UUID>& variables) const;
+
+  /**
+   * @brief remove everything from the index
+   */
+  void Clear();
+
+private:
+  struct VariableInfo {
+    UUIDSet constraints;
+    // non marginal constraints that involve a stamped variable
+    int num_stamped_constraints{0};
+    bool stamped{false};
+    ros::Time stamp;
+  };
+
+  struct ConstraintInfo {
+    std::vector<fuse_core::UUID> variables;
+    bool marginal{false};
+    bool stamped{false}; // non marginal and involves a stamped variable
+  };
+
+  void ApplyTransaction(const fuse_core::Transaction& transaction,
+                        bool marginal);
+
+  void RemoveConstraint(const fuse_core::UUID& uuid);
+
+  void RemoveVariable(const fuse_core::UUID& uuid);
+
+  bool IsInWindow(const fuse_core::UUID& variable,
+                  const ros::Time& lag_expiration) const;
+
+  bool IsConnectedToWindow(const fuse_core::UUID& variable,
+                           const ros::Time& lag_expiration) const;
+
+  std::map<ros::Time, UUIDSet> stamps_;
+  std::unordered_map<fuse_core::UUID, VariableInfo, fuse_core::uuid::hash>
+      variables_;
+  std::unordered_map<fuse_core::UUID, ConstraintInfo, fuse_core::uuid::hash>
+      constraints_;
+
+  // unstamped variables without any non marginal constraint to a stamped
+  // variable, e.g. variables only connected to other unstamped variables
+  UUIDSet orphans_;
+};
+
+} // namespace bs_optimizers
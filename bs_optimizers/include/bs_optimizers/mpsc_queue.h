@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Lock-free multi-producer single-consumer queue. Producers push onto
+ * an atomic linked list and never block each other or the consumer. The
+ * consumer takes all queued values at once, so there is no per-element
+ * synchronization and no ABA problem.
+ *
+ * Push can be called concurrently from any thread. PopAll and Clear must only
+ * be called by a single consumer at a time.
+ */
+template <typename T>
+class MPSCQueue {
+public:
+  MPSCQueue() = default;
+
+  ~MPSCQueue() { Clear(); }
+
+  MPSCQueue(const MPSCQueue& other) = delete;
+
+  MPSCQueue& operator=(const MPSCQueue& other) = delete;
+
+  /**
+   * @brief add a value to the queue
+   */
+  void Push(T value) {
+    Node* node =
+        new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+    while (!head_.compare_exchange_weak(node->next, node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {}
+  }
+
+  /**
+   * @brief remove all values from the queue
+   * @return values in the order they were pushed
+   */
+  std::vector<T> PopAll() {
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    std::vector<T> values;
+    while (node) {
+      values.push_back(std::move(node->value));
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+    // the list is last in first out
+    std::reverse(values.begin(), values.end());
+    return values;
+  }
+
+  /**
+   * @brief remove all values from the queue
+   */
+  void Clear() { PopAll(); }
+
+  /**
+   * @brief check if the queue is empty, this is only a snapshot if producers
+   * are running
+   */
+  bool Empty() const {
+    return head_.load(std::memory_order_relaxed) == nullptr;
+  }
+
+private:
+  struct Node {
+    T value;
+    Node* next;
+  };
+
+  std::atomic<Node*> head_{nullptr};
+};
+
+} // namespace bs_optimizers
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/uuid.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Freezes the extrinsics variables (bs_variables::Position3D and
+ * bs_variables::Orientation3D) estimated online once they converged, and
+ * frees them again when they drift. Extrinsics are connected to every
+ * residual of their sensor, so while they are free they couple all states of
+ * the window and slow down the (schur) solver, even though they barely move
+ * once calibrated.
+ *
+ * Update is called after each optimization. A free extrinsics variable
+ * converged once it moved less than max_translation_change /
+ * max_rotation_change_deg in each of the last convergence_cycles cycles and,
+ * if max_translation_std / max_rotation_std_deg are set, its marginal
+ * standard deviation is below them. Converged variables are held constant in
+ * the graph, so sensor models keep using (and publishing) the held value.
+ * Every probe_period cycles a held variable is freed for probe_cycles cycles:
+ * if it moves away from the held value by more than drift_translation /
+ * drift_rotation_deg it stays free until it converges again, otherwise it is
+ * held again. Variables that are on hold when they are first seen are held
+ * by someone else and are never changed.
+ *
+ * Holds only take effect in the next optimization. This class is not thread
+ * safe.
+ */
+class OnlineCalibrationManager {
+public:
+  struct Params {
+    bool enabled{false};
+    int convergence_cycles{20};
+    double max_translation_change{0.0005};
+    double max_rotation_change_deg{0.02};
+
+    /** covariance checks are disabled if not positive */
+    double max_translation_std{-1};
+    double max_rotation_std_deg{-1};
+
+    /** drift probes are disabled if not positive */
+    int probe_period{200};
+    int probe_cycles{5};
+    double drift_translation{0.01};
+    double drift_rotation_deg{0.2};
+  };
+
+  OnlineCalibrationManager() = default;
+
+  explicit OnlineCalibrationManager(const Params& params);
+
+  /**
+   * @brief check the extrinsics variables of a graph after an optimization
+   * and hold or free them in the graph
+   * @return true if a hold changed
+   */
+  bool Update(fuse_core::Graph& graph);
+
+  /**
+   * @brief forget all variables, this must be called whenever the graph is
+   * cleared
+   */
+  void Clear();
+
+  /**
+   * @brief number of extrinsics variables currently held by this manager
+   */
+  size_t NumHeld() const;
+
+  size_t NumTracked() const { return states_.size(); }
+
+  bool Enabled() const { return params_.enabled; }
+
+private:
+  enum class Status { FREE, HELD, PROBING, EXTERNAL };
+
+  struct VariableState {
+    Status status{Status::FREE};
+    bool is_position{true};
+    std::vector<double> last_value;
+
+    /** value when it was held, probes are compared with it */
+    std::vector<double> held_value;
+
+    /** consecutive cycles in the current status, or consecutive converged
+     * cycles when free */
+    int cycles{0};
+  };
+
+  /**
+   * @brief change between two values of a variable, in m for positions and in
+   * deg for orientations (w, x, y, z)
+   */
+  static double Change(bool is_position, const std::vector<double>& a,
+                       const std::vector<double>& b);
+
+  /**
+   * @brief check the marginal covariance of a free variable
+   * @return true if it is confident enough, or if the check is disabled
+   */
+  bool IsCertain(const fuse_core::Graph& graph, const fuse_core::UUID& uuid,
+                 bool is_position) const;
+
+  Params params_;
+  std::unordered_map<fuse_core::UUID, VariableState, fuse_core::uuid::hash>
+      states_;
+};
+
+} // namespace bs_optimizers
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Same as fuse_constraints::marginalizeVariables, but the constraints
+ * connected to the marginalized variables are linearized in parallel on the
+ * bs_common::TaskScheduler. Linearizing (evaluating the jacobians of) the
+ * constraints is most of the cost of marginalizing, the elimination of each
+ * variable depends on the previous one and stays sequential.
+ * @param source source of the marginal constraints
+ * @param marginalized_variables variables to marginalize
+ * @param graph graph the variables are in
+ * @return transaction removing the variables and their constraints, and
+ * adding the marginal constraints
+ */
+fuse_core::Transaction ParallelMarginalizeVariables(
+    const std::string& source,
+    const std::vector<fuse_core::UUID>& marginalized_variables,
+    const fuse_core::Graph& graph);
+
+/**
+ * @brief Deep copy of a graph into a fuse_graphs::HashGraph, the variables and
+ * constraints are cloned in parallel on the bs_common::TaskScheduler and then
+ * added to the copy. Unlike fuse_core::Graph::clone, the copy has the default
+ * HashGraph params, which only matter to optimize the copy.
+ */
+fuse_core::Graph::UniquePtr ParallelClone(const fuse_core::Graph& graph);
+
+} // namespace bs_optimizers
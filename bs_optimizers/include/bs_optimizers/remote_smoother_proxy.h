@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/transaction.h>
+#include <fuse_optimizers/optimizer.h>
+#include <ros/ros.h>
+
+#include <bs_optimizers/remote_smoother_transport.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief Optimizer of the front-end process when the FixedLagSmoother runs in
+ * a process of its own (remote_transport/enabled). It loads the sensor models
+ * and publishers like any fuse optimizer, but does not optimize: the
+ * transactions of the sensor models are sent to the smoother through shared
+ * memory (see RemoteSmootherClient), and the graph updates it sends back are
+ * passed to all plugins as bs_common::GraphSnapshot.
+ *
+ * Resets are done by the smoother, which tells the front-end to restart its
+ * plugins, and forwards its fast reset state to the bs_common::ResetContext
+ * of this process.
+ *
+ * The smoother must be configured with the same remote_transport/ params, no
+ * sensor models, and the motion models of the sensor models. Publishers
+ * receive each graph with an empty transaction, publishers which need the
+ * transactions must run in the smoother process.
+ */
+class RemoteSmootherProxy : public fuse_optimizers::Optimizer {
+public:
+  FUSE_SMART_PTR_DEFINITIONS(RemoteSmootherProxy);
+
+  /**
+   * @param graph graph object required by fuse, not used
+   */
+  RemoteSmootherProxy(
+      fuse_core::Graph::UniquePtr graph,
+      const ros::NodeHandle& node_handle = ros::NodeHandle(),
+      const ros::NodeHandle& private_node_handle = ros::NodeHandle("~"));
+
+  ~RemoteSmootherProxy() override;
+
+protected:
+  /**
+   * @brief send the transaction to the smoother
+   */
+  void transactionCallback(
+      const std::string& sensor_name,
+      fuse_core::Transaction::SharedPtr transaction) override;
+
+  /**
+   * @brief restart all plugins after the smoother was reset
+   */
+  void onReset(bool fast_reset,
+               const std::optional<bs_common::ImuState>& last_good_state);
+
+  std::unique_ptr<RemoteSmootherClient> client_;
+};
+
+} // namespace bs_optimizers
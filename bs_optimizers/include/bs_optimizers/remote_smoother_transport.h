@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <fuse_core/graph.h>
+#include <fuse_core/transaction.h>
+#include <ros/node_handle.h>
+#include <ros/time.h>
+
+#include <bs_common/chunk_file.h>
+#include <bs_common/graph_diff.h>
+#include <bs_common/graph_snapshot.h>
+#include <bs_common/imu_state.h>
+#include <bs_common/shm_ring.h>
+
+namespace bs_optimizers {
+
+/**
+ * @brief type of the frames exchanged between the smoother and a remote
+ * front-end, written as the first 32 bits of each message
+ */
+enum class RemoteFrameType : uint32_t {
+  HELLO = 0,   // sensor models of the front-end and their ignition flags
+  TRANSACTION, // transaction of a sensor model, compact encoded
+  GRAPH,       // graph update, diff against the previous graph frame
+  SNAPSHOT,    // graph update, diff against an empty graph
+  RESET,       // the smoother was reset, with the state to re-ignite from
+  RESYNC       // the front-end lost the graph, the next update is a snapshot
+};
+
+/**
+ * @brief Params of the shared memory transport between a FixedLagSmoother
+ * running in its own process and the front-end process running the sensor
+ * models (see RemoteSmootherProxy), loaded from remote_transport/
+ */
+struct RemoteTransportParams {
+  bool enabled{false};
+
+  /** prefix of the shared memory rings, both processes must use the same */
+  std::string name{"beam_slam"};
+
+  /** size of each ring, a graph update must fit in it */
+  int ring_size_mb{64};
+
+  /** max time in seconds to wait for space in a ring before dropping */
+  double write_timeout{0.1};
+
+  void LoadFromROS(const ros::NodeHandle& nh);
+
+  /** ring of the transactions, from the front-end to the smoother */
+  std::string TransactionRing() const { return "/" + name + "_transactions"; }
+
+  /** ring of the graph updates and resets, from the smoother to the
+   * front-end */
+  std::string GraphRing() const { return "/" + name + "_graphs"; }
+};
+
+/**
+ * @brief Smoother side of the remote transport. Creates both rings, reads the
+ * transactions of the front-end on a thread of its own and sends graph
+ * updates as diffs of the previously sent one (see
+ * bs_common::GraphDiffEncoder), so only the variables and constraints which
+ * changed are copied through the ring.
+ *
+ * Graph updates are sent on a thread of their own, if the front-end is slower
+ * than the smoother only the newest pending update is sent. If an update
+ * cannot be sent, or the front-end cannot apply it, the next one is sent as
+ * a snapshot.
+ */
+class RemoteSmootherServer {
+public:
+  using TransactionCallback = std::function<void(
+      const std::string& sensor_name, fuse_core::Transaction::SharedPtr)>;
+
+  /**
+   * @brief creates the rings, throws a std::runtime_error if they cannot be
+   * created
+   * @param on_transaction called on the reader thread with each transaction
+   * @param on_connect called on the reader thread once the front-end sent its
+   * sensor models
+   */
+  RemoteSmootherServer(const RemoteTransportParams& params,
+                       TransactionCallback on_transaction,
+                       std::function<void()> on_connect);
+
+  ~RemoteSmootherServer();
+
+  RemoteSmootherServer(const RemoteSmootherServer& other) = delete;
+
+  RemoteSmootherServer& operator=(const RemoteSmootherServer& other) = delete;
+
+  /**
+   * @brief check if the front-end sent its sensor models
+   */
+  bool IsConnected() const { return connected_; }
+
+  bool IsIgnitionSensor(const std::string& sensor_name) const;
+
+  bool HasIgnitionSensor() const;
+
+  /**
+   * @brief queue a graph update, superseding the pending one
+   * @param graph graph after the update, must not be modified afterwards
+   */
+  void PublishGraph(fuse_core::Graph::ConstSharedPtr graph,
+                    const ros::Time& stamp);
+
+  /**
+   * @brief queue a reset, pending graph updates are dropped and the next one
+   * is sent as a snapshot
+   * @param fast_reset true if the plugins should keep their resources, see
+   * bs_common::ResetContext
+   * @param last_good_state state offered to the ignition sensor after a fast
+   * reset
+   */
+  void PublishReset(bool fast_reset,
+                    const std::optional<bs_common::ImuState>& last_good_state);
+
+  /**
+   * @brief number of graph updates which could not be sent
+   */
+  uint64_t NumDropped() const { return num_dropped_; }
+
+private:
+  void ReadLoop();
+
+  void WriteLoop();
+
+  RemoteTransportParams params_;
+  TransactionCallback on_transaction_;
+  std::function<void()> on_connect_;
+  std::unique_ptr<bs_common::ShmRing> transaction_ring_;
+  std::unique_ptr<bs_common::ShmRing> graph_ring_;
+  std::atomic<bool> running_{true};
+  std::atomic<bool> connected_{false};
+  std::atomic<bool> resync_{false};
+  std::atomic<uint64_t> num_dropped_{0};
+
+  mutable std::mutex sensors_mutex_;
+  std::unordered_map<std::string, bool> sensors_;
+
+  // guarded by mutex_
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  fuse_core::Graph::ConstSharedPtr pending_graph_;
+  ros::Time pending_stamp_;
+  std::deque<bs_common::ByteWriter> pending_resets_;
+
+  // only accessed by the writer thread
+  bs_common::GraphDiffEncoder encoder_;
+  bool send_snapshot_{true};
+
+  std::thread reader_;
+  std::thread writer_;
+};
+
+/**
+ * @brief Front-end side of the remote transport. Opens the rings once the
+ * smoother created them, sends the sensor models and their transactions, and
+ * rebuilds the graph updates as bs_common::GraphSnapshot, with their delta
+ * w.r.t. the previous update received.
+ */
+class RemoteSmootherClient {
+public:
+  using GraphCallback = std::function<void(
+      bs_common::GraphSnapshot::ConstSharedPtr graph, const ros::Time& stamp)>;
+
+  using ResetCallback = std::function<void(
+      bool fast_reset,
+      const std::optional<bs_common::ImuState>& last_good_state)>;
+
+  /**
+   * @param sensors name of each sensor model, and if it is an ignition sensor
+   * @param on_graph called on the reader thread with each graph update
+   * @param on_reset called on the reader thread when the smoother is reset
+   */
+  RemoteSmootherClient(const RemoteTransportParams& params,
+                       const std::unordered_map<std::string, bool>& sensors,
+                       GraphCallback on_graph, ResetCallback on_reset);
+
+  ~RemoteSmootherClient();
+
+  RemoteSmootherClient(const RemoteSmootherClient& other) = delete;
+
+  RemoteSmootherClient& operator=(const RemoteSmootherClient& other) = delete;
+
+  bool IsConnected() const { return connected_; }
+
+  /**
+   * @brief send a transaction to the smoother, thread-safe
+   * @return false if it is not connected or the ring stays full
+   */
+  bool SendTransaction(const std::string& sensor_name,
+                       const fuse_core::Transaction& transaction);
+
+private:
+  /**
+   * @brief open the rings and send the sensor models
+   * @return false if the smoother did not create the rings yet
+   */
+  bool Connect();
+
+  void ReadLoop();
+
+  /**
+   * @brief discard the graph and ask the smoother for a snapshot
+   */
+  void RequestResync();
+
+  RemoteTransportParams params_;
+  std::unordered_map<std::string, bool> sensors_;
+  GraphCallback on_graph_;
+  ResetCallback on_reset_;
+  std::atomic<bool> running_{true};
+  std::atomic<bool> connected_{false};
+
+  // guarded by write_mutex_, transactions are sent by all sensor models
+  std::mutex write_mutex_;
+  std::unique_ptr<bs_common::ShmRing> transaction_ring_;
+
+  // only accessed by the reader thread
+  std::unique_ptr<bs_common::ShmRing> graph_ring_;
+  bs_common::GraphDiffDecoder decoder_;
+  bool synced_{false}; //!< false until a snapshot is received
+
+  std::thread reader_;
+};
+
+} // namespace bs_optimizers
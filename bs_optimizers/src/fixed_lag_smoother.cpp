@@ -34,6 +34,12 @@
 #include <bs_optimizers/fixed_lag_smoother.h>
 
 #include <bs_common/imu_state.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/latency_tracer.h>
+#include <bs_common/memory_accounting.h>
+#include <bs_common/reset_context.h>
+#include <bs_common/startup_profiler.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_constraints/inertial/absolute_imu_state_3d_stamped_constraint.h>
 #include <bs_parameters/parameter_base.h>
 #include <fuse_constraints/marginalize_variables.h>
@@ -44,6 +50,8 @@
 #include <ros/ros.h>
 
 #include <algorithm>
+#include <array>
+#include <functional>
 #include <iterator>
 #include <mutex>
 #include <string>
@@ -73,6 +81,47 @@ typename std::vector<T>::reverse_iterator
   container.erase(position.base());
   return position;
 }
+
+/**
+ * @brief Calls a function when going out of scope
+ */
+class ScopeExit {
+public:
+  explicit ScopeExit(std::function<void()> function)
+      : function_(std::move(function)) {}
+
+  ~ScopeExit() { function_(); }
+
+private:
+  std::function<void()> function_;
+};
+
+/**
+ * @brief Sets the budgets of the memory accounts from a (nested) struct of
+ * budgets in MB, e.g. {lidar_odometry: {active_clouds: 500}} sets the budget
+ * of "lidar_odometry/active_clouds"
+ */
+void setMemoryBudgets(XmlRpc::XmlRpcValue& budgets, const std::string& name) {
+  if (budgets.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+    for (auto& [key, value] : budgets) {
+      setMemoryBudgets(value, name.empty() ? key : name + "/" + key);
+    }
+    return;
+  }
+
+  double budget_mb;
+  if (budgets.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+    budget_mb = static_cast<int>(budgets);
+  } else if (budgets.getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+    budget_mb = static_cast<double>(budgets);
+  } else {
+    ROS_ERROR("Invalid memory budget of %s, must be a number", name.c_str());
+    return;
+  }
+  ROS_INFO("Memory budget of %s: %.1f MB", name.c_str(), budget_mb);
+  bs_common::MemoryAccounting::GetInstance().GetAccount(name).SetBudget(
+      static_cast<uint64_t>(std::max(budget_mb, 0.0) * 1024 * 1024));
+}
 } // namespace
 
 namespace bs_optimizers {
@@ -88,9 +137,190 @@ FixedLagSmoother::FixedLagSmoother(fuse_core::Graph::UniquePtr graph,
       started_(false) {
   params_.loadFromROS(private_node_handle);
 
+  std::string window_policy;
+  bs_parameters::getParam(ros::NodeHandle("~"), "window_policy", window_policy,
+                          std::string("FIXED"));
+  if (window_policy == "INFORMATION") {
+    InformationLagWindowPolicy::Params window_params;
+    window_params.lag_duration = params_.lag_duration;
+    double min_lag_duration;
+    bs_parameters::getParam(ros::NodeHandle("~"), "window/min_lag_duration",
+                            min_lag_duration, 1.0);
+    window_params.min_lag_duration = ros::Duration(min_lag_duration);
+    bs_parameters::getParam(ros::NodeHandle("~"), "window/min_translation",
+                            window_params.min_translation, 0.05);
+    bs_parameters::getParam(ros::NodeHandle("~"), "window/min_rotation_deg",
+                            window_params.min_rotation_deg, 2.0);
+    bs_parameters::getParam(ros::NodeHandle("~"), "window/information_budget",
+                            window_params.information_budget, 0.0);
+    bs_parameters::getParam(ros::NodeHandle("~"), "window/max_states",
+                            window_params.max_states, 0);
+    window_policy_ =
+        std::make_unique<InformationLagWindowPolicy>(window_params);
+  } else {
+    if (window_policy != "FIXED") {
+      ROS_ERROR("Invalid window policy: %s, options: FIXED, INFORMATION",
+                window_policy.c_str());
+      throw std::runtime_error{"invalid window policy"};
+    }
+    window_policy_ =
+        std::make_unique<FixedLagWindowPolicy>(params_.lag_duration);
+  }
+
   // get additional parameter
   bs_parameters::getParam(ros::NodeHandle("~"), "pseudo_marginalization",
                           use_pseudo_marginalization_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "use_graph_snapshots",
+                          use_graph_snapshots_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "parallel_marginalization",
+                          use_parallel_marginalization_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "parallel_graph_clone",
+                          use_parallel_graph_clone_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "incremental_problem",
+                          use_incremental_problem_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "landmark_ordering",
+                          use_landmark_ordering_, false);
+  if (use_landmark_ordering_ &&
+      params_.solver_options.linear_solver_type != ceres::SPARSE_SCHUR &&
+      params_.solver_options.linear_solver_type != ceres::DENSE_SCHUR &&
+      params_.solver_options.linear_solver_type != ceres::ITERATIVE_SCHUR) {
+    ROS_INFO("Landmark ordering enabled, setting linear solver type to "
+             "SPARSE_SCHUR.");
+    params_.solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+  }
+
+  OnlineCalibrationManager::Params calibration_params;
+  bs_parameters::getParam(ros::NodeHandle("~"), "online_calibration/enabled",
+                          calibration_params.enabled, false);
+  if (calibration_params.enabled) {
+    const std::string prefix = "online_calibration/";
+    const ros::NodeHandle nh("~");
+    bs_parameters::getParam(nh, prefix + "convergence_cycles",
+                            calibration_params.convergence_cycles, 20);
+    bs_parameters::getParam(nh, prefix + "max_translation_change",
+                            calibration_params.max_translation_change, 0.0005);
+    bs_parameters::getParam(nh, prefix + "max_rotation_change_deg",
+                            calibration_params.max_rotation_change_deg, 0.02);
+    bs_parameters::getParam(nh, prefix + "max_translation_std",
+                            calibration_params.max_translation_std, -1.0);
+    bs_parameters::getParam(nh, prefix + "max_rotation_std_deg",
+                            calibration_params.max_rotation_std_deg, -1.0);
+    bs_parameters::getParam(nh, prefix + "probe_period",
+                            calibration_params.probe_period, 200);
+    bs_parameters::getParam(nh, prefix + "probe_cycles",
+                            calibration_params.probe_cycles, 5);
+    bs_parameters::getParam(nh, prefix + "drift_translation",
+                            calibration_params.drift_translation, 0.01);
+    bs_parameters::getParam(nh, prefix + "drift_rotation_deg",
+                            calibration_params.drift_rotation_deg, 0.2);
+  }
+  calibration_manager_ = OnlineCalibrationManager(calibration_params);
+  bs_parameters::getParam(ros::NodeHandle("~"), "realtime_mode",
+                          realtime_mode_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "realtime_num_cycles",
+                          realtime_num_cycles_, 10);
+  bs_parameters::getParam(ros::NodeHandle("~"), "backpressure_cycles",
+                          backpressure_cycles_, 3);
+  bs_parameters::getParam(ros::NodeHandle("~"), "backpressure_max_pending",
+                          backpressure_max_pending_, 10);
+  backpressure_publisher_ =
+      private_node_handle_.advertise<std_msgs::Bool>("backpressure", 1, true);
+  bs_parameters::getParam(ros::NodeHandle("~"), "external_trigger",
+                          external_trigger_, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "latency_trace_path",
+                          latency_trace_path_, std::string());
+  if (!latency_trace_path_.empty()) {
+    bs_common::LatencyTracer::GetInstance().Enable();
+  }
+  bool profiler_enabled;
+  bs_parameters::getParam(ros::NodeHandle("~"), "profiler/enabled",
+                          profiler_enabled, false);
+  bs_parameters::getParam(ros::NodeHandle("~"), "profiler/rate_hz",
+                          profiler_params_.rate_hz, 20.0);
+  int profiler_max_stacks;
+  bs_parameters::getParam(ros::NodeHandle("~"), "profiler/max_stacks",
+                          profiler_max_stacks, 50000);
+  profiler_params_.max_stacks = static_cast<size_t>(profiler_max_stacks);
+  bs_parameters::getParam(ros::NodeHandle("~"), "profiler/output_path",
+                          profiler_output_path_,
+                          std::string("beam_slam_profile.folded"));
+  if (profiler_enabled) {
+    bs_common::SamplingProfiler::GetInstance().Start(profiler_params_);
+  }
+  XmlRpc::XmlRpcValue memory_budgets;
+  if (ros::NodeHandle("~").getParam("memory_budgets_mb", memory_budgets)) {
+    setMemoryBudgets(memory_budgets, "");
+  }
+
+  // configure the shared scheduler before any plugin queues tasks
+  bs_common::TaskScheduler::Params scheduler_params;
+  bs_parameters::getParam(ros::NodeHandle("~"), "task_scheduler/num_threads",
+                          scheduler_params.num_threads, 0);
+  bs_parameters::getParam(ros::NodeHandle("~"),
+                          "task_scheduler/max_background_threads",
+                          scheduler_params.max_background_threads, 0);
+  ros::NodeHandle("~").getParam("task_scheduler/cores",
+                                scheduler_params.cores);
+  bs_common::TaskScheduler::GetInstance().Configure(scheduler_params);
+  last_scheduler_stats_ = bs_common::TaskScheduler::GetInstance().GetStats();
+  ROS_INFO("Task scheduler running on %d threads",
+           last_scheduler_stats_.num_threads);
+  ros::NodeHandle("~").getParam("optimization_thread_cores",
+                                optimization_thread_cores_);
+  std::vector<std::string> low_priority_sensors;
+  ros::NodeHandle("~").getParam("low_priority_sensors", low_priority_sensors);
+  low_priority_sensors_.insert(low_priority_sensors.begin(),
+                               low_priority_sensors.end());
+  double low_priority_period;
+  bs_parameters::getParam(ros::NodeHandle("~"), "low_priority_period",
+                          low_priority_period, 1.0);
+  low_priority_period_ = ros::Duration(low_priority_period);
+  double low_priority_budget;
+  bs_parameters::getParam(ros::NodeHandle("~"), "low_priority_budget",
+                          low_priority_budget, 0.5);
+  low_priority_budget_ = ros::Duration(low_priority_budget);
+  bs_parameters::getParam(ros::NodeHandle("~"), "fast_reset", fast_reset_,
+                          false);
+  double fast_reset_min_period;
+  bs_parameters::getParam(ros::NodeHandle("~"), "fast_reset_min_period",
+                          fast_reset_min_period, 5.0);
+  fast_reset_min_period_ = ros::WallDuration(fast_reset_min_period);
+  remote_params_.LoadFromROS(ros::NodeHandle("~"));
+
+  // plugins load heavy resources in the background, only wait for the ones
+  // that are needed before starting
+  std::vector<std::string> wait_for_resources;
+  ros::NodeHandle("~").getParam("wait_for_resources", wait_for_resources);
+  double resource_wait_timeout;
+  bs_parameters::getParam(ros::NodeHandle("~"), "resource_wait_timeout",
+                          resource_wait_timeout, 60.0);
+  if (!wait_for_resources.empty()) {
+    ROS_INFO("Waiting for %zu resources before starting",
+             wait_for_resources.size());
+    const auto not_ready =
+        bs_common::StartupProfiler::GetInstance().WaitUntilReady(
+            wait_for_resources, resource_wait_timeout);
+    for (const auto& resource : not_ready) {
+      ROS_WARN("Resource %s not ready after %.1f s, starting anyway",
+               resource.c_str(), resource_wait_timeout);
+    }
+  }
+
+  // The transactions of a remote front-end are received like those of the
+  // local sensor models
+  if (remote_params_.enabled) {
+    if (!sensor_models_.empty()) {
+      ROS_WARN("Remote transport enabled with %zu local sensor models",
+               sensor_models_.size());
+    }
+    remote_server_ = std::make_unique<RemoteSmootherServer>(
+        remote_params_,
+        [this](const std::string& sensor_name,
+               fuse_core::Transaction::SharedPtr transaction) {
+          transactionCallback(sensor_name, std::move(transaction));
+        },
+        [this]() { autostart(); });
+  }
 
   // Test for auto-start
   autostart();
@@ -99,9 +329,11 @@ FixedLagSmoother::FixedLagSmoother(fuse_core::Graph::UniquePtr graph,
   optimization_thread_ = std::thread(&FixedLagSmoother::optimizationLoop, this);
 
   // Configure a timer to trigger optimizations
-  optimize_timer_ =
-      node_handle_.createTimer(params_.optimization_period,
-                               &FixedLagSmoother::optimizerTimerCallback, this);
+  if (!external_trigger_) {
+    optimize_timer_ = node_handle_.createTimer(
+        params_.optimization_period, &FixedLagSmoother::optimizerTimerCallback,
+        this);
+  }
 
   // Advertise a service that resets the optimizer to its initial state
   reset_service_server_ = node_handle_.advertiseService(
@@ -111,22 +343,44 @@ FixedLagSmoother::FixedLagSmoother(fuse_core::Graph::UniquePtr graph,
   reset_subscriber_ =
       node_handle_.subscribe(ros::names::resolve(params_.reset_service), 1,
                              &FixedLagSmoother::resetCallback, this);
+
+  // Advertise services to profile the plugins while running
+  profiler_enable_service_server_ = private_node_handle_.advertiseService(
+      "profiler/enable", &FixedLagSmoother::profilerEnableServiceCallback,
+      this);
+  profiler_dump_service_server_ = private_node_handle_.advertiseService(
+      "profiler/dump", &FixedLagSmoother::profilerDumpServiceCallback, this);
 }
 
 FixedLagSmoother::~FixedLagSmoother() {
+  // Stop receiving remote transactions
+  remote_server_.reset();
   // Wake up any sleeping threads
   optimization_running_ = false;
   optimization_requested_.notify_all();
   // Wait for the threads to shutdown
   if (optimization_thread_.joinable()) { optimization_thread_.join(); }
+  if (!latency_trace_path_.empty()) {
+    ROS_INFO("Writing latency trace to: %s", latency_trace_path_.c_str());
+    bs_common::LatencyTracer::GetInstance().WriteChromeTrace(
+        latency_trace_path_);
+  }
+  auto& profiler = bs_common::SamplingProfiler::GetInstance();
+  profiler.Stop();
+  if (profiler.NumSamples() > 0) {
+    ROS_INFO("Writing profile to: %s", profiler_output_path_.c_str());
+    profiler.WriteFoldedStacks(profiler_output_path_);
+  }
 }
 
 void FixedLagSmoother::autostart() {
+  // The ignition sensors of a remote front-end are known once it connected
+  if (remote_server_ && !remote_server_->IsConnected()) { return; }
   if (std::none_of(sensor_models_.begin(), sensor_models_.end(),
                    [](const auto& element) {
                      return element.second.ignition;
-                   })) // NOLINT(whitespace/braces)
-  {
+                   }) && // NOLINT(whitespace/braces)
+      !(remote_server_ && remote_server_->HasIgnitionSensor())) {
     // No ignition sensors were provided. Auto-start.
     started_ = true;
     setStartTime(ros::Time(0, 0));
@@ -135,35 +389,90 @@ void FixedLagSmoother::autostart() {
   }
 }
 
+bool FixedLagSmoother::isIgnitionSensor(const std::string& sensor_name) const {
+  const auto sensor_model = sensor_models_.find(sensor_name);
+  if (sensor_model != sensor_models_.end()) {
+    return sensor_model->second.ignition;
+  }
+  return remote_server_ && remote_server_->IsIgnitionSensor(sensor_name);
+}
+
 void FixedLagSmoother::preprocessMarginalization(
     const fuse_core::Transaction& new_transaction) {
-  timestamp_tracking_.addNewTransaction(new_transaction);
+  timestamp_tracking_.AddNewTransaction(new_transaction);
 }
 
 ros::Time FixedLagSmoother::computeLagExpirationTime() const {
   // Find the most recent variable timestamp
   auto start_time = getStartTime();
-  auto now = timestamp_tracking_.currentStamp();
-  // Then carefully subtract the lag duration. ROS Time objects do not handle
-  // negative values.
-  return (start_time + params_.lag_duration < now) ? now - params_.lag_duration
-                                                   : start_time;
+  auto now = timestamp_tracking_.CurrentStamp();
+  // variables before the current window start are already marginalized, so
+  // the policy can only shorten the window
+  const ros::Time window_start = std::max(start_time, lag_expiration_);
+  WindowStates states;
+  if (window_policy_->NeedsStates()) {
+    states = getWindowStates(window_start);
+  }
+  return std::max(window_start,
+                  window_policy_->LagExpiration(start_time, now, states));
+}
+
+WindowStates FixedLagSmoother::getWindowStates(const ros::Time& after) const {
+  WindowStates states;
+  for (const auto& v : graph_->getVariables()) {
+    if (v.type() != "fuse_variables::Position3DStamped") { continue; }
+    const auto& position =
+        dynamic_cast<const fuse_variables::Position3DStamped&>(v);
+    if (position.stamp() < after) { continue; }
+    const auto or_uuid = fuse_core::uuid::generate(
+        "fuse_variables::Orientation3DStamped", position.stamp(),
+        position.deviceId());
+    if (!graph_->variableExists(or_uuid)) { continue; }
+    const auto& orientation =
+        dynamic_cast<const fuse_variables::Orientation3DStamped&>(
+            graph_->getVariable(or_uuid));
+    WindowState state;
+    state.stamp = position.stamp();
+    state.position =
+        Eigen::Vector3d(position.x(), position.y(), position.z());
+    state.orientation = Eigen::Quaterniond(orientation.w(), orientation.x(),
+                                           orientation.y(), orientation.z());
+    states.push_back(state);
+  }
+  std::sort(states.begin(), states.end(),
+            [](const WindowState& a, const WindowState& b) {
+              return a.stamp < b.stamp;
+            });
+  return states;
 }
 
 std::vector<fuse_core::UUID> FixedLagSmoother::computeVariablesToMarginalize(
     const ros::Time& lag_expiration) {
-  auto marginalize_variable_uuids = std::vector<fuse_core::UUID>();
-  timestamp_tracking_.query(lag_expiration,
-                            std::back_inserter(marginalize_variable_uuids));
-  return marginalize_variable_uuids;
+  return timestamp_tracking_.Query(lag_expiration);
 }
 
 void FixedLagSmoother::postprocessMarginalization(
     const fuse_core::Transaction& marginal_transaction) {
-  timestamp_tracking_.addMarginalTransaction(marginal_transaction);
+  timestamp_tracking_.AddMarginalTransaction(marginal_transaction);
 }
 
 void FixedLagSmoother::optimizationLoop() {
+  bs_common::SamplingProfiler::GetInstance().RegisterThread(
+      "fixed_lag_smoother");
+  if (!optimization_thread_cores_.empty() &&
+      !bs_common::TaskScheduler::PinCurrentThread(
+          optimization_thread_cores_)) {
+    ROS_WARN("Cannot pin the optimization thread to the configured cores");
+  }
+
+  auto& instrumentation = bs_common::Instrumentation::GetInstance();
+  bs_common::Metric& marginalize_metric =
+      instrumentation.GetMetric("fixed_lag_smoother/marginalize");
+  bs_common::Metric& optimize_metric =
+      instrumentation.GetMetric("fixed_lag_smoother/optimize");
+  bs_common::Metric& notify_metric =
+      instrumentation.GetMetric("fixed_lag_smoother/notify");
+
   auto exit_wait_condition = [this]() {
     return this->optimization_request_ || !this->optimization_running_ ||
            !ros::ok();
@@ -178,20 +487,39 @@ void FixedLagSmoother::optimizationLoop() {
       optimization_request_ = false;
       optimization_deadline = optimization_deadline_;
     }
+    // Notify optimizeOnce() when this cycle is done, however it exits
+    ScopeExit cycle_completed([this]() {
+      {
+        std::lock_guard<std::mutex> lock(optimization_requested_mutex_);
+        completed_cycles_++;
+      }
+      optimization_completed_.notify_all();
+    });
     // If a shutdown is requested, exit now.
     if (!optimization_running_ || !ros::ok()) { break; }
     // Optimize
     {
       std::lock_guard<std::mutex> lock(optimization_mutex_);
+      const ros::WallTime cycle_start = ros::WallTime::now();
+      // Sort all received transactions into the pending queue, this is where
+      // the ignition transaction is detected
+      drainTransactionInbox();
+      if (!started_) { continue; }
+      // A low priority cycle runs right after the regular cycle in which it
+      // became due, so the odometry in that regular cycle is not delayed
+      const bool low_priority_cycle = run_low_priority_cycle_;
+      run_low_priority_cycle_ = false;
+      if (low_priority_cycle) {
+        last_low_priority_cycle_ = ros::Time::now();
+        optimization_deadline = last_low_priority_cycle_ + low_priority_budget_;
+      } else if (isLowPriorityCycleDue(ros::Time::now())) {
+        run_low_priority_cycle_ = true;
+        optimization_request_ = true;
+      }
       // Apply motion models
+      traced_transactions_.clear();
       auto new_transaction = fuse_core::Transaction::make_shared();
-      // DANGER: processQueue obtains a lock from the
-      // pending_transactions_mutex_
-      //         We do this to ensure state of the graph does not change between
-      //         unlocking the pending_transactions queue and obtaining the lock
-      //         for the graph. But we have now obtained two different locks. If
-      //         we are not extremely careful, we could get a deadlock.
-      processQueue(*new_transaction, lag_expiration_);
+      processQueue(*new_transaction, lag_expiration_, low_priority_cycle);
       // Skip this optimization cycle if the transaction is empty because
       // something failed while processing the pending transactions queue.
       if (new_transaction->empty()) { continue; }
@@ -234,9 +562,13 @@ void FixedLagSmoother::optimizationLoop() {
         ros::requestShutdown();
         break;
       }
+      if (use_incremental_problem_) {
+        incremental_problem_.Update(*graph_, *new_transaction);
+      }
 
       // Marginalize variable
       ROS_DEBUG("Marginalizing graph.");
+      bs_common::ScopedTimer marginalize_timer(marginalize_metric);
       preprocessMarginalization(*new_transaction);
       lag_expiration_ = computeLagExpirationTime();
       auto vars_to_marginalize = computeVariablesToMarginalize(lag_expiration_);
@@ -244,17 +576,14 @@ void FixedLagSmoother::optimizationLoop() {
       if (use_pseudo_marginalization_) {
         marginal_transaction_ = fuse_core::Transaction();
         if (vars_to_marginalize.size() > 1) {
-          // remove variables
-          for (const auto uuid : vars_to_marginalize) {
-            try {
-              // remove all connected constraints
-              auto constraints = graph_->getConnectedConstraints(uuid);
-              for (const auto& c : constraints) {
-                marginal_transaction_.removeConstraint(c.uuid());
-              }
-              marginal_transaction_.removeVariable(uuid);
-
-            } catch (const std::exception& ex) {}
+          // remove all variables and their connected constraints in one pass
+          // using the connectivity stored in the index
+          for (const auto& uuid :
+               timestamp_tracking_.ConnectedConstraints(vars_to_marginalize)) {
+            marginal_transaction_.removeConstraint(uuid);
+          }
+          for (const auto& uuid : vars_to_marginalize) {
+            marginal_transaction_.removeVariable(uuid);
           }
 
           // add prior on the new start state
@@ -266,19 +595,40 @@ void FixedLagSmoother::optimizationLoop() {
               Eigen::Matrix<double, 15, 15>::Identity() * 0.00001);
           marginal_transaction_.addConstraint(prior);
         }
+      } else if (use_parallel_marginalization_) {
+        marginal_transaction_ = ParallelMarginalizeVariables(
+            ros::this_node::getName(), vars_to_marginalize, *graph_);
       } else {
         marginal_transaction_ = fuse_constraints::marginalizeVariables(
             ros::this_node::getName(), vars_to_marginalize, *graph_);
       }
 
       graph_->update(marginal_transaction_);
+      if (use_incremental_problem_) {
+        incremental_problem_.Update(*graph_, marginal_transaction_);
+      }
       // Perform any post-marginal cleanup
       postprocessMarginalization(marginal_transaction_);
+      updateGraphMemoryAccount();
+      marginalize_timer.Stop();
       ROS_DEBUG("----Done marginalizing fuse graph");
 
       // Optimize the entire graph
       ROS_DEBUG("Optimizing fuse graph");
-      summary_ = graph_->optimize(params_.solver_options);
+      bs_common::ScopedTimer optimize_timer(optimize_metric);
+      ceres::Solver::Options solver_options = params_.solver_options;
+      if (use_landmark_ordering_) {
+        solver_options.linear_solver_ordering = computeLandmarkOrdering();
+      }
+      if (realtime_mode_) {
+        applyRealtimeLimits(optimization_deadline, solver_options);
+      }
+      if (use_incremental_problem_) {
+        summary_ = incremental_problem_.Optimize(solver_options);
+      } else {
+        summary_ = graph_->optimize(solver_options);
+      }
+      optimize_timer.Stop();
       ROS_DEBUG("Done optimizing fuse graph");
 
       // Abort if optimization failed. Not converging is not a failure because
@@ -294,6 +644,25 @@ void FixedLagSmoother::optimizationLoop() {
         break;
       }
 
+      if (realtime_mode_) {
+        cycle_costs_.emplace_back(summary_.minimizer_time_in_seconds,
+                                  summary_.iterations.size());
+        while (cycle_costs_.size() >
+               static_cast<size_t>(realtime_num_cycles_)) {
+          cycle_costs_.pop_front();
+        }
+      }
+
+      // Hold the converged extrinsics, the holds are applied to the problem
+      // in the next cycle
+      calibration_manager_.Update(*graph_);
+
+      // Keep the state to re-ignite from after a fast reset
+      if (fast_reset_) {
+        auto newest_state = getNewestImuState();
+        if (newest_state) { last_good_state_ = std::move(newest_state); }
+      }
+
       // Log a warning if the optimization took too long
       auto optimization_complete = ros::Time::now();
       if (optimization_complete > optimization_deadline) {
@@ -302,26 +671,44 @@ void FixedLagSmoother::optimizationLoop() {
                       << (optimization_complete - optimization_deadline)
                       << "s");
       }
+      updateBackpressure(optimization_complete > optimization_deadline);
+
+      // Record the transactions of this cycle, from their reception to the
+      // end of the optimization
+      const ros::WallTime cycle_end = ros::WallTime::now();
+      for (const auto& [stamp, receive_time] : traced_transactions_) {
+        bs_common::LatencyTracer::GetInstance().Record(
+            "fixed_lag_smoother", stamp, receive_time, cycle_start, cycle_end);
+      }
 
       // Optimization is complete. Notify all the things about the graph
       // changes.
-      notify(std::move(new_transaction), graph_->clone());
+      bs_common::ScopedTimer notify_timer(notify_metric);
+      fuse_core::Graph::ConstSharedPtr graph;
+      if (use_graph_snapshots_) {
+        graph = snapshot_builder_.Build(*graph_);
+      } else if (use_parallel_graph_clone_) {
+        graph = ParallelClone(*graph_);
+      } else {
+        graph = graph_->clone();
+      }
+      if (remote_server_) {
+        remote_server_->PublishGraph(graph, new_transaction->stamp());
+      }
+      notify(std::move(new_transaction), std::move(graph));
     }
   }
 }
 
 void FixedLagSmoother::optimizerTimerCallback(const ros::TimerEvent& event) {
-  // If an "ignition" transaction hasn't been received, then we can't do
-  // anything yet.
-  if (!started_) { return; }
-  // If there is some pending work, trigger the next optimization cycle.
-  // If the optimizer has not completed the previous optimization cycle, then it
-  // will not be waiting on the condition variable signal, so nothing will
-  // happen.
-  {
-    std::lock_guard<std::mutex> lock(pending_transactions_mutex_);
-    optimization_request_ = !pending_transactions_.empty();
-  }
+  // If there is some pending work, trigger the next optimization cycle. New
+  // transactions always trigger a cycle since the optimization thread is the
+  // one that checks for the "ignition" transaction. If the optimizer has not
+  // completed the previous optimization cycle, then it will not be waiting on
+  // the condition variable signal, so nothing will happen.
+  optimization_request_ =
+      !transaction_inbox_.Empty() ||
+      (started_ && num_pending_transactions_ > 0);
   if (optimization_request_) {
     {
       std::lock_guard<std::mutex> lock(optimization_requested_mutex_);
@@ -332,12 +719,27 @@ void FixedLagSmoother::optimizerTimerCallback(const ros::TimerEvent& event) {
   }
 }
 
-void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
-                                    const ros::Time& lag_expiration) {
-  // We need to get the pending transactions from the queue
-  std::lock_guard<std::mutex> pending_transactions_lock(
-      pending_transactions_mutex_);
+void FixedLagSmoother::optimizeOnce(const ros::Time& optimization_deadline) {
+  if (transaction_inbox_.Empty() &&
+      (!started_ || num_pending_transactions_ == 0)) {
+    return;
+  }
 
+  std::unique_lock<std::mutex> lock(optimization_requested_mutex_);
+  const uint64_t cycle = completed_cycles_;
+  optimization_deadline_ = optimization_deadline;
+  optimization_request_ = true;
+  optimization_requested_.notify_one();
+  optimization_completed_.wait(lock, [this, cycle]() {
+    return completed_cycles_ > cycle || !optimization_running_ || !ros::ok();
+  });
+}
+
+void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
+                                    const ros::Time& lag_expiration,
+                                    bool low_priority) {
+  // Only the optimization thread accesses the pending transactions, so this
+  // does not block the transaction callbacks
   if (pending_transactions_.empty()) { return; }
 
   // If we just started because an ignition sensor transaction was received, we
@@ -362,7 +764,7 @@ void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
 
     const auto transaction_rbegin = pending_transactions_.rbegin();
     auto& element = *transaction_rbegin;
-    if (!sensor_models_.at(element.sensor_name).ignition) {
+    if (!isIgnitionSensor(element.sensor_name)) {
       // We just started, but the oldest transaction is not from an ignition
       // sensor. We will still process the transaction, but we do not enforce it
       // is processed individually.
@@ -377,6 +779,8 @@ void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
         // delete this one, and return, so the transaction from the ignition
         // sensor is processed individually.
         transaction.merge(*element.transaction, true);
+        traced_transactions_.emplace_back(element.stamp(),
+                                          element.receive_time);
         erase(pending_transactions_, transaction_rbegin);
       } else {
         // The motion model processing failed. When this happens to an ignition
@@ -395,7 +799,7 @@ void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
         const auto pending_ignition_transaction_iter = std::find_if(
             pending_transactions_.rbegin(), pending_transactions_.rend(),
             [this](const auto& element) { // NOLINT(whitespace/braces)
-              return sensor_models_.at(element.sensor_name).ignition;
+              return isIgnitionSensor(element.sensor_name);
             }); // NOLINT(whitespace/braces)
         if (pending_ignition_transaction_iter == pending_transactions_.rend()) {
           // There is no other ignition transaction pending. We simply roll back
@@ -414,6 +818,7 @@ void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
 
       // There are no more pending transactions to process in this optimization
       // cycle, or they should be processed in the next one.
+      num_pending_transactions_ = pending_transactions_.size();
       return;
     }
   }
@@ -443,10 +848,15 @@ void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
                          element.sensor_name) != sensor_blacklist.end()) {
       // We should not process transactions from this sensor
       ++transaction_riter;
+    } else if ((low_priority_sensors_.count(element.sensor_name) > 0) !=
+               low_priority) {
+      // The transaction is processed in the cycles of the other lane
+      ++transaction_riter;
     } else if (applyMotionModels(element.sensor_name, *element.transaction)) {
       // Processing was successful. Add the results to the final transaction,
       // delete this one, and move to the next.
       transaction.merge(*element.transaction, true);
+      traced_transactions_.emplace_back(element.stamp(), element.receive_time);
       transaction_riter = erase(pending_transactions_, transaction_riter);
     } else {
       // The motion model processing failed.
@@ -474,46 +884,92 @@ void FixedLagSmoother::processQueue(fuse_core::Transaction& transaction,
       }
     }
   }
+  num_pending_transactions_ = pending_transactions_.size();
+}
+
+bool FixedLagSmoother::isLowPriorityCycleDue(const ros::Time& now) const {
+  if (low_priority_sensors_.empty() ||
+      now < last_low_priority_cycle_ + low_priority_period_) {
+    return false;
+  }
+  return std::any_of(pending_transactions_.begin(), pending_transactions_.end(),
+                     [this](const TransactionQueueElement& element) {
+                       return low_priority_sensors_.count(element.sensor_name) >
+                              0;
+                     });
 }
 
 bool FixedLagSmoother::resetServiceCallback(std_srvs::Empty::Request&,
                                             std_srvs::Empty::Response&) {
   ROS_ERROR_STREAM("Reset service received! Resetting system...");
-  // Tell all the plugins to stop
-  stopPlugins();
-  // Reset the optimizer state
-  optimization_request_ = false;
-  started_ = false;
-  ignited_ = false;
-  setStartTime(ros::Time(0, 0));
-  // DANGER: The optimizationLoop() function obtains the lock
-  // optimization_mutex_ lock and the
-  //         pending_transactions_mutex_ lock at the same time. We perform a
-  //         parallel locking scheme here to prevent the possibility of
-  //         deadlocks.
-  {
-    std::lock_guard<std::mutex> lock(optimization_mutex_);
-    // Clear all pending transactions
-    {
-      std::lock_guard<std::mutex> lock(pending_transactions_mutex_);
-      pending_transactions_.clear();
-    }
-    // Clear the graph and marginal tracking states
-    graph_->clear();
-    marginal_transaction_ = fuse_core::Transaction();
-    timestamp_tracking_.clear();
-    lag_expiration_ = ros::Time(0, 0);
-  }
-  // Tell all the plugins to start
-  startPlugins();
-  // Test for auto-start
-  autostart();
-
+  reset();
   return true;
 }
 
 void FixedLagSmoother::resetCallback(const std_msgs::Empty::ConstPtr&) {
   ROS_ERROR_STREAM("Reset callback received! Resetting system...");
+  reset();
+}
+
+bool FixedLagSmoother::profilerEnableServiceCallback(
+    std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res) {
+  auto& profiler = bs_common::SamplingProfiler::GetInstance();
+  if (!req.data) {
+    profiler.Stop();
+    res.success = true;
+    res.message = std::to_string(profiler.NumSamples()) + " samples";
+    return true;
+  }
+  res.success = profiler.Running() || profiler.Start(profiler_params_);
+  res.message = "sampling " + std::to_string(profiler.Threads().size()) +
+                " threads at " + std::to_string(profiler_params_.rate_hz) +
+                " Hz";
+  ROS_INFO_STREAM("Profiler " << (res.success ? "started, " : "not started, ")
+                              << res.message);
+  return true;
+}
+
+bool FixedLagSmoother::profilerDumpServiceCallback(
+    std_srvs::Trigger::Request&, std_srvs::Trigger::Response& res) {
+  auto& profiler = bs_common::SamplingProfiler::GetInstance();
+  res.success = profiler.WriteFoldedStacks(profiler_output_path_);
+  res.message = profiler_output_path_;
+  if (res.success) {
+    ROS_INFO("Wrote %zu profiler samples to: %s", profiler.NumSamples(),
+             profiler_output_path_.c_str());
+    profiler.Clear();
+  }
+  return true;
+}
+
+void FixedLagSmoother::reset() {
+  // A fast reset right after another one means the restored state keeps
+  // failing, so everything is rebuilt instead
+  const ros::WallTime now = ros::WallTime::now();
+  const bool fast_reset =
+      fast_reset_ && (last_fast_reset_.isZero() ||
+                      now - last_fast_reset_ > fast_reset_min_period_);
+  std::optional<bs_common::ImuState> last_good_state;
+  if (fast_reset) {
+    last_fast_reset_ = now;
+    {
+      std::lock_guard<std::mutex> lock(optimization_mutex_);
+      std::swap(last_good_state, last_good_state_);
+    }
+    // the biases are re-estimated, since they may be why the models failed
+    if (last_good_state) {
+      last_good_state->SetGyroBias(Eigen::Vector3d::Zero());
+      last_good_state->SetAccelBias(Eigen::Vector3d::Zero());
+      ROS_INFO("Fast reset, re-igniting from the state at %.3f s",
+               last_good_state->Stamp().toSec());
+    } else {
+      ROS_INFO("Fast reset, no state to re-ignite from");
+    }
+    bs_common::ResetContext::GetInstance().BeginFastReset(last_good_state);
+  } else if (fast_reset_) {
+    ROS_WARN("Fast reset %.1f s after the previous one, resetting fully",
+             (now - last_fast_reset_).toSec());
+  }
   // Tell all the plugins to stop
   stopPlugins();
   // Reset the optimizer state
@@ -521,26 +977,47 @@ void FixedLagSmoother::resetCallback(const std_msgs::Empty::ConstPtr&) {
   started_ = false;
   ignited_ = false;
   setStartTime(ros::Time(0, 0));
-  // DANGER: The optimizationLoop() function obtains the lock
-  // optimization_mutex_ lock and the
-  //         pending_transactions_mutex_ lock at the same time. We perform a
-  //         parallel locking scheme here to prevent the possibility of
-  //         deadlocks.
+  // The optimizationLoop() function only accesses the pending transactions
+  // and consumes the transaction inbox while holding optimization_mutex_, so
+  // holding it here makes this the only consumer.
   {
     std::lock_guard<std::mutex> lock(optimization_mutex_);
-    // Clear all pending transactions
-    {
-      std::lock_guard<std::mutex> lock(pending_transactions_mutex_);
-      pending_transactions_.clear();
-    }
+    // Clear all pending transactions, containers keep their capacity
+    transaction_inbox_.Clear();
+    pending_transactions_.clear();
+    num_pending_transactions_ = 0;
     // Clear the graph and marginal tracking states
     graph_->clear();
+    snapshot_builder_.Clear();
+    incremental_problem_.Clear();
+    calibration_manager_.Clear();
+    cycle_costs_.clear();
+    run_low_priority_cycle_ = false;
+    last_low_priority_cycle_ = ros::Time(0, 0);
     marginal_transaction_ = fuse_core::Transaction();
-    timestamp_tracking_.clear();
+    timestamp_tracking_.Clear();
     lag_expiration_ = ros::Time(0, 0);
+    last_good_state_.reset();
+    overrun_cycles_ = 0;
+    on_time_cycles_ = 0;
+    // The back-pressure flag is latched, release it before the plugins
+    // subscribe again
+    if (backpressure_) {
+      backpressure_ = false;
+      std_msgs::Bool msg;
+      msg.data = false;
+      backpressure_publisher_.publish(msg);
+    }
+    // Sent while holding the lock, so that no graph update of the previous
+    // session follows it
+    if (remote_server_) {
+      remote_server_->PublishReset(fast_reset, last_good_state);
+    }
   }
-  // Tell all the plugins to start
+  // Tell all the plugins to start, the ignition sensor may re-ignite from the
+  // last good state
   startPlugins();
+  if (fast_reset) { bs_common::ResetContext::GetInstance().EndReset(); }
   // Test for auto-start
   autostart();
 }
@@ -559,10 +1036,19 @@ void FixedLagSmoother::transactionCallback(
         << max_time << ", difference: " << (start_time - max_time) << "s");
     return;
   }
-  {
-    // We need to add the new transaction to the pending_transactions_ queue
-    std::lock_guard<std::mutex> pending_transactions_lock(
-        pending_transactions_mutex_);
+  // This never blocks, the transaction is sorted into the pending queue by
+  // the optimization thread
+  transaction_inbox_.Push(
+      {sensor_name, std::move(transaction), ros::WallTime::now()});
+}
+
+void FixedLagSmoother::drainTransactionInbox() {
+  for (auto& element : transaction_inbox_.PopAll()) {
+    // The start time may have changed since this was received
+    const std::string sensor_name = element.sensor_name;
+    const auto max_time = element.maxStamp();
+    auto start_time = getStartTime();
+    if (started_ && max_time < start_time) { continue; }
 
     // Add the new transaction to the pending set
     // The pending set is arranged "smallest stamp last" to making popping off
@@ -573,14 +1059,13 @@ void FixedLagSmoother::transactionCallback(
     };
     auto position = std::upper_bound(pending_transactions_.begin(),
                                      pending_transactions_.end(),
-                                     transaction->stamp(), comparator);
-    position = pending_transactions_.insert(
-        position, {sensor_name, std::move(transaction)}); // NOLINT
+                                     element.stamp(), comparator);
+    position = pending_transactions_.insert(position, std::move(element));
 
     // If we haven't "started" yet..
     if (!started_) {
       // ...check if we should
-      if (sensor_models_.at(sensor_name).ignition) {
+      if (isIgnitionSensor(sensor_name)) {
         started_ = true;
         ignited_ = true;
         start_time = position->minStamp();
@@ -624,6 +1109,7 @@ void FixedLagSmoother::transactionCallback(
       }
     }
   }
+  num_pending_transactions_ = pending_transactions_.size();
 }
 
 /**
@@ -682,10 +1168,9 @@ void FixedLagSmoother::setDiagnostics(
   const bool started = started_;
 
   status.add("Started", started);
-  {
-    std::lock_guard<std::mutex> lock(pending_transactions_mutex_);
-    status.add("Pending Transactions", pending_transactions_.size());
-  }
+  status.add("Backpressure", static_cast<bool>(backpressure_));
+  status.add("Pending Transactions",
+             static_cast<size_t>(num_pending_transactions_));
 
   if (started) {
     // Add some optimization summary report fields to the diagnostics status if
@@ -737,6 +1222,76 @@ void FixedLagSmoother::setDiagnostics(
                  time_since_last_optimization_request.toSec());
     }
   }
+
+  // Add latency metrics of all instrumented components in this process
+  const auto metrics = bs_common::Instrumentation::GetInstance().Summarize();
+  for (const auto& metric : metrics) {
+    if (metric.count == 0 && metric.counter == 0) { continue; }
+    status.add(metric.name + " Count", metric.count);
+    if (metric.counter > 0) {
+      status.add(metric.name + " Counter", metric.counter);
+    }
+    status.add(metric.name + " Mean [ms]", 1e3 * metric.mean_s);
+    status.add(metric.name + " p50 [ms]", 1e3 * metric.p50_s);
+    status.add(metric.name + " p99 [ms]", 1e3 * metric.p99_s);
+    status.add(metric.name + " Max [ms]", 1e3 * metric.max_s);
+  }
+
+  // Add memory of all accounted components in this process
+  const auto accounts = bs_common::MemoryAccounting::GetInstance().Summarize();
+  for (const auto& account : accounts) {
+    const std::string name = "memory/" + account.name;
+    status.add(name + " Elements", account.elements);
+    status.add(name + " [MB]", account.bytes / (1024.0 * 1024.0));
+    if (account.budget_bytes == 0) { continue; }
+    status.add(name + " Budget [MB]", account.budget_bytes / (1024.0 * 1024.0));
+    if (account.bytes > account.budget_bytes) {
+      status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN,
+                          account.name + " over memory budget");
+    }
+  }
+
+  // Add the load of the shared task scheduler since the last diagnostics
+  const auto scheduler_stats =
+      bs_common::TaskScheduler::GetInstance().GetStats();
+  status.add("task_scheduler Threads", scheduler_stats.num_threads);
+  const double elapsed_s =
+      scheduler_stats.uptime_s >= last_scheduler_stats_.uptime_s
+          ? scheduler_stats.uptime_s - last_scheduler_stats_.uptime_s
+          : scheduler_stats.uptime_s;
+  const std::array<std::string, 2> priority_names{"realtime", "background"};
+  for (int p = 0; p < bs_common::TaskScheduler::kNumPriorities; p++) {
+    const std::string name = "task_scheduler/" + priority_names[p];
+    status.add(name + " Tasks", scheduler_stats.tasks_run[p]);
+    status.add(name + " Queued", scheduler_stats.tasks_queued[p]);
+    const double busy_s =
+        scheduler_stats.busy_s[p] - last_scheduler_stats_.busy_s[p];
+    if (elapsed_s > 0 && busy_s >= 0) {
+      status.add(name + " Utilization [%]",
+                 100 * busy_s / (elapsed_s * scheduler_stats.num_threads));
+    }
+  }
+  last_scheduler_stats_ = scheduler_stats;
+}
+
+void FixedLagSmoother::updateGraphMemoryAccount() {
+  static bs_common::MemoryAccount& account =
+      bs_common::MemoryAccounting::GetInstance().GetAccount(
+          "fixed_lag_smoother/graph");
+  // the graph is bounded by the lag, so it is only reported. This does not
+  // include the ceres problem
+  uint64_t num_elements{0};
+  uint64_t bytes{0};
+  for (const auto& variable : graph_->getVariables()) {
+    num_elements++;
+    bytes += sizeof(fuse_core::Variable) + variable.size() * sizeof(double);
+  }
+  for (const auto& constraint : graph_->getConstraints()) {
+    num_elements++;
+    bytes += sizeof(fuse_core::Constraint) +
+             constraint.variables().size() * sizeof(fuse_core::UUID);
+  }
+  account.Update(num_elements, bytes);
 }
 
 bs_common::ImuState FixedLagSmoother::GetWindowStartState() {
@@ -751,49 +1306,142 @@ bs_common::ImuState FixedLagSmoother::GetWindowStartState() {
       first_window_time = position->stamp();
     }
   }
-  bs_common::ImuState first_window_state(first_window_time);
 
   try {
-    // get position
-    auto position = fuse_variables::Position3DStamped::make_shared();
-    const auto pos_uuid = fuse_core::uuid::generate(
-        position->type(), first_window_time, fuse_core::uuid::NIL);
-    *position = dynamic_cast<const fuse_variables::Position3DStamped&>(
-        graph_->getVariable(pos_uuid));
-    // get orientation
-    auto orientation = fuse_variables::Orientation3DStamped::make_shared();
-    const auto or_uuid = fuse_core::uuid::generate(
-        orientation->type(), first_window_time, fuse_core::uuid::NIL);
-    *orientation = dynamic_cast<const fuse_variables::Orientation3DStamped&>(
-        graph_->getVariable(or_uuid));
-    // get velocity
-    auto velocity = fuse_variables::VelocityLinear3DStamped::make_shared();
-    const auto vel_uuid = fuse_core::uuid::generate(
-        velocity->type(), first_window_time, fuse_core::uuid::NIL);
-    *velocity = dynamic_cast<const fuse_variables::VelocityLinear3DStamped&>(
-        graph_->getVariable(vel_uuid));
-    // get accel bias
-    auto accel_bias = bs_variables::AccelerationBias3DStamped::make_shared();
-    const auto ba_uuid = fuse_core::uuid::generate(
-        accel_bias->type(), first_window_time, fuse_core::uuid::NIL);
-    *accel_bias = dynamic_cast<const bs_variables::AccelerationBias3DStamped&>(
-        graph_->getVariable(ba_uuid));
-    // get gyro bias
-    auto gyro_bias = bs_variables::GyroscopeBias3DStamped::make_shared();
-    const auto bg_uuid = fuse_core::uuid::generate(
-        gyro_bias->type(), first_window_time, fuse_core::uuid::NIL);
-    *gyro_bias = dynamic_cast<const bs_variables::GyroscopeBias3DStamped&>(
-        graph_->getVariable(bg_uuid));
-    first_window_state.SetPosition(*position);
-    first_window_state.SetOrientation(*orientation);
-    first_window_state.SetVelocity(*velocity);
-    first_window_state.SetAccelBias(*accel_bias);
-    first_window_state.SetGyroBias(*gyro_bias);
-    return first_window_state;
+    return getImuState(first_window_time);
   } catch (const std::out_of_range& oor) {
     throw std::out_of_range(
         "Invalid start state of new graph, not all imu state variables exist.");
   }
 }
 
+bs_common::ImuState
+    FixedLagSmoother::getImuState(const ros::Time& stamp) const {
+  bs_common::ImuState state(stamp);
+  // get position
+  auto position = fuse_variables::Position3DStamped::make_shared();
+  const auto pos_uuid =
+      fuse_core::uuid::generate(position->type(), stamp, fuse_core::uuid::NIL);
+  *position = dynamic_cast<const fuse_variables::Position3DStamped&>(
+      graph_->getVariable(pos_uuid));
+  // get orientation
+  auto orientation = fuse_variables::Orientation3DStamped::make_shared();
+  const auto or_uuid = fuse_core::uuid::generate(orientation->type(), stamp,
+                                                 fuse_core::uuid::NIL);
+  *orientation = dynamic_cast<const fuse_variables::Orientation3DStamped&>(
+      graph_->getVariable(or_uuid));
+  // get velocity
+  auto velocity = fuse_variables::VelocityLinear3DStamped::make_shared();
+  const auto vel_uuid =
+      fuse_core::uuid::generate(velocity->type(), stamp, fuse_core::uuid::NIL);
+  *velocity = dynamic_cast<const fuse_variables::VelocityLinear3DStamped&>(
+      graph_->getVariable(vel_uuid));
+  // get accel bias
+  auto accel_bias = bs_variables::AccelerationBias3DStamped::make_shared();
+  const auto ba_uuid = fuse_core::uuid::generate(accel_bias->type(), stamp,
+                                                 fuse_core::uuid::NIL);
+  *accel_bias = dynamic_cast<const bs_variables::AccelerationBias3DStamped&>(
+      graph_->getVariable(ba_uuid));
+  // get gyro bias
+  auto gyro_bias = bs_variables::GyroscopeBias3DStamped::make_shared();
+  const auto bg_uuid =
+      fuse_core::uuid::generate(gyro_bias->type(), stamp, fuse_core::uuid::NIL);
+  *gyro_bias = dynamic_cast<const bs_variables::GyroscopeBias3DStamped&>(
+      graph_->getVariable(bg_uuid));
+  state.SetPosition(*position);
+  state.SetOrientation(*orientation);
+  state.SetVelocity(*velocity);
+  state.SetAccelBias(*accel_bias);
+  state.SetGyroBias(*gyro_bias);
+  return state;
+}
+
+std::optional<bs_common::ImuState>
+    FixedLagSmoother::getNewestImuState() const {
+  try {
+    return getImuState(timestamp_tracking_.CurrentStamp());
+  } catch (const std::out_of_range&) { return std::nullopt; }
+}
+
+std::shared_ptr<ceres::ParameterBlockOrdering>
+    FixedLagSmoother::computeLandmarkOrdering() {
+  auto ordering = std::make_shared<ceres::ParameterBlockOrdering>();
+  bool has_landmarks = false;
+  for (const auto& v : graph_->getVariables()) {
+    // the graph builds its problem directly from the variable data, so these
+    // are the parameter block pointers seen by ceres
+    double* data = const_cast<double*>(v.data());
+    const std::string type = v.type();
+    if (type == "bs_variables::Point3DLandmark" ||
+        type == "bs_variables::InverseDepthLandmark") {
+      ordering->AddElementToGroup(data, 0);
+      has_landmarks = true;
+    } else {
+      ordering->AddElementToGroup(data, 1);
+    }
+  }
+  if (!has_landmarks) { return nullptr; }
+  return ordering;
+}
+
+void FixedLagSmoother::applyRealtimeLimits(
+    const ros::Time& optimization_deadline,
+    ceres::Solver::Options& solver_options) const {
+  // always leave the solver some time, using the previous solution is
+  // preferred over skipping the optimization entirely
+  const double min_solver_time = 0.1 * params_.optimization_period.toSec();
+  const double time_left = (optimization_deadline - ros::Time::now()).toSec();
+  const double solver_time = std::max(time_left, min_solver_time);
+  solver_options.max_solver_time_in_seconds =
+      std::min(solver_options.max_solver_time_in_seconds, solver_time);
+
+  double total_time{0};
+  int total_iterations{0};
+  for (const auto& [time, iterations] : cycle_costs_) {
+    total_time += time;
+    total_iterations += iterations;
+  }
+  if (total_iterations == 0 || total_time <= 0) { return; }
+  const double time_per_iteration = total_time / total_iterations;
+  const int max_iterations =
+      std::max(1, static_cast<int>(solver_time / time_per_iteration));
+  solver_options.max_num_iterations =
+      std::min(solver_options.max_num_iterations, max_iterations);
+}
+
+void FixedLagSmoother::updateBackpressure(bool deadline_exceeded) {
+  if (backpressure_cycles_ <= 0) { return; }
+
+  const size_t num_pending = pending_transactions_.size();
+  const bool behind =
+      deadline_exceeded ||
+      num_pending > static_cast<size_t>(backpressure_max_pending_);
+  if (behind) {
+    overrun_cycles_++;
+    on_time_cycles_ = 0;
+  } else {
+    on_time_cycles_++;
+    overrun_cycles_ = 0;
+  }
+
+  bool backpressure = backpressure_;
+  if (!backpressure && overrun_cycles_ >= backpressure_cycles_) {
+    ROS_WARN_STREAM("Optimizer is falling behind ("
+                    << num_pending
+                    << " pending transactions), requesting sensor models "
+                       "to reduce their keyframe rate.");
+    backpressure = true;
+  } else if (backpressure && on_time_cycles_ >= backpressure_cycles_) {
+    ROS_INFO("Optimizer caught up, releasing back-pressure.");
+    backpressure = false;
+  } else {
+    return;
+  }
+
+  backpressure_ = backpressure;
+  std_msgs::Bool msg;
+  msg.data = backpressure;
+  backpressure_publisher_.publish(msg);
+}
+
 } // namespace bs_optimizers
@@ -0,0 +1,98 @@
+#include <bs_optimizers/graph_snapshot_builder.h>
+
+#include <algorithm>
+
+#include <fuse_variables/position_3d_stamped.h>
+
+namespace bs_optimizers {
+
+bs_common::GraphSnapshot::ConstSharedPtr
+    GraphSnapshotBuilder::Build(const fuse_core::Graph& graph) {
+  auto snapshot = bs_common::GraphSnapshot::make_shared();
+  bs_common::GraphDelta& delta = snapshot->DeltaMutable();
+
+  // add variables, only cloning the ones that are new or have changed
+  std::unordered_map<fuse_core::UUID, fuse_core::Variable::SharedPtr,
+                     fuse_core::uuid::hash>
+      variables;
+  variables.reserve(variables_.size());
+  std::vector<ros::Time> added_stamps;
+  std::vector<ros::Time> removed_stamps;
+  for (const auto& variable : graph.getVariables()) {
+    const fuse_core::UUID& uuid = variable.uuid();
+    fuse_core::Variable::SharedPtr shared_variable;
+    auto iter = variables_.find(uuid);
+    if (iter == variables_.end()) {
+      shared_variable = variable.clone();
+      delta.added_variables.push_back(uuid);
+      const auto position =
+          dynamic_cast<const fuse_variables::Position3DStamped*>(&variable);
+      if (position) { added_stamps.push_back(position->stamp()); }
+    } else if (!HasSameValue(*iter->second, variable)) {
+      shared_variable = variable.clone();
+      delta.changed_variables.push_back(uuid);
+    } else {
+      shared_variable = iter->second;
+    }
+    snapshot->addVariable(shared_variable);
+    if (graph.isVariableOnHold(uuid)) { snapshot->holdVariable(uuid, true); }
+    variables.emplace(uuid, std::move(shared_variable));
+  }
+
+  for (const auto& [uuid, variable] : variables_) {
+    if (variables.find(uuid) == variables.end()) {
+      delta.removed_variables.push_back(uuid);
+      const auto position =
+          dynamic_cast<const fuse_variables::Position3DStamped*>(
+              variable.get());
+      if (position) { removed_stamps.push_back(position->stamp()); }
+    }
+  }
+
+  // the index of the previous snapshot can't be modified, so it is only
+  // copied if pose states were added or removed
+  if (!added_stamps.empty() || !removed_stamps.empty()) {
+    auto stamps = bs_common::StampIndex::make_shared(*stamps_);
+    for (const auto& stamp : added_stamps) { stamps->Insert(stamp); }
+    for (const auto& stamp : removed_stamps) { stamps->Erase(stamp); }
+    stamps_ = std::move(stamps);
+  }
+  snapshot->SetStamps(stamps_);
+  variables_ = std::move(variables);
+
+  // add constraints, these are immutable so we only clone new ones
+  std::unordered_map<fuse_core::UUID, fuse_core::Constraint::SharedPtr,
+                     fuse_core::uuid::hash>
+      constraints;
+  constraints.reserve(constraints_.size());
+  for (const auto& constraint : graph.getConstraints()) {
+    const fuse_core::UUID& uuid = constraint.uuid();
+    fuse_core::Constraint::SharedPtr shared_constraint;
+    auto iter = constraints_.find(uuid);
+    if (iter == constraints_.end()) {
+      shared_constraint = constraint.clone();
+    } else {
+      shared_constraint = iter->second;
+    }
+    snapshot->addConstraint(shared_constraint);
+    constraints.emplace(uuid, std::move(shared_constraint));
+  }
+  constraints_ = std::move(constraints);
+
+  delta.BuildIndex();
+  return snapshot;
+}
+
+void GraphSnapshotBuilder::Clear() {
+  variables_.clear();
+  constraints_.clear();
+  stamps_ = bs_common::StampIndex::make_shared();
+}
+
+bool GraphSnapshotBuilder::HasSameValue(const fuse_core::Variable& v1,
+                                        const fuse_core::Variable& v2) const {
+  if (v1.size() != v2.size()) { return false; }
+  return std::equal(v1.data(), v1.data() + v1.size(), v2.data());
+}
+
+} // namespace bs_optimizers
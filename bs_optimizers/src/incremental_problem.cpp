@@ -0,0 +1,145 @@
+#include <bs_optimizers/incremental_problem.h>
+
+#include <limits>
+#include <vector>
+
+#include <fuse_core/loss.h>
+#include <ros/console.h>
+
+namespace bs_optimizers {
+
+IncrementalProblem::IncrementalProblem() {
+  // same ownership as fuse_graphs::HashGraph: cost functions and local
+  // parameterizations are created for the problem, loss functions are owned by
+  // the constraints
+  problem_options_.enable_fast_removal = true;
+  problem_options_.loss_function_ownership = fuse_core::Loss::Ownership;
+  problem_ = std::make_unique<ceres::Problem>(problem_options_);
+}
+
+void IncrementalProblem::Update(const fuse_core::Graph& graph,
+                                const fuse_core::Transaction& transaction) {
+  // constraints need to be removed before the variables they depend on
+  for (const auto& uuid : transaction.removedConstraints()) {
+    auto iter = constraints_.find(uuid);
+    if (iter == constraints_.end() || graph.constraintExists(uuid)) {
+      continue;
+    }
+    problem_->RemoveResidualBlock(iter->second);
+    constraints_.erase(iter);
+  }
+
+  // the variable memory may already be released at this point, that's ok
+  // because ceres only uses the pointer as a key when removing
+  for (const auto& uuid : transaction.removedVariables()) {
+    auto iter = variables_.find(uuid);
+    if (iter == variables_.end() || graph.variableExists(uuid)) { continue; }
+    problem_->RemoveParameterBlock(iter->second);
+    variables_.erase(iter);
+  }
+
+  // use the variables stored in the graph since the graph doesn't replace
+  // variables that already exist
+  for (const auto& variable : transaction.addedVariables()) {
+    const fuse_core::UUID& uuid = variable.uuid();
+    if (variables_.find(uuid) != variables_.end() ||
+        !graph.variableExists(uuid)) {
+      continue;
+    }
+    AddVariable(graph, graph.getVariable(uuid));
+  }
+
+  for (const auto& constraint : transaction.addedConstraints()) {
+    const fuse_core::UUID& uuid = constraint.uuid();
+    if (constraints_.find(uuid) != constraints_.end() ||
+        !graph.constraintExists(uuid)) {
+      continue;
+    }
+    AddConstraint(graph, graph.getConstraint(uuid));
+  }
+
+  // holds are not part of transactions, so check all of them
+  for (const auto& [uuid, data] : variables_) {
+    const bool on_hold = graph.isVariableOnHold(uuid);
+    if (on_hold == problem_->IsParameterBlockConstant(data)) { continue; }
+    if (on_hold) {
+      problem_->SetParameterBlockConstant(data);
+    } else {
+      problem_->SetParameterBlockVariable(data);
+    }
+  }
+}
+
+ceres::Solver::Summary
+    IncrementalProblem::Optimize(const ceres::Solver::Options& options) {
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, problem_.get(), &summary);
+  return summary;
+}
+
+void IncrementalProblem::Clear() {
+  constraints_.clear();
+  variables_.clear();
+  problem_ = std::make_unique<ceres::Problem>(problem_options_);
+}
+
+void IncrementalProblem::Rebuild(const fuse_core::Graph& graph) {
+  Clear();
+  for (const auto& variable : graph.getVariables()) {
+    AddVariable(graph, variable);
+  }
+  for (const auto& constraint : graph.getConstraints()) {
+    AddConstraint(graph, constraint);
+  }
+}
+
+void IncrementalProblem::AddVariable(const fuse_core::Graph& graph,
+                                     const fuse_core::Variable& variable) {
+  // the graph is the only owner of its variables and it is not const in the
+  // optimizer, we need mutable access for ceres to write the solution
+  double* data = const_cast<double*>(variable.data());
+  problem_->AddParameterBlock(data, variable.size(),
+                              variable.localParameterization());
+  for (size_t index = 0; index < variable.size(); ++index) {
+    const double lower_bound = variable.lowerBound(index);
+    if (lower_bound > std::numeric_limits<double>::lowest()) {
+      problem_->SetParameterLowerBound(data, index, lower_bound);
+    }
+    const double upper_bound = variable.upperBound(index);
+    if (upper_bound < std::numeric_limits<double>::max()) {
+      problem_->SetParameterUpperBound(data, index, upper_bound);
+    }
+  }
+  if (graph.isVariableOnHold(variable.uuid())) {
+    problem_->SetParameterBlockConstant(data);
+  }
+  variables_.emplace(variable.uuid(), data);
+}
+
+void IncrementalProblem::AddConstraint(
+    const fuse_core::Graph& graph, const fuse_core::Constraint& constraint) {
+  std::vector<double*> parameter_blocks;
+  parameter_blocks.reserve(constraint.variables().size());
+  for (const auto& uuid : constraint.variables()) {
+    auto iter = variables_.find(uuid);
+    if (iter == variables_.end()) {
+      // this can only happen if the variable was added to the graph without
+      // going through Update
+      ROS_WARN_STREAM("Variable " << fuse_core::uuid::to_string(uuid)
+                                  << " of constraint "
+                                  << fuse_core::uuid::to_string(
+                                         constraint.uuid())
+                                  << " is not in the incremental problem, "
+                                     "adding it.");
+      AddVariable(graph, graph.getVariable(uuid));
+      iter = variables_.find(uuid);
+    }
+    parameter_blocks.push_back(iter->second);
+  }
+  constraints_.emplace(constraint.uuid(),
+                       problem_->AddResidualBlock(constraint.costFunction(),
+                                                  constraint.lossFunction(),
+                                                  parameter_blocks));
+}
+
+} // namespace bs_optimizers
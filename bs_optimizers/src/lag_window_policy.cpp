@@ -0,0 +1,77 @@
+#include <bs_optimizers/lag_window_policy.h>
+
+#include <algorithm>
+
+namespace bs_optimizers {
+
+namespace {
+
+/**
+ * @brief now - duration, but never before the start time. ROS Time objects do
+ * not handle negative values.
+ */
+ros::Time WindowStart(const ros::Time& start_time, const ros::Time& now,
+                      const ros::Duration& duration) {
+  return (start_time + duration < now) ? now - duration : start_time;
+}
+
+} // namespace
+
+FixedLagWindowPolicy::FixedLagWindowPolicy(const ros::Duration& lag_duration)
+    : lag_duration_(lag_duration) {}
+
+ros::Time
+    FixedLagWindowPolicy::LagExpiration(const ros::Time& start_time,
+                                        const ros::Time& now,
+                                        const WindowStates& states) const {
+  return WindowStart(start_time, now, lag_duration_);
+}
+
+InformationLagWindowPolicy::InformationLagWindowPolicy(const Params& params)
+    : params_(params) {
+  params_.min_lag_duration =
+      std::min(params_.min_lag_duration, params_.lag_duration);
+  params_.min_translation = std::max(params_.min_translation, 1e-6);
+  params_.min_rotation_deg = std::max(params_.min_rotation_deg, 1e-6);
+}
+
+ros::Time InformationLagWindowPolicy::LagExpiration(
+    const ros::Time& start_time, const ros::Time& now,
+    const WindowStates& states) const {
+  const ros::Time max_start =
+      WindowStart(start_time, now, params_.min_lag_duration);
+  const ros::Time min_start =
+      WindowStart(start_time, now, params_.lag_duration);
+  if (states.empty()) { return min_start; }
+
+  // walk back from the newest state, each older state adds the motion to the
+  // one after it. The window starts at the last state kept
+  double information = 0;
+  int num_states = 1;
+  for (size_t i = states.size() - 1; i > 0; i--) {
+    const WindowState& state = states[i - 1];
+    if (state.stamp < min_start) { break; }
+    const double state_information = Information(state, states[i]);
+    information += state_information;
+    num_states++;
+    if (state.stamp >= max_start) { continue; }
+    if (state_information < 1 ||
+        (params_.information_budget > 0 &&
+         information > params_.information_budget) ||
+        (params_.max_states > 0 && num_states > params_.max_states)) {
+      return std::min(states[i].stamp, max_start);
+    }
+  }
+  return min_start;
+}
+
+double InformationLagWindowPolicy::Information(const WindowState& state,
+                                               const WindowState& next) const {
+  const double translation = (next.position - state.position).norm();
+  const double rotation_deg =
+      state.orientation.angularDistance(next.orientation) * 180.0 / M_PI;
+  return translation / params_.min_translation +
+         rotation_deg / params_.min_rotation_deg;
+}
+
+} // namespace bs_optimizers
@@ -0,0 +1,183 @@
+#include <bs_optimizers/marginalization_index.h>
+
+#include <algorithm>
+
+#include <fuse_variables/stamped.h>
+
+namespace bs_optimizers {
+
+void MarginalizationIndex::AddNewTransaction(
+    const fuse_core::Transaction& transaction) {
+  ApplyTransaction(transaction, false);
+}
+
+void MarginalizationIndex::AddMarginalTransaction(
+    const fuse_core::Transaction& transaction) {
+  ApplyTransaction(transaction, true);
+}
+
+ros::Time MarginalizationIndex::CurrentStamp() const {
+  if (stamps_.empty()) { return ros::Time(0, 0); }
+  return stamps_.rbegin()->first;
+}
+
+std::vector<fuse_core::UUID>
+    MarginalizationIndex::Query(const ros::Time& lag_expiration) const {
+  // candidates are all variables before the window, all variables they are
+  // connected to, and all unstamped variables not connected to any stamped
+  // variable. Everything else is either in the window or connected to a
+  // variable in the window.
+  UUIDSet candidates;
+  for (auto iter = stamps_.begin();
+       iter != stamps_.end() && iter->first < lag_expiration; iter++) {
+    for (const auto& uuid : iter->second) {
+      candidates.insert(uuid);
+      for (const auto& constraint : variables_.at(uuid).constraints) {
+        for (const auto& connected : constraints_.at(constraint).variables) {
+          candidates.insert(connected);
+        }
+      }
+    }
+  }
+  candidates.insert(orphans_.begin(), orphans_.end());
+
+  std::vector<fuse_core::UUID> to_marginalize;
+  for (const auto& uuid : candidates) {
+    if (!IsInWindow(uuid, lag_expiration) &&
+        !IsConnectedToWindow(uuid, lag_expiration)) {
+      to_marginalize.push_back(uuid);
+    }
+  }
+  return to_marginalize;
+}
+
+const MarginalizationIndex::UUIDSet& MarginalizationIndex::ConnectedConstraints(
+    const fuse_core::UUID& variable) const {
+  static const UUIDSet empty;
+  auto iter = variables_.find(variable);
+  if (iter == variables_.end()) { return empty; }
+  return iter->second.constraints;
+}
+
+std::vector<fuse_core::UUID> MarginalizationIndex::ConnectedConstraints(
+    const std::vector<fuse_core::UUID>& variables) const {
+  UUIDSet added;
+  std::vector<fuse_core::UUID> constraints;
+  for (const auto& variable : variables) {
+    for (const auto& constraint : ConnectedConstraints(variable)) {
+      if (added.insert(constraint).second) {
+        constraints.push_back(constraint);
+      }
+    }
+  }
+  return constraints;
+}
+
+void MarginalizationIndex::Clear() {
+  stamps_.clear();
+  variables_.clear();
+  constraints_.clear();
+  orphans_.clear();
+}
+
+void MarginalizationIndex::ApplyTransaction(
+    const fuse_core::Transaction& transaction, bool marginal) {
+  // same order as fuse_core::Graph::update
+  for (const auto& variable : transaction.addedVariables()) {
+    const fuse_core::UUID& uuid = variable.uuid();
+    VariableInfo& info = variables_[uuid];
+    if (info.stamped) { continue; }
+    const auto stamped =
+        dynamic_cast<const fuse_variables::Stamped*>(&variable);
+    if (stamped) {
+      info.stamped = true;
+      info.stamp = stamped->stamp();
+      stamps_[info.stamp].insert(uuid);
+      orphans_.erase(uuid);
+    } else if (info.num_stamped_constraints == 0) {
+      orphans_.insert(uuid);
+    }
+  }
+
+  for (const auto& constraint : transaction.addedConstraints()) {
+    const fuse_core::UUID& uuid = constraint.uuid();
+    if (constraints_.find(uuid) != constraints_.end()) { continue; }
+    ConstraintInfo& info = constraints_[uuid];
+    info.marginal = marginal;
+    info.variables = constraint.variables();
+    info.stamped =
+        !marginal &&
+        std::any_of(info.variables.begin(), info.variables.end(),
+                    [this](const fuse_core::UUID& variable_uuid) {
+                      auto iter = variables_.find(variable_uuid);
+                      return iter != variables_.end() && iter->second.stamped;
+                    });
+    for (const auto& variable_uuid : info.variables) {
+      VariableInfo& variable = variables_[variable_uuid];
+      if (!variable.constraints.insert(uuid).second) { continue; }
+      if (info.stamped && !variable.stamped &&
+          variable.num_stamped_constraints++ == 0) {
+        orphans_.erase(variable_uuid);
+      }
+    }
+  }
+
+  for (const auto& uuid : transaction.removedConstraints()) {
+    RemoveConstraint(uuid);
+  }
+
+  for (const auto& uuid : transaction.removedVariables()) {
+    RemoveVariable(uuid);
+  }
+}
+
+void MarginalizationIndex::RemoveConstraint(const fuse_core::UUID& uuid) {
+  auto iter = constraints_.find(uuid);
+  if (iter == constraints_.end()) { return; }
+  for (const auto& variable_uuid : iter->second.variables) {
+    auto variable_iter = variables_.find(variable_uuid);
+    if (variable_iter == variables_.end()) { continue; }
+    VariableInfo& variable = variable_iter->second;
+    if (variable.constraints.erase(uuid) == 0) { continue; }
+    if (iter->second.stamped && !variable.stamped &&
+        --variable.num_stamped_constraints == 0) {
+      orphans_.insert(variable_uuid);
+    }
+  }
+  constraints_.erase(iter);
+}
+
+void MarginalizationIndex::RemoveVariable(const fuse_core::UUID& uuid) {
+  auto iter = variables_.find(uuid);
+  if (iter == variables_.end()) { return; }
+  if (iter->second.stamped) {
+    auto stamp_iter = stamps_.find(iter->second.stamp);
+    stamp_iter->second.erase(uuid);
+    if (stamp_iter->second.empty()) { stamps_.erase(stamp_iter); }
+  }
+  orphans_.erase(uuid);
+  variables_.erase(iter);
+}
+
+bool MarginalizationIndex::IsInWindow(const fuse_core::UUID& variable,
+                                      const ros::Time& lag_expiration) const {
+  auto iter = variables_.find(variable);
+  if (iter == variables_.end()) { return false; }
+  return iter->second.stamped && iter->second.stamp >= lag_expiration;
+}
+
+bool MarginalizationIndex::IsConnectedToWindow(
+    const fuse_core::UUID& variable, const ros::Time& lag_expiration) const {
+  auto iter = variables_.find(variable);
+  if (iter == variables_.end()) { return false; }
+  for (const auto& constraint_uuid : iter->second.constraints) {
+    const ConstraintInfo& constraint = constraints_.at(constraint_uuid);
+    if (constraint.marginal) { continue; }
+    for (const auto& connected : constraint.variables) {
+      if (IsInWindow(connected, lag_expiration)) { return true; }
+    }
+  }
+  return false;
+}
+
+} // namespace bs_optimizers
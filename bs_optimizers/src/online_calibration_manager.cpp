@@ -0,0 +1,163 @@
+#include <bs_optimizers/online_calibration_manager.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <Eigen/Dense>
+#include <ros/console.h>
+
+namespace bs_optimizers {
+
+namespace {
+
+const std::string kPositionType = "bs_variables::Position3D";
+const std::string kOrientationType = "bs_variables::Orientation3D";
+
+} // namespace
+
+OnlineCalibrationManager::OnlineCalibrationManager(const Params& params)
+    : params_(params) {
+  if (params_.convergence_cycles < 1 || params_.probe_cycles < 1) {
+    ROS_ERROR("Online calibration convergence_cycles and probe_cycles must be "
+              "at least 1");
+    throw std::invalid_argument{"invalid online calibration params"};
+  }
+}
+
+bool OnlineCalibrationManager::Update(fuse_core::Graph& graph) {
+  if (!params_.enabled) { return false; }
+
+  bool changed = false;
+  std::unordered_map<fuse_core::UUID, VariableState, fuse_core::uuid::hash>
+      states;
+  for (const auto& variable : graph.getVariables()) {
+    const bool is_position = variable.type() == kPositionType;
+    if (!is_position && variable.type() != kOrientationType) { continue; }
+
+    const fuse_core::UUID& uuid = variable.uuid();
+    const std::vector<double> value(variable.data(),
+                                    variable.data() + variable.size());
+    auto iter = states_.find(uuid);
+    if (iter == states_.end()) {
+      VariableState state;
+      state.is_position = is_position;
+      state.last_value = value;
+      if (graph.isVariableOnHold(uuid)) { state.status = Status::EXTERNAL; }
+      states.emplace(uuid, std::move(state));
+      continue;
+    }
+
+    VariableState state = std::move(iter->second);
+    const double change = Change(is_position, state.last_value, value);
+    state.last_value = value;
+    auto name = [&variable]() {
+      return variable.type() + " " +
+             fuse_core::uuid::to_string(variable.uuid());
+    };
+    switch (state.status) {
+      case Status::EXTERNAL:
+        break;
+      case Status::HELD:
+        state.cycles++;
+        if (params_.probe_period > 0 && state.cycles >= params_.probe_period) {
+          graph.holdVariable(uuid, false);
+          state.status = Status::PROBING;
+          state.cycles = 0;
+          changed = true;
+        }
+        break;
+      case Status::PROBING: {
+        state.cycles++;
+        const double drift = Change(is_position, state.held_value, value);
+        const double max_drift = is_position ? params_.drift_translation
+                                             : params_.drift_rotation_deg;
+        if (drift > max_drift) {
+          ROS_WARN("Extrinsics %s drifted by %.4f since they were held, "
+                   "estimating them again",
+                   name().c_str(), drift);
+          state.status = Status::FREE;
+          state.cycles = 0;
+        } else if (state.cycles >= params_.probe_cycles) {
+          graph.holdVariable(uuid, true);
+          state.status = Status::HELD;
+          state.cycles = 0;
+          changed = true;
+        }
+        break;
+      }
+      case Status::FREE: {
+        const double max_change = is_position
+                                      ? params_.max_translation_change
+                                      : params_.max_rotation_change_deg;
+        state.cycles = change <= max_change ? state.cycles + 1 : 0;
+        if (state.cycles < params_.convergence_cycles) { break; }
+        // the covariance is only computed once the value is stable, and
+        // again after another convergence_cycles if it is not certain yet
+        state.cycles = 0;
+        if (!IsCertain(graph, uuid, is_position)) { break; }
+        ROS_INFO("Extrinsics %s converged, holding them", name().c_str());
+        graph.holdVariable(uuid, true);
+        state.status = Status::HELD;
+        state.held_value = value;
+        changed = true;
+        break;
+      }
+    }
+    states.emplace(uuid, std::move(state));
+  }
+  // variables which are gone from the graph are dropped
+  states_ = std::move(states);
+  return changed;
+}
+
+void OnlineCalibrationManager::Clear() {
+  states_.clear();
+}
+
+size_t OnlineCalibrationManager::NumHeld() const {
+  return std::count_if(states_.begin(), states_.end(), [](const auto& entry) {
+    return entry.second.status == Status::HELD;
+  });
+}
+
+double OnlineCalibrationManager::Change(bool is_position,
+                                        const std::vector<double>& a,
+                                        const std::vector<double>& b) {
+  if (is_position) {
+    return (Eigen::Vector3d(a[0], a[1], a[2]) -
+            Eigen::Vector3d(b[0], b[1], b[2]))
+        .norm();
+  }
+  const Eigen::Quaterniond qa(a[0], a[1], a[2], a[3]);
+  const Eigen::Quaterniond qb(b[0], b[1], b[2], b[3]);
+  return qa.angularDistance(qb) * 180.0 / M_PI;
+}
+
+bool OnlineCalibrationManager::IsCertain(const fuse_core::Graph& graph,
+                                         const fuse_core::UUID& uuid,
+                                         bool is_position) const {
+  const double max_std = is_position ? params_.max_translation_std
+                                     : params_.max_rotation_std_deg;
+  if (max_std <= 0) { return true; }
+
+  std::vector<std::vector<double>> covariances;
+  try {
+    graph.getCovariance({{uuid, uuid}}, covariances);
+  } catch (const std::exception& e) {
+    ROS_DEBUG("Cannot compute the covariance of the extrinsics: %s", e.what());
+    return false;
+  }
+  // tangent space covariance, orientations are in rad
+  const std::vector<double>& covariance = covariances.at(0);
+  const size_t size = std::lround(std::sqrt(covariance.size()));
+  double max_variance = 0;
+  for (size_t i = 0; i < size; i++) {
+    max_variance = std::max(max_variance, covariance[i * size + i]);
+  }
+  double std = std::sqrt(max_variance);
+  if (!is_position) { std *= 180.0 / M_PI; }
+  return std <= max_std;
+}
+
+} // namespace bs_optimizers
@@ -0,0 +1,120 @@
+#include <bs_optimizers/parallel_graph_operations.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include <fuse_constraints/marginalize_variables.h>
+#include <fuse_constraints/uuid_ordering.h>
+#include <fuse_graphs/hash_graph.h>
+
+#include <bs_common/task_scheduler.h>
+
+namespace bs_optimizers {
+
+fuse_core::Transaction ParallelMarginalizeVariables(
+    const std::string& source,
+    const std::vector<fuse_core::UUID>& marginalized_variables,
+    const fuse_core::Graph& graph) {
+  fuse_core::Transaction transaction;
+  if (marginalized_variables.empty()) { return transaction; }
+  for (const auto& uuid : marginalized_variables) {
+    transaction.removeVariable(uuid);
+  }
+
+  // find the constraints used by each marginalized variable, in elimination
+  // order, and add the variables they connect to the ordering. Variables are
+  // only appended, so the final ordering can be used to linearize them all
+  fuse_constraints::UuidOrdering variable_order =
+      fuse_constraints::computeEliminationOrder(marginalized_variables, graph);
+  const size_t num_marginalized = marginalized_variables.size();
+  std::vector<const fuse_core::Constraint*> constraints;
+  std::vector<size_t> constraint_buckets;
+  std::unordered_set<fuse_core::UUID, fuse_core::uuid::hash> used_constraints;
+  for (size_t i = 0; i < num_marginalized; i++) {
+    for (const auto& constraint :
+         graph.getConnectedConstraints(variable_order[i])) {
+      if (!used_constraints.insert(constraint.uuid()).second) { continue; }
+      for (const auto& variable_uuid : constraint.variables()) {
+        variable_order.push_back(variable_uuid);
+      }
+      constraints.push_back(&constraint);
+      constraint_buckets.push_back(i);
+      transaction.removeConstraint(constraint.uuid());
+    }
+  }
+
+  std::vector<fuse_constraints::detail::LinearTerm> linearized(
+      constraints.size());
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME, constraints.size(),
+      [&](size_t i) {
+        linearized[i] = fuse_constraints::detail::linearize(
+            *constraints[i], graph, variable_order);
+      });
+
+  // eliminate each variable in order, the marginal goes to the lowest ordered
+  // variable it is connected to
+  std::vector<std::vector<fuse_constraints::detail::LinearTerm>> linear_terms(
+      variable_order.size());
+  for (size_t i = 0; i < linearized.size(); i++) {
+    linear_terms[constraint_buckets[i]].push_back(std::move(linearized[i]));
+  }
+  for (size_t i = 0; i < num_marginalized; i++) {
+    if (linear_terms[i].empty()) { continue; }
+    auto marginal = fuse_constraints::detail::marginalizeNext(linear_terms[i]);
+    if (marginal.variables.empty()) { continue; }
+    const auto lowest_variable = *std::min_element(marginal.variables.begin(),
+                                                   marginal.variables.end());
+    linear_terms[lowest_variable].push_back(std::move(marginal));
+  }
+
+  // the remaining terms are converted to marginal constraints
+  for (size_t i = num_marginalized; i < linear_terms.size(); i++) {
+    for (const auto& linear_term : linear_terms[i]) {
+      transaction.addConstraint(
+          fuse_constraints::detail::createMarginalConstraint(
+              source, linear_term, graph, variable_order));
+    }
+  }
+  return transaction;
+}
+
+fuse_core::Graph::UniquePtr ParallelClone(const fuse_core::Graph& graph) {
+  std::vector<const fuse_core::Variable*> variables;
+  for (const auto& variable : graph.getVariables()) {
+    variables.push_back(&variable);
+  }
+  std::vector<const fuse_core::Constraint*> constraints;
+  for (const auto& constraint : graph.getConstraints()) {
+    constraints.push_back(&constraint);
+  }
+
+  std::vector<fuse_core::Variable::SharedPtr> variable_copies(
+      variables.size());
+  std::vector<fuse_core::Constraint::SharedPtr> constraint_copies(
+      constraints.size());
+  bs_common::TaskScheduler::GetInstance().ParallelFor(
+      bs_common::TaskPriority::REALTIME,
+      variables.size() + constraints.size(), [&](size_t i) {
+        if (i < variables.size()) {
+          variable_copies[i] = variables[i]->clone();
+        } else {
+          const size_t c = i - variables.size();
+          constraint_copies[c] = constraints[c]->clone();
+        }
+      });
+
+  auto copy = fuse_graphs::HashGraph::make_unique();
+  for (size_t i = 0; i < variables.size(); i++) {
+    copy->addVariable(std::move(variable_copies[i]));
+    if (graph.isVariableOnHold(variables[i]->uuid())) {
+      copy->holdVariable(variables[i]->uuid(), true);
+    }
+  }
+  for (auto& constraint : constraint_copies) {
+    copy->addConstraint(std::move(constraint));
+  }
+  return copy;
+}
+
+} // namespace bs_optimizers
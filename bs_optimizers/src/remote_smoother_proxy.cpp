@@ -0,0 +1,67 @@
+#include <bs_optimizers/remote_smoother_proxy.h>
+
+#include <unordered_map>
+
+#include <bs_common/reset_context.h>
+
+namespace bs_optimizers {
+
+RemoteSmootherProxy::RemoteSmootherProxy(
+    fuse_core::Graph::UniquePtr graph, const ros::NodeHandle& node_handle,
+    const ros::NodeHandle& private_node_handle)
+    : fuse_optimizers::Optimizer(std::move(graph), node_handle,
+                                 private_node_handle) {
+  RemoteTransportParams params;
+  params.LoadFromROS(private_node_handle);
+  if (!params.enabled) {
+    ROS_WARN("remote_transport/enabled is false, connecting to the remote "
+             "smoother anyway");
+  }
+
+  std::unordered_map<std::string, bool> sensors;
+  for (const auto& [name, info] : sensor_models_) {
+    sensors.emplace(name, info.ignition);
+  }
+  client_ = std::make_unique<RemoteSmootherClient>(
+      params, sensors,
+      [this](bs_common::GraphSnapshot::ConstSharedPtr graph,
+             const ros::Time& stamp) {
+        auto transaction = fuse_core::Transaction::make_shared();
+        transaction->stamp(stamp);
+        notify(std::move(transaction), std::move(graph));
+      },
+      [this](bool fast_reset,
+             const std::optional<bs_common::ImuState>& last_good_state) {
+        onReset(fast_reset, last_good_state);
+      });
+}
+
+RemoteSmootherProxy::~RemoteSmootherProxy() {
+  // stop the callbacks before the plugins are destroyed
+  client_.reset();
+}
+
+void RemoteSmootherProxy::transactionCallback(
+    const std::string& sensor_name,
+    fuse_core::Transaction::SharedPtr transaction) {
+  if (!client_->SendTransaction(sensor_name, *transaction)) {
+    ROS_WARN_THROTTLE(1.0,
+                      "Dropping transaction of %s, the remote smoother is not "
+                      "connected or not keeping up",
+                      sensor_name.c_str());
+  }
+}
+
+void RemoteSmootherProxy::onReset(
+    bool fast_reset,
+    const std::optional<bs_common::ImuState>& last_good_state) {
+  ROS_INFO("Remote smoother reset, restarting the plugins");
+  if (fast_reset) {
+    bs_common::ResetContext::GetInstance().BeginFastReset(last_good_state);
+  }
+  stopPlugins();
+  startPlugins();
+  if (fast_reset) { bs_common::ResetContext::GetInstance().EndReset(); }
+}
+
+} // namespace bs_optimizers
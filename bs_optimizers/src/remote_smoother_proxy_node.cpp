@@ -0,0 +1,12 @@
+#include <bs_optimizers/remote_smoother_proxy.h>
+#include <fuse_graphs/hash_graph.h>
+#include <ros/ros.h>
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "remote_smoother_proxy_node");
+  bs_optimizers::RemoteSmootherProxy optimizer(
+      fuse_graphs::HashGraph::make_unique());
+  ros::spin();
+
+  return 0;
+}
@@ -0,0 +1,313 @@
+#include <bs_optimizers/remote_smoother_transport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <bs_common/compact_imu_state.h>
+#include <bs_common/compact_serialization.h>
+#include <bs_parameters/parameter_base.h>
+
+namespace bs_optimizers {
+
+namespace {
+
+/** period at which the reader threads check if they should stop */
+constexpr std::chrono::milliseconds kReadTimeout{100};
+
+std::chrono::milliseconds WriteTimeout(const RemoteTransportParams& params) {
+  return std::chrono::milliseconds(
+      static_cast<int64_t>(std::max(params.write_timeout, 0.0) * 1000));
+}
+
+bool WriteFrame(bs_common::ShmRing& ring, const bs_common::ByteWriter& frame,
+                const std::chrono::milliseconds& timeout) {
+  return ring.Write(frame.Data().data(), frame.Size(), timeout);
+}
+
+} // namespace
+
+void RemoteTransportParams::LoadFromROS(const ros::NodeHandle& nh) {
+  bs_parameters::getParam(nh, "remote_transport/enabled", enabled, enabled);
+  bs_parameters::getParam(nh, "remote_transport/name", name, name);
+  bs_parameters::getParam(nh, "remote_transport/ring_size_mb", ring_size_mb,
+                          ring_size_mb);
+  bs_parameters::getParam(nh, "remote_transport/write_timeout",
+                          write_timeout, write_timeout);
+  if (ring_size_mb < 1) {
+    ROS_ERROR("Invalid remote_transport/ring_size_mb: %d, must be positive",
+              ring_size_mb);
+    throw std::invalid_argument{"invalid remote transport ring size"};
+  }
+}
+
+RemoteSmootherServer::RemoteSmootherServer(
+    const RemoteTransportParams& params, TransactionCallback on_transaction,
+    std::function<void()> on_connect)
+    : params_(params),
+      on_transaction_(std::move(on_transaction)),
+      on_connect_(std::move(on_connect)) {
+  const size_t capacity = static_cast<size_t>(params_.ring_size_mb) << 20;
+  transaction_ring_ =
+      bs_common::ShmRing::Create(params_.TransactionRing(), capacity);
+  graph_ring_ = bs_common::ShmRing::Create(params_.GraphRing(), capacity);
+  if (!transaction_ring_ || !graph_ring_) {
+    ROS_ERROR("Cannot create the shared memory rings of the remote transport "
+              "%s",
+              params_.name.c_str());
+    throw std::runtime_error{"cannot create remote transport"};
+  }
+  ROS_INFO("Waiting for the remote front-end on %s and %s",
+           params_.TransactionRing().c_str(), params_.GraphRing().c_str());
+  reader_ = std::thread(&RemoteSmootherServer::ReadLoop, this);
+  writer_ = std::thread(&RemoteSmootherServer::WriteLoop, this);
+}
+
+RemoteSmootherServer::~RemoteSmootherServer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+  if (reader_.joinable()) { reader_.join(); }
+  if (writer_.joinable()) { writer_.join(); }
+}
+
+bool RemoteSmootherServer::IsIgnitionSensor(
+    const std::string& sensor_name) const {
+  std::lock_guard<std::mutex> lock(sensors_mutex_);
+  const auto iter = sensors_.find(sensor_name);
+  return iter != sensors_.end() && iter->second;
+}
+
+bool RemoteSmootherServer::HasIgnitionSensor() const {
+  std::lock_guard<std::mutex> lock(sensors_mutex_);
+  return std::any_of(sensors_.begin(), sensors_.end(),
+                     [](const auto& sensor) { return sensor.second; });
+}
+
+void RemoteSmootherServer::PublishGraph(
+    fuse_core::Graph::ConstSharedPtr graph, const ros::Time& stamp) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_graph_ = std::move(graph);
+    pending_stamp_ = stamp;
+  }
+  condition_.notify_one();
+}
+
+void RemoteSmootherServer::PublishReset(
+    bool fast_reset,
+    const std::optional<bs_common::ImuState>& last_good_state) {
+  bs_common::ByteWriter frame;
+  frame.Write<uint32_t>(static_cast<uint32_t>(RemoteFrameType::RESET));
+  frame.Write<uint8_t>(fast_reset);
+  frame.Write<uint8_t>(last_good_state.has_value());
+  if (last_good_state) { frame.Write(last_good_state->Compact()); }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_graph_.reset();
+    pending_resets_.push_back(std::move(frame));
+  }
+  condition_.notify_one();
+}
+
+void RemoteSmootherServer::ReadLoop() {
+  const bs_common::CompactSerializer& serializer =
+      bs_common::CompactSerializer::Instance();
+  std::vector<uint8_t> message;
+  while (running_) {
+    if (!transaction_ring_->Read(message, kReadTimeout)) { continue; }
+    try {
+      bs_common::ByteReader frame(message.data(), message.size());
+      const auto type = static_cast<RemoteFrameType>(frame.Read<uint32_t>());
+      if (type == RemoteFrameType::HELLO) {
+        std::unordered_map<std::string, bool> sensors;
+        const uint64_t num_sensors = frame.Read<uint64_t>();
+        for (uint64_t i = 0; i < num_sensors; i++) {
+          const std::string name = frame.ReadString();
+          sensors[name] = frame.Read<uint8_t>();
+        }
+        {
+          std::lock_guard<std::mutex> lock(sensors_mutex_);
+          sensors_ = std::move(sensors);
+        }
+        ROS_INFO("Remote front-end connected with %zu sensor models",
+                 static_cast<size_t>(num_sensors));
+        connected_ = true;
+        resync_ = true;
+        if (on_connect_) { on_connect_(); }
+      } else if (type == RemoteFrameType::TRANSACTION) {
+        const std::string sensor_name = frame.ReadString();
+        on_transaction_(sensor_name, serializer.ReadTransaction(frame));
+      } else if (type == RemoteFrameType::RESYNC) {
+        resync_ = true;
+        condition_.notify_one();
+      } else {
+        ROS_ERROR("Unexpected remote transport frame type %u",
+                  static_cast<uint32_t>(type));
+      }
+    } catch (const std::exception& e) {
+      ROS_ERROR("Invalid remote transport frame: %s", e.what());
+    }
+  }
+}
+
+void RemoteSmootherServer::WriteLoop() {
+  const std::chrono::milliseconds timeout = WriteTimeout(params_);
+  while (true) {
+    fuse_core::Graph::ConstSharedPtr graph;
+    ros::Time stamp;
+    std::deque<bs_common::ByteWriter> resets;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() {
+        return !running_ || pending_graph_ || !pending_resets_.empty();
+      });
+      if (!running_) { return; }
+      std::swap(graph, pending_graph_);
+      std::swap(resets, pending_resets_);
+      stamp = pending_stamp_;
+    }
+
+    // the graph was queued after the resets
+    for (const auto& frame : resets) {
+      if (!WriteFrame(*graph_ring_, frame, timeout)) {
+        ROS_ERROR("Cannot send a reset to the remote front-end");
+      }
+      encoder_.Reset();
+      send_snapshot_ = true;
+    }
+    if (!graph) { continue; }
+
+    if (resync_.exchange(false)) {
+      encoder_.Reset();
+      send_snapshot_ = true;
+    }
+    const auto type =
+        send_snapshot_ ? RemoteFrameType::SNAPSHOT : RemoteFrameType::GRAPH;
+    bs_common::ByteWriter frame;
+    frame.Write<uint32_t>(static_cast<uint32_t>(type));
+    encoder_.Encode(*graph, stamp, frame);
+    send_snapshot_ = !WriteFrame(*graph_ring_, frame, timeout);
+    if (send_snapshot_) {
+      // the front-end did not get this diff, start over from a snapshot
+      encoder_.Reset();
+      num_dropped_++;
+      ROS_WARN_THROTTLE(10.0,
+                        "Cannot send a graph update of %zu bytes to the remote "
+                        "front-end, the ring is full or too small",
+                        frame.Size());
+    }
+  }
+}
+
+RemoteSmootherClient::RemoteSmootherClient(
+    const RemoteTransportParams& params,
+    const std::unordered_map<std::string, bool>& sensors,
+    GraphCallback on_graph, ResetCallback on_reset)
+    : params_(params),
+      sensors_(sensors),
+      on_graph_(std::move(on_graph)),
+      on_reset_(std::move(on_reset)) {
+  reader_ = std::thread(&RemoteSmootherClient::ReadLoop, this);
+}
+
+RemoteSmootherClient::~RemoteSmootherClient() {
+  running_ = false;
+  if (reader_.joinable()) { reader_.join(); }
+}
+
+bool RemoteSmootherClient::SendTransaction(
+    const std::string& sensor_name, const fuse_core::Transaction& transaction) {
+  if (!connected_) { return false; }
+  bs_common::ByteWriter frame;
+  frame.Write<uint32_t>(static_cast<uint32_t>(RemoteFrameType::TRANSACTION));
+  frame.WriteString(sensor_name);
+  bs_common::CompactSerializer::Instance().WriteTransaction(transaction, frame);
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  return WriteFrame(*transaction_ring_, frame, WriteTimeout(params_));
+}
+
+bool RemoteSmootherClient::Connect() {
+  graph_ring_ = bs_common::ShmRing::Open(params_.GraphRing());
+  auto transaction_ring = bs_common::ShmRing::Open(params_.TransactionRing());
+  if (!graph_ring_ || !transaction_ring) {
+    graph_ring_.reset();
+    return false;
+  }
+
+  bs_common::ByteWriter frame;
+  frame.Write<uint32_t>(static_cast<uint32_t>(RemoteFrameType::HELLO));
+  frame.Write<uint64_t>(sensors_.size());
+  for (const auto& [name, ignition] : sensors_) {
+    frame.WriteString(name);
+    frame.Write<uint8_t>(ignition);
+  }
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  if (!WriteFrame(*transaction_ring, frame, WriteTimeout(params_))) {
+    graph_ring_.reset();
+    return false;
+  }
+  transaction_ring_ = std::move(transaction_ring);
+  connected_ = true;
+  ROS_INFO("Connected to the remote smoother on %s and %s",
+           params_.TransactionRing().c_str(), params_.GraphRing().c_str());
+  return true;
+}
+
+void RemoteSmootherClient::ReadLoop() {
+  while (running_ && !Connect()) { std::this_thread::sleep_for(kReadTimeout); }
+
+  std::vector<uint8_t> message;
+  while (running_) {
+    if (!graph_ring_->Read(message, kReadTimeout)) { continue; }
+    try {
+      bs_common::ByteReader frame(message.data(), message.size());
+      const auto type = static_cast<RemoteFrameType>(frame.Read<uint32_t>());
+      if (type == RemoteFrameType::GRAPH && !synced_) {
+        // waiting for the snapshot requested
+        continue;
+      } else if (type == RemoteFrameType::GRAPH ||
+                 type == RemoteFrameType::SNAPSHOT) {
+        ros::Time stamp;
+        bs_common::GraphDelta delta;
+        decoder_.Apply(frame, type == RemoteFrameType::SNAPSHOT, &stamp,
+                       &delta);
+        synced_ = true;
+        on_graph_(decoder_.BuildSnapshot(std::move(delta)), stamp);
+      } else if (type == RemoteFrameType::RESET) {
+        // the next update is a snapshot
+        decoder_.Reset();
+        const bool fast_reset = frame.Read<uint8_t>();
+        std::optional<bs_common::ImuState> last_good_state;
+        if (frame.Read<uint8_t>()) {
+          last_good_state.emplace(frame.Read<bs_common::CompactImuState>());
+        }
+        on_reset_(fast_reset, last_good_state);
+      } else {
+        ROS_ERROR("Unexpected remote transport frame type %u",
+                  static_cast<uint32_t>(type));
+      }
+    } catch (const std::exception& e) {
+      ROS_ERROR("Invalid remote transport frame: %s", e.what());
+      RequestResync();
+    }
+  }
+}
+
+void RemoteSmootherClient::RequestResync() {
+  decoder_.Reset();
+  synced_ = false;
+  bs_common::ByteWriter frame;
+  frame.Write<uint32_t>(static_cast<uint32_t>(RemoteFrameType::RESYNC));
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  if (!WriteFrame(*transaction_ring_, frame, WriteTimeout(params_))) {
+    ROS_ERROR("Cannot request a graph snapshot from the remote smoother");
+  }
+}
+
+} // namespace bs_optimizers
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include <ros/time.h>
+
+namespace bs_publishers {
+
+/**
+ * @brief Tiny filter fusing the relative motions of front-end odometries
+ * (e.g. lidar, visual and inertial odometry) with the latest smoother states,
+ * so odometry can be published at the rate of the front ends without waiting
+ * for the graph.
+ *
+ * The fused pose is propagated by the motion of whichever source moves past
+ * it: each front-end pose only contributes the motion from the time of the
+ * fused pose, interpolated on that source, to its own stamp, so sources
+ * covering the same period never apply their motion twice. Only relative
+ * motions are used, so the world frames of the front ends don't matter.
+ *
+ * Each smoother state gives the correction of the fused pose at its stamp,
+ * which is applied gradually over the next front-end poses so the output
+ * stays smooth. All memory is allocated once: the last pose of each source
+ * and a fixed-size history of fused poses to relate the smoother states to.
+ */
+class FrontendOdometryFilter {
+public:
+  struct Params {
+    /** number of front-end sources */
+    size_t num_sources{1};
+
+    /** fraction of the remaining correction applied at each update, in
+     * (0, 1]. 1 snaps to the smoother states */
+    double correction_gain{0.1};
+
+    /** number of fused poses kept to apply the smoother states */
+    size_t history_size{200};
+  };
+
+  explicit FrontendOdometryFilter(const Params& params);
+
+  /**
+   * @brief Adds the pose of a front-end source
+   * @param source index of the source, less than num_sources
+   * @param stamp stamp of the pose
+   * @param T_World_Baselink pose in the world frame of the source
+   * @return true if the fused pose moved forward to this stamp
+   */
+  bool AddFrontendPose(size_t source, const ros::Time& stamp,
+                       const Eigen::Matrix4d& T_World_Baselink);
+
+  /**
+   * @brief Adds the optimized pose of a smoother state. The first one
+   * initializes the filter
+   * @return false if the state is older than the history
+   */
+  bool AddSmootherPose(const ros::Time& stamp,
+                       const Eigen::Matrix4d& T_World_Baselink);
+
+  bool Initialized() const { return initialized_; }
+
+  /**
+   * @brief Stamp of the fused pose
+   */
+  const ros::Time& Stamp() const { return stamp_; }
+
+  /**
+   * @brief Fused pose in the smoother world frame
+   */
+  const Eigen::Matrix4d& Pose() const { return T_World_Baselink_; }
+
+  /**
+   * @brief Clears everything, the next smoother pose initializes the filter
+   */
+  void Reset();
+
+private:
+  struct StampedPose {
+    ros::Time stamp;
+    Eigen::Matrix4d T{Eigen::Matrix4d::Identity()};
+    // product of the corrections applied up to this pose
+    Eigen::Matrix4d applied{Eigen::Matrix4d::Identity()};
+  };
+
+  /**
+   * @brief Adds the fused pose to the history, overwriting the oldest one
+   */
+  void PushHistory();
+
+  Params params_;
+  bool initialized_{false};
+  ros::Time stamp_;
+  Eigen::Matrix4d T_World_Baselink_{Eigen::Matrix4d::Identity()};
+  Eigen::Matrix4d correction_{Eigen::Matrix4d::Identity()};
+  Eigen::Matrix4d applied_{Eigen::Matrix4d::Identity()};
+
+  std::vector<StampedPose, Eigen::aligned_allocator<StampedPose>> sources_;
+  std::vector<bool> source_valid_;
+
+  // ring buffer of the fused poses, history_begin_ is the oldest one
+  std::vector<StampedPose, Eigen::aligned_allocator<StampedPose>> history_;
+  size_t history_begin_{0};
+  size_t history_size_{0};
+};
+
+} // namespace bs_publishers
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fuse_core/async_publisher.h>
+#include <fuse_core/fuse_macros.h>
+#include <fuse_core/graph.h>
+#include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+#include <fuse_variables/orientation_3d_stamped.h>
+#include <fuse_variables/position_3d_stamped.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+
+#include <bs_publishers/frontend_odometry_filter.h>
+#include <bs_publishers/stamped_variable_synchronizer.h>
+
+namespace bs_publishers {
+
+/**
+ * @brief Publisher plugin that publishes odometry at the rate of the front
+ * ends instead of the rate of the smoother. The relative motions of the
+ * front-end odometries (lidar, visual and inertial odometry) are fused with
+ * the latest smoother states in a bs_publishers::FrontendOdometryFilter, and
+ * the fused pose is published after each front-end pose.
+ *
+ * All callbacks run on the single thread of the publisher.
+ *
+ * Parameters:
+ *  - device_id (uuid string, default: 00000000-0000-0000-0000-000000000000) The
+ * device/robot ID to publish
+ *  - device_name (string) Used to generate the device/robot ID if the device_id
+ * is not provided
+ *  - source_topics (list of strings) nav_msgs::Odometry topics of the front
+ * ends, e.g. /local_mapper/lidar_odometry/odometry
+ *  - topic (string, default: odometry) Topic of the fused odometry
+ *  - correction_gain (double, default: 0.1) Fraction of the correction from
+ * the smoother applied at each front-end pose, 1 snaps to the smoother
+ *  - history_size (int, default: 200) Number of fused poses kept to apply the
+ * smoother states, which are older than the front-end poses
+ */
+class FrontendOdometryPublisher : public fuse_core::AsyncPublisher {
+public:
+  FUSE_SMART_PTR_DEFINITIONS(FrontendOdometryPublisher);
+
+  FrontendOdometryPublisher();
+
+  virtual ~FrontendOdometryPublisher() = default;
+
+  void onInit() override;
+
+  void onStart() override;
+
+  void onStop() override;
+
+  /**
+   * @brief Adds the latest state of the graph to the filter
+   */
+  void notifyCallback(fuse_core::Transaction::ConstSharedPtr transaction,
+                      fuse_core::Graph::ConstSharedPtr graph) override;
+
+protected:
+  using Synchronizer =
+      bs_publishers::StampedVariableSynchronizer<
+          fuse_variables::Orientation3DStamped,
+          fuse_variables::Position3DStamped>;
+
+  /**
+   * @brief Adds a front-end pose to the filter and publishes the fused pose
+   * @param source index of the source topic
+   */
+  void frontendCallback(const nav_msgs::Odometry::ConstPtr& message,
+                        size_t source);
+
+  fuse_core::UUID device_id_;
+  std::string world_frame_id_;
+  std::string baselink_frame_id_;
+  FrontendOdometryFilter::Params filter_params_;
+  std::unique_ptr<FrontendOdometryFilter> filter_;
+  Synchronizer synchronizer_;
+  std::vector<std::string> source_topics_;
+  std::vector<ros::Subscriber> source_subscribers_;
+  ros::Publisher odom_publisher_;
+  uint64_t odom_publisher_counter_{0};
+};
+
+} // namespace bs_publishers
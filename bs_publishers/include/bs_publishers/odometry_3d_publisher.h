@@ -1,5 +1,10 @@
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
 #include <fuse_core/async_publisher.h>
 #include <fuse_core/fuse_macros.h>
 #include <fuse_core/graph.h>
@@ -76,9 +81,9 @@ public:
   Odometry3DPublisher();
 
   /**
-   * @brief Destructor
+   * @brief Destructor. This stops the covariance worker if it is running
    */
-  virtual ~Odometry3DPublisher() = default;
+  virtual ~Odometry3DPublisher();
 
 protected:
   /**
@@ -135,6 +140,18 @@ protected:
                 fuse_core::UUID& velocity_angular_uuid,
                 nav_msgs::Odometry& state);
 
+  /**
+   * @brief Function run by the covariance worker thread. It computes the
+   * covariance of the latest requested state and stores it to be published
+   * with the following states
+   */
+  void covarianceWorker();
+
+  /**
+   * @brief Stops the covariance worker and waits for it to return
+   */
+  void stopCovarianceWorker();
+
   /**
    * @brief Timer callback method for the tf publication
    * @param[in] event The timer event parameters that are associated with the
@@ -171,6 +188,20 @@ protected:
   std::unique_ptr<tf2_ros::TransformListener> tf_listener_;
 
   ros::Timer tf_publish_timer_;
+
+  // async covariance computation
+  struct CovarianceJob {
+    fuse_core::Graph::ConstSharedPtr graph;
+    ros::Time stamp;
+    std::vector<std::pair<fuse_core::UUID, fuse_core::UUID>> requests;
+  };
+  std::thread covariance_thread_;
+  std::mutex covariance_mutex_;
+  std::condition_variable covariance_cv_;
+  std::optional<CovarianceJob> covariance_job_; //!< only the latest is kept
+  bool stop_covariance_worker_{false};
+  nav_msgs::Odometry latest_covariance_; //!< only the covariances are set
+  ros::Time last_covariance_request_time_;
 };
 
 } // namespace bs_publishers
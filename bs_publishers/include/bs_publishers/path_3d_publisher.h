@@ -1,9 +1,14 @@
 #pragma once
 
+#include <map>
+#include <unordered_map>
+
 #include <fuse_core/async_publisher.h>
 #include <fuse_core/fuse_macros.h>
 #include <fuse_core/graph.h>
 #include <fuse_core/transaction.h>
+#include <fuse_core/uuid.h>
+#include <geometry_msgs/PoseStamped.h>
 #include <ros/ros.h>
 
 namespace bs_publishers {
@@ -12,12 +17,25 @@ namespace bs_publishers {
  * @brief Publisher plugin that publishes all of the stamped 3D poses as a
  * nav_msgs::Path message.
  *
+ * The path is kept sorted by stamp between optimizations and only the poses
+ * added or removed by each transaction are touched, so the cost of a callback
+ * doesn't grow with the size of the graph. The poses added by each transaction
+ * are published as a delta path after every optimization, and the full path,
+ * with the latest estimates of all of its poses, is published at a lower rate.
+ *
  * Parameters:
  *  - device_id (uuid string, default: 00000000-0000-0000-0000-000000000000) The
  * device/robot ID to publish
  *  - device_name (string) Used to generate the device/robot ID if the device_id
  * is not provided
  *  - frame_id (string, default: map)  Name for the robot's map frame
+ *  - path_topic (string, default: path) Topic of the full path
+ *  - pose_array_topic (string, default: pose_array) Topic of the full path as a
+ * pose array
+ *  - delta_path_topic (string, default: path_delta) Topic of the poses added
+ * by each transaction
+ *  - full_path_period (double, default: 1.0) Minimum time in seconds between
+ * two publications of the full path
  */
 class Path3DPublisher : public fuse_core::AsyncPublisher {
 public:
@@ -53,6 +71,37 @@ public:
                       fuse_core::Graph::ConstSharedPtr graph) override;
 
 protected:
+  /** pose of the path with the variables it is read from */
+  struct PathPose {
+    fuse_core::UUID position_uuid;
+    fuse_core::UUID orientation_uuid;
+    geometry_msgs::PoseStamped pose;
+  };
+
+  /**
+   * @brief Adds the pose of a variable to the path if it is an orientation of
+   * the device with a matching position in the graph
+   * @return true if a pose was added
+   */
+  bool AddPose(const fuse_core::Variable& variable,
+               const fuse_core::Graph& graph);
+
+  /**
+   * @brief Removes the pose of a variable from the path, if any
+   */
+  void RemovePose(const fuse_core::UUID& uuid);
+
+  /**
+   * @brief Reads the latest estimate of a pose from the graph
+   * @return false if its variables are no longer in the graph
+   */
+  bool UpdatePose(PathPose& path_pose, const fuse_core::Graph& graph) const;
+
+  /**
+   * @brief Publishes the full path with the latest estimates of its poses
+   */
+  void PublishFullPath(const fuse_core::Graph& graph);
+
   fuse_core::UUID device_id_;     //!< The UUID of the device to be published
   std::string world_frame_id_;    //!< Frame name for the header of the path msg
   std::string baselink_frame_id_; //!< Frame name in the header of pose messages
@@ -60,6 +109,16 @@ protected:
                                   //!< trajectory as a path
   ros::Publisher pose_array_publisher_; //!< The publisher that sends the entire
                                         //!< robot trajectory as a pose array
+  ros::Publisher delta_path_publisher_; //!< The publisher that sends the poses
+                                        //!< added by each transaction
+  ros::Duration full_path_period_{1.0}; //!< Minimum time between publications
+                                        //!< of the full path
+  ros::Time last_full_path_time_;       //!< Time the full path was published
+
+  bool initialized_{false}; //!< If the path was seeded from the graph
+  std::map<ros::Time, PathPose> path_; //!< Path sorted by stamp
+  std::unordered_map<fuse_core::UUID, ros::Time, fuse_core::uuid::hash>
+      stamps_; //!< Stamps of the path poses by position and orientation uuid
 };
 
 } // namespace bs_publishers
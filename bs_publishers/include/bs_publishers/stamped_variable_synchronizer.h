@@ -44,7 +44,11 @@
 #include <fuse_variables/stamped.h>
 #include <ros/time.h>
 
+#include <cstdint>
+#include <map>
 #include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
 
 namespace bs_publishers {
 
@@ -53,12 +57,12 @@ namespace bs_publishers {
  * of stamped variables
  *
  * This is designed to be used by derived fuse_core::Publisher classes. The
- * class remembers the last common timestamp from the previous call, and
- * attempts to find a more recent common timestamp using the provided
- * transaction information. If no common timestamp is found after searching the
- * transaction, a full search of the graph will be conducted. If no common
- * timestamp is found after searching the full graph, a zero timestamp will be
- * returned.
+ * class searches the full graph on the first call only, and then keeps an index
+ * of which of the requested variable types exist at each timestamp up to date
+ * from the variables added and removed by each transaction. Variables are
+ * matched to the requested types by their exact type id, so finding the latest
+ * common timestamp costs one lookup per added or removed variable. If no common
+ * timestamp exists, a zero timestamp will be returned.
  *
  * The set of variable types are provided in the template parameters. e.g.
  * @code{.cpp}
@@ -96,21 +100,36 @@ public:
                                   const fuse_core::Graph& graph);
 
 private:
+  using TypeMask = uint32_t; //!< One bit per type of the parameter pack
+
+  static_assert(sizeof...(Ts) <= 32, "At most 32 types can be synchronized.");
+
+  static constexpr TypeMask ALL_TYPES =
+      static_cast<TypeMask>((uint64_t(1) << sizeof...(Ts)) - 1);
+
   fuse_core::UUID device_id_; //!< The device_id to use with the Stamped classes
   ros::Time latest_common_stamp_; //!< The previously discovered common stamp
+  bool initialized_{false}; //!< If the index was seeded from the graph
+  std::map<ros::Time, TypeMask> stamps_; //!< Types that exist at each stamp
+  std::unordered_map<fuse_core::UUID, std::pair<ros::Time, TypeMask>,
+                     fuse_core::uuid::hash>
+      variables_; //!< Stamp and type of each indexed variable
 
   /**
-   * @brief Search the variables in the provided range for more recent
-   * timestamps. Update the \p latest_common_stamp_ member variable if a newer
-   * common timestamp is found.
+   * @brief Add the variables in the provided range that are of the requested
+   * types and device to the stamp index
    *
-   * @param[in] variable_range The collection of variables to test
-   * @param[in] graph          The complete graph, used to verify that all
-   * requested variables exist for a given time
+   * @param[in] variable_range The collection of variables to add
    */
   template <typename VariableRange>
-  void updateTime(const VariableRange& variable_range,
-                  const fuse_core::Graph& graph);
+  void addVariables(const VariableRange& variable_range);
+
+  /**
+   * @brief Remove a variable from the stamp index, if it is indexed
+   *
+   * @param[in] uuid The uuid of the removed variable
+   */
+  void removeVariable(const fuse_core::UUID& uuid);
 };
 
 namespace detail {
@@ -198,88 +217,65 @@ template <typename... Ts>
 constexpr bool allStampedVariables = all_stamped_variables<Ts...>::value;
 
 /**
- * @brief Test if instances of all the template parameter pack types exist in
- * the graph
+ * @brief Find which of the template parameter pack types a variable is
  *
  * This version accepts an empty parameter pack, and is used to terminate the
  * recursive template parameter pack expansion.
  *
- * This would be much easier to write in C++17 using 'if constexpr
- * (sizeof...(Ts) > 0)'
- *
- * @param[in] graph     The complete graph, used to verify the existence of a
- * variable
- * @param[in] stamp     The timestamp used to construct all variable types
- * @param[in] device_id The device id used to construct all variable types
- * @return True if all variables exist, false otherwise
+ * @param[in] type  The type id of the variable
+ * @param[in] bit   The bit of the first type of the parameter pack
+ * @return Zero, the type is not part of the template parameter pack
  */
 template <typename...>
-struct all_variables_exist {
-  static bool value(const fuse_core::Graph& /*graph*/,
-                    const ros::Time& /*stamp*/,
-                    const fuse_core::UUID& /*device_id*/) {
-    return true;
+struct variable_type_bit {
+  static uint32_t value(const std::type_info& /*type*/, uint32_t /*bit*/) {
+    return 0;
   }
 };
 
 /**
- * @brief Test if instances of all the template parameter pack types exist in
- * the graph
+ * @brief Find which of the template parameter pack types a variable is
  *
- * This version accepts two or more template arguments. The template parameter
- * pack is expanded recursively.
+ * This version accepts one or more template arguments. The template parameter
+ * pack is expanded recursively. Types are compared by their type id, which
+ * unlike a dynamic_cast is a single comparison per type, so derived types of
+ * the parameter pack types don't match.
  *
- * @param[in] graph     The complete graph, used to verify the existence of a
- * variable
- * @param[in] stamp     The timestamp used to construct all variable types
- * @param[in] device_id The device id used to construct all variable types
- * @return True if all variables exist, false otherwise
+ * @param[in] type  The type id of the variable
+ * @param[in] bit   The bit of the first type of the parameter pack
+ * @return The bit of the variable's type in the template parameter pack, or
+ * zero if it is not part of it
  */
 template <typename T, typename... Ts>
-struct all_variables_exist<T, Ts...> {
-  static bool value(const fuse_core::Graph& graph, const ros::Time& stamp,
-                    const fuse_core::UUID& device_id) {
-    return graph.variableExists(T(stamp, device_id).uuid()) &&
-           all_variables_exist<Ts...>::value(graph, stamp, device_id);
+struct variable_type_bit<T, Ts...> {
+  static uint32_t value(const std::type_info& type, uint32_t bit) {
+    if (type == typeid(T)) { return bit; }
+    return variable_type_bit<Ts...>::value(type, bit << 1);
   }
 };
 
 /**
- * @brief Test if a given variable is included in the template parameter pack
- * types
- *
- * This version accepts an empty parameter pack, and is used to terminate the
- * recursive template parameter pack expansion.
- *
- * This would be much easier to write in C++17 using 'if constexpr
- * (sizeof...(Ts) > 0)'
+ * @brief Get the stamped base of a variable whose type is in the template
+ * parameter pack, without a dynamic_cast
  *
- * @param[in] variable The variable to check against the template parameter pack
- * @return True if the variable's type is part of the template parameter pack,
- * false otherwise
+ * @param[in] variable The variable, of one of the parameter pack types
+ * @param[in] bit      The bit of the variable's type, see variable_type_bit
+ * @return The stamped base of the variable
  */
 template <typename...>
-struct is_variable_in_pack {
-  static bool value(const fuse_core::Variable& /*variable*/) { return false; }
+struct stamped_cast {
+  static const fuse_variables::Stamped*
+      value(const fuse_core::Variable& /*variable*/, uint32_t /*bit*/) {
+    return nullptr;
+  }
 };
 
-/**
- * @brief Test if a given variable is included in the template parameter pack
- * types
- *
- * This version accepts two or more template arguments. The template parameter
- * pack is expanded recursively.
- *
- * @param[in] variable The variable to check against the template parameter pack
- * @return True if the variable's type is part of the template parameter pack,
- * false otherwise
- */
 template <typename T, typename... Ts>
-struct is_variable_in_pack<T, Ts...> {
-  static bool value(const fuse_core::Variable& variable) {
-    auto derived = dynamic_cast<const T*>(&variable);
-    return static_cast<bool>(derived) ||
-           is_variable_in_pack<Ts...>::value(variable);
+struct stamped_cast<T, Ts...> {
+  static const fuse_variables::Stamped*
+      value(const fuse_core::Variable& variable, uint32_t bit) {
+    if (bit == 1) { return &static_cast<const T&>(variable); }
+    return stamped_cast<Ts...>::value(variable, bit >> 1);
   }
 };
 
@@ -301,38 +297,61 @@ StampedVariableSynchronizer<Ts...>::StampedVariableSynchronizer(
 template <typename... Ts>
 ros::Time StampedVariableSynchronizer<Ts...>::findLatestCommonStamp(
     const fuse_core::Transaction& transaction, const fuse_core::Graph& graph) {
-  // Clear the previous stamp if the variable was deleted
-  if (latest_common_stamp_ != TIME_ZERO &&
-      !detail::all_variables_exist<Ts...>::value(graph, latest_common_stamp_,
-                                                 device_id_)) {
-    latest_common_stamp_ = TIME_ZERO;
+  if (!initialized_) {
+    // Seed the index with the whole graph, which already contains the
+    // transaction
+    addVariables(graph.getVariables());
+    initialized_ = true;
+  } else {
+    // The graph adds the variables of a transaction before removing any
+    addVariables(transaction.addedVariables());
+    for (const auto& uuid : transaction.removedVariables()) {
+      removeVariable(uuid);
+    }
   }
-  // Search the transaction for more recent variables
-  updateTime(transaction.addedVariables(), graph);
-  // If no common timestamp was found, search the whole graph for the most
-  // recent variable set
-  if (latest_common_stamp_ == TIME_ZERO) {
-    updateTime(graph.getVariables(), graph);
+
+  // The latest common stamp is usually the last indexed stamp
+  latest_common_stamp_ = TIME_ZERO;
+  for (auto iter = stamps_.rbegin(); iter != stamps_.rend(); ++iter) {
+    if (iter->second == ALL_TYPES) {
+      latest_common_stamp_ = iter->first;
+      break;
+    }
   }
   return latest_common_stamp_;
 }
 
 template <typename... Ts>
 template <typename VariableRange>
-void StampedVariableSynchronizer<Ts...>::updateTime(
-    const VariableRange& variable_range, const fuse_core::Graph& graph) {
+void StampedVariableSynchronizer<Ts...>::addVariables(
+    const VariableRange& variable_range) {
   for (const auto& candidate_variable : variable_range) {
-    if (detail::is_variable_in_pack<Ts...>::value(candidate_variable)) {
-      const auto& stamped_variable =
-          dynamic_cast<const fuse_variables::Stamped&>(candidate_variable);
-      if ((stamped_variable.stamp() > latest_common_stamp_) &&
-          (stamped_variable.deviceId() == device_id_) &&
-          (detail::all_variables_exist<Ts...>::value(
-              graph, stamped_variable.stamp(), device_id_))) {
-        latest_common_stamp_ = stamped_variable.stamp();
-      }
+    const TypeMask bit = detail::variable_type_bit<Ts...>::value(
+        typeid(candidate_variable), 1);
+    if (bit == 0) { continue; }
+    const fuse_variables::Stamped* stamped_variable =
+        detail::stamped_cast<Ts...>::value(candidate_variable, bit);
+    if (stamped_variable->deviceId() != device_id_) { continue; }
+    const ros::Time& stamp = stamped_variable->stamp();
+    if (!variables_
+             .emplace(candidate_variable.uuid(), std::make_pair(stamp, bit))
+             .second) {
+      continue;
     }
+    stamps_[stamp] |= bit;
   }
 }
 
+template <typename... Ts>
+void StampedVariableSynchronizer<Ts...>::removeVariable(
+    const fuse_core::UUID& uuid) {
+  auto variable_iter = variables_.find(uuid);
+  if (variable_iter == variables_.end()) { return; }
+  const auto& [stamp, bit] = variable_iter->second;
+  auto stamp_iter = stamps_.find(stamp);
+  stamp_iter->second &= ~bit;
+  if (stamp_iter->second == 0) { stamps_.erase(stamp_iter); }
+  variables_.erase(variable_iter);
+}
+
 } // namespace bs_publishers
@@ -0,0 +1,143 @@
+#include <bs_publishers/frontend_odometry_filter.h>
+
+#include <algorithm>
+
+namespace bs_publishers {
+
+namespace {
+
+/**
+ * @brief Interpolates between two transforms, with t in [0, 1]
+ */
+Eigen::Matrix4d Interpolate(const Eigen::Matrix4d& T1,
+                            const Eigen::Matrix4d& T2, double t) {
+  const Eigen::Quaterniond q1(T1.block<3, 3>(0, 0));
+  const Eigen::Quaterniond q2(T2.block<3, 3>(0, 0));
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) = q1.slerp(t, q2).normalized().toRotationMatrix();
+  T.block<3, 1>(0, 3) =
+      (1 - t) * T1.block<3, 1>(0, 3) + t * T2.block<3, 1>(0, 3);
+  return T;
+}
+
+/**
+ * @brief Inverse of a rigid transform
+ */
+Eigen::Matrix4d Invert(const Eigen::Matrix4d& T) {
+  Eigen::Matrix4d T_inv = Eigen::Matrix4d::Identity();
+  T_inv.block<3, 3>(0, 0) = T.block<3, 3>(0, 0).transpose();
+  T_inv.block<3, 1>(0, 3) = -T_inv.block<3, 3>(0, 0) * T.block<3, 1>(0, 3);
+  return T_inv;
+}
+
+} // namespace
+
+FrontendOdometryFilter::FrontendOdometryFilter(const Params& params)
+    : params_(params) {
+  params_.num_sources = std::max<size_t>(params_.num_sources, 1);
+  params_.correction_gain = std::clamp(params_.correction_gain, 1e-3, 1.0);
+  params_.history_size = std::max<size_t>(params_.history_size, 2);
+  sources_.resize(params_.num_sources);
+  source_valid_.resize(params_.num_sources, false);
+  history_.resize(params_.history_size);
+}
+
+bool FrontendOdometryFilter::AddFrontendPose(
+    size_t source, const ros::Time& stamp,
+    const Eigen::Matrix4d& T_World_Baselink) {
+  if (source >= sources_.size()) { return false; }
+  StampedPose& last = sources_[source];
+  const bool last_valid = source_valid_[source];
+  const StampedPose previous = last;
+  last.stamp = stamp;
+  last.T = T_World_Baselink;
+  source_valid_[source] = true;
+  if (!initialized_ || !last_valid || stamp <= stamp_ ||
+      stamp <= previous.stamp) {
+    return false;
+  }
+
+  // motion of this source since the fused pose
+  Eigen::Matrix4d T_World_BaselinkFused = previous.T;
+  if (previous.stamp < stamp_) {
+    const double t =
+        (stamp_ - previous.stamp).toSec() / (stamp - previous.stamp).toSec();
+    T_World_BaselinkFused = Interpolate(previous.T, T_World_Baselink, t);
+  }
+  T_World_Baselink_ =
+      T_World_Baselink_ * Invert(T_World_BaselinkFused) * T_World_Baselink;
+  stamp_ = stamp;
+
+  // apply part of the remaining correction
+  const Eigen::Matrix4d step = Interpolate(
+      Eigen::Matrix4d::Identity(), correction_, params_.correction_gain);
+  T_World_Baselink_ = step * T_World_Baselink_;
+  correction_ = Invert(step) * correction_;
+  applied_ = step * applied_;
+  PushHistory();
+  return true;
+}
+
+bool FrontendOdometryFilter::AddSmootherPose(
+    const ros::Time& stamp, const Eigen::Matrix4d& T_World_Baselink) {
+  // the smoother is ahead of all front ends, or this is the first state
+  if (!initialized_ || stamp >= stamp_) {
+    initialized_ = true;
+    stamp_ = stamp;
+    T_World_Baselink_ = T_World_Baselink;
+    correction_.setIdentity();
+    applied_.setIdentity();
+    history_size_ = 0;
+    PushHistory();
+    return true;
+  }
+
+  // find the fused pose at the stamp of the state
+  const auto at = [this](size_t i) -> const StampedPose& {
+    return history_[(history_begin_ + i) % history_.size()];
+  };
+  if (history_size_ == 0 || stamp < at(0).stamp) { return false; }
+  size_t i = history_size_ - 1;
+  while (i > 0 && at(i - 1).stamp > stamp) { i--; }
+  StampedPose fused = at(i);
+  if (i > 0 && fused.stamp != stamp) {
+    const StampedPose& before = at(i - 1);
+    const double t =
+        (stamp - before.stamp).toSec() / (fused.stamp - before.stamp).toSec();
+    fused.T = Interpolate(before.T, fused.T, t);
+    fused.applied = before.applied;
+  }
+
+  // correction of the current pose, without the corrections applied since
+  // the fused pose at the stamp of the state
+  correction_ = T_World_Baselink * Invert(fused.T) * fused.applied *
+                Invert(applied_);
+  return true;
+}
+
+void FrontendOdometryFilter::Reset() {
+  initialized_ = false;
+  stamp_ = ros::Time();
+  T_World_Baselink_.setIdentity();
+  correction_.setIdentity();
+  applied_.setIdentity();
+  std::fill(source_valid_.begin(), source_valid_.end(), false);
+  history_begin_ = 0;
+  history_size_ = 0;
+}
+
+void FrontendOdometryFilter::PushHistory() {
+  StampedPose* pose;
+  if (history_size_ < history_.size()) {
+    pose = &history_[(history_begin_ + history_size_) % history_.size()];
+    history_size_++;
+  } else {
+    pose = &history_[history_begin_];
+    history_begin_ = (history_begin_ + 1) % history_.size();
+  }
+  pose->stamp = stamp_;
+  pose->T = T_World_Baselink_;
+  pose->applied = applied_;
+}
+
+} // namespace bs_publishers
@@ -0,0 +1,112 @@
+#include <bs_publishers/frontend_odometry_publisher.h>
+
+#include <algorithm>
+
+#include <fuse_variables/stamped.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <bs_common/conversions.h>
+#include <bs_common/extrinsics_lookup_online.h>
+
+// Register this publisher with ROS as a plugin.
+PLUGINLIB_EXPORT_CLASS(bs_publishers::FrontendOdometryPublisher,
+                       fuse_core::Publisher);
+
+namespace bs_publishers {
+
+FrontendOdometryPublisher::FrontendOdometryPublisher()
+    : fuse_core::AsyncPublisher(1), device_id_(fuse_core::uuid::NIL) {}
+
+void FrontendOdometryPublisher::onInit() {
+  device_id_ = fuse_variables::loadDeviceId(private_node_handle_);
+  private_node_handle_.getParam("source_topics", source_topics_);
+  if (source_topics_.empty()) {
+    ROS_WARN("No source topics given to the front-end odometry publisher, "
+             "the smoother states will not be propagated.");
+  }
+  std::string topic;
+  private_node_handle_.param<std::string>("topic", topic, "odometry");
+  private_node_handle_.param("correction_gain", filter_params_.correction_gain,
+                             0.1);
+  int history_size;
+  private_node_handle_.param("history_size", history_size, 200);
+  filter_params_.history_size = std::max(history_size, 2);
+  filter_params_.num_sources = std::max<size_t>(source_topics_.size(), 1);
+  filter_ = std::make_unique<FrontendOdometryFilter>(filter_params_);
+
+  odom_publisher_ =
+      private_node_handle_.advertise<nav_msgs::Odometry>(topic, 100);
+}
+
+void FrontendOdometryPublisher::onStart() {
+  bs_common::ExtrinsicsLookupOnline& extrinsics =
+      bs_common::ExtrinsicsLookupOnline::GetInstance();
+  baselink_frame_id_ = extrinsics.GetBaselinkFrameId();
+  world_frame_id_ = extrinsics.GetWorldFrameId();
+  synchronizer_ = Synchronizer(device_id_);
+  filter_->Reset();
+  odom_publisher_counter_ = 0;
+
+  source_subscribers_.clear();
+  for (size_t i = 0; i < source_topics_.size(); i++) {
+    boost::function<void(const nav_msgs::Odometry::ConstPtr&)> callback =
+        [this, i](const nav_msgs::Odometry::ConstPtr& message) {
+          frontendCallback(message, i);
+        };
+    source_subscribers_.push_back(
+        private_node_handle_.subscribe<nav_msgs::Odometry>(
+            ros::names::resolve(source_topics_[i]), 100, callback));
+  }
+}
+
+void FrontendOdometryPublisher::onStop() {
+  source_subscribers_.clear();
+}
+
+void FrontendOdometryPublisher::notifyCallback(
+    fuse_core::Transaction::ConstSharedPtr transaction,
+    fuse_core::Graph::ConstSharedPtr graph) {
+  const ros::Time stamp =
+      synchronizer_.findLatestCommonStamp(*transaction, *graph);
+  if (stamp == Synchronizer::TIME_ZERO) { return; }
+
+  const auto& position = dynamic_cast<const fuse_variables::Position3DStamped&>(
+      graph->getVariable(
+          fuse_variables::Position3DStamped(stamp, device_id_).uuid()));
+  const auto& orientation =
+      dynamic_cast<const fuse_variables::Orientation3DStamped&>(
+          graph->getVariable(
+              fuse_variables::Orientation3DStamped(stamp, device_id_).uuid()));
+  Eigen::Matrix4d T_World_Baselink = Eigen::Matrix4d::Identity();
+  T_World_Baselink.block<3, 3>(0, 0) =
+      Eigen::Quaterniond(orientation.w(), orientation.x(), orientation.y(),
+                         orientation.z())
+          .normalized()
+          .toRotationMatrix();
+  T_World_Baselink.block<3, 1>(0, 3) =
+      Eigen::Vector3d(position.x(), position.y(), position.z());
+  if (!filter_->AddSmootherPose(stamp, T_World_Baselink)) {
+    ROS_WARN_THROTTLE(10.0,
+                      "Smoother state at %.3f is older than the front-end "
+                      "odometry history, increase history_size.",
+                      stamp.toSec());
+  }
+}
+
+void FrontendOdometryPublisher::frontendCallback(
+    const nav_msgs::Odometry::ConstPtr& message, size_t source) {
+  Eigen::Matrix4d T_World_Baselink;
+  bs_common::OdometryMsgToTransformationMatrix(*message, T_World_Baselink);
+  if (!filter_->AddFrontendPose(source, message->header.stamp,
+                                T_World_Baselink)) {
+    return;
+  }
+  if (odom_publisher_.getNumSubscribers() == 0) { return; }
+  nav_msgs::Odometry odom_msg;
+  bs_common::EigenTransformToOdometryMsg(
+      filter_->Pose(), filter_->Stamp(), odom_publisher_counter_++,
+      world_frame_id_, baselink_frame_id_, odom_msg);
+  odom_publisher_.publish(odom_msg);
+}
+
+} // namespace bs_publishers
@@ -1,8 +1,12 @@
 #include <bs_publishers/odometry_3d_publisher.h>
 
+#include <algorithm>
+
 #include <pluginlib/class_list_macros.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 
+#include <bs_common/latency_tracer.h>
+#include <bs_common/task_scheduler.h>
 #include <bs_constraints/motion/unicycle_3d_predict.h>
 
 // Register this publisher with ROS as a plugin.
@@ -15,6 +19,10 @@ Odometry3DPublisher::Odometry3DPublisher()
       device_id_(fuse_core::uuid::NIL),
       latest_stamp_(Synchronizer::TIME_ZERO) {}
 
+Odometry3DPublisher::~Odometry3DPublisher() {
+  stopCovarianceWorker();
+}
+
 void Odometry3DPublisher::onInit() {
   // Read settings from the parameter sever
   device_id_ = fuse_variables::loadDeviceId(private_node_handle_);
@@ -38,6 +46,8 @@ void Odometry3DPublisher::onInit() {
 void Odometry3DPublisher::notifyCallback(
     fuse_core::Transaction::ConstSharedPtr transaction,
     fuse_core::Graph::ConstSharedPtr graph) {
+  const ros::WallTime receive_time = ros::WallTime::now();
+
   // Find the most recent common timestamp
   latest_stamp_ = synchronizer_.findLatestCommonStamp(*transaction, *graph);
   if (latest_stamp_ == Synchronizer::TIME_ZERO) {
@@ -46,6 +56,9 @@ void Odometry3DPublisher::notifyCallback(
         "Failed to find a matching set of position and orientation variables.");
     return;
   }
+  // the age at the end of this stage is the age of the published pose
+  bs_common::ScopedTrace trace("odometry_3d_publisher", latest_stamp_,
+                               receive_time);
 
   // Get the pose values associated with the selected timestamp
   fuse_core::UUID position_uuid;
@@ -56,6 +69,7 @@ void Odometry3DPublisher::notifyCallback(
   if (!getState(*graph, latest_stamp_, device_id_, position_uuid,
                 orientation_uuid, velocity_linear_uuid, velocity_angular_uuid,
                 odom_output_)) {
+    trace.Cancel();
     return;
   }
 
@@ -65,67 +79,127 @@ void Odometry3DPublisher::notifyCallback(
 
   // Don't waste CPU computing the covariance if nobody is listening
   if (odom_pub_.getNumSubscribers() > 0) {
-    try {
-      std::vector<std::pair<fuse_core::UUID, fuse_core::UUID>>
-          covariance_requests;
-      covariance_requests.emplace_back(position_uuid, position_uuid);
-      covariance_requests.emplace_back(position_uuid, orientation_uuid);
-      covariance_requests.emplace_back(orientation_uuid, orientation_uuid);
-      covariance_requests.emplace_back(velocity_linear_uuid,
-                                       velocity_linear_uuid);
-      covariance_requests.emplace_back(velocity_linear_uuid,
-                                       velocity_angular_uuid);
-      covariance_requests.emplace_back(velocity_angular_uuid,
-                                       velocity_angular_uuid);
+    // The covariance is computed by the worker at a lower rate since it
+    // factorizes the whole window, and the latest result is reused in between
+    const ros::Time now = ros::Time::now();
+    if (now - last_covariance_request_time_ >= params_.covariance_period) {
+      last_covariance_request_time_ = now;
+      CovarianceJob job;
+      job.graph = graph;
+      job.stamp = latest_stamp_;
+      job.requests.emplace_back(position_uuid, position_uuid);
+      job.requests.emplace_back(position_uuid, orientation_uuid);
+      job.requests.emplace_back(orientation_uuid, orientation_uuid);
+      job.requests.emplace_back(velocity_linear_uuid, velocity_linear_uuid);
+      job.requests.emplace_back(velocity_linear_uuid, velocity_angular_uuid);
+      job.requests.emplace_back(velocity_angular_uuid, velocity_angular_uuid);
+      {
+        std::lock_guard<std::mutex> lock(covariance_mutex_);
+        covariance_job_ = std::move(job);
+      }
+      covariance_cv_.notify_one();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(covariance_mutex_);
+      odom_output_.pose.covariance = latest_covariance_.pose.covariance;
+      odom_output_.twist.covariance = latest_covariance_.twist.covariance;
+    }
+    if (!params_.predict_to_current_time ||
+        !params_.publish_predicted_odometry) {
+      odom_pub_.publish(odom_output_);
+    }
+  }
+}
 
+void Odometry3DPublisher::covarianceWorker() {
+  while (true) {
+    CovarianceJob job;
+    {
+      std::unique_lock<std::mutex> lock(covariance_mutex_);
+      covariance_cv_.wait(lock, [this] {
+        return stop_covariance_worker_ || covariance_job_.has_value();
+      });
+      if (stop_covariance_worker_) { return; }
+      job = std::move(*covariance_job_);
+      covariance_job_.reset();
+    }
+
+    nav_msgs::Odometry covariance;
+    try {
       std::vector<std::vector<double>> covariance_matrices;
-      graph->getCovariance(covariance_requests, covariance_matrices,
-                           params_.covariance_options);
-
-      odom_output_.pose.covariance[0] = covariance_matrices[0][0];
-      odom_output_.pose.covariance[1] = covariance_matrices[0][1];
-      odom_output_.pose.covariance[5] = covariance_matrices[1][0];
-      odom_output_.pose.covariance[6] = covariance_matrices[0][2];
-      odom_output_.pose.covariance[7] = covariance_matrices[0][3];
-      odom_output_.pose.covariance[11] = covariance_matrices[1][1];
-      odom_output_.pose.covariance[30] = covariance_matrices[1][0];
-      odom_output_.pose.covariance[31] = covariance_matrices[1][1];
-      odom_output_.pose.covariance[35] = covariance_matrices[2][0];
-
-      odom_output_.twist.covariance[0] = covariance_matrices[3][0];
-      odom_output_.twist.covariance[1] = covariance_matrices[3][1];
-      odom_output_.twist.covariance[5] = covariance_matrices[4][0];
-      odom_output_.twist.covariance[6] = covariance_matrices[3][2];
-      odom_output_.twist.covariance[7] = covariance_matrices[3][3];
-      odom_output_.twist.covariance[11] = covariance_matrices[4][1];
-      odom_output_.twist.covariance[30] = covariance_matrices[4][0];
-      odom_output_.twist.covariance[31] = covariance_matrices[4][1];
-      odom_output_.twist.covariance[35] = covariance_matrices[5][0];
+      ceres::Covariance::Options covariance_options =
+          params_.covariance_options;
+      covariance_options.num_threads =
+          params_.covariance_threads > 0
+              ? params_.covariance_threads
+              : bs_common::TaskScheduler::GetInstance().NumThreads();
+      job.graph->getCovariance(job.requests, covariance_matrices,
+                               covariance_options);
+
+      covariance.pose.covariance[0] = covariance_matrices[0][0];
+      covariance.pose.covariance[1] = covariance_matrices[0][1];
+      covariance.pose.covariance[5] = covariance_matrices[1][0];
+      covariance.pose.covariance[6] = covariance_matrices[0][2];
+      covariance.pose.covariance[7] = covariance_matrices[0][3];
+      covariance.pose.covariance[11] = covariance_matrices[1][1];
+      covariance.pose.covariance[30] = covariance_matrices[1][0];
+      covariance.pose.covariance[31] = covariance_matrices[1][1];
+      covariance.pose.covariance[35] = covariance_matrices[2][0];
+
+      covariance.twist.covariance[0] = covariance_matrices[3][0];
+      covariance.twist.covariance[1] = covariance_matrices[3][1];
+      covariance.twist.covariance[5] = covariance_matrices[4][0];
+      covariance.twist.covariance[6] = covariance_matrices[3][2];
+      covariance.twist.covariance[7] = covariance_matrices[3][3];
+      covariance.twist.covariance[11] = covariance_matrices[4][1];
+      covariance.twist.covariance[30] = covariance_matrices[4][0];
+      covariance.twist.covariance[31] = covariance_matrices[4][1];
+      covariance.twist.covariance[35] = covariance_matrices[5][0];
     } catch (const std::exception& e) {
       ROS_WARN_STREAM(
           "An error occurred computing the covariance information for "
-          << latest_stamp_
+          << job.stamp
           << ". "
              "The covariance will be set to zero.\n"
           << e.what());
-      std::fill(odom_output_.pose.covariance.begin(),
-                odom_output_.pose.covariance.end(), 0.0);
-      std::fill(odom_output_.twist.covariance.begin(),
-                odom_output_.twist.covariance.end(), 0.0);
     }
-    odom_pub_.publish(odom_output_);
+
+    std::lock_guard<std::mutex> lock(covariance_mutex_);
+    latest_covariance_.pose.covariance = covariance.pose.covariance;
+    latest_covariance_.twist.covariance = covariance.twist.covariance;
+  }
+}
+
+void Odometry3DPublisher::stopCovarianceWorker() {
+  {
+    std::lock_guard<std::mutex> lock(covariance_mutex_);
+    if (!covariance_thread_.joinable()) { return; }
+    stop_covariance_worker_ = true;
   }
+  covariance_cv_.notify_one();
+  covariance_thread_.join();
 }
 
 void Odometry3DPublisher::onStart() {
   synchronizer_ = Synchronizer(device_id_);
   latest_stamp_ = Synchronizer::TIME_ZERO;
   odom_output_ = nav_msgs::Odometry();
+  last_covariance_request_time_ = ros::Time(0);
+  {
+    std::lock_guard<std::mutex> lock(covariance_mutex_);
+    latest_covariance_ = nav_msgs::Odometry();
+    covariance_job_.reset();
+    stop_covariance_worker_ = false;
+  }
+  covariance_thread_ =
+      std::thread(&Odometry3DPublisher::covarianceWorker, this);
   tf_publish_timer_.start();
 }
 
 void Odometry3DPublisher::onStop() {
   tf_publish_timer_.stop();
+  stopCovarianceWorker();
 }
 
 bool Odometry3DPublisher::getState(
@@ -198,7 +272,8 @@ void Odometry3DPublisher::tfPublishTimerCallback(const ros::TimerEvent& event) {
   trans.child_frame_id = odom_output_.child_frame_id;
 
   // If requested, we need to project our state forward in time using the 3D
-  // kinematic model
+  // kinematic model. The prediction is bounded so that a stalled optimizer
+  // doesn't make the pose drift away with the last velocity
   if (params_.predict_to_current_time) {
     tf2::Vector3 velocity_linear;
     tf2::Vector3 velocity_angular;
@@ -208,12 +283,30 @@ void Odometry3DPublisher::tfPublishTimerCallback(const ros::TimerEvent& event) {
     tf2::Vector3 unused_acc;
     tf2::Vector3 unused_angular_vel;
 
-    bs_constraints::predict(
-        pose, velocity_linear, velocity_angular, unused_acc,
-        event.current_real.toSec() - odom_output_.header.stamp.toSec(), pose,
-        velocity_linear, unused_angular_vel, unused_acc);
+    double dt = std::max(
+        event.current_real.toSec() - odom_output_.header.stamp.toSec(), 0.0);
+    if (params_.max_prediction_time > 0 && dt > params_.max_prediction_time) {
+      ROS_WARN_THROTTLE(5.0, "Latest state is older than the maximum "
+                             "prediction time, holding predicted pose.");
+      dt = params_.max_prediction_time;
+    }
 
-    trans.header.stamp = event.current_real;
+    bs_constraints::predict(pose, velocity_linear, velocity_angular,
+                            unused_acc, dt, pose, velocity_linear,
+                            unused_angular_vel, unused_acc);
+
+    trans.header.stamp = odom_output_.header.stamp + ros::Duration(dt);
+
+    // Publish the predicted odometry at the timer rate, instead of the
+    // optimized odometry after each optimization
+    if (params_.publish_predicted_odometry &&
+        odom_pub_.getNumSubscribers() > 0) {
+      nav_msgs::Odometry predicted_odom = odom_output_;
+      predicted_odom.header.stamp = trans.header.stamp;
+      tf2::toMsg(pose, predicted_odom.pose.pose);
+      predicted_odom.twist.twist.linear = tf2::toMsg(velocity_linear);
+      odom_pub_.publish(predicted_odom);
+    }
   }
 
   trans.transform.translation.x = pose.getOrigin().x();
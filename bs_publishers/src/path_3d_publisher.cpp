@@ -37,12 +37,23 @@ void Path3DPublisher::onInit() {
     pose_array_topic = "pose_array";
   }
 
+  std::string delta_path_topic;
+  if (!private_node_handle_.getParam("delta_path_topic", delta_path_topic)) {
+    delta_path_topic = "path_delta";
+  }
+  double full_path_period;
+  if (private_node_handle_.getParam("full_path_period", full_path_period)) {
+    full_path_period_ = ros::Duration(full_path_period);
+  }
+
   // Advertise the topic
   path_publisher_ =
       private_node_handle_.advertise<nav_msgs::Path>(path_topic, 1);
   pose_array_publisher_ =
       private_node_handle_.advertise<geometry_msgs::PoseArray>(pose_array_topic,
                                                                1);
+  delta_path_publisher_ =
+      private_node_handle_.advertise<nav_msgs::Path>(delta_path_topic, 1);
 }
 
 void Path3DPublisher::onStart() {
@@ -53,49 +64,125 @@ void Path3DPublisher::onStart() {
 }
 
 void Path3DPublisher::notifyCallback(
-    fuse_core::Transaction::ConstSharedPtr /*transaction*/,
+    fuse_core::Transaction::ConstSharedPtr transaction,
     fuse_core::Graph::ConstSharedPtr graph) {
+  // The path is seeded from the graph once, after that the transactions tell
+  // which poses were added and removed. This has to be tracked even if no one
+  // is listening.
+  std::vector<geometry_msgs::PoseStamped> added_poses;
+  if (!initialized_) {
+    for (const auto& variable : graph->getVariables()) {
+      AddPose(variable, *graph);
+    }
+    initialized_ = true;
+  } else {
+    for (const auto& uuid : transaction->removedVariables()) {
+      RemovePose(uuid);
+    }
+    for (const auto& variable : transaction->addedVariables()) {
+      if (!AddPose(variable, *graph)) { continue; }
+      const auto& orientation =
+          dynamic_cast<const fuse_variables::Orientation3DStamped&>(variable);
+      added_poses.push_back(path_.at(orientation.stamp()).pose);
+    }
+  }
+
+  // Exit if there are no poses
+  if (path_.empty()) { return; }
+
+  // Publish the poses added by this transaction, sorted by timestamp
+  if (!added_poses.empty() && delta_path_publisher_.getNumSubscribers() > 0) {
+    auto compare_stamps = [](const geometry_msgs::PoseStamped& pose1,
+                             const geometry_msgs::PoseStamped& pose2) {
+      return pose1.header.stamp < pose2.header.stamp;
+    };
+    std::sort(added_poses.begin(), added_poses.end(), compare_stamps);
+    nav_msgs::Path delta_msg;
+    delta_msg.header.stamp = added_poses.back().header.stamp;
+    delta_msg.header.frame_id = world_frame_id_;
+    delta_msg.poses = std::move(added_poses);
+    delta_path_publisher_.publish(delta_msg);
+  }
+
+  // Publish the full path at a lower rate
+  const ros::Time now = ros::Time::now();
+  if (now - last_full_path_time_ < full_path_period_) { return; }
+  last_full_path_time_ = now;
+  PublishFullPath(*graph);
+}
+
+bool Path3DPublisher::AddPose(const fuse_core::Variable& variable,
+                              const fuse_core::Graph& graph) {
+  auto orientation =
+      dynamic_cast<const fuse_variables::Orientation3DStamped*>(&variable);
+  if (!orientation || (orientation->deviceId() != device_id_)) {
+    return false;
+  }
+  const auto& stamp = orientation->stamp();
+  auto position_uuid =
+      fuse_variables::Position3DStamped(stamp, device_id_).uuid();
+  if (!graph.variableExists(position_uuid)) { return false; }
+
+  PathPose path_pose;
+  path_pose.position_uuid = position_uuid;
+  path_pose.orientation_uuid = orientation->uuid();
+  path_pose.pose.header.stamp = stamp;
+  path_pose.pose.header.frame_id = baselink_frame_id_;
+  if (!UpdatePose(path_pose, graph)) { return false; }
+
+  path_[stamp] = path_pose;
+  stamps_[path_pose.position_uuid] = stamp;
+  stamps_[path_pose.orientation_uuid] = stamp;
+  return true;
+}
+
+void Path3DPublisher::RemovePose(const fuse_core::UUID& uuid) {
+  auto stamp_iter = stamps_.find(uuid);
+  if (stamp_iter == stamps_.end()) { return; }
+  auto path_iter = path_.find(stamp_iter->second);
+  stamps_.erase(path_iter->second.position_uuid);
+  stamps_.erase(path_iter->second.orientation_uuid);
+  path_.erase(path_iter);
+}
+
+bool Path3DPublisher::UpdatePose(PathPose& path_pose,
+                                 const fuse_core::Graph& graph) const {
+  if (!graph.variableExists(path_pose.position_uuid) ||
+      !graph.variableExists(path_pose.orientation_uuid)) {
+    return false;
+  }
+  auto position = dynamic_cast<const fuse_variables::Position3DStamped*>(
+      &graph.getVariable(path_pose.position_uuid));
+  auto orientation = dynamic_cast<const fuse_variables::Orientation3DStamped*>(
+      &graph.getVariable(path_pose.orientation_uuid));
+  if (!position || !orientation) { return false; }
+  path_pose.pose.pose.position.x = position->x();
+  path_pose.pose.pose.position.y = position->y();
+  path_pose.pose.pose.position.z = position->z();
+  path_pose.pose.pose.orientation =
+      tf2::toMsg(tf2::Quaternion(orientation->x(), orientation->y(),
+                                 orientation->z(), orientation->w()));
+  return true;
+}
+
+void Path3DPublisher::PublishFullPath(const fuse_core::Graph& graph) {
   // Exit early if no one is listening
   if ((path_publisher_.getNumSubscribers() == 0) &&
       (pose_array_publisher_.getNumSubscribers() == 0)) {
     return;
   }
 
-  // Extract all of the 3D pose variables to the path
+  // Read the latest estimates of the path, which is already sorted
   std::vector<geometry_msgs::PoseStamped> poses;
-  for (const auto& variable : graph->getVariables()) {
-    auto orientation =
-        dynamic_cast<const fuse_variables::Orientation3DStamped*>(&variable);
-    if (orientation && (orientation->deviceId() == device_id_)) {
-      const auto& stamp = orientation->stamp();
-      auto position_uuid =
-          fuse_variables::Position3DStamped(stamp, device_id_).uuid();
-      if (!graph->variableExists(position_uuid)) { continue; }
-      auto position = dynamic_cast<const fuse_variables::Position3DStamped*>(
-          &graph->getVariable(position_uuid));
-      geometry_msgs::PoseStamped pose;
-      pose.header.stamp = stamp;
-      pose.header.frame_id = baselink_frame_id_;
-      pose.pose.position.x = position->x();
-      pose.pose.position.y = position->y();
-      pose.pose.position.z = position->z();
-      pose.pose.orientation =
-          tf2::toMsg(tf2::Quaternion(orientation->x(), orientation->y(),
-                                     orientation->z(), orientation->w()));
-      poses.push_back(std::move(pose));
-    }
+  poses.reserve(path_.size());
+  for (auto& [stamp, path_pose] : path_) {
+    if (!UpdatePose(path_pose, graph)) { continue; }
+    poses.push_back(path_pose.pose);
   }
 
   // Exit if there are no poses
   if (poses.empty()) { return; }
 
-  // Sort the poses by timestamp
-  auto compare_stamps = [](const geometry_msgs::PoseStamped& pose1,
-                           const geometry_msgs::PoseStamped& pose2) {
-    return pose1.header.stamp < pose2.header.stamp;
-  };
-  std::sort(poses.begin(), poses.end(), compare_stamps);
-
   // Define the header for the aggregate message
   std_msgs::Header header;
   header.stamp = poses.back().header.stamp;
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <nlohmann/json.hpp>
+
+#include <bs_common/trajectory_buffer.h>
+#include <bs_tools/trajectory_errors.h>
+
+namespace bs_tools {
+
+/**
+ * @brief Gets the points which are not dominated by any other point, i.e. no
+ * other point is at least as good in all objectives and better in one
+ * @param objectives one vector of objectives to minimize per point, all of
+ * the same size
+ * @return indices of the Pareto optimal points, in increasing order
+ */
+std::vector<size_t>
+    ParetoFront(const std::vector<std::vector<double>>& objectives);
+
+/**
+ * @brief Parameter of the local mapper which is tuned. This is either a ros
+ * param of the local mapper, e.g. "lag_duration", or a value of a json config
+ * referred to by a ros param, in which case each trial writes its own copy of
+ * that json config and points the ros param to it
+ */
+struct TunedParameter {
+  /** ros param relative to the local mapper's namespace, or the key of the
+   * value in the json config separated by '/', e.g. "retention/max_distance_m"
+   */
+  std::string name;
+
+  /** json config relative to the beam slam config folder, e.g.
+   * "registration/scan_to_map.json". Empty for a ros param */
+  std::string config_file;
+
+  /** ros params pointing to config_file, e.g.
+   * "lidar_odometry/registration_config" */
+  std::vector<std::string> config_params;
+
+  /** values to try. If empty, values are in [min, max] */
+  std::vector<nlohmann::json> values;
+  double min{0};
+  double max{0};
+  bool integer{false};
+
+  /** values between min and max tried by a grid search */
+  int grid_steps{3};
+
+  /**
+   * @brief load from json, throws if invalid
+   */
+  void LoadFromJson(const nlohmann::json& J);
+
+  /**
+   * @brief gets the value at a normalized position in [0, 1], i.e. a value
+   * index or a position between min and max
+   */
+  nlohmann::json Value(double x) const;
+
+  /**
+   * @brief gets the normalized position in [0, 1] of a value
+   */
+  double Normalize(const nlohmann::json& value) const;
+};
+
+/**
+ * @brief Bag the local mapper is replayed on, with its reference trajectory
+ */
+struct TuningBag {
+  std::string bag_file;
+
+  /** pose file (.json, .txt or .ply, see beam_mapping::Poses) or trajectory
+   * file (see bs_common/trajectory_file.h) */
+  std::string reference_file;
+};
+
+/**
+ * @brief Tunes the params of the local mapper for the trade off between
+ * latency and accuracy. Each trial replays all bags through the local mapper
+ * with one set of parameter values, using bs_tools_replay_node (see
+ * replay.launch), and is scored with the ATE and RPE against the reference
+ * trajectories and the p99 processing time of the stages of the pipeline.
+ * Trials run in parallel, each with its own ros master.
+ *
+ * The parameter values are either a grid over all values, random samples, or
+ * chosen by bayesian optimization: after random initial trials, each trial
+ * maximizes the expected improvement of a gaussian process fit to a random
+ * weighting of the normalized objectives (ParEGO), so that successive trials
+ * explore different parts of the Pareto front.
+ *
+ * All trials and the Pareto optimal ones are written to the output directory,
+ * with one override config per trial which can be loaded on top of the
+ * local mapper config.
+ */
+class ConfigTuner {
+public:
+  struct Params {
+    /** name of the study, the json configs of the trials are written to
+     * $(config folder)/tuning/<name> so that they can be referred to by
+     * paths relative to the config folder */
+    std::string name{"study"};
+
+    /** where the override config, logs and results of each trial go */
+    std::string output_directory;
+
+    /** launch file that replays a bag, with bag_file, overrides,
+     * results_file and trajectory_file args */
+    std::string launch_package{"beam_slam_launch"};
+    std::string launch_file{"replay.launch"};
+
+    /** other args passed to the launch file, e.g. config */
+    std::map<std::string, std::string> launch_args;
+
+    /** grid, random or bayesian */
+    std::string search{"bayesian"};
+
+    /** trials of the random and bayesian searches */
+    int num_trials{20};
+
+    /** random trials before the bayesian optimization */
+    int num_initial_trials{5};
+
+    /** trials run at the same time */
+    int parallel_trials{1};
+
+    /** ros master port of the first parallel trial, the others use the next
+     * ports */
+    int base_port{11411};
+
+    int seed{0};
+
+    double rpe_delta_s{1};
+
+    /** stages whose p99 processing times are summed into the latency score */
+    std::vector<std::string> latency_metrics{"lidar_odometry/process",
+                                             "fixed_lag_smoother/optimize"};
+
+    std::vector<TuningBag> bags;
+    std::vector<TunedParameter> parameters;
+
+    /**
+     * @brief load from json, throws if invalid
+     */
+    void LoadFromJson(const nlohmann::json& J);
+  };
+
+  struct Trial {
+    size_t id{0};
+
+    /** one value per tuned parameter */
+    std::vector<nlohmann::json> values;
+
+    /** false if any of the replays failed */
+    bool succeeded{false};
+
+    /** averaged over all bags */
+    double ate_m{0};
+    double rpe_m{0};
+    double latency_s{0};
+
+    /** p99 of each latency metric, max over all bags */
+    std::map<std::string, double> stage_p99_s;
+
+    /**
+     * @brief objectives to minimize
+     */
+    std::vector<double> Objectives() const {
+      return {ate_m, rpe_m, latency_s};
+    }
+  };
+
+  /**
+   * @brief constructor, loads the reference trajectories
+   */
+  explicit ConfigTuner(const Params& params);
+
+  /**
+   * @brief runs all trials and writes the results. Blocks until done
+   */
+  void Run();
+
+  const std::vector<Trial>& Trials() const { return trials_; }
+
+  /**
+   * @brief gets the Pareto optimal trials among the successful ones
+   */
+  std::vector<Trial> ParetoOptimalTrials() const;
+
+private:
+  /**
+   * @brief gets the values of all trials of a grid search
+   */
+  std::vector<std::vector<nlohmann::json>> GridValues() const;
+
+  std::vector<nlohmann::json> RandomValues();
+
+  /**
+   * @brief gets the values maximizing the expected improvement of a random
+   * scalarization of the objectives of the previous trials
+   */
+  std::vector<nlohmann::json> BayesianValues();
+
+  /**
+   * @brief runs trials in parallel, one per set of values
+   */
+  void RunTrials(const std::vector<std::vector<nlohmann::json>>& values);
+
+  void RunTrial(Trial& trial, int slot) const;
+
+  /**
+   * @brief writes the override config of a trial, and the json configs it
+   * refers to
+   * @return path to the override config
+   */
+  std::string WriteOverrides(const Trial& trial) const;
+
+  std::string TrialDirectory(size_t id) const;
+
+  nlohmann::json TrialToJson(const Trial& trial) const;
+
+  void WriteResults() const;
+
+  Params params_;
+  std::vector<bs_common::Trajectory> references_;
+  std::vector<Trial> trials_;
+  std::mt19937 generator_;
+};
+
+} // namespace bs_tools
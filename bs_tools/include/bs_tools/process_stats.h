@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace bs_tools {
+
+/**
+ * @brief CPU time used by a thread of this process
+ */
+struct ThreadCpuTime {
+  int tid{0};
+
+  /** name of the thread, which is the process name unless the thread was
+   * named */
+  std::string name;
+
+  /** user and system time */
+  double cpu_s{0};
+};
+
+/**
+ * @brief Reads the CPU times of all threads of this process that are still
+ * running, from /proc/self/task
+ */
+std::vector<ThreadCpuTime> GetThreadCpuTimes();
+
+/**
+ * @brief Gets the user and system time of this process, including the
+ * threads that already ended
+ */
+double GetProcessCpuTime();
+
+/**
+ * @brief Gets the peak resident set size of this process, from
+ * /proc/self/status
+ * @return 0 if it cannot be read
+ */
+double GetPeakRssMb();
+
+/**
+ * @brief Gets the hostname, CPU model, number of CPUs and memory of this
+ * machine, so that results measured on different machines can be told apart
+ */
+nlohmann::json GetHostInfo();
+
+} // namespace bs_tools
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include <bs_common/trajectory_buffer.h>
+
+namespace bs_tools {
+
+/**
+ * @brief Replay of a bag through the local mapper, run as its own roslaunch
+ * with bs_tools_replay_node (see replay.launch)
+ */
+struct ReplayRun {
+  std::string launch_package{"beam_slam_launch"};
+  std::string launch_file{"replay.launch"};
+
+  /** args of the launch file, e.g. bag_file or config. The results_file and
+   * trajectory_file args are set by RunReplay */
+  std::map<std::string, std::string> args;
+
+  /** port of the ros master started for this replay, replays with different
+   * ports can run at the same time */
+  int port{11311};
+
+  /** outputs are written to <prefix>.log, <prefix>_results.json and
+   * <prefix>_trajectory.bin */
+  std::string output_prefix;
+};
+
+/**
+ * @brief Runs a replay and waits for it to finish
+ * @param run replay to run
+ * @param results [out] results written by the replay node, see
+ * replay/results_file in replay_node.cpp
+ * @param trajectory [out] trajectory estimated by the replay
+ * @return false if the replay failed or did not write its outputs
+ */
+bool RunReplay(const ReplayRun& run, nlohmann::json& results,
+               bs_common::Trajectory& trajectory);
+
+/**
+ * @brief Loads a pose file (.json, .txt or .ply, see beam_mapping::Poses) or
+ * a trajectory file (see bs_common/trajectory_file.h), throws if it cannot be
+ * loaded
+ */
+bs_common::Trajectory LoadTrajectory(const std::string& path);
+
+/**
+ * @brief Writes nested json objects as a yaml file that can be loaded with
+ * rosparam. Floats always get a decimal point, since yaml 1.1 (used by
+ * rosparam) reads e.g. 1e-06 as a string
+ * @return false if the file cannot be written
+ */
+bool WriteYaml(const std::string& path, const nlohmann::json& J);
+
+} // namespace bs_tools
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace bs_tools {
+
+/**
+ * @brief Dataset and config the local mapper is scored on, e.g. one of the
+ * examples in beam_slam_launch/config/examples
+ */
+struct ScoringCase {
+  std::string name;
+  std::string bag_file;
+
+  /** reference trajectory, see LoadTrajectory. If empty, the trajectory
+   * error is not scored */
+  std::string reference_file;
+
+  /** args of the launch file, e.g. config, calibration_params and
+   * extrinsics_file_path. $(beam_slam_config) and $(beam_slam_calibrations)
+   * are replaced by the config and calibrations folders */
+  std::map<std::string, std::string> launch_args;
+
+  /** params of the replay node, e.g. sync_metrics, which are specific to the
+   * topics of the dataset, see replay.yaml */
+  nlohmann::json replay = nlohmann::json::object();
+
+  /**
+   * @brief load from json, throws if invalid
+   */
+  void LoadFromJson(const nlohmann::json& J);
+};
+
+/**
+ * @brief Standard performance scoring of the local mapper. Each case is
+ * replayed with bs_tools_replay_node (see replay.launch) and scored with:
+ *
+ *  - the rate at which scans, frames or any other instrumented unit of work
+ *    are processed
+ *  - the count and latency percentiles of every instrumented stage
+ *  - the peak RSS, and the CPU time and utilization of the process and of
+ *    each of its threads
+ *  - the ATE and RPE against a reference trajectory
+ *
+ * The cases run one after the other so that they do not compete for the
+ * machine, and the scores of all cases are gathered in a json report along
+ * with the machine they were measured on. Reports of different releases or
+ * machines can then be compared with CompareReports.
+ */
+class ScoringSuite {
+public:
+  /** version of the report format, bumped whenever it changes */
+  static constexpr int kReportVersion = 1;
+
+  struct Params {
+    /** where the replay configs, logs and results of all cases go */
+    std::string output_directory;
+
+    std::string launch_package{"beam_slam_launch"};
+    std::string launch_file{"replay.launch"};
+
+    /** port of the ros master of the replays */
+    int port{11411};
+
+    double rpe_delta_s{1};
+
+    /** name of a unit of work to the metric recorded for each of them, the
+     * rate of each is reported as <name>_per_s */
+    std::map<std::string, std::string> throughput_metrics{
+        {"scans", "lidar_odometry/process"},
+        {"frames", "visual_feature_tracker/track"}};
+
+    std::vector<ScoringCase> cases;
+
+    /**
+     * @brief load from json, throws if invalid
+     */
+    void LoadFromJson(const nlohmann::json& J);
+  };
+
+  explicit ScoringSuite(const Params& params);
+
+  /**
+   * @brief runs all cases, skipping the ones without a bag
+   * @param label identifies what is scored, e.g. a release or commit
+   * @return report
+   */
+  nlohmann::json Run(const std::string& label) const;
+
+private:
+  nlohmann::json RunCase(const ScoringCase& scoring_case) const;
+
+  Params params_;
+};
+
+/**
+ * @brief Logs the relative change of the main scores of the cases found in
+ * both reports
+ */
+void CompareReports(const nlohmann::json& baseline,
+                    const nlohmann::json& report);
+
+} // namespace bs_tools
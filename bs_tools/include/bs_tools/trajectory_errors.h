@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bs_common/trajectory_buffer.h>
+
+namespace bs_tools {
+
+/**
+ * @brief Accuracy of an estimated trajectory against a reference trajectory
+ */
+struct TrajectoryErrors {
+  /** RMSE of the positions after a rigid alignment to the reference */
+  double ate_m{0};
+
+  /** RMSE of the translation error of relative poses over rpe_delta_s */
+  double rpe_m{0};
+
+  /** number of estimated poses inside of the reference trajectory */
+  size_t num_poses{0};
+};
+
+/**
+ * @brief Computes the absolute and relative trajectory errors. The
+ * reference is interpolated at the estimated stamps, and the estimate is
+ * rigidly aligned to it (umeyama, without scale) before computing the ATE
+ * @param estimate estimated trajectory
+ * @param reference reference trajectory, e.g. ground truth
+ * @param rpe_delta_s time between the poses of the relative pose errors
+ * @param errors [out] errors
+ * @return false if fewer than 3 estimated poses are inside of the reference
+ */
+bool ComputeTrajectoryErrors(const bs_common::Trajectory& estimate,
+                             const bs_common::Trajectory& reference,
+                             double rpe_delta_s, TrajectoryErrors& errors);
+
+} // namespace bs_tools
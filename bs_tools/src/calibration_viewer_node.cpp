@@ -1,8 +1,13 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
 #include <ros/ros.h>
 
 #include <pcl/common/transforms.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/image_encodings.h>
 
 #include <beam_calibration/CameraModel.h>
 #include <beam_cv/OpenCVConversions.h>
@@ -16,8 +21,10 @@ struct ScanStamped {
   ros::Time stamp;
 };
 
+// images are only converted once they are displayed, since most of them are
+// dropped while waiting for a scan
 struct ImageStamped {
-  cv::Mat image;
+  sensor_msgs::Image::ConstPtr msg;
   ros::Time stamp;
 };
 
@@ -56,6 +63,11 @@ struct CalibrationViewer {
     }
     camera_intrinsics_path_ = beam::CombinePaths(
         bs_common::GetBeamSlamCalibrationsPath(), camera_intrinsics_path_rel);
+
+    // only the closest point is drawn in each cell of this size, so dense
+    // scans don't cost more to draw than the image can show
+    nh_.param<int>("point_cell_size_px", point_cell_size_px_, 3);
+    point_cell_size_px_ = std::max(point_cell_size_px_, 1);
   }
 
   void Setup() {
@@ -75,7 +87,7 @@ struct CalibrationViewer {
 
   void ImageCallback(const sensor_msgs::Image::ConstPtr& msg) {
     ImageStamped i;
-    i.image = beam_cv::OpenCVConversions::RosImgToMat(*msg).clone();
+    i.msg = msg;
     i.stamp = msg->header.stamp;
     images_.emplace(i);
     ProcessData();
@@ -111,8 +123,8 @@ struct CalibrationViewer {
         continue;
       } else if (scan.start <= image.stamp && scan.end >= image.stamp) {
         pcl::PointCloud<PointXYZIRT> cloud_aligned =
-            AlignScanToTime(scan.scan, image.stamp);
-        DisplayData(cloud_aligned, image.image, image.stamp);
+            AlignScanToTime(scan, image.stamp);
+        DisplayData(cloud_aligned, *image.msg, image.stamp);
         images_.pop();
       }
     }
@@ -121,9 +133,8 @@ struct CalibrationViewer {
     while (images_.size() > 3) { images_.pop(); }
   }
 
-  pcl::PointCloud<PointXYZIRT>
-      AlignScanToTime(const pcl::PointCloud<PointXYZIRT>& scan,
-                      const ros::Time& stamp) {
+  pcl::PointCloud<PointXYZIRT> AlignScanToTime(const ScanStamped& scan,
+                                               const ros::Time& stamp) {
     pcl::PointCloud<PointXYZIRT> cloud_aligned;
 
     // get pose of at the align time
@@ -134,55 +145,107 @@ struct CalibrationViewer {
                         std::to_string(stamp.toSec()).c_str());
       return cloud_aligned;
     }
-    Eigen::Matrix4f T_Lidar0_World =
-        beam::InvertTransform(T_World_Lidar0).cast<float>();
+    const Eigen::Matrix4d T_Lidar0_World =
+        beam::InvertTransform(T_World_Lidar0);
+
+    // points share the stamps of their firing, so the poses are looked up
+    // once per unique stamp, in a single walk of the trajectory. Points past
+    // the odometry are skipped
+    const ros::Time odometry_end = frame_initializer_->OdometryEndTime();
+    std::vector<size_t> order(scan.scan.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&scan](size_t a, size_t b) {
+      return scan.scan[a].time < scan.scan[b].time;
+    });
+    std::vector<ros::Time> times;
+    std::vector<size_t> point_indices;
+    std::vector<size_t> time_indices;
+    for (const size_t i : order) {
+      const ros::Time pt = scan.stamp + ros::Duration(scan.scan[i].time);
+      if (pt > odometry_end) { break; }
+      if (times.empty() || times.back() != pt) { times.push_back(pt); }
+      point_indices.push_back(i);
+      time_indices.push_back(times.size() - 1);
+    }
+    std::vector<Eigen::Matrix4d, beam::AlignMat4d> Ts_World_LidarN;
+    std::string error_msg;
+    if (!frame_initializer_->GetPoses(Ts_World_LidarN, times,
+                                      extrinsics_.GetLidarFrameId(),
+                                      error_msg)) {
+      ROS_WARN_THROTTLE(1, "cannot get scan poses, skipping: %s",
+                        error_msg.c_str());
+      return cloud_aligned;
+    }
+    std::vector<Eigen::Affine3f, Eigen::aligned_allocator<Eigen::Affine3f>>
+        Ts_Lidar0_LidarN;
+    Ts_Lidar0_LidarN.reserve(times.size());
+    for (const auto& T_World_LidarN : Ts_World_LidarN) {
+      Ts_Lidar0_LidarN.emplace_back(
+          (T_Lidar0_World * T_World_LidarN).cast<float>());
+    }
 
     // align cloud
-    for (const auto& p : scan) {
-      ros::Time pt = stamp + ros::Duration(p.time);
-      Eigen::Matrix4d T_World_LidarN;
-      if (!frame_initializer_->GetPose(T_World_LidarN, pt,
-                                       extrinsics_.GetLidarFrameId())) {
-        // if any point doesn't return a valid result, then skip
-        continue;
-      }
-      Eigen::Affine3f T_Lidar0_LidarN(T_Lidar0_World *
-                                      T_World_LidarN.cast<float>());
-      PointXYZIRT p_aligned =
-          pcl::transformPoint<PointXYZIRT>(p, T_Lidar0_LidarN);
-      cloud_aligned.push_back(p_aligned);
+    cloud_aligned.reserve(point_indices.size());
+    for (size_t i = 0; i < point_indices.size(); i++) {
+      cloud_aligned.push_back(pcl::transformPoint<PointXYZIRT>(
+          scan.scan[point_indices[i]], Ts_Lidar0_LidarN[time_indices[i]]));
     }
     return cloud_aligned;
   }
 
   void DisplayData(const pcl::PointCloud<PointXYZIRT>& cloud,
-                   const cv::Mat& image, const ros::Time& stamp) {
+                   const sensor_msgs::Image& image_msg,
+                   const ros::Time& stamp) {
     Eigen::Matrix4d T_Cam_Lidar;
     if (!extrinsics_.GetT_CAMERA_LIDAR(T_Cam_Lidar, stamp)) {
       ROS_WARN("cannot get extrinsics, skipping image");
       return;
     }
-    pcl::PointCloud<PointXYZIRT> cloud_in_cam;
-    pcl::transformPointCloud(cloud, cloud_in_cam, Eigen::Affine3d(T_Cam_Lidar));
-    std::vector<Eigen::Vector3d> pixels;
-    for (const auto& p : cloud_in_cam) {
-      if (p.z < 0) { continue; }
+
+    // draw into a reused buffer instead of a new copy of every image. bgr8
+    // images are copied straight from the message
+    if (image_msg.encoding == sensor_msgs::image_encodings::BGR8) {
+      cv::Mat(image_msg.height, image_msg.width, CV_8UC3,
+              const_cast<uint8_t*>(image_msg.data.data()), image_msg.step)
+          .copyTo(image_);
+    } else {
+      beam_cv::OpenCVConversions::RosImgToMat(image_msg).copyTo(image_);
+    }
+
+    // keep the closest point of each cell
+    const int cell_size = point_cell_size_px_;
+    const int cell_cols = (image_.cols + cell_size - 1) / cell_size;
+    const int cell_rows = (image_.rows + cell_size - 1) / cell_size;
+    cell_depths_.assign(cell_cols * cell_rows,
+                        std::numeric_limits<double>::max());
+    cell_pixels_.resize(cell_depths_.size());
+    const Eigen::Matrix4f T = T_Cam_Lidar.cast<float>();
+    for (const auto& p : cloud) {
+      const Eigen::Vector3d p_in_cam =
+          (T.topLeftCorner<3, 3>() * Eigen::Vector3f(p.x, p.y, p.z) +
+           T.topRightCorner<3, 1>())
+              .cast<double>();
+      if (p_in_cam.z() < 0) { continue; }
       Eigen::Vector2d pixel;
-      Eigen::Vector3d p_in_cam(p.x, p.y, p.z);
       bool in_image;
       if (!camera_model_->ProjectPoint(p_in_cam, pixel, in_image)) { continue; }
-
       if (!in_image) { continue; }
-      Eigen::Vector3d v(pixel[0], pixel[1], p_in_cam.norm());
-      pixels.push_back(v);
+      const int c = std::clamp(static_cast<int>(pixel[0]) / cell_size, 0,
+                               cell_cols - 1);
+      const int r = std::clamp(static_cast<int>(pixel[1]) / cell_size, 0,
+                               cell_rows - 1);
+      const size_t cell = r * cell_cols + c;
+      const double d = p_in_cam.norm();
+      if (d < cell_depths_[cell]) {
+        cell_depths_[cell] = d;
+        cell_pixels_[cell] = cv::Point(pixel[0], pixel[1]);
+      }
     }
 
     static int radius = 1;
-    for (auto& pixel : pixels) {
-      cv::Point p(pixel[0], pixel[1]);
-      int r = static_cast<int>(pixel[1]);
-      int c = static_cast<int>(pixel[0]);
-      double d = pixel[2];
+    for (size_t cell = 0; cell < cell_depths_.size(); cell++) {
+      double d = cell_depths_[cell];
+      if (d == std::numeric_limits<double>::max()) { continue; }
       if (d > max_d_) {
         d = 255;
       } else if (d < min_d_) {
@@ -190,14 +253,14 @@ struct CalibrationViewer {
       } else {
         d = 255 * (d - min_d_) / (max_d_ - min_d_);
       }
-      cv::circle(image, p, radius, cv::Scalar(255 - d, 0, d));
+      cv::circle(image_, cell_pixels_[cell], radius, cv::Scalar(255 - d, 0, d));
     }
     std_msgs::Header header;
     header.stamp = stamp;
     header.seq = publisher_counter_++;
     header.frame_id = extrinsics_.GetCameraFrameId();
     sensor_msgs::Image out_msg =
-        beam_cv::OpenCVConversions::MatToRosImg(image, header, "bgr8");
+        beam_cv::OpenCVConversions::MatToRosImg(image_, header, "bgr8");
     image_publisher_.publish(out_msg);
   }
 
@@ -217,6 +280,12 @@ struct CalibrationViewer {
   const double max_d_{10};
   const double min_d_{0.5};
   int publisher_counter_{0};
+  int point_cell_size_px_{3};
+
+  // reused between images
+  cv::Mat image_;
+  std::vector<double> cell_depths_;
+  std::vector<cv::Point> cell_pixels_;
   std::queue<ScanStamped> scans_;
   std::queue<ImageStamped> images_;
 };
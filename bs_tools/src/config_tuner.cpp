@@ -0,0 +1,588 @@
+#include <bs_tools/config_tuner.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/utils.h>
+#include <bs_tools/replay_runner.h>
+
+namespace bs_tools {
+
+namespace {
+
+// length scale of the gaussian process kernel, in normalized parameter space
+constexpr double kKernelLengthScale = 0.25;
+
+// observation noise of the gaussian process, relative to the signal variance
+constexpr double kKernelNoise = 1e-4;
+
+// random points at which the expected improvement is evaluated
+constexpr int kNumCandidates = 2000;
+
+// weight of the weighted sum in the augmented Tchebycheff scalarization
+constexpr double kScalarizationRho = 0.05;
+
+/**
+ * @brief set a value of a json object, creating the objects along a '/'
+ * separated key
+ */
+void SetNested(nlohmann::json& J, const std::string& key,
+               const nlohmann::json& value) {
+  J[nlohmann::json::json_pointer("/" + key)] = value;
+}
+
+bool WriteJson(const std::string& path, const nlohmann::json& J) {
+  std::ofstream file(path);
+  file << std::setw(4) << J << std::endl;
+  return file.good();
+}
+
+/**
+ * @brief gaussian process with a squared exponential kernel over points in
+ * [0, 1]^d, fit to standardized values
+ */
+class GaussianProcess {
+public:
+  GaussianProcess(const std::vector<Eigen::VectorXd>& X,
+                  const std::vector<double>& y)
+      : X_(X) {
+    const size_t n = X.size();
+    Eigen::VectorXd values(n);
+    for (size_t i = 0; i < n; i++) { values[i] = y[i]; }
+    mean_ = values.mean();
+    std_ = std::sqrt((values.array() - mean_).square().mean());
+    if (std_ < 1e-12) { std_ = 1; }
+    values = (values.array() - mean_) / std_;
+
+    Eigen::MatrixXd K(n, n);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) { K(i, j) = Kernel(X[i], X[j]); }
+    }
+    K.diagonal().array() += kKernelNoise;
+    llt_.compute(K);
+    alpha_ = llt_.solve(values);
+  }
+
+  /**
+   * @brief gets the expected improvement over a value, when minimizing
+   */
+  double ExpectedImprovement(const Eigen::VectorXd& x, double best) const {
+    Eigen::VectorXd k(X_.size());
+    for (size_t i = 0; i < X_.size(); i++) { k[i] = Kernel(x, X_[i]); }
+    const double mean = k.dot(alpha_);
+    const double variance =
+        std::max(1 - k.dot(llt_.solve(k)), 1e-12);
+    const double sigma = std::sqrt(variance);
+    const double improvement = (best - mean_) / std_ - mean;
+    const double z = improvement / sigma;
+    const double cdf = 0.5 * std::erfc(-z / std::sqrt(2));
+    const double pdf = std::exp(-0.5 * z * z) / std::sqrt(2 * M_PI);
+    return improvement * cdf + sigma * pdf;
+  }
+
+private:
+  static double Kernel(const Eigen::VectorXd& a, const Eigen::VectorXd& b) {
+    return std::exp(-(a - b).squaredNorm() /
+                    (2 * kKernelLengthScale * kKernelLengthScale));
+  }
+
+  std::vector<Eigen::VectorXd> X_;
+  double mean_{0};
+  double std_{1};
+  Eigen::LLT<Eigen::MatrixXd> llt_;
+  Eigen::VectorXd alpha_;
+};
+
+} // namespace
+
+std::vector<size_t>
+    ParetoFront(const std::vector<std::vector<double>>& objectives) {
+  const auto dominates = [](const std::vector<double>& a,
+                            const std::vector<double>& b) {
+    bool better = false;
+    for (size_t k = 0; k < a.size(); k++) {
+      if (a[k] > b[k]) { return false; }
+      if (a[k] < b[k]) { better = true; }
+    }
+    return better;
+  };
+
+  std::vector<size_t> front;
+  for (size_t i = 0; i < objectives.size(); i++) {
+    bool dominated = false;
+    for (size_t j = 0; j < objectives.size() && !dominated; j++) {
+      dominated = j != i && dominates(objectives[j], objectives[i]);
+    }
+    if (!dominated) { front.push_back(i); }
+  }
+  return front;
+}
+
+void TunedParameter::LoadFromJson(const nlohmann::json& J) {
+  if (!J.contains("name")) {
+    BEAM_ERROR("Tuned parameter needs a name");
+    throw std::invalid_argument{"invalid tuned parameter"};
+  }
+  name = J["name"];
+  if (J.contains("config_file")) { config_file = J["config_file"]; }
+  if (J.contains("config_params")) {
+    config_params = J["config_params"].get<std::vector<std::string>>();
+  }
+  if (J.contains("values")) {
+    values = J["values"].get<std::vector<nlohmann::json>>();
+  }
+  if (J.contains("min")) { min = J["min"]; }
+  if (J.contains("max")) { max = J["max"]; }
+  if (J.contains("integer")) { integer = J["integer"]; }
+  if (J.contains("grid_steps")) { grid_steps = J["grid_steps"]; }
+
+  if (!config_file.empty() && config_params.empty()) {
+    BEAM_ERROR("Tuned parameter {} of {} needs the config_params pointing to "
+               "the config file",
+               name, config_file);
+    throw std::invalid_argument{"invalid tuned parameter"};
+  }
+  if (values.empty() && !(min <= max)) {
+    BEAM_ERROR("Tuned parameter {} needs values, or min <= max", name);
+    throw std::invalid_argument{"invalid tuned parameter"};
+  }
+  if (grid_steps < 1) {
+    BEAM_ERROR("Tuned parameter {} needs grid_steps >= 1", name);
+    throw std::invalid_argument{"invalid tuned parameter"};
+  }
+}
+
+nlohmann::json TunedParameter::Value(double x) const {
+  x = std::clamp(x, 0.0, 1.0);
+  if (!values.empty()) {
+    const size_t index =
+        static_cast<size_t>(std::round(x * (values.size() - 1)));
+    return values[index];
+  }
+  const double value = min + x * (max - min);
+  if (integer) { return static_cast<int64_t>(std::round(value)); }
+  return value;
+}
+
+double TunedParameter::Normalize(const nlohmann::json& value) const {
+  if (!values.empty()) {
+    if (values.size() == 1) { return 0; }
+    const auto iter = std::find(values.begin(), values.end(), value);
+    return static_cast<double>(iter - values.begin()) / (values.size() - 1);
+  }
+  if (max == min) { return 0; }
+  return (value.get<double>() - min) / (max - min);
+}
+
+void ConfigTuner::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("name")) { name = J["name"]; }
+  if (J.contains("output_directory")) {
+    output_directory = J["output_directory"];
+  }
+  if (J.contains("launch_package")) { launch_package = J["launch_package"]; }
+  if (J.contains("launch_file")) { launch_file = J["launch_file"]; }
+  if (J.contains("launch_args")) {
+    launch_args = J["launch_args"].get<std::map<std::string, std::string>>();
+  }
+  if (J.contains("search")) { search = J["search"]; }
+  if (J.contains("num_trials")) { num_trials = J["num_trials"]; }
+  if (J.contains("num_initial_trials")) {
+    num_initial_trials = J["num_initial_trials"];
+  }
+  if (J.contains("parallel_trials")) { parallel_trials = J["parallel_trials"]; }
+  if (J.contains("base_port")) { base_port = J["base_port"]; }
+  if (J.contains("seed")) { seed = J["seed"]; }
+  if (J.contains("rpe_delta_s")) { rpe_delta_s = J["rpe_delta_s"]; }
+  if (J.contains("latency_metrics")) {
+    latency_metrics = J["latency_metrics"].get<std::vector<std::string>>();
+  }
+  if (J.contains("bags")) {
+    bags.clear();
+    for (const auto& J_bag : J["bags"]) {
+      TuningBag bag;
+      bag.bag_file = J_bag["bag_file"];
+      bag.reference_file = J_bag["reference_file"];
+      bags.push_back(bag);
+    }
+  }
+  if (J.contains("parameters")) {
+    parameters.clear();
+    for (const auto& J_parameter : J["parameters"]) {
+      TunedParameter parameter;
+      parameter.LoadFromJson(J_parameter);
+      parameters.push_back(parameter);
+    }
+  }
+
+  if (search != "grid" && search != "random" && search != "bayesian") {
+    BEAM_ERROR("Invalid search: {}. Options: grid, random, bayesian", search);
+    throw std::invalid_argument{"invalid tuning params"};
+  }
+  if (output_directory.empty() || bags.empty() || parameters.empty()) {
+    BEAM_ERROR("Tuning needs an output_directory, bags and parameters");
+    throw std::invalid_argument{"invalid tuning params"};
+  }
+  if (num_trials < 1 || num_initial_trials < 1 || parallel_trials < 1) {
+    BEAM_ERROR("Tuning needs num_trials, num_initial_trials and "
+               "parallel_trials >= 1");
+    throw std::invalid_argument{"invalid tuning params"};
+  }
+}
+
+ConfigTuner::ConfigTuner(const Params& params)
+    : params_(params), generator_(params.seed) {
+  for (const TuningBag& bag : params_.bags) {
+    references_.push_back(LoadTrajectory(bag.reference_file));
+  }
+}
+
+void ConfigTuner::Run() {
+  std::filesystem::create_directories(params_.output_directory);
+  if (params_.search == "grid") {
+    RunTrials(GridValues());
+    WriteResults();
+    return;
+  }
+
+  const size_t num_trials = params_.num_trials;
+  const size_t num_random = params_.search == "random"
+                                ? num_trials
+                                : std::min<size_t>(params_.num_initial_trials,
+                                                   num_trials);
+  std::vector<std::vector<nlohmann::json>> values;
+  for (size_t i = 0; i < num_random; i++) { values.push_back(RandomValues()); }
+  RunTrials(values);
+  WriteResults();
+
+  while (trials_.size() < num_trials) {
+    values.clear();
+    const size_t batch_size = std::min<size_t>(
+        params_.parallel_trials, num_trials - trials_.size());
+    for (size_t i = 0; i < batch_size; i++) {
+      values.push_back(BayesianValues());
+    }
+    RunTrials(values);
+    WriteResults();
+  }
+}
+
+std::vector<ConfigTuner::Trial> ConfigTuner::ParetoOptimalTrials() const {
+  std::vector<const Trial*> succeeded;
+  std::vector<std::vector<double>> objectives;
+  for (const Trial& trial : trials_) {
+    if (!trial.succeeded) { continue; }
+    succeeded.push_back(&trial);
+    objectives.push_back(trial.Objectives());
+  }
+  std::vector<Trial> pareto_optimal;
+  for (size_t i : ParetoFront(objectives)) {
+    pareto_optimal.push_back(*succeeded[i]);
+  }
+  return pareto_optimal;
+}
+
+std::vector<std::vector<nlohmann::json>> ConfigTuner::GridValues() const {
+  std::vector<std::vector<nlohmann::json>> grid{{}};
+  for (const TunedParameter& parameter : params_.parameters) {
+    std::vector<nlohmann::json> values = parameter.values;
+    if (values.empty()) {
+      for (int i = 0; i < parameter.grid_steps; i++) {
+        const double x =
+            parameter.grid_steps > 1
+                ? static_cast<double>(i) / (parameter.grid_steps - 1)
+                : 0.5;
+        values.push_back(parameter.Value(x));
+      }
+    }
+    std::vector<std::vector<nlohmann::json>> extended;
+    for (const auto& point : grid) {
+      for (const auto& value : values) {
+        extended.push_back(point);
+        extended.back().push_back(value);
+      }
+    }
+    grid = std::move(extended);
+  }
+  return grid;
+}
+
+std::vector<nlohmann::json> ConfigTuner::RandomValues() {
+  std::uniform_real_distribution<double> distribution(0, 1);
+  std::vector<nlohmann::json> values;
+  for (const TunedParameter& parameter : params_.parameters) {
+    values.push_back(parameter.Value(distribution(generator_)));
+  }
+  return values;
+}
+
+std::vector<nlohmann::json> ConfigTuner::BayesianValues() {
+  // normalize the objectives of the successful trials
+  const size_t num_objectives = Trial().Objectives().size();
+  std::vector<double> min(num_objectives, std::numeric_limits<double>::max());
+  std::vector<double> max(num_objectives,
+                          std::numeric_limits<double>::lowest());
+  size_t num_succeeded = 0;
+  for (const Trial& trial : trials_) {
+    if (!trial.succeeded) { continue; }
+    num_succeeded++;
+    const std::vector<double> objectives = trial.Objectives();
+    for (size_t k = 0; k < num_objectives; k++) {
+      min[k] = std::min(min[k], objectives[k]);
+      max[k] = std::max(max[k], objectives[k]);
+    }
+  }
+  if (num_succeeded < 2) { return RandomValues(); }
+
+  // random weights on the simplex, scalarized with the augmented Tchebycheff
+  // function as in ParEGO
+  std::exponential_distribution<double> exponential(1);
+  std::vector<double> weights(num_objectives);
+  double weight_sum = 0;
+  for (double& weight : weights) {
+    weight = exponential(generator_);
+    weight_sum += weight;
+  }
+  for (double& weight : weights) { weight /= weight_sum; }
+
+  std::vector<Eigen::VectorXd> X;
+  std::vector<double> y;
+  double worst = 0;
+  for (const Trial& trial : trials_) {
+    Eigen::VectorXd x(params_.parameters.size());
+    for (size_t p = 0; p < params_.parameters.size(); p++) {
+      x[p] = params_.parameters[p].Normalize(trial.values[p]);
+    }
+    X.push_back(x);
+    if (!trial.succeeded) {
+      y.push_back(std::numeric_limits<double>::quiet_NaN());
+      continue;
+    }
+    const std::vector<double> objectives = trial.Objectives();
+    double max_term = 0;
+    double sum = 0;
+    for (size_t k = 0; k < num_objectives; k++) {
+      const double range = max[k] - min[k];
+      const double f = range > 0 ? (objectives[k] - min[k]) / range : 0;
+      max_term = std::max(max_term, weights[k] * f);
+      sum += weights[k] * f;
+    }
+    y.push_back(max_term + kScalarizationRho * sum);
+    worst = std::max(worst, y.back());
+  }
+  // failed trials are as bad as the worst successful one
+  for (double& value : y) {
+    if (std::isnan(value)) { value = worst; }
+  }
+  const double best = *std::min_element(y.begin(), y.end());
+
+  const GaussianProcess gp(X, y);
+  std::uniform_real_distribution<double> distribution(0, 1);
+  std::vector<nlohmann::json> best_values;
+  double best_improvement = -1;
+  for (int c = 0; c < kNumCandidates; c++) {
+    // snap the candidate to the values it maps to
+    std::vector<nlohmann::json> values;
+    Eigen::VectorXd x(params_.parameters.size());
+    for (size_t p = 0; p < params_.parameters.size(); p++) {
+      const TunedParameter& parameter = params_.parameters[p];
+      values.push_back(parameter.Value(distribution(generator_)));
+      x[p] = parameter.Normalize(values.back());
+    }
+    const double improvement = gp.ExpectedImprovement(x, best);
+    if (improvement > best_improvement) {
+      best_improvement = improvement;
+      best_values = std::move(values);
+    }
+  }
+  return best_values;
+}
+
+void ConfigTuner::RunTrials(
+    const std::vector<std::vector<nlohmann::json>>& values) {
+  const size_t first = trials_.size();
+  for (const auto& trial_values : values) {
+    Trial trial;
+    trial.id = trials_.size();
+    trial.values = trial_values;
+    trials_.push_back(trial);
+  }
+
+  // each worker runs one trial at a time on its own ros master
+  std::atomic<size_t> next{first};
+  std::vector<std::thread> workers;
+  const int num_workers =
+      std::min<int>(params_.parallel_trials, static_cast<int>(values.size()));
+  for (int slot = 0; slot < num_workers; slot++) {
+    workers.emplace_back([this, &next, slot]() {
+      for (size_t i = next++; i < trials_.size(); i = next++) {
+        RunTrial(trials_[i], slot);
+      }
+    });
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+}
+
+void ConfigTuner::RunTrial(Trial& trial, int slot) const {
+  const std::string directory = TrialDirectory(trial.id);
+  std::filesystem::create_directories(directory);
+  const std::string overrides = WriteOverrides(trial);
+  const int port = params_.base_port + slot;
+  BEAM_INFO("Running trial {} on port {}", trial.id, port);
+
+  trial.succeeded = true;
+  trial.ate_m = 0;
+  trial.rpe_m = 0;
+  trial.latency_s = 0;
+  for (size_t b = 0; b < params_.bags.size(); b++) {
+    ReplayRun run;
+    run.launch_package = params_.launch_package;
+    run.launch_file = params_.launch_file;
+    run.args = params_.launch_args;
+    run.args["bag_file"] = params_.bags[b].bag_file;
+    run.args["overrides"] = overrides;
+    run.port = port;
+    run.output_prefix =
+        beam::CombinePaths(directory, "bag_" + std::to_string(b));
+    nlohmann::json J;
+    bs_common::Trajectory estimate;
+    if (!RunReplay(run, J, estimate)) {
+      BEAM_ERROR("Replay of trial {} failed on bag {}", trial.id,
+                 params_.bags[b].bag_file);
+      trial.succeeded = false;
+      return;
+    }
+
+    for (const std::string& metric : params_.latency_metrics) {
+      double p99_s = 0;
+      if (J["metrics"].contains(metric)) {
+        p99_s = J["metrics"][metric]["p99_s"];
+      } else {
+        BEAM_WARN("Metric {} was not recorded in trial {}", metric, trial.id);
+      }
+      trial.latency_s += p99_s / params_.bags.size();
+      double& stage_p99_s = trial.stage_p99_s[metric];
+      stage_p99_s = std::max(stage_p99_s, p99_s);
+    }
+
+    TrajectoryErrors errors;
+    if (!ComputeTrajectoryErrors(estimate, references_[b],
+                                 params_.rpe_delta_s, errors)) {
+      BEAM_ERROR("Trajectory of trial {} does not overlap the reference of "
+                 "bag {}",
+                 trial.id, params_.bags[b].bag_file);
+      trial.succeeded = false;
+      return;
+    }
+    trial.ate_m += errors.ate_m / params_.bags.size();
+    trial.rpe_m += errors.rpe_m / params_.bags.size();
+  }
+  BEAM_INFO("Trial {}: ATE {:.3f} m, RPE {:.3f} m, latency {:.1f} ms",
+            trial.id, trial.ate_m, trial.rpe_m, 1e3 * trial.latency_s);
+}
+
+std::string ConfigTuner::WriteOverrides(const Trial& trial) const {
+  nlohmann::json overrides = nlohmann::json::object();
+  std::map<std::string, nlohmann::json> configs;
+  for (size_t p = 0; p < params_.parameters.size(); p++) {
+    const TunedParameter& parameter = params_.parameters[p];
+    if (parameter.config_file.empty()) {
+      SetNested(overrides, parameter.name, trial.values[p]);
+      continue;
+    }
+
+    // copy the config once, then point its ros params to the copy
+    auto iter = configs.find(parameter.config_file);
+    if (iter == configs.end()) {
+      nlohmann::json J;
+      const std::string path = beam::CombinePaths(
+          bs_common::GetBeamSlamConfigPath(), parameter.config_file);
+      if (!beam::ReadJson(path, J)) {
+        BEAM_ERROR("Unable to read config: {}", path);
+        throw std::runtime_error{"unable to read config"};
+      }
+      iter = configs.emplace(parameter.config_file, J).first;
+    }
+    SetNested(iter->second, parameter.name, trial.values[p]);
+    const std::string relative_path =
+        "tuning/" + params_.name + "/trial_" + std::to_string(trial.id) + "/" +
+        parameter.config_file;
+    for (const std::string& config_param : parameter.config_params) {
+      SetNested(overrides, config_param, relative_path);
+    }
+  }
+
+  for (const auto& [config_file, J] : configs) {
+    const std::filesystem::path path =
+        std::filesystem::path(bs_common::GetBeamSlamConfigPath()) / "tuning" /
+        params_.name / ("trial_" + std::to_string(trial.id)) / config_file;
+    std::filesystem::create_directories(path.parent_path());
+    if (!WriteJson(path.string(), J)) {
+      BEAM_ERROR("Unable to write config: {}", path.string());
+      throw std::runtime_error{"unable to write config"};
+    }
+  }
+
+  const std::string overrides_file =
+      beam::CombinePaths(TrialDirectory(trial.id), "overrides.yaml");
+  if (!WriteYaml(overrides_file, overrides)) {
+    BEAM_ERROR("Unable to write overrides: {}", overrides_file);
+    throw std::runtime_error{"unable to write overrides"};
+  }
+  return overrides_file;
+}
+
+std::string ConfigTuner::TrialDirectory(size_t id) const {
+  return beam::CombinePaths(params_.output_directory,
+                            "trial_" + std::to_string(id));
+}
+
+nlohmann::json ConfigTuner::TrialToJson(const Trial& trial) const {
+  nlohmann::json parameters = nlohmann::json::object();
+  for (size_t p = 0; p < params_.parameters.size(); p++) {
+    const TunedParameter& parameter = params_.parameters[p];
+    const std::string key =
+        parameter.config_file.empty()
+            ? parameter.name
+            : parameter.config_file + ":" + parameter.name;
+    parameters[key] = trial.values[p];
+  }
+  return nlohmann::json{
+      {"id", trial.id},
+      {"succeeded", trial.succeeded},
+      {"parameters", parameters},
+      {"ate_m", trial.ate_m},
+      {"rpe_m", trial.rpe_m},
+      {"latency_s", trial.latency_s},
+      {"stage_p99_s", trial.stage_p99_s},
+      {"overrides",
+       beam::CombinePaths(TrialDirectory(trial.id), "overrides.yaml")}};
+}
+
+void ConfigTuner::WriteResults() const {
+  nlohmann::json J_trials = nlohmann::json::array();
+  for (const Trial& trial : trials_) { J_trials.push_back(TrialToJson(trial)); }
+  nlohmann::json J_pareto = nlohmann::json::array();
+  for (const Trial& trial : ParetoOptimalTrials()) {
+    J_pareto.push_back(TrialToJson(trial));
+  }
+  const std::string trials_file =
+      beam::CombinePaths(params_.output_directory, "trials.json");
+  const std::string pareto_file =
+      beam::CombinePaths(params_.output_directory, "pareto_optimal.json");
+  if (!WriteJson(trials_file, J_trials) || !WriteJson(pareto_file, J_pareto)) {
+    BEAM_ERROR("Unable to write tuning results to {}",
+               params_.output_directory);
+  }
+}
+
+} // namespace bs_tools
@@ -0,0 +1,68 @@
+#include <gflags/gflags.h>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+
+#include <bs_tools/config_tuner.h>
+
+// clang-format off
+/**
+ * Tunes the local mapper params for the trade off between latency and
+ * accuracy by replaying bags with bs_tools_replay_node, see
+ * bs_tools/config_tuner.h and the example in
+ * beam_slam_launch/config/config_tuner.json. Example command for running
+ * binary:
+ *
+ ./devel/lib/bs_tools/bs_tools_config_tuner_main \
+ -tuner_config ~/beam_slam/beam_slam_launch/config/config_tuner.json \
+ -output_directory ~/results/tuning
+ *
+ * Every trial runs its own ros master, so no roscore needs to be running. The
+ * launch file of the trials runs the calibration publisher, see
+ * replay.launch.
+ */
+// clang-format on
+
+DEFINE_string(tuner_config, "",
+              "Full path to the tuning config, with the bags, parameters and "
+              "search (Required).");
+DEFINE_validator(tuner_config, &beam::gflags::ValidateFileMustExist);
+DEFINE_string(output_directory, "",
+              "Full path to the output directory, overrides the one of the "
+              "tuning config.");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  nlohmann::json J;
+  if (!beam::ReadJson(FLAGS_tuner_config, J)) {
+    BEAM_ERROR("Unable to read tuning config: {}", FLAGS_tuner_config);
+    return 1;
+  }
+  if (!FLAGS_output_directory.empty()) {
+    J["output_directory"] = FLAGS_output_directory;
+  }
+
+  bs_tools::ConfigTuner::Params params;
+  try {
+    params.LoadFromJson(J);
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Invalid tuning config: {}", e.what());
+    return 1;
+  }
+
+  bs_tools::ConfigTuner tuner(params);
+  tuner.Run();
+
+  BEAM_INFO("Pareto optimal trials:");
+  BEAM_INFO("{:>6} {:>10} {:>10} {:>14}", "trial", "ATE [m]", "RPE [m]",
+            "latency [ms]");
+  for (const auto& trial : tuner.ParetoOptimalTrials()) {
+    BEAM_INFO("{:>6} {:>10.3f} {:>10.3f} {:>14.1f}", trial.id, trial.ate_m,
+              trial.rpe_m, 1e3 * trial.latency_s);
+  }
+  BEAM_INFO("Results and override configs written to: {}",
+            params.output_directory);
+  return 0;
+}
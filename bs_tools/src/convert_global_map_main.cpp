@@ -0,0 +1,51 @@
+#include <filesystem>
+
+#include <gflags/gflags.h>
+
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+#include <bs_models/global_mapping/global_map.h>
+
+// clang-format off
+/** 
+ * Converts global map data between the submap directory format and the binary
+ * map store (see bs_models/global_mapping/map_store.h). The input format is
+ * detected automatically. Example command for running binary:
+ * 
+ ./devel/lib/bs_tools/bs_tools_convert_global_map_main \
+ -globalmap_dir ~/results/global_mapper/global_mapper_results/GlobalMapData/ \
+ -output_path ~/results/GlobalMapDataConverted
+*/
+// clang-format on
+
+DEFINE_string(globalmap_dir, "",
+              "Full path to global map directory to load (Required).");
+DEFINE_validator(globalmap_dir, &beam::gflags::ValidateDirMustExist);
+DEFINE_string(output_path, "",
+              "Full path to output directory, which is created if it does not "
+              "exist (Required).");
+DEFINE_bool(to_directories, false,
+            "Set to true to save the submaps to the directory format instead "
+            "of the binary map store.");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_output_path.empty()) {
+    BEAM_ERROR("Output path required.");
+    return 1;
+  }
+  std::filesystem::create_directories(FLAGS_output_path);
+
+  BEAM_INFO("Loading global map data from: {}", FLAGS_globalmap_dir);
+  std::shared_ptr<bs_models::global_mapping::GlobalMap> global_map;
+  try {
+    global_map = std::make_shared<bs_models::global_mapping::GlobalMap>(
+        FLAGS_globalmap_dir);
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Cannot load global map: {}", e.what());
+    return 1;
+  }
+
+  global_map->SaveData(FLAGS_output_path, !FLAGS_to_directories);
+  return 0;
+}
@@ -0,0 +1,67 @@
+#include <gflags/gflags.h>
+
+#include <beam_mapping/Poses.h>
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/trajectory_file.h>
+
+// clang-format off
+/** 
+ * Converts a pose file (.json, .txt or .ply, see beam_mapping::Poses) to a
+ * binary trajectory file (see bs_common/trajectory_file.h), which is memory
+ * mapped instead of parsed when loaded by the POSEFILE frame initializer.
+ * Example command for running binary:
+ * 
+ ./devel/lib/bs_tools/bs_tools_convert_poses_main \
+ -pose_file ~/results/poses.json \
+ -output_file ~/results/poses.bin
+*/
+// clang-format on
+
+DEFINE_string(pose_file, "", "Full path to pose file to convert (Required).");
+DEFINE_validator(pose_file, &beam::gflags::ValidateFileMustExist);
+DEFINE_string(output_file, "",
+              "Full path to output trajectory file, which is overridden if it "
+              "exists (Required).");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_output_file.empty()) {
+    BEAM_ERROR("Output file required.");
+    return 1;
+  }
+
+  BEAM_INFO("Loading poses from: {}", FLAGS_pose_file);
+  beam_mapping::Poses poses_reader;
+  if (!poses_reader.LoadFromFile(FLAGS_pose_file)) {
+    BEAM_ERROR("Cannot load pose file. Options: .json, .txt, .ply");
+    return 1;
+  }
+
+  const std::vector<Eigen::Matrix4d, beam::AlignMat4d>& transforms =
+      poses_reader.GetPoses();
+  const std::vector<ros::Time>& timestamps = poses_reader.GetTimeStamps();
+  bs_common::TrajectoryPoses poses;
+  poses.reserve(transforms.size());
+  for (size_t i = 0; i < transforms.size(); i++) {
+    poses.emplace_back(timestamps[i], transforms[i]);
+  }
+
+  bs_common::TrajectoryFile trajectory_file;
+  trajectory_file.fixed_frame = poses_reader.GetFixedFrame();
+  trajectory_file.moving_frame = poses_reader.GetMovingFrame();
+  trajectory_file.trajectory = bs_common::Trajectory(std::move(poses));
+  if (trajectory_file.trajectory.Size() != transforms.size()) {
+    BEAM_WARN("Removed {} poses with duplicate timestamps",
+              transforms.size() - trajectory_file.trajectory.Size());
+  }
+
+  if (!trajectory_file.Save(FLAGS_output_file)) {
+    BEAM_ERROR("Cannot write trajectory file: {}", FLAGS_output_file);
+    return 1;
+  }
+  BEAM_INFO("Saved {} poses to: {}", trajectory_file.trajectory.Size(),
+            FLAGS_output_file);
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include <filesystem>
+#include <sstream>
+
+#include <gflags/gflags.h>
+
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+#include <bs_models/global_mapping/global_map_merger.h>
+
+// clang-format off
+/**
+ * Merges global maps from several sessions into one global map, see
+ * bs_models/global_mapping/global_map_merger.h. Example command for running
+ * everything in one process:
+ *
+ ./devel/lib/bs_tools/bs_tools_global_map_merge_main \
+ -globalmap_dirs ~/results/session1/GlobalMapData,~/results/session2/GlobalMapData \
+ -output_path ~/results/merged \
+ -merge_config ~/beam_slam/beam_slam_launch/config/global_map/global_map_merge.json \
+ -calibration_yaml ~/beam_slam/beam_slam_launch/config/calibration_params.yaml
+ *
+ * To verify the candidates on several machines sharing the output path, run
+ * -stage candidates once, then -stage verify with -shard_index 0 to
+ * num_shards - 1 on any number of machines, and finally -stage merge once all
+ * shards are verified.
+ *
+ * NOTE: YOU MUST ALSO PUBLISH YOUR EXTRINSIC CALIBRATIONS - USE: calibration_publisher.launch
+ */
+// clang-format on
+
+DEFINE_string(globalmap_dirs, "",
+              "Comma separated full paths to the global map directories to "
+              "merge, the first one is the reference frame (Required).");
+DEFINE_string(
+    merge_config, "",
+    "Full path to config file for the merge. If left empty, this will use the "
+    "default parameters defined in the class header. You can use the default "
+    "in: .../beam_slam/beam_slam_launch/config/global_map/"
+    "global_map_merge.json");
+DEFINE_string(output_path, "",
+              "Full path to output directory, shared by all stages. ");
+DEFINE_validator(output_path, &beam::gflags::ValidateDirMustExist);
+DEFINE_string(calibration_yaml, "", "Full path to calibration yaml. ");
+DEFINE_validator(calibration_yaml, &beam::gflags::ValidateFileMustExist);
+DEFINE_string(stage, "all",
+              "Stage to run: candidates, verify, merge, or all to run them in "
+              "this process.");
+DEFINE_int32(shard_index, 0, "Shard of the candidates to verify.");
+DEFINE_int32(num_shards, 1,
+             "Number of shards the candidates are split in for verification.");
+
+using bs_models::global_mapping::GlobalMap;
+using bs_models::global_mapping::GlobalMapMerger;
+
+std::string CandidatesFile() {
+  return beam::CombinePaths(FLAGS_output_path, "candidates.json");
+}
+
+std::string VerifiedFile(int shard_index) {
+  return beam::CombinePaths(FLAGS_output_path,
+                            "verified_" + std::to_string(shard_index) + "_of_" +
+                                std::to_string(FLAGS_num_shards) + ".json");
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const std::string stage = FLAGS_stage;
+  if (stage != "all" && stage != "candidates" && stage != "verify" &&
+      stage != "merge") {
+    BEAM_ERROR("Invalid stage: {}", stage);
+    return 1;
+  }
+  if (FLAGS_num_shards < 1 || FLAGS_shard_index < 0 ||
+      FLAGS_shard_index >= FLAGS_num_shards) {
+    BEAM_ERROR("Invalid shard {} of {} shards", FLAGS_shard_index,
+               FLAGS_num_shards);
+    return 1;
+  }
+
+  std::vector<std::string> globalmap_dirs;
+  std::stringstream dirs_stream(FLAGS_globalmap_dirs);
+  std::string dir;
+  while (std::getline(dirs_stream, dir, ',')) {
+    if (!dir.empty()) { globalmap_dirs.push_back(dir); }
+  }
+  if (globalmap_dirs.size() < 2) {
+    BEAM_ERROR("At least two global map directories are required.");
+    return 1;
+  }
+
+  // setup ros and load calibration
+  int arg = 0;
+  ros::init(arg, NULL, "global_map_merge");
+  std::string calibration_load_cmd = "rosparam load " + FLAGS_calibration_yaml;
+  BEAM_INFO("Running command: {}", calibration_load_cmd);
+  int result1 = system(calibration_load_cmd.c_str());
+
+  GlobalMapMerger::Params params;
+  params.LoadJson(FLAGS_merge_config);
+  GlobalMapMerger merger(params, FLAGS_output_path);
+
+  std::vector<std::shared_ptr<GlobalMap>> maps;
+  try {
+    for (const std::string& globalmap_dir : globalmap_dirs) {
+      BEAM_INFO("Loading global map data from: {}", globalmap_dir);
+      maps.push_back(std::make_shared<GlobalMap>(globalmap_dir));
+    }
+  } catch (const std::runtime_error& e) {
+    BEAM_ERROR("Cannot load global map: {}", e.what());
+    return 1;
+  }
+
+  std::vector<GlobalMapMerger::Candidate> candidates;
+  if (stage == "all" || stage == "candidates") {
+    candidates = merger.FindCandidates(maps);
+    BEAM_INFO("Found {} candidates", candidates.size());
+    if (!GlobalMapMerger::SaveCandidates(CandidatesFile(), globalmap_dirs,
+                                         candidates)) {
+      return 1;
+    }
+    if (stage == "candidates") { return 0; }
+  } else if (!GlobalMapMerger::LoadCandidates(CandidatesFile(),
+                                              globalmap_dirs, candidates)) {
+    return 1;
+  }
+
+  if (stage == "all") {
+    if (!merger.VerifyCandidates(maps, candidates)) { return 1; }
+  } else if (stage == "verify") {
+    if (!merger.VerifyCandidates(maps, candidates, FLAGS_shard_index,
+                                 FLAGS_num_shards)) {
+      return 1;
+    }
+    return GlobalMapMerger::SaveCandidates(VerifiedFile(FLAGS_shard_index),
+                                           globalmap_dirs, candidates,
+                                           FLAGS_shard_index, FLAGS_num_shards)
+               ? 0
+               : 1;
+  } else {
+    for (int i = 0; i < FLAGS_num_shards; i++) {
+      if (!GlobalMapMerger::LoadCandidates(VerifiedFile(i), globalmap_dirs,
+                                           candidates)) {
+        BEAM_ERROR("Shard {} of {} is not verified", i, FLAGS_num_shards);
+        return 1;
+      }
+    }
+  }
+
+  std::shared_ptr<GlobalMap> merged_map = merger.Merge(maps, candidates);
+  if (!merged_map) { return 1; }
+
+  std::string global_map_data_path =
+      beam::CombinePaths(FLAGS_output_path, "GlobalMapData");
+  std::filesystem::create_directory(global_map_data_path);
+  BEAM_INFO("Outputting merged global map data to: {}", global_map_data_path);
+  merged_map->SaveData(global_map_data_path);
+  return 0;
+}
@@ -1,4 +1,6 @@
 #include <filesystem>
+#include <fstream>
+#include <sstream>
 
 #include <gflags/gflags.h>
 
@@ -55,6 +57,28 @@ bool RUN_ALIGNMENT = false;
 bool RUN_PGO = false;
 std::string SAVE_PATH;
 
+// get a memory value from /proc/self/status in MB, 0 if not available
+int GetMemoryMB(const std::string& key) {
+  std::ifstream file("/proc/self/status");
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind(key + ":", 0) != 0) { continue; }
+    std::istringstream values(line.substr(key.size() + 1));
+    int kb = 0;
+    values >> kb;
+    return kb / 1024;
+  }
+  return 0;
+}
+
+// log the peak resident memory since the last report, then reset the peak
+void ReportMemoryUsage(const std::string& stage) {
+  BEAM_INFO("Memory usage after {}: peak RSS {} MB, current RSS {} MB", stage,
+            GetMemoryMB("VmHWM"), GetMemoryMB("VmRSS"));
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
 int RunBatchOptimizer(
     bs_models::global_mapping::GlobalMapRefinement& refinement,
     bs_models::global_mapping::GlobalMap& map) {
@@ -153,23 +177,39 @@ int main(int argc, char* argv[]) {
   }
   std::filesystem::create_directory(SAVE_PATH);
 
-  // load global map and refinement
+  // load global map and refinement, when streaming the lidar clouds are
+  // paged in by the refinement
+  bs_models::global_mapping::GlobalMapRefinement::Params params;
+  params.LoadJson(FLAGS_refinement_config);
+
+  // the registration cache is kept outside of the results, which are cleared,
+  // so reruns on the same output path reuse it
+  if (params.registration_cache.enabled) {
+    params.registration_cache.path =
+        beam::CombinePaths(FLAGS_output_path, "registration_cache.bin");
+  }
   BEAM_INFO("Loading global map data from: {}", FLAGS_globalmap_dir);
   auto global_map = std::make_shared<bs_models::global_mapping::GlobalMap>(
-      FLAGS_globalmap_dir);
-  bs_models::global_mapping::GlobalMapRefinement refinement(
-      global_map, FLAGS_refinement_config);
+      FLAGS_globalmap_dir, !params.streaming.enabled);
+  bs_models::global_mapping::GlobalMapRefinement refinement(global_map,
+                                                            params);
+  ReportMemoryUsage("loading");
 
   // run refinement
   if (RunBatchOptimizer(refinement, *global_map) != 0) { return 1; }
+  ReportMemoryUsage("batch optimization");
   if (RunRefinement(refinement, *global_map) != 0) { return 1; }
+  ReportMemoryUsage("submap refinement");
   if (RunAlignment(refinement, *global_map) != 0) { return 1; }
+  ReportMemoryUsage("submap alignment");
   if (RunPGO(refinement, *global_map) != 0) { return 1; }
+  ReportMemoryUsage("pose graph optimization");
   BEAM_INFO("Global map refinement completed successfully.");
 
   // output results
   BEAM_INFO("Outputting results to: {}", SAVE_PATH);
   refinement.SaveResults(SAVE_PATH, true);
+  ReportMemoryUsage("saving results");
 
   // Save global map data
   std::string global_map_data_path =
@@ -177,6 +217,7 @@ int main(int argc, char* argv[]) {
   std::filesystem::create_directory(global_map_data_path);
   BEAM_INFO("Outputting global map data to: {}", global_map_data_path);
   refinement.SaveGlobalMapData(global_map_data_path);
+  ReportMemoryUsage("saving global map data");
 
   return 0;
 }
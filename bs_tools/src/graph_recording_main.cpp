@@ -0,0 +1,64 @@
+#include <gflags/gflags.h>
+
+#include <fuse_graphs/hash_graph.h>
+
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/graph_access.h>
+#include <bs_common/graph_recorder.h>
+
+// clang-format off
+/**
+ * Reconstructs the graph at one update of a recording written by
+ * bs_common::GraphRecorder (e.g., graph_updates/graph in the lidar odometry
+ * output), and saves it as text with bs_common::SaveGraphToTxtFile.
+ * Example command for running binary:
+ *
+ ./devel/lib/bs_tools/bs_tools_graph_recording_main \
+ -recording_dir ~/results/lidar_odometry/graph_updates/graph \
+ -update 120 \
+ -output_file ~/results/graph_120.txt
+*/
+// clang-format on
+
+DEFINE_string(recording_dir, "",
+              "Full path to the directory of the recording (Required).");
+DEFINE_validator(recording_dir, &beam::gflags::ValidateDirMustExist);
+DEFINE_int64(update, -1,
+             "Update to reconstruct, the last recorded update if negative.");
+DEFINE_string(output_file, "",
+              "Full path to output text file, which is overridden if it "
+              "exists. If empty, only the recorded updates are listed.");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  bs_common::GraphRecording recording;
+  if (!recording.Open(FLAGS_recording_dir)) {
+    BEAM_ERROR("No valid graph recording in: {}", FLAGS_recording_dir);
+    return 1;
+  }
+  const std::vector<uint64_t> updates = recording.Updates();
+  BEAM_INFO("Recording contains {} updates, from {} to {}", updates.size(),
+            updates.front(), updates.back());
+  if (FLAGS_output_file.empty()) { return 0; }
+
+  const uint64_t update = FLAGS_update < 0 ? updates.back() : FLAGS_update;
+  fuse_graphs::HashGraph graph;
+  ros::Time stamp;
+  try {
+    if (!recording.Read(update, graph, &stamp)) {
+      BEAM_ERROR("Update {} was not recorded", update);
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Cannot reconstruct update {}: {}", update, e.what());
+    return 1;
+  }
+
+  BEAM_INFO("Saving graph of update {} (stamp {}) to: {}", update,
+            stamp.toSec(), FLAGS_output_file);
+  bs_common::SaveGraphToTxtFile(graph, FLAGS_output_file);
+  return 0;
+}
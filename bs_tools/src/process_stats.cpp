@@ -0,0 +1,93 @@
+#include <bs_tools/process_stats.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace bs_tools {
+
+namespace {
+
+/**
+ * @brief gets the value of a "key: value" line of a /proc file
+ */
+std::string ReadProcValue(const std::string& path, const std::string& key) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.compare(0, key.size(), key) != 0) { continue; }
+    const size_t separator = line.find(':');
+    if (separator == std::string::npos) { continue; }
+    const size_t start = line.find_first_not_of(" \t", separator + 1);
+    return start == std::string::npos ? "" : line.substr(start);
+  }
+  return "";
+}
+
+} // namespace
+
+std::vector<ThreadCpuTime> GetThreadCpuTimes() {
+  const double ticks_per_s = sysconf(_SC_CLK_TCK);
+  std::vector<ThreadCpuTime> threads;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator("/proc/self/task", error)) {
+    std::ifstream file(entry.path() / "stat");
+    std::string stat;
+    if (!std::getline(file, stat)) { continue; }
+
+    // the name is in parentheses and may contain spaces, the fields after it
+    // start with the state, utime and stime are the 12th and 13th after it
+    const size_t name_start = stat.find('(');
+    const size_t name_end = stat.rfind(')');
+    if (name_start == std::string::npos || name_end == std::string::npos) {
+      continue;
+    }
+    std::istringstream fields(stat.substr(name_end + 2));
+    std::string field;
+    double utime = 0;
+    double stime = 0;
+    for (int i = 0; i < 13 && fields >> field; i++) {
+      if (i == 11) { utime = std::stod(field); }
+      if (i == 12) { stime = std::stod(field); }
+    }
+
+    ThreadCpuTime thread;
+    thread.tid = std::stoi(entry.path().filename().string());
+    thread.name = stat.substr(name_start + 1, name_end - name_start - 1);
+    thread.cpu_s = (utime + stime) / ticks_per_s;
+    threads.push_back(thread);
+  }
+  return threads;
+}
+
+double GetProcessCpuTime() {
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+  return usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec +
+         usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+}
+
+double GetPeakRssMb() {
+  // e.g. "123456 kB"
+  const std::string value = ReadProcValue("/proc/self/status", "VmHWM");
+  if (value.empty()) { return 0; }
+  return std::stod(value) / 1024;
+}
+
+nlohmann::json GetHostInfo() {
+  char hostname[256] = {0};
+  gethostname(hostname, sizeof(hostname) - 1);
+  const std::string memory = ReadProcValue("/proc/meminfo", "MemTotal");
+  return nlohmann::json{
+      {"hostname", std::string(hostname)},
+      {"cpu_model", ReadProcValue("/proc/cpuinfo", "model name")},
+      {"num_cpus", std::thread::hardware_concurrency()},
+      {"memory_mb", memory.empty() ? 0.0 : std::stod(memory) / 1024}};
+}
+
+} // namespace bs_tools
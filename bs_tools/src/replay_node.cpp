@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fuse_graphs/hash_graph.h>
+#include <fuse_graphs/hash_graph_params.h>
+#include <nav_msgs/Odometry.h>
+#include <nlohmann/json.hpp>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <rosgraph_msgs/Clock.h>
+#include <topic_tools/shape_shifter.h>
+
+#include <bs_common/conversions.h>
+#include <bs_common/instrumentation.h>
+#include <bs_common/trajectory_file.h>
+#include <bs_optimizers/fixed_lag_smoother.h>
+#include <bs_tools/process_stats.h>
+
+// clang-format off
+/**
+ * Replays a bag through the local mapper as fast as possible, in lock-step
+ * with simulated time. The fixed lag smoother and all its sensor models run in
+ * this process, and this node must be named after the local mapper so that it
+ * loads the same params (see replay.launch). The replay itself is configured
+ * with the following private params:
+ *
+ *  - replay/bag_file (string, required) bag to replay
+ *  - replay/topics (string list, default: all) topics to replay
+ *  - replay/start_offset (double, default: 0) seconds to skip at the start
+ *  - replay/duration (double, default: 0) seconds to replay, 0 for all
+ *  - replay/stage_timeout (double, default: 5) max wall time in seconds to
+ *    wait for a stage to process a message
+ *  - replay/sync_metrics (dict, default: none) map from topic to the name of
+ *    the instrumentation metric recorded by the stage consuming it, e.g.
+ *    "/imu/data: inertial_odometry/process_imu". After publishing a message on
+ *    one of these topics, the replay waits until that metric was recorded once
+ *    more before continuing.
+ *  - replay/graph_update_metrics (string list, default: none) metrics recorded
+ *    by the sensor models when they receive a graph update. After each
+ *    optimization, the replay waits until each of these were recorded.
+ *  - replay/odometry_topic (string, default: none) nav_msgs/Odometry topic of
+ *    the estimated trajectory, e.g. the marginalized poses of the graph
+ *    publisher
+ *  - replay/trajectory_file (string, default: none) where to save the poses
+ *    received on odometry_topic as a trajectory file (see
+ *    bs_common/trajectory_file.h)
+ *  - replay/results_file (string, default: none) where to save the replay
+ *    stats, the summary of every instrumented stage, the peak memory and the
+ *    CPU time of each thread as json, e.g. for bs_tools_config_tuner_main or
+ *    bs_tools_scoring_suite_main
+ *
+ * The smoother must be configured with external_trigger: true, an
+ * optimization is triggered every optimization_period of bag time.
+ *
+ * Once done, the throughput and latency of every instrumented stage is
+ * printed, along with the peak memory and CPU usage of the replay.
+ */
+// clang-format on
+
+namespace {
+
+uint64_t MetricCount(const std::string& name) {
+  return bs_common::Instrumentation::GetInstance().GetMetric(name)
+      .Summarize()
+      .count;
+}
+
+/**
+ * @brief Wait until a metric has been recorded a number of times
+ * @return false if it timed out
+ */
+bool WaitForMetric(const std::string& name, uint64_t count,
+                   const ros::WallDuration& timeout) {
+  const ros::WallTime end = ros::WallTime::now() + timeout;
+  while (MetricCount(name) < count) {
+    if (ros::WallTime::now() > end || !ros::ok()) { return false; }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  return true;
+}
+
+/**
+ * @brief Publish the clock and wait until it's received by this process, this
+ * way the clock subscriber stays the only thing setting the sim time
+ */
+void SetTime(const ros::Time& time, const ros::Publisher& clock_publisher) {
+  rosgraph_msgs::Clock clock;
+  clock.clock = time;
+  clock_publisher.publish(clock);
+  while (ros::ok() && ros::Time::now() < time) {
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "local_mapper");
+
+  // the smoother timer, sensor models and message stamps all use the bag time
+  ros::param::set("/use_sim_time", true);
+
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  std::string bag_file;
+  if (!private_nh.getParam("replay/bag_file", bag_file)) {
+    ROS_ERROR("Missing required param: replay/bag_file");
+    return 1;
+  }
+  std::vector<std::string> topics;
+  private_nh.getParam("replay/topics", topics);
+  double start_offset{0};
+  private_nh.getParam("replay/start_offset", start_offset);
+  double duration{0};
+  private_nh.getParam("replay/duration", duration);
+  double stage_timeout{5};
+  private_nh.getParam("replay/stage_timeout", stage_timeout);
+  std::map<std::string, std::string> sync_metrics;
+  private_nh.getParam("replay/sync_metrics", sync_metrics);
+  std::vector<std::string> graph_update_metrics;
+  private_nh.getParam("replay/graph_update_metrics", graph_update_metrics);
+  std::string odometry_topic;
+  private_nh.getParam("replay/odometry_topic", odometry_topic);
+  std::string trajectory_file;
+  private_nh.getParam("replay/trajectory_file", trajectory_file);
+  std::string results_file;
+  private_nh.getParam("replay/results_file", results_file);
+  double optimization_period{0.1};
+  private_nh.getParam("optimization_period", optimization_period);
+  bool external_trigger{false};
+  private_nh.getParam("external_trigger", external_trigger);
+  if (!external_trigger) {
+    ROS_WARN("external_trigger is not set, the smoother will also be "
+             "triggered by its own timer and the replay is not deterministic");
+  }
+
+  rosbag::Bag bag;
+  try {
+    bag.open(bag_file, rosbag::bagmode::Read);
+  } catch (const rosbag::BagException& e) {
+    ROS_ERROR("Unable to open bag %s: %s", bag_file.c_str(), e.what());
+    return 1;
+  }
+
+  // set the time before the smoother and sensor models start
+  rosbag::View full_view(bag);
+  const ros::Time start_time =
+      full_view.getBeginTime() + ros::Duration(start_offset);
+  const ros::Time end_time = duration > 0
+                                 ? start_time + ros::Duration(duration)
+                                 : full_view.getEndTime();
+  ros::Publisher clock_publisher =
+      nh.advertise<rosgraph_msgs::Clock>("/clock", 1);
+
+  // the clock and other global callbacks
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+  SetTime(start_time, clock_publisher);
+
+  fuse_graphs::HashGraphParams hash_graph_params;
+  hash_graph_params.loadFromROS(private_nh);
+  bs_optimizers::FixedLagSmoother optimizer(
+      fuse_graphs::HashGraph::make_unique(hash_graph_params));
+
+  std::unique_ptr<rosbag::View> view;
+  if (topics.empty()) {
+    view = std::make_unique<rosbag::View>(bag, start_time, end_time);
+  } else {
+    view = std::make_unique<rosbag::View>(bag, rosbag::TopicQuery(topics),
+                                          start_time, end_time);
+  }
+
+  // the estimated poses are received by the spinner thread
+  std::mutex poses_mutex;
+  bs_common::TrajectoryFile trajectory;
+  bs_common::TrajectoryPoses poses;
+  ros::Subscriber odometry_subscriber;
+  if (!odometry_topic.empty()) {
+    boost::function<void(const nav_msgs::Odometry::ConstPtr&)> callback =
+        [&](const nav_msgs::Odometry::ConstPtr& msg) {
+          Eigen::Matrix4d T_WORLD_BASELINK;
+          bs_common::OdometryMsgToTransformationMatrix(*msg,
+                                                       T_WORLD_BASELINK);
+          std::lock_guard<std::mutex> lock(poses_mutex);
+          trajectory.fixed_frame = msg->header.frame_id;
+          trajectory.moving_frame = msg->child_frame_id;
+          poses.emplace_back(msg->header.stamp, T_WORLD_BASELINK);
+        };
+    odometry_subscriber =
+        nh.subscribe<nav_msgs::Odometry>(odometry_topic, 1000, callback);
+  }
+
+  // advertise everything before publishing so no message is lost
+  std::map<std::string, ros::Publisher> publishers;
+  for (const rosbag::ConnectionInfo* info : view->getConnections()) {
+    if (info->topic == "/clock" ||
+        publishers.find(info->topic) != publishers.end()) {
+      continue;
+    }
+    ros::AdvertiseOptions opts(info->topic, 100, info->md5sum, info->datatype,
+                               info->msg_def);
+    publishers.emplace(info->topic, nh.advertise(opts));
+  }
+  ros::WallDuration(1.0).sleep();
+
+  std::map<std::string, uint64_t> expected_counts;
+  for (const auto& [topic, metric] : sync_metrics) {
+    expected_counts[metric] = MetricCount(metric);
+  }
+
+  const ros::WallDuration timeout(stage_timeout);
+  ros::Time next_optimization = start_time + ros::Duration(optimization_period);
+  uint64_t num_messages{0};
+  uint64_t num_timeouts{0};
+  uint64_t num_optimizations{0};
+  const std::vector<bs_tools::ThreadCpuTime> start_cpu_times =
+      bs_tools::GetThreadCpuTimes();
+  const double start_process_cpu_s = bs_tools::GetProcessCpuTime();
+  const ros::WallTime wall_start = ros::WallTime::now();
+  for (const rosbag::MessageInstance& m : *view) {
+    if (!ros::ok()) { break; }
+
+    // optimize for all periods that ended before this message
+    while (m.getTime() >= next_optimization) {
+      SetTime(next_optimization, clock_publisher);
+      std::map<std::string, uint64_t> graph_update_counts;
+      for (const auto& metric : graph_update_metrics) {
+        graph_update_counts[metric] = MetricCount(metric);
+      }
+      const uint64_t num_notify = MetricCount("fixed_lag_smoother/notify");
+      optimizer.optimizeOnce(next_optimization +
+                             ros::Duration(optimization_period));
+      next_optimization += ros::Duration(optimization_period);
+      if (MetricCount("fixed_lag_smoother/notify") == num_notify) { continue; }
+      num_optimizations++;
+      // wait for the sensor models to receive the new graph
+      for (const auto& [metric, count] : graph_update_counts) {
+        if (!WaitForMetric(metric, count + 1, timeout)) { num_timeouts++; }
+      }
+    }
+
+    auto publisher = publishers.find(m.getTopic());
+    if (publisher == publishers.end()) { continue; }
+    SetTime(m.getTime(), clock_publisher);
+    const auto msg = m.instantiate<topic_tools::ShapeShifter>();
+    publisher->second.publish(msg);
+    num_messages++;
+
+    auto iter = sync_metrics.find(m.getTopic());
+    if (iter == sync_metrics.end()) { continue; }
+    uint64_t& expected = expected_counts.at(iter->second);
+    expected++;
+    if (!WaitForMetric(iter->second, expected, timeout)) {
+      ROS_WARN_THROTTLE(1, "Timed out waiting for %s on topic %s",
+                        iter->second.c_str(), m.getTopic().c_str());
+      num_timeouts++;
+      // the stage may have dropped the message
+      expected = MetricCount(iter->second);
+    }
+  }
+  const double wall_time = (ros::WallTime::now() - wall_start).toSec();
+  const double cpu_time = bs_tools::GetProcessCpuTime() - start_process_cpu_s;
+  const double peak_rss_mb = bs_tools::GetPeakRssMb();
+
+  // CPU time of each thread during the replay. Threads which ended before now
+  // are only counted in the process CPU time
+  std::map<int, double> start_thread_cpu_s;
+  for (const auto& thread : start_cpu_times) {
+    start_thread_cpu_s[thread.tid] = thread.cpu_s;
+  }
+  std::vector<bs_tools::ThreadCpuTime> thread_cpu_times =
+      bs_tools::GetThreadCpuTimes();
+  for (auto& thread : thread_cpu_times) {
+    auto iter = start_thread_cpu_s.find(thread.tid);
+    if (iter != start_thread_cpu_s.end()) { thread.cpu_s -= iter->second; }
+  }
+  std::sort(thread_cpu_times.begin(), thread_cpu_times.end(),
+            [](const auto& a, const auto& b) { return a.cpu_s > b.cpu_s; });
+  const double bag_time = (end_time - start_time).toSec();
+  bag.close();
+
+  ROS_INFO("Replayed %lu messages and %lu optimizations in %.2fs (%.2fs of "
+           "data, %.2fx real time), %lu stage timeouts",
+           num_messages, num_optimizations, wall_time, bag_time,
+           bag_time / wall_time, num_timeouts);
+  ROS_INFO("%-45s %8s %10s %10s %10s %10s %10s", "stage", "count", "rate [Hz]",
+           "mean [ms]", "p50 [ms]", "p99 [ms]", "max [ms]");
+  for (const auto& metric :
+       bs_common::Instrumentation::GetInstance().Summarize()) {
+    if (metric.count == 0) { continue; }
+    ROS_INFO("%-45s %8lu %10.1f %10.3f %10.3f %10.3f %10.3f",
+             metric.name.c_str(), metric.count, metric.count / wall_time,
+             1e3 * metric.mean_s, 1e3 * metric.p50_s, 1e3 * metric.p99_s,
+             1e3 * metric.max_s);
+  }
+  ROS_INFO("Peak RSS %.1f MB, CPU time %.2fs (%.2f cores)", peak_rss_mb,
+           cpu_time, cpu_time / wall_time);
+
+  spinner.stop();
+  odometry_subscriber.shutdown();
+
+  int result = 0;
+  if (!trajectory_file.empty()) {
+    trajectory.trajectory = bs_common::Trajectory(std::move(poses));
+    if (trajectory.Save(trajectory_file)) {
+      ROS_INFO("Saved %lu poses to %s", trajectory.trajectory.Size(),
+               trajectory_file.c_str());
+    } else {
+      ROS_ERROR("Unable to save trajectory file %s", trajectory_file.c_str());
+      result = 1;
+    }
+  }
+
+  if (!results_file.empty()) {
+    nlohmann::json J;
+    J["num_messages"] = num_messages;
+    J["num_optimizations"] = num_optimizations;
+    J["num_timeouts"] = num_timeouts;
+    J["wall_time_s"] = wall_time;
+    J["bag_time_s"] = bag_time;
+    J["trajectory_file"] = trajectory_file;
+    nlohmann::json metrics = nlohmann::json::object();
+    for (const auto& metric :
+         bs_common::Instrumentation::GetInstance().Summarize()) {
+      metrics[metric.name] = {{"count", metric.count},
+                              {"counter", metric.counter},
+                              {"mean_s", metric.mean_s},
+                              {"p50_s", metric.p50_s},
+                              {"p99_s", metric.p99_s},
+                              {"max_s", metric.max_s}};
+    }
+    J["metrics"] = metrics;
+    nlohmann::json threads = nlohmann::json::array();
+    for (const auto& thread : thread_cpu_times) {
+      threads.push_back({{"tid", thread.tid},
+                         {"name", thread.name},
+                         {"cpu_s", thread.cpu_s},
+                         {"utilization", thread.cpu_s / wall_time}});
+    }
+    J["process"] = {{"peak_rss_mb", peak_rss_mb},
+                    {"cpu_s", cpu_time},
+                    {"cpu_utilization", cpu_time / wall_time},
+                    {"threads", threads}};
+    std::ofstream file(results_file);
+    file << std::setw(4) << J << std::endl;
+    if (!file.good()) {
+      ROS_ERROR("Unable to write results file %s", results_file.c_str());
+      result = 1;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,123 @@
+#include <bs_tools/replay_runner.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <beam_mapping/Poses.h>
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/trajectory_file.h>
+
+namespace bs_tools {
+
+namespace {
+
+std::string YamlValue(const nlohmann::json& value) {
+  if (value.is_array()) {
+    std::string out = "[";
+    for (size_t i = 0; i < value.size(); i++) {
+      if (i > 0) { out += ", "; }
+      out += YamlValue(value[i]);
+    }
+    return out + "]";
+  }
+  std::string out = value.dump();
+  if (value.is_number_float() && out.find('.') == std::string::npos) {
+    const size_t exponent = out.find('e');
+    if (exponent == std::string::npos) {
+      out += ".0";
+    } else {
+      out.insert(exponent, ".0");
+    }
+  }
+  return out;
+}
+
+void WriteYaml(std::ostream& stream, const nlohmann::json& J, int indent) {
+  const std::string padding(indent, ' ');
+  for (const auto& [key, value] : J.items()) {
+    if (value.is_object()) {
+      stream << padding << YamlValue(key) << ":\n";
+      WriteYaml(stream, value, indent + 2);
+    } else {
+      stream << padding << YamlValue(key) << ": " << YamlValue(value) << "\n";
+    }
+  }
+}
+
+} // namespace
+
+bool RunReplay(const ReplayRun& run, nlohmann::json& results,
+               bs_common::Trajectory& trajectory) {
+  const std::string results_file = run.output_prefix + "_results.json";
+  const std::string trajectory_file = run.output_prefix + "_trajectory.bin";
+  const std::string log_file = run.output_prefix + ".log";
+
+  // roslaunch does not return the exit code of the replay, so outputs of a
+  // previous run with the same prefix must not be mistaken for this one
+  std::filesystem::remove(results_file);
+  std::filesystem::remove(trajectory_file);
+
+  std::map<std::string, std::string> args = run.args;
+  args["results_file"] = results_file;
+  args["trajectory_file"] = trajectory_file;
+  std::stringstream command;
+  command << "ROS_MASTER_URI=http://localhost:" << run.port << " roslaunch -p "
+          << run.port << " " << run.launch_package << " " << run.launch_file;
+  for (const auto& [arg, value] : args) {
+    command << " '" << arg << ":=" << value << "'";
+  }
+  command << " > '" << log_file << "' 2>&1";
+  if (std::system(command.str().c_str()) != 0) {
+    BEAM_ERROR("Replay failed, see {}", log_file);
+    return false;
+  }
+
+  if (!beam::ReadJson(results_file, results)) {
+    BEAM_ERROR("Replay did not write its results, see {}", log_file);
+    return false;
+  }
+  try {
+    trajectory = LoadTrajectory(trajectory_file);
+  } catch (const std::runtime_error&) { return false; }
+  return true;
+}
+
+bs_common::Trajectory LoadTrajectory(const std::string& path) {
+  if (bs_common::TrajectoryFile::IsTrajectoryFile(path)) {
+    bs_common::TrajectoryFile file;
+    if (!file.Load(path)) {
+      BEAM_ERROR("Unable to load trajectory file: {}", path);
+      throw std::runtime_error{"unable to load trajectory file"};
+    }
+    return file.trajectory;
+  }
+  beam_mapping::Poses poses_reader;
+  if (!poses_reader.LoadFromFile(path)) {
+    BEAM_ERROR("Unable to load pose file: {}. Options: .json, .txt, .ply, or "
+               "a binary trajectory file",
+               path);
+    throw std::runtime_error{"unable to load pose file"};
+  }
+  const std::vector<Eigen::Matrix4d, beam::AlignMat4d>& transforms =
+      poses_reader.GetPoses();
+  const std::vector<ros::Time>& timestamps = poses_reader.GetTimeStamps();
+  bs_common::TrajectoryPoses poses;
+  poses.reserve(transforms.size());
+  for (size_t i = 0; i < transforms.size(); i++) {
+    poses.emplace_back(timestamps[i], transforms[i]);
+  }
+  return bs_common::Trajectory(std::move(poses));
+}
+
+bool WriteYaml(const std::string& path, const nlohmann::json& J) {
+  std::ofstream file(path);
+  WriteYaml(file, J, 0);
+  return file.good();
+}
+
+} // namespace bs_tools
@@ -0,0 +1,258 @@
+#include <bs_tools/scoring_suite.h>
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/log.h>
+
+#include <bs_common/utils.h>
+#include <bs_tools/process_stats.h>
+#include <bs_tools/replay_runner.h>
+#include <bs_tools/trajectory_errors.h>
+
+namespace bs_tools {
+
+namespace {
+
+/**
+ * @brief gets the current UTC time as ISO 8601
+ */
+std::string CurrentTime() {
+  const std::time_t now = std::time(nullptr);
+  std::tm utc;
+  gmtime_r(&now, &utc);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+  return buffer;
+}
+
+/**
+ * @brief logs the change of a score from a baseline
+ */
+void LogChange(const std::string& name, const nlohmann::json& baseline,
+               const nlohmann::json& current) {
+  if (!baseline.is_number() || !current.is_number()) { return; }
+  const double before = baseline.get<double>();
+  const double after = current.get<double>();
+  const double change = before != 0 ? 100 * (after - before) / before : 0;
+  BEAM_INFO("  {:<45} {:>12.4f} -> {:>12.4f} ({:+.1f}%)", name, before, after,
+            change);
+}
+
+/**
+ * @brief replaces $(beam_slam_config) and $(beam_slam_calibrations) by the
+ * config and calibrations folders, since launch args given on the command
+ * line are not substituted
+ */
+std::string ResolvePath(std::string path) {
+  const std::vector<std::pair<std::string, std::string>> folders{
+      {"$(beam_slam_config)", bs_common::GetBeamSlamConfigPath()},
+      {"$(beam_slam_calibrations)", bs_common::GetBeamSlamCalibrationsPath()}};
+  for (const auto& [token, folder] : folders) {
+    const size_t position = path.find(token);
+    if (position != std::string::npos) {
+      path.replace(position, token.size(), folder);
+    }
+  }
+  return path;
+}
+
+} // namespace
+
+void ScoringCase::LoadFromJson(const nlohmann::json& J) {
+  if (!J.contains("name")) {
+    BEAM_ERROR("Scoring case needs a name");
+    throw std::invalid_argument{"invalid scoring case"};
+  }
+  name = J["name"];
+  if (J.contains("bag_file")) { bag_file = J["bag_file"]; }
+  if (J.contains("reference_file")) { reference_file = J["reference_file"]; }
+  if (J.contains("launch_args")) {
+    launch_args = J["launch_args"].get<std::map<std::string, std::string>>();
+    for (auto& [arg, value] : launch_args) { value = ResolvePath(value); }
+  }
+  if (J.contains("replay")) { replay = J["replay"]; }
+  if (!replay.is_object()) {
+    BEAM_ERROR("Replay params of scoring case {} must be an object", name);
+    throw std::invalid_argument{"invalid scoring case"};
+  }
+}
+
+void ScoringSuite::Params::LoadFromJson(const nlohmann::json& J) {
+  if (J.contains("output_directory")) {
+    output_directory = J["output_directory"];
+  }
+  if (J.contains("launch_package")) { launch_package = J["launch_package"]; }
+  if (J.contains("launch_file")) { launch_file = J["launch_file"]; }
+  if (J.contains("port")) { port = J["port"]; }
+  if (J.contains("rpe_delta_s")) { rpe_delta_s = J["rpe_delta_s"]; }
+  if (J.contains("throughput_metrics")) {
+    throughput_metrics =
+        J["throughput_metrics"].get<std::map<std::string, std::string>>();
+  }
+  if (J.contains("cases")) {
+    cases.clear();
+    for (const auto& J_case : J["cases"]) {
+      ScoringCase scoring_case;
+      scoring_case.LoadFromJson(J_case);
+      cases.push_back(scoring_case);
+    }
+  }
+  if (output_directory.empty() || cases.empty()) {
+    BEAM_ERROR("Scoring suite needs an output_directory and cases");
+    throw std::invalid_argument{"invalid scoring suite params"};
+  }
+}
+
+ScoringSuite::ScoringSuite(const Params& params) : params_(params) {}
+
+nlohmann::json ScoringSuite::Run(const std::string& label) const {
+  std::filesystem::create_directories(params_.output_directory);
+  nlohmann::json cases = nlohmann::json::array();
+  for (const ScoringCase& scoring_case : params_.cases) {
+    if (scoring_case.bag_file.empty()) {
+      BEAM_WARN("Skipping scoring case {} without a bag", scoring_case.name);
+      continue;
+    }
+    BEAM_INFO("Scoring case {}", scoring_case.name);
+    cases.push_back(RunCase(scoring_case));
+  }
+  return nlohmann::json{{"version", kReportVersion},
+                        {"label", label},
+                        {"time", CurrentTime()},
+                        {"host", GetHostInfo()},
+                        {"cases", cases}};
+}
+
+nlohmann::json ScoringSuite::RunCase(const ScoringCase& scoring_case) const {
+  nlohmann::json report{{"name", scoring_case.name}, {"succeeded", false}};
+  const std::string prefix =
+      beam::CombinePaths(params_.output_directory, scoring_case.name);
+
+  // replaces replay.yaml, whose sync metrics are specific to its topics
+  nlohmann::json replay_config{
+      {"external_trigger", true},
+      {"replay",
+       {{"odometry_topic", "/local_mapper/graph_publisher/odom"}}}};
+  replay_config["replay"].update(scoring_case.replay);
+  const std::string replay_config_file = prefix + "_replay.yaml";
+  if (!WriteYaml(replay_config_file, replay_config)) {
+    BEAM_ERROR("Unable to write replay config: {}", replay_config_file);
+    return report;
+  }
+
+  ReplayRun run;
+  run.launch_package = params_.launch_package;
+  run.launch_file = params_.launch_file;
+  run.args = scoring_case.launch_args;
+  run.args["bag_file"] = scoring_case.bag_file;
+  run.args["replay_config"] = replay_config_file;
+  run.port = params_.port;
+  run.output_prefix = prefix;
+  nlohmann::json results;
+  bs_common::Trajectory trajectory;
+  if (!RunReplay(run, results, trajectory)) { return report; }
+
+  const double wall_time_s = results["wall_time_s"];
+  const double bag_time_s = results["bag_time_s"];
+  report["succeeded"] = true;
+  report["wall_time_s"] = wall_time_s;
+  report["bag_time_s"] = bag_time_s;
+  report["realtime_factor"] = wall_time_s > 0 ? bag_time_s / wall_time_s : 0;
+  report["num_messages"] = results["num_messages"];
+  report["num_timeouts"] = results["num_timeouts"];
+
+  const nlohmann::json& metrics = results["metrics"];
+  nlohmann::json throughput = nlohmann::json::object();
+  for (const auto& [name, metric] : params_.throughput_metrics) {
+    if (!metrics.contains(metric)) { continue; }
+    const double count = metrics[metric]["count"];
+    throughput[name + "_per_s"] = wall_time_s > 0 ? count / wall_time_s : 0;
+    throughput["num_" + name] = count;
+  }
+  report["throughput"] = throughput;
+
+  nlohmann::json stages = nlohmann::json::object();
+  for (const auto& [name, metric] : metrics.items()) {
+    if (metric["count"] == 0) { continue; }
+    stages[name] = {{"count", metric["count"]},
+                    {"mean_ms", 1e3 * metric["mean_s"].get<double>()},
+                    {"p50_ms", 1e3 * metric["p50_s"].get<double>()},
+                    {"p99_ms", 1e3 * metric["p99_s"].get<double>()},
+                    {"max_ms", 1e3 * metric["max_s"].get<double>()}};
+  }
+  report["stages"] = stages;
+  report["process"] = results["process"];
+
+  if (scoring_case.reference_file.empty()) { return report; }
+  TrajectoryErrors errors;
+  try {
+    const bs_common::Trajectory reference =
+        LoadTrajectory(scoring_case.reference_file);
+    if (ComputeTrajectoryErrors(trajectory, reference, params_.rpe_delta_s,
+                                errors)) {
+      report["trajectory"] = {{"ate_m", errors.ate_m},
+                              {"rpe_m", errors.rpe_m},
+                              {"num_poses", errors.num_poses}};
+    } else {
+      BEAM_ERROR("Trajectory of case {} does not overlap its reference",
+                 scoring_case.name);
+    }
+  } catch (const std::runtime_error&) {}
+  return report;
+}
+
+void CompareReports(const nlohmann::json& baseline,
+                    const nlohmann::json& report) {
+  const auto hostname = [](const nlohmann::json& J) {
+    return J.value("host", nlohmann::json::object()).value("hostname", "");
+  };
+  BEAM_INFO("Comparing {} ({}) to baseline {} ({})",
+            report.value("label", ""), hostname(report),
+            baseline.value("label", ""), hostname(baseline));
+  for (const auto& current : report["cases"]) {
+    const std::string name = current["name"];
+    const auto iter = std::find_if(
+        baseline["cases"].begin(), baseline["cases"].end(),
+        [&name](const nlohmann::json& J) { return J["name"] == name; });
+    if (iter == baseline["cases"].end()) { continue; }
+    const nlohmann::json& before = *iter;
+    if (!before.value("succeeded", false) ||
+        !current.value("succeeded", false)) {
+      BEAM_WARN("Case {} failed in one of the reports", name);
+      continue;
+    }
+
+    BEAM_INFO("{}:", name);
+    LogChange("realtime_factor", before["realtime_factor"],
+              current["realtime_factor"]);
+    for (const auto& [key, value] : current["throughput"].items()) {
+      if (before["throughput"].contains(key)) {
+        LogChange(key, before["throughput"][key], value);
+      }
+    }
+    LogChange("peak_rss_mb", before["process"]["peak_rss_mb"],
+              current["process"]["peak_rss_mb"]);
+    LogChange("cpu_utilization", before["process"]["cpu_utilization"],
+              current["process"]["cpu_utilization"]);
+    if (before.contains("trajectory") && current.contains("trajectory")) {
+      LogChange("ate_m", before["trajectory"]["ate_m"],
+                current["trajectory"]["ate_m"]);
+      LogChange("rpe_m", before["trajectory"]["rpe_m"],
+                current["trajectory"]["rpe_m"]);
+    }
+    for (const auto& [stage, value] : current["stages"].items()) {
+      if (before["stages"].contains(stage)) {
+        LogChange(stage + " p99_ms", before["stages"][stage]["p99_ms"],
+                  value["p99_ms"]);
+      }
+    }
+  }
+}
+
+} // namespace bs_tools
@@ -0,0 +1,98 @@
+#include <fstream>
+#include <iomanip>
+
+#include <gflags/gflags.h>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+
+#include <bs_tools/scoring_suite.h>
+
+// clang-format off
+/**
+ * Scores the throughput, latency, memory, CPU usage and trajectory error of
+ * the local mapper on a set of datasets, see bs_tools/scoring_suite.h and the
+ * suite of the example configs in beam_slam_launch/config/scoring_suite.json.
+ * Example command for running binary:
+ *
+ ./devel/lib/bs_tools/bs_tools_scoring_suite_main \
+ -suite_config ~/beam_slam/beam_slam_launch/config/scoring_suite.json \
+ -output_directory ~/results/scoring \
+ -label v1.2.0 \
+ -baseline_report ~/results/scoring_v1.1.0/report.json
+ *
+ * The replays run their own ros master, so no roscore needs to be running.
+ */
+// clang-format on
+
+DEFINE_string(suite_config, "",
+              "Full path to the suite config, with the cases to score "
+              "(Required).");
+DEFINE_validator(suite_config, &beam::gflags::ValidateFileMustExist);
+DEFINE_string(output_directory, "",
+              "Full path to the output directory, overrides the one of the "
+              "suite config.");
+DEFINE_string(report_file, "",
+              "Full path to the report, defaults to report.json in the output "
+              "directory.");
+DEFINE_string(label, "",
+              "What is scored, e.g. a release or commit, written to the "
+              "report.");
+DEFINE_string(baseline_report, "",
+              "Full path to a previous report to compare this one to.");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  nlohmann::json J;
+  if (!beam::ReadJson(FLAGS_suite_config, J)) {
+    BEAM_ERROR("Unable to read suite config: {}", FLAGS_suite_config);
+    return 1;
+  }
+  if (!FLAGS_output_directory.empty()) {
+    J["output_directory"] = FLAGS_output_directory;
+  }
+
+  bs_tools::ScoringSuite::Params params;
+  try {
+    params.LoadFromJson(J);
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Invalid suite config: {}", e.what());
+    return 1;
+  }
+
+  nlohmann::json baseline;
+  if (!FLAGS_baseline_report.empty() &&
+      !beam::ReadJson(FLAGS_baseline_report, baseline)) {
+    BEAM_ERROR("Unable to read baseline report: {}", FLAGS_baseline_report);
+    return 1;
+  }
+
+  bs_tools::ScoringSuite suite(params);
+  const nlohmann::json report = suite.Run(FLAGS_label);
+
+  const std::string report_file =
+      FLAGS_report_file.empty()
+          ? beam::CombinePaths(params.output_directory, "report.json")
+          : FLAGS_report_file;
+  std::ofstream file(report_file);
+  file << std::setw(4) << report << std::endl;
+  if (!file.good()) {
+    BEAM_ERROR("Unable to write report: {}", report_file);
+    return 1;
+  }
+  BEAM_INFO("Report written to: {}", report_file);
+
+  if (!baseline.is_null()) { bs_tools::CompareReports(baseline, report); }
+
+  int num_failed = 0;
+  for (const auto& scoring_case : report["cases"]) {
+    if (!scoring_case["succeeded"].get<bool>()) { num_failed++; }
+  }
+  if (num_failed > 0) {
+    BEAM_ERROR("{} cases failed", num_failed);
+    return 1;
+  }
+  return 0;
+}
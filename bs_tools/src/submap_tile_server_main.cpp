@@ -0,0 +1,75 @@
+#include <chrono>
+#include <thread>
+
+#include <gflags/gflags.h>
+
+#include <beam_utils/filesystem.h>
+#include <beam_utils/gflags.h>
+#include <beam_utils/log.h>
+#include <bs_models/global_mapping/submap_tile_server.h>
+
+// clang-format off
+/**
+ * Runs the inter-robot loop closures of a submap tile store shared by several
+ * robots, see bs_models/global_mapping/submap_tile_server.h. Robots push their
+ * completed submaps with the tile_store params of their global map config.
+ * Example command:
+ *
+ ./devel/lib/bs_tools/bs_tools_submap_tile_server_main \
+ -tile_store_path /mnt/fleet/submap_tiles \
+ -server_config ~/beam_slam/beam_slam_launch/config/global_map/submap_tile_server.json
+ *
+ * Loop closures are appended to tile_store_path/loop_closures.json as they are
+ * found, run with -period_s 0 to process the tiles pushed so far once.
+ */
+// clang-format on
+
+DEFINE_string(tile_store_path, "",
+              "Full path to the root directory of the tile store (Required).");
+DEFINE_validator(tile_store_path, &beam::gflags::ValidateDirMustExist);
+DEFINE_string(
+    server_config, "",
+    "Full path to config file for the server. If left empty, this will use "
+    "the default parameters defined in the class header. You can use the "
+    "default in: .../beam_slam/beam_slam_launch/config/global_map/"
+    "submap_tile_server.json");
+DEFINE_double(period_s, 5.0,
+              "Period in seconds at which new tiles are processed, 0 to "
+              "process them once and exit.");
+
+using bs_models::global_mapping::SubmapTileServer;
+using bs_models::global_mapping::SubmapTileStore;
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  SubmapTileStore::Params store_params;
+  store_params.enabled = true;
+  store_params.directory = FLAGS_tile_store_path;
+  SubmapTileServer::Params params;
+  std::shared_ptr<SubmapTileServer> server;
+  try {
+    params.LoadJson(FLAGS_server_config);
+    server = std::make_shared<SubmapTileServer>(
+        params, std::make_shared<SubmapTileStore>(store_params));
+  } catch (const std::exception& e) {
+    BEAM_ERROR("Cannot start the submap tile server: {}", e.what());
+    return 1;
+  }
+
+  const std::string loop_closures_file =
+      beam::CombinePaths(FLAGS_tile_store_path, "loop_closures.json");
+  while (true) {
+    const auto loop_closures = server->ProcessNewTiles();
+    if (!loop_closures.empty()) {
+      BEAM_INFO("Found {} inter-robot loop closures", loop_closures.size());
+      if (!SubmapTileServer::SaveLoopClosures(loop_closures_file,
+                                              loop_closures)) {
+        return 1;
+      }
+    }
+    if (FLAGS_period_s <= 0) { break; }
+    std::this_thread::sleep_for(std::chrono::duration<double>(FLAGS_period_s));
+  }
+  return 0;
+}
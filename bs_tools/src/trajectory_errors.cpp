@@ -0,0 +1,77 @@
+#include <bs_tools/trajectory_errors.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <beam_utils/log.h>
+
+namespace bs_tools {
+
+bool ComputeTrajectoryErrors(const bs_common::Trajectory& estimate,
+                             const bs_common::Trajectory& reference,
+                             double rpe_delta_s, TrajectoryErrors& errors) {
+  errors = TrajectoryErrors();
+  if (estimate.Empty() || reference.Empty()) { return false; }
+
+  std::vector<ros::Time> times;
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_estimates;
+  for (const bs_common::TrajectoryPose& pose : estimate) {
+    if (pose.stamp < reference.StartTime() ||
+        pose.stamp > reference.EndTime()) {
+      continue;
+    }
+    times.push_back(pose.stamp);
+    T_estimates.push_back(pose.T());
+  }
+  if (times.size() < 3) { return false; }
+  std::vector<Eigen::Matrix4d, beam::AlignMat4d> T_references;
+  std::string error_msg;
+  if (!reference.Get(T_references, times, error_msg)) {
+    BEAM_ERROR("Unable to interpolate reference trajectory: {}", error_msg);
+    return false;
+  }
+
+  const size_t n = times.size();
+  Eigen::Matrix3Xd p_estimates(3, n);
+  Eigen::Matrix3Xd p_references(3, n);
+  for (size_t i = 0; i < n; i++) {
+    p_estimates.col(i) = T_estimates[i].block<3, 1>(0, 3);
+    p_references.col(i) = T_references[i].block<3, 1>(0, 3);
+  }
+  const Eigen::Matrix4d T_REF_EST =
+      Eigen::umeyama(p_estimates, p_references, false);
+  const Eigen::Matrix3Xd p_aligned =
+      (T_REF_EST.block<3, 3>(0, 0) * p_estimates).colwise() +
+      T_REF_EST.block<3, 1>(0, 3);
+  errors.num_poses = n;
+  errors.ate_m = std::sqrt((p_aligned - p_references).colwise()
+                               .squaredNorm()
+                               .mean());
+
+  // pair each pose with the first one at least rpe_delta_s later
+  double squared_error_sum = 0;
+  size_t num_pairs = 0;
+  size_t j = 0;
+  const ros::Duration delta(rpe_delta_s);
+  for (size_t i = 0; i < n; i++) {
+    j = std::max(j, i + 1);
+    while (j < n && times[j] < times[i] + delta) { j++; }
+    if (j == n) { break; }
+    const Eigen::Matrix4d T_estimate =
+        beam::InvertTransform(T_estimates[i]) * T_estimates[j];
+    const Eigen::Matrix4d T_reference =
+        beam::InvertTransform(T_references[i]) * T_references[j];
+    const Eigen::Matrix4d T_error =
+        beam::InvertTransform(T_reference) * T_estimate;
+    squared_error_sum += T_error.block<3, 1>(0, 3).squaredNorm();
+    num_pairs++;
+  }
+  if (num_pairs > 0) {
+    errors.rpe_m = std::sqrt(squared_error_sum / num_pairs);
+  }
+  return true;
+}
+
+} // namespace bs_tools